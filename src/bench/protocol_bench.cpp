@@ -0,0 +1,1769 @@
+// Host benchmark for the VESC protocol code, built by the `native`
+// PlatformIO environment:
+//
+//   pio run -e native -t exec
+//
+// Each case first checks its result against a known answer, so a broken
+// build fails loudly instead of reporting a fast number, then times a
+// fixed amount of work. Numbers are only comparable run to run on the
+// same machine; the point is to spot a regression before flashing.
+//
+// The CRC and the framer are also checked against plain reference
+// versions (reference.h) on a few million random inputs.
+//
+// With --json, the headline number of each case is also written to a
+// file, which tools/bench_check.py compares with a stored baseline:
+//
+//   .pio/build/native/program --json results.json
+//
+// The emulator case drives vesc/emulator.h with a poll loop in virtual
+// time and checks what comes back.
+//
+// Given capture files (see vesc/replay.h) instead, it replays each one
+// through the parser and prints the report for comparison between
+// builds; add --realtime to keep the recorded pacing:
+//
+//   .pio/build/native/program [--realtime] capt0001.vcap ...
+
+#include "reference.h"
+#include "../vesc/bms.h"
+#include "../vesc/buffer.h"
+#include "../vesc/can.h"
+#include "../vesc/command.h"
+#include "../vesc/config.h"
+#include "../vesc/crc.h"
+#include "../vesc/dispatch.h"
+#include "../vesc/emulator.h"
+#include "../vesc/firmware_upload.h"
+#include "../vesc/framer.h"
+#include "../vesc/heartbeat.h"
+#include "../vesc/can_buffer.h"
+#include "../vesc/can_status.h"
+#include "../telemetry/laps.h"
+#include "../telemetry/thermal.h"
+#include "../telemetry/formula.h"
+#include "../telemetry/attitude.h"
+#include "../telemetry/time_align.h"
+#include "../vesc/change_tracker.h"
+#include "../vesc/requests.h"
+#include "../vesc/link_quality.h"
+#include "../vesc/link_analyzer.h"
+#include "../vesc/packet.h"
+#include "../vesc/poll_schedule.h"
+#include "../vesc/protocol.h"
+#include "../vesc/replay.h"
+#include "../vesc/samples.h"
+#include "../vesc/values.h"
+#include "../vesc/values_cache.h"
+#include "../vesc/write_batch.h"
+#include "../vesc/tx_scheduler.h"
+#include "../vesc/throughput.h"
+#include "../telemetry/gps_parser.h"
+#include "../telemetry/filter.h"
+#include "../telemetry/sample_codec.h"
+#include "../telemetry/fixed_point.h"
+#include "../telemetry/units.h"
+#include "../system/broadcast_ring.h"
+#include "../ble/advertising.h"
+
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const int FRAMES = 200000;
+static const size_t CRC_BYTES = 64 * 1024 * 1024;
+static const size_t NOTIFY_SIZE = 20;   // BLE notification payload at the default MTU
+static const int EQUIVALENCE_CRCS = 2000000;
+static const int EQUIVALENCE_STREAMS = 100000;
+
+static volatile uint32_t sink;
+static int failures = 0;
+
+static double secondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// The headline number of each timed case, for --json
+struct BenchResult {
+    const char* name;
+    double value;
+    const char* unit;
+};
+
+static const int MAX_RESULTS = 24;
+static BenchResult results[MAX_RESULTS];
+static int resultCount = 0;
+
+static void result(const char* name, double value, const char* unit) {
+    if (resultCount < MAX_RESULTS) results[resultCount++] = { name, value, unit };
+}
+
+// {"results": {"crc16": {"value": 301.1, "unit": "MB/s"}, ...}} for
+// tools/bench_check.py
+static bool writeResults(const char* path) {
+    FILE* file = fopen(path, "w");
+    if (!file) return false;
+    fprintf(file, "{\n  \"results\": {\n");
+    for (int i = 0; i < resultCount; i++) {
+        fprintf(file, "    \"%s\": {\"value\": %.6g, \"unit\": \"%s\"}%s\n", results[i].name, results[i].value,
+                results[i].unit, i + 1 < resultCount ? "," : "");
+    }
+    fprintf(file, "  }\n}\n");
+    return fclose(file) == 0;
+}
+
+static void check(bool ok, const char* what) {
+    if (!ok) {
+        printf("FAIL: %s\n", what);
+        failures++;
+    }
+}
+
+static void putInt16(uint8_t* out, size_t& index, int16_t value) {
+    out[index++] = (uint8_t)(value >> 8);
+    out[index++] = (uint8_t)value;
+}
+
+static void putInt32(uint8_t* out, size_t& index, int32_t value) {
+    out[index++] = (uint8_t)(value >> 24);
+    out[index++] = (uint8_t)(value >> 16);
+    out[index++] = (uint8_t)(value >> 8);
+    out[index++] = (uint8_t)value;
+}
+
+// COMM_GET_VALUES reply with every group a 6.x firmware sends
+static size_t buildValuesReply(uint8_t* out, int16_t vIn) {
+    size_t n = 0;
+    out[n++] = COMM_GET_VALUES;
+    putInt16(out, n, 352);          // temp_fet
+    putInt16(out, n, 411);          // temp_motor
+    for (int i = 0; i < 4; i++) putInt32(out, n, 1234 * (i + 1));
+    putInt16(out, n, 456);          // duty
+    putInt32(out, n, 18000);        // rpm
+    putInt16(out, n, vIn);
+    for (int i = 0; i < 6; i++) putInt32(out, n, 100000 + i);
+    out[n++] = 0;                   // fault
+    putInt32(out, n, 0);            // pid_pos
+    out[n++] = 7;                   // controller id
+    for (int i = 0; i < 3; i++) putInt16(out, n, 350 + i);
+    putInt32(out, n, 1000);         // vd
+    putInt32(out, n, 2000);         // vq
+    out[n++] = 0;                   // status
+    return n;
+}
+
+// COMM_GET_VALUES_SELECTIVE reply for the dashboard's power group
+static size_t buildSelectiveReply(uint8_t* out, uint32_t mask, int16_t vIn) {
+    size_t n = encodeValuesSelectiveRequest(mask, out);
+    for (int bit = 0; bit < VALUES_FIELD_COUNT; bit++) {
+        if (!(mask & (1u << bit))) continue;
+        if (bit == 8) {
+            putInt16(out, n, vIn);
+        } else {
+            size_t size = valuesSelectiveReplySize(1u << bit);
+            memset(out + n, 0, size);
+            n += size;
+        }
+    }
+    return n;
+}
+
+static void benchCrc() {
+    const uint8_t known[] = { '1', '2', '3', '4', '5', '6', '7', '8', '9' };
+    check(crc16(known, sizeof(known)) == 0x31C3, "crc16 check value");
+
+    static uint8_t data[4096];
+    for (size_t i = 0; i < sizeof(data); i++) data[i] = (uint8_t)rand();
+
+    auto start = std::chrono::steady_clock::now();
+    uint16_t crc = 0;
+    for (size_t done = 0; done < CRC_BYTES; done += sizeof(data)) {
+        crc = crc16Update(crc, data, sizeof(data));
+    }
+    double seconds = secondsSince(start);
+    sink = crc;
+    printf("crc16            %8.1f MB/s\n", CRC_BYTES / seconds / 1e6);
+    result("crc16", CRC_BYTES / seconds / 1e6, "MB/s");
+}
+
+struct FrameCount {
+    uint32_t frames;
+    uint32_t checksum;
+};
+
+static void countFrame(const uint8_t* payload, size_t length, void* context) {
+    FrameCount* count = (FrameCount*)context;
+    count->frames++;
+    count->checksum += payload[length - 1];
+}
+
+// Arrival times of the frames a framer emits
+struct FrameTimes {
+    VescFramer* framer;
+    uint64_t times[4];
+    uint32_t frames;
+};
+
+static void timeFrame(const uint8_t* payload, size_t length, void* context) {
+    FrameTimes* times = (FrameTimes*)context;
+    if (times->frames < 4) times->times[times->frames] = times->framer->frameTimeUs();
+    times->frames++;
+}
+
+static void benchFramer() {
+    // A stream of values replies cut into notification-sized pieces, as
+    // they arrive over BLE
+    uint8_t payload[128];
+    size_t payloadLength = buildValuesReply(payload, 421);
+    uint8_t packet[128 + VESC_PACKET_MAX_OVERHEAD];
+    size_t packetLength = vescEncodePacket(payload, payloadLength, packet);
+    check(packetLength == payloadLength + 5, "short packet length");
+
+    const int perStream = 64;
+    static uint8_t stream[perStream * sizeof(packet)];
+    size_t streamLength = 0;
+    for (int i = 0; i < perStream; i++) {
+        memcpy(stream + streamLength, packet, packetLength);
+        streamLength += packetLength;
+    }
+
+    FrameCount count = { 0, 0 };
+    VescFramer framer(countFrame, &count);
+    auto start = std::chrono::steady_clock::now();
+    for (int round = 0; round < FRAMES / perStream; round++) {
+        for (size_t offset = 0; offset < streamLength; offset += NOTIFY_SIZE) {
+            size_t n = streamLength - offset < NOTIFY_SIZE ? streamLength - offset : NOTIFY_SIZE;
+            framer.feed(stream + offset, n);
+        }
+    }
+    double seconds = secondsSince(start);
+    sink = count.checksum;
+
+    uint32_t expected = (FRAMES / perStream) * perStream;
+    check(count.frames == expected, "framer frame count");
+    check(framer.crcErrorCount() == 0 && framer.bytesDiscarded() == 0, "framer errors");
+    printf("framer           %8.0f frames/s  (%.1f MB/s)\n",
+           count.frames / seconds, count.frames * (double)packetLength / seconds / 1e6);
+    result("framer", count.frames / seconds, "frames/s");
+
+    // Long frames take the 2-byte length path
+    static uint8_t big[600];
+    for (size_t i = 0; i < sizeof(big); i++) big[i] = (uint8_t)i;
+    static uint8_t bigPacket[sizeof(big) + VESC_PACKET_MAX_OVERHEAD];
+    size_t bigLength = vescEncodePacket(big, sizeof(big), bigPacket);
+    FrameCount bigCount = { 0, 0 };
+    VescFramer bigFramer(countFrame, &bigCount);
+    bigFramer.feed(bigPacket, bigLength);
+    check(bigPacket[0] == VESC_PACKET_START_LONG && bigCount.frames == 1, "long packet round trip");
+
+    // A frame is stamped with the feed its start byte came in: the first
+    // packet is split over two notifications, the second starts in the
+    // second and ends in the third
+    FrameTimes times = {};
+    VescFramer timedFramer(timeFrame, &times);
+    times.framer = &timedFramer;
+    uint8_t pair[2 * sizeof(packet)];
+    memcpy(pair, packet, packetLength);
+    memcpy(pair + packetLength, packet, packetLength);
+    timedFramer.feed(pair, 3, 100);
+    timedFramer.feed(pair + 3, packetLength, 200);
+    timedFramer.feed(pair + 3 + packetLength, packetLength - 3, 300);
+    check(times.frames == 2 && times.times[0] == 100 && times.times[1] == 200, "framer arrival times");
+}
+
+// Digest of what a framer emits, as referenceFrame() computes it
+struct FrameDigest {
+    uint32_t frames;
+    uint32_t digest;
+};
+
+static void digestFrame(const uint8_t* payload, size_t length, void* context) {
+    FrameDigest* out = (FrameDigest*)context;
+    out->frames++;
+    out->digest = referenceDigest(out->digest, payload, length);
+}
+
+// Frames, damaged frames and noise: the kinds of trouble a BLE link
+// causes, and a few it should not
+static size_t randomStream(uint8_t* out, size_t capacity) {
+    static uint8_t payload[VescFramer::MAX_PAYLOAD + 64];
+    size_t length = 0;
+    int pieces = 1 + rand() % 8;
+    for (int piece = 0; piece < pieces; piece++) {
+        uint8_t* at = out + length;
+        size_t room = capacity - length;
+        if (room < sizeof(payload) + VESC_PACKET_MAX_OVERHEAD) break;
+        int kind = rand() % 8;
+        size_t payloadLength = rand() % 4 ? 1 + rand() % 80 : 1 + rand() % (VescFramer::MAX_PAYLOAD + 40);
+        for (size_t i = 0; i < payloadLength; i++) payload[i] = (uint8_t)(rand() % 3 ? rand() : 2 + rand() % 3);
+        size_t n = 0;
+        if (kind == 6) {
+            // Noise, heavy on start and stop bytes
+            n = 1 + rand() % 24;
+            for (size_t i = 0; i < n; i++) at[i] = (uint8_t)(rand() % 2 ? 2 + rand() % 3 : rand());
+        } else if (kind == 7) {
+            // A header with a length that is no frame's
+            at[0] = VESC_PACKET_START_HUGE;
+            uint32_t bogus = rand() % 2 ? 0 : VescFramer::MAX_PAYLOAD + 1 + rand() % 70000;
+            at[1] = (uint8_t)(bogus >> 16);
+            at[2] = (uint8_t)(bogus >> 8);
+            at[3] = (uint8_t)bogus;
+            n = 4;
+        } else {
+            n = vescEncodePacket(payload, payloadLength, at);
+            if (kind == 4) at[rand() % n] ^= (uint8_t)(1 << rand() % 8);
+            if (kind == 5) n = 1 + rand() % n;
+        }
+        length += n;
+    }
+    return length;
+}
+
+// The table CRC and the ring framer against the plain versions in
+// reference.h, on random inputs. The stream is fed in random pieces, so
+// this also checks that how it was split makes no difference.
+static void checkEquivalence() {
+    srand(118);
+    auto start = std::chrono::steady_clock::now();
+    static uint8_t data[2048];
+    for (size_t i = 0; i < sizeof(data); i++) data[i] = (uint8_t)rand();
+    bool crcs = true;
+    for (int i = 0; i < EQUIVALENCE_CRCS && crcs; i++) {
+        size_t offset = rand() % 64;
+        size_t length = rand() % 64 ? rand() % 96 : rand() % (sizeof(data) - 64);
+        size_t split = length ? rand() % length : 0;
+        const uint8_t* p = data + offset;
+        uint16_t expected = referenceCrc16(p, length);
+        crcs = crc16(p, length) == expected && crc16Update(crc16(p, split), p + split, length - split) == expected;
+        data[rand() % sizeof(data)] = (uint8_t)rand();
+    }
+    check(crcs, "crc16 matches the bitwise CRC");
+
+    static uint8_t stream[16384];
+    uint64_t frames = 0;
+    bool framers = true;
+    for (int i = 0; i < EQUIVALENCE_STREAMS && framers; i++) {
+        size_t length = randomStream(stream, sizeof(stream));
+        ReferenceFrames expected;
+        referenceFrame(stream, length, VescFramer::MAX_PAYLOAD, expected);
+
+        FrameDigest got = { 0, 0 };
+        VescFramer framer(digestFrame, &got);
+        for (size_t offset = 0; offset < length;) {
+            size_t n = rand() % 8 ? 1 + rand() % 40 : 1 + rand() % 3000;
+            if (n > length - offset) n = length - offset;
+            framer.feed(stream + offset, n);
+            offset += n;
+        }
+        framers = got.frames == expected.frames && got.digest == expected.digest &&
+                  framer.bytesDiscarded() == expected.discarded && framer.crcErrorCount() == expected.crcErrors &&
+                  framer.stopErrorCount() == expected.stopErrors && framer.oversizeCount() == expected.oversize;
+        if (!framers) printf("stream %d: %u frames, reference %u\n", i, (unsigned)got.frames, (unsigned)expected.frames);
+        frames += expected.frames;
+    }
+    check(framers, "framer matches the reference framer");
+    printf("equivalence      %d CRCs, %d streams (%llu frames) in %.1f s\n", EQUIVALENCE_CRCS, EQUIVALENCE_STREAMS,
+           (unsigned long long)frames, secondsSince(start));
+}
+
+static void benchDecode() {
+    VescFirmware fw = { 6, 2 };
+    const ValuesLayout& layout = valuesLayoutForFirmware(fw);
+    uint8_t payload[128];
+    size_t length = buildValuesReply(payload, 421);
+
+    VescValues values;
+    memset(&values, 0, sizeof(values));
+    check(decodeValues(payload, length, layout, values) && values.vIn == 421 &&
+          values.fields == VALUES_ALL_FIELDS, "decodeValues");
+    check(valuesField(values, VALUES_BIT_V_IN) == 421 && valuesField(values, VALUES_BIT_TEMP_MOS, 2) == values.tempMos[2] &&
+          valuesField(values, VALUES_BIT_STATUS) == values.status, "valuesField");
+
+    // Older firmware: the handshake picks a shorter table, and the full
+    // one refuses its replies
+    VescFirmware older = { 3, 40 };
+    const ValuesLayout& olderLayout = valuesLayoutForFirmware(older);
+    uint8_t olderPayload[VALUES_MAX_REPLY_SIZE];
+    size_t olderLength = encodeValues(values, olderLayout.fields, olderPayload);
+    VescValues olderValues;
+    memset(&olderValues, 0, sizeof(olderValues));
+    check(olderLength == olderLayout.size && decodeValues(olderPayload, olderLength, olderLayout, olderValues) &&
+          olderValues.tempMos[2] == values.tempMos[2] && olderValues.fields == olderLayout.fields &&
+          !decodeValues(olderPayload, olderLength, layout, olderValues), "decodeValues older firmware");
+
+    auto start = std::chrono::steady_clock::now();
+    uint32_t total = 0;
+    for (int i = 0; i < FRAMES; i++) {
+        decodeValues(payload, length, layout, values);
+        total += values.vIn;
+    }
+    double seconds = secondsSince(start);
+    sink = total;
+    printf("decodeValues     %8.1f ns/frame\n", seconds * 1e9 / FRAMES);
+    result("decodeValues", seconds * 1e9 / FRAMES, "ns/frame");
+
+    uint32_t mask = VALUES_MASK_POWER;
+    length = buildSelectiveReply(payload, mask, 398);
+    memset(&values, 0, sizeof(values));
+    check(decodeValuesSelective(payload, length, values) && values.vIn == 398 &&
+          values.fields == mask, "decodeValuesSelective");
+
+    // The decoder generated for the mask reads the same, and refuses
+    // replies to other masks
+    ValuesDecoder maskDecoder = valuesDecoderForMask(mask);
+    VescValues generated;
+    memset(&generated, 0, sizeof(generated));
+    uint8_t temps[VALUES_MAX_REPLY_SIZE];
+    size_t tempsLength = encodeValuesSelective(values, VALUES_MASK_TEMPS, temps);
+    check(maskDecoder != decodeValuesSelective && maskDecoder(payload, length, generated) &&
+          memcmp(&generated, &values, sizeof(values)) == 0 && !maskDecoder(temps, tempsLength, generated) &&
+          !maskDecoder(payload, length - 1, generated) &&
+          valuesDecoderForMask(mask & ~VALUES_FIELD_RPM) == decodeValuesSelective, "valuesDecoderForMask");
+
+    // Forwarded replies are routed by the controller id they carry
+    VescValues forwarded;
+    memset(&forwarded, 0, sizeof(forwarded));
+    forwarded.controllerId = 5;
+    uint8_t routed[VALUES_MAX_REPLY_SIZE];
+    size_t routedLength = encodeValuesSelective(forwarded, mask | VALUES_FIELD_CONTROLLER_ID | VALUES_FIELD_VQ, routed);
+    check(valuesReplyControllerId(routed, routedLength, layout) == 5 &&
+          valuesReplyControllerId(payload, length, layout) == -1, "valuesReplyControllerId");
+
+    // A scope sample: float channels into mA and mV
+    uint8_t samplePayload[64];
+    size_t sampleLength = 0;
+    bufferAppendUint8(samplePayload, COMM_SAMPLE_PRINT, sampleLength);
+    for (int c = 0; c < VESC_SAMPLE_CHANNELS; c++) bufferAppendFloat32Auto(samplePayload, -12.5f + c, sampleLength);
+    bufferAppendUint8(samplePayload, 0x11, sampleLength);
+    bufferAppendUint8(samplePayload, 3, sampleLength);
+    VescSample sample;
+    check(decodeSample(samplePayload, sampleLength, sample) && sample.channels[VESC_SAMPLE_CURRENT_1] == -12500 &&
+          sample.channels[VESC_SAMPLE_F_SW] == -6 && sample.status == 0x11 && sample.phase == 3 &&
+          !decodeSample(samplePayload, sampleLength - 1, sample), "decodeSample");
+
+    start = std::chrono::steady_clock::now();
+    total = 0;
+    for (int i = 0; i < FRAMES; i++) {
+        decodeValuesSelective(payload, length, values);
+        total += values.vIn;
+    }
+    seconds = secondsSince(start);
+    sink = total;
+    printf("decodeSelective  %8.1f ns/frame\n", seconds * 1e9 / FRAMES);
+    result("decodeSelective", seconds * 1e9 / FRAMES, "ns/frame");
+
+    start = std::chrono::steady_clock::now();
+    total = 0;
+    for (int i = 0; i < FRAMES; i++) {
+        maskDecoder(payload, length, values);
+        total += values.vIn;
+    }
+    seconds = secondsSince(start);
+    sink = total;
+    printf("decodeMask       %8.1f ns/frame\n", seconds * 1e9 / FRAMES);
+    result("decodeMask", seconds * 1e9 / FRAMES, "ns/frame");
+}
+
+// Write handler that feeds each write straight back into a framer. A
+// non-negative budget is the number of writes taken before the link
+// reports itself busy.
+struct BatchSink {
+    VescFramer* framer;
+    uint32_t writes;
+    size_t largest;
+    int budget;
+};
+
+static bool batchWrite(const uint8_t* data, size_t length, void* context) {
+    BatchSink* out = (BatchSink*)context;
+    if (out->budget == 0) return false;
+    if (out->budget > 0) out->budget--;
+    out->writes++;
+    if (length > out->largest) out->largest = length;
+    out->framer->feed(data, length);
+    return true;
+}
+
+// Command bytes of the frames a framer emits, in order
+struct FrameOrder {
+    uint8_t commands[32];
+    uint32_t frames;
+};
+
+static void recordFrame(const uint8_t* payload, size_t length, void* context) {
+    FrameOrder* order = (FrameOrder*)context;
+    if (order->frames < sizeof(order->commands)) order->commands[order->frames] = payload[0];
+    order->frames++;
+}
+
+static void checkScheduler() {
+    FrameOrder order = {};
+    VescFramer framer(recordFrame, &order);
+    BatchSink out = { &framer, 0, 0, -1 };
+    VescTxScheduler tx(batchWrite, &out);
+    VescCommand poll(COMM_GET_VALUES_SELECTIVE);
+    poll.addUint32(0x0001A3C0);
+    VescCommand setCurrent(COMM_SET_CURRENT);
+    setCurrent.addInt32(-12500);
+
+    // Control queued after the polls still goes first
+    tx.setWriteLimit(100);
+    tx.add(VescTxScheduler::TELEMETRY, poll, 0);
+    tx.add(VescTxScheduler::TELEMETRY, poll, 0);
+    tx.add(VescTxScheduler::CONTROL, setCurrent, 0);
+    tx.flush();
+    check(order.frames == 3 && order.commands[0] == COMM_SET_CURRENT && order.commands[1] == COMM_GET_VALUES_SELECTIVE,
+          "scheduler control first");
+
+    // A poll cut off by a busy link is finished before control, so the
+    // byte stream stays whole (the first two went out as the batch filled)
+    tx.setWriteLimit(7);
+    for (int i = 0; i < 3; i++) tx.add(VescTxScheduler::TELEMETRY, poll, 0);
+    out.budget = 1;
+    tx.flush();
+    bool cut = tx.batch(VescTxScheduler::TELEMETRY).partialBytes() > 0;
+    out.budget = -1;
+    tx.add(VescTxScheduler::CONTROL, setCurrent, 0);
+    tx.flush();
+    check(cut && order.frames == 7 && order.commands[5] == COMM_GET_VALUES_SELECTIVE &&
+          order.commands[6] == COMM_SET_CURRENT && framer.crcErrorCount() == 0 && tx.pending() == 0,
+          "scheduler finishes a cut frame");
+
+    // 10 control frames a second, bursts of 2
+    tx.setLimit(VescTxScheduler::CONTROL, 10, 2);
+    bool burst = tx.add(VescTxScheduler::CONTROL, setCurrent, 1000) && tx.add(VescTxScheduler::CONTROL, setCurrent, 1000);
+    bool over = !tx.add(VescTxScheduler::CONTROL, setCurrent, 1050);
+    bool refilled = tx.add(VescTxScheduler::CONTROL, setCurrent, 1100);
+    bool polls = tx.add(VescTxScheduler::TELEMETRY, poll, 1100);
+    check(burst && over && refilled && polls && tx.framesLimited(VescTxScheduler::CONTROL) == 1,
+          "scheduler control rate");
+}
+
+static void checkHeartbeat() {
+    // ALIVE every 500 ms, probe after 750 ms quiet, dead after 2 s
+    VescHeartbeat heartbeat(500, 750, 2000);
+    heartbeat.reset(0);
+    bool early = !heartbeat.piggyback(200);
+    bool rides = heartbeat.piggyback(260) && heartbeat.idle(500) == VescHeartbeat::HEARTBEAT_NONE;
+    heartbeat.onFrame(600);
+    bool alone = heartbeat.idle(760) == VescHeartbeat::HEARTBEAT_ALIVE && heartbeat.msUntilDue(760) == 500;
+    check(early && rides && alone && heartbeat.piggybacked() == 1 && heartbeat.standalone() == 1,
+          "heartbeat piggyback");
+
+    bool probe = heartbeat.idle(1400) == VescHeartbeat::HEARTBEAT_PROBE &&
+                 heartbeat.idle(1500) == VescHeartbeat::HEARTBEAT_NONE;
+    check(probe && !heartbeat.dead(2500) && heartbeat.dead(2600) && !heartbeat.dead(2600, 2), "heartbeat silence");
+
+    // Two polls 50 ms apart on a 20 ms RTT, neither answered
+    RequestTracker tracker(2, 1000, 50, 2000);
+    tracker.onSent(COMM_GET_VALUES, 0);
+    tracker.onReply(COMM_GET_VALUES, 20);
+    tracker.onSent(COMM_GET_VALUES, 100);
+    tracker.onSent(COMM_GET_VALUES, 150);
+    bool none = tracker.overdue(155, 0) == 0;
+    bool both = tracker.overdue(230, 0) == 2 && tracker.overdue(230, 250) == 0 && tracker.overdue(400, 250) == 2;
+    tracker.onReply(COMM_GET_VALUES, 410);
+    check(none && both && tracker.inFlight() == 1 && tracker.overdue(1200, 0) == 1, "missed replies in a row");
+}
+
+// A firmware image pushed through a simulated VESC in virtual time: each
+// packet takes the link latency each way, and the VESC handles them one
+// at a time at UART speed. Returns the ms taken; out gets what was written.
+static std::vector<uint8_t> uploadImage;
+
+static size_t readUploadImage(uint32_t offset, uint8_t* out, size_t length, void* context) {
+    if (offset >= uploadImage.size()) return 0;
+    if (length > uploadImage.size() - offset) length = uploadImage.size() - offset;
+    memcpy(out, &uploadImage[offset], length);
+    return length;
+}
+
+static uint32_t simulateUpload(uint8_t maxWindow, uint32_t dropAck, std::vector<uint8_t>& out, bool& jumped,
+                               VescFirmwareUpload& upload) {
+    const uint32_t LATENCY_MS = 30;
+    struct InFlight {
+        uint32_t atMs;
+        std::vector<uint8_t> payload;
+    };
+    std::vector<InFlight> toVesc, toDash;
+    upload.start(uploadImage.size(), maxWindow, 244);
+    out.assign(uploadImage.size() + VescFirmwareUpload::HEADER_BYTES, 0);
+    jumped = false;
+    uint32_t vescFreeMs = 0, acks = 0;
+    uint8_t payload[VescFirmwareUpload::MAX_PAYLOAD];
+    uint32_t now = 0;
+    for (; now < 600000 && (upload.active() || !toVesc.empty()); now++) {
+        size_t n;
+        while ((n = upload.next(payload, now)) > 0) {
+            toVesc.push_back({ now + LATENCY_MS, std::vector<uint8_t>(payload, payload + n) });
+            upload.sent(now);
+        }
+        // The VESC: one packet at a time, ~12 bytes a ms over its UART
+        while (!toVesc.empty() && toVesc[0].atMs <= now && vescFreeMs <= now) {
+            std::vector<uint8_t> p = toVesc[0].payload;
+            toVesc.erase(toVesc.begin());
+            vescFreeMs = now + 1 + p.size() / 12;
+            uint8_t reply[6] = { p[0], 1, 0, 0, 0, 0 };
+            if (p[0] == COMM_JUMP_TO_BOOTLOADER) {
+                jumped = true;
+                continue;
+            }
+            if (p[0] == COMM_WRITE_NEW_APP_DATA) {
+                size_t index = 1;
+                uint32_t offset = bufferGetUint32(p.data(), index);
+                memcpy(&out[offset], &p[5], p.size() - 5);
+                memcpy(reply + 2, &p[1], 4);
+                if (++acks == dropAck) continue;
+            }
+            toDash.push_back({ vescFreeMs + LATENCY_MS, std::vector<uint8_t>(reply, reply + 6) });
+        }
+        while (!toDash.empty() && toDash[0].atMs <= now) {
+            upload.onReply(toDash[0].payload.data(), toDash[0].payload.size(), now);
+            toDash.erase(toDash.begin());
+        }
+    }
+    return now;
+}
+
+static void checkFirmwareUpload() {
+    uploadImage.resize(100000);
+    for (size_t i = 0; i < uploadImage.size(); i++) uploadImage[i] = (uint8_t)(i * 7 + (i >> 8));
+    std::vector<uint8_t> written;
+    bool jumped;
+
+    VescFirmwareUpload serial(readUploadImage);
+    uint32_t serialMs = simulateUpload(1, 0, written, jumped, serial);
+
+    VescFirmwareUpload windowed(readUploadImage);
+    uint32_t windowedMs = simulateUpload(8, 20, written, jumped, windowed);
+    size_t index = 0;
+    bool header = bufferGetUint32(written.data(), index) == uploadImage.size() &&
+                  bufferGetUint16(written.data(), index) == crc16(uploadImage.data(), uploadImage.size());
+    bool image = memcmp(&written[VescFirmwareUpload::HEADER_BYTES], uploadImage.data(), uploadImage.size()) == 0;
+    check(windowed.state() == VescFirmwareUpload::UPLOAD_DONE && jumped && header && image &&
+          windowed.retransmits() >= 1 && windowed.chunkBytes() == 476, "firmware upload");
+    check(windowedMs * 2 < serialMs, "firmware upload window");
+    printf("firmware upload: %u ms one chunk at a time, %u ms windowed (window %u, %u resent)\n", serialMs,
+           windowedMs, windowed.window(), windowed.retransmits());
+}
+
+static void benchCommands() {
+    // The builder matches the hand-rolled encoders
+    uint8_t expected[16];
+    uint8_t selective[5];
+    size_t selectiveLength = encodeValuesSelectiveRequest(0x0001A3C0, selective);
+    size_t expectedLength = encodeForwardCan(7, selective, selectiveLength, expected);
+    VescCommand forwarded(COMM_GET_VALUES_SELECTIVE, 7);
+    forwarded.addUint32(0x0001A3C0);
+    check(forwarded.valid() && forwarded.length() == expectedLength &&
+          memcmp(forwarded.payload(), expected, expectedLength) == 0, "command builder layout");
+
+    VescCommand setCurrent(COMM_SET_CURRENT);
+    setCurrent.addFloat32(-12.5f, 1000.0f).addInt16(-2).addUint16(0xBEEF);
+    size_t index = 1;
+    check(bufferGetInt32(setCurrent.payload(), index) == -12500 &&
+          bufferGetInt16(setCurrent.payload(), index) == -2 &&
+          bufferGetUint16(setCurrent.payload(), index) == 0xBEEF, "command builder fields");
+
+    VescCommand tooLong(COMM_FW_VERSION);
+    for (size_t i = 0; i < VescCommand::MAX_PAYLOAD; i++) tooLong.addUint8(0);
+    check(!tooLong.valid() && tooLong.length() == VescCommand::MAX_PAYLOAD, "command builder overflow");
+
+    // Six controllers' polls at the default MTU: whole frames per write;
+    // at a large MTU: one write
+    FrameCount count = { 0, 0 };
+    VescFramer framer(countFrame, &count);
+    BatchSink out = { &framer, 0, 0, -1 };
+    VescWriteBatch batch(batchWrite, &out);
+    for (int i = 0; i < 6; i++) batch.add(forwarded);
+    batch.flush();
+    check(count.frames == 6 && out.writes == 6 && out.largest <= batch.writeLimit(), "batch at default MTU");
+
+    out.writes = 0;
+    batch.setWriteLimit(509);
+    for (int i = 0; i < 6; i++) batch.add(forwarded);
+    batch.flush();
+    check(count.frames == 12 && out.writes == 1, "batch at large MTU");
+
+    // A frame longer than the limit is split and still reassembled
+    static uint8_t big[300];
+    out.largest = 0;
+    batch.setWriteLimit(20);
+    batch.add(big, sizeof(big));
+    batch.flush();
+    check(count.frames == 13 && framer.crcErrorCount() == 0 && out.largest <= 20, "batch splits long frames");
+
+    // A busy link keeps the rest queued for the next flush
+    out.writes = 0;
+    out.budget = 2;
+    for (int i = 0; i < 6; i++) batch.add(forwarded);
+    bool partial = batch.flush();
+    check(!partial && out.writes == 2 && count.frames == 15 && batch.pending() > 0, "batch defers on a busy link");
+    out.budget = -1;
+    check(batch.flush() && batch.pending() == 0 && count.frames == 19 && framer.crcErrorCount() == 0,
+          "batch resumes after a busy link");
+    checkScheduler();
+    checkHeartbeat();
+
+    batch.setWriteLimit(244);
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < FRAMES; i++) {
+        VescCommand request(COMM_GET_VALUES_SELECTIVE, (uint8_t)(i & 3));
+        request.addUint32((uint32_t)i);
+        batch.add(request);
+        if ((i & 3) == 3) batch.flush();
+    }
+    batch.flush();
+    double seconds = secondsSince(start);
+    check(batch.framesQueued() == (uint32_t)FRAMES + 19 && batch.framesDropped() == 0, "batch frame count");
+    printf("commands         %8.0f frames/s  (%.2f frames/write)\n",
+           FRAMES / seconds, (double)batch.framesQueued() / batch.writesIssued());
+    result("commands", FRAMES / seconds, "frames/s");
+}
+
+static uint64_t hostClock() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static void hostSleep(uint32_t us) {
+    std::this_thread::sleep_for(std::chrono::microseconds(us));
+}
+
+static void appendChunk(std::vector<uint8_t>& capture, uint32_t timeUs, const uint8_t* data, size_t length) {
+    CaptureChunkHeader chunk;
+    chunk.timeUs = timeUs;
+    chunk.length = (uint16_t)length;
+    const uint8_t* header = (const uint8_t*)&chunk;
+    capture.insert(capture.end(), header, header + sizeof(chunk));
+    capture.insert(capture.end(), data, data + length);
+}
+
+static void benchReplay() {
+    // A synthetic capture: values replies cut at random points, as a BLE
+    // module that splits on its own buffer boundaries does
+    std::vector<uint8_t> capture(sizeof(CaptureFileHeader));
+    CaptureFileHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic = CAPTURE_MAGIC;
+    header.version = CAPTURE_VERSION;
+    header.headerSize = sizeof(header);
+
+    std::vector<uint8_t> stream;
+    uint8_t payload[128];
+    uint8_t packet[128 + VESC_PACKET_MAX_OVERHEAD];
+    const int packets = 20000;
+    for (int i = 0; i < packets; i++) {
+        size_t length = buildValuesReply(payload, (int16_t)(400 + i % 50));
+        size_t n = vescEncodePacket(payload, length, packet);
+        stream.insert(stream.end(), packet, packet + n);
+    }
+    srand(1);
+    uint32_t timeUs = 0;
+    for (size_t offset = 0; offset < stream.size(); ) {
+        size_t n = 1 + rand() % 100;
+        if (n > stream.size() - offset) n = stream.size() - offset;
+        appendChunk(capture, timeUs, stream.data() + offset, n);
+        offset += n;
+        timeUs += 500;
+        header.chunkCount++;
+    }
+    memcpy(capture.data(), &header, sizeof(header));
+
+    ReplayReport first, second;
+    check(replayCapture(capture.data(), capture.size(), false, hostClock, hostSleep, first), "replay accepts capture");
+    check(first.frames == (uint32_t)packets && first.valuesDecoded == (uint32_t)packets &&
+          first.crcErrors == 0 && first.bytesDiscarded == 0, "replay frames");
+    replayCapture(capture.data(), capture.size(), false, hostClock, hostSleep, second);
+    check(first.frameDigest == second.frameDigest && first.valuesDigest == second.valuesDigest,
+          "replay is deterministic");
+
+    double seconds = second.elapsedUs / 1e6;
+    printf("replay           %8.0f chunks/s  (%.1f MB/s, %u frames)\n",
+           second.chunks / seconds, second.bytes / seconds / 1e6, second.frames);
+    result("replay", second.chunks / seconds, "chunks/s");
+}
+
+struct EmulatorClient {
+    VescFramer* framer;
+    uint32_t chunks;
+    uint16_t largestChunk;
+};
+
+static void emulatorOutput(const uint8_t* data, size_t length, void* context) {
+    EmulatorClient* client = (EmulatorClient*)context;
+    client->chunks++;
+    if (length > client->largestChunk) client->largestChunk = (uint16_t)length;
+    client->framer->feed(data, length);
+}
+
+struct EmulatorReplies {
+    uint32_t fw;
+    uint32_t values;
+    uint32_t selective;
+    uint32_t alive;
+    uint32_t fromCan;
+    int pinged;
+    uint8_t canIds[4];
+    bool decoded;
+};
+
+static void countEmulatorReply(const uint8_t* payload, size_t length, void* context) {
+    EmulatorReplies* replies = (EmulatorReplies*)context;
+    VescFirmware fw = { 6, 2 };
+    const ValuesLayout& layout = valuesLayoutForFirmware(fw);
+    VescValues values;
+    switch (payload[0]) {
+        case COMM_FW_VERSION:
+            replies->fw++;
+            break;
+        case COMM_ALIVE:
+            replies->alive++;
+            break;
+        case COMM_PING_CAN:
+            replies->pinged = decodePingCan(payload, length, replies->canIds, sizeof(replies->canIds));
+            break;
+        case COMM_GET_VALUES:
+            replies->values++;
+            if (!decodeValues(payload, length, layout, values) ||
+                valuesReplyControllerId(payload, length, layout) != values.controllerId) replies->decoded = false;
+            if (values.controllerId == 1) replies->fromCan++;
+            break;
+        case COMM_GET_VALUES_SELECTIVE:
+            replies->selective++;
+            if (!decodeValuesSelective(payload, length, values) || values.vIn < 400) replies->decoded = false;
+            break;
+    }
+}
+
+static void benchEmulator() {
+    // A 50 Hz poll of the local controller and one on CAN, in virtual
+    // time, first on a clean link and then with drops
+    static const uint8_t canIds[] = { 1 };
+    EmulatorConfig config = { 0, canIds, 1, 6, 2, 4000, 2000, 20, 0, 1 };
+    const int TICKS = 20000;
+
+    for (int pass = 0; pass < 2; pass++) {
+        config.dropPerMille = pass == 0 ? 0 : 100;
+        EmulatorReplies replies;
+        memset(&replies, 0, sizeof(replies));
+        replies.pinged = -1;
+        replies.decoded = true;
+        VescFramer framer(countEmulatorReply, &replies);
+        EmulatorClient client = { &framer, 0, 0 };
+        VescEmulator emulator(config, emulatorOutput, &client);
+
+        uint8_t payload[16];
+        uint8_t packet[16 + VESC_PACKET_MAX_OVERHEAD];
+        size_t n;
+        uint64_t now = 0;
+
+        payload[0] = COMM_FW_VERSION;
+        n = vescEncodePacket(payload, 1, packet);
+        emulator.receive(packet, n, now);
+        payload[0] = COMM_ALIVE;
+        n = vescEncodePacket(payload, 1, packet);
+        emulator.receive(packet, n, now);
+        payload[0] = COMM_PING_CAN;
+        n = vescEncodePacket(payload, 1, packet);
+        emulator.receive(packet, n, now);
+
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < TICKS; i++) {
+            now = (uint64_t)i * 20000;
+            size_t length = encodeValuesSelectiveRequest(VALUES_FIELD_V_IN | VALUES_FIELD_RPM, payload);
+            n = vescEncodePacket(payload, length, packet);
+            emulator.receive(packet, n, now);
+
+            uint8_t command = COMM_GET_VALUES;
+            length = encodeForwardCan(i % 2 ? 1 : 7, &command, 1, payload);   // id 7 is not on the bus
+            n = vescEncodePacket(payload, length, packet);
+            emulator.receive(packet, n, now);
+            emulator.poll(now);
+        }
+        emulator.poll(UINT64_MAX);
+        double seconds = secondsSince(start);
+
+        uint32_t requests = 3 + 2 * TICKS;
+        check(emulator.requests() == requests, "emulator request count");
+        check(emulator.replies() + emulator.dropped() == 3 + TICKS + TICKS / 2, "emulator answers known ids only");
+        check(replies.fw + replies.alive + (replies.pinged >= 0) + replies.values + replies.selective ==
+              emulator.replies() &&
+              replies.decoded && framer.crcErrorCount() == 0, "emulator replies decode");
+        check(replies.fromCan == replies.values && client.largestChunk <= config.mtu, "emulator CAN and MTU");
+        if (pass == 0) {
+            check(emulator.dropped() == 0 && replies.pinged == 1 && replies.canIds[0] == 1, "emulator clean link");
+            printf("emulator         %8.0f requests/s  (%u chunks)\n", requests / seconds, client.chunks);
+            result("emulator", requests / seconds, "requests/s");
+        } else {
+            check(emulator.dropped() > requests / 20 && emulator.dropped() < requests / 5, "emulator drop rate");
+        }
+    }
+}
+
+static void benchLinkQuality() {
+    // Counters over windows of 20 requests: clean, then half lost, then
+    // clean again; the level drops at once and climbs one step per
+    // RECOVER_WINDOWS clean windows
+    LinkQuality quality;
+    LinkCounters counters = { 0, 0, 0, 0, 40, -60 };
+    quality.update(counters);
+    counters.replies += 20;
+    counters.frames += 20;
+    check(quality.update(counters) == LinkQuality::LINK_GOOD && quality.score() == 100, "link quality clean");
+
+    counters.replies += 10;
+    counters.timeouts += 10;
+    counters.frames += 10;
+    check(quality.update(counters) == LinkQuality::LINK_POOR && quality.pollSlowdown() == 4, "link quality lossy");
+
+    int windows = 0;
+    while (quality.level() != LinkQuality::LINK_GOOD && windows < 20) {
+        counters.replies += 20;
+        counters.frames += 20;
+        quality.update(counters);
+        windows++;
+    }
+    check(windows == 2 * LinkQuality::RECOVER_WINDOWS, "link quality recovers step by step");
+
+    counters.rssi = -80;
+    counters.replies += 20;
+    counters.frames += 20;
+    check(quality.update(counters) == LinkQuality::LINK_DEGRADED, "link quality weak RSSI");
+
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < FRAMES; i++) {
+        counters.replies += 20 - (i & 7);
+        counters.timeouts += i & 7;
+        counters.frames += 20;
+        counters.crcErrors += i & 1;
+        sink += quality.update(counters);
+    }
+    double seconds = secondsSince(start);
+    printf("link quality     %8.1f Mupdates/s\n", FRAMES / seconds / 1e6);
+    result("linkQuality", FRAMES / seconds / 1e6, "Mupdates/s");
+}
+
+static void benchGps() {
+    // GGA then RMC, split mid-sentence; the RMC starts at byte 67, 37
+    // bytes into the second piece at 100 us a byte
+    static const char nmea[] =
+        "$GPGGA,123519,4807.038,N,01131.000,E,1,08,0.9,545.4,M,46.9,M,,*47\r\n"
+        "$GPRMC,123519,A,4807.038,N,01131.000,E,022.4,084.4,230394,003.1,W*6A\r\n";
+    GpsParser parser;
+    bool first = parser.feed((const uint8_t*)nmea, 30, 1000, 100);
+    bool second = parser.feed((const uint8_t*)nmea + 30, sizeof(nmea) - 1 - 30, 5000, 100);
+    const GpsFix& fix = parser.fix();
+    check(!first && second && fix.fix == GPS_FIX_3D && fix.latitude == 481173000 && fix.longitude == 115166667 &&
+          fix.speed == 415 && fix.course == 8440 && fix.satellites == 8 && fix.altitude == 5454 &&
+          fix.utcMs == 45319000 && parser.fixTimeUs() == 5000 + 37 * 100, "gps NMEA fix");
+
+    uint8_t corrupt[sizeof(nmea)];
+    memcpy(corrupt, nmea, sizeof(nmea));
+    corrupt[100] ^= 1;
+    GpsParser bad;
+    check(!bad.feed(corrupt, sizeof(nmea) - 1) && bad.checksumErrors() == 1, "gps NMEA checksum");
+
+    // UBX NAV-PVT with the same position and speed, after a false sync
+    uint8_t ubx[6 + 6 + 92 + 2] = { 0x00, 'x', 0xB5, 0x61, 0x00, 0x00, 0xB5, 0x62 };
+    uint8_t* message = ubx + 6;
+    message[2] = 0x01;
+    message[3] = 0x07;
+    message[4] = 92;
+    uint8_t* pvt = message + 6;
+    pvt[8] = 12;
+    pvt[9] = 35;
+    pvt[10] = 19;
+    pvt[20] = 3;
+    pvt[21] = 0x01;
+    pvt[23] = 9;
+    int32_t lon = 115166667, lat = 481173000, height = 545400, speed = 11520;
+    memcpy(pvt + 24, &lon, 4);     // Little-endian on the host too
+    memcpy(pvt + 28, &lat, 4);
+    memcpy(pvt + 36, &height, 4);
+    memcpy(pvt + 60, &speed, 4);
+    uint8_t a = 0, b = 0;
+    for (size_t i = 2; i < 6 + 92; i++) {
+        a += message[i];
+        b += a;
+    }
+    message[6 + 92] = a;
+    message[6 + 92 + 1] = b;
+    GpsParser ubxParser;
+    check(ubxParser.feed(ubx, sizeof(ubx)) && ubxParser.fix().fix == GPS_FIX_3D &&
+          ubxParser.fix().latitude == lat && ubxParser.fix().speed == 415 && ubxParser.fix().satellites == 9 &&
+          ubxParser.fix().altitude == 5454 && ubxParser.fix().utcMs == 45319000, "gps UBX NAV-PVT");
+
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < FRAMES / 10; i++) sink += parser.feed((const uint8_t*)nmea, sizeof(nmea) - 1);
+    double seconds = secondsSince(start);
+    printf("gps NMEA         %8.1f ns/byte\n", seconds * 1e9 / (FRAMES / 10) / (sizeof(nmea) - 1));
+    result("gpsNmea", seconds * 1e9 / (FRAMES / 10) / (sizeof(nmea) - 1), "ns/byte");
+}
+
+static void benchBeacon() {
+    // Flags, then a status beacon for company 0xFFFF: 41.2 V, FET 35.5 °C,
+    // motor -2.0 °C, fault 3
+    static const uint8_t adv[] = {
+        0x02, 0x01, 0x06,
+        0x0D, 0xFF, 0xFF, 0xFF, 'V', 0x01, 0x07, 0x9C, 0x01, 0x63, 0x01, 0xEC, 0xFF, 0x03,
+        0x05, 0x09, 'V', 'E', 'S', 'C'
+    };
+    AdvBeacon beacon;
+    check(advDecodeBeacon(adv, sizeof(adv), 0xFFFF, beacon) && beacon.sequence == 7 && beacon.vIn == 412 &&
+          beacon.tempFet == 355 && beacon.tempMotor == -20 && beacon.faultCode == 3, "beacon decode");
+    check(!advDecodeBeacon(adv, sizeof(adv), 0x1234, beacon), "beacon other company");
+    uint8_t future[sizeof(adv)];
+    memcpy(future, adv, sizeof(adv));
+    future[8] = 0x02;
+    check(!advDecodeBeacon(future, sizeof(future), 0xFFFF, beacon), "beacon unknown version");
+    check(!advDecodeBeacon(adv, 10, 0xFFFF, beacon), "beacon truncated");
+    AdvFilter filter = { 0xFFFF, false };
+    check(advMatchVesc(adv, sizeof(adv), filter) == ADV_MATCH_MANUFACTURER, "beacon listed by company id");
+
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < FRAMES; i++) sink += advDecodeBeacon(adv, sizeof(adv), 0xFFFF, beacon) + beacon.vIn;
+    double seconds = secondsSince(start);
+    printf("beacon decode    %8.1f ns/adv\n", seconds * 1e9 / FRAMES);
+    result("beaconDecode", seconds * 1e9 / FRAMES, "ns/adv");
+}
+
+// A ride-like column: slow drift with noise, a held stretch, and the
+// extremes, which only the 32-bit code can carry
+static void rideColumn(int32_t* out, uint32_t n, uint32_t seed) {
+    int32_t value = 0;
+    for (uint32_t i = 0; i < n; i++) {
+        seed = seed * 1103515245 + 12345;
+        if (i % 1000 < 200) {
+            out[i] = value;
+            continue;
+        }
+        value += (int32_t)((seed >> 16) % 41) - 20;
+        out[i] = value;
+    }
+    out[n / 2] = INT32_MIN;
+    out[n / 2 + 1] = INT32_MAX;
+}
+
+static void benchSampleCodec() {
+    const uint32_t SAMPLES = 256;
+    const int BLOCKS = 4000;
+    int32_t values[SAMPLES], times[SAMPLES], decoded[SAMPLES];
+    uint8_t valueBytes[SampleEncoder::maxBytes(SAMPLES)], timeBytes[SampleEncoder::maxBytes(SAMPLES)];
+    rideColumn(values, SAMPLES, 7);
+    // 50 ms polls with a few ms of jitter, across a millis() wrap
+    uint32_t now = 0xFFFFF000u;
+    for (uint32_t i = 0; i < SAMPLES; i++) {
+        now += 50 + (i % 7 == 0 ? 3 : 0);
+        times[i] = (int32_t)now;
+    }
+
+    SampleEncoder valueColumn, timeColumn;
+    valueColumn.begin(SAMPLE_DELTA, valueBytes, sizeof(valueBytes));
+    timeColumn.begin(SAMPLE_DELTA_OF_DELTA, timeBytes, sizeof(timeBytes));
+    for (uint32_t i = 0; i < SAMPLES; i++) {
+        valueColumn.add(values[i]);
+        timeColumn.add(times[i]);
+    }
+    SampleDecoder valueReader(SAMPLE_DELTA, valueBytes, valueColumn.bytes());
+    SampleDecoder timeReader(SAMPLE_DELTA_OF_DELTA, timeBytes, timeColumn.bytes());
+    bool same = valueColumn.count() == SAMPLES && valueColumn.bytes() <= sizeof(valueBytes);
+    for (uint32_t i = 0; i < SAMPLES; i++) same = same && valueReader.next() == values[i];
+    for (uint32_t i = 0; i < SAMPLES; i++) same = same && timeReader.next() == times[i];
+    check(same, "sample codec round trip");
+    check(timeColumn.bytes() < SAMPLES / 2, "sample codec steady clock");
+
+    auto start = std::chrono::steady_clock::now();
+    size_t packed = 0;
+    for (int b = 0; b < BLOCKS; b++) {
+        values[b % SAMPLES] += b;
+        valueColumn.begin(SAMPLE_DELTA, valueBytes, sizeof(valueBytes));
+        for (uint32_t i = 0; i < SAMPLES; i++) valueColumn.add(values[i]);
+        SampleDecoder reader(SAMPLE_DELTA, valueBytes, valueColumn.bytes());
+        for (uint32_t i = 0; i < SAMPLES; i++) decoded[i] = reader.next();
+        sink += decoded[b % SAMPLES];
+        packed += valueColumn.bytes();
+    }
+    double seconds = secondsSince(start);
+    printf("sample codec     %8.1f ns/sample (%.1f bits/sample)\n", seconds * 1e9 / BLOCKS / SAMPLES,
+           packed * 8.0 / BLOCKS / SAMPLES);
+    result("sampleCodec", seconds * 1e9 / BLOCKS / SAMPLES, "ns/sample");
+}
+
+// Converting and printing a value the way a page does: checked against
+// printf and the exact conversions, then timed in miles and °F
+static void benchFormat() {
+    const int VALUES = 2000000;
+    const int32_t samples[] = { 0, 5, -5, 481, -1234, 99999, -2147483647 - 1, 2147483647 };
+    bool same = true;
+    char text[16], expected[24];
+    for (int32_t value : samples) {
+        for (uint8_t decimals = 0; decimals <= 3; decimals++) {
+            formatFixed(text, sizeof(text), value, decimals);
+            int64_t magnitude = value < 0 ? -(int64_t)value : value;
+            int64_t divisor = decimals == 0 ? 1 : decimals == 1 ? 10 : decimals == 2 ? 100 : 1000;
+            if (decimals == 0) {
+                snprintf(expected, sizeof(expected), "%s%lld", value < 0 ? "-" : "", (long long)magnitude);
+            } else {
+                snprintf(expected, sizeof(expected), "%s%lld.%0*lld", value < 0 ? "-" : "",
+                         (long long)(magnitude / divisor), (int)decimals, (long long)(magnitude % divisor));
+            }
+            same = same && strcmp(text, expected) == 0;
+        }
+    }
+    char small[4];
+    same = same && formatFixed(small, sizeof(small), -1234, 1) == 6 && strcmp(small, "-12") == 0;
+    check(same, "fixed-point formatting");
+
+    UnitSettings imperial = { true, true };
+    unitsConfigure(imperial);
+    bool converted = true;
+    for (int32_t deciC = -400; deciC <= 2000; deciC++) {
+        converted = converted && unitsConvert(UNIT_TEMPERATURE, deciC) == deciCelsiusToDeciFahrenheit(deciC);
+    }
+    converted = converted && unitsConvert(UNIT_SPEED, 1000) == 621 && unitsConvert(UNIT_SPEED, -1000) == -621;
+    converted = converted && unitsConvert(UNIT_DISTANCE, 160934) == 100000;    // 0.01 km
+    converted = converted && unitsConvert(UNIT_PER_DISTANCE, 200) == 322;      // 0.1 Wh/km
+    converted = converted && unitsConvert(UNIT_NONE, 481) == 481 && strcmp(unitsName(UNIT_SPEED), "mph") == 0;
+    check(converted, "unit conversions");
+
+    auto start = std::chrono::steady_clock::now();
+    size_t length = 0;
+    for (int i = 0; i < VALUES; i++) {
+        length += formatFixed(text, sizeof(text), unitsConvert((UnitKind)(1 + i % 4), i * 7 - 500000), 1);
+    }
+    double seconds = secondsSince(start);
+    sink += (uint32_t)length;
+    UnitSettings metric = { false, false };
+    unitsConfigure(metric);
+    converted = unitsConvert(UNIT_SPEED, 1000) == 1000 && strcmp(unitsName(UNIT_SPEED), "km/h") == 0;
+    check(converted, "metric units leave values alone");
+    printf("unit format      %8.1f ns/value\n", seconds * 1e9 / VALUES);
+    result("unitFormat", seconds * 1e9 / VALUES, "ns/value");
+}
+
+static int replayFiles(int argc, char** argv) {
+    bool realtime = false;
+    int failed = 0;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--realtime") == 0) {
+            realtime = true;
+            continue;
+        }
+
+        FILE* file = fopen(argv[i], "rb");
+        if (!file) {
+            printf("%s: cannot open\n", argv[i]);
+            failed++;
+            continue;
+        }
+        std::vector<uint8_t> data;
+        uint8_t block[4096];
+        size_t n;
+        while ((n = fread(block, 1, sizeof(block), file)) > 0) {
+            data.insert(data.end(), block, block + n);
+        }
+        fclose(file);
+
+        ReplayReport r;
+        if (!replayCapture(data.data(), data.size(), realtime, hostClock, hostSleep, r)) {
+            printf("%s: not a capture\n", argv[i]);
+            failed++;
+            continue;
+        }
+        printf("%s: %u chunks, %u bytes, %u frames, %u crc, %u resyncs, %u discarded, "
+               "%u decoded, %u failed, digests %08X/%08X, %.1f ms (%.1f ms recorded)\n",
+               argv[i], r.chunks, r.bytes, r.frames, r.crcErrors, r.resyncs, r.bytesDiscarded,
+               r.valuesDecoded, r.decodeFailures, r.frameDigest, r.valuesDigest,
+               r.elapsedUs / 1000.0, r.captureUs / 1000.0);
+    }
+    return failed ? 1 : 0;
+}
+
+static uint32_t dispatched = 0;
+
+static void countDispatched(uint8_t link, const uint8_t* payload, size_t length) {
+    dispatched += link + length;
+}
+
+static void benchDispatch() {
+    VescDispatcher dispatcher;
+    dispatcher.on(COMM_GET_VALUES, countDispatched);
+    uint8_t values[] = { COMM_GET_VALUES, 0, 0 };
+    uint8_t unknown[] = { 0xEE };
+    check(dispatcher.dispatch(1, values, sizeof(values)) && dispatched == 4 &&
+          !dispatcher.dispatch(0, unknown, sizeof(unknown)) && dispatcher.unhandledCount() == 1 &&
+          dispatcher.lastUnhandled() == 0xEE, "dispatch routing");
+
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < FRAMES; i++) dispatcher.dispatch(0, values, sizeof(values));
+    double seconds = secondsSince(start);
+    sink = dispatched;
+    printf("dispatch         %8.1f ns/frame\n", seconds * 1e9 / FRAMES);
+    result("dispatch", seconds * 1e9 / FRAMES, "ns/frame");
+}
+
+// CAN frames from the dashboard's side go straight to the VESC's, and
+// back; the last payload each side received is kept
+struct CanBusEnd {
+    VescCanBuffer* peer;
+    uint32_t frames;
+    uint8_t payload[VescCanBuffer::MAX_PAYLOAD];
+    size_t length;
+};
+
+static bool deliverCanFrame(uint32_t id, const uint8_t* data, uint8_t length, void* context) {
+    CanBusEnd* end = (CanBusEnd*)context;
+    end->frames++;
+    end->peer->onFrame(id, data, length);
+    return true;
+}
+
+static void keepCanPayload(const uint8_t* payload, size_t length, void* context) {
+    CanBusEnd* end = (CanBusEnd*)context;
+    memcpy(end->payload, payload, length);
+    end->length = length;
+}
+
+static void benchCanBuffer() {
+    static CanBusEnd dashboardEnd, vescEnd;
+    VescCanBuffer dashboard(254, deliverCanFrame, keepCanPayload, &dashboardEnd);
+    VescCanBuffer vesc(0, deliverCanFrame, keepCanPayload, &vescEnd);
+    dashboardEnd.peer = &vesc;
+    vescEnd.peer = &dashboard;
+
+    uint8_t shortRequest[] = { COMM_FW_VERSION };
+    dashboard.send(0, shortRequest, sizeof(shortRequest));
+    check(dashboardEnd.frames == 1 && vescEnd.length == 1 && vescEnd.payload[0] == COMM_FW_VERSION,
+          "CAN short buffer");
+
+    // Past offset 255, so the long fill frames are used too
+    uint8_t reply[300];
+    for (size_t i = 0; i < sizeof(reply); i++) reply[i] = (uint8_t)(i * 7 + 1);
+    vesc.send(254, reply, sizeof(reply));
+    check(vescEnd.frames == VescCanBuffer::framesFor(sizeof(reply)) && dashboardEnd.length == sizeof(reply) &&
+          memcmp(dashboardEnd.payload, reply, sizeof(reply)) == 0 && dashboard.payloadsReceived() == 1,
+          "CAN buffer round trip");
+
+    // Not for us, and a corrupt buffer
+    uint8_t status[8] = {};
+    dashboard.onFrame(9u << 8 | 0, status, 8);
+    uint8_t process[] = { 0, 1, 0, 8, 0, 0 };
+    dashboard.onFrame((uint32_t)VescCanBuffer::CAN_PACKET_PROCESS_RX_BUFFER << 8 | 254, process, sizeof(process));
+    check(dashboard.payloadsReceived() == 1 && dashboard.crcErrors() == 1, "CAN buffer rejects");
+}
+
+// Two readers of one ring, one keeping up and one lapped
+static void checkBroadcastRing() {
+    static BroadcastRing<uint32_t, 8> ring;
+    BroadcastCursor fast, slow;
+    ring.subscribe(fast);
+    ring.subscribe(slow);
+    bool inOrder = true;
+    uint32_t value;
+    for (uint32_t i = 0; i < 20; i++) {
+        ring.publish(i);
+        if (!ring.read(fast, value) || value != i) inOrder = false;
+    }
+    check(inOrder && fast.missed == 0 && !ring.read(fast, value), "broadcast ring reader keeping up");
+
+    // 20 published into 8 slots: the oldest 7 still safe to read are left
+    uint32_t first = 0;
+    uint32_t count = 0;
+    while (ring.read(slow, value)) {
+        if (count++ == 0) first = value;
+    }
+    check(slow.missed == 13 && first == 13 && count == 7 && slow.next == 20, "broadcast ring overrun");
+}
+
+// Deadbands: jitter is not a change, a drift that adds up to one is
+static void checkChangeTracker() {
+    ValuesChangeTracker tracker;
+    VescValues values = {};
+    values.fields = VALUES_FIELD_RPM | VALUES_FIELD_TEMP_FET | VALUES_FIELD_FAULT;
+    values.rpm = 1000;
+    bool first = tracker.update(values) == values.fields;
+
+    bool jitter = true;
+    for (int i = 0; i < 10; i++) {
+        values.rpm = 1000 + (i & 1 ? 15 : -15);
+        if (tracker.update(values) != 0) jitter = false;
+    }
+    uint32_t drift = 0;
+    for (int i = 1; i <= 3; i++) {
+        values.tempFet = (int16_t)i;
+        drift |= tracker.update(values);
+    }
+    values.faultCode = 1;
+    bool fault = tracker.update(values) == VALUES_FIELD_FAULT;
+    check(first && jitter && drift == VALUES_FIELD_TEMP_FET && fault, "change tracker deadbands");
+}
+
+// A median that drops a spike, and an EMA that settles on a step
+static void checkValuesFilter() {
+    const ValuesFilterStage stages[] = {
+        { VALUES_BIT_CURRENT_IN, FILTER_MEDIAN5, 0 },
+        { VALUES_BIT_V_IN, FILTER_EMA, 2 },
+        { VALUES_BIT_TACHOMETER, FILTER_EMA, 2 },   // A counter: refused
+    };
+    ValuesFilter filter;
+    filter.configure(stages, 3);
+    VescValues values = {};
+    values.fields = VALUES_FIELD_CURRENT_IN | VALUES_FIELD_V_IN | VALUES_FIELD_TACHOMETER;
+    const int32_t currents[] = { 100, 102, 5000, 101, 99 };
+    bool spike = true;
+    int16_t voltage = 0;
+    for (int i = 0; i < 40; i++) {
+        values.currentIn = currents[i % 5];
+        values.vIn = i == 0 ? 400 : 500;
+        values.tachometer = i;
+        filter.apply(values);
+        if (values.currentIn > 102) spike = false;
+        if (i == 1) voltage = values.vIn;
+        if (values.tachometer != i) spike = false;
+    }
+    check(spike && voltage == 425 && values.vIn == 500, "values filter median and EMA");
+}
+
+// Status broadcasts, encoded and gathered into one sample
+static void checkCanStatus() {
+    VescValues sent = {};
+    sent.rpm = -12345;
+    sent.currentMotor = 4210;
+    sent.dutyNow = 512;
+    sent.wattHours = 98765;
+    sent.tempFet = 412;
+    sent.currentIn = -350;
+    sent.pidPos = 180000000;
+    sent.tachometer = 424242;
+    sent.vIn = 503;
+
+    VescValues got = {};
+    uint32_t fields = 0;
+    const uint8_t types[] = { CAN_PACKET_STATUS, CAN_PACKET_STATUS_3, CAN_PACKET_STATUS_4, CAN_PACKET_STATUS_5 };
+    for (uint8_t type : types) {
+        uint32_t id = 0;
+        uint8_t data[8];
+        uint8_t length = encodeCanStatus(type, 17, sent, id, data);
+        fields |= decodeCanStatus(id, data, length, got);
+    }
+    check(fields == (canStatusFields(CAN_PACKET_STATUS) | canStatusFields(CAN_PACKET_STATUS_3) |
+                     canStatusFields(CAN_PACKET_STATUS_4) | canStatusFields(CAN_PACKET_STATUS_5)) &&
+          got.rpm == sent.rpm && got.currentMotor == sent.currentMotor && got.dutyNow == sent.dutyNow &&
+          got.wattHours == sent.wattHours && got.tempFet == sent.tempFet && got.currentIn == sent.currentIn &&
+          got.pidPos == sent.pidPos && got.tachometer == sent.tachometer && got.vIn == sent.vIn &&
+          got.controllerId == 17 && (got.fields & VALUES_FIELD_CONTROLLER_ID),
+          "CAN status round trip");
+
+    // Buffer traffic and short frames are not status
+    uint8_t data[8] = {};
+    check(!isCanStatus((uint32_t)VescCanBuffer::CAN_PACKET_PROCESS_SHORT_BUFFER << 8 | 17) &&
+          isCanStatus((uint32_t)CAN_PACKET_STATUS_6 << 8 | 17) &&
+          decodeCanStatus((uint32_t)CAN_PACKET_STATUS << 8 | 17, data, 6, got) == 0 &&
+          decodeCanStatus((uint32_t)CAN_PACKET_STATUS_6 << 8 | 17, data, 8, got) == 0,
+          "CAN status rejects");
+}
+
+// A BMS reading through the reply encoder and back
+static void checkBms() {
+    VescBmsValues sent = {};
+    sent.packMv = 49512;
+    sent.chargeMv = 0;
+    sent.currentMa = -12340;
+    sent.ampHoursMah = 2150;
+    sent.wattHoursMwh = 101234;
+    sent.cellCount = 13;
+    for (uint8_t c = 0; c < sent.cellCount; c++) sent.cellMv[c] = (uint16_t)(3800 + c * 3);
+    sent.cellMv[4] = 3702;
+    sent.balancing = 1u << 12;
+    sent.tempCount = 2;
+    sent.temps[0] = 251;
+    sent.temps[1] = -53;
+    sent.tempIc = 312;
+    sent.tempCellMax = 288;
+    sent.soc = 734;
+    sent.soh = 990;
+    sent.canId = 10;
+
+    uint8_t payload[VESC_BMS_MAX_REPLY_SIZE];
+    size_t length = encodeBmsValues(sent, payload);
+    VescBmsValues got;
+    bool decoded = decodeBmsValues(payload, length, got);
+    check(decoded && got.packMv == sent.packMv && got.currentMa == sent.currentMa &&
+          got.ampHoursMah == sent.ampHoursMah && got.wattHoursMwh == sent.wattHoursMwh &&
+          got.cellCount == 13 && memcmp(got.cellMv, sent.cellMv, 13 * sizeof(got.cellMv[0])) == 0 &&
+          got.balancing == sent.balancing && got.tempCount == 2 && got.temps[1] == -53 &&
+          got.tempIc == 312 && got.tempCellMax == 288 && got.soc == 734 && got.soh == 990 && got.canId == 10 &&
+          got.minCell == 4 && got.maxCell == 12, "BMS values round trip");
+    check(!decodeBmsValues(payload, length - 1, got) && !decodeBmsValues(payload, 20, got), "BMS values rejects");
+}
+
+// A probe burst at a UART bridge's pace, and the budget polls get from it
+static void checkThroughput() {
+    // 80-byte frames every 7 ms: the first frame's start to the last's
+    // spans five frames
+    ThroughputProbe probe;
+    probe.start(6, 0);
+    for (uint32_t i = 0; i < 6; i++) probe.onFrame(80, 100000 + i * 7000);
+    bool finished = probe.update(60, 1000);
+    check(finished && !probe.active() && probe.bytesPerSecond() == 11428, "throughput probe rate");
+    probe.start(6, 0);
+    probe.onFrame(80, 1000);
+    check(!probe.update(500, 1000) && probe.update(1000, 1000) && probe.bytesPerSecond() == 0,
+          "throughput probe timeout");
+
+    // 1000 B/s with a 100 ms burst: 100 bytes, refilled at 1 byte a ms
+    ThroughputBudget budget(100);
+    check(budget.fits(10000, 0) && budget.periodFor(50) == 0, "throughput budget unlimited");
+    budget.setRate(1000, 0);
+    bool first = budget.fits(90, 0);
+    budget.spend(90);
+    check(first && !budget.fits(90, 10) && !budget.fits(90, 79) && budget.fits(90, 80) &&
+          budget.periodFor(50) == 50, "throughput budget pacing");
+}
+
+// A forwarded controller's currents read back on the primary's clock
+static void checkTimeAlign() {
+    SampleTrack track;
+    VescValues values = {};
+    values.fields = VALUES_FIELD_CURRENT_IN | VALUES_FIELD_CURRENT_MOTOR;
+    values.currentIn = 1000;
+    values.currentMotor = -200;
+    track.add(10000, values);
+    values.currentIn = 2000;
+    values.currentMotor = 200;
+    track.add(60000, values);
+    VescValues temps = {};
+    temps.fields = VALUES_FIELD_TEMP_FET;
+    track.add(70000, temps);
+
+    VescValues out = {};
+    bool between = track.at(20000, 100000, out) && out.currentIn == 1200 && out.currentMotor == -120;
+    check(between && track.size() == 2 && track.reached(60000) && !track.reached(60001), "align interpolates");
+
+    // Past the newest within the window it is held; beyond, nothing
+    out = VescValues();
+    bool held = track.at(90000, 50000, out) && out.currentIn == 2000;
+    out.currentIn = 7;
+    bool far = !track.at(200000, 50000, out) && out.currentIn == 7;
+    // Samples further apart than the window are not interpolated across
+    bool nearer = track.at(50000, 40000, out) && out.currentIn == 2000;
+    check(held && far && nearer, "align window");
+
+    // An old sample is left out; the ring keeps the newest DEPTH
+    track.add(5000, values);
+    for (uint32_t i = 0; i < SampleTrack::DEPTH; i++) {
+        values.currentIn = 3000 + i;
+        track.add(100000 + i * 50000, values);
+    }
+    check(track.size() == SampleTrack::DEPTH && !track.at(60000, 10000, out) && track.at(125000, 50000, out) &&
+          out.currentIn == 3000, "align ring");
+}
+
+// A saturated link slows the low priorities first and the critical last
+static void checkPollPriorities() {
+    // Power 400 B/s, temperatures 10 B/s, energy 100 B/s, and 200 B/s of
+    // request framing at the power rate
+    PollSchedule schedule(0);
+    int power = schedule.add(0x01, 50, POLL_CRITICAL);
+    int temps = schedule.add(0x02, 1000, POLL_NORMAL);
+    int energy = schedule.add(0x04, 1000, POLL_LOW);
+    schedule.setCost(power, 20);
+    schedule.setCost(temps, 10);
+    schedule.setCost(energy, 100);
+    schedule.fit(0, 10);
+    bool unlimited = schedule.slowedFields() == 0;
+    schedule.fit(2000, 10);
+    check(unlimited && schedule.slowedFields() == 0, "poll fit keeps rates that fit");
+
+    // 40 B/s left for energy: polled every third period
+    schedule.fit(650, 10);
+    schedule.restart(0);
+    schedule.markSent(0x07, 0);
+    check(schedule.slowedFields() == 0x04 && schedule.period(energy) == 1000 && (schedule.due(1000) & 0x06) == 0x02 &&
+          (schedule.due(3000) & 0x06) == 0x06, "poll fit slows the low priority first");
+
+    // Not even power fits: it is slowed to what there is, the rest as far as they go
+    schedule.fit(300, 10);
+    schedule.restart(0);
+    schedule.markSent(0x07, 0);
+    check(schedule.slowedFields() == 0x07 && schedule.due(199) == 0 && schedule.due(200) == 0x01 &&
+          (schedule.due(15999) & 0x06) == 0 && (schedule.due(16000) & 0x06) == 0x06,
+          "poll fit stretch cap");
+}
+
+// Fresh fields are left out until age plus the round trip reaches the TTL
+static void checkValuesCache() {
+    uint32_t ttl[VALUES_FIELD_COUNT] = {};
+    ttl[VALUES_BIT_TEMP_FET] = 750;
+    ttl[VALUES_BIT_TEMP_MOTOR] = 750;
+    ValuesCache cache;
+    uint32_t temps = VALUES_FIELD_TEMP_FET | VALUES_FIELD_TEMP_MOTOR;
+    check(cache.fresh(temps, ttl, 40, 0) == 0 && cache.ageMs(VALUES_BIT_TEMP_FET, 0) == UINT32_MAX,
+          "values cache empty");
+    cache.note(VALUES_MASK_POWER | VALUES_FIELD_TEMP_FET, 1000);
+    check(cache.fresh(temps | VALUES_MASK_POWER, ttl, 40, 1709) == VALUES_FIELD_TEMP_FET &&
+          cache.fresh(temps, ttl, 40, 1710) == 0 && cache.ageMs(VALUES_BIT_TEMP_FET, 1500) == 500,
+          "values cache TTL");
+    cache.clear();
+    check(cache.fresh(temps, ttl, 0, 1001) == 0, "values cache clear");
+}
+
+static void checkLaps() {
+    LapConfig config = { true, 10, 1000 };
+    LapTimer laps;
+    laps.configure(config);
+    VescValues v = VescValues();
+    v.fields = VALUES_FIELD_GPS | VALUES_FIELD_WATT_HOURS | VALUES_FIELD_WATT_HOURS_CHARGED | VALUES_FIELD_CURRENT_IN;
+    v.gpsLatitude = 473000000;
+    v.gpsLongitude = 85000000;
+    v.wattHours = 1000;
+    laps.add(v, 0, 0);
+    laps.mark(0, 10);
+    check(laps.running() && laps.hasLine() && laps.count() == 0, "laps start line placed");
+
+    // Out past twice the radius (3000 is 33 m north), then back in
+    v.gpsLatitude += 3000;
+    v.wattHours = 1400;
+    v.currentIn = 2500;
+    bool early = laps.add(v, 2000, 50);
+    v.gpsLatitude -= 2500;
+    v.wattHours = 1500;
+    v.wattHoursCharged = 100;
+    v.currentIn = 1000;
+    v.gpsAge = 50;
+    bool crossed = laps.add(v, 5000, 90);
+    const LapRecord& lap = laps.completed(0);
+    check(!early && crossed && laps.count() == 1 && lap.number == 1 && lap.durationMs == 4950 &&
+          lap.historyStart == 10 && lap.historyCount == 80 && lap.energy == 400 && lap.maxCurrentIn == 2500,
+          "laps GPS crossing");
+    check(laps.current().number == 2 && laps.current().startMs == 4950 && laps.current().energy == 0,
+          "laps next lap");
+
+    // Still inside the circle: no second lap until it has been out again
+    check(!laps.add(v, 7000, 100), "laps stay in the circle");
+    laps.mark(8000, 120);
+    check(laps.count() == 2 && laps.completed(0).durationMs == 3050 && laps.best() == 0, "laps manual mark");
+    laps.reset();
+    check(!laps.running() && !laps.hasLine() && laps.count() == 0 && laps.best() == -1, "laps reset");
+}
+
+// A bridge heating at 0.003 °C/s per (10 A)² and cooling to 25 °C with
+// a 200 s time constant, read at 1 Hz to 0.1 °C, under a load that steps
+// between 20 and 80 A; then held at 80 A to see the prediction come true
+static void checkThermal() {
+    const float heating = 0.3f, cooling = 1.0f / 200, ambient = 25;
+    ThermalConfig config = { 0.999f, 60, 10000 };
+    ThermalModel model;
+    model.configure(config);
+    float temperature = ambient;
+    uint32_t timeMs = 0;
+    int32_t predicted = -2;
+    uint32_t predictedAtMs = 0, reachedMs = 0;
+    for (uint32_t second = 0; second < 1200; second++) {
+        float amps = second < 600 ? ((second / 40) % 2 ? 80.0f : 20.0f) : 80.0f;
+        for (int i = 0; i < 10; i++) {
+            float load = (amps / 100) * (amps / 100);
+            temperature += (heating * load - cooling * (temperature - ambient)) * 0.1f;
+            timeMs += 100;
+            model.addCurrent((int32_t)(amps * 100), timeMs);
+        }
+        model.addTemperature((int16_t)(temperature * 10), timeMs);
+        if (second == 630) {
+            predicted = model.secondsTo(550);
+            predictedAtMs = timeMs;
+        }
+        if (reachedMs == 0 && temperature >= 55) reachedMs = timeMs;
+    }
+    int32_t actual = (int32_t)(reachedMs - predictedAtMs) / 1000;
+    check(model.fitted() && model.cooling() > 0.7f * cooling && model.cooling() < 1.3f * cooling,
+          "thermal model fits cooling");
+    check(predicted > 0 && predicted > actual * 8 / 10 && predicted < actual * 12 / 10, "thermal model predicts limit");
+    check(model.secondsTo(900) == ThermalModel::NEVER && model.secondsTo(300) == 0, "thermal model out of reach");
+
+    ThermalModel fresh;
+    fresh.addTemperature(300, 0);
+    check(!fresh.fitted() && fresh.secondsTo(400) == ThermalModel::NEVER, "thermal model unfitted");
+
+    // The limits after the battery cutoff, through the emulator's encoder
+    VescConfig sent = { 6000, -6000, 3000, -1500, 15000, 300, 570, 420, 400, 850, 1000, 900, 1100, 0, 0 };
+    VescFirmware fw = { 6, 2 };
+    uint8_t payload[VESC_CONFIG_MAX_REPLY_SIZE];
+    size_t length = encodeMcconf(sent, fw, payload);
+    VescConfig got = VescConfig();
+    bool decoded = decodeMcconf(payload, length, fw, got);
+    check(length <= sizeof(payload) && decoded && got.tempFetStart == 850 && got.tempFetEnd == 1000 &&
+          got.tempMotorStart == 900 && got.tempMotorEnd == 1100, "mcconf temperature limits");
+    VescConfig shortReply = VescConfig();
+    check(decodeMcconf(payload, length - 16, fw, shortReply) && shortReply.tempFetStart == 0 &&
+          shortReply.batteryCutEnd == 400, "mcconf without temperature limits");
+}
+
+static void checkFormulas() {
+    FormulaSet set;
+    const char* error = nullptr;
+    check(set.add("power_kw = v_in * current_in / 1000", error) &&
+          set.add("per_kw = max(power_kw, 0.5) * -2 + abs(-(1 + 2)) / 0", error), "formulas compile");
+    check(set.fields() == (VALUES_FIELD_V_IN | VALUES_FIELD_CURRENT_IN), "formula fields");
+
+    VescValues v = VescValues();
+    v.vIn = 500;                 // 50.0 V
+    v.currentIn = 2000;          // 20.00 A
+    set.evaluate(v);
+    check((v.fields & VALUES_FIELD_FORMULA) && v.formula[0] == 1000 && v.formula[1] == -2000, "formula results");
+
+    const char* bad[] = { "x = v_in +", "x = nope * 2", "v_in = 1", "x = (1 + 2", "x = 1 2",
+                          "x = 1+(1+(1+(1+(1+(1+(1+(1+(1+1))))))))" };
+    for (const char* line : bad) {
+        FormulaSet one;
+        error = nullptr;
+        check(!one.add(line, error) && error != nullptr && one.count() == 0, line);
+    }
+
+    const char file[] = "# custom fields\n\nwatts = v_in * current_in\r\nhalf = watts / 2\nthird = 1\n";
+    FormulaSet parsed;
+    uint16_t line = 0;
+    check(!parsed.parse(file, sizeof(file) - 1, line, error) && line == 5 && parsed.count() == 2 &&
+          strcmp(parsed.name(1), "half") == 0, "formulas file");
+
+    const int SAMPLES = 1000000;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < SAMPLES; i++) {
+        v.currentIn = i & 0xFFFF;
+        set.evaluate(v);
+        sink += (uint32_t)v.formula[1];
+    }
+    double seconds = secondsSince(start);
+    result("formulas", seconds * 1e9 / SAMPLES, "ns/sample");
+    printf("formulas         %8.1f ns/sample (2 formulas, %d code bytes at most each)\n", seconds * 1e9 / SAMPLES,
+           FormulaSet::MAX_CODE);
+}
+
+// Rates in rad/s and accelerations in g, as the MPU6886 gives them
+static void checkAttitude() {
+    const float DEG = 0.0174533f;
+    const float DT = 0.01f;
+
+    AttitudeFilter level(1.0f, 0.02f, 0.15f);
+    level.update(0, 0, 0, sinf(10 * DEG), 0, cosf(10 * DEG), DT);
+    check(fabsf(level.pitch() - 10) < 0.1f && fabsf(level.roll()) < 0.1f, "attitude starts from gravity");
+
+    // Nose up at 20 degrees a second for a second, through a push the
+    // gate keeps out of the correction
+    AttitudeFilter turning(1.0f, 0.0f, 0.15f);
+    turning.update(0, 0, 0, 0, 0, 1, DT);
+    for (int i = 0; i < 100; i++) turning.update(0, -20 * DEG, 0, 0.8f, 0, 1, DT);
+    check(fabsf(turning.pitch() - 20) < 0.5f, "attitude follows the gyro");
+
+    // A gyro bias of 2 degrees a second is learned away
+    AttitudeFilter drifting(1.0f, 0.05f, 0.15f);
+    for (int i = 0; i < 6000; i++) drifting.update(2 * DEG, 0, 0, 0, sinf(5 * DEG), cosf(5 * DEG), DT);
+    check(fabsf(drifting.roll() - 5) < 0.2f, "attitude cancels gyro drift");
+
+    for (int i = 0; i < 5; i++) drifting.update(0, 0, 0, 0.1f, sinf(5 * DEG), cosf(5 * DEG), DT);
+    check(fabsf(drifting.forward() - 0.1f) < 0.01f, "attitude forward acceleration");
+
+    const int SAMPLES = 1000000;
+    AttitudeFilter filter(1.0f, 0.02f, 0.15f);
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < SAMPLES; i++) {
+        float wobble = (i & 63) * 0.001f;
+        filter.update(wobble, -wobble, 0.01f, wobble, 0.02f, 1.0f - wobble, DT);
+        sink += (uint32_t)(filter.pitch() * 10);
+    }
+    double seconds = secondsSince(start);
+    result("attitude", seconds * 1e9 / SAMPLES, "ns/sample");
+    printf("attitude         %8.1f ns/sample (Mahony update and pitch)\n", seconds * 1e9 / SAMPLES);
+}
+
+static void checkLinkAnalyzer() {
+    LinkAnalyzer analyzer;
+    LinkAnalyzer::Counters c;
+    memset(&c, 0, sizeof(c));
+    analyzer.update(c, 1000);
+    check(analyzer.figures().windowMs == 0 && analyzer.figures().rttMedian == LinkAnalyzer::RTT_BUCKETS,
+          "link analyzer waits for two updates");
+
+    // Every 500 ms: 10 requests, 9 replies of two notifications of 120
+    // bytes, a timeout and a bad CRC; round trips of 20-40 ms, a few slow
+    for (int i = 1; i <= 12; i++) {
+        c.requests += 10;
+        c.replies += 9;
+        c.timeouts += 1;
+        c.frames += 9;
+        c.crcErrors += 1;
+        c.notifications += 18;
+        c.notificationBytes += 18 * 120;
+        c.rtt[1] += 5;
+        c.rtt[2] += 3;
+        c.rtt[5] += 1;
+        analyzer.update(c, 1000 + i * 500);
+    }
+    const LinkAnalyzer::Figures& f = analyzer.figures();
+    check(f.windowMs == (LinkAnalyzer::WINDOW_UPDATES - 1) * 500, "link analyzer window");
+    check(f.notificationsPerFrameX100 == 200 && f.bytesPerNotification == 120, "link analyzer fragmentation");
+    check(f.requestsPerSecondX10 == 200 && f.repliesPerSecondX10 == 180 && f.timeoutsPerSecondX10 == 20,
+          "link analyzer rates");
+    check(f.crcFailuresX100 == 1000, "link analyzer CRC failures");
+    check(f.rttCount == 72 && f.rttMedian == 1 && f.rttP90 == 5, "link analyzer RTT spread");
+    check(LinkAnalyzer::rttBucketEdge(0) == 16 && LinkAnalyzer::rttBucketEdge(6) == 1024 &&
+          LinkAnalyzer::rttBucketEdge(7) == 0, "link analyzer RTT buckets");
+
+    // A link reset starts the window over
+    memset(&c, 0, sizeof(c));
+    analyzer.update(c, 8000);
+    check(analyzer.figures().windowMs == 0, "link analyzer resets on counters going back");
+}
+
+int main(int argc, char** argv) {
+    const char* jsonPath = nullptr;
+    if (argc == 3 && strcmp(argv[1], "--json") == 0) {
+        jsonPath = argv[2];
+    } else if (argc > 1) {
+        return replayFiles(argc, argv);
+    }
+
+    benchCrc();
+    benchFramer();
+    checkEquivalence();
+    benchDecode();
+    benchDispatch();
+    benchCommands();
+    benchReplay();
+    benchEmulator();
+    benchLinkQuality();
+    benchGps();
+    benchBeacon();
+    benchCanBuffer();
+    benchSampleCodec();
+    benchFormat();
+    checkCanStatus();
+    checkBms();
+    checkThroughput();
+    checkPollPriorities();
+    checkValuesCache();
+    checkLaps();
+    checkThermal();
+    checkFormulas();
+    checkAttitude();
+    checkTimeAlign();
+    checkLinkAnalyzer();
+    checkBroadcastRing();
+    checkChangeTracker();
+    checkValuesFilter();
+    checkFirmwareUpload();
+
+    if (jsonPath && !writeResults(jsonPath)) {
+        printf("%s: cannot write\n", jsonPath);
+        failures++;
+    }
+    if (failures) {
+        printf("%d check(s) failed\n", failures);
+        return 1;
+    }
+    return 0;
+}
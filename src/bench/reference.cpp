@@ -0,0 +1,72 @@
+#include "reference.h"
+#include "../vesc/protocol.h"
+
+#include <string.h>
+
+uint16_t referenceCrc16(const uint8_t* data, size_t length) {
+    uint16_t crc = 0;
+    for (size_t i = 0; i < length; i++) {
+        crc ^= (uint16_t)(data[i] << 8);
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x1021) : (uint16_t)(crc << 1);
+        }
+    }
+    return crc;
+}
+
+uint32_t referenceDigest(uint32_t digest, const uint8_t* payload, size_t length) {
+    if (digest == 0) digest = 2166136261u;
+    for (int i = 0; i < 4; i++) {
+        digest = (digest ^ (uint8_t)(length >> (8 * i))) * 16777619u;
+    }
+    for (size_t i = 0; i < length; i++) {
+        digest = (digest ^ payload[i]) * 16777619u;
+    }
+    return digest;
+}
+
+void referenceFrame(const uint8_t* stream, size_t length, size_t maxPayload, ReferenceFrames& out) {
+    memset(&out, 0, sizeof(out));
+    size_t i = 0;
+    while (i < length) {
+        uint8_t start = stream[i];
+        if (start != VESC_PACKET_START && start != VESC_PACKET_START_LONG && start != VESC_PACKET_START_HUGE) {
+            out.discarded++;
+            i++;
+            continue;
+        }
+
+        size_t lengthBytes = start - VESC_PACKET_START + 1;
+        if (i + 1 + lengthBytes > length) break;
+        size_t payloadLength = 0;
+        for (size_t k = 0; k < lengthBytes; k++) payloadLength = payloadLength * 256 + stream[i + 1 + k];
+        if (payloadLength == 0 || payloadLength > maxPayload) {
+            if (payloadLength > maxPayload) out.oversize++;
+            out.discarded++;
+            i++;
+            continue;
+        }
+
+        const uint8_t* payload = stream + i + 1 + lengthBytes;
+        size_t frameLength = 1 + lengthBytes + payloadLength + 3;
+        if (i + frameLength > length) break;
+        if (stream[i + frameLength - 1] != VESC_PACKET_STOP) {
+            out.stopErrors++;
+            out.discarded++;
+            i++;
+            continue;
+        }
+        uint16_t expected = (uint16_t)(payload[payloadLength] * 256 + payload[payloadLength + 1]);
+        if (referenceCrc16(payload, payloadLength) != expected) {
+            out.crcErrors++;
+            out.discarded++;
+            i++;
+            continue;
+        }
+
+        out.frames++;
+        out.digest = referenceDigest(out.digest, payload, payloadLength);
+        i += frameLength;
+    }
+    out.pending = length - i;
+}
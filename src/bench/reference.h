@@ -0,0 +1,32 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Plain versions of the CRC and the framer, written for obviousness
+// rather than speed, as oracles for the ones in src/vesc. The benchmark
+// runs both on the same random inputs and fails if they ever disagree,
+// so the fast versions can change freely as long as it stays quiet.
+
+// CRC-16-CCITT bit by bit: poly 0x1021, initial value 0
+uint16_t referenceCrc16(const uint8_t* data, size_t length);
+
+// What a framer should make of a whole stream, however it was split
+struct ReferenceFrames {
+    uint32_t frames;
+    uint32_t digest;          // FNV-1a over each frame's length and payload, in order
+    uint32_t discarded;
+    uint32_t crcErrors;
+    uint32_t stopErrors;
+    uint32_t oversize;
+    size_t pending;           // Bytes left waiting for the rest of a frame
+};
+
+// Scan a stream from its start: at each byte, either a whole frame whose
+// stop byte and CRC check out, or a one-byte skip. Payloads longer than
+// maxPayload are skipped as corrupt. A frame running past the end is left
+// pending.
+void referenceFrame(const uint8_t* stream, size_t length, size_t maxPayload, ReferenceFrames& out);
+
+// The digest step referenceFrame() uses, for comparing a framer's output
+uint32_t referenceDigest(uint32_t digest, const uint8_t* payload, size_t length);
@@ -0,0 +1,137 @@
+#include "advertising.h"
+
+#include <ctype.h>
+#include <string.h>
+
+// AD types from the Bluetooth assigned numbers
+static const uint8_t AD_UUID128_INCOMPLETE = 0x06;
+static const uint8_t AD_UUID128_COMPLETE = 0x07;
+static const uint8_t AD_NAME_SHORT = 0x08;
+static const uint8_t AD_NAME_COMPLETE = 0x09;
+static const uint8_t AD_MANUFACTURER = 0xFF;
+
+// 6e400001-b5a3-f393-e0a9-e50e24dcca9e, least significant byte first as
+// it is sent over the air
+static const uint8_t NUS_SERVICE_UUID[16] = {
+    0x9e, 0xca, 0xdc, 0x24, 0x0e, 0xe5, 0xa9, 0xe0,
+    0x93, 0xf3, 0xa3, 0xb5, 0x01, 0x00, 0x40, 0x6e
+};
+
+// Find the next AD structure of a type at or after offset. Returns its
+// data and length, or nullptr once the data (or a malformed length)
+// runs out.
+static const uint8_t* findAd(const uint8_t* data, size_t length, uint8_t type, size_t& offset, size_t& adLength) {
+    while (offset < length) {
+        size_t fieldLength = data[offset];
+        if (fieldLength == 0 || offset + 1 + fieldLength > length) return nullptr;
+        size_t field = offset;
+        offset += 1 + fieldLength;
+        if (data[field + 1] == type) {
+            adLength = fieldLength - 1;
+            return data + field + 2;
+        }
+    }
+    return nullptr;
+}
+
+static bool listsUuid128(const uint8_t* data, size_t length, uint8_t type, const uint8_t* uuid) {
+    size_t offset = 0;
+    size_t adLength;
+    const uint8_t* ad;
+    while ((ad = findAd(data, length, type, offset, adLength)) != nullptr) {
+        for (size_t i = 0; i + 16 <= adLength; i += 16) {
+            if (memcmp(ad + i, uuid, 16) == 0) return true;
+        }
+    }
+    return false;
+}
+
+static bool hasCompany(const uint8_t* data, size_t length, uint16_t companyId) {
+    size_t offset = 0;
+    size_t adLength;
+    const uint8_t* ad;
+    while ((ad = findAd(data, length, AD_MANUFACTURER, offset, adLength)) != nullptr) {
+        // The company id leads the manufacturer data, little endian
+        if (adLength >= 2 && (uint16_t)(ad[0] | (ad[1] << 8)) == companyId) return true;
+    }
+    return false;
+}
+
+static const uint8_t BEACON_TYPE = 'V';
+static const uint8_t BEACON_VERSION = 1;
+static const size_t BEACON_LENGTH = 12;     // Manufacturer data, company id included
+
+static int16_t readInt16(const uint8_t* data) {
+    return (int16_t)(data[0] | (data[1] << 8));
+}
+
+// Case-insensitive search for "VESC" in a name that is not terminated
+static bool containsVesc(const uint8_t* name, size_t length) {
+    static const char needle[] = "VESC";
+    for (size_t start = 0; start + 4 <= length; start++) {
+        size_t i = 0;
+        while (needle[i] && toupper(name[start + i]) == needle[i]) i++;
+        if (needle[i] == '\0') return true;
+    }
+    return false;
+}
+
+static const uint8_t* findName(const uint8_t* data, size_t length, size_t& nameLength) {
+    size_t offset = 0;
+    const uint8_t* name = findAd(data, length, AD_NAME_COMPLETE, offset, nameLength);
+    if (name) return name;
+    offset = 0;
+    return findAd(data, length, AD_NAME_SHORT, offset, nameLength);
+}
+
+AdvMatch advMatchVesc(const uint8_t* data, size_t length, const AdvFilter& filter) {
+    if (listsUuid128(data, length, AD_UUID128_COMPLETE, NUS_SERVICE_UUID) ||
+        listsUuid128(data, length, AD_UUID128_INCOMPLETE, NUS_SERVICE_UUID)) {
+        return ADV_MATCH_SERVICE;
+    }
+    if (filter.companyId >= 0 && hasCompany(data, length, (uint16_t)filter.companyId)) {
+        return ADV_MATCH_MANUFACTURER;
+    }
+    if (filter.nameFallback) {
+        size_t nameLength;
+        const uint8_t* name = findName(data, length, nameLength);
+        if (name && containsVesc(name, nameLength)) return ADV_MATCH_NAME;
+    }
+    return ADV_NO_MATCH;
+}
+
+bool advCopyName(const uint8_t* data, size_t length, char* out, size_t outSize) {
+    size_t nameLength;
+    const uint8_t* name = findName(data, length, nameLength);
+    if (!name || outSize == 0) return false;
+    if (nameLength > outSize - 1) nameLength = outSize - 1;
+    memcpy(out, name, nameLength);
+    out[nameLength] = '\0';
+    return true;
+}
+
+bool advDecodeBeacon(const uint8_t* data, size_t length, uint16_t companyId, AdvBeacon& out) {
+    size_t offset = 0;
+    size_t adLength;
+    const uint8_t* ad;
+    while ((ad = findAd(data, length, AD_MANUFACTURER, offset, adLength)) != nullptr) {
+        if (adLength < BEACON_LENGTH || (uint16_t)readInt16(ad) != companyId) continue;
+        if (ad[2] != BEACON_TYPE || ad[3] != BEACON_VERSION) continue;
+        out.sequence = ad[4];
+        out.vIn = readInt16(ad + 5);
+        out.tempFet = readInt16(ad + 7);
+        out.tempMotor = readInt16(ad + 9);
+        out.faultCode = ad[11];
+        return true;
+    }
+    return false;
+}
+
+const char* advMatchName(AdvMatch match) {
+    switch (match) {
+        case ADV_MATCH_SERVICE: return "service";
+        case ADV_MATCH_MANUFACTURER: return "manufacturer data";
+        case ADV_MATCH_NAME: return "name";
+        default: return "none";
+    }
+}
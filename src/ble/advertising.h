@@ -0,0 +1,50 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Raw advertising data checks for the scan callback. They walk the AD
+// structures of the advertisement (plus scan response) in place, so
+// telling a VESC from the hundreds of other advertisers around is a few
+// byte compares with no strings or heap involved.
+
+// How an advertisement was recognized as a VESC
+enum AdvMatch : uint8_t {
+    ADV_NO_MATCH,
+    ADV_MATCH_SERVICE,       // Lists the Nordic UART Service
+    ADV_MATCH_MANUFACTURER,  // Manufacturer data with the configured company id
+    ADV_MATCH_NAME           // "VESC" in the name (fallback)
+};
+
+struct AdvFilter {
+    int32_t companyId;       // Manufacturer data company id to accept, -1 for none
+    bool nameFallback;       // Accept "VESC" in the name when nothing else matched
+};
+
+// Check the service UUIDs first, then manufacturer data, then the name
+AdvMatch advMatchVesc(const uint8_t* data, size_t length, const AdvFilter& filter);
+
+// Copy the advertised name (complete, else shortened) into out as a C
+// string. Returns false if the advertisement carries no name.
+bool advCopyName(const uint8_t* data, size_t length, char* out, size_t outSize);
+
+const char* advMatchName(AdvMatch match);
+
+// Status beacon: a VESC setup's telemetry in its manufacturer data (a
+// VESC Express script can send it), so it can be watched without a
+// connection. After the company id, little endian:
+//   'V' 0x01 sequence:u8 vIn:u16 (0.1 V) tempFet:i16 (0.1 °C)
+//   tempMotor:i16 (0.1 °C) fault:u8
+// 14 bytes of advertising data with its AD header, leaving room for the
+// flags and a short name in a legacy advertisement.
+struct AdvBeacon {
+    uint8_t sequence;        // The sender bumps it with each new status
+    int16_t vIn;
+    int16_t tempFet;
+    int16_t tempMotor;
+    uint8_t faultCode;
+};
+
+// Decode the first status beacon with companyId. Returns false if the
+// advertisement carries none.
+bool advDecodeBeacon(const uint8_t* data, size_t length, uint16_t companyId, AdvBeacon& out);
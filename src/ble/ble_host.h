@@ -0,0 +1,51 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include "ble_transport.h"
+
+// The BLE host stack the dashboard runs on, chosen at build time by
+// BLE_BACKEND_NIMBLE (feature_flags.h): bluedroid_host.cpp over the ESP32
+// BLE Arduino library, or nimble_host.cpp over NimBLE-Arduino. The env
+// builds exactly one of them. Scanning, the VESC links and the few
+// pairing calls bonding.cpp makes all go through here, so nothing above
+// it includes a stack's headers.
+
+// An advertisement heard by a scan: the advertiser's address, most
+// significant byte first as BLEDeviceInfo::bda keeps it, its address
+// type (BLE_ADDRESS_PUBLIC or _RANDOM), RSSI and raw advertising data.
+// Called on the host's task.
+typedef void (*BleAdvertHandler)(const uint8_t* address, uint8_t addressType, int rssi,
+                                 const uint8_t* payload, size_t length);
+
+// Bring up the controller and host, and set the local MTU so the exchange
+// after a connect asks for the largest size. releaseClassic starts the
+// Bluedroid build's controller BLE only (controller.h); NimBLE always
+// does. A later call only sets the MTU again.
+void bleHostBegin(uint16_t localMtu, bool releaseClassic);
+
+// The stack's name, for the boot log
+const char* bleHostName();
+
+// Where scans report. With duplicates, every advertisement is reported,
+// not only the first of each device per scan.
+void bleHostScanHandler(BleAdvertHandler handler, bool duplicates);
+
+// Scan until stopped, active (asking for scan responses) or passive, with
+// the interval and window in ms. Returns false if it did not start.
+bool bleHostScanStart(bool active, uint16_t intervalMs, uint16_t windowMs);
+void bleHostScanStop();
+
+// The link in a slot, below VESC_MAX_LINKS
+BleTransport& bleHostLink(uint8_t index);
+
+// Pairing, for bonding.cpp. Just Works bonding with encryption and
+// identity keys on both sides; the stack keeps the keys in NVS.
+void bleHostSecurityBegin();
+int bleHostBondCount();
+bool bleHostIsBonded(const uint8_t* address);
+
+// Ask a connected peer for encryption with its stored keys. The result
+// comes to bondingAuthComplete(); false if it could not be asked.
+bool bleHostEncrypt(const uint8_t* address);
+void bleHostForgetBond(const uint8_t* address);
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include "link_params.h"
+#include "device_table.h"
+#include "call_deadline.h"
+#include "../vesc/transport.h"
+
+// Simultaneous links the dashboard can hold (vehicles with a BLE module
+// per VESC instead of CAN)
+#define VESC_MAX_LINKS 3
+
+// How writes to the UART RX characteristic are sent
+enum BleWriteMode : uint8_t {
+    BLE_WRITE_AUTO,            // Without response if RX allows it, else with
+    BLE_WRITE_WITH_RESPONSE,   // Each write confirmed before the next is sent
+    BLE_WRITE_NO_RESPONSE      // Paced by the stack's free buffers
+};
+
+// BLE link to a VESC over the Nordic UART Service, whichever host stack
+// carries it (see BLE_BACKEND_NIMBLE in feature_flags.h): BluedroidLink
+// or NimbleLink, one per link slot, handed out by bleHostLink().
+//
+// Each lives for the whole program and makes its client once, so a long
+// run of failed reconnects does not allocate (or leak) anything.
+// Notifications and callbacks carry the link's index, which the owner
+// uses to index its per-link state directly.
+class BleTransport : public VescTransport {
+public:
+    typedef void (*DisconnectHandler)(uint8_t link);
+    // Called once notifications are enabled; returns true once the VESC
+    // has answered. A false result on the cached path triggers discovery.
+    typedef bool (*ReadyCheck)(uint8_t link);
+
+    // Create the client. Call once per link after bleHostBegin().
+    virtual void begin(uint8_t index, const BleLinkProfile& profile, uint16_t mtu,
+                       DataHandler onData, DisconnectHandler onDisconnect,
+                       BleWriteMode writeMode = BLE_WRITE_AUTO) = 0;
+
+    // Supervision timeout to ask for on the next connect; 0 keeps the
+    // profile's. A short one has the stack report a silent peer lost
+    // within that time instead of seconds later.
+    virtual void setSupervisionTimeout(uint32_t ms) = 0;
+
+    // Longest the blocking library calls of a connect may take before the
+    // link is dropped under them (see call_deadline.h); 0 for none
+    virtual void setCallDeadlines(const BleCallDeadlines& limits) = 0;
+
+    // After discovery, route notifications straight from the stack's
+    // event to the data handler instead of through a callback on the
+    // library's characteristic, where the backend can (Bluedroid)
+    virtual void setDirectNotify(bool enabled) = 0;
+
+    // Connect to a device and subscribe to the UART TX characteristic,
+    // using what the GATT cache holds for it. The address type that worked
+    // last time is tried first, else the one the device advertised. Returns
+    // false (and leaves the client disconnected) if the link could not be
+    // set up. ready() reports whether the VESC answered; see isReady().
+    virtual bool connect(const BLEDeviceInfo& device, ReadyCheck ready) = 0;
+
+    virtual void disconnect() = 0;
+
+    // True if the VESC answered during the last connect()
+    virtual bool isReady() const = 0;
+
+    // True if the last connect() skipped discovery
+    virtual bool usedCachedHandles() const = 0;
+
+    // True if the current connection writes without response
+    virtual bool writesWithoutResponse() const = 0;
+    virtual uint32_t writesDeferred() const = 0;
+    virtual uint32_t writeErrors() const = 0;
+
+    // Ask the controller for the connection RSSI; does not wait for the
+    // answer where the stack reports it later
+    virtual void requestRssi() = 0;
+
+    // Last connection RSSI reported, in dBm. Returns 0 if none yet.
+    virtual int rssi() = 0;
+};
@@ -0,0 +1,129 @@
+#include "ble_host.h"
+#include "bluedroid_link.h"
+#include "bonding.h"
+#include "controller.h"
+#include "../log.h"
+
+#include "BLEDevice.h"
+#include "BLEScan.h"
+#include "BLEAdvertisedDevice.h"
+#include <esp_gap_ble_api.h>
+#include <string.h>
+
+static const uint8_t KEY_SIZE = 16;
+static const int MAX_BONDS = 15;    // CONFIG_BT_SMP_MAX_BONDS
+
+static BluedroidLink links[VESC_MAX_LINKS];
+static esp_ble_bond_dev_t bonds[MAX_BONDS];     // Connection task only
+static volatile BleAdvertHandler advertHandler = nullptr;
+
+// The library is told not to parse advertisements, so every advertiser
+// around costs only what the handler does with the raw bytes
+class ScanCallbacks : public BLEAdvertisedDeviceCallbacks {
+    void onResult(BLEAdvertisedDevice advertisedDevice) {
+        BleAdvertHandler handler = advertHandler;
+        if (!handler) return;
+        BLEAddress address = advertisedDevice.getAddress();
+        handler(*address.getNative(), advertisedDevice.getAddressType(), advertisedDevice.getRSSI(),
+                advertisedDevice.getPayload(), advertisedDevice.getPayloadLength());
+    }
+};
+
+static ScanCallbacks scanCallbacks;
+
+// Records negotiated parameters and connection RSSI, and passes pairing
+// results on to bonding.h
+static void gapEventHandler(esp_gap_ble_cb_event_t event, esp_ble_gap_cb_param_t* param) {
+    if (event == ESP_GAP_BLE_UPDATE_CONN_PARAMS_EVT) {
+        bleLinkStatus.interval = param->update_conn_params.conn_int;
+        bleLinkStatus.latency = param->update_conn_params.latency;
+        bleLinkStatus.timeout = param->update_conn_params.timeout;
+        LOG_D(BLE, "Connection params updated (status %d): interval %.2fms latency %d timeout %dms",
+              param->update_conn_params.status, param->update_conn_params.conn_int * 1.25f,
+              param->update_conn_params.latency, param->update_conn_params.timeout * 10);
+    } else if (event == ESP_GAP_BLE_READ_RSSI_COMPLETE_EVT) {
+        if (param->read_rssi_cmpl.status == ESP_BT_STATUS_SUCCESS) {
+            for (uint8_t i = 0; i < VESC_MAX_LINKS; i++) {
+                links[i].noteRssi(param->read_rssi_cmpl.remote_addr, param->read_rssi_cmpl.rssi);
+            }
+        }
+    } else if (event == ESP_GAP_BLE_AUTH_CMPL_EVT) {
+        const esp_ble_auth_cmpl_t& result = param->ble_security.auth_cmpl;
+        bondingAuthComplete(result.bd_addr, result.success, result.fail_reason);
+    }
+}
+
+void bleHostBegin(uint16_t localMtu, bool releaseClassic) {
+    if (releaseClassic) bleControllerStartBleOnly();
+    BLEDevice::init("");
+    BLEDevice::setCustomGapHandler(gapEventHandler);
+    BLEDevice::setMTU(localMtu);
+}
+
+const char* bleHostName() {
+    return "Bluedroid";
+}
+
+void bleHostScanHandler(BleAdvertHandler handler, bool duplicates) {
+    advertHandler = handler;
+    BLEDevice::getScan()->setAdvertisedDeviceCallbacks(&scanCallbacks, duplicates, false);
+}
+
+bool bleHostScanStart(bool active, uint16_t intervalMs, uint16_t windowMs) {
+    BLEScan* scan = BLEDevice::getScan();
+    scan->setActiveScan(active);
+    scan->setInterval(intervalMs);
+    scan->setWindow(windowMs);
+    scan->clearResults();
+    return scan->start(0, nullptr, false);
+}
+
+void bleHostScanStop() {
+    BLEDevice::getScan()->stop();
+}
+
+BleTransport& bleHostLink(uint8_t index) {
+    return links[index];
+}
+
+static void setParam(esp_ble_sm_param_t param, uint8_t value) {
+    esp_ble_gap_set_security_param(param, &value, sizeof(value));
+}
+
+void bleHostSecurityBegin() {
+    // Secure Connections where the module has it, bonding, and no IO, so
+    // pairing is Just Works; both sides hand over their encryption and
+    // identity keys, the latter resolving a module's random address
+    setParam(ESP_BLE_SM_AUTHEN_REQ_MODE, ESP_LE_AUTH_REQ_SC_BOND);
+    setParam(ESP_BLE_SM_IOCAP_MODE, ESP_IO_CAP_NONE);
+    setParam(ESP_BLE_SM_MAX_KEY_SIZE, KEY_SIZE);
+    setParam(ESP_BLE_SM_SET_INIT_KEY, ESP_BLE_ENC_KEY_MASK | ESP_BLE_ID_KEY_MASK);
+    setParam(ESP_BLE_SM_SET_RSP_KEY, ESP_BLE_ENC_KEY_MASK | ESP_BLE_ID_KEY_MASK);
+}
+
+int bleHostBondCount() {
+    return esp_ble_get_bond_device_num();
+}
+
+bool bleHostIsBonded(const uint8_t* address) {
+    int count = esp_ble_get_bond_device_num();
+    if (count <= 0) return false;
+    if (count > MAX_BONDS) count = MAX_BONDS;
+    if (esp_ble_get_bond_device_list(&count, bonds) != ESP_OK) return false;
+    for (int i = 0; i < count; i++) {
+        if (memcmp(bonds[i].bd_addr, address, sizeof(esp_bd_addr_t)) == 0) return true;
+    }
+    return false;
+}
+
+bool bleHostEncrypt(const uint8_t* address) {
+    esp_bd_addr_t bda;
+    memcpy(bda, address, sizeof(bda));
+    return esp_ble_set_encryption(bda, ESP_BLE_SEC_ENCRYPT) == ESP_OK;
+}
+
+void bleHostForgetBond(const uint8_t* address) {
+    esp_bd_addr_t bda;
+    memcpy(bda, address, sizeof(bda));
+    esp_ble_remove_bond_device(bda);
+}
@@ -0,0 +1,325 @@
+#include "bluedroid_link.h"
+#include "bonding.h"
+#include "../log.h"
+
+#include "BLEDevice.h"
+#include "BLERemoteService.h"
+#include <esp_gap_ble_api.h>
+#include <esp_gattc_api.h>
+#include <string.h>
+
+// Nordic UART Service UUIDs
+static BLEUUID serviceUUID("6e400001-b5a3-f393-e0a9-e50e24dcca9e");
+static BLEUUID charUUID_RX("6e400002-b5a3-f393-e0a9-e50e24dcca9e");
+static BLEUUID charUUID_TX("6e400003-b5a3-f393-e0a9-e50e24dcca9e");
+
+static const uint32_t CCCD_WRITE_TIMEOUT_MS = 1000;
+
+static const char* addrTypeName(uint8_t type) {
+    return type == BLE_ADDR_TYPE_RANDOM ? "RANDOM" : "PUBLIC";
+}
+
+void BluedroidLink::Callbacks::onConnect(BLEClient* client) {
+    LOG_I(BLE, "BLE Client %d Connected", owner->linkIndex);
+}
+
+void BluedroidLink::Callbacks::onDisconnect(BLEClient* client) {
+    LOG_I(BLE, "BLE Client %d Disconnected", owner->linkIndex);
+    owner->dropCharacteristics();
+    if (owner->disconnectHandler) owner->disconnectHandler(owner->linkIndex);
+}
+
+BluedroidLink::BluedroidLink()
+    : bleClient(nullptr), callbacks(this), direct(), linkIndex(0), txChar(nullptr), rxChar(nullptr),
+      profile(&BLE_PROFILE_BALANCED), mtu(23), supervisionMs(0), deadlines(), directNotify(true), writeMode(BLE_WRITE_AUTO), dataHandler(nullptr),
+      disconnectHandler(nullptr), ready(false), cachedPath(false) {
+}
+
+void BluedroidLink::begin(uint8_t index, const BleLinkProfile& linkProfile, uint16_t linkMtu,
+                          DataHandler onData, DisconnectHandler onDisconnect,
+                          BleWriteMode linkWriteMode) {
+    linkIndex = index;
+    writeMode = linkWriteMode;
+    profile = &linkProfile;
+    mtu = linkMtu;
+    dataHandler = onData;
+    disconnectHandler = onDisconnect;
+
+    gattDirectInit();
+    if (!bleClient) {
+        bleClient = BLEDevice::createClient();
+        bleClient->setClientCallbacks(&callbacks);
+        LOG_D(BLE, "BLE client created with callbacks");
+    }
+}
+
+void BluedroidLink::dropCharacteristics() {
+    // Owned by the client's service map, which is rebuilt on the next
+    // discovery, so only forget the pointers
+    txChar = nullptr;
+    rxChar = nullptr;
+}
+
+// A call ran past its deadline (call_deadline.h): have the stack close
+// the GATT connection and disconnect the peer. Both only post to the BTC
+// task.
+void BluedroidLink::dropCall(void* context) {
+    BluedroidLink* link = (BluedroidLink*)context;
+    esp_ble_gattc_close(link->bleClient->getGattcIf(), link->bleClient->getConnId());
+    esp_ble_gap_disconnect(link->peer);
+}
+
+// One connect attempt under its deadline. A connect that only came
+// through after the link was dropped under it is let go.
+bool BluedroidLink::connectWithin(BLEAddress& address, uint8_t type) {
+    bleCallArm(BLE_CALL_CONNECT, dropCall, this, deadlines.connectMs);
+    bool connected = bleClient->connect(address, (esp_ble_addr_type_t)type);
+    if (bleCallDisarm()) {
+        if (bleClient->isConnected()) bleClient->disconnect();
+        return false;
+    }
+    return connected;
+}
+
+bool BluedroidLink::connectAddress(BLEAddress& address, uint8_t preferredType, uint8_t& usedType) {
+    uint8_t otherType = (preferredType == BLE_ADDR_TYPE_RANDOM) ? BLE_ADDR_TYPE_PUBLIC : BLE_ADDR_TYPE_RANDOM;
+
+    LOG_D(BLE, "Attempting connection with %s address type...", addrTypeName(preferredType));
+    if (connectWithin(address, preferredType)) {
+        usedType = preferredType;
+        return true;
+    }
+
+    LOG_W(BLE, "Failed with %s address, trying %s...", addrTypeName(preferredType), addrTypeName(otherType));
+    if (connectWithin(address, otherType)) {
+        usedType = otherType;
+        return true;
+    }
+    return false;
+}
+
+// Request MTU and connection parameters for the fresh connection
+void BluedroidLink::requestParams() {
+    // The MTU exchange runs automatically on connect using the local MTU;
+    // request again in case the peer ignored the first exchange
+    if (bleClient->getMTU() < mtu) {
+        bleClient->setMTU(mtu);
+    }
+    bleLinkStatus.mtu = bleClient->getMTU();
+
+    esp_ble_conn_update_params_t params;
+    memcpy(params.bda, peer, sizeof(esp_bd_addr_t));
+    params.min_int = profile->minInterval;
+    params.max_int = profile->maxInterval;
+    params.latency = profile->latency;
+    params.timeout = bleLinkSupervisionTimeout(*profile, supervisionMs);
+
+    esp_err_t err = esp_ble_gap_update_conn_params(&params);
+    if (err != ESP_OK) {
+        LOG_W(BLE, "Connection parameter update failed to start (err %d)", err);
+    } else {
+        LOG_D(BLE, "Requested %s connection profile, supervision timeout %dms", profile->name, params.timeout * 10);
+    }
+}
+
+// Run full GATT discovery for the NUS service and subscribe to TX.
+// Fills in the handles to cache on success.
+bool BluedroidLink::discoverAndSubscribe(GattCacheEntry& entry) {
+    // getService() runs discovery and blocks until the GATT search completes
+    LOG_D(BLE, "Getting UART service...");
+    bleCallArm(BLE_CALL_DISCOVER, dropCall, this, deadlines.discoverMs);
+    BLERemoteService* pRemoteService = bleClient->getService(serviceUUID);
+    if (bleCallDisarm()) return false;
+    if (pRemoteService == nullptr) {
+        LOG_W(BLE, "Failed to find Nordic UART service");
+        LOG_I(BLE, "Listing all available services:");
+        std::map<std::string, BLERemoteService*>* serviceMap = bleClient->getServices();
+        for (auto const& service : *serviceMap) {
+            LOG_I(BLE, "  Found service: %s", service.first.c_str());
+        }
+        return false;
+    }
+
+    LOG_D(BLE, "Found Nordic UART service");
+
+    // Get the TX characteristic (for receiving data from VESC)
+    LOG_D(BLE, "Getting TX characteristic...");
+    txChar = pRemoteService->getCharacteristic(charUUID_TX);
+    if (txChar == nullptr) {
+        LOG_W(BLE, "Failed to find TX characteristic");
+        return false;
+    }
+
+    // Get the RX characteristic (for sending data to VESC)
+    LOG_D(BLE, "Getting RX characteristic...");
+    rxChar = pRemoteService->getCharacteristic(charUUID_RX);
+    if (rxChar == nullptr) {
+        LOG_W(BLE, "Failed to find RX characteristic");
+        return false;
+    }
+
+    LOG_D(BLE, "Found both characteristics");
+
+    if (!txChar->canNotify()) {
+        LOG_W(BLE, "TX characteristic cannot notify");
+        return false;
+    }
+
+    BLERemoteDescriptor* pDescriptor = txChar->getDescriptor(BLEUUID((uint16_t)0x2902));
+    entry.txHandle = txChar->getHandle();
+    entry.rxHandle = rxChar->getHandle();
+    entry.rxNoResponse = rxChar->canWriteNoResponse();
+    entry.cccdHandle = pDescriptor ? pDescriptor->getHandle() : 0;
+
+    // With the handles known, notifications can take the same way as on
+    // the cached path: straight from the GATTC event to the handler, with
+    // no callback registered on the characteristic for the library to
+    // look up and call through std::function
+    if (directNotify && entry.cccdHandle != 0) {
+        if (gattDirectAttach(direct, bleClient, entry, dataHandler, linkIndex, CCCD_WRITE_TIMEOUT_MS)) {
+            LOG_I(BLE, "Notifications enabled (direct)");
+            return true;
+        }
+        LOG_W(BLE, "Direct notifications failed, registering with the characteristic");
+    }
+
+    // Register for notifications from TX characteristic
+    LOG_D(BLE, "Registering for notifications...");
+    GattNotifyHandler handler = dataHandler;
+    uint8_t link = linkIndex;
+    txChar->registerForNotify([handler, link](BLERemoteCharacteristic* characteristic, uint8_t* data, size_t length, bool isNotify) {
+        if (handler) handler(link, data, length);
+    });
+
+    // Also write to the CCCD descriptor to ensure notifications are enabled
+    LOG_D(BLE, "Writing to CCCD descriptor...");
+    if (pDescriptor) {
+        uint8_t notifyValue[] = {0x01, 0x00}; // Enable notifications
+        bleCallArm(BLE_CALL_SUBSCRIBE, dropCall, this, deadlines.subscribeMs);
+        pDescriptor->writeValue(notifyValue, 2, true);  // Waits for the write response
+        if (bleCallDisarm()) return false;
+        LOG_D(BLE, "CCCD descriptor written");
+    } else {
+        LOG_W(BLE, "CCCD descriptor not found");
+    }
+    LOG_I(BLE, "Notifications enabled");
+    return true;
+}
+
+// Pick the write type for this connection and route writes to RX
+void BluedroidLink::startWrites(const GattCacheEntry& entry) {
+    bool noResponse = writeMode == BLE_WRITE_NO_RESPONSE ||
+                      (writeMode == BLE_WRITE_AUTO && entry.rxNoResponse);
+    gattWriteBegin(direct, bleClient, entry.rxHandle, noResponse);
+    LOG_D(BLE, "Link %d writes %s response", linkIndex, noResponse ? "without" : "with");
+}
+
+bool BluedroidLink::connect(const BLEDeviceInfo& device, ReadyCheck readyCheck) {
+    const char* address = device.address;
+    ready = false;
+    cachedPath = false;
+
+    // Tear down whatever is left of the previous connection
+    gattDirectDetach(direct, bleClient);
+    if (bleClient->isConnected()) {
+        bleClient->disconnect();
+    }
+    dropCharacteristics();
+
+    // Try the address type that worked last time first; otherwise the
+    // advertised one, then the other
+    GattCacheEntry cached;
+    bool haveCache = gattCacheLookup(address, cached);
+    uint8_t addrType = haveCache ? cached.addrType : device.addressType;
+
+    memcpy(peer, device.bda, sizeof(peer));
+    lastRssi = 0;
+    BLEAddress bleAddress(peer);
+    bondingConnectStart(device.bda);
+    if (!connectAddress(bleAddress, addrType, addrType)) {
+        LOG_W(BLE, "Failed to connect to VESC BLE device");
+        return false;
+    }
+
+    LOG_I(BLE, "Connected to VESC BLE device");
+
+    // A bonded module is encrypted before any GATT traffic, so nothing it
+    // protects is refused and has to wait for pairing
+    if (!bondingResume(device.bda)) {
+        bleClient->disconnect();
+        return false;
+    }
+
+    // Ask for a large MTU and short connection interval so a telemetry
+    // reply arrives in a single notification
+    requestParams();
+
+    // Fast path: reuse the handles from the last successful discovery. A
+    // rejected CCCD write or a silent VESC means the handles are stale.
+    if (haveCache && cached.addrType == addrType && cached.cccdHandle != 0) {
+        LOG_D(BLE, "Using cached GATT handles");
+        if (gattDirectAttach(direct, bleClient, cached, dataHandler, linkIndex, CCCD_WRITE_TIMEOUT_MS)) {
+            startWrites(cached);
+            ready = readyCheck(linkIndex);
+        }
+        if (ready) {
+            cachedPath = true;
+            bondingConnectDone();
+            return true;
+        }
+        LOG_W(BLE, "Cached GATT handles failed, running full discovery");
+        gattDirectDetach(direct, bleClient);
+        gattCacheForget(address);
+    }
+
+    GattCacheEntry discovered = GattCacheEntry();
+    discovered.addrType = addrType;
+    if (!discoverAndSubscribe(discovered)) {
+        bleClient->disconnect();
+        dropCharacteristics();
+        return false;
+    }
+
+    // Notifications are live once the CCCD write is acknowledged. Remember
+    // the handles only once the VESC has answered through them.
+    startWrites(discovered);
+    ready = readyCheck(linkIndex);
+    if (ready && discovered.cccdHandle != 0) {
+        gattCacheStore(address, discovered);
+    }
+    bondingConnectDone();
+    return true;
+}
+
+void BluedroidLink::disconnect() {
+    if (!bleClient) return;
+    gattDirectDetach(direct, bleClient);
+    if (bleClient->isConnected()) {
+        bleClient->disconnect();
+    }
+    dropCharacteristics();
+}
+
+bool BluedroidLink::isConnected() {
+    return bleClient && bleClient->isConnected();
+}
+
+bool BluedroidLink::write(const uint8_t* data, size_t length) {
+    if (!isConnected()) return false;
+    return gattWrite(direct, bleClient, data, length);
+}
+
+void BluedroidLink::requestRssi() {
+    if (!isConnected()) return;
+    esp_err_t err = esp_ble_gap_read_rssi(peer);
+    if (err != ESP_OK) LOG_V(BLE, "RSSI read failed to start (err %d)", err);
+}
+
+void BluedroidLink::noteRssi(const uint8_t* address, int8_t rssi) {
+    if (memcmp(address, peer, sizeof(peer)) == 0) lastRssi = rssi;
+}
+
+size_t BluedroidLink::writeLimit() {
+    uint16_t linkMtu = bleClient ? bleClient->getMTU() : 23;
+    return linkMtu > 3 ? linkMtu - 3 : 20;
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include "BLEClient.h"
+#include "BLERemoteCharacteristic.h"
+#include "ble_transport.h"
+#include "gatt_cache.h"
+#include "gatt_direct.h"
+
+// The VESC link on Bluedroid, through the ESP32 BLE Arduino library's
+// BLEClient, with notifications and writes on the direct GATTC path
+// (gatt_direct.h). Owns the client and a callback object; see
+// BleTransport for the rest.
+class BluedroidLink : public BleTransport {
+public:
+    BluedroidLink();
+
+    void begin(uint8_t index, const BleLinkProfile& profile, uint16_t mtu,
+               DataHandler onData, DisconnectHandler onDisconnect,
+               BleWriteMode writeMode = BLE_WRITE_AUTO) override;
+
+    uint8_t index() const { return linkIndex; }
+
+    void setSupervisionTimeout(uint32_t ms) override { supervisionMs = ms; }
+    void setCallDeadlines(const BleCallDeadlines& limits) override { deadlines = limits; }
+
+    // Off, notifications after a full discovery go through a callback on
+    // the library's characteristic; the cached path always takes the
+    // GATTC event
+    void setDirectNotify(bool enabled) override { directNotify = enabled; }
+
+    bool connect(const BLEDeviceInfo& device, ReadyCheck ready) override;
+    void disconnect() override;
+    bool isConnected() override;
+    bool isReady() const override { return ready; }
+    bool usedCachedHandles() const override { return cachedPath; }
+
+    // Write raw bytes to the UART RX characteristic. Never waits for the
+    // VESC: returns false if the link is down or still busy with earlier
+    // writes (see gattWrite()), in which case the caller retries later.
+    bool write(const uint8_t* data, size_t length) override;
+
+    // One ATT write: the negotiated MTU less its 3-byte header
+    size_t writeLimit() override;
+
+    bool writesWithoutResponse() const override { return direct.writeNoResponse; }
+    uint32_t writesDeferred() const override { return direct.writesDeferred; }
+    uint32_t writeErrors() const override { return direct.writeErrors; }
+
+    // The answer arrives on the GAP handler (bluedroid_host.cpp), which
+    // passes it to noteRssi()
+    void requestRssi() override;
+    int rssi() override { return lastRssi; }
+
+    // A connection RSSI the controller reported for address; kept if it is
+    // this link's peer
+    void noteRssi(const uint8_t* address, int8_t rssi);
+
+private:
+    class Callbacks : public BLEClientCallbacks {
+    public:
+        explicit Callbacks(BluedroidLink* owner) : owner(owner) {}
+        void onConnect(BLEClient* client);
+        void onDisconnect(BLEClient* client);
+    private:
+        BluedroidLink* owner;
+    };
+
+    static void dropCall(void* link);
+    bool connectAddress(BLEAddress& address, uint8_t preferredType, uint8_t& usedType);
+    bool connectWithin(BLEAddress& address, uint8_t type);
+    void requestParams();
+    bool discoverAndSubscribe(GattCacheEntry& entry);
+    void startWrites(const GattCacheEntry& entry);
+    void dropCharacteristics();
+
+    BLEClient* bleClient;
+    Callbacks callbacks;
+    GattDirect direct;
+    uint8_t linkIndex;
+    esp_bd_addr_t peer;
+    volatile int8_t lastRssi;
+    BLERemoteCharacteristic* txChar;
+    BLERemoteCharacteristic* rxChar;
+    const BleLinkProfile* profile;
+    uint16_t mtu;
+    uint32_t supervisionMs;
+    BleCallDeadlines deadlines;
+    bool directNotify;
+    BleWriteMode writeMode;
+    GattNotifyHandler dataHandler;
+    DisconnectHandler disconnectHandler;
+    bool ready;
+    bool cachedPath;
+};
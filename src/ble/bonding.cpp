@@ -0,0 +1,109 @@
+#include "bonding.h"
+#include "ble_host.h"
+#include "../log.h"
+
+#include <Arduino.h>
+#include <string.h>
+
+static const char* const PATH_NAMES[BOND_PATH_COUNT] = { "open", "paired", "resumed" };
+
+static BondingConfig config = { false, 0 };
+static BondingStats stats;
+
+// The connect in progress. The host fills in its pairing result for the
+// same address.
+static uint8_t sessionAddress[6];
+static uint32_t sessionStartMs = 0;
+static bool sessionBonded = false;
+static volatile bool sessionActive = false;
+static volatile bool authDone = false;
+static volatile bool authSuccess = false;
+static volatile uint8_t authFailReason = 0;
+
+void bondingBegin(const BondingConfig& bondingConfig) {
+    config = bondingConfig;
+    memset(&stats, 0, sizeof(stats));
+    if (!config.enabled) return;
+    bleHostSecurityBegin();
+    LOG_I(BLE, "Bonding on, %d bond(s) stored", bleHostBondCount());
+}
+
+bool bondingIsBonded(const uint8_t* address) {
+    return bleHostIsBonded(address);
+}
+
+void bondingConnectStart(const uint8_t* address) {
+    sessionActive = false;
+    memcpy(sessionAddress, address, sizeof(sessionAddress));
+    sessionBonded = config.enabled && bondingIsBonded(address);
+    authDone = false;
+    authSuccess = false;
+    sessionStartMs = millis();
+    sessionActive = true;
+}
+
+bool bondingResume(const uint8_t* address) {
+    if (!sessionBonded) return true;
+    // A module that asks for security on connect has the stack resume
+    // the bond by itself, and it may be done already
+    bool asked = authDone || bleHostEncrypt(address);
+    uint32_t start = millis();
+    while (asked && !authDone && millis() - start < config.encryptTimeoutMs) delay(2);
+    if (asked && authDone && authSuccess) return true;
+
+    if (!asked || !authDone) {
+        LOG_W(BLE, "Encryption did not resume (%s)", !asked ? "refused" : "timeout");
+        return false;
+    }
+    // The module lost its keys (a reset or a new pairing elsewhere)
+    LOG_W(BLE, "Stored bond rejected (reason 0x%02x), forgetting it", authFailReason);
+    bleHostForgetBond(address);
+    stats.resumeFailures++;
+    return false;
+}
+
+void bondingConnectDone() {
+    if (!sessionActive) return;
+    sessionActive = false;
+    uint32_t took = millis() - sessionStartMs;
+    BondPath path = BOND_PATH_OPEN;
+    if (authDone && authSuccess) path = sessionBonded ? BOND_PATH_RESUMED : BOND_PATH_PAIRED;
+
+    uint32_t n = ++stats.connects[path];
+    stats.totalMs[path] += took;
+    if (n == 1 || took < stats.fastestMs[path]) stats.fastestMs[path] = took;
+    if (took > stats.slowestMs[path]) stats.slowestMs[path] = took;
+    LOG_I(BLE, "Link up in %u ms (%s), %s average %u ms over %u", (unsigned)took, PATH_NAMES[path],
+          PATH_NAMES[path], (unsigned)(stats.totalMs[path] / n), (unsigned)n);
+}
+
+void bondingAuthComplete(const uint8_t* address, bool success, uint8_t reason) {
+    if (!sessionActive || memcmp(address, sessionAddress, sizeof(sessionAddress)) != 0) return;
+    authSuccess = success;
+    authFailReason = reason;
+    authDone = true;
+    if (!success) {
+        LOG_W(BLE, "Pairing failed (reason 0x%02x)", reason);
+    } else if (!sessionBonded) {
+        LOG_I(BLE, "Paired and bonded with the module");
+    }
+}
+
+const BondingStats& bondingStats() {
+    return stats;
+}
+
+void bondingLogStats() {
+    char line[160];
+    int n = snprintf(line, sizeof(line), "Connect min/avg/max:");
+    bool any = false;
+    for (uint8_t p = 0; p < BOND_PATH_COUNT && n > 0 && (size_t)n < sizeof(line); p++) {
+        if (stats.connects[p] == 0) continue;
+        any = true;
+        n += snprintf(line + n, sizeof(line) - n, " %s %u/%u/%u ms (%u)", PATH_NAMES[p],
+                      (unsigned)stats.fastestMs[p], (unsigned)(stats.totalMs[p] / stats.connects[p]),
+                      (unsigned)stats.slowestMs[p], (unsigned)stats.connects[p]);
+    }
+    if (!any) return;
+    LOG_I(BLE, "%s, %u bonds rejected", line, (unsigned)stats.resumeFailures);
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <stdint.h>
+
+// Bonding with VESC BLE modules that want an encrypted link. The stack
+// is set up to bond with any module that asks to pair (Just Works, as the
+// dashboard has no way to enter or show a passkey), and the BLE host
+// (ble_host.h, Bluedroid or NimBLE) keeps each bond's keys in NVS. A connect to a bonded module then asks for
+// encryption at once, which the stored keys resume in one exchange
+// instead of pairing again. Modules that never ask are left unencrypted,
+// as before.
+//
+// Connects run one at a time on the connection task; pairing results
+// come from the BLE stack's task.
+
+struct BondingConfig {
+    bool enabled;
+    uint32_t encryptTimeoutMs;  // Longest a connect waits for encryption to resume
+};
+
+// How a connect came up, for the reconnect time statistics
+enum BondPath : uint8_t {
+    BOND_PATH_OPEN,         // No encryption
+    BOND_PATH_PAIRED,       // Paired during the connect, and bonded
+    BOND_PATH_RESUMED,      // Encrypted with the keys of an earlier bond
+    BOND_PATH_COUNT
+};
+
+struct BondingStats {
+    uint32_t connects[BOND_PATH_COUNT];
+    uint32_t totalMs[BOND_PATH_COUNT];
+    uint32_t fastestMs[BOND_PATH_COUNT];
+    uint32_t slowestMs[BOND_PATH_COUNT];
+    uint32_t resumeFailures;    // Bonds the module no longer knew, forgotten
+};
+
+// Set the security parameters. Call once after bleHostBegin().
+void bondingBegin(const BondingConfig& config);
+
+// True if the stack holds a bond for an address
+bool bondingIsBonded(const uint8_t* address);
+
+// A link's connect is starting; times it and notes what pairing it sees
+void bondingConnectStart(const uint8_t* address);
+
+// With the link up: a bonded module is asked for encryption and waited
+// for. Returns true if it is encrypted, or was never bonded. A bond the
+// module rejects is forgotten, and false returned so the connect is
+// retried and pairs afresh.
+bool bondingResume(const uint8_t* address);
+
+// The connect finished with the VESC set up; adds its time to the stats
+// and logs it
+void bondingConnectDone();
+
+// Pairing or encryption with address finished, reported by the BLE host;
+// reason is the stack's failure code where it gives one
+void bondingAuthComplete(const uint8_t* address, bool success, uint8_t reason);
+
+const BondingStats& bondingStats();
+
+// Average, fastest and slowest connect time per path; nothing before
+// the first connect
+void bondingLogStats();
@@ -0,0 +1,99 @@
+#include "call_deadline.h"
+#include "../log.h"
+
+#include <Arduino.h>
+#include <esp_timer.h>
+
+static const uint32_t CHECK_MS = 100;
+
+struct WatchedCall {
+    bool armed;
+    bool expired;
+    BleCall call;
+    BleCallDrop drop;
+    void* context;
+    uint32_t startedMs;
+    uint32_t deadlineMs;
+};
+
+static portMUX_TYPE callMux = portMUX_INITIALIZER_UNLOCKED;
+static WatchedCall watched = {};
+static BleCallStats stats = {};
+static esp_timer_handle_t checkTimer = nullptr;
+
+const char* bleCallName(BleCall call) {
+    switch (call) {
+        case BLE_CALL_CONNECT: return "connect";
+        case BLE_CALL_DISCOVER: return "discovery";
+        case BLE_CALL_SUBSCRIBE: return "subscribe";
+        default: return "?";
+    }
+}
+
+// On the esp_timer task. The drop functions only post to the stack's
+// task, so they are safe here while the connection task sits in the
+// library.
+static void checkDeadline(void* arg) {
+    uint32_t now = millis();
+    bool expire = false;
+    WatchedCall call;
+    portENTER_CRITICAL(&callMux);
+    if (watched.armed && !watched.expired && now - watched.startedMs >= watched.deadlineMs) {
+        watched.expired = true;
+        stats.expired[watched.call]++;
+        expire = true;
+    }
+    call = watched;
+    portEXIT_CRITICAL(&callMux);
+    if (!expire) return;
+
+    LOG_W(BLE, "BLE %s still waiting after %u ms, dropping the link", bleCallName(call.call),
+          (unsigned)(now - call.startedMs));
+    call.drop(call.context);
+}
+
+void bleCallDeadlineBegin() {
+    if (checkTimer) return;
+    esp_timer_create_args_t args;
+    args.callback = checkDeadline;
+    args.arg = nullptr;
+    args.dispatch_method = ESP_TIMER_TASK;
+    args.name = "ble_deadline";
+    args.skip_unhandled_events = true;
+    if (esp_timer_create(&args, &checkTimer) != ESP_OK ||
+        esp_timer_start_periodic(checkTimer, CHECK_MS * 1000ull) != ESP_OK) {
+        LOG_E(BLE, "Could not start the BLE call deadline timer");
+    }
+}
+
+void bleCallArm(BleCall call, BleCallDrop drop, void* context, uint32_t deadlineMs) {
+    portENTER_CRITICAL(&callMux);
+    watched.armed = deadlineMs > 0 && drop != nullptr;
+    watched.expired = false;
+    watched.call = call;
+    watched.drop = drop;
+    watched.context = context;
+    watched.startedMs = millis();
+    watched.deadlineMs = deadlineMs;
+    stats.calls++;
+    portEXIT_CRITICAL(&callMux);
+}
+
+bool bleCallDisarm() {
+    uint32_t now = millis();
+    portENTER_CRITICAL(&callMux);
+    bool expired = watched.expired;
+    uint32_t took = now - watched.startedMs;
+    if (took > stats.slowestMs[watched.call]) stats.slowestMs[watched.call] = took;
+    watched.armed = false;
+    watched.expired = false;
+    portEXIT_CRITICAL(&callMux);
+    return expired;
+}
+
+BleCallStats bleCallStats() {
+    portENTER_CRITICAL(&callMux);
+    BleCallStats copy = stats;
+    portEXIT_CRITICAL(&callMux);
+    return copy;
+}
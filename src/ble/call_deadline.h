@@ -0,0 +1,57 @@
+#pragma once
+
+#include <stdint.h>
+
+// Deadlines for the BLE library calls that wait on the stack with no
+// timeout of their own: the connect, the GATT search and the CCCD write
+// after a full discovery. A peer that stops answering halfway through
+// one would otherwise hold the connection task for good.
+//
+// The connection task arms a deadline before such a call and disarms it
+// after. A periodic esp_timer checks it; once it has passed, the timer
+// calls the link's drop function, which has the stack close the GATT
+// connection and disconnect the peer. The library's wait then ends with
+// the disconnect, and the caller tears the rest down and reports the
+// connect as failed, so a hung call costs a reconnect rather than a
+// reset. (A link still being established is given up by the controller
+// at its own 30 s establishment timeout at the latest.) Only one call
+// is watched at a time, which is all the connection task ever makes.
+
+enum BleCall : uint8_t {
+    BLE_CALL_CONNECT,
+    BLE_CALL_DISCOVER,
+    BLE_CALL_SUBSCRIBE,
+    BLE_CALL_COUNT
+};
+
+struct BleCallDeadlines {
+    uint32_t connectMs;        // Per address type tried
+    uint32_t discoverMs;
+    uint32_t subscribeMs;
+};
+
+struct BleCallStats {
+    uint32_t calls;                    // Watched since boot
+    uint32_t expired[BLE_CALL_COUNT];  // Ran past their deadline
+    uint32_t slowestMs[BLE_CALL_COUNT];
+};
+
+// Start the check timer. Call once from setup().
+void bleCallDeadlineBegin();
+
+// Tears down the link a call is waiting on, given the context passed to
+// bleCallArm(). Runs on the esp_timer task while the connection task is
+// still in the call, so it may only post to the stack, never wait on it.
+typedef void (*BleCallDrop)(void* context);
+
+// A call starts now and must finish within deadlineMs, or drop(context)
+// is called; 0 watches nothing
+void bleCallArm(BleCall call, BleCallDrop drop, void* context, uint32_t deadlineMs);
+
+// The call returned. True if its deadline passed and the link was torn
+// down under it, in which case its result is not to be trusted.
+bool bleCallDisarm();
+
+BleCallStats bleCallStats();
+
+const char* bleCallName(BleCall call);
@@ -0,0 +1,211 @@
+#include "capture.h"
+#include "../log.h"
+#include "../vesc/replay.h"
+#include "../system/memory.h"
+
+#include <Arduino.h>
+#include <SD.h>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <string.h>
+
+static const char* CAPTURE_DIRECTORY = "/logs";
+static const size_t WRITE_SLICE = 4096;     // Card writes per SPI bus hold
+static const size_t HEX_LINE_BYTES = 32;    // Chunk bytes per serial line
+
+static portMUX_TYPE captureMux = portMUX_INITIALIZER_UNLOCKED;
+static uint8_t* buffer = nullptr;
+static size_t capacity = 0;
+static size_t used = 0;
+static uint32_t chunkCount = 0;
+static uint64_t startUs = 0;
+static volatile bool recording = false;
+static volatile bool full = false;
+
+bool captureBegin(size_t bytes) {
+    if (buffer) return true;
+
+    buffer = (uint8_t*)memoryAlloc(bytes, MEMORY_BULK, MEMORY_TAG_BLE);
+    if (!buffer) {
+        LOG_E(BLE, "No PSRAM for a %u byte notification capture", (unsigned)bytes);
+        return false;
+    }
+    capacity = bytes;
+    return true;
+}
+
+void captureStart() {
+    if (!buffer || recording) return;
+
+    portENTER_CRITICAL(&captureMux);
+    used = 0;
+    chunkCount = 0;
+    full = false;
+    startUs = esp_timer_get_time();
+    recording = true;
+    portEXIT_CRITICAL(&captureMux);
+    LOG_I(BLE, "Capturing BLE notifications (%u bytes of buffer)", (unsigned)capacity);
+}
+
+void captureChunk(const uint8_t* data, size_t length) {
+    if (!recording) return;
+
+    CaptureChunkHeader chunk;
+    chunk.timeUs = (uint32_t)(esp_timer_get_time() - startUs);
+    chunk.length = (uint16_t)length;
+
+    portENTER_CRITICAL(&captureMux);
+    if (recording && used + sizeof(chunk) + length <= capacity) {
+        memcpy(buffer + used, &chunk, sizeof(chunk));
+        memcpy(buffer + used + sizeof(chunk), data, length);
+        used += sizeof(chunk) + length;
+        chunkCount++;
+    } else {
+        full = true;
+    }
+    portEXIT_CRITICAL(&captureMux);
+}
+
+bool captureFull() {
+    return recording && full;
+}
+
+static void fillHeader(CaptureFileHeader& header) {
+    memset(&header, 0, sizeof(header));
+    header.magic = CAPTURE_MAGIC;
+    header.version = CAPTURE_VERSION;
+    header.headerSize = sizeof(header);
+    header.chunkCount = chunkCount;
+}
+
+static bool saveToCard() {
+    if (!SD.exists(CAPTURE_DIRECTORY)) SD.mkdir(CAPTURE_DIRECTORY);
+
+    char path[32];
+    for (int i = 1; i <= 9999; i++) {
+        snprintf(path, sizeof(path), "%s/capt%04d.vcap", CAPTURE_DIRECTORY, i);
+        if (SD.exists(path)) continue;
+
+        File file = SD.open(path, FILE_WRITE);
+        if (!file) break;
+        CaptureFileHeader header;
+        fillHeader(header);
+        bool ok = file.write((const uint8_t*)&header, sizeof(header)) == sizeof(header);
+        for (size_t offset = 0; ok && offset < used; offset += WRITE_SLICE) {
+            size_t n = used - offset < WRITE_SLICE ? used - offset : WRITE_SLICE;
+            ok = file.write(buffer + offset, n) == n;
+        }
+        file.close();
+        if (!ok) {
+            LOG_E(BLE, "SD write failed saving %s", path);
+            return false;
+        }
+        LOG_I(BLE, "Saved %u notifications (%u bytes) to %s", chunkCount, (unsigned)used, path);
+        return true;
+    }
+    LOG_E(BLE, "Could not create a capture file");
+    return false;
+}
+
+// One line per chunk: "cap <timeUs> <hex bytes>", long chunks continued
+// on "cap+ <hex bytes>" lines
+static void dumpToSerial() {
+    Serial.printf("capture begin %u\n", chunkCount);
+    size_t offset = 0;
+    while (offset + sizeof(CaptureChunkHeader) <= used) {
+        CaptureChunkHeader chunk;
+        memcpy(&chunk, buffer + offset, sizeof(chunk));
+        offset += sizeof(chunk);
+        for (size_t i = 0; i < chunk.length; i += HEX_LINE_BYTES) {
+            if (i == 0) {
+                Serial.printf("cap %u ", chunk.timeUs);
+            } else {
+                Serial.print("cap+ ");
+            }
+            for (size_t j = i; j < chunk.length && j < i + HEX_LINE_BYTES; j++) {
+                Serial.printf("%02X", buffer[offset + j]);
+            }
+            Serial.print("\n");
+        }
+        offset += chunk.length;
+    }
+    Serial.print("capture end\n");
+}
+
+bool captureStopAndSave() {
+    if (!recording) return false;
+
+    portENTER_CRITICAL(&captureMux);
+    recording = false;
+    portEXIT_CRITICAL(&captureMux);
+
+    bool saved = true;
+    if (chunkCount > 0) {
+        if (SD.cardType() != CARD_NONE) {
+            saved = saveToCard();
+        } else {
+            dumpToSerial();
+        }
+    }
+    used = 0;
+    chunkCount = 0;
+    return saved;
+}
+
+static uint64_t replayClock() {
+    return esp_timer_get_time();
+}
+
+static void replaySleep(uint32_t us) {
+    if (us >= 1000) {
+        delay(us / 1000);
+    } else {
+        delayMicroseconds(us);
+    }
+}
+
+bool captureReplayLatest(bool realtime) {
+    if (SD.cardType() == CARD_NONE) return false;
+
+    char path[32];
+    int latest = 0;
+    for (int i = 1; i <= 9999; i++) {
+        snprintf(path, sizeof(path), "%s/capt%04d.vcap", CAPTURE_DIRECTORY, i);
+        if (!SD.exists(path)) break;
+        latest = i;
+    }
+    if (latest == 0) {
+        LOG_I(BLE, "No capture to replay");
+        return false;
+    }
+    snprintf(path, sizeof(path), "%s/capt%04d.vcap", CAPTURE_DIRECTORY, latest);
+
+    File file = SD.open(path, FILE_READ);
+    if (!file) return false;
+    size_t size = file.size();
+    uint8_t* data = (uint8_t*)memoryAlloc(size, MEMORY_BULK, MEMORY_TAG_BLE);
+    if (!data) {
+        LOG_E(BLE, "No PSRAM to load %s (%u bytes)", path, (unsigned)size);
+        file.close();
+        return false;
+    }
+    size_t got = file.read(data, size);
+    file.close();
+
+    ReplayReport report;
+    bool ok = replayCapture(data, got, realtime, replayClock, replaySleep, report);
+    memoryFree(data);
+    if (!ok) {
+        LOG_E(BLE, "%s is not a capture", path);
+        return false;
+    }
+
+    LOG_I(BLE, "Replayed %s%s: %u chunks, %u bytes in %u us (%u us recorded)",
+          path, realtime ? " in real time" : "", report.chunks, report.bytes,
+          (uint32_t)report.elapsedUs, report.captureUs);
+    LOG_I(BLE, "  %u frames, %u CRC errors, %u resyncs, %u discarded, %u decoded, %u failed",
+          report.frames, report.crcErrors, report.resyncs, report.bytesDiscarded,
+          report.valuesDecoded, report.decodeFailures);
+    LOG_I(BLE, "  frame digest %08X, values digest %08X", report.frameDigest, report.valuesDigest);
+    return true;
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Development capture of the raw BLE notification stream. While
+// recording, every notification is copied with a timestamp into a PSRAM
+// buffer, keeping the exact chunking the VESC's BLE module produced.
+// Saved captures (vesc/replay.h format) go to /logs/captNNNN.vcap, or to
+// the serial port as hex lines if there is no SD card, and can be replayed
+// through the parser here or on the host (bench/protocol_bench.cpp).
+
+// Allocate the buffer. Returns false if there is not enough PSRAM.
+bool captureBegin(size_t bytes);
+
+// Start recording into an empty buffer. Does nothing while already
+// recording, so a reconnect continues the same capture.
+void captureStart();
+
+// Record one notification. Called from the BLE callback; never blocks.
+// Chunks that no longer fit are dropped and the capture counts as full.
+void captureChunk(const uint8_t* data, size_t length);
+
+// True once recording has run out of buffer
+bool captureFull();
+
+// Stop recording and write out what was captured, then empty the buffer.
+// Blocks the caller for the write; UI task only.
+bool captureStopAndSave();
+
+// Load the newest saved capture, replay it through a framer and the
+// decoders and log the report. UI task only, e.g. at boot.
+bool captureReplayLatest(bool realtime);
@@ -0,0 +1,940 @@
+#include "connection_manager.h"
+#include "../log.h"
+#include "../system/heap_stats.h"
+#include "../system/app_events.h"
+#include "../system/perf_stats.h"
+#include "advertising.h"
+#include "last_devices.h"
+#include "gatt_cache.h"
+#include "ble_host.h"
+
+#include "../system/task_layout.h"
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
+#include <string.h>
+
+static const int COMMAND_QUEUE_LENGTH = 8;
+static const int EVENT_QUEUE_LENGTH = 8;
+static const uint32_t TASK_STACK_SIZE = 8192;
+static const TaskPlacement& PLACEMENT = TASK_PLACEMENT[TASK_VESC_CONN];
+
+// Scan timing in ms: near-continuous for the device list, about 10% duty
+// while waiting for a dropped device to advertise again
+static const uint16_t LIST_SCAN_INTERVAL_MS = 100;
+static const uint16_t LIST_SCAN_WINDOW_MS = 99;
+static const uint16_t WATCH_SCAN_INTERVAL_MS = 320;
+static const uint16_t WATCH_SCAN_WINDOW_MS = 32;
+static const uint32_t FLEET_IDLE_CHECK_MS = 1000;  // Fleet mode with no VESC heard
+// The passive start of an adaptive scan: short windows back to back, so
+// each of the three advertising channels comes round quickly
+static const uint16_t PASSIVE_SCAN_INTERVAL_MS = 30;
+static const uint16_t PASSIVE_SCAN_WINDOW_MS = 30;
+static const uint32_t SCAN_POLL_MS = 20;           // A blocking adaptive scan looks for an early end this often
+
+enum ConnCommandType : uint8_t {
+    CMD_SCAN,
+    CMD_CONNECT,
+    CMD_CONNECT_LAST,
+    CMD_DISCONNECT,
+    CMD_CANCEL_RECONNECT,
+    CMD_RETRY_NOW,
+    CMD_LINK_LOST,
+    CMD_DEVICE_HEARD,
+    CMD_DROP_LINK,
+    CMD_FLEET,
+    CMD_DEVICE_FOUND,
+    CMD_NAME_NEEDED
+};
+
+struct ConnCommand {
+    ConnCommandType type;
+    uint8_t link;             // CMD_LINK_LOST, CMD_DEVICE_HEARD, CMD_DROP_LINK
+    uint8_t deviceCount;      // CMD_CONNECT
+    int8_t devices[VESC_MAX_LINKS];   // CMD_CONNECT; CMD_DEVICE_FOUND has its device first
+    uint32_t heardMs;         // CMD_DEVICE_FOUND: millis() it was first heard
+};
+
+static QueueHandle_t commandQueue = nullptr;
+static QueueHandle_t eventQueue = nullptr;
+static SemaphoreHandle_t devicesMutex = nullptr;
+
+static BleTransport* const* connLinks = nullptr;
+static uint8_t connLinkCount = 1;
+static ConnHooks hooks;
+static ConnConfig config;
+
+// Written by the scan callback on the BLE host's task, under devicesMutex
+static DeviceTable deviceTable;
+static volatile uint32_t devicesVersion = 0;
+static volatile bool backgroundScanning = false;
+
+// Owned by the task
+static ConnState state = CONN_IDLE;
+static int linkDevices[VESC_MAX_LINKS] = { -1, -1, -1 };  // Device per link, -1 if unused
+static uint32_t linkRetryMs[VESC_MAX_LINKS];                // Next attempt for a dropped secondary
+static uint32_t linkBackoffMs[VESC_MAX_LINKS];              // Wait after the next failed attempt
+static volatile uint8_t linksUp = 0;
+static uint32_t nextAttemptMs = 0;
+static uint32_t fleetDueMs[DeviceTable::MAX_DEVICES];  // Next visit per device, 0 if never visited
+// millis() of each device's last status beacon, 0 if none; under devicesMutex
+static uint32_t beaconHeardMs[DeviceTable::MAX_DEVICES];
+// The primary of the last connection, and whether hearing it should
+// connect it: armed when connecting to it straight away did not work
+static uint8_t lastUsedAddress[6];
+static char lastUsedName[sizeof(BLEDeviceInfo().name)];
+static volatile bool lastUsedKnown = false;
+static bool prewarmArmed = false;
+
+// The scan that fills the list, from the clear to the next. An adaptive
+// one starts passive and turns active when a VESC is heard without its
+// name, or after passiveScanMs. scanActive is read by the scan callback.
+struct Discovery {
+    uint32_t startedMs;
+    uint32_t firstMs;         // Into the scan the first VESC was heard, 0 if none yet
+    uint32_t expectedMs;      // ...and the last used one
+    bool active;
+};
+static Discovery discovery = { 0, 0, 0, true };
+static volatile bool scanActive = true;
+static volatile bool nameWanted = false;    // Set by the callback for an unnamed VESC heard passively
+static ScanStats scanStats;
+
+// While a link is down, a low-duty scan listens for its device; hearing
+// it advertise makes the next attempt due at once. The scan callback
+// reads the addresses and sets heardMask under watchMux.
+static portMUX_TYPE watchMux = portMUX_INITIALIZER_UNLOCKED;
+static uint8_t watchMask = 0;
+static uint8_t heardMask = 0;
+static uint8_t watchAddresses[VESC_MAX_LINKS][6];
+static bool watchScanning = false;
+
+static void noteWatchedDevice(const uint8_t* address);
+static bool noteBeacon(const uint8_t* address, const uint8_t* payload, size_t length, int rssi);
+
+// Scan results, from the BLE host (ble_host.h) with the raw advertising
+// data, so every advertiser around costs only the raw byte checks in
+// advertising.h. A background scan reports every advertisement, so a
+// known address only updates its RSSI.
+static void onAdvert(const uint8_t* address, uint8_t addressType, int rssi, const uint8_t* payload,
+                     size_t payloadLength) {
+    if (watchMask) noteWatchedDevice(address);
+    bool beaconing = config.beaconCompanyId >= 0 && noteBeacon(address, payload, payloadLength, rssi);
+    xSemaphoreTake(devicesMutex, portMAX_DELAY);
+    int index = deviceTable.find(address);
+    if (index >= 0 && deviceTable.updateRssi(index, rssi, millis())) devicesVersion++;
+    if (index >= 0 && !deviceTable.named(index)) {
+        char name[sizeof(BLEDeviceInfo().name)];
+        if (advCopyName(payload, payloadLength, name, sizeof(name))) {
+            deviceTable.rename(index, name);
+            devicesVersion++;
+        }
+    }
+    if (index >= 0 && beaconing) beaconHeardMs[index] = millis() | 1;
+    xSemaphoreGive(devicesMutex);
+    if (index >= 0) return;
+
+    // The last used VESC is known by its address, so a passive scan
+    // lists it from its first advertisement whatever that carries
+    bool lastUsed = lastUsedKnown && memcmp(address, lastUsedAddress, sizeof(lastUsedAddress)) == 0;
+    AdvMatch match = advMatchVesc(payload, payloadLength, config.scanFilter);
+    if (match == ADV_NO_MATCH && !lastUsed) return;
+
+    char name[sizeof(BLEDeviceInfo().name)];
+    bool named = advCopyName(payload, payloadLength, name, sizeof(name));
+    if (!named && lastUsed) {
+        strcpy(name, lastUsedName);
+        named = true;
+    }
+    BLEDeviceInfo device;
+    xSemaphoreTake(devicesMutex, portMAX_DELAY);
+    index = deviceTable.add(address, addressType, named ? name : nullptr, rssi, millis());
+    if (index >= 0) {
+        device = deviceTable.at(index);
+        devicesVersion++;
+    }
+    xSemaphoreGive(devicesMutex);
+    if (index < 0) {
+        LOG_W(BLE, "Device list full, ignoring %s", name);
+        return;
+    }
+    LOG_I(BLE, "Found VESC device: %s (%s) RSSI: %d, by %s", device.name, device.address, device.rssi,
+               match == ADV_NO_MATCH ? "address" : advMatchName(match));
+    // Its history is looked up on the task, which owns the GATT cache
+    ConnCommand found;
+    memset(&found, 0, sizeof(found));
+    found.type = CMD_DEVICE_FOUND;
+    found.devices[0] = (int8_t)index;
+    found.heardMs = millis();
+    xQueueSend(commandQueue, &found, 0);
+    // Its name comes in a scan response, which only an active scan asks for
+    if (!named && !scanActive && !nameWanted) {
+        nameWanted = true;
+        found.type = CMD_NAME_NEEDED;
+        xQueueSend(commandQueue, &found, 0);
+    }
+    appEventsSet(APP_EVENT_CONNECTION);
+}
+
+// Hand a status beacon to the hook. Returns true if the advertisement
+// carried one.
+static bool noteBeacon(const uint8_t* address, const uint8_t* payload, size_t length, int rssi) {
+    AdvBeacon beacon;
+    if (!advDecodeBeacon(payload, length, (uint16_t)config.beaconCompanyId, beacon)) return false;
+    if (!hooks.beacon) return true;
+    char name[sizeof(BLEDeviceInfo().name)];
+    char text[sizeof(BLEDeviceInfo().address)];
+    snprintf(text, sizeof(text), "%02x:%02x:%02x:%02x:%02x:%02x", address[0], address[1], address[2], address[3],
+             address[4], address[5]);
+    bool named = advCopyName(payload, length, name, sizeof(name));
+    hooks.beacon(named ? name : nullptr, text, rssi, beacon);
+    return true;
+}
+
+// A device a dropped link is waiting for has advertised. Called from the
+// scan callback; posts one command per link until the next attempt.
+static void noteWatchedDevice(const uint8_t* address) {
+    uint8_t newlyHeard = 0;
+    portENTER_CRITICAL(&watchMux);
+    for (uint8_t link = 0; link < VESC_MAX_LINKS; link++) {
+        uint8_t bit = 1u << link;
+        if ((watchMask & bit) && !(heardMask & bit) && memcmp(watchAddresses[link], address, 6) == 0) {
+            heardMask |= bit;
+            newlyHeard |= bit;
+        }
+    }
+    portEXIT_CRITICAL(&watchMux);
+
+    for (uint8_t link = 0; link < VESC_MAX_LINKS; link++) {
+        if (!(newlyHeard & (1u << link))) continue;
+        ConnCommand command;
+        memset(&command, 0, sizeof(command));
+        command.type = CMD_DEVICE_HEARD;
+        command.link = link;
+        xQueueSend(commandQueue, &command, 0);
+    }
+}
+
+static void setState(ConnState newState) {
+    state = newState;
+    ConnEvent event;
+    event.state = newState;
+    event.deviceIndex = linkDevices[0];
+    event.nextAttemptMs = nextAttemptMs;
+    if (xQueueSend(eventQueue, &event, 0) != pdTRUE) {
+        LOG_W(BLE, "Connection event queue full, dropped state %d", newState);
+    }
+    appEventsSet(APP_EVENT_CONNECTION);
+}
+
+static void sendCommand(const ConnCommand& command) {
+    if (!commandQueue) return;
+    if (xQueueSend(commandQueue, &command, 0) != pdTRUE) {
+        LOG_W(BLE, "Connection command queue full, dropped command %d", command.type);
+    }
+}
+
+static void sendCommand(ConnCommandType type, uint8_t link = 0) {
+    ConnCommand command;
+    memset(&command, 0, sizeof(command));
+    command.type = type;
+    command.link = link;
+    sendCommand(command);
+}
+
+static void forgetLinks() {
+    linksUp = 0;
+    for (int i = 0; i < VESC_MAX_LINKS; i++) linkDevices[i] = -1;
+}
+
+// A secondary link that should be up but is not
+static bool secondaryPending(uint8_t link) {
+    return linkDevices[link] >= 0 && !(linksUp & (1u << link));
+}
+
+static void clearDevices() {
+    xSemaphoreTake(devicesMutex, portMAX_DELAY);
+    deviceTable.clear();
+    memset(beaconHeardMs, 0, sizeof(beaconHeardMs));
+    devicesVersion++;
+    xSemaphoreGive(devicesMutex);
+}
+
+static bool copyDevice(int deviceIndex, BLEDeviceInfo& out) {
+    xSemaphoreTake(devicesMutex, portMAX_DELAY);
+    bool found = deviceIndex >= 0 && deviceIndex < deviceTable.size();
+    if (found) out = deviceTable.at(deviceIndex);
+    xSemaphoreGive(devicesMutex);
+    return found;
+}
+
+static void stopWatchScan() {
+    if (!watchScanning) return;
+    bleHostScanStop();
+    watchScanning = false;
+    portENTER_CRITICAL(&watchMux);
+    watchMask = 0;
+    portEXIT_CRITICAL(&watchMux);
+}
+
+// Start a list scan with no end, passive or active
+static bool startListScan(bool active) {
+    scanActive = active;
+    if (active) return bleHostScanStart(true, LIST_SCAN_INTERVAL_MS, LIST_SCAN_WINDOW_MS);
+    return bleHostScanStart(false, PASSIVE_SCAN_INTERVAL_MS, PASSIVE_SCAN_WINDOW_MS);
+}
+
+// A new list is being scanned for
+static void beginDiscovery() {
+    discovery.startedMs = millis();
+    discovery.firstMs = 0;
+    discovery.expectedMs = 0;
+    discovery.active = !config.adaptiveScan;
+    nameWanted = false;
+    scanStats.scans++;
+    scanStats.firstFoundMs = 0;
+    scanStats.expectedFoundMs = 0;
+}
+
+// Scan until stopped, reporting devices as they are found
+static void startBackgroundScan() {
+    if ((!config.continuousScan && state != CONN_FLEET) || backgroundScanning) return;
+    stopWatchScan();
+    // Fleet mode wants the names of everyone around from the start
+    bool active = discovery.active || state == CONN_FLEET;
+    LOG_I(BLE, "Scanning in the background%s...", active ? "" : " (passive)");
+    backgroundScanning = startListScan(active);
+    if (!backgroundScanning) LOG_W(BLE, "Background scan failed to start");
+}
+
+// Turn the list scan active, as a VESC needs its name or the passive
+// part is over. Restarting the scan is the only way to change its type.
+static void activateDiscovery(bool forName) {
+    if (discovery.active) return;
+    discovery.active = true;
+    if (forName) scanStats.activeSwitches++;
+    LOG_I(BLE, "Scan active after %u ms (%s)", (unsigned)(millis() - discovery.startedMs),
+          forName ? "a VESC without its name" : "passive part over");
+    if (!backgroundScanning && state != CONN_SCANNING) return;
+    bleHostScanStop();
+    bool started = startListScan(true);
+    if (backgroundScanning) backgroundScanning = started;
+}
+
+// Wait until the passive part of the list scan is over, 0 if it is
+static uint32_t passiveLeftMs() {
+    if (discovery.active || !backgroundScanning || state != CONN_IDLE) return 0;
+    uint32_t elapsed = millis() - discovery.startedMs;
+    return elapsed < config.passiveScanMs ? config.passiveScanMs - elapsed : 0;
+}
+
+// Connecting is quicker with the radio not also scanning
+static void stopBackgroundScan() {
+    stopWatchScan();
+    if (!backgroundScanning) return;
+    bleHostScanStop();
+    backgroundScanning = false;
+    LOG_D(BLE, "Background scan stopped");
+}
+
+// Links that are down and waiting for their next attempt
+static uint8_t linksWaiting() {
+    uint8_t waiting = 0;
+    if (state == CONN_RECONNECTING) waiting |= 1;
+    if (state == CONN_CONNECTED) {
+        for (uint8_t link = 1; link < connLinkCount; link++) {
+            if (secondaryPending(link)) waiting |= 1u << link;
+        }
+    }
+    return waiting;
+}
+
+// Run the low-duty scan while any link is waiting, listening for the
+// addresses of the waiting links
+static void updateWatchScan() {
+    uint8_t waiting = linksWaiting();
+    if (waiting == 0 || backgroundScanning) {
+        stopWatchScan();
+        return;
+    }
+
+    uint8_t addresses[VESC_MAX_LINKS][6];
+    for (uint8_t link = 0; link < VESC_MAX_LINKS; link++) {
+        BLEDeviceInfo device;
+        if (!(waiting & (1u << link))) continue;
+        if (copyDevice(linkDevices[link], device)) {
+            memcpy(addresses[link], device.bda, sizeof(device.bda));
+        } else {
+            waiting &= ~(1u << link);
+        }
+    }
+    portENTER_CRITICAL(&watchMux);
+    memcpy(watchAddresses, addresses, sizeof(addresses));
+    watchMask = waiting;
+    portEXIT_CRITICAL(&watchMux);
+
+    if (!watchScanning && waiting) {
+        // Only the addresses matter, which a passive scan hears as well
+        scanActive = !config.adaptiveScan;
+        watchScanning = bleHostScanStart(scanActive, WATCH_SCAN_INTERVAL_MS, WATCH_SCAN_WINDOW_MS);
+        LOG_D(BLE, "Listening for dropped devices (links 0x%x)", waiting);
+    }
+}
+
+// Wait before the next attempt of a link, doubling after each failure up
+// to the configured maximum
+static uint32_t nextBackoff(uint8_t link) {
+    uint32_t wait = linkBackoffMs[link];
+    uint32_t doubled = wait * 2;
+    linkBackoffMs[link] = doubled > config.reconnectMaxIntervalMs ? config.reconnectMaxIntervalMs : doubled;
+    return wait;
+}
+
+static void resetBackoff(uint8_t link) {
+    linkBackoffMs[link] = config.reconnectIntervalMs;
+}
+
+// An attempt is starting; a later advertisement should trigger again
+static void clearHeard(uint8_t link) {
+    portENTER_CRITICAL(&watchMux);
+    heardMask &= ~(1u << link);
+    portEXIT_CRITICAL(&watchMux);
+}
+
+static void runAdaptiveScan() {
+    uint32_t durationMs = config.scanSeconds * 1000;
+    if (!startListScan(false)) LOG_W(BLE, "Scan failed to start");
+    bool lastUsedHeard = false;
+    while (millis() - discovery.startedMs < durationMs && !lastUsedHeard) {
+        vTaskDelay(pdMS_TO_TICKS(SCAN_POLL_MS));
+        if (!discovery.active && (nameWanted || millis() - discovery.startedMs >= config.passiveScanMs)) {
+            activateDiscovery(nameWanted);
+        }
+        if (!lastUsedKnown) continue;
+        xSemaphoreTake(devicesMutex, portMAX_DELAY);
+        lastUsedHeard = deviceTable.find(lastUsedAddress) >= 0;
+        xSemaphoreGive(devicesMutex);
+    }
+    bleHostScanStop();
+    LOG_I(BLE, "Scan complete after %u ms, %d VESC device(s)%s", (unsigned)(millis() - discovery.startedMs),
+          deviceTable.size(), lastUsedHeard ? ", the last used one among them" : "");
+}
+
+static void runScan() {
+    forgetLinks();
+    clearDevices();
+    beginDiscovery();
+
+    if (config.continuousScan) {
+        // Devices still advertising are listed again as they are heard
+        startBackgroundScan();
+        setState(CONN_IDLE);
+        return;
+    }
+
+    setState(CONN_SCANNING);
+    LOG_I(BLE, "Starting BLE scan...");
+    if (!config.adaptiveScan) {
+        // Scan for configured duration
+        if (!startListScan(true)) LOG_W(BLE, "Scan failed to start");
+        vTaskDelay(pdMS_TO_TICKS(config.scanSeconds * 1000));
+        bleHostScanStop();
+        LOG_I(BLE, "Scan complete. Found %d UART devices.", deviceTable.size());
+        setState(CONN_IDLE);
+        return;
+    }
+
+    // Passive, then active, and over as soon as the last used VESC is
+    // heard: it is listed with its stored name, so waiting on can only
+    // find others
+    runAdaptiveScan();
+    setState(CONN_IDLE);
+}
+
+static bool connectDevice(uint8_t link, int deviceIndex) {
+    BLEDeviceInfo device;
+    if (!copyDevice(deviceIndex, device)) return false;
+
+    BleTransport& connLink = *connLinks[link];
+    LOG_I(BLE, "Connecting link %d to VESC: %s (%s)", link, device.name, device.address);
+
+    linksUp &= ~(1u << link);
+    stopBackgroundScan();
+    clearHeard(link);
+    if (hooks.beforeConnect) hooks.beforeConnect(link);
+    if (!connLink.connect(device, hooks.ready)) {
+        return false;
+    }
+
+    if (!connLink.isReady()) {
+        LOG_W(BLE, "No reply from VESC after connecting, continuing anyway");
+    }
+    LOG_I(BLE, "VESC connection %d fully established%s", link, connLink.usedCachedHandles() ? " (cached handles)" : "");
+    bleLinkLogStatus();
+    linksUp |= 1u << link;
+    resetBackoff(link);
+    return true;
+}
+
+// Bring up every secondary link that is down and due. One that fails is
+// tried again after the reconnect interval.
+static void connectSecondaries(bool onlyDue) {
+    for (uint8_t link = 1; link < connLinkCount; link++) {
+        if (!secondaryPending(link)) continue;
+        if (onlyDue && (int32_t)(linkRetryMs[link] - millis()) > 0) continue;
+        if (!connectDevice(link, linkDevices[link])) {
+            uint32_t wait = nextBackoff(link);
+            LOG_W(BLE, "Link %d failed, will retry in %u ms or when heard", link, (unsigned)wait);
+            linkRetryMs[link] = millis() + wait;
+        }
+    }
+}
+
+// Connect the primary in linkDevices, then the secondaries. On success
+// the devices are remembered for the next boot.
+static bool connectLinks() {
+    stopBackgroundScan();
+    setState(CONN_CONNECTING);
+    if (!connectDevice(0, linkDevices[0])) {
+        forgetLinks();
+        return false;
+    }
+    setState(CONN_CONNECTED);
+    connectSecondaries(false);
+
+    BLEDeviceInfo remembered[VESC_MAX_LINKS];
+    int count = 0;
+    for (uint8_t link = 0; link < connLinkCount; link++) {
+        if (copyDevice(linkDevices[link], remembered[count])) count++;
+    }
+    lastDevicesStore(remembered, count);
+    if (count > 0) {
+        memcpy(lastUsedAddress, remembered[0].bda, sizeof(lastUsedAddress));
+        strlcpy(lastUsedName, remembered[0].name, sizeof(lastUsedName));
+        lastUsedKnown = true;
+    }
+    return true;
+}
+
+// Connect the devices the UI picked, or the one found for it. On failure
+// the manager is back in CONN_IDLE with the list scanning.
+static void connectChosen() {
+    prewarmArmed = false;
+    if (!connectLinks()) {
+        // The UI returns to the device list on its own after showing the
+        // failure
+        setState(CONN_CONNECT_FAILED);
+        state = CONN_IDLE;
+        startBackgroundScan();
+    }
+}
+
+// How far into the list scan the first VESC, and the last used one,
+// were heard
+static void noteDiscoveryTime(DeviceHistory history, uint32_t heardMs) {
+    uint32_t into = heardMs - discovery.startedMs;
+    if (into == 0) into = 1;
+    const char* type = scanActive ? "active" : "passive";
+    if (discovery.firstMs == 0) {
+        discovery.firstMs = into;
+        scanStats.firstFoundMs = into;
+        LOG_D(BLE, "First VESC heard %u ms into the scan (%s)", (unsigned)into, type);
+    }
+    if (history == DEVICE_LAST_USED && discovery.expectedMs == 0) {
+        discovery.expectedMs = into;
+        scanStats.expectedFoundMs = into;
+        scanStats.expectedScans++;
+        scanStats.expectedTotalMs += into;
+        LOG_I(BLE, "Last used VESC heard %u ms into the scan (%s)", (unsigned)into, type);
+    }
+}
+
+// Rank a newly found device: the last used VESC, one with handles in the
+// GATT cache from an earlier connection, or new. While armed, the last
+// used VESC topping the list is connected without waiting for a tap.
+static void noteFoundDevice(int deviceIndex, uint32_t heardMs) {
+    BLEDeviceInfo device;
+    if (!copyDevice(deviceIndex, device)) return;
+    DeviceHistory history = DEVICE_NEW;
+    GattCacheEntry entry;
+    if (lastUsedKnown && memcmp(device.bda, lastUsedAddress, sizeof(lastUsedAddress)) == 0) {
+        history = DEVICE_LAST_USED;
+    } else if (gattCacheLookup(device.address, entry)) {
+        history = DEVICE_KNOWN;
+    }
+
+    xSemaphoreTake(devicesMutex, portMAX_DELAY);
+    bool same = deviceIndex < deviceTable.size() && memcmp(deviceTable.at(deviceIndex).bda, device.bda, 6) == 0;
+    if (same && history != DEVICE_NEW) {
+        deviceTable.setHistory(deviceIndex, history);
+        devicesVersion++;
+    }
+    int best = deviceTable.best(millis());
+    bool lastUsedFirst = best >= 0 && deviceTable.history(best) == DEVICE_LAST_USED;
+    xSemaphoreGive(devicesMutex);
+
+    if (state == CONN_IDLE || state == CONN_SCANNING) noteDiscoveryTime(history, heardMs);
+    if (!prewarmArmed || !lastUsedFirst || state != CONN_IDLE) return;
+    LOG_I(BLE, "Last used VESC heard and ranked first, connecting");
+    forgetLinks();
+    linkDevices[0] = best;
+    connectChosen();
+}
+
+// Put the devices of the last connection in the list, as if a scan had
+// found them, and assign them to links. Their address types come from
+// the GATT cache, so connecting needs no scan; without an entry random
+// is tried first, as for most VESC modules.
+static bool listLastDevices() {
+    BLEDeviceInfo stored[VESC_MAX_LINKS];
+    int count = lastDevicesLoad(stored, connLinkCount);
+    if (count == 0) return false;
+
+    forgetLinks();
+    clearDevices();
+    xSemaphoreTake(devicesMutex, portMAX_DELAY);
+    for (int i = 0; i < count; i++) {
+        uint8_t address[6];
+        if (!DeviceTable::parseAddress(stored[i].address, address)) continue;
+        int index = deviceTable.find(address);
+        if (index < 0) index = deviceTable.add(address, BLE_ADDRESS_RANDOM, stored[i].name, 0, millis());
+        linkDevices[i] = index;
+    }
+    devicesVersion++;
+    xSemaphoreGive(devicesMutex);
+
+    LOG_I(BLE, "Connecting straight to %s (%s)", stored[0].name, stored[0].address);
+    return linkDevices[0] >= 0;
+}
+
+static void attemptReconnect() {
+    LOG_I(BLE, "Attempting to reconnect...");
+    heapStatsLog("reconnect");
+
+    BLEDeviceInfo device;
+    if (!copyDevice(linkDevices[0], device)) {
+        // Device list might have changed, go back to scanning
+        LOG_W(BLE, "Device not in list, returning to scan");
+        runScan();
+        return;
+    }
+
+    if (connectDevice(0, linkDevices[0])) {
+        LOG_I(BLE, "Reconnection successful!");
+        setState(CONN_CONNECTED);
+        connectSecondaries(false);
+    } else {
+        uint32_t wait = nextBackoff(0);
+        LOG_W(BLE, "Reconnection failed, will retry in %u ms or when heard", (unsigned)wait);
+        nextAttemptMs = millis() + wait;
+        setState(CONN_RECONNECTING);
+    }
+}
+
+// The device heard lately whose visit is due soonest, the strongest of
+// those due alike; -1 if none was heard. dueMs is when it is due. One
+// whose beacons are heard needs no visit.
+static int nextFleetDevice(uint32_t now, uint32_t& dueMs) {
+    int best = -1;
+    int bestRssi = 0;
+    int32_t bestWait = 0;
+    if (config.fleetRevisitMs == 0) return -1;
+    xSemaphoreTake(devicesMutex, portMAX_DELAY);
+    for (int i = 0; i < deviceTable.size(); i++) {
+        if (now - deviceTable.lastSeenMs(i) > config.fleetHeardMs) continue;
+        if (beaconHeardMs[i] != 0 && now - beaconHeardMs[i] <= config.fleetHeardMs) continue;
+        int32_t wait = fleetDueMs[i] == 0 ? 0 : (int32_t)(fleetDueMs[i] - now);
+        if (wait < 0) wait = 0;
+        int rssi = deviceTable.at(i).rssi;
+        if (best < 0 || wait < bestWait || (wait == bestWait && rssi > bestRssi)) {
+            best = i;
+            bestWait = wait;
+            bestRssi = rssi;
+        }
+    }
+    xSemaphoreGive(devicesMutex);
+    dueMs = now + (uint32_t)bestWait;
+    return best;
+}
+
+// One fleet visit: connect, hand the link to the hook, disconnect. The
+// link is never assigned a device, so the disconnect callback's
+// CMD_LINK_LOST is ignored. The scan pauses only while connecting.
+static void visitFleetDevice(int deviceIndex) {
+    BLEDeviceInfo device;
+    if (!copyDevice(deviceIndex, device)) return;
+    uint32_t started = millis();
+    bool connected = connectDevice(0, deviceIndex);
+    uint32_t connectMs = millis() - started;
+    startBackgroundScan();
+    if (hooks.fleetVisit) hooks.fleetVisit(0, device, connected, connectMs);
+    if (connected) connLinks[0]->disconnect();
+    linksUp = 0;
+    fleetDueMs[deviceIndex] = millis() + config.fleetRevisitMs;
+    if (fleetDueMs[deviceIndex] == 0) fleetDueMs[deviceIndex] = 1;
+}
+
+static void handleCommand(const ConnCommand& command) {
+    switch (command.type) {
+        case CMD_SCAN:
+            if (state == CONN_IDLE) runScan();
+            break;
+
+        case CMD_CONNECT:
+            if (state != CONN_IDLE || command.deviceCount == 0) break;
+            forgetLinks();
+            for (uint8_t i = 0; i < command.deviceCount && i < connLinkCount; i++) {
+                linkDevices[i] = command.devices[i];
+            }
+            connectChosen();
+            break;
+
+        case CMD_CONNECT_LAST:
+            if (state != CONN_IDLE) break;
+            if (!listLastDevices()) {
+                LOG_I(BLE, "No previous VESC stored, scanning");
+                runScan();
+            } else if (!connectLinks()) {
+                // It is probably off or out of range; connect it when a
+                // scan hears it, unless the user picks another first
+                LOG_W(BLE, "Previous VESC did not answer, scanning");
+                runScan();
+                prewarmArmed = config.prewarmLast;
+            }
+            break;
+
+        case CMD_DEVICE_FOUND:
+            noteFoundDevice(command.devices[0], command.heardMs);
+            break;
+
+        case CMD_NAME_NEEDED:
+            if (state == CONN_IDLE && backgroundScanning) activateDiscovery(true);
+            break;
+
+        case CMD_FLEET:
+            if (state != CONN_IDLE) break;
+            prewarmArmed = false;
+            forgetLinks();
+            memset(fleetDueMs, 0, sizeof(fleetDueMs));
+            LOG_I(BLE, "Fleet mode: visiting VESCs heard within %u s, each every %u s",
+                  (unsigned)(config.fleetHeardMs / 1000), (unsigned)(config.fleetRevisitMs / 1000));
+            setState(CONN_FLEET);
+            startBackgroundScan();
+            break;
+
+        case CMD_DISCONNECT:
+        case CMD_CANCEL_RECONNECT:
+            prewarmArmed = false;
+            // Leave CONNECTED and forget the links first so the disconnect
+            // callbacks are not taken for dropped links
+            forgetLinks();
+            // Fleet mode scans whatever the setting; the list may not
+            if (state == CONN_FLEET && !config.continuousScan) stopBackgroundScan();
+            setState(CONN_IDLE);
+            stopWatchScan();
+            for (uint8_t link = 0; link < connLinkCount; link++) {
+                connLinks[link]->disconnect();
+            }
+            startBackgroundScan();
+            break;
+
+        case CMD_RETRY_NOW:
+            if (state == CONN_RECONNECTING) nextAttemptMs = millis();
+            break;
+
+        case CMD_LINK_LOST:
+            if (linkDevices[command.link] < 0) break;
+            linksUp &= ~(1u << command.link);
+            // The first attempt goes out at once; backing off starts
+            // with its failure
+            resetBackoff(command.link);
+            if (command.link > 0) {
+                LOG_W(BLE, "Link %d lost - retrying it", command.link);
+                linkRetryMs[command.link] = millis();
+            } else if (state == CONN_CONNECTED) {
+                LOG_W(BLE, "Link lost - reconnecting");
+                nextAttemptMs = millis();
+                setState(CONN_RECONNECTING);
+            }
+            break;
+
+        case CMD_DROP_LINK:
+            // The link stays wanted, so its disconnect callback takes the
+            // same way as a real drop
+            if (command.link < connLinkCount && (linksUp & (1u << command.link))) {
+                LOG_I(BLE, "Dropping link %d on request", command.link);
+                connLinks[command.link]->disconnect();
+            }
+            break;
+
+        case CMD_DEVICE_HEARD:
+            // Its device is advertising again, so it is in range and free
+            if (command.link == 0 && state == CONN_RECONNECTING) {
+                LOG_I(BLE, "VESC heard advertising, reconnecting now");
+                nextAttemptMs = millis();
+            } else if (command.link > 0 && state == CONN_CONNECTED && secondaryPending(command.link)) {
+                LOG_I(BLE, "Link %d device heard advertising, reconnecting now", command.link);
+                linkRetryMs[command.link] = millis();
+            }
+            break;
+    }
+}
+
+static void connectionTask(void* param) {
+    for (;;) {
+        // Sleep until a command arrives or the next reconnect attempt is due
+        TickType_t wait = portMAX_DELAY;
+        if (state == CONN_RECONNECTING) {
+            int32_t remaining = (int32_t)(nextAttemptMs - millis());
+            wait = remaining > 0 ? pdMS_TO_TICKS(remaining) : 0;
+        } else if (state == CONN_CONNECTED) {
+            for (uint8_t link = 1; link < connLinkCount; link++) {
+                if (!secondaryPending(link)) continue;
+                int32_t remaining = (int32_t)(linkRetryMs[link] - millis());
+                TickType_t ticks = remaining > 0 ? pdMS_TO_TICKS(remaining) : 0;
+                if (ticks < wait) wait = ticks;
+            }
+        } else if (state == CONN_IDLE && passiveLeftMs() > 0) {
+            wait = pdMS_TO_TICKS(passiveLeftMs());
+        } else if (state == CONN_FLEET) {
+            // Nobody heard yet: look again once the scan had a chance
+            uint32_t now = millis();
+            uint32_t dueMs = 0;
+            bool any = nextFleetDevice(now, dueMs) >= 0;
+            wait = pdMS_TO_TICKS(any ? dueMs - now : FLEET_IDLE_CHECK_MS);
+        }
+
+        ConnCommand command;
+        bool received = xQueueReceive(commandQueue, &command, wait) == pdTRUE;
+        taskBudgetStart(TASK_VESC_CONN);
+        if (received) handleCommand(command);
+
+        if (state == CONN_RECONNECTING && (int32_t)(nextAttemptMs - millis()) <= 0) {
+            attemptReconnect();
+        } else if (state == CONN_CONNECTED) {
+            connectSecondaries(true);
+        } else if (state == CONN_IDLE && backgroundScanning && !discovery.active && passiveLeftMs() == 0) {
+            activateDiscovery(false);
+        } else if (state == CONN_FLEET) {
+            uint32_t now = millis();
+            uint32_t dueMs = 0;
+            int device = nextFleetDevice(now, dueMs);
+            if (device >= 0 && dueMs == now) visitFleetDevice(device);
+        }
+        updateWatchScan();
+        taskBudgetEnd(TASK_VESC_CONN);
+    }
+}
+
+void connectionManagerBegin(BleTransport* const* vescLinks, uint8_t linkCount, const ConnHooks& connHooks,
+                            const ConnConfig& connConfig) {
+    connLinks = vescLinks;
+    connLinkCount = linkCount < 1 ? 1 : (linkCount > VESC_MAX_LINKS ? VESC_MAX_LINKS : linkCount);
+    hooks = connHooks;
+    config = connConfig;
+    if (config.reconnectMaxIntervalMs < config.reconnectIntervalMs) {
+        config.reconnectMaxIntervalMs = config.reconnectIntervalMs;
+    }
+    for (uint8_t link = 0; link < VESC_MAX_LINKS; link++) resetBackoff(link);
+    for (uint8_t link = 0; link < connLinkCount; link++) {
+        connLinks[link]->setSupervisionTimeout(config.supervisionTimeoutMs);
+        connLinks[link]->setCallDeadlines(config.callDeadlines);
+    }
+    bleCallDeadlineBegin();
+
+    commandQueue = xQueueCreate(COMMAND_QUEUE_LENGTH, sizeof(ConnCommand));
+    eventQueue = xQueueCreate(EVENT_QUEUE_LENGTH, sizeof(ConnEvent));
+    devicesMutex = xSemaphoreCreateMutex();
+    BLEDeviceInfo last;
+    lastUsedKnown = lastDevicesLoad(&last, 1) > 0 && DeviceTable::parseAddress(last.address, lastUsedAddress);
+    if (lastUsedKnown) strlcpy(lastUsedName, last.name, sizeof(lastUsedName));
+
+    // A background scan wants every advertisement, for the RSSI and the
+    // beacons. The callback reads the raw advertising data itself.
+    bleHostScanHandler(onAdvert, config.continuousScan || config.beaconCompanyId >= 0);
+
+    TaskHandle_t task = nullptr;
+    xTaskCreatePinnedToCore(connectionTask, PLACEMENT.name, TASK_STACK_SIZE, nullptr,
+                            PLACEMENT.priority, &task, PLACEMENT.core);
+    perfWatchTask(task, MEMORY_TAG_BLE);
+}
+
+void connectionManagerScan() {
+    sendCommand(CMD_SCAN);
+}
+
+void connectionManagerConnect(int deviceIndex) {
+    connectionManagerConnect(&deviceIndex, 1);
+}
+
+void connectionManagerConnect(const int* deviceIndices, int count) {
+    ConnCommand command;
+    memset(&command, 0, sizeof(command));
+    command.type = CMD_CONNECT;
+    for (int i = 0; i < count && i < VESC_MAX_LINKS; i++) {
+        command.devices[i] = (int8_t)deviceIndices[i];
+        command.deviceCount++;
+    }
+    sendCommand(command);
+}
+
+void connectionManagerConnectLast() {
+    sendCommand(CMD_CONNECT_LAST);
+}
+
+void connectionManagerDisconnect() {
+    sendCommand(CMD_DISCONNECT);
+}
+
+void connectionManagerFleet() {
+    sendCommand(CMD_FLEET);
+}
+
+void connectionManagerCancelReconnect() {
+    sendCommand(CMD_CANCEL_RECONNECT);
+}
+
+void connectionManagerRetryNow() {
+    sendCommand(CMD_RETRY_NOW);
+}
+
+void connectionManagerSetScanTime(uint32_t seconds) {
+    // One aligned word, read by the task when it starts a scan
+    config.scanSeconds = seconds > 0 ? seconds : 1;
+}
+
+void connectionManagerLinkLost(uint8_t link) {
+    sendCommand(CMD_LINK_LOST, link < VESC_MAX_LINKS ? link : 0);
+}
+
+void connectionManagerDropLink(uint8_t link) {
+    sendCommand(CMD_DROP_LINK, link);
+}
+
+uint8_t connectionManagerLinksUp() {
+    return linksUp;
+}
+
+bool connectionManagerPoll(ConnEvent& event) {
+    if (!eventQueue) return false;
+    return xQueueReceive(eventQueue, &event, 0) == pdTRUE;
+}
+
+void connectionManagerCopyDevices(DeviceList& out) {
+    xSemaphoreTake(devicesMutex, portMAX_DELAY);
+    deviceTable.copyTo(out, millis());
+    xSemaphoreGive(devicesMutex);
+}
+
+uint32_t connectionManagerDevicesVersion() {
+    return devicesVersion;
+}
+
+bool connectionManagerScanning() {
+    return backgroundScanning;
+}
+
+void connectionManagerScanStats(ScanStats& out) {
+    out = scanStats;
+}
@@ -0,0 +1,154 @@
+#pragma once
+
+#include <Arduino.h>
+#include "ble_transport.h"
+#include "device_table.h"
+#include "advertising.h"
+
+// Scan/connect/reconnect state machine, run on its own FreeRTOS task on
+// the BT core so the UI loop never blocks on the BLE stack. The UI sends
+// commands and reads state changes from a queue.
+//
+// Up to VESC_MAX_LINKS devices can be connected at once. The state
+// follows link 0, the primary; the other links are connected after it,
+// and one that drops is retried in the background while the primary
+// stays up.
+//
+// In fleet mode the manager connects nobody for good. It keeps the
+// background scan running and visits the VESCs it hears in turn on link
+// 0: connect (cached handles where it has them), let the fleet hook take
+// its snapshot, disconnect, and on to whichever is due next. A VESC that
+// sends status beacons is watched from those and not visited.
+
+enum ConnState : uint8_t {
+    CONN_IDLE,            // Showing the device list
+    CONN_SCANNING,
+    CONN_CONNECTING,
+    CONN_CONNECTED,
+    CONN_CONNECT_FAILED,  // Posted once; the manager is back in CONN_IDLE
+    CONN_RECONNECTING,
+    CONN_FLEET            // Visiting the VESCs around in turn
+};
+
+struct ConnEvent {
+    ConnState state;
+    int8_t deviceIndex;       // Primary device the state refers to, -1 if none
+    uint32_t nextAttemptMs;   // millis() of the next reconnect attempt
+};
+
+// Hooks run on the connection task, but for beacon
+struct ConnHooks {
+    void (*beforeConnect)(uint8_t link);  // Reset protocol state for a new link
+    BleTransport::ReadyCheck ready; // Wait for the VESC to answer
+    // Fleet mode: a visit to device is over. With connected set, link is
+    // up and the hook takes its snapshot before it is disconnected.
+    // connectMs is the time from starting the connect to the VESC ready.
+    void (*fleetVisit)(uint8_t link, const BLEDeviceInfo& device, bool connected, uint32_t connectMs);
+    // A status beacon was heard. Called from the scan callback on the BLE
+    // stack's task, for every advertisement that carries one; name is
+    // nullptr if this one did not.
+    void (*beacon)(const char* name, const char* address, int rssi, const AdvBeacon& beacon);
+};
+
+struct ConnConfig {
+    uint32_t scanSeconds;
+    // A dropped link is retried at once, then after reconnectIntervalMs,
+    // doubling after each failure up to reconnectMaxIntervalMs, or as
+    // soon as a low-duty scan hears its device advertise
+    uint32_t reconnectIntervalMs;
+    uint32_t reconnectMaxIntervalMs;
+    // Supervision timeout every link asks for, 0 for the profile's
+    uint32_t supervisionTimeoutMs;
+    // Longest each blocking library call of a connect may wait
+    BleCallDeadlines callDeadlines;
+    // Keep scanning in the background while the device list is up,
+    // instead of a blocking scan of scanSeconds per rescan
+    bool continuousScan;
+    AdvFilter scanFilter;     // Which advertisers are listed as VESCs
+    // Fleet mode visits each device heard within fleetHeardMs again
+    // fleetRevisitMs after its last visit; 0 visits none, for beacons only
+    uint32_t fleetRevisitMs;
+    uint32_t fleetHeardMs;
+    int32_t beaconCompanyId;  // Status beacons' company id, -1 for none
+    // When connecting straight to the last used VESC fails, connect it
+    // as soon as a scan hears it ranked first in the list
+    bool prewarmLast;
+    // Start each list scan passive, in short back-to-back windows: the
+    // last used VESC is listed by its address and stored name, and the
+    // scan turns active (for scan responses) when a VESC is heard without
+    // a name or after passiveScanMs. A blocking scan also ends once the
+    // last used VESC is heard.
+    bool adaptiveScan;
+    uint32_t passiveScanMs;
+};
+
+// How quickly the list scans found something, since boot
+struct ScanStats {
+    uint32_t scans;
+    uint32_t firstFoundMs;      // Into the latest scan the first VESC was heard, 0 if none
+    uint32_t expectedFoundMs;   // ...and the last used one
+    uint32_t expectedScans;     // Scans that heard the last used VESC
+    uint32_t expectedTotalMs;   // Their times to it, summed
+    uint32_t activeSwitches;    // Passive scans turned active early for a name
+};
+
+// Start the task with linkCount links (at most VESC_MAX_LINKS). Each must
+// already have had begin() called; their disconnect handlers should call
+// connectionManagerLinkLost().
+void connectionManagerBegin(BleTransport* const* links, uint8_t linkCount, const ConnHooks& hooks,
+                            const ConnConfig& config);
+
+// Commands from the UI. All return immediately, and do nothing before
+// connectionManagerBegin() (wired builds never call it). With continuous
+// scanning, a scan clears the list and the manager stays in CONN_IDLE
+// while devices come in.
+void connectionManagerScan();
+void connectionManagerConnect(int deviceIndex);
+
+// Connect several devices, one per link; the first is the primary
+void connectionManagerConnect(const int* deviceIndices, int count);
+
+// Connect straight to the devices of the last successful connection
+// (see last_devices.h), skipping the scan. Scans instead if none are
+// stored or the primary does not connect.
+void connectionManagerConnectLast();
+void connectionManagerDisconnect();
+
+// Start fleet mode from the device list; connectionManagerDisconnect()
+// ends it
+void connectionManagerFleet();
+void connectionManagerCancelReconnect();
+void connectionManagerRetryNow();
+
+// Change the blocking scan duration; the next scan uses it
+void connectionManagerSetScanTime(uint32_t seconds);
+
+// Report a dropped or silent link. Losing the primary starts
+// reconnecting; a secondary link is retried on its own. Safe to call from
+// the BLE stack's callbacks.
+void connectionManagerLinkLost(uint8_t link = 0);
+
+// Disconnect a link as if it had dropped, keeping its device, so it is
+// reconnected the usual way (soak testing)
+void connectionManagerDropLink(uint8_t link = 0);
+
+// Links that are connected and set up, one bit per link
+uint8_t connectionManagerLinksUp();
+
+// Next state change, if any. Does not block.
+bool connectionManagerPoll(ConnEvent& event);
+
+// Copy of the devices found by the last scan, with their rank scores
+// (see deviceScore()). Indices stay valid until the next rescan.
+void connectionManagerCopyDevices(DeviceList& out);
+
+// Changes whenever a device is added or its shown RSSI moves, so the UI
+// can refresh the list as a background scan runs
+uint32_t connectionManagerDevicesVersion();
+
+// True while a background scan is running
+bool connectionManagerScanning();
+
+// Copy of the discovery times (not locked; the fields are words, written
+// on the connection task)
+void connectionManagerScanStats(ScanStats& out);
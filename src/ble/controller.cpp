@@ -0,0 +1,30 @@
+#include "controller.h"
+#include "../log.h"
+
+#include <esp_bt.h>
+#include <esp_heap_caps.h>
+
+uint32_t bleControllerStartBleOnly() {
+    if (esp_bt_controller_get_status() != ESP_BT_CONTROLLER_STATUS_IDLE) return 0;
+
+    uint32_t before = heap_caps_get_free_size(MALLOC_CAP_INTERNAL);
+    esp_err_t err = esp_bt_controller_mem_release(ESP_BT_MODE_CLASSIC_BT);
+    if (err != ESP_OK) {
+        LOG_W(BLE, "Classic BT memory release failed (err %d)", err);
+        return 0;
+    }
+    uint32_t after = heap_caps_get_free_size(MALLOC_CAP_INTERNAL);
+    uint32_t gained = after > before ? after - before : 0;
+
+    esp_bt_controller_config_t config = BT_CONTROLLER_INIT_CONFIG_DEFAULT();
+    config.mode = ESP_BT_MODE_BLE;
+    err = esp_bt_controller_init(&config);
+    if (err == ESP_OK) err = esp_bt_controller_enable(ESP_BT_MODE_BLE);
+    if (err != ESP_OK) {
+        LOG_W(BLE, "BLE-only controller start failed (err %d)", err);
+        return 0;
+    }
+
+    LOG_I(BLE, "Controller started BLE only, %u bytes of Classic BT memory released", (unsigned)gained);
+    return gained;
+}
@@ -0,0 +1,14 @@
+#pragma once
+
+#include <stdint.h>
+
+// The dashboard only speaks BLE, but the Arduino core's default
+// controller setup is dual mode and keeps the Classic BT controller's
+// memory reserved. Starting the controller in BLE-only mode first hands
+// that memory back to the heap. BLEDevice::init() then finds the
+// controller enabled and only brings up the host.
+//
+// Call once, before BLEDevice::init(). Returns the internal heap bytes
+// gained; 0 if the controller was already up or would not start that
+// way, in which case BLEDevice::init() starts it as usual.
+uint32_t bleControllerStartBleOnly();
@@ -0,0 +1,138 @@
+#include "device_table.h"
+
+#include <stdio.h>
+#include <string.h>
+
+static_assert(DeviceTable::MAX_DEVICES <= 16, "the named devices must fit a uint16_t mask");
+
+// Each reading moves the average a quarter of the way
+static const int RSSI_SMOOTHING_SHIFT = 2;
+
+// Ranking, in dB of signal: a device connected before outranks a new one
+// up to 10 dB stronger, the last used one up to 20 dB. One not heard for
+// STALE_AFTER_MS loses a dB every STALE_MS_PER_DB, up to STALE_MAX_DB.
+static const int32_t KNOWN_BONUS_DB = 10;
+static const int32_t LAST_USED_BONUS_DB = 20;
+static const uint32_t STALE_AFTER_MS = 2000;
+static const uint32_t STALE_MS_PER_DB = 500;
+static const int32_t STALE_MAX_DB = 40;
+
+int32_t deviceScore(int rssi, DeviceHistory history, uint32_t ageMs) {
+    int32_t score = rssi;
+    if (history == DEVICE_KNOWN) score += KNOWN_BONUS_DB;
+    if (history == DEVICE_LAST_USED) score += LAST_USED_BONUS_DB;
+    if (ageMs > STALE_AFTER_MS) {
+        uint32_t stale = (ageMs - STALE_AFTER_MS) / STALE_MS_PER_DB;
+        score -= stale > (uint32_t)STALE_MAX_DB ? STALE_MAX_DB : (int32_t)stale;
+    }
+    return score;
+}
+
+DeviceTable::DeviceTable() {
+    clear();
+}
+
+void DeviceTable::clear() {
+    count = 0;
+    namedMask = 0;
+    memset(slots, -1, sizeof(slots));
+}
+
+uint32_t DeviceTable::hash(const uint8_t* address) {
+    // FNV-1a; the low bytes of an address are the random part, so mixing
+    // all six spreads vendors that share a prefix
+    uint32_t h = 2166136261u;
+    for (int i = 0; i < 6; i++) {
+        h ^= address[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+int DeviceTable::find(const uint8_t* address) const {
+    for (uint32_t probe = hash(address), n = 0; n < SLOTS; probe++, n++) {
+        int index = slots[probe & (SLOTS - 1)];
+        if (index < 0) return -1;
+        if (memcmp(devices[index].bda, address, 6) == 0) return index;
+    }
+    return -1;
+}
+
+int DeviceTable::add(const uint8_t* address, uint8_t addressType, const char* name, int rssi, uint32_t nowMs) {
+    if (count >= MAX_DEVICES) return -1;
+
+    uint32_t probe = hash(address);
+    while (slots[probe & (SLOTS - 1)] >= 0) probe++;
+    int index = count++;
+    slots[probe & (SLOTS - 1)] = (int8_t)index;
+
+    BLEDeviceInfo& device = devices[index];
+    memcpy(device.bda, address, 6);
+    device.addressType = addressType;
+    device.name[0] = '\0';
+    if (name) {
+        rename(index, name);
+    } else {
+        strcpy(device.name, "Unnamed VESC");
+        namedMask &= ~(1u << index);
+    }
+    snprintf(device.address, sizeof(device.address), "%02x:%02x:%02x:%02x:%02x:%02x",
+             address[0], address[1], address[2], address[3], address[4], address[5]);
+    device.rssi = rssi;
+    rssiQ4[index] = (int16_t)(rssi * 16);
+    seenMs[index] = nowMs;
+    histories[index] = DEVICE_NEW;
+    return index;
+}
+
+void DeviceTable::rename(int index, const char* name) {
+    BLEDeviceInfo& device = devices[index];
+    strncpy(device.name, name, sizeof(device.name) - 1);
+    device.name[sizeof(device.name) - 1] = '\0';
+    namedMask |= 1u << index;
+}
+
+bool DeviceTable::updateRssi(int index, int rssi, uint32_t nowMs) {
+    seenMs[index] = nowMs;
+    rssiQ4[index] += (int16_t)((rssi * 16 - rssiQ4[index]) >> RSSI_SMOOTHING_SHIFT);
+
+    // Round to the nearest dBm
+    int shown = (rssiQ4[index] + (rssiQ4[index] < 0 ? -8 : 8)) / 16;
+    if (shown == devices[index].rssi) return false;
+    devices[index].rssi = shown;
+    return true;
+}
+
+int32_t DeviceTable::score(int index, uint32_t nowMs) const {
+    return deviceScore(devices[index].rssi, history(index), nowMs - seenMs[index]);
+}
+
+int DeviceTable::best(uint32_t nowMs) const {
+    int best = -1;
+    int32_t bestScore = 0;
+    for (int i = 0; i < count; i++) {
+        int32_t s = score(i, nowMs);
+        if (best < 0 || s > bestScore) {
+            best = i;
+            bestScore = s;
+        }
+    }
+    return best;
+}
+
+void DeviceTable::copyTo(DeviceList& out, uint32_t nowMs) const {
+    memcpy(out.devices, devices, count * sizeof(BLEDeviceInfo));
+    for (int i = 0; i < count; i++) out.scores[i] = score(i, nowMs);
+    out.count = count;
+}
+
+bool DeviceTable::parseAddress(const char* text, uint8_t* address) {
+    unsigned int bytes[6];
+    char end;
+    if (sscanf(text, "%2x:%2x:%2x:%2x:%2x:%2x%c", &bytes[0], &bytes[1], &bytes[2],
+               &bytes[3], &bytes[4], &bytes[5], &end) != 6) {
+        return false;
+    }
+    for (int i = 0; i < 6; i++) address[i] = (uint8_t)bytes[i];
+    return true;
+}
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Address types, the same numbers in either BLE host's API
+const uint8_t BLE_ADDRESS_PUBLIC = 0;
+const uint8_t BLE_ADDRESS_RANDOM = 1;
+
+// Structure to store BLE device information. Fixed-size so copying the
+// list to the UI does not allocate per device. The address is kept both
+// ways: as bytes to connect with and as text to show, log and key the
+// GATT cache by.
+struct BLEDeviceInfo {
+    char name[32];
+    char address[18];     // "aa:bb:cc:dd:ee:ff"
+    uint8_t bda[6];       // The same address, as the stack takes it
+    uint8_t addressType;  // BLE_ADDRESS_PUBLIC or _RANDOM, as it advertised
+    int rssi;             // Smoothed over the advertisements seen
+};
+
+struct DeviceList;
+
+// What the dashboard remembers of a device, for ranking the list
+enum DeviceHistory : uint8_t {
+    DEVICE_NEW,
+    DEVICE_KNOWN,       // Connected before; it has a GATT cache entry
+    DEVICE_LAST_USED    // The primary of the last connection
+};
+
+// Where a device ranks in the list, higher first: its smoothed RSSI in
+// dBm, plus a bonus for one connected before and a bigger one for the
+// last used, less a penalty growing with the time since it was heard
+int32_t deviceScore(int rssi, DeviceHistory history, uint32_t ageMs);
+
+// Devices found by scanning, one entry per address however often it
+// advertises. Indices are stable until clear(), so the UI can keep
+// pointing at a device while a background scan runs. Addresses are
+// looked up in a small open-addressed hash table; nothing allocates.
+// Not thread safe; the owner locks around it.
+class DeviceTable {
+public:
+    static const int MAX_DEVICES = 16;
+
+    DeviceTable();
+
+    void clear();
+
+    // Index of a known address, or -1
+    int find(const uint8_t* address) const;
+
+    // Add a device. Returns its index, or -1 if the table is full. A
+    // nullptr name lists it as "Unnamed VESC" until rename().
+    int add(const uint8_t* address, uint8_t addressType, const char* name, int rssi, uint32_t nowMs);
+
+    // Give an unnamed device the name a later advertisement carried
+    void rename(int index, const char* name);
+    bool named(int index) const { return (namedMask & (1u << index)) != 0; }
+
+    // Fold a new reading into a known device's RSSI. Returns true if the
+    // smoothed value shown to the user changed.
+    bool updateRssi(int index, int rssi, uint32_t nowMs);
+
+    int size() const { return count; }
+    const BLEDeviceInfo& at(int index) const { return devices[index]; }
+    uint32_t lastSeenMs(int index) const { return seenMs[index]; }
+
+    // Devices are added as DEVICE_NEW; the owner looks up their history
+    void setHistory(int index, DeviceHistory value) { histories[index] = value; }
+    DeviceHistory history(int index) const { return (DeviceHistory)histories[index]; }
+
+    int32_t score(int index, uint32_t nowMs) const;
+
+    // The device ranked first, -1 if there are none
+    int best(uint32_t nowMs) const;
+
+    // Copy the devices and their scores at nowMs
+    void copyTo(DeviceList& out, uint32_t nowMs) const;
+
+    // Parse "aa:bb:cc:dd:ee:ff" into 6 bytes. Returns false if malformed.
+    static bool parseAddress(const char* text, uint8_t* address);
+
+private:
+    static const int SLOTS = 32;  // Power of two, a good deal above MAX_DEVICES
+
+    static uint32_t hash(const uint8_t* address);
+
+    BLEDeviceInfo devices[MAX_DEVICES];
+    int16_t rssiQ4[MAX_DEVICES];     // Exponential average, in 1/16 dBm
+    uint32_t seenMs[MAX_DEVICES];
+    uint8_t histories[MAX_DEVICES];  // DeviceHistory
+    uint16_t namedMask;              // Devices listed under their own name
+    int8_t slots[SLOTS];             // Device index per hash slot, -1 if empty
+    int count;
+};
+
+// A copy of the table for the UI, sized for the whole table so refreshing
+// it never allocates
+struct DeviceList {
+    BLEDeviceInfo devices[DeviceTable::MAX_DEVICES];
+    int32_t scores[DeviceTable::MAX_DEVICES];   // deviceScore() when copied
+    int count;
+
+    DeviceList() : count(0) {}
+
+    int size() const { return count; }
+    bool empty() const { return count == 0; }
+    const BLEDeviceInfo& operator[](int index) const { return devices[index]; }
+};
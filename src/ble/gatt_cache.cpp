@@ -0,0 +1,111 @@
+#include "gatt_cache.h"
+#include "../log.h"
+
+#include <Arduino.h>
+#include <Preferences.h>
+
+static const char* NVS_NAMESPACE = "gattcache";
+static const uint8_t ENTRY_VERSION = 2;
+static const int RAM_SLOTS = 4;
+
+struct StoredEntry {
+    uint8_t version;
+    GattCacheEntry entry;
+};
+
+struct RamSlot {
+    bool used;
+    char key[13];
+    GattCacheEntry entry;
+};
+
+static RamSlot ramSlots[RAM_SLOTS];
+static int nextRamSlot = 0;
+
+// NVS keys are limited to 15 characters, so use the address without colons
+static void makeKey(const char* address, char* key) {
+    int n = 0;
+    for (const char* p = address; *p && n < 12; p++) {
+        if (*p != ':') key[n++] = tolower(*p);
+    }
+    key[n] = '\0';
+}
+
+static RamSlot* findRamSlot(const char* key) {
+    for (int i = 0; i < RAM_SLOTS; i++) {
+        if (ramSlots[i].used && strcmp(ramSlots[i].key, key) == 0) return &ramSlots[i];
+    }
+    return nullptr;
+}
+
+static void putRamSlot(const char* key, const GattCacheEntry& entry) {
+    RamSlot* slot = findRamSlot(key);
+    if (!slot) {
+        slot = &ramSlots[nextRamSlot];
+        nextRamSlot = (nextRamSlot + 1) % RAM_SLOTS;
+    }
+    slot->used = true;
+    strcpy(slot->key, key);
+    slot->entry = entry;
+}
+
+bool gattCacheLookup(const char* address, GattCacheEntry& entry) {
+    char key[13];
+    makeKey(address, key);
+
+    RamSlot* slot = findRamSlot(key);
+    if (slot) {
+        entry = slot->entry;
+        return true;
+    }
+
+    Preferences prefs;
+    if (!prefs.begin(NVS_NAMESPACE, true)) return false;
+    StoredEntry stored;
+    size_t n = prefs.getBytes(key, &stored, sizeof(stored));
+    prefs.end();
+    if (n != sizeof(stored) || stored.version != ENTRY_VERSION) return false;
+
+    putRamSlot(key, stored.entry);
+    entry = stored.entry;
+    return true;
+}
+
+void gattCacheStore(const char* address, const GattCacheEntry& entry) {
+    char key[13];
+    makeKey(address, key);
+
+    // Skip the flash write when nothing changed
+    RamSlot* slot = findRamSlot(key);
+    if (slot && memcmp(&slot->entry, &entry, sizeof(entry)) == 0) return;
+    putRamSlot(key, entry);
+
+    StoredEntry stored;
+    memset(&stored, 0, sizeof(stored));
+    stored.version = ENTRY_VERSION;
+    stored.entry = entry;
+
+    Preferences prefs;
+    if (!prefs.begin(NVS_NAMESPACE, false)) {
+        LOG_W(BLE, "Could not open NVS to cache GATT handles");
+        return;
+    }
+    prefs.putBytes(key, &stored, sizeof(stored));
+    prefs.end();
+    LOG_D(BLE, "Cached GATT handles for %s (tx 0x%04X rx 0x%04X cccd 0x%04X%s)",
+          address, entry.txHandle, entry.rxHandle, entry.cccdHandle, entry.rxNoResponse ? ", write no response" : "");
+}
+
+void gattCacheForget(const char* address) {
+    char key[13];
+    makeKey(address, key);
+
+    RamSlot* slot = findRamSlot(key);
+    if (slot) slot->used = false;
+
+    Preferences prefs;
+    if (prefs.begin(NVS_NAMESPACE, false)) {
+        prefs.remove(key);
+        prefs.end();
+    }
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+// What we learned about a VESC the last time full discovery succeeded.
+// Kept in RAM and in NVS so a reconnect (even after a reboot) can skip
+// the address type probe and, where the backend can attach to known
+// handles (gatt_direct.h, Bluedroid), the GATT service search.
+struct GattCacheEntry {
+    uint8_t addrType;        // Address type that connected (BLE_ADDRESS_*)
+    uint16_t txHandle;       // NUS TX characteristic value (notifications)
+    uint16_t rxHandle;       // NUS RX characteristic value (writes)
+    uint16_t cccdHandle;     // Client configuration descriptor of TX
+    uint8_t rxNoResponse;    // RX accepts write without response
+};
+
+// Cached entry for a device address ("aa:bb:cc:dd:ee:ff"). Checks RAM
+// first, then NVS.
+bool gattCacheLookup(const char* address, GattCacheEntry& entry);
+void gattCacheStore(const char* address, const GattCacheEntry& entry);
+void gattCacheForget(const char* address);
@@ -0,0 +1,168 @@
+#include "gatt_direct.h"
+#include "../log.h"
+
+#include <Arduino.h>
+#include "BLEDevice.h"
+#include <esp_gattc_api.h>
+#include <esp_gap_ble_api.h>
+
+// A with-response write not confirmed by then is given up on, so a lost
+// confirmation cannot stop writes for the rest of the connection
+static const uint32_t WRITE_CONFIRM_TIMEOUT_MS = 1000;
+
+// Attached links by connection id (the ACL link index, below the stack's
+// connection limit), written by the connection task
+static const int MAX_CONN_IDS = 9;
+static GattDirect* volatile directByConn[MAX_CONN_IDS];
+
+static IRAM_ATTR GattDirect* directFor(uint16_t connId) {
+    return connId < MAX_CONN_IDS ? directByConn[connId] : nullptr;
+}
+
+// In IRAM with the framer (vesc/hot_path.h), so notifications reach the
+// queue without waiting on flash
+static IRAM_ATTR void gattcEventHandler(esp_gattc_cb_event_t event, esp_gatt_if_t gattcIf, esp_ble_gattc_cb_param_t* param) {
+    if (event == ESP_GATTC_NOTIFY_EVT) {
+        GattDirect* direct = directFor(param->notify.conn_id);
+        if (direct && direct->active && param->notify.handle == direct->txHandle) {
+            direct->handler(direct->link, param->notify.value, param->notify.value_len);
+        }
+    } else if (event == ESP_GATTC_WRITE_DESCR_EVT) {
+        GattDirect* direct = directFor(param->write.conn_id);
+        if (direct && param->write.handle == direct->cccdHandle) {
+            direct->cccdWriteStatus = param->write.status;
+            direct->cccdWriteDone = true;
+        }
+    } else if (event == ESP_GATTC_WRITE_CHAR_EVT) {
+        GattDirect* direct = directFor(param->write.conn_id);
+        if (direct && param->write.handle == direct->rxHandle) {
+            if (param->write.status != ESP_GATT_OK) direct->writeErrors++;
+            direct->writePending = false;
+        }
+    } else if (event == ESP_GATTC_CONGEST_EVT) {
+        GattDirect* direct = directFor(param->congest.conn_id);
+        if (direct) direct->congested = param->congest.congested;
+    } else if (event == ESP_GATTC_DISCONNECT_EVT) {
+        GattDirect* direct = directFor(param->disconnect.conn_id);
+        if (direct) {
+            direct->active = false;
+            direct->writeReady = false;
+        }
+    }
+}
+
+void gattDirectInit() {
+    BLEDevice::setCustomGattcHandler(gattcEventHandler);
+}
+
+bool gattDirectAttach(GattDirect& direct, BLEClient* client, const GattCacheEntry& entry,
+                      GattNotifyHandler handler, uint8_t link, uint32_t timeoutMs) {
+    esp_gatt_if_t gattcIf = client->getGattcIf();
+    uint16_t connId = client->getConnId();
+    if (connId >= MAX_CONN_IDS) return false;
+
+    direct.active = false;
+    direct.connId = connId;
+    direct.handler = handler;
+    direct.link = link;
+    direct.txHandle = entry.txHandle;
+    direct.rxHandle = entry.rxHandle;
+    direct.cccdHandle = entry.cccdHandle;
+    direct.cccdWriteDone = false;
+    directByConn[connId] = &direct;
+
+    esp_err_t err = esp_ble_gattc_register_for_notify(gattcIf, *client->getPeerAddress().getNative(), entry.txHandle);
+    if (err != ESP_OK) {
+        LOG_W(BLE, "Register for notify on cached handle failed (err %d)", err);
+        gattDirectDetach(direct, client);
+        return false;
+    }
+
+    uint8_t notifyValue[] = {0x01, 0x00};
+    err = esp_ble_gattc_write_char_descr(gattcIf, connId, entry.cccdHandle, sizeof(notifyValue),
+                                         notifyValue, ESP_GATT_WRITE_TYPE_RSP, ESP_GATT_AUTH_REQ_NONE);
+    if (err != ESP_OK) {
+        LOG_W(BLE, "CCCD write on cached handle failed to start (err %d)", err);
+        gattDirectDetach(direct, client);
+        return false;
+    }
+
+    unsigned long start = millis();
+    while (!direct.cccdWriteDone && millis() - start < timeoutMs) {
+        if (!client->isConnected()) break;
+        delay(2);
+    }
+
+    if (!direct.cccdWriteDone || direct.cccdWriteStatus != ESP_GATT_OK) {
+        LOG_W(BLE, "Cached CCCD handle rejected (%s, status %d)",
+              direct.cccdWriteDone ? "error" : "timeout", direct.cccdWriteStatus);
+        gattDirectDetach(direct, client);
+        return false;
+    }
+
+    direct.active = true;
+    return true;
+}
+
+void gattDirectDetach(GattDirect& direct, BLEClient* client) {
+    if (client && direct.txHandle != 0 && client->isConnected()) {
+        esp_ble_gattc_unregister_for_notify(client->getGattcIf(), *client->getPeerAddress().getNative(), direct.txHandle);
+    }
+    direct.active = false;
+    direct.writeReady = false;
+    if (direct.connId < MAX_CONN_IDS && directByConn[direct.connId] == &direct) {
+        directByConn[direct.connId] = nullptr;
+    }
+    direct.txHandle = 0;
+    direct.rxHandle = 0;
+    direct.cccdHandle = 0;
+}
+
+void gattWriteBegin(GattDirect& direct, BLEClient* client, uint16_t rxHandle, bool noResponse) {
+    uint16_t connId = client->getConnId();
+    if (connId >= MAX_CONN_IDS) return;
+
+    direct.connId = connId;
+    direct.rxHandle = rxHandle;
+    direct.writeNoResponse = noResponse;
+    direct.writePending = false;
+    direct.congested = false;
+    directByConn[connId] = &direct;
+    direct.writeReady = true;
+}
+
+bool gattWrite(GattDirect& direct, BLEClient* client, const uint8_t* data, size_t length) {
+    if (!direct.writeReady) return false;
+
+    // Each write without response takes a controller buffer until it is
+    // on air; with response, only one write is outstanding at a time
+    bool busy;
+    if (direct.writeNoResponse) {
+        busy = direct.congested || esp_ble_get_cur_sendable_packets_num(direct.connId) == 0;
+    } else {
+        if (direct.writePending && millis() - direct.writeStartedMs > WRITE_CONFIRM_TIMEOUT_MS) {
+            direct.writePending = false;
+            direct.writeErrors++;
+        }
+        busy = direct.writePending;
+    }
+    if (busy) {
+        direct.writesDeferred++;
+        return false;
+    }
+
+    if (!direct.writeNoResponse) {
+        direct.writePending = true;
+        direct.writeStartedMs = millis();
+    }
+    esp_err_t err = esp_ble_gattc_write_char(client->getGattcIf(), direct.connId, direct.rxHandle, length,
+                                             (uint8_t*)data,
+                                             direct.writeNoResponse ? ESP_GATT_WRITE_TYPE_NO_RSP : ESP_GATT_WRITE_TYPE_RSP,
+                                             ESP_GATT_AUTH_REQ_NONE);
+    if (err != ESP_OK) {
+        direct.writePending = false;
+        direct.writeErrors++;
+        return false;
+    }
+    return true;
+}
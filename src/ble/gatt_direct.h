@@ -0,0 +1,64 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include "BLEClient.h"
+#include "gatt_cache.h"
+
+// The Bluedroid link's own GATT client path (bluedroid_link.h): the
+// UART's notifications taken from the GATTC event, and its writes sent
+// through the GATTC API, by connection id and handle.
+
+// Notification bytes from a link, tagged with the link's index
+typedef void (*GattNotifyHandler)(uint8_t link, const uint8_t* data, size_t length);
+
+// Direct-path state of one link, owned by its BluedroidLink. The GATTC
+// handler finds it by connection id, so a notification costs an array
+// index however many links are up. Writes always go through it (see
+// gattWriteBegin()), whichever way the handles were found.
+struct GattDirect {
+    volatile bool active;        // Notifications routed here
+    uint16_t connId;
+    uint16_t txHandle;
+    uint16_t rxHandle;
+    uint16_t cccdHandle;
+    volatile bool cccdWriteDone;
+    volatile int cccdWriteStatus;
+    GattNotifyHandler handler;
+    uint8_t link;
+
+    // Writes to RX. With-response writes are sent asynchronously, one at a
+    // time; without response the stack's free buffers and congestion
+    // flag pace them.
+    bool writeReady;
+    bool writeNoResponse;
+    volatile bool writePending;  // With-response write awaiting its confirmation
+    volatile bool congested;
+    uint32_t writeStartedMs;
+    uint32_t writesDeferred;     // Refused because the link was busy
+    uint32_t writeErrors;
+};
+
+// Register the GATTC handler used by the direct path. Call once after
+// BLEDevice::init().
+void gattDirectInit();
+
+// Enable notifications on known handles of a connected client (cached,
+// or just discovered) through the GATTC API. Waits for the CCCD write response; on success
+// notifications go to handler, tagged with link, and writes must use
+// gattDirectWrite().
+bool gattDirectAttach(GattDirect& direct, BLEClient* client, const GattCacheEntry& entry,
+                      GattNotifyHandler handler, uint8_t link, uint32_t timeoutMs);
+
+// Stop routing notifications for the direct path
+void gattDirectDetach(GattDirect& direct, BLEClient* client);
+
+// Route writes for a connected client to rxHandle, with or without
+// response. The cached path's attach sets the handles; call this after
+// either path has found them.
+void gattWriteBegin(GattDirect& direct, BLEClient* client, uint16_t rxHandle, bool noResponse);
+
+// Queue one write to RX without blocking. Returns false, counting it as
+// deferred, while the previous with-response write is unconfirmed or the
+// stack has no buffer free; the caller keeps the data and tries again.
+bool gattWrite(GattDirect& direct, BLEClient* client, const uint8_t* data, size_t length);
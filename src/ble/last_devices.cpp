@@ -0,0 +1,70 @@
+#include "last_devices.h"
+#include "ble_transport.h"
+#include "../log.h"
+
+#include <Preferences.h>
+#include <string.h>
+
+static const char* NVS_NAMESPACE = "lastdev";
+static const char* NVS_KEY = "devices";
+static const uint8_t STORED_VERSION = 1;
+
+struct StoredDevices {
+    uint8_t version;
+    uint8_t count;
+    BLEDeviceInfo devices[VESC_MAX_LINKS];
+};
+
+static bool loadStored(StoredDevices& stored) {
+    Preferences prefs;
+    if (!prefs.begin(NVS_NAMESPACE, true)) return false;
+    size_t n = prefs.getBytes(NVS_KEY, &stored, sizeof(stored));
+    prefs.end();
+    return n == sizeof(stored) && stored.version == STORED_VERSION && stored.count <= VESC_MAX_LINKS;
+}
+
+int lastDevicesLoad(BLEDeviceInfo* out, int maxCount) {
+    StoredDevices stored;
+    if (!loadStored(stored)) return 0;
+
+    int count = stored.count < maxCount ? stored.count : maxCount;
+    for (int i = 0; i < count; i++) {
+        out[i] = stored.devices[i];
+        // Stored by an older build or corrupted; never trust the strings
+        out[i].name[sizeof(out[i].name) - 1] = '\0';
+        out[i].address[sizeof(out[i].address) - 1] = '\0';
+    }
+    return count;
+}
+
+void lastDevicesStore(const BLEDeviceInfo* devices, int count) {
+    StoredDevices stored;
+    memset(&stored, 0, sizeof(stored));
+    stored.version = STORED_VERSION;
+    stored.count = count < VESC_MAX_LINKS ? count : VESC_MAX_LINKS;
+    for (int i = 0; i < stored.count; i++) {
+        strlcpy(stored.devices[i].name, devices[i].name, sizeof(stored.devices[i].name));
+        strlcpy(stored.devices[i].address, devices[i].address, sizeof(stored.devices[i].address));
+    }
+
+    // RSSI is not stored, so a reconnect to the same devices compares equal
+    StoredDevices previous;
+    if (loadStored(previous) && memcmp(&previous, &stored, sizeof(stored)) == 0) return;
+
+    Preferences prefs;
+    if (!prefs.begin(NVS_NAMESPACE, false)) {
+        LOG_W(BLE, "Could not open NVS to remember the last devices");
+        return;
+    }
+    prefs.putBytes(NVS_KEY, &stored, sizeof(stored));
+    prefs.end();
+    LOG_D(BLE, "Remembered %d device(s), primary %s", stored.count, stored.devices[0].address);
+}
+
+void lastDevicesForget() {
+    Preferences prefs;
+    if (prefs.begin(NVS_NAMESPACE, false)) {
+        prefs.remove(NVS_KEY);
+        prefs.end();
+    }
+}
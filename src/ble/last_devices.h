@@ -0,0 +1,19 @@
+#pragma once
+
+#include <stdint.h>
+#include "device_table.h"
+
+// The devices of the last successful connection, one per link with the
+// primary first, kept in NVS so the next boot can connect straight to
+// them without scanning. Their address types and GATT handles are in the
+// GATT cache (gatt_cache.h), keyed by address.
+
+// Load into out (room for maxCount). Returns how many were stored, 0 if
+// none.
+int lastDevicesLoad(BLEDeviceInfo* out, int maxCount);
+
+// Remember a connection's devices. Skips the flash write when they are
+// already stored.
+void lastDevicesStore(const BLEDeviceInfo* devices, int count);
+
+void lastDevicesForget();
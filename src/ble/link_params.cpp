@@ -0,0 +1,24 @@
+#include "link_params.h"
+#include "../log.h"
+
+const BleLinkProfile BLE_PROFILE_PERFORMANCE = { "performance", 6, 12, 0, 200 };
+const BleLinkProfile BLE_PROFILE_BALANCED = { "balanced", 12, 24, 0, 400 };
+const BleLinkProfile BLE_PROFILE_POWER_SAVE = { "power-save", 40, 80, 4, 600 };
+
+volatile BleLinkStatus bleLinkStatus = { 23, 0, 0, 0 };
+
+// The supervision timeout must exceed (1 + latency) * max interval * 2,
+// and 100 ms. Intervals are 1.25 ms units, the timeout 10 ms units.
+uint16_t bleLinkSupervisionTimeout(const BleLinkProfile& profile, uint32_t supervisionMs) {
+    uint32_t timeout = supervisionMs > 0 ? (supervisionMs + 9) / 10 : profile.timeout;
+    uint32_t least = ((uint32_t)profile.latency + 1) * profile.maxInterval / 4 + 1;
+    if (least < 10) least = 10;
+    if (timeout < least) timeout = least;
+    return timeout > 3200 ? 3200 : (uint16_t)timeout;
+}
+
+void bleLinkLogStatus() {
+    LOG_I(BLE, "Link: MTU %d, interval %.2fms, latency %d, timeout %dms",
+          bleLinkStatus.mtu, bleLinkStatus.interval * 1.25f,
+          bleLinkStatus.latency, bleLinkStatus.timeout * 10);
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <stdint.h>
+
+// Connection parameter profiles, trading latency against power.
+// Intervals are in 1.25 ms units, supervision timeout in 10 ms units.
+struct BleLinkProfile {
+    const char* name;
+    uint16_t minInterval;
+    uint16_t maxInterval;
+    uint16_t latency;        // Connection events the peripheral may skip
+    uint16_t timeout;
+};
+
+extern const BleLinkProfile BLE_PROFILE_PERFORMANCE;  // 7.5-15 ms, no latency
+extern const BleLinkProfile BLE_PROFILE_BALANCED;     // 15-30 ms
+extern const BleLinkProfile BLE_PROFILE_POWER_SAVE;   // 50-100 ms, latency 4
+
+// Values actually in effect on the current link, as the BLE host
+// (ble_host.h) last reported them
+struct BleLinkStatus {
+    uint16_t mtu;
+    uint16_t interval;       // 1.25 ms units, 0 until the controller reports it
+    uint16_t latency;
+    uint16_t timeout;        // 10 ms units
+};
+
+extern volatile BleLinkStatus bleLinkStatus;
+
+// Supervision timeout for a profile in 10 ms units: supervisionMs, or the
+// profile's own if 0, raised to the least the spec allows for the
+// profile's longest interval and latency
+uint16_t bleLinkSupervisionTimeout(const BleLinkProfile& profile, uint32_t supervisionMs);
+
+// Log the negotiated MTU and connection parameters
+void bleLinkLogStatus();
@@ -0,0 +1,383 @@
+#include "log_service.h"
+#include "../storage/log_format.h"
+#include "../log.h"
+#include "../system/coexist.h"
+#include "../system/perf_stats.h"
+#include "../system/spi_bus.h"
+#include "../system/task_layout.h"
+
+#include <Arduino.h>
+#include <SD.h>
+#include "BLEDevice.h"
+#include "BLEServer.h"
+#include "BLE2902.h"
+#include "../system/memory.h"
+#include <esp_gap_ble_api.h>
+#include <esp_system.h>
+#include <esp_gatts_api.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <string.h>
+
+static const char* LOG_DIRECTORY = "/logs";
+static const char* LOG_EXTENSION = ".vdl";
+static const size_t READ_SLICE = 4096;        // Card reads per SPI bus hold; the LCD shares the bus
+static const uint32_t READ_SLICE_MS = 4;      // What one takes, kept clear of the next render
+static const uint16_t MAX_RECORD = 512;       // Largest notification, the most an ATT MTU of 517 carries
+static const size_t DATA_HEADER = 5;          // 0x20 and the offset
+static const uint32_t SEND_TIMEOUT_MS = 2000; // Refused records before a read is given up
+static const uint32_t TASK_STACK_SIZE = 6144;
+static const TaskPlacement& PLACEMENT = TASK_PLACEMENT[TASK_LOG_SERVICE];
+
+static BLEUUID serviceUuid(LOG_SERVICE_UUID);
+static BLEUUID controlUuid("5644ab01-6c6f-4773-9a2e-76657363d001");
+static BLEUUID dataUuid("5644ab02-6c6f-4773-9a2e-76657363d001");
+
+enum Command : uint8_t {
+    CMD_LIST = 0x01,
+    CMD_READ = 0x02,
+    CMD_CANCEL = 0x03
+};
+
+enum Record : uint8_t {
+    RECORD_LOG = 0x10,
+    RECORD_LIST_END = 0x11,
+    RECORD_DATA = 0x20,
+    RECORD_READ_END = 0x21,
+    RECORD_ERROR = 0x2F
+};
+
+struct Request {
+    Command command;
+    uint16_t number;
+    uint32_t offset;
+    uint32_t length;
+};
+
+static BLEServer* server = nullptr;
+static BLECharacteristic* dataCharacteristic = nullptr;
+static BleLinkProfile linkProfile;
+static TaskHandle_t task = nullptr;
+static uint8_t* slice = nullptr;
+
+// Written on the BT task, read by the service task
+static portMUX_TYPE stateMux = portMUX_INITIALIZER_UNLOCKED;
+static volatile bool connected = false;
+static volatile bool congested = false;
+static volatile uint16_t connId = 0;
+static volatile uint16_t mtu = 23;
+static volatile bool cancelled = false;
+static bool requestPending = false;
+static Request pending;
+static LogServiceStats stats;
+
+static void putU16(uint8_t* p, uint16_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+}
+
+static void putU32(uint8_t* p, uint32_t v) {
+    for (int i = 0; i < 4; i++) p[i] = (uint8_t)(v >> (8 * i));
+}
+
+static uint16_t getU16(const uint8_t* p) {
+    return (uint16_t)(p[0] | p[1] << 8);
+}
+
+static uint32_t getU32(const uint8_t* p) {
+    return p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+// Bytes a notification can carry on the current link
+static size_t recordRoom() {
+    size_t room = mtu - 3;
+    return room < MAX_RECORD ? room : MAX_RECORD;
+}
+
+// Notify the phone, first waiting out congestion. Straight to Bluedroid
+// rather than through BLECharacteristic::setValue(), which would copy
+// every record into a std::string. Returns false once the phone is gone,
+// or if the stack keeps refusing the record without being congested.
+static bool send(const uint8_t* data, size_t length) {
+    uint32_t first = millis();
+    uint32_t started = first;        // Of the current run of refusals
+    bool waited = false;
+    for (;;) {
+        if (!connected) return false;
+        if (!congested) {
+            esp_err_t err = esp_ble_gatts_send_indicate(server->getGattsIf(), connId, dataCharacteristic->getHandle(),
+                                                        length, (uint8_t*)data, false);
+            if (err == ESP_OK) break;
+            if (millis() - started >= SEND_TIMEOUT_MS) {
+                LOG_W(BLE, "Log service: notify failed (err %d)", err);
+                return false;
+            }
+        } else {
+            started = millis();
+        }
+        waited = true;
+        vTaskDelay(1);
+    }
+    if (waited) {
+        portENTER_CRITICAL(&stateMux);
+        stats.congestedMs += millis() - first;
+        portEXIT_CRITICAL(&stateMux);
+    }
+    return true;
+}
+
+static void sendError(LogServiceError code) {
+    uint8_t record[2] = { RECORD_ERROR, code };
+    send(record, sizeof(record));
+}
+
+static bool logNumber(const char* name, uint16_t& number) {
+    // ride0001.vdl
+    size_t n = strlen(name);
+    if (n != 12 || strncmp(name, "ride", 4) != 0 || strcmp(name + 8, LOG_EXTENSION) != 0) return false;
+    uint32_t value = 0;
+    for (int i = 4; i < 8; i++) {
+        if (name[i] < '0' || name[i] > '9') return false;
+        value = value * 10 + (name[i] - '0');
+    }
+    number = (uint16_t)value;
+    return true;
+}
+
+static bool isClosedLog(File& file) {
+    uint32_t size = file.size();
+    LogFooter footer;
+    return size >= sizeof(footer) && file.seek(size - sizeof(footer)) &&
+           file.read((uint8_t*)&footer, sizeof(footer)) == sizeof(footer) &&
+           logFooterValid(footer, size);
+}
+
+static void listLogs() {
+    File dir = SD.open(LOG_DIRECTORY);
+    uint16_t count = 0;
+    if (dir && dir.isDirectory()) {
+        for (File file = dir.openNextFile(); file && connected; file = dir.openNextFile()) {
+            uint16_t number;
+            if (!file.isDirectory() && logNumber(file.name(), number)) {
+                uint8_t record[8];
+                record[0] = RECORD_LOG;
+                putU16(record + 1, number);
+                putU32(record + 3, file.size());
+                record[7] = isClosedLog(file) ? 1 : 0;
+                if (send(record, sizeof(record))) count++;
+            }
+            file.close();
+        }
+    }
+    if (dir) dir.close();
+    uint8_t end[3] = { RECORD_LIST_END };
+    putU16(end + 1, count);
+    send(end, sizeof(end));
+}
+
+// Stream [offset, offset + length) of a log, a card slice at a time cut
+// into records as large as the MTU allows
+static void readLog(const Request& request) {
+    char path[32];
+    snprintf(path, sizeof(path), "%s/ride%04u%s", LOG_DIRECTORY, (unsigned)request.number, LOG_EXTENSION);
+    File file = SD.open(path, FILE_READ);
+    if (!file) {
+        sendError(LOG_SERVICE_ERROR_NO_FILE);
+        return;
+    }
+    uint32_t size = file.size();
+    uint32_t offset = request.offset < size ? request.offset : size;
+    uint32_t end = request.length && request.length < size - offset ? offset + request.length : size;
+    uint32_t crc = 0;
+    uint32_t sent = 0;
+    uint8_t record[MAX_RECORD];
+    LOG_I(BLE, "Log service: sending %s from %u, %u bytes", path, (unsigned)offset, (unsigned)(end - offset));
+
+    bool ok = file.seek(offset);
+    while (ok && offset < end && !cancelled) {
+        size_t n = end - offset < READ_SLICE ? end - offset : READ_SLICE;
+        coexistAcquire(COEXIST_SD_READ);
+        spiBusCardBegin(READ_SLICE_MS);
+        bool read = file.read(slice, n) == n;
+        spiBusCardEnd();
+        if (!read) {
+            ok = false;
+            break;
+        }
+        size_t used = 0;
+        while (used < n && ok && !cancelled) {
+            size_t room = recordRoom() - DATA_HEADER;
+            size_t chunk = n - used < room ? n - used : room;
+            record[0] = RECORD_DATA;
+            putU32(record + 1, offset + used);
+            memcpy(record + DATA_HEADER, slice + used, chunk);
+            ok = send(record, DATA_HEADER + chunk);
+            if (!ok) break;
+            crc = logCrc32(crc, slice + used, chunk);
+            used += chunk;
+        }
+        offset += used;
+        sent += used;
+        portENTER_CRITICAL(&stateMux);
+        stats.bytesSent += used;
+        portEXIT_CRITICAL(&stateMux);
+    }
+    file.close();
+
+    if (!connected) {
+        LOG_I(BLE, "Log service: phone left after %u bytes", (unsigned)sent);
+        return;
+    }
+    if (!ok) {
+        sendError(LOG_SERVICE_ERROR_READ);
+        return;
+    }
+    uint8_t done[9] = { RECORD_READ_END };
+    putU32(done + 1, sent);
+    putU32(done + 5, crc);
+    send(done, sizeof(done));
+    if (!cancelled) {
+        portENTER_CRITICAL(&stateMux);
+        stats.filesSent++;
+        portEXIT_CRITICAL(&stateMux);
+    }
+}
+
+static void serviceTaskMain(void* param) {
+    for (;;) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        Request request;
+        portENTER_CRITICAL(&stateMux);
+        bool have = requestPending;
+        request = pending;
+        requestPending = false;
+        cancelled = false;
+        portEXIT_CRITICAL(&stateMux);
+        if (!have || !connected) continue;
+
+        taskBudgetStart(TASK_LOG_SERVICE);
+        if (request.command == CMD_LIST) listLogs();
+        else if (request.command == CMD_READ) readLog(request);
+        taskBudgetEnd(TASK_LOG_SERVICE);
+    }
+}
+
+// Congestion and the MTU are only reported to a GATTS handler
+static void gattsEventHandler(esp_gatts_cb_event_t event, esp_gatt_if_t gattsIf, esp_ble_gatts_cb_param_t* param) {
+    if (event == ESP_GATTS_CONGEST_EVT) {
+        if (param->congest.conn_id == connId) congested = param->congest.congested;
+    } else if (event == ESP_GATTS_MTU_EVT) {
+        if (param->mtu.conn_id == connId) mtu = param->mtu.mtu;
+    }
+}
+
+class ServerCallbacks : public BLEServerCallbacks {
+    void onConnect(BLEServer* pServer, esp_ble_gatts_cb_param_t* param) override {
+        connId = param->connect.conn_id;
+        mtu = 23;
+        congested = false;
+        connected = true;
+        esp_ble_conn_update_params_t params;
+        memcpy(params.bda, param->connect.remote_bda, sizeof(esp_bd_addr_t));
+        params.min_int = linkProfile.minInterval;
+        params.max_int = linkProfile.maxInterval;
+        params.latency = linkProfile.latency;
+        params.timeout = linkProfile.timeout;
+        esp_ble_gap_update_conn_params(&params);
+        LOG_I(BLE, "Log service: phone connected");
+    }
+
+    void onDisconnect(BLEServer* pServer) override {
+        connected = false;
+        cancelled = true;
+        LOG_I(BLE, "Log service: phone disconnected, advertising again");
+        pServer->startAdvertising();
+    }
+};
+
+// On the BT task: keep the request for the service task, which may still
+// be busy with the last one; a new one cancels it
+class ControlCallbacks : public BLECharacteristicCallbacks {
+    void onWrite(BLECharacteristic* characteristic) override {
+        std::string value = characteristic->getValue();
+        const uint8_t* p = (const uint8_t*)value.data();
+        size_t n = value.length();
+        Request request;
+        memset(&request, 0, sizeof(request));
+        if (n >= 1) request.command = (Command)p[0];
+        bool valid = (n == 1 && (request.command == CMD_LIST || request.command == CMD_CANCEL)) ||
+                     (n == 11 && request.command == CMD_READ);
+        if (!valid) {
+            LOG_W(BLE, "Log service: bad command of %u bytes", (unsigned)n);
+            return;
+        }
+        if (request.command == CMD_READ) {
+            request.number = getU16(p + 1);
+            request.offset = getU32(p + 3);
+            request.length = getU32(p + 7);
+        }
+        portENTER_CRITICAL(&stateMux);
+        cancelled = true;
+        if (request.command != CMD_CANCEL) {
+            pending = request;
+            requestPending = true;
+        }
+        portEXIT_CRITICAL(&stateMux);
+        xTaskNotifyGive(task);
+    }
+};
+
+bool logServiceBegin(const char* name, const BleLinkProfile& profile) {
+    if (server) return true;
+
+    if (SD.cardType() == CARD_NONE) {
+        LOG_I(APP, "No SD card, log service off");
+        return false;
+    }
+    slice = (uint8_t*)memoryAlloc(READ_SLICE, MEMORY_BULK, MEMORY_TAG_BLE);
+    if (!slice) {
+        LOG_E(APP, "No PSRAM for the log service");
+        return false;
+    }
+    linkProfile = profile;
+    memset(&stats, 0, sizeof(stats));
+
+    xTaskCreatePinnedToCore(serviceTaskMain, PLACEMENT.name, TASK_STACK_SIZE, nullptr, PLACEMENT.priority, &task,
+                            PLACEMENT.core);
+    perfWatchTask(task, MEMORY_TAG_BLE);
+
+    BLEDevice::setCustomGattsHandler(gattsEventHandler);
+    esp_ble_gap_set_device_name(name);
+    server = BLEDevice::createServer();
+    server->setCallbacks(new ServerCallbacks());
+    BLEService* service = server->createService(serviceUuid);
+    BLECharacteristic* control = service->createCharacteristic(
+        controlUuid, BLECharacteristic::PROPERTY_WRITE | BLECharacteristic::PROPERTY_WRITE_NR);
+    control->setCallbacks(new ControlCallbacks());
+    dataCharacteristic = service->createCharacteristic(dataUuid, BLECharacteristic::PROPERTY_NOTIFY);
+    dataCharacteristic->addDescriptor(new BLE2902());
+    service->start();
+
+    BLEAdvertising* advertising = BLEDevice::getAdvertising();
+    advertising->addServiceUUID(serviceUuid);
+    advertising->setScanResponse(true);
+    BLEDevice::startAdvertising();
+    LOG_I(BLE, "Log service advertising as %s", name);
+    return true;
+}
+
+LogServiceStats logServiceStats() {
+    LogServiceStats out;
+    portENTER_CRITICAL(&stateMux);
+    out = stats;
+    portEXIT_CRITICAL(&stateMux);
+    out.connected = connected;
+    out.mtu = mtu;
+    return out;
+}
+
+void logServiceAddress(char* out, size_t size) {
+    uint8_t mac[6] = {};
+    esp_read_mac(mac, ESP_MAC_BT);
+    snprintf(out, size, "%02x:%02x:%02x:%02x:%02x:%02x", mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
+}
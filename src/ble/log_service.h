@@ -0,0 +1,61 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include "link_params.h"
+
+// A GATT server that lets a phone list and download the telemetry logs
+// on the SD card, alongside the client links to the VESCs.
+//
+// The dashboard advertises the service under its own name. A phone writes
+// commands to the control characteristic and gets everything back as
+// notifications on the data characteristic, each as large as the
+// negotiated MTU allows. All numbers are little-endian.
+//
+// Commands (control, write or write without response):
+//   0x01                       list the logs
+//   0x02 number:u16 offset:u32 length:u32
+//                              read ride<number>.vdl from offset, length
+//                              bytes or to the end for 0
+//   0x03                       cancel a read
+// Records (data, notify):
+//   0x10 number:u16 size:u32 closed:u8    one per log; only closed logs
+//                                         are final, the open one grows
+//   0x11 count:u16                        end of the list
+//   0x20 offset:u32 bytes...              file data
+//   0x21 length:u32 crc:u32               end of a read: bytes sent and
+//                                         their CRC-32 (as logCrc32)
+//   0x2F code:u8                          LOG_SERVICE_ERROR_*
+//
+// A low-priority task reads the file in slices as the upload does and
+// sends while Bluedroid has room, waiting out congestion, so the download
+// runs at what the phone's link carries without starving the VESC links
+// of buffers. A read cut off by a disconnect resumes from any offset.
+
+// The service, for pairing codes and the phone's scan filter
+#define LOG_SERVICE_UUID "5644ab00-6c6f-4773-9a2e-76657363d001"
+
+enum LogServiceError : uint8_t {
+    LOG_SERVICE_ERROR_NO_FILE = 1,
+    LOG_SERVICE_ERROR_READ = 2,
+    LOG_SERVICE_ERROR_BAD_COMMAND = 3
+};
+
+struct LogServiceStats {
+    bool connected;            // A phone is connected
+    uint16_t mtu;              // Negotiated with it
+    uint32_t filesSent;        // Reads completed since boot
+    uint32_t bytesSent;        // File bytes notified since boot
+    uint32_t congestedMs;      // Spent waiting for Bluedroid's buffers
+};
+
+// Create the service, start advertising as name and start the task. The
+// phone is asked for the connection parameters of profile. Call after
+// BLEDevice::init(). Returns false without an SD card.
+bool logServiceBegin(const char* name, const BleLinkProfile& profile);
+
+LogServiceStats logServiceStats();
+
+// The address the service advertises from, "aa:bb:cc:dd:ee:ff", read
+// from eFuse so it is safe off the BLE task
+void logServiceAddress(char* out, size_t size);
@@ -0,0 +1,104 @@
+#include "ble_host.h"
+#include "nimble_link.h"
+#include "../log.h"
+
+#include <NimBLEDevice.h>
+#include <string.h>
+
+static NimbleLink links[VESC_MAX_LINKS];
+static volatile BleAdvertHandler advertHandler = nullptr;
+
+// The scan keeps no results (setMaxResults(0)), so every advertiser
+// around costs only what the handler does with the raw bytes
+class ScanCallbacks : public NimBLEAdvertisedDeviceCallbacks {
+    void onResult(NimBLEAdvertisedDevice* advertisedDevice) {
+        BleAdvertHandler handler = advertHandler;
+        if (!handler) return;
+        uint8_t address[6];
+        nimbleAddressBytes(advertisedDevice->getAddress(), address);
+        handler(address, advertisedDevice->getAddressType(), advertisedDevice->getRSSI(),
+                advertisedDevice->getPayload(), advertisedDevice->getPayloadLength());
+    }
+};
+
+static ScanCallbacks scanCallbacks;
+
+// The stored bond for an address, if any
+static bool findBond(const uint8_t* address, NimBLEAddress& bond) {
+    int count = NimBLEDevice::getNumBonds();
+    for (int i = 0; i < count; i++) {
+        NimBLEAddress stored = NimBLEDevice::getBondedAddress(i);
+        uint8_t bytes[6];
+        nimbleAddressBytes(stored, bytes);
+        if (memcmp(bytes, address, sizeof(bytes)) == 0) {
+            bond = stored;
+            return true;
+        }
+    }
+    return false;
+}
+
+// NimBLEDevice::init() starts the controller BLE only, handing the
+// Classic BT memory back, whatever releaseClassic says
+void bleHostBegin(uint16_t localMtu, bool releaseClassic) {
+    NimBLEDevice::init("");
+    NimBLEDevice::setMTU(localMtu);
+    NimBLEDevice::getScan()->setMaxResults(0);
+}
+
+const char* bleHostName() {
+    return "NimBLE";
+}
+
+void bleHostScanHandler(BleAdvertHandler handler, bool duplicates) {
+    advertHandler = handler;
+    NimBLEDevice::getScan()->setAdvertisedDeviceCallbacks(&scanCallbacks, duplicates);
+}
+
+bool bleHostScanStart(bool active, uint16_t intervalMs, uint16_t windowMs) {
+    NimBLEScan* scan = NimBLEDevice::getScan();
+    scan->setActiveScan(active);
+    scan->setInterval(intervalMs);
+    scan->setWindow(windowMs);
+    scan->clearResults();
+    return scan->start(0, nullptr, false);
+}
+
+void bleHostScanStop() {
+    NimBLEDevice::getScan()->stop();
+}
+
+BleTransport& bleHostLink(uint8_t index) {
+    return links[index];
+}
+
+void bleHostSecurityBegin() {
+    // Bonding, Secure Connections where the module has it, and no IO, so
+    // pairing is Just Works; both sides hand over their encryption and
+    // identity keys, the latter resolving a module's random address
+    NimBLEDevice::setSecurityAuth(true, false, true);
+    NimBLEDevice::setSecurityIOCap(BLE_HS_IO_NO_INPUT_OUTPUT);
+    NimBLEDevice::setSecurityInitKey(BLE_SM_PAIR_KEY_DIST_ENC | BLE_SM_PAIR_KEY_DIST_ID);
+    NimBLEDevice::setSecurityRespKey(BLE_SM_PAIR_KEY_DIST_ENC | BLE_SM_PAIR_KEY_DIST_ID);
+}
+
+int bleHostBondCount() {
+    return NimBLEDevice::getNumBonds();
+}
+
+bool bleHostIsBonded(const uint8_t* address) {
+    NimBLEAddress bond;
+    return findBond(address, bond);
+}
+
+bool bleHostEncrypt(const uint8_t* address) {
+    for (uint8_t i = 0; i < VESC_MAX_LINKS; i++) {
+        if (links[i].encrypt(address)) return true;
+    }
+    return false;
+}
+
+void bleHostForgetBond(const uint8_t* address) {
+    NimBLEAddress bond;
+    if (findBond(address, bond)) NimBLEDevice::deleteBond(bond);
+}
@@ -0,0 +1,334 @@
+#include "nimble_link.h"
+#include "bonding.h"
+#include "../log.h"
+
+#include <Arduino.h>
+#include <string.h>
+#if defined(CONFIG_NIMBLE_CPP_IDF)
+#include "host/ble_hs.h"
+#else
+#include "nimble/nimble/host/include/host/ble_hs.h"
+#endif
+
+// Nordic UART Service UUIDs
+static NimBLEUUID serviceUUID("6e400001-b5a3-f393-e0a9-e50e24dcca9e");
+static NimBLEUUID charUUID_RX("6e400002-b5a3-f393-e0a9-e50e24dcca9e");
+static NimBLEUUID charUUID_TX("6e400003-b5a3-f393-e0a9-e50e24dcca9e");
+
+// A with-response write not confirmed by then is given up on, so a lost
+// confirmation cannot stop writes for the rest of the connection
+static const uint32_t WRITE_CONFIRM_TIMEOUT_MS = 1000;
+
+// The links by index, for the notification callback, which is only told
+// the characteristic
+static NimbleLink* linkByIndex[VESC_MAX_LINKS];
+
+static const char* addrTypeName(uint8_t type) {
+    return type == BLE_ADDR_RANDOM ? "RANDOM" : "PUBLIC";
+}
+
+NimBLEAddress nimbleAddress(const uint8_t* bda, uint8_t type) {
+    ble_addr_t address;
+    address.type = type;
+    for (int i = 0; i < 6; i++) address.val[i] = bda[5 - i];
+    return NimBLEAddress(address);
+}
+
+void nimbleAddressBytes(const NimBLEAddress& address, uint8_t* bda) {
+    const uint8_t* native = address.getNative();
+    for (int i = 0; i < 6; i++) bda[i] = native[5 - i];
+}
+
+void NimbleLink::Callbacks::onConnect(NimBLEClient* client) {
+    LOG_I(BLE, "BLE Client %d Connected", owner->linkIndex);
+}
+
+void NimbleLink::Callbacks::onDisconnect(NimBLEClient* client) {
+    LOG_I(BLE, "BLE Client %d Disconnected", owner->linkIndex);
+    owner->writeReady = false;
+    owner->txChar = nullptr;
+    if (owner->disconnectHandler) owner->disconnectHandler(owner->linkIndex);
+}
+
+// Pairing, or the resume of a bond, finished; the host gives no reason
+// for a failure
+void NimbleLink::Callbacks::onAuthenticationComplete(struct ble_gap_conn_desc* desc) {
+    bondingAuthComplete(owner->peer, desc->sec_state.encrypted, 0);
+}
+
+NimbleLink::NimbleLink()
+    : client(nullptr), callbacks(this), linkIndex(0), peer(), lastRssi(0), txChar(nullptr), rxHandle(0),
+      profile(&BLE_PROFILE_BALANCED), mtu(23), supervisionMs(0), deadlines(), writeMode(BLE_WRITE_AUTO),
+      dataHandler(nullptr), disconnectHandler(nullptr), ready(false), writeReady(false), writeNoResponse(false),
+      writePending(false), writeStartedMs(0), deferredWrites(0), failedWrites(0) {
+}
+
+void NimbleLink::begin(uint8_t index, const BleLinkProfile& linkProfile, uint16_t linkMtu,
+                       DataHandler onData, DisconnectHandler onDisconnect,
+                       BleWriteMode linkWriteMode) {
+    linkIndex = index;
+    writeMode = linkWriteMode;
+    profile = &linkProfile;
+    mtu = linkMtu;
+    dataHandler = onData;
+    disconnectHandler = onDisconnect;
+    if (index < VESC_MAX_LINKS) linkByIndex[index] = this;
+
+    if (!client) {
+        client = NimBLEDevice::createClient();
+        client->setClientCallbacks(&callbacks, false);
+        LOG_D(BLE, "BLE client created with callbacks");
+    }
+}
+
+// A call ran past its deadline (call_deadline.h): end the connection, or
+// give up establishing it. Both only post to the host.
+void NimbleLink::dropCall(void* context) {
+    NimbleLink* link = (NimbleLink*)context;
+    if (link->client->isConnected()) {
+        ble_gap_terminate(link->client->getConnId(), BLE_ERR_REM_USER_CONN_TERM);
+    } else {
+        ble_gap_conn_cancel();
+    }
+}
+
+// On the host task
+void NimbleLink::onNotify(NimBLERemoteCharacteristic* characteristic, uint8_t* data, size_t length, bool isNotify) {
+    for (uint8_t i = 0; i < VESC_MAX_LINKS; i++) {
+        NimbleLink* link = linkByIndex[i];
+        if (link && link->txChar == characteristic) {
+            if (link->dataHandler) link->dataHandler(link->linkIndex, data, length);
+            return;
+        }
+    }
+}
+
+int NimbleLink::onWriteDone(uint16_t connHandle, const struct ble_gatt_error* error, struct ble_gatt_attr* attr,
+                            void* arg) {
+    NimbleLink* link = (NimbleLink*)arg;
+    if (error->status != 0) link->failedWrites++;
+    link->writePending = false;
+    return 0;
+}
+
+// One connect attempt under its deadline. A connect that only came
+// through after the link was dropped under it is let go.
+bool NimbleLink::connectWithin(uint8_t type) {
+    NimBLEAddress address = nimbleAddress(peer, type);
+    bleCallArm(BLE_CALL_CONNECT, dropCall, this, deadlines.connectMs);
+    bool connected = client->connect(address, true);
+    if (bleCallDisarm()) {
+        if (client->isConnected()) client->disconnect();
+        return false;
+    }
+    return connected;
+}
+
+bool NimbleLink::connectAddress(uint8_t preferredType, uint8_t& usedType) {
+    uint8_t otherType = (preferredType == BLE_ADDR_RANDOM) ? BLE_ADDR_PUBLIC : BLE_ADDR_RANDOM;
+
+    LOG_D(BLE, "Attempting connection with %s address type...", addrTypeName(preferredType));
+    if (connectWithin(preferredType)) {
+        usedType = preferredType;
+        return true;
+    }
+
+    LOG_W(BLE, "Failed with %s address, trying %s...", addrTypeName(preferredType), addrTypeName(otherType));
+    if (connectWithin(otherType)) {
+        usedType = otherType;
+        return true;
+    }
+    return false;
+}
+
+// The MTU the exchange after connect settled on, and the parameters the
+// connection came up with
+void NimbleLink::readParams() {
+    bleLinkStatus.mtu = client->getMTU();
+    ble_gap_conn_desc desc;
+    if (ble_gap_conn_find(client->getConnId(), &desc) == 0) {
+        bleLinkStatus.interval = desc.conn_itvl;
+        bleLinkStatus.latency = desc.conn_latency;
+        bleLinkStatus.timeout = desc.supervision_timeout;
+    }
+}
+
+// Discover the NUS service and subscribe to TX. Fills in the handles to
+// cache on success.
+bool NimbleLink::discoverAndSubscribe(GattCacheEntry& entry) {
+    // Each lookup runs its part of the discovery and blocks until it is done
+    LOG_D(BLE, "Getting UART service...");
+    bleCallArm(BLE_CALL_DISCOVER, dropCall, this, deadlines.discoverMs);
+    NimBLERemoteService* service = client->getService(serviceUUID);
+    NimBLERemoteCharacteristic* tx = service ? service->getCharacteristic(charUUID_TX) : nullptr;
+    NimBLERemoteCharacteristic* rx = service ? service->getCharacteristic(charUUID_RX) : nullptr;
+    NimBLERemoteDescriptor* cccd = tx ? tx->getDescriptor(NimBLEUUID((uint16_t)0x2902)) : nullptr;
+    if (bleCallDisarm()) return false;
+    if (service == nullptr) {
+        LOG_W(BLE, "Failed to find Nordic UART service");
+        return false;
+    }
+    if (tx == nullptr) {
+        LOG_W(BLE, "Failed to find TX characteristic");
+        return false;
+    }
+    if (rx == nullptr) {
+        LOG_W(BLE, "Failed to find RX characteristic");
+        return false;
+    }
+    if (!tx->canNotify()) {
+        LOG_W(BLE, "TX characteristic cannot notify");
+        return false;
+    }
+
+    entry.txHandle = tx->getHandle();
+    entry.rxHandle = rx->getHandle();
+    entry.rxNoResponse = rx->canWriteNoResponse();
+    entry.cccdHandle = cccd ? cccd->getHandle() : 0;
+
+    // Writes the CCCD and waits for the response
+    LOG_D(BLE, "Subscribing to TX...");
+    txChar = tx;
+    bleCallArm(BLE_CALL_SUBSCRIBE, dropCall, this, deadlines.subscribeMs);
+    bool subscribed = tx->subscribe(true, onNotify, true);
+    if (bleCallDisarm()) return false;
+    if (!subscribed) {
+        LOG_W(BLE, "Subscribing to TX failed");
+        return false;
+    }
+    LOG_I(BLE, "Notifications enabled");
+    return true;
+}
+
+// Pick the write type for this connection and route writes to RX
+void NimbleLink::startWrites(const GattCacheEntry& entry) {
+    writeNoResponse = writeMode == BLE_WRITE_NO_RESPONSE ||
+                      (writeMode == BLE_WRITE_AUTO && entry.rxNoResponse);
+    rxHandle = entry.rxHandle;
+    writePending = false;
+    writeReady = true;
+    LOG_D(BLE, "Link %d writes %s response", linkIndex, writeNoResponse ? "without" : "with");
+}
+
+bool NimbleLink::connect(const BLEDeviceInfo& device, ReadyCheck readyCheck) {
+    const char* address = device.address;
+    ready = false;
+
+    // Tear down whatever is left of the previous connection
+    writeReady = false;
+    if (client->isConnected()) {
+        client->disconnect();
+    }
+    txChar = nullptr;
+
+    // Try the address type that worked last time first; otherwise the
+    // advertised one, then the other
+    GattCacheEntry cached;
+    bool haveCache = gattCacheLookup(address, cached);
+    uint8_t addrType = haveCache ? cached.addrType : device.addressType;
+
+    memcpy(peer, device.bda, sizeof(peer));
+    lastRssi = 0;
+    // Asked for in the connect, so there is no update to wait for after
+    client->setConnectionParams(profile->minInterval, profile->maxInterval, profile->latency,
+                                bleLinkSupervisionTimeout(*profile, supervisionMs));
+    if (deadlines.connectMs > 0) client->setConnectTimeout((deadlines.connectMs + 999) / 1000);
+    bondingConnectStart(device.bda);
+    if (!connectAddress(addrType, addrType)) {
+        LOG_W(BLE, "Failed to connect to VESC BLE device");
+        return false;
+    }
+
+    LOG_I(BLE, "Connected to VESC BLE device");
+
+    // A bonded module is encrypted before any GATT traffic, so nothing it
+    // protects is refused and has to wait for pairing
+    if (!bondingResume(device.bda)) {
+        client->disconnect();
+        return false;
+    }
+
+    GattCacheEntry discovered = GattCacheEntry();
+    discovered.addrType = addrType;
+    if (!discoverAndSubscribe(discovered)) {
+        client->disconnect();
+        txChar = nullptr;
+        return false;
+    }
+    readParams();
+
+    // Remember the address type and handles only once the VESC has
+    // answered through them
+    startWrites(discovered);
+    ready = readyCheck(linkIndex);
+    if (ready && discovered.cccdHandle != 0) {
+        gattCacheStore(address, discovered);
+    }
+    bondingConnectDone();
+    return true;
+}
+
+void NimbleLink::disconnect() {
+    if (!client) return;
+    writeReady = false;
+    if (client->isConnected()) {
+        client->disconnect();
+    }
+    txChar = nullptr;
+}
+
+bool NimbleLink::isConnected() {
+    return client && client->isConnected();
+}
+
+bool NimbleLink::write(const uint8_t* data, size_t length) {
+    if (!writeReady || !isConnected()) return false;
+    uint16_t connHandle = client->getConnId();
+
+    // Without response, each write takes one of the host's buffers until
+    // it is on air; the host refuses it when none is left
+    if (writeNoResponse) {
+        int rc = ble_gattc_write_no_rsp_flat(connHandle, rxHandle, data, length);
+        if (rc == 0) return true;
+        if (rc == BLE_HS_ENOMEM) {
+            deferredWrites++;
+        } else {
+            failedWrites++;
+        }
+        return false;
+    }
+
+    // With response, only one write is outstanding at a time
+    if (writePending && millis() - writeStartedMs > WRITE_CONFIRM_TIMEOUT_MS) {
+        writePending = false;
+        failedWrites++;
+    }
+    if (writePending) {
+        deferredWrites++;
+        return false;
+    }
+    writePending = true;
+    writeStartedMs = millis();
+    if (ble_gattc_write_flat(connHandle, rxHandle, data, length, onWriteDone, this) != 0) {
+        writePending = false;
+        failedWrites++;
+        return false;
+    }
+    return true;
+}
+
+size_t NimbleLink::writeLimit() {
+    uint16_t linkMtu = isConnected() ? client->getMTU() : 23;
+    return linkMtu > 3 ? linkMtu - 3 : 20;
+}
+
+void NimbleLink::requestRssi() {
+    if (!isConnected()) return;
+    int rssi = client->getRssi();
+    if (rssi != 0) lastRssi = rssi;
+}
+
+bool NimbleLink::encrypt(const uint8_t* address) {
+    if (!isConnected() || memcmp(address, peer, sizeof(peer)) != 0) return false;
+    return ble_gap_security_initiate(client->getConnId()) == 0;
+}
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <NimBLEDevice.h>
+#include "ble_transport.h"
+#include "gatt_cache.h"
+
+// An address as BLEDeviceInfo::bda keeps it, most significant byte first,
+// for NimBLE, which keeps the least significant first
+NimBLEAddress nimbleAddress(const uint8_t* bda, uint8_t type);
+
+// ...and back
+void nimbleAddressBytes(const NimBLEAddress& address, uint8_t* bda);
+
+// The VESC link on NimBLE, through NimBLE-Arduino's NimBLEClient. The
+// connection parameters go into the connect itself, so the link comes up
+// at the profile's interval with no update afterwards. Every connect
+// runs discovery: the library routes notifications to the
+// characteristics it discovered, so the cache only gives the address
+// type. Writes go to the host's GATT client API by handle, with response
+// one at a time, without response until the host has no buffer left.
+// See BleTransport for the rest.
+class NimbleLink : public BleTransport {
+public:
+    NimbleLink();
+
+    void begin(uint8_t index, const BleLinkProfile& profile, uint16_t mtu,
+               DataHandler onData, DisconnectHandler onDisconnect,
+               BleWriteMode writeMode = BLE_WRITE_AUTO) override;
+
+    uint8_t index() const { return linkIndex; }
+
+    void setSupervisionTimeout(uint32_t ms) override { supervisionMs = ms; }
+    void setCallDeadlines(const BleCallDeadlines& limits) override { deadlines = limits; }
+
+    // NimBLE has no other way than the characteristic's callback
+    void setDirectNotify(bool enabled) override {}
+
+    bool connect(const BLEDeviceInfo& device, ReadyCheck ready) override;
+    void disconnect() override;
+    bool isConnected() override;
+    bool isReady() const override { return ready; }
+    bool usedCachedHandles() const override { return false; }
+
+    bool write(const uint8_t* data, size_t length) override;
+    size_t writeLimit() override;
+
+    bool writesWithoutResponse() const override { return writeNoResponse; }
+    uint32_t writesDeferred() const override { return deferredWrites; }
+    uint32_t writeErrors() const override { return failedWrites; }
+
+    // The host reads it back at once, so requestRssi() stores the answer
+    void requestRssi() override;
+    int rssi() override { return lastRssi; }
+
+    // Ask the peer for encryption with its stored keys, if address is this
+    // link's connected peer; the result comes to bondingAuthComplete()
+    bool encrypt(const uint8_t* address);
+
+private:
+    class Callbacks : public NimBLEClientCallbacks {
+    public:
+        explicit Callbacks(NimbleLink* owner) : owner(owner) {}
+        void onConnect(NimBLEClient* client);
+        void onDisconnect(NimBLEClient* client);
+        void onAuthenticationComplete(struct ble_gap_conn_desc* desc);
+    private:
+        NimbleLink* owner;
+    };
+
+    static void dropCall(void* link);
+    static void onNotify(NimBLERemoteCharacteristic* characteristic, uint8_t* data, size_t length, bool isNotify);
+    static int onWriteDone(uint16_t connHandle, const struct ble_gatt_error* error, struct ble_gatt_attr* attr,
+                           void* arg);
+    bool connectAddress(uint8_t preferredType, uint8_t& usedType);
+    bool connectWithin(uint8_t type);
+    void readParams();
+    bool discoverAndSubscribe(GattCacheEntry& entry);
+    void startWrites(const GattCacheEntry& entry);
+
+    NimBLEClient* client;
+    Callbacks callbacks;
+    uint8_t linkIndex;
+    uint8_t peer[6];            // Most significant byte first, as BLEDeviceInfo::bda
+    volatile int8_t lastRssi;
+    NimBLERemoteCharacteristic* volatile txChar;
+    uint16_t rxHandle;
+    const BleLinkProfile* profile;
+    uint16_t mtu;
+    uint32_t supervisionMs;
+    BleCallDeadlines deadlines;
+    BleWriteMode writeMode;
+    DataHandler dataHandler;
+    DisconnectHandler disconnectHandler;
+    bool ready;
+
+    bool writeReady;
+    bool writeNoResponse;
+    volatile bool writePending;  // With-response write awaiting its confirmation
+    uint32_t writeStartedMs;
+    uint32_t deferredWrites;
+    volatile uint32_t failedWrites;
+};
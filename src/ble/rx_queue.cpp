@@ -0,0 +1,158 @@
+#include "rx_queue.h"
+#include "../log.h"
+#include "../system/spsc_queue.h"
+#include "../system/perf_stats.h"
+#include "../system/task_layout.h"
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <string.h>
+
+static const size_t QUEUE_SIZE = 4096;   // Several full-MTU notifications, per link
+static const size_t CHUNK_SIZE = 256;    // Bytes handed to the framer at a time
+static const size_t STAMP_QUEUE_SIZE = 1024;
+static const size_t CAN_QUEUE_SIZE = 4096;  // 170 frames, a few rounds of a bus of six controllers
+static const size_t SAMPLE_QUEUE_SIZE = 2048;   // 14 samples, a burst of flat-out playback
+static const uint32_t TASK_STACK_SIZE = 4096;
+static const TaskPlacement& PLACEMENT = TASK_PLACEMENT[TASK_VESC_RX];
+
+// Length and arrival time of each queued notification, pushed after its
+// bytes so the parser never sees a stamp before what it covers
+struct RxStamp {
+    uint32_t length;
+    uint64_t timeUs;
+};
+
+static SpscByteQueue<QUEUE_SIZE> queues[VESC_MAX_LINKS];
+static SpscByteQueue<STAMP_QUEUE_SIZE> stamps[VESC_MAX_LINKS];
+static TaskHandle_t parserTask = nullptr;
+static RxHandler rxHandler = nullptr;
+static volatile uint32_t droppedBytes = 0;
+static volatile uint32_t notifications[VESC_MAX_LINKS];
+static volatile uint32_t notificationBytes[VESC_MAX_LINKS];
+static SpscByteQueue<CAN_QUEUE_SIZE> canFrames;
+static RxCanHandler canHandler = nullptr;
+static volatile uint32_t droppedCanFrames = 0;
+static SpscByteQueue<SAMPLE_QUEUE_SIZE> samples;
+static RxSampleHandler sampleHandler = nullptr;
+
+// Bytes left of the notification being handed out, and its time
+static uint32_t stampLeft[VESC_MAX_LINKS];
+static uint64_t stampTimeUs[VESC_MAX_LINKS];
+
+// Up to one chunk of the oldest notification on a link
+static size_t popChunk(uint8_t link, uint8_t* chunk) {
+    if (stampLeft[link] == 0) {
+        RxStamp stamp;
+        if (stamps[link].size() < sizeof(stamp)) return 0;
+        stamps[link].pop((uint8_t*)&stamp, sizeof(stamp));
+        stampLeft[link] = stamp.length;
+        stampTimeUs[link] = stamp.timeUs;
+    }
+    size_t n = queues[link].pop(chunk, stampLeft[link] < CHUNK_SIZE ? stampLeft[link] : CHUNK_SIZE);
+    stampLeft[link] -= n;
+    return n;
+}
+
+static void parserTaskMain(void* param) {
+    uint8_t chunk[CHUNK_SIZE];
+    for (;;) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        taskBudgetStart(TASK_VESC_RX);
+
+        // A chunk from each link in turn, so a busy link cannot hold up
+        // the others
+        bool more = true;
+        while (more) {
+            more = false;
+            for (uint8_t link = 0; link < VESC_MAX_LINKS; link++) {
+                size_t n = popChunk(link, chunk);
+                if (n > 0) {
+                    rxHandler(link, chunk, n, stampTimeUs[link]);
+                    more = true;
+                }
+            }
+            RxCanFrame frame;
+            if (canFrames.size() >= sizeof(frame)) {
+                canFrames.pop((uint8_t*)&frame, sizeof(frame));
+                if (canHandler) canHandler(frame);
+                more = true;
+            }
+            if (samples.size() >= sizeof(LogSample)) {
+                LogSample sample;
+                samples.pop((uint8_t*)&sample, sizeof(sample));
+                if (sampleHandler) sampleHandler(sample);
+                more = true;
+            }
+        }
+        taskBudgetEnd(TASK_VESC_RX);
+    }
+}
+
+void rxQueueBegin(RxHandler handler) {
+    rxHandler = handler;
+    xTaskCreatePinnedToCore(parserTaskMain, PLACEMENT.name, TASK_STACK_SIZE, nullptr,
+                            PLACEMENT.priority, &parserTask, PLACEMENT.core);
+    perfWatchTask(parserTask, MEMORY_TAG_PROTOCOL);
+}
+
+IRAM_ATTR void rxQueuePush(uint8_t link, const uint8_t* data, size_t length, uint64_t timeUs) {
+    if (length == 0) return;
+    RxStamp stamp = { (uint32_t)length, timeUs };
+    notifications[link]++;
+    notificationBytes[link] += length;
+    if (length > QUEUE_SIZE - queues[link].size() || sizeof(stamp) > STAMP_QUEUE_SIZE - stamps[link].size()) {
+        // The framer resyncs on the next start byte
+        droppedBytes += length;
+    } else {
+        queues[link].push(data, length);
+        stamps[link].push((const uint8_t*)&stamp, sizeof(stamp));
+    }
+    xTaskNotifyGive(parserTask);
+}
+
+uint32_t rxQueueDropped() {
+    return droppedBytes;
+}
+
+RxLinkCounts rxQueueLinkCounts(uint8_t link) {
+    RxLinkCounts counts = {};
+    if (link >= VESC_MAX_LINKS) return counts;
+    counts.notifications = notifications[link];
+    counts.bytes = notificationBytes[link];
+    return counts;
+}
+
+void rxQueueSetCanHandler(RxCanHandler handler) {
+    canHandler = handler;
+}
+
+void rxQueuePushCan(uint32_t id, const uint8_t* data, uint8_t length, uint64_t timeUs) {
+    RxCanFrame frame = {};
+    frame.timeUs = timeUs;
+    frame.id = id;
+    frame.length = length > sizeof(frame.data) ? sizeof(frame.data) : length;
+    memcpy(frame.data, data, frame.length);
+    if (sizeof(frame) > CAN_QUEUE_SIZE - canFrames.size()) {
+        droppedCanFrames++;
+    } else {
+        canFrames.push((const uint8_t*)&frame, sizeof(frame));
+    }
+    xTaskNotifyGive(parserTask);
+}
+
+uint32_t rxQueueCanDropped() {
+    return droppedCanFrames;
+}
+
+void rxQueueSetSampleHandler(RxSampleHandler handler) {
+    sampleHandler = handler;
+}
+
+bool rxQueuePushSample(const LogSample& sample) {
+    if (sizeof(sample) > SAMPLE_QUEUE_SIZE - samples.size()) return false;
+    samples.push((const uint8_t*)&sample, sizeof(sample));
+    xTaskNotifyGive(parserTask);
+    return true;
+}
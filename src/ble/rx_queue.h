@@ -0,0 +1,69 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include "ble_transport.h"
+#include "../storage/log_format.h"
+
+// Moves notification bytes off the BLE host's task. The BLE callback only
+// copies into a lock-free queue and wakes a parser task, which hands the
+// bytes to the framer; this keeps the BT stack's callback short no matter
+// how much parsing or logging a frame causes. Each link has its own
+// queue, so bytes from different VESCs never interleave.
+//
+// Every notification is queued with the esp_timer time it arrived at,
+// and the handler is never given bytes from two notifications at once,
+// so the time it gets is that of every byte it is handed.
+
+typedef void (*RxHandler)(uint8_t link, const uint8_t* data, size_t length, uint64_t timeUs);
+
+// Start the parser task. handler runs on that task.
+void rxQueueBegin(RxHandler handler);
+
+// Queue bytes from a notification on a link, received at timeUs
+// (esp_timer_get_time()). Called from the BLE callback.
+void rxQueuePush(uint8_t link, const uint8_t* data, size_t length, uint64_t timeUs);
+
+// Bytes dropped because a queue was full, over all links
+uint32_t rxQueueDropped();
+
+// Notifications (or reads, on a wired link) pushed onto a link's queue
+// since boot, dropped ones included, and the bytes they carried
+struct RxLinkCounts {
+    uint32_t notifications;
+    uint32_t bytes;
+};
+
+RxLinkCounts rxQueueLinkCounts(uint8_t link);
+
+// CAN frames (status broadcasts from a wired CAN bus) ride on the same
+// task, each whole and with its arrival time, so what they carry is
+// decoded where the replies are
+struct RxCanFrame {
+    uint64_t timeUs;
+    uint32_t id;
+    uint8_t length;
+    uint8_t data[8];
+};
+
+typedef void (*RxCanHandler)(const RxCanFrame& frame);
+
+// handler runs on the parser task. Set it before frames are pushed.
+void rxQueueSetCanHandler(RxCanHandler handler);
+
+// Queue a frame. Called from the one task that reads the bus.
+void rxQueuePushCan(uint32_t id, const uint8_t* data, uint8_t length, uint64_t timeUs);
+
+// Frames dropped because their queue was full
+uint32_t rxQueueCanDropped();
+
+// Samples played back from a log (see storage/log_playback.h) ride on it
+// as well, so they are published by the task that publishes live ones
+typedef void (*RxSampleHandler)(const LogSample& sample);
+
+// handler runs on the parser task. Set it before samples are pushed.
+void rxQueueSetSampleHandler(RxSampleHandler handler);
+
+// Queue a sample. Called from the one task that plays logs; returns
+// false, queueing nothing, while the queue is full.
+bool rxQueuePushSample(const LogSample& sample);
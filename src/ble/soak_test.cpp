@@ -0,0 +1,127 @@
+#include "soak_test.h"
+#include "../log.h"
+#include "../system/heap_stats.h"
+#include "../system/perf_stats.h"
+
+#include <Arduino.h>
+#include <esp_heap_caps.h>
+#include <stdio.h>
+#include <string.h>
+
+static bool active = false;
+static SoakSettings config;
+static SoakStats stats;
+static uint64_t reconnectSumMs = 0;
+static uint32_t startedMs = 0;
+static uint32_t lastSummaryMs = 0;
+
+static bool connected = false;
+static uint32_t connectedSinceMs = 0;
+static bool dropPending = false;          // Dropped and not back yet
+static uint32_t droppedAtMs = 0;
+static bool slowCounted = false;
+
+// Taken at the first reconnect, once everything a connection allocates
+// for good has been allocated
+static bool haveBaseline = false;
+static uint32_t baselineHeap = 0;
+static uint32_t baselinePsram = 0;
+static uint32_t baselineStack[PERF_MAX_TASKS];
+
+static uint32_t freePsram() {
+    return heap_caps_get_free_size(MALLOC_CAP_SPIRAM);
+}
+
+static void takeBaseline() {
+    PerfSnapshot perf;
+    perfSnapshot(perf);
+    baselineHeap = heapStatsRead().freeBytes;
+    baselinePsram = freePsram();
+    for (uint8_t i = 0; i < perf.taskCount; i++) baselineStack[i] = perf.tasks[i].freeBytes;
+    haveBaseline = true;
+}
+
+static void logSummary() {
+    uint32_t minutes = (millis() - startedMs) / 60000;
+    LOG_I(APP, "Soak: %uh%02u, %u drops, %u reconnects (%u slow), reconnect min/avg/max %u/%u/%u ms",
+          minutes / 60, minutes % 60, stats.drops, stats.reconnects, stats.slowReconnects, stats.reconnectMinMs,
+          stats.reconnectAvgMs, stats.reconnectMaxMs);
+    if (!haveBaseline) return;
+
+    HeapStats heap = heapStatsRead();
+    uint32_t psram = freePsram();
+    LOG_I(APP, "Soak: heap %u free (%+d since the first reconnect), min %u, largest %u; PSRAM %u (%+d)",
+          heap.freeBytes, (int)(heap.freeBytes - baselineHeap), heap.minFreeBytes, heap.largestBlock, psram,
+          (int)(psram - baselinePsram));
+
+    PerfSnapshot perf;
+    perfSnapshot(perf);
+    char line[160];
+    int n = snprintf(line, sizeof(line), "Soak: stack");
+    for (uint8_t i = 0; i < perf.taskCount && n > 0 && (size_t)n < sizeof(line); i++) {
+        n += snprintf(line + n, sizeof(line) - n, " %s=%u(%+d)", perf.tasks[i].name, perf.tasks[i].freeBytes,
+                      (int)(perf.tasks[i].freeBytes - baselineStack[i]));
+    }
+    LOG_I(APP, "%s", line);
+}
+
+void soakBegin(const SoakSettings& settings) {
+    config = settings;
+    memset(&stats, 0, sizeof(stats));
+    reconnectSumMs = 0;
+    startedMs = millis();
+    lastSummaryMs = startedMs;
+    active = true;
+    LOG_W(APP, "Soak test: dropping the link every %u s", (unsigned)(settings.dropEveryMs / 1000));
+}
+
+void soakConnectionEvent(ConnState previous, ConnState state) {
+    if (!active) return;
+    uint32_t now = millis();
+    if (state == CONN_CONNECTED && previous != CONN_CONNECTED) {
+        connected = true;
+        connectedSinceMs = now;
+        if (!dropPending) return;
+        dropPending = false;
+        uint32_t took = now - droppedAtMs;
+        stats.reconnects++;
+        stats.lastReconnectMs = took;
+        if (stats.reconnects == 1 || took < stats.reconnectMinMs) stats.reconnectMinMs = took;
+        if (took > stats.reconnectMaxMs) stats.reconnectMaxMs = took;
+        reconnectSumMs += took;
+        stats.reconnectAvgMs = (uint32_t)(reconnectSumMs / stats.reconnects);
+        if (took > config.reconnectLimitMs && !slowCounted) stats.slowReconnects++;
+        LOG_I(APP, "Soak: reconnected in %u ms", took);
+        if (!haveBaseline) takeBaseline();
+    } else if (state != CONN_CONNECTED) {
+        connected = false;
+        // Left for the device list: the storm is paused, not failed
+        if (state == CONN_IDLE) dropPending = false;
+    }
+}
+
+void soakUpdate() {
+    if (!active) return;
+    uint32_t now = millis();
+    if (connected && !dropPending && now - connectedSinceMs >= config.dropEveryMs) {
+        dropPending = true;
+        droppedAtMs = now;
+        slowCounted = false;
+        stats.drops++;
+        connectionManagerDropLink(0);
+    }
+    if (dropPending && !slowCounted && now - droppedAtMs > config.reconnectLimitMs) {
+        slowCounted = true;
+        stats.slowReconnects++;
+        LOG_W(APP, "Soak: not reconnected %u ms after the drop", now - droppedAtMs);
+        heapStatsLog("soak");
+    }
+    if (now - lastSummaryMs >= config.summaryEveryMs) {
+        lastSummaryMs = now;
+        logSummary();
+    }
+}
+
+SoakStats soakStats() {
+    return stats;
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <stdint.h>
+#include "connection_manager.h"
+
+// Reconnect storms for long unattended runs. While enabled, the primary
+// link is dropped every dropEveryMs of connected time and left to the
+// connection manager to bring back, exactly as a link lost in the field.
+// Each reconnect is timed from the drop to CONN_CONNECTED, and every
+// summaryEveryMs a summary is logged: drops, reconnects and the ones
+// that took longer than reconnectLimitMs, reconnect time min/avg/max,
+// and the internal heap, PSRAM and task stacks now against the first
+// reconnect, so leaks show as a steady drift across the hours.
+//
+// Driven from the UI loop; nothing here blocks.
+
+struct SoakSettings {
+    uint32_t dropEveryMs;        // Connected time between forced drops
+    uint32_t summaryEveryMs;
+    uint32_t reconnectLimitMs;   // Slower reconnects are logged and counted
+};
+
+struct SoakStats {
+    uint32_t drops;
+    uint32_t reconnects;
+    uint32_t slowReconnects;     // Over the limit, or still pending past it
+    uint32_t reconnectMinMs;
+    uint32_t reconnectMaxMs;
+    uint32_t reconnectAvgMs;
+    uint32_t lastReconnectMs;
+};
+
+void soakBegin(const SoakSettings& settings);
+
+// Every state change the UI applies
+void soakConnectionEvent(ConnState previous, ConnState state);
+
+// Once per loop pass
+void soakUpdate();
+
+SoakStats soakStats();
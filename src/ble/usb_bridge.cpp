@@ -0,0 +1,68 @@
+#include "usb_bridge.h"
+#include "../system/app_events.h"
+#include "../vesc/framer.h"
+
+#include <Arduino.h>
+
+static const size_t READ_CHUNK = 256;
+
+static void framedFromHost(const uint8_t* payload, size_t length, void* context);
+
+static VescFramer hostFramer(framedFromHost);
+static BridgePacketHandler packetHandler = nullptr;
+static bool started = false;
+static uint32_t packetsToVesc = 0;
+static volatile uint32_t bytesToHost = 0;
+static volatile uint32_t bytesDropped = 0;
+
+static void framedFromHost(const uint8_t* payload, size_t length, void* context) {
+    packetsToVesc++;
+    packetHandler(payload, length);
+}
+
+static void serialReceived() {
+    appEventsSet(APP_EVENT_USB);
+}
+
+void usbBridgeBegin(uint32_t baud, size_t bufferBytes, BridgePacketHandler toVesc) {
+    packetHandler = toVesc;
+    Serial.flush();
+    Serial.end();
+    Serial.setRxBufferSize(bufferBytes);
+    Serial.setTxBufferSize(bufferBytes);
+    Serial.begin(baud);
+    Serial.onReceive(serialReceived);
+    started = true;
+}
+
+void usbBridgeToHost(const uint8_t* data, size_t length) {
+    if (!started) return;
+    // All or nothing: a partial notification would desync VESC Tool's
+    // framer, a whole one is just a lost packet it resends
+    if ((size_t)Serial.availableForWrite() < length) {
+        bytesDropped += length;
+        return;
+    }
+    Serial.write(data, length);
+    bytesToHost += length;
+}
+
+void usbBridgePoll() {
+    if (!started) return;
+    uint8_t chunk[READ_CHUNK];
+    int available;
+    while ((available = Serial.available()) > 0) {
+        size_t n = Serial.read(chunk, (size_t)available < sizeof(chunk) ? available : sizeof(chunk));
+        if (n == 0) break;
+        hostFramer.feed(chunk, n);
+    }
+}
+
+UsbBridgeStats usbBridgeStats() {
+    UsbBridgeStats stats;
+    stats.packetsToVesc = packetsToVesc;
+    stats.bytesToHost = bytesToHost;
+    stats.bytesDropped = bytesDropped;
+    stats.hostErrors = hostFramer.crcErrorCount() + hostFramer.stopErrorCount();
+    return stats;
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Bridges the USB serial port to the primary VESC link, so VESC Tool on a
+// laptop can use the Core2 as its BLE dongle while the dashboard keeps
+// running.
+//
+// Host to VESC: the bytes VESC Tool sends are reassembled into packets on
+// the UI task, and each whole packet goes to the link's write batch with
+// the dashboard's polls, so the two never interleave inside a packet.
+// VESC to host: every notification on the link is copied to the port as
+// it arrives, before the dashboard's own framer sees it. The dashboard
+// thus also decodes the replies to VESC Tool's requests, and VESC Tool
+// sees the replies to the dashboard's polls.
+//
+// Neither direction blocks: bytes the serial transmit buffer has no room
+// for are dropped (VESC Tool resends), as are packets while the link is
+// down. Text logging has to be off, or it would corrupt the stream.
+
+typedef void (*BridgePacketHandler)(const uint8_t* payload, size_t length);
+
+struct UsbBridgeStats {
+    uint32_t packetsToVesc;    // Whole packets from the host
+    uint32_t bytesToHost;
+    uint32_t bytesDropped;     // Towards the host, for want of buffer space
+    uint32_t hostErrors;       // Host packets with a bad CRC or stop byte
+};
+
+// Restart the serial port at baud with bufferBytes of transmit and
+// receive buffer. toVesc gets each packet from the host, on the UI task.
+// Incoming bytes set APP_EVENT_USB.
+void usbBridgeBegin(uint32_t baud, size_t bufferBytes, BridgePacketHandler toVesc);
+
+// Forward bytes from the VESC. Called from the parser task; never blocks.
+void usbBridgeToHost(const uint8_t* data, size_t length);
+
+// Reassemble what the host sent. Call from the UI task.
+void usbBridgePoll();
+
+UsbBridgeStats usbBridgeStats();
@@ -0,0 +1,120 @@
+// Firmware for a second ESP32: a BLE peripheral with the Nordic UART
+// Service that a dashboard connects to as if it were a VESC's BLE module,
+// answered by VescEmulator. Build with: pio run -e vesc-emulator
+
+#include <Arduino.h>
+#include <BLEDevice.h>
+#include <BLEServer.h>
+#include <BLE2902.h>
+#include "../vesc/emulator.h"
+#include "../log.h"
+
+// ============== USER CONFIGURABLE SETTINGS ==============
+const char* EMULATOR_NAME = "VESC Emulator";      // Advertised name (the dashboard looks for "VESC")
+const uint8_t EMULATOR_CONTROLLER_ID = 0;         // Local controller
+const uint8_t EMULATOR_CAN_IDS[] = { 1 };         // Controllers answering COMM_FORWARD_CAN
+const uint8_t EMULATOR_FW_MAJOR = 6;              // Reported firmware (selects the values layout)
+const uint8_t EMULATOR_FW_MINOR = 2;
+const uint32_t EMULATOR_LATENCY_US = 4000;        // Request to reply, before the BLE link's own delay
+const uint32_t EMULATOR_JITTER_US = 2000;         // Extra random delay per reply
+const uint16_t EMULATOR_DROP_PER_MILLE = 0;       // Replies never sent, per 1000
+const uint16_t EMULATOR_MTU = 517;                // Largest ATT MTU to accept
+const uint16_t EMULATOR_CHUNK_LIMIT = 0;          // Cap notification size below the MTU (0 = MTU - 3)
+const uint32_t EMULATOR_STATS_MS = 5000;          // How often to log request/reply counts
+// ========================================================
+
+static BLEUUID serviceUUID("6e400001-b5a3-f393-e0a9-e50e24dcca9e");
+static BLEUUID charUUID_RX("6e400002-b5a3-f393-e0a9-e50e24dcca9e");
+static BLEUUID charUUID_TX("6e400003-b5a3-f393-e0a9-e50e24dcca9e");
+
+static BLEServer* server = nullptr;
+static BLECharacteristic* txCharacteristic = nullptr;
+static volatile bool centralConnected = false;
+static VescEmulator* emulator = nullptr;
+
+// Writes arrive on the BLE host task, polling happens in loop(); the
+// emulator itself is not thread safe. A mutex rather than a spinlock,
+// since poll() notifies while holding it.
+static SemaphoreHandle_t emulatorLock = nullptr;
+
+static void notifyChunk(const uint8_t* data, size_t length, void* context) {
+    if (!centralConnected) return;
+    txCharacteristic->setValue((uint8_t*)data, length);
+    txCharacteristic->notify();
+}
+
+class ServerCallbacks : public BLEServerCallbacks {
+    void onConnect(BLEServer* pServer) override {
+        centralConnected = true;
+        LOG_I(BLE, "Dashboard connected");
+    }
+
+    void onDisconnect(BLEServer* pServer) override {
+        centralConnected = false;
+        LOG_I(BLE, "Dashboard disconnected, advertising again");
+        pServer->startAdvertising();
+    }
+};
+
+class RxCallbacks : public BLECharacteristicCallbacks {
+    void onWrite(BLECharacteristic* characteristic) override {
+        std::string value = characteristic->getValue();
+        xSemaphoreTake(emulatorLock, portMAX_DELAY);
+        emulator->receive((const uint8_t*)value.data(), value.length(), esp_timer_get_time());
+        xSemaphoreGive(emulatorLock);
+    }
+};
+
+void setup() {
+    Serial.begin(115200);
+    emulatorLock = xSemaphoreCreateMutex();
+
+    BLEDevice::init(EMULATOR_NAME);
+    BLEDevice::setMTU(EMULATOR_MTU);
+    server = BLEDevice::createServer();
+    server->setCallbacks(new ServerCallbacks());
+
+    BLEService* service = server->createService(serviceUUID);
+    txCharacteristic = service->createCharacteristic(charUUID_TX, BLECharacteristic::PROPERTY_NOTIFY);
+    txCharacteristic->addDescriptor(new BLE2902());
+    BLECharacteristic* rx = service->createCharacteristic(
+        charUUID_RX, BLECharacteristic::PROPERTY_WRITE | BLECharacteristic::PROPERTY_WRITE_NR);
+    rx->setCallbacks(new RxCallbacks());
+    service->start();
+
+    EmulatorConfig config;
+    config.controllerId = EMULATOR_CONTROLLER_ID;
+    config.canIds = EMULATOR_CAN_IDS;
+    config.canCount = sizeof(EMULATOR_CAN_IDS);
+    config.fwMajor = EMULATOR_FW_MAJOR;
+    config.fwMinor = EMULATOR_FW_MINOR;
+    config.latencyUs = EMULATOR_LATENCY_US;
+    config.jitterUs = EMULATOR_JITTER_US;
+    config.mtu = EMULATOR_CHUNK_LIMIT ? EMULATOR_CHUNK_LIMIT : EMULATOR_MTU - 3;
+    config.dropPerMille = EMULATOR_DROP_PER_MILLE;
+    config.seed = esp_random();
+    emulator = new VescEmulator(config, notifyChunk);
+
+    BLEAdvertising* advertising = BLEDevice::getAdvertising();
+    advertising->addServiceUUID(serviceUUID);
+    advertising->setScanResponse(true);
+    BLEDevice::startAdvertising();
+    LOG_I(APP, "%s advertising as controller %u, FW %u.%u", EMULATOR_NAME, EMULATOR_CONTROLLER_ID,
+          EMULATOR_FW_MAJOR, EMULATOR_FW_MINOR);
+}
+
+void loop() {
+    static uint32_t lastStats = 0;
+
+    xSemaphoreTake(emulatorLock, portMAX_DELAY);
+    emulator->poll(esp_timer_get_time());
+    xSemaphoreGive(emulatorLock);
+
+    if (millis() - lastStats >= EMULATOR_STATS_MS) {
+        lastStats = millis();
+        LOG_I(APP, "Emulator: %u requests, %u replies, %u dropped, %u unknown",
+              (unsigned)emulator->requests(), (unsigned)emulator->replies(),
+              (unsigned)emulator->dropped(), (unsigned)emulator->unknown());
+    }
+    delay(1);
+}
@@ -0,0 +1,352 @@
+// Host converter from the dashboard's ride logs (storage/log_format.h) to
+// tables. Built by the `native-export` PlatformIO environment:
+//
+//   pio run -e native-export
+//   .pio/build/native-export/program [-j threads] [-o dir] [--columns] ride*.vdl
+//
+// Each log becomes ride0001.csv next to it (or in -o dir): time_ms,
+// unix_ms, then one column per LogValue in its units, a value left empty
+// in a sample whose fields did not carry it. --columns writes a directory
+// ride0001/ of little-endian arrays instead, one file per column
+// (time_ms.u32, unix_ms.i64, fields.u32 and <value>.i32 as the raw
+// fixed-point integers) with a columns.txt giving each one's decimals,
+// for numpy.fromfile() or a Parquet writer.
+//
+// Column names, decimals and the field each value belongs to come from
+// LOG_VALUE_INFO, the table the firmware itself uses, so a new value
+// needs no change here. Files are decoded on a pool of threads; a closed
+// file is also split at its block index, each stretch between entries
+// decoded on its own (every block starts with a keyframe), and the parts
+// joined in order. A file without a footer, cut short by power loss, is
+// read as one stretch up to its last valid block.
+
+#include "../storage/log_format.h"
+
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+static const size_t WRITE_BUFFER = 1 << 20;
+static const uint32_t MIN_CHUNK_BYTES = 64 * 1024;  // Smaller stretches are joined to the next
+
+struct ExportSample {
+    LogSample sample;
+    int64_t unixMs;                  // 0 if the block had no wall clock
+};
+
+struct ExportChunk {
+    uint32_t begin;                  // File offsets of the blocks decoded
+    uint32_t end;
+    std::vector<ExportSample> samples;
+    uint32_t badBlocks;
+};
+
+struct ExportFile {
+    std::string input;
+    std::string output;
+    std::vector<uint8_t> data;
+    std::vector<ExportChunk> chunks;
+    std::atomic<uint32_t> pending;   // Chunks not yet decoded
+    bool ok;
+
+    ExportFile() : pending(0), ok(false) {}
+};
+
+struct ExportJob {
+    ExportFile* file;
+    uint32_t chunk;
+};
+
+static bool columnsOut = false;
+static std::mutex printMutex;
+
+static void report(const char* format, const char* path, const char* detail) {
+    std::lock_guard<std::mutex> lock(printMutex);
+    fprintf(stderr, format, path, detail);
+}
+
+static bool readFile(const std::string& path, std::vector<uint8_t>& out) {
+    FILE* file = fopen(path.c_str(), "rb");
+    if (file == nullptr) return false;
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    out.resize(size > 0 ? size : 0);
+    bool ok = size >= 0 && fread(out.data(), 1, out.size(), file) == out.size();
+    fclose(file);
+    return ok;
+}
+
+// Split a file at its index, or keep it whole without one
+static bool planChunks(ExportFile& file) {
+    const std::vector<uint8_t>& data = file.data;
+    LogFileHeader header;
+    if (data.size() < LOG_SECTOR_SIZE) return false;
+    memcpy(&header, data.data(), sizeof(header));
+    if (header.magic != LOG_MAGIC) {
+        report("%s: %s\n", file.input.c_str(), "not a ride log");
+        return false;
+    }
+    if (header.version != LOG_FORMAT_VERSION || header.valueCount != LOG_VALUE_COUNT) {
+        report("%s: %s\n", file.input.c_str(), "written by another log format version");
+        return false;
+    }
+
+    uint32_t blocksEnd = (uint32_t)data.size();
+    std::vector<uint32_t> starts(1, (uint32_t)LOG_SECTOR_SIZE);
+    LogFooter footer;
+    if (data.size() >= LOG_SECTOR_SIZE + sizeof(footer)) {
+        memcpy(&footer, data.data() + data.size() - sizeof(footer), sizeof(footer));
+        if (logFooterValid(footer, (uint32_t)data.size())) {
+            blocksEnd = footer.indexOffset;
+            for (uint32_t i = 0; i < footer.indexCount; i++) {
+                LogIndexEntry entry;
+                memcpy(&entry, data.data() + footer.indexOffset + i * sizeof(entry), sizeof(entry));
+                if (entry.offset >= blocksEnd || entry.offset < starts.back() + MIN_CHUNK_BYTES) continue;
+                starts.push_back(entry.offset);
+            }
+        }
+    }
+
+    file.chunks.resize(starts.size());
+    for (size_t i = 0; i < starts.size(); i++) {
+        file.chunks[i].begin = starts[i];
+        file.chunks[i].end = i + 1 < starts.size() ? starts[i + 1] : blocksEnd;
+        file.chunks[i].badBlocks = 0;
+    }
+    file.pending.store((uint32_t)starts.size());
+    return true;
+}
+
+// Decode the blocks of one stretch, stopping at the first that does not
+// check out
+static void decodeChunk(const std::vector<uint8_t>& data, ExportChunk& chunk) {
+    uint32_t offset = chunk.begin;
+    while (offset + sizeof(LogBlockHeader) <= chunk.end) {
+        LogBlockHeader header;
+        memcpy(&header, data.data() + offset, sizeof(header));
+        const uint8_t* payload = data.data() + offset + sizeof(header);
+        if (header.magic != LOG_BLOCK_MAGIC || header.payloadLength > chunk.end - offset - sizeof(header) ||
+            logCrc32(logBlockHeaderCrc(header), payload, header.payloadLength) != header.crc) {
+            chunk.badBlocks++;
+            break;
+        }
+
+        ExportSample row;
+        LogSample previous = {};
+        size_t used;
+        for (size_t at = 0; at < header.payloadLength; at += used) {
+            used = logDecodeFrame(payload + at, header.payloadLength - at, previous, row.sample);
+            if (used == 0) {
+                chunk.badBlocks++;
+                break;
+            }
+            row.unixMs = header.unixMs ? (int64_t)header.unixMs + (int32_t)(row.sample.timeMs - header.firstTimeMs)
+                                       : 0;
+            chunk.samples.push_back(row);
+            previous = row.sample;
+        }
+        offset += logBlockSpan(header.payloadLength);
+    }
+}
+
+// A fixed-point value in its units, without going through a float
+static char* formatFixed(char* out, int32_t value, uint8_t decimals) {
+    char digits[16];
+    uint32_t magnitude = value < 0 ? 0u - (uint32_t)value : (uint32_t)value;
+    int n = 0;
+    do {
+        digits[n++] = (char)('0' + magnitude % 10);
+        magnitude /= 10;
+    } while (magnitude > 0 || n <= decimals);
+    if (value < 0) *out++ = '-';
+    while (n > 0) {
+        if (n == decimals) *out++ = '.';
+        *out++ = digits[--n];
+    }
+    return out;
+}
+
+class Writer {
+public:
+    Writer(FILE* file) : file(file), used(0) { buffer = (char*)malloc(WRITE_BUFFER); }
+    ~Writer() {
+        flush();
+        free(buffer);
+    }
+
+    // Room for a row at least
+    char* reserve() {
+        if (used > WRITE_BUFFER - 1024) flush();
+        return buffer + used;
+    }
+    void commit(char* end) { used = end - buffer; }
+    void flush() {
+        if (used > 0) fwrite(buffer, 1, used, file);
+        used = 0;
+    }
+
+private:
+    FILE* file;
+    char* buffer;
+    size_t used;
+};
+
+static bool writeCsv(const ExportFile& file) {
+    FILE* out = fopen(file.output.c_str(), "wb");
+    if (out == nullptr) return false;
+    Writer writer(out);
+    char* p = writer.reserve();
+    p += sprintf(p, "time_ms,unix_ms");
+    for (int i = 0; i < LOG_VALUE_COUNT; i++) p += sprintf(p, ",%s", LOG_VALUE_INFO[i].name);
+    *p++ = '\n';
+    writer.commit(p);
+
+    for (const ExportChunk& chunk : file.chunks) {
+        for (const ExportSample& row : chunk.samples) {
+            p = writer.reserve();
+            p += sprintf(p, "%u,", (unsigned)row.sample.timeMs);
+            if (row.unixMs) p += sprintf(p, "%lld", (long long)row.unixMs);
+            for (int i = 0; i < LOG_VALUE_COUNT; i++) {
+                *p++ = ',';
+                const LogValueInfo& info = LOG_VALUE_INFO[i];
+                if (info.field == 0 || (row.sample.fields & info.field)) {
+                    p = formatFixed(p, row.sample.values[i], info.decimals);
+                }
+            }
+            *p++ = '\n';
+            writer.commit(p);
+        }
+    }
+    writer.flush();
+    return fclose(out) == 0;
+}
+
+template <typename T, typename Get>
+static bool writeColumn(const ExportFile& file, const char* name, const char* type, Get get) {
+    std::string path = file.output + "/" + name + "." + type;
+    FILE* out = fopen(path.c_str(), "wb");
+    if (out == nullptr) return false;
+    std::vector<T> column;
+    for (const ExportChunk& chunk : file.chunks) {
+        for (const ExportSample& row : chunk.samples) column.push_back(get(row));
+    }
+    bool ok = fwrite(column.data(), sizeof(T), column.size(), out) == column.size();
+    return fclose(out) == 0 && ok;
+}
+
+static bool writeColumns(const ExportFile& file) {
+    mkdir(file.output.c_str(), 0755);
+    bool ok = writeColumn<uint32_t>(file, "time_ms", "u32", [](const ExportSample& r) { return r.sample.timeMs; }) &&
+              writeColumn<int64_t>(file, "unix_ms", "i64", [](const ExportSample& r) { return r.unixMs; }) &&
+              writeColumn<uint32_t>(file, "fields", "u32", [](const ExportSample& r) { return r.sample.fields; });
+    for (int i = 0; i < LOG_VALUE_COUNT && ok; i++) {
+        ok = writeColumn<int32_t>(file, LOG_VALUE_INFO[i].name, "i32",
+                                  [i](const ExportSample& r) { return r.sample.values[i]; });
+    }
+
+    std::string path = file.output + "/columns.txt";
+    FILE* out = fopen(path.c_str(), "w");
+    if (out == nullptr) return false;
+    fprintf(out, "time_ms u32 0 0\nunix_ms i64 0 0\nfields u32 0 0\n");
+    for (int i = 0; i < LOG_VALUE_COUNT; i++) {
+        fprintf(out, "%s i32 %u 0x%08x\n", LOG_VALUE_INFO[i].name, (unsigned)LOG_VALUE_INFO[i].decimals,
+                (unsigned)LOG_VALUE_INFO[i].field);
+    }
+    return fclose(out) == 0 && ok;
+}
+
+// The worker that decodes a file's last chunk writes the file out
+static void finishFile(ExportFile& file) {
+    size_t samples = 0;
+    uint32_t bad = 0;
+    for (const ExportChunk& chunk : file.chunks) {
+        samples += chunk.samples.size();
+        bad += chunk.badBlocks;
+    }
+    file.ok = columnsOut ? writeColumns(file) : writeCsv(file);
+    char detail[96];
+    snprintf(detail, sizeof(detail), "%zu samples, %zu stretches%s%s", samples, file.chunks.size(),
+             bad ? ", stopped at a bad block" : "", file.ok ? "" : ", could not write");
+    report("%s: %s\n", file.output.c_str(), detail);
+    std::vector<uint8_t>().swap(file.data);
+    std::vector<ExportChunk>().swap(file.chunks);
+}
+
+static std::string outputPath(const std::string& input, const char* directory) {
+    std::string base = input;
+    size_t slash = base.find_last_of('/');
+    std::string name = slash == std::string::npos ? base : base.substr(slash + 1);
+    std::string folder = directory ? std::string(directory) : (slash == std::string::npos ? "." : base.substr(0, slash));
+    size_t dot = name.find_last_of('.');
+    if (dot != std::string::npos) name = name.substr(0, dot);
+    return folder + "/" + name + (columnsOut ? "" : ".csv");
+}
+
+static void usage() {
+    fprintf(stderr, "usage: log_export [-j threads] [-o dir] [--columns] ride.vdl ...\n");
+}
+
+int main(int argc, char** argv) {
+    unsigned threads = std::thread::hardware_concurrency();
+    const char* directory = nullptr;
+    std::vector<std::string> inputs;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+            threads = (unsigned)atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+            directory = argv[++i];
+        } else if (strcmp(argv[i], "--columns") == 0) {
+            columnsOut = true;
+        } else if (argv[i][0] == '-') {
+            usage();
+            return 2;
+        } else {
+            inputs.push_back(argv[i]);
+        }
+    }
+    if (inputs.empty()) {
+        usage();
+        return 2;
+    }
+    if (threads == 0) threads = 1;
+    if (directory) mkdir(directory, 0755);
+
+    std::vector<ExportFile> files(inputs.size());
+    std::vector<ExportJob> jobs;
+    for (size_t i = 0; i < inputs.size(); i++) {
+        ExportFile& file = files[i];
+        file.input = inputs[i];
+        file.output = outputPath(inputs[i], directory);
+        if (!readFile(file.input, file.data)) {
+            report("%s: %s\n", file.input.c_str(), "cannot read");
+            continue;
+        }
+        if (!planChunks(file)) continue;
+        for (uint32_t c = 0; c < file.chunks.size(); c++) jobs.push_back({ &file, c });
+    }
+
+    std::atomic<size_t> next(0);
+    std::vector<std::thread> pool;
+    for (unsigned t = 0; t < threads; t++) {
+        pool.push_back(std::thread([&]() {
+            size_t j;
+            while ((j = next.fetch_add(1)) < jobs.size()) {
+                ExportFile& file = *jobs[j].file;
+                decodeChunk(file.data, file.chunks[jobs[j].chunk]);
+                if (file.pending.fetch_sub(1) == 1) finishFile(file);
+            }
+        }));
+    }
+    for (std::thread& thread : pool) thread.join();
+
+    int failed = 0;
+    for (const ExportFile& file : files) failed += !file.ok;
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+// Feature modules chosen at compile time. Each FEATURE_* is 1 unless the
+// build sets it to 0, as the m5stack-core2-lean env does (platformio.ini);
+// tools/env_sizes.py compares what each env costs in flash and RAM.
+//
+// A module that is out has the settings that enable it forced off in
+// src/main.cpp, written FEATURE_X && <setting>, so every call into it
+// sits behind a constant and is compiled away; its sources are then left
+// out of the build with a -<file> in the env's build_src_filter.
+// Anything else that reaches into a module tests its FEATURE_* the same
+// way.
+
+// SD card ride logs: recording, the ride review and log playback, and
+// the BLE log download service
+// (storage/telemetry_log, log_review, log_playback; ble/log_service)
+#ifndef FEATURE_LOGGING
+#define FEATURE_LOGGING 1
+#endif
+
+// WiFi: log upload, firmware updates and rollback, the live stream
+// (storage/log_upload; system/firmware_update, wifi_station;
+// telemetry/live_stream)
+#ifndef FEATURE_WIFI
+#define FEATURE_WIFI 1
+#endif
+
+// A GPS receiver on Port C (telemetry/gps, gps_parser)
+#ifndef FEATURE_GPS
+#define FEATURE_GPS 1
+#endif
+
+// Custom fields from the formulas file (telemetry/formula)
+#ifndef FEATURE_FORMULAS
+#define FEATURE_FORMULAS 1
+#endif
+
+// More than one VESC BLE module connected at once. Out, BLE_MAX_LINKS is
+// 1; the per-link tables keep their VESC_MAX_LINKS entries.
+#ifndef FEATURE_MULTI_LINK
+#define FEATURE_MULTI_LINK 1
+#endif
+
+// The BLE host stack behind ble/ble_host.h and ble/ble_transport.h: 0
+// for Bluedroid through the ESP32 BLE Arduino library, 1 for
+// NimBLE-Arduino (the m5stack-core2-nimble env). The log download
+// service's GATT server is written against Bluedroid, so it is out with
+// NimBLE (ble/log_service).
+#ifndef BLE_BACKEND_NIMBLE
+#define BLE_BACKEND_NIMBLE 0
+#endif
@@ -0,0 +1,205 @@
+// libFuzzer target for the receive path of the VESC protocol code: the
+// framer, the CAN buffer reassembly, the capture reader and every reply
+// decoder. Built by the `native-fuzz` PlatformIO environment (clang):
+//
+//   pio run -e native-fuzz
+//   .pio/build/native-fuzz/program -max_len=4096 fuzz/corpus
+//
+// Seed the corpus from recorded captures with tools/fuzz_corpus.py. Any
+// crash, sanitizer report or leak is a bug in the code under test; the
+// input that found it is written next to the program, and passing that
+// file alone replays it.
+//
+// The first byte of an input picks what the rest is:
+//
+//   low two bits 0   a BLE notification stream, fed to a framer in
+//                    notifications of (byte >> 2) + 1 bytes
+//   low two bits 1   one payload, handed to the decoders without the
+//                    framer (so without a CRC to get past)
+//   low two bits 2   CAN frames for VescCanBuffer and decodeCanStatus():
+//                    [type][length][data...] each
+//   low two bits 3   a capture file for replayCapture()
+//
+// Every payload that comes out of the framer or the CAN buffer goes
+// through all the decoders, whatever its command byte, so each decoder
+// also sees replies meant for another.
+//
+// Built with -DFUZZ_STANDALONE instead, for a compiler without libFuzzer,
+// a main() runs the target once on each file given, or on each file of a
+// directory given.
+
+#include "../vesc/can.h"
+#include "../vesc/can_buffer.h"
+#include "../vesc/can_status.h"
+#include "../vesc/config.h"
+#include "../vesc/firmware_upload.h"
+#include "../vesc/framer.h"
+#include "../vesc/replay.h"
+#include "../vesc/samples.h"
+#include "../vesc/values.h"
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+static const uint8_t OWN_CAN_ID = 2;
+static const uint32_t UPLOAD_IMAGE_BYTES = 4096;
+static const size_t UPLOAD_WRITE_LIMIT = 244;
+
+// Each firmware generation with its own COMM_GET_VALUES layout
+static const VescFirmware FIRMWARES[] = {{0, 0}, {3, 40}, {5, 1}, {5, 2}, {5, 3}, {6, 0}, {6, 5}};
+
+static const uint32_t MASKS[] = {
+    VALUES_MASK_POWER, VALUES_MASK_TEMPS, VALUES_MASK_FAULT, VALUES_MASK_ENERGY,
+    VALUES_MASK_POWER | VALUES_FIELD_CONTROLLER_ID, VALUES_ALL_FIELDS
+};
+
+static size_t readImage(uint32_t offset, uint8_t* out, size_t length, void* context) {
+    memset(out, (uint8_t)offset, length);
+    return length;
+}
+
+static uint64_t noClock() { return 0; }
+static void noSleep(uint32_t us) {}
+
+// Upload state is per input, so a crash replays from the input alone
+struct FuzzRun {
+    VescFirmwareUpload upload;
+    uint32_t now;
+
+    FuzzRun() : upload(readImage, nullptr), now(0) {}
+};
+
+static void decodeAll(const uint8_t* payload, size_t length, FuzzRun& run) {
+    VescFirmware fw = {};
+    decodeFwVersion(payload, length, fw);
+    VescIdentity identity = {};
+    decodeFwIdentity(payload, length, identity);
+
+    VescValues values = {};
+    for (size_t i = 0; i < sizeof(FIRMWARES) / sizeof(FIRMWARES[0]); i++) {
+        const ValuesLayout& layout = valuesLayoutForFirmware(FIRMWARES[i]);
+        decodeValues(payload, length, layout, values);
+        valuesReplyControllerId(payload, length, layout);
+
+        VescConfig config = {};
+        decodeMcconf(payload, length, FIRMWARES[i], config);
+    }
+    decodeValuesSelective(payload, length, values);
+    for (size_t i = 0; i < sizeof(MASKS) / sizeof(MASKS[0]); i++) {
+        valuesDecoderForMask(MASKS[i])(payload, length, values);
+    }
+
+    VescConfig config = {};
+    decodeAppconf(payload, length, config);
+    VescSample sample = {};
+    decodeSample(payload, length, sample);
+    uint8_t ids[8];
+    decodePingCan(payload, length, ids, sizeof(ids));
+
+    // Acks for the upload, which then sends whatever they let it
+    uint8_t out[VescFirmwareUpload::MAX_PAYLOAD];
+    run.upload.onReply(payload, length, run.now);
+    run.now += 7;
+    while (run.upload.next(out, run.now) > 0) run.upload.sent(run.now);
+}
+
+static void onFrame(const uint8_t* payload, size_t length, void* context) {
+    decodeAll(payload, length, *(FuzzRun*)context);
+}
+
+static bool dropFrame(uint32_t id, const uint8_t* data, uint8_t length, void* context) {
+    return true;
+}
+
+static void fuzzStream(const uint8_t* data, size_t size, size_t chunk, FuzzRun& run) {
+    VescFramer framer(onFrame, &run);
+    for (size_t done = 0; done < size; done += chunk) {
+        size_t n = size - done < chunk ? size - done : chunk;
+        framer.feed(data + done, n, done);
+    }
+}
+
+static void fuzzCanFrames(const uint8_t* data, size_t size, FuzzRun& run) {
+    VescCanBuffer can(OWN_CAN_ID, dropFrame, onFrame, &run);
+    VescValues values = {};
+    size_t i = 0;
+    while (i + 2 <= size) {
+        uint32_t id = (uint32_t)data[i] << 8 | OWN_CAN_ID;
+        uint8_t length = data[i + 1] % 9;
+        i += 2;
+        if (i + length > size) break;
+        can.onFrame(id, data + i, length);
+        decodeCanStatus(id, data + i, length, values);
+        i += length;
+    }
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
+    if (size < 1) return 0;
+    uint8_t mode = data[0] & 3;
+    FuzzRun run;
+    run.upload.start(UPLOAD_IMAGE_BYTES, VescFirmwareUpload::MAX_WINDOW, UPLOAD_WRITE_LIMIT);
+    // Reading the image for its CRC before the erase goes out
+    uint8_t out[VescFirmwareUpload::MAX_PAYLOAD];
+    while (run.upload.state() == VescFirmwareUpload::UPLOAD_CHECKING) run.upload.next(out, 0);
+    if (run.upload.next(out, 0) > 0) run.upload.sent(0);
+
+    switch (mode) {
+        case 0:
+            fuzzStream(data + 1, size - 1, (data[0] >> 2) + 1, run);
+            break;
+        case 1:
+            decodeAll(data + 1, size - 1, run);
+            break;
+        case 2:
+            fuzzCanFrames(data + 1, size - 1, run);
+            break;
+        case 3: {
+            ReplayReport report;
+            replayCapture(data + 1, size - 1, false, noClock, noSleep, report);
+            break;
+        }
+    }
+    return 0;
+}
+
+#ifdef FUZZ_STANDALONE
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+static int runFile(const char* path) {
+    FILE* file = fopen(path, "rb");
+    if (file == nullptr) return 0;
+    std::vector<uint8_t> input;
+    uint8_t buffer[4096];
+    size_t n;
+    while ((n = fread(buffer, 1, sizeof(buffer), file)) > 0) input.insert(input.end(), buffer, buffer + n);
+    fclose(file);
+    LLVMFuzzerTestOneInput(input.data(), input.size());
+    return 1;
+}
+
+int main(int argc, char** argv) {
+    int inputs = 0;
+    for (int i = 1; i < argc; i++) {
+        DIR* dir = opendir(argv[i]);
+        if (dir == nullptr) {
+            inputs += runFile(argv[i]);
+            continue;
+        }
+        struct dirent* entry;
+        char path[1024];
+        while ((entry = readdir(dir)) != nullptr) {
+            if (entry->d_name[0] == '.') continue;
+            snprintf(path, sizeof(path), "%s/%s", argv[i], entry->d_name);
+            inputs += runFile(path);
+        }
+        closedir(dir);
+    }
+    printf("Ran %d inputs\n", inputs);
+    return 0;
+}
+#endif
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <Arduino.h>
+
+// Compile-time gated logging.
+//
+// Levels follow CORE_DEBUG_LEVEL from platformio.ini:
+//   0 none, 1 error, 2 warn, 3 info, 4 debug, 5 verbose
+//
+// Every subsystem can be raised or lowered on its own by defining
+// LOG_LEVEL_<SUBSYSTEM> in build_flags (e.g. -DLOG_LEVEL_PROTO=5 to get
+// per-packet hex dumps). Statements above the active level are removed
+// by the compiler, including the formatting of their arguments.
+
+#define LOG_LEVEL_NONE 0
+#define LOG_LEVEL_ERROR 1
+#define LOG_LEVEL_WARN 2
+#define LOG_LEVEL_INFO 3
+#define LOG_LEVEL_DEBUG 4
+#define LOG_LEVEL_VERBOSE 5
+
+#ifndef LOG_LEVEL
+#ifdef CORE_DEBUG_LEVEL
+#define LOG_LEVEL CORE_DEBUG_LEVEL
+#else
+#define LOG_LEVEL LOG_LEVEL_INFO
+#endif
+#endif
+
+// Subsystems
+#ifndef LOG_LEVEL_APP
+#define LOG_LEVEL_APP LOG_LEVEL
+#endif
+#ifndef LOG_LEVEL_BLE
+#define LOG_LEVEL_BLE LOG_LEVEL
+#endif
+#ifndef LOG_LEVEL_PROTO
+#define LOG_LEVEL_PROTO LOG_LEVEL
+#endif
+#ifndef LOG_LEVEL_UI
+#define LOG_LEVEL_UI LOG_LEVEL
+#endif
+
+#define LOG_ENABLED(sub, level) (LOG_LEVEL_##sub >= (level))
+
+#define LOG_AT(sub, level, fmt, ...) \
+    do { \
+        if (LOG_ENABLED(sub, level)) Serial.printf(fmt "\n", ##__VA_ARGS__); \
+    } while (0)
+
+#define LOG_E(sub, fmt, ...) LOG_AT(sub, LOG_LEVEL_ERROR, fmt, ##__VA_ARGS__)
+#define LOG_W(sub, fmt, ...) LOG_AT(sub, LOG_LEVEL_WARN, fmt, ##__VA_ARGS__)
+#define LOG_I(sub, fmt, ...) LOG_AT(sub, LOG_LEVEL_INFO, fmt, ##__VA_ARGS__)
+#define LOG_D(sub, fmt, ...) LOG_AT(sub, LOG_LEVEL_DEBUG, fmt, ##__VA_ARGS__)
+#define LOG_V(sub, fmt, ...) LOG_AT(sub, LOG_LEVEL_VERBOSE, fmt, ##__VA_ARGS__)
+
+// Hex dump of a buffer, truncated to maxBytes
+#define LOG_HEX(sub, level, label, data, length, maxBytes) \
+    do { \
+        if (LOG_ENABLED(sub, level)) logHexDump(label, data, length, maxBytes); \
+    } while (0)
+
+inline void logHexDump(const char* label, const uint8_t* data, size_t length, size_t maxBytes) {
+    Serial.print(label);
+    for (size_t i = 0; i < length && i < maxBytes; i++) {
+        Serial.printf("%02X ", data[i]);
+    }
+    if (length > maxBytes) Serial.print("...");
+    Serial.printf(" (len=%d)\n", length);
+}
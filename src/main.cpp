@@ -1,820 +1,5716 @@
 #include <M5Core2.h>
-#include "BLEDevice.h"
-#include "BLEUtils.h"
-#include "BLEScan.h"
-#include "BLEAdvertisedDevice.h"
-#include "BLEClient.h"
-#include "BLERemoteService.h"
-#include "BLERemoteCharacteristic.h"
-#include <vector>
+#include <SD.h>
+#include <SPIFFS.h>
 #include <string>
+#include "feature_flags.h"
+#include "vesc/protocol.h"
+#include "vesc/framer.h"
+#include "vesc/packet.h"
+#include "vesc/values.h"
+#include "vesc/can.h"
+#include "vesc/can_status.h"
+#include "vesc/command.h"
+#include "vesc/write_batch.h"
+#include "vesc/tx_scheduler.h"
+#include "vesc/heartbeat.h"
+#include "vesc/requests.h"
+#include "vesc/poll_schedule.h"
+#include "vesc/link_quality.h"
+#include "vesc/link_analyzer.h"
+#include "vesc/throughput.h"
+#include "vesc/values_cache.h"
+#include "vesc/config.h"
+#include "vesc/dispatch.h"
+#include "vesc/samples.h"
+#include "vesc/bms.h"
+#include "vesc/firmware_upload.h"
+#include "log.h"
+#include "ble/link_params.h"
+#include "ble/bonding.h"
+#include "ble/ble_host.h"
+#include "ble/connection_manager.h"
+#include "ble/rx_queue.h"
+#include "ble/capture.h"
+#include "ble/usb_bridge.h"
+#include "ble/log_service.h"
+#include "ble/soak_test.h"
+#include "ble/last_devices.h"
+#include "wired/uart_link.h"
+#include "wired/can_link.h"
+#include "system/heap_stats.h"
+#include "system/app_events.h"
+#include "system/coexist.h"
+#include "system/perf_stats.h"
+#include "system/probes.h"
+#include "system/memory.h"
+#include "system/crash_report.h"
+#include "system/event_trace.h"
+#include "system/boot_profile.h"
+#include "system/power.h"
+#include "system/sensors.h"
+#include "system/settings.h"
+#include "system/spi_bus.h"
+#include "system/task_layout.h"
+#include "system/spsc_queue.h"
+#include "system/audio.h"
+#include "system/haptics.h"
+#include "system/i2c_bus.h"
+#include "system/wall_clock.h"
+#include "system/parking.h"
+#include "system/firmware_update.h"
+#include "telemetry/telemetry.h"
+#include "telemetry/gps.h"
+#include "telemetry/imu.h"
+#include "telemetry/fixed_point.h"
+#include "telemetry/fault_capture.h"
+#include "telemetry/fleet.h"
+#include "telemetry/scope.h"
+#include "telemetry/energy.h"
+#include "telemetry/drivetrain.h"
+#include "telemetry/odometer.h"
+#include "telemetry/derived.h"
+#include "telemetry/ride_stats.h"
+#include "telemetry/units.h"
+#include "telemetry/alerts.h"
+#include "telemetry/live_stream.h"
+#include "telemetry/serial_stream.h"
+#include "telemetry/laps.h"
+#include "storage/telemetry_log.h"
+#include "storage/log_upload.h"
+#include "storage/log_review.h"
+#include "storage/log_playback.h"
+#include "storage/screenshot.h"
+#include "storage/config_cache.h"
+#include "ui/widgets.h"
+#include "ui/strip_chart.h"
+#include "ui/input.h"
+#include "ui/screen.h"
+#include "ui/layout.h"
+#include "ui/layout_page.h"
+#include "ui/console.h"
+#include "ui/scroll_view.h"
+#include "ui/list_view.h"
+#include "ui/render_governor.h"
+#include "ui/render_bench.h"
+#include "ui/glyph_cache.h"
+#include "ui/sprite_panel.h"
+#include "ui/cell_grid.h"
+#include "ui/cell_heatmap.h"
+#include "ui/text_strip.h"
+#include "ui/unicode_text.h"
+#include "ui/ui_assets.h"
+#include "ui/qr_code.h"
+#include "ui/display.h"
 
 // ============== USER CONFIGURABLE SETTINGS ==============
+// Settings marked [live] are defaults: hold B in the device list to
+// change them on the device, where they are applied at once and kept in
+// NVS once saved. Settings written FEATURE_X && <setting> are forced
+// off in builds without that module (see feature_flags.h).
 // BLE Scan Settings
-const int BLE_SCAN_TIME_SECONDS = 3;        // How long to scan for BLE devices
+const int BLE_SCAN_TIME_SECONDS = 3;        // How long to scan for BLE devices [live]
+const bool BLE_SCAN_CONTINUOUS = true;      // Scan in the background while the list is up, updating it live
+const int32_t BLE_SCAN_COMPANY_ID = -1;     // Also list advertisers with this manufacturer id (-1: off)
+const bool BLE_SCAN_NAME_FALLBACK = true;   // Also list devices with "VESC" in the name but no NUS UUID
+const int32_t BLE_BEACON_COMPANY_ID = -1;   // Read status beacons with this manufacturer id into the fleet table (-1: off)
+const bool AUTO_CONNECT_LAST = true;        // At boot, connect straight to the last used VESC (hold A to scan instead)
+const bool BLE_PREWARM_LAST = true;         // If it did not answer, connect it once a scan hears it ranked first
+const bool BLE_SCAN_ADAPTIVE = true;        // Scan passive first, going active only for names; stop once the last used VESC is heard
+const uint32_t BLE_SCAN_PASSIVE_MS = 1500;  // Longest a list scan stays passive
+
+// BLE Link Settings
+const int BLE_MAX_LINKS = FEATURE_MULTI_LINK ? 2 : 1; // VESC BLE modules connected at once (1-3); hold C in the device list to add one
+const uint16_t BLE_MTU = 517;               // Largest ATT MTU to negotiate (a full values reply fits in one notification)
+const bool BLE_RELEASE_CLASSIC = true;      // Start the controller BLE only, handing the Classic BT memory to the heap (NimBLE always does)
+const BleLinkProfile& BLE_LINK_PROFILE = BLE_PROFILE_PERFORMANCE; // Connection interval/latency profile (PERFORMANCE, BALANCED, POWER_SAVE)
+const uint32_t BLE_SUPERVISION_TIMEOUT_MS = 400; // Stack reports a silent peer lost after this (0: the profile's)
+const bool BLE_BONDING = true;              // Bond with modules that ask to pair, so reconnects only resume encryption
+const uint32_t BLE_ENCRYPT_DEADLINE_MS = 3000;    // Longest a reconnect waits for a bond's encryption to resume
+// The BLE library waits on the stack without timeouts; a connect step
+// still waiting after these has its link dropped and is retried
+const uint32_t BLE_CONNECT_DEADLINE_MS = 10000;   // Per address type tried
+const uint32_t BLE_DISCOVERY_DEADLINE_MS = 8000;  // GATT service search
+const uint32_t BLE_SUBSCRIBE_DEADLINE_MS = 3000;  // CCCD write after a full discovery
+const bool BLE_DIRECT_NOTIFY = true;        // Take notifications from the GATTC event, not the library's characteristic callback (Bluedroid)
+const BleWriteMode BLE_WRITE_MODE = BLE_WRITE_AUTO; // Write without response when the VESC allows it (AUTO, WITH_RESPONSE, NO_RESPONSE)
+const uint32_t BLE_WRITE_RETRY_MS = 2;      // Retry period for writes the BLE stack had no room for
+// Control frames (setpoints, keepalives) go out ahead of telemetry; each
+// class is held to a frame rate per link so neither crowds out the other
+const uint16_t CONTROL_TX_MAX_FPS = 50;     // Control frames per second (0: no limit)
+const uint16_t CONTROL_TX_BURST = 4;
+const uint16_t TELEMETRY_TX_MAX_FPS = 0;    // Polls and bridged packets per second (0: no limit)
+const uint16_t TELEMETRY_TX_BURST = 16;
+
+// Wired VESC Settings. The m5stack-core2-wired-uart and -wired-can builds
+// talk to one VESC over a cable instead of BLE: its UART app on a
+// hardware UART, or the CAN bus through an external transceiver. The
+// link takes the place of the primary BLE link; there is no scan, and
+// the VESC counts as connected once it answers COMM_FW_VERSION.
+#ifdef WIRED_UART
+const bool WIRED_UART_ENABLED = true;
+#else
+const bool WIRED_UART_ENABLED = false;
+#endif
+#ifdef WIRED_CAN
+const bool WIRED_CAN_ENABLED = true;
+#else
+const bool WIRED_CAN_ENABLED = false;
+#endif
+const bool WIRED_ENABLED = WIRED_UART_ENABLED || WIRED_CAN_ENABLED;
+const int8_t WIRED_UART_RX_PIN = 13;        // Port C, to the VESC's TX (a GPS moves to other pins)
+const int8_t WIRED_UART_TX_PIN = 14;        // Port C, to the VESC's RX
+const uint32_t WIRED_UART_BAUD = 115200;    // The VESC's UART baud rate (app configuration)
+const int8_t WIRED_CAN_TX_PIN = 32;         // Port A, to the transceiver's TX
+const int8_t WIRED_CAN_RX_PIN = 33;         // Port A, from the transceiver's RX
+const uint16_t WIRED_CAN_KBIT = 500;        // The VESC's CAN baud rate (125, 250, 500, 1000)
+const uint8_t WIRED_CAN_OWN_ID = 254;       // The dashboard's CAN id; must not be a controller's
+const uint8_t WIRED_CAN_VESC_ID = 0;        // The controller to talk to; the others are reached through it
+const bool CAN_STATUS_ENABLED = true;       // Take telemetry from the controllers' CAN status broadcasts
+const uint32_t CAN_STATUS_HEARD_MS = 500;   // Fields broadcast this recently are left out of polls
 
 // VESC Data Refresh Settings  
-const int VESC_DATA_REFRESH_MS = 300;       // How often to request voltage data (milliseconds)
-const int VESC_DATA_STALE_TIMEOUT_MS = 5000; // When to show "No data" warning (milliseconds)
+const int VESC_DATA_REFRESH_MS = 50;        // Fastest telemetry poll period (milliseconds); slowed down on a slow link [live]
+const int VESC_DATA_MAX_REFRESH_MS = 2000;  // Slowest poll period however slow the link gets
+const int MAX_REQUESTS_IN_FLIGHT = 2;       // Telemetry requests allowed to await a reply at once
+const int STREAM_MAX_IN_FLIGHT = 6;         // ...opened up to this many on a clean link, so polling streams at the fastest period
+const int REQUEST_TIMEOUT_MS = 1000;        // Give up on a reply after this long
+
+// Per-quantity poll rates (Hz, 0 = off). Due quantities are merged into
+// one COMM_GET_VALUES_SELECTIVE request per tick.
+const int POLL_RATE_POWER_HZ = 20;          // Voltage, currents, duty, ERPM [live]
+const int POLL_RATE_TEMPS_HZ = 1;           // FET and motor temperature [live]
+const int POLL_RATE_FAULT_HZ = 2;           // Fault code (changes are logged) [live]
+const int POLL_RATE_ENERGY_HZ = 1;          // Watt-hour and distance counters (range estimate)
+const int POLL_COALESCE_MS = 20;            // Pull in quantities due within this window
+// Response cache: a field that came in with any reply or status
+// broadcast is left out of requests while still fresh, for this share
+// of its poll period less the round trip
+const uint32_t RESPONSE_CACHE_FIELDS = VALUES_MASK_TEMPS | VALUES_MASK_FAULT | VALUES_MASK_ENERGY;
+const uint8_t RESPONSE_CACHE_TTL_PERCENT = 75;
+const uint32_t POLL_ALWAYS_FIELDS = VALUES_FIELD_FAULT | // Polled whatever the page shows (fault changes are logged,
+    VALUES_FIELD_WATT_HOURS | VALUES_FIELD_WATT_HOURS_CHARGED | VALUES_FIELD_TACHOMETER_ABS; // the trip is counted)
+// Saturation: when a link's measured budget cannot carry every quantity
+// at its rate, the energy counters slow first, then the temperatures;
+// power and the fault code keep theirs. A widget whose value is older
+// than this many poll periods is drawn greyed.
+const int POLL_STALE_FACTOR = 3;
+const uint32_t POLL_STALE_MIN_MS = 1000;    // ...and never before this
+const int VESC_DATA_STALE_TIMEOUT_MS = 5000; // When to show "No data" warning (milliseconds) [live]
+
+// Link Quality Settings. Reply loss, CRC failures, RTT and RSSI are scored
+// per window; a degraded link is polled at half rate, a poor one at a
+// quarter with only the fields below, until it recovers.
+const int LINK_QUALITY_WINDOW_MS = 1000;    // Scoring window
+const uint32_t LINK_POOR_FIELDS = VALUES_FIELD_V_IN | VALUES_FIELD_CURRENT_IN | VALUES_FIELD_FAULT; // Polled on a poor link
+const int LINK_POOR_STALE_FACTOR = 2;       // A poor link gets this many stale timeouts before reconnecting
+// Link analyzer: swiping left on the stats overlay shows where a
+// link's air time goes: notifications per frame, bytes per notification,
+// the negotiated MTU and interval, request and reply rates, CRC failures
+// and the RTT spread, over the last few seconds.
+const uint32_t LINK_ANALYZER_REFRESH_MS = 500; // Figures taken this often (2 Hz)
+// Throughput Probe Settings. At connect a burst of full values requests
+// measures the bytes a second the link carries back, which a module's
+// UART bridge can cap below BLE; polls are then spaced and trimmed
+// (to LINK_POOR_FIELDS) to ask for no more than a share of it.
+const bool THROUGHPUT_PROBE_ENABLED = true;
+const uint8_t THROUGHPUT_PROBE_REQUESTS = 6;   // Requests in the burst
+const uint32_t THROUGHPUT_PROBE_TIMEOUT_MS = 1000; // Longest the probe waits for its replies
+const uint8_t THROUGHPUT_HEADROOM_PERCENT = 80; // Share of the measured rate polls may ask for
+// Heartbeat: COMM_ALIVE at least every HEARTBEAT_ALIVE_MS, riding along
+// with polls where it can. A link silent for HEARTBEAT_PROBE_MS is probed
+// (COMM_FW_VERSION), and one silent for HEARTBEAT_DEAD_MS is reconnected,
+// well before the stale timeout runs out.
+const uint32_t HEARTBEAT_ALIVE_MS = 500;
+const uint32_t HEARTBEAT_PROBE_MS = 750;
+const uint32_t HEARTBEAT_DEAD_MS = 2000;    // Doubled on a poor link, like the stale timeout
+const int LINK_LOST_MISSED_REPLIES = 2;     // Polls in a row past their RTT budget (at most MAX_REQUESTS_IN_FLIGHT), with nothing heard...
+const uint32_t LINK_LOST_SILENT_MS = 250;   // ...for at least this long, and the link is reconnected
+const bool USE_SELECTIVE_VALUES = true;     // Request only displayed fields (falls back to full values on old firmware)
+const int VESC_READY_TIMEOUT_MS = 1500;     // Max wait for the first reply after connecting
+const int VESC_READY_RETRY_MS = 500;        // Resend COMM_FW_VERSION this often while waiting
+
+// CAN Bus Settings (dual-motor boards)
+const bool CAN_DISCOVERY_ENABLED = true;    // Ping the VESC's CAN bus after connecting and poll every controller found too
+const int CAN_PING_TIMEOUT_MS = 2000;       // How long the VESC may take to answer the bus ping
+const bool VESC_CONFIG_READ_ENABLED = true; // Read the limits from mcconf/appconf once per VESC and firmware
+const int VESC_CONFIG_TIMEOUT_MS = 3000;    // How long the VESC may take to send its configuration
+// The other controllers' currents are resampled onto controller 0's
+// sample times before they are summed into the logged sample; their
+// replies come in after its own
+const uint32_t CONTROLLER_ALIGN_WINDOW_MS = 150; // Longest gap interpolated across (0 sums them as they stand)
+
+// Telemetry History Settings
+const int HISTORY_MINUTES = 10;             // Samples kept in PSRAM for graphs and ride stats
+const uint32_t HISTORY_CAPACITY = HISTORY_MINUTES * 60 * POLL_RATE_POWER_HZ;
+const int HISTORY_PYRAMID_LEVELS = 8;       // Min/max levels, each 4x coarser; 8 reach back weeks at 20 Hz
+const int HISTORY_PYRAMID_BUCKETS = 640;    // Buckets per level (two screen widths)
+const size_t HISTORY_ARCHIVE_BYTES = 1024 * 1024; // Compressed samples behind the raw ring, about 2 h at 20 Hz (0 = off)
+
+// Fault Capture Settings. A new fault code keeps the history around it in
+// PSRAM, polling fast until the window closes.
+const uint32_t FAULT_CAPTURE_PRE_MS = 5000;  // History kept from before the fault
+const uint32_t FAULT_CAPTURE_POST_MS = 5000; // ...and after it, polled at the capture rate
+const int FAULT_CAPTURE_RATE_HZ = 50;        // Poll rate of the capture fields after a fault
+const uint32_t FAULT_CAPTURE_FIELDS = VALUES_FIELD_V_IN | VALUES_FIELD_CURRENT_IN | VALUES_FIELD_CURRENT_MOTOR |
+                                      VALUES_FIELD_TEMP_FET | VALUES_FIELD_TEMP_MOTOR | VALUES_FIELD_FAULT;
+const uint8_t FAULT_CAPTURE_SLOTS = 4;       // Captures kept until uploaded; the oldest goes when full
+const uint32_t FAULT_CAPTURE_SAMPLES = (FAULT_CAPTURE_PRE_MS * POLL_RATE_POWER_HZ +
+                                        FAULT_CAPTURE_POST_MS * FAULT_CAPTURE_RATE_HZ) / 1000 + 64;
+
+// Scope Settings. Holding Button C on the dashboard opens a scope of the
+// VESC's sampled phase currents and voltages (COMM_SAMPLE_PRINT).
+const bool SCOPE_ENABLED = true;
+const uint16_t SCOPE_SAMPLES = 1000;         // Per capture; the firmware buffers at most ADC_SAMPLE_MAX_LEN
+const uint8_t SCOPE_DECIMATION = 1;          // PWM cycles per sample
+const VescSampleMode SCOPE_MODE = VESC_SAMPLE_NOW; // or VESC_SAMPLE_TRIGGER_START/_FAULT to arm and wait
+const uint32_t SCOPE_TIMEOUT_MS = 3000;      // A capture ends after this long without a sample
+
+// Console Settings. Holding Button C on the stats overlay opens a console
+// that runs VESC terminal commands (COMM_TERMINAL_CMD) and shows their
+// output (COMM_PRINT).
+const uint16_t CONSOLE_SCROLLBACK_LINES = 200; // Output lines kept in PSRAM
+const char* const CONSOLE_COMMANDS[] = { "faults", "hw_status", "mem", "threads", "can_devs", "uptime", "upload_fw", "trace" };
+
+// Battery Settings. The pack's charge comes from its voltage, corrected
+// for the sag under the current drawn; Wh/km and range are worked out
+// from the VESC's watt-hour and tachometer counters.
+const BatteryChemistry BATTERY_CHEMISTRY = CHEMISTRY_LI_ION; // Discharge curve (LI_ION or LIFEPO4)
+const int BATTERY_CELLS = 12;               // Pack cells in series [live]
+const uint32_t BATTERY_CAPACITY_MAH = 12000; // Pack capacity [live]
+const uint16_t BATTERY_RESISTANCE_MOHM = 100; // Pack internal resistance to start from (learned while riding)
+const uint32_t BATTERY_SOC_SMOOTHING_MS = 5000; // Time constant of the shown charge
+const uint32_t ENERGY_RECENT_METERS = 2000; // Distance the recent Wh/km is averaged over
+const uint32_t ENERGY_MIN_METERS = 200;     // Distance before Wh/km and range are shown
+
+// Drivetrain Settings. Speed comes from the ERPM and distance from the
+// tachometer counts.
+const uint8_t MOTOR_POLES = 14;             // Magnet poles (not pole pairs) [live]
+const uint16_t GEAR_RATIO_X100 = 100;       // Motor turns per wheel turn x100 (100 for hub motors) [live]
+const uint16_t WHEEL_DIAMETER_MM = 90;      // [live]
+
+// Units Settings. Telemetry is kept metric; the pages, the stats overlay
+// and the controllers page convert what they print.
+const bool UNITS_FAHRENHEIT = false;        // Temperatures in °F [live]
+const bool UNITS_MILES = false;             // Speed in mph, distance in mi, consumption in Wh/mi [live]
+
+// Ride Stats Settings. Minimum, maximum and average of every history
+// quantity over the trip (hold C on the settings screen for a new one).
+const uint32_t RIDE_STATS_PERSIST_MS = 60000; // Saved to NVS this often while riding, to survive a reboot
+
+// Odometer Settings. Lifetime distance, energy and peaks, added up in RAM
+// and committed to a ring of NVS slots every ODOMETER_COMMIT_MS while
+// they change, and at once on parking or when the battery is about to
+// give out (the PMIC's low-voltage warning or POWER_LOSS_MV on battery).
+const uint32_t ODOMETER_COMMIT_MS = 300000;
+const uint8_t ODOMETER_SLOTS = 4;           // NVS keys the commits rotate through
+const uint16_t POWER_LOSS_MV = 3450;        // Battery voltage that counts as about to give out
+
+// Filter Settings. The pages and the alerts see smoothed fields; logs,
+// the serial stream and the chart history keep the raw samples.
+const uint8_t FILTER_VOLTAGE_EMA_SHIFT = 2; // Input voltage EMA, a new sample weighs 1/2^n (0 = off, up to 4)
+const uint8_t FILTER_CURRENT_MEDIAN = 3;    // Input and motor current, median of 3 or 5 samples (0 = off)
+const uint8_t FILTER_TEMP_EMA_SHIFT = 1;    // FET and motor temperature EMA (0 = off, up to 4)
+
+// Alert Settings. The rules are checked against every decoded sample;
+// an active one turns the status line red, and beeps and vibrates every
+// ALERT_REPEAT_MS until it clears.
+const uint8_t ALERT_FET_TEMP_C = 80;        // FET temperature alert, 0 = off [live]
+const uint8_t ALERT_MOTOR_TEMP_C = 100;     // Motor temperature alert, 0 = off [live]
+const uint16_t ALERT_CELL_MV = 3300;        // Cell voltage under load, 0 = off [live]
+const int16_t ALERT_TEMP_HYSTERESIS = 50;   // 0.1 °C back below the threshold before it clears
+const int16_t ALERT_VOLTAGE_HYSTERESIS = 10; // 0.1 V back above the threshold before it clears
+const bool ALERT_ON_FAULT = true;           // Beep and vibrate on a VESC fault code
+const bool ALERT_SOUND = true;              // Beep on the speaker
+const uint8_t ALERT_VOLUME_PERCENT = 60;    // Of the clips' own level
+const bool ALERT_VIBRATE = true;            // Pulse the vibration motor
+const uint16_t ALERT_VIBRATE_MS = 300;      // One pulse; a fault plays three of half the length
+const uint32_t ALERT_REPEAT_MS = 5000;      // Least time between two beeps
+
+// Thermal Model Settings. Controller 0's FET and motor temperatures are
+// fitted online against its motor current, and the combined sample
+// carries the seconds until the nearer of the two reaches the point
+// where the VESC starts cutting current: l_temp_fet_start and
+// l_temp_motor_start from its mcconf, the limits below until that is read.
+const float THERMAL_FORGETTING = 0.999f;    // Fit's forgetting per reading; 0.999 looks back ~1000 readings
+const uint32_t THERMAL_MIN_READINGS = 60;   // Temperature readings fitted before predicting
+const uint32_t THERMAL_LOAD_SMOOTHING_MS = 30000; // Time constant of the load a prediction assumes
+const uint8_t THERMAL_FET_LIMIT_C = 85;     // The firmware's default l_temp_fet_start
+const uint8_t THERMAL_MOTOR_LIMIT_C = 85;   // The firmware's default l_temp_motor_start
+const int16_t THERMAL_ALERT_SECONDS = 60;   // Alert when derating is this close, 0 = off
+const int16_t THERMAL_ALERT_HYSTERESIS_S = 30; // Further away before it clears
+
+// SD Card Logging Settings
+const bool SD_LOGGING_ENABLED = FEATURE_LOGGING && true; // Record every sample to /logs on the SD card while connected
+const size_t SD_LOG_BLOCK_BYTES = 32768;    // Bytes per card write; two blocks are buffered in PSRAM
+const uint16_t SD_LOG_KEYFRAME_INTERVAL = 250; // Frames between full keyframes (seek granularity)
+const uint32_t SD_LOG_FLUSH_INTERVAL_MS = 2000; // Longest a sample waits for the card; bounds loss on power-off
+
+// Ride Review Settings. Holding Button A on the device list charts the
+// newest closed log on the SD card, decoded a window at a time.
+const bool RIDE_REVIEW_ENABLED = FEATURE_LOGGING && true;
+const uint32_t RIDE_REVIEW_DECODE_BYTES = 1048576; // Widest window decoded frame by frame; wider ones show block keyframes
+// Log playback: swiping left on the ride review plays the log shown into
+// the dashboard as if it were live, swiping right LOG_PLAYBACK_FAST_SPEED
+// times faster. Widgets, graphs and alerts see each sample; the log, trip
+// statistics and odometer do not. Tap A or C to stop. The UI's frame
+// rate and render times are logged over the playback when it ends.
+const bool LOG_PLAYBACK_ENABLED = FEATURE_LOGGING && true;
+const uint8_t LOG_PLAYBACK_FAST_SPEED = 8;  // Times real time; 0 plays flat out
+const uint32_t LOG_PLAYBACK_MAX_GAP_MS = 2000; // Longer pauses in the ride are cut to this
+
+// Screenshot Settings. Swiping up on the dashboard, the stats overlay or
+// the device list saves the screen to /screens/screenNNNN.bmp on the SD
+// card, read back from the panel a band per frame while rendering goes on.
+const bool SCREENSHOTS_ENABLED = true;
+const uint16_t SCREENSHOT_BAND_ROWS = 8;    // Panel rows read after each render; 8 rows take ~4 ms
+
+// Pairing Settings. Swiping left on the device list shows QR codes for a
+// phone: the log service's name, address and UUID, and the live stream's
+// WiFi when it runs its own AP. Each is built the first time it is shown.
+const bool PAIRING_SCREEN_ENABLED = true;
+const int16_t PAIRING_QR_SIZE = 190;        // Largest side of a code, quiet zone included, in pixels
+
+// BLE Log Service Settings. Phones can list and download the card's logs
+// over BLE while the dashboard stays connected to the VESCs; BLE_MAX_LINKS
+// plus the phone must fit the controller's three connections.
+const bool LOG_SERVICE_ENABLED = FEATURE_LOGGING && !BLE_BACKEND_NIMBLE && true; // Advertise the log download service
+const char* LOG_SERVICE_NAME = "vescDash";  // Advertised name
+const BleLinkProfile& LOG_SERVICE_PROFILE = BLE_PROFILE_BALANCED; // Asked of the phone; shorter intervals download faster
+
+// WiFi Upload Settings. Closed logs go to the depot server as they are on
+// the card whenever its AP is in range and no ride is in progress.
+const bool LOG_UPLOAD_ENABLED = FEATURE_WIFI && false; // Upload finished logs over WiFi
+const char* LOG_UPLOAD_SSID = "depot";      // Network to join
+const char* LOG_UPLOAD_PASSWORD = "";
+const char* LOG_UPLOAD_URL = "http://192.168.4.1:8080/logs"; // Files are POSTed to <url>/<name> in chunks
+const size_t LOG_UPLOAD_CHUNK_BYTES = 65536; // Bytes per request (PSRAM)
+const uint32_t LOG_UPLOAD_RETRY_MS = 60000; // Look for the AP or new logs this often
+
+// Firmware Update Settings. Whenever uploading would be allowed, the
+// depot server is asked for a new image every FIRMWARE_CHECK_MS. It is
+// streamed into the idle app partition while the VESC link stays up, and
+// the dashboard restarts into it once no VESC is connected or, parked,
+// the display is off. A new image that has not run for
+// FIRMWARE_CONFIRM_SECONDS within FIRMWARE_BOOT_ATTEMPTS boots is
+// replaced by the one before it.
+const bool FIRMWARE_UPDATE_ENABLED = FEATURE_WIFI && false; // Update over WiFi
+const char* FIRMWARE_UPDATE_SSID = "depot"; // Network to join
+const char* FIRMWARE_UPDATE_PASSWORD = "";
+const char* FIRMWARE_UPDATE_URL = "http://192.168.4.1:8080/firmware/vescdash.bin"; // ETag and 304 supported
+const uint32_t FIRMWARE_CHECK_MS = 600000;  // Ask for a new image this often
+const uint8_t FIRMWARE_BOOT_ATTEMPTS = 3;
+const int FIRMWARE_CONFIRM_SECONDS = 60;
+
+// VESC Upload Settings. Running VESC_UPLOAD_COMMAND from the console
+// pushes VESC_UPLOAD_PATH on the SD card into the primary VESC and
+// restarts it into the new firmware, as VESC Tool's firmware page does.
+// Nothing checks the image is for the VESC's hardware.
+const char* VESC_UPLOAD_COMMAND = "upload_fw";       // Console entry that runs the upload, not a terminal command
+const char* VESC_UPLOAD_PATH = "/firmware/vesc.bin"; // e.g. VESC Tool's VESC_default.bin for the hardware
+const uint8_t VESC_UPLOAD_MAX_WINDOW = 8;            // Chunks out at once, at most
+const uint32_t VESC_UPLOAD_CACHE_BYTES = 16384;      // Read ahead from the card, in PSRAM
+
+// Live Stream Settings. A WebSocket on WiFi sends every combined sample to
+// pit-side laptops as a binary log keyframe.
+const bool LIVE_STREAM_ENABLED = FEATURE_WIFI && false; // Serve live telemetry over WiFi
+const bool LIVE_STREAM_ACCESS_POINT = true; // Open our own AP (false: join LIVE_STREAM_SSID)
+const char* LIVE_STREAM_SSID = "vescDash";
+const char* LIVE_STREAM_PASSWORD = "vescdash"; // 8+ characters, or "" for an open AP
+const uint16_t LIVE_STREAM_PORT = 81;       // ws://<address>:81/
+const uint8_t LIVE_STREAM_MAX_CLIENTS = 2;  // Laptops at once (up to 4)
+
+// Coexistence Settings. SD writes, log reads and upload requests start in
+// the gaps between VESC polls, so their replies are not held up behind
+// the card or WiFi. Each gap must leave the burst's time before the next
+// poll; a burst that finds none within the wait goes anyway.
+const uint32_t COEXIST_SD_WRITE_BURST_MS = 8; // One 4 KB slice of a log block
+const uint32_t COEXIST_SD_READ_BURST_MS = 4; // One 4 KB read
+const uint32_t COEXIST_WIFI_BURST_MS = 20;  // Start of an upload request
+const uint32_t COEXIST_FLASH_WRITE_BURST_MS = 50; // Erasing and writing one 4 KB firmware sector
+const uint32_t COEXIST_MAX_WAIT_MS = 250;   // Longest a burst is held back
+const uint32_t SPI_BUS_MAX_WAIT_MS = 100;   // Longest a card slice waits for the renders to leave it room
+
+// Memory Settings. Bulk buffers (history, scrollback, log blocks, sprites)
+// live in PSRAM; internal RAM is kept for DMA, ISRs and the BLE and WiFi
+// stacks (src/system/memory.h).
+const size_t MEMORY_PSRAM_ABOVE = 4096;        // Plain mallocs this large or larger go to PSRAM
+const size_t MEMORY_INTERNAL_RESERVE = 40960;  // Internal RAM a bulk buffer never takes when PSRAM is full
+
+// Wall Clock Settings. Log blocks carry UTC from the RTC, corrected by
+// NTP whenever WiFi joins a network (the upload, or a stream that is not
+// its own AP).
+const char* WALL_CLOCK_NTP_SERVER = "pool.ntp.org"; // "" to rely on the RTC alone
+
+// GPS Settings. An NMEA or UBX receiver on Port C; its fixes are merged
+// into the combined samples, so the history and the log carry the GPS
+// speed and position next to the ERPM.
+const bool GPS_ENABLED = FEATURE_GPS && false; // Read a receiver on the UART port
+const int8_t GPS_RX_PIN = 13;               // Port C, to the receiver's TX
+const int8_t GPS_TX_PIN = 14;
+const uint32_t GPS_BAUD = 9600;             // The receiver's output rate; 9600 is the usual default
+
+// Serial Stream Settings. The m5stack-core2-serial-stream build turns the
+// USB serial port into a binary telemetry stream for bench captures
+// (decode with tools/serial_stream.py).
+#ifdef SERIAL_STREAM
+const bool SERIAL_STREAM_ENABLED = true;
+#else
+const bool SERIAL_STREAM_ENABLED = false;
+#endif
+const uint32_t SERIAL_STREAM_BAUD = 921600; // Must match the env's monitor_speed
+const size_t SERIAL_STREAM_TX_BUFFER = 4096; // A record that does not fit is dropped, never waited for
+
+// USB Bridge Settings. The m5stack-core2-usb-bridge build passes VESC Tool's
+// packets between the USB serial port and the primary VESC link, with
+// text logging off.
+#ifdef USB_BRIDGE
+const bool USB_BRIDGE_ENABLED = true;
+#else
+const bool USB_BRIDGE_ENABLED = false;
+#endif
+const uint32_t USB_BRIDGE_BAUD = 115200;    // Pick the same in VESC Tool
+const size_t USB_BRIDGE_BUFFER = 4096;      // Serial buffer each way
 
-// Display Update Thresholds
-const float VOLTAGE_UPDATE_THRESHOLD = 0.05;  // Only update display if voltage changes by this amount (volts)
-const float TEMP_UPDATE_THRESHOLD = 0.1;      // Only update display if temperature changes by this amount (°C)
-const int BATTERY_UPDATE_THRESHOLD = 1;       // Only update battery display if it changes by this percent
+#if defined(USB_BRIDGE) && defined(SERIAL_STREAM)
+#error "The USB bridge and the serial stream both need the serial port"
+#endif
+
+// BLE Capture Settings (development)
+const size_t BLE_CAPTURE_BYTES = 0;         // PSRAM for recording raw notifications while connected (0 = off)
+const bool BLE_REPLAY_AT_BOOT = false;      // Replay the newest capture through the parser at boot and log the result
+const bool BLE_REPLAY_REALTIME = false;     // Replay at the recorded pace instead of as fast as possible
+
+// Event Trace Settings. Each poll's request, link writes, notifications,
+// frames, decodes and renders are stamped into a ring in PSRAM; a late
+// reply, or the console's TRACE_COMMAND, saves it to /logs/traceNNNN.vtr
+// for tools/trace_json.py (src/system/event_trace.h).
+const size_t TRACE_RECORDS = 4096;           // 8 bytes each, about 2 s of a busy link (0 = off)
+const uint32_t TRACE_SAVE_RTT_MS = 250;      // A reply this late saves the trace (0 = only from the console)
+const uint32_t TRACE_SAVE_DELAY_MS = 1000;   // ...once this much of what follows it is in the ring too
+const uint32_t TRACE_SAVE_INTERVAL_MS = 60000; // At most one save on a late reply this often
+const char* TRACE_COMMAND = "trace";         // Console entry that saves the trace, not a terminal command
+
+// Render Benchmark Settings (development). Times the drawing paths on the
+// LCD and logs us per operation and the SPI rate; also run by holding
+// Button C at power-on.
+const bool RENDER_BENCH_AT_BOOT = false;
+const uint16_t RENDER_BENCH_ITERATIONS = 50; // Timed runs per case
+
+// Soak Test Settings (m5stack-core2-soak builds). The link is dropped on
+// purpose every SOAK_DROP_INTERVAL_MS and a summary of reconnect times,
+// heap, PSRAM and stack headroom is logged, for runs of hours.
+#ifdef SOAK_TEST
+const bool SOAK_TEST_ENABLED = true;
+#else
+const bool SOAK_TEST_ENABLED = false;
+#endif
+const uint32_t SOAK_DROP_INTERVAL_MS = 60000;    // Connected time between drops
+const uint32_t SOAK_SUMMARY_INTERVAL_MS = 600000;
+const uint32_t SOAK_RECONNECT_LIMIT_MS = 15000;  // Slower reconnects are counted and logged
+
+// Fleet Mode Settings. Every VESC heard nearby is visited in turn over a
+// short connection for its voltage, temperatures and fault, shown as a
+// table. m5stack-core2-fleet builds start in fleet mode, and holding A on
+// the device list enters it instead of the ride review.
+#ifdef FLEET_MODE
+const bool FLEET_MODE_ENABLED = true;
+#else
+const bool FLEET_MODE_ENABLED = false;
+#endif
+const uint32_t FLEET_REVISIT_MS = 30000;     // Between two visits to one VESC (0: beacons only, no visits)
+const uint32_t FLEET_HEARD_MS = 20000;       // Only VESCs heard advertising this recently are visited
+const int FLEET_REPLY_TIMEOUT_MS = 1000;     // Wait for COMM_GET_VALUES on a visit
+
+// Frame Loop Settings
+const int TARGET_FPS = 30;                  // Most frames per second the UI renders [live]
+const int IDLE_TICK_MS = 250;               // Render at least this often (countdowns, data age)
+const uint32_t POLL_RETRY_MS = 5;           // Retry period for a due poll the request window held back
+
+// Power Settings. Hold A while connected to switch modes; the stats
+// overlay shows the battery draw measured in each.
+const PowerMode POWER_MODE = POWER_FULL;    // Mode at boot (FULL or SAVE)
+const uint32_t POWER_FULL_CPU_MHZ = 240;    // CPU clock in full mode
+const uint32_t POWER_SAVE_CPU_MHZ = 80;     // CPU clock in save mode (80 is the radio's minimum)
+const uint8_t POWER_FULL_BRIGHTNESS = 100;  // Backlight percent in full mode
+const uint8_t POWER_SAVE_BRIGHTNESS = 30;   // Backlight percent in save mode
+const bool POWER_SAVE_LIGHT_SLEEP = true;   // Light sleep while idle in save mode (SDK builds with power management)
+const int SENSOR_POLL_MS = 1000;            // How often a background task samples the AXP (battery level, voltage, current)
+const int SENSOR_WATCH_MS = 100;            // How often VBUS and the low-voltage warning are checked in between
+
+// Motion Settings. The MPU6886 tells when the vehicle is parked: after
+// MOTION_STILL_SECONDS without motion, telemetry is polled more slowly;
+// the first movement restores full rate at once.
+const bool MOTION_DETECT_ENABLED = true;    // Watch the accelerometer
+const int MOTION_SAMPLE_MS = 50;            // Accelerometer sample period
+const uint16_t MOTION_THRESHOLD_MG = 40;    // Deviation from gravity that counts as motion
+const int MOTION_STILL_SECONDS = 60;        // Still this long counts as parked
+const int MOTION_PARKED_SLOWDOWN = 8;       // Poll periods are this many times longer while parked
+
+// IMU Settings. The MPU6886 fills its FIFO at a fixed rate and a task
+// runs a Mahony filter over it; every combined sample gets the pitch and
+// forward acceleration measured nearest it, next to the current it drew.
+// Mount the Core2 with the IMU's x axis pointing forward.
+const bool IMU_ENABLED = true;              // Estimate pitch, roll and acceleration
+const uint16_t IMU_RATE_HZ = 100;           // Sample rate through the FIFO
+const uint32_t IMU_READ_MS = 50;            // FIFO bursts apart; the FIFO holds 730 ms at 100 Hz
+const float IMU_KP = 1.0f;                  // How fast gravity pulls the estimate back
+const float IMU_KI = 0.02f;                 // How fast the gyro's bias is learned
+const float IMU_GATE_G = 0.15f;             // Accelerations further from 1 g do not correct
+
+// I2C Bus Settings. The touch panel, PMIC, RTC and IMU share the internal
+// I2C bus; one task runs all of their transactions, touch reads first,
+// then IMU reads, then backlight and motor switching, then the slow PMIC
+// and RTC work, so the render loop never waits on the bus.
+const uint8_t I2C_BUS_QUEUE_LENGTH = 8;     // Jobs waiting per priority
+
+// Display Power Settings. Nobody is taken to be looking once the
+// vehicle is parked, the panel untouched and no alert or fault showing:
+// DISPLAY_DIM_SECONDS after the last of these the backlight dims, and
+// DISPLAY_OFF_SECONDS after it the panel goes off and nothing is
+// rendered, while polling and logging go on. A touch, movement, alert
+// or connection change brings it straight back; the touch that wakes a
+// dark display does nothing else.
+const int DISPLAY_DIM_SECONDS = 15;         // 0 = never dim
+const int DISPLAY_OFF_SECONDS = 120;        // 0 = never switch off
+const uint8_t DISPLAY_DIMMED_BRIGHTNESS = 10; // Backlight percent while dimmed
+
+// Parking Settings. With no VESC connected, the display off and no USB
+// power for PARKING_AFTER_MINUTES, the dashboard deep sleeps, waking
+// every PARKING_WAKE_SECONDS for a passive scan of PARKING_SCAN_MS for
+// the last VESC. Hearing it, or a touch, boots and connects straight to
+// it; a shorter wake period finds it sooner for a little more battery.
+const bool PARKING_ENABLED = true;
+const int PARKING_AFTER_MINUTES = 10;
+const int PARKING_WAKE_SECONDS = 20;
+const int PARKING_SCAN_MS = 1200;
+const bool PARKING_WAKE_ON_TOUCH = true;     // The touch interrupt wakes it too
+const int PARKING_LOG_CLOSE_MS = 2000;       // Longest wait for the log to close first
+
+// Dashboard Layout Settings. Pages and widgets (with their repaint
+// thresholds) come from this file on the SD card, or else SPIFFS, and
+// the built-in gauges, ride and graphs pages without one.
+const char* LAYOUT_FILE = "/layout.bin";
+const uint8_t LAYOUT_FIRST_PAGE = 1;        // First page shown, from 1 [live]
+const uint8_t LAYOUT_PAGE_COUNT = 6;        // Pages shown from there [live]
+
+// Formula Settings. Custom fields worked out on every sample from the
+// formulas in this file on the SD card, or else SPIFFS, one
+// "name = expression" a line (src/telemetry/formula.h). Pages show them
+// as LAYOUT_Q_FORMULA1/2, alert rules watch ALERT_Q_FORMULA1/2, and the
+// SD log keeps them; the fields they read are polled on every page.
+const bool FORMULAS_ENABLED = FEATURE_FORMULAS && true; // Read the formulas file at boot
+const char* FORMULAS_FILE = "/formulas.txt";
+
+// Rider Profile Settings. Each rider profile keeps its own poll rates,
+// alert thresholds, units and layout pages (the settings screen shows
+// the selected one's); swiping down on the dashboard or the device list
+// opens a menu to switch, which takes effect at once.
+const bool RIDER_PROFILES_ENABLED = true;
+
+// Controllers Page Settings. With more than one controller reporting, a
+// page after the last layout page shows them side by side with totals.
+const uint32_t CONTROLLERS_PAGE_REFRESH_MS = 100;  // Fastest refresh of its numbers
+
+// BMS Settings. A VESC-compatible BMS on the CAN bus reports its cells to
+// the controller, which answers COMM_BMS_GET_VALUES for it; once one has,
+// a cells page after the controllers page shows them as a heatmap.
+const bool BMS_ENABLED = true;
+const uint32_t BMS_POLL_MS = 1000;          // How often the primary link is asked
+const uint8_t BMS_ABSENT_AFTER = 3;         // Replies without cells (or none) before asking only...
+const uint32_t BMS_ABSENT_POLL_MS = 10000;  // ...this often
+const uint32_t BMS_STALE_MS = 5000;         // The cells page goes once the reading is this old
+const uint16_t BMS_CELL_EMPTY_MV = 3300;    // Heatmap red
+const uint16_t BMS_CELL_FULL_MV = 4200;     // Heatmap green
+
+// Lap Timer Settings. A laps page after the cells page times laps from
+// Button A, or over GPS, from a start line placed where A was first
+// pressed, with each lap's energy, peak currents and top speed in a
+// table. While a lap runs the charts dot the best lap's trace under it.
+const bool LAPS_ENABLED = true;
+const bool LAPS_GEOFENCE = true;            // Count laps at the start line while there is a fix
+const uint16_t LAPS_LINE_RADIUS_M = 15;     // Start line circle
+const uint32_t LAPS_MIN_LAP_MS = 20000;     // A pass sooner than this is not a lap
+const uint32_t LAPS_PAGE_REFRESH_MS = 100;  // Fastest refresh of its numbers
+
+// Retained Screen Settings. Dashboard pages and the stats overlay keep
+// an image of their widgets in PSRAM, so coming back to one is a blit.
+const uint8_t RETAINED_SCREEN_BITS = 8;     // Bits a pixel: 16 (150 KB a screen), 8 (RGB332) or 4 (16-colour palette)
+
+// Display DMA Settings. In the M5GFX build, screens, panels, gauge faces
+// and other sprites in PSRAM go out through two line buffers in internal
+// RAM, one filled while the bus's DMA sends the other (src/ui/display.h).
+const uint16_t DISPLAY_DMA_LINES = 8;       // Lines a buffer, 5 KB each at 320 wide (0 = off)
+
+// Unicode Text Settings. Layout labels and device names outside ASCII are
+// drawn from an efont in the M5GFX build (UNICODE_TEXT_FONT in
+// platformio.ini picks the script and size), and as '?' with M5.Lcd.
+// Each glyph is rasterized on first use into a 1-bit cell in PSRAM.
+const uint16_t UNICODE_GLYPH_CELLS = 512;   // Glyphs kept, the least recently used replaced (0 = off)
+
+// Stats Overlay Settings
+const uint32_t STATS_HOLD_MS = 700;         // Hold Button B this long to show or hide the stats overlay
 // ========================================================
 
-// Structure to store BLE device information
-struct BLEDeviceInfo {
-    String name;
-    String address;
-    int rssi;
+// Copy of the connection manager's scan results, refreshed after each scan
+DeviceList discoveredDevices;
+uint32_t shownDevicesVersion = 0;  // connectionManagerDevicesVersion() of the list on screen
+int selectedDeviceIndex = 0;     // Index into discoveredDevices, which stays put as the list is re-sorted
+uint16_t deviceOrder[DeviceTable::MAX_DEVICES]; // discoveredDevices by rank, best first, as listed
+ConnState connState = CONN_IDLE;  // Last state reported by the connection manager
+VescValues shownValues = {};  // UI copy of the combined sample, refreshed from the telemetry snapshot
+
+uint32_t markedDevices = 0;  // Devices picked for extra links, one bit per list entry
+
+// The CAN bus behind each link is pinged once per connection
+enum CanDiscovery { CAN_DISCOVERY_OFF, CAN_DISCOVERY_DUE, CAN_DISCOVERY_WAITING, CAN_DISCOVERY_DONE };
+
+// ...and so is the VESC's configuration, unless it is cached
+enum ConfigFetch { CONFIG_FETCH_OFF, CONFIG_FETCH_DUE, CONFIG_FETCH_WAITING, CONFIG_FETCH_RECEIVED, CONFIG_FETCH_DONE };
+
+// Protocol state of one BLE link
+struct LinkState {
+    VescFirmware firmware;               // Unknown (0.0) until queried
+    const ValuesLayout* layout;          // COMM_GET_VALUES layout of that firmware
+    volatile bool replyReceived;         // Set by the parser on any valid frame
+    volatile bool resetRequested;        // Parser drops the partial frame and the link's controllers
+    // Selective values polling; disabled for the connection if the VESC
+    // never answers COMM_GET_VALUES_SELECTIVE
+    bool selectiveSupported;
+    int selectiveUnanswered;
+    volatile CanDiscovery canDiscovery;
+    unsigned long canPingSentMs;
+    VescIdentity identity;               // From the COMM_FW_VERSION reply, zero until then
+    volatile ConfigFetch configFetch;
+    unsigned long configRequestMs;
+    VescConfig config;                   // Filled in by the parser while WAITING
+};
+LinkState linkStates[VESC_MAX_LINKS] = {};
+// A fleet visit in progress takes every values reply for the fleet table
+volatile bool fleetVisiting = false;
+volatile bool fleetAnswered = false;
+VescValues fleetValues = {};
+uint8_t sessionLinks = 0;  // Links whose polling the UI has started
+const int SELECTIVE_FALLBACK_AFTER = 3;  // Unanswered requests before falling back
+
+// Controllers polled. Controller i < VESC_MAX_LINKS is the VESC wired to
+// link i's BLE module, controller 0 being the primary whose speed and
+// voltage the dashboard shows. The rest are CAN slots, handed out as the
+// bus pings are answered, each reached through controllerLinks[i] with
+// COMM_FORWARD_CAN to controllerCanIds[i]. Decoder state, slot
+// assignment and fault tracking are owned by the parser task.
+VescValues controllerValues[TELEMETRY_MAX_CONTROLLERS] = {};
+uint8_t controllerLinks[TELEMETRY_MAX_CONTROLLERS] = {};
+uint8_t controllerCanIds[TELEMETRY_MAX_CONTROLLERS] = {};
+uint8_t lastFaultCodes[TELEMETRY_MAX_CONTROLLERS] = {};
+uint64_t frameArrivalUs = 0;  // esp_timer time the frame being decoded began to arrive
+uint32_t replySentUs = 0;     // esp_timer time its request was sent, 0 if it matched none
+volatile uint32_t traceSaveDueMs = 0;  // A late reply asked for the event trace to be saved then
+volatile uint32_t traceSaveRtt = 0;
+volatile uint32_t canSlotsUsed = 0;  // One bit per controller slot
+// Fields each controller broadcast in its CAN status frames, and when it
+// last did; polls leave them out while they keep coming. Written by the
+// parser task.
+volatile uint32_t canStatusHeard[TELEMETRY_MAX_CONTROLLERS] = {};
+volatile uint32_t canStatusHeardMs[TELEMETRY_MAX_CONTROLLERS] = {};
+// When each controller's fields last came in, noted by the parser task as
+// they are published, and how long each stays fresh (set by the UI task
+// with the poll periods)
+ValuesCache valuesCaches[TELEMETRY_MAX_CONTROLLERS];
+uint32_t valuesCacheTtl[VALUES_FIELD_COUNT] = {};
+uint32_t responseCacheHits = 0;  // Fields left out of requests as fresh, UI task
+uint8_t shownControllers = 1;  // UI copy, from the telemetry snapshot
+Drivetrain drivetrain;  // Speed and distance factors, from the settings
+DerivedValues shownDerived(&drivetrain);  // Of shownValues, worked out as the pages ask (UI task)
+uint32_t shownVersion = 0;  // Bus sequence of shownValues, 0 before the first sample
+uint32_t shownChanged = VALUES_ALL_FIELDS;  // Fields that moved since the dashboard last updated
+EnergyEstimator energyEstimator;  // Trip and range, folded in on the UI task
+
+// What to poll and how often
+PollSchedule pollSchedule(POLL_COALESCE_MS);
+unsigned long lastTelemetryRequest = 0;
+
+// Outstanding telemetry requests, per controller since a forwarded reply
+// takes longer than a local one; replies are matched on the parser task
+static_assert(TELEMETRY_MAX_CONTROLLERS == 10, "one request tracker per controller");
+RequestTracker requestTrackers[TELEMETRY_MAX_CONTROLLERS] = {
+    RequestTracker(MAX_REQUESTS_IN_FLIGHT, REQUEST_TIMEOUT_MS, VESC_DATA_REFRESH_MS, VESC_DATA_MAX_REFRESH_MS,
+                   STREAM_MAX_IN_FLIGHT),
+    RequestTracker(MAX_REQUESTS_IN_FLIGHT, REQUEST_TIMEOUT_MS, VESC_DATA_REFRESH_MS, VESC_DATA_MAX_REFRESH_MS,
+                   STREAM_MAX_IN_FLIGHT),
+    RequestTracker(MAX_REQUESTS_IN_FLIGHT, REQUEST_TIMEOUT_MS, VESC_DATA_REFRESH_MS, VESC_DATA_MAX_REFRESH_MS,
+                   STREAM_MAX_IN_FLIGHT),
+    RequestTracker(MAX_REQUESTS_IN_FLIGHT, REQUEST_TIMEOUT_MS, VESC_DATA_REFRESH_MS, VESC_DATA_MAX_REFRESH_MS,
+                   STREAM_MAX_IN_FLIGHT),
+    RequestTracker(MAX_REQUESTS_IN_FLIGHT, REQUEST_TIMEOUT_MS, VESC_DATA_REFRESH_MS, VESC_DATA_MAX_REFRESH_MS,
+                   STREAM_MAX_IN_FLIGHT),
+    RequestTracker(MAX_REQUESTS_IN_FLIGHT, REQUEST_TIMEOUT_MS, VESC_DATA_REFRESH_MS, VESC_DATA_MAX_REFRESH_MS,
+                   STREAM_MAX_IN_FLIGHT),
+    RequestTracker(MAX_REQUESTS_IN_FLIGHT, REQUEST_TIMEOUT_MS, VESC_DATA_REFRESH_MS, VESC_DATA_MAX_REFRESH_MS,
+                   STREAM_MAX_IN_FLIGHT),
+    RequestTracker(MAX_REQUESTS_IN_FLIGHT, REQUEST_TIMEOUT_MS, VESC_DATA_REFRESH_MS, VESC_DATA_MAX_REFRESH_MS,
+                   STREAM_MAX_IN_FLIGHT),
+    RequestTracker(MAX_REQUESTS_IN_FLIGHT, REQUEST_TIMEOUT_MS, VESC_DATA_REFRESH_MS, VESC_DATA_MAX_REFRESH_MS,
+                   STREAM_MAX_IN_FLIGHT),
+    RequestTracker(MAX_REQUESTS_IN_FLIGHT, REQUEST_TIMEOUT_MS, VESC_DATA_REFRESH_MS, VESC_DATA_MAX_REFRESH_MS,
+                   STREAM_MAX_IN_FLIGHT),
+};
+RequestTracker& requestTracker = requestTrackers[0];
+portMUX_TYPE requestTrackerMux = portMUX_INITIALIZER_UNLOCKED;
+// When the wait for telemetry last started over (a connect, a dropped
+// link, playback, a firmware upload); samples from before it are not news
+uint32_t dataWatchMs = 0;
+
+// How long the dashboard has gone without a new combined sample
+uint32_t dataAgeMs(uint32_t now) {
+    uint32_t sinceWatch = now - dataWatchMs;
+    TelemetryReading reading = telemetryReadLatest(now);
+    return reading.sequence != 0 && reading.ageMs < sinceWatch ? reading.ageMs : sinceWatch;
+}
+
+// Quality estimate per link, updated on the UI task
+LinkQuality linkQuality[VESC_MAX_LINKS];
+
+// Keep-alive and silence detection per link, on the UI task
+static_assert(VESC_MAX_LINKS == 3, "one heartbeat per link");
+VescHeartbeat heartbeats[VESC_MAX_LINKS] = {
+    VescHeartbeat(HEARTBEAT_ALIVE_MS, HEARTBEAT_PROBE_MS, HEARTBEAT_DEAD_MS),
+    VescHeartbeat(HEARTBEAT_ALIVE_MS, HEARTBEAT_PROBE_MS, HEARTBEAT_DEAD_MS),
+    VescHeartbeat(HEARTBEAT_ALIVE_MS, HEARTBEAT_PROBE_MS, HEARTBEAT_DEAD_MS),
+};
+uint32_t heartbeatFrames[VESC_MAX_LINKS] = {};  // Framer count the heartbeat last saw
+
+// Reply rate each link was measured at when it connected, and what polls
+// may ask of it. The probe's frames are noted on the parser task.
+ThroughputProbe throughputProbes[VESC_MAX_LINKS];
+ThroughputBudget throughputBudgets[VESC_MAX_LINKS];
+portMUX_TYPE throughputMux = portMUX_INITIALIZER_UNLOCKED;
+
+// Laps, fed the combined sample by the parser task; the UI marks laps
+// and copies the timer under the same lock. lapsTiming follows it on the
+// UI task, for the poll mask.
+LapTimer lapTimer;
+portMUX_TYPE lapMux = portMUX_INITIALIZER_UNLOCKED;
+bool lapsTiming = false;
+
+// Firmware push to the primary VESC, run on the UI task. Acks come in on
+// the rx task and are queued as fixed records for the UI loop; the image
+// is read from the card through a read-ahead cache.
+struct UploadReply {
+    uint8_t length;
+    uint8_t payload[7];         // Command, ok, offset: all an ack carries
+};
+size_t readVescImage(uint32_t offset, uint8_t* out, size_t length, void* context);
+VescFirmwareUpload vescUpload(readVescImage);
+SpscByteQueue<256> uploadReplies;
+File vescImage;
+uint8_t* vescImageCache = nullptr;
+uint32_t vescImageCacheStart = 0;
+uint32_t vescImageCacheLength = 0;
+uint32_t vescUploadShownPercent = 0;
+unsigned long lastLinkQualityUpdate = 0;
+unsigned long lastPollFit = 0;
+
+// The panel, on the M5.Lcd or M5GFX backend (see ui/display.h)
+DisplayGfx& lcd = displayPanel();
+
+// What is on the display. Each connection state has its own root
+// screen; the stats overlay is pushed over the dashboard pages. The
+// screens are defined below with their hooks and button handlers.
+ScreenStack screens(&lcd);
+RenderGovernor renderGovernor;
+DisplayPower displayPower(DISPLAY_DIM_SECONDS * 1000u, DISPLAY_OFF_SECONDS * 1000u);
+extern Screen deviceListScreen, scanningScreen, connectingScreen, connectFailedScreen,
+              reconnectingScreen, statsScreen, settingsScreen, scopeScreen, consoleScreen, reviewScreen, fleetScreen,
+              controllersScreen, cellsScreen, riderScreen, lapsScreen, pairingScreen, linkScreen;
+extern const ScreenHooks dashboardHooks;
+extern const ScreenInput dashboardInput, lapsInput;
+
+// Dashboard pages, built from the layout at boot. Each widget repaints
+// itself only when its value changes; a page's compositor pushes the
+// dirty ones once per frame.
+Layout dashboardLayout;
+LayoutPageView dashboardViews[Layout::MAX_PAGES];
+Screen* dashboardScreens[Layout::MAX_PAGES] = {};
+uint32_t shownFields = VALUES_ALL_FIELDS;  // Telemetry the visible page needs, POLL_ALWAYS_FIELDS included
+uint32_t formulaFields = 0;                // Fields the formulas read
+
+// Stats overlay: performance counters in place of the connected screen
+// while shown. Holding Button B toggles it.
+TextWidget statsLines[13] = {
+    { &lcd, 10, 8, 300, 14, 2, ALIGN_LEFT },
+    { &lcd, 10, 32, 300, 14, 1, ALIGN_LEFT },
+    { &lcd, 10, 48, 300, 14, 1, ALIGN_LEFT },
+    { &lcd, 10, 64, 300, 14, 1, ALIGN_LEFT },
+    { &lcd, 10, 80, 300, 14, 1, ALIGN_LEFT },
+    { &lcd, 10, 96, 300, 14, 1, ALIGN_LEFT },
+    { &lcd, 10, 112, 300, 14, 1, ALIGN_LEFT },
+    { &lcd, 10, 128, 300, 14, 1, ALIGN_LEFT },
+    { &lcd, 10, 144, 300, 14, 1, ALIGN_LEFT },
+    { &lcd, 10, 160, 300, 14, 1, ALIGN_LEFT },
+    { &lcd, 10, 176, 300, 14, 1, ALIGN_LEFT },
+    { &lcd, 10, 192, 300, 14, 1, ALIGN_LEFT },
+    { &lcd, 10, 216, 300, 16, 1, ALIGN_LEFT }
+};
+const int STATS_LINE_COUNT = sizeof(statsLines) / sizeof(statsLines[0]);
+Compositor statsOverlay;
+
+// Overlay pages; a tap on Button B moves between them, the probes only
+// in probe builds
+enum StatsPage : uint8_t {
+    STATS_COUNTERS,
+    STATS_MEMORY,
+    STATS_LIFETIME,
+    STATS_CRASH,
+    STATS_PROBES
+};
+StatsPage statsPage = STATS_COUNTERS;
+
+// Link analyzer: one link's traffic over the analyzer's window, a line
+// per figure and a bar per RTT bucket. Lines repaint only when their
+// text changes, so a 2 Hz refresh redraws just the figures that moved.
+TextWidget linkLines[16] = {
+    { &lcd, 10, 8, 300, 14, 2, ALIGN_LEFT },
+    { &lcd, 10, 30, 300, 12, 1, ALIGN_LEFT },
+    { &lcd, 10, 42, 300, 12, 1, ALIGN_LEFT },
+    { &lcd, 10, 54, 300, 12, 1, ALIGN_LEFT },
+    { &lcd, 10, 66, 300, 12, 1, ALIGN_LEFT },
+    { &lcd, 10, 78, 300, 12, 1, ALIGN_LEFT },
+    { &lcd, 10, 90, 300, 12, 1, ALIGN_LEFT },
+    { &lcd, 10, 106, 300, 12, 1, ALIGN_LEFT },
+    { &lcd, 10, 120, 300, 12, 1, ALIGN_LEFT },
+    { &lcd, 10, 132, 300, 12, 1, ALIGN_LEFT },
+    { &lcd, 10, 144, 300, 12, 1, ALIGN_LEFT },
+    { &lcd, 10, 156, 300, 12, 1, ALIGN_LEFT },
+    { &lcd, 10, 168, 300, 12, 1, ALIGN_LEFT },
+    { &lcd, 10, 180, 300, 12, 1, ALIGN_LEFT },
+    { &lcd, 10, 192, 300, 12, 1, ALIGN_LEFT },
+    { &lcd, 10, 216, 300, 16, 1, ALIGN_LEFT }
+};
+const int LINK_LINE_COUNT = sizeof(linkLines) / sizeof(linkLines[0]);
+const int LINK_RTT_FIRST_LINE = 7;
+const int LINK_RTT_BAR_CHARS = 20;
+Compositor linkPanel;
+LinkAnalyzer linkAnalyzer;
+uint8_t analyzedLink = 0;
+uint32_t linkAnalyzerUpdatedMs = 0;
+
+// Scope: one column per bucket of the zoom level, currents in the top
+// pane and phase voltages in the bottom one. Redrawn on a pan or zoom,
+// and while a capture comes in at most every SCOPE_REDRAW_MS.
+const int16_t SCOPE_COLUMNS = 320;
+const int16_t SCOPE_PANE_Y[2] = { 14, 118 };
+const int16_t SCOPE_PANE_H = 100;
+const uint32_t SCOPE_REDRAW_MS = 250;
+const uint8_t SCOPE_TRACES = 3;
+struct ScopeTrace {
+    VescSampleChannel channel;
+    uint16_t color;
+};
+const ScopeTrace SCOPE_PANES[2][SCOPE_TRACES] = {
+    { { VESC_SAMPLE_CURRENT_1, YELLOW }, { VESC_SAMPLE_CURRENT_2, CYAN }, { VESC_SAMPLE_CURRENT_FILTERED, WHITE } },
+    { { VESC_SAMPLE_PHASE_1, RED }, { VESC_SAMPLE_PHASE_2, GREEN }, { VESC_SAMPLE_PHASE_3, BLUE } },
+};
+const int32_t SCOPE_MIN_SPAN = 2000;       // mA or mV, so noise is not blown up to full height
+HistoryBucket* scopeBuckets = nullptr;     // [trace][column], in PSRAM
+uint8_t scopeLevel = 0;
+uint32_t scopeFirst = 0;                   // First sample shown
+bool scopeViewChanged = true;
+uint16_t scopeShownCount = 0;
+uint32_t scopeDrawnMs = 0;
+
+// Ride review: one trace per pane over the ride's time line, a column
+// per REVIEW_MS_PER_COLUMN << reviewLevel ms. Redrawn on a pan or zoom
+// and whenever the review task has decoded a new window.
+const int16_t REVIEW_COLUMNS = 320;
+const uint8_t REVIEW_PANE_COUNT = 4;
+const int16_t REVIEW_PANE_Y[REVIEW_PANE_COUNT] = { 14, 67, 120, 173 };
+const int16_t REVIEW_PANE_H = 50;
+const uint32_t REVIEW_MS_PER_COLUMN = 1000 / POLL_RATE_POWER_HZ; // Finest zoom, a sample a column
+const uint8_t REVIEW_MAX_LEVEL = 16;
+struct ReviewPane {
+    LogReviewTrace trace;
+    uint16_t color;
+    int32_t scale;                         // Raw units per unit shown, and the least span
+    const char* unit;
+};
+const ReviewPane REVIEW_PANES[REVIEW_PANE_COUNT] = {
+    { { LOG_RPM, VALUES_FIELD_RPM }, GREEN, 1000, "kERPM" },
+    { { LOG_CURRENT_IN, VALUES_FIELD_CURRENT_IN }, YELLOW, 100, "A" },
+    { { LOG_V_IN, VALUES_FIELD_V_IN }, CYAN, 10, "V" },
+    { { LOG_TEMP_MOTOR, VALUES_FIELD_TEMP_MOTOR }, RED, 10, "C" },
+};
+static_assert(REVIEW_PANE_COUNT <= LOG_REVIEW_MAX_TRACES, "one review trace per pane");
+HistoryBucket* reviewBuckets = nullptr;    // [pane][column], in PSRAM
+bool reviewReady = false;
+int reviewFile = 0;                        // Log shown, 0 for none yet
+uint32_t reviewDurationMs = 0;
+uint32_t reviewDecoded = 0;
+uint8_t reviewLevel = 0;
+uint32_t reviewFirstMs = 0;                // First ride ms shown
+bool reviewViewChanged = true;
+
+// A log playing into the dashboard in place of a VESC. Set by the UI
+// task, read by the parser task as the samples come in.
+bool playbackReady = false;
+volatile bool playbackRunning = false;
+
+// The UI under playback, a perf window at a time
+struct PlaybackBench {
+    uint32_t startedMs;
+    uint32_t windowMs;           // When the last window was taken
+    uint32_t windows;
+    uint32_t fpsSum;
+    uint32_t renderUsSum;
+    uint32_t renderUsMax;
+    uint32_t jitterUsMax;
+};
+PlaybackBench playbackBench = {};
+
+// Console: the selected command on top, the output scrolling below it in
+// hardware, the button hint at the bottom
+const uint8_t CONSOLE_COMMAND_COUNT = sizeof(CONSOLE_COMMANDS) / sizeof(CONSOLE_COMMANDS[0]);
+static_assert(CONSOLE_COLUMNS <= ScrollTextView::MAX_COLUMNS, "console lines fit the view");
+bool consoleLine(uint32_t line, char* out, uint16_t& color, void* context);
+ScrollTextView consoleView(&lcd, 14, 20, consoleLine);
+uint8_t consoleCommand = 0;
+bool consoleCommandChanged = true;
+const int32_t CONSOLE_PAGE_LINES = 16;
+
+// Which layout page is showing; Button B steps through them, and past
+// the last one to the controllers page (dashboardLayout.pageCount), the
+// cells page (one after) and the laps page (two after), each while it
+// has something to show
+uint8_t dashboardPage = 0;
+
+// Fields the controllers page shows
+#define CONTROLLERS_PAGE_FIELDS (VALUES_MASK_POWER | VALUES_MASK_TEMPS | VALUES_MASK_FAULT | VALUES_MASK_ENERGY)
+
+// Fields a running lap adds up, and the laps page shows
+#define LAP_FIELDS (VALUES_FIELD_V_IN | VALUES_FIELD_CURRENT_IN | VALUES_FIELD_CURRENT_MOTOR | VALUES_FIELD_RPM | \
+                    VALUES_FIELD_WATT_HOURS | VALUES_FIELD_WATT_HOURS_CHARGED | VALUES_FIELD_TACHOMETER_ABS)
+
+// Settings screen: a title, one line per setting and the button hint.
+// Pushed over the device list by holding Button B.
+TextWidget settingsLines[SETTING_COUNT + 2] = {
+    { &lcd, 10, 8, 300, 14, 2, ALIGN_LEFT },
+    { &lcd, 10, 28, 300, 10, 1, ALIGN_LEFT },
+    { &lcd, 10, 38, 300, 10, 1, ALIGN_LEFT },
+    { &lcd, 10, 48, 300, 10, 1, ALIGN_LEFT },
+    { &lcd, 10, 58, 300, 10, 1, ALIGN_LEFT },
+    { &lcd, 10, 68, 300, 10, 1, ALIGN_LEFT },
+    { &lcd, 10, 78, 300, 10, 1, ALIGN_LEFT },
+    { &lcd, 10, 88, 300, 10, 1, ALIGN_LEFT },
+    { &lcd, 10, 98, 300, 10, 1, ALIGN_LEFT },
+    { &lcd, 10, 108, 300, 10, 1, ALIGN_LEFT },
+    { &lcd, 10, 118, 300, 10, 1, ALIGN_LEFT },
+    { &lcd, 10, 128, 300, 10, 1, ALIGN_LEFT },
+    { &lcd, 10, 138, 300, 10, 1, ALIGN_LEFT },
+    { &lcd, 10, 148, 300, 10, 1, ALIGN_LEFT },
+    { &lcd, 10, 158, 300, 10, 1, ALIGN_LEFT },
+    { &lcd, 10, 168, 300, 10, 1, ALIGN_LEFT },
+    { &lcd, 10, 178, 300, 10, 1, ALIGN_LEFT },
+    { &lcd, 10, 188, 300, 10, 1, ALIGN_LEFT },
+    { &lcd, 10, 198, 300, 10, 1, ALIGN_LEFT },
+    { &lcd, 10, 208, 300, 10, 1, ALIGN_LEFT },
+    { &lcd, 10, 220, 300, 16, 1, ALIGN_LEFT }
+};
+static_assert(sizeof(settingsLines) / sizeof(settingsLines[0]) == SETTING_COUNT + 2, "a line per setting");
+Compositor settingsPanel;
+uint8_t selectedSetting = 0;
+
+// Rider menu: a title, one line per profile and the button hint. Pushed
+// over the dashboard or the device list by a swipe down.
+TextWidget riderLines[SETTINGS_PROFILE_COUNT + 2] = {
+    { &lcd, 10, 8, 300, 14, 2, ALIGN_LEFT },
+    { &lcd, 10, 40, 300, 16, 2, ALIGN_LEFT },
+    { &lcd, 10, 64, 300, 16, 2, ALIGN_LEFT },
+    { &lcd, 10, 88, 300, 16, 2, ALIGN_LEFT },
+    { &lcd, 10, 112, 300, 16, 2, ALIGN_LEFT },
+    { &lcd, 10, 220, 300, 16, 1, ALIGN_LEFT }
+};
+static_assert(sizeof(riderLines) / sizeof(riderLines[0]) == SETTINGS_PROFILE_COUNT + 2, "a line per profile");
+Compositor riderPanel;
+uint8_t selectedRider = 0;
+
+// Pairing screen: one QR code at a time, each drawn into its sprite the
+// first time it is shown and pushed from it after
+enum PairingCode : uint8_t {
+    PAIRING_LOG_SERVICE,
+    PAIRING_WIFI,
+    PAIRING_CODE_COUNT
+};
+QrCodeSprite logServiceCode(&lcd);
+QrCodeSprite wifiCode(&lcd);
+QrCodeSprite* const pairingCodes[PAIRING_CODE_COUNT] = { &logServiceCode, &wifiCode };
+uint8_t shownPairingCode = 0;
+bool logServiceReady = false;
+
+// Reconnection tracking
+unsigned long nextReconnectAttempt = 0;  // millis() of the next attempt, from the connection manager
+const int RECONNECT_INTERVAL_MS = 5000;  // First retry after 5 seconds, doubling after each failure...
+const int RECONNECT_MAX_INTERVAL_MS = 30000; // ...up to 30 seconds; hearing the VESC retries at once
+unsigned long connectFailedTime = 0;  // When "Connection failed" was shown
+const int CONNECT_FAILED_DISPLAY_MS = 2000;
+unsigned long connectionStartTime = 0;  // Track when connection was established
+const int CONNECTION_GRACE_PERIOD_MS = 10000;  // Give 10 seconds grace period for initial data
+const int HEAP_LOG_INTERVAL_MS = 60000;  // Periodic heap readout for soak tests
+
+// VESC communication now handled by VescUart library
+
+// BLE connections, the host's (ble_host.h), set up once in setup() and
+// reused for every reconnect
+BleTransport* const vescLinks[VESC_MAX_LINKS] = { &bleHostLink(0), &bleHostLink(1), &bleHostLink(2) };
+
+// What each link's bytes travel over: its BLE connection, unless a wired
+// build puts its cable in place of the primary
+VescUartLink wiredUart;
+VescCanLink wiredCan;
+VescTransport* vescTransports[VESC_MAX_LINKS] = { vescLinks[0], vescLinks[1], vescLinks[2] };
+
+bool linkIsBle(uint8_t link) {
+    return vescTransports[link] == vescLinks[link];
+}
+
+// Wired builds only: the VESC has answered, and when it was last probed
+bool wiredUp = false;
+uint32_t wiredProbeMs = 0;
+
+// Reassemble fragmented packets from each link's notifications; the
+// framer's context is the link index
+void parseVESCResponse(const uint8_t* payload, size_t length, void* context);
+VescDispatcher replyDispatcher;  // Reply handlers by command byte, set up in setup()
+static_assert(VESC_MAX_LINKS == 3, "one framer per link");
+VescFramer vescFramers[VESC_MAX_LINKS] = {
+    VescFramer(parseVESCResponse, (void*)0),
+    VescFramer(parseVESCResponse, (void*)1),
+    VescFramer(parseVESCResponse, (void*)2),
+};
+
+// Send a VESC packet with a short (<= 255 byte) payload over a link
+void sendVESCPacket(uint8_t link, const uint8_t* payload, size_t length) {
+    // Checks the link rather than connState so the readiness probe can be
+    // sent while the connection task is still setting up the link
+    if (!vescTransports[link]->isConnected() || length == 0 || length > 255) return;
+    
+    uint8_t packet[255 + VESC_PACKET_MAX_OVERHEAD];
+    size_t packetLength = vescEncodePacket(payload, length, packet);
+    traceEvent(TRACE_WRITE, link, (uint16_t)packetLength);
+    vescTransports[link]->write(packet, packetLength);
+    LOG_V(PROTO, "Sent VESC packet on link %d: command %d (%d bytes)", link, payload[0], (int)packetLength);
+}
+
+// Send a command that has no arguments
+void sendVESCPacket(uint8_t link, uint8_t command) {
+    sendVESCPacket(link, &command, 1);
+}
+
+// Outgoing frames are queued per link and written in as few MTU-sized
+// writes as possible, control ahead of telemetry. UI task only; the
+// connection task's readiness probe uses sendVESCPacket() directly.
+bool writeVESCBatch(const uint8_t* data, size_t length, void* context) {
+    VescTransport* transport = vescTransports[(uintptr_t)context];
+    if (!transport->isConnected()) return false;
+    traceEvent(TRACE_WRITE, (uint8_t)(uintptr_t)context, (uint16_t)length);
+    return transport->write(data, length);
+}
+
+VescTxScheduler vescTx[VESC_MAX_LINKS] = {
+    VescTxScheduler(writeVESCBatch, (void*)0),
+    VescTxScheduler(writeVESCBatch, (void*)1),
+    VescTxScheduler(writeVESCBatch, (void*)2),
+};
+
+void queueVESCPacket(uint8_t link, const VescCommand& command) {
+    // COMM_ALIVE shares the write when one is coming due
+    if (sessionLinks & (1u << link) && heartbeats[link].piggyback(millis())) {
+        vescTx[link].add(VescTxScheduler::TELEMETRY, VescCommand(COMM_ALIVE), millis());
+    }
+    if (!vescTx[link].add(VescTxScheduler::TELEMETRY, command, millis())) {
+        LOG_W(PROTO, "Dropped VESC command %d for link %d", command.payload()[0], link);
+    }
+}
+
+// A setpoint or keepalive: written at once, ahead of any queued polls.
+// Returns false if it was over the control rate or the link is down.
+bool sendVESCControl(uint8_t link, const VescCommand& command) {
+    if (!vescTransports[link]->isConnected()) return false;
+    if (!vescTx[link].add(VescTxScheduler::CONTROL, command, millis())) {
+        LOG_D(PROTO, "Control command %d for link %d refused", command.payload()[0], link);
+        return false;
+    }
+    vescTx[link].flush();
+    return true;
+}
+
+// Write out the queued polls. A link that is busy keeps the rest for the
+// next call, so the poll loop never waits on the BLE stack.
+void flushVESCPackets() {
+    for (uint8_t link = 0; link < VESC_MAX_LINKS; link++) {
+        if (vescTx[link].pending() > 0) vescTx[link].flush();
+    }
+}
+
+// A packet from VESC Tool on the USB bridge. It joins the polls in the
+// primary link's batch, so the two never interleave inside a packet.
+void bridgePacketToVesc(const uint8_t* payload, size_t length) {
+    if (!vescTransports[0]->isConnected()) return;
+    if (!vescTx[0].add(VescTxScheduler::TELEMETRY, payload, length, millis())) {
+        LOG_W(PROTO, "Dropped bridged VESC command %d", payload[0]);
+    }
+}
+
+bool vescPacketsPending() {
+    for (uint8_t link = 0; link < VESC_MAX_LINKS; link++) {
+        if (vescTx[link].pending() > 0) return true;
+    }
+    return false;
+}
+
+// Link a controller is reached through
+uint8_t controllerLink(uint8_t controller) {
+    return controller < VESC_MAX_LINKS ? controller : controllerLinks[controller];
+}
+
+// True if a controller's link is up and the controller is assigned
+bool controllerActive(uint8_t controller) {
+    if (controller >= VESC_MAX_LINKS && !(canSlotsUsed & (1u << controller))) return false;
+    return sessionLinks & (1u << controllerLink(controller));
+}
+
+// Period in ms for a rate in Hz; 0 stays 0 (off)
+uint32_t pollPeriodMs(int hz) {
+    return hz > 0 ? 1000 / hz : 0;
+}
+
+// Telemetry quantities polled at their own rates
+struct PollGroup {
+    uint32_t fields;
+    int rateHz;
+    PollPriority priority;   // Which gives way first on a saturated link
+    int id;                  // Subscription in pollSchedule
+};
+PollGroup pollGroups[] = {
+    { VALUES_MASK_POWER, POLL_RATE_POWER_HZ, POLL_CRITICAL, -1 },
+    { VALUES_MASK_TEMPS, POLL_RATE_TEMPS_HZ, POLL_NORMAL, -1 },
+    { VALUES_MASK_FAULT, POLL_RATE_FAULT_HZ, POLL_CRITICAL, -1 },
+    { VALUES_MASK_ENERGY, POLL_RATE_ENERGY_HZ, POLL_LOW, -1 },
+};
+const int POLL_GROUP_COUNT = sizeof(pollGroups) / sizeof(pollGroups[0]);
+
+// Generated decoders for the masks the visible page requests: each poll
+// group as the page trims it, with and without the controller id that
+// forwarded requests add. Picked by the UI task on a page change and read
+// by the parser task; a generated decoder checks the echoed mask itself,
+// so an entry read mid-update only falls back to the generic decoder.
+struct ReplyDecoder {
+    volatile uint32_t mask;
+    ValuesDecoder volatile decode;
 };
+ReplyDecoder replyDecoders[2 * POLL_GROUP_COUNT];
+
+bool parked = false;  // Board still for MOTION_STILL_SECONDS; polled slower
+bool capturing = false;  // A fault capture window is open; polled faster
+
+void pickReplyDecoders() {
+    int n = 0;
+    for (const PollGroup& group : pollGroups) {
+        uint32_t masks[2] = { group.fields & shownFields, (group.fields & shownFields) | VALUES_FIELD_CONTROLLER_ID };
+        for (uint32_t mask : masks) {
+            ValuesDecoder decode = valuesDecoderForMask(mask);
+            replyDecoders[n].mask = decode != decodeValuesSelective ? mask : 0;
+            replyDecoders[n++].decode = decode;
+        }
+    }
+}
+
+// A selective reply through the decoder picked for its mask, or the
+// generic one
+bool decodeSelectiveReply(const uint8_t* payload, size_t length, VescValues& values) {
+    if (length >= 5) {
+        uint32_t mask = (uint32_t)payload[1] << 24 | (uint32_t)payload[2] << 16 | (uint32_t)payload[3] << 8 | payload[4];
+        for (const ReplyDecoder& decoder : replyDecoders) {
+            if (decoder.mask != mask) continue;
+            ValuesDecoder decode = decoder.decode;
+            if (decode && decode(payload, length, values)) return true;
+            break;
+        }
+    }
+    return decodeValuesSelective(payload, length, values);
+}
+
+// Poll what the visible page shows: a group with none of its fields on
+// the page is paused, and the rest are requested without the fields no
+// widget needs. Parked, every group is polled MOTION_PARKED_SLOWDOWN
+// times less often. While a fault is being captured the capture fields
+// are polled at FAULT_CAPTURE_RATE_HZ whatever the page or motion.
+void subscribeVisiblePage() {
+    uint32_t pageFields = 0;
+    if (dashboardPage < dashboardLayout.pageCount) {
+        pageFields = layoutPageFields(dashboardLayout, dashboardPage);
+    } else if (dashboardPage == dashboardLayout.pageCount) {
+        pageFields = CONTROLLERS_PAGE_FIELDS;
+    } else if (dashboardPage == dashboardLayout.pageCount + 2) {
+        pageFields = LAP_FIELDS;
+    }
+    shownFields = pageFields | POLL_ALWAYS_FIELDS | formulaFields;
+    if (capturing) shownFields |= FAULT_CAPTURE_FIELDS;
+    // A lap's figures need their fields whatever page is showing
+    if (lapsTiming) shownFields |= LAP_FIELDS;
+    uint32_t slowdown = parked && !capturing ? MOTION_PARKED_SLOWDOWN : 1;
+    for (const PollGroup& group : pollGroups) {
+        bool shown = (group.fields & shownFields) != 0;
+        uint32_t period = shown ? pollPeriodMs(group.rateHz) * slowdown : 0;
+        if (capturing && (group.fields & FAULT_CAPTURE_FIELDS)) {
+            uint32_t capturePeriod = pollPeriodMs(FAULT_CAPTURE_RATE_HZ);
+            if (period == 0 || capturePeriod < period) period = capturePeriod;
+        }
+        pollSchedule.setPeriod(group.id, period);
+        uint32_t cached = group.fields & RESPONSE_CACHE_FIELDS;
+        for (uint32_t rest = cached; rest != 0; rest &= rest - 1) {
+            valuesCacheTtl[__builtin_ctz(rest)] = period * RESPONSE_CACHE_TTL_PERCENT / 100;
+        }
+    }
+    pickReplyDecoders();
+    LOG_D(PROTO, "Page %d polls fields 0x%06x", dashboardPage, (unsigned)shownFields);
+}
+
+// Follow the motion detector. Moving again makes every quantity due at
+// once rather than at the end of its long parked period.
+void setParked(bool nowParked) {
+    parked = nowParked;
+    LOG_I(APP, "%s", parked ? "Parked: slower polling" : "Moving: full-rate polling");
+    subscribeVisiblePage();
+    if (!parked) {
+        pollSchedule.restart(millis());
+        lastTelemetryRequest = 0;
+    }
+}
+
+// Follow the fault capture. A new window makes the capture fields due at
+// once and lets requests go out as fast as the capture rate.
+void setCapturing(bool nowCapturing) {
+    capturing = nowCapturing;
+    uint32_t minPeriod = settings().refreshMs;
+    if (capturing && pollPeriodMs(FAULT_CAPTURE_RATE_HZ) < minPeriod) minPeriod = pollPeriodMs(FAULT_CAPTURE_RATE_HZ);
+    portENTER_CRITICAL(&requestTrackerMux);
+    for (uint8_t i = 0; i < TELEMETRY_MAX_CONTROLLERS; i++) {
+        requestTrackers[i].setMinPeriod(minPeriod);
+    }
+    portEXIT_CRITICAL(&requestTrackerMux);
+    subscribeVisiblePage();
+    if (capturing) {
+        pollSchedule.restart(millis());
+        lastTelemetryRequest = 0;
+    }
+}
+
+// The filter stages from the settings above
+void setupFilters() {
+    uint8_t median = FILTER_NONE;
+    if (FILTER_CURRENT_MEDIAN == 3) median = FILTER_MEDIAN3;
+    if (FILTER_CURRENT_MEDIAN == 5) median = FILTER_MEDIAN5;
+    const ValuesFilterStage stages[] = {
+        { VALUES_BIT_V_IN, FILTER_EMA, FILTER_VOLTAGE_EMA_SHIFT },
+        { VALUES_BIT_CURRENT_IN, median, 0 },
+        { VALUES_BIT_CURRENT_MOTOR, median, 0 },
+        { VALUES_BIT_TEMP_FET, FILTER_EMA, FILTER_TEMP_EMA_SHIFT },
+        { VALUES_BIT_TEMP_MOTOR, FILTER_EMA, FILTER_TEMP_EMA_SHIFT },
+    };
+    telemetrySetFilters(stages, sizeof(stages) / sizeof(stages[0]));
+}
+
+// Subscribe the telemetry quantities at their configured rates
+void setupPollSchedule() {
+    for (PollGroup& group : pollGroups) {
+        group.id = pollSchedule.add(group.fields, pollPeriodMs(group.rateHz), group.priority);
+    }
+    subscribeVisiblePage();
+}
+
+// Compile the alert rules for the current thresholds. A fault already
+// shows on the status line, so that rule only beeps.
+void applyAlertRules(const Settings& s) {
+    const uint8_t outputs = ALERT_OUT_COLOR | ALERT_OUT_BEEP | ALERT_OUT_VIBRATE;
+    AlertRule rules[5];
+    uint8_t count = 0;
+    if (ALERT_ON_FAULT) {
+        rules[count++] = { "Fault", ALERT_Q_FAULT, ALERT_NOT_EQUAL, 0, 0, ALERT_OUT_BEEP | ALERT_OUT_VIBRATE,
+                           AUDIO_CLIP_FAULT, HAPTIC_TRIPLE };
+    }
+    if (s.alertFetTempC != 0) {
+        rules[count++] = { "FET hot", ALERT_Q_TEMP_FET, ALERT_ABOVE, s.alertFetTempC * 10, ALERT_TEMP_HYSTERESIS,
+                           outputs, AUDIO_CLIP_ALERT, HAPTIC_PULSE };
+    }
+    if (s.alertMotorTempC != 0) {
+        rules[count++] = { "Motor hot", ALERT_Q_TEMP_MOTOR, ALERT_ABOVE, s.alertMotorTempC * 10,
+                           ALERT_TEMP_HYSTERESIS, outputs, AUDIO_CLIP_ALERT, HAPTIC_PULSE };
+    }
+    if (s.alertCellMv != 0) {
+        rules[count++] = { "Low battery", ALERT_Q_V_IN, ALERT_BELOW, (int32_t)s.alertCellMv * s.batteryCells / 100,
+                           ALERT_VOLTAGE_HYSTERESIS, outputs, AUDIO_CLIP_ALERT, HAPTIC_PULSE };
+    }
+    if (THERMAL_ALERT_SECONDS != 0) {
+        rules[count++] = { "Derate soon", ALERT_Q_DERATE, ALERT_BELOW, THERMAL_ALERT_SECONDS,
+                           THERMAL_ALERT_HYSTERESIS_S, outputs, AUDIO_CLIP_ALERT, HAPTIC_PULSE };
+    }
+    alertsConfigure(rules, count);
+}
+
+// Work out the chosen units' conversions; the pages show them from their
+// next update on. Returns true if the units changed.
+bool applyUnits() {
+    const Settings& s = settings();
+    UnitSettings units = { s.fahrenheit != 0, s.miles != 0 };
+    const UnitSettings& shown = unitsSettings();
+    // Metric until configured, which needs no conversions
+    if (units.fahrenheit == shown.fahrenheit && units.miles == shown.miles) return false;
+    unitsConfigure(units);
+    return true;
+}
+
+bool layoutPageShown(uint8_t page);
+bool dashboardPageAvailable(uint8_t page);
+
+// Put the current settings into effect; called at boot, whenever one is
+// changed on the settings screen and on a switch of rider
+void applySettings() {
+    const Settings& s = settings();
+    portENTER_CRITICAL(&requestTrackerMux);
+    for (uint8_t i = 0; i < TELEMETRY_MAX_CONTROLLERS; i++) {
+        requestTrackers[i].setMinPeriod(s.refreshMs);
+    }
+    portEXIT_CRITICAL(&requestTrackerMux);
+    pollGroups[0].rateHz = s.pollPowerHz;
+    pollGroups[1].rateHz = s.pollTempsHz;
+    pollGroups[2].rateHz = s.pollFaultHz;
+    // The page showing may be one the rider's pages leave out
+    if (!dashboardPageAvailable(dashboardPage)) {
+        dashboardPage = 0;
+        while (dashboardPage + 1 < dashboardLayout.pageCount && !layoutPageShown(dashboardPage)) dashboardPage++;
+    }
+    subscribeVisiblePage();
+    SocConfig battery = { BATTERY_CHEMISTRY, s.batteryCells, BATTERY_RESISTANCE_MOHM, BATTERY_SOC_SMOOTHING_MS };
+    telemetrySetBattery(battery);
+    DrivetrainConfig wheels = { s.motorPoles, s.gearRatioX100, s.wheelDiameterMm };
+    drivetrain.configure(wheels);
+    odometerConfigure(drivetrain);
+    shownDerived.setDrivetrain(&drivetrain);
+    shownChanged = VALUES_ALL_FIELDS;   // Speed and distance read differently now
+    EnergyConfig energy = { BATTERY_CHEMISTRY, s.batteryCells, s.batteryCapacityMah, ENERGY_RECENT_METERS,
+                            ENERGY_MIN_METERS };
+    energyEstimator.configure(energy, drivetrain);
+    applyAlertRules(s);
+    telemetrySetStaleTimeout(s.staleTimeoutMs);
+    connectionManagerSetScanTime(s.scanSeconds);
+    renderGovernor.setRate(s.targetFps, IDLE_TICK_MS);
+    if (applyUnits()) {
+        for (uint8_t page = 0; page < dashboardLayout.pageCount; page++) dashboardViews[page].unitsChanged();
+        LOG_I(UI, "Units: %s, %s", unitsName(UNIT_TEMPERATURE), unitsName(UNIT_SPEED));
+    }
+}
+
+// Match a reply against the outstanding requests of a controller
+void trackReply(uint8_t controller, uint8_t command) {
+    portENTER_CRITICAL(&requestTrackerMux);
+    bool matched = requestTrackers[controller].onReply(command, millis());
+    uint32_t rtt = requestTrackers[controller].lastRtt();
+    replySentUs = matched ? requestTrackers[controller].lastTag() : 0;
+    uint32_t outstanding = 0;
+    for (uint8_t i = 0; i < TELEMETRY_MAX_CONTROLLERS; i++) outstanding += requestTrackers[i].inFlight();
+    portEXIT_CRITICAL(&requestTrackerMux);
+    if (matched) perfNoteRtt(rtt);
+    if (matched && TRACE_SAVE_RTT_MS > 0 && rtt >= TRACE_SAVE_RTT_MS && traceSaveDueMs == 0) {
+        traceSaveDueMs = millis() + TRACE_SAVE_DELAY_MS;
+        traceSaveRtt = rtt;
+    }
+    if (outstanding == 0) coexistPollAnswered();
+}
+
+// Save the event trace once a late reply has had its aftermath recorded,
+// at most once per TRACE_SAVE_INTERVAL_MS. UI task.
+void updateEventTrace() {
+    static uint32_t lastSaveMs = 0;
+    static bool saved = false;
+    uint32_t dueMs = traceSaveDueMs;
+    if (dueMs == 0 || (int32_t)(millis() - dueMs) < 0) return;
+    if (!saved || millis() - lastSaveMs >= TRACE_SAVE_INTERVAL_MS) {
+        char reason[32];
+        snprintf(reason, sizeof(reason), "reply after %u ms", (unsigned)traceSaveRtt);
+        traceSave(reason);
+        lastSaveMs = millis();
+        saved = true;
+    }
+    traceSaveDueMs = 0;
+}
+
+// How long the replies to a poll may take: the slowest controller's
+// smoothed RTT plus its spread
+uint32_t pollReplyWindow() {
+    uint32_t window = 0;
+    portENTER_CRITICAL(&requestTrackerMux);
+    for (uint8_t i = 0; i < TELEMETRY_MAX_CONTROLLERS; i++) {
+        if (!controllerActive(i)) continue;
+        const RequestTracker& tracker = requestTrackers[i];
+        uint32_t w = tracker.smoothedRtt() > 0 ? tracker.smoothedRtt() + 4 * tracker.rttVariance() : REQUEST_TIMEOUT_MS;
+        if (w > window) window = w;
+    }
+    portEXIT_CRITICAL(&requestTrackerMux);
+    return window;
+}
+
+// Poll period the slowest controller's round-trip time and link quality
+// allow
+uint32_t telemetryPollPeriod() {
+    uint32_t period = 0;
+    for (uint8_t i = 0; i < TELEMETRY_MAX_CONTROLLERS; i++) {
+        if (!controllerActive(i)) continue;
+        uint32_t p = requestTrackers[i].pollPeriod() * linkQuality[controllerLink(i)].pollSlowdown();
+        if (p > period) period = p;
+    }
+    if (period > VESC_DATA_MAX_REFRESH_MS) period = VESC_DATA_MAX_REFRESH_MS;
+    return period > 0 ? period : settings().refreshMs;
+}
+
+// Counters a link's quality is scored from: its framer, and the request
+// trackers of the controllers reached through it
+LinkCounters linkCounters(uint8_t link) {
+    LinkCounters counters;
+    memset(&counters, 0, sizeof(counters));
+    portENTER_CRITICAL(&requestTrackerMux);
+    for (uint8_t i = 0; i < TELEMETRY_MAX_CONTROLLERS; i++) {
+        if (!controllerActive(i) || controllerLink(i) != link) continue;
+        counters.replies += requestTrackers[i].replies();
+        counters.timeouts += requestTrackers[i].timeouts();
+        if (requestTrackers[i].smoothedRtt() > counters.srttMs) counters.srttMs = requestTrackers[i].smoothedRtt();
+    }
+    portEXIT_CRITICAL(&requestTrackerMux);
+    counters.frames = vescFramers[link].framesReceived();
+    counters.crcErrors = vescFramers[link].crcErrorCount();
+    counters.rssi = linkIsBle(link) ? vescLinks[link]->rssi() : 0;
+    return counters;
+}
+
+// Score each link's last window and ask for a fresh RSSI for the next
+void updateLinkQuality() {
+    if (millis() - lastLinkQualityUpdate < LINK_QUALITY_WINDOW_MS) return;
+    lastLinkQualityUpdate = millis();
+    for (uint8_t link = 0; link < VESC_MAX_LINKS; link++) {
+        if (!(sessionLinks & (1u << link))) continue;
+        LinkQuality& quality = linkQuality[link];
+        LinkQuality::Level before = quality.level();
+        LinkCounters counters = linkCounters(link);
+        if (quality.update(counters) != before) {
+            LOG_W(PROTO, "Link %d quality %s -> %s (score %d, RTT %ums, RSSI %d)", link,
+                  LinkQuality::levelName(before), LinkQuality::levelName(quality.level()),
+                  quality.score(), counters.srttMs, counters.rssi);
+        }
+        if (linkIsBle(link)) vescLinks[link]->requestRssi();
+    }
+}
+
+// Worst quality over the links being polled
+LinkQuality::Level worstLinkQuality() {
+    LinkQuality::Level worst = LinkQuality::LINK_GOOD;
+    for (uint8_t link = 0; link < VESC_MAX_LINKS; link++) {
+        if ((sessionLinks & (1u << link)) && linkQuality[link].level() > worst) worst = linkQuality[link].level();
+    }
+    return worst;
+}
+
+// Controller a values reply on a link came from, by the controller id it
+// carries. Replies without one can only be from the link's own VESC.
+uint8_t controllerForReply(uint8_t link, const uint8_t* payload, size_t length) {
+    if (canSlotsUsed == 0) return link;
+    int id = valuesReplyControllerId(payload, length, *linkStates[link].layout);
+    for (uint8_t i = VESC_MAX_LINKS; i < TELEMETRY_MAX_CONTROLLERS; i++) {
+        if ((canSlotsUsed & (1u << i)) && controllerLinks[i] == link && controllerCanIds[i] == id) return i;
+    }
+    return link;
+}
+
+// Free a link's CAN slots. Runs on the parser task.
+void releaseCanSlots(uint8_t link) {
+    for (uint8_t i = VESC_MAX_LINKS; i < TELEMETRY_MAX_CONTROLLERS; i++) {
+        if ((canSlotsUsed & (1u << i)) && controllerLinks[i] == link) {
+            canSlotsUsed &= ~(1u << i);
+            telemetryForgetController(i);
+        }
+    }
+}
+
+// Slot of the controller at a CAN id behind a link, -1 if it has none
+int canSlotFor(uint8_t link, uint8_t canId) {
+    for (uint8_t i = VESC_MAX_LINKS; i < TELEMETRY_MAX_CONTROLLERS; i++) {
+        if ((canSlotsUsed & (1u << i)) && controllerLinks[i] == link && controllerCanIds[i] == canId) return i;
+    }
+    return -1;
+}
+
+// Hand a free CAN slot to the controller at a CAN id. Returns the slot,
+// -1 if none is left. Runs on the parser task.
+int assignCanSlot(uint8_t link, uint8_t canId) {
+    uint8_t slot = VESC_MAX_LINKS;
+    while (slot < TELEMETRY_MAX_CONTROLLERS && (canSlotsUsed & (1u << slot))) slot++;
+    if (slot == TELEMETRY_MAX_CONTROLLERS) return -1;
+    
+    portENTER_CRITICAL(&requestTrackerMux);
+    controllerLinks[slot] = link;
+    controllerCanIds[slot] = canId;
+    controllerValues[slot] = VescValues();
+    lastFaultCodes[slot] = 0;
+    canStatusHeard[slot] = 0;
+    valuesCaches[slot].clear();
+    requestTrackers[slot].reset(true);
+    portEXIT_CRITICAL(&requestTrackerMux);
+    telemetryForgetController(slot);
+    canSlotsUsed |= 1u << slot;
+    return slot;
+}
+
+// Start polling the controllers that answered a link's CAN ping. Runs on
+// the parser task, which owns the decoder and telemetry state.
+void startPollingCan(uint8_t link, const uint8_t* ids, int found) {
+    linkStates[link].canDiscovery = CAN_DISCOVERY_DONE;
+    if (found == 0) {
+        LOG_I(PROTO, "No other controllers on the CAN bus of link %d", link);
+        return;
+    }
+
+    for (int i = 0; i < found; i++) {
+        // Already heard broadcasting its status
+        if (canSlotFor(link, ids[i]) >= 0) continue;
+        int slot = assignCanSlot(link, ids[i]);
+        if (slot < 0) {
+            LOG_W(PROTO, "No controller slot left for CAN id %d on link %d", ids[i], link);
+            break;
+        }
+        LOG_I(PROTO, "Polling controller %d at CAN id %d on link %d", slot, ids[i], link);
+    }
+}
 
-std::vector<BLEDeviceInfo> discoveredDevices;
-bool scanComplete = false;
-int selectedDeviceIndex = 0;
-bool isConnected = false;
-float vescVoltage = 0.0;
-float vescFetTemp = 0.0;
-unsigned long lastVoltageUpdate = 0;
+// Framed size of the reply a values request for fields draws on a link
+size_t pollReplyBytes(uint8_t link, uint32_t fields) {
+    const LinkState& state = linkStates[link];
+    size_t payload = state.selectiveSupported ? 1 + 4 + valuesSelectiveReplySize(fields) : state.layout->size;
+    return payload + vescPacketOverhead(payload);
+}
+
+// Request a set of telemetry fields from one controller. Returns false
+// without sending if nothing is left to ask for once a poor link, fields
+// the controller keeps broadcasting and a fresh cache have trimmed them,
+// while a throughput probe runs, if the request is over the link's
+// throughput budget, or if the in-flight limit is reached.
+bool requestTelemetry(uint8_t controller, uint32_t fields) {
+    uint8_t link = controllerLink(controller);
+    LinkState& state = linkStates[link];
+    if (state.selectiveSupported && state.selectiveUnanswered >= SELECTIVE_FALLBACK_AFTER) {
+        LOG_W(PROTO, "No COMM_GET_VALUES_SELECTIVE replies on link %d, falling back to COMM_GET_VALUES", link);
+        state.selectiveSupported = false;
+    }
+    
+    // A poor link carries only the numbers that matter most
+    if (linkQuality[link].level() == LinkQuality::LINK_POOR) {
+        fields &= LINK_POOR_FIELDS;
+        if (fields == 0) return false;
+    }
+    
+    // Fields the controller keeps broadcasting need no request
+    if (millis() - canStatusHeardMs[controller] < CAN_STATUS_HEARD_MS) {
+        fields &= ~canStatusHeard[controller];
+        if (fields == 0) return false;
+    }
+    
+    // ...nor do fields still fresh from an earlier reply
+    portENTER_CRITICAL(&requestTrackerMux);
+    uint32_t rtt = requestTrackers[controller].smoothedRtt();
+    portEXIT_CRITICAL(&requestTrackerMux);
+    uint32_t fresh = valuesCaches[controller].fresh(fields, valuesCacheTtl, rtt, millis());
+    if (fresh != 0) {
+        responseCacheHits += __builtin_popcount(fresh);
+        fields &= ~fresh;
+        if (fields == 0) return false;
+    }
+    
+    // Ask for no more than the link was measured to carry: over budget,
+    // the request shrinks to the fields that matter most, or waits
+    if (throughputProbes[link].active()) return false;
+    ThroughputBudget& budget = throughputBudgets[link];
+    if (!budget.fits(pollReplyBytes(link, fields), millis())) {
+        uint32_t critical = fields & LINK_POOR_FIELDS;
+        if (critical == 0 || critical == fields || !budget.fits(pollReplyBytes(link, critical), millis())) {
+            LOG_V(PROTO, "Telemetry request to controller %d over the link's throughput", controller);
+            return false;
+        }
+        fields = critical;
+    }
+    
+    uint8_t command = state.selectiveSupported ? COMM_GET_VALUES_SELECTIVE : COMM_GET_VALUES;
+    RequestTracker& tracker = requestTrackers[controller];
+    portENTER_CRITICAL(&requestTrackerMux);
+    bool canSend = tracker.canSend(millis());
+    // Tagged with the send time in us, for the stage latencies
+    if (canSend) tracker.onSent(command, millis(), (uint32_t)esp_timer_get_time());
+    portEXIT_CRITICAL(&requestTrackerMux);
+    if (canSend) traceEvent(TRACE_REQUEST, link, (uint16_t)(command << 8 | controller));
+    if (!canSend) {
+        LOG_V(PROTO, "Telemetry request to controller %d skipped, %d in flight", controller, tracker.inFlight());
+        return false;
+    }
+    
+    // A forwarded reply is only recognized by the controller id in it
+    bool forward = controller >= VESC_MAX_LINKS;
+    VescCommand request = forward ? VescCommand(command, controllerCanIds[controller]) : VescCommand(command);
+    if (state.selectiveSupported) {
+        if (forward) fields |= VALUES_FIELD_CONTROLLER_ID;
+        request.addUint32(fields);
+        if (!forward) state.selectiveUnanswered++;
+    }
+    budget.spend(pollReplyBytes(link, fields));
+    queueVESCPacket(link, request);
+    return true;
+}
 
-// Display update tracking to prevent flicker
-float lastDisplayedVoltage = -1.0;
-float lastDisplayedFetTemp = -1.0;
-int lastBatteryLevel = -1;
-bool needsFullRedraw = true;
-String lastStatusText = "";
+// BMS polling on the primary link. Requests without a reply carrying
+// cells are counted, and reset by the reply handler.
+uint32_t bmsRequestMs = 0;
+uint8_t bmsUnanswered = 0;
+bool bmsHeard = false;
+
+// Ask for the BMS reading, with the generic command builder like any
+// other request. A bus that has shown no cells for a few requests is
+// asked only now and then, in case a BMS is plugged in.
+void pollBms() {
+    if (!BMS_ENABLED || !(sessionLinks & 1u)) return;
+    uint32_t period = bmsUnanswered >= BMS_ABSENT_AFTER ? BMS_ABSENT_POLL_MS : BMS_POLL_MS;
+    if (millis() - bmsRequestMs < period) return;
+    bmsRequestMs = millis();
+    if (bmsUnanswered < 255) bmsUnanswered++;
+    queueVESCPacket(0, VescCommand(COMM_BMS_GET_VALUES));
+}
+
+// Request the due fields from every controller back to back, so their
+// replies overlap on the links; a link's requests share one write where
+// the MTU allows. Returns true if any request went out.
+bool requestTelemetryAll(uint32_t fields) {
+    bool sent = false;
+    for (uint8_t i = 0; i < TELEMETRY_MAX_CONTROLLERS; i++) {
+        if (controllerActive(i) && requestTelemetry(i, fields)) sent = true;
+    }
+    flushVESCPackets();
+    return sent;
+}
+
+// Start polling a link that has just come up. Runs on the UI task.
+void startLinkSession(uint8_t link) {
+    LinkState& state = linkStates[link];
+    state.selectiveSupported = USE_SELECTIVE_VALUES;
+    state.selectiveUnanswered = 0;
+    if (link == 0) {
+        bmsRequestMs = millis() - BMS_POLL_MS;
+        bmsUnanswered = 0;
+        bmsHeard = false;
+    }
+    vescTx[link].clear();
+    vescTx[link].setWriteLimit(vescTransports[link]->writeLimit());
+    heartbeats[link].reset(millis());
+    heartbeatFrames[link] = vescFramers[link].framesReceived();
+    portENTER_CRITICAL(&requestTrackerMux);
+    requestTrackers[link].reset();
+    portEXIT_CRITICAL(&requestTrackerMux);
+    linkQuality[link].reset();
+    
+    // Forwarded replies are only told apart with firmware that sends the
+    // controller id
+    if (CAN_DISCOVERY_ENABLED && (state.layout->fields & VALUES_FIELD_CONTROLLER_ID)) {
+        state.canDiscovery = CAN_DISCOVERY_DUE;
+    }
+    if (VESC_CONFIG_READ_ENABLED) state.configFetch = CONFIG_FETCH_DUE;
+    
+    // A burst of full values requests, answered back to back, measures
+    // the link's reply rate before polling starts
+    throughputBudgets[link].setRate(0, millis());
+    if (THROUGHPUT_PROBE_ENABLED) {
+        portENTER_CRITICAL(&throughputMux);
+        throughputProbes[link].start(THROUGHPUT_PROBE_REQUESTS, millis());
+        portEXIT_CRITICAL(&throughputMux);
+        for (uint8_t i = 0; i < THROUGHPUT_PROBE_REQUESTS; i++) queueVESCPacket(link, VescCommand(COMM_GET_VALUES));
+        vescTx[link].flush();
+    }
+    LOG_I(APP, "Polling link %d (firmware %d.%02d)", link, state.firmware.major, state.firmware.minor);
+}
+
+// Limits of a link's VESC, once read or found in the cache
+void logVescConfig(uint8_t link, const VescConfig& config, const char* source) {
+    char motorMax[12], motorMin[12], batteryMax[12], batteryMin[12], cutStart[12], cutEnd[12];
+    formatFixed(motorMax, sizeof(motorMax), config.currentMax, 2);
+    formatFixed(motorMin, sizeof(motorMin), config.currentMin, 2);
+    formatFixed(batteryMax, sizeof(batteryMax), config.inCurrentMax, 2);
+    formatFixed(batteryMin, sizeof(batteryMin), config.inCurrentMin, 2);
+    formatFixed(cutStart, sizeof(cutStart), config.batteryCutStart, 1);
+    formatFixed(cutEnd, sizeof(cutEnd), config.batteryCutEnd, 1);
+    LOG_I(APP, "VESC on link %d (%s): motor %s/%sA, battery %s/%sA, cutoff %s-%sV, CAN id %d", link, source,
+          motorMax, motorMin, batteryMax, batteryMin, cutStart, cutEnd, config.canId);
+}
+
+// Count down to the primary VESC's own temperature limits once its
+// configuration is known; firmware without them keeps the defaults
+void applyThermalLimits(const VescConfig& config) {
+    ThermalConfig thermal = { THERMAL_FORGETTING, THERMAL_MIN_READINGS, THERMAL_LOAD_SMOOTHING_MS };
+    int16_t fet = config.tempFetStart != 0 ? config.tempFetStart : THERMAL_FET_LIMIT_C * 10;
+    int16_t motor = config.tempMotorStart != 0 ? config.tempMotorStart : THERMAL_MOTOR_LIMIT_C * 10;
+    telemetrySetThermal(thermal, fet, motor);
+}
+
+// Finish a link's throughput probe once its replies are in, and budget
+// the link's polls from the rate it measured
+void updateThroughputProbes() {
+    for (uint8_t link = 0; link < VESC_MAX_LINKS; link++) {
+        ThroughputProbe& probe = throughputProbes[link];
+        if (!probe.active()) continue;
+        portENTER_CRITICAL(&throughputMux);
+        bool finished = probe.update(millis(), THROUGHPUT_PROBE_TIMEOUT_MS);
+        portEXIT_CRITICAL(&throughputMux);
+        if (!finished) continue;
+        uint32_t rate = probe.bytesPerSecond();
+        if (rate == 0) {
+            LOG_W(PROTO, "Throughput probe on link %d had too few replies; polls are not budgeted", link);
+            continue;
+        }
+        ThroughputBudget& budget = throughputBudgets[link];
+        budget.setRate(rate * THROUGHPUT_HEADROOM_PERCENT / 100, millis());
+        LOG_I(PROTO, "Link %d carries %u B/s; polls ask for up to %u B/s, the page's fields every %u ms at most",
+              link, (unsigned)rate, (unsigned)budget.rate(),
+              (unsigned)budget.periodFor(pollReplyBytes(link, shownFields)));
+    }
+}
+
+// Fit the poll groups into the tightest link's budget, shared by the
+// controllers polled through it, so a saturated link slows the groups
+// that matter least rather than every poll alike. Refitted once a
+// window, which follows page changes and links coming and going.
+void fitPollSchedule() {
+    if (millis() - lastPollFit < LINK_QUALITY_WINDOW_MS) return;
+    lastPollFit = millis();
+    uint32_t rate = 0;
+    int tightest = -1;
+    for (uint8_t link = 0; link < VESC_MAX_LINKS; link++) {
+        // Full COMM_GET_VALUES replies cost the same whatever is due
+        if (!(sessionLinks & (1u << link)) || !linkStates[link].selectiveSupported) continue;
+        uint32_t limit = throughputBudgets[link].rate();
+        if (limit == 0) continue;
+        uint32_t controllers = 0;
+        for (uint8_t c = 0; c < TELEMETRY_MAX_CONTROLLERS; c++) {
+            if (controllerActive(c) && controllerLink(c) == link) controllers++;
+        }
+        if (controllers > 1) limit /= controllers;
+        if (tightest < 0 || limit < rate) {
+            rate = limit;
+            tightest = link;
+        }
+    }
+    uint32_t before = pollSchedule.slowedFields();
+    for (const PollGroup& group : pollGroups) {
+        pollSchedule.setCost(group.id, valuesSelectiveReplySize(group.fields & shownFields));
+    }
+    pollSchedule.fit(rate, tightest >= 0 ? pollReplyBytes(tightest, 0) : 0);
+    uint32_t slowed = pollSchedule.slowedFields();
+    if (slowed != before && slowed != 0) {
+        LOG_W(PROTO, "Link %d saturated: fields 0x%06x polled slower", tightest, (unsigned)slowed);
+    } else if (slowed != before) {
+        LOG_I(PROTO, "Links keep up again: every field at its rate");
+    }
+}
+
+// Fields on the page older than a few of their poll periods: a link too
+// busy for them, or replies going missing
+uint32_t staleFields(uint32_t now) {
+    if (playbackRunning || !vescTransports[0]->isConnected()) return 0;
+    uint32_t stale = 0;
+    for (const PollGroup& group : pollGroups) {
+        uint32_t period = pollSchedule.period(group.id);
+        if (period == 0) continue;
+        uint32_t limit = period * POLL_STALE_FACTOR;
+        if (limit < POLL_STALE_MIN_MS) limit = POLL_STALE_MIN_MS;
+        for (uint32_t rest = group.fields & shownFields; rest != 0; rest &= rest - 1) {
+            uint8_t bit = __builtin_ctz(rest);
+            // Never seen: the status line says so
+            uint32_t age = valuesCaches[0].ageMs(bit, now);
+            if (age != UINT32_MAX && age > limit) stale |= 1u << bit;
+        }
+    }
+    return stale;
+}
+
+// Read each link's VESC configuration once per connection, or take it
+// from the cache when the VESC and its firmware are the same as before
+void fetchVescConfigs() {
+    for (uint8_t link = 0; link < VESC_MAX_LINKS; link++) {
+        LinkState& state = linkStates[link];
+        if (!(sessionLinks & (1u << link))) continue;
+        bool identified = state.identity.uuidHash != 0;
+        if (state.configFetch == CONFIG_FETCH_DUE) {
+            VescConfig cached;
+            if (identified && configCacheLookup(state.identity, cached)) {
+                state.config = cached;
+                state.configFetch = CONFIG_FETCH_DONE;
+                logVescConfig(link, cached, "cached");
+                if (link == 0) applyThermalLimits(cached);
+                continue;
+            }
+            state.config = VescConfig();
+            state.configRequestMs = millis();
+            state.configFetch = CONFIG_FETCH_WAITING;
+            sendVESCPacket(link, COMM_GET_MCCONF);
+            sendVESCPacket(link, COMM_GET_APPCONF);
+            LOG_D(PROTO, "Reading the configuration of link %d", link);
+        } else if (state.configFetch == CONFIG_FETCH_RECEIVED) {
+            state.configFetch = CONFIG_FETCH_DONE;
+            if (identified) configCacheStore(state.identity, state.config);
+            logVescConfig(link, state.config, "read");
+            if (link == 0) applyThermalLimits(state.config);
+        } else if (state.configFetch == CONFIG_FETCH_WAITING &&
+                   millis() - state.configRequestMs > VESC_CONFIG_TIMEOUT_MS) {
+            state.configFetch = CONFIG_FETCH_DONE;
+            LOG_W(PROTO, "No usable configuration from link %d", link);
+        }
+    }
+}
+
+// Links that are up: from the connection manager, or the wired VESC
+uint8_t linksUp() {
+    if (WIRED_ENABLED) return wiredUp ? 1 : 0;
+    return connectionManagerLinksUp();
+}
+
+void prepareForConnect(uint8_t link);
+void handleConnectionEvent(const ConnEvent& event);
+
+// A link went silent. A wired VESC is probed again until it answers.
+void reportLinkLost(uint8_t link) {
+    if (!WIRED_ENABLED) {
+        connectionManagerLinkLost(link);
+        return;
+    }
+    if (!wiredUp) return;
+    wiredUp = false;
+    prepareForConnect(0);
+    linkStates[0].replyReceived = false;
+    ConnEvent event = { CONN_RECONNECTING, -1, (uint32_t)millis() };
+    handleConnectionEvent(event);
+}
+
+// Wired builds stand in for the connection manager: COMM_FW_VERSION
+// every VESC_READY_RETRY_MS until the VESC answers, then connected.
+// Runs on the UI task.
+void updateWiredLink() {
+    if (wiredUp) return;
+    if (linkStates[0].replyReceived) {
+        wiredUp = true;
+        LOG_I(APP, "Wired VESC answered");
+        ConnEvent event = { CONN_CONNECTED, -1, 0 };
+        handleConnectionEvent(event);
+        return;
+    }
+    if (millis() - wiredProbeMs >= (uint32_t)VESC_READY_RETRY_MS) {
+        wiredProbeMs = millis();
+        sendVESCPacket(0, COMM_FW_VERSION);
+    }
+}
+
+// Start polling links as they come up; a dropped link's controllers stop
+// being polled until it is back. Runs on the UI task.
+void updateLinkSessions() {
+    uint8_t up = connState == CONN_CONNECTED ? linksUp() : 0;
+    uint8_t started = up & ~sessionLinks;
+    uint8_t stopped = sessionLinks & ~up;
+    for (uint8_t link = 0; link < VESC_MAX_LINKS; link++) {
+        if (started & (1u << link)) startLinkSession(link);
+        if (stopped & (1u << link)) vescTx[link].clear();
+    }
+    if (stopped) LOG_I(APP, "Links up: 0x%x (was 0x%x)", up, sessionLinks);
+    sessionLinks = up;
+}
+
+// Polls through a link that are overdue, summed over its controllers
+uint8_t missedReplies(uint8_t link, uint32_t now) {
+    uint8_t missed = 0;
+    portENTER_CRITICAL(&requestTrackerMux);
+    for (uint8_t i = 0; i < TELEMETRY_MAX_CONTROLLERS; i++) {
+        if (controllerActive(i) && controllerLink(i) == link) missed += requestTrackers[i].overdue(now, LINK_LOST_SILENT_MS);
+    }
+    portEXIT_CRITICAL(&requestTrackerMux);
+    return missed;
+}
+
+// Feed each link's heartbeat what came back, send what it asks for, and
+// reconnect a link that has gone silent: LINK_LOST_MISSED_REPLIES polls
+// unanswered in a row, or nothing at all for HEARTBEAT_DEAD_MS. The
+// supervision timeout catches a peer that is gone altogether; this also
+// catches one whose link stays up but carries nothing. The grace period
+// holds only until the session's first frame. Polls have had their
+// chance to carry COMM_ALIVE by now, so what goes out here goes out on
+// its own.
+void updateHeartbeats() {
+    uint32_t now = millis();
+    bool grace = now - connectionStartTime < CONNECTION_GRACE_PERIOD_MS;
+    for (uint8_t link = 0; link < VESC_MAX_LINKS; link++) {
+        if (!(sessionLinks & (1u << link))) continue;
+        VescHeartbeat& heartbeat = heartbeats[link];
+        uint32_t frames = vescFramers[link].framesReceived();
+        if (frames != heartbeatFrames[link]) {
+            heartbeatFrames[link] = frames;
+            heartbeat.onFrame(now);
+        }
+        // Erasing, the VESC answers nothing for seconds; the upload
+        // judges the link by its own timeouts
+        if (link == 0 && vescUpload.active()) heartbeat.onFrame(now);
+        uint32_t factor = linkQuality[link].level() == LinkQuality::LINK_POOR ? LINK_POOR_STALE_FACTOR : 1;
+        bool missed = heartbeat.silentMs(now) >= LINK_LOST_SILENT_MS * factor &&
+                      missedReplies(link, now) >= LINK_LOST_MISSED_REPLIES;
+        if ((heartbeat.heard() || !grace) && (missed || heartbeat.dead(now, factor))) {
+            LOG_W(APP, "Link %d silent for %u ms%s, reconnecting", link, heartbeat.silentMs(now),
+                  missed ? " with polls unanswered" : "");
+            heartbeat.reset(now);
+            reportLinkLost(link);
+            if (link == 0) {
+                // Stop polling until the manager reports the new state
+                connectionStartTime = now;
+                dataWatchMs = now;
+            }
+            continue;
+        }
+
+        switch (heartbeat.idle(now)) {
+            case VescHeartbeat::HEARTBEAT_ALIVE:
+                sendVESCControl(link, VescCommand(COMM_ALIVE));
+                break;
+            case VescHeartbeat::HEARTBEAT_PROBE:
+                // One write for both
+                vescTx[link].add(VescTxScheduler::TELEMETRY, VescCommand(COMM_ALIVE), now);
+                vescTx[link].add(VescTxScheduler::TELEMETRY, VescCommand(COMM_FW_VERSION), now);
+                vescTx[link].flush();
+                LOG_D(PROTO, "Link %d quiet, probing", link);
+                break;
+            default:
+                break;
+        }
+    }
+}
+
+// Ping each link's CAN bus once per connection. The VESC answers after
+// pinging every id, which takes a while.
+void discoverCanControllers() {
+    for (uint8_t link = 0; link < VESC_MAX_LINKS; link++) {
+        LinkState& state = linkStates[link];
+        if (!(sessionLinks & (1u << link))) continue;
+        if (state.canDiscovery == CAN_DISCOVERY_DUE) {
+            state.canPingSentMs = millis();
+            state.canDiscovery = CAN_DISCOVERY_WAITING;
+            sendVESCPacket(link, COMM_PING_CAN);
+            LOG_D(PROTO, "Pinging the CAN bus of link %d", link);
+        } else if (state.canDiscovery == CAN_DISCOVERY_WAITING && millis() - state.canPingSentMs > CAN_PING_TIMEOUT_MS) {
+            state.canDiscovery = CAN_DISCOVERY_DONE;
+            LOG_W(PROTO, "No reply to COMM_PING_CAN on link %d, polling its VESC only", link);
+        }
+    }
+}
+
+// Pull the samples published since the last frame off the bus, keeping
+// the newest for display and which fields moved in any of them. Runs on
+// the UI task; the decoder publishes from the BLE task.
+void refreshTelemetry() {
+    static BroadcastCursor cursor;
+    static bool subscribed = false;
+    if (!subscribed) {
+        telemetrySubscribe(cursor);
+        subscribed = true;
+    }
+    TelemetrySnapshot snapshot;
+    uint32_t missed = cursor.missed;
+    bool fresh = false;
+    while (telemetryNext(cursor, snapshot)) {
+        shownChanged |= snapshot.changed;
+        fresh = true;
+    }
+    if (!fresh) return;
+
+    // A lapped cursor lost what moved in the samples it skipped
+    if (cursor.missed != missed) shownChanged = VALUES_ALL_FIELDS;
+    // With several controllers, current and power are totals for the
+    // vehicle; the pages switch their labels to say so
+    shownControllers = snapshot.controllers;
+    shownValues = snapshot.values;
+    shownVersion = cursor.next;
+    // The counters are cumulative, so a snapshot skipped here only moves
+    // its energy and distance into the next
+    energyEstimator.update(snapshot.values, snapshot.controllers);
+    bootMarkFirstTelemetry();
+}
+
+// Log fault codes when they change rather than on every sample, and
+// capture the history around a new one
+void checkFaultChange(uint8_t controller) {
+    const VescValues& values = controllerValues[controller];
+    uint8_t& lastFaultCode = lastFaultCodes[controller];
+    if (!(values.fields & VALUES_FIELD_FAULT) || values.faultCode == lastFaultCode) return;
+    
+    faultCaptureTrigger(controller, lastFaultCode, values.faultCode, (uint32_t)(frameArrivalUs / 1000));
+    if (values.faultCode != 0) {
+        LOG_W(PROTO, "VESC %d fault %d", controller, values.faultCode);
+    } else {
+        LOG_I(PROTO, "VESC %d fault %d cleared", controller, lastFaultCode);
+    }
+    lastFaultCode = values.faultCode;
+}
+
+void addLapSample(const VescValues& combined, uint32_t sampleMs) {
+    portENTER_CRITICAL(&lapMux);
+    bool crossed = lapTimer.add(combined, sampleMs, telemetryHistory().total());
+    LapRecord lap = crossed ? lapTimer.completed(0) : LapRecord();
+    portEXIT_CRITICAL(&lapMux);
+    if (crossed) LOG_I(APP, "Lap %u over the line: %u ms", (unsigned)lap.number, (unsigned)lap.durationMs);
+}
+
+// A decoded sample: publish it, and log the combined sample once per
+// poll of controller 0
+void publishValues(uint8_t controller) {
+    valuesCaches[controller].note(controllerValues[controller].fields, millis());
+    uint64_t combinedUs;
+    const VescValues* combined = telemetryPublish(controller, controllerValues[controller], frameArrivalUs,
+                                                  combinedUs);
+    traceEvent(TRACE_DECODED, controllerLink(controller), controller);
+    perfNoteSample(replySentUs, (uint32_t)frameArrivalUs, (uint32_t)esp_timer_get_time());
+    // One combined sample per poll of controller 0, once the others' replies are in
+    if (combined) {
+        uint32_t sampleMs = (uint32_t)(combinedUs / 1000);
+        // A ride played back is not logged or counted a second time
+        if (!playbackRunning) {
+            if (SD_LOGGING_ENABLED) telemetryLogAppend(*combined, sampleMs);
+            rideStatsAdd(*combined);
+            odometerAdd(*combined);
+        }
+        serialStreamAppend(*combined, sampleMs);
+        if (LAPS_ENABLED) addLapSample(*combined, sampleMs);
+    }
+    alertsEvaluate(controller, telemetrySmoothed(controller), telemetrySmoothedCombined());
+    appEventsSet(APP_EVENT_TELEMETRY);
+    checkFaultChange(controller);
+}
+
+// Debug dump of a decoded sample: every field it carried, formatted from
+// the raw fixed-point values as the field table describes them
+void logValues(const VescValues& values) {
+    char line[120];
+    int length = 0;
+    for (uint8_t bit = 0; bit < VALUES_FIELD_COUNT; bit++) {
+        if (!(values.fields & (1u << bit))) continue;
+        const ValuesFieldInfo& info = VALUES_FIELD_INFO[bit];
+        for (uint8_t i = 0; i < info.count; i++) {
+            char number[16];
+            formatFixed(number, sizeof(number), valuesField(values, bit, i), info.decimals);
+            char item[48];
+            int n = info.count > 1
+                ? snprintf(item, sizeof(item), "%s%d=%s%s", info.name, i + 1, number, info.unit)
+                : snprintf(item, sizeof(item), "%s=%s%s", info.name, number, info.unit);
+            if (length > 0 && length + 2 + n >= (int)sizeof(line)) {
+                LOG_D(PROTO, "%s", line);
+                length = 0;
+            }
+            length += snprintf(line + length, sizeof(line) - length, "%s%s", length > 0 ? "  " : "", item);
+        }
+    }
+    if (length > 0) LOG_D(PROTO, "%s", line);
+}
+
+// Reply handlers, on the parser task; payload[0] is the command byte the
+// VESC is replying to
+void onValuesReply(uint8_t link, const uint8_t* payload, size_t length) {
+    LinkState& state = linkStates[link];
+    if (fleetVisiting) {
+        if (!fleetAnswered && decodeValues(payload, length, *state.layout, fleetValues)) fleetAnswered = true;
+        return;
+    }
+    uint8_t controller = controllerForReply(link, payload, length);
+    trackReply(controller, payload[0]);
+    
+    // Decode straight out of the framer buffer
+    VescValues& values = controllerValues[controller];
+    if (!decodeValues(payload, length, *state.layout, values)) {
+        LOG_W(PROTO, "COMM_GET_VALUES reply too short for firmware %d.%02d (len=%d)", state.firmware.major,
+              state.firmware.minor, length);
+        return;
+    }
+    
+    publishValues(controller);
+    if (LOG_ENABLED(PROTO, LOG_LEVEL_DEBUG)) logValues(values);
+}
+
+void onSelectiveValuesReply(uint8_t link, const uint8_t* payload, size_t length) {
+    uint8_t controller = controllerForReply(link, payload, length);
+    trackReply(controller, payload[0]);
+    
+    VescValues& values = controllerValues[controller];
+    if (!decodeSelectiveReply(payload, length, values)) {
+        LOG_W(PROTO, "Malformed COMM_GET_VALUES_SELECTIVE reply (len=%d)", length);
+        return;
+    }
+    
+    if (controller == link) linkStates[link].selectiveUnanswered = 0;
+    publishValues(controller);
+    LOG_D(PROTO, "Selective values 0x%08X from controller %d", values.fields, controller);
+    if (LOG_ENABLED(PROTO, LOG_LEVEL_DEBUG)) logValues(values);
+}
+
+void onPingCanReply(uint8_t link, const uint8_t* payload, size_t length) {
+    uint8_t ids[TELEMETRY_MAX_CONTROLLERS - 1];
+    int found = decodePingCan(payload, length, ids, sizeof(ids));
+    if (found >= 0 && linkStates[link].canDiscovery == CAN_DISCOVERY_WAITING) startPollingCan(link, ids, found);
+}
+
+// COMM_GET_MCCONF and COMM_GET_APPCONF. Up to a kilobyte in a long frame;
+// only the leading limits are read.
+void onConfigReply(uint8_t link, const uint8_t* payload, size_t length) {
+    LinkState& state = linkStates[link];
+    if (state.configFetch != CONFIG_FETCH_WAITING) return;
+    bool decoded = payload[0] == COMM_GET_MCCONF ? decodeMcconf(payload, length, state.firmware, state.config)
+                                                 : decodeAppconf(payload, length, state.config);
+    if (!decoded) {
+        LOG_W(PROTO, "Configuration reply 0x%02X from link %d not understood (firmware %d.%02d, len=%d)",
+              payload[0], link, state.firmware.major, state.firmware.minor, length);
+    } else if (state.config.parts == VESC_CONFIG_ALL) {
+        state.configFetch = CONFIG_FETCH_RECEIVED;
+    }
+}
+
+void onFwVersionReply(uint8_t link, const uint8_t* payload, size_t length) {
+    LinkState& state = linkStates[link];
+    decodeFwIdentity(payload, length, state.identity);
+    VescFirmware previous = state.firmware;
+    if (decodeFwVersion(payload, length, state.firmware)) {
+        // Every values reply from now on is read with this table
+        state.layout = &valuesLayoutForFirmware(state.firmware);
+        // Heartbeat probes ask again; only news is logged
+        if (state.firmware.major != previous.major || state.firmware.minor != previous.minor) {
+            LOG_I(PROTO, "VESC firmware %d.%02d on link %d", state.firmware.major, state.firmware.minor, link);
+        }
+    }
+}
+
+// One frame per sample of a scope capture, a few hundred in a burst
+void onSamplePrintReply(uint8_t link, const uint8_t* payload, size_t length) {
+    VescSample sample;
+    if (decodeSample(payload, length, sample)) {
+        scopeAdd(sample, millis());
+    } else {
+        LOG_W(PROTO, "Malformed COMM_SAMPLE_PRINT reply (len=%d)", length);
+    }
+}
+
+// The BMS reading the controller keeps; no cells means no BMS heard
+void onBmsReply(uint8_t link, const uint8_t* payload, size_t length) {
+    VescBmsValues bms;
+    if (!decodeBmsValues(payload, length, bms)) {
+        LOG_W(PROTO, "Malformed COMM_BMS_GET_VALUES reply (len=%d)", length);
+        return;
+    }
+    if (link != 0 || bms.cellCount == 0) return;
+    if (!bmsHeard) {
+        LOG_I(PROTO, "BMS with %u cells (CAN id %u)", bms.cellCount, bms.canId);
+        bmsHeard = true;
+    }
+    bmsUnanswered = 0;
+    telemetryPublishBms(bms, millis());
+}
+
+// Terminal output, one print of the firmware per frame
+void onPrintReply(uint8_t link, const uint8_t* payload, size_t length) {
+    consoleAppend((const char*)payload + 1, length - 1);
+}
+
+// Acks of a firmware push, handed to the UI loop
+void onUploadReply(uint8_t link, const uint8_t* payload, size_t length) {
+    if (link != 0) return;
+    UploadReply reply;
+    reply.length = length < sizeof(reply.payload) ? length : sizeof(reply.payload);
+    memcpy(reply.payload, payload, reply.length);
+    if (!uploadReplies.push((const uint8_t*)&reply, sizeof(reply))) {
+        LOG_W(PROTO, "Upload ack queue full, dropping an ack");
+    }
+}
+
+void onAliveReply(uint8_t link, const uint8_t* payload, size_t length) {
+    LOG_D(PROTO, "Received COMM_ALIVE response");
+}
+
+// Register the reply handlers; call before any link is up
+void setupReplyHandlers() {
+    replyDispatcher.on(COMM_GET_VALUES, onValuesReply);
+    replyDispatcher.on(COMM_GET_VALUES_SELECTIVE, onSelectiveValuesReply);
+    replyDispatcher.on(COMM_PING_CAN, onPingCanReply);
+    replyDispatcher.on(COMM_GET_MCCONF, onConfigReply);
+    replyDispatcher.on(COMM_GET_APPCONF, onConfigReply);
+    replyDispatcher.on(COMM_FW_VERSION, onFwVersionReply);
+    replyDispatcher.on(COMM_SAMPLE_PRINT, onSamplePrintReply);
+    replyDispatcher.on(COMM_BMS_GET_VALUES, onBmsReply);
+    replyDispatcher.on(COMM_PRINT, onPrintReply);
+    replyDispatcher.on(COMM_ERASE_NEW_APP, onUploadReply);
+    replyDispatcher.on(COMM_WRITE_NEW_APP_DATA, onUploadReply);
+    replyDispatcher.on(COMM_ALIVE, onAliveReply);
+}
+
+// Parse a framed VESC payload from a link and update telemetry
+void parseVESCResponse(const uint8_t* payload, size_t length, void* context) {
+    PROBE_SCOPE("decode");
+    LOG_HEX(PROTO, LOG_LEVEL_VERBOSE, "Raw payload: ", payload, length, 64);
+    uint8_t link = (uint8_t)(uintptr_t)context;
+    linkStates[link].replyReceived = true;
+    frameArrivalUs = vescFramers[link].frameTimeUs();
+    traceEvent(TRACE_FRAME, link, payload[0]);
+    if (payload[0] == COMM_GET_VALUES && throughputProbes[link].active()) {
+        portENTER_CRITICAL(&throughputMux);
+        throughputProbes[link].onFrame(length + vescPacketOverhead(length), (uint32_t)frameArrivalUs);
+        portEXIT_CRITICAL(&throughputMux);
+    }
+    
+    if (!replyDispatcher.dispatch(link, payload, length)) {
+        LOG_D(PROTO, "Unhandled packet (cmd=0x%02X, payload len=%d, %u so far)", payload[0], length,
+              replyDispatcher.unhandledCount());
+    }
+}
+
+// A status broadcast from the wired CAN bus, on the parser task. The
+// frames of a round are gathered into the controller's sample, which is
+// published as the next round's CAN_PACKET_STATUS comes in; a controller
+// not heard of before gets a CAN slot. Its fields are then left out of
+// polls (see requestTelemetry()).
+void onCanStatus(const RxCanFrame& frame) {
+    if (!(sessionLinks & 1u)) return;
+    uint8_t canId = canStatusSender(frame.id);
+    int controller = canId == WIRED_CAN_VESC_ID ? 0 : canSlotFor(0, canId);
+    if (controller < 0) {
+        controller = assignCanSlot(0, canId);
+        if (controller < 0) return;
+        LOG_I(PROTO, "Controller %d at CAN id %d broadcasts its status", controller, canId);
+    }
+    
+    VescValues& values = controllerValues[controller];
+    uint8_t type = (uint8_t)(frame.id >> 8);
+    if (type == CAN_PACKET_STATUS && (values.fields & ~VALUES_FIELD_CONTROLLER_ID) != 0) {
+        frameArrivalUs = frame.timeUs;
+        replySentUs = 0;
+        publishValues(controller);
+        values.fields = 0;
+    }
+    uint32_t fields = decodeCanStatus(frame.id, frame.data, frame.length, values);
+    if (fields == 0) return;
+    canStatusHeard[controller] |= fields;
+    canStatusHeardMs[controller] = millis();
+}
+
+// A sample played back from a log, on the parser task. It stands in for
+// controller 0's reply; the GPS fix and IMU attitude are merged in anew.
+void onPlaybackSample(const LogSample& sample) {
+    if (!playbackRunning) return;
+    logValuesFromSample(sample, controllerValues[0]);
+    frameArrivalUs = esp_timer_get_time();
+    replySentUs = 0;
+    publishValues(0);
+}
+
+// Bytes from a VESC, on the parser task (see ble/rx_queue.h)
+void vescBytesReceived(uint8_t link, const uint8_t* pData, size_t length, uint64_t timeUs) {
+    PROBE_SCOPE("rx");
+    LOG_V(PROTO, "BLE notification on link %d: %d bytes", link, length);
+    traceEvent(TRACE_PARSE, link, (uint16_t)length);
+    
+    VescFramer& framer = vescFramers[link];
+    if (linkStates[link].resetRequested) {
+        linkStates[link].resetRequested = false;
+        framer.reset();
+        releaseCanSlots(link);
+        controllerValues[link] = VescValues();
+        lastFaultCodes[link] = 0;
+        canStatusHeard[link] = 0;
+        valuesCaches[link].clear();
+        telemetryForgetController(link);
+    }
+    
+    static uint32_t lastDropped = 0;
+    if (rxQueueDropped() != lastDropped) {
+        lastDropped = rxQueueDropped();
+        LOG_W(PROTO, "Receive queue overflow (%u bytes dropped so far)", lastDropped);
+    }
+    
+    // VESC Tool on the USB bridge gets everything the primary VESC sends
+    if (link == 0) usbBridgeToHost(pData, length);
+    
+    // The framer buffers partial packets and calls parseVESCResponse
+    // once for each complete one with a valid CRC
+    uint32_t crcErrorsBefore = framer.crcErrorCount();
+    framer.feed(pData, length, timeUs);
+    if (framer.crcErrorCount() != crcErrorsBefore) {
+        LOG_W(PROTO, "Dropped corrupted packet on link %d (CRC errors: %u, frames: %u)",
+                     link, framer.crcErrorCount(), framer.framesReceived());
+    }
+}
+
+// BLE notification data, from either the characteristic callback or the
+// cached-handle path. Runs on the BLE host's task, so only queue it; the
+// link index picks the queue directly. Captures record the primary link.
+IRAM_ATTR void onVescNotify(uint8_t link, const uint8_t* pData, size_t length) {
+    PROBE_SCOPE("notify");
+    uint64_t timeUs = esp_timer_get_time();
+    traceEvent(TRACE_NOTIFY, link, (uint16_t)length);
+    if (link == 0) captureChunk(pData, length);
+    rxQueuePush(link, pData, length, timeUs);
+}
+
+// Called from the BLE stack when a link drops
+void onVescDisconnected(uint8_t link) {
+    connectionManagerLinkLost(link);
+}
+
+// Send COMM_FW_VERSION until the VESC answers or the timeout passes.
+// Returns as soon as any valid frame arrives.
+bool waitForVescReady(uint8_t link) {
+    unsigned long start = millis();
+    unsigned long lastSend = 0;
+    LinkState& state = linkStates[link];
+    state.replyReceived = false;
+    
+    LOG_D(BLE, "Waiting for VESC on link %d to answer COMM_FW_VERSION...", link);
+    while (millis() - start < VESC_READY_TIMEOUT_MS) {
+        if (lastSend == 0 || millis() - lastSend >= VESC_READY_RETRY_MS) {
+            sendVESCPacket(link, COMM_FW_VERSION);
+            lastSend = millis();
+        }
+        if (state.replyReceived) {
+            LOG_I(BLE, "VESC on link %d ready after %lu ms", link, millis() - start);
+            return true;
+        }
+        if (!vescLinks[link]->isConnected()) return false;
+        delay(5);
+    }
+    return state.replyReceived;
+}
+
+// Fleet mode, on the connection task: one COMM_GET_VALUES from the VESC
+// just connected, into the fleet table. The ready check has read its
+// firmware, so the reply decodes with the right layout.
+void fleetVisit(uint8_t link, const BLEDeviceInfo& device, bool connected, uint32_t connectMs) {
+    unsigned long start = millis();
+    fleetAnswered = false;
+    fleetVisiting = true;
+    if (connected) {
+        sendVESCPacket(link, COMM_GET_VALUES);
+        while (!fleetAnswered && millis() - start < FLEET_REPLY_TIMEOUT_MS && vescLinks[link]->isConnected()) {
+            delay(5);
+        }
+    }
+    bool answered = fleetAnswered;
+    uint32_t visitMs = connectMs + (millis() - start);
+    fleetRecord(device.name, device.address, device.rssi, answered ? &fleetValues : nullptr, visitMs,
+                connected && vescLinks[link]->usedCachedHandles(), millis());
+    fleetVisiting = false;
+    if (answered) {
+        LOG_I(APP, "Fleet: %s %d.%dV fault %d, %u ms", device.name, fleetValues.vIn / 10, fleetValues.vIn % 10,
+              fleetValues.faultCode, visitMs);
+    } else {
+        LOG_W(APP, "Fleet: no snapshot from %s (%s)", device.name, connected ? "no reply" : "no connection");
+    }
+}
+
+// A status beacon, on the BLE stack's task: into the fleet table with no
+// connection at all
+void onBeacon(const char* name, const char* address, int rssi, const AdvBeacon& beacon) {
+    VescValues values = {};
+    values.vIn = beacon.vIn;
+    values.tempFet = beacon.tempFet;
+    values.tempMotor = beacon.tempMotor;
+    values.faultCode = beacon.faultCode;
+    fleetRecordBeacon(name, address, rssi, values, beacon.sequence, millis());
+}
+
+// Runs on the connection task before each connect attempt of a link
+void prepareForConnect(uint8_t link) {
+    // Drop any partial packet left over from a previous connection and the
+    // controllers found through it. Both belong to the parser task, so ask
+    // it to reset. The CAN bus is discovered again after connecting.
+    linkStates[link].resetRequested = true;
+    linkStates[link].firmware = VescFirmware();
+    linkStates[link].layout = &valuesLayoutForFirmware(VescFirmware());
+    linkStates[link].canDiscovery = CAN_DISCOVERY_OFF;
+    linkStates[link].identity = VescIdentity();
+    linkStates[link].configFetch = CONFIG_FETCH_OFF;
+}
+
+// Device list: the devices by rank in a virtualized list that
+// only paints the rows whose device, RSSI, selection or mark changed
+const int16_t DEVICE_ROW_HEIGHT = 26;
+const uint8_t DEVICE_ROWS = 6;
+void paintDeviceRow(DisplayGfx* display, uint32_t position, int16_t x, int16_t y, int16_t w, int16_t h, void* context);
+uint32_t deviceRowKey(uint32_t position, void* context);
+ListView deviceList(&lcd, 10, 40, 304, DEVICE_ROWS, DEVICE_ROW_HEIGHT, paintDeviceRow, deviceRowKey);
+
+// Re-sort after the devices were copied; insertion sort, as the order
+// mostly holds from one refresh to the next
+void sortDevices() {
+    int count = discoveredDevices.size();
+    for (int i = 0; i < count; i++) deviceOrder[i] = i;
+    for (int i = 1; i < count; i++) {
+        uint16_t device = deviceOrder[i];
+        int j = i;
+        while (j > 0 && discoveredDevices.scores[deviceOrder[j - 1]] < discoveredDevices.scores[device]) {
+            deviceOrder[j] = deviceOrder[j - 1];
+            j--;
+        }
+        deviceOrder[j] = device;
+    }
+    deviceList.setCount(count);
+}
+
+// Where a device is listed, or 0 if it is not
+uint32_t devicePosition(int device) {
+    for (int i = 0; i < discoveredDevices.size(); i++) {
+        if (deviceOrder[i] == device) return i;
+    }
+    return 0;
+}
+
+uint32_t deviceRowKey(uint32_t position, void* context) {
+    int device = deviceOrder[position];
+    bool marked = device < 32 && (markedDevices & (1u << device));
+    return (uint32_t)device | (uint32_t)(uint8_t)discoveredDevices[device].rssi << 16 |
+           (device == selectedDeviceIndex ? 1u << 24 : 0) | (marked ? 1u << 25 : 0);
+}
+
+// Highlight the selected device; "+" marks one picked for a link
+void paintDeviceRow(DisplayGfx* display, uint32_t position, int16_t x, int16_t y, int16_t w, int16_t h, void* context) {
+    int device = deviceOrder[position];
+    const BLEDeviceInfo& info = discoveredDevices[device];
+    bool selected = device == selectedDeviceIndex;
+    char mark = device < 32 && (markedDevices & (1u << device)) ? '+' : ' ';
+    display->fillRect(x, y, w, h, BLACK);
+    display->setTextSize(1);
+    display->setCursor(x, y + 2);
+    uint16_t color = selected ? BLACK : WHITE, background = selected ? WHITE : BLACK;
+    display->setTextColor(color, background);
+    display->printf("%c%c%d. ", selected ? '>' : ' ', mark, (int)position + 1);
+    if (utf8HasNonAscii(info.name)) {
+        unicodeTextDraw(display, info.name, display->getCursorX(), y + 2, 1, color, background);
+    } else {
+        display->print(info.name);
+    }
+    display->setTextColor(WHITE, BLACK);
+    display->setCursor(x + 10, y + 14);
+    display->printf("   %s (RSSI: %d)", info.address, info.rssi);
+}
+
+// Draw the device list. The rows repaint themselves as they change;
+// allItems clears the screen's text and repaints everything.
+void displayDeviceList(bool allItems = false) {
+    lcd.setTextSize(2);
+    lcd.setTextColor(WHITE, BLACK);
+    lcd.setCursor(10, 10);
+    
+    if (discoveredDevices.empty() && connectionManagerScanning()) {
+        lcd.println("Scanning for devices...");
+        lcd.setCursor(10, 40);
+        lcd.println("VESCs appear as found");
+    } else if (discoveredDevices.empty()) {
+        lcd.println("No VESC devices found");
+        lcd.setCursor(10, 40);
+        lcd.println("Press A to rescan");
+    } else {
+        if (allItems) {
+            lcd.printf("Found %d VESC devices:\n", discoveredDevices.size());
+            deviceList.invalidate();
+        }
+        deviceList.render();
+        if (!allItems) return;
+        
+        lcd.setTextSize(1);
+        lcd.fillRect(10, 200, 300, 10, BLACK);
+        lcd.setCursor(10, 200);
+        lcd.println(BLE_MAX_LINKS > 1 ? "A:Rescan B:Down C:Connect (hold C: add)" : "A:Rescan B:Up/Down C:Connect");
+        lcd.setCursor(10, 212);
+        lcd.print(FLEET_MODE_ENABLED ? "Hold A: fleet B: settings  Drag/tap to connect"
+                                        : "Hold A: review B: settings  Drag/tap to connect");
+    }
+}
+
+// Touch on the list: drags and flings scroll it, a tap connects the
+// device tapped
+void updateDeviceList() {
+    int16_t x = 0, y = 0;
+    bool down = inputTouchPoint(x, y);
+    deviceList.touch(down, x, y, millis());
+    int32_t tapped = deviceList.takeTap();
+    if (tapped < 0 || tapped >= discoveredDevices.size()) return;
+    selectedDeviceIndex = deviceOrder[tapped];
+    LOG_D(APP, "Device %d tapped", selectedDeviceIndex + 1);
+    deviceList.render();
+    connectionManagerConnect(selectedDeviceIndex);
+}
+
+// Render hook of the device list: new devices and selection changes are
+// drawn as they happen, so only a cleared screen needs drawing here
+void renderDeviceList(bool full) {
+    if (full) {
+        displayDeviceList(true);
+    } else if (!discoveredDevices.empty()) {
+        deviceList.render();
+    }
+}
+
+TextStrip reconnectLine(&lcd);  // The countdown, one push per change
+
+void displayReconnecting(bool full) {
+    static char shownStatus[48] = "";
+    // Show reconnecting message
+    if (full) {
+        lcd.setTextSize(3);
+        lcd.setTextColor(YELLOW, BLACK);
+        const char* msg = "Reconnecting...";
+        lcd.setCursor((320 - lcd.textWidth(msg)) / 2, 100);
+        lcd.print(msg);
+        
+        // Button labels
+        lcd.setTextSize(1);
+        lcd.setTextColor(WHITE, BLACK);
+        lcd.setCursor(10, 220);
+        lcd.println("A:Cancel  B:Retry Now");
+    }
+    
+    // Show countdown to next attempt
+    long untilNext = (long)(nextReconnectAttempt - millis());
+    int secondsUntilNext = untilNext > 0 ? untilNext / 1000 : 0;
+    
+    char status[48];
+    snprintf(status, sizeof(status), "Next attempt in %ds, or when heard", secondsUntilNext);
+    if (!full && strcmp(status, shownStatus) == 0) return;
+    strcpy(shownStatus, status);
+    reconnectLine.begin(320, 20);
+    lcd.setTextSize(1);
+    reconnectLine.draw(0, 140, status, (320 - lcd.textWidth(status)) / 2, 0, 1, WHITE, BLACK);
+}
+
+// Fleet table: one row per VESC visited, redrawn when a visit lands and
+// once a second for the ages. Red for a fault, grey while the last good
+// snapshot is older than the last visit. The last column is how long the
+// last visit took, connect to reply, or "adv" for one read from beacons.
+const int16_t FLEET_ROW_HEIGHT = 11;
+const int16_t FLEET_TABLE_Y = 44;
+uint32_t shownFleetVersion = 0;
+uint32_t shownFleetSecond = 0;
+TextStrip fleetRow(&lcd);
+
+void displayFleetRow(int16_t y, const FleetEntry& entry, uint32_t now) {
+    char age[8] = "--";
+    if (entry.sampled) {
+        uint32_t seconds = (now - entry.sampledMs) / 1000;
+        if (seconds < 100) {
+            snprintf(age, sizeof(age), "%us", seconds);
+        } else {
+            snprintf(age, sizeof(age), "%um", seconds / 60);
+        }
+    }
+    char fault[8] = "ok";
+    if (entry.faultCode != 0) snprintf(fault, sizeof(fault), "F%u", entry.faultCode);
+    char visit[8] = "adv";
+    if (!entry.passive) snprintf(visit, sizeof(visit), "%u", entry.visitMs);
+    char line[64];
+    if (entry.sampled) {
+        snprintf(line, sizeof(line), "%-16.16s %3d.%dV %4d %4d %-5s %4s %4s", entry.name, entry.vIn / 10,
+                 abs(entry.vIn % 10), entry.tempFet / 10, entry.tempMotor / 10, fault, age, visit);
+    } else {
+        snprintf(line, sizeof(line), "%-16.16s %6s %4s %4s %-5s %4s %4s", entry.name, "-", "-", "-", "-", age, visit);
+    }
+    bool stale = !entry.sampled || entry.lastFailed;
+    uint16_t color = entry.sampled && entry.faultCode != 0 ? RED : (stale ? DARKGREY : WHITE);
+    fleetRow.begin(300, FLEET_ROW_HEIGHT);
+    fleetRow.draw(10, y, line, 0, 0, 1, color, BLACK);
+}
+
+void renderFleet(bool full) {
+    uint32_t now = millis();
+    if (full) {
+        lcd.setTextSize(2);
+        lcd.setTextColor(WHITE, BLACK);
+        lcd.setCursor(10, 10);
+        lcd.print("Fleet");
+        lcd.setTextSize(1);
+        lcd.setTextColor(DARKGREY, BLACK);
+        lcd.setCursor(10, 32);
+        char header[64];
+        snprintf(header, sizeof(header), "%-16s %6s %4s %4s %-5s %4s %4s", "Vehicle", "Volts", "FET", "Mot", "Fault",
+                 "Age", "ms");
+        lcd.print(header);
+        lcd.setTextColor(WHITE, BLACK);
+        lcd.setCursor(10, 225);
+        lcd.print("A:Stop  Visits every VESC heard in turn");
+    } else if (fleetVersion() == shownFleetVersion && now / 1000 == shownFleetSecond) {
+        return;
+    }
+    shownFleetVersion = fleetVersion();
+    shownFleetSecond = now / 1000;
+
+    static FleetEntry entries[FLEET_MAX_ENTRIES];
+    int count = fleetCopy(entries, FLEET_MAX_ENTRIES);
+    lcd.setTextSize(1);
+    if (count == 0) {
+        lcd.setTextColor(WHITE, BLACK);
+        lcd.setCursor(10, FLEET_TABLE_Y);
+        lcd.print(connectionManagerScanning() ? "Listening for VESCs..." : "No VESC heard yet");
+        return;
+    }
+    for (int i = 0; i < count; i++) displayFleetRow(FLEET_TABLE_Y + i * FLEET_ROW_HEIGHT, entries[i], now);
+
+    lcd.setTextColor(WHITE, BLACK);
+    lcd.setCursor(90, 10);
+    lcd.setTextSize(2);
+    lcd.printf("%d VESCs ", count);
+}
+
+// Controllers page: a column per controller reporting, then the totals
+// of the combined sample, a row per quantity. Cells repaint only when
+// their text changes, and the numbers at most every
+// CONTROLLERS_PAGE_REFRESH_MS, so a full bus costs no more per frame than
+// a gauge. Controllers beyond the columns still count in the totals.
+// A column goes grey when its controller stops reporting.
+enum ControllersRow : uint8_t {
+    CONTROLLERS_ROW_NAME, CONTROLLERS_ROW_VOLTS, CONTROLLERS_ROW_MOTOR_A, CONTROLLERS_ROW_BATTERY_A,
+    CONTROLLERS_ROW_WATTS, CONTROLLERS_ROW_DUTY, CONTROLLERS_ROW_ERPM, CONTROLLERS_ROW_TEMP_FET,
+    CONTROLLERS_ROW_TEMP_MOTOR, CONTROLLERS_ROW_WATT_HOURS, CONTROLLERS_ROW_FAULT, CONTROLLERS_ROW_AGE,
+    CONTROLLERS_ROWS
+};
+const char* const CONTROLLERS_ROW_LABELS[CONTROLLERS_ROWS] = {
+    "", "Volts", "Motor A", "Batt A", "Watts", "Duty %", "ERPM", "FET", "Motor", "Wh", "Fault", "Age"
+};
+const uint8_t CONTROLLERS_COLUMNS = 8;  // Plus the totals
+const int16_t CONTROLLERS_GRID_X = 44;
+const int16_t CONTROLLERS_GRID_Y = 34;
+const int16_t CONTROLLERS_CELL_WIDTH = 30;
+const int16_t CONTROLLERS_CELL_HEIGHT = 15;
+const uint32_t CONTROLLERS_STALE_MS = 1000;  // A column older than this is grey
+static_assert(CONTROLLERS_COLUMNS + 1 <= CellGrid::MAX_COLUMNS && CONTROLLERS_ROWS <= CellGrid::MAX_ROWS,
+              "the controllers page fits its grid");
+CellGrid controllersGrid(&lcd);
+uint32_t controllersRefreshMs = 0;
+
+// A fixed-point value (scale units to 1) to one decimal. The sign is
+// written apart from the magnitude, so -0.4 keeps its minus.
+void formatFixedTenths(char* out, size_t size, int32_t value, int32_t scale) {
+    int32_t tenths = (int32_t)((int64_t)value * 10 / scale);
+    uint32_t magnitude = tenths < 0 ? -tenths : tenths;
+    snprintf(out, size, "%s%u.%u", tenths < 0 ? "-" : "", magnitude / 10, magnitude % 10);
+}
+
+// A fixed-point value (scale units to 1) in five characters at most: one
+// decimal while it fits, then whole, then thousands
+void formatCell(char* out, size_t size, int32_t value, int32_t scale) {
+    int32_t tenths = (int32_t)((int64_t)value * 10 / scale);
+    if (tenths > -1000 && tenths < 10000) {
+        formatFixedTenths(out, size, value, scale);
+        return;
+    }
+    int32_t whole = value / scale;
+    if (whole > -10000 && whole < 100000) {
+        snprintf(out, size, "%d", whole);
+    } else {
+        snprintf(out, size, "%dk", whole / 1000);
+    }
+}
+
+// One column: a controller's last sample, or the combined one (no
+// cache). A number its cache holds from longer ago than two of its poll
+// periods, and than a column takes to go stale, is grey on its own.
+void setControllersColumn(uint8_t column, const char* name, const TelemetrySnapshot& snapshot,
+                          const ValuesCache* cache, uint32_t now) {
+    bool total = cache == nullptr;
+    const VescValues& v = snapshot.values;
+    uint32_t ageMs = now - snapshot.updatedMs;
+    uint16_t color = ageMs > CONTROLLERS_STALE_MS ? DARKGREY : (total ? CYAN : WHITE);
+    char cell[CellGrid::MAX_CHARS + 1];
+    controllersGrid.set(column, CONTROLLERS_ROW_NAME, name, total ? CYAN : LIGHTGREY);
+
+    struct Quantity {
+        uint8_t row;
+        uint32_t field;
+        int32_t value;
+        int32_t scale;
+    };
+    int32_t watts = (int32_t)((int64_t)v.vIn * v.currentIn / 1000);
+    const Quantity quantities[] = {
+        { CONTROLLERS_ROW_VOLTS, VALUES_FIELD_V_IN, v.vIn, 10 },
+        { CONTROLLERS_ROW_MOTOR_A, VALUES_FIELD_CURRENT_MOTOR, v.currentMotor, 100 },
+        { CONTROLLERS_ROW_BATTERY_A, VALUES_FIELD_CURRENT_IN, v.currentIn, 100 },
+        { CONTROLLERS_ROW_WATTS, VALUES_FIELD_V_IN | VALUES_FIELD_CURRENT_IN, watts, 1 },
+        // Duty and ERPM are per motor; the combined sample has the primary's
+        { CONTROLLERS_ROW_DUTY, total ? 0u : VALUES_FIELD_DUTY, v.dutyNow, 10 },
+        { CONTROLLERS_ROW_ERPM, total ? 0u : VALUES_FIELD_RPM, v.rpm, 1 },
+        { CONTROLLERS_ROW_TEMP_FET, VALUES_FIELD_TEMP_FET, unitsConvert(UNIT_TEMPERATURE, v.tempFet), 10 },
+        { CONTROLLERS_ROW_TEMP_MOTOR, VALUES_FIELD_TEMP_MOTOR, unitsConvert(UNIT_TEMPERATURE, v.tempMotor), 10 },
+        { CONTROLLERS_ROW_WATT_HOURS, VALUES_FIELD_WATT_HOURS, v.wattHours, 10000 },
+    };
+    for (const Quantity& q : quantities) {
+        if (q.field != 0 && (v.fields & q.field) == q.field) {
+            formatCell(cell, sizeof(cell), q.value, q.scale);
+        } else {
+            strcpy(cell, "-");
+        }
+        uint16_t quantityColor = color;
+        for (uint32_t rest = cache ? q.field : 0; rest != 0; rest &= rest - 1) {
+            uint8_t bit = __builtin_ctz(rest);
+            uint32_t age = cache->ageMs(bit, now);
+            uint32_t late = valuesCacheTtl[bit] * 200 / RESPONSE_CACHE_TTL_PERCENT;
+            if (age != UINT32_MAX && age > CONTROLLERS_STALE_MS && age > late) quantityColor = DARKGREY;
+        }
+        controllersGrid.set(column, q.row, cell, quantityColor);
+    }
+
+    if (v.fields & VALUES_FIELD_FAULT) {
+        if (v.faultCode != 0) snprintf(cell, sizeof(cell), "F%u", v.faultCode);
+        controllersGrid.set(column, CONTROLLERS_ROW_FAULT, v.faultCode != 0 ? cell : "ok",
+                            v.faultCode != 0 ? RED : color);
+    } else {
+        controllersGrid.set(column, CONTROLLERS_ROW_FAULT, "-", color);
+    }
+    if (ageMs < 1000) {
+        snprintf(cell, sizeof(cell), "%ums", ageMs);
+    } else {
+        snprintf(cell, sizeof(cell), "%us", ageMs / 1000 < 99999 ? ageMs / 1000 : 99999);
+    }
+    controllersGrid.set(column, CONTROLLERS_ROW_AGE, cell, color);
+}
+
+void clearControllersColumn(uint8_t column) {
+    for (uint8_t row = 0; row < CONTROLLERS_ROWS; row++) controllersGrid.set(column, row, "", BLACK);
+}
+
+void enterControllers() {
+    controllersGrid.setGeometry(CONTROLLERS_GRID_X, CONTROLLERS_GRID_Y, CONTROLLERS_CELL_WIDTH,
+                                CONTROLLERS_CELL_HEIGHT, CONTROLLERS_COLUMNS + 1, CONTROLLERS_ROWS);
+    controllersRefreshMs = 0;
+}
+
+void renderControllers(bool full) {
+    uint32_t now = millis();
+    if (full) {
+        lcd.setTextSize(2);
+        lcd.setTextColor(WHITE, BLACK);
+        lcd.setCursor(10, 10);
+        lcd.print("Controllers");
+        lcd.setTextSize(1);
+        lcd.setTextColor(DARKGREY, BLACK);
+        for (uint8_t row = 1; row < CONTROLLERS_ROWS; row++) {
+            lcd.setCursor(2, controllersGrid.cellY(row) + (CONTROLLERS_CELL_HEIGHT - 8) / 2);
+            lcd.print(CONTROLLERS_ROW_LABELS[row]);
+            if (row == CONTROLLERS_ROW_TEMP_FET || row == CONTROLLERS_ROW_TEMP_MOTOR) {
+                lcd.print(" ");
+                lcd.print(unitsName(UNIT_TEMPERATURE));
+            }
+        }
+        lcd.setTextColor(WHITE, BLACK);
+        lcd.setCursor(10, 225);
+        lcd.print("B:Next page  Hold B:Stats");
+        controllersGrid.invalidate();
+    } else if (now - controllersRefreshMs < CONTROLLERS_PAGE_REFRESH_MS) {
+        return;
+    }
+    controllersRefreshMs = now;
+
+    uint8_t column = 0;
+    TelemetrySnapshot snapshot;
+    char name[CellGrid::MAX_CHARS + 1];
+    for (uint8_t i = 0; i < TELEMETRY_MAX_CONTROLLERS && column < CONTROLLERS_COLUMNS; i++) {
+        if (!controllerActive(i) || telemetryController(i, snapshot) == 0) continue;
+        // BLE modules by link, the rest by CAN id
+        if (i < VESC_MAX_LINKS) {
+            snprintf(name, sizeof(name), "L%u", i);
+        } else {
+            snprintf(name, sizeof(name), "#%u", controllerCanIds[i]);
+        }
+        setControllersColumn(column++, name, snapshot, &valuesCaches[i], now);
+    }
+    uint8_t shown = column;
+    while (column < CONTROLLERS_COLUMNS) clearControllersColumn(column++);
+    TelemetryReading total = telemetryReadLatest(now);
+    if (total.sequence != 0) {
+        setControllersColumn(CONTROLLERS_COLUMNS, "Total", total.snapshot, nullptr, now);
+    } else {
+        clearControllersColumn(CONTROLLERS_COLUMNS);
+    }
+    controllersGrid.paint();
+
+    lcd.setTextSize(2);
+    lcd.setTextColor(WHITE, BLACK);
+    lcd.setCursor(160, 10);
+    lcd.printf("%u ", shown);
+}
+
+// ---- Cells page ----
+//
+// The BMS's cells as a heatmap, eight to a row, with the spread and the
+// hottest cell below. Only a new reading is drawn, and of it only the
+// tiles whose value moved (see ui/cell_heatmap.h).
+const int16_t CELLS_GRID_X = 8;
+const int16_t CELLS_GRID_Y = 40;
+const int16_t CELLS_TILE_WIDTH = 38;
+const int16_t CELLS_TILE_HEIGHT = 22;
+const uint8_t CELLS_COLUMNS = 8;
+CellHeatmap cellsHeatmap(&lcd);
+uint32_t cellsVersion = 0;
+
+// True while the BMS has reported cells lately
+bool bmsReporting() {
+    BmsSnapshot snapshot;
+    return telemetryBms(snapshot) != 0 && snapshot.values.cellCount > 0 &&
+           millis() - snapshot.updatedMs < BMS_STALE_MS;
+}
+
+void enterCells() {
+    cellsHeatmap.setGeometry(CELLS_GRID_X, CELLS_GRID_Y, CELLS_TILE_WIDTH, CELLS_TILE_HEIGHT, CELLS_COLUMNS);
+    cellsHeatmap.setRange(BMS_CELL_EMPTY_MV, BMS_CELL_FULL_MV);
+    cellsVersion = 0;
+}
+
+void renderCells(bool full) {
+    if (full) {
+        lcd.setTextSize(2);
+        lcd.setTextColor(WHITE, BLACK);
+        lcd.setCursor(10, 10);
+        lcd.print("Cells");
+        lcd.setTextSize(1);
+        lcd.setCursor(10, 225);
+        lcd.print("B:Next page  Hold B:Stats");
+        cellsHeatmap.invalidate();
+        cellsVersion = 0;
+    }
+    BmsSnapshot snapshot;
+    uint32_t version = telemetryBms(snapshot);
+    if (version == cellsVersion) return;
+    cellsVersion = version;
+
+    const VescBmsValues& bms = snapshot.values;
+    cellsHeatmap.setCount(bms.cellCount);
+    for (uint8_t c = 0; c < bms.cellCount; c++) {
+        uint8_t marks = 0;
+        if (c == bms.minCell) marks |= CellHeatmap::MARK_LOWEST;
+        if (c == bms.maxCell) marks |= CellHeatmap::MARK_HIGHEST;
+        if (bms.balancing & (1u << c)) marks |= CellHeatmap::MARK_BALANCING;
+        cellsHeatmap.set(c, bms.cellMv[c], marks);
+    }
+    cellsHeatmap.paint();
+
+    char pack[12], low[12], high[12], hottest[12], soc[12];
+    formatFixed(pack, sizeof(pack), bms.packMv / 100, 1);
+    formatFixed(low, sizeof(low), bms.cellMv[bms.minCell], 3);
+    formatFixed(high, sizeof(high), bms.cellMv[bms.maxCell], 3);
+    formatFixed(hottest, sizeof(hottest), unitsConvert(UNIT_TEMPERATURE, bms.tempCellMax), 1);
+    formatFixed(soc, sizeof(soc), bms.soc, 1);
+    lcd.setTextSize(2);
+    lcd.setTextColor(WHITE, BLACK);
+    lcd.setCursor(100, 10);
+    lcd.printf("%uS %sV   ", bms.cellCount, pack);
+    lcd.setTextSize(1);
+    int16_t y = cellsHeatmap.bottom() + 8;
+    lcd.setCursor(10, y);
+    lcd.printf("Low %sV (#%u)  High %sV (#%u)  Spread %umV   ", low, bms.minCell + 1, high, bms.maxCell + 1,
+               bms.cellMv[bms.maxCell] - bms.cellMv[bms.minCell]);
+    lcd.setCursor(10, y + 14);
+    lcd.printf("Hottest %s%s  Charge %s%%  Balancing %u   ", hottest, unitsName(UNIT_TEMPERATURE), soc,
+               (unsigned)__builtin_popcount(bms.balancing));
+}
+
+// ---- Laps page ----
+//
+// The running lap's time, the best and the last, a power chart of the
+// lap with the best one dotted under it, and a row per recent lap. The
+// timer is copied at most every LAPS_PAGE_REFRESH_MS, and cells repaint
+// only when their text changes.
+enum LapsColumn : uint8_t {
+    LAPS_COLUMN_NUMBER, LAPS_COLUMN_TIME, LAPS_COLUMN_WATT_HOURS, LAPS_COLUMN_BATTERY_A, LAPS_COLUMN_MOTOR_A,
+    LAPS_COLUMN_SPEED, LAPS_COLUMNS
+};
+const char* const LAPS_COLUMN_LABELS[LAPS_COLUMNS] = { "#", "Time", "Wh", "Batt A", "Motor A", "" };
+const uint8_t LAPS_ROWS = 8;            // The labels, then the newest laps
+const int16_t LAPS_GRID_X = 10;
+const int16_t LAPS_GRID_Y = 110;
+const int16_t LAPS_CELL_WIDTH = 50;
+const int16_t LAPS_CELL_HEIGHT = 13;
+static_assert(LAPS_COLUMNS <= CellGrid::MAX_COLUMNS && LAPS_ROWS <= CellGrid::MAX_ROWS, "the laps page fits its grid");
+CellGrid lapsGrid(&lcd);
+StripChartWidget lapsChart(&lcd, 10, 46, 300, 58, HISTORY_POWER, YELLOW, 1000);
+Compositor lapsPanel;
+LapTimer shownLaps;             // The UI's copy
+uint32_t lapsRefreshMs = 0;
+char lapsHeadline[2][48];       // What the two text lines last showed
+
+// m:ss.t, or m:ss from 100 minutes on
+void formatLapTime(char* out, size_t size, uint32_t ms) {
+    uint32_t tenths = ms / 100;
+    uint32_t minutes = tenths / 600;
+    if (minutes < 100) {
+        snprintf(out, size, "%u:%02u.%u", (unsigned)minutes, (unsigned)(tenths / 10 % 60), (unsigned)(tenths % 10));
+    } else {
+        snprintf(out, size, "%u:%02u", (unsigned)minutes, (unsigned)(tenths / 10 % 60));
+    }
+}
+
+// The best lap lined up under the one running, for the charts
+ChartReference lapReference() {
+    ChartReference reference = { 0, 0, 0 };
+    if (!LAPS_ENABLED || !lapsTiming) return reference;
+    portENTER_CRITICAL(&lapMux);
+    int best = lapTimer.best();
+    if (best >= 0) {
+        reference.traceStart = lapTimer.current().historyStart;
+        reference.start = lapTimer.completed(best).historyStart;
+        reference.count = lapTimer.completed(best).historyCount;
+    }
+    portEXIT_CRITICAL(&lapMux);
+    return reference;
+}
+
+void setLapsRow(uint8_t row, const LapRecord& lap, uint16_t color) {
+    char cell[CellGrid::MAX_CHARS + 1];
+    snprintf(cell, sizeof(cell), "%u", (unsigned)lap.number);
+    lapsGrid.set(LAPS_COLUMN_NUMBER, row, cell, color);
+    formatLapTime(cell, sizeof(cell), lap.durationMs);
+    lapsGrid.set(LAPS_COLUMN_TIME, row, cell, color);
+    formatCell(cell, sizeof(cell), lap.energy, 10000);
+    lapsGrid.set(LAPS_COLUMN_WATT_HOURS, row, cell, color);
+    formatCell(cell, sizeof(cell), lap.maxCurrentIn, 100);
+    lapsGrid.set(LAPS_COLUMN_BATTERY_A, row, cell, color);
+    formatCell(cell, sizeof(cell), lap.maxCurrentMotor, 100);
+    lapsGrid.set(LAPS_COLUMN_MOTOR_A, row, cell, color);
+    // Over the ground with a fix, else from the wheel
+    int32_t speed = lap.maxGpsSpeed > 0 ? lap.maxGpsSpeed : drivetrain.speed(lap.maxRpm);
+    formatCell(cell, sizeof(cell), unitsConvert(UNIT_SPEED, speed), 10);
+    lapsGrid.set(LAPS_COLUMN_SPEED, row, cell, color);
+}
+
+void showLapsLine(uint8_t line, int16_t y, uint8_t size, const char* text) {
+    if (strcmp(text, lapsHeadline[line]) == 0) return;
+    strncpy(lapsHeadline[line], text, sizeof(lapsHeadline[line]) - 1);
+    lcd.fillRect(0, y, 320, size * 8, BLACK);
+    lcd.setTextSize(size);
+    lcd.setTextColor(WHITE, BLACK);
+    lcd.setCursor(size == 2 ? 110 : 10, y);
+    lcd.print(text);
+}
+
+void enterLaps() {
+    lapsGrid.setGeometry(LAPS_GRID_X, LAPS_GRID_Y, LAPS_CELL_WIDTH, LAPS_CELL_HEIGHT, LAPS_COLUMNS, LAPS_ROWS);
+    lapsRefreshMs = 0;
+}
+
+void updateLaps() {
+    lapsChart.setReference(lapReference(), LIGHTGREY);
+    lapsChart.update(telemetryHistory());
+}
+
+void renderLaps(bool full) {
+    uint32_t now = millis();
+    if (full) {
+        lcd.setTextSize(2);
+        lcd.setTextColor(WHITE, BLACK);
+        lcd.setCursor(10, 10);
+        lcd.print("Laps");
+        lcd.setTextSize(1);
+        lcd.setCursor(10, 225);
+        lcd.print("A:Lap  Hold A:Reset  B:Next page");
+        for (uint8_t column = 0; column < LAPS_COLUMNS; column++) {
+            lapsGrid.set(column, 0, column == LAPS_COLUMN_SPEED ? unitsName(UNIT_SPEED) : LAPS_COLUMN_LABELS[column],
+                         DARKGREY);
+        }
+        lapsGrid.invalidate();
+        lapsHeadline[0][0] = '\0';
+        lapsHeadline[1][0] = '\0';
+    } else if (now - lapsRefreshMs < LAPS_PAGE_REFRESH_MS) {
+        return;
+    }
+    lapsRefreshMs = now;
+
+    portENTER_CRITICAL(&lapMux);
+    shownLaps = lapTimer;
+    portEXIT_CRITICAL(&lapMux);
+
+    char line[48];
+    char time[12];
+    if (shownLaps.running()) {
+        formatLapTime(time, sizeof(time), shownLaps.current().durationMs);
+        snprintf(line, sizeof(line), "#%u %s", (unsigned)shownLaps.current().number, time);
+    } else {
+        snprintf(line, sizeof(line), "A to start");
+    }
+    showLapsLine(0, 10, 2, line);
+
+    int best = shownLaps.best();
+    if (best >= 0) {
+        const LapRecord& fastest = shownLaps.completed(best);
+        const LapRecord& last = shownLaps.completed(0);
+        char bestTime[12];
+        formatLapTime(bestTime, sizeof(bestTime), fastest.durationMs);
+        formatLapTime(time, sizeof(time), last.durationMs);
+        uint32_t behind = last.durationMs - fastest.durationMs;
+        snprintf(line, sizeof(line), "Best %s (#%u)  Last %s +%u.%us%s", bestTime, (unsigned)fastest.number, time,
+                 (unsigned)(behind / 1000), (unsigned)(behind / 100 % 10), shownLaps.hasLine() ? "  GPS line" : "");
+    } else {
+        snprintf(line, sizeof(line), "%s", shownLaps.hasLine() ? "GPS start line set" : "");
+    }
+    showLapsLine(1, 32, 1, line);
+
+    for (uint8_t row = 1; row < LAPS_ROWS; row++) {
+        uint8_t age = row - 1;
+        if (age < shownLaps.count()) {
+            setLapsRow(row, shownLaps.completed(age), age == best ? GREEN : WHITE);
+        } else {
+            for (uint8_t column = 0; column < LAPS_COLUMNS; column++) lapsGrid.set(column, row, "", BLACK);
+        }
+    }
+    lapsGrid.paint();
+}
+
+// The layout file, if the SD card or SPIFFS has a valid one
+bool loadLayoutFile(fs::FS& fs, const char* source) {
+    if (!fs.exists(LAYOUT_FILE)) return false;
+    File file = fs.open(LAYOUT_FILE, FILE_READ);
+    if (!file) return false;
+    
+    static const size_t MAX_FILE_BYTES = sizeof(LayoutFileHeader) + Layout::MAX_PAGES * sizeof(LayoutPageRecord) +
+                                         Layout::MAX_WIDGETS * sizeof(LayoutWidgetRecord) + Layout::MAX_LABEL_BYTES;
+    size_t size = file.size();
+    bool loaded = false;
+    if (size <= MAX_FILE_BYTES) {
+        uint8_t* data = (uint8_t*)malloc(size);
+        if (data && file.read(data, size) == size) {
+            loaded = layoutParse(data, size, dashboardLayout);
+        }
+        free(data);
+    }
+    file.close();
+    if (loaded) {
+        LOG_I(UI, "Layout from %s%s: %d pages, %d widgets", source, LAYOUT_FILE,
+              dashboardLayout.pageCount, dashboardLayout.widgetCount);
+    } else {
+        LOG_W(UI, "Layout %s%s is damaged or too large, ignored", source, LAYOUT_FILE);
+    }
+    return loaded;
+}
+
+void loadLayout() {
+    if (SD.cardType() != CARD_NONE && loadLayoutFile(SD, "SD:")) return;
+    if (SPIFFS.begin(false) && loadLayoutFile(SPIFFS, "SPIFFS:")) return;
+    layoutDefault(dashboardLayout);
+    LOG_I(UI, "Built-in layout: %d pages", dashboardLayout.pageCount);
+}
+
+// The formulas file, if the SD card or SPIFFS has one
+bool loadFormulasFile(fs::FS& fs, const char* source) {
+    if (!FORMULAS_ENABLED || !fs.exists(FORMULAS_FILE)) return false;
+    File file = fs.open(FORMULAS_FILE, FILE_READ);
+    if (!file) return false;
+
+    static const size_t MAX_FILE_BYTES = 2048;
+    size_t size = file.size();
+    FormulaSet formulas;
+    bool read = false;
+    if (size <= MAX_FILE_BYTES) {
+        char* text = (char*)malloc(size);
+        read = text && file.read((uint8_t*)text, size) == size;
+        uint16_t line = 0;
+        const char* error = nullptr;
+        if (read && !formulas.parse(text, size, line, error)) {
+            LOG_W(APP, "Formula on line %u of %s%s: %s", line, source, FORMULAS_FILE, error);
+        }
+        free(text);
+    }
+    file.close();
+    if (!read) {
+        LOG_W(APP, "Formulas %s%s could not be read or are too large, ignored", source, FORMULAS_FILE);
+        return false;
+    }
+    for (uint8_t i = 0; i < formulas.count(); i++) {
+        LOG_I(APP, "Formula %u from %s%s: %s", i + 1, source, FORMULAS_FILE, formulas.name(i));
+    }
+    formulaFields = formulas.fields();
+    telemetrySetFormulas(formulas);
+    return true;
+}
+
+void loadFormulas() {
+    if (SD.cardType() != CARD_NONE && loadFormulasFile(SD, "SD:")) return;
+    if (SPIFFS.begin(false)) loadFormulasFile(SPIFFS, "SPIFFS:");
+}
+
+void setupDashboard() {
+    loadLayout();
+    loadFormulas();
+    for (uint8_t page = 0; page < dashboardLayout.pageCount; page++) {
+        dashboardViews[page].build(&lcd, dashboardLayout, page);
+        const char* name = dashboardLayout.label(dashboardLayout.pages[page].name);
+        dashboardScreens[page] = new Screen(name, dashboardHooks, dashboardInput, &dashboardViews[page].compositor());
+        // Coming back to a dashboard page is a blit of its last image
+        dashboardScreens[page]->retain(&lcd, RETAINED_SCREEN_BITS);
+    }
+    for (int i = 0; i < STATS_LINE_COUNT; i++) {
+        statsOverlay.add(&statsLines[i]);
+    }
+    statsOverlay.begin();
+    statsScreen.retain(&lcd, RETAINED_SCREEN_BITS);
+    
+    for (TextWidget& line : settingsLines) {
+        settingsPanel.add(&line);
+    }
+    settingsPanel.begin();
+    settingsLines[SETTING_COUNT + 1].setText("A:-  C:+  B:Next  Hold B:Save A:Undo C:New trip", WHITE);
+
+    for (TextWidget& line : linkLines) {
+        linkPanel.add(&line);
+    }
+    linkPanel.begin();
+
+    for (TextWidget& line : riderLines) {
+        riderPanel.add(&line);
+    }
+    riderPanel.begin();
+    riderLines[0].setText("Rider", WHITE);
+    riderLines[SETTINGS_PROFILE_COUNT + 1].setText("A:Back  B:Next  C:Choose", WHITE);
+
+    lapsPanel.add(&lapsChart);
+    lapsPanel.begin();
+}
+
+// Paint the retained images of the dashboard pages and the stats screen
+// ahead of their first showing, so even entering one the first time is a
+// blit. One screen a loop pass once the first frame is up, keeping input
+// and rendering going; the screen on top is passed over.
+void prerenderScreens() {
+    static uint8_t next = 0;
+    uint8_t total = dashboardLayout.pageCount + 1;
+    while (next < total) {
+        Screen* screen = next < dashboardLayout.pageCount ? dashboardScreens[next] : &statsScreen;
+        next++;
+        if (!screen || screen == screens.top()) continue;
+        uint32_t started = micros();
+        if (!screen->prerender()) continue;
+        LOG_D(UI, "Prerendered the %s screen in %u us", screen->name(), (unsigned)(micros() - started));
+        return;
+    }
+}
+
+// ---- Render benchmark ----
+
+// Full-screen and panel sprites, and a glyph cache like the value
+// widgets' but with the built-in font, made for the benchmark only
+struct RenderBenchTargets {
+    DisplaySprite* screen;
+    SpritePanel* panel;
+    GlyphCache* glyphs;
+};
+
+void benchFillScreen(void* context) {
+    static bool flip = false;
+    flip = !flip;
+    lcd.fillScreen(flip ? NAVY : BLACK);
+}
+
+void benchFillRect(void* context) {
+    lcd.fillRect(80, 90, 160, 60, DARKGREY);
+}
+
+void benchPrintText(void* context) {
+    lcd.setTextSize(4);
+    lcd.setTextColor(WHITE, BLACK);
+    lcd.setCursor(40, 100);
+    lcd.print("48.56V");
+}
+
+void benchGlyphText(void* context) {
+    GlyphCache& glyphs = *((RenderBenchTargets*)context)->glyphs;
+    int16_t x = 40;
+    for (const char* c = "48.56V"; *c; c++) {
+        glyphs.draw(&lcd, *c, x, 100);
+        x += glyphs.glyphWidth(*c);
+    }
+}
+
+void benchScreenSprite(void* context) {
+    ((RenderBenchTargets*)context)->screen->pushSprite(0, 0);
+}
+
+#ifdef DISPLAY_M5GFX
+// The same frame handed to the bus's DMA while the CPU only waits for it
+// in endWrite(); the gap to "sprite 320x240" is what DMA leaves free
+void benchScreenSpriteDma(void* context) {
+    DisplaySprite* screen = ((RenderBenchTargets*)context)->screen;
+    lcd.startWrite();
+    lcd.pushImageDMA(0, 0, 320, 240, (const lgfx::swap565_t*)screen->getBuffer());
+    lcd.endWrite();
+}
+
+// Through the line pool, as the retained screens are shown
+void benchScreenSpritePool(void* context) {
+    displayPushSprite(*((RenderBenchTargets*)context)->screen, 0, 0);
+}
+#endif
+
+void benchPanelSprite(void* context) {
+    ((RenderBenchTargets*)context)->panel->push();
+}
+
+void benchDeviceList(void* context) {
+    displayDeviceList(true);
+}
+
+void benchDashboardRepaint(void* context) {
+    Compositor& widgets = dashboardViews[0].compositor();
+    widgets.invalidateAll();
+    widgets.frame();
+}
+
+void benchDashboardBlit(void* context) {
+    dashboardScreens[0]->show(&lcd);
+}
+
+// Time every drawing path once setupDashboard() has built the widgets
+void runRenderBench() {
+    const uint32_t SCREEN_BYTES = 320 * 240 * 2;
+    const uint32_t PANEL_BYTES = 160 * 60 * 2;
+    DisplaySprite screen(&lcd);
+    screen.setPsram(true);
+    screen.setColorDepth(16);
+    SpritePanel panel(&lcd, 80, 90, 160, 60);
+    GlyphCache glyphs("0123456789.V", 4, WHITE, BLACK);
+    if (screen.createSprite(320, 240) == nullptr || !panel.begin() || !glyphs.begin(&lcd)) {
+        LOG_E(UI, "Render benchmark: no memory for its sprites");
+        screen.deleteSprite();
+        return;
+    }
+    screen.fillSprite(DARKGREEN);
+    panel.canvas().fillSprite(MAROON);
+    panel.drawCentered("48.56V", 20, 3, WHITE, MAROON);
+    RenderBenchTargets targets = { &screen, &panel, &glyphs };
+
+    const RenderBenchCase cases[] = {
+        { "fillScreen", benchFillScreen, nullptr, SCREEN_BYTES },
+        { "fillRect 160x60", benchFillRect, nullptr, PANEL_BYTES },
+        { "print size 4", benchPrintText, nullptr, 0 },
+        { "glyph cache size 4", benchGlyphText, &targets, 0 },
+        { "sprite 320x240", benchScreenSprite, &targets, SCREEN_BYTES },
+#ifdef DISPLAY_M5GFX
+        { "sprite 320x240 DMA", benchScreenSpriteDma, &targets, SCREEN_BYTES },
+        { "sprite 320x240 pool", benchScreenSpritePool, &targets, SCREEN_BYTES },
+#endif
+        { "sprite panel 160x60", benchPanelSprite, &targets, PANEL_BYTES },
+        { "device list", benchDeviceList, nullptr, 0 },
+        // Last, as they need a dashboard page
+        { "dashboard repaint", benchDashboardRepaint, nullptr, 0 },
+        { "dashboard blit", benchDashboardBlit, nullptr, SCREEN_BYTES },
+    };
+    size_t count = sizeof(cases) / sizeof(cases[0]);
+    if (dashboardScreens[0]) {
+        // Let the page's retained image fill in before it is blitted
+        dashboardScreens[0]->show(&lcd);
+        dashboardScreens[0]->frame();
+    } else {
+        count -= 2;
+    }
+    lcd.fillScreen(BLACK);
+    renderBenchRunAll(cases, count, RENDER_BENCH_ITERATIONS);
+    screen.deleteSprite();
+    lcd.fillScreen(BLACK);
+}
+
+// Fault code of the first faulted controller, 0 if none
+uint8_t activeFault() {
+    for (uint8_t i = 0; i < TELEMETRY_MAX_CONTROLLERS; i++) {
+        if (lastFaultCodes[i] != 0) return lastFaultCodes[i];
+    }
+    return 0;
+}
+
+// Enter hook of the dashboard pages: the page shown last may have
+// passed over widgets this one shows, so everything is fed once
+void enterDashboard() {
+    shownChanged = VALUES_ALL_FIELDS;
+}
+
+// Update hook of the dashboard pages; the page's compositor paints what
+// changed
+void updateDashboard() {
+    PROBE_SCOPE("dashboard");
+    // M5Stack battery level from the cached sample, so no I2C here
+    SensorReadings sensors;
+    sensorsRead(sensors);
+    
+    // Status text (data age)
+    unsigned long timeSinceUpdate = dataAgeMs(millis());
+    unsigned long timeSinceConnection = millis() - connectionStartTime;
+    char statusText[16];
+    RideStats ride;
+    rideStatsRead(ride);
+    shownDerived.setSample(shownValues, shownVersion);
+    LayoutSample sample = { &shownValues, &shownDerived, shownChanged, &telemetryHistory(),
+                            &energyEstimator.estimate(), &ride, sensors.batteryLevel, shownControllers, statusText, CYAN,
+                            lapReference(), staleFields(millis()) };
+    if (timeSinceUpdate > settings().staleTimeoutMs) {
+        if (timeSinceConnection <= CONNECTION_GRACE_PERIOD_MS) {
+            // During grace period, show waiting message
+            sample.status = "Waiting...";
+            sample.statusColor = YELLOW;
+        } else {
+            sample.status = "No data";
+            sample.statusColor = RED;
+        }
+    } else if (activeFault() != 0) {
+        // A fault outranks the data age
+        snprintf(statusText, sizeof(statusText), "Fault %d%s", activeFault(), capturing ? " REC" : "");
+        sample.statusColor = RED;
+    } else if (const char* alert = alertsShown()) {
+        sample.status = alert;
+        sample.statusColor = RED;
+    } else if (LOG_PLAYBACK_ENABLED && playbackRunning) {
+        LogPlaybackStatus playback = logPlaybackStatus();
+        if (playback.speed > 0) {
+            snprintf(statusText, sizeof(statusText), "Replay %ux", (unsigned)playback.speed);
+        } else {
+            snprintf(statusText, sizeof(statusText), "Replay max");
+        }
+        sample.statusColor = MAGENTA;
+    } else {
+        snprintf(statusText, sizeof(statusText), "%lus ago", timeSinceUpdate / 1000);
+    }
+    dashboardViews[dashboardPage].update(sample);
+    shownChanged = 0;
+}
+
+// Snapshot of the performance counters, link counters included
+void collectPerfStats(PerfSnapshot& snapshot) {
+    perfSnapshot(snapshot);
+    snapshot.frames = 0;
+    snapshot.crcErrors = 0;
+    snapshot.resyncs = 0;
+    for (int i = 0; i < VESC_MAX_LINKS; i++) {
+        snapshot.frames += vescFramers[i].framesReceived();
+        snapshot.crcErrors += vescFramers[i].crcErrorCount();
+        snapshot.resyncs += vescFramers[i].resyncCount();
+    }
+    snapshot.rxDropped = rxQueueDropped();
+    snapshot.timeouts = 0;
+    for (uint8_t i = 0; i < TELEMETRY_MAX_CONTROLLERS; i++) {
+        snapshot.timeouts += requestTrackers[i].timeouts();
+    }
+    snapshot.unhandled = replyDispatcher.unhandledCount();
+}
+
+// Probe page: one line per probe, times in microseconds
+void displayProbeLines() {
+    ProbeStats probes[PROBE_MAX];
+    int count = probesSnapshot(probes, PROBE_MAX);
+    uint32_t cyclesPerUs = getCpuFrequencyMhz();
+    
+    char line[TextWidget::MAX_TEXT];
+    for (int i = 1; i < STATS_LINE_COUNT - 1; i++) {
+        int p = i - 1;
+        if (p >= count) {
+            statsLines[i].setText("", WHITE);
+            continue;
+        }
+        
+        // Tenths of a microsecond
+        const ProbeStats& s = probes[p];
+        uint32_t minT = s.count ? s.minCycles * 10 / cyclesPerUs : 0;
+        uint32_t avgT = s.count ? (uint32_t)(s.totalCycles * 10 / s.count / cyclesPerUs) : 0;
+        uint32_t maxT = s.maxCycles * 10 / cyclesPerUs;
+        snprintf(line, sizeof(line), "%-10s %6u %u.%u/%u.%u/%u.%u", s.name, s.count,
+                 minT / 10, minT % 10, avgT / 10, avgT % 10, maxT / 10, maxT % 10);
+        statsLines[i].setText(line, WHITE);
+    }
+}
+
+// Memory by subsystem, then the tasks closest to their stack's end
+void displayMemoryLines() {
+    MemoryTagStats tags[MEMORY_TAG_COUNT];
+    memoryTagStats(tags);
+    bool traced = memoryHeapTraced();
+    char line[TextWidget::MAX_TEXT];
+    snprintf(line, sizeof(line), "%-10s %6s %8s", traced ? "KB" : "KB buffers", "held", "peak");
+    statsLines[1].setText(line, CYAN);
+    int row = 2;
+    for (uint8_t t = 0; t < MEMORY_TAG_COUNT; t++) {
+        uint32_t heldBytes = tags[t].bufferBytes + tags[t].heapBytes;
+        snprintf(line, sizeof(line), "%-10s %4u.%u %6u.%u", memoryTagName((MemoryTag)t), heldBytes / 1024,
+                 heldBytes % 1024 * 10 / 1024, tags[t].peakBytes / 1024, tags[t].peakBytes % 1024 * 10 / 1024);
+        statsLines[row++].setText(line, WHITE);
+    }
+
+    // Lowest headroom first, two to a line
+    PerfSnapshot s;
+    perfSnapshot(s);
+    uint8_t order[PERF_MAX_TASKS];
+    for (uint8_t i = 0; i < s.taskCount; i++) order[i] = i;
+    for (uint8_t i = 1; i < s.taskCount; i++) {
+        for (uint8_t j = i; j > 0 && s.tasks[order[j]].freeBytes < s.tasks[order[j - 1]].freeBytes; j--) {
+            uint8_t swap = order[j];
+            order[j] = order[j - 1];
+            order[j - 1] = swap;
+        }
+    }
+    for (uint8_t i = 0; row < STATS_LINE_COUNT - 1; row++, i += 2) {
+        int n = 0;
+        line[0] = 0;
+        for (uint8_t j = i; j < s.taskCount && j < i + 2; j++) {
+            const PerfTaskStack& task = s.tasks[order[j]];
+            n += snprintf(line + n, sizeof(line) - n, "%s%.10s %u", n ? "  " : "Stack ", task.name, task.freeBytes);
+            if (n >= (int)sizeof(line)) break;
+        }
+        statsLines[row].setText(line, WHITE);
+    }
+}
+
+// Odometer totals, committed or not
+void displayLifetimeLines() {
+    OdometerTotals t;
+    odometerRead(t);
+    char line[TextWidget::MAX_TEXT];
+    char a[12], b[12];
+    formatFixed(a, sizeof(a), unitsConvert(UNIT_DISTANCE, (int32_t)(t.microns / 100000000ull)), 1);
+    snprintf(line, sizeof(line), "Distance %s %s", a, unitsName(UNIT_DISTANCE));
+    statsLines[1].setText(line, CYAN);
+    snprintf(line, sizeof(line), "Energy %d.%d Wh used, %d.%d regen", (int)(t.wattHours / 10000),
+             (int)(t.wattHours / 1000 % 10), (int)(t.wattHoursCharged / 10000), (int)(t.wattHoursCharged / 1000 % 10));
+    statsLines[2].setText(line, WHITE);
+    snprintf(line, sizeof(line), "Charge %d.%d Ah drawn", (int)(t.ampHours / 10000), (int)(t.ampHours / 1000 % 10));
+    statsLines[3].setText(line, WHITE);
+    formatFixed(a, sizeof(a), unitsConvert(UNIT_SPEED, t.maxSpeed), 1);
+    snprintf(line, sizeof(line), "Top speed %s %s", a, unitsName(UNIT_SPEED));
+    statsLines[4].setText(line, WHITE);
+    snprintf(line, sizeof(line), "Peak %d A in, %d W", t.maxCurrentIn / 100, t.maxPowerW);
+    statsLines[5].setText(line, WHITE);
+    formatFixed(a, sizeof(a), unitsConvert(UNIT_TEMPERATURE, t.maxTempFet), 1);
+    formatFixed(b, sizeof(b), unitsConvert(UNIT_TEMPERATURE, t.maxTempMotor), 1);
+    snprintf(line, sizeof(line), "Hottest FET %s, motor %s %s", a, b, unitsName(UNIT_TEMPERATURE));
+    statsLines[6].setText(line, WHITE);
+    snprintf(line, sizeof(line), "%u samples, %u commits since boot", (unsigned)t.samples,
+             (unsigned)odometerCommits());
+    statsLines[7].setText(line, WHITE);
+    for (int i = 8; i < STATS_LINE_COUNT - 1; i++) statsLines[i].setText("", WHITE);
+}
+
+// The last crash: where it happened, and how often it has
+void displayCrashLines() {
+    CrashStats crash = crashReportStats();
+    const CrashSummary& s = crash.summary;
+    char line[TextWidget::MAX_TEXT];
+    snprintf(line, sizeof(line), "%u crashes, %u brownouts", (unsigned)crash.crashes, (unsigned)crash.brownouts);
+    statsLines[1].setText(line, crash.crashes ? YELLOW : GREEN);
+    int row = 2;
+    if (!crash.haveSummary) {
+        statsLines[row++].setText("No crash recorded", WHITE);
+    } else {
+        snprintf(line, sizeof(line), "Last: #%u %s%s", (unsigned)s.number, crashReasonName(s.reason),
+                 crash.crashedLastBoot ? ", this boot" : "");
+        statsLines[row++].setText(line, crash.crashedLastBoot ? RED : WHITE);
+        if (s.hasDump) {
+            snprintf(line, sizeof(line), "Task %s  PC 0x%08x", s.task, (unsigned)s.pc);
+            statsLines[row++].setText(line, WHITE);
+            snprintf(line, sizeof(line), "Cause %u at 0x%08x  ELF %s", (unsigned)s.cause, (unsigned)s.address,
+                     s.elfSha);
+            statsLines[row++].setText(line, WHITE);
+            // Three frames to a line
+            for (uint8_t i = 0; i < s.depth && row < STATS_LINE_COUNT - 1; i += 3) {
+                int n = 0;
+                for (uint8_t j = i; j < s.depth && j < i + 3; j++) {
+                    n += snprintf(line + n, sizeof(line) - n, "%s0x%08x", n ? " " : "", (unsigned)s.backtrace[j]);
+                }
+                statsLines[row++].setText(line, CYAN);
+            }
+            if (s.corrupted && row < STATS_LINE_COUNT - 1) statsLines[row++].setText("Backtrace corrupted", YELLOW);
+        } else {
+            statsLines[row++].setText("No core dump", WHITE);
+        }
+    }
+    while (row < STATS_LINE_COUNT - 1) statsLines[row++].setText("", WHITE);
+}
+
+void updateStats() {
+    statsLines[STATS_LINE_COUNT - 1].setText("B:page  Hold A:power B:close C:console", WHITE);
+    if (statsPage == STATS_PROBES) {
+        statsLines[0].setText("Probes  n  us min/avg/max", WHITE);
+        displayProbeLines();
+        return;
+    }
+    if (statsPage == STATS_MEMORY) {
+        statsLines[0].setText("Memory", WHITE);
+        displayMemoryLines();
+        return;
+    }
+    if (statsPage == STATS_LIFETIME) {
+        statsLines[0].setText("Lifetime", WHITE);
+        displayLifetimeLines();
+        return;
+    }
+    if (statsPage == STATS_CRASH) {
+        statsLines[0].setText("Crashes", WHITE);
+        displayCrashLines();
+        return;
+    }
+    statsLines[0].setText("Performance", WHITE);
+    
+    PerfSnapshot s;
+    collectPerfStats(s);
+    
+    // Widgets repaint only on change, so formatting every frame is cheap
+    char line[TextWidget::MAX_TEXT];
+    snprintf(line, sizeof(line), "Frames %u  CRC %u  Resync %u  Drop %u",
+             s.frames, s.crcErrors, s.resyncs, s.rxDropped);
+    statsLines[1].setText(line, s.crcErrors || s.rxDropped ? YELLOW : GREEN);
+    snprintf(line, sizeof(line), "RTT <16:%u <32:%u <64:%u <128:%u",
+             s.rttHistogram[0], s.rttHistogram[1], s.rttHistogram[2], s.rttHistogram[3]);
+    statsLines[2].setText(line, CYAN);
+    snprintf(line, sizeof(line), "<256:%u <512:%u <1k:%u 1k+:%u  TO %u",
+             s.rttHistogram[4], s.rttHistogram[5], s.rttHistogram[6], s.rttHistogram[7], s.timeouts);
+    statsLines[3].setText(line, s.timeouts ? YELLOW : CYAN);
+    snprintf(line, sizeof(line), "Frame work %u.%u ms avg, %u.%u max",
+             s.renderUsAvg / 1000, s.renderUsAvg / 100 % 10, s.renderUsMax / 1000, s.renderUsMax / 100 % 10);
+    statsLines[4].setText(line, WHITE);
+    snprintf(line, sizeof(line), "Late start %u.%u ms avg, %u.%u max",
+             s.jitterUsAvg / 1000, s.jitterUsAvg / 100 % 10, s.jitterUsMax / 1000, s.jitterUsMax / 100 % 10);
+    statsLines[5].setText(line, WHITE);
+    LinkQuality::Level quality = worstLinkQuality();
+    snprintf(line, sizeof(line), "%u fps, %u skipped  Link %s", s.framesPerSecond, s.framesSkipped,
+             LinkQuality::levelName(quality));
+    statsLines[6].setText(line, quality == LinkQuality::LINK_GOOD ? WHITE : (quality == LinkQuality::LINK_POOR ? RED : YELLOW));
+    snprintf(line, sizeof(line), "Heap %u/%u min  PSRAM %u", s.freeHeap, s.minFreeHeap, s.freePsram);
+    statsLines[7].setText(line, WHITE);
+    
+    // Average battery draw in each mode, the current one in green
+    PowerModeStats full = powerModeStats(POWER_FULL);
+    PowerModeStats save = powerModeStats(POWER_SAVE);
+    if (powerOnUsb()) {
+        snprintf(line, sizeof(line), "Power %s USB  avg full %d save %dmA",
+                 powerModeName(powerMode()), full.averageMa, save.averageMa);
+    } else {
+        snprintf(line, sizeof(line), "Power %s %dmA  avg full %d save %d",
+                 powerModeName(powerMode()), powerLastDrawMa(), full.averageMa, save.averageMa);
+    }
+    statsLines[8].setText(line, powerMode() == POWER_SAVE ? GREEN : WHITE);
+    
+    // Stack headroom, two tasks to a line
+    for (int row = 0; row < 2; row++) {
+        int n = 0;
+        line[0] = 0;
+        for (int i = row * 2; i < s.taskCount && i < row * 2 + 2; i++) {
+            n += snprintf(line + n, sizeof(line) - n, "%s%s %u", n ? "  " : "Stack ",
+                          s.tasks[i].name, s.tasks[i].freeBytes);
+            if (n >= (int)sizeof(line)) break;
+        }
+        statsLines[9 + row].setText(line, WHITE);
+    }
+    bootFormatLine(line, sizeof(line));
+    statsLines[11].setText(line, WHITE);
+}
+
+void logPerfStats() {
+    PerfSnapshot snapshot;
+    collectPerfStats(snapshot);
+    char line[320];
+    perfFormatLine(snapshot, line, sizeof(line));
+    LOG_I(APP, "%s", line);
+    perfFormatLatencyLine(snapshot, line, sizeof(line));
+    LOG_I(APP, "%s", line);
+    if (probesFormatLine(line, sizeof(line)) > 0) {
+        LOG_I(APP, "%s", line);
+    }
+}
+
+// ---- Link analyzer ----
+
+// A link's cumulative counters as the analyzer takes them. The RTT
+// histogram is the instrumentation's, over every link.
+LinkAnalyzer::Counters linkAnalyzerCounters(uint8_t link) {
+    static_assert(LinkAnalyzer::RTT_BUCKETS == PERF_RTT_BUCKETS, "RTT buckets differ");
+    LinkAnalyzer::Counters c;
+    memset(&c, 0, sizeof(c));
+    RxLinkCounts rx = rxQueueLinkCounts(link);
+    c.notifications = rx.notifications;
+    c.notificationBytes = rx.bytes;
+    c.frames = vescFramers[link].framesReceived();
+    c.crcErrors = vescFramers[link].crcErrorCount();
+    portENTER_CRITICAL(&requestTrackerMux);
+    for (uint8_t i = 0; i < TELEMETRY_MAX_CONTROLLERS; i++) {
+        if (controllerLinks[i] != link) continue;
+        c.requests += requestTrackers[i].sent();
+        c.replies += requestTrackers[i].replies();
+        c.timeouts += requestTrackers[i].timeouts();
+    }
+    portEXIT_CRITICAL(&requestTrackerMux);
+    PerfSnapshot perf;
+    perfSnapshot(perf);
+    memcpy(c.rtt, perf.rttHistogram, sizeof(c.rtt));
+    return c;
+}
+
+// The first polled link from link on, or link itself if none is
+uint8_t nextAnalyzedLink(uint8_t link) {
+    for (uint8_t i = 0; i < VESC_MAX_LINKS; i++) {
+        uint8_t candidate = (link + i) % VESC_MAX_LINKS;
+        if (sessionLinks & (1u << candidate)) return candidate;
+    }
+    return link;
+}
+
+void enterLinkAnalyzer() {
+    analyzedLink = nextAnalyzedLink(analyzedLink);
+    linkAnalyzer.reset();
+    linkAnalyzerUpdatedMs = 0;
+}
+
+// Tenths as "12.3"
+void formatTenths(char* out, size_t size, uint32_t tenths) {
+    snprintf(out, size, "%u.%u", tenths / 10, tenths % 10);
+}
+
+void updateLinkAnalyzer() {
+    uint32_t now = millis();
+    if (linkAnalyzerUpdatedMs != 0 && now - linkAnalyzerUpdatedMs < LINK_ANALYZER_REFRESH_MS) return;
+    linkAnalyzerUpdatedMs = now;
+    linkAnalyzer.update(linkAnalyzerCounters(analyzedLink), now);
+    const LinkAnalyzer::Figures& f = linkAnalyzer.figures();
+    bool ble = linkIsBle(analyzedLink);
+
+    char line[TextWidget::MAX_TEXT];
+    char a[12], b[12];
+    snprintf(line, sizeof(line), "Link %u %s", analyzedLink, ble ? "BLE" : "wired");
+    linkLines[0].setText(line, WHITE);
+    if (ble) {
+        // The parameters of the connection negotiated last
+        uint16_t interval = bleLinkStatus.interval;
+        if (interval != 0) {
+            snprintf(a, sizeof(a), "%u.%02u ms", interval * 125 / 100, interval * 125 % 100);
+        } else {
+            snprintf(a, sizeof(a), "-");
+        }
+        snprintf(line, sizeof(line), "MTU %u  interval %s  latency %u", bleLinkStatus.mtu, a,
+                 bleLinkStatus.latency);
+        linkLines[1].setText(line, CYAN);
+        snprintf(line, sizeof(line), "RSSI %d dBm  quality %s (%u)", vescLinks[analyzedLink]->rssi(),
+                 LinkQuality::levelName(linkQuality[analyzedLink].level()), linkQuality[analyzedLink].score());
+    } else {
+        linkLines[1].setText("No MTU or interval on a cable", CYAN);
+        snprintf(line, sizeof(line), "Quality %s (%u)", LinkQuality::levelName(linkQuality[analyzedLink].level()),
+                 linkQuality[analyzedLink].score());
+    }
+    linkLines[2].setText(line, linkQuality[analyzedLink].level() == LinkQuality::LINK_GOOD ? WHITE : YELLOW);
+    if (f.windowMs == 0) {
+        for (int i = 3; i < LINK_LINE_COUNT - 1; i++) linkLines[i].setText(i == 3 ? "Measuring..." : "", WHITE);
+    } else {
+        snprintf(line, sizeof(line), "Notifications/frame %u.%02u  %u B each", f.notificationsPerFrameX100 / 100,
+                 f.notificationsPerFrameX100 % 100, f.bytesPerNotification);
+        linkLines[3].setText(line, f.notificationsPerFrameX100 > 100 ? YELLOW : WHITE);
+        formatTenths(a, sizeof(a), f.requestsPerSecondX10);
+        formatTenths(b, sizeof(b), f.repliesPerSecondX10);
+        snprintf(line, sizeof(line), "Requests %s/s  replies %s/s", a, b);
+        linkLines[4].setText(line, WHITE);
+        formatTenths(a, sizeof(a), f.timeoutsPerSecondX10);
+        snprintf(line, sizeof(line), "Timeouts %s/s  CRC fail %u.%02u%%", a, f.crcFailuresX100 / 100,
+                 f.crcFailuresX100 % 100);
+        linkLines[5].setText(line, f.timeoutsPerSecondX10 || f.crcFailuresX100 ? YELLOW : WHITE);
+        if (f.rttCount == 0) {
+            snprintf(line, sizeof(line), "RTT over %u s: no round trips", (f.windowMs + 500) / 1000);
+        } else {
+            uint32_t median = LinkAnalyzer::rttBucketEdge(f.rttMedian);
+            uint32_t p90 = LinkAnalyzer::rttBucketEdge(f.rttP90);
+            snprintf(a, sizeof(a), median ? "<%u" : "1k+", median);
+            snprintf(b, sizeof(b), p90 ? "<%u" : "1k+", p90);
+            snprintf(line, sizeof(line), "RTT over %u s: %u, p50 %s p90 %s ms", (f.windowMs + 500) / 1000,
+                     f.rttCount, a, b);
+        }
+        linkLines[6].setText(line, CYAN);
+        // A bar a bucket, as its share of the window's round trips
+        for (uint8_t bucket = 0; bucket < LinkAnalyzer::RTT_BUCKETS; bucket++) {
+            uint32_t edge = LinkAnalyzer::rttBucketEdge(bucket);
+            uint32_t share = f.rttCount ? (f.rtt[bucket] * 100 + f.rttCount / 2) / f.rttCount : 0;
+            int filled = f.rttCount ? (int)((f.rtt[bucket] * LINK_RTT_BAR_CHARS + f.rttCount / 2) / f.rttCount) : 0;
+            int n = edge ? snprintf(line, sizeof(line), "<%4u ", edge) : snprintf(line, sizeof(line), "1024+ ");
+            for (int i = 0; i < LINK_RTT_BAR_CHARS; i++) line[n++] = i < filled ? '#' : '.';
+            snprintf(line + n, sizeof(line) - n, " %3u%%", share);
+            linkLines[LINK_RTT_FIRST_LINE + bucket].setText(line, bucket == f.rttP90 ? YELLOW : WHITE);
+        }
+    }
+    linkLines[LINK_LINE_COUNT - 1].setText("A:next link  B:close  C:restart", WHITE);
+}
+
+// The selected dashboard page
+Screen* dashboardScreen() {
+    if (dashboardPage == dashboardLayout.pageCount) return &controllersScreen;
+    if (dashboardPage == dashboardLayout.pageCount + 1) return &cellsScreen;
+    if (dashboardPage > dashboardLayout.pageCount) return &lapsScreen;
+    return dashboardScreens[dashboardPage];
+}
+
+// The stats overlay starts on its counters page with a log line
+void enterStats() {
+    // Right after a crash the overlay opens on it, once
+    static bool crashShown = false;
+    statsPage = STATS_COUNTERS;
+    if (crashReportStats().crashedLastBoot && !crashShown) {
+        statsPage = STATS_CRASH;
+        crashShown = true;
+    }
+    logPerfStats();
+}
+
+void enterSettings() {
+    selectedSetting = 0;
+}
+
+void enterRider() {
+    selectedRider = settingsProfile();
+}
+
+void updateRider() {
+    for (uint8_t i = 0; i < SETTINGS_PROFILE_COUNT; i++) {
+        char line[TextWidget::MAX_TEXT];
+        snprintf(line, sizeof(line), "%c Rider %u%s", i == selectedRider ? '>' : ' ', i + 1,
+                 i == settingsProfile() ? "  (riding)" : "");
+        riderLines[1 + i].setText(line, i == selectedRider ? YELLOW : WHITE);
+    }
+}
+
+bool pairingCodeAvailable(uint8_t code) {
+    if (code == PAIRING_LOG_SERVICE) return logServiceReady;
+    return LIVE_STREAM_ENABLED && LIVE_STREAM_ACCESS_POINT;
+}
+
+// WIFI: fields escape \ ; , : and " with a backslash
+void appendWifiField(char* out, size_t size, const char* text) {
+    size_t length = strlen(out);
+    for (const char* c = text; *c && length + 2 < size; c++) {
+        if (strchr("\\;,:\"", *c)) out[length++] = '\\';
+        out[length++] = *c;
+    }
+    out[length] = '\0';
+}
+
+void pairingCodeText(uint8_t code, char* out, size_t size) {
+    if (code == PAIRING_LOG_SERVICE) {
+        char address[18] = "";
+        if (LOG_SERVICE_ENABLED) logServiceAddress(address, sizeof(address));
+        snprintf(out, size, "vescdash://logs?name=%s&address=%s&service=%s", LOG_SERVICE_NAME, address,
+                 LOG_SERVICE_UUID);
+        return;
+    }
+    snprintf(out, size, "WIFI:T:%s;S:", LIVE_STREAM_PASSWORD[0] ? "WPA" : "nopass");
+    appendWifiField(out, size, LIVE_STREAM_SSID);
+    if (LIVE_STREAM_PASSWORD[0]) {
+        strncat(out, ";P:", size - strlen(out) - 1);
+        appendWifiField(out, size, LIVE_STREAM_PASSWORD);
+    }
+    strncat(out, ";;", size - strlen(out) - 1);
+}
+
+void enterPairing() {
+    shownPairingCode = 0;
+    while (shownPairingCode < PAIRING_CODE_COUNT && !pairingCodeAvailable(shownPairingCode)) shownPairingCode++;
+}
+
+// The code and what it holds, in words for a phone without a scanner.
+// Only a full render draws: nothing on the screen changes by itself.
+void renderPairing(bool full) {
+    if (!full) return;
+    lcd.setTextSize(2);
+    lcd.setTextColor(WHITE, BLACK);
+    lcd.setCursor(10, 8);
+    lcd.print("Pair a phone");
+    lcd.setTextSize(1);
+    lcd.setCursor(10, 225);
+    if (shownPairingCode >= PAIRING_CODE_COUNT) {
+        lcd.print("A:Close");
+        lcd.setCursor(10, 40);
+        lcd.print("Nothing to pair: no log service or WiFi AP");
+        return;
+    }
+    lcd.print("A:Close  B:Next code");
+
+    QrCodeSprite& qr = *pairingCodes[shownPairingCode];
+    if (!qr.built()) {
+        char text[160];
+        pairingCodeText(shownPairingCode, text, sizeof(text));
+        uint32_t start = millis();
+        if (qr.build(text, PAIRING_QR_SIZE)) LOG_D(UI, "Pairing code built in %u ms", (unsigned)(millis() - start));
+    }
+    qr.push(10, 30);
+
+    int16_t x = 10 + qr.size() + 10;
+    char line[24] = "";
+    lcd.setTextColor(YELLOW, BLACK);
+    lcd.setCursor(x, 40);
+    lcd.print(shownPairingCode == PAIRING_LOG_SERVICE ? "Log download" : "Live stream WiFi");
+    lcd.setTextColor(WHITE, BLACK);
+    if (shownPairingCode == PAIRING_LOG_SERVICE) {
+        lcd.setCursor(x, 60);
+        lcd.print("Name");
+        lcd.setCursor(x, 72);
+        lcd.print(LOG_SERVICE_NAME);
+        if (LOG_SERVICE_ENABLED) logServiceAddress(line, sizeof(line));
+        lcd.setCursor(x, 92);
+        lcd.print("Address");
+        lcd.setCursor(x, 104);
+        lcd.print(line);
+    } else {
+        lcd.setCursor(x, 60);
+        lcd.print("SSID");
+        lcd.setCursor(x, 72);
+        lcd.print(LIVE_STREAM_SSID);
+        lcd.setCursor(x, 92);
+        lcd.print("Password");
+        lcd.setCursor(x, 104);
+        lcd.print(LIVE_STREAM_PASSWORD[0] ? LIVE_STREAM_PASSWORD : "(open)");
+        snprintf(line, sizeof(line), "192.168.4.1:%u", LIVE_STREAM_PORT);
+        lcd.setCursor(x, 124);
+        lcd.print(line);
+    }
+}
+
+// The settings with the selected one highlighted; a title star marks
+// changes not saved yet
+void updateSettings() {
+    char title[TextWidget::MAX_TEXT];
+    snprintf(title, sizeof(title), "Settings, rider %u%s", settingsProfile() + 1, settingsModified() ? " *" : "");
+    settingsLines[0].setText(title, WHITE);
+    for (uint8_t i = 0; i < SETTING_COUNT; i++) {
+        const SettingInfo& info = settingInfo((SettingId)i);
+        int32_t value = settingValue((SettingId)i);
+        char line[TextWidget::MAX_TEXT];
+        if (info.choices) {
+            snprintf(line, sizeof(line), "%c %-14s %6s", i == selectedSetting ? '>' : ' ', info.name,
+                     info.choices[value - info.min]);
+        } else {
+            snprintf(line, sizeof(line), "%c %-14s %6d %s", i == selectedSetting ? '>' : ' ', info.name,
+                     (int)value, info.unit);
+        }
+        settingsLines[1 + i].setText(line, i == selectedSetting ? YELLOW : WHITE);
+    }
+}
+
+void enterScope() {
+    scopeViewChanged = true;
+}
+
+void updateScope() {
+    scopeUpdate(millis());
+}
+
+// Samples one view spans at the current zoom level
+uint32_t scopeSpan() {
+    return scopeBucketSize(scopeLevel) * SCOPE_COLUMNS;
+}
+
+// Keep the view within the capture
+void scopeClampView() {
+    uint32_t count = scopeCount();
+    uint32_t span = scopeSpan();
+    uint32_t last = count > span ? count - span : 0;
+    if (scopeFirst > last) scopeFirst = last;
+    scopeFirst -= scopeFirst % scopeBucketSize(scopeLevel);
+    scopeViewChanged = true;
+}
+
+uint32_t reviewMsPerColumn() {
+    return REVIEW_MS_PER_COLUMN << reviewLevel;
+}
+
+uint32_t reviewSpan() {
+    return reviewMsPerColumn() * REVIEW_COLUMNS;
+}
+
+// Zoom level at which one view shows the whole ride
+uint8_t reviewWholeLevel() {
+    uint8_t level = 0;
+    while (level < REVIEW_MAX_LEVEL && (uint64_t)(REVIEW_MS_PER_COLUMN << level) * REVIEW_COLUMNS < reviewDurationMs) {
+        level++;
+    }
+    return level;
+}
+
+// Keep the view within the ride and on a column, and ask for it
+void reviewClampView() {
+    if (!RIDE_REVIEW_ENABLED) return;
+    if (reviewLevel > reviewWholeLevel()) reviewLevel = reviewWholeLevel();
+    uint32_t span = reviewSpan();
+    uint32_t last = reviewDurationMs > span ? reviewDurationMs - span : 0;
+    if (reviewFirstMs > last) reviewFirstMs = last;
+    reviewFirstMs -= reviewFirstMs % reviewMsPerColumn();
+    logReviewView(reviewFirstMs, reviewMsPerColumn());
+    reviewViewChanged = true;
+}
+
+void enterReview() {
+    reviewFile = 0;
+    reviewViewChanged = true;
+    if (RIDE_REVIEW_ENABLED) logReviewOpen(0);
+}
+
+void exitReview() {
+    if (RIDE_REVIEW_ENABLED) logReviewClose();
+}
+
+// Start a newly opened log zoomed out to the whole ride
+void updateReview() {
+    if (!RIDE_REVIEW_ENABLED) return;
+    LogReviewStatus status = logReviewStatus();
+    if (status.file != reviewFile) {
+        reviewFile = status.file;
+        reviewDurationMs = status.durationMs;
+        reviewLevel = reviewWholeLevel();
+        reviewFirstMs = 0;
+        if (reviewFile) reviewClampView();
+        reviewViewChanged = true;
+    }
+    if (status.decoded != reviewDecoded) {
+        reviewDecoded = status.decoded;
+        reviewViewChanged = true;
+    }
+}
+
+void formatRideTime(uint32_t ms, char* out, size_t size) {
+    uint32_t s = ms / 1000;
+    snprintf(out, size, "%u:%02u:%02u", (unsigned)(s / 3600), (unsigned)(s / 60 % 60), (unsigned)(s % 60));
+}
+
+int16_t reviewY(int32_t value, int32_t low, int64_t range, int16_t top) {
+    return top + REVIEW_PANE_H - 1 - (int16_t)(((int64_t)(value - low) * (REVIEW_PANE_H - 1)) / range);
+}
+
+// Columns without a sample are left blank, and the mean is carried across
+// them with a line, which zoomed far out joins the block keyframes up
+void renderReviewPane(uint8_t p) {
+    const ReviewPane& pane = REVIEW_PANES[p];
+    const HistoryBucket* buckets = reviewBuckets + p * REVIEW_COLUMNS;
+    int32_t low = INT32_MAX, high = INT32_MIN;
+    for (int16_t x = 0; x < REVIEW_COLUMNS; x++) {
+        if (buckets[x].min > buckets[x].max) continue;
+        if (buckets[x].min < low) low = buckets[x].min;
+        if (buckets[x].max > high) high = buckets[x].max;
+    }
+    if (low > high) low = high = 0;
+    if (high - low < pane.scale) {
+        int32_t middle = low + (high - low) / 2;
+        low = middle - pane.scale / 2;
+        high = low + pane.scale;
+    }
+
+    int16_t top = REVIEW_PANE_Y[p];
+    int64_t range = (int64_t)(high - low);
+    int16_t lastX = -1, lastY = 0;
+    for (int16_t x = 0; x < REVIEW_COLUMNS; x++) {
+        lcd.drawFastVLine(x, top, REVIEW_PANE_H, BLACK);
+        const HistoryBucket& b = buckets[x];
+        if (b.min > b.max) continue;
+        int16_t yMax = reviewY(b.max, low, range, top);
+        int16_t yMin = reviewY(b.min, low, range, top);
+        int16_t yMean = reviewY(b.mean, low, range, top);
+        if (lastX >= 0 && x - lastX > 1) lcd.drawLine(lastX, lastY, x, yMean, pane.color);
+        lcd.drawFastVLine(x, yMax, yMin - yMax + 1, pane.color);
+        lastX = x;
+        lastY = yMean;
+    }
+    char label[16];
+    lcd.setTextColor(DARKGREY);
+    lcd.setCursor(2, top + 1);
+    formatFixedTenths(label, sizeof(label), high, pane.scale);
+    lcd.printf("%s %s", label, pane.unit);
+    lcd.setCursor(2, top + REVIEW_PANE_H - 9);
+    formatFixedTenths(label, sizeof(label), low, pane.scale);
+    lcd.print(label);
+}
+
+// The panes keep the last window until the view's own is decoded
+void renderReview(bool full) {
+    if (!full && !reviewViewChanged) return;
+    if (!RIDE_REVIEW_ENABLED || !reviewBuckets) {
+        if (full) {
+            lcd.setTextSize(2);
+            lcd.setTextColor(WHITE, BLACK);
+            lcd.setCursor(10, 100);
+            lcd.println("No memory for the review");
+        }
+        return;
+    }
+    reviewViewChanged = false;
+
+    LogReviewStatus status = logReviewStatus();
+    bool copied = reviewFile && logReviewCopy(reviewBuckets);
+    lcd.setTextSize(1);
+    lcd.setTextColor(WHITE, BLACK);
+    lcd.fillRect(0, 0, 320, REVIEW_PANE_Y[0], BLACK);
+    lcd.setCursor(4, 3);
+    if (status.searching) {
+        lcd.print("Looking for a log...");
+    } else if (!reviewFile) {
+        lcd.print("No closed log on the card");
+    } else {
+        char from[12], to[12], length[12];
+        formatRideTime(reviewFirstMs, from, sizeof(from));
+        formatRideTime(reviewFirstMs + reviewSpan(), to, sizeof(to));
+        formatRideTime(reviewDurationMs, length, sizeof(length));
+        lcd.printf("ride%04d  %s-%s of %s%s", reviewFile, from, to, length, copied ? "" : "  decoding");
+    }
+    if (copied) {
+        for (uint8_t p = 0; p < REVIEW_PANE_COUNT; p++) renderReviewPane(p);
+    } else if (!reviewFile) {
+        lcd.fillRect(0, REVIEW_PANE_Y[0], 320, REVIEW_PANE_Y[REVIEW_PANE_COUNT - 1] + REVIEW_PANE_H - REVIEW_PANE_Y[0], BLACK);
+    }
+    if (full) {
+        lcd.setTextColor(WHITE, BLACK);
+        lcd.setCursor(4, 226);
+        lcd.print("A/C: pan  Hold A/C: zoom -/+  B: older  Hold B: close");
+    }
+}
+
+void renderScopePane(uint8_t pane, uint32_t firstBucket) {
+    uint32_t copied[SCOPE_TRACES];
+    int32_t low = INT32_MAX, high = INT32_MIN;
+    for (uint8_t t = 0; t < SCOPE_TRACES; t++) {
+        HistoryBucket* buckets = scopeBuckets + t * SCOPE_COLUMNS;
+        copied[t] = scopeCopy(SCOPE_PANES[pane][t].channel, scopeLevel, firstBucket, SCOPE_COLUMNS, buckets);
+        for (uint32_t x = 0; x < copied[t]; x++) {
+            if (buckets[x].min < low) low = buckets[x].min;
+            if (buckets[x].max > high) high = buckets[x].max;
+        }
+    }
+    if (low > high) low = high = 0;
+    if (high - low < SCOPE_MIN_SPAN) {
+        int32_t middle = low + (high - low) / 2;
+        low = middle - SCOPE_MIN_SPAN / 2;
+        high = low + SCOPE_MIN_SPAN;
+    }
+
+    // Column by column, so the old trace is never cleared all at once
+    int16_t top = SCOPE_PANE_Y[pane];
+    int64_t range = (int64_t)(high - low);
+    for (int16_t x = 0; x < SCOPE_COLUMNS; x++) {
+        lcd.drawFastVLine(x, top, SCOPE_PANE_H, BLACK);
+        for (uint8_t t = 0; t < SCOPE_TRACES; t++) {
+            if ((uint32_t)x >= copied[t]) continue;
+            const HistoryBucket& b = scopeBuckets[t * SCOPE_COLUMNS + x];
+            int16_t yMax = top + SCOPE_PANE_H - 1 - (int16_t)(((int64_t)(b.max - low) * (SCOPE_PANE_H - 1)) / range);
+            int16_t yMin = top + SCOPE_PANE_H - 1 - (int16_t)(((int64_t)(b.min - low) * (SCOPE_PANE_H - 1)) / range);
+            lcd.drawFastVLine(x, yMax, yMin - yMax + 1, SCOPE_PANES[pane][t].color);
+        }
+    }
+    char label[16];
+    lcd.setTextColor(DARKGREY);
+    lcd.setCursor(2, top + 1);
+    formatFixedTenths(label, sizeof(label), high, 1000);
+    lcd.printf("%s %s", label, pane == 0 ? "A" : "V");
+    lcd.setCursor(2, top + SCOPE_PANE_H - 9);
+    formatFixedTenths(label, sizeof(label), low, 1000);
+    lcd.print(label);
+}
+
+void renderScope(bool full) {
+    uint16_t count = scopeCount();
+    bool grew = count != scopeShownCount && millis() - scopeDrawnMs >= SCOPE_REDRAW_MS;
+    if (!full && !scopeViewChanged && !grew) return;
+    if (!scopeBuckets) {
+        if (full) {
+            lcd.setTextSize(2);
+            lcd.setTextColor(WHITE, BLACK);
+            lcd.setCursor(10, 100);
+            lcd.println("No memory for the scope");
+        }
+        return;
+    }
+    scopeViewChanged = false;
+    scopeShownCount = count;
+    scopeDrawnMs = millis();
+
+    lcd.setTextSize(1);
+    lcd.setTextColor(WHITE, BLACK);
+    lcd.fillRect(0, 0, 320, SCOPE_PANE_Y[0], BLACK);
+    lcd.setCursor(4, 3);
+    lcd.printf("Scope %u/%u  %u-%u  1:%u%s", count, SCOPE_SAMPLES, scopeFirst, scopeFirst + scopeSpan(),
+                  scopeBucketSize(scopeLevel), scopeRecording() ? "  capturing" : "");
+    for (uint8_t pane = 0; pane < 2; pane++) renderScopePane(pane, scopeFirst / scopeBucketSize(scopeLevel));
+    if (full) {
+        lcd.setTextColor(WHITE, BLACK);
+        lcd.setCursor(4, 226);
+        lcd.print("A/C: pan  Hold A/C: zoom -/+  B: capture  Hold B: close");
+    }
+}
+
+// Commands as echoed in CYAN, their output in white
+bool consoleLine(uint32_t line, char* out, uint16_t& color, void* context) {
+    if (!consoleCopyLine(line, out)) return false;
+    color = out[0] == '>' ? CYAN : WHITE;
+    return true;
+}
+
+void enterConsole() {
+    consoleCommandChanged = true;
+}
+
+void exitConsole() {
+    consoleView.hide();
+}
+
+void renderConsole(bool full) {
+    if (full || consoleCommandChanged) {
+        consoleCommandChanged = false;
+        lcd.setTextSize(1);
+        lcd.setTextColor(WHITE, BLACK);
+        lcd.fillRect(0, 0, 320, 14, BLACK);
+        lcd.setCursor(4, 3);
+        lcd.printf("Console  > %s", CONSOLE_COMMANDS[consoleCommand]);
+    }
+    if (!full) {
+        consoleView.update(consoleOldestLine(), consoleLineCount());
+        return;
+    }
+    consoleView.show(consoleOldestLine(), consoleLineCount());
+    lcd.setTextColor(WHITE, BLACK);
+    lcd.setCursor(4, 226);
+    lcd.print("A/B: command  C: run  Hold A/C: page  Hold B: close");
+}
+
+void displayScanning(bool full) {
+    if (!full) return;
+    lcd.setTextSize(2);
+    lcd.setTextColor(WHITE, BLACK);
+    lcd.setCursor(10, 50);
+    lcd.println("Scanning for devices...");
+    rleImageDraw(&lcd, IMAGE_BLUETOOTH, 290, 46);
+    lcd.setCursor(10, 80);
+    lcd.setTextSize(1);
+    lcd.printf("(%d seconds)", settings().scanSeconds);
+}
+
+void displayConnecting(bool full) {
+    if (!full) return;
+    lcd.setTextSize(2);
+    lcd.setTextColor(YELLOW, BLACK);
+    lcd.setCursor(10, 100);
+    lcd.println("Connecting...");
+    rleImageDraw(&lcd, IMAGE_BLUETOOTH, 174, 96);
+}
+
+void displayConnectFailed(bool full) {
+    if (!full) return;
+    lcd.setTextSize(2);
+    lcd.setTextColor(RED, BLACK);
+    lcd.setCursor(10, 100);
+    lcd.println("Connection failed");
+    rleImageDraw(&lcd, IMAGE_BLUETOOTH_OFF, 222, 96);
+}
+
+// ---- Log playback ----
+
+// Play the log on the review screen into the dashboard
+void startPlayback(uint8_t speed) {
+    if (!LOG_PLAYBACK_ENABLED || !playbackReady || reviewFile == 0 || connState == CONN_CONNECTED) return;
+    memset(&playbackBench, 0, sizeof(playbackBench));
+    playbackBench.startedMs = millis();
+    playbackBench.windowMs = playbackBench.startedMs;
+    alertsClear();
+    energyEstimator.resync();
+    connectionStartTime = millis();
+    dataWatchMs = millis();
+    playbackRunning = true;
+    logPlaybackStart(reviewFile, speed);
+    screens.setRoot(dashboardScreen());
+}
+
+// Log how the UI kept up, and go back to the device list
+void stopPlayback() {
+    if (!LOG_PLAYBACK_ENABLED || !playbackRunning) return;
+    playbackRunning = false;
+    logPlaybackStop();
+    alertsClear();
+    LogPlaybackStatus status = logPlaybackStatus();
+    const PlaybackBench& b = playbackBench;
+    uint32_t windows = b.windows ? b.windows : 1;
+    LOG_I(APP, "Playback: %u samples, %u s of ride in %u s; UI %u fps, render avg %u us max %u us, jitter max %u us",
+          (unsigned)status.samples, (unsigned)(status.positionMs / 1000),
+          (unsigned)((millis() - b.startedMs) / 1000), (unsigned)(b.fpsSum / windows),
+          (unsigned)(b.renderUsSum / windows), (unsigned)b.renderUsMax, (unsigned)b.jitterUsMax);
+    screens.setRoot(&deviceListScreen);
+}
+
+// Once per loop pass: take the perf window, and stop at the log's end
+void updatePlayback() {
+    if (!LOG_PLAYBACK_ENABLED || !playbackRunning) return;
+    uint32_t now = millis();
+    if (now - playbackBench.windowMs >= PERF_WINDOW_MS) {
+        playbackBench.windowMs = now;
+        PerfSnapshot s;
+        perfSnapshot(s);
+        playbackBench.windows++;
+        playbackBench.fpsSum += s.framesPerSecond;
+        playbackBench.renderUsSum += s.renderUsAvg;
+        if (s.renderUsMax > playbackBench.renderUsMax) playbackBench.renderUsMax = s.renderUsMax;
+        if (s.jitterUsMax > playbackBench.jitterUsMax) playbackBench.jitterUsMax = s.jitterUsMax;
+    }
+    if (!logPlaybackStatus().playing) stopPlayback();
+}
+
+// Apply a state change from the connection manager
+void handleConnectionEvent(const ConnEvent& event) {
+    // The connection manager takes the screens back from a log
+    stopPlayback();
+    ConnState previous = connState;
+    connState = event.state;
+    nextReconnectAttempt = event.nextAttemptMs;
+    heapAllocSetSteady(false);   // Switching screens and files may allocate
+    
+    switch (event.state) {
+        case CONN_SCANNING:
+            screens.setRoot(&scanningScreen);
+            break;
+            
+        case CONN_IDLE:
+            // The ride is over; close the log file
+            if (SD_LOGGING_ENABLED) telemetryLogStop();
+            captureStopAndSave();
+            alertsClear();
+            if (previous == CONN_SCANNING) {
+                connectionManagerCopyDevices(discoveredDevices);
+                sortDevices();
+                selectedDeviceIndex = discoveredDevices.empty() ? 0 : deviceOrder[0];
+                markedDevices = 0;
+                deviceList.scrollTo(0);
+            }
+            screens.setRoot(&deviceListScreen);
+            break;
+            
+        case CONN_CONNECTING:
+            screens.setRoot(&connectingScreen);
+            break;
+            
+        case CONN_CONNECTED:
+            bootMarkConnected();
+            if (previous == CONN_RECONNECTING) {
+                LOG_I(APP, "Reconnection successful!");
+            }
+            connectionStartTime = millis();  // Start grace period timer
+            dataWatchMs = millis();  // Initialize to prevent immediate timeout
+            energyEstimator.resync();
+            odometerResync();
+            
+            // Poll every quantity right away; each link's own state is
+            // set up as it comes up (startLinkSession)
+            LOG_I(APP, "Requesting initial telemetry...");
+            pollSchedule.restart(millis());
+            if (SD_LOGGING_ENABLED) telemetryLogStart(linkStates[0].firmware);
+            captureStart();
+            if (previous != CONN_CONNECTED) screens.setRoot(dashboardScreen());
+            break;
+            
+        case CONN_CONNECT_FAILED:
+            connectFailedTime = millis();
+            screens.setRoot(&connectFailedScreen);
+            break;
+            
+        case CONN_RECONNECTING:
+            alertsClear();
+            screens.setRoot(&reconnectingScreen);
+            break;
+            
+        case CONN_FLEET:
+            fleetClear();
+            screens.setRoot(&fleetScreen);
+            break;
+    }
+    soakConnectionEvent(previous, event.state);
+}
+
+// Bring up the BLE controller and host on the BT core while
+// setup() initializes the display and PMIC on the other
+SemaphoreHandle_t bleInitDone = nullptr;
+
+void bleInitTask(void* param) {
+    MemoryTag previous = memoryTagEnter(MEMORY_TAG_BLE);
+    bleHostBegin(BLE_MTU, BLE_RELEASE_CLASSIC);
+    LOG_I(BLE, "BLE host: %s", bleHostName());
+    BondingConfig bonding = { BLE_BONDING, BLE_ENCRYPT_DEADLINE_MS };
+    bondingBegin(bonding);
+    memoryTagLeave(previous);
+    bootMark("ble");
+    xSemaphoreGive(bleInitDone);
+    vTaskDelete(nullptr);
+}
+
+// On the I2C bus task: the buttons as they are now, for setup() to see
+// what is held at boot
+void readButtonsNow(void* context) {
+    M5.update();
+}
+
+void setup() {
+    // A parking wake-up scans for the VESC before anything else is
+    // powered, and only goes on from here if it heard it
+    ParkingSettings parking = { PARKING_WAKE_SECONDS, PARKING_SCAN_MS, PARKING_WAKE_ON_TOUCH };
+    bool unparked = PARKING_ENABLED && !WIRED_ENABLED && parkingResume(parking);
+    // A new image on trial counts this boot, or gives way to the old one.
+    // A build without WiFi cannot have fetched one.
+    if (FEATURE_WIFI) firmwareUpdateBoot(FIRMWARE_BOOT_ATTEMPTS);
+    // Before the BLE stack and the buffers below allocate
+    memoryBegin(MEMORY_PSRAM_ABOVE, MEMORY_INTERNAL_RESERVE);
+    bootMark("app start");
+    bleInitDone = xSemaphoreCreateBinary();
+    taskBudgetBegin();
+    const TaskPlacement& bleInit = TASK_PLACEMENT[TASK_BLE_INIT];
+    xTaskCreatePinnedToCore(bleInitTask, bleInit.name, 4096, nullptr, bleInit.priority, nullptr, bleInit.core);
+    
+    // Initialize M5Stack Core2 (PMIC, display, touch, serial, card)
+    displayBegin();
+    if (DISPLAY_DMA_LINES > 0) displayLinePoolBegin(DISPLAY_DMA_LINES);
+    i2cBusBegin(I2C_BUS_QUEUE_LENGTH);
+    if (UNICODE_GLYPH_CELLS > 0) unicodeTextBegin(&lcd, UNICODE_GLYPH_CELLS);
+    PowerSettings powerSettings = { POWER_FULL_CPU_MHZ, POWER_SAVE_CPU_MHZ, POWER_FULL_BRIGHTNESS,
+                                    POWER_SAVE_BRIGHTNESS, DISPLAY_DIMMED_BRIGHTNESS, POWER_SAVE_LIGHT_SLEEP };
+    powerBegin(powerSettings, POWER_MODE);
+    wallClockBegin();
+    MotionSettings motionSettings = { MOTION_DETECT_ENABLED, MOTION_SAMPLE_MS, MOTION_THRESHOLD_MG,
+                                      MOTION_STILL_SECONDS * 1000u };
+    sensorsBegin(SENSOR_POLL_MS, SENSOR_WATCH_MS, motionSettings);
+    if (IMU_ENABLED) {
+        ImuSettings imu = { IMU_RATE_HZ, IMU_READ_MS, IMU_KP, IMU_KI, IMU_GATE_G };
+        imuBegin(imu);
+    }
+    Settings defaults = { BLE_SCAN_TIME_SECONDS, VESC_DATA_REFRESH_MS, VESC_DATA_STALE_TIMEOUT_MS, POLL_RATE_POWER_HZ,
+                          POLL_RATE_TEMPS_HZ, POLL_RATE_FAULT_HZ, TARGET_FPS, BATTERY_CELLS, BATTERY_CAPACITY_MAH,
+                          MOTOR_POLES, GEAR_RATIO_X100, WHEEL_DIAMETER_MM, ALERT_FET_TEMP_C, ALERT_MOTOR_TEMP_C,
+                          ALERT_CELL_MV, UNITS_FAHRENHEIT, UNITS_MILES, LAYOUT_FIRST_PAGE, LAYOUT_PAGE_COUNT };
+    settingsBegin(defaults);
+    // Before the dashboard pages print their units
+    applyUnits();
+    if (ALERT_SOUND) audioBegin(ALERT_VOLUME_PERCENT);
+    if (ALERT_VIBRATE) hapticsBegin(ALERT_VIBRATE_MS);
+    AlertOutputSettings alertOutput = { ALERT_SOUND, ALERT_VIBRATE, ALERT_REPEAT_MS };
+    alertsBegin(alertOutput);
+    bootMark("m5");
+    
+    // Count the reset, and save what the last crash left to the card
+    crashReportBoot();
+    
+    // Count the UI loop's heap allocations (alloc-trace builds only)
+    heapAllocTrackTask(xTaskGetCurrentTaskHandle());
+    perfWatchTask(xTaskGetCurrentTaskHandle(), MEMORY_TAG_UI);
+    
+    // Initialize the display
+    lcd.fillScreen(BLACK);
+    lcd.setTextColor(WHITE, BLACK);
+    lcd.setTextSize(2);
+    
+    // Display Loading message
+    lcd.setCursor(10, 50);
+    lcd.println("Loading...");
+    
+    // Initialize serial communication
+    Serial.begin(115200);
+    if (USB_BRIDGE_ENABLED) usbBridgeBegin(USB_BRIDGE_BAUD, USB_BRIDGE_BUFFER, bridgePacketToVesc);
+    if (SERIAL_STREAM_ENABLED) {
+        LOG_I(APP, "Switching serial to the binary telemetry stream at %u baud", SERIAL_STREAM_BAUD);
+        serialStreamBegin(SERIAL_STREAM_BAUD, SERIAL_STREAM_TX_BUFFER);
+    }
+    LOG_I(APP, "M5Stack Core2 BLE Scanner");
+    LOG_I(APP, "System initialized successfully");
+    if (unparked) LOG_I(APP, "Resumed from parking after %u wake-ups", (unsigned)parkingWakeCount());
+    
+    // Dashboard widgets (sprites in PSRAM)
+    setupDashboard();
+    bootMark("dashboard");
+    i2cBusRun(I2C_PRIORITY_TOUCH, readButtonsNow, nullptr);
+    if (RENDER_BENCH_AT_BOOT || M5.BtnC.isPressed()) runRenderBench();
+    
+    appEventsBegin();
+    inputBegin(STATS_HOLD_MS);
+    telemetryBegin(HISTORY_CAPACITY, HISTORY_PYRAMID_LEVELS, HISTORY_PYRAMID_BUCKETS, HISTORY_ARCHIVE_BYTES,
+                   settings().staleTimeoutMs);
+    telemetrySetAlignment(CONTROLLER_ALIGN_WINDOW_MS);
+    setupFilters();
+    applyThermalLimits(VescConfig());
+    if (GPS_ENABLED && WIRED_UART_ENABLED && GPS_RX_PIN == WIRED_UART_RX_PIN) {
+        LOG_E(APP, "GPS and the wired VESC share pin %d; GPS off", GPS_RX_PIN);
+    } else if (GPS_ENABLED) {
+        GpsSettings gps = { GPS_RX_PIN, GPS_TX_PIN, GPS_BAUD };
+        gpsBegin(gps);
+    }
+    LapConfig laps = { LAPS_GEOFENCE && GPS_ENABLED, LAPS_LINE_RADIUS_M, LAPS_MIN_LAP_MS };
+    lapTimer.configure(laps);
+    CoexistSettings coexist = { { COEXIST_SD_WRITE_BURST_MS, COEXIST_SD_READ_BURST_MS, COEXIST_WIFI_BURST_MS,
+                                  COEXIST_FLASH_WRITE_BURST_MS },
+                                COEXIST_MAX_WAIT_MS };
+    coexistBegin(coexist);
+    spiBusBegin(SPI_BUS_MAX_WAIT_MS);
+    if (SD_LOGGING_ENABLED) telemetryLogBegin(SD_LOG_BLOCK_BYTES, SD_LOG_KEYFRAME_INTERVAL, SD_LOG_FLUSH_INTERVAL_MS);
+    if (RIDE_REVIEW_ENABLED) {
+        LogReviewTrace traces[REVIEW_PANE_COUNT];
+        for (uint8_t p = 0; p < REVIEW_PANE_COUNT; p++) traces[p] = REVIEW_PANES[p].trace;
+        reviewReady = logReviewBegin(traces, REVIEW_PANE_COUNT, REVIEW_COLUMNS, RIDE_REVIEW_DECODE_BYTES);
+        if (reviewReady) {
+            reviewBuckets = (HistoryBucket*)memoryAlloc(REVIEW_PANE_COUNT * REVIEW_COLUMNS * sizeof(HistoryBucket),
+                                                        MEMORY_BULK, MEMORY_TAG_UI);
+        }
+        if (reviewReady && LOG_PLAYBACK_ENABLED) {
+            rxQueueSetSampleHandler(onPlaybackSample);
+            playbackReady = logPlaybackBegin(rxQueuePushSample, LOG_PLAYBACK_MAX_GAP_MS);
+        }
+    }
+    if (SCREENSHOTS_ENABLED) screenshotBegin(SCREENSHOT_BAND_ROWS);
+    if (LIVE_STREAM_ENABLED) {
+        LiveStreamSettings stream = { LIVE_STREAM_ACCESS_POINT, LIVE_STREAM_SSID, LIVE_STREAM_PASSWORD,
+                                      LIVE_STREAM_PORT, LIVE_STREAM_MAX_CLIENTS };
+        liveStreamBegin(stream);
+    }
+    if (LOG_UPLOAD_ENABLED) {
+        LogUploadSettings upload = { LOG_UPLOAD_SSID, LOG_UPLOAD_PASSWORD, LOG_UPLOAD_URL,
+                                     LOG_UPLOAD_CHUNK_BYTES, LOG_UPLOAD_RETRY_MS };
+        logUploadBegin(upload);
+    }
+    if (FIRMWARE_UPDATE_ENABLED) {
+        FirmwareUpdateSettings update = { FIRMWARE_UPDATE_SSID, FIRMWARE_UPDATE_PASSWORD, FIRMWARE_UPDATE_URL,
+                                          FIRMWARE_CHECK_MS };
+        firmwareUpdateBegin(update);
+    }
+    if (LOG_UPLOAD_ENABLED || (LIVE_STREAM_ENABLED && !LIVE_STREAM_ACCESS_POINT)) {
+        wallClockStartNtp(WALL_CLOCK_NTP_SERVER);
+    }
+    rideStatsBegin(RIDE_STATS_PERSIST_MS);
+    odometerBegin(ODOMETER_COMMIT_MS, ODOMETER_SLOTS);
+    faultCaptureBegin(FAULT_CAPTURE_PRE_MS, FAULT_CAPTURE_POST_MS, FAULT_CAPTURE_SAMPLES, FAULT_CAPTURE_SLOTS);
+    consoleBegin(CONSOLE_SCROLLBACK_LINES);
+    if (SCOPE_ENABLED && scopeBegin(SCOPE_SAMPLES, SCOPE_COLUMNS)) {
+        scopeBuckets = (HistoryBucket*)memoryAlloc(SCOPE_TRACES * SCOPE_COLUMNS * sizeof(HistoryBucket), MEMORY_BULK,
+                                                   MEMORY_TAG_UI);
+    }
+    if (BLE_CAPTURE_BYTES > 0) captureBegin(BLE_CAPTURE_BYTES);
+    if (TRACE_RECORDS > 0) traceBegin(TRACE_RECORDS);
+    if (BLE_REPLAY_AT_BOOT) captureReplayLatest(BLE_REPLAY_REALTIME);
+    setupPollSchedule();
+    setupReplyHandlers();
+    applySettings();
+    rxQueueBegin(vescBytesReceived);
+    bootMark("services");
+    
+    // Everything below needs the BLE stack
+    if (xSemaphoreTake(bleInitDone, 0) != pdTRUE) {
+        lcd.setCursor(10, 80);
+        lcd.println("Initializing BLE...");
+        LOG_I(APP, "Waiting for BLE init...");
+        xSemaphoreTake(bleInitDone, portMAX_DELAY);
+    }
+    vSemaphoreDelete(bleInitDone);
+    uint8_t linkCount = BLE_MAX_LINKS < 1 ? 1 : (BLE_MAX_LINKS > VESC_MAX_LINKS ? VESC_MAX_LINKS : BLE_MAX_LINKS);
+    for (uint8_t i = 0; i < linkCount; i++) {
+        if (!WIRED_ENABLED) {
+            vescLinks[i]->begin(i, BLE_LINK_PROFILE, BLE_MTU, onVescNotify, onVescDisconnected, BLE_WRITE_MODE);
+            vescLinks[i]->setDirectNotify(BLE_DIRECT_NOTIFY);
+        }
+        vescTx[i].setLimit(VescTxScheduler::CONTROL, CONTROL_TX_MAX_FPS, CONTROL_TX_BURST);
+        vescTx[i].setLimit(VescTxScheduler::TELEMETRY, TELEMETRY_TX_MAX_FPS, TELEMETRY_TX_BURST);
+    }
+    if (LOG_SERVICE_ENABLED) logServiceReady = logServiceBegin(LOG_SERVICE_NAME, LOG_SERVICE_PROFILE);
+    
+    if (WIRED_ENABLED) {
+        // The cable takes the primary link's place; updateWiredLink()
+        // does what the connection manager would
+        bool started;
+        if (WIRED_CAN_ENABLED) {
+            WiredCanSettings can = { WIRED_CAN_TX_PIN, WIRED_CAN_RX_PIN, WIRED_CAN_KBIT, WIRED_CAN_OWN_ID,
+                                     WIRED_CAN_VESC_ID };
+            if (CAN_STATUS_ENABLED) {
+                rxQueueSetCanHandler(onCanStatus);
+                wiredCan.setStatusHandler(rxQueuePushCan);
+            }
+            started = wiredCan.begin(0, can, onVescNotify);
+            if (started) vescTransports[0] = &wiredCan;
+        } else {
+            WiredUartSettings uart = { UART_NUM_1, WIRED_UART_RX_PIN, WIRED_UART_TX_PIN, WIRED_UART_BAUD };
+            started = wiredUart.begin(0, uart, onVescNotify);
+            if (started) vescTransports[0] = &wiredUart;
+        }
+        if (!started) LOG_E(APP, "Wired VESC link did not start");
+        prepareForConnect(0);
+        ConnEvent event = { CONN_CONNECTING, -1, 0 };
+        handleConnectionEvent(event);
+        bootMark("setup");
+        bootProfileLog();
+        heapMemoryReport();
+        return;
+    }
+
+    // Scanning and (re)connecting run on their own task from here on
+    ConnHooks hooks = { prepareForConnect, waitForVescReady, fleetVisit, onBeacon };
+    ConnConfig config = { settings().scanSeconds, RECONNECT_INTERVAL_MS, RECONNECT_MAX_INTERVAL_MS,
+                          BLE_SUPERVISION_TIMEOUT_MS,
+                          { BLE_CONNECT_DEADLINE_MS, BLE_DISCOVERY_DEADLINE_MS, BLE_SUBSCRIBE_DEADLINE_MS },
+                          BLE_SCAN_CONTINUOUS,
+                          { BLE_SCAN_COMPANY_ID, BLE_SCAN_NAME_FALLBACK }, FLEET_REVISIT_MS, FLEET_HEARD_MS,
+                          BLE_BEACON_COMPANY_ID, BLE_PREWARM_LAST, BLE_SCAN_ADAPTIVE, BLE_SCAN_PASSIVE_MS };
+    // The clients it makes are the BLE stack's, though made here
+    MemoryTag previousTag = memoryTagEnter(MEMORY_TAG_BLE);
+    connectionManagerBegin(vescLinks, linkCount, hooks, config);
+    memoryTagLeave(previousTag);
+    if (SOAK_TEST_ENABLED) {
+        SoakSettings soak = { SOAK_DROP_INTERVAL_MS, SOAK_SUMMARY_INTERVAL_MS, SOAK_RECONNECT_LIMIT_MS };
+        soakBegin(soak);
+    }
+    
+    // Go straight to the last used VESC unless A is held; the manager
+    // scans if there is none or it does not answer
+    i2cBusRun(I2C_PRIORITY_TOUCH, readButtonsNow, nullptr);
+    if (FLEET_MODE_ENABLED) {
+        connectionManagerFleet();
+    } else if ((AUTO_CONNECT_LAST || unparked) && !M5.BtnA.isPressed()) {
+        LOG_I(APP, "Connecting to the last used VESC...");
+        connectionManagerConnectLast();
+    } else {
+        connectionManagerScan();
+    }
+    bootMark("setup");
+    bootProfileLog();
+    heapMemoryReport();
+}
+
+// Sleep until something needs the loop: new telemetry, a connection
+// state change, touch input, the next due poll or the next render the
+// governor allows. Nothing waits for a render slot, so replies and polls
+// are handled as soon as they arrive or fall due; only the rendering is
+// paced (see renderGovernor).
+uint32_t waitForNextFrame() {
+    // The touch IRQ only marks the press; track the finger at frame rate,
+    // and a page slide to its end
+    if (inputTouchActive() || screens.animating()) renderGovernor.request(micros());
+    
+    // Nothing is rendered while the display is off; wake for the sensors
+    uint32_t timeout = displayPower.state() == DISPLAY_OFF ? SENSOR_POLL_MS : renderGovernor.msUntilDue(micros());
+    uint32_t untilDisplay = displayPower.msUntilChange(millis());
+    if (untilDisplay < timeout) timeout = untilDisplay;
+    if (connState == CONN_CONNECTED) {
+        uint32_t untilPoll = pollSchedule.msUntilDue(millis());
+        uint32_t sinceRequest = millis() - lastTelemetryRequest;
+        uint32_t period = telemetryPollPeriod();
+        uint32_t untilAllowed = sinceRequest < period ? period - sinceRequest : 0;
+        if (untilAllowed > untilPoll) untilPoll = untilAllowed;
+        coexistNextPoll(millis(), untilPoll);
+        // A due poll still here was held back; do not spin on it
+        if (untilPoll == 0) untilPoll = POLL_RETRY_MS;
+        if (untilPoll < timeout) timeout = untilPoll;
+        for (uint8_t link = 0; link < VESC_MAX_LINKS; link++) {
+            if (!(sessionLinks & (1u << link))) continue;
+            uint32_t untilHeartbeat = heartbeats[link].msUntilDue(millis());
+            if (untilHeartbeat < timeout) timeout = untilHeartbeat;
+        }
+        if (vescPacketsPending() && BLE_WRITE_RETRY_MS < timeout) timeout = BLE_WRITE_RETRY_MS;
+    } else {
+        coexistNextPoll(millis(), UINT32_MAX);
+    }
+    
+    uint32_t events = appEventsWait(timeout);
+    // Anything but USB traffic may change what is on screen
+    if (events & ~APP_EVENT_USB) renderGovernor.request(micros());
+    return events;
+}
+
+// ---- Screen input handlers ----
+
+void reconnectCancel() {
+    LOG_D(APP, "Button A pressed - Cancel reconnection");
+    connectionManagerCancelReconnect();
+}
+
+void reconnectRetryNow() {
+    LOG_D(APP, "Button B pressed - Retry now");
+    connectionManagerRetryNow();
+}
+
+void fleetStop() {
+    LOG_D(APP, "Button A pressed - Leave fleet mode");
+    connectionManagerDisconnect();
+}
+
+void dashboardDisconnect() {
+    if (playbackRunning) {
+        LOG_D(APP, "Button A pressed - Playback stopped");
+        stopPlayback();
+        return;
+    }
+    LOG_D(APP, "Button A pressed - Disconnect");
+    selectedDeviceIndex = 0;
+    connectionManagerDisconnect();
+}
+
+void dashboardTogglePower() {
+    LOG_D(APP, "Button A held - Power mode");
+    powerSetMode(powerMode() == POWER_FULL ? POWER_SAVE : POWER_FULL);
+}
+
+// The layout pages the rider's settings pick; all of them if those start
+// past the layout's last page
+bool layoutPageShown(uint8_t page) {
+    const Settings& s = settings();
+    uint8_t first = s.firstPage - 1;
+    if (first >= dashboardLayout.pageCount) return true;
+    return page >= first && page - first < s.pageCount;
+}
+
+// Step through the pages, wrapping around. The new page slides in from
+// the side it comes from, once both have been shown before.
+bool dashboardPageAvailable(uint8_t page) {
+    if (page < dashboardLayout.pageCount) return layoutPageShown(page);
+    if (page == dashboardLayout.pageCount) return shownControllers > 1;
+    if (page == dashboardLayout.pageCount + 1) return BMS_ENABLED && bmsReporting();
+    return LAPS_ENABLED;
+}
+
+void dashboardTurnPage(bool forward) {
+    uint8_t pages = dashboardLayout.pageCount + 3;
+    do {
+        dashboardPage = (dashboardPage + (forward ? 1 : pages - 1)) % pages;
+    } while (!dashboardPageAvailable(dashboardPage));
+    subscribeVisiblePage();
+    screens.setRoot(dashboardScreen(), forward ? SLIDE_LEFT : SLIDE_RIGHT);
+}
+
+// A tap switches pages, a hold opens the stats overlay; both act on
+// release so a hold does not also switch
+void dashboardNextScreen() {
+    LOG_D(APP, "Button B pressed - Switch screen");
+    dashboardTurnPage(true);
+}
+
+void dashboardSwipeNext() {
+    LOG_D(APP, "Swipe left - Next page");
+    dashboardTurnPage(true);
+}
+
+void dashboardSwipePrevious() {
+    LOG_D(APP, "Swipe right - Previous page");
+    dashboardTurnPage(false);
+}
+
+void dashboardShowStats() {
+    LOG_D(APP, "Button B held - Stats overlay on");
+    screens.push(&statsScreen);
+}
+
+void dashboardShowScope() {
+    if (!SCOPE_ENABLED) return;
+    LOG_D(APP, "Button C held - Scope");
+    screens.push(&scopeScreen);
+}
+
+// Ask the VESC on the primary link for a capture
+void scopeCapture() {
+    if (connState != CONN_CONNECTED || scopeRecording()) return;
+    LOG_D(APP, "Button B pressed - Scope capture");
+    scopeStart(SCOPE_SAMPLES, SCOPE_TIMEOUT_MS, millis());
+    scopeFirst = 0;
+    scopeClampView();
+    VescCommand request(COMM_SAMPLE_PRINT);
+    request.addUint8(SCOPE_MODE).addUint16(SCOPE_SAMPLES).addUint8(SCOPE_DECIMATION);
+    queueVESCPacket(0, request);
+    flushVESCPackets();
+}
+
+void scopePan(int direction) {
+    uint32_t step = scopeSpan() / 2;
+    scopeFirst = direction < 0 ? (scopeFirst > step ? scopeFirst - step : 0) : scopeFirst + step;
+    scopeClampView();
+}
+
+void scopePanLeft() {
+    scopePan(-1);
+}
+
+void scopePanRight() {
+    scopePan(1);
+}
+
+// Zoom about the middle of the view
+void scopeZoom(int direction) {
+    if (direction > 0 ? scopeLevel == 0 : scopeLevel >= scopeLevels()) return;
+    uint32_t middle = scopeFirst + scopeSpan() / 2;
+    scopeLevel += direction > 0 ? -1 : 1;
+    uint32_t half = scopeSpan() / 2;
+    scopeFirst = middle > half ? middle - half : 0;
+    scopeClampView();
+}
+
+void scopeZoomOut() {
+    scopeZoom(-1);
+}
+
+void scopeZoomIn() {
+    scopeZoom(1);
+}
+
+void scopeClose() {
+    LOG_D(APP, "Button B held - Scope closed");
+    screens.pop();
+}
+
+void reviewPan(int direction) {
+    uint32_t step = reviewSpan() / 2;
+    reviewFirstMs = direction < 0 ? (reviewFirstMs > step ? reviewFirstMs - step : 0) : reviewFirstMs + step;
+    reviewClampView();
+}
+
+void reviewPanLeft() {
+    reviewPan(-1);
+}
+
+void reviewPanRight() {
+    reviewPan(1);
+}
+
+// Zoom about the middle of the view
+void reviewZoom(int direction) {
+    if (!reviewFile || (direction > 0 ? reviewLevel == 0 : reviewLevel >= reviewWholeLevel())) return;
+    uint32_t middle = reviewFirstMs + reviewSpan() / 2;
+    reviewLevel += direction > 0 ? -1 : 1;
+    uint32_t half = reviewSpan() / 2;
+    reviewFirstMs = middle > half ? middle - half : 0;
+    reviewClampView();
+}
+
+void reviewZoomOut() {
+    reviewZoom(-1);
+}
+
+void reviewZoomIn() {
+    reviewZoom(1);
+}
+
+// The next log back; past the oldest the newest comes round again
+void reviewOlder() {
+    LOG_D(APP, "Button B pressed - Older log");
+    if (RIDE_REVIEW_ENABLED) logReviewOpen(reviewFile > 1 ? reviewFile : 0);
+    reviewFile = 0;
+    reviewViewChanged = true;
+}
+
+void reviewClose() {
+    LOG_D(APP, "Button B held - Review closed");
+    screens.pop();
+}
+
+void reviewPlay() {
+    LOG_D(APP, "Swipe left - Play the log");
+    startPlayback(1);
+}
+
+void reviewPlayFast() {
+    LOG_D(APP, "Swipe right - Play the log fast");
+    startPlayback(LOG_PLAYBACK_FAST_SPEED);
+}
+
+void statsShowLink() {
+    LOG_D(APP, "Swipe left - Link analyzer");
+    screens.push(&linkScreen);
+}
+
+void linkAnalyzerNext() {
+    analyzedLink = nextAnalyzedLink((analyzedLink + 1) % VESC_MAX_LINKS);
+    linkAnalyzer.reset();
+    linkAnalyzerUpdatedMs = 0;
+}
+
+void linkAnalyzerRestart() {
+    linkAnalyzer.reset();
+    linkAnalyzerUpdatedMs = 0;
+}
 
-// Reconnection tracking
-bool isReconnecting = false;
-unsigned long lastReconnectAttempt = 0;
-const int RECONNECT_INTERVAL_MS = 5000;  // Try to reconnect every 5 seconds
-int lastConnectedDeviceIndex = -1;  // Remember which device we were connected to
-unsigned long connectionStartTime = 0;  // Track when connection was established
-const int CONNECTION_GRACE_PERIOD_MS = 10000;  // Give 10 seconds grace period for initial data
+void linkAnalyzerClose() {
+    screens.pop();
+}
 
-// VESC communication now handled by VescUart library
+void statsShowConsole() {
+    LOG_D(APP, "Button C held - Console");
+    screens.push(&consoleScreen);
+}
 
-// Nordic UART Service UUIDs
-static BLEUUID serviceUUID("6e400001-b5a3-f393-e0a9-e50e24dcca9e");
-static BLEUUID charUUID_RX("6e400002-b5a3-f393-e0a9-e50e24dcca9e");
-static BLEUUID charUUID_TX("6e400003-b5a3-f393-e0a9-e50e24dcca9e");
-
-// VESC UART Communication Constants
-#define COMM_GET_VALUES 4
-#define COMM_ALIVE 30
-#define VESC_PACKET_START 2
-#define VESC_PACKET_STOP 3
-
-// BLE Connection variables
-BLEClient* pClient = nullptr;
-BLERemoteCharacteristic* pRemoteCharacteristicTX = nullptr;
-BLERemoteCharacteristic* pRemoteCharacteristicRX = nullptr;
-
-// Buffer for assembling fragmented packets
-std::vector<uint8_t> rxBuffer;
-bool waitingForPacket = false;
-
-// Callback class for BLE scan results
-class MyAdvertisedDeviceCallbacks: public BLEAdvertisedDeviceCallbacks {
-    void onResult(BLEAdvertisedDevice advertisedDevice) {
-        // Only add devices with "VESC" in the name
-        if (advertisedDevice.haveName()) {
-            String deviceName = advertisedDevice.getName().c_str();
-            deviceName.toUpperCase();
-            if (deviceName.indexOf("VESC") != -1) {
-                BLEDeviceInfo device;
-                device.name = advertisedDevice.getName().c_str();
-                device.address = advertisedDevice.getAddress().toString().c_str();
-                device.rssi = advertisedDevice.getRSSI();
-                discoveredDevices.push_back(device);
-                Serial.printf("Found VESC device: %s (%s) RSSI: %d\n", 
-                             device.name.c_str(), device.address.c_str(), device.rssi);
-            }
-        }
-    }
-};
+void consolePrevious() {
+    consoleCommand = (consoleCommand + CONSOLE_COMMAND_COUNT - 1) % CONSOLE_COMMAND_COUNT;
+    consoleCommandChanged = true;
+}
 
-// CRC16 calculation for VESC packets
-uint16_t crc16(uint8_t *data, uint32_t len) {
-    uint16_t crc = 0;
-    for (uint32_t i = 0; i < len; i++) {
-        crc ^= data[i] << 8;
-        for (uint8_t bit = 0; bit < 8; bit++) {
-            if (crc & 0x8000) {
-                crc = (crc << 1) ^ 0x1021;
-            } else {
-                crc = crc << 1;
-            }
-        }
-    }
-    return crc;
+void consoleNext() {
+    consoleCommand = (consoleCommand + 1) % CONSOLE_COMMAND_COUNT;
+    consoleCommandChanged = true;
 }
 
-// Send VESC packet
-void sendVESCPacket(uint8_t command) {
-    if (!pRemoteCharacteristicRX || !isConnected) return;
-    
-    uint8_t packet[6];
-    packet[0] = VESC_PACKET_START;
-    packet[1] = 1; // Length
-    packet[2] = command;
-    
-    uint16_t crc = crc16(&packet[2], 1);
-    packet[3] = (crc >> 8) & 0xFF;
-    packet[4] = crc & 0xFF;
-    packet[5] = VESC_PACKET_STOP;
-    
-    pRemoteCharacteristicRX->writeValue(packet, 6);
-    Serial.printf("Sent VESC packet: command %d\n", command);
+// A line of upload progress in the console and the log
+void vescUploadReport(const char* format, ...) {
+    char line[CONSOLE_COLUMNS + 1];
+    va_list args;
+    va_start(args, format);
+    int n = vsnprintf(line, sizeof(line), format, args);
+    va_end(args);
+    if (n < 0) return;
+    if (n >= (int)sizeof(line)) n = sizeof(line) - 1;
+    consoleAppend(line, n);
+    LOG_I(APP, "VESC upload: %s", line);
 }
 
-// Parse VESC response and extract voltage
-void parseVESCResponse(uint8_t* data, size_t length) {
-    if (length < 6) return; // Too short to be valid
-    
-    Serial.print("Raw data: ");
-    for (int i = 0; i < length && i < 64; i++) { // Limit output for readability
-        Serial.printf("%02X ", data[i]);
-    }
-    if (length > 64) Serial.print("...");
-    Serial.printf(" (len=%d)\n", length);
-    
-    // Look for VESC packet structure
-    if (data[0] == VESC_PACKET_START) {
-        Serial.println("Found VESC packet start byte (0x02)");
-        
-        // Get payload length
-        uint8_t payloadLength = data[1];
-        Serial.printf("Payload length: %d bytes\n", payloadLength);
-        
-        // COMM_GET_VALUES response doesn't echo the command byte
-        // The payload starts directly after the length byte
-        // Expected minimum payload for COMM_GET_VALUES is around 50-60 bytes
-        
-        if (payloadLength >= 50 && length >= payloadLength + 5) {
-            Serial.println("Packet size looks like COMM_GET_VALUES response");
-            
-            // The packet has a COMM_GET_VALUES byte at position 2
-            // The actual data payload starts at position 3
-            // Voltage is at offset 26 in the data payload
-            // So in full packet: position = 3 + 26 = 29
-            
-            if (length >= 31) { // Need at least 31 bytes to read voltage
-                // Let's debug the packet structure more carefully
-                Serial.printf("Packet structure: Start=0x%02X Len=%d Cmd=0x%02X\n", 
-                             data[0], data[1], data[2]);
-                
-                // Print key data positions for debugging
-                Serial.printf("Data at key positions:\n");
-                for (int i = 3; i < 35 && i < length; i += 2) {
-                    Serial.printf("  [%d-%d]: 0x%02X%02X = %d\n", 
-                                 i, i+1, data[i], data[i+1], 
-                                 (int16_t)((data[i] << 8) | data[i+1]));
-                }
-                
-                // Voltage is at position 29-30 (confirmed from testing)
-                int voltageIndex = 29;
-                int16_t voltageRaw = (data[voltageIndex] << 8) | data[voltageIndex + 1];
-                vescVoltage = voltageRaw / 10.0;
-                
-                // FET temp is at position 3-4
-                int16_t tempFetRaw = (data[3] << 8) | data[4];
-                vescFetTemp = tempFetRaw / 10.0;
-                
-                Serial.printf("Voltage: %.1fV (raw: 0x%04X = %d)\n", 
-                             vescVoltage, voltageRaw & 0xFFFF, voltageRaw);
-                Serial.printf("FET Temp: %.1f°C (%.1f°F)\n", 
-                             vescFetTemp, (vescFetTemp * 9.0 / 5.0) + 32.0);
-                lastVoltageUpdate = millis();
-                
-                // Also check motor temp
-                int16_t tempMotor = (data[5] << 8) | data[6];
-                Serial.printf("Motor Temp: %.1f°C\n", tempMotor/10.0);
-            } else {
-                Serial.printf("Packet too short for voltage data (need 31, got %d)\n", length);
-            }
-        } else if (data[2] == COMM_ALIVE) {
-            Serial.println("Received COMM_ALIVE response");
-        } else {
-            Serial.printf("Unknown or incomplete packet (payload len=%d, total len=%d)\n", 
-                         payloadLength, length);
+// Serve the upload from the cache, refilling it from the card at the
+// offset asked for when it does not hold all of the range
+size_t readVescImage(uint32_t offset, uint8_t* out, size_t length, void* context) {
+    if (!vescImage || vescImageCache == nullptr) return 0;
+    if (offset < vescImageCacheStart || offset + length > vescImageCacheStart + vescImageCacheLength) {
+        if (!vescImage.seek(offset)) return 0;
+        vescImageCacheStart = offset;
+        vescImageCacheLength = vescImage.read(vescImageCache, VESC_UPLOAD_CACHE_BYTES);
+        if (offset + length > vescImageCacheStart + vescImageCacheLength) {
+            length = vescImageCacheLength;
         }
-    } else {
-        Serial.printf("No start byte found (got 0x%02X, expected 0x02)\n", data[0]);
     }
+    memcpy(out, vescImageCache + (offset - vescImageCacheStart), length);
+    return length;
 }
 
-// BLE notification callback
-void notifyCallback(BLERemoteCharacteristic* pBLERemoteCharacteristic, uint8_t* pData, size_t length, bool isNotify) {
-    Serial.printf("BLE notification: %d bytes\n", length);
-    
-    // Add data to buffer
-    for (size_t i = 0; i < length; i++) {
-        rxBuffer.push_back(pData[i]);
+void vescUploadStart() {
+    if (vescUpload.active()) {
+        vescUploadReport("Upload already running, %u%%",
+                         (unsigned)((uint64_t)vescUpload.bytesAcked() * 100 / vescUpload.totalBytes()));
+        return;
     }
-    
-    // Try to find and parse complete packets
-    while (rxBuffer.size() >= 6) { // Minimum packet size
-        // Look for start byte
-        if (rxBuffer[0] != VESC_PACKET_START) {
-            // Remove bytes until we find a start byte or buffer is empty
-            while (!rxBuffer.empty() && rxBuffer[0] != VESC_PACKET_START) {
-                rxBuffer.erase(rxBuffer.begin());
-            }
-            if (rxBuffer.empty()) break;
-        }
-        
-        // Check if we have enough data for the length byte
-        if (rxBuffer.size() < 2) break;
-        
-        uint8_t payloadLength = rxBuffer[1];
-        size_t totalPacketLength = 2 + payloadLength + 3; // Start + Length + Payload + CRC(2) + Stop
-        
-        // Wait for complete packet
-        if (rxBuffer.size() < totalPacketLength) {
-            Serial.printf("Waiting for complete packet (have %d, need %d)\n", 
-                         rxBuffer.size(), totalPacketLength);
-            break;
-        }
-        
-        // Check for stop byte
-        if (rxBuffer[totalPacketLength - 1] == VESC_PACKET_STOP) {
-            // We have a complete packet!
-            std::vector<uint8_t> packet(rxBuffer.begin(), rxBuffer.begin() + totalPacketLength);
-            parseVESCResponse(packet.data(), packet.size());
-            
-            // Remove processed packet from buffer
-            rxBuffer.erase(rxBuffer.begin(), rxBuffer.begin() + totalPacketLength);
-        } else {
-            // Invalid packet, remove start byte and try again
-            Serial.println("Invalid packet (no stop byte), searching for next...");
-            rxBuffer.erase(rxBuffer.begin());
+    if (vescImageCache == nullptr) {
+        vescImageCache = (uint8_t*)memoryAlloc(VESC_UPLOAD_CACHE_BYTES, MEMORY_BULK, MEMORY_TAG_PROTOCOL);
+        if (vescImageCache == nullptr) {
+            vescUploadReport("No memory for the upload");
+            return;
         }
     }
+    if (vescImage) vescImage.close();
+    vescImage = SD.open(VESC_UPLOAD_PATH, FILE_READ);
+    if (!vescImage || vescImage.size() == 0) {
+        vescUploadReport("No image at %s", VESC_UPLOAD_PATH);
+        if (vescImage) vescImage.close();
+        return;
+    }
+    vescImageCacheStart = 0;
+    vescImageCacheLength = 0;
+    vescUploadShownPercent = 0;
+    while (uploadReplies.size() > 0) {
+        UploadReply stale;
+        uploadReplies.pop((uint8_t*)&stale, sizeof(stale));
+    }
+    if (!vescUpload.start(vescImage.size(), VESC_UPLOAD_MAX_WINDOW, vescTx[0].writeLimit())) {
+        vescUploadReport("Upload refused");
+        vescImage.close();
+        return;
+    }
+    vescUploadReport("Uploading %s, %u bytes in %u-byte chunks", VESC_UPLOAD_PATH, (unsigned)vescUpload.imageBytes(),
+                     (unsigned)vescUpload.chunkBytes());
 }
 
-// BLE Client callbacks
-class MyClientCallbacks : public BLEClientCallbacks {
-    void onConnect(BLEClient* pclient) {
-        Serial.println("BLE Client Connected");
+// Feed acks to the upload and send whatever it has due, from the UI loop
+void serviceVescUpload() {
+    if (!vescUpload.active() && !vescImage) return;
+    uint32_t now = millis();
+    VescFirmwareUpload::State before = vescUpload.state();
+    if (vescUpload.active() && connState != CONN_CONNECTED) {
+        vescUpload.cancel();
+        vescUploadReport("Link lost, upload stopped at %u of %u bytes", (unsigned)vescUpload.bytesAcked(),
+                         (unsigned)vescUpload.totalBytes());
     }
-    
-    void onDisconnect(BLEClient* pclient) {
-        Serial.println("BLE Client Disconnected");
-        if (isConnected) {
-            // Unexpected disconnect - trigger reconnection
-            isConnected = false;
-            isReconnecting = true;
-            lastReconnectAttempt = millis();
-            needsFullRedraw = true;
-            Serial.println("Unexpected disconnect - will attempt reconnection");
-        }
+    UploadReply reply;
+    while (vescUpload.active() && uploadReplies.pop((uint8_t*)&reply, sizeof(reply)) == sizeof(reply)) {
+        vescUpload.onReply(reply.payload, reply.length, now);
     }
-};
+    static uint8_t payload[VescFirmwareUpload::MAX_PAYLOAD];
+    bool queued = false;
+    size_t length;
+    while ((length = vescUpload.next(payload, now)) > 0) {
+        if (!vescTx[0].add(VescTxScheduler::TELEMETRY, payload, length, now)) break;
+        vescUpload.sent(now);
+        queued = true;
+    }
+    if (queued) flushVESCPackets();
 
-// Connect to selected VESC device
-bool connectToVESC(int deviceIndex) {
-    if (deviceIndex >= discoveredDevices.size()) return false;
-    
-    BLEDeviceInfo& device = discoveredDevices[deviceIndex];
-    Serial.printf("Connecting to VESC: %s (%s)\n", device.name.c_str(), device.address.c_str());
-    
-    // Clean up any existing connection
-    if (pClient) {
-        delete pClient;
-        pClient = nullptr;
+    if (vescUpload.state() == VescFirmwareUpload::UPLOAD_ERASING && before == VescFirmwareUpload::UPLOAD_CHECKING) {
+        vescUploadReport("Image CRC %04x, erasing", vescUpload.imageCrc());
     }
-    
-    // Create BLE client with callbacks
-    pClient = BLEDevice::createClient();
-    pClient->setClientCallbacks(new MyClientCallbacks());
-    Serial.println("BLE client created with callbacks");
-    
-    // Connect to the BLE server - try random address first (most common for VESC)
-    BLEAddress bleAddress(device.address.c_str());
-    Serial.printf("Attempting connection to %s with RANDOM address type...\n", device.address.c_str());
-    
-    if (!pClient->connect(bleAddress, BLE_ADDR_TYPE_RANDOM)) {
-        Serial.println("Failed with RANDOM address, trying PUBLIC...");
-        if (!pClient->connect(bleAddress, BLE_ADDR_TYPE_PUBLIC)) {
-            Serial.println("Failed to connect to VESC BLE device");
-            delete pClient;
-            pClient = nullptr;
-            return false;
+    if (vescUpload.state() == VescFirmwareUpload::UPLOAD_WRITING) {
+        uint32_t percent = (uint64_t)vescUpload.bytesAcked() * 100 / vescUpload.totalBytes();
+        if (percent >= vescUploadShownPercent + 10) {
+            vescUploadShownPercent = percent - percent % 10;
+            vescUploadReport("%u%% written, window %u, RTT %u ms", (unsigned)vescUploadShownPercent,
+                             vescUpload.window(), (unsigned)vescUpload.smoothedRtt());
         }
     }
-    
-    Serial.println("Connected to VESC BLE device");
-    delay(2000); // Critical stabilization delay for VESC BLE modules
-    
-    // Get the Nordic UART service
-    Serial.println("Getting UART service...");
-    BLERemoteService* pRemoteService = pClient->getService(serviceUUID);
-    if (pRemoteService == nullptr) {
-        Serial.println("Failed to find Nordic UART service");
-        Serial.println("Listing all available services:");
-        std::map<std::string, BLERemoteService*>* serviceMap = pClient->getServices();
-        for (auto const& service : *serviceMap) {
-            Serial.printf("  Found service: %s\n", service.first.c_str());
+    if (!vescUpload.active()) {
+        if (vescUpload.state() == VescFirmwareUpload::UPLOAD_DONE) {
+            vescUploadReport("Done, %u resent; the VESC restarts into it", (unsigned)vescUpload.retransmits());
+        } else if (vescUpload.state() == VescFirmwareUpload::UPLOAD_FAILED) {
+            vescUploadReport("Upload failed: %s", vescUpload.error());
         }
-        pClient->disconnect();
-        delete pClient;
-        pClient = nullptr;
-        return false;
+        vescImage.close();
     }
-    
-    Serial.println("Found Nordic UART service");
-    
-    // Get the TX characteristic (for receiving data from VESC)
-    Serial.println("Getting TX characteristic...");
-    pRemoteCharacteristicTX = pRemoteService->getCharacteristic(charUUID_TX);
-    if (pRemoteCharacteristicTX == nullptr) {
-        Serial.println("Failed to find TX characteristic");
-        pClient->disconnect();
-        return false;
+}
+
+// Run the selected command on the VESC of the primary link
+void consoleRun() {
+    if (connState != CONN_CONNECTED) return;
+    const char* command = CONSOLE_COMMANDS[consoleCommand];
+    LOG_D(APP, "Button C pressed - Terminal command %s", command);
+    char echo[CONSOLE_COLUMNS + 1];
+    int n = snprintf(echo, sizeof(echo), "> %s", command);
+    consoleAppend(echo, n);
+    if (strcmp(command, VESC_UPLOAD_COMMAND) == 0) {
+        vescUploadStart();
+        return;
     }
-    
-    // Get the RX characteristic (for sending data to VESC)
-    Serial.println("Getting RX characteristic...");
-    pRemoteCharacteristicRX = pRemoteService->getCharacteristic(charUUID_RX);
-    if (pRemoteCharacteristicRX == nullptr) {
-        Serial.println("Failed to find RX characteristic");
-        pClient->disconnect();
-        return false;
+    if (strcmp(command, TRACE_COMMAND) == 0) {
+        bool saved = traceSave("console");
+        n = snprintf(echo, sizeof(echo), saved ? "Trace %u saved" : "No trace saved", (unsigned)traceSaveCount());
+        consoleAppend(echo, n);
+        return;
     }
-    
-    Serial.println("Found both characteristics");
-    
-    // Register for notifications from TX characteristic
-    if (pRemoteCharacteristicTX->canNotify()) {
-        Serial.println("Registering for notifications...");
-        pRemoteCharacteristicTX->registerForNotify(notifyCallback);
-        
-        // Also write to the CCCD descriptor to ensure notifications are enabled
-        Serial.println("Writing to CCCD descriptor...");
-        BLERemoteDescriptor* pDescriptor = pRemoteCharacteristicTX->getDescriptor(BLEUUID((uint16_t)0x2902));
-        if (pDescriptor) {
-            uint8_t notifyValue[] = {0x01, 0x00}; // Enable notifications
-            pDescriptor->writeValue(notifyValue, 2, true);
-            Serial.println("CCCD descriptor written");
-        } else {
-            Serial.println("Warning: CCCD descriptor not found");
-        }
-        
-        Serial.println("Notifications enabled");
+    VescCommand request(COMM_TERMINAL_CMD);
+    request.addBytes((const uint8_t*)command, strlen(command));
+    if (!request.valid()) return;
+    queueVESCPacket(0, request);
+    flushVESCPackets();
+}
+
+// A page through the scrollback; back at the end it follows new output
+void consolePageUp() {
+    consoleView.scrollBy(-CONSOLE_PAGE_LINES);
+}
+
+void consolePageDown() {
+    consoleView.scrollBy(CONSOLE_PAGE_LINES);
+}
+
+void consoleClose() {
+    LOG_D(APP, "Button B held - Console closed");
+    screens.pop();
+}
+
+void statsClose() {
+    LOG_D(APP, "Button B held - Stats overlay off");
+    screens.pop();
+}
+
+// Probe builds page through the overlay; otherwise a tap leaves it for
+// the next dashboard page
+void statsNextPage() {
+    LOG_D(APP, "Button B pressed - Next stats page");
+    if (statsPage == STATS_COUNTERS) {
+        statsPage = STATS_MEMORY;
+    } else if (statsPage == STATS_MEMORY) {
+        statsPage = STATS_LIFETIME;
+    } else if (statsPage == STATS_LIFETIME) {
+        statsPage = STATS_CRASH;
     } else {
-        Serial.println("TX characteristic cannot notify");
-        pClient->disconnect();
-        delete pClient;
-        pClient = nullptr;
-        return false;
+        statsPage = statsPage == STATS_CRASH && PROBES_ENABLED ? STATS_PROBES : STATS_COUNTERS;
     }
-    
-    delay(1000); // Allow notification setup to complete
-    
-    isConnected = true;
-    isReconnecting = false;  // Clear reconnecting flag
-    lastConnectedDeviceIndex = deviceIndex;  // Remember this device
-    connectionStartTime = millis();  // Start grace period timer
-    lastVoltageUpdate = millis();  // Initialize to prevent immediate timeout
-    Serial.println("VESC connection fully established");
-    
-    // Test connection with COMM_ALIVE first (simpler command)
-    Serial.println("Testing connection with COMM_ALIVE...");
-    sendVESCPacket(COMM_ALIVE);
-    delay(500);
-    
-    // Then request voltage data
-    Serial.println("Requesting initial voltage data...");
-    sendVESCPacket(COMM_GET_VALUES);
-    
-    return true;
+    // Probe figures start over each time the page is opened
+    if (statsPage == STATS_PROBES) probesReset();
 }
 
-void displayDeviceList() {
-    static int lastSelectedIndex = -1;
-    
-    // Only do full redraw when needed
-    if (needsFullRedraw) {
-        M5.Lcd.fillScreen(BLACK);
-        needsFullRedraw = false;
-        lastSelectedIndex = -1; // Force redraw of all items
+void dashboardBack() {
+    if (playbackRunning) {
+        LOG_D(APP, "Button C pressed - Playback stopped");
+        stopPlayback();
+        return;
     }
-    
-    M5.Lcd.setTextSize(2);
-    M5.Lcd.setTextColor(WHITE, BLACK);
-    M5.Lcd.setCursor(10, 10);
-    
-    if (discoveredDevices.empty()) {
-        M5.Lcd.println("No VESC devices found");
-        M5.Lcd.setCursor(10, 40);
-        M5.Lcd.println("Press A to rescan");
-    } else {
-        M5.Lcd.printf("Found %d VESC devices:\n", discoveredDevices.size());
-        
-        int yPos = 40;
-        for (int i = 0; i < discoveredDevices.size() && i < 6; i++) {
-            // Only redraw if this item or the selection changed
-            if (i == selectedDeviceIndex || i == lastSelectedIndex || lastSelectedIndex == -1) {
-                // Clear the area for this item
-                M5.Lcd.fillRect(10, yPos, 300, 35, BLACK);
-                
-                M5.Lcd.setCursor(10, yPos);
-                M5.Lcd.setTextSize(1);
-                
-                // Highlight selected device
-                if (i == selectedDeviceIndex) {
-                    M5.Lcd.setTextColor(BLACK, WHITE);
-                    M5.Lcd.printf("> %d. %s\n", i + 1, discoveredDevices[i].name.c_str());
-                    M5.Lcd.setTextColor(WHITE, BLACK);
-                } else {
-                    M5.Lcd.printf("  %d. %s\n", i + 1, discoveredDevices[i].name.c_str());
-                }
-                
-                M5.Lcd.setCursor(20, yPos + 15);
-                M5.Lcd.printf("   %s (RSSI: %d)\n", discoveredDevices[i].address.c_str(), discoveredDevices[i].rssi);
-            }
-            yPos += 35;
-        }
-        
-        lastSelectedIndex = selectedDeviceIndex;
-        
-        M5.Lcd.setTextSize(1);
-        M5.Lcd.setCursor(10, 200);
-        M5.Lcd.println("A:Rescan B:Up/Down C:Connect");
+    LOG_D(APP, "Button C pressed - Back to device list");
+    selectedDeviceIndex = 0;
+    connectionManagerDisconnect();
+}
+
+void deviceListRescan() {
+    LOG_D(APP, "Button A pressed - Rescanning");
+    selectedDeviceIndex = 0;
+    markedDevices = 0;
+    connectionManagerScan();
+}
+
+void deviceListNext() {
+    LOG_D(APP, "Button B pressed - Navigate devices");
+    if (!discoveredDevices.empty()) {
+        uint32_t position = (devicePosition(selectedDeviceIndex) + 1) % discoveredDevices.size();
+        selectedDeviceIndex = deviceOrder[position];
+        deviceList.ensureVisible(position);
+        displayDeviceList();
     }
 }
 
-void displayReconnecting() {
-    // Show reconnecting message
-    if (needsFullRedraw) {
-        M5.Lcd.fillScreen(BLACK);
-        needsFullRedraw = false;
+// Connect the marked devices, or just the selected one
+void deviceListConnect() {
+    LOG_D(APP, "Button C pressed - Connect to selected device");
+    int marked[VESC_MAX_LINKS];
+    int count = 0;
+    for (int i = 0; i < discoveredDevices.size() && i < 32 && count < BLE_MAX_LINKS && count < VESC_MAX_LINKS; i++) {
+        if (markedDevices & (1u << i)) marked[count++] = i;
     }
-    
-    M5.Lcd.setTextSize(3);
-    M5.Lcd.setTextColor(YELLOW, BLACK);
-    String msg = "Reconnecting...";
-    int textWidth = msg.length() * 18; // Approximate width per char at size 3
-    int xPos = (320 - textWidth) / 2;
-    M5.Lcd.setCursor(xPos, 100);
-    M5.Lcd.print(msg);
-    
-    // Show countdown to next attempt
-    unsigned long timeSinceAttempt = millis() - lastReconnectAttempt;
-    int secondsUntilNext = (RECONNECT_INTERVAL_MS - timeSinceAttempt) / 1000;
-    if (secondsUntilNext < 0) secondsUntilNext = 0;
-    
-    M5.Lcd.setTextSize(1);
-    M5.Lcd.setTextColor(WHITE, BLACK);
-    String status = "Next attempt in " + String(secondsUntilNext) + "s";
-    textWidth = status.length() * 6;
-    xPos = (320 - textWidth) / 2;
-    M5.Lcd.setCursor(xPos, 140);
-    M5.Lcd.fillRect(0, 140, 320, 20, BLACK); // Clear the line
-    M5.Lcd.print(status);
-    
-    // Button labels
-    M5.Lcd.setCursor(10, 220);
-    M5.Lcd.println("A:Cancel  B:Retry Now");
-}
-
-void displayVoltage() {
-    // Only do full redraw when needed
-    if (needsFullRedraw) {
-        M5.Lcd.fillScreen(BLACK);
-        
-        // Draw static elements
-        // Small "VESC Connected" at top
-        M5.Lcd.setTextSize(1);
-        M5.Lcd.setTextColor(WHITE, BLACK);
-        M5.Lcd.setCursor(10, 10);
-        M5.Lcd.println("VESC Connected");
-        
-        // Button labels at bottom
-        M5.Lcd.setTextSize(1);
-        M5.Lcd.setTextColor(WHITE, BLACK);
-        M5.Lcd.setCursor(10, 220);
-        M5.Lcd.println("A:Disconnect  B:Request  C:Back");
-        
-        needsFullRedraw = false;
-        lastDisplayedVoltage = -1.0; // Force voltage update
-        lastDisplayedFetTemp = -1.0; // Force temp update
-        lastBatteryLevel = -1; // Force battery update
-        lastStatusText = ""; // Force status update
+    if (count > 0) {
+        connectionManagerConnect(marked, count);
+    } else if (!discoveredDevices.empty() && selectedDeviceIndex < discoveredDevices.size()) {
+        connectionManagerConnect(selectedDeviceIndex);
     }
-    
-    // Update voltage - large and centered
-    if (abs(vescVoltage - lastDisplayedVoltage) > VOLTAGE_UPDATE_THRESHOLD) {
-        // Clear voltage area
-        M5.Lcd.fillRect(0, 70, 320, 60, BLACK);
-        
-        // Calculate center position for voltage text
-        M5.Lcd.setTextSize(6);
-        M5.Lcd.setTextColor(GREEN, BLACK);
-        String voltageStr = String(vescVoltage, 1) + "V";
-        int textWidth = voltageStr.length() * 36; // Approximate width per char at size 6
-        int xPos = (320 - textWidth) / 2;
-        M5.Lcd.setCursor(xPos, 80);
-        M5.Lcd.print(voltageStr);
-        
-        lastDisplayedVoltage = vescVoltage;
+}
+
+// A hold marks the selected device for an extra link; with one link it
+// is just a slow tap
+void deviceListMark() {
+    if (BLE_MAX_LINKS <= 1) {
+        deviceListConnect();
+        return;
     }
-    
-    // Update FET temperature in Fahrenheit
-    float fetTempF = (vescFetTemp * 9.0 / 5.0) + 32.0;
-    if (abs(vescFetTemp - lastDisplayedFetTemp) > TEMP_UPDATE_THRESHOLD) {
-        // Clear temp area
-        M5.Lcd.fillRect(0, 140, 320, 30, BLACK);
-        
-        M5.Lcd.setTextSize(2);
-        M5.Lcd.setTextColor(YELLOW, BLACK);
-        String tempStr = "FET: " + String(fetTempF, 1) + "°F";
-        int textWidth = tempStr.length() * 12; // Approximate width per char at size 2
-        int xPos = (320 - textWidth) / 2;
-        M5.Lcd.setCursor(xPos, 145);
-        M5.Lcd.print(tempStr);
-        
-        lastDisplayedFetTemp = vescFetTemp;
+    if (!discoveredDevices.empty() && selectedDeviceIndex < discoveredDevices.size() && selectedDeviceIndex < 32) {
+        markedDevices ^= 1u << selectedDeviceIndex;
+        LOG_D(APP, "Button C held - Device %d %s", selectedDeviceIndex + 1,
+              (markedDevices & (1u << selectedDeviceIndex)) ? "marked" : "unmarked");
+        displayDeviceList();
     }
-    
-    // Update M5Stack battery level in lower right
-    int batteryLevel = M5.Axp.GetBatteryLevel();
-    if (abs(batteryLevel - lastBatteryLevel) > BATTERY_UPDATE_THRESHOLD || lastBatteryLevel == -1) {
-        // Clear battery area (lower right)
-        M5.Lcd.fillRect(220, 195, 100, 20, BLACK);
-        
-        M5.Lcd.setTextSize(1);
-        // Color based on battery level
-        if (batteryLevel > 60) {
-            M5.Lcd.setTextColor(GREEN, BLACK);
-        } else if (batteryLevel > 20) {
-            M5.Lcd.setTextColor(YELLOW, BLACK);
-        } else {
-            M5.Lcd.setTextColor(RED, BLACK);
-        }
-        
-        M5.Lcd.setCursor(240, 200);
-        M5.Lcd.printf("M5: %d%%", batteryLevel);
-        
-        lastBatteryLevel = batteryLevel;
+}
+
+void deviceListReview() {
+    if (FLEET_MODE_ENABLED) {
+        LOG_D(APP, "Button A held - Fleet mode");
+        connectionManagerFleet();
+        return;
+    }
+    if (!reviewReady) return;
+    LOG_D(APP, "Button A held - Ride review");
+    screens.push(&reviewScreen);
+}
+
+void deviceListSettings() {
+    LOG_D(APP, "Button B held - Settings");
+    screens.push(&settingsScreen);
+}
+
+// A press is a lap on the spot, not on release; the first starts timing
+void lapsMark() {
+    LOG_D(APP, "Button A pressed - Lap");
+    uint32_t now = (uint32_t)(esp_timer_get_time() / 1000);
+    portENTER_CRITICAL(&lapMux);
+    bool started = !lapTimer.running();
+    lapTimer.mark(now, telemetryHistory().total());
+    bool line = lapTimer.hasLine();
+    portEXIT_CRITICAL(&lapMux);
+    lapsRefreshMs = 0;
+    if (!started) return;
+    LOG_I(APP, "Lap timing started%s", line ? " at the GPS start line" : "");
+    lapsTiming = true;
+    subscribeVisiblePage();
+}
+
+void lapsReset() {
+    LOG_D(APP, "Button A held - Reset laps");
+    portENTER_CRITICAL(&lapMux);
+    lapTimer.reset();
+    portEXIT_CRITICAL(&lapMux);
+    lapsRefreshMs = 0;
+    lapsTiming = false;
+    subscribeVisiblePage();
+}
+
+void takeScreenshot() {
+    LOG_D(APP, "Swipe up - Screenshot");
+    if (screenshotRequest()) return;
+    LOG_I(APP, "No screenshot: %s", screenshotBusy() ? "the last one is still being saved" : "no card or memory");
+}
+
+void openPairing() {
+    if (!PAIRING_SCREEN_ENABLED) return;
+    LOG_D(APP, "Swipe left - Pairing");
+    screens.push(&pairingScreen);
+}
+
+void pairingClose() {
+    screens.pop();
+}
+
+// The next code there is, if there is another
+void pairingNext() {
+    if (shownPairingCode >= PAIRING_CODE_COUNT) return;
+    uint8_t code = shownPairingCode;
+    do {
+        code = (code + 1) % PAIRING_CODE_COUNT;
+    } while (code != shownPairingCode && !pairingCodeAvailable(code));
+    if (code == shownPairingCode) return;
+    shownPairingCode = code;
+    screens.redraw();
+}
+
+void openRiderMenu() {
+    if (!RIDER_PROFILES_ENABLED) return;
+    LOG_D(APP, "Swipe down - Rider menu");
+    screens.push(&riderScreen);
+}
+
+void riderClose() {
+    screens.pop();
+}
+
+void riderNext() {
+    selectedRider = (selectedRider + 1) % SETTINGS_PROFILE_COUNT;
+}
+
+// The new rider's poll rates and pages apply at once, so fields only the
+// last rider showed stop being polled before the menu closes
+void riderChoose() {
+    LOG_D(APP, "Button C pressed - Rider %u", selectedRider + 1);
+    bool changed = settingsSelectProfile(selectedRider);
+    if (changed) applySettings();
+    screens.pop();
+    // The page underneath may be one the new rider's pages leave out
+    Screen* top = screens.top();
+    bool page = top && (&top->input() == &dashboardInput || &top->input() == &lapsInput);
+    if (changed && page && top != dashboardScreen()) {
+        screens.setRoot(dashboardScreen());
+    }
+}
+
+// Changes take effect at once, so their effect can be watched
+void settingsStep(int steps) {
+    if (settingAdjust((SettingId)selectedSetting, steps)) applySettings();
+}
+
+void settingsDecrease() {
+    settingsStep(-1);
+}
+
+void settingsIncrease() {
+    settingsStep(1);
+}
+
+void settingsNext() {
+    selectedSetting = (selectedSetting + 1) % SETTING_COUNT;
+}
+
+void settingsSaveAndClose() {
+    LOG_D(APP, "Button B held - Save settings");
+    settingsSave();
+    screens.pop();
+}
+
+// Start the trip statistics, distance and energy afresh
+void settingsNewTrip() {
+    LOG_D(APP, "Button C held - New trip");
+    rideStatsReset();
+    energyEstimator.reset();
+}
+
+void settingsUndoAndClose() {
+    LOG_D(APP, "Button A held - Undo settings");
+    settingsRevert();
+    applySettings();
+    screens.pop();
+}
+
+// Buttons A, B, C of each screen: press handlers act as the button goes
+// down, tap and hold handlers on release
+const ScreenInput reconnectInput = {
+    { reconnectCancel, reconnectRetryNow, nullptr },
+    { nullptr, nullptr, nullptr },
+    { nullptr, nullptr, nullptr },
+};
+const ScreenInput dashboardInput = {
+    { nullptr, nullptr, dashboardBack },
+    { dashboardDisconnect, dashboardNextScreen, nullptr },
+    { dashboardTogglePower, dashboardShowStats, dashboardShowScope },
+    { dashboardSwipeNext, dashboardSwipePrevious, openRiderMenu, takeScreenshot },
+};
+const ScreenInput lapsInput = {
+    { lapsMark, nullptr, dashboardBack },
+    { nullptr, dashboardNextScreen, nullptr },
+    { lapsReset, dashboardShowStats, dashboardShowScope },
+    { dashboardSwipeNext, dashboardSwipePrevious, openRiderMenu, takeScreenshot },
+};
+const ScreenInput statsInput = {
+    { nullptr, nullptr, dashboardBack },
+    { dashboardDisconnect, statsNextPage, nullptr },
+    { dashboardTogglePower, statsClose, statsShowConsole },
+    { statsShowLink, nullptr, nullptr, takeScreenshot },
+};
+const ScreenInput linkInput = {
+    { nullptr, nullptr, nullptr },
+    { linkAnalyzerNext, linkAnalyzerClose, linkAnalyzerRestart },
+    { nullptr, nullptr, nullptr },
+    { nullptr, nullptr, nullptr, takeScreenshot },
+};
+const ScreenInput deviceListInput = {
+    { deviceListRescan, nullptr, nullptr },
+    { nullptr, deviceListNext, deviceListConnect },
+    { deviceListReview, deviceListSettings, deviceListMark },
+    { openPairing, nullptr, openRiderMenu, takeScreenshot },
+};
+const ScreenInput settingsInput = {
+    { nullptr, nullptr, nullptr },
+    { settingsDecrease, settingsNext, settingsIncrease },
+    { settingsUndoAndClose, settingsSaveAndClose, settingsNewTrip },
+};
+const ScreenInput riderInput = {
+    { nullptr, nullptr, nullptr },
+    { riderClose, riderNext, riderChoose },
+    { nullptr, nullptr, nullptr },
+};
+const ScreenInput pairingInput = {
+    { nullptr, nullptr, nullptr },
+    { pairingClose, pairingNext, nullptr },
+    { nullptr, nullptr, nullptr },
+};
+const ScreenInput scopeInput = {
+    { nullptr, scopeCapture, nullptr },
+    { scopePanLeft, nullptr, scopePanRight },
+    { scopeZoomOut, scopeClose, scopeZoomIn },
+};
+const ScreenInput reviewInput = {
+    { nullptr, nullptr, nullptr },
+    { reviewPanLeft, reviewOlder, reviewPanRight },
+    { reviewZoomOut, reviewClose, reviewZoomIn },
+    { reviewPlay, reviewPlayFast, nullptr, nullptr },
+};
+const ScreenInput consoleInput = {
+    { nullptr, nullptr, nullptr },
+    { consolePrevious, consoleNext, consoleRun },
+    { consolePageUp, consoleClose, consolePageDown },
+};
+const ScreenInput fleetInput = {
+    { nullptr, nullptr, nullptr },
+    { fleetStop, nullptr, nullptr },
+    { nullptr, nullptr, nullptr },
+};
+const ScreenInput noInput = {};
+
+// Enter, exit, update and render hooks of each screen
+const ScreenHooks deviceListHooks = { nullptr, nullptr, updateDeviceList, renderDeviceList };
+const ScreenHooks scanningHooks = { nullptr, nullptr, nullptr, displayScanning };
+const ScreenHooks connectingHooks = { nullptr, nullptr, nullptr, displayConnecting };
+const ScreenHooks connectFailedHooks = { nullptr, nullptr, nullptr, displayConnectFailed };
+const ScreenHooks reconnectingHooks = { nullptr, nullptr, nullptr, displayReconnecting };
+const ScreenHooks dashboardHooks = { enterDashboard, nullptr, updateDashboard, nullptr };
+const ScreenHooks statsHooks = { enterStats, nullptr, updateStats, nullptr };
+const ScreenHooks settingsHooks = { enterSettings, nullptr, updateSettings, nullptr };
+const ScreenHooks riderHooks = { enterRider, nullptr, updateRider, nullptr };
+const ScreenHooks pairingHooks = { enterPairing, nullptr, nullptr, renderPairing };
+const ScreenHooks linkHooks = { enterLinkAnalyzer, nullptr, updateLinkAnalyzer, nullptr };
+const ScreenHooks scopeHooks = { enterScope, nullptr, updateScope, renderScope };
+const ScreenHooks consoleHooks = { enterConsole, exitConsole, nullptr, renderConsole };
+const ScreenHooks reviewHooks = { enterReview, exitReview, updateReview, renderReview };
+const ScreenHooks fleetHooks = { nullptr, nullptr, nullptr, renderFleet };
+const ScreenHooks controllersHooks = { enterControllers, nullptr, nullptr, renderControllers };
+const ScreenHooks cellsHooks = { enterCells, nullptr, nullptr, renderCells };
+const ScreenHooks lapsHooks = { enterLaps, nullptr, updateLaps, renderLaps };
+
+Screen deviceListScreen("devices", deviceListHooks, deviceListInput);
+Screen scanningScreen("scanning", scanningHooks, noInput);
+Screen connectingScreen("connecting", connectingHooks, noInput);
+Screen connectFailedScreen("connect failed", connectFailedHooks, noInput);
+Screen reconnectingScreen("reconnecting", reconnectingHooks, reconnectInput);
+Screen statsScreen("stats", statsHooks, statsInput, &statsOverlay);
+Screen settingsScreen("settings", settingsHooks, settingsInput, &settingsPanel);
+Screen riderScreen("rider", riderHooks, riderInput, &riderPanel);
+Screen pairingScreen("pairing", pairingHooks, pairingInput);
+Screen linkScreen("link", linkHooks, linkInput, &linkPanel);
+Screen scopeScreen("scope", scopeHooks, scopeInput);
+Screen consoleScreen("console", consoleHooks, consoleInput);
+Screen reviewScreen("review", reviewHooks, reviewInput);
+Screen fleetScreen("fleet", fleetHooks, fleetInput);
+Screen controllersScreen("controllers", controllersHooks, dashboardInput);
+Screen cellsScreen("cells", cellsHooks, dashboardInput);
+Screen lapsScreen("laps", lapsHooks, lapsInput, &lapsPanel);
+
+// Dim and switch off the display while nobody is looking. A touch on the
+// dark display only wakes it: its events are dropped until the finger
+// lifts, so it cannot press a button nobody could see.
+void updateDisplayPower(uint32_t events) {
+    static bool swallowing = false;
+    uint32_t now = millis();
+    if ((events & APP_EVENT_INPUT) || inputTouchActive()) {
+        if (displayPower.activity(now)) swallowing = true;
+    }
+    if (!sensorsStill() || alertsShown() || activeFault() != 0 || (events & APP_EVENT_CONNECTION)) {
+        displayPower.activity(now);
+    }
+    if (swallowing) {
+        // Checked first: a read that ends after the clear keeps swallowing
+        bool touching = inputTouchActive();
+        inputClear();
+        if (!touching) swallowing = false;
     }
     
-    // Update status text (data age) in lower left
-    String statusText;
-    unsigned long timeSinceUpdate = millis() - lastVoltageUpdate;
-    unsigned long timeSinceConnection = millis() - connectionStartTime;
+    DisplayState was = displayPower.state();
+    DisplayState state = displayPower.update(now);
+    if (!displayPower.changed()) return;
+    static const char* const NAMES[] = { "full", "dimmed", "off" };
+    LOG_I(APP, "Display %s", NAMES[state]);
+    powerSetDisplay(state);
+    // What was on the panel went stale while it was dark
+    if (was == DISPLAY_OFF) screens.redraw();
+}
+
+// Close the log and the capture and commit the lifetime totals, before
+// the board sleeps or restarts
+void closeStorage() {
+    if (SD_LOGGING_ENABLED) telemetryLogStop();
+    captureStopAndSave();
+    uint32_t started = millis();
+    while (SD_LOGGING_ENABLED && !telemetryLogClosed() && millis() - started < PARKING_LOG_CLOSE_MS) delay(10);
+    odometerCommit();
+}
+
+// Sleep deeply while there is nothing to connect to and nobody looking
+// (see parking.h). Parking needs a last VESC to listen for.
+void updateParking() {
+    static uint32_t waitingSince = 0;
+    bool waiting = (connState == CONN_RECONNECTING || connState == CONN_IDLE) &&
+                   displayPower.state() == DISPLAY_OFF && !powerOnUsb();
+    if (!waiting) waitingSince = millis();
+    if (millis() - waitingSince < PARKING_AFTER_MINUTES * 60000u) return;
+    waitingSince = millis();
     
-    if (timeSinceUpdate > VESC_DATA_STALE_TIMEOUT_MS) {
-        if (timeSinceConnection <= CONNECTION_GRACE_PERIOD_MS) {
-            // During grace period, show waiting message
-            statusText = "Waiting...";
-        } else {
-            statusText = "No data";
+    BLEDeviceInfo last;
+    uint8_t address[6];
+    if (lastDevicesLoad(&last, 1) == 0 || !DeviceTable::parseAddress(last.address, address)) return;
+    LOG_I(APP, "No VESC for %d minutes, parking", PARKING_AFTER_MINUTES);
+    closeStorage();
+    parkingEnter(address);
+}
+
+// Fetch firmware while uploading is allowed, restart into a new image
+// once nobody will miss the dashboard, and confirm a new image once it
+// has run for a while
+void updateFirmware() {
+    if (!FEATURE_WIFI) return;
+    if (firmwareUpdateOnTrial() && millis() >= FIRMWARE_CONFIRM_SECONDS * 1000u) firmwareUpdateConfirm();
+    if (!FIRMWARE_UPDATE_ENABLED) return;
+    firmwareUpdateAllow(connState != CONN_CONNECTED || parked);
+    if (!firmwareUpdateReady()) return;
+    if (connState == CONN_CONNECTED && !(parked && displayPower.state() == DISPLAY_OFF)) return;
+    LOG_I(APP, "Restarting into the new firmware");
+    closeStorage();
+    ESP.restart();
+}
+
+// Battery draw, averaged per power mode as samples arrive. When external
+// power goes, or the battery is about to, what is buffered is saved at
+// once: the log's filling block, the trip stats and the lifetime totals.
+// The time from the sample that saw it until the last of them is stored
+// is logged, as seen from this loop.
+void updateSupply() {
+    static uint32_t lastSensorSample = 0;
+    static bool onUsb = false;
+    static bool powerFailing = false;
+    static uint32_t warnedMs = 0;        // 0 while nothing is being saved
+    static uint32_t logTicket = 0;
+    static uint32_t statsTicket = 0;
+    static uint32_t slowestSaveMs = 0;
+    SensorReadings sensors;
+    uint32_t sensorSample = sensorsRead(sensors);
+    if (sensorSample != lastSensorSample) {
+        bool unplugged = lastSensorSample != 0 && onUsb && !sensors.onUsb;
+        lastSensorSample = sensorSample;
+        onUsb = sensors.onUsb;
+        powerSample(sensors.batteryMa, sensors.onUsb);
+        bool failing = !sensors.onUsb && (sensors.lowVoltage || sensors.batteryMv < POWER_LOSS_MV);
+        if (unplugged || (failing && !powerFailing)) {
+            LOG_W(APP, "%s at %d mV, saving what is buffered",
+                  unplugged ? "External power lost" : "Battery low", sensors.batteryMv);
+            warnedMs = sensors.updatedMs != 0 ? sensors.updatedMs : 1;
+            // The card and NVS writes run on their own tasks; the
+            // odometer commit meanwhile runs here
+            logTicket = SD_LOGGING_ENABLED ? telemetryLogFlushNow() : 0;
+            statsTicket = rideStatsSaveNow();
+            odometerCommit();
         }
-    } else {
-        statusText = String(timeSinceUpdate / 1000) + "s ago";
+        powerFailing = failing;
     }
-    
-    // Only update status if changed
-    if (statusText != lastStatusText) {
-        // Clear status area (lower left)
-        M5.Lcd.fillRect(10, 195, 100, 20, BLACK);
-        
-        M5.Lcd.setTextSize(1);
-        if (timeSinceUpdate > VESC_DATA_STALE_TIMEOUT_MS) {
-            if (timeSinceConnection <= CONNECTION_GRACE_PERIOD_MS) {
-                M5.Lcd.setTextColor(YELLOW, BLACK);  // Yellow for waiting during grace period
-            } else {
-                M5.Lcd.setTextColor(RED, BLACK);  // Red for no data after grace period
-            }
-        } else {
-            M5.Lcd.setTextColor(CYAN, BLACK);
-        }
-        M5.Lcd.setCursor(10, 200);
-        M5.Lcd.print(statusText);
-        
-        lastStatusText = statusText;
+    if (warnedMs != 0 && (!SD_LOGGING_ENABLED || telemetryLogFlushed(logTicket)) && rideStatsSaved(statsTicket)) {
+        uint32_t took = millis() - warnedMs;
+        if (took > slowestSaveMs) slowestSaveMs = took;
+        LOG_W(APP, "Buffered data saved %u ms after the power warning (slowest %u ms)", took, slowestSaveMs);
+        warnedMs = 0;
     }
 }
 
-void performBLEScan() {
-    // Clear previous results
-    discoveredDevices.clear();
-    
-    // Show scanning message
-    M5.Lcd.fillScreen(BLACK);
-    M5.Lcd.setTextSize(2);
-    M5.Lcd.setTextColor(WHITE, BLACK);
-    M5.Lcd.setCursor(10, 50);
-    M5.Lcd.println("Scanning for devices...");
-    M5.Lcd.setCursor(10, 80);
-    M5.Lcd.setTextSize(1);
-    M5.Lcd.printf("(%d seconds)", BLE_SCAN_TIME_SECONDS);
-    
-    Serial.println("Starting BLE scan...");
-    
-    BLEScan* pBLEScan = BLEDevice::getScan();
-    pBLEScan->clearResults();
-    
-    // Scan for configured duration
-    BLEScanResults foundDevices = pBLEScan->start(BLE_SCAN_TIME_SECONDS, false);
+void loop() {
+    uint32_t events = waitForNextFrame();
+    uint32_t frameStartUs = micros();
+    taskBudgetStart(TASK_UI);
     
-    Serial.printf("Scan complete. Found %d total devices, %d UART devices.\n", 
-                  foundDevices.getCount(), discoveredDevices.size());
+    // Read the buttons if the panel was touched
+    inputUpdate(events & APP_EVENT_INPUT);
     
-    // Clear screen and display results
-    needsFullRedraw = true;
-    displayDeviceList();
-}
-
-void setup() {
-    // Initialize M5Stack Core2
-    M5.begin();
+    updateSupply();
     
-    // Initialize the display
-    M5.Lcd.fillScreen(BLACK);
-    M5.Lcd.setTextColor(WHITE, BLACK);
-    M5.Lcd.setTextSize(2);
+    // Slow down while parked, back to full rate on the first movement
+    if (sensorsStill() != parked) setParked(sensorsStill());
+    // Upload logs and fetch firmware only while no ride is in progress
+    if (LOG_UPLOAD_ENABLED) logUploadAllow(connState != CONN_CONNECTED || parked);
+    updateFirmware();
     
-    // Display Loading message
-    M5.Lcd.setCursor(10, 50);
-    M5.Lcd.println("Loading...");
+    // Poll fast while a fault window is open; store it when it closes
+    if (faultCaptureUpdate(telemetryHistory(), millis()) != capturing) setCapturing(!capturing);
     
-    // Initialize serial communication
-    Serial.begin(115200);
-    Serial.println("M5Stack Core2 BLE Scanner");
-    Serial.println("System initialized successfully");
+    // Apply state changes from the connection task
+    ConnEvent event;
+    while (connectionManagerPoll(event)) {
+        handleConnectionEvent(event);
+    }
+    if (WIRED_ENABLED) updateWiredLink();
+    soakUpdate();
+    updatePlayback();
+    updateLinkSessions();
+    refreshTelemetry();
+    if (USB_BRIDGE_ENABLED) {
+        // Packets from VESC Tool go out at once, with any polls due
+        usbBridgePoll();
+        flushVESCPackets();
+    }
     
-    // Initialize BLE
-    M5.Lcd.setCursor(10, 80);
-    M5.Lcd.println("Initializing BLE...");
-    Serial.println("Initializing BLE...");
+    updateDisplayPower(events);
+    if (PARKING_ENABLED && !WIRED_ENABLED) updateParking();
     
-    BLEDevice::init("");
-    BLEScan* pBLEScan = BLEDevice::getScan();
-    pBLEScan->setAdvertisedDeviceCallbacks(new MyAdvertisedDeviceCallbacks());
-    pBLEScan->setActiveScan(true);
-    pBLEScan->setInterval(100);
-    pBLEScan->setWindow(99);
+    // Button events go to the screen now showing
+    if (screens.top()) {
+        inputDispatch(screens.top()->input());
+    } else {
+        inputClear();
+    }
     
-    // Perform initial scan
-    performBLEScan();
-}
-
-void loop() {
-    // Update M5Stack Core2 system
-    M5.update();
+    serviceVescUpload();
+    updateEventTrace();
     
-    if (isReconnecting) {
-        // Handle reconnecting state
-        if (M5.BtnA.wasPressed()) {
-            Serial.println("Button A pressed - Cancel reconnection");
-            isReconnecting = false;
-            lastConnectedDeviceIndex = -1;
-            needsFullRedraw = true;
-            displayDeviceList();
-        }
-        
-        if (M5.BtnB.wasPressed()) {
-            Serial.println("Button B pressed - Retry now");
-            lastReconnectAttempt = 0; // Force immediate retry
-        }
+    if (connState == CONN_CONNECTED) {
+        // No telemetry while pushing firmware; the upload has the link
+        if (vescUpload.active()) dataWatchMs = millis();
         
-        // Attempt reconnection at intervals
-        if (millis() - lastReconnectAttempt > RECONNECT_INTERVAL_MS) {
-            Serial.println("Attempting to reconnect...");
-            lastReconnectAttempt = millis();
-            
-            // Try to reconnect to the last device
-            if (lastConnectedDeviceIndex >= 0 && lastConnectedDeviceIndex < discoveredDevices.size()) {
-                if (connectToVESC(lastConnectedDeviceIndex)) {
-                    Serial.println("Reconnection successful!");
-                    needsFullRedraw = true;
-                    isReconnecting = false;
-                    connectionStartTime = millis();  // Reset grace period for reconnection
-                    lastVoltageUpdate = millis();  // Reset data timeout
-                } else {
-                    Serial.println("Reconnection failed, will retry...");
-                }
-            } else {
-                // Device list might have changed, go back to scanning
-                Serial.println("Device not in list, returning to scan");
-                isReconnecting = false;
-                needsFullRedraw = true;
-                performBLEScan();
-            }
-        }
-        
-        // Update reconnecting display
-        displayReconnecting();
-        
-    } else if (isConnected) {
         // Check if connection is stale and should trigger reconnection
-        unsigned long timeSinceUpdate = millis() - lastVoltageUpdate;
+        unsigned long timeSinceUpdate = dataAgeMs(millis());
         unsigned long timeSinceConnection = millis() - connectionStartTime;
         
-        // Only check for stale connection after grace period
+        // Only check for stale connection after grace period. A poor link
+        // is slowed down rather than dropped, so give it longer.
+        unsigned long staleTimeout = settings().staleTimeoutMs;
+        if (worstLinkQuality() == LinkQuality::LINK_POOR) staleTimeout *= LINK_POOR_STALE_FACTOR;
         if (timeSinceConnection > CONNECTION_GRACE_PERIOD_MS) {
-            if (timeSinceUpdate > VESC_DATA_STALE_TIMEOUT_MS && !isReconnecting) {
-                Serial.printf("Connection appears lost (no data for %lums), entering reconnection mode\n", timeSinceUpdate);
-                isConnected = false;
-                isReconnecting = true;
-                lastReconnectAttempt = millis();
-                needsFullRedraw = true;
+            if (timeSinceUpdate > staleTimeout) {
+                LOG_W(APP, "Connection appears lost (no data for %lums), entering reconnection mode", timeSinceUpdate);
+                reportLinkLost(0);
+                // Stop polling until the manager reports the new state
+                connectionStartTime = millis();
+                dataWatchMs = millis();
             }
         } else {
             // During grace period, show status but don't disconnect
-            if (timeSinceUpdate > VESC_DATA_STALE_TIMEOUT_MS) {
-                Serial.printf("Waiting for initial data... (grace period: %lds remaining)\n", 
-                             (CONNECTION_GRACE_PERIOD_MS - timeSinceConnection) / 1000);
+            if (timeSinceUpdate > settings().staleTimeoutMs) {
+                LOG_V(APP, "Waiting for initial data... (grace period: %lds remaining)", 
+                           (CONNECTION_GRACE_PERIOD_MS - timeSinceConnection) / 1000);
             }
         }
         
-        // Handle connected state
-        if (M5.BtnA.wasPressed()) {
-            Serial.println("Button A pressed - Disconnect");
-            if (pClient) {
-                pClient->disconnect();
+        // Send whatever quantities are due as one request per controller,
+        // no faster than the measured round-trip time allows; a request is
+        // skipped while too many are still unanswered
+        if (!vescUpload.active() && millis() - lastTelemetryRequest >= telemetryPollPeriod()) {
+            uint32_t dueFields = pollSchedule.due(millis());
+            if (dueFields != 0 && requestTelemetryAll(dueFields & shownFields)) {
+                pollSchedule.markSent(dueFields, millis());
+                lastTelemetryRequest = millis();
+                coexistPollSent(lastTelemetryRequest, pollReplyWindow());
             }
-            isConnected = false;
-            isReconnecting = false;
-            lastConnectedDeviceIndex = -1;
-            selectedDeviceIndex = 0;
-            needsFullRedraw = true;
-            displayDeviceList();
         }
         
-        if (M5.BtnB.wasPressed()) {
-            Serial.println("Button B pressed - Request voltage");
-            sendVESCPacket(COMM_GET_VALUES);
-        }
+        discoverCanControllers();
+        fetchVescConfigs();
+        pollBms();
+        updateThroughputProbes();
+        fitPollSchedule();
+        updateLinkQuality();
+        updateHeartbeats();
         
-        if (M5.BtnC.wasPressed()) {
-            Serial.println("Button C pressed - Back to device list");
-            if (pClient) {
-                pClient->disconnect();
-            }
-            isConnected = false;
-            isReconnecting = false;
-            lastConnectedDeviceIndex = -1;
-            selectedDeviceIndex = 0;
-            needsFullRedraw = true;
-            displayDeviceList();
-        }
+        // Finish writes the stack had no room for last time
+        flushVESCPackets();
         
-        // Auto-request voltage data at configured interval
-        static unsigned long lastRequest = 0;
-        if (millis() - lastRequest > VESC_DATA_REFRESH_MS) {
-            sendVESCPacket(COMM_GET_VALUES);
-            lastRequest = millis();
-        }
+        // A capture that has filled its buffer is written out right away
+        if (captureFull()) captureStopAndSave();
         
-        // Update voltage display
-        displayVoltage();
+    } else if (connState == CONN_CONNECT_FAILED) {
+        // Leave the failure message up for a moment, then back to the list
+        if (millis() - connectFailedTime > CONNECT_FAILED_DISPLAY_MS) {
+            connState = CONN_IDLE;
+            screens.setRoot(&deviceListScreen);
+        }
         
+    } else if (connState == CONN_IDLE) {
+        // A background scan adds devices and moves their RSSI while the
+        // list is up. Device indices are stable, so the selection follows
+        // its device as the list re-sorts; the rows repaint as they change.
+        uint32_t devicesVersion = connectionManagerDevicesVersion();
+        if (devicesVersion != shownDevicesVersion) {
+            int shownCount = discoveredDevices.size();
+            shownDevicesVersion = devicesVersion;
+            connectionManagerCopyDevices(discoveredDevices);
+            sortDevices();
+            if (selectedDeviceIndex >= discoveredDevices.size()) selectedDeviceIndex = 0;
+            // Redrawing the whole screen is only needed for the header
+            if (discoveredDevices.size() != shownCount) screens.redraw();
+        }
+    }
+    
+    // Show a new screen or repaint what changed on the current one, once
+    // per render slot at most and only if something may have changed
+    uint32_t lateUs = 0;
+    static bool frameShown = false;
+    bool rendering = displayPower.state() != DISPLAY_OFF && renderGovernor.due(micros(), lateUs);
+    if (rendering) {
+        perfNoteFrameStart(lateUs);
+        PROBE_SCOPE("screen");
+        // The card gets the bus between renders, not in the middle of one
+        spiBusRenderBegin();
+        uint32_t frameStartUs = micros();
+        traceEvent(TRACE_RENDER_START, 0, 0);
+        screens.frame();
+        frameShown = true;
+        traceEvent(TRACE_RENDER_END, 0, 0);
+        perfNoteFramePushed(frameStartUs, micros());
+        screenshotFrame(displayPanel());
+        spiBusRenderEnd(1000 / settings().targetFps);
     } else {
-        // Handle scanning/selection state
-        if (M5.BtnA.wasPressed()) {
-            Serial.println("Button A pressed - Rescanning");
-            selectedDeviceIndex = 0;
-            performBLEScan();
+        perfNoteFrameSkipped();
+    }
+    if (frameShown) prerenderScreens();
+    
+    // Past the grace period a connected UI loop runs on what setup()
+    // allocated; alloc-trace builds hold it to that
+    heapAllocSetSteady(connState == CONN_CONNECTED &&
+                       millis() - connectionStartTime >= (unsigned long)CONNECTION_GRACE_PERIOD_MS);
+    
+    // Heap readout so long soak runs can confirm memory stays flat
+    static unsigned long lastHeapLog = 0;
+    if (millis() - lastHeapLog >= HEAP_LOG_INTERVAL_MS) {
+        lastHeapLog = millis();
+        heapStatsLog("periodic");
+        bondingLogStats();
+        if (responseCacheHits > 0) LOG_I(APP, "Response cache: %u fields left out of requests", (unsigned)responseCacheHits);
+        ScanStats scan;
+        connectionManagerScanStats(scan);
+        if (scan.expectedScans > 0) {
+            LOG_I(APP, "Discovery: last used VESC in %u ms avg over %u of %u scans, %u turned active",
+                  (unsigned)(scan.expectedTotalMs / scan.expectedScans), (unsigned)scan.expectedScans,
+                  (unsigned)scan.scans, (unsigned)scan.activeSwitches);
         }
-        
-        if (M5.BtnB.wasPressed()) {
-            Serial.println("Button B pressed - Navigate devices");
-            if (!discoveredDevices.empty()) {
-                selectedDeviceIndex = (selectedDeviceIndex + 1) % discoveredDevices.size();
-                displayDeviceList();
-            }
+        if (faultCaptureCount() > 0) LOG_I(APP, "Fault captures: %d stored", faultCaptureCount());
+        if (LOG_UPLOAD_ENABLED) {
+            LogUploadStats upload = logUploadStats();
+            LOG_I(APP, "Upload: WiFi %s, %u files, %u bytes, %u failures%s%s",
+                  upload.wifiConnected ? "up" : "down", upload.filesUploaded, upload.bytesUploaded,
+                  upload.failures, upload.current[0] ? ", now " : "", upload.current);
         }
-        
-        if (M5.BtnC.wasPressed()) {
-            Serial.println("Button C pressed - Connect to selected device");
-            if (!discoveredDevices.empty() && selectedDeviceIndex < discoveredDevices.size()) {
-                M5.Lcd.fillScreen(BLACK);
-                M5.Lcd.setTextSize(2);
-                M5.Lcd.setTextColor(YELLOW, BLACK);
-                M5.Lcd.setCursor(10, 100);
-                M5.Lcd.println("Connecting...");
-                
-                if (connectToVESC(selectedDeviceIndex)) {
-                    needsFullRedraw = true;
-                    displayVoltage();
-                } else {
-                    needsFullRedraw = true;
-                    M5.Lcd.setTextColor(RED, BLACK);
-                    M5.Lcd.setCursor(10, 100);
-                    M5.Lcd.println("Connection failed");
-                    delay(2000);
-                    M5.Lcd.fillScreen(BLACK);
-                    displayDeviceList();
-                }
+        if (FIRMWARE_UPDATE_ENABLED) {
+            static const char* STATE_NAMES[] = { "idle", "downloading", "ready" };
+            FirmwareUpdateStats update = firmwareUpdateStats();
+            LOG_I(APP, "Firmware: %s %u/%u bytes, %u checks, %u failures", STATE_NAMES[update.state],
+                  update.received, update.total, update.checks, update.failures);
+        }
+        if (LOG_SERVICE_ENABLED) {
+            LogServiceStats service = logServiceStats();
+            LOG_I(APP, "Log service: phone %s (MTU %u), %u files, %u bytes sent, %u ms congested",
+                  service.connected ? "connected" : "away", service.mtu, service.filesSent, service.bytesSent,
+                  service.congestedMs);
+        }
+        {
+            static const char* USER_NAMES[COEXIST_USER_COUNT] = { "SD write", "SD read", "WiFi", "flash" };
+            CoexistStats coexist = coexistStats();
+            for (int u = 0; u < COEXIST_USER_COUNT; u++) {
+                const CoexistUserStats& user = coexist.users[u];
+                if (user.bursts == 0) continue;
+                LOG_I(APP, "Coexist: %s %u bursts, %u deferred, %u forced, %u ms waited", USER_NAMES[u],
+                      user.bursts, user.deferred, user.forced, user.waitedMs);
             }
         }
+        SpiBusStats bus = spiBusStats();
+        if (bus.slices > 0) {
+            LOG_I(APP, "SPI bus: %u card slices, %u deferred, %u forced, %u ms waited; %u renders waited (max %u us)",
+                  bus.slices, bus.slicesDeferred, bus.slicesForced, bus.cardWaitMs, bus.renderWaits,
+                  bus.renderWaitMaxUs);
+        }
+        if (USB_BRIDGE_ENABLED) {
+            UsbBridgeStats bridge = usbBridgeStats();
+            LOG_I(APP, "USB bridge: %u packets to the VESC, %u bytes to the host (%u dropped), %u host errors",
+                  bridge.packetsToVesc, bridge.bytesToHost, bridge.bytesDropped, bridge.hostErrors);
+        }
+        if (SERIAL_STREAM_ENABLED) LOG_I(APP, "Serial stream: %u records dropped", serialStreamDropped());
+        {
+            I2cBusStats i2c = i2cBusStats();
+            LOG_I(APP, "I2C bus: %u touch, %u IMU, %u control, %u slow jobs, %u dropped; waits max %u/%u/%u/%u us, "
+                  "longest job %u us", i2c.jobs[I2C_PRIORITY_TOUCH], i2c.jobs[I2C_PRIORITY_IMU],
+                  i2c.jobs[I2C_PRIORITY_CONTROL], i2c.jobs[I2C_PRIORITY_SLOW], i2c.dropped,
+                  i2c.waitMaxUs[I2C_PRIORITY_TOUCH], i2c.waitMaxUs[I2C_PRIORITY_IMU],
+                  i2c.waitMaxUs[I2C_PRIORITY_CONTROL], i2c.waitMaxUs[I2C_PRIORITY_SLOW], i2c.jobMaxUs);
+        }
+        if (IMU_ENABLED) {
+            ImuStats imu = imuStats();
+            LOG_I(APP, "IMU: %u samples in %u FIFO bursts, %u overflows", imu.samples, imu.reads, imu.overflows);
+        }
+        if (LIVE_STREAM_ENABLED) {
+            LiveStreamStats stream = liveStreamStats();
+            LOG_I(APP, "Live stream: %d clients, %u frames sent, %u dropped, %u samples missed", stream.clients,
+                  stream.framesSent, stream.framesDropped, stream.samplesMissed);
+        }
+#ifdef HEAP_ALLOC_TRACE
+        // The render path should not touch the heap once connected
+        static uint32_t lastAllocCount = 0;
+        uint32_t allocCount = heapAllocCount();
+        LOG_I(APP, "UI loop heap allocations: %u in the last %ds",
+              allocCount - lastAllocCount, HEAP_LOG_INTERVAL_MS / 1000);
+        lastAllocCount = allocCount;
+        static uint32_t lastSteadyCount = 0;
+        uint32_t steadyCount = heapAllocSteadyCount();
+        if (steadyCount != lastSteadyCount) {
+            LOG_E(APP, "UI loop allocated %u times while connected", steadyCount - lastSteadyCount);
+            lastSteadyCount = steadyCount;
+        }
+#endif
+        LOG_I(PROTO, "Requests: RTT %ums (avg %ums, var %ums), poll %ums, %u timeouts",
+              requestTracker.lastRtt(), requestTracker.smoothedRtt(), requestTracker.rttVariance(),
+              requestTracker.pollPeriod(), requestTracker.timeouts());
+        for (uint8_t link = 0; link < VESC_MAX_LINKS; link++) {
+            if (!(sessionLinks & (1u << link))) continue;
+            LOG_I(PROTO, "Link %d (%s, score %d): %u frames sent in %u writes (%u bytes each at most, %s response), "
+                         "%u deferred, %u dropped, %u errors, %u/%u control/telemetry over rate", link,
+                  LinkQuality::levelName(linkQuality[link].level()), linkQuality[link].score(),
+                  vescTx[link].framesQueued(), vescTx[link].writesIssued(), (unsigned)vescTx[link].writeLimit(),
+                  vescLinks[link]->writesWithoutResponse() ? "without" : "with",
+                  vescLinks[link]->writesDeferred(), vescTx[link].framesDropped(), vescLinks[link]->writeErrors(),
+                  vescTx[link].framesLimited(VescTxScheduler::CONTROL),
+                  vescTx[link].framesLimited(VescTxScheduler::TELEMETRY));
+        }
+        BleCallStats calls = bleCallStats();
+        LOG_I(BLE, "BLE calls: %u watched, connect/discovery/subscribe %u/%u/%u past deadline, slowest %u/%u/%u ms",
+              calls.calls, calls.expired[BLE_CALL_CONNECT], calls.expired[BLE_CALL_DISCOVER],
+              calls.expired[BLE_CALL_SUBSCRIBE], calls.slowestMs[BLE_CALL_CONNECT],
+              calls.slowestMs[BLE_CALL_DISCOVER], calls.slowestMs[BLE_CALL_SUBSCRIBE]);
+        for (uint8_t i = 1; i < TELEMETRY_MAX_CONTROLLERS; i++) {
+            if (!controllerActive(i)) continue;
+            LOG_I(PROTO, "Controller %d (link %d%s): RTT %ums (avg %ums), %u timeouts", i, controllerLink(i),
+                  i >= VESC_MAX_LINKS ? ", CAN" : "",
+                  requestTrackers[i].lastRtt(), requestTrackers[i].smoothedRtt(), requestTrackers[i].timeouts());
+        }
+        TelemetryLogStats logStats;
+        logStats.active = false;
+        if (SD_LOGGING_ENABLED) logStats = telemetryLogStats();
+        if (logStats.active) {
+            LOG_I(APP, "SD log: %u records, %u dropped, %u bytes written, slowest write %ums",
+                  logStats.records, logStats.dropped, logStats.bytesWritten, logStats.slowestWriteMs);
+        }
+        logPerfStats();
     }
     
-    // Small delay to prevent overwhelming the system
-    delay(50);
+    if (rendering) perfNoteFrameWork(micros() - frameStartUs);
+    taskBudgetEnd(TASK_UI);
 }
@@ -0,0 +1,28 @@
+#pragma once
+
+// The little of the Arduino core the UI and history code use, for the
+// SDL simulator. Time comes from SDL through M5GFX's platform layer.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+uint32_t millis();
+uint32_t micros();
+void delay(uint32_t ms);
+
+// Log output goes to stdout
+class SimSerial {
+public:
+    int printf(const char* format, ...) __attribute__((format(printf, 2, 3)));
+    size_t print(const char* text) { return fputs(text, stdout) < 0 ? 0 : strlen(text); }
+    size_t println(const char* text = "") { return print(text) + print("\n"); }
+};
+
+extern SimSerial Serial;
+
+// arduino-esp32 brings in FreeRTOS as well
+#include "freertos/task.h"
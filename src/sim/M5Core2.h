@@ -0,0 +1,18 @@
+#pragma once
+
+// Stand-in for the M5Core2 library in the SDL simulator (the native_sdl
+// environment). The simulator builds the UI on the M5GFX display backend
+// (DISPLAY_M5GFX, see ui/display.h), here drawing into an SDL window, and
+// sim_platform.cpp stands in for ui/display.cpp over M5.Lcd. Buttons and
+// touch come from sim_input.cpp instead of the library's M5.BtnA..C and
+// M5.Touch, and scroll_view.cpp, which drives the ILI9341's hardware
+// scroll, is left out of the build.
+
+#include <M5GFX.h>
+#include "Arduino.h"
+
+struct M5Core2Sim {
+    M5GFX Lcd;
+};
+
+extern M5Core2Sim M5;
@@ -0,0 +1,7 @@
+#pragma once
+
+// Only what system/memory.h names, for the SDL simulator
+
+#include <stdint.h>
+
+typedef void* TaskHandle_t;
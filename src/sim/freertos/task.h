@@ -0,0 +1,7 @@
+#pragma once
+
+#include "FreeRTOS.h"
+#include "../Arduino.h"
+
+// One tick is a millisecond, as on the dashboard
+inline void vTaskDelay(uint32_t ticks) { delay(ticks); }
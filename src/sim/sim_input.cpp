@@ -0,0 +1,132 @@
+// ui/input.cpp for the SDL simulator: the left, down and right arrow
+// keys are buttons A, B and C (GPIO 39, 38 and 37 of M5GFX's SDL key
+// mapping, low while held) and the mouse is the finger on the display.
+// Events and their timing are the same as on the dashboard.
+
+#include "../ui/input.h"
+
+#include "M5Core2.h"
+
+static const uint8_t QUEUE_LENGTH = 8;
+static const int16_t DISPLAY_HEIGHT = 240;
+static const uint16_t SWIPE_MIN_DISTANCE = 80;  // Pixels the finger has to travel
+static const uint16_t SWIPE_MAX_SLOPE = 577;    // tan(30°) x1000: degrees either side of the direction
+static const uint16_t SWIPE_MAX_MS = 500;       // A slower drag is not a swipe
+static const uint8_t BUTTON_PINS[INPUT_BUTTON_COUNT] = { 39, 38, 37 };
+
+static uint32_t holdTimeMs = 700;
+static InputEvent queue[QUEUE_LENGTH];
+static uint8_t head = 0;
+static uint8_t count = 0;
+static uint32_t dropped = 0;
+static bool touchActive = false;
+static int16_t touchX = -1;
+static int16_t touchY = -1;
+static int16_t startX = 0;
+static int16_t startY = 0;
+static uint32_t startMs = 0;
+static bool held[INPUT_BUTTON_COUNT] = {};
+static uint32_t pressedMs[INPUT_BUTTON_COUNT] = {};
+
+static void push(InputButton button, InputAction action, InputSwipe swipe = INPUT_SWIPE_LEFT) {
+    if (count == QUEUE_LENGTH) {
+        dropped++;
+        return;
+    }
+    InputEvent& event = queue[(head + count) % QUEUE_LENGTH];
+    event.button = button;
+    event.action = action;
+    event.swipe = swipe;
+    count++;
+}
+
+// A quick, straight drag from where the finger went down to where it
+// lifted: sideways, down or up
+static void checkSwipe(uint32_t now) {
+    int32_t dx = touchX - startX;
+    int32_t dy = touchY - startY;
+    int32_t across = dx < 0 ? -dx : dx;
+    int32_t rise = dy < 0 ? -dy : dy;
+    if (now - startMs > SWIPE_MAX_MS || startY >= DISPLAY_HEIGHT) return;
+    if (across >= SWIPE_MIN_DISTANCE && rise * 1000 <= across * SWIPE_MAX_SLOPE) {
+        push(INPUT_BUTTON_A, INPUT_SWIPE, dx < 0 ? INPUT_SWIPE_LEFT : INPUT_SWIPE_RIGHT);
+    } else if (rise >= SWIPE_MIN_DISTANCE && across * 1000 <= rise * SWIPE_MAX_SLOPE) {
+        push(INPUT_BUTTON_A, INPUT_SWIPE, dy > 0 ? INPUT_SWIPE_DOWN : INPUT_SWIPE_UP);
+    }
+}
+
+void inputBegin(uint32_t holdMs) {
+    holdTimeMs = holdMs;
+    inputClear();
+}
+
+void inputUpdate(bool touchInterrupt) {
+    uint32_t now = millis();
+    int32_t x, y;
+    bool touching = M5.Lcd.getTouch(&x, &y) > 0;
+    if (touching && !touchActive) {
+        startX = x;
+        startY = y;
+        startMs = now;
+    }
+    if (touching) {
+        touchX = x;
+        touchY = y;
+    } else if (touchActive) {
+        checkSwipe(now);
+    }
+    touchActive = touching;
+
+    for (uint8_t i = 0; i < INPUT_BUTTON_COUNT; i++) {
+        InputButton button = (InputButton)i;
+        bool down = !lgfx::gpio_in(BUTTON_PINS[i]);
+        if (down && !held[i]) {
+            pressedMs[i] = now;
+            push(button, INPUT_PRESS);
+        } else if (!down && held[i]) {
+            push(button, now - pressedMs[i] >= holdTimeMs ? INPUT_HOLD : INPUT_TAP);
+        }
+        held[i] = down;
+    }
+}
+
+bool inputTouchActive() {
+    return touchActive;
+}
+
+bool inputTouchPoint(int16_t& x, int16_t& y) {
+    if (!touchActive || touchX < 0 || touchY < 0 || touchY >= DISPLAY_HEIGHT) return false;
+    x = touchX;
+    y = touchY;
+    return true;
+}
+
+bool inputNext(InputEvent& event) {
+    if (count == 0) return false;
+    event = queue[head];
+    head = (head + 1) % QUEUE_LENGTH;
+    count--;
+    return true;
+}
+
+void inputDispatch(const ScreenInput& screen) {
+    InputEvent event;
+    while (inputNext(event)) {
+        if (event.action == INPUT_SWIPE) {
+            if (screen.swipe[event.swipe]) screen.swipe[event.swipe]();
+            continue;
+        }
+        const InputHandler* handlers = event.action == INPUT_PRESS ? screen.press :
+                                       (event.action == INPUT_TAP ? screen.tap : screen.hold);
+        if (handlers[event.button]) handlers[event.button]();
+    }
+}
+
+void inputClear() {
+    head = 0;
+    count = 0;
+}
+
+uint32_t inputDropped() {
+    return dropped;
+}
@@ -0,0 +1,337 @@
+// Simulator of the dashboard screens on the host, for UI work (dirty
+// rectangles, sprite strategies, layouts) without flashing. Built by the
+// `native_sdl` PlatformIO environment, which needs SDL2:
+//
+//   pio run -e native_sdl
+//   .pio/build/native_sdl/program [-b bits] [-l layout.bin] [ride0001.vdl]
+//
+// The layout pages, their widgets and the screen stack are the
+// dashboard's own, drawn by M5GFX into a 320x240 SDL window. Telemetry
+// comes from vesc/emulator.h, polled through the framer and decoders the
+// dashboard uses; given a ride log it is replayed instead, at the pace it
+// was recorded. -b sets the bits a pixel of the retained page images
+// (16, 8 or 4, 0 for none) and -l loads a layout file in place of the
+// built-in one.
+//
+// The left, down and right arrow keys are buttons A, B and C and the
+// mouse is a finger: B or a swipe to the left turns to the next page, A
+// or a swipe to the right back. Keys 1 to 6 scale the window. Every
+// SIM_REPORT_MS the frame rate and the average and longest frame times
+// are printed, as measured on the host; the numbers are for comparing
+// one change with another, not for the ESP32's own.
+
+#include "M5Core2.h"
+#include "../ui/display.h"
+#include "../ui/input.h"
+#include "../ui/layout.h"
+#include "../ui/layout_page.h"
+#include "../ui/render_governor.h"
+#include "../ui/screen.h"
+#include "../ui/unicode_text.h"
+#include "../vesc/change_tracker.h"
+#include "../vesc/emulator.h"
+#include "../vesc/framer.h"
+#include "../vesc/packet.h"
+#include "../vesc/protocol.h"
+#include "../vesc/values.h"
+#include "../storage/log_format.h"
+#include "../telemetry/derived.h"
+#include "../telemetry/drivetrain.h"
+#include "../telemetry/energy.h"
+#include "../telemetry/history.h"
+#include "../telemetry/ride_stats.h"
+#include "../telemetry/soc.h"
+
+#include <vector>
+
+// Simulator Settings. The pack, drivetrain and rates are main.cpp's
+// defaults.
+static const uint8_t SIM_TARGET_FPS = 30;
+static const uint32_t SIM_IDLE_MS = 250;
+static const uint32_t SIM_HOLD_MS = 700;
+static const uint32_t SIM_POLL_US = 1000000 / 20;        // COMM_GET_VALUES at 20 Hz
+static const uint32_t SIM_REPORT_MS = 5000;
+static const uint32_t SIM_MAX_GAP_MS = 1000;             // Longest pause kept when replaying a log
+static const uint32_t SIM_HISTORY_CAPACITY = 10 * 60 * 20;
+static const uint8_t SIM_PYRAMID_LEVELS = 8;
+static const uint32_t SIM_PYRAMID_BUCKETS = 640;
+static const size_t SIM_ARCHIVE_BYTES = 1024 * 1024;
+static const uint8_t SIM_RETAINED_BITS = 8;
+static const uint16_t SIM_GLYPH_CELLS = 512;
+static const BatteryChemistry SIM_CHEMISTRY = CHEMISTRY_LI_ION;
+static const uint8_t SIM_BATTERY_CELLS = 12;
+static const uint32_t SIM_BATTERY_CAPACITY_MAH = 12000;
+static const uint16_t SIM_BATTERY_RESISTANCE_MOHM = 100;
+static const uint32_t SIM_SOC_SMOOTHING_MS = 5000;
+static const uint32_t SIM_ENERGY_RECENT_METERS = 2000;
+static const uint32_t SIM_ENERGY_MIN_METERS = 200;
+static const DrivetrainConfig SIM_DRIVETRAIN = { 14, 100, 90 };
+static const VescFirmware SIM_FIRMWARE = { 6, 2 };
+
+// Where the telemetry comes from
+static std::vector<LogSample> rideLog;   // Empty for the emulator
+static size_t rideNext = 0;
+static uint32_t rideClockMs = 0;         // Log time shown so far
+static uint32_t rideLastMs = 0;
+
+static uint8_t retainedBits = SIM_RETAINED_BITS;
+static const char* layoutPath = nullptr;
+
+// What the dashboard shows
+static Layout layout;
+static LayoutPageView views[Layout::MAX_PAGES];
+static Screen* pages[Layout::MAX_PAGES];
+static uint8_t page = 0;
+static ScreenStack screens(&M5.Lcd);
+static RenderGovernor governor;
+
+static VescValues shown = {};
+static uint32_t shownVersion = 0;
+static uint32_t shownChanged = 0;
+static uint32_t lastSampleMs = 0;
+static ValuesChangeTracker tracker;
+static TelemetryHistory history;
+static Drivetrain drivetrain;
+static DerivedValues derived(&drivetrain);
+static EnergyEstimator energy;
+static SocEstimator soc;
+static RideStats ride = {};
+
+static bool readFile(const char* path, std::vector<uint8_t>& out) {
+    FILE* file = fopen(path, "rb");
+    if (file == nullptr) return false;
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    out.resize(size > 0 ? size : 0);
+    bool ok = size >= 0 && fread(out.data(), 1, out.size(), file) == out.size();
+    fclose(file);
+    return ok;
+}
+
+// Every sample of the leading run of valid blocks
+static bool loadRide(const char* path) {
+    std::vector<uint8_t> data;
+    LogFileHeader header;
+    if (!readFile(path, data) || data.size() < LOG_SECTOR_SIZE) return false;
+    memcpy(&header, data.data(), sizeof(header));
+    if (header.magic != LOG_MAGIC || header.version != LOG_FORMAT_VERSION ||
+        header.valueCount != LOG_VALUE_COUNT) return false;
+
+    size_t offset = LOG_SECTOR_SIZE;
+    while (offset + sizeof(LogBlockHeader) <= data.size()) {
+        LogBlockHeader block;
+        memcpy(&block, data.data() + offset, sizeof(block));
+        const uint8_t* payload = data.data() + offset + sizeof(block);
+        if (block.magic != LOG_BLOCK_MAGIC || block.payloadLength > data.size() - offset - sizeof(block) ||
+            logCrc32(logBlockHeaderCrc(block), payload, block.payloadLength) != block.crc) break;
+        LogSample previous = {};
+        LogSample sample;
+        size_t used;
+        for (size_t at = 0; at < block.payloadLength; at += used) {
+            used = logDecodeFrame(payload + at, block.payloadLength - at, previous, sample);
+            if (used == 0) break;
+            rideLog.push_back(sample);
+            previous = sample;
+        }
+        offset += logBlockSpan(block.payloadLength);
+    }
+    return !rideLog.empty();
+}
+
+static bool loadLayout(const char* path) {
+    std::vector<uint8_t> data;
+    return readFile(path, data) && layoutParse(data.data(), data.size(), layout);
+}
+
+// A combined sample, as the telemetry task hands one to the UI
+static void publish(const VescValues& values, uint32_t timeMs) {
+    shown = values;
+    shownVersion++;
+    shownChanged |= tracker.update(values);
+    lastSampleMs = millis();
+    history.append(values, timeMs);
+    energy.update(values, 1);
+    int32_t fields[HISTORY_FIELD_COUNT];
+    historySample(values, fields);
+    for (int i = 0; i < HISTORY_FIELD_COUNT; i++) ride.fields[i].add(fields[i]);
+    governor.request(micros());
+}
+
+static void onReply(const uint8_t* payload, size_t length, void* context) {
+    VescValues values = {};
+    if (length < 1 || payload[0] != COMM_GET_VALUES) return;
+    if (!decodeValues(payload, length, valuesLayoutForFirmware(SIM_FIRMWARE), values)) return;
+    values.soc = soc.update(values.vIn, values.currentIn, millis());
+    publish(values, millis());
+}
+
+static VescFramer framer(onReply);
+
+static void emulatorOutput(const uint8_t* data, size_t length, void* context) {
+    framer.feed(data, length);
+}
+
+static const EmulatorConfig EMULATOR = { 0, nullptr, 0, SIM_FIRMWARE.major, SIM_FIRMWARE.minor, 4000, 2000, 20, 0, 1 };
+static VescEmulator emulator(EMULATOR, emulatorOutput);
+
+static void pollEmulator() {
+    static uint64_t nextPollUs = 0;
+    uint64_t now = (uint64_t)millis() * 1000;
+    if (now >= nextPollUs) {
+        nextPollUs = now + SIM_POLL_US;
+        uint8_t command = COMM_GET_VALUES;
+        uint8_t packet[1 + VESC_PACKET_MAX_OVERHEAD];
+        emulator.receive(packet, vescEncodePacket(&command, 1, packet), now);
+    }
+    emulator.poll(now);
+}
+
+// Samples of the log that are due, with long gaps cut short
+static void pollRide() {
+    uint32_t now = millis();
+    while (rideNext < rideLog.size()) {
+        const LogSample& sample = rideLog[rideNext];
+        uint32_t gap = rideNext == 0 ? 0 : sample.timeMs - rideLog[rideNext - 1].timeMs;
+        if (gap > SIM_MAX_GAP_MS) gap = SIM_MAX_GAP_MS;
+        if (rideNext > 0 && now - rideLastMs < gap) return;
+        rideLastMs = rideNext == 0 ? now : rideLastMs + gap;
+        rideClockMs += gap;
+        VescValues values = {};
+        logValuesFromSample(sample, values);
+        publish(values, rideClockMs);
+        rideNext++;
+    }
+}
+
+// ---- Dashboard ----
+
+void enterPage() {
+    shownChanged = VALUES_ALL_FIELDS;
+}
+
+void updatePage() {
+    char status[16];
+    uint32_t age = millis() - lastSampleMs;
+    snprintf(status, sizeof(status), "%lus ago", (unsigned long)(age / 1000));
+    derived.setSample(shown, shownVersion);
+    LayoutSample sample = { &shown, &derived, shownChanged, &history, &energy.estimate(), &ride, 100, 1,
+                            shownVersion ? status : "Waiting...", (uint16_t)(shownVersion ? CYAN : YELLOW) };
+    views[page].update(sample);
+    shownChanged = 0;
+}
+
+void turnPage(bool forward) {
+    page = (page + (forward ? 1 : layout.pageCount - 1)) % layout.pageCount;
+    screens.setRoot(pages[page], forward ? SLIDE_LEFT : SLIDE_RIGHT);
+}
+
+void nextPage() { turnPage(true); }
+void previousPage() { turnPage(false); }
+
+const ScreenHooks pageHooks = { enterPage, nullptr, updatePage, nullptr };
+const ScreenInput pageInput = {
+    { nullptr, nullptr, nullptr },
+    { previousPage, nextPage, nullptr },
+    { nullptr, nullptr, nullptr },
+    { nextPage, previousPage },
+};
+
+static void setupDashboard() {
+    if (layoutPath == nullptr || !loadLayout(layoutPath)) {
+        if (layoutPath) Serial.printf("%s is not a valid layout, using the built-in one\n", layoutPath);
+        layoutDefault(layout);
+    }
+    for (uint8_t i = 0; i < layout.pageCount; i++) {
+        views[i].build(&M5.Lcd, layout, i);
+        pages[i] = new Screen(layout.label(layout.pages[i].name), pageHooks, pageInput, &views[i].compositor());
+        if (retainedBits) pages[i]->retain(&M5.Lcd, retainedBits);
+    }
+    screens.setRoot(pages[0]);
+}
+
+static void setupTelemetry() {
+    drivetrain.configure(SIM_DRIVETRAIN);
+    SocConfig battery = { SIM_CHEMISTRY, SIM_BATTERY_CELLS, SIM_BATTERY_RESISTANCE_MOHM, SIM_SOC_SMOOTHING_MS };
+    soc.configure(battery);
+    EnergyConfig pack = { SIM_CHEMISTRY, SIM_BATTERY_CELLS, SIM_BATTERY_CAPACITY_MAH, SIM_ENERGY_RECENT_METERS,
+                          SIM_ENERGY_MIN_METERS };
+    energy.configure(pack, drivetrain);
+    history.begin(SIM_HISTORY_CAPACITY, SIM_PYRAMID_LEVELS, SIM_PYRAMID_BUCKETS, SIM_ARCHIVE_BYTES);
+}
+
+// Frame rate and frame times since the last report
+static void reportFrame(uint32_t frameUs) {
+    static uint32_t frames = 0, totalUs = 0, longestUs = 0, since = 0;
+    frames++;
+    totalUs += frameUs;
+    if (frameUs > longestUs) longestUs = frameUs;
+    uint32_t now = millis();
+    if (now - since < SIM_REPORT_MS) return;
+    Serial.printf("%s: %u fps, frame %u us average, %u us longest\n", pages[page]->name(),
+                  (unsigned)(frames * 1000 / (now - since)), (unsigned)(totalUs / frames), (unsigned)longestUs);
+    frames = totalUs = longestUs = 0;
+    since = now;
+}
+
+static int simLoop(bool* running) {
+    displayBegin();
+    M5.Lcd.fillScreen(BLACK);
+    unicodeTextBegin(&M5.Lcd, SIM_GLYPH_CELLS);
+    inputBegin(SIM_HOLD_MS);
+    governor.setRate(SIM_TARGET_FPS, SIM_IDLE_MS);
+    setupTelemetry();
+    setupDashboard();
+
+    while (*running) {
+        if (rideLog.empty()) {
+            pollEmulator();
+        } else {
+            pollRide();
+        }
+        inputUpdate(false);
+        if (Screen* top = screens.top()) inputDispatch(top->input());
+        if (inputTouchActive() || screens.animating()) governor.request(micros());
+
+        uint32_t lateUs;
+        if (governor.due(micros(), lateUs)) {
+            uint32_t started = micros();
+            screens.frame();
+            reportFrame(micros() - started);
+        }
+        delay(1);
+    }
+    return 0;
+}
+
+static void usage() {
+    fprintf(stderr, "usage: program [-b 16|8|4|0] [-l layout.bin] [ride.vdl]\n");
+}
+
+int main(int argc, char** argv) {
+    const char* ridePath = nullptr;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-b") == 0 && i + 1 < argc) {
+            retainedBits = (uint8_t)atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-l") == 0 && i + 1 < argc) {
+            layoutPath = argv[++i];
+        } else if (argv[i][0] == '-') {
+            usage();
+            return 2;
+        } else {
+            ridePath = argv[i];
+        }
+    }
+    if (retainedBits != 0 && retainedBits != 4 && retainedBits != 8 && retainedBits != 16) {
+        usage();
+        return 2;
+    }
+    if (ridePath) {
+        if (!loadRide(ridePath)) {
+            fprintf(stderr, "%s: not a ride log, or no valid blocks\n", ridePath);
+            return 1;
+        }
+        Serial.printf("Replaying %u samples of %s\n", (unsigned)rideLog.size(), ridePath);
+    }
+    return lgfx::Panel_sdl::main(simLoop);
+}
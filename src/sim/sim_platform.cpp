@@ -0,0 +1,72 @@
+// What the simulator has in place of the Arduino core, the M5Core2
+// library, the display backend and the firmware's allocator
+
+#include "M5Core2.h"
+#include "../system/memory.h"
+#include "../ui/display.h"
+
+SimSerial Serial;
+M5Core2Sim M5;
+
+uint32_t millis() {
+    return (uint32_t)lgfx::millis();
+}
+
+uint32_t micros() {
+    return (uint32_t)lgfx::micros();
+}
+
+void delay(uint32_t ms) {
+    lgfx::delay(ms);
+}
+
+int SimSerial::printf(const char* format, ...) {
+    va_list args;
+    va_start(args, format);
+    int n = vprintf(format, args);
+    va_end(args);
+    return n;
+}
+
+void displayBegin() {
+    M5.Lcd.init();
+}
+
+DisplayGfx& displayPanel() {
+    return M5.Lcd;
+}
+
+// The SDL panel has no controller to command
+void displayCommand(uint8_t command, const uint8_t* data, size_t length) {}
+
+const char* displayBackendName() {
+    return "M5GFX (SDL)";
+}
+
+// Nor any DMA; everything is pushed by the library
+bool displayLinePoolBegin(uint16_t lines) {
+    return false;
+}
+
+void displayPushImage(DisplayGfx* target, int32_t x, int32_t y, int32_t w, int32_t h, const uint16_t* pixels,
+                      int32_t stride) {
+    bool oldSwapBytes = target->getSwapBytes();
+    target->setSwapBytes(false);
+    for (int32_t row = 0; row < h; row++) target->pushImage(x, y + row, w, 1, (uint16_t*)pixels + row * stride);
+    target->setSwapBytes(oldSwapBytes);
+}
+
+void displayPushSprite(DisplaySprite& sprite, int32_t x, int32_t y) {
+    sprite.pushSprite(x, y);
+}
+
+// One kind of memory on the host; the tags are not counted
+void* memoryAlloc(size_t bytes, MemoryPlace place, MemoryTag tag) {
+    void* buffer = malloc(bytes);
+    if (buffer == nullptr) Serial.printf("Could not allocate %u bytes\n", (unsigned)bytes);
+    return buffer;
+}
+
+void memoryFree(void* buffer) {
+    free(buffer);
+}
@@ -0,0 +1,101 @@
+#include "config_cache.h"
+#include "../log.h"
+
+#include <Arduino.h>
+#include <Preferences.h>
+#include <string.h>
+
+static const char* NVS_NAMESPACE = "vescconf";
+static const uint8_t ENTRY_VERSION = 2;
+static const int RAM_SLOTS = 4;
+
+struct StoredEntry {
+    uint8_t version;
+    uint32_t firmwareHash;
+    VescConfig config;
+};
+
+struct RamSlot {
+    bool used;
+    uint32_t uuidHash;
+    uint32_t firmwareHash;
+    VescConfig config;
+};
+
+static RamSlot ramSlots[RAM_SLOTS];
+static int nextRamSlot = 0;
+
+// NVS keys are limited to 15 characters; the hash as hex fits
+static void makeKey(const VescIdentity& identity, char* key) {
+    snprintf(key, 10, "%08x", (unsigned)identity.uuidHash);
+}
+
+static RamSlot* findRamSlot(uint32_t uuidHash) {
+    for (int i = 0; i < RAM_SLOTS; i++) {
+        if (ramSlots[i].used && ramSlots[i].uuidHash == uuidHash) return &ramSlots[i];
+    }
+    return nullptr;
+}
+
+static void putRamSlot(const VescIdentity& identity, const VescConfig& config) {
+    RamSlot* slot = findRamSlot(identity.uuidHash);
+    if (!slot) {
+        slot = &ramSlots[nextRamSlot];
+        nextRamSlot = (nextRamSlot + 1) % RAM_SLOTS;
+    }
+    slot->used = true;
+    slot->uuidHash = identity.uuidHash;
+    slot->firmwareHash = identity.firmwareHash;
+    slot->config = config;
+}
+
+bool configCacheLookup(const VescIdentity& identity, VescConfig& config) {
+    RamSlot* slot = findRamSlot(identity.uuidHash);
+    if (slot) {
+        if (slot->firmwareHash != identity.firmwareHash) return false;
+        config = slot->config;
+        return true;
+    }
+
+    char key[10];
+    makeKey(identity, key);
+    Preferences prefs;
+    if (!prefs.begin(NVS_NAMESPACE, true)) return false;
+    StoredEntry stored;
+    size_t n = prefs.getBytes(key, &stored, sizeof(stored));
+    prefs.end();
+    if (n != sizeof(stored) || stored.version != ENTRY_VERSION || stored.firmwareHash != identity.firmwareHash ||
+        stored.config.parts != VESC_CONFIG_ALL) {
+        return false;
+    }
+
+    putRamSlot(identity, stored.config);
+    config = stored.config;
+    return true;
+}
+
+void configCacheStore(const VescIdentity& identity, const VescConfig& config) {
+    // Skip the flash write when nothing changed
+    RamSlot* slot = findRamSlot(identity.uuidHash);
+    if (slot && slot->firmwareHash == identity.firmwareHash && memcmp(&slot->config, &config, sizeof(config)) == 0) {
+        return;
+    }
+    putRamSlot(identity, config);
+
+    StoredEntry stored;
+    memset(&stored, 0, sizeof(stored));
+    stored.version = ENTRY_VERSION;
+    stored.firmwareHash = identity.firmwareHash;
+    stored.config = config;
+
+    char key[10];
+    makeKey(identity, key);
+    Preferences prefs;
+    if (!prefs.begin(NVS_NAMESPACE, false)) {
+        LOG_W(APP, "Could not open NVS to cache the VESC configuration");
+        return;
+    }
+    prefs.putBytes(key, &stored, sizeof(stored));
+    prefs.end();
+    LOG_D(APP, "Cached the configuration of VESC %08x", (unsigned)identity.uuidHash);
+}
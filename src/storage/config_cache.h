@@ -0,0 +1,16 @@
+#pragma once
+
+#include <stdint.h>
+#include "vesc/config.h"
+
+// VESC configurations read on earlier connections, so a reconnect (even
+// after a reboot) can skip COMM_GET_MCCONF and COMM_GET_APPCONF. Entries
+// are kept in RAM and in NVS, one per VESC by its unique id, and only
+// match while the firmware hash is the same; a configuration changed in
+// VESC Tool without a firmware update is not noticed. UI task only.
+
+// Cached configuration of a VESC. Checks RAM first, then NVS.
+bool configCacheLookup(const VescIdentity& identity, VescConfig& config);
+
+// Store a complete configuration; skipped if it is what is already kept
+void configCacheStore(const VescIdentity& identity, const VescConfig& config);
@@ -0,0 +1,288 @@
+#include "log_format.h"
+
+#include <string.h>
+
+const LogValueInfo LOG_VALUE_INFO[LOG_VALUE_COUNT] = {
+    { "current_motor", 2, VALUES_FIELD_CURRENT_MOTOR },
+    { "current_in", 2, VALUES_FIELD_CURRENT_IN },
+    { "current_id", 2, VALUES_FIELD_CURRENT_ID },
+    { "current_iq", 2, VALUES_FIELD_CURRENT_IQ },
+    { "erpm", 0, VALUES_FIELD_RPM },
+    { "amp_hours", 4, VALUES_FIELD_AMP_HOURS },
+    { "amp_hours_charged", 4, VALUES_FIELD_AMP_HOURS_CHARGED },
+    { "watt_hours", 4, VALUES_FIELD_WATT_HOURS },
+    { "watt_hours_charged", 4, VALUES_FIELD_WATT_HOURS_CHARGED },
+    { "tachometer", 0, VALUES_FIELD_TACHOMETER },
+    { "tachometer_abs", 0, VALUES_FIELD_TACHOMETER_ABS },
+    { "pid_pos", 6, VALUES_FIELD_PID_POS },
+    { "vd", 3, VALUES_FIELD_VD },
+    { "vq", 3, VALUES_FIELD_VQ },
+    { "temp_fet", 1, VALUES_FIELD_TEMP_FET },
+    { "temp_motor", 1, VALUES_FIELD_TEMP_MOTOR },
+    { "duty", 3, VALUES_FIELD_DUTY },
+    { "v_in", 1, VALUES_FIELD_V_IN },
+    { "temp_mos1", 1, VALUES_FIELD_TEMP_MOS },
+    { "temp_mos2", 1, VALUES_FIELD_TEMP_MOS },
+    { "temp_mos3", 1, VALUES_FIELD_TEMP_MOS },
+    { "fault", 0, VALUES_FIELD_FAULT },
+    { "controller_id", 0, VALUES_FIELD_CONTROLLER_ID },
+    { "status", 0, VALUES_FIELD_STATUS },
+    { "soc", 1, 0 },
+    { "gps_latitude", 7, VALUES_FIELD_GPS },
+    { "gps_longitude", 7, VALUES_FIELD_GPS },
+    { "gps_speed", 1, VALUES_FIELD_GPS },
+    { "gps_age_ms", 0, VALUES_FIELD_GPS },
+    { "formula1", VALUES_FORMULA_DECIMALS, VALUES_FIELD_FORMULA },
+    { "formula2", VALUES_FORMULA_DECIMALS, VALUES_FIELD_FORMULA },
+    { "imu_pitch", 1, VALUES_FIELD_IMU },
+    { "imu_roll", 1, VALUES_FIELD_IMU },
+    { "imu_accel", 2, VALUES_FIELD_IMU },
+};
+
+static inline uint32_t zigzag(int32_t value) {
+    return ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+}
+
+static inline int32_t unzigzag(uint32_t value) {
+    return (int32_t)(value >> 1) ^ -(int32_t)(value & 1);
+}
+
+static inline size_t putVarint(uint8_t* out, uint32_t value) {
+    size_t n = 0;
+    while (value >= 0x80) {
+        out[n++] = (uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+    out[n++] = (uint8_t)value;
+    return n;
+}
+
+// Returns bytes read, 0 if truncated or longer than 5 bytes
+static inline size_t getVarint(const uint8_t* data, size_t length, uint32_t& value) {
+    value = 0;
+    for (size_t i = 0; i < length && i < 5; i++) {
+        value |= (uint32_t)(data[i] & 0x7F) << (7 * i);
+        if (!(data[i] & 0x80)) return i + 1;
+    }
+    return 0;
+}
+
+// The changed mask; as short as the 32-bit form while only its low bits
+// are set
+static inline size_t putVarint64(uint8_t* out, uint64_t value) {
+    size_t n = 0;
+    while (value >= 0x80) {
+        out[n++] = (uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+    out[n++] = (uint8_t)value;
+    return n;
+}
+
+static inline size_t getVarint64(const uint8_t* data, size_t length, uint64_t& value) {
+    value = 0;
+    for (size_t i = 0; i < length && i < 10; i++) {
+        value |= (uint64_t)(data[i] & 0x7F) << (7 * i);
+        if (!(data[i] & 0x80)) return i + 1;
+    }
+    return 0;
+}
+
+// CRC-32, reflected polynomial 0xEDB88320, a nibble at a time
+static const uint32_t crc32Nibbles[16] = {
+    0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+    0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C
+};
+
+uint32_t logCrc32(uint32_t crc, const void* data, size_t length) {
+    const uint8_t* bytes = (const uint8_t*)data;
+    crc = ~crc;
+    for (size_t i = 0; i < length; i++) {
+        crc ^= bytes[i];
+        crc = (crc >> 4) ^ crc32Nibbles[crc & 0x0F];
+        crc = (crc >> 4) ^ crc32Nibbles[crc & 0x0F];
+    }
+    return ~crc;
+}
+
+void logSealBlock(LogBlockHeader& header, uint32_t sequence, uint32_t firstTimeMs, uint64_t unixMs,
+                  uint16_t flags, const uint8_t* payload, uint32_t payloadLength) {
+    header.magic = LOG_BLOCK_MAGIC;
+    header.sequence = sequence;
+    header.firstTimeMs = firstTimeMs;
+    header.payloadLength = payloadLength;
+    header.flags = flags;
+    header.reserved = 0;
+    header.unixMs = unixMs;
+    header.crc = logCrc32(logBlockHeaderCrc(header), payload, payloadLength);
+}
+
+void logFillHeader(LogFileHeader& header, const VescFirmware& firmware, uint32_t startMs,
+                   uint16_t keyframeInterval) {
+    memset(&header, 0, sizeof(header));
+    header.magic = LOG_MAGIC;
+    header.version = LOG_FORMAT_VERSION;
+    header.headerSize = sizeof(LogFileHeader);
+    header.valueCount = LOG_VALUE_COUNT;
+    header.fwMajor = firmware.major;
+    header.fwMinor = firmware.minor;
+    header.startMs = startMs;
+    header.keyframeInterval = keyframeInterval;
+}
+
+void logSampleFromValues(const VescValues& values, uint32_t timeMs, LogSample& sample) {
+    int32_t* v = sample.values;
+    sample.timeMs = timeMs;
+    sample.fields = values.fields;
+    v[LOG_CURRENT_MOTOR] = values.currentMotor;
+    v[LOG_CURRENT_IN] = values.currentIn;
+    v[LOG_CURRENT_ID] = values.currentId;
+    v[LOG_CURRENT_IQ] = values.currentIq;
+    v[LOG_RPM] = values.rpm;
+    v[LOG_AMP_HOURS] = values.ampHours;
+    v[LOG_AMP_HOURS_CHARGED] = values.ampHoursCharged;
+    v[LOG_WATT_HOURS] = values.wattHours;
+    v[LOG_WATT_HOURS_CHARGED] = values.wattHoursCharged;
+    v[LOG_TACHOMETER] = values.tachometer;
+    v[LOG_TACHOMETER_ABS] = values.tachometerAbs;
+    v[LOG_PID_POS] = values.pidPos;
+    v[LOG_VD] = values.vd;
+    v[LOG_VQ] = values.vq;
+    v[LOG_TEMP_FET] = values.tempFet;
+    v[LOG_TEMP_MOTOR] = values.tempMotor;
+    v[LOG_DUTY] = values.dutyNow;
+    v[LOG_V_IN] = values.vIn;
+    v[LOG_TEMP_MOS1] = values.tempMos[0];
+    v[LOG_TEMP_MOS2] = values.tempMos[1];
+    v[LOG_TEMP_MOS3] = values.tempMos[2];
+    v[LOG_FAULT] = values.faultCode;
+    v[LOG_CONTROLLER_ID] = values.controllerId;
+    v[LOG_STATUS] = values.status;
+    v[LOG_SOC] = values.soc;
+    v[LOG_GPS_LATITUDE] = values.gpsLatitude;
+    v[LOG_GPS_LONGITUDE] = values.gpsLongitude;
+    v[LOG_GPS_SPEED] = values.gpsSpeed;
+    v[LOG_GPS_AGE] = values.gpsAge;
+    v[LOG_FORMULA1] = values.formula[0];
+    v[LOG_FORMULA2] = values.formula[1];
+    v[LOG_IMU_PITCH] = values.imuPitch;
+    v[LOG_IMU_ROLL] = values.imuRoll;
+    v[LOG_IMU_ACCEL] = values.imuAccel;
+}
+
+void logValuesFromSample(const LogSample& sample, VescValues& values) {
+    const int32_t* v = sample.values;
+    values.fields = sample.fields;
+    values.currentMotor = v[LOG_CURRENT_MOTOR];
+    values.currentIn = v[LOG_CURRENT_IN];
+    values.currentId = v[LOG_CURRENT_ID];
+    values.currentIq = v[LOG_CURRENT_IQ];
+    values.rpm = v[LOG_RPM];
+    values.ampHours = v[LOG_AMP_HOURS];
+    values.ampHoursCharged = v[LOG_AMP_HOURS_CHARGED];
+    values.wattHours = v[LOG_WATT_HOURS];
+    values.wattHoursCharged = v[LOG_WATT_HOURS_CHARGED];
+    values.tachometer = v[LOG_TACHOMETER];
+    values.tachometerAbs = v[LOG_TACHOMETER_ABS];
+    values.pidPos = v[LOG_PID_POS];
+    values.vd = v[LOG_VD];
+    values.vq = v[LOG_VQ];
+    values.tempFet = (int16_t)v[LOG_TEMP_FET];
+    values.tempMotor = (int16_t)v[LOG_TEMP_MOTOR];
+    values.dutyNow = (int16_t)v[LOG_DUTY];
+    values.vIn = (int16_t)v[LOG_V_IN];
+    values.tempMos[0] = (int16_t)v[LOG_TEMP_MOS1];
+    values.tempMos[1] = (int16_t)v[LOG_TEMP_MOS2];
+    values.tempMos[2] = (int16_t)v[LOG_TEMP_MOS3];
+    values.faultCode = (uint8_t)v[LOG_FAULT];
+    values.controllerId = (uint8_t)v[LOG_CONTROLLER_ID];
+    values.status = (uint8_t)v[LOG_STATUS];
+    values.soc = (int16_t)v[LOG_SOC];
+    values.gpsLatitude = v[LOG_GPS_LATITUDE];
+    values.gpsLongitude = v[LOG_GPS_LONGITUDE];
+    values.gpsSpeed = (int16_t)v[LOG_GPS_SPEED];
+    values.gpsAge = (int16_t)v[LOG_GPS_AGE];
+    values.formula[0] = v[LOG_FORMULA1];
+    values.formula[1] = v[LOG_FORMULA2];
+    values.imuPitch = (int16_t)v[LOG_IMU_PITCH];
+    values.imuRoll = (int16_t)v[LOG_IMU_ROLL];
+    values.imuAccel = (int16_t)v[LOG_IMU_ACCEL];
+}
+
+size_t logEncodeFrame(const LogSample& sample, const LogSample* previous, uint8_t* out) {
+    size_t n = 0;
+    if (!previous) {
+        out[n++] = LOG_FRAME_KEY;
+        n += putVarint(out + n, sample.timeMs);
+        n += putVarint(out + n, sample.fields);
+        for (int i = 0; i < LOG_VALUE_COUNT; i++) {
+            n += putVarint(out + n, zigzag(sample.values[i]));
+        }
+        return n;
+    }
+
+    uint64_t changed = 0;
+    for (int i = 0; i < LOG_VALUE_COUNT; i++) {
+        if (sample.values[i] != previous->values[i]) changed |= 1ull << i;
+    }
+    if (sample.fields != previous->fields) changed |= 1ull << LOG_CHANGED_FIELDS;
+
+    out[n++] = LOG_FRAME_DELTA;
+    n += putVarint(out + n, sample.timeMs - previous->timeMs);
+    n += putVarint64(out + n, changed);
+    if (changed & (1ull << LOG_CHANGED_FIELDS)) {
+        n += putVarint(out + n, sample.fields);
+    }
+    for (int i = 0; i < LOG_VALUE_COUNT; i++) {
+        if (changed & (1ull << i)) {
+            // Wrapping difference, so extreme values cannot overflow
+            int32_t diff = (int32_t)((uint32_t)sample.values[i] - (uint32_t)previous->values[i]);
+            n += putVarint(out + n, zigzag(diff));
+        }
+    }
+    return n;
+}
+
+size_t logDecodeFrame(const uint8_t* data, size_t length, const LogSample& previous, LogSample& out) {
+    if (length < 1) return 0;
+
+    size_t n = 1;
+    size_t used;
+    uint32_t word;
+    if (data[0] == LOG_FRAME_KEY) {
+        if (!(used = getVarint(data + n, length - n, out.timeMs))) return 0;
+        n += used;
+        if (!(used = getVarint(data + n, length - n, out.fields))) return 0;
+        n += used;
+        for (int i = 0; i < LOG_VALUE_COUNT; i++) {
+            if (!(used = getVarint(data + n, length - n, word))) return 0;
+            n += used;
+            out.values[i] = unzigzag(word);
+        }
+        return n;
+    }
+    if (data[0] != LOG_FRAME_DELTA) return 0;
+
+    uint32_t delta;
+    uint64_t changed;
+    if (!(used = getVarint(data + n, length - n, delta))) return 0;
+    n += used;
+    if (!(used = getVarint64(data + n, length - n, changed))) return 0;
+    n += used;
+
+    out.timeMs = previous.timeMs + delta;
+    out.fields = previous.fields;
+    if (changed & (1ull << LOG_CHANGED_FIELDS)) {
+        if (!(used = getVarint(data + n, length - n, out.fields))) return 0;
+        n += used;
+    }
+    for (int i = 0; i < LOG_VALUE_COUNT; i++) {
+        out.values[i] = previous.values[i];
+        if (changed & (1ull << i)) {
+            if (!(used = getVarint(data + n, length - n, word))) return 0;
+            n += used;
+            out.values[i] = (int32_t)((uint32_t)out.values[i] + (uint32_t)unzigzag(word));
+        }
+    }
+    return n;
+}
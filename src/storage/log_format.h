@@ -0,0 +1,170 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include "vesc/values.h"
+
+// On-card telemetry log format.
+//
+// A file is a LogFileHeader padded to LOG_SECTOR_SIZE, a run of blocks
+// and, if the file was closed cleanly, an index and a LogFooter. All
+// fixed-size parts are little-endian; everything in a frame is a LEB128
+// varint.
+//
+// Blocks:
+//   LogBlockHeader, payloadLength bytes of whole frames, zero padding to
+//   the next LOG_SECTOR_SIZE boundary. Sequence numbers count up from 0
+//   within a file and the CRC covers the header and the payload, so after
+//   a power loss the valid blocks are exactly the leading run whose
+//   headers check out. The first frame of every block is a keyframe, so
+//   each block also decodes on its own.
+//
+// Frames:
+//   keyframe  LOG_FRAME_KEY, timeMs, fields, then every value zig-zag
+//   delta     LOG_FRAME_DELTA, timeMs - previous timeMs, changed mask
+//             (up to 64 bits), fields if bit LOG_CHANGED_FIELDS is set,
+//             then the zig-zag
+//             difference from the previous frame for each value whose
+//             bit is set
+//
+// Besides starting each block, keyframes follow any dropped sample and
+// repeat every keyframeInterval frames. The index lists (timeMs, file
+// offset) for blocks, so a reader can seek to a time and decode forward
+// from there without scanning the file. A file cut short by power loss
+// has no footer; the logger truncates it to its last valid block on the
+// next boot and carries on appending to it, marking the first new block
+// LOG_BLOCK_RESUMED because millis() restarted.
+//
+// Each block header also carries the UTC time of its leading keyframe
+// (0 when the dashboard had no wall clock), so frames map to absolute
+// time as unixMs + (timeMs - firstTimeMs), across a resume as well.
+
+static const uint32_t LOG_MAGIC = 0x474C4456;         // "VDLG"
+static const uint32_t LOG_INDEX_MAGIC = 0x58444C56;   // "VLDX"
+static const uint32_t LOG_BLOCK_MAGIC = 0x4B4C4256;   // "VBLK"
+static const uint16_t LOG_FORMAT_VERSION = 8;
+static const size_t LOG_SECTOR_SIZE = 512;
+
+// LogBlockHeader flags
+static const uint16_t LOG_BLOCK_RESUMED = 0x0001;      // Time restarts here after a reboot
+
+static const uint8_t LOG_FRAME_KEY = 0x01;
+static const uint8_t LOG_FRAME_DELTA = 0x02;
+
+// Values in frame order
+enum LogValue : uint8_t {
+    LOG_CURRENT_MOTOR, LOG_CURRENT_IN, LOG_CURRENT_ID, LOG_CURRENT_IQ,
+    LOG_RPM, LOG_AMP_HOURS, LOG_AMP_HOURS_CHARGED, LOG_WATT_HOURS,
+    LOG_WATT_HOURS_CHARGED, LOG_TACHOMETER, LOG_TACHOMETER_ABS, LOG_PID_POS,
+    LOG_VD, LOG_VQ, LOG_TEMP_FET, LOG_TEMP_MOTOR, LOG_DUTY, LOG_V_IN,
+    LOG_TEMP_MOS1, LOG_TEMP_MOS2, LOG_TEMP_MOS3, LOG_FAULT, LOG_CONTROLLER_ID,
+    LOG_STATUS, LOG_SOC, LOG_GPS_LATITUDE, LOG_GPS_LONGITUDE, LOG_GPS_SPEED,
+    LOG_GPS_AGE, LOG_FORMULA1, LOG_FORMULA2, LOG_IMU_PITCH, LOG_IMU_ROLL,
+    LOG_IMU_ACCEL,
+    LOG_VALUE_COUNT
+};
+
+// How each value reads, for whatever turns logs into tables: its column
+// name (as in tools/serial_stream.py), the decimals of its fixed-point
+// value, and the VALUES_FIELD_* bit a sample's fields carry when it holds
+// the value (0 when every sample does)
+struct LogValueInfo {
+    const char* name;
+    uint8_t decimals;
+    uint32_t field;
+};
+
+extern const LogValueInfo LOG_VALUE_INFO[LOG_VALUE_COUNT];
+
+// Bit in a delta frame's changed mask: the fields mask follows
+static const uint8_t LOG_CHANGED_FIELDS = LOG_VALUE_COUNT;
+static_assert(LOG_CHANGED_FIELDS < 64, "the changed mask is 64 bits");
+
+// Longest encoded frame
+static const size_t LOG_MAX_FRAME_SIZE = 1 + 5 + 10 + 5 + LOG_VALUE_COUNT * 5;
+
+struct __attribute__((packed)) LogFileHeader {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t headerSize;        // sizeof(LogFileHeader)
+    uint16_t valueCount;        // LOG_VALUE_COUNT when written
+    uint8_t fwMajor;            // VESC firmware, 0.0 if unknown
+    uint8_t fwMinor;
+    uint32_t startMs;           // millis() when the file was started
+    uint16_t keyframeInterval;  // Frames between keyframes
+    uint16_t reserved0;
+    uint32_t reserved1;
+};
+
+struct __attribute__((packed)) LogBlockHeader {
+    uint32_t magic;             // LOG_BLOCK_MAGIC
+    uint32_t sequence;          // 0 for the first block of a file
+    uint32_t firstTimeMs;       // timeMs of the leading keyframe
+    uint32_t payloadLength;     // Frame bytes after the header
+    uint16_t flags;             // LOG_BLOCK_*
+    uint16_t reserved;
+    uint64_t unixMs;            // UTC ms since 1970 at firstTimeMs, 0 if unknown
+    uint32_t crc;               // logCrc32 of the header up to here, then the payload
+};
+
+struct __attribute__((packed)) LogIndexEntry {
+    uint32_t timeMs;
+    uint32_t offset;            // File offset of a block
+};
+
+// Last bytes of a cleanly closed file
+struct __attribute__((packed)) LogFooter {
+    uint32_t indexOffset;       // File offset of the first LogIndexEntry
+    uint32_t indexCount;
+    uint32_t magic;             // LOG_INDEX_MAGIC
+};
+
+// One sample, unpacked
+struct LogSample {
+    uint32_t timeMs;
+    uint32_t fields;            // VALUES_FIELD_* present in this reply
+    int32_t values[LOG_VALUE_COUNT];
+};
+
+// Bytes a block takes on the card, padding included
+inline size_t logBlockSpan(uint32_t payloadLength) {
+    size_t bytes = sizeof(LogBlockHeader) + payloadLength;
+    return (bytes + LOG_SECTOR_SIZE - 1) & ~(LOG_SECTOR_SIZE - 1);
+}
+
+// Standard CRC-32 (as zlib). Start with crc = 0 and feed the result back
+// in to checksum data in pieces.
+uint32_t logCrc32(uint32_t crc, const void* data, size_t length);
+
+// Fill in a block header, CRC included, for a payload held in memory
+void logSealBlock(LogBlockHeader& header, uint32_t sequence, uint32_t firstTimeMs, uint64_t unixMs,
+                  uint16_t flags, const uint8_t* payload, uint32_t payloadLength);
+
+// Whether a file of fileSize bytes ending in footer was closed cleanly
+inline bool logFooterValid(const LogFooter& footer, uint32_t fileSize) {
+    return footer.magic == LOG_INDEX_MAGIC &&
+           footer.indexOffset + footer.indexCount * sizeof(LogIndexEntry) + sizeof(footer) == fileSize;
+}
+
+// CRC of a block header's fixed part; continue it over the payload with
+// logCrc32 and compare with header.crc
+inline uint32_t logBlockHeaderCrc(const LogBlockHeader& header) {
+    return logCrc32(0, &header, sizeof(header) - sizeof(header.crc));
+}
+
+void logFillHeader(LogFileHeader& header, const VescFirmware& firmware, uint32_t startMs,
+                   uint16_t keyframeInterval);
+void logSampleFromValues(const VescValues& values, uint32_t timeMs, LogSample& sample);
+
+// The reverse, for replaying a log through the dashboard's own code
+void logValuesFromSample(const LogSample& sample, VescValues& values);
+
+// Encode a frame into out (at least LOG_MAX_FRAME_SIZE bytes). With
+// previous == nullptr a keyframe is written, otherwise a delta frame.
+// Returns the encoded length.
+size_t logEncodeFrame(const LogSample& sample, const LogSample* previous, uint8_t* out);
+
+// Decode one frame. previous must hold the last decoded sample for a
+// delta frame and is ignored for a keyframe. Returns the bytes consumed,
+// or 0 if the data is truncated or not a frame.
+size_t logDecodeFrame(const uint8_t* data, size_t length, const LogSample& previous, LogSample& out);
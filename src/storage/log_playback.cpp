@@ -0,0 +1,237 @@
+#include "log_playback.h"
+#include "../log.h"
+#include "../system/coexist.h"
+#include "../system/perf_stats.h"
+#include "../system/spi_bus.h"
+#include "../system/task_layout.h"
+#include "../system/memory.h"
+
+#include <Arduino.h>
+#include <SD.h>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <string.h>
+
+static const char* LOG_DIRECTORY = "/logs";
+static const size_t READ_SLICE = 4096;       // Card reads per SPI bus hold; the LCD shares the bus
+static const uint32_t READ_SLICE_MS = 4;     // What one takes, kept clear of the next render
+static const uint32_t TASK_STACK_SIZE = 6144;
+static const TaskPlacement& PLACEMENT = TASK_PLACEMENT[TASK_LOG_PLAYBACK];
+
+// Where the ride is: the log's clock, and the playback's with gaps cut
+struct Pace {
+    uint8_t speed;
+    uint64_t startUs;            // esp_timer time ride time 0 was handed over
+    uint32_t playedMs;
+    uint32_t lastTimeMs;         // As logged
+    bool started;
+};
+
+static LogPlaybackSink sink = nullptr;
+static uint32_t maxGap = 0;
+static TaskHandle_t task = nullptr;
+static uint8_t* slice = nullptr;             // READ_SLICE plus a frame cut off by the previous read
+
+// Requests from the UI, and the status back, under mux
+static portMUX_TYPE mux = portMUX_INITIALIZER_UNLOCKED;
+static int startFile = -1;                   // -1 for no start pending
+static uint8_t startSpeed = 1;
+static bool stopPending = false;
+static LogPlaybackStatus status;
+
+static void logPath(char* path, size_t size, int number) {
+    snprintf(path, size, "%s/ride%04d.vdl", LOG_DIRECTORY, number);
+}
+
+// A stop, or a new start, ends the log playing
+static bool stopAsked() {
+    portENTER_CRITICAL(&mux);
+    bool stop = stopPending || startFile >= 0;
+    portEXIT_CRITICAL(&mux);
+    return stop;
+}
+
+static bool takeStart(int& number, uint8_t& speed) {
+    portENTER_CRITICAL(&mux);
+    number = startFile;
+    speed = startSpeed;
+    startFile = -1;
+    stopPending = false;
+    portEXIT_CRITICAL(&mux);
+    return number >= 0;
+}
+
+// Wait until a sample is due and hand it over. Returns false if asked
+// to stop first.
+static bool deliver(const LogSample& sample, Pace& pace) {
+    if (pace.started) {
+        // A resumed log restarts millis(): carry straight on
+        uint32_t gap = sample.timeMs >= pace.lastTimeMs ? sample.timeMs - pace.lastTimeMs : 0;
+        pace.playedMs += gap < maxGap ? gap : maxGap;
+    } else {
+        pace.startUs = esp_timer_get_time();
+        pace.started = true;
+    }
+    pace.lastTimeMs = sample.timeMs;
+
+    if (pace.speed > 0) {
+        uint64_t dueUs = pace.startUs + (uint64_t)pace.playedMs * 1000 / pace.speed;
+        for (;;) {
+            if (stopAsked()) return false;
+            uint64_t now = esp_timer_get_time();
+            if (now >= dueUs) break;
+            // A stop or a new start notifies, and wakes the task early
+            uint32_t waitMs = (uint32_t)((dueUs - now + 999) / 1000);
+            ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(waitMs) > 0 ? pdMS_TO_TICKS(waitMs) : 1);
+        }
+    }
+    while (!sink(sample)) {
+        if (stopAsked()) return false;
+        vTaskDelay(1);
+    }
+    portENTER_CRITICAL(&mux);
+    status.positionMs = pace.playedMs;
+    status.samples++;
+    portEXIT_CRITICAL(&mux);
+    return true;
+}
+
+// Play a log's blocks in order. Returns false if the card failed or the
+// log was cut mid-block.
+static bool playBlocks(File& file, Pace& pace) {
+    uint32_t size = file.size();
+    uint32_t offset = LOG_SECTOR_SIZE;
+    LogSample previous, sample;
+    memset(&previous, 0, sizeof(previous));
+
+    // A closed log's index follows the last block
+    while (offset + sizeof(LogBlockHeader) <= size) {
+        LogBlockHeader header;
+        if (!file.seek(offset) || file.read((uint8_t*)&header, sizeof(header)) != sizeof(header)) return false;
+        if (header.magic != LOG_BLOCK_MAGIC) return true;
+        if (offset + sizeof(header) + header.payloadLength > size) return false;
+
+        uint32_t left = header.payloadLength;
+        size_t have = 0;
+        while (left > 0) {
+            size_t n = left < READ_SLICE ? left : READ_SLICE;
+            coexistAcquire(COEXIST_SD_READ);
+            spiBusCardBegin(READ_SLICE_MS);
+            bool read = file.read(slice + have, n) == n;
+            spiBusCardEnd();
+            if (!read) return false;
+            have += n;
+            left -= n;
+
+            size_t used = 0;
+            size_t length;
+            while ((length = logDecodeFrame(slice + used, have - used, previous, sample)) > 0) {
+                used += length;
+                previous = sample;
+                if (!deliver(sample, pace)) return true;
+            }
+            have -= used;
+            if (left > 0 && have > LOG_MAX_FRAME_SIZE) return false;   // Not a frame
+            memmove(slice, slice + used, have);
+        }
+        offset += logBlockSpan(header.payloadLength);
+    }
+    return true;
+}
+
+static void play(int number, uint8_t speed) {
+    char path[32];
+    logPath(path, sizeof(path), number);
+    portENTER_CRITICAL(&mux);
+    memset(&status, 0, sizeof(status));
+    status.file = number;
+    status.playing = true;
+    status.speed = speed;
+    portEXIT_CRITICAL(&mux);
+
+    File file = SD.open(path, FILE_READ);
+    LogFileHeader header;
+    bool ok = file && file.read((uint8_t*)&header, sizeof(header)) == sizeof(header) &&
+              header.magic == LOG_MAGIC && header.version == LOG_FORMAT_VERSION &&
+              header.valueCount == LOG_VALUE_COUNT;
+    if (ok) {
+        LOG_I(APP, "Playback: %s at %ux", path, (unsigned)speed);
+        Pace pace = { speed, 0, 0, 0, false };
+        ok = playBlocks(file, pace);
+        if (!ok) LOG_W(APP, "Playback: %s is cut short or the card failed", path);
+    } else {
+        LOG_W(APP, "Playback: %s is not a log of this version", path);
+    }
+    if (file) file.close();
+
+    portENTER_CRITICAL(&mux);
+    status.playing = startFile >= 0;     // Unless the next log is already waiting
+    status.failed = !ok;
+    LogPlaybackStatus done = status;
+    portEXIT_CRITICAL(&mux);
+    LOG_I(APP, "Playback: %s, %u samples over %u s", path, (unsigned)done.samples,
+          (unsigned)(done.positionMs / 1000));
+}
+
+static void playbackTaskMain(void* param) {
+    for (;;) {
+        int number;
+        uint8_t speed;
+        if (!takeStart(number, speed)) {
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+            continue;
+        }
+        play(number, speed);
+    }
+}
+
+bool logPlaybackBegin(LogPlaybackSink playbackSink, uint32_t maxGapMs) {
+    if (task) return true;
+
+    if (SD.cardType() == CARD_NONE) {
+        LOG_I(APP, "No SD card, log playback off");
+        return false;
+    }
+    slice = (uint8_t*)memoryAlloc(READ_SLICE + LOG_MAX_FRAME_SIZE, MEMORY_BULK, MEMORY_TAG_LOGGER);
+    if (!slice) {
+        LOG_E(APP, "No PSRAM for log playback");
+        return false;
+    }
+    sink = playbackSink;
+    maxGap = maxGapMs;
+    memset(&status, 0, sizeof(status));
+
+    xTaskCreatePinnedToCore(playbackTaskMain, PLACEMENT.name, TASK_STACK_SIZE, nullptr, PLACEMENT.priority, &task,
+                            PLACEMENT.core);
+    perfWatchTask(task, MEMORY_TAG_LOGGER);
+    return true;
+}
+
+void logPlaybackStart(int file, uint8_t speed) {
+    if (!task || file <= 0) return;
+    portENTER_CRITICAL(&mux);
+    startFile = file;
+    startSpeed = speed;
+    // Playing from now, so the UI never sees the log it started as over
+    status.file = file;
+    status.playing = true;
+    status.speed = speed;
+    portEXIT_CRITICAL(&mux);
+    xTaskNotifyGive(task);
+}
+
+void logPlaybackStop() {
+    if (!task) return;
+    portENTER_CRITICAL(&mux);
+    stopPending = true;
+    portEXIT_CRITICAL(&mux);
+    xTaskNotifyGive(task);
+}
+
+LogPlaybackStatus logPlaybackStatus() {
+    portENTER_CRITICAL(&mux);
+    LogPlaybackStatus out = status;
+    portEXIT_CRITICAL(&mux);
+    return out;
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <stdint.h>
+#include "log_format.h"
+
+// Plays a telemetry log from the SD card back into the dashboard, so
+// layouts can be shown off and tried, and the UI timed, on a real ride
+// without a VESC.
+//
+// A task reads the log a slice at a time from the front, decodes its
+// frames and hands each sample to a sink when it falls due: at the pace
+// it was recorded, `speed` times faster, or (speed 0) as fast as the
+// sink takes them. Gaps longer than maxGapMs (a reboot, a stop with the
+// dashboard off) are cut to maxGapMs. The sink publishes the sample as
+// a live one; when it cannot take one yet it returns false and is
+// offered the same sample again a tick later, so nothing is skipped.
+//
+// Blocks are read up to the first bad one, so logs cut short by a power
+// loss play too. The UI task starts and stops playback.
+
+typedef bool (*LogPlaybackSink)(const LogSample& sample);
+
+struct LogPlaybackStatus {
+    int file;                   // Number of the log playing (ride<file>.vdl), 0 if none
+    bool playing;
+    uint8_t speed;              // Times real time, 0 for flat out
+    uint32_t positionMs;        // Ride time of the last sample handed over, gaps cut
+    uint32_t samples;           // Handed over since the start
+    bool failed;                // The last log could not be read to its end
+};
+
+// Allocate the read buffer and start the playback task. Returns false
+// without an SD card or the memory.
+bool logPlaybackBegin(LogPlaybackSink sink, uint32_t maxGapMs);
+
+// Play log number `file` from its start, stopping any log playing
+void logPlaybackStart(int file, uint8_t speed);
+
+// Stop at the next sample
+void logPlaybackStop();
+
+LogPlaybackStatus logPlaybackStatus();
@@ -0,0 +1,520 @@
+#include "log_review.h"
+#include "../log.h"
+#include "../system/coexist.h"
+#include "../system/perf_stats.h"
+#include "../system/spi_bus.h"
+#include "../system/task_layout.h"
+#include "../system/memory.h"
+
+#include <Arduino.h>
+#include <SD.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
+#include <string.h>
+
+static const char* LOG_DIRECTORY = "/logs";
+static const size_t READ_SLICE = 4096;       // Card reads per SPI bus hold; the LCD shares the bus
+static const uint32_t READ_SLICE_MS = 4;     // What one takes, kept clear of the next render
+static const uint32_t INDEX_CAPACITY = 4096; // The most the logger writes
+static const uint8_t WINDOW_VIEWS = 3;       // The view and a view's margin each side
+static const uint32_t TASK_STACK_SIZE = 6144;
+static const TaskPlacement& PLACEMENT = TASK_PLACEMENT[TASK_LOG_REVIEW];
+
+// A block index entry placed on the ride time line
+struct ReviewEntry {
+    uint32_t rideMs;
+    uint32_t timeMs;             // As logged
+    uint32_t offset;
+};
+
+struct Window {
+    HistoryBucket* buckets;      // [trace][column], windowColumns per trace
+    uint32_t firstMs;
+    uint32_t msPerColumn;
+    bool valid;
+};
+
+struct Accumulator {
+    int64_t sum;
+    uint32_t count;
+    int32_t min;
+    int32_t max;
+};
+
+static LogReviewTrace traces[LOG_REVIEW_MAX_TRACES];
+static uint8_t traceCount = 0;
+static uint16_t viewColumns = 0;
+static uint16_t windowColumns = 0;
+static uint32_t decodeLimit = 0;
+static TaskHandle_t task = nullptr;
+
+// Shared with the UI under windowMutex
+static SemaphoreHandle_t windowMutex = nullptr;
+static Window windows[2];
+static uint8_t front = 0;
+static LogReviewStatus status;
+static uint32_t decodedWindows = 0;
+
+// Requests from the UI, under requestMux
+static portMUX_TYPE requestMux = portMUX_INITIALIZER_UNLOCKED;
+static int openBelow = -1;                   // -1 for no open pending
+static bool closePending = false;
+static uint32_t viewFirstMs = 0;
+static uint32_t viewMsPerColumn = 0;         // 0 until a view is set
+static uint32_t viewChanges = 0;
+
+// Review task
+static File file;
+static ReviewEntry* entries = nullptr;
+static uint32_t entryCount = 0;
+static uint32_t blocksEnd = 0;               // Where the blocks stop and the index starts
+static uint32_t durationMs = 0;
+static Accumulator* accumulators = nullptr;  // [trace][column] of the window being decoded
+static uint8_t* slice = nullptr;             // READ_SLICE plus a frame cut off by the previous read
+
+static void logPath(char* path, size_t size, int number) {
+    snprintf(path, size, "%s/ride%04d.vdl", LOG_DIRECTORY, number);
+}
+
+static bool readAt(uint32_t offset, void* data, size_t length) {
+    return file.seek(offset) && file.read((uint8_t*)data, length) == length;
+}
+
+static void readView(uint32_t& firstMs, uint32_t& msPerColumn, uint32_t& changes) {
+    portENTER_CRITICAL(&requestMux);
+    firstMs = viewFirstMs;
+    msPerColumn = viewMsPerColumn;
+    changes = viewChanges;
+    portEXIT_CRITICAL(&requestMux);
+}
+
+static uint64_t windowEndMs(const Window& window) {
+    return window.firstMs + (uint64_t)windowColumns * window.msPerColumn;
+}
+
+static bool covers(const Window& window, uint32_t firstMs, uint32_t msPerColumn) {
+    return window.valid && window.msPerColumn == msPerColumn && firstMs >= window.firstMs &&
+           firstMs + (uint64_t)viewColumns * msPerColumn <= windowEndMs(window);
+}
+
+// The window a view wants: the view with a view's margin on each side
+static Window targetFor(uint32_t firstMs, uint32_t msPerColumn) {
+    Window target;
+    uint32_t margin = (uint32_t)viewColumns * msPerColumn;
+    target.buckets = nullptr;
+    target.firstMs = firstMs > margin ? firstMs - margin : 0;
+    target.msPerColumn = msPerColumn;
+    target.valid = true;
+    return target;
+}
+
+// Whether a view set since `changes` leaves the window being decoded
+// without a use
+static bool obsolete(const Window& target, uint32_t changes) {
+    uint32_t firstMs, msPerColumn, now;
+    readView(firstMs, msPerColumn, now);
+    if (now == changes) return false;
+    Window wanted = targetFor(firstMs, msPerColumn);
+    return !covers(target, firstMs, msPerColumn) || wanted.firstMs != target.firstMs;
+}
+
+// Last index entry at or before a ride time
+static uint32_t entryAt(uint32_t rideMs) {
+    uint32_t low = 0, high = entryCount;
+    while (high - low > 1) {
+        uint32_t middle = (low + high) / 2;
+        if (entries[middle].rideMs <= rideMs) low = middle; else high = middle;
+    }
+    return low;
+}
+
+static void bin(const LogSample& sample, uint32_t rideMs, const Window& target) {
+    if (rideMs < target.firstMs) return;
+    uint32_t column = (rideMs - target.firstMs) / target.msPerColumn;
+    if (column >= windowColumns) return;
+    for (uint8_t t = 0; t < traceCount; t++) {
+        if ((sample.fields & traces[t].field) != traces[t].field) continue;
+        int32_t value = sample.values[traces[t].value];
+        Accumulator& a = accumulators[t * windowColumns + column];
+        if (a.count == 0 || value < a.min) a.min = value;
+        if (a.count == 0 || value > a.max) a.max = value;
+        a.sum += value;
+        a.count++;
+    }
+}
+
+// Decode every frame from index entry `first` on until one at or past
+// untilMs, or the end of the blocks, binning them into target if it is
+// given. lastMs is the ride time of the last frame before the stop.
+// Returns false if the card failed or a new view made the target useless.
+static bool decodeFrames(uint32_t first, const Window* target, uint64_t untilMs, uint32_t changes,
+                         uint32_t& lastMs) {
+    uint32_t offset = entries[first].offset;
+    uint32_t nextEntry = first;
+    int64_t bias = 0;            // Ride time minus logged time
+    bool haveLast = false;
+    uint32_t lastTimeMs = 0;
+    LogSample previous, sample;
+    memset(&previous, 0, sizeof(previous));
+
+    while (offset + sizeof(LogBlockHeader) <= blocksEnd) {
+        LogBlockHeader header;
+        if (!readAt(offset, &header, sizeof(header)) || header.magic != LOG_BLOCK_MAGIC) return false;
+        // Indexed blocks carry their place on the time line, resumed ones included
+        while (nextEntry < entryCount && entries[nextEntry].offset < offset) nextEntry++;
+        if (nextEntry < entryCount && entries[nextEntry].offset == offset) {
+            bias = (int64_t)entries[nextEntry].rideMs - entries[nextEntry].timeMs;
+            haveLast = false;
+        }
+
+        uint32_t left = header.payloadLength;
+        size_t have = 0;
+        while (left > 0) {
+            size_t n = left < READ_SLICE ? left : READ_SLICE;
+            coexistAcquire(COEXIST_SD_READ);
+            spiBusCardBegin(READ_SLICE_MS);
+            bool read = file.read(slice + have, n) == n;
+            spiBusCardEnd();
+            if (!read) return false;
+            have += n;
+            left -= n;
+
+            size_t used = 0;
+            size_t length;
+            while ((length = logDecodeFrame(slice + used, have - used, previous, sample)) > 0) {
+                used += length;
+                previous = sample;
+                // A resume that fell between index entries: carry on from the last frame
+                if (haveLast && sample.timeMs < lastTimeMs) bias += (int64_t)lastTimeMs - sample.timeMs;
+                haveLast = true;
+                lastTimeMs = sample.timeMs;
+                int64_t rideMs = sample.timeMs + bias;
+                if (rideMs < 0) rideMs = 0;
+                if ((uint64_t)rideMs >= untilMs) return true;
+                lastMs = (uint32_t)rideMs;
+                if (target) bin(sample, lastMs, *target);
+            }
+            have -= used;
+            if (left > 0 && have > LOG_MAX_FRAME_SIZE) return false;   // Not a frame
+            memmove(slice, slice + used, have);
+
+            if (target && obsolete(*target, changes)) return false;
+        }
+        offset += logBlockSpan(header.payloadLength);
+    }
+    return true;
+}
+
+// Zoomed far out: bin only the keyframe that leads each indexed block,
+// skipping blocks whose column already has one
+static bool sampleKeyframes(uint32_t first, const Window& target, uint64_t untilMs, uint32_t changes) {
+    LogSample none, sample;
+    memset(&none, 0, sizeof(none));
+    for (uint32_t e = first; e < entryCount && entries[e].rideMs < untilMs; e++) {
+        if (entries[e].rideMs < target.firstMs) continue;
+        uint32_t column = (entries[e].rideMs - target.firstMs) / target.msPerColumn;
+        bool sampled = false;
+        for (uint8_t t = 0; t < traceCount && !sampled; t++) {
+            sampled = accumulators[t * windowColumns + column].count > 0;
+        }
+        if (sampled) continue;
+
+        if (!readAt(entries[e].offset, slice, LOG_SECTOR_SIZE)) return false;
+        const LogBlockHeader& header = *(const LogBlockHeader*)slice;
+        if (header.magic != LOG_BLOCK_MAGIC) return false;
+        size_t room = LOG_SECTOR_SIZE - sizeof(LogBlockHeader);
+        size_t length = header.payloadLength < room ? header.payloadLength : room;
+        if (logDecodeFrame(slice + sizeof(LogBlockHeader), length, none, sample) > 0) {
+            bin(sample, entries[e].rideMs, target);
+        }
+
+        if (e % 16 == 15) {
+            vTaskDelay(1);
+            if (obsolete(target, changes)) return false;
+        }
+    }
+    return true;
+}
+
+// Decode the window a view wants into the back buffer and show it
+static bool decodeWindow(uint32_t firstMs, uint32_t msPerColumn, uint32_t changes) {
+    Window target = targetFor(firstMs, msPerColumn);
+    uint64_t untilMs = windowEndMs(target);
+    for (uint32_t i = 0; i < (uint32_t)traceCount * windowColumns; i++) accumulators[i].count = 0;
+
+    uint32_t first = entryAt(target.firstMs);
+    uint32_t last = first;
+    while (last < entryCount && entries[last].rideMs < untilMs) last++;
+    uint32_t endOffset = last < entryCount ? entries[last].offset : blocksEnd;
+    bool ok;
+    if (endOffset - entries[first].offset > decodeLimit) {
+        ok = sampleKeyframes(first, target, untilMs, changes);
+    } else {
+        uint32_t lastMs = 0;
+        ok = decodeFrames(first, &target, untilMs, changes, lastMs);
+    }
+    if (!ok) return false;
+
+    uint8_t back = front ^ 1;
+    HistoryBucket* buckets = windows[back].buckets;
+    for (uint32_t i = 0; i < (uint32_t)traceCount * windowColumns; i++) {
+        const Accumulator& a = accumulators[i];
+        if (a.count == 0) {
+            buckets[i].min = INT32_MAX;
+            buckets[i].max = INT32_MIN;
+            buckets[i].mean = 0;
+        } else {
+            buckets[i].min = a.min;
+            buckets[i].max = a.max;
+            buckets[i].mean = (int32_t)(a.sum / a.count);
+        }
+    }
+    xSemaphoreTake(windowMutex, portMAX_DELAY);
+    windows[back].firstMs = target.firstMs;
+    windows[back].msPerColumn = target.msPerColumn;
+    windows[back].valid = true;
+    front = back;
+    decodedWindows++;
+    xSemaphoreGive(windowMutex);
+    return true;
+}
+
+// Decode until the window shown fits the latest view: it covers it, and
+// unless it already reaches an end of the ride, with room to pan either way
+static void updateWindow() {
+    for (;;) {
+        uint32_t firstMs, msPerColumn, changes;
+        readView(firstMs, msPerColumn, changes);
+        if (msPerColumn == 0) return;
+
+        const Window& shown = windows[front];
+        Window target = targetFor(firstMs, msPerColumn);
+        if (covers(shown, firstMs, msPerColumn)) {
+            uint32_t slack = (uint32_t)viewColumns / 2 * msPerColumn;
+            uint64_t viewEnd = firstMs + (uint64_t)viewColumns * msPerColumn;
+            bool roomBefore = firstMs - shown.firstMs >= slack || shown.firstMs == 0;
+            bool roomAfter = windowEndMs(shown) - viewEnd >= slack || windowEndMs(shown) > durationMs;
+            if ((roomBefore && roomAfter) || target.firstMs == shown.firstMs) return;
+        }
+        if (!decodeWindow(firstMs, msPerColumn, changes) && !obsolete(target, changes)) {
+            LOG_W(APP, "Review: could not read the log");
+            return;
+        }
+    }
+}
+
+static void closeFile() {
+    if (file) file.close();
+    entryCount = 0;
+    xSemaphoreTake(windowMutex, portMAX_DELAY);
+    windows[0].valid = windows[1].valid = false;
+    memset(&status, 0, sizeof(status));
+    xSemaphoreGive(windowMutex);
+}
+
+// Read the header, footer and index of a closed log of this format and
+// place the index on the ride time line
+static bool loadFile(int number) {
+    char path[32];
+    logPath(path, sizeof(path), number);
+    file = SD.open(path, FILE_READ);
+    if (!file) return false;
+
+    uint32_t size = file.size();
+    LogFileHeader header;
+    LogFooter footer;
+    if (!readAt(0, &header, sizeof(header)) || header.magic != LOG_MAGIC ||
+        header.version != LOG_FORMAT_VERSION || header.valueCount != LOG_VALUE_COUNT ||
+        size < sizeof(footer) || !readAt(size - sizeof(footer), &footer, sizeof(footer)) ||
+        !logFooterValid(footer, size) || footer.indexCount == 0 || footer.indexCount > INDEX_CAPACITY) {
+        file.close();
+        return false;
+    }
+
+    LogIndexEntry* raw = (LogIndexEntry*)slice;
+    const uint32_t perSlice = READ_SLICE / sizeof(LogIndexEntry);
+    int64_t bias = 0;
+    for (uint32_t i = 0; i < footer.indexCount; i += perSlice) {
+        uint32_t n = footer.indexCount - i < perSlice ? footer.indexCount - i : perSlice;
+        if (!readAt(footer.indexOffset + i * sizeof(LogIndexEntry), raw, n * sizeof(LogIndexEntry))) {
+            file.close();
+            return false;
+        }
+        for (uint32_t j = 0; j < n; j++) {
+            uint32_t k = i + j;
+            if (k == 0) {
+                bias = -(int64_t)raw[j].timeMs;
+            } else if (raw[j].timeMs < entries[k - 1].timeMs) {
+                // Resumed after a reboot: continue one block step on
+                uint32_t step = k > 1 ? entries[k - 1].rideMs - entries[k - 2].rideMs : 0;
+                bias = (int64_t)entries[k - 1].rideMs + step - raw[j].timeMs;
+            }
+            entries[k].timeMs = raw[j].timeMs;
+            entries[k].rideMs = (uint32_t)(raw[j].timeMs + bias);
+            entries[k].offset = raw[j].offset;
+        }
+    }
+    entryCount = footer.indexCount;
+    blocksEnd = footer.indexOffset;
+
+    // The ride ends in the blocks after the last index entry
+    uint32_t lastMs = entries[entryCount - 1].rideMs;
+    if (!decodeFrames(entryCount - 1, nullptr, UINT64_MAX, 0, lastMs)) {
+        LOG_W(APP, "Review: %s has a bad block after its last index entry", path);
+    }
+    durationMs = lastMs;
+
+    LogBlockHeader block;
+    uint64_t unixMs = readAt(entries[0].offset, &block, sizeof(block)) ? block.unixMs : 0;
+    xSemaphoreTake(windowMutex, portMAX_DELAY);
+    windows[0].valid = windows[1].valid = false;
+    status.file = number;
+    status.durationMs = durationMs;
+    status.unixMs = unixMs;
+    status.blocks = entryCount;
+    xSemaphoreGive(windowMutex);
+    LOG_I(APP, "Review: %s, %u s in %u indexed blocks", path, (unsigned)(durationMs / 1000), (unsigned)entryCount);
+    return true;
+}
+
+static void openLatest(int below) {
+    closeFile();
+    xSemaphoreTake(windowMutex, portMAX_DELAY);
+    status.searching = true;
+    xSemaphoreGive(windowMutex);
+
+    int last = 0;
+    char path[32];
+    for (int i = 1; i <= 9999; i++) {
+        logPath(path, sizeof(path), i);
+        if (!SD.exists(path)) break;
+        last = i;
+    }
+    if (below > 0 && below - 1 < last) last = below - 1;
+    bool found = false;
+    for (int i = last; i >= 1 && !found; i--) found = loadFile(i);
+    if (!found) LOG_I(APP, "Review: no closed log to show");
+
+    xSemaphoreTake(windowMutex, portMAX_DELAY);
+    status.searching = false;
+    xSemaphoreGive(windowMutex);
+}
+
+static void reviewTaskMain(void* param) {
+    for (;;) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        portENTER_CRITICAL(&requestMux);
+        int below = openBelow;
+        bool close = closePending;
+        openBelow = -1;
+        closePending = false;
+        portEXIT_CRITICAL(&requestMux);
+
+        taskBudgetStart(TASK_LOG_REVIEW);
+        if (close) closeFile();
+        if (below >= 0) openLatest(below);
+        if (file) updateWindow();
+        taskBudgetEnd(TASK_LOG_REVIEW);
+    }
+}
+
+bool logReviewBegin(const LogReviewTrace* list, uint8_t count, uint16_t columns, uint32_t maxDecodeBytes) {
+    if (task) return true;
+
+    if (SD.cardType() == CARD_NONE) {
+        LOG_I(APP, "No SD card, ride review off");
+        return false;
+    }
+    traceCount = count < LOG_REVIEW_MAX_TRACES ? count : LOG_REVIEW_MAX_TRACES;
+    memcpy(traces, list, traceCount * sizeof(LogReviewTrace));
+    viewColumns = columns;
+    windowColumns = columns * WINDOW_VIEWS;
+    decodeLimit = maxDecodeBytes;
+
+    size_t buckets = (size_t)traceCount * windowColumns;
+    entries = (ReviewEntry*)memoryAlloc(INDEX_CAPACITY * sizeof(ReviewEntry), MEMORY_BULK, MEMORY_TAG_LOGGER);
+    accumulators = (Accumulator*)memoryAlloc(buckets * sizeof(Accumulator), MEMORY_BULK, MEMORY_TAG_LOGGER);
+    slice = (uint8_t*)memoryAlloc(READ_SLICE + LOG_MAX_FRAME_SIZE, MEMORY_BULK, MEMORY_TAG_LOGGER);
+    for (int i = 0; i < 2; i++) {
+        windows[i].buckets =
+            (HistoryBucket*)memoryAlloc(buckets * sizeof(HistoryBucket), MEMORY_BULK, MEMORY_TAG_LOGGER);
+        windows[i].valid = false;
+    }
+    if (!entries || !accumulators || !slice || !windows[0].buckets || !windows[1].buckets) {
+        LOG_E(APP, "No PSRAM for the ride review");
+        memoryFree(entries);
+        memoryFree(accumulators);
+        memoryFree(slice);
+        for (int i = 0; i < 2; i++) memoryFree(windows[i].buckets);
+        entries = nullptr;
+        return false;
+    }
+    memset(&status, 0, sizeof(status));
+    windowMutex = xSemaphoreCreateMutex();
+
+    xTaskCreatePinnedToCore(reviewTaskMain, PLACEMENT.name, TASK_STACK_SIZE, nullptr, PLACEMENT.priority, &task,
+                            PLACEMENT.core);
+    perfWatchTask(task, MEMORY_TAG_LOGGER);
+    return true;
+}
+
+void logReviewOpen(int below) {
+    if (!task) return;
+    portENTER_CRITICAL(&requestMux);
+    openBelow = below;
+    viewMsPerColumn = 0;
+    viewChanges++;
+    portEXIT_CRITICAL(&requestMux);
+    xTaskNotifyGive(task);
+}
+
+void logReviewClose() {
+    if (!task) return;
+    portENTER_CRITICAL(&requestMux);
+    closePending = true;
+    viewMsPerColumn = 0;
+    viewChanges++;
+    portEXIT_CRITICAL(&requestMux);
+    xTaskNotifyGive(task);
+}
+
+LogReviewStatus logReviewStatus() {
+    LogReviewStatus out;
+    memset(&out, 0, sizeof(out));
+    if (!task) return out;
+    xSemaphoreTake(windowMutex, portMAX_DELAY);
+    out = status;
+    out.decoded = decodedWindows;
+    xSemaphoreGive(windowMutex);
+    return out;
+}
+
+void logReviewView(uint32_t firstMs, uint32_t msPerColumn) {
+    if (!task || msPerColumn == 0) return;
+    portENTER_CRITICAL(&requestMux);
+    bool changed = firstMs != viewFirstMs || msPerColumn != viewMsPerColumn;
+    viewFirstMs = firstMs;
+    viewMsPerColumn = msPerColumn;
+    if (changed) viewChanges++;
+    portEXIT_CRITICAL(&requestMux);
+    if (changed) xTaskNotifyGive(task);
+}
+
+bool logReviewCopy(HistoryBucket* out) {
+    if (!task) return false;
+    uint32_t firstMs, msPerColumn, changes;
+    readView(firstMs, msPerColumn, changes);
+    xSemaphoreTake(windowMutex, portMAX_DELAY);
+    const Window& shown = windows[front];
+    bool ok = covers(shown, firstMs, msPerColumn);
+    if (ok) {
+        uint32_t column = (firstMs - shown.firstMs) / msPerColumn;
+        for (uint8_t t = 0; t < traceCount; t++) {
+            memcpy(out + t * viewColumns, shown.buckets + t * windowColumns + column,
+                   viewColumns * sizeof(HistoryBucket));
+        }
+    }
+    xSemaphoreGive(windowMutex);
+    return ok;
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <stdint.h>
+#include "log_format.h"
+#include "../telemetry/history_pyramid.h"
+
+// Reads closed telemetry logs back from the SD card for the ride review
+// screen, without ever holding a whole log in memory.
+//
+// The screen asks for a view: a start time and a resolution in ms per
+// column. A low-priority task seeks to it through the file's block index
+// and decodes a window three views wide, the view plus a view's margin
+// each side, into min/max/mean columns. A window that spans more than
+// maxDecodeBytes of blocks is not decoded frame by frame; only the
+// keyframe leading each indexed block is read, one sector per block, so
+// zoomed out over hours a column shows one sample per block and short
+// spikes can be missed. Windows are double-buffered: the one shown stays
+// put while the next is decoded, and panning by up to half a view is
+// served at once from the margin while the task recentres behind it.
+//
+// Times are ride time, ms from the first frame of the file. A file that
+// was resumed after a reboot restarts millis(); the time lost to the
+// reboot is squeezed out, so the ride continues where it stopped.
+//
+// One task (the UI) opens files, sets views and copies columns.
+
+static const uint8_t LOG_REVIEW_MAX_TRACES = 4;
+
+// A value drawn on the review screen, and the reply field it needs
+struct LogReviewTrace {
+    LogValue value;
+    uint32_t field;             // VALUES_FIELD_*; samples without it are skipped
+};
+
+struct LogReviewStatus {
+    int file;                   // Number of the open log (ride<file>.vdl), 0 if none
+    bool searching;             // An open is in progress
+    uint32_t durationMs;        // Ride time of the last frame
+    uint64_t unixMs;            // UTC at the first frame, 0 if the log has none
+    uint32_t blocks;            // Indexed blocks
+    uint32_t decoded;           // Windows decoded so far; a change means new columns
+};
+
+// Allocate the windows for views `columns` wide and start the review
+// task. Returns false without an SD card or the memory.
+bool logReviewBegin(const LogReviewTrace* traces, uint8_t count, uint16_t columns, uint32_t maxDecodeBytes);
+
+// Open the newest closed log numbered below `below`, or the newest of all
+// for 0. Logs of another format version are passed over. The open runs
+// on the review task; watch logReviewStatus().
+void logReviewOpen(int below);
+
+// Close the file and drop the windows
+void logReviewClose();
+
+LogReviewStatus logReviewStatus();
+
+// Show [firstMs, firstMs + columns * msPerColumn); firstMs should be a
+// multiple of msPerColumn
+void logReviewView(uint32_t firstMs, uint32_t msPerColumn);
+
+// Copy the view's columns, [trace][column] with `columns` per trace, if
+// a decoded window covers it; columns without a sample have min > max.
+// Returns false while the view is still being decoded.
+bool logReviewCopy(HistoryBucket* out);
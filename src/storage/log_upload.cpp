@@ -0,0 +1,265 @@
+#include "log_upload.h"
+#include "log_format.h"
+#include "../log.h"
+#include "../system/coexist.h"
+#include "../system/crash_report.h"
+#include "../system/perf_stats.h"
+#include "../system/spi_bus.h"
+#include "../system/task_layout.h"
+#include "../system/wifi_station.h"
+#include "../system/memory.h"
+
+#include <Arduino.h>
+#include <HTTPClient.h>
+#include <Preferences.h>
+#include <SD.h>
+#include <WiFi.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <string.h>
+
+static const char* LOG_DIRECTORY = "/logs";
+static const char* LOG_EXTENSION = ".vdl";
+static const char* NVS_NAMESPACE = "upload";
+static const size_t READ_SLICE = 4096;        // Card reads per SPI bus hold; the LCD shares the bus
+static const uint32_t READ_SLICE_MS = 4;      // What one takes, kept clear of the next render
+static const uint32_t JOIN_TIMEOUT_MS = 15000;
+static const uint16_t HTTP_TIMEOUT_MS = 10000;
+static const uint32_t TASK_STACK_SIZE = 8192;
+static const TaskPlacement& PLACEMENT = TASK_PLACEMENT[TASK_LOG_UPLOAD];
+
+static LogUploadSettings config;
+static uint8_t* chunk = nullptr;
+static volatile bool allowed = false;
+static bool wanted = false;                   // We asked for the shared station
+
+static portMUX_TYPE statsMux = portMUX_INITIALIZER_UNLOCKED;
+static LogUploadStats stats;
+
+static void setCurrent(const char* name) {
+    portENTER_CRITICAL(&statsMux);
+    strncpy(stats.current, name, sizeof(stats.current) - 1);
+    stats.current[sizeof(stats.current) - 1] = '\0';
+    portEXIT_CRITICAL(&statsMux);
+}
+
+static void countFailure() {
+    portENTER_CRITICAL(&statsMux);
+    stats.failures++;
+    portEXIT_CRITICAL(&statsMux);
+}
+
+// Upload progress per file name, which fits an NVS key
+static uint32_t loadProgress(const char* name) {
+    Preferences prefs;
+    if (!prefs.begin(NVS_NAMESPACE, true)) return 0;
+    uint32_t offset = prefs.getUInt(name, 0);
+    prefs.end();
+    return offset;
+}
+
+static void saveProgress(const char* name, uint32_t offset) {
+    Preferences prefs;
+    if (!prefs.begin(NVS_NAMESPACE, false)) return;
+    prefs.putUInt(name, offset);
+    prefs.end();
+}
+
+// Only closed logs are uploaded; they are never written again
+static bool isClosedLog(File& file) {
+    uint32_t size = file.size();
+    LogFooter footer;
+    return size >= sizeof(footer) && file.seek(size - sizeof(footer)) &&
+           file.read((uint8_t*)&footer, sizeof(footer)) == sizeof(footer) &&
+           logFooterValid(footer, size);
+}
+
+static bool endsWith(const char* s, const char* suffix) {
+    size_t n = strlen(s), m = strlen(suffix);
+    return n >= m && strcmp(s + n - m, suffix) == 0;
+}
+
+// Join the AP, or use the station if another user has it up
+static bool joinNetwork() {
+    if (!wanted) {
+        wanted = true;
+        wifiStationWant(WIFI_USER_LOG_UPLOAD, config.ssid, config.password);
+    }
+    if (!wifiStationWait(JOIN_TIMEOUT_MS, allowed)) return false;
+    if (!stats.wifiConnected) LOG_I(APP, "Upload: on %s, %s", config.ssid, WiFi.localIP().toString().c_str());
+    stats.wifiConnected = true;
+    return true;
+}
+
+static void leaveNetwork() {
+    stats.wifiConnected = false;
+    if (!wanted) return;
+    wanted = false;
+    wifiStationRelease(WIFI_USER_LOG_UPLOAD);
+}
+
+static size_t readChunk(File& file, uint32_t offset, size_t length) {
+    if (!file.seek(offset)) return 0;
+    size_t done = 0;
+    while (done < length) {
+        size_t n = length - done < READ_SLICE ? length - done : READ_SLICE;
+        coexistAcquire(COEXIST_SD_READ);
+        spiBusCardBegin(READ_SLICE_MS);
+        size_t got = file.read(chunk + done, n);
+        spiBusCardEnd();
+        done += got;
+        if (got != n) break;
+    }
+    return done;
+}
+
+// Send one chunk. Returns the offset to continue from: past the chunk if
+// it was accepted, the server's offset on a 409, or offset on failure.
+static uint32_t sendChunk(const char* name, uint32_t offset, size_t length, uint32_t total) {
+    char url[160];
+    snprintf(url, sizeof(url), "%s/%s", config.url, name);
+    static const char* HEADER_KEYS[] = { "X-Upload-Offset" };
+
+    // Start the request in a gap between polls; the radio arbiter still
+    // prefers Bluetooth while it is on the air
+    coexistAcquire(COEXIST_WIFI);
+    HTTPClient http;
+    http.setTimeout(HTTP_TIMEOUT_MS);
+    if (!http.begin(url)) {
+        LOG_W(APP, "Upload: bad URL %s", url);
+        return offset;
+    }
+    http.collectHeaders(HEADER_KEYS, 1);
+    http.addHeader("Content-Type", "application/octet-stream");
+    http.addHeader("X-Upload-Offset", String(offset));
+    http.addHeader("X-Upload-Total", String(total));
+    int code = http.sendRequest("POST", chunk, length);
+
+    uint32_t next = offset;
+    if (code >= 200 && code < 300) {
+        next = offset + length;
+    } else if (code == 409 && http.hasHeader("X-Upload-Offset")) {
+        next = strtoul(http.header("X-Upload-Offset").c_str(), nullptr, 10);
+        if (next > total) next = total;
+        LOG_I(APP, "Upload: server has %s up to %u", name, (unsigned)next);
+    } else {
+        LOG_W(APP, "Upload: %s at %u failed (%d)", name, (unsigned)offset, code);
+    }
+    http.end();
+    return next;
+}
+
+// Upload the rest of one file. Returns false if it stopped short.
+static bool uploadFile(File& file, const char* name, uint32_t offset) {
+    uint32_t total = file.size();
+    setCurrent(name);
+    LOG_I(APP, "Upload: %s from %u of %u bytes", name, (unsigned)offset, (unsigned)total);
+    while (offset < total) {
+        if (!allowed || WiFi.status() != WL_CONNECTED) return false;
+
+        size_t length = total - offset < config.chunkBytes ? total - offset : config.chunkBytes;
+        if (readChunk(file, offset, length) != length) {
+            LOG_W(APP, "Upload: could not read %s", name);
+            return false;
+        }
+        uint32_t next = sendChunk(name, offset, length, total);
+        if (next == offset) {
+            countFailure();
+            return false;
+        }
+        if (next > offset) {
+            portENTER_CRITICAL(&statsMux);
+            stats.bytesUploaded += next - offset;
+            portEXIT_CRITICAL(&statsMux);
+        }
+        offset = next;
+        saveProgress(name, offset);
+    }
+    portENTER_CRITICAL(&statsMux);
+    stats.filesUploaded++;
+    portEXIT_CRITICAL(&statsMux);
+    LOG_I(APP, "Upload: %s done", name);
+    return true;
+}
+
+// One pass over the log directory. Returns false if an upload failed.
+static bool uploadPending() {
+    File dir = SD.open(LOG_DIRECTORY);
+    if (!dir || !dir.isDirectory()) return true;
+
+    bool ok = true;
+    for (File file = dir.openNextFile(); file && ok && allowed; file = dir.openNextFile()) {
+        char name[16];
+        strncpy(name, file.name(), sizeof(name) - 1);
+        name[sizeof(name) - 1] = '\0';
+        // Crash reports are renamed into place whole
+        bool crash = strncmp(name, "crash", 5) == 0 &&
+                     (endsWith(name, CRASH_SUMMARY_EXTENSION) || endsWith(name, CRASH_DUMP_EXTENSION));
+        if (!file.isDirectory() && (crash || endsWith(name, LOG_EXTENSION))) {
+            uint32_t offset = loadProgress(name);
+            if (offset < file.size() && (crash || isClosedLog(file))) ok = uploadFile(file, name, offset);
+        }
+        file.close();
+    }
+    dir.close();
+    setCurrent("");
+    return ok;
+}
+
+static void uploadTaskMain(void* param) {
+    for (;;) {
+        if (!allowed) {
+            leaveNetwork();
+            vTaskDelay(pdMS_TO_TICKS(1000));
+            continue;
+        }
+        if (!joinNetwork()) {
+            stats.wifiConnected = false;
+            vTaskDelay(pdMS_TO_TICKS(config.retryMs));
+            continue;
+        }
+        uploadPending();
+        // Nothing left or something failed: look again later, off the air
+        leaveNetwork();
+        uint32_t waited = 0;
+        while (allowed && waited < config.retryMs) {
+            vTaskDelay(pdMS_TO_TICKS(1000));
+            waited += 1000;
+        }
+    }
+}
+
+bool logUploadBegin(const LogUploadSettings& settings) {
+    if (chunk) return true;
+
+    if (SD.cardType() == CARD_NONE) {
+        LOG_I(APP, "No SD card, log upload off");
+        return false;
+    }
+    chunk = (uint8_t*)memoryAlloc(settings.chunkBytes, MEMORY_BULK, MEMORY_TAG_LOGGER);
+    if (!chunk) {
+        LOG_E(APP, "No PSRAM for a %u byte upload chunk", (unsigned)settings.chunkBytes);
+        return false;
+    }
+    config = settings;
+    memset(&stats, 0, sizeof(stats));
+
+    TaskHandle_t task = nullptr;
+    xTaskCreatePinnedToCore(uploadTaskMain, PLACEMENT.name, TASK_STACK_SIZE, nullptr,
+                            PLACEMENT.priority, &task, PLACEMENT.core);
+    perfWatchTask(task, MEMORY_TAG_LOGGER);
+    LOG_I(APP, "Log upload to %s via %s", settings.url, settings.ssid);
+    return true;
+}
+
+void logUploadAllow(bool allow) {
+    allowed = allow;
+}
+
+LogUploadStats logUploadStats() {
+    LogUploadStats out;
+    portENTER_CRITICAL(&statsMux);
+    out = stats;
+    portEXIT_CRITICAL(&statsMux);
+    return out;
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Uploads finished telemetry logs over WiFi, byte for byte as they are on
+// the card (the frames are already delta-compressed), so the server can
+// store them as .vdl files.
+//
+// A low-priority task on the radio core joins the configured AP while
+// uploading is allowed and walks /logs for closed files (those ending in
+// a valid LogFooter; the file being written never has one), and for the
+// crash reports of crash_report.h. Each file is POSTed to <url>/<name> in
+// chunks, one request per chunk:
+//
+//     X-Upload-Offset: offset of the chunk in the file
+//     X-Upload-Total:  file size
+//
+// A 2xx reply accepts the chunk. A 409 reply carries the server's own
+// X-Upload-Offset, and the upload resumes from there, so either side
+// losing its progress costs at most a chunk. Progress is kept in NVS per
+// file, so an upload cut off by leaving the AP picks up where it stopped.
+//
+// WiFi is the shared station of wifi_station.h, started with modem sleep
+// and the coexistence arbiter set to prefer Bluetooth, and let go
+// whenever uploading is disallowed.
+
+struct LogUploadSettings {
+    const char* ssid;
+    const char* password;
+    const char* url;           // Base URL, without a trailing slash
+    size_t chunkBytes;         // Bytes per request, buffered in PSRAM
+    uint32_t retryMs;          // Pause after a failure or an idle pass
+};
+
+struct LogUploadStats {
+    bool wifiConnected;
+    uint32_t filesUploaded;    // Completed since boot
+    uint32_t bytesUploaded;    // Accepted since boot
+    uint32_t failures;         // Requests that failed or were refused
+    char current[16];          // File being uploaded, "" if none
+};
+
+// Allocate the chunk buffer and start the upload task. Returns false
+// without an SD card or the memory; uploading then stays off.
+bool logUploadBegin(const LogUploadSettings& settings);
+
+// Let the task use WiFi, e.g. only while no ride is in progress. Takes
+// effect between chunks. Off until first allowed.
+void logUploadAllow(bool allowed);
+
+LogUploadStats logUploadStats();
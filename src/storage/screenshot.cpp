@@ -0,0 +1,186 @@
+#include "screenshot.h"
+#include "../log.h"
+#include "../system/coexist.h"
+#include "../system/memory.h"
+#include "../system/perf_stats.h"
+#include "../system/spi_bus.h"
+#include "../system/task_layout.h"
+
+#include <Arduino.h>
+#include <SD.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <string.h>
+
+static const char* SCREEN_DIRECTORY = "/screens";
+static const uint16_t WRITE_SLICE_ROWS = 8;  // Rows per SPI bus hold; the LCD shares the bus
+static const uint32_t WRITE_SLICE_MS = 4;    // What a slice takes, kept clear of the next render
+static const uint32_t BMP_HEADER_SIZE = 54;  // File header and BITMAPINFOHEADER
+static const uint32_t TASK_STACK_SIZE = 4096;
+static const TaskPlacement& PLACEMENT = TASK_PLACEMENT[TASK_SCREENSHOT];
+
+enum CaptureState : uint8_t {
+    CAPTURE_IDLE,
+    CAPTURE_READING,            // The UI is reading bands
+    CAPTURE_WRITING             // The task owns the frame
+};
+
+static TaskHandle_t task = nullptr;
+static uint16_t rowsPerBand = 8;
+static volatile CaptureState state = CAPTURE_IDLE;
+static uint8_t* frame = nullptr;             // Rows top down, R, G, B a pixel
+static int16_t frameWidth = 0;
+static int16_t frameHeight = 0;
+static int16_t rowsRead = 0;
+static uint32_t captureStartMs = 0;
+static int nextNumber = 1;                   // Below it every name is taken
+static volatile uint32_t saved = 0;
+
+static void putLittle(uint8_t* out, uint32_t value, uint8_t bytes) {
+    for (uint8_t i = 0; i < bytes; i++) out[i] = (uint8_t)(value >> (8 * i));
+}
+
+static void bmpHeader(uint8_t* out, int16_t width, int16_t height) {
+    uint32_t imageBytes = (uint32_t)width * 3 * height;   // 320 * 3 is already 4-byte aligned
+    memset(out, 0, BMP_HEADER_SIZE);
+    out[0] = 'B';
+    out[1] = 'M';
+    putLittle(out + 2, BMP_HEADER_SIZE + imageBytes, 4);
+    putLittle(out + 10, BMP_HEADER_SIZE, 4);
+    putLittle(out + 14, 40, 4);
+    putLittle(out + 18, width, 4);
+    putLittle(out + 22, height, 4);         // Positive: rows bottom up
+    putLittle(out + 26, 1, 2);
+    putLittle(out + 28, 24, 2);
+    putLittle(out + 34, imageBytes, 4);
+    putLittle(out + 38, 2835, 4);           // 72 dpi
+    putLittle(out + 42, 2835, 4);
+}
+
+// The first free number from nextNumber on, one card lookup per bus hold
+static File createFile(char* path, size_t size) {
+    File file;
+    coexistAcquire(COEXIST_SD_WRITE);
+    spiBusCardBegin(WRITE_SLICE_MS);
+    if (!SD.exists(SCREEN_DIRECTORY)) SD.mkdir(SCREEN_DIRECTORY);
+    spiBusCardEnd();
+    for (; nextNumber <= 9999; nextNumber++) {
+        snprintf(path, size, "%s/screen%04d.bmp", SCREEN_DIRECTORY, nextNumber);
+        coexistAcquire(COEXIST_SD_WRITE);
+        spiBusCardBegin(WRITE_SLICE_MS);
+        bool taken = SD.exists(path);
+        if (!taken) file = SD.open(path, FILE_WRITE);
+        spiBusCardEnd();
+        if (taken) continue;
+        nextNumber++;
+        break;
+    }
+    return file;
+}
+
+static bool writeFrame(File& file) {
+    uint8_t header[BMP_HEADER_SIZE];
+    bmpHeader(header, frameWidth, frameHeight);
+    size_t rowBytes = (size_t)frameWidth * 3;
+
+    // BMP wants B, G, R
+    for (size_t i = 0; i < rowBytes * frameHeight; i += 3) {
+        uint8_t red = frame[i];
+        frame[i] = frame[i + 2];
+        frame[i + 2] = red;
+    }
+
+    coexistAcquire(COEXIST_SD_WRITE);
+    spiBusCardBegin(WRITE_SLICE_MS);
+    bool ok = file.write(header, sizeof(header)) == sizeof(header);
+    spiBusCardEnd();
+    for (int16_t row = frameHeight - 1; ok && row >= 0;) {
+        // Between polls, so the SPI bus and CPU are free when replies land
+        coexistAcquire(COEXIST_SD_WRITE);
+        spiBusCardBegin(WRITE_SLICE_MS);
+        for (uint16_t n = 0; ok && n < WRITE_SLICE_ROWS && row >= 0; n++, row--) {
+            ok = file.write(frame + row * rowBytes, rowBytes) == rowBytes;
+        }
+        spiBusCardEnd();
+    }
+    coexistAcquire(COEXIST_SD_WRITE);
+    spiBusCardBegin(WRITE_SLICE_MS);
+    file.close();
+    spiBusCardEnd();
+    return ok;
+}
+
+static void writerTaskMain(void* param) {
+    for (;;) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        if (state != CAPTURE_WRITING) continue;
+
+        taskBudgetStart(TASK_SCREENSHOT);
+        char path[32];
+        File file = createFile(path, sizeof(path));
+        if (!file) {
+            LOG_E(APP, "Could not create a screenshot file");
+        } else if (!writeFrame(file)) {
+            LOG_E(APP, "SD write failed saving %s", path);
+        } else {
+            saved++;
+            LOG_I(APP, "Saved a %dx%d screenshot to %s in %u ms", frameWidth, frameHeight, path,
+                  (unsigned)(millis() - captureStartMs));
+        }
+        memoryFree(frame);
+        frame = nullptr;
+        state = CAPTURE_IDLE;
+        taskBudgetEnd(TASK_SCREENSHOT);
+    }
+}
+
+bool screenshotBegin(uint16_t bandRows) {
+    if (task) return true;
+
+    if (SD.cardType() == CARD_NONE) {
+        LOG_I(APP, "No SD card, screenshots off");
+        return false;
+    }
+    rowsPerBand = bandRows > 0 ? bandRows : 1;
+    xTaskCreatePinnedToCore(writerTaskMain, PLACEMENT.name, TASK_STACK_SIZE, nullptr, PLACEMENT.priority, &task,
+                            PLACEMENT.core);
+    perfWatchTask(task, MEMORY_TAG_LOGGER);
+    return true;
+}
+
+bool screenshotRequest() {
+    if (!task || state != CAPTURE_IDLE) return false;
+
+    DisplayGfx& panel = displayPanel();
+    frameWidth = panel.width();
+    frameHeight = panel.height();
+    frame = (uint8_t*)memoryAlloc((size_t)frameWidth * 3 * frameHeight, MEMORY_BULK, MEMORY_TAG_LOGGER);
+    if (!frame) {
+        LOG_E(APP, "No PSRAM for a %dx%d screenshot", frameWidth, frameHeight);
+        return false;
+    }
+    rowsRead = 0;
+    captureStartMs = millis();
+    state = CAPTURE_READING;
+    return true;
+}
+
+void screenshotFrame(DisplayGfx& panel) {
+    if (state != CAPTURE_READING) return;
+
+    int16_t rows = frameHeight - rowsRead < rowsPerBand ? frameHeight - rowsRead : rowsPerBand;
+    panel.readRectRGB(0, rowsRead, frameWidth, rows, frame + (size_t)rowsRead * frameWidth * 3);
+    rowsRead += rows;
+    if (rowsRead < frameHeight) return;
+
+    state = CAPTURE_WRITING;
+    xTaskNotifyGive(task);
+}
+
+bool screenshotBusy() {
+    return state != CAPTURE_IDLE;
+}
+
+uint32_t screenshotCount() {
+    return saved;
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <stdint.h>
+#include "../ui/display.h"
+
+// Screenshots of the panel to the SD card, as 24-bit BMPs numbered
+// /screens/screenNNNN.bmp.
+//
+// Not every widget draws through a sprite (some go straight to the
+// panel), so the frame is read back from the panel itself. The UI reads
+// a band of rows after each render, inside its own hold of the SPI bus,
+// into a frame buffer in PSRAM; rendering carries on and the only cost
+// is the band's read. A screen that changes while it is being read
+// shows the change from the band read after it. Once the last band is
+// in, a low-priority task writes the file, one card slice at a time
+// between the polls and renders, and frees the buffer.
+//
+// One capture at a time. The UI task requests and reads; the task only
+// writes.
+
+// Start the writer task, reading bandRows rows per frame. Returns false
+// without an SD card.
+bool screenshotBegin(uint16_t bandRows);
+
+// Start a capture of the panel. Returns false if there is no card, one
+// is already running, or the frame buffer could not be had.
+bool screenshotRequest();
+
+// From the UI loop after a render, while it holds the bus: read the next
+// band of a capture, if one is running
+void screenshotFrame(DisplayGfx& panel);
+
+// A capture is being read or written
+bool screenshotBusy();
+
+// Screenshots saved since boot
+uint32_t screenshotCount();
@@ -0,0 +1,84 @@
+#include "slot_store.h"
+#include "../vesc/crc.h"
+#include "../log.h"
+
+#include <Preferences.h>
+#include <string.h>
+
+struct __attribute__((packed)) SlotHeader {
+    uint32_t sequence;
+    uint16_t length;
+    uint16_t crc;            // Of the header's first six bytes and the record
+};
+
+static uint16_t slotCrc(const SlotHeader& header, const uint8_t* record, size_t size) {
+    uint16_t crc = crc16((const uint8_t*)&header, offsetof(SlotHeader, crc));
+    return crc16Update(crc, record, size);
+}
+
+static void slotKey(uint8_t slot, char* key) {
+    key[0] = 's';
+    key[1] = (char)('0' + slot);
+    key[2] = '\0';
+}
+
+SlotStore::SlotStore(const char* nvsNamespace, uint8_t slots)
+    : nvsNamespace(nvsNamespace), slotCount(slots < 1 ? 1 : (slots > MAX_SLOTS ? MAX_SLOTS : slots)),
+      newestSlot(slotCount - 1), sequence(0), saveCount(0) {
+}
+
+bool SlotStore::load(void* record, size_t size) {
+    if (size > MAX_RECORD) return false;
+    Preferences prefs;
+    if (!prefs.begin(nvsNamespace, true)) return false;
+
+    bool found = false;
+    uint8_t blob[sizeof(SlotHeader) + MAX_RECORD];
+    for (uint8_t slot = 0; slot < slotCount; slot++) {
+        char key[4];
+        slotKey(slot, key);
+        size_t n = prefs.getBytes(key, blob, sizeof(SlotHeader) + size);
+        if (n != sizeof(SlotHeader) + size) continue;
+        SlotHeader header;
+        memcpy(&header, blob, sizeof(header));
+        const uint8_t* payload = blob + sizeof(header);
+        if (header.length != size || header.crc != slotCrc(header, payload, size)) continue;
+        if (found && (int32_t)(header.sequence - sequence) <= 0) continue;
+        memcpy(record, payload, size);
+        sequence = header.sequence;
+        newestSlot = slot;
+        found = true;
+    }
+    prefs.end();
+    return found;
+}
+
+bool SlotStore::save(const void* record, size_t size) {
+    if (size > MAX_RECORD) return false;
+    uint8_t blob[sizeof(SlotHeader) + MAX_RECORD];
+    SlotHeader header;
+    header.sequence = sequence + 1;
+    header.length = (uint16_t)size;
+    header.crc = slotCrc(header, (const uint8_t*)record, size);
+    memcpy(blob, &header, sizeof(header));
+    memcpy(blob + sizeof(header), record, size);
+
+    Preferences prefs;
+    if (!prefs.begin(nvsNamespace, false)) {
+        LOG_W(APP, "Could not open NVS namespace %s", nvsNamespace);
+        return false;
+    }
+    uint8_t slot = (newestSlot + 1) % slotCount;
+    char key[4];
+    slotKey(slot, key);
+    bool written = prefs.putBytes(key, blob, sizeof(header) + size) == sizeof(header) + size;
+    prefs.end();
+    if (!written) {
+        LOG_W(APP, "Could not store %s slot %d", nvsNamespace, slot);
+        return false;
+    }
+    sequence = header.sequence;
+    newestSlot = slot;
+    saveCount++;
+    return true;
+}
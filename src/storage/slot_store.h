@@ -0,0 +1,40 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+// A small record kept in NVS that is rewritten often. Each save goes to
+// the next of a ring of slots, stamped with a sequence number and a CRC,
+// so successive writes land on different keys and a write cut short by
+// power loss leaves the slot before it to load. NVS already spreads its
+// page erases; the ring moves the rewritten entries along with them and
+// keeps one intact copy through a torn write.
+//
+// Not thread safe; callers that save from more than one task lock
+// around it.
+class SlotStore {
+public:
+    static const uint8_t MAX_SLOTS = 8;
+    static const size_t MAX_RECORD = 120;
+
+    // slots is clamped to 1..MAX_SLOTS
+    SlotStore(const char* nvsNamespace, uint8_t slots);
+
+    // The newest intact record of exactly size bytes. Returns false if
+    // no slot holds one.
+    bool load(void* record, size_t size);
+
+    // Write the record to the slot after the newest. Returns false if NVS
+    // would not take it.
+    bool save(const void* record, size_t size);
+
+    // Saved since boot
+    uint32_t saves() const { return saveCount; }
+
+private:
+    const char* nvsNamespace;
+    uint8_t slotCount;
+    uint8_t newestSlot;
+    uint32_t sequence;       // Of the newest record
+    uint32_t saveCount;
+};
@@ -0,0 +1,533 @@
+#include "telemetry_log.h"
+#include "log_format.h"
+#include "../log.h"
+#include "../system/coexist.h"
+#include "../system/perf_stats.h"
+#include "../system/probes.h"
+#include "../system/spi_bus.h"
+#include "../system/task_layout.h"
+#include "../system/wall_clock.h"
+#include "../system/memory.h"
+
+#include <Arduino.h>
+#include <SD.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include <freertos/task.h>
+#include <string.h>
+#include <unistd.h>
+
+static const char* LOG_DIRECTORY = "/logs";
+static const char* SD_MOUNT_POINT = "/sd";   // Where SD.begin() mounts the card for POSIX calls
+static const size_t WRITE_SLICE = 4096;      // Card writes per SPI bus hold; the LCD shares the bus
+static const uint32_t WRITE_SLICE_MS = 8;    // What one takes, kept clear of the next render
+static const uint32_t TASK_STACK_SIZE = 6144;
+static const TaskPlacement& PLACEMENT = TASK_PLACEMENT[TASK_SD_LOG];
+static const int COMMAND_QUEUE_LENGTH = 4;   // Open, close and both blocks at most
+static const uint32_t INDEX_CAPACITY = 4096; // Block index entries kept for the footer
+static const size_t PAYLOAD_OFFSET = sizeof(LogBlockHeader);
+static const UBaseType_t FLUSH_PRIORITY = 2;  // Writer priority until an urgent flush lands, below the decoder
+
+enum LogCommandType : uint8_t {
+    LOG_CMD_OPEN,
+    LOG_CMD_BLOCK,
+    LOG_CMD_CLOSE
+};
+
+struct LogCommand {
+    LogCommandType type;
+    uint8_t block;
+    uint8_t fwMajor;      // OPEN
+    uint8_t fwMinor;
+    uint32_t length;      // Payload bytes for BLOCK
+    uint32_t timeMs;      // First frame for BLOCK, start time for OPEN
+};
+
+static QueueHandle_t commandQueue = nullptr;
+static portMUX_TYPE bufferMux = portMUX_INITIALIZER_UNLOCKED;
+
+// Producer side, guarded by bufferMux. Each block buffer has room for
+// its LogBlockHeader in front of the payload.
+static uint8_t* blocks[2] = { nullptr, nullptr };
+static size_t blockSize = 0;
+static volatile bool blockBusy[2] = { false, false };  // Queued for or being written
+static uint8_t activeBlock = 0;
+static uint32_t handedOff = 0;          // Blocks handed to the writer since boot
+static bool flushWanted = false;        // An urgent flush waits for the other block to come free
+static size_t activeLength = 0;        // Payload bytes in the active block
+static uint32_t blockStartMs = 0;      // Time of the active block's first frame
+static bool active = false;
+static uint32_t records = 0;
+static uint32_t dropped = 0;
+static uint16_t keyframeInterval = 0;
+static uint32_t flushInterval = 0;
+static LogSample previous;
+static bool havePrevious = false;      // false forces the next frame to be a keyframe
+static uint32_t framesSinceKey = 0;
+
+// Writer side
+static File file;
+static uint32_t fileOffset = 0;        // Where the next block goes
+static uint32_t nextSequence = 0;
+static uint16_t nextFlags = 0;
+static bool resumePending = false;     // A recovered file waits for the next open
+static char resumePath[32];
+static uint8_t sector[LOG_SECTOR_SIZE];
+static volatile uint32_t bytesWritten = 0;
+static volatile uint32_t slowestWriteMs = 0;
+static volatile uint32_t recoveredBlocks = 0;
+static volatile bool fileOpen = false;  // Read by telemetryLogClosed()
+static volatile uint32_t blocksDone = 0;   // Blocks the writer finished with, written or not
+static volatile uint32_t boostTicket = 0;  // The writer runs at FLUSH_PRIORITY until this block is done
+static TaskHandle_t writerTask = nullptr;
+
+// Block index. When it fills up every other entry is dropped and only
+// every indexStride-th block is added from then on, so it always spans
+// the whole file.
+static LogIndexEntry* blockIndex = nullptr;
+static uint32_t indexCount = 0;
+static uint32_t indexStride = 1;
+static uint32_t indexedBlocks = 0;
+
+static void resetIndex() {
+    indexCount = 0;
+    indexStride = 1;
+    indexedBlocks = 0;
+}
+
+static void indexBlock(uint32_t timeMs, uint32_t offset) {
+    if (indexedBlocks++ % indexStride != 0) return;
+
+    if (indexCount == INDEX_CAPACITY) {
+        for (uint32_t i = 0; i < INDEX_CAPACITY / 2; i++) {
+            blockIndex[i] = blockIndex[i * 2];
+        }
+        indexCount = INDEX_CAPACITY / 2;
+        indexStride *= 2;
+        if ((indexedBlocks - 1) % indexStride != 0) return;
+    }
+    blockIndex[indexCount].timeMs = timeMs;
+    blockIndex[indexCount].offset = offset;
+    indexCount++;
+}
+
+static void logPath(char* path, size_t size, int number) {
+    snprintf(path, size, "%s/ride%04d.vdl", LOG_DIRECTORY, number);
+}
+
+static bool openNextFile(const LogCommand& command) {
+    if (!SD.exists(LOG_DIRECTORY)) SD.mkdir(LOG_DIRECTORY);
+
+    char path[32];
+    for (int i = 1; i <= 9999; i++) {
+        logPath(path, sizeof(path), i);
+        if (SD.exists(path)) continue;
+        file = SD.open(path, FILE_WRITE);
+        if (!file) break;
+
+        // The header gets a sector to itself so every block is aligned
+        VescFirmware firmware;
+        memset(&firmware, 0, sizeof(firmware));
+        firmware.major = command.fwMajor;
+        firmware.minor = command.fwMinor;
+        memset(sector, 0, sizeof(sector));
+        logFillHeader(*(LogFileHeader*)sector, firmware, command.timeMs, keyframeInterval);
+        if (file.write(sector, sizeof(sector)) != sizeof(sector)) {
+            LOG_E(APP, "SD write failed, telemetry log not started");
+            file.close();
+            return false;
+        }
+        file.flush();
+        fileOffset = sizeof(sector);
+        bytesWritten = sizeof(sector);
+        nextSequence = 0;
+        nextFlags = 0;
+        resetIndex();
+        LOG_I(APP, "Logging telemetry to %s", path);
+        return true;
+    }
+    LOG_E(APP, "Could not create a telemetry log file");
+    return false;
+}
+
+// Check the newest log. If it has no footer, keep the leading run of
+// valid blocks, cut off the rest and set it up to be resumed.
+static void recoverLastLog() {
+    int last = 0;
+    char path[32];
+    for (int i = 1; i <= 9999; i++) {
+        logPath(path, sizeof(path), i);
+        if (!SD.exists(path)) break;
+        last = i;
+    }
+    if (last == 0) return;
+    logPath(path, sizeof(path), last);
+
+    File in = SD.open(path, FILE_READ);
+    if (!in) return;
+    uint32_t size = in.size();
+
+    LogFooter footer;
+    if (size >= sizeof(footer) && in.seek(size - sizeof(footer)) &&
+        in.read((uint8_t*)&footer, sizeof(footer)) == sizeof(footer) && logFooterValid(footer, size)) {
+        in.close();
+        return;
+    }
+
+    LogFileHeader header;
+    in.seek(0);
+    if (in.read((uint8_t*)&header, sizeof(header)) != sizeof(header) ||
+        header.magic != LOG_MAGIC || header.version != LOG_FORMAT_VERSION) {
+        LOG_W(APP, "%s was not closed and is not a format %u log, leaving it", path, LOG_FORMAT_VERSION);
+        in.close();
+        return;
+    }
+
+    uint32_t offset = LOG_SECTOR_SIZE;
+    uint32_t sequence = 0;
+    resetIndex();
+    while (offset + sizeof(LogBlockHeader) <= size) {
+        LogBlockHeader block;
+        if (!in.seek(offset) || in.read((uint8_t*)&block, sizeof(block)) != sizeof(block)) break;
+        if (block.magic != LOG_BLOCK_MAGIC || block.sequence != sequence ||
+            offset + logBlockSpan(block.payloadLength) > size) break;
+
+        uint32_t crc = logBlockHeaderCrc(block);
+        uint32_t left = block.payloadLength;
+        while (left > 0) {
+            size_t n = left < sizeof(sector) ? left : sizeof(sector);
+            if (in.read(sector, n) != n) break;
+            crc = logCrc32(crc, sector, n);
+            left -= n;
+        }
+        if (left > 0 || crc != block.crc) break;
+
+        indexBlock(block.firstTimeMs, offset);
+        offset += logBlockSpan(block.payloadLength);
+        sequence++;
+    }
+    in.close();
+
+    if (offset < size) {
+        char fullPath[40];
+        snprintf(fullPath, sizeof(fullPath), "%s%s", SD_MOUNT_POINT, path);
+        if (truncate(fullPath, offset) != 0) {
+            LOG_E(APP, "Could not truncate %s, leaving it", path);
+            return;
+        }
+    }
+
+    strlcpy(resumePath, path, sizeof(resumePath));
+    resumePending = true;
+    fileOffset = offset;
+    nextSequence = sequence;
+    recoveredBlocks = sequence;
+    LOG_I(APP, "Recovered %s: %u blocks, cut %u torn bytes", path, sequence, size - offset);
+}
+
+static bool openLog(const LogCommand& command) {
+    if (resumePending) {
+        resumePending = false;
+        file = SD.open(resumePath, FILE_APPEND);
+        if (file) {
+            bytesWritten = 0;
+            nextFlags = LOG_BLOCK_RESUMED;
+            LOG_I(APP, "Resuming telemetry log %s", resumePath);
+            return true;
+        }
+    }
+    return openNextFile(command);
+}
+
+static void writeBlock(const LogCommand& command) {
+    if (file) {
+        uint32_t started = millis();
+        uint8_t* data = blocks[command.block];
+        // Sample times are millis(), i.e. esp_timer time in ms
+        uint64_t unixMs = wallClockUnixMs((uint64_t)command.timeMs * 1000);
+        logSealBlock(*(LogBlockHeader*)data, nextSequence, command.timeMs, unixMs, nextFlags,
+                     data + PAYLOAD_OFFSET, command.length);
+        size_t span = logBlockSpan(command.length);
+        memset(data + PAYLOAD_OFFSET + command.length, 0, span - PAYLOAD_OFFSET - command.length);
+
+        size_t offset = 0;
+        while (offset < span) {
+            size_t n = span - offset < WRITE_SLICE ? span - offset : WRITE_SLICE;
+            // Between polls, so the SPI bus and CPU are free when replies land
+            coexistAcquire(COEXIST_SD_WRITE);
+            spiBusCardBegin(WRITE_SLICE_MS);
+            bool wrote = file.write(data + offset, n) == n;
+            spiBusCardEnd();
+            if (!wrote) {
+                LOG_E(APP, "SD write failed, closing telemetry log");
+                file.close();
+                break;
+            }
+            offset += n;
+        }
+        bytesWritten += offset;
+        if (file) {
+            // The only sync point: a power loss from here on costs at
+            // most the block being filled
+            coexistAcquire(COEXIST_SD_WRITE);
+            spiBusCardBegin(WRITE_SLICE_MS);
+            file.flush();
+            spiBusCardEnd();
+            indexBlock(command.timeMs, fileOffset);
+            fileOffset += span;
+            nextSequence++;
+            nextFlags = 0;
+        }
+
+        uint32_t took = millis() - started;
+        if (took > slowestWriteMs) slowestWriteMs = took;
+    }
+    blockBusy[command.block] = false;
+    blocksDone++;
+}
+
+static void closeLog() {
+    if (!file) return;
+
+    LogFooter footer;
+    footer.indexOffset = fileOffset;
+    footer.indexCount = indexCount;
+    footer.magic = LOG_INDEX_MAGIC;
+    file.write((const uint8_t*)blockIndex, indexCount * sizeof(LogIndexEntry));
+    file.write((const uint8_t*)&footer, sizeof(footer));
+    bytesWritten += indexCount * sizeof(LogIndexEntry) + sizeof(footer);
+    file.close();
+    LOG_I(APP, "Telemetry log closed, %u bytes", bytesWritten);
+}
+
+// Mark the active block for writing and switch to the other one. Called
+// with bufferMux held; the caller queues the returned command once the
+// lock is released. Returns false if the other block is still busy.
+static bool handOffActiveBlock(LogCommand& command) {
+    uint8_t next = activeBlock ^ 1;
+    if (blockBusy[next]) return false;
+
+    memset(&command, 0, sizeof(command));
+    command.type = LOG_CMD_BLOCK;
+    command.block = activeBlock;
+    command.length = activeLength;
+    command.timeMs = blockStartMs;
+    blockBusy[activeBlock] = true;
+    activeBlock = next;
+    activeLength = 0;
+    handedOff++;
+    return true;
+}
+
+static void writerTaskMain(void* param) {
+    recoverLastLog();
+
+    LogCommand command;
+    for (;;) {
+        if (xQueueReceive(commandQueue, &command, portMAX_DELAY) != pdTRUE) continue;
+
+        taskBudgetStart(TASK_SD_LOG);
+        switch (command.type) {
+            case LOG_CMD_OPEN:
+                if (file) file.close();
+                slowestWriteMs = 0;
+                openLog(command);
+                fileOpen = (bool)file;
+                break;
+            case LOG_CMD_BLOCK: {
+                writeBlock(command);
+                // An urgent flush that found both blocks busy sends the
+                // filling one as soon as this one is free
+                LogCommand next;
+                bool queued = false;
+                portENTER_CRITICAL(&bufferMux);
+                if (flushWanted && activeLength > 0) queued = handOffActiveBlock(next);
+                if (queued || activeLength == 0) flushWanted = false;
+                portEXIT_CRITICAL(&bufferMux);
+                if (queued) xQueueSend(commandQueue, &next, 0);
+                if (!queued && (int32_t)(blocksDone - boostTicket) >= 0 &&
+                    uxTaskPriorityGet(nullptr) != PLACEMENT.priority) {
+                    vTaskPrioritySet(nullptr, PLACEMENT.priority);
+                }
+                break;
+            }
+            case LOG_CMD_CLOSE:
+                closeLog();
+                fileOpen = false;
+                break;
+        }
+        taskBudgetEnd(TASK_SD_LOG);
+    }
+}
+
+bool telemetryLogBegin(size_t blockBytes, uint16_t keyframeFrames, uint32_t flushMs) {
+    if (commandQueue) return true;
+
+    if (SD.cardType() == CARD_NONE) {
+        LOG_I(APP, "No SD card, telemetry logging off");
+        return false;
+    }
+
+    // Whole sectors, so every block write lands sector-aligned
+    blockSize = (blockBytes + LOG_SECTOR_SIZE - 1) & ~(LOG_SECTOR_SIZE - 1);
+    for (int i = 0; i < 2; i++) {
+        blocks[i] = (uint8_t*)memoryAlloc(blockSize, MEMORY_BULK, MEMORY_TAG_LOGGER);
+        if (!blocks[i]) {
+            LOG_E(APP, "No PSRAM for %u byte telemetry log blocks", (unsigned)blockSize);
+            if (i == 1) memoryFree(blocks[0]);
+            blocks[0] = nullptr;
+            return false;
+        }
+    }
+
+    blockIndex = (LogIndexEntry*)memoryAlloc(INDEX_CAPACITY * sizeof(LogIndexEntry), MEMORY_BULK, MEMORY_TAG_LOGGER);
+    if (!blockIndex) {
+        LOG_E(APP, "No PSRAM for the telemetry log index");
+        memoryFree(blocks[0]);
+        memoryFree(blocks[1]);
+        blocks[0] = blocks[1] = nullptr;
+        return false;
+    }
+
+    keyframeInterval = keyframeFrames > 0 ? keyframeFrames : 1;
+    flushInterval = flushMs;
+    commandQueue = xQueueCreate(COMMAND_QUEUE_LENGTH, sizeof(LogCommand));
+    xTaskCreatePinnedToCore(writerTaskMain, PLACEMENT.name, TASK_STACK_SIZE, nullptr,
+                            PLACEMENT.priority, &writerTask, PLACEMENT.core);
+    perfWatchTask(writerTask, MEMORY_TAG_LOGGER);
+    return true;
+}
+
+void telemetryLogStart(const VescFirmware& firmware) {
+    if (!commandQueue || active) return;
+
+    LogCommand command;
+    memset(&command, 0, sizeof(command));
+    command.type = LOG_CMD_OPEN;
+    command.fwMajor = firmware.major;
+    command.fwMinor = firmware.minor;
+    command.timeMs = millis();
+    if (xQueueSend(commandQueue, &command, 0) != pdTRUE) return;
+
+    portENTER_CRITICAL(&bufferMux);
+    activeLength = 0;
+    records = 0;
+    dropped = 0;
+    havePrevious = false;
+    active = true;
+    portEXIT_CRITICAL(&bufferMux);
+}
+
+void telemetryLogStop() {
+    if (!commandQueue || !active) return;
+
+    LogCommand block;
+    bool handedOff = false;
+    portENTER_CRITICAL(&bufferMux);
+    active = false;
+    if (activeLength > 0) {
+        handedOff = handOffActiveBlock(block);
+        if (!handedOff) dropped++;
+    }
+    portEXIT_CRITICAL(&bufferMux);
+    if (handedOff) xQueueSend(commandQueue, &block, portMAX_DELAY);
+
+    LogCommand command;
+    memset(&command, 0, sizeof(command));
+    command.type = LOG_CMD_CLOSE;
+    xQueueSend(commandQueue, &command, portMAX_DELAY);
+}
+
+void telemetryLogAppend(const VescValues& values, uint32_t timeMs) {
+    if (!active) return;
+    PROBE_SCOPE("log_append");
+
+    LogSample sample;
+    logSampleFromValues(values, timeMs, sample);
+    uint8_t frame[LOG_MAX_FRAME_SIZE];
+
+    LogCommand block;
+    bool handedOff = false;
+    portENTER_CRITICAL(&bufferMux);
+    if (active) {
+        // Every block opens with a keyframe so it decodes on its own
+        bool keyframe = activeLength == 0 || !havePrevious || framesSinceKey >= keyframeInterval;
+        size_t length = logEncodeFrame(sample, keyframe ? nullptr : &previous, frame);
+        bool fits = activeLength + length <= blockSize - PAYLOAD_OFFSET;
+        if (!fits && handOffActiveBlock(block)) {
+            handedOff = true;
+            fits = true;
+            if (!keyframe) {
+                keyframe = true;
+                length = logEncodeFrame(sample, nullptr, frame);
+            }
+        }
+
+        if (fits) {
+            if (activeLength == 0) blockStartMs = timeMs;
+            memcpy(blocks[activeBlock] + PAYLOAD_OFFSET + activeLength, frame, length);
+            activeLength += length;
+            if (keyframe) framesSinceKey = 0;
+            framesSinceKey++;
+            previous = sample;
+            havePrevious = true;
+            records++;
+
+            // Bound what a power loss can take by flushing a partly
+            // filled block once it is old enough
+            if (!handedOff && timeMs - blockStartMs >= flushInterval) {
+                handedOff = handOffActiveBlock(block);
+            }
+        } else {
+            // The delta chain is broken; restart it with a keyframe
+            havePrevious = false;
+            dropped++;
+        }
+    }
+    portEXIT_CRITICAL(&bufferMux);
+    if (handedOff) xQueueSend(commandQueue, &block, 0);
+}
+
+uint32_t telemetryLogFlushNow() {
+    if (!commandQueue) return 0;
+
+    LogCommand block;
+    bool queued = false;
+    portENTER_CRITICAL(&bufferMux);
+    if (active && activeLength > 0) {
+        queued = handOffActiveBlock(block);
+        if (!queued) flushWanted = true;
+    }
+    // Blocks go out in the order they were handed off, so the flush is
+    // done once the writer is through the last one, or the one to come
+    uint32_t ticket = handedOff + (flushWanted ? 1 : 0);
+    portEXIT_CRITICAL(&bufferMux);
+    if (queued) xQueueSend(commandQueue, &block, portMAX_DELAY);
+
+    if ((int32_t)(ticket - blocksDone) > 0) {
+        boostTicket = ticket;
+        vTaskPrioritySet(writerTask, FLUSH_PRIORITY);
+    }
+    return ticket;
+}
+
+bool telemetryLogFlushed(uint32_t ticket) {
+    return (int32_t)(blocksDone - ticket) >= 0;
+}
+
+bool telemetryLogClosed() {
+    return !active && !fileOpen;
+}
+
+TelemetryLogStats telemetryLogStats() {
+    TelemetryLogStats stats;
+    portENTER_CRITICAL(&bufferMux);
+    stats.active = active;
+    stats.records = records;
+    stats.dropped = dropped;
+    portEXIT_CRITICAL(&bufferMux);
+    stats.bytesWritten = bytesWritten;
+    stats.slowestWriteMs = slowestWriteMs;
+    stats.recoveredBlocks = recoveredBlocks;
+    return stats;
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include "vesc/values.h"
+
+// Binary telemetry logging to the SD card (format in log_format.h):
+// delta-encoded frames in checksummed blocks, with a seek index.
+//
+// The decoder appends records into one of two PSRAM blocks; when a block
+// fills, or has been filling for the flush interval, a low-priority task
+// on the BT core writes and flushes it to the card while the other block
+// fills. Appending is a short copy under a spinlock and never waits on
+// the card, so a slow SD write costs at most dropped records (counted in
+// the stats), never a stalled decoder or UI.
+//
+// Only whole blocks are ever flushed, so a brown-out loses at most the
+// last flush interval, or less when it is seen coming (see
+// telemetryLogFlushNow()). On boot the writer task checks the newest log; if
+// it was not closed cleanly, a torn tail is cut off after the last block
+// whose sequence number and CRC check out, the index is rebuilt from the
+// block headers, and the next telemetryLogStart() appends to that file.
+
+struct TelemetryLogStats {
+    bool active;               // A file is open
+    uint32_t records;          // Appended to the current file
+    uint32_t dropped;          // Lost because both blocks were busy
+    uint32_t bytesWritten;     // Written to the card for the current file
+    uint32_t slowestWriteMs;   // Longest single block write
+    uint32_t recoveredBlocks;  // Kept from an unclosed log at boot
+};
+
+// Allocate the blocks and start the writer task, which first recovers an
+// unclosed log. A keyframe is written every keyframeFrames frames and a
+// partly filled block is flushed after flushMs. Returns false if there
+// is no SD card or not enough PSRAM; logging then stays off.
+bool telemetryLogBegin(size_t blockBytes, uint16_t keyframeFrames, uint32_t flushMs);
+
+// Open a new log file, or resume the one recovered at boot. Does nothing
+// if one is already open, so a reconnect continues the same file.
+void telemetryLogStart(const VescFirmware& firmware);
+
+// Write out what is buffered and close the file
+void telemetryLogStop();
+
+// Stopped, and the writer task has finished closing the file
+bool telemetryLogClosed();
+
+// Hand the partly filled block to the writer now instead of at the flush
+// interval, and raise the writer's priority until it and every block
+// queued before it are on the card. For when power is about to go; the
+// file stays open and appending goes on. Returns a ticket for
+// telemetryLogFlushed().
+uint32_t telemetryLogFlushNow();
+
+// Everything appended before telemetryLogFlushNow() is on the card (or
+// failed to get there)
+bool telemetryLogFlushed(uint32_t ticket);
+
+// Add one sample. Called from the decoding task; never blocks.
+void telemetryLogAppend(const VescValues& values, uint32_t timeMs);
+
+TelemetryLogStats telemetryLogStats();
@@ -0,0 +1,27 @@
+#include "app_events.h"
+
+#include <M5Core2.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/event_groups.h>
+
+static EventGroupHandle_t events = nullptr;
+
+// The FT6336 pulls its INT line low while the panel is touched
+static void IRAM_ATTR touchInterrupt() {
+    BaseType_t woken = pdFALSE;
+    xEventGroupSetBitsFromISR(events, APP_EVENT_INPUT, &woken);
+    portYIELD_FROM_ISR(woken);
+}
+
+void appEventsBegin() {
+    events = xEventGroupCreate();
+    attachInterrupt(digitalPinToInterrupt(CST_INT), touchInterrupt, FALLING);
+}
+
+void appEventsSet(uint32_t bits) {
+    if (events) xEventGroupSetBits(events, bits);
+}
+
+uint32_t appEventsWait(uint32_t timeoutMs) {
+    return xEventGroupWaitBits(events, APP_EVENT_ALL, pdTRUE, pdFALSE, pdMS_TO_TICKS(timeoutMs));
+}
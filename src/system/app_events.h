@@ -0,0 +1,26 @@
+#pragma once
+
+#include <stdint.h>
+
+// Wake-up sources for the UI loop, backed by a FreeRTOS event group.
+// Other tasks set bits; loop() sleeps in appEventsWait() until one is set
+// or its timeout passes.
+#define APP_EVENT_TELEMETRY   (1u << 0)  // New telemetry sample published
+#define APP_EVENT_CONNECTION  (1u << 1)  // Connection manager state change
+#define APP_EVENT_INPUT       (1u << 2)  // Touch controller interrupt
+#define APP_EVENT_MOTION      (1u << 3)  // The board started moving or came to rest
+#define APP_EVENT_USB         (1u << 4)  // Bytes from the host on the USB bridge
+#define APP_EVENT_POWER       (1u << 5)  // External power came or went, or the PMIC warning changed
+#define APP_EVENT_ALL         (APP_EVENT_TELEMETRY | APP_EVENT_CONNECTION | APP_EVENT_INPUT | APP_EVENT_MOTION | \
+                               APP_EVENT_USB | APP_EVENT_POWER)
+
+// Create the event group and hook the touch interrupt. Call from setup()
+// before starting the tasks that post events.
+void appEventsBegin();
+
+// Safe to call before appEventsBegin() (the bits are dropped)
+void appEventsSet(uint32_t bits);
+
+// Block until any event is set or timeoutMs passes. Returns the bits that
+// were set and clears them.
+uint32_t appEventsWait(uint32_t timeoutMs);
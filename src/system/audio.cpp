@@ -0,0 +1,107 @@
+#include "audio.h"
+#include "audio_clips.h"
+#include "i2c_bus.h"
+#include "perf_stats.h"
+#include "task_layout.h"
+#include "../log.h"
+
+#include <M5Core2.h>
+#include <driver/i2s.h>
+
+static const i2s_port_t I2S_PORT = I2S_NUM_0;
+static const int PIN_BCK = 12;                // NS4168 on the Core2
+static const int PIN_LRCK = 0;
+static const int PIN_DATA = 2;
+static const int DMA_BUFFERS = 4;
+static const int DMA_BUFFER_SAMPLES = 256;    // 32 ms each at 8 kHz
+static const uint8_t QUEUE_LENGTH = 4;
+
+static const uint32_t TASK_STACK_SIZE = 2048;
+static const TaskPlacement& PLACEMENT = TASK_PLACEMENT[TASK_AUDIO];
+
+struct ClipInfo {
+    const int16_t* pcm;
+    uint32_t samples;
+};
+
+static const ClipInfo CLIPS[AUDIO_CLIP_COUNT] = {
+    { AUDIO_CLIP_ALERT_PCM, sizeof(AUDIO_CLIP_ALERT_PCM) / sizeof(int16_t) },
+    { AUDIO_CLIP_FAULT_PCM, sizeof(AUDIO_CLIP_FAULT_PCM) / sizeof(int16_t) },
+};
+
+static QueueHandle_t queue = nullptr;
+static volatile uint32_t dropped = 0;
+static int32_t volume = 256;                  // Gain x256
+
+static void playClip(const ClipInfo& clip) {
+    // Scale a DMA buffer's worth at a time; i2s_write() blocks this task,
+    // not the CPU, until the DMA has room
+    int16_t chunk[DMA_BUFFER_SAMPLES];
+    for (uint32_t start = 0; start < clip.samples; start += DMA_BUFFER_SAMPLES) {
+        uint32_t n = clip.samples - start;
+        if (n > DMA_BUFFER_SAMPLES) n = DMA_BUFFER_SAMPLES;
+        for (uint32_t i = 0; i < n; i++) {
+            chunk[i] = (int16_t)((clip.pcm[start + i] * volume) >> 8);
+        }
+        size_t written = 0;
+        i2s_write(I2S_PORT, chunk, n * sizeof(int16_t), &written, portMAX_DELAY);
+    }
+}
+
+static void playerTask(void* arg) {
+    uint8_t clip;
+    for (;;) {
+        if (xQueueReceive(queue, &clip, portMAX_DELAY) != pdTRUE) continue;
+        playClip(CLIPS[clip]);
+    }
+}
+
+// On the bus task
+static void enableSpeaker(void* context) {
+    M5.Axp.SetSpkEnable(true);
+}
+
+void audioBegin(uint8_t volumePercent) {
+    volume = volumePercent * 256 / 100;
+
+    // M5.begin() may have installed the library's own speaker driver
+    i2s_driver_uninstall(I2S_PORT);
+    i2s_config_t config = {};
+    config.mode = (i2s_mode_t)(I2S_MODE_MASTER | I2S_MODE_TX);
+    config.sample_rate = AUDIO_SAMPLE_RATE;
+    config.bits_per_sample = I2S_BITS_PER_SAMPLE_16BIT;
+    config.channel_format = I2S_CHANNEL_FMT_ONLY_RIGHT;
+    config.communication_format = I2S_COMM_FORMAT_STAND_I2S;
+    config.dma_buf_count = DMA_BUFFERS;
+    config.dma_buf_len = DMA_BUFFER_SAMPLES;
+    config.tx_desc_auto_clear = true;          // Silence, not the last buffer again, once a clip ends
+    i2s_pin_config_t pins = {};
+    pins.mck_io_num = I2S_PIN_NO_CHANGE;
+    pins.bck_io_num = PIN_BCK;
+    pins.ws_io_num = PIN_LRCK;
+    pins.data_out_num = PIN_DATA;
+    pins.data_in_num = I2S_PIN_NO_CHANGE;
+    if (i2s_driver_install(I2S_PORT, &config, 0, nullptr) != ESP_OK || i2s_set_pin(I2S_PORT, &pins) != ESP_OK) {
+        LOG_E(APP, "Could not set up the speaker");
+        return;
+    }
+    i2cBusRun(I2C_PRIORITY_CONTROL, enableSpeaker, nullptr);
+
+    queue = xQueueCreate(QUEUE_LENGTH, sizeof(uint8_t));
+    TaskHandle_t task = nullptr;
+    xTaskCreatePinnedToCore(playerTask, PLACEMENT.name, TASK_STACK_SIZE, nullptr, PLACEMENT.priority, &task, PLACEMENT.core);
+    perfWatchTask(task, MEMORY_TAG_SYSTEM);
+}
+
+bool audioPlay(AudioClip clip) {
+    uint8_t value = clip;
+    if (!queue || clip >= AUDIO_CLIP_COUNT || xQueueSend(queue, &value, 0) != pdTRUE) {
+        dropped++;
+        return false;
+    }
+    return true;
+}
+
+uint32_t audioDropped() {
+    return dropped;
+}
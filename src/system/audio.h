@@ -0,0 +1,29 @@
+#pragma once
+
+#include <stdint.h>
+
+// Sound clips, in the order of tools/audio_clips.py
+enum AudioClip : uint8_t {
+    AUDIO_CLIP_ALERT,
+    AUDIO_CLIP_FAULT,
+    AUDIO_CLIP_COUNT
+};
+
+// Clips on the Core2's speaker.
+//
+// The clips are PCM tables in flash (src/system/audio_clips.h, generated
+// by tools/audio_clips.py). A low-priority task takes them off a short
+// queue and hands them to the I2S driver, whose DMA feeds the amplifier;
+// the task sleeps while the DMA buffers are full, so playing costs no
+// time on the UI loop or the decoder. audioPlay() only queues.
+
+// Take over the speaker's I2S port and start the player task. Call once
+// from setup(), after M5.begin().
+void audioBegin(uint8_t volumePercent);
+
+// Queue a clip. Returns false, and counts a drop, if the queue is full.
+// Safe from any task.
+bool audioPlay(AudioClip clip);
+
+// Clips dropped because the queue was full
+uint32_t audioDropped();
@@ -0,0 +1,455 @@
+#pragma once
+
+// Generated by tools/audio_clips.py; edit the notes there, not the tables.
+
+#include <stdint.h>
+
+#define AUDIO_SAMPLE_RATE 8000
+
+// Falling two-tone, for a threshold alert, 300 ms
+static const int16_t AUDIO_CLIP_ALERT_PCM[2400] = {
+    0, 16, 99, 198, 148, -193, -754, -1198, -1071, -123, 1410, 2781,
+    3055, 1665, -1112, -4091, -5649, -4578, -866, 4045, 7791, 8214, 4564, -1893,
+    -8262, -11327, -9177, -2337, 6266, 12563, 13300, 7727, -1857, -11063, -15460, -12750,
+    -3975, 6879, 14733, 15844, 9630, -1029, -11215, -16254, -13833, -5063, 6031, 14357,
+    16093, 10443, 0, -10443, -16093, -14357, -6031, 5063, 13833, 16254, 11215, 1029,
+    -9630, -15869, -14824, -6976, 4074, 13255, 16351, 11943, 2053, -8779, -15582, -15233,
+    -7893, 3070, 12624, 16384, 12624, 3070, -7893, -15233, -15582, -8779, 2053, 11943,
+    16351, 13255, 4074, -6976, -14824, -15869, -9630, 1029, 11215, 16254, 13833, 5063,
+    -6031, -14357, -16093, -10443, 0, 10443, 16093, 14357, 6031, -5063, -13833, -16254,
+    -11215, -1029, 9630, 15869, 14824, 6976, -4074, -13255, -16351, -11943, -2053, 8779,
+    15582, 15233, 7893, -3070, -12624, -16384, -12624, -3070, 7893, 15233, 15582, 8779,
+    -2053, -11943, -16351, -13255, -4074, 6976, 14824, 15869, 9630, -1029, -11215, -16254,
+    -13833, -5063, 6031, 14357, 16093, 10443, 0, -10443, -16093, -14357, -6031, 5063,
+    13833, 16254, 11215, 1029, -9630, -15869, -14824, -6976, 4074, 13255, 16351, 11943,
+    2053, -8779, -15582, -15233, -7893, 3070, 12624, 16384, 12624, 3070, -7893, -15233,
+    -15582, -8779, 2053, 11943, 16351, 13255, 4074, -6976, -14824, -15869, -9630, 1029,
+    11215, 16254, 13833, 5063, -6031, -14357, -16093, -10443, 0, 10443, 16093, 14357,
+    6031, -5063, -13833, -16254, -11215, -1029, 9630, 15869, 14824, 6976, -4074, -13255,
+    -16351, -11943, -2053, 8779, 15582, 15233, 7893, -3070, -12624, -16384, -12624, -3070,
+    7893, 15233, 15582, 8779, -2053, -11943, -16351, -13255, -4074, 6976, 14824, 15869,
+    9630, -1029, -11215, -16254, -13833, -5063, 6031, 14357, 16093, 10443, 0, -10443,
+    -16093, -14357, -6031, 5063, 13833, 16254, 11215, 1029, -9630, -15869, -14824, -6976,
+    4074, 13255, 16351, 11943, 2053, -8779, -15582, -15233, -7893, 3070, 12624, 16384,
+    12624, 3070, -7893, -15233, -15582, -8779, 2053, 11943, 16351, 13255, 4074, -6976,
+    -14824, -15869, -9630, 1029, 11215, 16254, 13833, 5063, -6031, -14357, -16093, -10443,
+    0, 10443, 16093, 14357, 6031, -5063, -13833, -16254, -11215, -1029, 9630, 15869,
+    14824, 6976, -4074, -13255, -16351, -11943, -2053, 8779, 15582, 15233, 7893, -3070,
+    -12624, -16384, -12624, -3070, 7893, 15233, 15582, 8779, -2053, -11943, -16351, -13255,
+    -4074, 6976, 14824, 15869, 9630, -1029, -11215, -16254, -13833, -5063, 6031, 14357,
+    16093, 10443, 0, -10443, -16093, -14357, -6031, 5063, 13833, 16254, 11215, 1029,
+    -9630, -15869, -14824, -6976, 4074, 13255, 16351, 11943, 2053, -8779, -15582, -15233,
+    -7893, 3070, 12624, 16384, 12624, 3070, -7893, -15233, -15582, -8779, 2053, 11943,
+    16351, 13255, 4074, -6976, -14824, -15869, -9630, 1029, 11215, 16254, 13833, 5063,
+    -6031, -14357, -16093, -10443, 0, 10443, 16093, 14357, 6031, -5063, -13833, -16254,
+    -11215, -1029, 9630, 15869, 14824, 6976, -4074, -13255, -16351, -11943, -2053, 8779,
+    15582, 15233, 7893, -3070, -12624, -16384, -12624, -3070, 7893, 15233, 15582, 8779,
+    -2053, -11943, -16351, -13255, -4074, 6976, 14824, 15869, 9630, -1029, -11215, -16254,
+    -13833, -5063, 6031, 14357, 16093, 10443, 0, -10443, -16093, -14357, -6031, 5063,
+    13833, 16254, 11215, 1029, -9630, -15869, -14824, -6976, 4074, 13255, 16351, 11943,
+    2053, -8779, -15582, -15233, -7893, 3070, 12624, 16384, 12624, 3070, -7893, -15233,
+    -15582, -8779, 2053, 11943, 16351, 13255, 4074, -6976, -14824, -15869, -9630, 1029,
+    11215, 16254, 13833, 5063, -6031, -14357, -16093, -10443, 0, 10443, 16093, 14357,
+    6031, -5063, -13833, -16254, -11215, -1029, 9630, 15869, 14824, 6976, -4074, -13255,
+    -16351, -11943, -2053, 8779, 15582, 15233, 7893, -3070, -12624, -16384, -12624, -3070,
+    7893, 15233, 15582, 8779, -2053, -11943, -16351, -13255, -4074, 6976, 14824, 15869,
+    9630, -1029, -11215, -16254, -13833, -5063, 6031, 14357, 16093, 10443, 0, -10443,
+    -16093, -14357, -6031, 5063, 13833, 16254, 11215, 1029, -9630, -15869, -14824, -6976,
+    4074, 13255, 16351, 11943, 2053, -8779, -15582, -15233, -7893, 3070, 12624, 16384,
+    12624, 3070, -7893, -15233, -15582, -8779, 2053, 11943, 16351, 13255, 4074, -6976,
+    -14824, -15869, -9630, 1029, 11215, 16254, 13833, 5063, -6031, -14357, -16093, -10443,
+    0, 10443, 16093, 14357, 6031, -5063, -13833, -16254, -11215, -1029, 9630, 15869,
+    14824, 6976, -4074, -13255, -16351, -11943, -2053, 8779, 15582, 15233, 7893, -3070,
+    -12624, -16384, -12624, -3070, 7893, 15233, 15582, 8779, -2053, -11943, -16351, -13255,
+    -4074, 6976, 14824, 15869, 9630, -1029, -11215, -16254, -13833, -5063, 6031, 14357,
+    16093, 10443, 0, -10443, -16093, -14357, -6031, 5063, 13833, 16254, 11215, 1029,
+    -9630, -15869, -14824, -6976, 4074, 13255, 16351, 11943, 2053, -8779, -15582, -15233,
+    -7893, 3070, 12624, 16384, 12624, 3070, -7893, -15233, -15582, -8779, 2053, 11943,
+    16351, 13255, 4074, -6976, -14824, -15869, -9630, 1029, 11215, 16254, 13833, 5063,
+    -6031, -14357, -16093, -10443, 0, 10443, 16093, 14357, 6031, -5063, -13833, -16254,
+    -11215, -1029, 9630, 15869, 14824, 6976, -4074, -13255, -16351, -11943, -2053, 8779,
+    15582, 15233, 7893, -3070, -12624, -16384, -12624, -3070, 7893, 15233, 15582, 8779,
+    -2053, -11943, -16351, -13255, -4074, 6976, 14824, 15869, 9630, -1029, -11215, -16254,
+    -13833, -5063, 6031, 14357, 16093, 10443, 0, -10443, -16093, -14357, -6031, 5063,
+    13833, 16254, 11215, 1029, -9630, -15869, -14824, -6976, 4074, 13255, 16351, 11943,
+    2053, -8779, -15582, -15233, -7893, 3070, 12624, 16384, 12624, 3070, -7893, -15233,
+    -15582, -8779, 2053, 11943, 16351, 13255, 4074, -6976, -14824, -15869, -9630, 1029,
+    11215, 16254, 13833, 5063, -6031, -14357, -16093, -10443, 0, 10443, 16093, 14357,
+    6031, -5063, -13833, -16254, -11215, -1029, 9630, 15869, 14824, 6976, -4074, -13255,
+    -16351, -11943, -2053, 8779, 15582, 15233, 7893, -3070, -12624, -16384, -12624, -3070,
+    7893, 15233, 15582, 8779, -2053, -11943, -16351, -13255, -4074, 6976, 14824, 15869,
+    9630, -1029, -11215, -16254, -13833, -5063, 6031, 14357, 16093, 10443, 0, -10443,
+    -16093, -14357, -6031, 5063, 13833, 16254, 11215, 1029, -9630, -15869, -14824, -6976,
+    4074, 13255, 16351, 11943, 2053, -8779, -15582, -15233, -7893, 3070, 12624, 16384,
+    12624, 3070, -7893, -15233, -15582, -8779, 2053, 11943, 16351, 13255, 4074, -6976,
+    -14824, -15869, -9630, 1029, 11215, 16254, 13833, 5063, -6031, -14357, -16093, -10443,
+    0, 10443, 16093, 14357, 6031, -5063, -13833, -16254, -11215, -1029, 9630, 15869,
+    14824, 6976, -4074, -13255, -16351, -11943, -2053, 8779, 15582, 15233, 7893, -3070,
+    -12624, -16384, -12624, -3070, 7893, 15233, 15582, 8779, -2053, -11943, -16351, -13255,
+    -4074, 6976, 14824, 15869, 9630, -1029, -11215, -16254, -13833, -5063, 6031, 14357,
+    16093, 10443, 0, -10443, -16093, -14357, -6031, 5063, 13833, 16254, 11215, 1029,
+    -9630, -15869, -14824, -6976, 4074, 13255, 16351, 11943, 2053, -8779, -15582, -15233,
+    -7893, 3070, 12624, 16384, 12624, 3070, -7893, -15233, -15582, -8779, 2053, 11943,
+    16351, 13255, 4074, -6976, -14824, -15869, -9630, 1029, 11215, 16254, 13833, 5063,
+    -6031, -14357, -16093, -10443, 0, 10443, 16093, 14357, 6031, -5063, -13833, -16254,
+    -11215, -1029, 9630, 15869, 14824, 6976, -4074, -13255, -16351, -11943, -2053, 8779,
+    15582, 15233, 7893, -3070, -12624, -16384, -12624, -3070, 7893, 15233, 15582, 8779,
+    -2053, -11943, -16351, -13255, -4074, 6976, 14824, 15869, 9630, -1029, -11215, -16254,
+    -13833, -5063, 6031, 14357, 16093, 10443, 0, -10443, -16093, -14357, -6031, 5063,
+    13833, 16254, 11215, 1029, -9630, -15869, -14824, -6976, 4074, 13255, 16351, 11943,
+    2053, -8779, -15582, -15233, -7893, 3070, 12624, 16384, 12624, 3070, -7893, -15233,
+    -15582, -8779, 2053, 11943, 16351, 13255, 4074, -6976, -14824, -15869, -9630, 1029,
+    11215, 16254, 13833, 5063, -6031, -14357, -16093, -10443, 0, 10443, 16093, 14357,
+    6031, -5063, -13833, -16254, -11215, -1029, 9630, 15869, 14824, 6976, -4074, -13255,
+    -16351, -11943, -2053, 8779, 15582, 15233, 7893, -3070, -12624, -16384, -12624, -3070,
+    7893, 15233, 15582, 8779, -2053, -11943, -16351, -13255, -4074, 6976, 14824, 15869,
+    9630, -1029, -11215, -16254, -13833, -5063, 6031, 14357, 16093, 10443, 0, -10443,
+    -16093, -14357, -6031, 5063, 13833, 16254, 11215, 1029, -9615, -15771, -14619, -6805,
+    3919, 12532, 15146, 10803, 1807, -7493, -12851, -12093, -6008, 2232, 8727, 10723,
+    7785, 1775, -4256, -7616, -7180, -3703, 787, 4126, 5047, 3619, 973, -1438,
+    -2598, -2324, -1154, 98, 826, 886, 526, 124, -83, -88, -25, 0,
+    0, 13, 87, 226, 351, 326, 28, -565, -1321, -1961, -2138, -1577,
+    -212, 1721, 3699, 5041, 5122, 3611, 650, -3107, -6627, -8781, -8694, -6067,
+    -1344, 4335, 9411, 12348, 12093, 8448, 2188, -5097, -11418, -14950, -14575, -10235,
+    -2995, 5234, 12214, 16018, 15582, 11026, 3574, -4817, -11943, -15931, -15733, -11401,
+    -4074, 4323, 11585, 15803, 15869, 11765, 4571, -3825, -11215, -15659, -15989, -12118,
+    -5063, 3322, 10835, 15500, 16093, 12458, 5550, -2817, -10443, -15326, -16182, -12786,
+    -6031, 2308, 10042, 15136, 16254, 13102, 6507, -1798, -9630, -14932, -16311, -13404,
+    -6976, 1285, 9209, 14713, 16351, 13693, 7438, -772, -8779, -14479, -16375, -13969,
+    -7893, 257, 8340, 14231, 16384, 14231, 8340, 257, -7893, -13969, -16375, -14479,
+    -8779, -772, 7438, 13693, 16351, 14713, 9209, 1285, -6976, -13404, -16311, -14932,
+    -9630, -1798, 6507, 13102, 16254, 15136, 10042, 2308, -6031, -12786, -16182, -15326,
+    -10443, -2817, 5550, 12458, 16093, 15500, 10835, 3322, -5063, -12118, -15989, -15659,
+    -11215, -3825, 4571, 11765, 15869, 15803, 11585, 4323, -4074, -11401, -15733, -15931,
+    -11943, -4817, 3574, 11026, 15582, 16043, 12289, 5307, -3070, -10640, -15415, -16140,
+    -12624, -5791, 2563, 10244, 15233, 16220, 12946, 6270, -2053, -9837, -15036, -16285,
+    -13255, -6742, 1542, 9421, 14824, 16333, 13550, 7208, -1029, -8995, -14598, -16365,
+    -13833, -7666, 515, 8560, 14357, 16381, 14102, 8117, 0, -8117, -14102, -16381,
+    -14357, -8560, -515, 7666, 13833, 16365, 14598, 8995, 1029, -7208, -13550, -16333,
+    -14824, -9421, -1542, 6742, 13255, 16285, 15036, 9837, 2053, -6270, -12946, -16220,
+    -15233, -10244, -2563, 5791, 12624, 16140, 15415, 10640, 3070, -5307, -12289, -16043,
+    -15582, -11026, -3574, 4817, 11943, 15931, 15733, 11401, 4074, -4323, -11585, -15803,
+    -15869, -11765, -4571, 3825, 11215, 15659, 15989, 12118, 5063, -3322, -10835, -15500,
+    -16093, -12458, -5550, 2817, 10443, 15326, 16182, 12786, 6031, -2308, -10042, -15136,
+    -16254, -13102, -6507, 1798, 9630, 14932, 16311, 13404, 6976, -1285, -9209, -14713,
+    -16351, -13693, -7438, 772, 8779, 14479, 16375, 13969, 7893, -257, -8340, -14231,
+    -16384, -14231, -8340, -257, 7893, 13969, 16375, 14479, 8779, 772, -7438, -13693,
+    -16351, -14713, -9209, -1285, 6976, 13404, 16311, 14932, 9630, 1798, -6507, -13102,
+    -16254, -15136, -10042, -2308, 6031, 12786, 16182, 15326, 10443, 2817, -5550, -12458,
+    -16093, -15500, -10835, -3322, 5063, 12118, 15989, 15659, 11215, 3825, -4571, -11765,
+    -15869, -15803, -11585, -4323, 4074, 11401, 15733, 15931, 11943, 4817, -3574, -11026,
+    -15582, -16043, -12289, -5307, 3070, 10640, 15415, 16140, 12624, 5791, -2563, -10244,
+    -15233, -16220, -12946, -6270, 2053, 9837, 15036, 16285, 13255, 6742, -1542, -9421,
+    -14824, -16333, -13550, -7208, 1029, 8995, 14598, 16365, 13833, 7666, -515, -8560,
+    -14357, -16381, -14102, -8117, 0, 8117, 14102, 16381, 14357, 8560, 515, -7666,
+    -13833, -16365, -14598, -8995, -1029, 7208, 13550, 16333, 14824, 9421, 1542, -6742,
+    -13255, -16285, -15036, -9837, -2053, 6270, 12946, 16220, 15233, 10244, 2563, -5791,
+    -12624, -16140, -15415, -10640, -3070, 5307, 12289, 16043, 15582, 11026, 3574, -4817,
+    -11943, -15931, -15733, -11401, -4074, 4323, 11585, 15803, 15869, 11765, 4571, -3825,
+    -11215, -15659, -15989, -12118, -5063, 3322, 10835, 15500, 16093, 12458, 5550, -2817,
+    -10443, -15326, -16182, -12786, -6031, 2308, 10042, 15136, 16254, 13102, 6507, -1798,
+    -9630, -14932, -16311, -13404, -6976, 1285, 9209, 14713, 16351, 13693, 7438, -772,
+    -8779, -14479, -16375, -13969, -7893, 257, 8340, 14231, 16384, 14231, 8340, 257,
+    -7893, -13969, -16375, -14479, -8779, -772, 7438, 13693, 16351, 14713, 9209, 1285,
+    -6976, -13404, -16311, -14932, -9630, -1798, 6507, 13102, 16254, 15136, 10042, 2308,
+    -6031, -12786, -16182, -15326, -10443, -2817, 5550, 12458, 16093, 15500, 10835, 3322,
+    -5063, -12118, -15989, -15659, -11215, -3825, 4571, 11765, 15869, 15803, 11585, 4323,
+    -4074, -11401, -15733, -15931, -11943, -4817, 3574, 11026, 15582, 16043, 12289, 5307,
+    -3070, -10640, -15415, -16140, -12624, -5791, 2563, 10244, 15233, 16220, 12946, 6270,
+    -2053, -9837, -15036, -16285, -13255, -6742, 1542, 9421, 14824, 16333, 13550, 7208,
+    -1029, -8995, -14598, -16365, -13833, -7666, 515, 8560, 14357, 16381, 14102, 8117,
+    0, -8117, -14102, -16381, -14357, -8560, -515, 7666, 13833, 16365, 14598, 8995,
+    1029, -7208, -13550, -16333, -14824, -9421, -1542, 6742, 13255, 16285, 15036, 9837,
+    2053, -6270, -12946, -16220, -15233, -10244, -2563, 5791, 12624, 16140, 15415, 10640,
+    3070, -5307, -12289, -16043, -15582, -11026, -3574, 4817, 11943, 15931, 15733, 11401,
+    4074, -4323, -11585, -15803, -15869, -11765, -4571, 3825, 11215, 15659, 15989, 12118,
+    5063, -3322, -10835, -15500, -16093, -12458, -5550, 2817, 10443, 15326, 16182, 12786,
+    6031, -2308, -10042, -15136, -16254, -13102, -6507, 1798, 9630, 14932, 16311, 13404,
+    6976, -1285, -9209, -14713, -16351, -13693, -7438, 772, 8779, 14479, 16375, 13969,
+    7893, -257, -8340, -14231, -16384, -14231, -8340, -257, 7893, 13969, 16375, 14479,
+    8779, 772, -7438, -13693, -16351, -14713, -9209, -1285, 6976, 13404, 16311, 14932,
+    9630, 1798, -6507, -13102, -16254, -15136, -10042, -2308, 6031, 12786, 16182, 15326,
+    10443, 2817, -5550, -12458, -16093, -15500, -10835, -3322, 5063, 12118, 15989, 15659,
+    11215, 3825, -4571, -11765, -15869, -15803, -11585, -4323, 4074, 11401, 15733, 15931,
+    11943, 4817, -3574, -11026, -15582, -16043, -12289, -5307, 3070, 10640, 15415, 16140,
+    12624, 5791, -2563, -10244, -15233, -16220, -12946, -6270, 2053, 9837, 15036, 16285,
+    13255, 6742, -1542, -9421, -14824, -16333, -13550, -7208, 1029, 8995, 14598, 16365,
+    13833, 7666, -515, -8560, -14357, -16381, -14102, -8117, 0, 8117, 14102, 16381,
+    14357, 8560, 515, -7666, -13833, -16365, -14598, -8995, -1029, 7208, 13550, 16333,
+    14824, 9421, 1542, -6742, -13255, -16285, -15036, -9837, -2053, 6270, 12946, 16220,
+    15233, 10244, 2563, -5791, -12624, -16140, -15415, -10640, -3070, 5307, 12289, 16043,
+    15582, 11026, 3574, -4817, -11943, -15931, -15733, -11401, -4074, 4323, 11585, 15803,
+    15869, 11765, 4571, -3825, -11215, -15659, -15989, -12118, -5063, 3322, 10835, 15500,
+    16093, 12458, 5550, -2817, -10443, -15326, -16182, -12786, -6031, 2308, 10042, 15136,
+    16254, 13102, 6507, -1798, -9630, -14932, -16311, -13404, -6976, 1285, 9209, 14713,
+    16351, 13693, 7438, -772, -8779, -14479, -16375, -13969, -7893, 257, 8340, 14231,
+    16384, 14231, 8340, 257, -7893, -13969, -16375, -14479, -8779, -772, 7438, 13693,
+    16351, 14713, 9209, 1285, -6976, -13404, -16311, -14932, -9630, -1798, 6507, 13102,
+    16254, 15136, 10042, 2308, -6031, -12786, -16182, -15326, -10443, -2817, 5550, 12458,
+    16093, 15500, 10835, 3322, -5063, -12118, -15989, -15659, -11215, -3825, 4571, 11765,
+    15869, 15803, 11585, 4323, -4074, -11401, -15733, -15931, -11943, -4817, 3574, 11026,
+    15582, 16043, 12289, 5307, -3070, -10640, -15415, -16140, -12624, -5791, 2563, 10244,
+    15233, 16220, 12946, 6270, -2053, -9837, -15036, -16285, -13255, -6742, 1542, 9421,
+    14824, 16333, 13550, 7208, -1029, -8995, -14598, -16365, -13833, -7666, 515, 8560,
+    14357, 16381, 14102, 8117, 0, -8117, -14102, -16381, -14357, -8560, -515, 7666,
+    13833, 16365, 14598, 8995, 1029, -7208, -13550, -16333, -14824, -9421, -1542, 6742,
+    13255, 16285, 15036, 9837, 2053, -6270, -12946, -16220, -15233, -10244, -2563, 5791,
+    12624, 16140, 15415, 10640, 3070, -5307, -12289, -16043, -15582, -11026, -3574, 4817,
+    11943, 15931, 15733, 11401, 4074, -4323, -11585, -15803, -15869, -11765, -4571, 3825,
+    11215, 15659, 15989, 12118, 5063, -3322, -10835, -15500, -16093, -12458, -5550, 2817,
+    10443, 15326, 16182, 12786, 6031, -2308, -10042, -15136, -16254, -13102, -6507, 1798,
+    9630, 14932, 16311, 13404, 6976, -1285, -9209, -14713, -16351, -13693, -7438, 772,
+    8779, 14479, 16375, 13969, 7893, -257, -8340, -14231, -16384, -14231, -8340, -257,
+    7893, 13969, 16375, 14479, 8779, 772, -7438, -13693, -16351, -14713, -9209, -1285,
+    6976, 13404, 16311, 14932, 9630, 1798, -6507, -13102, -16254, -15136, -10042, -2308,
+    6031, 12786, 16182, 15326, 10443, 2817, -5550, -12458, -16093, -15500, -10835, -3322,
+    5063, 12118, 15989, 15659, 11215, 3825, -4571, -11765, -15869, -15803, -11585, -4323,
+    4074, 11401, 15733, 15931, 11943, 4817, -3574, -11026, -15558, -15944, -12120, -5177,
+    2953, 10060, 14279, 14598, 11111, 4943, -2114, -8132, -11596, -11792, -8950, -4104,
+    1266, 5688, 8108, 8142, 6107, 2844, -591, -3255, -4576, -4459, -3235, -1486,
+    180, 1317, 1749, 1563, 1019, 418, -20, -209, -198, -101, -22, 0,
+};
+
+// Three fast high beeps, for a VESC fault, 360 ms
+static const int16_t AUDIO_CLIP_FAULT_PCM[2880] = {
+    0, 22, 88, 7, -339, -556, -56, 998, 1416, 185, -1941, -2635,
+    -423, 3091, 4159, 791, -4361, -5908, -1295, 5663, 7791, 1927, -6906, -9703,
+    -2667, 8009, 11537, 3480, -8904, -13186, -4321, 9537, 14557, 5141, -9874, -15566,
+    -5884, 9903, 16154, 6497, -9630, -16311, -6976, 9209, 16351, 7438, -8779, -16375,
+    -7893, 8340, 16384, 8340, -7893, -16375, -8779, 7438, 16351, 9209, -6976, -16311,
+    -9630, 6507, 16254, 10042, -6031, -16182, -10443, 5550, 16093, 10835, -5063, -15989,
+    -11215, 4571, 15869, 11585, -4074, -15733, -11943, 3574, 15582, 12289, -3070, -15415,
+    -12624, 2563, 15233, 12946, -2053, -15036, -13255, 1542, 14824, 13550, -1029, -14598,
+    -13833, 515, 14357, 14102, 0, -14102, -14357, -515, 13833, 14598, 1029, -13550,
+    -14824, -1542, 13255, 15036, 2053, -12946, -15233, -2563, 12624, 15415, 3070, -12289,
+    -15582, -3574, 11943, 15733, 4074, -11585, -15869, -4571, 11215, 15989, 5063, -10835,
+    -16093, -5550, 10443, 16182, 6031, -10042, -16254, -6507, 9630, 16311, 6976, -9209,
+    -16351, -7438, 8779, 16375, 7893, -8340, -16384, -8340, 7893, 16375, 8779, -7438,
+    -16351, -9209, 6976, 16311, 9630, -6507, -16254, -10042, 6031, 16182, 10443, -5550,
+    -16093, -10835, 5063, 15989, 11215, -4571, -15869, -11585, 4074, 15733, 11943, -3574,
+    -15582, -12289, 3070, 15415, 12624, -2563, -15233, -12946, 2053, 15036, 13255, -1542,
+    -14824, -13550, 1029, 14598, 13833, -515, -14357, -14102, 0, 14102, 14357, 515,
+    -13833, -14598, -1029, 13550, 14824, 1542, -13255, -15036, -2053, 12946, 15233, 2563,
+    -12624, -15415, -3070, 12289, 15582, 3574, -11943, -15733, -4074, 11585, 15869, 4571,
+    -11215, -15989, -5063, 10835, 16093, 5550, -10443, -16182, -6031, 10042, 16254, 6507,
+    -9630, -16311, -6976, 9209, 16351, 7438, -8779, -16375, -7893, 8340, 16384, 8340,
+    -7893, -16375, -8779, 7438, 16351, 9209, -6976, -16311, -9630, 6507, 16254, 10042,
+    -6031, -16182, -10443, 5550, 16093, 10835, -5063, -15989, -11215, 4571, 15869, 11585,
+    -4074, -15733, -11943, 3574, 15582, 12289, -3070, -15415, -12624, 2563, 15233, 12946,
+    -2053, -15036, -13255, 1542, 14824, 13550, -1029, -14598, -13833, 515, 14357, 14102,
+    0, -14102, -14357, -515, 13833, 14598, 1029, -13550, -14824, -1542, 13255, 15036,
+    2053, -12946, -15233, -2563, 12624, 15415, 3070, -12289, -15582, -3574, 11943, 15733,
+    4074, -11585, -15869, -4571, 11215, 15989, 5063, -10835, -16093, -5550, 10443, 16182,
+    6031, -10042, -16254, -6507, 9630, 16311, 6976, -9209, -16351, -7438, 8779, 16375,
+    7893, -8340, -16384, -8340, 7893, 16375, 8779, -7438, -16351, -9209, 6976, 16311,
+    9630, -6507, -16254, -10042, 6031, 16182, 10443, -5550, -16093, -10835, 5063, 15989,
+    11215, -4571, -15869, -11585, 4074, 15733, 11943, -3574, -15582, -12289, 3070, 15415,
+    12624, -2563, -15233, -12946, 2053, 15036, 13255, -1542, -14824, -13550, 1029, 14598,
+    13833, -515, -14357, -14102, 0, 14102, 14357, 515, -13833, -14598, -1029, 13550,
+    14824, 1542, -13255, -15036, -2053, 12946, 15233, 2563, -12624, -15415, -3070, 12289,
+    15582, 3574, -11943, -15733, -4074, 11585, 15869, 4571, -11215, -15989, -5063, 10835,
+    16093, 5550, -10443, -16182, -6031, 10042, 16254, 6507, -9630, -16311, -6976, 9209,
+    16351, 7438, -8779, -16375, -7893, 8340, 16384, 8340, -7893, -16375, -8779, 7438,
+    16351, 9209, -6976, -16311, -9630, 6507, 16254, 10042, -6031, -16182, -10443, 5550,
+    16093, 10835, -5063, -15989, -11215, 4571, 15869, 11585, -4074, -15733, -11943, 3574,
+    15582, 12289, -3070, -15415, -12624, 2563, 15233, 12946, -2053, -15036, -13255, 1542,
+    14824, 13550, -1029, -14598, -13833, 515, 14357, 14102, 0, -14102, -14357, -515,
+    13833, 14598, 1029, -13550, -14824, -1542, 13255, 15036, 2053, -12946, -15233, -2563,
+    12624, 15415, 3070, -12289, -15582, -3574, 11943, 15733, 4074, -11585, -15869, -4571,
+    11215, 15989, 5063, -10835, -16093, -5550, 10443, 16182, 6031, -10042, -16254, -6507,
+    9630, 16311, 6976, -9209, -16351, -7438, 8779, 16375, 7893, -8340, -16384, -8340,
+    7893, 16375, 8779, -7438, -16351, -9209, 6976, 16311, 9630, -6507, -16254, -10042,
+    6031, 16182, 10443, -5550, -16093, -10835, 5063, 15989, 11215, -4571, -15869, -11585,
+    4074, 15733, 11943, -3574, -15582, -12289, 3070, 15415, 12624, -2563, -15233, -12946,
+    2053, 15036, 13255, -1542, -14824, -13550, 1029, 14598, 13833, -515, -14357, -14102,
+    0, 14015, 14159, 502, -13307, -13802, -953, 12257, 13048, 1316, -10931, -11937,
+    -1563, 9411, 10531, 1677, -7785, -8913, -1655, 6145, 7180, 1507, -4578, -5436,
+    -1258, 3163, 3789, 942, -1966, -2342, -607, 1035, 1186, 302, -397, -396,
+    -83, 62, 25, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 22, 88, 7, -339, -556, -56, 998,
+    1416, 185, -1941, -2635, -423, 3091, 4159, 791, -4361, -5908, -1295, 5663,
+    7791, 1927, -6906, -9703, -2667, 8009, 11537, 3480, -8904, -13186, -4321, 9537,
+    14557, 5141, -9874, -15566, -5884, 9903, 16154, 6497, -9630, -16311, -6976, 9209,
+    16351, 7438, -8779, -16375, -7893, 8340, 16384, 8340, -7893, -16375, -8779, 7438,
+    16351, 9209, -6976, -16311, -9630, 6507, 16254, 10042, -6031, -16182, -10443, 5550,
+    16093, 10835, -5063, -15989, -11215, 4571, 15869, 11585, -4074, -15733, -11943, 3574,
+    15582, 12289, -3070, -15415, -12624, 2563, 15233, 12946, -2053, -15036, -13255, 1542,
+    14824, 13550, -1029, -14598, -13833, 515, 14357, 14102, 0, -14102, -14357, -515,
+    13833, 14598, 1029, -13550, -14824, -1542, 13255, 15036, 2053, -12946, -15233, -2563,
+    12624, 15415, 3070, -12289, -15582, -3574, 11943, 15733, 4074, -11585, -15869, -4571,
+    11215, 15989, 5063, -10835, -16093, -5550, 10443, 16182, 6031, -10042, -16254, -6507,
+    9630, 16311, 6976, -9209, -16351, -7438, 8779, 16375, 7893, -8340, -16384, -8340,
+    7893, 16375, 8779, -7438, -16351, -9209, 6976, 16311, 9630, -6507, -16254, -10042,
+    6031, 16182, 10443, -5550, -16093, -10835, 5063, 15989, 11215, -4571, -15869, -11585,
+    4074, 15733, 11943, -3574, -15582, -12289, 3070, 15415, 12624, -2563, -15233, -12946,
+    2053, 15036, 13255, -1542, -14824, -13550, 1029, 14598, 13833, -515, -14357, -14102,
+    0, 14102, 14357, 515, -13833, -14598, -1029, 13550, 14824, 1542, -13255, -15036,
+    -2053, 12946, 15233, 2563, -12624, -15415, -3070, 12289, 15582, 3574, -11943, -15733,
+    -4074, 11585, 15869, 4571, -11215, -15989, -5063, 10835, 16093, 5550, -10443, -16182,
+    -6031, 10042, 16254, 6507, -9630, -16311, -6976, 9209, 16351, 7438, -8779, -16375,
+    -7893, 8340, 16384, 8340, -7893, -16375, -8779, 7438, 16351, 9209, -6976, -16311,
+    -9630, 6507, 16254, 10042, -6031, -16182, -10443, 5550, 16093, 10835, -5063, -15989,
+    -11215, 4571, 15869, 11585, -4074, -15733, -11943, 3574, 15582, 12289, -3070, -15415,
+    -12624, 2563, 15233, 12946, -2053, -15036, -13255, 1542, 14824, 13550, -1029, -14598,
+    -13833, 515, 14357, 14102, 0, -14102, -14357, -515, 13833, 14598, 1029, -13550,
+    -14824, -1542, 13255, 15036, 2053, -12946, -15233, -2563, 12624, 15415, 3070, -12289,
+    -15582, -3574, 11943, 15733, 4074, -11585, -15869, -4571, 11215, 15989, 5063, -10835,
+    -16093, -5550, 10443, 16182, 6031, -10042, -16254, -6507, 9630, 16311, 6976, -9209,
+    -16351, -7438, 8779, 16375, 7893, -8340, -16384, -8340, 7893, 16375, 8779, -7438,
+    -16351, -9209, 6976, 16311, 9630, -6507, -16254, -10042, 6031, 16182, 10443, -5550,
+    -16093, -10835, 5063, 15989, 11215, -4571, -15869, -11585, 4074, 15733, 11943, -3574,
+    -15582, -12289, 3070, 15415, 12624, -2563, -15233, -12946, 2053, 15036, 13255, -1542,
+    -14824, -13550, 1029, 14598, 13833, -515, -14357, -14102, 0, 14102, 14357, 515,
+    -13833, -14598, -1029, 13550, 14824, 1542, -13255, -15036, -2053, 12946, 15233, 2563,
+    -12624, -15415, -3070, 12289, 15582, 3574, -11943, -15733, -4074, 11585, 15869, 4571,
+    -11215, -15989, -5063, 10835, 16093, 5550, -10443, -16182, -6031, 10042, 16254, 6507,
+    -9630, -16311, -6976, 9209, 16351, 7438, -8779, -16375, -7893, 8340, 16384, 8340,
+    -7893, -16375, -8779, 7438, 16351, 9209, -6976, -16311, -9630, 6507, 16254, 10042,
+    -6031, -16182, -10443, 5550, 16093, 10835, -5063, -15989, -11215, 4571, 15869, 11585,
+    -4074, -15733, -11943, 3574, 15582, 12289, -3070, -15415, -12624, 2563, 15233, 12946,
+    -2053, -15036, -13255, 1542, 14824, 13550, -1029, -14598, -13833, 515, 14357, 14102,
+    0, -14102, -14357, -515, 13833, 14598, 1029, -13550, -14824, -1542, 13255, 15036,
+    2053, -12946, -15233, -2563, 12624, 15415, 3070, -12289, -15582, -3574, 11943, 15733,
+    4074, -11585, -15869, -4571, 11215, 15989, 5063, -10835, -16093, -5550, 10443, 16182,
+    6031, -10042, -16254, -6507, 9630, 16311, 6976, -9209, -16351, -7438, 8779, 16375,
+    7893, -8340, -16384, -8340, 7893, 16375, 8779, -7438, -16351, -9209, 6976, 16311,
+    9630, -6507, -16254, -10042, 6031, 16182, 10443, -5550, -16093, -10835, 5063, 15989,
+    11215, -4571, -15869, -11585, 4074, 15733, 11943, -3574, -15582, -12289, 3070, 15415,
+    12624, -2563, -15233, -12946, 2053, 15036, 13255, -1542, -14824, -13550, 1029, 14598,
+    13833, -515, -14357, -14102, 0, 14015, 14159, 502, -13307, -13802, -953, 12257,
+    13048, 1316, -10931, -11937, -1563, 9411, 10531, 1677, -7785, -8913, -1655, 6145,
+    7180, 1507, -4578, -5436, -1258, 3163, 3789, 942, -1966, -2342, -607, 1035,
+    1186, 302, -397, -396, -83, 62, 25, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 22, 88, 7,
+    -339, -556, -56, 998, 1416, 185, -1941, -2635, -423, 3091, 4159, 791,
+    -4361, -5908, -1295, 5663, 7791, 1927, -6906, -9703, -2667, 8009, 11537, 3480,
+    -8904, -13186, -4321, 9537, 14557, 5141, -9874, -15566, -5884, 9903, 16154, 6497,
+    -9630, -16311, -6976, 9209, 16351, 7438, -8779, -16375, -7893, 8340, 16384, 8340,
+    -7893, -16375, -8779, 7438, 16351, 9209, -6976, -16311, -9630, 6507, 16254, 10042,
+    -6031, -16182, -10443, 5550, 16093, 10835, -5063, -15989, -11215, 4571, 15869, 11585,
+    -4074, -15733, -11943, 3574, 15582, 12289, -3070, -15415, -12624, 2563, 15233, 12946,
+    -2053, -15036, -13255, 1542, 14824, 13550, -1029, -14598, -13833, 515, 14357, 14102,
+    0, -14102, -14357, -515, 13833, 14598, 1029, -13550, -14824, -1542, 13255, 15036,
+    2053, -12946, -15233, -2563, 12624, 15415, 3070, -12289, -15582, -3574, 11943, 15733,
+    4074, -11585, -15869, -4571, 11215, 15989, 5063, -10835, -16093, -5550, 10443, 16182,
+    6031, -10042, -16254, -6507, 9630, 16311, 6976, -9209, -16351, -7438, 8779, 16375,
+    7893, -8340, -16384, -8340, 7893, 16375, 8779, -7438, -16351, -9209, 6976, 16311,
+    9630, -6507, -16254, -10042, 6031, 16182, 10443, -5550, -16093, -10835, 5063, 15989,
+    11215, -4571, -15869, -11585, 4074, 15733, 11943, -3574, -15582, -12289, 3070, 15415,
+    12624, -2563, -15233, -12946, 2053, 15036, 13255, -1542, -14824, -13550, 1029, 14598,
+    13833, -515, -14357, -14102, 0, 14102, 14357, 515, -13833, -14598, -1029, 13550,
+    14824, 1542, -13255, -15036, -2053, 12946, 15233, 2563, -12624, -15415, -3070, 12289,
+    15582, 3574, -11943, -15733, -4074, 11585, 15869, 4571, -11215, -15989, -5063, 10835,
+    16093, 5550, -10443, -16182, -6031, 10042, 16254, 6507, -9630, -16311, -6976, 9209,
+    16351, 7438, -8779, -16375, -7893, 8340, 16384, 8340, -7893, -16375, -8779, 7438,
+    16351, 9209, -6976, -16311, -9630, 6507, 16254, 10042, -6031, -16182, -10443, 5550,
+    16093, 10835, -5063, -15989, -11215, 4571, 15869, 11585, -4074, -15733, -11943, 3574,
+    15582, 12289, -3070, -15415, -12624, 2563, 15233, 12946, -2053, -15036, -13255, 1542,
+    14824, 13550, -1029, -14598, -13833, 515, 14357, 14102, 0, -14102, -14357, -515,
+    13833, 14598, 1029, -13550, -14824, -1542, 13255, 15036, 2053, -12946, -15233, -2563,
+    12624, 15415, 3070, -12289, -15582, -3574, 11943, 15733, 4074, -11585, -15869, -4571,
+    11215, 15989, 5063, -10835, -16093, -5550, 10443, 16182, 6031, -10042, -16254, -6507,
+    9630, 16311, 6976, -9209, -16351, -7438, 8779, 16375, 7893, -8340, -16384, -8340,
+    7893, 16375, 8779, -7438, -16351, -9209, 6976, 16311, 9630, -6507, -16254, -10042,
+    6031, 16182, 10443, -5550, -16093, -10835, 5063, 15989, 11215, -4571, -15869, -11585,
+    4074, 15733, 11943, -3574, -15582, -12289, 3070, 15415, 12624, -2563, -15233, -12946,
+    2053, 15036, 13255, -1542, -14824, -13550, 1029, 14598, 13833, -515, -14357, -14102,
+    0, 14102, 14357, 515, -13833, -14598, -1029, 13550, 14824, 1542, -13255, -15036,
+    -2053, 12946, 15233, 2563, -12624, -15415, -3070, 12289, 15582, 3574, -11943, -15733,
+    -4074, 11585, 15869, 4571, -11215, -15989, -5063, 10835, 16093, 5550, -10443, -16182,
+    -6031, 10042, 16254, 6507, -9630, -16311, -6976, 9209, 16351, 7438, -8779, -16375,
+    -7893, 8340, 16384, 8340, -7893, -16375, -8779, 7438, 16351, 9209, -6976, -16311,
+    -9630, 6507, 16254, 10042, -6031, -16182, -10443, 5550, 16093, 10835, -5063, -15989,
+    -11215, 4571, 15869, 11585, -4074, -15733, -11943, 3574, 15582, 12289, -3070, -15415,
+    -12624, 2563, 15233, 12946, -2053, -15036, -13255, 1542, 14824, 13550, -1029, -14598,
+    -13833, 515, 14357, 14102, 0, -14102, -14357, -515, 13833, 14598, 1029, -13550,
+    -14824, -1542, 13255, 15036, 2053, -12946, -15233, -2563, 12624, 15415, 3070, -12289,
+    -15582, -3574, 11943, 15733, 4074, -11585, -15869, -4571, 11215, 15989, 5063, -10835,
+    -16093, -5550, 10443, 16182, 6031, -10042, -16254, -6507, 9630, 16311, 6976, -9209,
+    -16351, -7438, 8779, 16375, 7893, -8340, -16384, -8340, 7893, 16375, 8779, -7438,
+    -16351, -9209, 6976, 16311, 9630, -6507, -16254, -10042, 6031, 16182, 10443, -5550,
+    -16093, -10835, 5063, 15989, 11215, -4571, -15869, -11585, 4074, 15733, 11943, -3574,
+    -15582, -12289, 3070, 15415, 12624, -2563, -15233, -12946, 2053, 15036, 13255, -1542,
+    -14824, -13550, 1029, 14598, 13833, -515, -14357, -14102, 0, 14015, 14159, 502,
+    -13307, -13802, -953, 12257, 13048, 1316, -10931, -11937, -1563, 9411, 10531, 1677,
+    -7785, -8913, -1655, 6145, 7180, 1507, -4578, -5436, -1258, 3163, 3789, 942,
+    -1966, -2342, -607, 1035, 1186, 302, -397, -396, -83, 62, 25, 0,
+};
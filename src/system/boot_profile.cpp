@@ -0,0 +1,72 @@
+#include "boot_profile.h"
+#include "../log.h"
+
+#include <Arduino.h>
+#include <stdio.h>
+
+static portMUX_TYPE bootMux = portMUX_INITIALIZER_UNLOCKED;
+static BootProfile profile = {};
+
+void bootMark(const char* phase) {
+    uint32_t now = micros();
+    portENTER_CRITICAL(&bootMux);
+    if (profile.phaseCount < BOOT_MAX_PHASES) {
+        profile.phases[profile.phaseCount].name = phase;
+        profile.phases[profile.phaseCount].endUs = now;
+        profile.phaseCount++;
+    }
+    portEXIT_CRITICAL(&bootMux);
+}
+
+void bootMarkConnected() {
+    uint32_t now = micros();
+    portENTER_CRITICAL(&bootMux);
+    if (profile.connectedUs == 0) profile.connectedUs = now;
+    portEXIT_CRITICAL(&bootMux);
+}
+
+void bootMarkFirstTelemetry() {
+    uint32_t now = micros();
+    portENTER_CRITICAL(&bootMux);
+    bool first = profile.firstTelemetryUs == 0;
+    if (first) profile.firstTelemetryUs = now;
+    portEXIT_CRITICAL(&bootMux);
+    if (first) bootProfileLog();
+}
+
+BootProfile bootProfile() {
+    portENTER_CRITICAL(&bootMux);
+    BootProfile copy = profile;
+    portEXIT_CRITICAL(&bootMux);
+    return copy;
+}
+
+void bootProfileLog() {
+    BootProfile p = bootProfile();
+    // Phases on different tasks overlap, so each is shown with the time
+    // since the previous mark as well as since reset
+    uint32_t previous = 0;
+    for (int i = 0; i < p.phaseCount; i++) {
+        LOG_I(APP, "Boot: %-12s done at %5u ms (+%u ms)", p.phases[i].name,
+              p.phases[i].endUs / 1000, (p.phases[i].endUs - previous) / 1000);
+        previous = p.phases[i].endUs;
+    }
+    if (p.connectedUs) LOG_I(APP, "Boot: connected at %u ms", p.connectedUs / 1000);
+    if (p.firstTelemetryUs) LOG_I(APP, "Boot: first telemetry at %u ms", p.firstTelemetryUs / 1000);
+}
+
+size_t bootFormatLine(char* out, size_t size) {
+    BootProfile p = bootProfile();
+    uint32_t setupUs = 0;
+    for (int i = 0; i < p.phaseCount; i++) {
+        if (p.phases[i].endUs > setupUs) setupUs = p.phases[i].endUs;
+    }
+    int n = snprintf(out, size, "Boot %u.%02us", setupUs / 1000000, setupUs / 10000 % 100);
+    if (p.connectedUs && n < (int)size) {
+        n += snprintf(out + n, size - n, ", connected %u.%02us", p.connectedUs / 1000000, p.connectedUs / 10000 % 100);
+    }
+    if (p.firstTelemetryUs && n < (int)size) {
+        n += snprintf(out + n, size - n, ", data %u.%02us", p.firstTelemetryUs / 1000000, p.firstTelemetryUs / 10000 % 100);
+    }
+    return n < (int)size ? n : size - 1;
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Startup timeline: each phase marks the time it finished, in
+// microseconds since reset, from whichever task ran it. The connection
+// and first telemetry sample are marked once, so the stats screen can
+// show how long power-on to a live dashboard took.
+
+static const int BOOT_MAX_PHASES = 10;
+
+struct BootPhase {
+    const char* name;
+    uint32_t endUs;
+};
+
+struct BootProfile {
+    uint8_t phaseCount;
+    BootPhase phases[BOOT_MAX_PHASES];
+    uint32_t connectedUs;        // 0 until the first connection
+    uint32_t firstTelemetryUs;   // 0 until the first telemetry sample
+};
+
+// Mark a phase as done now. Safe from any task; the name must outlive
+// the profile (a literal).
+void bootMark(const char* phase);
+
+// Only the first call of each counts
+void bootMarkConnected();
+void bootMarkFirstTelemetry();
+
+BootProfile bootProfile();
+
+// Log each phase with its duration and the totals
+void bootProfileLog();
+
+// "Boot 0.62s, connected 1.41s, data 1.48s" for the stats screen
+size_t bootFormatLine(char* out, size_t size);
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <atomic>
+
+// Where one reader of a BroadcastRing is: the sequence number of the next
+// item it wants, and how many it lost to the writer lapping it
+struct BroadcastCursor {
+    uint32_t next;
+    uint32_t missed;
+};
+
+// Lock-free ring with one writer and any number of readers, each reading
+// at its own pace through its own cursor. The writer never blocks and
+// never waits for a reader: it overwrites the oldest item. Each slot
+// carries the sequence number of the item in it, odd while it is being
+// written, so a reader that was lapped, or whose copy a write overlapped,
+// sees the mismatch, counts what it lost and skips ahead to the oldest
+// item still there. Capacity must be a power of two.
+template <typename T, size_t Capacity>
+class BroadcastRing {
+    static_assert((Capacity & (Capacity - 1)) == 0, "capacity must be a power of two");
+
+public:
+    BroadcastRing() : head(0) {
+        for (size_t i = 0; i < Capacity; i++) slots[i].seq.store(0, std::memory_order_relaxed);
+    }
+
+    // Only one task may call publish()
+    void publish(const T& item) {
+        uint32_t n = head.load(std::memory_order_relaxed);
+        Slot& slot = slots[n & (Capacity - 1)];
+        slot.seq.store(2 * n + 1, std::memory_order_relaxed);  // Odd: write in progress
+        std::atomic_thread_fence(std::memory_order_release);
+        memcpy(&slot.item, &item, sizeof(T));
+        slot.seq.store(2 * n + 2, std::memory_order_release);
+        head.store(n + 1, std::memory_order_release);
+    }
+
+    // Items published so far
+    uint32_t published() const { return head.load(std::memory_order_acquire); }
+
+    // A cursor at the next item to be published
+    void subscribe(BroadcastCursor& cursor) const {
+        cursor.next = published();
+        cursor.missed = 0;
+    }
+
+    // Copy the item at the cursor and advance it. Returns false when the
+    // reader has caught up.
+    bool read(BroadcastCursor& cursor, T& out) const {
+        for (;;) {
+            uint32_t n = head.load(std::memory_order_acquire);
+            if (cursor.next == n) return false;
+            // Lapped: the oldest slot may be the one being written next,
+            // so resume one past it
+            if (n - cursor.next >= Capacity) {
+                uint32_t oldest = n - Capacity + 1;
+                cursor.missed += oldest - cursor.next;
+                cursor.next = oldest;
+            }
+            const Slot& slot = slots[cursor.next & (Capacity - 1)];
+            uint32_t expected = 2 * cursor.next + 2;
+            uint32_t before = slot.seq.load(std::memory_order_acquire);
+            if (before == expected) {
+                memcpy(&out, &slot.item, sizeof(T));
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if (slot.seq.load(std::memory_order_relaxed) == expected) {
+                    cursor.next++;
+                    return true;
+                }
+            }
+            // Overwritten under us: count it and move on
+            cursor.missed++;
+            cursor.next++;
+        }
+    }
+
+private:
+    struct Slot {
+        std::atomic<uint32_t> seq;
+        T item;
+    };
+
+    std::atomic<uint32_t> head;
+    Slot slots[Capacity];
+};
@@ -0,0 +1,94 @@
+#include "coexist.h"
+
+#include <Arduino.h>
+#include <string.h>
+
+// A plan not refreshed for this long is assumed stopped (the UI loop
+// refreshes it at least every poll period while connected)
+static const uint32_t PLAN_STALE_MS = 1000;
+
+static portMUX_TYPE coexistMux = portMUX_INITIALIZER_UNLOCKED;
+static CoexistSettings config = {};
+static CoexistStats stats = {};
+static bool planning = false;
+static uint32_t plannedAtMs = 0;     // When nextPollMs was last set
+static uint32_t nextPollMs = 0;
+static bool awaiting = false;        // A poll is out and not fully answered
+static uint32_t sentMs = 0;
+static uint32_t replyWindowMs = 0;
+
+// Called with coexistMux held
+static bool inGap(CoexistUser user, uint32_t now) {
+    if (!planning || now - plannedAtMs > PLAN_STALE_MS) return true;
+    if (awaiting && now - sentMs < replyWindowMs) return false;
+    int32_t until = (int32_t)(nextPollMs - now);
+    return until >= (int32_t)config.burstMs[user];
+}
+
+void coexistBegin(const CoexistSettings& settings) {
+    portENTER_CRITICAL(&coexistMux);
+    config = settings;
+    memset(&stats, 0, sizeof(stats));
+    portEXIT_CRITICAL(&coexistMux);
+}
+
+void coexistPollSent(uint32_t nowMs, uint32_t window) {
+    portENTER_CRITICAL(&coexistMux);
+    awaiting = true;
+    sentMs = nowMs;
+    replyWindowMs = window;
+    portEXIT_CRITICAL(&coexistMux);
+}
+
+void coexistPollAnswered() {
+    portENTER_CRITICAL(&coexistMux);
+    awaiting = false;
+    portEXIT_CRITICAL(&coexistMux);
+}
+
+void coexistNextPoll(uint32_t nowMs, uint32_t untilMs) {
+    portENTER_CRITICAL(&coexistMux);
+    planning = untilMs != UINT32_MAX;
+    plannedAtMs = nowMs;
+    nextPollMs = nowMs + untilMs;
+    if (!planning) awaiting = false;
+    portEXIT_CRITICAL(&coexistMux);
+}
+
+bool coexistAcquire(CoexistUser user) {
+    uint32_t started = millis();
+    bool deferred = false;
+    bool forced = false;
+    for (;;) {
+        uint32_t now = millis();
+        portENTER_CRITICAL(&coexistMux);
+        bool gap = inGap(user, now);
+        uint32_t maxWait = config.maxWaitMs;
+        portEXIT_CRITICAL(&coexistMux);
+        if (gap) break;
+        if (now - started >= maxWait) {
+            forced = true;
+            break;
+        }
+        deferred = true;
+        vTaskDelay(1);
+    }
+
+    uint32_t waited = millis() - started;
+    portENTER_CRITICAL(&coexistMux);
+    CoexistUserStats& s = stats.users[user];
+    s.bursts++;
+    if (deferred) s.deferred++;
+    if (forced) s.forced++;
+    s.waitedMs += waited;
+    portEXIT_CRITICAL(&coexistMux);
+    return !forced;
+}
+
+CoexistStats coexistStats() {
+    CoexistStats out;
+    portENTER_CRITICAL(&coexistMux);
+    out = stats;
+    portEXIT_CRITICAL(&coexistMux);
+    return out;
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <stdint.h>
+
+// Places background bursts in the gaps of the VESC poll schedule.
+//
+// The radio is shared by the BLE links and WiFi, and the SPI bus by the
+// SD card and the LCD, so an SD block write, card reads for an upload,
+// an HTTP request or a flash sector write (which holds the cache off)
+// that lands on top of a poll delays its replies. The UI
+// loop tells the scheduler when each poll goes out, when the last reply
+// to it came in and when the next one falls due. A background task asks
+// for a slot before each burst and is held until a poll has been
+// answered and the next one is at least the burst's length away, or
+// until it has waited maxWaitMs, so a burst is never put off for good.
+//
+// With no polls planned (nothing connected, or the plan not refreshed
+// within a few poll periods) every burst goes at once.
+
+enum CoexistUser : uint8_t {
+    COEXIST_SD_WRITE,          // Telemetry log blocks
+    COEXIST_SD_READ,           // Log reads for the upload, review and log service
+    COEXIST_WIFI,              // Upload and firmware requests
+    COEXIST_FLASH_WRITE,       // Firmware image sectors
+    COEXIST_USER_COUNT
+};
+
+struct CoexistSettings {
+    uint32_t burstMs[COEXIST_USER_COUNT];   // Gap a burst of each user needs before the next poll
+    uint32_t maxWaitMs;                     // Longest a burst is held back
+};
+
+struct CoexistUserStats {
+    uint32_t bursts;           // Slots asked for
+    uint32_t deferred;         // Bursts that had to wait for a gap
+    uint32_t forced;           // Bursts that gave up waiting at maxWaitMs
+    uint32_t waitedMs;         // Total time held back
+};
+
+struct CoexistStats {
+    CoexistUserStats users[COEXIST_USER_COUNT];
+};
+
+void coexistBegin(const CoexistSettings& settings);
+
+// From the UI loop: a poll just went out and its replies are expected
+// within replyWindowMs
+void coexistPollSent(uint32_t nowMs, uint32_t replyWindowMs);
+
+// Every outstanding poll has been answered. Safe from any task.
+void coexistPollAnswered();
+
+// The next poll falls due untilMs from now; UINT32_MAX stops planning
+// (e.g. on disconnect)
+void coexistNextPoll(uint32_t nowMs, uint32_t untilMs);
+
+// From a background task before a burst: wait for a gap. Returns false
+// if it gave up waiting.
+bool coexistAcquire(CoexistUser user);
+
+CoexistStats coexistStats();
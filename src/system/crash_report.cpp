@@ -0,0 +1,190 @@
+#include "crash_report.h"
+#include "memory.h"
+#include "../log.h"
+
+#include <Arduino.h>
+#include <Preferences.h>
+#include <SD.h>
+#include <esp_system.h>
+#include <esp_partition.h>
+#include <sdkconfig.h>
+#include <string.h>
+
+// Dumps are only written, and summaries only readable, when the core is
+// built with them; otherwise resets are still counted
+#if defined(CONFIG_ESP_COREDUMP_ENABLE_TO_FLASH) && defined(CONFIG_ESP_COREDUMP_DATA_FORMAT_ELF)
+#include <esp_core_dump.h>
+#define CRASH_DUMPS 1
+#else
+#define CRASH_DUMPS 0
+#endif
+
+static const char* NVS_NAMESPACE = "crash";
+static const char* KEY_CRASHES = "crashes";
+static const char* KEY_BROWNOUTS = "brownouts";
+static const char* KEY_LAST = "last";          // CrashSummary of the last crash
+static const char* CRASH_DIRECTORY = "/logs";
+static const size_t COPY_BYTES = 4096;         // Dump copied to the card a sector at a time
+static const size_t ERASE_BYTES = 4096;        // The dump's header sector; without it there is no image
+
+static CrashStats stats = {};
+
+const char* crashReasonName(uint8_t reason) {
+    switch (reason) {
+        case ESP_RST_PANIC: return "panic";
+        case ESP_RST_INT_WDT: return "interrupt wdt";
+        case ESP_RST_TASK_WDT: return "task wdt";
+        case ESP_RST_WDT: return "wdt";
+        case ESP_RST_BROWNOUT: return "brownout";
+        default: return "reset";
+    }
+}
+
+static bool isCrash(esp_reset_reason_t reason) {
+    return reason == ESP_RST_PANIC || reason == ESP_RST_INT_WDT || reason == ESP_RST_TASK_WDT ||
+           reason == ESP_RST_WDT;
+}
+
+// One line per field, for people and for grep
+static bool writeSummary(const char* path, const CrashSummary& s) {
+    File file = SD.open(path, FILE_WRITE);
+    if (!file) return false;
+    file.printf("crash %u\nreason %s\n", (unsigned)s.number, crashReasonName(s.reason));
+    if (s.hasDump) {
+        file.printf("task %s\npc 0x%08x\ncause %u address 0x%08x\nelf %s\nbacktrace", s.task, (unsigned)s.pc,
+                    (unsigned)s.cause, (unsigned)s.address, s.elfSha);
+        for (uint8_t i = 0; i < s.depth; i++) file.printf(" 0x%08x", (unsigned)s.backtrace[i]);
+        file.printf("%s\n", s.corrupted ? " (corrupted)" : "");
+    }
+    file.close();
+    return true;
+}
+
+#if CRASH_DUMPS
+static bool readDump(CrashSummary& s) {
+    esp_core_dump_summary_t dump;
+    if (esp_core_dump_get_summary(&dump) != ESP_OK) return false;
+    s.hasDump = true;
+    strncpy(s.task, dump.exc_task, sizeof(s.task) - 1);
+    s.task[sizeof(s.task) - 1] = '\0';
+    s.pc = dump.exc_pc;
+    s.cause = dump.ex_info.exc_cause;
+    s.address = dump.ex_info.exc_vaddr;
+    s.depth = dump.exc_bt_info.depth < CRASH_BACKTRACE_DEPTH ? dump.exc_bt_info.depth : CRASH_BACKTRACE_DEPTH;
+    for (uint8_t i = 0; i < s.depth; i++) s.backtrace[i] = dump.exc_bt_info.bt[i];
+    s.corrupted = dump.exc_bt_info.corrupted;
+    strncpy(s.elfSha, (const char*)dump.app_elf_sha256_str, sizeof(s.elfSha) - 1);
+    s.elfSha[sizeof(s.elfSha) - 1] = '\0';
+    return true;
+}
+
+// Copy the raw image out of the coredump partition
+static bool copyDump(const char* path) {
+    size_t address = 0, size = 0;
+    if (esp_core_dump_image_get(&address, &size) != ESP_OK) return false;
+    const esp_partition_t* partition =
+        esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_DATA_COREDUMP, nullptr);
+    if (partition == nullptr || address < partition->address) return false;
+    uint8_t* buffer = (uint8_t*)memoryAlloc(COPY_BYTES, MEMORY_INTERNAL, MEMORY_TAG_SYSTEM);
+    if (buffer == nullptr) return false;
+    File file = SD.open(path, FILE_WRITE);
+    bool ok = (bool)file;
+    for (size_t done = 0; ok && done < size; done += COPY_BYTES) {
+        size_t n = size - done < COPY_BYTES ? size - done : COPY_BYTES;
+        ok = esp_partition_read(partition, address - partition->address + done, buffer, n) == ESP_OK &&
+             file.write(buffer, n) == n;
+    }
+    if (file) file.close();
+    memoryFree(buffer);
+    return ok;
+}
+
+static void eraseDump() {
+    const esp_partition_t* partition =
+        esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_DATA_COREDUMP, nullptr);
+    if (partition != nullptr) esp_partition_erase_range(partition, 0, ERASE_BYTES);
+}
+#endif
+
+// Both files are written under temporary names and renamed once whole,
+// so the upload never sends half of one
+static bool saveToCard(const CrashSummary& s, bool withDump) {
+    if (SD.cardType() == CARD_NONE) return false;
+    if (!SD.exists(CRASH_DIRECTORY)) SD.mkdir(CRASH_DIRECTORY);
+    char path[32], temporary[32];
+    snprintf(temporary, sizeof(temporary), "%s/crash%04u.tmp", CRASH_DIRECTORY, (unsigned)(s.number % 10000));
+#if CRASH_DUMPS
+    if (withDump) {
+        snprintf(path, sizeof(path), "%s/crash%04u%s", CRASH_DIRECTORY, (unsigned)(s.number % 10000),
+                 CRASH_DUMP_EXTENSION);
+        SD.remove(path);
+        if (!copyDump(temporary) || !SD.rename(temporary, path)) {
+            SD.remove(temporary);
+            return false;
+        }
+    }
+#endif
+    snprintf(path, sizeof(path), "%s/crash%04u%s", CRASH_DIRECTORY, (unsigned)(s.number % 10000),
+             CRASH_SUMMARY_EXTENSION);
+    SD.remove(path);
+    if (!writeSummary(temporary, s) || !SD.rename(temporary, path)) {
+        SD.remove(temporary);
+        return false;
+    }
+    return true;
+}
+
+void crashReportBoot() {
+    esp_reset_reason_t reason = esp_reset_reason();
+    Preferences prefs;
+    if (!prefs.begin(NVS_NAMESPACE, false)) return;
+    stats.crashes = prefs.getUInt(KEY_CRASHES, 0);
+    stats.brownouts = prefs.getUInt(KEY_BROWNOUTS, 0);
+    stats.haveSummary = prefs.getBytes(KEY_LAST, &stats.summary, sizeof(stats.summary)) == sizeof(stats.summary);
+    stats.crashedLastBoot = isCrash(reason);
+    if (reason == ESP_RST_BROWNOUT) prefs.putUInt(KEY_BROWNOUTS, ++stats.brownouts);
+
+    CrashSummary found = {};
+    bool haveDump = false;
+#if CRASH_DUMPS
+    haveDump = readDump(found);
+#endif
+    if (stats.crashedLastBoot) {
+        prefs.putUInt(KEY_CRASHES, ++stats.crashes);
+        found.reason = reason;
+        found.number = stats.crashes;
+    } else if (haveDump && stats.haveSummary) {
+        // Left in flash by a crash already counted, for want of a card
+        found.reason = stats.summary.reason;
+        found.number = stats.summary.number;
+    } else if (haveDump) {
+        found.reason = ESP_RST_PANIC;
+        found.number = stats.crashes;
+    }
+
+    if (stats.crashedLastBoot || haveDump) {
+        stats.summary = found;
+        stats.haveSummary = true;
+        prefs.putBytes(KEY_LAST, &stats.summary, sizeof(stats.summary));
+        if (found.hasDump) {
+            LOG_E(APP, "Crash %u (%s) in task %s at 0x%08x, cause %u", (unsigned)found.number,
+                  crashReasonName(found.reason), found.task, (unsigned)found.pc, (unsigned)found.cause);
+        } else {
+            LOG_E(APP, "Crash %u (%s), no core dump", (unsigned)found.number, crashReasonName(found.reason));
+        }
+        bool saved = saveToCard(found, haveDump);
+#if CRASH_DUMPS
+        if (haveDump && saved) eraseDump();
+#endif
+        if (saved) {
+            LOG_I(APP, "Crash %u saved to %s", (unsigned)found.number, CRASH_DIRECTORY);
+        } else if (haveDump) {
+            LOG_W(APP, "No card for crash %u; its dump stays in flash", (unsigned)found.number);
+        }
+    }
+    prefs.end();
+}
+
+CrashStats crashReportStats() {
+    return stats;
+}
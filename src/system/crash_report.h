@@ -0,0 +1,54 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+// What the last crash left behind. On a panic or watchdog reset the core
+// writes a core dump to the coredump partition; at the next boot its
+// summary (the task, the PC, the backtrace) is read out, kept in NVS for
+// the stats overlay, and the dump is copied to the SD card next to the
+// ride logs, where the log upload picks it up:
+//
+//     /logs/crashNNNN.txt    the summary as text
+//     /logs/crashNNNN.cdmp   the raw dump, for
+//                            espcoredump.py info_corefile -t raw -c crashNNNN.cdmp firmware.elf
+//
+// Once copied the dump is erased, so each crash is saved once. Without a
+// card it stays in flash until a boot that has one (or the next crash).
+// Resets are counted by kind in NVS whether or not a dump was written.
+
+#define CRASH_SUMMARY_EXTENSION ".txt"
+#define CRASH_DUMP_EXTENSION ".cdmp"
+
+static const uint8_t CRASH_BACKTRACE_DEPTH = 9;
+
+struct CrashSummary {
+    uint8_t reason;            // esp_reset_reason_t of the crash
+    bool hasDump;              // The fields below came from a core dump
+    bool corrupted;            // The backtrace ran into a bad frame
+    uint8_t depth;             // Frames in backtrace
+    char task[16];
+    uint32_t pc;
+    uint32_t cause;            // EXCCAUSE, and the address it was about
+    uint32_t address;
+    uint32_t backtrace[CRASH_BACKTRACE_DEPTH];
+    char elfSha[9];            // Start of the crashed build's ELF SHA-256
+    uint32_t number;           // Of the crash since the counters started
+};
+
+struct CrashStats {
+    uint32_t crashes;          // Panics and watchdogs
+    uint32_t brownouts;
+    bool crashedLastBoot;      // This boot follows a crash
+    bool haveSummary;          // summary holds the last crash with a number
+    CrashSummary summary;
+};
+
+// Early in setup(), after the SD card is mounted: count the reset, read
+// any core dump, save it to the card and erase it. Logs what it found.
+void crashReportBoot();
+
+CrashStats crashReportStats();
+
+// Short name of a reset reason ("panic", "task wdt", ...)
+const char* crashReasonName(uint8_t reason);
@@ -0,0 +1,37 @@
+#include "display_power.h"
+
+DisplayPower::DisplayPower(uint32_t dimMs, uint32_t offMs)
+    : dimMs(dimMs), offMs(offMs), lastActivityMs(0), current(DISPLAY_FULL), stateChanged(false) {
+}
+
+void DisplayPower::setTimeouts(uint32_t newDimMs, uint32_t newOffMs) {
+    dimMs = newDimMs;
+    offMs = newOffMs;
+}
+
+bool DisplayPower::activity(uint32_t now) {
+    lastActivityMs = now;
+    return current == DISPLAY_OFF;
+}
+
+DisplayState DisplayPower::stateAt(uint32_t now) const {
+    uint32_t quiet = now - lastActivityMs;
+    if (offMs > 0 && quiet >= offMs) return DISPLAY_OFF;
+    if (dimMs > 0 && quiet >= dimMs) return DISPLAY_DIMMED;
+    return DISPLAY_FULL;
+}
+
+DisplayState DisplayPower::update(uint32_t now) {
+    DisplayState next = stateAt(now);
+    stateChanged = next != current;
+    current = next;
+    return current;
+}
+
+uint32_t DisplayPower::msUntilChange(uint32_t now) const {
+    uint32_t quiet = now - lastActivityMs;
+    uint32_t until = UINT32_MAX;
+    if (dimMs > 0 && quiet < dimMs) until = dimMs - quiet;
+    if (offMs > 0 && quiet < offMs && offMs - quiet < until) until = offMs - quiet;
+    return until;
+}
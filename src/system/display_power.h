@@ -0,0 +1,46 @@
+#pragma once
+
+#include <stdint.h>
+
+enum DisplayState : uint8_t {
+    DISPLAY_FULL,       // The power mode's backlight
+    DISPLAY_DIMMED,     // The dimmed backlight
+    DISPLAY_OFF         // Backlight and panel off, nothing rendered
+};
+
+// Whether anyone is looking at the display, judged by how long ago there
+// was a reason to: a touch, the vehicle moving, an alert. dimMs after
+// the last one the backlight dims, offMs after it the display goes off;
+// the next one brings it straight back to full. 0 turns a step off.
+//
+// Hardware independent; times are passed in.
+class DisplayPower {
+public:
+    DisplayPower(uint32_t dimMs, uint32_t offMs);
+
+    void setTimeouts(uint32_t dimMs, uint32_t offMs);
+
+    // A reason to be on. Returns true if the display was off, so the
+    // touch that woke it can be kept from acting on the dark screen.
+    bool activity(uint32_t now);
+
+    // The state for now; check changed() for whether it moved
+    DisplayState update(uint32_t now);
+    DisplayState state() const { return current; }
+
+    // The last update() changed the state
+    bool changed() const { return stateChanged; }
+
+    // Until update() would dim or switch off without further activity,
+    // UINT32_MAX if never
+    uint32_t msUntilChange(uint32_t now) const;
+
+private:
+    DisplayState stateAt(uint32_t now) const;
+
+    uint32_t dimMs;
+    uint32_t offMs;
+    uint32_t lastActivityMs;
+    DisplayState current;
+    bool stateChanged;
+};
@@ -0,0 +1,135 @@
+#include "event_trace.h"
+#include "memory.h"
+#include "../log.h"
+
+#include <Arduino.h>
+#include <SD.h>
+#include <esp_timer.h>
+#include <string.h>
+
+static const char* TRACE_DIRECTORY = "/logs";
+static const size_t WRITE_RECORDS = 512;    // Records per card write
+static const size_t HEX_LINE_RECORDS = 8;   // Records per serial line
+
+static TraceRecord* ring = nullptr;
+static uint32_t mask = 0;
+static volatile uint32_t head = 0;          // Records ever claimed
+static volatile bool frozen = false;
+static uint32_t saves = 0;
+
+static const char* EVENT_NAMES[TRACE_EVENT_COUNT] = {
+    "request", "write", "notify", "parse", "frame", "decoded", "render start", "render end"
+};
+
+const char* traceEventName(uint8_t event) {
+    return event < TRACE_EVENT_COUNT ? EVENT_NAMES[event] : "?";
+}
+
+bool traceBegin(size_t records) {
+    if (ring || records == 0) return ring != nullptr;
+    size_t capacity = 1;
+    while (capacity * 2 <= records) capacity *= 2;
+    ring = (TraceRecord*)memoryAlloc(capacity * sizeof(TraceRecord), MEMORY_BULK, MEMORY_TAG_PROTOCOL);
+    if (!ring) {
+        LOG_E(APP, "No PSRAM for a %u record event trace", (unsigned)capacity);
+        return false;
+    }
+    mask = capacity - 1;
+    LOG_I(APP, "Tracing protocol events (%u records)", (unsigned)capacity);
+    return true;
+}
+
+// Writers on both cores each claim a slot with one atomic add, so none
+// waits on another
+IRAM_ATTR void traceEvent(TraceEvent event, uint8_t link, uint16_t arg) {
+    if (ring == nullptr || frozen) return;
+    uint32_t slot = __atomic_fetch_add(&head, 1, __ATOMIC_RELAXED) & mask;
+    TraceRecord& record = ring[slot];
+    record.timeUs = (uint32_t)esp_timer_get_time();
+    record.event = event;
+    record.link = link;
+    record.arg = arg;
+}
+
+uint32_t traceSaveCount() {
+    return saves;
+}
+
+static bool saveToCard(const TraceFileHeader& header, uint32_t first) {
+    if (!SD.exists(TRACE_DIRECTORY)) SD.mkdir(TRACE_DIRECTORY);
+
+    char path[32];
+    for (int i = 1; i <= 9999; i++) {
+        snprintf(path, sizeof(path), "%s/trace%04d.vtr", TRACE_DIRECTORY, i);
+        if (SD.exists(path)) continue;
+
+        File file = SD.open(path, FILE_WRITE);
+        if (!file) break;
+        bool ok = file.write((const uint8_t*)&header, sizeof(header)) == sizeof(header);
+        // The ring wraps, so write it in runs that do not
+        for (uint32_t done = 0; ok && done < header.recordCount;) {
+            uint32_t slot = (first + done) & mask;
+            uint32_t n = header.recordCount - done;
+            if (n > mask + 1 - slot) n = mask + 1 - slot;
+            if (n > WRITE_RECORDS) n = WRITE_RECORDS;
+            size_t bytes = n * sizeof(TraceRecord);
+            ok = file.write((const uint8_t*)&ring[slot], bytes) == bytes;
+            done += n;
+        }
+        file.close();
+        if (!ok) {
+            LOG_E(APP, "SD write failed saving %s", path);
+            return false;
+        }
+        LOG_I(APP, "Saved %u trace records to %s", (unsigned)header.recordCount, path);
+        return true;
+    }
+    LOG_E(APP, "Could not create a trace file");
+    return false;
+}
+
+// "trace begin <records> <lost>", then "trc <hex>" lines of whole
+// records, then "trace end"
+static void dumpToSerial(const TraceFileHeader& header, uint32_t first) {
+    Serial.printf("trace begin %u %u\n", (unsigned)header.recordCount, (unsigned)header.lostRecords);
+    for (uint32_t i = 0; i < header.recordCount; i += HEX_LINE_RECORDS) {
+        Serial.print("trc ");
+        for (uint32_t j = i; j < header.recordCount && j < i + HEX_LINE_RECORDS; j++) {
+            const uint8_t* bytes = (const uint8_t*)&ring[(first + j) & mask];
+            for (size_t k = 0; k < sizeof(TraceRecord); k++) Serial.printf("%02X", bytes[k]);
+        }
+        Serial.print("\n");
+    }
+    Serial.print("trace end\n");
+}
+
+bool traceSave(const char* reason) {
+    if (ring == nullptr) return false;
+
+    // Let a writer that got past the check finish its record
+    frozen = true;
+    delay(1);
+    uint32_t total = head;
+    uint32_t capacity = mask + 1;
+    TraceFileHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic = TRACE_MAGIC;
+    header.version = TRACE_VERSION;
+    header.headerSize = sizeof(header);
+    header.recordCount = total < capacity ? total : capacity;
+    header.lostRecords = total - header.recordCount;
+    uint32_t first = total - header.recordCount;
+
+    LOG_I(APP, "Saving the event trace: %s", reason);
+    bool saved = true;
+    if (header.recordCount > 0) {
+        if (SD.cardType() != CARD_NONE) {
+            saved = saveToCard(header, first);
+        } else {
+            dumpToSerial(header, first);
+        }
+    }
+    saves++;
+    frozen = false;
+    return saved;
+}
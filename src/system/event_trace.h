@@ -0,0 +1,68 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+// A flight recorder for the way of a poll: each step from the request to
+// the pixels is stamped into a fixed ring of 8-byte records, cheap enough
+// to leave on in any build. When a reply comes back late the ring is
+// saved, so the time can be put down to our scheduler, the BLE stack, the
+// VESC, the parser or the renderer after the fact:
+//
+//     /logs/traceNNNN.vtr    the records, oldest first, behind a
+//                            TraceFileHeader; or "trc" hex lines on the
+//                            serial port without an SD card
+//
+// tools/trace_json.py turns either into Chrome trace JSON for
+// chrome://tracing or ui.perfetto.dev. Times are esp_timer microseconds,
+// the one clock both cores and every task share (a core's cycle counter
+// is its own, and its rate follows the CPU frequency). Little-endian
+// throughout.
+
+static const uint32_t TRACE_MAGIC = 0x43525456;     // "VTRC"
+static const uint16_t TRACE_VERSION = 1;
+
+enum TraceEvent : uint8_t {
+    TRACE_REQUEST,          // A poll was queued; arg = command << 8 | controller
+    TRACE_WRITE,            // A link write went to the BLE stack; arg = bytes
+    TRACE_NOTIFY,           // A notification arrived from the stack; arg = bytes
+    TRACE_PARSE,            // The parser task took it off the queue; arg = bytes
+    TRACE_FRAME,            // A whole frame passed its CRC; arg = command
+    TRACE_DECODED,          // Its values were published; arg = controller
+    TRACE_RENDER_START,     // A UI frame started drawing
+    TRACE_RENDER_END,       // ... and had pushed everything to the LCD
+    TRACE_EVENT_COUNT
+};
+
+struct __attribute__((packed)) TraceRecord {
+    uint32_t timeUs;
+    uint8_t event;          // TraceEvent
+    uint8_t link;
+    uint16_t arg;
+};
+
+struct __attribute__((packed)) TraceFileHeader {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t headerSize;    // sizeof(TraceFileHeader)
+    uint32_t recordCount;
+    uint32_t lostRecords;   // Written over before the save
+};
+
+// Allocate a ring of records (rounded down to a power of two) in PSRAM.
+// Returns false without the memory; tracing then stays off.
+bool traceBegin(size_t records);
+
+// Record an event. Any task (in IRAM, for the notify path), never blocks;
+// a few stores when tracing is on.
+void traceEvent(TraceEvent event, uint8_t link, uint16_t arg);
+
+// Save the ring as it is now, then carry on recording. Blocks the caller
+// for the write; UI task only.
+bool traceSave(const char* reason);
+
+// Saves so far
+uint32_t traceSaveCount();
+
+// Short name of an event ("request", "notify", ...)
+const char* traceEventName(uint8_t event);
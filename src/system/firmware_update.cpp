@@ -0,0 +1,357 @@
+#include "firmware_update.h"
+#include "coexist.h"
+#include "perf_stats.h"
+#include "task_layout.h"
+#include "wifi_station.h"
+#include "../log.h"
+#include "memory.h"
+
+#include <Arduino.h>
+#include <HTTPClient.h>
+#include <Preferences.h>
+#include <WiFi.h>
+#include <esp_app_format.h>
+#include <esp_ota_ops.h>
+#include <esp_system.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <string.h>
+
+static const char* NVS_NAMESPACE = "firmware";
+static const char* KEY_ETAG = "etag";         // Of the image last installed
+static const char* KEY_TRIAL = "trial";       // Address of the partition on trial
+static const char* KEY_BOOTS = "boots";       // Its boots so far
+static const size_t SECTOR_BYTES = 4096;      // One flash sector per write
+static const size_t ETAG_SIZE = 64;
+static const size_t DESCRIPTION_OFFSET = sizeof(esp_image_header_t) + sizeof(esp_image_segment_header_t);
+static const uint32_t JOIN_TIMEOUT_MS = 15000;
+static const uint16_t HTTP_TIMEOUT_MS = 10000;
+static const uint32_t STALL_TIMEOUT_MS = 10000;  // Longest wait for the next bytes of the image
+static const uint32_t TASK_STACK_SIZE = 8192;
+static const TaskPlacement& PLACEMENT = TASK_PLACEMENT[TASK_FIRMWARE];
+
+enum DownloadResult : uint8_t {
+    DOWNLOAD_FAILED,
+    DOWNLOAD_CURRENT,          // The image is the running build
+    DOWNLOAD_INSTALLED
+};
+
+static FirmwareUpdateSettings config;
+static uint8_t* sector = nullptr;
+static volatile bool allowed = false;
+static bool onTrial = false;
+
+static portMUX_TYPE statsMux = portMUX_INITIALIZER_UNLOCKED;
+static FirmwareUpdateStats stats;
+
+static void setProgress(FirmwareUpdateState state, uint32_t received, uint32_t total) {
+    portENTER_CRITICAL(&statsMux);
+    stats.state = state;
+    stats.received = received;
+    stats.total = total;
+    portEXIT_CRITICAL(&statsMux);
+}
+
+static void countFailure() {
+    portENTER_CRITICAL(&statsMux);
+    stats.failures++;
+    portEXIT_CRITICAL(&statsMux);
+}
+
+void firmwareUpdateBoot(uint8_t bootAttempts) {
+    Preferences prefs;
+    if (!prefs.begin(NVS_NAMESPACE, false)) return;
+    uint32_t trial = prefs.getUInt(KEY_TRIAL, 0);
+    if (trial == 0) {
+        prefs.end();
+        return;
+    }
+
+    const esp_partition_t* running = esp_ota_get_running_partition();
+    if (running->address != trial) {
+        // The bootloader found the new image invalid and kept the old one
+        LOG_W(APP, "Firmware: the new image did not start, still on %s", running->label);
+        prefs.remove(KEY_TRIAL);
+        prefs.remove(KEY_BOOTS);
+        prefs.end();
+        return;
+    }
+    onTrial = true;
+    if (esp_reset_reason() == ESP_RST_DEEPSLEEP) {
+        prefs.end();
+        return;
+    }
+
+    uint8_t boots = prefs.getUChar(KEY_BOOTS, 0) + 1;
+    if (boots <= bootAttempts) {
+        prefs.putUChar(KEY_BOOTS, boots);
+        prefs.end();
+        LOG_I(APP, "Firmware: %s on trial, boot %u of %u", running->label, boots, bootAttempts);
+        return;
+    }
+
+    // With two app partitions the next one is the previous image
+    const esp_partition_t* previous = esp_ota_get_next_update_partition(nullptr);
+    prefs.remove(KEY_TRIAL);
+    prefs.remove(KEY_BOOTS);
+    prefs.end();
+    onTrial = false;
+    LOG_E(APP, "Firmware: %s not confirmed in %u boots, going back to %s", running->label, bootAttempts,
+          previous ? previous->label : "?");
+    if (previous && esp_ota_set_boot_partition(previous) == ESP_OK) ESP.restart();
+    LOG_E(APP, "Firmware: the previous image is not valid, staying on %s", running->label);
+}
+
+bool firmwareUpdateOnTrial() {
+    return onTrial;
+}
+
+void firmwareUpdateConfirm() {
+    if (!onTrial) return;
+    onTrial = false;
+    Preferences prefs;
+    if (prefs.begin(NVS_NAMESPACE, false)) {
+        prefs.remove(KEY_TRIAL);
+        prefs.remove(KEY_BOOTS);
+        prefs.end();
+    }
+    // For a bootloader built with rollback, which holds the image as
+    // pending until told otherwise
+    esp_ota_mark_app_valid_cancel_rollback();
+    LOG_I(APP, "Firmware: %s confirmed", esp_ota_get_app_description()->version);
+}
+
+static void loadEtag(char* etag) {
+    etag[0] = '\0';
+    Preferences prefs;
+    if (!prefs.begin(NVS_NAMESPACE, true)) return;
+    if (prefs.isKey(KEY_ETAG)) prefs.getString(KEY_ETAG, etag, ETAG_SIZE);
+    prefs.end();
+}
+
+// The image installed, on trial from its first boot; or the running
+// build's ETag, so the server can answer 304 next time
+static void saveInstalled(const char* etag, const esp_partition_t* trial) {
+    Preferences prefs;
+    if (!prefs.begin(NVS_NAMESPACE, false)) return;
+    if (etag[0]) prefs.putString(KEY_ETAG, etag);
+    if (trial) {
+        prefs.putUInt(KEY_TRIAL, trial->address);
+        prefs.putUChar(KEY_BOOTS, 0);
+    }
+    prefs.end();
+}
+
+// Check the app description that follows the first segment header
+static DownloadResult checkImage(const uint8_t* head) {
+    const esp_app_desc_t* incoming = (const esp_app_desc_t*)(head + DESCRIPTION_OFFSET);
+    const esp_app_desc_t* running = esp_ota_get_app_description();
+    if (incoming->magic_word != ESP_APP_DESC_MAGIC_WORD) {
+        LOG_W(APP, "Firmware: not an app image");
+        return DOWNLOAD_FAILED;
+    }
+    if (strncmp(incoming->project_name, running->project_name, sizeof(incoming->project_name)) != 0) {
+        LOG_W(APP, "Firmware: image is %.32s, not %.32s", incoming->project_name, running->project_name);
+        return DOWNLOAD_FAILED;
+    }
+    if (memcmp(incoming->app_elf_sha256, running->app_elf_sha256, sizeof(running->app_elf_sha256)) == 0) {
+        return DOWNLOAD_CURRENT;
+    }
+    LOG_I(APP, "Firmware: downloading %.32s (running %.32s)", incoming->version, running->version);
+    return DOWNLOAD_INSTALLED;
+}
+
+static bool writeSector(esp_ota_handle_t handle, size_t length) {
+    // Erasing and writing a sector holds the flash cache off, so it goes
+    // in a gap between polls like an SD block
+    coexistAcquire(COEXIST_FLASH_WRITE);
+    esp_err_t err = esp_ota_write(handle, sector, length);
+    if (err != ESP_OK) LOG_W(APP, "Firmware: flash write failed (%s)", esp_err_to_name(err));
+    return err == ESP_OK;
+}
+
+// Stream the reply body into the idle partition a sector at a time
+static DownloadResult download(HTTPClient& http, const esp_partition_t* target) {
+    int size = http.getSize();          // -1 for a chunked reply
+    uint32_t total = size > 0 ? (uint32_t)size : 0;
+    if (total > target->size) {
+        LOG_W(APP, "Firmware: %u byte image does not fit %s", (unsigned)total, target->label);
+        return DOWNLOAD_FAILED;
+    }
+    if (total != 0 && total < DESCRIPTION_OFFSET + sizeof(esp_app_desc_t)) return DOWNLOAD_FAILED;
+
+    esp_ota_handle_t handle;
+    esp_err_t err = esp_ota_begin(target, OTA_WITH_SEQUENTIAL_WRITES, &handle);
+    if (err != ESP_OK) {
+        LOG_W(APP, "Firmware: could not start writing %s (%s)", target->label, esp_err_to_name(err));
+        return DOWNLOAD_FAILED;
+    }
+
+    WiFiClient* stream = http.getStreamPtr();
+    DownloadResult result = DOWNLOAD_INSTALLED;
+    bool checked = false;
+    bool ok = true;
+    uint32_t received = 0;
+    size_t filled = 0;
+    uint32_t lastDataMs = millis();
+    setProgress(FIRMWARE_DOWNLOADING, 0, total);
+    while (ok && (total == 0 || received < total)) {
+        if (!allowed) {
+            LOG_I(APP, "Firmware: download stopped at %u bytes", (unsigned)received);
+            ok = false;
+            break;
+        }
+        int available = stream->available();
+        if (available <= 0) {
+            if (!http.connected()) break;
+            if (millis() - lastDataMs >= STALL_TIMEOUT_MS) {
+                LOG_W(APP, "Firmware: download stalled at %u bytes", (unsigned)received);
+                ok = false;
+                break;
+            }
+            vTaskDelay(pdMS_TO_TICKS(5));
+            continue;
+        }
+        size_t want = SECTOR_BYTES - filled;
+        if ((size_t)available < want) want = available;
+        int got = stream->read(sector + filled, want);
+        if (got <= 0) continue;
+        lastDataMs = millis();
+        filled += got;
+        received += got;
+        setProgress(FIRMWARE_DOWNLOADING, received, total);
+
+        if (!checked && filled >= DESCRIPTION_OFFSET + sizeof(esp_app_desc_t)) {
+            checked = true;
+            result = checkImage(sector);
+            if (result != DOWNLOAD_INSTALLED) ok = false;
+        }
+        if (ok && filled == SECTOR_BYTES) {
+            ok = writeSector(handle, filled);
+            filled = 0;
+        }
+    }
+    // The tail of the image, or all of an image shorter than a sector
+    if (ok && filled > 0) ok = checked && writeSector(handle, filled);
+    if (ok && total != 0 && received != total) {
+        LOG_W(APP, "Firmware: got %u of %u bytes", (unsigned)received, (unsigned)total);
+        ok = false;
+    }
+    if (!ok) {
+        esp_ota_abort(handle);
+        return result == DOWNLOAD_CURRENT ? DOWNLOAD_CURRENT : DOWNLOAD_FAILED;
+    }
+
+    // Checks the segments and the image's SHA-256
+    err = esp_ota_end(handle);
+    if (err == ESP_OK) err = esp_ota_set_boot_partition(target);
+    if (err != ESP_OK) {
+        LOG_W(APP, "Firmware: image rejected (%s)", esp_err_to_name(err));
+        return DOWNLOAD_FAILED;
+    }
+    LOG_I(APP, "Firmware: %u bytes installed to %s, runs from the next restart", (unsigned)received, target->label);
+    return DOWNLOAD_INSTALLED;
+}
+
+static void checkForUpdate() {
+    static const char* HEADER_KEYS[] = { "ETag" };
+    char etag[ETAG_SIZE];
+    loadEtag(etag);
+
+    portENTER_CRITICAL(&statsMux);
+    stats.checks++;
+    portEXIT_CRITICAL(&statsMux);
+
+    coexistAcquire(COEXIST_WIFI);
+    HTTPClient http;
+    http.setTimeout(HTTP_TIMEOUT_MS);
+    if (!http.begin(config.url)) {
+        LOG_W(APP, "Firmware: bad URL %s", config.url);
+        countFailure();
+        return;
+    }
+    http.collectHeaders(HEADER_KEYS, 1);
+    if (etag[0]) http.addHeader("If-None-Match", etag);
+    http.addHeader("X-Firmware-Version", esp_ota_get_app_description()->version);
+    int code = http.GET();
+
+    if (code == 304) {
+        LOG_D(APP, "Firmware: up to date");
+    } else if (code == 200) {
+        const esp_partition_t* target = esp_ota_get_next_update_partition(nullptr);
+        String served = http.header("ETag");
+        DownloadResult result = target ? download(http, target) : DOWNLOAD_FAILED;
+        if (result == DOWNLOAD_FAILED) countFailure();
+        if (result != DOWNLOAD_FAILED) {
+            saveInstalled(served.c_str(), result == DOWNLOAD_INSTALLED ? target : nullptr);
+        }
+        setProgress(result == DOWNLOAD_INSTALLED ? FIRMWARE_READY : FIRMWARE_IDLE, 0, 0);
+    } else {
+        LOG_W(APP, "Firmware: %s failed (%d)", config.url, code);
+        countFailure();
+    }
+    http.end();
+}
+
+static void updateTaskMain(void* param) {
+    bool wanted = false;
+    bool checkedOnce = false;
+    uint32_t lastCheckMs = 0;
+    for (;;) {
+        bool due = !checkedOnce || millis() - lastCheckMs >= config.checkMs;
+        if (!allowed || !due || firmwareUpdateReady()) {
+            if (wanted) {
+                wanted = false;
+                wifiStationRelease(WIFI_USER_FIRMWARE);
+            }
+            vTaskDelay(pdMS_TO_TICKS(1000));
+            continue;
+        }
+        if (!wanted) {
+            wanted = true;
+            wifiStationWant(WIFI_USER_FIRMWARE, config.ssid, config.password);
+        }
+        // No network counts as a check, so the station is let go until the next
+        if (wifiStationWait(JOIN_TIMEOUT_MS, allowed)) checkForUpdate();
+        checkedOnce = true;
+        lastCheckMs = millis();
+    }
+}
+
+bool firmwareUpdateBegin(const FirmwareUpdateSettings& settings) {
+    if (sector) return true;
+
+    sector = (uint8_t*)memoryAlloc(SECTOR_BYTES, MEMORY_INTERNAL, MEMORY_TAG_SYSTEM);
+    if (!sector) {
+        LOG_E(APP, "No memory for the firmware update buffer");
+        return false;
+    }
+    config = settings;
+    memset(&stats, 0, sizeof(stats));
+
+    TaskHandle_t task = nullptr;
+    xTaskCreatePinnedToCore(updateTaskMain, PLACEMENT.name, TASK_STACK_SIZE, nullptr,
+                            PLACEMENT.priority, &task, PLACEMENT.core);
+    perfWatchTask(task, MEMORY_TAG_SYSTEM);
+    LOG_I(APP, "Firmware updates from %s via %s", settings.url, settings.ssid);
+    return true;
+}
+
+void firmwareUpdateAllow(bool allow) {
+    allowed = allow;
+}
+
+bool firmwareUpdateReady() {
+    portENTER_CRITICAL(&statsMux);
+    bool ready = stats.state == FIRMWARE_READY;
+    portEXIT_CRITICAL(&statsMux);
+    return ready;
+}
+
+FirmwareUpdateStats firmwareUpdateStats() {
+    FirmwareUpdateStats out;
+    portENTER_CRITICAL(&statsMux);
+    out = stats;
+    portEXIT_CRITICAL(&statsMux);
+    return out;
+}
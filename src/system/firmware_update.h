@@ -0,0 +1,72 @@
+#pragma once
+
+#include <stdint.h>
+
+// Firmware updates over WiFi into the idle one of the two app partitions
+// (partitions.csv).
+//
+// While allowed, a low-priority task on the radio core asks the URL for
+// the image every checkMs over the shared station (wifi_station.h),
+// sending the ETag of the image it last installed in If-None-Match; a 304
+// means there is nothing new. A 200 is written to the idle partition as it
+// arrives, one flash sector at a time with the writes placed in gaps of
+// the poll schedule, and the partition is erased sector by sector ahead of
+// them rather than all at once, so nothing the size of the image is held
+// in RAM and no long erase holds up the BLE link. The image is refused on
+// its first sector if it is another project's, or if it is the build that
+// is already running. A complete image is verified and made the boot
+// partition; it runs from the next restart, which the UI loop picks the
+// moment for.
+//
+// The Arduino core's bootloader does not roll back by itself, so a new
+// image starts on trial: each of its boots counts in NVS, and
+// firmwareUpdateConfirm() ends the trial. One that boots bootAttempts
+// times without being confirmed (crashing, or hanging until the task
+// watchdog resets it) switches back to the previous partition. Its ETag
+// stays stored, so the same image is not fetched again.
+
+struct FirmwareUpdateSettings {
+    const char* ssid;
+    const char* password;
+    const char* url;           // The image, e.g. http://depot/vescdash.bin
+    uint32_t checkMs;          // Ask for a new image this often while allowed
+};
+
+enum FirmwareUpdateState : uint8_t {
+    FIRMWARE_IDLE,
+    FIRMWARE_DOWNLOADING,
+    FIRMWARE_READY             // Installed; runs from the next restart
+};
+
+struct FirmwareUpdateStats {
+    FirmwareUpdateState state;
+    uint32_t received;         // Bytes of the image being downloaded
+    uint32_t total;            // Its size, 0 if the server did not say
+    uint32_t checks;           // Requests since boot
+    uint32_t failures;         // Requests or downloads that failed
+};
+
+// Call first in setup(). Counts this boot of an image on trial, and if it
+// is out of attempts, switches back to the previous image and restarts.
+// Deep-sleep wake-ups do not count.
+void firmwareUpdateBoot(uint8_t bootAttempts);
+
+// The running image is on trial
+bool firmwareUpdateOnTrial();
+
+// The running image works: end its trial
+void firmwareUpdateConfirm();
+
+// Allocate the sector buffer and start the update task. Returns false
+// without the memory; updating then stays off.
+bool firmwareUpdateBegin(const FirmwareUpdateSettings& settings);
+
+// Let the task use WiFi, e.g. only while no ride is in progress. A
+// download stops when disallowed and starts over at the next check. Off
+// until first allowed.
+void firmwareUpdateAllow(bool allowed);
+
+// A new image is installed and waits for a restart
+bool firmwareUpdateReady();
+
+FirmwareUpdateStats firmwareUpdateStats();
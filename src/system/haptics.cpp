@@ -0,0 +1,80 @@
+#include "haptics.h"
+#include "i2c_bus.h"
+#include "../log.h"
+
+#include <M5Core2.h>
+#include <esp_timer.h>
+
+static const uint8_t VIBRATION_LDO = 3;     // The Core2's vibration motor
+static const uint8_t MAX_STEPS = 8;
+
+// Steps alternate on and off, starting on; 0 ends the pattern
+static const uint8_t PATTERNS[HAPTIC_COUNT][MAX_STEPS] = {
+    { 4, 0 },
+    { 2, 2, 2, 2, 2, 0 },
+};
+
+static portMUX_TYPE hapticsMux = portMUX_INITIALIZER_UNLOCKED;
+static esp_timer_handle_t stepTimer = nullptr;
+static uint32_t quarterUs = 75000;
+static uint8_t pattern = HAPTIC_PULSE;      // Under hapticsMux, with step
+static uint8_t step = MAX_STEPS;            // Next step to play, MAX_STEPS when idle
+static bool motorOn = false;                // Owned by the timer callback
+
+// On the bus task; context is whether the motor runs
+static void setMotor(void* context) {
+    M5.Axp.SetLDOEnable(VIBRATION_LDO, context != nullptr);
+}
+
+// Switch the motor for the next step and arm the timer for its end
+static void playStep(void* arg) {
+    uint8_t length = 0;
+    bool on = false;
+    portENTER_CRITICAL(&hapticsMux);
+    if (step < MAX_STEPS) {
+        length = PATTERNS[pattern][step];
+        on = (step & 1) == 0;
+        step = length ? step + 1 : MAX_STEPS;
+    }
+    portEXIT_CRITICAL(&hapticsMux);
+
+    if (length == 0) on = false;
+    // A switch the bus had no room for is tried again at the next step
+    bool switched = on == motorOn || i2cBusPost(I2C_PRIORITY_CONTROL, setMotor, on ? (void*)1 : nullptr);
+    if (switched) motorOn = on;
+    if (length) {
+        esp_timer_start_once(stepTimer, length * quarterUs);
+    } else if (!switched) {
+        esp_timer_start_once(stepTimer, quarterUs);    // The motor still has to go off
+    }
+}
+
+void hapticsBegin(uint16_t pulseMs) {
+    if (stepTimer) return;
+    quarterUs = pulseMs * 1000u / 4;
+    esp_timer_create_args_t args;
+    args.callback = playStep;
+    args.arg = nullptr;
+    args.dispatch_method = ESP_TIMER_TASK;
+    args.name = "haptics";
+    args.skip_unhandled_events = true;
+    if (esp_timer_create(&args, &stepTimer) != ESP_OK) {
+        LOG_E(APP, "Could not create the haptics timer");
+        stepTimer = nullptr;
+    }
+}
+
+void hapticsPlay(HapticPattern next) {
+    if (!stepTimer || next >= HAPTIC_COUNT) return;
+    portENTER_CRITICAL(&hapticsMux);
+    pattern = next;
+    step = 0;
+    portEXIT_CRITICAL(&hapticsMux);
+    // A step still timed restarts from the new pattern's first
+    esp_timer_stop(stepTimer);
+    esp_timer_start_once(stepTimer, 0);
+}
+
+bool hapticsPlaying() {
+    return step < MAX_STEPS || motorOn;
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <stdint.h>
+
+// Vibration patterns
+enum HapticPattern : uint8_t {
+    HAPTIC_PULSE,            // One pulse
+    HAPTIC_TRIPLE,           // Three short pulses, for faults
+    HAPTIC_COUNT
+};
+
+// Patterns on the Core2's vibration motor, which hangs off one of the
+// AXP192's LDOs.
+//
+// A pattern is a short table of on and off times in quarters of the
+// pulse length. An esp_timer steps through it: each callback switches
+// the LDO and arms the timer for the next step, so nothing ever sleeps
+// through a pulse and no task waits on the motor. Switching the LDO is
+// one I2C write, posted to the I2C bus task ahead of its slow readings
+// (see i2c_bus.h). hapticsPlay() only starts the timer.
+
+// Create the timer; pulseMs is the length of HAPTIC_PULSE. Call once
+// from setup(), after M5.begin().
+void hapticsBegin(uint16_t pulseMs);
+
+// Start a pattern, cutting short one still playing. Safe from any task;
+// never blocks.
+void hapticsPlay(HapticPattern pattern);
+
+bool hapticsPlaying();
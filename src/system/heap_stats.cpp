@@ -0,0 +1,127 @@
+#include "heap_stats.h"
+#include "memory.h"
+#include "../log.h"
+
+#include <Arduino.h>
+#include <esp_heap_caps.h>
+
+HeapStats heapStatsRead() {
+    HeapStats stats;
+    stats.freeBytes = heap_caps_get_free_size(MALLOC_CAP_INTERNAL);
+    stats.minFreeBytes = heap_caps_get_minimum_free_size(MALLOC_CAP_INTERNAL);
+    stats.largestBlock = heap_caps_get_largest_free_block(MALLOC_CAP_INTERNAL);
+    return stats;
+}
+
+void heapStatsLog(const char* tag) {
+    HeapStats stats = heapStatsRead();
+    LOG_I(APP, "Heap [%s]: free %u, min free %u, largest block %u",
+          tag, stats.freeBytes, stats.minFreeBytes, stats.largestBlock);
+}
+
+// Section bounds from the linker script
+extern "C" {
+extern uint8_t _data_start, _data_end, _bss_start, _bss_end;
+}
+
+void heapMemoryReport() {
+    LOG_I(APP, "Static RAM: data %u, bss %u", (unsigned)(&_data_end - &_data_start),
+          (unsigned)(&_bss_end - &_bss_start));
+    LOG_I(APP, "Internal heap: %u of %u free, largest block %u",
+          heap_caps_get_free_size(MALLOC_CAP_INTERNAL), heap_caps_get_total_size(MALLOC_CAP_INTERNAL),
+          heap_caps_get_largest_free_block(MALLOC_CAP_INTERNAL));
+    LOG_I(APP, "PSRAM: %u of %u free, largest block %u",
+          heap_caps_get_free_size(MALLOC_CAP_SPIRAM), heap_caps_get_total_size(MALLOC_CAP_SPIRAM),
+          heap_caps_get_largest_free_block(MALLOC_CAP_SPIRAM));
+    MemoryStats memory = memoryStats();
+    LOG_I(APP, "Buffers: %u in PSRAM, %u internal, %u moved to internal, %u refused", memory.psramBytes,
+          memory.internalBytes, memory.fallbacks, memory.failures);
+
+    // Held now and at most, by subsystem
+    MemoryTagStats tags[MEMORY_TAG_COUNT];
+    memoryTagStats(tags);
+    char line[192];
+    int n = snprintf(line, sizeof(line), "%s:", memoryHeapTraced() ? "Buffers and heap" : "Buffers");
+    for (uint8_t t = 0; t < MEMORY_TAG_COUNT && n > 0 && (size_t)n < sizeof(line); t++) {
+        n += snprintf(line + n, sizeof(line) - n, " %s %u/%u", memoryTagName((MemoryTag)t),
+                      (unsigned)(tags[t].bufferBytes + tags[t].heapBytes), (unsigned)tags[t].peakBytes);
+    }
+    LOG_I(APP, "%s", line);
+    if (memoryHeapUntracked()) LOG_W(APP, "%u heap blocks not charged, table full", (unsigned)memoryHeapUntracked());
+}
+
+static TaskHandle_t trackedTask = nullptr;
+static volatile uint32_t allocCount = 0;
+static volatile uint32_t steadyCount = 0;
+static volatile bool steadyState = false;
+
+void heapAllocTrackTask(TaskHandle_t task) {
+    trackedTask = task;
+    allocCount = 0;
+}
+
+uint32_t heapAllocCount() {
+    return allocCount;
+}
+
+void heapAllocSetSteady(bool steady) {
+    steadyState = steady;
+}
+
+uint32_t heapAllocSteadyCount() {
+    return steadyCount;
+}
+
+#ifdef HEAP_ALLOC_TRACE
+// Linked in place of the allocator with -Wl,--wrap=malloc etc. Counting
+// is a handle compare and an increment, and charging a block to its tag
+// (memory.h) a short probe of a hash table, so it is cheap enough to
+// leave on for a soak run. Blocks newlib frees internally through
+// _free_r stay charged.
+extern "C" {
+void* __real_malloc(size_t size);
+void* __real_calloc(size_t count, size_t size);
+void* __real_realloc(void* ptr, size_t size);
+void __real_free(void* ptr);
+
+static inline void countAlloc() {
+    if (trackedTask != nullptr && xTaskGetCurrentTaskHandle() == trackedTask) {
+        allocCount = allocCount + 1;
+        if (steadyState) {
+            steadyCount = steadyCount + 1;
+#ifdef HEAP_ALLOC_STRICT
+            abort();
+#endif
+        }
+    }
+}
+
+void* __wrap_malloc(size_t size) {
+    countAlloc();
+    void* block = __real_malloc(size);
+    memoryTraceAlloc(block);
+    return block;
+}
+
+void* __wrap_calloc(size_t count, size_t size) {
+    countAlloc();
+    void* block = __real_calloc(count, size);
+    memoryTraceAlloc(block);
+    return block;
+}
+
+void* __wrap_realloc(void* ptr, size_t size) {
+    countAlloc();
+    memoryTraceFree(ptr);
+    void* block = __real_realloc(ptr, size);
+    // A failed realloc leaves the old block where it was
+    memoryTraceAlloc(block != nullptr || size == 0 ? block : ptr);
+    return block;
+}
+
+void __wrap_free(void* ptr) {
+    memoryTraceFree(ptr);
+    __real_free(ptr);
+}
+}
+#endif
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <stdint.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+// Snapshot of the internal heap, for spotting leaks and fragmentation
+// over long runs
+struct HeapStats {
+    uint32_t freeBytes;
+    uint32_t minFreeBytes;     // Low-water mark since boot
+    uint32_t largestBlock;     // Largest single allocation that would succeed
+};
+
+HeapStats heapStatsRead();
+
+// Log the current snapshot with a short tag ("reconnect", "periodic", ...)
+void heapStatsLog(const char* tag);
+
+// Log what the firmware holds for good: static data and bss, and the
+// internal and PSRAM heaps once setup() has made its buffers. Everything
+// the dashboard needs is allocated by then, so these figures are its
+// whole footprint.
+void heapMemoryReport();
+
+// Count heap allocations (malloc, calloc, realloc and anything built on
+// them such as new and String) made by one task. Only active in builds
+// with -DHEAP_ALLOC_TRACE, which route the allocator through counting
+// wrappers at link time (see the alloc-trace env in platformio.ini);
+// otherwise the count stays 0.
+void heapAllocTrackTask(TaskHandle_t task);
+uint32_t heapAllocCount();
+
+// Mark whether the tracked task is in steady state, where it should not
+// allocate at all. Its allocations while it is are also counted apart,
+// and builds with -DHEAP_ALLOC_STRICT abort on the first one, so the
+// backtrace shows where it came from.
+void heapAllocSetSteady(bool steady);
+uint32_t heapAllocSteadyCount();
@@ -0,0 +1,109 @@
+#include "i2c_bus.h"
+#include "perf_stats.h"
+#include "task_layout.h"
+#include "../log.h"
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
+
+static const uint32_t TASK_STACK_SIZE = 4096;   // Jobs run on it: the touch read goes through the gesture code
+static const TaskPlacement& PLACEMENT = TASK_PLACEMENT[TASK_I2C_BUS];
+
+struct I2cRequest {
+    I2cJob job;
+    void* context;
+    SemaphoreHandle_t done;      // Given once the job has run; nullptr for a post
+    uint32_t queuedUs;
+};
+
+static TaskHandle_t task = nullptr;
+static QueueHandle_t queues[I2C_PRIORITY_COUNT] = {};
+static portMUX_TYPE statsMux = portMUX_INITIALIZER_UNLOCKED;
+static I2cBusStats stats = {};
+
+// The most urgent waiting job, if any
+static bool nextRequest(I2cRequest& request, uint8_t& priority) {
+    for (priority = 0; priority < I2C_PRIORITY_COUNT; priority++) {
+        if (xQueueReceive(queues[priority], &request, 0) == pdTRUE) return true;
+    }
+    return false;
+}
+
+static void busTask(void* param) {
+    for (;;) {
+        I2cRequest request;
+        uint8_t priority;
+        if (!nextRequest(request, priority)) {
+            // Each queued job gives a notification, so none is missed
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+            continue;
+        }
+        taskBudgetStart(TASK_I2C_BUS);
+        uint32_t startedUs = micros();
+        request.job(request.context);
+        uint32_t tookUs = micros() - startedUs;
+        taskBudgetEnd(TASK_I2C_BUS);
+        if (request.done) xSemaphoreGive(request.done);
+
+        uint32_t waitedUs = startedUs - request.queuedUs;
+        portENTER_CRITICAL(&statsMux);
+        stats.jobs[priority]++;
+        if (waitedUs > stats.waitMaxUs[priority]) stats.waitMaxUs[priority] = waitedUs;
+        if (tookUs > stats.jobMaxUs) stats.jobMaxUs = tookUs;
+        portEXIT_CRITICAL(&statsMux);
+    }
+}
+
+void i2cBusBegin(uint8_t queueLength) {
+    if (task) return;
+    if (queueLength == 0) queueLength = 1;
+    for (uint8_t p = 0; p < I2C_PRIORITY_COUNT; p++) queues[p] = xQueueCreate(queueLength, sizeof(I2cRequest));
+    xTaskCreatePinnedToCore(busTask, PLACEMENT.name, TASK_STACK_SIZE, nullptr, PLACEMENT.priority, &task,
+                            PLACEMENT.core);
+    perfWatchTask(task, MEMORY_TAG_SYSTEM);
+}
+
+static bool enqueue(I2cPriority priority, I2cJob job, void* context, SemaphoreHandle_t done, TickType_t wait) {
+    I2cRequest request = { job, context, done, (uint32_t)micros() };
+    if (xQueueSend(queues[priority], &request, wait) != pdTRUE) return false;
+    xTaskNotifyGive(task);
+    return true;
+}
+
+bool i2cBusPost(I2cPriority priority, I2cJob job, void* context) {
+    if (priority >= I2C_PRIORITY_COUNT) return false;
+    if (!task) {
+        job(context);
+        return true;
+    }
+    if (enqueue(priority, job, context, nullptr, 0)) return true;
+    portENTER_CRITICAL(&statsMux);
+    stats.dropped++;
+    portEXIT_CRITICAL(&statsMux);
+    return false;
+}
+
+void i2cBusRun(I2cPriority priority, I2cJob job, void* context) {
+    if (!task) {
+        job(context);
+        return;
+    }
+    if (priority >= I2C_PRIORITY_COUNT) priority = I2C_PRIORITY_SLOW;
+    StaticSemaphore_t storage;
+    SemaphoreHandle_t done = xSemaphoreCreateBinaryStatic(&storage);
+    // A full queue only holds this task back, so wait for room
+    enqueue(priority, job, context, done, portMAX_DELAY);
+    xSemaphoreTake(done, portMAX_DELAY);
+    vSemaphoreDelete(done);
+}
+
+I2cBusStats i2cBusStats() {
+    I2cBusStats out;
+    portENTER_CRITICAL(&statsMux);
+    out = stats;
+    portEXIT_CRITICAL(&statsMux);
+    return out;
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <stdint.h>
+
+// Runs every transaction on the internal I2C bus (Wire1: the FT6336
+// touch panel, the AXP192 PMIC, the BM8563 RTC and the MPU6886) on one
+// task, most urgent first, so nothing on the render path waits on it.
+//
+// A user hands the bus a job: a function that does one batch of its
+// transactions back to back (a touch read, a FIFO drain, a PMIC sample)
+// and keeps the bus for all of them. The Wire driver's lock only keeps
+// single transactions apart, so left to it a touch read can queue
+// behind every register of a PMIC sample and the RTC write after it.
+// Here jobs wait in one queue per priority and the task always takes
+// the highest waiting one next: a touch read waits for at most the one
+// job already on the bus, however much slow work is queued.
+//
+// i2cBusPost() queues a job and returns at once; the UI loop and the
+// timer callbacks use it and pick any result up later. i2cBusRun() waits
+// for the job, for background tasks that need its result to go on.
+//
+// Before i2cBusBegin() a job runs at once on the caller, so setup() can
+// use the bus before the task is up.
+
+enum I2cPriority : uint8_t {
+    I2C_PRIORITY_TOUCH,          // The panel and its buttons
+    I2C_PRIORITY_IMU,            // FIFO drains and motion samples
+    I2C_PRIORITY_CONTROL,        // Backlight, rails, motor, speaker
+    I2C_PRIORITY_SLOW,           // PMIC readings and the RTC
+    I2C_PRIORITY_COUNT
+};
+
+typedef void (*I2cJob)(void* context);
+
+struct I2cBusStats {
+    uint32_t jobs[I2C_PRIORITY_COUNT];   // Run, by priority
+    uint32_t dropped;                    // Posted to a full queue
+    uint32_t waitMaxUs[I2C_PRIORITY_COUNT];   // Longest from queued to started
+    uint32_t jobMaxUs;                   // Longest a job held the bus
+};
+
+// Start the bus task, with room for queueLength jobs per priority
+void i2cBusBegin(uint8_t queueLength);
+
+// Queue a job. Safe from any task; returns false, and drops the job, if
+// its priority's queue is full.
+bool i2cBusPost(I2cPriority priority, I2cJob job, void* context);
+
+// Queue a job and wait until it has run. Not from the bus task itself.
+void i2cBusRun(I2cPriority priority, I2cJob job, void* context);
+
+I2cBusStats i2cBusStats();
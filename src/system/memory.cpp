@@ -0,0 +1,275 @@
+#include "memory.h"
+#include "../log.h"
+
+#include <Arduino.h>
+#include <esp_heap_caps.h>
+#include <soc/soc_memory_layout.h>
+#include <string.h>
+
+static const char* TAG_NAMES[MEMORY_TAG_COUNT] = { "system", "ble", "protocol", "ui", "logger", "telemetry" };
+static const int MAX_BUFFERS = 64;      // memoryAlloc() buffers held at once that are charged to a tag
+static const int MAX_TASKS = 24;
+
+struct HeldBuffer {
+    void* buffer;
+    MemoryTag tag;
+};
+
+struct TaskTag {
+    TaskHandle_t task;
+    MemoryTag tag;
+};
+
+static size_t reserve = 0;
+static MemoryStats stats = {};
+static MemoryTagStats tagStats[MEMORY_TAG_COUNT] = {};
+static HeldBuffer held[MAX_BUFFERS] = {};
+static TaskTag taskTags[MAX_TASKS] = {};
+static uint8_t taskTagCount = 0;
+static portMUX_TYPE statsLock = portMUX_INITIALIZER_UNLOCKED;
+
+#ifdef HEAP_ALLOC_TRACE
+// Every heap block held, by address: open addressing with linear probing,
+// kept at most three quarters full. Size and tag share a word.
+static const uint32_t TRACE_BITS = 13;
+static const uint32_t TRACE_SLOTS = 1u << TRACE_BITS;   // 64 KB of PSRAM
+static const uint32_t TRACE_LIMIT = TRACE_SLOTS / 4 * 3;
+
+struct TracedBlock {
+    uintptr_t block;
+    uint32_t sizeAndTag;        // Size << 8 | tag
+};
+
+static TracedBlock* traced = nullptr;
+static uint32_t tracedCount = 0;
+#endif
+static uint32_t untracked = 0;
+
+void memoryBegin(size_t psramAbove, size_t internalReserve) {
+    reserve = internalReserve;
+    if (heap_caps_get_total_size(MALLOC_CAP_SPIRAM) == 0) {
+        LOG_W(APP, "No PSRAM; bulk buffers share internal RAM down to %u bytes free", (unsigned)reserve);
+    } else {
+        heap_caps_malloc_extmem_enable(psramAbove);
+    }
+#ifdef HEAP_ALLOC_TRACE
+    // Blocks from before this are never charged, nor is their free
+    traced = (TracedBlock*)heap_caps_calloc(TRACE_SLOTS, sizeof(TracedBlock), MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (traced == nullptr) LOG_W(APP, "No PSRAM for the allocation table; heap not charged to tags");
+#endif
+}
+
+// Called with statsLock held
+static void charge(MemoryTag tag, int32_t bytes, bool heap) {
+    MemoryTagStats& t = tagStats[tag];
+    if (heap) {
+        t.heapBytes += bytes;
+    } else {
+        t.bufferBytes += bytes;
+    }
+    uint32_t total = t.heapBytes + t.bufferBytes;
+    if (total > t.peakBytes) t.peakBytes = total;
+}
+
+// The BLE stack's tasks, which are not ours to tag
+static MemoryTag tagByName(TaskHandle_t task) {
+    const char* name = pcTaskGetTaskName(task);
+    if (name == nullptr) return MEMORY_TAG_SYSTEM;
+    if (strncmp(name, "BTC", 3) == 0 || strncmp(name, "BTU", 3) == 0 || strncmp(name, "btController", 12) == 0 ||
+        strncmp(name, "hciT", 4) == 0) {
+        return MEMORY_TAG_BLE;
+    }
+    return MEMORY_TAG_SYSTEM;
+}
+
+// Called with statsLock held. A task seen for the first time is kept
+// with the tag its name gives, while there is room.
+static TaskTag* findTask(TaskHandle_t task) {
+    for (uint8_t i = 0; i < taskTagCount; i++) {
+        if (taskTags[i].task == task) return &taskTags[i];
+    }
+    if (taskTagCount >= MAX_TASKS) return nullptr;
+    TaskTag& added = taskTags[taskTagCount++];
+    added.task = task;
+    added.tag = tagByName(task);
+    return &added;
+}
+
+void memoryTagTask(TaskHandle_t task, MemoryTag tag) {
+    if (task == nullptr || tag >= MEMORY_TAG_COUNT) return;
+    portENTER_CRITICAL(&statsLock);
+    TaskTag* entry = findTask(task);
+    if (entry) entry->tag = tag;
+    portEXIT_CRITICAL(&statsLock);
+}
+
+MemoryTag memoryTagEnter(MemoryTag tag) {
+    TaskHandle_t task = xTaskGetCurrentTaskHandle();
+    portENTER_CRITICAL(&statsLock);
+    TaskTag* entry = findTask(task);
+    MemoryTag previous = entry ? entry->tag : MEMORY_TAG_SYSTEM;
+    if (entry) entry->tag = tag;
+    portEXIT_CRITICAL(&statsLock);
+    return previous;
+}
+
+void memoryTagLeave(MemoryTag previous) {
+    memoryTagTask(xTaskGetCurrentTaskHandle(), previous);
+}
+
+static void* allocInternal(size_t bytes, uint32_t caps, bool keepReserve) {
+    if (keepReserve && heap_caps_get_free_size(MALLOC_CAP_INTERNAL) < bytes + reserve) return nullptr;
+    return heap_caps_malloc(bytes, caps | MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+}
+
+void* memoryAlloc(size_t bytes, MemoryPlace place, MemoryTag tag) {
+    void* buffer = nullptr;
+    bool fellBack = false;
+    switch (place) {
+        case MEMORY_BULK:
+            buffer = heap_caps_malloc(bytes, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+            if (buffer == nullptr) {
+                buffer = allocInternal(bytes, 0, true);
+                fellBack = buffer != nullptr;
+            }
+            break;
+        case MEMORY_INTERNAL:
+            buffer = allocInternal(bytes, 0, false);
+            break;
+        case MEMORY_DMA:
+            buffer = allocInternal(bytes, MALLOC_CAP_DMA, false);
+            break;
+    }
+
+    portENTER_CRITICAL(&statsLock);
+    if (buffer == nullptr) {
+        stats.failures++;
+    } else {
+        size_t bytesHeld = heap_caps_get_allocated_size(buffer);
+        if (esp_ptr_external_ram(buffer)) {
+            stats.psramBytes += bytesHeld;
+        } else {
+            stats.internalBytes += bytesHeld;
+            if (fellBack) stats.fallbacks++;
+        }
+        for (int i = 0; i < MAX_BUFFERS; i++) {
+            if (held[i].buffer == nullptr) {
+                held[i].buffer = buffer;
+                held[i].tag = tag;
+                charge(tag, bytesHeld, false);
+                break;
+            }
+        }
+    }
+    portEXIT_CRITICAL(&statsLock);
+
+    if (buffer == nullptr) {
+        LOG_E(APP, "No memory for %u bytes (%s)", (unsigned)bytes,
+              place == MEMORY_BULK ? "bulk" : place == MEMORY_DMA ? "DMA" : "internal");
+    } else if (fellBack) {
+        LOG_W(APP, "PSRAM full, %u bytes put in internal RAM", (unsigned)bytes);
+    }
+    return buffer;
+}
+
+void memoryFree(void* buffer) {
+    if (buffer == nullptr) return;
+    size_t bytes = heap_caps_get_allocated_size(buffer);
+    bool external = esp_ptr_external_ram(buffer);
+    heap_caps_free(buffer);
+    portENTER_CRITICAL(&statsLock);
+    if (external) {
+        stats.psramBytes -= bytes;
+    } else {
+        stats.internalBytes -= bytes;
+    }
+    for (int i = 0; i < MAX_BUFFERS; i++) {
+        if (held[i].buffer == buffer) {
+            held[i].buffer = nullptr;
+            charge(held[i].tag, -(int32_t)bytes, false);
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&statsLock);
+}
+
+MemoryStats memoryStats() {
+    portENTER_CRITICAL(&statsLock);
+    MemoryStats copy = stats;
+    portEXIT_CRITICAL(&statsLock);
+    return copy;
+}
+
+void memoryTagStats(MemoryTagStats out[MEMORY_TAG_COUNT]) {
+    portENTER_CRITICAL(&statsLock);
+    memcpy(out, tagStats, sizeof(tagStats));
+    portEXIT_CRITICAL(&statsLock);
+}
+
+const char* memoryTagName(MemoryTag tag) {
+    return tag < MEMORY_TAG_COUNT ? TAG_NAMES[tag] : "?";
+}
+
+uint32_t memoryHeapUntracked() {
+    return untracked;
+}
+
+#ifdef HEAP_ALLOC_TRACE
+bool memoryHeapTraced() {
+    return traced != nullptr;
+}
+
+static inline uint32_t traceSlot(uintptr_t block) {
+    return (uint32_t)((block >> 2) * 2654435761u) >> (32 - TRACE_BITS);
+}
+
+void memoryTraceAlloc(void* block) {
+    if (traced == nullptr || block == nullptr) return;
+    uint32_t size = heap_caps_get_allocated_size(block);
+    TaskHandle_t task = xTaskGetCurrentTaskHandle();
+    portENTER_CRITICAL(&statsLock);
+    TaskTag* entry = findTask(task);
+    MemoryTag tag = entry ? entry->tag : MEMORY_TAG_SYSTEM;
+    if (tracedCount >= TRACE_LIMIT) {
+        untracked++;
+    } else {
+        uint32_t i = traceSlot((uintptr_t)block);
+        while (traced[i].block != 0 && traced[i].block != (uintptr_t)block) i = (i + 1) & (TRACE_SLOTS - 1);
+        if (traced[i].block == 0) tracedCount++;
+        traced[i].block = (uintptr_t)block;
+        traced[i].sizeAndTag = size << 8 | tag;
+        charge(tag, size, true);
+    }
+    portEXIT_CRITICAL(&statsLock);
+}
+
+void memoryTraceFree(void* block) {
+    if (traced == nullptr || block == nullptr) return;
+    portENTER_CRITICAL(&statsLock);
+    uint32_t i = traceSlot((uintptr_t)block);
+    while (traced[i].block != 0 && traced[i].block != (uintptr_t)block) i = (i + 1) & (TRACE_SLOTS - 1);
+    if (traced[i].block != 0) {
+        charge((MemoryTag)(traced[i].sizeAndTag & 0xFF), -(int32_t)(traced[i].sizeAndTag >> 8), true);
+        tracedCount--;
+        // Close the gap: pull back any later block of the run that would
+        // no longer be found past it
+        uint32_t hole = i;
+        for (uint32_t j = (i + 1) & (TRACE_SLOTS - 1); traced[j].block != 0; j = (j + 1) & (TRACE_SLOTS - 1)) {
+            uint32_t home = traceSlot(traced[j].block);
+            if (((j - home) & (TRACE_SLOTS - 1)) >= ((j - hole) & (TRACE_SLOTS - 1))) {
+                traced[hole] = traced[j];
+                hole = j;
+            }
+        }
+        traced[hole].block = 0;
+    }
+    portEXIT_CRITICAL(&statsLock);
+}
+#else
+bool memoryHeapTraced() {
+    return false;
+}
+
+void memoryTraceAlloc(void* block) {}
+void memoryTraceFree(void* block) {}
+#endif
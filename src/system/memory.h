@@ -0,0 +1,86 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+// Where the firmware's buffers go. The ESP32's internal RAM is the only
+// memory DMA, ISRs and code running with the flash cache off can touch,
+// and the BLE and WiFi stacks allocate from it while running, so bulk
+// data (history, scrollback, log blocks, upload chunks) goes to PSRAM and
+// internal RAM is kept for what needs it.
+//
+// memoryBegin() also sends plain mallocs of psramAbove bytes or more
+// (String, std::vector, the sprites of libraries) to PSRAM, the way
+// CONFIG_SPIRAM_USE_MALLOC does with a fixed limit. A bulk buffer falls
+// back to internal RAM only while internalReserve bytes would still be
+// free after it, so a board short of PSRAM runs with less history rather
+// than a BLE stack that cannot allocate.
+enum MemoryPlace : uint8_t {
+    MEMORY_BULK,        // PSRAM, or internal RAM above the reserve
+    MEMORY_INTERNAL,    // Internal RAM, e.g. written out with the cache off
+    MEMORY_DMA          // Internal RAM the SPI and I2S DMA can read
+};
+
+// The part of the firmware a buffer or allocation belongs to, so growth
+// can be pinned on a feature. Each memoryAlloc() buffer names its tag.
+// In builds with -DHEAP_ALLOC_TRACE every other heap allocation is also
+// charged, to the tag of the task making it (memoryTagTask()), or the
+// tag a stretch of code on it asked for (memoryTagEnter()); the BLE
+// stack's own tasks are recognized by name. Everything else is SYSTEM.
+enum MemoryTag : uint8_t {
+    MEMORY_TAG_SYSTEM,
+    MEMORY_TAG_BLE,
+    MEMORY_TAG_PROTOCOL,    // Receive path, parser and wired links
+    MEMORY_TAG_UI,
+    MEMORY_TAG_LOGGER,      // SD logging, ride review and upload
+    MEMORY_TAG_TELEMETRY,   // History, capture, GPS and the other telemetry tasks
+    MEMORY_TAG_COUNT
+};
+
+struct MemoryTagStats {
+    uint32_t bufferBytes;       // Held through memoryAlloc()
+    uint32_t heapBytes;         // Held through malloc and new; HEAP_ALLOC_TRACE builds only
+    uint32_t peakBytes;         // Most of the two held at once
+};
+
+struct MemoryStats {
+    uint32_t psramBytes;        // Held in PSRAM through memoryAlloc()
+    uint32_t internalBytes;     // Held in internal RAM through memoryAlloc()
+    uint32_t fallbacks;         // Bulk buffers put in internal RAM
+    uint32_t failures;          // Allocations refused
+};
+
+void memoryBegin(size_t psramAbove, size_t internalReserve);
+
+// bytes of the place asked for, or nullptr (logged) without the memory
+void* memoryAlloc(size_t bytes, MemoryPlace place, MemoryTag tag);
+
+// Free a buffer from memoryAlloc(); nullptr is ignored
+void memoryFree(void* buffer);
+
+MemoryStats memoryStats();
+
+// Charge a task's heap allocations to a tag
+void memoryTagTask(TaskHandle_t task, MemoryTag tag);
+
+// Charge the calling task's allocations to tag until memoryTagLeave()
+// with what this returns, e.g. around a library's begin() in setup()
+MemoryTag memoryTagEnter(MemoryTag tag);
+void memoryTagLeave(MemoryTag previous);
+
+// Per tag, indexed by MemoryTag
+void memoryTagStats(MemoryTagStats out[MEMORY_TAG_COUNT]);
+
+const char* memoryTagName(MemoryTag tag);
+
+// Whether heap allocations are charged (HEAP_ALLOC_TRACE), and how many
+// could not be, for a full table
+bool memoryHeapTraced();
+uint32_t memoryHeapUntracked();
+
+// For the HEAP_ALLOC_TRACE allocator wrappers (heap_stats.cpp): a block
+// came from the heap or is about to go back. Never allocate.
+void memoryTraceAlloc(void* block);
+void memoryTraceFree(void* block);
@@ -0,0 +1,40 @@
+#include "motion.h"
+
+#include <stdlib.h>
+
+MotionDetector::MotionDetector(uint16_t thresholdMg, uint32_t stillMs)
+    : thresholdMg(thresholdMg), stillMs(stillMs), started(false), isStill(false),
+      deviation(0), lastMotionMs(0) {
+    gravity[0] = gravity[1] = gravity[2] = 0;
+}
+
+bool MotionDetector::update(int32_t xMg, int32_t yMg, int32_t zMg, uint32_t now) {
+    const int32_t sample[3] = { xMg, yMg, zMg };
+    if (!started) {
+        // The board starts out moving until it has been still for a while
+        for (int i = 0; i < 3; i++) gravity[i] = sample[i] * (1 << GRAVITY_SHIFT);
+        started = true;
+        lastMotionMs = now;
+        return false;
+    }
+
+    deviation = 0;
+    for (int i = 0; i < 3; i++) {
+        deviation += abs(sample[i] - (gravity[i] >> GRAVITY_SHIFT));
+        gravity[i] += sample[i] - (gravity[i] >> GRAVITY_SHIFT);
+    }
+
+    if (deviation > thresholdMg) {
+        lastMotionMs = now;
+        if (isStill) {
+            isStill = false;
+            return true;
+        }
+        return false;
+    }
+    if (!isStill && now - lastMotionMs >= stillMs) {
+        isStill = true;
+        return true;
+    }
+    return false;
+}
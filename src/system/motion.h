@@ -0,0 +1,33 @@
+#pragma once
+
+#include <stdint.h>
+
+// Decides from accelerometer samples whether the board is moving. Gravity
+// is tracked with a slow low-pass per axis; a sample that strays from it
+// by more than the threshold (summed over the axes) counts as motion and
+// ends a still period at once. Only after stillMs without motion is the
+// board considered still, so a pause at a junction does not count.
+// Accelerations are in mg, times in milliseconds. Not thread safe.
+class MotionDetector {
+public:
+    MotionDetector(uint16_t thresholdMg, uint32_t stillMs);
+
+    // Feed one sample. Returns true if the still state changed.
+    bool update(int32_t xMg, int32_t yMg, int32_t zMg, uint32_t now);
+
+    bool still() const { return isStill; }
+
+    // Deviation of the last sample from gravity, mg
+    int32_t lastDeviation() const { return deviation; }
+
+private:
+    static const int GRAVITY_SHIFT = 4;   // Low-pass weight 1/16
+
+    uint16_t thresholdMg;
+    uint32_t stillMs;
+    bool started;
+    bool isStill;
+    int32_t gravity[3];    // mg << GRAVITY_SHIFT
+    int32_t deviation;
+    uint32_t lastMotionMs;
+};
@@ -0,0 +1,98 @@
+#include "parking.h"
+#include "i2c_bus.h"
+#include "../log.h"
+#include "../ble/ble_host.h"
+
+#include <M5Core2.h>
+#include <esp_attr.h>
+#include <esp_sleep.h>
+#include <esp_system.h>
+#include <string.h>
+
+static const uint32_t PARKED_MAGIC = 0x5041524b;    // "PARK"
+static const gpio_num_t TOUCH_INT_PIN = GPIO_NUM_39;  // FT6336U interrupt, low while touched
+static const uint16_t SCAN_INTERVAL_MS = 100;
+static const uint16_t SCAN_WINDOW_MS = 99;
+static const uint16_t SCAN_MTU = 23;                // Nothing connects before the full boot sets it
+
+// Kept through deep sleep; a power-on or reset leaves stale contents,
+// which the reset reason rules out
+struct ParkedState {
+    uint32_t magic;
+    uint8_t address[6];
+    uint32_t wakes;
+};
+
+RTC_DATA_ATTR static ParkedState parked;
+static ParkingSettings settings;
+static uint32_t resumedWakes = 0;
+static volatile bool heard = false;
+
+static void onAdvert(const uint8_t* address, uint8_t addressType, int rssi, const uint8_t* payload, size_t length) {
+    if (memcmp(address, parked.address, sizeof(parked.address)) == 0) heard = true;
+}
+
+static void enableTouchWake() {
+    if (settings.wakeOnTouch) esp_sleep_enable_ext0_wakeup(TOUCH_INT_PIN, 0);
+}
+
+// Back to sleep from a wake-up that heard nothing. The PMIC still has
+// the display rails off from parkingEnter(), so only the ESP32 sleeps.
+static void sleepAgain() {
+    enableTouchWake();
+    esp_sleep_enable_timer_wakeup((uint64_t)settings.wakeSeconds * 1000000ull);
+    esp_deep_sleep_start();
+}
+
+// Listen for the parked VESC's advertisements. Passive, since only the
+// address is wanted. A scan that does not start counts as heard, so a
+// broken radio boots normally instead of sleeping forever.
+static bool scanForVesc() {
+    bleHostBegin(SCAN_MTU, true);
+    bleHostScanHandler(onAdvert, false);
+    heard = false;
+    if (!bleHostScanStart(false, SCAN_INTERVAL_MS, SCAN_WINDOW_MS)) return true;
+    uint32_t started = millis();
+    while (!heard && millis() - started < settings.scanMs) delay(10);
+    bleHostScanStop();
+    bleHostScanHandler(nullptr, false);
+    return heard;
+}
+
+bool parkingResume(const ParkingSettings& parkingSettings) {
+    settings = parkingSettings;
+    if (esp_reset_reason() != ESP_RST_DEEPSLEEP || parked.magic != PARKED_MAGIC) {
+        parked.magic = 0;
+        return false;
+    }
+    if (esp_sleep_get_wakeup_cause() == ESP_SLEEP_WAKEUP_TIMER) {
+        parked.wakes++;
+        if (!scanForVesc()) sleepAgain();
+    }
+    // Heard or touched
+    resumedWakes = parked.wakes;
+    parked.magic = 0;
+    return true;
+}
+
+// On the bus task, so the PMIC is not cut off in another job's transfer
+static void deepSleep(void* context) {
+    M5.Axp.DeepSleep((uint64_t)settings.wakeSeconds * 1000000ull);
+}
+
+void parkingEnter(const uint8_t address[6]) {
+    memcpy(parked.address, address, sizeof(parked.address));
+    parked.wakes = 0;
+    parked.magic = PARKED_MAGIC;
+    LOG_I(APP, "Parking: deep sleep, listening for %02x:%02x:%02x:%02x:%02x:%02x every %u s", address[0], address[1],
+          address[2], address[3], address[4], address[5], (unsigned)settings.wakeSeconds);
+    Serial.flush();
+    enableTouchWake();
+    // Switches the display, backlight and vibration rails off until the
+    // next full boot; does not come back
+    i2cBusRun(I2C_PRIORITY_CONTROL, deepSleep, nullptr);
+}
+
+uint32_t parkingWakeCount() {
+    return resumedWakes;
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <stdint.h>
+
+// Parking: with the vehicle off for a long time there is nothing to
+// reconnect to, and retrying every few seconds drains the battery in
+// hours. Parked, the dashboard sleeps deeply instead and wakes every
+// wakeSeconds for a short passive scan. The primary VESC's address
+// waits in RTC memory, so the scan runs before the PMIC, display or
+// storage are brought up; not hearing it goes straight back to sleep.
+// Hearing it, or a touch, resumes the normal boot, which connects
+// straight to the last VESC with its cached handles.
+
+struct ParkingSettings {
+    uint32_t wakeSeconds;      // Sleep between scans
+    uint32_t scanMs;           // Passive scan per wake-up
+    bool wakeOnTouch;          // The touch controller's interrupt wakes too
+};
+
+// Call first in setup(), before anything is powered. After a parking
+// wake-up this brings up the BLE controller and scans; if the VESC is
+// not heard it sleeps again and does not return. Returns true when the
+// boot resumes from parking, false for any other boot. The settings are
+// kept for parkingEnter().
+bool parkingResume(const ParkingSettings& settings);
+
+// Remember the primary's address and sleep. The caller closes logs and
+// anything else that should survive first. Does not return.
+void parkingEnter(const uint8_t address[6]);
+
+// Wake-ups the last parking took before the VESC was heard
+uint32_t parkingWakeCount();
@@ -0,0 +1,168 @@
+#include "perf_stats.h"
+#include "task_layout.h"
+
+#include <Arduino.h>
+#include <esp_heap_caps.h>
+#include <stdio.h>
+#include <string.h>
+
+static portMUX_TYPE rttMux = portMUX_INITIALIZER_UNLOCKED;
+static uint32_t rttHistogram[PERF_RTT_BUCKETS];
+
+static portMUX_TYPE latencyMux = portMUX_INITIALIZER_UNLOCKED;
+static uint32_t latencyHistogram[PERF_LATENCY_STAGES][PERF_LATENCY_BUCKETS];
+static const char* LATENCY_NAMES[PERF_LATENCY_STAGES] = { "reply", "decode", "wait", "push", "total" };
+
+// Newest sample not yet drawn
+static bool samplePending = false;
+static uint32_t pendingSentUs = 0;
+static uint32_t pendingPublishedUs = 0;
+
+static TaskHandle_t watchedTasks[PERF_MAX_TASKS];
+static MemoryTag watchedTags[PERF_MAX_TASKS];
+static uint8_t watchedCount = 0;
+
+// UI window being filled, and the last complete one
+struct FrameWindow {
+    uint32_t frames;
+    uint32_t skipped;
+    uint32_t renderSum;
+    uint32_t renderMax;
+    uint32_t jitterSum;
+    uint32_t jitterMax;
+};
+static FrameWindow filling;
+static FrameWindow finished;
+static uint32_t windowStartMs = 0;
+
+void perfWatchTask(TaskHandle_t task, MemoryTag tag) {
+    if (!task) return;
+    memoryTagTask(task, tag);
+    if (watchedCount >= PERF_MAX_TASKS) return;
+    watchedTags[watchedCount] = tag;
+    watchedTasks[watchedCount++] = task;
+}
+
+void perfNoteRtt(uint32_t rttMs) {
+    int bucket = 0;
+    for (uint32_t edge = 16; bucket < PERF_RTT_BUCKETS - 1 && rttMs >= edge; edge <<= 1) {
+        bucket++;
+    }
+    portENTER_CRITICAL(&rttMux);
+    rttHistogram[bucket]++;
+    portEXIT_CRITICAL(&rttMux);
+}
+
+// Called with latencyMux held
+static void noteLatency(PerfLatencyStage stage, uint32_t us) {
+    int bucket = 0;
+    for (uint32_t edge = 1000; bucket < PERF_LATENCY_BUCKETS - 1 && us >= edge; edge <<= 1) {
+        bucket++;
+    }
+    latencyHistogram[stage][bucket]++;
+}
+
+void perfNoteSample(uint32_t sentUs, uint32_t arrivalUs, uint32_t publishedUs) {
+    portENTER_CRITICAL(&latencyMux);
+    if (sentUs != 0) noteLatency(PERF_LATENCY_REPLY, arrivalUs - sentUs);
+    noteLatency(PERF_LATENCY_DECODE, publishedUs - arrivalUs);
+    samplePending = true;
+    pendingSentUs = sentUs;
+    pendingPublishedUs = publishedUs;
+    portEXIT_CRITICAL(&latencyMux);
+}
+
+void perfNoteFramePushed(uint32_t startUs, uint32_t endUs) {
+    portENTER_CRITICAL(&latencyMux);
+    // Only a sample the frame could have drawn
+    if (samplePending && (int32_t)(startUs - pendingPublishedUs) >= 0) {
+        noteLatency(PERF_LATENCY_WAIT, startUs - pendingPublishedUs);
+        noteLatency(PERF_LATENCY_PUSH, endUs - startUs);
+        if (pendingSentUs != 0) noteLatency(PERF_LATENCY_TOTAL, endUs - pendingSentUs);
+        samplePending = false;
+    }
+    portEXIT_CRITICAL(&latencyMux);
+}
+
+static void rollWindow() {
+    uint32_t now = millis();
+    if (now - windowStartMs >= PERF_WINDOW_MS) {
+        finished = filling;
+        memset(&filling, 0, sizeof(filling));
+        windowStartMs = now;
+    }
+}
+
+void perfNoteFrameStart(uint32_t lateUs) {
+    rollWindow();
+    filling.frames++;
+    filling.jitterSum += lateUs;
+    if (lateUs > filling.jitterMax) filling.jitterMax = lateUs;
+}
+
+void perfNoteFrameSkipped() {
+    rollWindow();
+    filling.skipped++;
+}
+
+void perfNoteFrameWork(uint32_t workUs) {
+    filling.renderSum += workUs;
+    if (workUs > filling.renderMax) filling.renderMax = workUs;
+}
+
+void perfSnapshot(PerfSnapshot& out) {
+    portENTER_CRITICAL(&rttMux);
+    memcpy(out.rttHistogram, rttHistogram, sizeof(rttHistogram));
+    portEXIT_CRITICAL(&rttMux);
+    portENTER_CRITICAL(&latencyMux);
+    memcpy(out.latencyHistogram, latencyHistogram, sizeof(latencyHistogram));
+    portEXIT_CRITICAL(&latencyMux);
+
+    uint32_t frames = finished.frames;
+    out.framesPerSecond = frames * 1000 / PERF_WINDOW_MS;
+    out.framesSkipped = finished.skipped * 1000 / PERF_WINDOW_MS;
+    out.renderUsAvg = frames ? finished.renderSum / frames : 0;
+    out.renderUsMax = finished.renderMax;
+    out.jitterUsAvg = frames ? finished.jitterSum / frames : 0;
+    out.jitterUsMax = finished.jitterMax;
+    out.budgetOverruns = taskBudgetOverruns();
+
+    out.freeHeap = heap_caps_get_free_size(MALLOC_CAP_INTERNAL);
+    out.minFreeHeap = heap_caps_get_minimum_free_size(MALLOC_CAP_INTERNAL);
+    out.freePsram = heap_caps_get_free_size(MALLOC_CAP_SPIRAM);
+
+    // The ESP-IDF high-water mark is already in bytes
+    out.taskCount = watchedCount;
+    for (uint8_t i = 0; i < watchedCount; i++) {
+        out.tasks[i].name = pcTaskGetTaskName(watchedTasks[i]);
+        out.tasks[i].freeBytes = uxTaskGetStackHighWaterMark(watchedTasks[i]);
+        out.tasks[i].tag = watchedTags[i];
+    }
+}
+
+size_t perfFormatLine(const PerfSnapshot& s, char* out, size_t size) {
+    int n = snprintf(out, size,
+                     "perf frames=%u crc=%u resync=%u rxdrop=%u timeouts=%u unhandled=%u rtt=%u/%u/%u/%u/%u/%u/%u/%u "
+                     "fps=%u skipped=%u work=%u/%uus late=%u/%uus overruns=%u heap=%u/%u psram=%u stack",
+                     s.frames, s.crcErrors, s.resyncs, s.rxDropped, s.timeouts, s.unhandled,
+                     s.rttHistogram[0], s.rttHistogram[1], s.rttHistogram[2], s.rttHistogram[3],
+                     s.rttHistogram[4], s.rttHistogram[5], s.rttHistogram[6], s.rttHistogram[7],
+                     s.framesPerSecond, s.framesSkipped, s.renderUsAvg, s.renderUsMax, s.jitterUsAvg, s.jitterUsMax,
+                     s.budgetOverruns, s.freeHeap, s.minFreeHeap, s.freePsram);
+    for (uint8_t i = 0; i < s.taskCount && n > 0 && (size_t)n < size; i++) {
+        n += snprintf(out + n, size - n, " %s=%u", s.tasks[i].name, s.tasks[i].freeBytes);
+    }
+    if (n < 0) return 0;
+    return (size_t)n < size ? (size_t)n : size - 1;
+}
+
+size_t perfFormatLatencyLine(const PerfSnapshot& s, char* out, size_t size) {
+    int n = snprintf(out, size, "latency");
+    for (int stage = 0; stage < PERF_LATENCY_STAGES && n > 0 && (size_t)n < size; stage++) {
+        const uint32_t* h = s.latencyHistogram[stage];
+        n += snprintf(out + n, size - n, " %s=%u/%u/%u/%u/%u/%u/%u/%u", LATENCY_NAMES[stage],
+                      h[0], h[1], h[2], h[3], h[4], h[5], h[6], h[7]);
+    }
+    if (n < 0) return 0;
+    return (size_t)n < size ? (size_t)n : size - 1;
+}
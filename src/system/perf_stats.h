@@ -0,0 +1,98 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include "memory.h"
+
+// Field instrumentation: a request round-trip histogram, UI frame work
+// time and pacing jitter, memory headroom and task stack high-water
+// marks. Recording is a couple of adds, so it stays on in release
+// builds. The UI figures cover the last complete PERF_WINDOW_MS window.
+//
+// Link counters (frames, CRC errors, resyncs) already live in the framer
+// and receive queue; the caller copies them into the snapshot.
+
+static const int PERF_RTT_BUCKETS = 8;      // <16, <32, ... <1024 ms, then 1024+
+static const int PERF_MAX_TASKS = 24;
+static const uint32_t PERF_WINDOW_MS = 1000;
+static const int PERF_LATENCY_BUCKETS = 8;  // <1, <2, <4, ... <64 ms, then 64+
+
+// Stages of a sample's way from the request to the screen. A sample is
+// followed to the first frame rendered after it was published; samples
+// a newer one overtook before that frame are only counted up to then.
+enum PerfLatencyStage : uint8_t {
+    PERF_LATENCY_REPLY,          // Request sent until the reply's first byte arrived
+    PERF_LATENCY_DECODE,         // First byte until the decoded sample was published
+    PERF_LATENCY_WAIT,           // Published until a frame started drawing it
+    PERF_LATENCY_PUSH,           // That frame's drawing and pushes to the LCD
+    PERF_LATENCY_TOTAL,          // Request sent until its values were on the LCD
+    PERF_LATENCY_STAGES
+};
+
+struct PerfTaskStack {
+    const char* name;
+    uint32_t freeBytes;          // Least stack left since the task started
+    MemoryTag tag;
+};
+
+struct PerfSnapshot {
+    // Link, filled in by the caller
+    uint32_t frames;
+    uint32_t crcErrors;
+    uint32_t resyncs;
+    uint32_t rxDropped;          // Bytes lost to a full receive queue
+    uint32_t timeouts;           // Requests never answered
+    uint32_t unhandled;          // Frames with a command nothing handles
+
+    uint32_t rttHistogram[PERF_RTT_BUCKETS];
+    uint32_t latencyHistogram[PERF_LATENCY_STAGES][PERF_LATENCY_BUCKETS];
+
+    uint32_t framesPerSecond;    // UI frames rendered in the last window
+    uint32_t framesSkipped;      // Loop passes that had nothing to render, per second
+    uint32_t renderUsAvg;        // Loop work of the passes that rendered
+    uint32_t renderUsMax;
+    uint32_t jitterUsAvg;        // How late renders started past their slot
+    uint32_t jitterUsMax;
+    uint32_t budgetOverruns;     // Units of task work over their budget (task_layout.h)
+
+    uint32_t freeHeap;
+    uint32_t minFreeHeap;
+    uint32_t freePsram;
+
+    uint8_t taskCount;
+    PerfTaskStack tasks[PERF_MAX_TASKS];
+};
+
+// Watch a task's stack, and charge its heap allocations to tag
+// (memory.h); the name is taken from the task
+void perfWatchTask(TaskHandle_t task, MemoryTag tag);
+
+// A matched request/reply round trip. Safe from any task.
+void perfNoteRtt(uint32_t rttMs);
+
+// A sample was published. Times are esp_timer microseconds, truncated
+// to 32 bits: when its request was sent (0 if unknown), when the reply
+// began to arrive and when it was published. Safe from any task.
+void perfNoteSample(uint32_t sentUs, uint32_t arrivalUs, uint32_t publishedUs);
+
+// A UI frame drew from startUs and had pushed everything by endUs.
+// Finishes the newest sample published before it started. UI task only.
+void perfNoteFramePushed(uint32_t startUs, uint32_t endUs);
+
+// How late a rendering UI frame started, and how long the frame's work
+// took; or a loop pass that did not render. UI task only.
+void perfNoteFrameStart(uint32_t lateUs);
+void perfNoteFrameWork(uint32_t workUs);
+void perfNoteFrameSkipped();
+
+// Everything except the link counters
+void perfSnapshot(PerfSnapshot& out);
+
+// The snapshot as one compact line for the serial log. Returns the
+// length written.
+size_t perfFormatLine(const PerfSnapshot& snapshot, char* out, size_t size);
+
+// The latency histograms as one line ("latency reply=a/b/.. decode=..")
+size_t perfFormatLatencyLine(const PerfSnapshot& snapshot, char* out, size_t size);
@@ -0,0 +1,135 @@
+#include "power.h"
+#include "i2c_bus.h"
+#include "../log.h"
+#include "../ui/display.h"
+
+#include <M5Core2.h>
+#include <sdkconfig.h>
+#if CONFIG_PM_ENABLE
+#include <esp_pm.h>
+#endif
+
+static PowerSettings settings;
+static PowerMode mode = POWER_FULL;
+static DisplayState display = DISPLAY_FULL;
+static bool settling = false;
+static int32_t lastDrawMa = 0;
+static bool onUsb = false;
+static int64_t totalMa[POWER_MODE_COUNT];
+static uint32_t sampleCount[POWER_MODE_COUNT];
+
+// Let the SDK scale the clock down and light sleep while idle. Only
+// builds with CONFIG_PM_ENABLE have the power management driver; the
+// others keep the fixed clock set below.
+static void configureSleep(bool enable, uint32_t cpuMhz) {
+#if CONFIG_PM_ENABLE
+    esp_pm_config_esp32_t config;
+    config.max_freq_mhz = cpuMhz;
+    config.min_freq_mhz = enable ? 40 : cpuMhz;
+    config.light_sleep_enable = enable;
+    esp_err_t err = esp_pm_configure(&config);
+    if (err != ESP_OK) LOG_W(APP, "Power management not configured (err %d)", err);
+#else
+    if (enable) LOG_D(APP, "Light sleep needs CONFIG_PM_ENABLE; clock and backlight only");
+#endif
+}
+
+static const uint8_t CMD_DISPOFF = 0x28;     // Panel output off, frame memory kept
+static const uint8_t CMD_DISPON = 0x29;
+
+// Backlight for the mode, dimmer while the display is dimmed
+static uint8_t brightness() {
+    uint8_t level = mode == POWER_SAVE ? settings.saveBrightness : settings.fullBrightness;
+    return display == DISPLAY_DIMMED && settings.dimBrightness < level ? settings.dimBrightness : level;
+}
+
+// On the bus task; context is the level, or the rail's state
+static void setBacklight(void* context) {
+    M5.Axp.ScreenBreath((uint8_t)(uintptr_t)context);
+}
+
+static void setDisplayRail(void* context) {
+    M5.Axp.SetDCDC3(context != nullptr);
+}
+
+static void postBacklight() {
+    i2cBusPost(I2C_PRIORITY_CONTROL, setBacklight, (void*)(uintptr_t)brightness());
+}
+
+static void applyMode() {
+    bool save = mode == POWER_SAVE;
+    uint32_t cpuMhz = save ? settings.saveCpuMhz : settings.fullCpuMhz;
+    if (!setCpuFrequencyMhz(cpuMhz)) LOG_W(APP, "CPU clock %u MHz not supported", cpuMhz);
+    configureSleep(save && settings.lightSleep, cpuMhz);
+    if (display != DISPLAY_OFF) postBacklight();
+    settling = true;
+    LOG_I(APP, "Power mode %s: CPU %u MHz, backlight %d%%", powerModeName(mode), getCpuFrequencyMhz(),
+          brightness());
+}
+
+void powerBegin(const PowerSettings& powerSettings, PowerMode initialMode) {
+    settings = powerSettings;
+    mode = initialMode;
+    applyMode();
+}
+
+void powerSetMode(PowerMode newMode) {
+    if (newMode == mode || newMode >= POWER_MODE_COUNT) return;
+    mode = newMode;
+    applyMode();
+}
+
+PowerMode powerMode() {
+    return mode;
+}
+
+void powerSetDisplay(DisplayState state) {
+    if (state == display) return;
+    DisplayState previous = display;
+    display = state;
+    if (state == DISPLAY_OFF) {
+        displayCommand(CMD_DISPOFF);
+        i2cBusPost(I2C_PRIORITY_CONTROL, setDisplayRail, nullptr);
+        LOG_D(APP, "Display off");
+        return;
+    }
+    if (previous == DISPLAY_OFF) {
+        displayCommand(CMD_DISPON);
+        i2cBusPost(I2C_PRIORITY_CONTROL, setDisplayRail, (void*)1);
+    }
+    // ScreenBreath() sets the backlight's LCD voltage, 2.5 to 3.3 V
+    postBacklight();
+    LOG_D(APP, "Backlight %d%%%s", brightness(), state == DISPLAY_DIMMED ? " (dimmed)" : "");
+}
+
+void powerSample(int batteryMa, bool usb) {
+    lastDrawMa = -batteryMa;
+    onUsb = usb;
+    if (settling) {
+        settling = false;
+        return;
+    }
+    if (onUsb || lastDrawMa <= 0) return;
+    totalMa[mode] += lastDrawMa;
+    sampleCount[mode]++;
+}
+
+int32_t powerLastDrawMa() {
+    return lastDrawMa;
+}
+
+bool powerOnUsb() {
+    return onUsb;
+}
+
+PowerModeStats powerModeStats(PowerMode statsMode) {
+    PowerModeStats stats = { 0, 0 };
+    if (statsMode >= POWER_MODE_COUNT) return stats;
+    stats.samples = sampleCount[statsMode];
+    stats.averageMa = stats.samples ? (int32_t)(totalMa[statsMode] / stats.samples) : 0;
+    return stats;
+}
+
+const char* powerModeName(PowerMode nameMode) {
+    return nameMode == POWER_SAVE ? "save" : "full";
+}
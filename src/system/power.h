@@ -0,0 +1,54 @@
+#pragma once
+
+#include <stdint.h>
+#include "display_power.h"
+
+// Power modes. Save lowers the CPU clock, dims the backlight and, on
+// builds with power management enabled in the SDK, lets the chip enter
+// automatic light sleep whenever every task is blocked, which between
+// polls and frames is most of the time. The poll schedule and frame
+// pacing are untouched, so telemetry keeps its cadence.
+enum PowerMode : uint8_t {
+    POWER_FULL,
+    POWER_SAVE,
+    POWER_MODE_COUNT
+};
+
+struct PowerSettings {
+    uint32_t fullCpuMhz;
+    uint32_t saveCpuMhz;       // 80 is the lowest the radio runs at
+    uint8_t fullBrightness;    // Backlight, percent
+    uint8_t saveBrightness;
+    uint8_t dimBrightness;     // While the display is dimmed, in either mode if lower
+    bool lightSleep;           // Allow automatic light sleep in save mode
+};
+
+// Battery current measured while in a mode, averaged over the samples
+// taken on battery (the AXP cannot tell system draw while on USB)
+struct PowerModeStats {
+    uint32_t samples;
+    int32_t averageMa;         // Drawn from the battery, positive
+};
+
+void powerBegin(const PowerSettings& settings, PowerMode mode);
+void powerSetMode(PowerMode mode);
+PowerMode powerMode();
+
+// Drive the backlight and panel for a display state (see
+// display_power.h). Dimmed lowers the backlight's LCD voltage; off cuts
+// the backlight's DC-DC and blanks the panel, which keeps its frame
+// memory, so full brings back the last picture at once.
+void powerSetDisplay(DisplayState state);
+
+// Fold a battery current sample (positive while charging, as the AXP
+// reports it) into the current mode's average. The first sample after a
+// mode change is skipped while the draw settles.
+void powerSample(int batteryMa, bool onUsb);
+
+// Latest reading in mA (positive while drawing), and whether it was on USB
+int32_t powerLastDrawMa();
+bool powerOnUsb();
+
+PowerModeStats powerModeStats(PowerMode mode);
+
+const char* powerModeName(PowerMode mode);
@@ -0,0 +1,75 @@
+#include "probes.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#ifdef PERF_PROBES
+#include <freertos/FreeRTOS.h>
+
+static Probe* probes[PROBE_MAX];
+static int probeCount = 0;
+static portMUX_TYPE registryMux = portMUX_INITIALIZER_UNLOCKED;
+
+Probe::Probe(const char* name) : resetPending(false) {
+    stats.name = name;
+    stats.count = 0;
+    stats.totalCycles = 0;
+    stats.minCycles = UINT32_MAX;
+    stats.maxCycles = 0;
+
+    // Probes register on first use, possibly from several tasks at once.
+    // Past PROBE_MAX they still time but are not reported.
+    portENTER_CRITICAL(&registryMux);
+    if (probeCount < PROBE_MAX) probes[probeCount++] = this;
+    portEXIT_CRITICAL(&registryMux);
+}
+
+int probesSnapshot(ProbeStats* out, int max) {
+    portENTER_CRITICAL(&registryMux);
+    int n = probeCount < max ? probeCount : max;
+    portEXIT_CRITICAL(&registryMux);
+    for (int i = 0; i < n; i++) {
+        out[i] = probes[i]->stats;
+    }
+    return n;
+}
+
+void probesReset() {
+    portENTER_CRITICAL(&registryMux);
+    for (int i = 0; i < probeCount; i++) {
+        probes[i]->resetPending = true;
+    }
+    portEXIT_CRITICAL(&registryMux);
+}
+
+size_t probesFormatLine(char* out, size_t size) {
+    ProbeStats stats[PROBE_MAX];
+    int count = probesSnapshot(stats, PROBE_MAX);
+    if (count == 0 || size == 0) return 0;
+
+    int n = snprintf(out, size, "probes");
+    for (int i = 0; i < count && n > 0 && (size_t)n < size; i++) {
+        const ProbeStats& s = stats[i];
+        uint32_t avg = s.count ? (uint32_t)(s.totalCycles / s.count) : 0;
+        n += snprintf(out + n, size - n, " %s=%u:%u/%u/%u", s.name, s.count,
+                      s.count ? s.minCycles : 0, avg, s.maxCycles);
+    }
+    if (n < 0) return 0;
+    return (size_t)n < size ? (size_t)n : size - 1;
+}
+
+#else
+
+int probesSnapshot(ProbeStats* out, int max) {
+    return 0;
+}
+
+void probesReset() {
+}
+
+size_t probesFormatLine(char* out, size_t size) {
+    if (size > 0) out[0] = 0;
+    return 0;
+}
+
+#endif
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Cycle-accurate timing of hot paths. PROBE_SCOPE("name") times the rest
+// of the enclosing block with the CPU cycle counter and accumulates the
+// count, min, average and max per name. Entering a probe costs two
+// CCOUNT reads and a few adds.
+//
+// Probes only exist in builds with -DPERF_PROBES (the m5stack-core2-probes
+// env); otherwise PROBE_SCOPE expands to nothing and the snapshot is
+// empty. CCOUNT is per core, so a probe must only be entered from one task
+// and that task must be pinned, which all of ours are.
+
+static const int PROBE_MAX = 10;
+
+struct ProbeStats {
+    const char* name;
+    uint32_t count;
+    uint32_t minCycles;
+    uint32_t maxCycles;
+    uint64_t totalCycles;
+};
+
+#ifdef PERF_PROBES
+#include <Arduino.h>
+
+class Probe {
+public:
+    explicit Probe(const char* name);
+
+    // Called by the owning task only; a pending reset is applied here so
+    // the reader never writes the accumulators
+    void record(uint32_t cycles) {
+        if (resetPending) {
+            stats.count = 0;
+            stats.totalCycles = 0;
+            stats.minCycles = UINT32_MAX;
+            stats.maxCycles = 0;
+            resetPending = false;
+        }
+        stats.count++;
+        stats.totalCycles += cycles;
+        if (cycles < stats.minCycles) stats.minCycles = cycles;
+        if (cycles > stats.maxCycles) stats.maxCycles = cycles;
+    }
+
+    ProbeStats stats;
+    volatile bool resetPending;
+};
+
+class ProbeScope {
+public:
+    explicit ProbeScope(Probe& probe) : probe(probe), start(ESP.getCycleCount()) {}
+    ~ProbeScope() { probe.record(ESP.getCycleCount() - start); }
+
+private:
+    Probe& probe;
+    uint32_t start;
+};
+
+#define PROBE_CONCAT2(a, b) a##b
+#define PROBE_CONCAT(a, b) PROBE_CONCAT2(a, b)
+#define PROBE_SCOPE(name) \
+    static Probe PROBE_CONCAT(probe_, __LINE__)(name); \
+    ProbeScope PROBE_CONCAT(probeScope_, __LINE__)(PROBE_CONCAT(probe_, __LINE__))
+
+static const bool PROBES_ENABLED = true;
+#else
+#define PROBE_SCOPE(name) do {} while (0)
+
+static const bool PROBES_ENABLED = false;
+#endif
+
+// Copy up to max probes' figures. Returns how many were copied; 0 when
+// probes are compiled out. A probe being recorded while it is copied can
+// be one sample off.
+int probesSnapshot(ProbeStats* out, int max);
+
+// Start every probe afresh on its next record
+void probesReset();
+
+// One compact line for the serial log ("probes name=count:min/avg/max
+// ..." in cycles). Returns the length written, 0 when compiled out.
+size_t probesFormatLine(char* out, size_t size);
@@ -0,0 +1,135 @@
+#include "sensors.h"
+#include "seqlock.h"
+#include "perf_stats.h"
+#include "motion.h"
+#include "app_events.h"
+#include "task_layout.h"
+#include "wall_clock.h"
+#include "i2c_bus.h"
+#include "../log.h"
+
+#include <M5Core2.h>
+
+static const uint32_t TASK_STACK_SIZE = 3072;
+static const TaskPlacement& PLACEMENT = TASK_PLACEMENT[TASK_SENSORS];
+
+static Seqlock<SensorReadings> readings;
+static uint32_t samplePeriodMs = 5000;
+static uint32_t watchPeriodMs = 5000;
+static bool lastOnUsb = false;
+static bool lastLowVoltage = false;
+static MotionSettings motionSettings;
+static MotionDetector* motion = nullptr;   // nullptr with detection off or no IMU
+static volatile bool still = false;
+
+// The PMIC registers of a sample, on the bus task
+static void readAxp(void* context) {
+    SensorReadings& r = *(SensorReadings*)context;
+    r.batteryLevel = (int)M5.Axp.GetBatteryLevel();
+    r.batteryMv = (int)(M5.Axp.GetBatVoltage() * 1000);
+    r.batteryMa = (int)M5.Axp.GetBatCurrent();
+    r.onUsb = M5.Axp.isVBUS();
+    r.charging = M5.Axp.isCharging();
+    r.lowVoltage = M5.Axp.GetWarningLevel() != 0;
+}
+
+static void readSupply(void* context) {
+    SensorReadings& r = *(SensorReadings*)context;
+    r.onUsb = M5.Axp.isVBUS();
+    r.lowVoltage = M5.Axp.GetWarningLevel() != 0;
+}
+
+struct AccelReading {
+    float x, y, z;
+};
+
+static void readAccel(void* context) {
+    AccelReading& a = *(AccelReading*)context;
+    M5.IMU.getAccelData(&a.x, &a.y, &a.z);
+}
+
+static void initImu(void* context) {
+    *(bool*)context = M5.IMU.Init() == 0;
+}
+
+static void sampleAxp() {
+    SensorReadings r;
+    i2cBusRun(I2C_PRIORITY_SLOW, readAxp, &r);
+    r.updatedMs = millis();
+    lastOnUsb = r.onUsb;
+    lastLowVoltage = r.lowVoltage;
+    readings.write(r);
+    LOG_V(APP, "AXP: battery %d%% %dmV %dmA%s", r.batteryLevel, r.batteryMv, r.batteryMa,
+          r.onUsb ? " (USB)" : "");
+}
+
+// Resample at once if the supply changed since the last sample
+static void watchSupply() {
+    SensorReadings r;
+    i2cBusRun(I2C_PRIORITY_SLOW, readSupply, &r);
+    if (r.onUsb == lastOnUsb && r.lowVoltage == lastLowVoltage) return;
+    sampleAxp();
+    appEventsSet(APP_EVENT_POWER);
+    LOG_I(APP, "Supply changed: %s%s", lastOnUsb ? "USB" : "battery", lastLowVoltage ? ", low voltage" : "");
+}
+
+static void sampleImu() {
+    AccelReading a;
+    i2cBusRun(I2C_PRIORITY_IMU, readAccel, &a);
+    if (!motion->update((int32_t)(a.x * 1000), (int32_t)(a.y * 1000), (int32_t)(a.z * 1000), millis())) return;
+    still = motion->still();
+    appEventsSet(APP_EVENT_MOTION);
+    LOG_I(APP, "Board %s (deviation %d mg)", still ? "still" : "moving", (int)motion->lastDeviation());
+}
+
+static void sensorTask(void* param) {
+    uint32_t lastAxpMs = 0;
+    uint32_t lastWatchMs = 0;
+    bool first = true;
+    uint32_t delayMs = motion ? motionSettings.sampleMs : samplePeriodMs;
+    if (watchPeriodMs < delayMs) delayMs = watchPeriodMs;
+    for (;;) {
+        taskBudgetStart(TASK_SENSORS);
+        if (first || millis() - lastAxpMs >= samplePeriodMs) {
+            first = false;
+            lastAxpMs = millis();
+            lastWatchMs = lastAxpMs;
+            sampleAxp();
+        } else if (millis() - lastWatchMs >= watchPeriodMs) {
+            lastWatchMs = millis();
+            watchSupply();
+        }
+        if (motion) sampleImu();
+        wallClockService();
+        taskBudgetEnd(TASK_SENSORS);
+        vTaskDelay(pdMS_TO_TICKS(delayMs));
+    }
+}
+
+void sensorsBegin(uint32_t periodMs, uint32_t watchMs, const MotionSettings& motionConfig) {
+    samplePeriodMs = periodMs > 0 ? periodMs : 1;
+    watchPeriodMs = watchMs > 0 ? watchMs : samplePeriodMs;
+    motionSettings = motionConfig;
+    if (motionSettings.sampleMs == 0) motionSettings.sampleMs = 1;
+    if (motionSettings.enabled) {
+        bool found = false;
+        i2cBusRun(I2C_PRIORITY_IMU, initImu, &found);
+        if (found) {
+            motion = new MotionDetector(motionSettings.thresholdMg, motionSettings.stillMs);
+        } else {
+            LOG_W(APP, "No MPU6886, motion detection off");
+        }
+    }
+    TaskHandle_t task = nullptr;
+    xTaskCreatePinnedToCore(sensorTask, PLACEMENT.name, TASK_STACK_SIZE, nullptr, PLACEMENT.priority, &task,
+                            PLACEMENT.core);
+    perfWatchTask(task, MEMORY_TAG_SYSTEM);
+}
+
+uint32_t sensorsRead(SensorReadings& out) {
+    return readings.read(out);
+}
+
+bool sensorsStill() {
+    return still;
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <stdint.h>
+
+// PMIC readings, sampled on a background task at a slow rate so nothing
+// on the render path waits on the shared I2C bus; the reads run as slow
+// jobs on the bus task (see i2c_bus.h). The values change over minutes;
+// the UI reads the last sample, which costs a struct copy. The same task
+// reads the MPU6886 accelerometer more often to tell whether the board
+// is moving (see motion.h).
+//
+// Between samples the task checks VBUS and the PMIC's low-voltage
+// warning every watch period, two register reads. A change takes a full
+// sample at once and sets APP_EVENT_POWER, so losing external power is
+// seen within the watch period instead of the sample period.
+struct SensorReadings {
+    int batteryLevel;        // Percent
+    int batteryMv;
+    int batteryMa;           // Positive while charging, negative on battery
+    bool onUsb;
+    bool charging;
+    bool lowVoltage;         // The PMIC's low-voltage warning is raised
+    uint32_t updatedMs;      // millis() of the sample, 0 before the first
+};
+
+struct MotionSettings {
+    bool enabled;
+    uint32_t sampleMs;         // Accelerometer period
+    uint16_t thresholdMg;      // Deviation from gravity that counts as motion
+    uint32_t stillMs;          // Without motion for this long is still
+};
+
+// Start the sampling task; the first sample is taken right away
+void sensorsBegin(uint32_t periodMs, uint32_t watchMs, const MotionSettings& motion);
+
+// True once the board has been still for MotionSettings::stillMs; false
+// from the first sample with motion. Each change sets APP_EVENT_MOTION.
+// Always false with motion detection off or without an IMU.
+bool sensorsStill();
+
+// Copy the latest sample. Returns the number of samples so far, so a
+// caller can tell whether a new one arrived since its last read.
+uint32_t sensorsRead(SensorReadings& out);
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+#include <atomic>
+
+// Single-writer sequence lock. The writer never blocks; readers copy the
+// value and retry if a write overlapped the copy, so they always see a
+// consistent snapshot. Suited to small structs published from one task
+// and read from another core.
+template <typename T>
+class Seqlock {
+public:
+    Seqlock() : seq(0) {
+        memset(&data, 0, sizeof(data));
+    }
+
+    // Only one task may call write()
+    void write(const T& value) {
+        uint32_t s = seq.load(std::memory_order_relaxed);
+        seq.store(s + 1, std::memory_order_relaxed);  // Odd: write in progress
+        std::atomic_thread_fence(std::memory_order_release);
+        memcpy(&data, &value, sizeof(T));
+        seq.store(s + 2, std::memory_order_release);
+    }
+
+    // Copy the latest value. Returns the number of writes so far, so a
+    // caller can tell whether anything changed since its last read.
+    uint32_t read(T& out) const {
+        uint32_t before;
+        uint32_t after;
+        do {
+            before = seq.load(std::memory_order_acquire);
+            memcpy(&out, &data, sizeof(T));
+            std::atomic_thread_fence(std::memory_order_acquire);
+            after = seq.load(std::memory_order_relaxed);
+        } while ((before & 1) || before != after);
+        return before >> 1;
+    }
+
+private:
+    std::atomic<uint32_t> seq;
+    T data;
+};
@@ -0,0 +1,278 @@
+#include "settings.h"
+#include "../log.h"
+
+#include <Preferences.h>
+#include <string.h>
+
+static const char* NVS_NAMESPACE = "settings";
+static const char* NVS_KEY = "values";
+static const char* NVS_PROFILE_KEY = "profile";
+static const char* const NVS_RIDER_KEYS[SETTINGS_PROFILE_COUNT] = { "rider1", "rider2", "rider3", "rider4" };
+static const uint8_t STORED_VERSION = 1;
+
+struct __attribute__((packed)) StoredSettings {
+    uint8_t version;
+    uint8_t size;                // sizeof(Settings) when written
+    Settings values;
+};
+
+static const char* const TEMPERATURE_UNITS[] = { "C", "F" };
+static const char* const DISTANCE_UNITS[] = { "km", "miles" };
+
+static const SettingInfo infos[SETTING_COUNT] = {
+    { "Scan time",     "s",   1,    30,    1 },
+    { "Fastest poll",  "ms",  20,   1000,  10 },
+    { "Stale timeout", "ms",  1000, 30000, 500 },
+    { "Power poll",    "Hz",  0,    50,    1, nullptr, true },
+    { "Temp poll",     "Hz",  0,    10,    1, nullptr, true },
+    { "Fault poll",    "Hz",  0,    10,    1, nullptr, true },
+    { "Frame rate",    "fps", 5,    60,    5 },
+    { "Battery cells", "S",   1,    32,    1 },
+    { "Battery size",  "mAh", 500,  200000, 250 },
+    { "Motor poles",   "",    2,    60,    2 },
+    { "Gear ratio",    "/100", 100, 1000,  5 },
+    { "Wheel size",    "mm",  50,   1000,  1 },
+    { "FET alert",     "C",   0,    120,   5, nullptr, true },
+    { "Motor alert",   "C",   0,    150,   5, nullptr, true },
+    { "Low cell",      "mV",  0,    4000,  50, nullptr, true },
+    { "Temperature",   "",    0,    1,     1, TEMPERATURE_UNITS, true },
+    { "Distance",      "",    0,    1,     1, DISTANCE_UNITS, true },
+    { "First page",    "",    1,    6,     1, nullptr, true },     // Layout::MAX_PAGES
+    { "Pages",         "",    1,    6,     1, nullptr, true },
+};
+
+// The shared settings with the selected profile's; the other profiles'
+// own settings wait in riders, whose shared ones are not used
+static Settings current;
+static Settings stored;
+static Settings riders[SETTINGS_PROFILE_COUNT];
+static Settings storedRiders[SETTINGS_PROFILE_COUNT];
+static uint8_t profile = 0;
+
+static int32_t get(const Settings& s, SettingId id) {
+    switch (id) {
+        case SETTING_SCAN_SECONDS:     return s.scanSeconds;
+        case SETTING_REFRESH_MS:       return s.refreshMs;
+        case SETTING_STALE_TIMEOUT_MS: return s.staleTimeoutMs;
+        case SETTING_POLL_POWER_HZ:    return s.pollPowerHz;
+        case SETTING_POLL_TEMPS_HZ:    return s.pollTempsHz;
+        case SETTING_POLL_FAULT_HZ:    return s.pollFaultHz;
+        case SETTING_TARGET_FPS:       return s.targetFps;
+        case SETTING_BATTERY_CELLS:    return s.batteryCells;
+        case SETTING_BATTERY_CAPACITY: return s.batteryCapacityMah;
+        case SETTING_MOTOR_POLES:      return s.motorPoles;
+        case SETTING_GEAR_RATIO:       return s.gearRatioX100;
+        case SETTING_WHEEL_DIAMETER:   return s.wheelDiameterMm;
+        case SETTING_ALERT_FET_TEMP:   return s.alertFetTempC;
+        case SETTING_ALERT_MOTOR_TEMP: return s.alertMotorTempC;
+        case SETTING_ALERT_CELL_MV:    return s.alertCellMv;
+        case SETTING_TEMPERATURE_UNIT: return s.fahrenheit;
+        case SETTING_DISTANCE_UNIT:    return s.miles;
+        case SETTING_FIRST_PAGE:       return s.firstPage;
+        case SETTING_PAGE_COUNT:       return s.pageCount;
+        default:                       return 0;
+    }
+}
+
+static void set(Settings& s, SettingId id, int32_t value) {
+    switch (id) {
+        case SETTING_SCAN_SECONDS:     s.scanSeconds = value; break;
+        case SETTING_REFRESH_MS:       s.refreshMs = value; break;
+        case SETTING_STALE_TIMEOUT_MS: s.staleTimeoutMs = value; break;
+        case SETTING_POLL_POWER_HZ:    s.pollPowerHz = value; break;
+        case SETTING_POLL_TEMPS_HZ:    s.pollTempsHz = value; break;
+        case SETTING_POLL_FAULT_HZ:    s.pollFaultHz = value; break;
+        case SETTING_TARGET_FPS:       s.targetFps = value; break;
+        case SETTING_BATTERY_CELLS:    s.batteryCells = value; break;
+        case SETTING_BATTERY_CAPACITY: s.batteryCapacityMah = value; break;
+        case SETTING_MOTOR_POLES:      s.motorPoles = value; break;
+        case SETTING_GEAR_RATIO:       s.gearRatioX100 = value; break;
+        case SETTING_WHEEL_DIAMETER:   s.wheelDiameterMm = value; break;
+        case SETTING_ALERT_FET_TEMP:   s.alertFetTempC = value; break;
+        case SETTING_ALERT_MOTOR_TEMP: s.alertMotorTempC = value; break;
+        case SETTING_ALERT_CELL_MV:    s.alertCellMv = value; break;
+        case SETTING_TEMPERATURE_UNIT: s.fahrenheit = value; break;
+        case SETTING_DISTANCE_UNIT:    s.miles = value; break;
+        case SETTING_FIRST_PAGE:       s.firstPage = value; break;
+        case SETTING_PAGE_COUNT:       s.pageCount = value; break;
+        default:                       break;
+    }
+}
+
+static bool inRange(SettingId id, int32_t value) {
+    return value >= infos[id].min && value <= infos[id].max;
+}
+
+// Copy a profile's own settings, leaving the shared ones
+static void copyRider(Settings& to, const Settings& from) {
+    for (uint8_t i = 0; i < SETTING_COUNT; i++) {
+        SettingId id = (SettingId)i;
+        if (infos[i].rider) set(to, id, get(from, id));
+    }
+}
+
+static bool riderDiffers(const Settings& a, const Settings& b) {
+    for (uint8_t i = 0; i < SETTING_COUNT; i++) {
+        SettingId id = (SettingId)i;
+        if (infos[i].rider && get(a, id) != get(b, id)) return true;
+    }
+    return false;
+}
+
+// The settings of a stored blob over into, those of a profile only if
+// riderOnly. Returns how many were taken, or -1 without a valid blob.
+static int loadBlob(Preferences& prefs, const char* key, Settings& into, bool riderOnly) {
+    StoredSettings blob;
+    size_t n = prefs.getBytes(key, &blob, sizeof(blob));
+    // Settings are only ever appended, so a shorter blob from an older
+    // build still holds the ones it knew
+    size_t header = sizeof(blob) - sizeof(Settings);
+    if (n <= header || blob.version != STORED_VERSION || blob.size > sizeof(Settings) || n != header + blob.size) {
+        return -1;
+    }
+    Settings values = into;
+    memcpy(&values, &blob.values, blob.size);
+    int loaded = 0;
+    for (uint8_t i = 0; i < SETTING_COUNT; i++) {
+        SettingId id = (SettingId)i;
+        int32_t value = get(values, id);
+        if ((riderOnly && !infos[i].rider) || !inRange(id, value)) continue;
+        set(into, id, value);
+        loaded++;
+    }
+    return loaded;
+}
+
+static bool storeBlob(Preferences& prefs, const char* key, const Settings& values) {
+    StoredSettings blob;
+    blob.version = STORED_VERSION;
+    blob.size = sizeof(Settings);
+    blob.values = values;
+    return prefs.putBytes(key, &blob, sizeof(blob)) == sizeof(blob);
+}
+
+void settingsBegin(const Settings& defaults) {
+    current = defaults;
+    // A default outside its range would be clamped on the first adjust
+    for (uint8_t i = 0; i < SETTING_COUNT; i++) {
+        SettingId id = (SettingId)i;
+        if (!inRange(id, get(current, id))) {
+            LOG_W(APP, "Default %s %d is outside %d-%d", infos[i].name, (int)get(current, id),
+                  (int)infos[i].min, (int)infos[i].max);
+        }
+    }
+
+    // A profile never saved starts from the shared blob, which holds the
+    // settings of whichever profile was saved last (or of the only one
+    // before there were profiles)
+    Preferences prefs;
+    int loaded = -1;
+    int riderProfiles = 0;
+    if (prefs.begin(NVS_NAMESPACE, true)) {
+        loaded = loadBlob(prefs, NVS_KEY, current, false);
+        profile = prefs.getUChar(NVS_PROFILE_KEY, 0);
+        if (profile >= SETTINGS_PROFILE_COUNT) profile = 0;
+        for (uint8_t p = 0; p < SETTINGS_PROFILE_COUNT; p++) {
+            riders[p] = current;
+            if (loadBlob(prefs, NVS_RIDER_KEYS[p], riders[p], true) >= 0) riderProfiles++;
+        }
+        prefs.end();
+    } else {
+        for (uint8_t p = 0; p < SETTINGS_PROFILE_COUNT; p++) riders[p] = current;
+    }
+    copyRider(current, riders[profile]);
+    if (loaded >= 0) {
+        LOG_I(APP, "Settings: %d of %d from NVS, rider %u of %d profiles saved", loaded, SETTING_COUNT,
+              profile + 1, riderProfiles);
+    } else {
+        LOG_I(APP, "Settings: defaults, rider %u", profile + 1);
+    }
+    stored = current;
+    for (uint8_t p = 0; p < SETTINGS_PROFILE_COUNT; p++) storedRiders[p] = riders[p];
+}
+
+const Settings& settings() {
+    return current;
+}
+
+const SettingInfo& settingInfo(SettingId id) {
+    return infos[id < SETTING_COUNT ? id : 0];
+}
+
+int32_t settingValue(SettingId id) {
+    return get(current, id);
+}
+
+bool settingAdjust(SettingId id, int steps) {
+    if (id >= SETTING_COUNT) return false;
+    const SettingInfo& info = infos[id];
+    int32_t value = get(current, id) + steps * info.step;
+    if (value < info.min) value = info.min;
+    if (value > info.max) value = info.max;
+    if (value == get(current, id)) return false;
+    set(current, id, value);
+    return true;
+}
+
+// The selected profile's changes are in current; riders only lags it
+bool settingsModified() {
+    if (memcmp(&current, &stored, sizeof(Settings)) != 0) return true;
+    for (uint8_t p = 0; p < SETTINGS_PROFILE_COUNT; p++) {
+        if (p != profile && riderDiffers(riders[p], storedRiders[p])) return true;
+    }
+    return false;
+}
+
+bool settingsSave() {
+    if (!settingsModified()) return true;
+
+    riders[profile] = current;
+    Preferences prefs;
+    if (!prefs.begin(NVS_NAMESPACE, false)) {
+        LOG_W(APP, "Could not open NVS to store the settings");
+        return false;
+    }
+    bool written = storeBlob(prefs, NVS_KEY, current);
+    for (uint8_t p = 0; p < SETTINGS_PROFILE_COUNT && written; p++) {
+        if (p == profile || riderDiffers(riders[p], storedRiders[p])) {
+            written = storeBlob(prefs, NVS_RIDER_KEYS[p], riders[p]);
+        }
+    }
+    prefs.end();
+    if (!written) {
+        LOG_W(APP, "Could not store the settings");
+        return false;
+    }
+    stored = current;
+    for (uint8_t p = 0; p < SETTINGS_PROFILE_COUNT; p++) storedRiders[p] = riders[p];
+    LOG_I(APP, "Settings saved");
+    return true;
+}
+
+void settingsRevert() {
+    current = stored;
+    for (uint8_t p = 0; p < SETTINGS_PROFILE_COUNT; p++) riders[p] = storedRiders[p];
+}
+
+uint8_t settingsProfile() {
+    return profile;
+}
+
+bool settingsSelectProfile(uint8_t next) {
+    if (next >= SETTINGS_PROFILE_COUNT || next == profile) return false;
+    copyRider(riders[profile], current);
+    copyRider(storedRiders[profile], stored);
+    profile = next;
+    copyRider(current, riders[profile]);
+    copyRider(stored, storedRiders[profile]);
+
+    Preferences prefs;
+    if (prefs.begin(NVS_NAMESPACE, false)) {
+        prefs.putUChar(NVS_PROFILE_KEY, profile);
+        prefs.end();
+    } else {
+        LOG_W(APP, "Could not store the rider profile");
+    }
+    LOG_I(APP, "Rider profile %u", profile + 1);
+    return true;
+}
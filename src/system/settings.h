@@ -0,0 +1,94 @@
+#pragma once
+
+#include <stdint.h>
+
+// Performance, battery, drivetrain and alert settings that can be tuned on the
+// device. They are kept in NVS as one blob, loaded once at boot over the
+// compile-time defaults and read from this struct afterwards; the caller
+// applies a change as soon as it is made, and only a save writes it to
+// flash. UI task only.
+struct __attribute__((packed)) Settings {
+    uint16_t scanSeconds;        // Blocking scan duration
+    uint16_t refreshMs;          // Fastest telemetry poll period
+    uint16_t staleTimeoutMs;     // "No data" and reconnect after this long
+    uint8_t pollPowerHz;         // Poll group rates, 0 = off
+    uint8_t pollTempsHz;
+    uint8_t pollFaultHz;
+    uint8_t targetFps;           // Frame rate cap
+    uint8_t batteryCells;        // In series, for the range estimate
+    uint32_t batteryCapacityMah;
+    uint8_t motorPoles;          // Drivetrain, for speed and distance
+    uint16_t gearRatioX100;
+    uint16_t wheelDiameterMm;
+    uint8_t alertFetTempC;       // Alert thresholds, 0 = off
+    uint8_t alertMotorTempC;
+    uint16_t alertCellMv;        // Per cell, under load
+    uint8_t fahrenheit;          // Units shown: 0 = °C, 1 = °F
+    uint8_t miles;               // 0 = km, km/h, Wh/km; 1 = mi, mph, Wh/mi
+    uint8_t firstPage;           // Layout pages shown, from 1
+    uint8_t pageCount;
+};
+
+enum SettingId : uint8_t {
+    SETTING_SCAN_SECONDS,
+    SETTING_REFRESH_MS,
+    SETTING_STALE_TIMEOUT_MS,
+    SETTING_POLL_POWER_HZ,
+    SETTING_POLL_TEMPS_HZ,
+    SETTING_POLL_FAULT_HZ,
+    SETTING_TARGET_FPS,
+    SETTING_BATTERY_CELLS,
+    SETTING_BATTERY_CAPACITY,
+    SETTING_MOTOR_POLES,
+    SETTING_GEAR_RATIO,
+    SETTING_WHEEL_DIAMETER,
+    SETTING_ALERT_FET_TEMP,
+    SETTING_ALERT_MOTOR_TEMP,
+    SETTING_ALERT_CELL_MV,
+    SETTING_TEMPERATURE_UNIT,
+    SETTING_DISTANCE_UNIT,
+    SETTING_FIRST_PAGE,
+    SETTING_PAGE_COUNT,
+    SETTING_COUNT
+};
+
+struct SettingInfo {
+    const char* name;
+    const char* unit;
+    int32_t min;
+    int32_t max;
+    int32_t step;
+    const char* const* choices;  // Names of the values from min up, nullptr to show the number
+    bool rider;                  // Kept per rider profile
+};
+
+static const uint8_t SETTINGS_PROFILE_COUNT = 4;
+
+// Load the stored settings; any that are missing or out of range take
+// their default
+void settingsBegin(const Settings& defaults);
+
+const Settings& settings();
+const SettingInfo& settingInfo(SettingId id);
+int32_t settingValue(SettingId id);
+
+// Move a setting by a number of steps, clamped to its range. Returns
+// true if it changed.
+bool settingAdjust(SettingId id, int steps);
+
+// True if the settings, of any profile, differ from what is stored
+bool settingsModified();
+
+// Store the settings of every profile. Returns false if NVS could not be written.
+bool settingsSave();
+
+// Go back to the stored settings, of every profile
+void settingsRevert();
+
+// The rider profile in use, from 0
+uint8_t settingsProfile();
+
+// Switch to another rider profile: its settings replace the current
+// profile's, which keep any change not saved yet until it is chosen
+// again. The choice is stored at once. Returns true if it changed.
+bool settingsSelectProfile(uint8_t profile);
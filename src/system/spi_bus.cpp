@@ -0,0 +1,99 @@
+#include "spi_bus.h"
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/event_groups.h>
+#include <freertos/semphr.h>
+#include <string.h>
+
+static const EventBits_t BIT_IDLE = 1 << 0;   // No render is running
+
+static SemaphoreHandle_t busMutex = nullptr;   // Priority inheritance lifts a slice the UI waits on
+static EventGroupHandle_t busEvents = nullptr;
+static portMUX_TYPE statsMux = portMUX_INITIALIZER_UNLOCKED;
+static SpiBusStats stats = {};
+static uint32_t maxWait = 0;
+static uint32_t nextFrameAtMs = 0;             // Earliest start of the next render
+static bool framePlanned = false;
+
+void spiBusBegin(uint32_t maxWaitMs) {
+    if (busMutex) return;
+    maxWait = maxWaitMs;
+    busEvents = xEventGroupCreate();
+    xEventGroupSetBits(busEvents, BIT_IDLE);
+    busMutex = xSemaphoreCreateMutex();
+}
+
+void spiBusRenderBegin() {
+    if (!busMutex) return;
+    xEventGroupClearBits(busEvents, BIT_IDLE);
+    uint32_t started = micros();
+    if (xSemaphoreTake(busMutex, 0) != pdTRUE) {
+        xSemaphoreTake(busMutex, portMAX_DELAY);
+        uint32_t waited = micros() - started;
+        portENTER_CRITICAL(&statsMux);
+        stats.renderWaits++;
+        if (waited > stats.renderWaitMaxUs) stats.renderWaitMaxUs = waited;
+        portEXIT_CRITICAL(&statsMux);
+    }
+}
+
+void spiBusRenderEnd(uint32_t nextFrameMs) {
+    if (!busMutex) return;
+    portENTER_CRITICAL(&statsMux);
+    nextFrameAtMs = millis() + nextFrameMs;
+    framePlanned = true;
+    portEXIT_CRITICAL(&statsMux);
+    xSemaphoreGive(busMutex);
+    xEventGroupSetBits(busEvents, BIT_IDLE);
+}
+
+void spiBusCardBegin(uint32_t sliceMs) {
+    if (!busMutex) return;
+    uint32_t started = millis();
+    bool deferred = false;
+    bool forced = false;
+    for (;;) {
+        uint32_t now = millis();
+        uint32_t waited = now - started;
+        if (waited >= maxWait) {
+            forced = deferred;
+            break;
+        }
+        uint32_t left = maxWait - waited;
+        if (!(xEventGroupGetBits(busEvents) & BIT_IDLE)) {
+            deferred = true;
+            xEventGroupWaitBits(busEvents, BIT_IDLE, pdFALSE, pdTRUE, pdMS_TO_TICKS(left) + 1);
+            continue;
+        }
+        portENTER_CRITICAL(&statsMux);
+        int32_t until = framePlanned ? (int32_t)(nextFrameAtMs - now) : -1;
+        portEXIT_CRITICAL(&statsMux);
+        // A slot already past without a render means the UI is idle
+        if (until < 0 || until >= (int32_t)sliceMs) break;
+        deferred = true;
+        uint32_t sleep = (uint32_t)until < left ? (uint32_t)until : left;
+        vTaskDelay(pdMS_TO_TICKS(sleep) + 1);
+    }
+    xSemaphoreTake(busMutex, portMAX_DELAY);
+
+    uint32_t waited = millis() - started;
+    portENTER_CRITICAL(&statsMux);
+    stats.slices++;
+    if (deferred) stats.slicesDeferred++;
+    if (forced) stats.slicesForced++;
+    stats.cardWaitMs += waited;
+    portEXIT_CRITICAL(&statsMux);
+}
+
+void spiBusCardEnd() {
+    if (busMutex) xSemaphoreGive(busMutex);
+}
+
+SpiBusStats spiBusStats() {
+    SpiBusStats out;
+    portENTER_CRITICAL(&statsMux);
+    out = stats;
+    portEXIT_CRITICAL(&statsMux);
+    return out;
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <stdint.h>
+
+// Hands the SPI bus the LCD shares with the SD card between the UI loop
+// and the storage tasks, with the display first.
+//
+// The SPI driver already keeps single transactions apart, but a card
+// slice is a run of them (data sectors plus FAT updates) and a render a
+// run of sprite pushes, so without this the two interleave transaction
+// by transaction and a frame can end up waiting behind a whole block
+// write. Instead the UI holds the bus for a render, and a storage task
+// holds it for one slice of its transfer at a time. A slice is only
+// started once no render is running and the next render slot is at
+// least the slice's length away, or after maxWaitMs, so a busy screen
+// slows the card down but never stops it. A render waits for at most
+// the one slice already on the bus.
+//
+// Before spiBusBegin() every call returns at once.
+
+struct SpiBusStats {
+    uint32_t slices;            // Card slices run
+    uint32_t slicesDeferred;    // Started late to keep out of a render
+    uint32_t slicesForced;      // Gave up waiting at maxWaitMs
+    uint32_t cardWaitMs;        // Total time slices were held back
+    uint32_t renderWaits;       // Renders that found a slice on the bus
+    uint32_t renderWaitMaxUs;   // Longest such wait
+};
+
+void spiBusBegin(uint32_t maxWaitMs);
+
+// From the UI loop around a render. nextFrameMs is the least time until
+// the next render may start (the frame period).
+void spiBusRenderBegin();
+void spiBusRenderEnd(uint32_t nextFrameMs);
+
+// From a storage task around one slice expected to take sliceMs
+void spiBusCardBegin(uint32_t sliceMs);
+void spiBusCardEnd();
+
+SpiBusStats spiBusStats();
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <atomic>
+
+// Lock-free single-producer/single-consumer byte ring. One task calls
+// push(), one other task calls pop(); neither ever blocks. Capacity must
+// be a power of two.
+template <size_t Capacity>
+class SpscByteQueue {
+    static_assert((Capacity & (Capacity - 1)) == 0, "capacity must be a power of two");
+
+public:
+    SpscByteQueue() : head(0), tail(0) {}
+
+    // Append all of data or nothing. Returns false if there is not enough
+    // room, so a chunk is never split.
+    bool push(const uint8_t* data, size_t length) {
+        uint32_t h = head.load(std::memory_order_relaxed);
+        uint32_t t = tail.load(std::memory_order_acquire);
+        if (length > Capacity - (h - t)) return false;
+
+        size_t start = h & (Capacity - 1);
+        size_t first = Capacity - start;
+        if (first > length) first = length;
+        memcpy(&buffer[start], data, first);
+        memcpy(&buffer[0], data + first, length - first);
+
+        head.store(h + length, std::memory_order_release);
+        return true;
+    }
+
+    // Remove up to maxLength bytes. Returns the number copied.
+    size_t pop(uint8_t* out, size_t maxLength) {
+        uint32_t t = tail.load(std::memory_order_relaxed);
+        uint32_t h = head.load(std::memory_order_acquire);
+        size_t length = h - t;
+        if (length > maxLength) length = maxLength;
+
+        size_t start = t & (Capacity - 1);
+        size_t first = Capacity - start;
+        if (first > length) first = length;
+        memcpy(out, &buffer[start], first);
+        memcpy(out + first, &buffer[0], length - first);
+
+        tail.store(t + length, std::memory_order_release);
+        return length;
+    }
+
+    size_t size() const {
+        return head.load(std::memory_order_acquire) - tail.load(std::memory_order_acquire);
+    }
+
+private:
+    std::atomic<uint32_t> head;   // Written by the producer
+    std::atomic<uint32_t> tail;   // Written by the consumer
+    uint8_t buffer[Capacity];
+};
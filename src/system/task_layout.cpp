@@ -0,0 +1,92 @@
+#include "task_layout.h"
+#include "../log.h"
+
+#include <Arduino.h>
+#include <esp_timer.h>
+
+struct BudgetState {
+    uint32_t startedMs;
+    bool busy;
+    bool reportedStuck;      // Logged while still running; once per unit
+    uint32_t overranMs;      // A finished unit's length waiting to be logged, 0 if none
+};
+
+static portMUX_TYPE budgetMux = portMUX_INITIALIZER_UNLOCKED;
+static BudgetState budgets[TASK_COUNT];
+static uint32_t totalOverruns = 0;
+static esp_timer_handle_t checkTimer = nullptr;
+
+// On the esp_timer task, above every task here, so a stalled task
+// cannot hold the report back
+static void checkBudgets(void* arg) {
+    uint32_t now = millis();
+    for (uint8_t i = 0; i < TASK_COUNT; i++) {
+        uint32_t budget = TASK_PLACEMENT[i].budgetMs;
+        if (budget == 0) continue;
+        bool stuck = false;
+        uint32_t runningMs = 0;
+        uint32_t finishedMs = 0;
+        portENTER_CRITICAL(&budgetMux);
+        BudgetState& state = budgets[i];
+        runningMs = now - state.startedMs;
+        if (state.busy && !state.reportedStuck && runningMs > budget) {
+            state.reportedStuck = true;
+            totalOverruns++;
+            stuck = true;
+        }
+        finishedMs = state.overranMs;
+        state.overranMs = 0;
+        portEXIT_CRITICAL(&budgetMux);
+
+        if (stuck) {
+            LOG_W(APP, "Task %s has run for %u ms, budget %u ms", TASK_PLACEMENT[i].name, runningMs, budget);
+        }
+        if (finishedMs) {
+            LOG_W(APP, "Task %s took %u ms, budget %u ms", TASK_PLACEMENT[i].name, finishedMs, budget);
+        }
+    }
+}
+
+void taskBudgetBegin() {
+    if (checkTimer) return;
+    esp_timer_create_args_t args;
+    args.callback = checkBudgets;
+    args.arg = nullptr;
+    args.dispatch_method = ESP_TIMER_TASK;
+    args.name = "task_budget";
+    args.skip_unhandled_events = true;
+    if (esp_timer_create(&args, &checkTimer) != ESP_OK ||
+        esp_timer_start_periodic(checkTimer, TASK_BUDGET_CHECK_MS * 1000ull) != ESP_OK) {
+        LOG_E(APP, "Could not start the task budget watchdog");
+    }
+}
+
+void taskBudgetStart(TaskId task) {
+    if (TASK_PLACEMENT[task].budgetMs == 0) return;
+    uint32_t now = millis();
+    portENTER_CRITICAL(&budgetMux);
+    budgets[task].startedMs = now;
+    budgets[task].busy = true;
+    budgets[task].reportedStuck = false;
+    portEXIT_CRITICAL(&budgetMux);
+}
+
+void taskBudgetEnd(TaskId task) {
+    uint32_t budget = TASK_PLACEMENT[task].budgetMs;
+    if (budget == 0) return;
+    uint32_t now = millis();
+    portENTER_CRITICAL(&budgetMux);
+    BudgetState& state = budgets[task];
+    uint32_t elapsed = now - state.startedMs;
+    // A unit already reported as stuck is not counted twice
+    if (state.busy && elapsed > budget) {
+        state.overranMs = elapsed;
+        if (!state.reportedStuck) totalOverruns++;
+    }
+    state.busy = false;
+    portEXIT_CRITICAL(&budgetMux);
+}
+
+uint32_t taskBudgetOverruns() {
+    return totalOverruns;
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <stdint.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+// Every task the dashboard starts, in one place.
+//
+// Core 0 carries the radios: Bluedroid and WiFi, the tasks that call
+// them (connect and scan, the WebSocket stream, the log upload) and the
+// decoder that turns their bytes into telemetry. loop() never calls the
+// BLE stack itself; connect and scan requests are queued to vesc_conn.
+// Core 1 carries what the rider sees and touches: loop() renders and
+// reads the buttons, and the I2C bus task runs every Wire1 transaction
+// for it and for the sensor and IMU tasks (see i2c_bus.h). Work that can
+// wait (storage, alert outputs, sound) runs at priority 1 and gets what
+// the others leave.
+//
+// Priorities, highest first: the BT controller and host tasks (set by
+// the SDK, far above these), the decoder (3), the connection task, the
+// BLE bring-up and the I2C bus (2), then loop() and everything else (1).
+//
+// A task with a budget brackets each unit of its work with
+// taskBudgetStart() and taskBudgetEnd(). A watchdog timer looks at every
+// task each TASK_BUDGET_CHECK_MS and logs one that is still inside a unit
+// past its budget, and any unit that ended over it, so a stall shows up
+// by name instead of as a frozen screen.
+enum TaskId : uint8_t {
+    TASK_UI,                 // loop(): input, polls and rendering
+    TASK_BLE_INIT,           // Brings up the BLE stack during setup()
+    TASK_VESC_RX,            // Frames and dispatches received bytes
+    TASK_VESC_CONN,          // Scan, connect, reconnect
+    TASK_LIVE_STREAM,        // WebSocket clients
+    TASK_LOG_UPLOAD,         // Logs to the server over WiFi
+    TASK_FIRMWARE,           // Firmware images from the server over WiFi
+    TASK_LOG_SERVICE,        // Logs to a phone over the BLE log service
+    TASK_SD_LOG,             // Telemetry log blocks to the SD card
+    TASK_LOG_REVIEW,         // Decodes logs from the SD card for the review screen
+    TASK_LOG_PLAYBACK,       // Plays a log from the SD card back into the dashboard
+    TASK_SCREENSHOT,         // Screenshots to the SD card
+    TASK_RIDE_STATS,         // Trip statistics to NVS
+    TASK_ODOMETER,           // Lifetime totals to NVS
+    TASK_SENSORS,            // AXP192 and IMU sampling
+    TASK_GPS,                // GPS receiver on the UART
+    TASK_IMU,                // MPU6886 FIFO and the attitude filter
+    TASK_I2C_BUS,            // Every transaction on the internal I2C bus
+    TASK_WIRED_RX,           // A VESC wired to a UART or the CAN bus
+    TASK_ALERTS,             // Alert outputs and their repeats
+    TASK_AUDIO,              // Clips to the speaker
+    TASK_COUNT
+};
+
+struct TaskPlacement {
+    const char* name;
+    BaseType_t core;
+    UBaseType_t priority;
+    uint32_t budgetMs;       // Longest unit of work, 0 if not watched
+};
+
+static const TaskPlacement TASK_PLACEMENT[TASK_COUNT] = {
+    { "loopTask",    1, 1, 200 },    // Set by the Arduino core; a full redraw is ~50 ms
+    { "ble_init",    0, 2, 0 },
+    { "vesc_rx",     0, 3, 20 },     // Below the BT host tasks on the same core
+    { "vesc_conn",   0, 2, 30000 },  // A scan or a connect blocks for seconds
+    { "live_stream", 0, 1, 100 },
+    { "log_upload",  0, 1, 0 },      // A file upload takes as long as it takes
+    { "fw_update",   0, 1, 0 },      // So does an image download
+    { "log_service", 0, 1, 0 },      // So does a download to a phone
+    { "sd_log",      0, 1, 500 },    // Slow cards stall a write for a few hundred ms
+    { "log_review",  0, 1, 0 },      // A window reads as much of the card as it spans
+    { "log_playback", 0, 1, 0 },     // Waits out the time between samples
+    { "screenshot",  0, 1, 0 },      // A whole frame, a slice at a time
+    { "ride_stats",  0, 1, 500 },    // One NVS write
+    { "odometer",    0, 1, 500 },    // One NVS write
+    { "sensors",     1, 1, 50 },
+    { "gps",         1, 1, 20 },     // Parses what one UART event brought
+    { "imu",         1, 1, 20 },     // A FIFO read and a few dozen filter steps
+    { "i2c_bus",     1, 2, 20 },     // One job; above loop() so a touch read starts at once
+    { "wired_rx",    0, 3, 20 },     // Stands in for the BT host: only queues the bytes
+    { "alerts",      0, 1, 0 },      // Sleeps out the repeat period
+    { "audio",       0, 1, 0 },      // Blocks on the I2S DMA
+};
+
+static const uint32_t TASK_BUDGET_CHECK_MS = 100;
+
+// Start the watchdog timer. Call once from setup().
+void taskBudgetBegin();
+
+// A unit of work begins or ends on the calling task. Cheap, safe from
+// any task, and a no-op for tasks without a budget.
+void taskBudgetStart(TaskId task);
+void taskBudgetEnd(TaskId task);
+
+// Units that ran over their budget since boot, over all tasks
+uint32_t taskBudgetOverruns();
@@ -0,0 +1,117 @@
+#include "wall_clock.h"
+#include "i2c_bus.h"
+#include "../log.h"
+
+#include <M5Core2.h>
+#include <esp_sntp.h>
+#include <esp_timer.h>
+#include <sys/time.h>
+#include <time.h>
+
+static const uint16_t RTC_MIN_YEAR = 2024;   // Anything earlier is an RTC that was never set
+
+static portMUX_TYPE clockMux = portMUX_INITIALIZER_UNLOCKED;
+static int64_t offsetUs = 0;                 // Unix time minus esp_timer time
+static volatile WallClockSource source = WALL_CLOCK_NONE;
+static volatile bool rtcWritePending = false;
+
+struct RtcDateTime {
+    RTC_DateTypeDef date;
+    RTC_TimeTypeDef time;
+};
+
+// Days from 1970-01-01 to a civil date (proleptic Gregorian)
+static int32_t daysFromCivil(int32_t year, int32_t month, int32_t day) {
+    year -= month <= 2;
+    int32_t era = (year >= 0 ? year : year - 399) / 400;
+    int32_t yearOfEra = year - era * 400;
+    int32_t dayOfYear = (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 + day - 1;
+    int32_t dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+    return era * 146097 + dayOfEra - 719468;
+}
+
+static void setOffset(int64_t unixUs, WallClockSource from) {
+    int64_t offset = unixUs - esp_timer_get_time();
+    portENTER_CRITICAL(&clockMux);
+    offsetUs = offset;
+    source = from;
+    portEXIT_CRITICAL(&clockMux);
+}
+
+// Runs on the lwIP task once SNTP has set the system time
+static void onNtpSync(struct timeval* tv) {
+    setOffset((int64_t)tv->tv_sec * 1000000 + tv->tv_usec, WALL_CLOCK_NTP);
+    rtcWritePending = true;
+    LOG_I(APP, "Clock synced from NTP");
+}
+
+// On the bus task
+static void readRtc(void* context) {
+    RtcDateTime& now = *(RtcDateTime*)context;
+    M5.Rtc.GetDate(&now.date);
+    M5.Rtc.GetTime(&now.time);
+}
+
+static void writeRtc(void* context) {
+    RtcDateTime& now = *(RtcDateTime*)context;
+    M5.Rtc.SetDate(&now.date);
+    M5.Rtc.SetTime(&now.time);
+}
+
+void wallClockBegin() {
+    RtcDateTime now;
+    i2cBusRun(I2C_PRIORITY_SLOW, readRtc, &now);
+    const RTC_DateTypeDef& date = now.date;
+    const RTC_TimeTypeDef& time = now.time;
+    if (date.Year < RTC_MIN_YEAR || date.Month < 1 || date.Month > 12 || date.Date < 1 || date.Date > 31 ||
+        time.Hours > 23 || time.Minutes > 59 || time.Seconds > 59) {
+        LOG_W(APP, "RTC not set, logs carry no wall-clock time until NTP syncs");
+        return;
+    }
+    int64_t seconds = (int64_t)daysFromCivil(date.Year, date.Month, date.Date) * 86400 +
+                      time.Hours * 3600 + time.Minutes * 60 + time.Seconds;
+    setOffset(seconds * 1000000, WALL_CLOCK_RTC);
+
+    struct timeval tv = { (time_t)seconds, 0 };
+    settimeofday(&tv, nullptr);
+    LOG_I(APP, "RTC: %04u-%02u-%02u %02u:%02u:%02u UTC", date.Year, date.Month, date.Date, time.Hours,
+          time.Minutes, time.Seconds);
+}
+
+void wallClockStartNtp(const char* ntpServer) {
+    if (!ntpServer || !ntpServer[0]) return;
+    sntp_set_time_sync_notification_cb(onNtpSync);
+    configTime(0, 0, ntpServer);
+}
+
+void wallClockService() {
+    if (!rtcWritePending) return;
+    rtcWritePending = false;
+
+    struct timeval tv;
+    gettimeofday(&tv, nullptr);
+    struct tm utc;
+    gmtime_r(&tv.tv_sec, &utc);
+    RtcDateTime now;
+    now.date.WeekDay = utc.tm_wday;
+    now.date.Month = utc.tm_mon + 1;
+    now.date.Date = utc.tm_mday;
+    now.date.Year = utc.tm_year + 1900;
+    now.time.Hours = utc.tm_hour;
+    now.time.Minutes = utc.tm_min;
+    now.time.Seconds = utc.tm_sec;
+    i2cBusRun(I2C_PRIORITY_SLOW, writeRtc, &now);
+}
+
+uint64_t wallClockUnixMs(uint64_t monotonicUs) {
+    portENTER_CRITICAL(&clockMux);
+    int64_t offset = offsetUs;
+    WallClockSource from = source;
+    portEXIT_CRITICAL(&clockMux);
+    if (from == WALL_CLOCK_NONE) return 0;
+    return (uint64_t)((int64_t)monotonicUs + offset) / 1000;
+}
+
+WallClockSource wallClockSource() {
+    return source;
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <stdint.h>
+
+// Wall-clock time for logs, without touching the I2C RTC per sample.
+//
+// At boot the BM8563 RTC is read once and the result is kept as an
+// offset from esp_timer time (which millis() and the sample timestamps
+// come from), so turning a timestamp into UTC is one addition. The RTC
+// only counts whole seconds, so this mapping is within a second.
+//
+// With an NTP server set, SNTP runs whenever WiFi is up (the log upload
+// or the live stream bring it up) and each sync replaces the offset. The
+// synced time is written back to the RTC from the sensor task, as a slow
+// job on the I2C bus task, so the next boot starts from it.
+
+enum WallClockSource : uint8_t {
+    WALL_CLOCK_NONE,         // RTC unset or unreadable, and no NTP sync yet
+    WALL_CLOCK_RTC,
+    WALL_CLOCK_NTP
+};
+
+// Read the RTC and set the system time from it. Call once from setup(),
+// after M5.begin() and before the sensor task starts.
+void wallClockBegin();
+
+// Sync from ntpServer while WiFi is connected. Call after WiFi has been
+// set up to start; SNTP keeps retrying until the network is there.
+void wallClockStartNtp(const char* ntpServer);
+
+// Write a fresh NTP time to the RTC if there is one. Called from the
+// sensor task.
+void wallClockService();
+
+// UTC milliseconds since 1970 at an esp_timer time, 0 if the wall clock
+// is not known
+uint64_t wallClockUnixMs(uint64_t monotonicUs);
+
+WallClockSource wallClockSource();
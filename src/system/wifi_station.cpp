@@ -0,0 +1,58 @@
+#include "wifi_station.h"
+#include "../log.h"
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include <esp_coexist.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
+
+static uint8_t users = 0;                     // One bit per WifiStationUser
+static bool joined = false;                   // We brought the station up
+static wifi_mode_t modeBefore = WIFI_OFF;     // What to go back to, e.g. the live stream's AP
+
+// WiFi calls block, so the users are serialized with a mutex rather than
+// a spinlock
+static SemaphoreHandle_t stationLock() {
+    static SemaphoreHandle_t lock = xSemaphoreCreateMutex();
+    return lock;
+}
+
+void wifiStationWant(WifiStationUser user, const char* ssid, const char* password) {
+    xSemaphoreTake(stationLock(), portMAX_DELAY);
+    users |= 1u << user;
+    if (!joined && WiFi.status() != WL_CONNECTED) {
+        joined = true;
+        modeBefore = WiFi.getMode();
+        WiFi.mode(modeBefore == WIFI_AP ? WIFI_AP_STA : WIFI_STA);
+        // Bluetooth needs modem sleep to share the radio, and the BLE links
+        // get the antenna whenever both want it
+        WiFi.setSleep(true);
+        esp_coex_preference_set(ESP_COEX_PREFER_BT);
+        WiFi.begin(ssid, password);
+        LOG_I(APP, "WiFi: joining %s", ssid);
+    }
+    xSemaphoreGive(stationLock());
+}
+
+void wifiStationRelease(WifiStationUser user) {
+    xSemaphoreTake(stationLock(), portMAX_DELAY);
+    users &= ~(1u << user);
+    if (users == 0 && joined) {
+        joined = false;
+        WiFi.disconnect(modeBefore == WIFI_OFF);
+        WiFi.mode(modeBefore);
+        LOG_I(APP, "WiFi: left the network");
+    }
+    xSemaphoreGive(stationLock());
+}
+
+bool wifiStationWait(uint32_t timeoutMs, const volatile bool& keepWaiting) {
+    uint32_t started = millis();
+    while (WiFi.status() != WL_CONNECTED) {
+        if (!keepWaiting || millis() - started >= timeoutMs) return false;
+        vTaskDelay(pdMS_TO_TICKS(100));
+    }
+    return true;
+}
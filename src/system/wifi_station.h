@@ -0,0 +1,26 @@
+#pragma once
+
+#include <stdint.h>
+
+// The WiFi station shared by the background tasks that talk to the depot
+// network: the log upload and the firmware update. The first user to want
+// it brings it up, with modem sleep and the coexistence arbiter set to
+// prefer Bluetooth; the last to let go takes it down again, so one task
+// finishing never cuts the other off mid-transfer. A station that was
+// already connected when the first user came (the live stream's) is used
+// as it is and left up.
+enum WifiStationUser : uint8_t {
+    WIFI_USER_LOG_UPLOAD,
+    WIFI_USER_FIRMWARE,
+    WIFI_USER_COUNT
+};
+
+// The user wants the station; joins ssid if nobody has it up yet
+void wifiStationWant(WifiStationUser user, const char* ssid, const char* password);
+
+// The user is done with it
+void wifiStationRelease(WifiStationUser user);
+
+// Wait for the station to connect, for at most timeoutMs or while
+// keepWaiting holds. Returns true once connected.
+bool wifiStationWait(uint32_t timeoutMs, const volatile bool& keepWaiting);
@@ -0,0 +1,209 @@
+#include "alerts.h"
+#include "telemetry.h"
+#include "../system/perf_stats.h"
+#include "../log.h"
+#include "../system/task_layout.h"
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <stddef.h>
+
+static const uint32_t TASK_STACK_SIZE = 3072;
+static const TaskPlacement& PLACEMENT = TASK_PLACEMENT[TASK_ALERTS];
+
+// Where each quantity lives in VescValues. Pack quantities are the
+// dashboard's totals and are only checked on controller 0's combined
+// sample; the rest are checked per controller.
+struct QuantityInfo {
+    uint8_t offset;
+    uint8_t width;               // Bytes: 1, 2 or 4, all signed but the fault code
+    bool pack;
+    uint32_t field;
+};
+
+static const QuantityInfo QUANTITIES[ALERT_Q_COUNT] = {
+    { offsetof(VescValues, tempFet),      2, false, VALUES_FIELD_TEMP_FET },
+    { offsetof(VescValues, tempMotor),    2, false, VALUES_FIELD_TEMP_MOTOR },
+    { offsetof(VescValues, vIn),          2, false, VALUES_FIELD_V_IN },
+    { offsetof(VescValues, currentIn),    4, true,  VALUES_FIELD_CURRENT_IN },
+    { offsetof(VescValues, currentMotor), 4, false, VALUES_FIELD_CURRENT_MOTOR },
+    { offsetof(VescValues, dutyNow),      2, false, VALUES_FIELD_DUTY },
+    { offsetof(VescValues, rpm),          4, false, VALUES_FIELD_RPM },
+    { offsetof(VescValues, faultCode),    1, false, VALUES_FIELD_FAULT },
+    { offsetof(VescValues, soc),          2, true,  VALUES_FIELD_V_IN },
+    { offsetof(VescValues, derateSeconds), 2, true, VALUES_FIELD_TEMP_FET },
+    { offsetof(VescValues, formula[0]),   4, true,  VALUES_FIELD_FORMULA },
+    { offsetof(VescValues, formula[1]),   4, true,  VALUES_FIELD_FORMULA },
+    { offsetof(VescValues, imuPitch),     2, true,  VALUES_FIELD_IMU },
+    { offsetof(VescValues, imuAccel),     2, true,  VALUES_FIELD_IMU },
+};
+
+// One comparison, ready to run on a raw sample
+struct CompiledRule {
+    uint8_t offset;
+    uint8_t width;
+    uint8_t compare;
+    uint8_t outputs;
+    bool pack;
+    uint32_t field;
+    int32_t set;                 // Level an inactive rule compares against
+    int32_t clear;               // ...and an active one, the threshold moved by the hysteresis
+    AudioClip clip;
+    HapticPattern haptic;
+    const char* name;
+};
+
+static portMUX_TYPE alertsMux = portMUX_INITIALIZER_UNLOCKED;
+static CompiledRule rules[ALERT_MAX_RULES];
+static uint8_t ruleCount = 0;
+static uint32_t states[TELEMETRY_MAX_CONTROLLERS];   // Active rules per controller
+static volatile uint32_t activeMask = 0;
+static volatile uint8_t activeOutputs = 0;            // ALERT_OUT_* of the active rules
+static volatile AudioClip activeClip = AUDIO_CLIP_ALERT; // Of the first active rule that beeps
+static volatile HapticPattern activeHaptic = HAPTIC_PULSE; // Of the first active rule that vibrates
+static AlertOutputSettings outputSettings;
+static TaskHandle_t outputTask = nullptr;
+
+static int32_t load(const VescValues& values, const CompiledRule& rule) {
+    const uint8_t* p = (const uint8_t*)&values + rule.offset;
+    switch (rule.width) {
+        case 1:  return *p;
+        case 2:  return *(const int16_t*)p;
+        default: return *(const int32_t*)p;
+    }
+}
+
+// Recompute the totals over the controllers. Returns the newly active
+// rules. Call with the lock held.
+static uint32_t combine() {
+    uint32_t mask = 0;
+    for (uint8_t c = 0; c < TELEMETRY_MAX_CONTROLLERS; c++) mask |= states[c];
+    uint8_t outputs = 0;
+    for (uint8_t i = 0; i < ruleCount; i++) {
+        if (!(mask & (1u << i))) continue;
+        if ((rules[i].outputs & ~outputs) & ALERT_OUT_BEEP) activeClip = rules[i].clip;
+        if ((rules[i].outputs & ~outputs) & ALERT_OUT_VIBRATE) activeHaptic = rules[i].haptic;
+        outputs |= rules[i].outputs;
+    }
+    uint32_t risen = mask & ~activeMask;
+    activeMask = mask;
+    activeOutputs = outputs;
+    return risen;
+}
+
+static void play(uint8_t outputs) {
+    if (outputSettings.sound && (outputs & ALERT_OUT_BEEP)) audioPlay(activeClip);
+    if (outputSettings.vibrate && (outputs & ALERT_OUT_VIBRATE)) hapticsPlay(activeHaptic);
+}
+
+// Sleep until a rule that sounds is active, then sound it every repeatMs
+// for as long as one is
+static void outputLoop(void* arg) {
+    for (;;) {
+        if (!(activeOutputs & (ALERT_OUT_BEEP | ALERT_OUT_VIBRATE))) {
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+            continue;
+        }
+        play(activeOutputs);
+        vTaskDelay(pdMS_TO_TICKS(outputSettings.repeatMs));
+    }
+}
+
+void alertsBegin(const AlertOutputSettings& output) {
+    outputSettings = output;
+    xTaskCreatePinnedToCore(outputLoop, PLACEMENT.name, TASK_STACK_SIZE, nullptr, PLACEMENT.priority, &outputTask, PLACEMENT.core);
+    perfWatchTask(outputTask, MEMORY_TAG_TELEMETRY);
+}
+
+void alertsConfigure(const AlertRule* source, uint8_t count) {
+    if (count > ALERT_MAX_RULES) {
+        LOG_W(APP, "%d alert rules, only the first %d are kept", count, ALERT_MAX_RULES);
+        count = ALERT_MAX_RULES;
+    }
+    CompiledRule compiled[ALERT_MAX_RULES];
+    for (uint8_t i = 0; i < count; i++) {
+        const AlertRule& rule = source[i];
+        const QuantityInfo& q = QUANTITIES[rule.quantity < ALERT_Q_COUNT ? rule.quantity : 0];
+        CompiledRule& c = compiled[i];
+        c.offset = q.offset;
+        c.width = q.width;
+        c.compare = rule.compare;
+        c.outputs = rule.outputs;
+        c.pack = q.pack;
+        c.field = q.field;
+        c.set = rule.threshold;
+        switch (rule.compare) {
+            case ALERT_ABOVE: c.clear = rule.threshold - rule.hysteresis; break;
+            case ALERT_BELOW: c.clear = rule.threshold + rule.hysteresis; break;
+            default:          c.clear = rule.threshold; break;
+        }
+        c.clip = rule.clip;
+        c.haptic = rule.haptic;
+        c.name = rule.name;
+    }
+    portENTER_CRITICAL(&alertsMux);
+    for (uint8_t i = 0; i < count; i++) rules[i] = compiled[i];
+    ruleCount = count;
+    for (uint8_t c = 0; c < TELEMETRY_MAX_CONTROLLERS; c++) states[c] = 0;
+    combine();
+    portEXIT_CRITICAL(&alertsMux);
+    LOG_D(APP, "%d alert rules", count);
+}
+
+void alertsEvaluate(uint8_t controller, const VescValues& values, const VescValues& combined) {
+    if (controller >= TELEMETRY_MAX_CONTROLLERS) return;
+    portENTER_CRITICAL(&alertsMux);
+    uint32_t state = states[controller];
+    for (uint8_t i = 0; i < ruleCount; i++) {
+        const CompiledRule& rule = rules[i];
+        if (rule.pack && controller != 0) continue;
+        const VescValues& sample = rule.pack ? combined : values;
+        if (!(sample.fields & rule.field)) continue;
+        uint32_t bit = 1u << i;
+        int32_t value = load(sample, rule);
+        int32_t level = (state & bit) ? rule.clear : rule.set;
+        bool active;
+        switch (rule.compare) {
+            case ALERT_ABOVE: active = value > level; break;
+            case ALERT_BELOW: active = value < level; break;
+            default:          active = value != level; break;
+        }
+        if (active) state |= bit; else state &= ~bit;
+    }
+    uint32_t risen = 0;
+    if (state != states[controller]) {
+        states[controller] = state;
+        risen = combine();
+    }
+    bool sounds = risen && (activeOutputs & (ALERT_OUT_BEEP | ALERT_OUT_VIBRATE));
+    portEXIT_CRITICAL(&alertsMux);
+
+    for (uint8_t i = 0; risen; i++, risen >>= 1) {
+        if (risen & 1) LOG_W(APP, "Alert: %s (VESC %d)", rules[i].name, controller);
+    }
+    if (sounds && outputTask) xTaskNotifyGive(outputTask);
+}
+
+void alertsClear() {
+    portENTER_CRITICAL(&alertsMux);
+    for (uint8_t c = 0; c < TELEMETRY_MAX_CONTROLLERS; c++) states[c] = 0;
+    combine();
+    portEXIT_CRITICAL(&alertsMux);
+}
+
+uint32_t alertsActive() {
+    return activeMask;
+}
+
+const char* alertsShown() {
+    const char* name = nullptr;
+    portENTER_CRITICAL(&alertsMux);
+    for (uint8_t i = 0; i < ruleCount; i++) {
+        if ((activeMask & (1u << i)) && (rules[i].outputs & ALERT_OUT_COLOR)) {
+            name = rules[i].name;
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&alertsMux);
+    return name;
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <stdint.h>
+#include "vesc/values.h"
+#include "system/audio.h"
+#include "system/haptics.h"
+
+// Quantities a rule can watch, each a raw VescValues field in its own
+// units (values.h)
+enum AlertQuantity : uint8_t {
+    ALERT_Q_TEMP_FET,        // 0.1 °C
+    ALERT_Q_TEMP_MOTOR,      // 0.1 °C
+    ALERT_Q_V_IN,            // 0.1 V
+    ALERT_Q_CURRENT_IN,      // 0.01 A
+    ALERT_Q_CURRENT_MOTOR,   // 0.01 A
+    ALERT_Q_DUTY,            // 0.001
+    ALERT_Q_RPM,             // ERPM
+    ALERT_Q_FAULT,           // mc_fault_code
+    ALERT_Q_SOC,             // 0.1 %
+    ALERT_Q_DERATE,          // s until thermal derating, VALUES_DERATE_NONE if not in sight
+    ALERT_Q_FORMULA1,        // 0.001 of the first formula's units (telemetry/formula.h)
+    ALERT_Q_FORMULA2,        // ...and of the second
+    ALERT_Q_PITCH,           // 0.1 degree nose up, from the IMU (telemetry/imu.h)
+    ALERT_Q_ACCEL,           // 0.01 g forward
+    ALERT_Q_COUNT
+};
+
+enum AlertCompare : uint8_t {
+    ALERT_ABOVE,             // Active above the threshold
+    ALERT_BELOW,             // Active below it
+    ALERT_NOT_EQUAL          // Active while different from it
+};
+
+// What an active rule drives
+#define ALERT_OUT_COLOR   0x01   // Status line in red with the rule's name
+#define ALERT_OUT_BEEP    0x02
+#define ALERT_OUT_VIBRATE 0x04
+
+struct AlertRule {
+    const char* name;            // Shown on the status line; must outlive the rules
+    AlertQuantity quantity;
+    AlertCompare compare;
+    int32_t threshold;           // Raw units of the quantity
+    int32_t hysteresis;          // Clears only once back past the threshold by this
+    uint8_t outputs;             // ALERT_OUT_*
+    AudioClip clip;              // Played for ALERT_OUT_BEEP
+    HapticPattern haptic;        // Played for ALERT_OUT_VIBRATE
+};
+
+struct AlertOutputSettings {
+    bool sound;                  // Play the rules' clips (audio.h)
+    bool vibrate;                // Play the rules' vibration patterns (haptics.h)
+    uint32_t repeatMs;           // Least time between two outputs
+};
+
+#define ALERT_MAX_RULES 16
+
+// Threshold alerts on the decoded telemetry.
+//
+// The rules are compiled once, when the settings are applied, into a
+// flat array of comparisons: each holds the offset and width of its
+// VescValues field, the field bit, and the raw levels it sets and clears
+// at. Evaluating a sample is then a load and two compares per rule, with
+// no lookups by name, and runs for every decoded reply of every
+// controller. A rule only looks at replies that carried its field, and it
+// is active while it is active on any controller.
+//
+// A low-priority task starts the outputs, so the decoder never waits on
+// them: clips are queued to the audio player and vibration patterns
+// handed to the haptics timer, neither of which blocks. A rule going
+// active is signalled at once with the clip and pattern of the first
+// active rule that sounds or vibrates; while one stays active it is
+// repeated every repeatMs, and outputs never come closer together than
+// that.
+
+// Start the output task. Call once from setup(), after audioBegin() and
+// hapticsBegin() if those outputs are wanted.
+void alertsBegin(const AlertOutputSettings& output);
+
+// Compile a new set of rules; rules beyond ALERT_MAX_RULES are dropped.
+// Every rule starts inactive.
+void alertsConfigure(const AlertRule* rules, uint8_t count);
+
+// Check one controller's decoded sample, and for controller 0 the pack
+// quantities (input current, charge) on the combined sample. Called from
+// the decoding task.
+void alertsEvaluate(uint8_t controller, const VescValues& values, const VescValues& combined);
+
+// Drop every active alert, e.g. once the VESCs are gone
+void alertsClear();
+
+// Bit per active rule, in the order they were configured
+uint32_t alertsActive();
+
+// Name of the first active rule with ALERT_OUT_COLOR, nullptr if none
+const char* alertsShown();
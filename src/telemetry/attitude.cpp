@@ -0,0 +1,88 @@
+#include "attitude.h"
+
+#include <math.h>
+
+static const float DEGREES = 57.29578f;
+
+AttitudeFilter::AttitudeFilter(float kp, float ki, float gateG) : twoKp(2 * kp), twoKi(2 * ki), gateG(gateG) {
+    reset();
+}
+
+void AttitudeFilter::reset() {
+    isStarted = false;
+    q0 = 1;
+    q1 = q2 = q3 = 0;
+    integralX = integralY = integralZ = 0;
+    forwardG = 0;
+}
+
+void AttitudeFilter::update(float gx, float gy, float gz, float ax, float ay, float az, float dt) {
+    float magnitude = sqrtf(ax * ax + ay * ay + az * az);
+    if (!isStarted) {
+        if (magnitude == 0) return;
+        // Level from gravity, facing wherever it faces
+        float halfRoll = 0.5f * atan2f(ay, az);
+        float halfPitch = 0.5f * atan2f(-ax, sqrtf(ay * ay + az * az));
+        float cr = cosf(halfRoll), sr = sinf(halfRoll);
+        float cp = cosf(halfPitch), sp = sinf(halfPitch);
+        q0 = cr * cp;
+        q1 = sr * cp;
+        q2 = cr * sp;
+        q3 = -sr * sp;
+        isStarted = true;
+    }
+
+    // Gravity where the estimate has it, half length
+    float halfVx = q1 * q3 - q0 * q2;
+    float halfVy = q0 * q1 + q2 * q3;
+    float halfVz = q0 * q0 - 0.5f + q3 * q3;
+
+    if (magnitude > 0 && fabsf(magnitude - 1) <= gateG) {
+        float inverse = 1 / magnitude;
+        float nx = ax * inverse, ny = ay * inverse, nz = az * inverse;
+        // Error: the cross product of the measured and estimated gravity
+        float halfEx = ny * halfVz - nz * halfVy;
+        float halfEy = nz * halfVx - nx * halfVz;
+        float halfEz = nx * halfVy - ny * halfVx;
+        if (twoKi > 0) {
+            integralX += twoKi * halfEx * dt;
+            integralY += twoKi * halfEy * dt;
+            integralZ += twoKi * halfEz * dt;
+            gx += integralX;
+            gy += integralY;
+            gz += integralZ;
+        }
+        gx += twoKp * halfEx;
+        gy += twoKp * halfEy;
+        gz += twoKp * halfEz;
+    }
+
+    gx *= 0.5f * dt;
+    gy *= 0.5f * dt;
+    gz *= 0.5f * dt;
+    float a = q0, b = q1, c = q2;
+    q0 += -b * gx - c * gy - q3 * gz;
+    q1 += a * gx + c * gz - q3 * gy;
+    q2 += a * gy - b * gz + q3 * gx;
+    q3 += a * gz + b * gy - c * gx;
+    float norm = 1 / sqrtf(q0 * q0 + q1 * q1 + q2 * q2 + q3 * q3);
+    q0 *= norm;
+    q1 *= norm;
+    q2 *= norm;
+    q3 *= norm;
+
+    forwardG = ax - 2 * (q1 * q3 - q0 * q2);
+}
+
+// x forward, y to the left and z up: nose up turns x towards gravity's
+// reaction, so the sine of the pitch is gravity's x
+float AttitudeFilter::pitch() const {
+    float s = 2 * (q1 * q3 - q0 * q2);
+    if (s > 1) s = 1;
+    if (s < -1) s = -1;
+    return asinf(s) * DEGREES;
+}
+
+float AttitudeFilter::roll() const {
+    return atan2f(2 * (q0 * q1 + q2 * q3), q0 * q0 - q1 * q1 - q2 * q2 + q3 * q3) * DEGREES;
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <stdint.h>
+
+// Pitch, roll and forward acceleration from a six-axis IMU, by Mahony's
+// complementary filter on a quaternion.
+//
+// The gyro is integrated each sample, and the accelerometer's measure of
+// gravity pulls the estimate back by a proportional and a slow integral
+// term, so gyro drift cancels out and vibration does not. A sample whose
+// acceleration strays from 1 g by more than the gate (braking, a bump)
+// is integrated without that correction: gravity cannot be told from the
+// push then. The first sample sets the attitude from gravity alone.
+//
+// The M5Core2 library's MahonyAHRS has its rate fixed at 25 Hz and its
+// state in globals; this runs at any rate, with the step given per
+// sample, and keeps its state per instance. Axes are the sensor's, x
+// forward, y to the left and z up, readings at rest +1 g on z. Not
+// thread safe.
+class AttitudeFilter {
+public:
+    AttitudeFilter(float kp, float ki, float gateG);
+
+    void reset();
+
+    // One sample: rates in rad/s, accelerations in g, step in seconds
+    void update(float gx, float gy, float gz, float ax, float ay, float az, float dt);
+
+    bool started() const { return isStarted; }
+
+    // Degrees: nose up and right side down positive
+    float pitch() const;
+    float roll() const;
+
+    // Acceleration along x with gravity taken out, in g, for the last sample
+    float forward() const { return forwardG; }
+
+private:
+    float twoKp;
+    float twoKi;
+    float gateG;
+    bool isStarted;
+    float q0, q1, q2, q3;
+    float integralX, integralY, integralZ;
+    float forwardG;
+};
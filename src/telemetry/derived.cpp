@@ -0,0 +1,58 @@
+#include "derived.h"
+#include "fixed_point.h"
+
+static const int32_t EFFICIENCY_MIN_SPEED = 30;   // 0.1 km/h
+
+static_assert(DERIVED_COUNT <= 32, "one valid bit per signal");
+
+DerivedValues::DerivedValues(const Drivetrain* drivetrain)
+    : values(nullptr), drivetrain(drivetrain), sequence(0), valid(0), computeCount(0), cache{} {
+}
+
+void DerivedValues::setDrivetrain(const Drivetrain* newDrivetrain) {
+    drivetrain = newDrivetrain;
+    valid = 0;
+}
+
+void DerivedValues::setSample(const VescValues& sample, uint32_t sampleSequence) {
+    values = &sample;
+    if (sampleSequence == sequence) return;
+    sequence = sampleSequence;
+    valid = 0;
+}
+
+int32_t DerivedValues::get(DerivedSignal signal) {
+    if (!values || signal >= DERIVED_COUNT) return 0;
+    uint32_t bit = 1u << signal;
+    if (!(valid & bit)) {
+        cache[signal] = compute(signal);
+        valid |= bit;
+        computeCount++;
+    }
+    return cache[signal];
+}
+
+int32_t DerivedValues::compute(DerivedSignal signal) {
+    const VescValues& v = *values;
+    switch (signal) {
+        case DERIVED_POWER:
+            return (int32_t)(((int64_t)v.vIn * v.currentIn) / 100);
+        case DERIVED_TEMP_FET_F:
+            return deciCelsiusToDeciFahrenheit(v.tempFet);
+        case DERIVED_TEMP_MOTOR_F:
+            return deciCelsiusToDeciFahrenheit(v.tempMotor);
+        case DERIVED_SPEED:
+            if (!drivetrain) return 0;
+            return drivetrain->speed(v.rpm < 0 ? -v.rpm : v.rpm);
+        case DERIVED_DISTANCE:
+            return drivetrain ? drivetrain->distance(v.tachometerAbs) : 0;
+        case DERIVED_EFFICIENCY: {
+            // 0.1 W over 0.1 km/h is Wh/km; one more decimal
+            int32_t speed = get(DERIVED_SPEED);
+            if (speed < EFFICIENCY_MIN_SPEED) return 0;
+            return (int32_t)((int64_t)get(DERIVED_POWER) * 10 / speed);
+        }
+        default:
+            return 0;
+    }
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <stdint.h>
+#include "../vesc/values.h"
+#include "drivetrain.h"
+
+// Quantities worked out from the raw fields of a sample, in the units the
+// dashboard prints them in
+enum DerivedSignal : uint8_t {
+    DERIVED_POWER,          // 0.1 W, vIn x currentIn
+    DERIVED_TEMP_FET_F,     // 0.1 °F
+    DERIVED_TEMP_MOTOR_F,   // 0.1 °F
+    DERIVED_SPEED,          // 0.1 km/h from the ERPM, unsigned
+    DERIVED_DISTANCE,       // 0.01 km from the absolute tachometer
+    DERIVED_EFFICIENCY,     // 0.1 Wh/km right now, power over speed; 0 below walking pace
+    DERIVED_COUNT
+};
+
+// Derived quantities of one sample, each worked out the first time it is
+// asked for and kept until a sample with another sequence number comes
+// in. Widgets of a page ask for what they show, so a quantity nobody
+// shows costs nothing, and two widgets on the same one compute it once.
+// State of charge is not here: it needs the history of the current, so
+// the telemetry store keeps it as a field (VescValues::soc).
+class DerivedValues {
+public:
+    explicit DerivedValues(const Drivetrain* drivetrain = nullptr);
+
+    void setDrivetrain(const Drivetrain* drivetrain);
+
+    // The sample asked about from now on. The cache is kept if sequence
+    // is that of the sample already set; values must outlive the calls.
+    void setSample(const VescValues& values, uint32_t sequence);
+
+    int32_t get(DerivedSignal signal);
+
+    // Computations done since boot
+    uint32_t computations() const { return computeCount; }
+
+private:
+    int32_t compute(DerivedSignal signal);
+
+    const VescValues* values;
+    const Drivetrain* drivetrain;
+    uint32_t sequence;
+    uint32_t valid;          // One bit per DerivedSignal
+    uint32_t computeCount;
+    int32_t cache[DERIVED_COUNT];
+};
@@ -0,0 +1,21 @@
+#include "drivetrain.h"
+
+Drivetrain::Drivetrain() : speedPerErpm(0), hundredthKmPerCount(0), countMicrons(0) {
+}
+
+void Drivetrain::configure(const DrivetrainConfig& config) {
+    uint64_t circumference = (uint64_t)config.wheelDiameterMm * 3141593 / 1000;   // µm
+    uint64_t polesX100 = (uint64_t)config.motorPoles * config.gearRatioX100;
+    if (polesX100 == 0) {
+        *this = Drivetrain();
+        return;
+    }
+    // A wheel turn a minute is circumference * 60 / 1e9 km/h, and takes
+    // poles / 2 * gear ERPM. In 0.1 km/h with the gear x100 that is
+    // circumference * 120000 / (poles * gearX100 * 1e9).
+    speedPerErpm = (int64_t)(((circumference * 120000) << SPEED_SHIFT) / (polesX100 * 1000000000ull));
+    // A wheel turn is 3 * poles * gear counts; 0.01 km is 1e7 µm
+    uint64_t countsX100 = 3 * polesX100;
+    hundredthKmPerCount = (int64_t)(((circumference * 100) << DISTANCE_SHIFT) / (countsX100 * 10000000ull));
+    countMicrons = (uint32_t)((circumference * 100 + countsX100 / 2) / countsX100);
+}
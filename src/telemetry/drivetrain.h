@@ -0,0 +1,44 @@
+#pragma once
+
+#include <stdint.h>
+
+// Motor and wheel, as set on the settings screen
+struct DrivetrainConfig {
+    uint8_t motorPoles;          // Magnet poles (not pole pairs)
+    uint16_t gearRatioX100;      // Motor turns per wheel turn, x100 (100 for hub motors)
+    uint16_t wheelDiameterMm;
+};
+
+// Road speed from ERPM and distance from tachometer counts. The factors
+// are worked out once in configure(), so each conversion is a multiply
+// and a shift. A motor turn is poles / 2 electrical turns and 3 * poles
+// tachometer counts.
+class Drivetrain {
+public:
+    Drivetrain();
+
+    void configure(const DrivetrainConfig& config);
+
+    // 0.1 km/h, signed as the ERPM
+    int32_t speed(int32_t erpm) const {
+        return (int32_t)(((int64_t)erpm * speedPerErpm) >> SPEED_SHIFT);
+    }
+
+    // Microns covered over a number of tachometer counts
+    int64_t microns(int64_t counts) const { return counts * countMicrons; }
+
+    // 0.01 km over a number of tachometer counts
+    int32_t distance(int64_t counts) const {
+        return (int32_t)((counts * hundredthKmPerCount) >> DISTANCE_SHIFT);
+    }
+
+    uint32_t micronsPerCount() const { return countMicrons; }
+
+private:
+    static const int SPEED_SHIFT = 24;
+    static const int DISTANCE_SHIFT = 32;
+
+    int64_t speedPerErpm;        // 0.1 km/h per ERPM << SPEED_SHIFT
+    int64_t hundredthKmPerCount; // 0.01 km per count << DISTANCE_SHIFT
+    uint32_t countMicrons;       // Rounded
+};
@@ -0,0 +1,79 @@
+#include "energy.h"
+
+EnergyEstimator::EnergyEstimator() : config(), packEnergy(0), charge(0) {
+    reset();
+}
+
+void EnergyEstimator::configure(const EnergyConfig& newConfig, const Drivetrain& newDrivetrain) {
+    config = newConfig;
+    drivetrain = newDrivetrain;
+    // mAh x mV is µWh
+    packEnergy = (int64_t)config.capacityMah * config.cells * socNominalCellMillivolts(config.chemistry) / 100;
+    refresh();
+}
+
+void EnergyEstimator::reset() {
+    hasBaseline = false;
+    tripEnergy = 0;
+    tripCounts = 0;
+    recentEnergy = 0;
+    recentCounts = 0;
+    current = EnergyEstimate();
+}
+
+void EnergyEstimator::rebaseline(const VescValues& values, uint8_t controllers) {
+    hasBaseline = true;
+    lastControllers = controllers;
+    lastWattHours = values.wattHours;
+    lastWattHoursCharged = values.wattHoursCharged;
+    lastTachometer = values.tachometerAbs;
+}
+
+void EnergyEstimator::update(const VescValues& values, uint8_t controllers) {
+    const uint32_t needed = VALUES_FIELD_WATT_HOURS | VALUES_FIELD_WATT_HOURS_CHARGED | VALUES_FIELD_TACHOMETER_ABS;
+    if ((values.fields & needed) == needed) {
+        int32_t used = values.wattHours - lastWattHours;
+        int32_t charged = values.wattHoursCharged - lastWattHoursCharged;
+        int32_t counts = values.tachometerAbs - lastTachometer;
+        bool restarted = !hasBaseline || controllers != lastControllers || used < 0 || charged < 0 || counts < 0;
+        rebaseline(values, controllers);
+        if (!restarted) {
+            int64_t net = (int64_t)used - charged;
+            tripEnergy += net;
+            tripCounts += counts;
+
+            // Both sums lose the share of the averaging distance just
+            // covered, so their ratio follows the last few recentMeters
+            uint32_t micronsPerCount = drivetrain.micronsPerCount();
+            int64_t window = micronsPerCount > 0 ? (int64_t)config.recentMeters * 1000000 / micronsPerCount : 0;
+            if (window <= counts) {
+                recentEnergy = net;
+                recentCounts = counts;
+            } else {
+                recentEnergy += net - recentEnergy * counts / window;
+                recentCounts += counts - recentCounts * counts / window;
+            }
+        }
+    }
+    charge = values.soc;
+    refresh();
+}
+
+// 0.1 Wh/km from 0.0001 Wh over a number of counts, 0 below minMeters
+int32_t EnergyEstimator::whPerKm(int64_t energy, int64_t counts) const {
+    int64_t microns = drivetrain.microns(counts);
+    if (microns <= 0 || microns < (int64_t)config.minMeters * 1000000) return 0;
+    return (int32_t)(energy * 1000000 / microns);
+}
+
+void EnergyEstimator::refresh() {
+    current.tripDistance = drivetrain.distance(tripCounts);
+    current.tripEnergy = (int32_t)(tripEnergy / 1000);
+    current.tripWhPerKm = whPerKm(tripEnergy, tripCounts);
+    current.recentWhPerKm = whPerKm(recentEnergy, recentCounts);
+
+    int64_t remaining = packEnergy * charge / 1000;
+    current.remainingWh = (int32_t)(remaining / 1000);
+    int32_t rate = current.recentWhPerKm > 0 ? current.recentWhPerKm : current.tripWhPerKm;
+    current.range = rate > 0 ? (int32_t)(remaining / (100 * (int64_t)rate)) : 0;
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include "../vesc/values.h"
+#include "soc.h"
+#include "drivetrain.h"
+
+#include <stdint.h>
+
+// Pack the estimate is worked out for
+struct EnergyConfig {
+    BatteryChemistry chemistry;
+    uint8_t cells;               // In series
+    uint32_t capacityMah;        // Of one series string times the strings in parallel
+    uint32_t recentMeters;       // Distance the recent consumption is averaged over
+    uint32_t minMeters;          // Distance before a consumption figure is shown
+};
+
+// What the estimator has worked out so far; 0 where it does not know yet
+struct EnergyEstimate {
+    int32_t tripDistance;        // 0.01 km
+    int32_t tripEnergy;          // 0.1 Wh, net of regen
+    int32_t tripWhPerKm;         // 0.1 Wh/km over the trip
+    int32_t recentWhPerKm;       // 0.1 Wh/km, exponentially weighted by distance
+    int32_t remainingWh;         // 0.1 Wh left in the pack
+    int32_t range;               // 0.1 km at the recent (else trip) consumption
+};
+
+// Energy use and range, folded in from the VESC's own watt-hour and
+// tachometer counters one sample at a time. Each update costs the same
+// whatever the trip length: the trip is a running sum of counter deltas,
+// and the recent figure two sums that decay with distance covered.
+//
+// The counters are cumulative, so a missed or skipped sample only moves
+// its delta into the next one. They go back to 0 when a VESC restarts,
+// and a controller dropping out of or back into a combined sample jumps
+// the sum; either way the estimator takes a new baseline and carries on.
+//
+// What is left in the pack is its nominal energy times the sample's
+// state of charge (values.soc, see soc.h).
+// Not thread safe.
+class EnergyEstimator {
+public:
+    EnergyEstimator();
+
+    // Set the pack, and the drivetrain the counters are turned into
+    // distance with
+    void configure(const EnergyConfig& config, const Drivetrain& drivetrain);
+
+    // Start a new trip
+    void reset();
+
+    // Take a new baseline of the counters on the next sample, keeping the
+    // trip; for a new connection, which may be to another VESC
+    void resync() { hasBaseline = false; }
+
+    // Fold in a sample. Only samples carrying the energy counters move
+    // the trip; controllers is how many the sample combines.
+    void update(const VescValues& values, uint8_t controllers);
+
+    const EnergyEstimate& estimate() const { return current; }
+
+private:
+    void rebaseline(const VescValues& values, uint8_t controllers);
+    int32_t whPerKm(int64_t energy, int64_t counts) const;
+    void refresh();
+
+    EnergyConfig config;
+    Drivetrain drivetrain;
+    int64_t packEnergy;          // 0.0001 Wh, full
+    int32_t charge;              // 0.1 %, of the last sample
+
+    bool hasBaseline;
+    uint8_t lastControllers;
+    int32_t lastWattHours;       // Counters at the last update
+    int32_t lastWattHoursCharged;
+    int32_t lastTachometer;
+
+    int64_t tripEnergy;          // 0.0001 Wh
+    int64_t tripCounts;
+    int64_t recentEnergy;
+    int64_t recentCounts;
+
+    EnergyEstimate current;
+};
@@ -0,0 +1,170 @@
+#include "fault_capture.h"
+#include "../log.h"
+#include "../system/memory.h"
+
+#include <Arduino.h>
+
+static const uint8_t MAX_SLOTS = 8;
+
+struct Capture {
+    FaultCaptureInfo info;
+    int32_t* columns[HISTORY_FIELD_COUNT];
+    uint32_t* times;
+};
+
+static Capture captures[MAX_SLOTS];
+static uint8_t slotCount = 0;
+static uint8_t oldest = 0;        // Ring of stored captures
+static uint8_t stored = 0;
+static uint32_t windowBeforeMs = 0;
+static uint32_t windowAfterMs = 0;
+static uint32_t slotSamples = 0;
+
+// Set by any task, taken by faultCaptureUpdate()
+static portMUX_TYPE triggerMux = portMUX_INITIALIZER_UNLOCKED;
+static bool triggerPending = false;
+static FaultCaptureInfo pendingTrigger;
+
+// The window being recorded
+static bool recording = false;
+static FaultCaptureInfo openWindow;
+
+bool faultCaptureBegin(uint32_t preMs, uint32_t postMs, uint32_t maxSamples, uint8_t slots) {
+    windowBeforeMs = preMs;
+    windowAfterMs = postMs;
+    if (slots > MAX_SLOTS) slots = MAX_SLOTS;
+
+    // One block for every slot: a column per field plus the timestamps
+    size_t slotBytes = (size_t)maxSamples * (HISTORY_FIELD_COUNT + 1) * sizeof(int32_t);
+    uint8_t* block = (uint8_t*)memoryAlloc(slotBytes * slots, MEMORY_BULK, MEMORY_TAG_TELEMETRY);
+    if (!block || maxSamples == 0) {
+        LOG_E(APP, "No PSRAM for %d fault captures of %u samples", slots, (unsigned)maxSamples);
+        if (block) memoryFree(block);
+        return false;
+    }
+    for (uint8_t i = 0; i < slots; i++) {
+        int32_t* base = (int32_t*)(block + slotBytes * i);
+        for (int f = 0; f < HISTORY_FIELD_COUNT; f++) {
+            captures[i].columns[f] = base + (size_t)f * maxSamples;
+        }
+        captures[i].times = (uint32_t*)(base + (size_t)HISTORY_FIELD_COUNT * maxSamples);
+    }
+    slotCount = slots;
+    slotSamples = maxSamples;
+    LOG_I(APP, "Fault capture: %d slots of %u samples (%ums before, %ums after), %u bytes", slots,
+          (unsigned)maxSamples, (unsigned)preMs, (unsigned)postMs, (unsigned)(slotBytes * slots));
+    return true;
+}
+
+void faultCaptureTrigger(uint8_t controller, uint8_t previousCode, uint8_t faultCode, uint32_t now) {
+    if (faultCode == 0) return;
+    portENTER_CRITICAL(&triggerMux);
+    if (!triggerPending) {
+        triggerPending = true;
+        pendingTrigger.controller = controller;
+        pendingTrigger.faultCode = faultCode;
+        pendingTrigger.previousCode = previousCode;
+        pendingTrigger.triggerMs = now;
+        pendingTrigger.samples = 0;
+    }
+    portEXIT_CRITICAL(&triggerMux);
+}
+
+// Copy the closed window out of the history into the next slot
+static void storeWindow(const TelemetryHistory& history) {
+    uint32_t start = openWindow.triggerMs - windowBeforeMs;
+    uint32_t end = openWindow.triggerMs + windowAfterMs;
+
+    // Absolute sample numbers of the window, consistent with one total()
+    uint32_t total, first, last;
+    do {
+        total = history.total();
+        first = total - history.countSince(start);
+        last = total - history.countSince(end + 1);
+    } while (history.total() != total);
+    uint32_t n = last - first;
+    // A window denser than a slot keeps its newest samples
+    if (n > slotSamples) {
+        first += n - slotSamples;
+        n = slotSamples;
+    }
+
+    uint8_t slot = (oldest + stored) % slotCount;
+    if (stored == slotCount) {
+        LOG_W(APP, "Fault capture slots full, dropping the oldest (fault %d)", captures[oldest].info.faultCode);
+        slot = oldest;
+        oldest = (oldest + 1) % slotCount;
+        stored--;
+    }
+    Capture& capture = captures[slot];
+    uint32_t copied = history.copyTimes(first, n, capture.times);
+    for (int f = 0; f < HISTORY_FIELD_COUNT; f++) {
+        history.copyRange((HistoryField)f, first, copied, capture.columns[f]);
+    }
+    capture.info = openWindow;
+    capture.info.samples = copied;
+    stored++;
+    LOG_I(APP, "Fault %d on controller %d captured: %u samples, %d stored", openWindow.faultCode,
+          openWindow.controller, (unsigned)copied, stored);
+}
+
+bool faultCaptureUpdate(const TelemetryHistory& history, uint32_t now) {
+    if (!recording) {
+        portENTER_CRITICAL(&triggerMux);
+        bool pending = triggerPending;
+        if (pending) openWindow = pendingTrigger;
+        triggerPending = false;
+        portEXIT_CRITICAL(&triggerMux);
+        if (!pending) return false;
+
+        recording = true;
+        LOG_W(APP, "Fault %d on controller %d (was %d), capturing", openWindow.faultCode,
+              openWindow.controller, openWindow.previousCode);
+    }
+
+    if (now - openWindow.triggerMs < windowAfterMs) return true;
+
+    recording = false;
+    if (slotCount > 0) storeWindow(history);
+    // A trigger that came in while recording belongs to this window
+    portENTER_CRITICAL(&triggerMux);
+    triggerPending = false;
+    portEXIT_CRITICAL(&triggerMux);
+    return false;
+}
+
+bool faultCaptureRecording() {
+    return recording;
+}
+
+uint8_t faultCaptureCount() {
+    return stored;
+}
+
+bool faultCaptureInfo(uint8_t index, FaultCaptureInfo& out) {
+    if (index >= stored) return false;
+    out = captures[(oldest + index) % slotCount].info;
+    return true;
+}
+
+uint32_t faultCaptureCopy(uint8_t index, HistoryField field, int32_t* out, uint32_t maxCount) {
+    if (index >= stored || field >= HISTORY_FIELD_COUNT) return 0;
+    const Capture& capture = captures[(oldest + index) % slotCount];
+    uint32_t n = capture.info.samples < maxCount ? capture.info.samples : maxCount;
+    memcpy(out, capture.columns[field], n * sizeof(int32_t));
+    return n;
+}
+
+uint32_t faultCaptureCopyTimes(uint8_t index, uint32_t* out, uint32_t maxCount) {
+    if (index >= stored) return 0;
+    const Capture& capture = captures[(oldest + index) % slotCount];
+    uint32_t n = capture.info.samples < maxCount ? capture.info.samples : maxCount;
+    memcpy(out, capture.times, n * sizeof(uint32_t));
+    return n;
+}
+
+void faultCaptureRelease() {
+    if (stored == 0) return;
+    oldest = (oldest + 1) % slotCount;
+    stored--;
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <stdint.h>
+#include "history.h"
+
+// Fault captures. A new fault code opens a window from preMs before the
+// transition to postMs after it; when the window closes, its samples are
+// copied out of the history ring into a capture slot in PSRAM, where they
+// stay until released (e.g. once uploaded) however far the ring moves on.
+// While a window is open the caller should poll at its capture rate, so
+// the post-trigger half is dense. With every slot full the oldest capture
+// is replaced.
+//
+// faultCaptureTrigger() may be called from any task; everything else
+// runs on the UI task.
+
+struct FaultCaptureInfo {
+    uint8_t controller;
+    uint8_t faultCode;
+    uint8_t previousCode;      // 0 if the controller was fine before
+    uint32_t triggerMs;        // millis() of the transition
+    uint32_t samples;          // Samples in the capture
+};
+
+// Allocate slots captures of at most maxSamples samples each. Returns
+// false without the memory; triggers are then only logged.
+bool faultCaptureBegin(uint32_t preMs, uint32_t postMs, uint32_t maxSamples, uint8_t slots);
+
+// Report a fault code change on a controller. A change to 0 (cleared)
+// does not open a window, nor does a trigger while one is open.
+void faultCaptureTrigger(uint8_t controller, uint8_t previousCode, uint8_t faultCode, uint32_t now);
+
+// Open a pending window or close a finished one. Returns true while a
+// window is open.
+bool faultCaptureUpdate(const TelemetryHistory& history, uint32_t now);
+
+bool faultCaptureRecording();
+
+// Stored captures, 0 the oldest
+uint8_t faultCaptureCount();
+bool faultCaptureInfo(uint8_t index, FaultCaptureInfo& out);
+
+// Copy one field, or the timestamps, of a stored capture. Return how many
+// samples were copied.
+uint32_t faultCaptureCopy(uint8_t index, HistoryField field, int32_t* out, uint32_t maxCount);
+uint32_t faultCaptureCopyTimes(uint8_t index, uint32_t* out, uint32_t maxCount);
+
+// Drop the oldest stored capture, e.g. once it has been uploaded
+void faultCaptureRelease();
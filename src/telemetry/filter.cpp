@@ -0,0 +1,103 @@
+#include "filter.h"
+
+#include <string.h>
+
+// Fields a filter would corrupt: counters, codes and ids
+static const uint32_t UNFILTERED_FIELDS = VALUES_FIELD_AMP_HOURS | VALUES_FIELD_AMP_HOURS_CHARGED |
+                                          VALUES_FIELD_WATT_HOURS | VALUES_FIELD_WATT_HOURS_CHARGED |
+                                          VALUES_FIELD_TACHOMETER | VALUES_FIELD_TACHOMETER_ABS |
+                                          VALUES_FIELD_FAULT | VALUES_FIELD_CONTROLLER_ID |
+                                          VALUES_FIELD_PID_POS | VALUES_FIELD_STATUS;
+
+static inline void order(int32_t& a, int32_t& b) {
+    if (a > b) {
+        int32_t t = a;
+        a = b;
+        b = t;
+    }
+}
+
+static inline int32_t median3(const int32_t* w) {
+    int32_t a = w[0], b = w[1], c = w[2];
+    order(a, b);
+    order(b, c);
+    order(a, b);
+    return b;
+}
+
+// Nine compare-exchanges sort five; the middle one is the median
+static inline int32_t median5(const int32_t* w) {
+    int32_t v[5] = { w[0], w[1], w[2], w[3], w[4] };
+    order(v[0], v[1]);
+    order(v[3], v[4]);
+    order(v[2], v[4]);
+    order(v[2], v[3]);
+    order(v[1], v[4]);
+    order(v[0], v[3]);
+    order(v[0], v[2]);
+    order(v[1], v[3]);
+    order(v[1], v[2]);
+    return v[2];
+}
+
+ValuesFilter::ValuesFilter() : stageCount(0) {
+}
+
+void ValuesFilter::configure(const ValuesFilterStage* source, uint8_t count) {
+    stageCount = 0;
+    for (uint8_t i = 0; i < count && stageCount < MAX_STAGES; i++) {
+        const ValuesFilterStage& s = source[i];
+        if (s.bit >= VALUES_FIELD_COUNT || (UNFILTERED_FIELDS & (1u << s.bit))) continue;
+        if (s.kind == FILTER_NONE || s.kind > FILTER_MEDIAN5) continue;
+        if (s.kind == FILTER_EMA && (s.shift == 0 || s.shift > MAX_SHIFT)) continue;
+        Stage& stage = stages[stageCount++];
+        stage.bit = s.bit;
+        stage.kind = s.kind;
+        stage.shift = s.shift;
+    }
+    reset();
+}
+
+void ValuesFilter::reset() {
+    for (uint8_t i = 0; i < stageCount; i++) {
+        stages[i].seeded = false;
+        stages[i].next = 0;
+    }
+}
+
+int32_t ValuesFilter::step(Stage& stage, uint8_t element, int32_t value) {
+    int32_t* w = stage.state[element];
+    if (!stage.seeded) {
+        for (uint8_t i = 0; i < WINDOW; i++) w[i] = value;
+        if (stage.kind == FILTER_EMA) w[0] = value * (1 << stage.shift);
+        return value;
+    }
+    switch (stage.kind) {
+        case FILTER_EMA: {
+            // Sum scaled by 2^shift: sum += x - sum / 2^shift, rounded
+            int32_t sum = w[0];
+            sum += value - (sum >> stage.shift);
+            w[0] = sum;
+            return (sum + (1 << (stage.shift - 1))) >> stage.shift;
+        }
+        case FILTER_MEDIAN3:
+            w[stage.next] = value;
+            return median3(w);
+        default:
+            w[stage.next] = value;
+            return median5(w);
+    }
+}
+
+void ValuesFilter::apply(VescValues& values) {
+    for (uint8_t i = 0; i < stageCount; i++) {
+        Stage& stage = stages[i];
+        if (!(values.fields & (1u << stage.bit))) continue;
+        uint8_t elements = VALUES_FIELD_INFO[stage.bit].count;
+        for (uint8_t e = 0; e < elements; e++) {
+            valuesSetField(values, stage.bit, step(stage, e, valuesField(values, stage.bit, e)), e);
+        }
+        stage.seeded = true;
+        stage.next = (uint8_t)((stage.next + 1) % (stage.kind == FILTER_MEDIAN3 ? 3 : WINDOW));
+    }
+}
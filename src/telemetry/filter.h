@@ -0,0 +1,64 @@
+#pragma once
+
+#include <stdint.h>
+#include "../vesc/values.h"
+
+// Smoothing of decoded fields for what is shown and alerted on; logs and
+// the history keep the raw samples.
+//
+// Each stage smooths one field, every element of it (the three MOSFET
+// sensors), with either an integer EMA or a running median of the last
+// 3 or 5 samples taken by a fixed sorting network. The EMA follows a
+// steady drift; the median drops single-sample spikes (a current
+// reading caught mid-commutation) without the EMA's tail. A field's
+// first sample seeds its stage, and a sample that does not carry the
+// field leaves the stage alone. Every update costs the same whatever the
+// values. Not thread safe.
+enum ValuesFilterKind : uint8_t {
+    FILTER_NONE,
+    FILTER_EMA,         // Weight of the new sample 1 / 2^shift
+    FILTER_MEDIAN3,
+    FILTER_MEDIAN5
+};
+
+struct ValuesFilterStage {
+    uint8_t bit;        // VALUES_BIT_*
+    uint8_t kind;       // ValuesFilterKind
+    uint8_t shift;      // EMA only, 1 to MAX_SHIFT
+};
+
+class ValuesFilter {
+public:
+    static const uint8_t MAX_STAGES = 6;
+    // Keeps the EMA's scaled state within 32 bits for the measured fields
+    static const uint8_t MAX_SHIFT = 4;
+
+    ValuesFilter();
+
+    // Set the stages, dropping any beyond MAX_STAGES, a counter's or one
+    // with no effect, and start them afresh
+    void configure(const ValuesFilterStage* stages, uint8_t count);
+
+    // Forget the samples seen, e.g. the controller was lost
+    void reset();
+
+    // Smooth the fields that values carries, in place
+    void apply(VescValues& values);
+
+private:
+    static const uint8_t WINDOW = 5;
+
+    struct Stage {
+        uint8_t bit;
+        uint8_t kind;
+        uint8_t shift;
+        uint8_t next;                 // Window slot the next sample goes in
+        bool seeded;
+        int32_t state[3][WINDOW];     // Median windows; an EMA keeps its sum in [e][0]
+    };
+
+    int32_t step(Stage& stage, uint8_t element, int32_t value);
+
+    Stage stages[MAX_STAGES];
+    uint8_t stageCount;
+};
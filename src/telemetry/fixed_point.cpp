@@ -0,0 +1,48 @@
+#include "fixed_point.h"
+
+#include <string.h>
+
+static const int32_t POW10[FIXED_MAX_DECIMALS + 1] = {
+    1, 10, 100, 1000, 10000, 100000, 1000000
+};
+
+int32_t fixedRescale(int32_t value, uint8_t fromDecimals, uint8_t toDecimals) {
+    if (fromDecimals > FIXED_MAX_DECIMALS) fromDecimals = FIXED_MAX_DECIMALS;
+    if (toDecimals > FIXED_MAX_DECIMALS) toDecimals = FIXED_MAX_DECIMALS;
+
+    if (toDecimals >= fromDecimals) {
+        return value * POW10[toDecimals - fromDecimals];
+    }
+    int32_t divisor = POW10[fromDecimals - toDecimals];
+    int32_t half = divisor / 2;
+    return (value >= 0 ? value + half : value - half) / divisor;
+}
+
+int formatFixed(char* out, size_t size, int32_t value, uint8_t decimals) {
+    if (decimals > FIXED_MAX_DECIMALS) decimals = FIXED_MAX_DECIMALS;
+
+    // Digits from the last, into a buffer long enough for any int32_t
+    // with its sign and point
+    char digits[16];
+    char* p = digits + sizeof(digits);
+    uint32_t magnitude = value < 0 ? 0u - (uint32_t)value : (uint32_t)value;
+    for (uint8_t i = 0; i < decimals; i++) {
+        *--p = (char)('0' + magnitude % 10);
+        magnitude /= 10;
+    }
+    if (decimals > 0) *--p = '.';
+    do {
+        *--p = (char)('0' + magnitude % 10);
+        magnitude /= 10;
+    } while (magnitude != 0);
+    if (value < 0) *--p = '-';
+
+    // Truncated to fit, as snprintf would
+    int length = (int)(digits + sizeof(digits) - p);
+    if (size > 0) {
+        size_t copied = (size_t)length < size ? (size_t)length : size - 1;
+        memcpy(out, p, copied);
+        out[copied] = '\0';
+    }
+    return length;
+}
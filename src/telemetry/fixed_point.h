@@ -0,0 +1,25 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Helpers for the scaled integers telemetry is kept in (see the unit
+// comments in vesc/values.h). A value with N decimals means value / 10^N,
+// e.g. vIn = 481 with 1 decimal is 48.1 V. Everything here is integer
+// math; floats are never needed between the decoder and the screen.
+
+// Largest number of decimals the helpers handle
+static const uint8_t FIXED_MAX_DECIMALS = 6;
+
+// Change the number of decimals, rounding half away from zero
+int32_t fixedRescale(int32_t value, uint8_t fromDecimals, uint8_t toDecimals);
+
+// Print as a decimal number ("-12.34"), digit by digit without printf.
+// Returns the length written, as snprintf does.
+int formatFixed(char* out, size_t size, int32_t value, uint8_t decimals);
+
+// 0.1 °C to 0.1 °F, rounded to nearest
+inline int32_t deciCelsiusToDeciFahrenheit(int32_t deciCelsius) {
+    int32_t scaled = deciCelsius * 9;
+    return (scaled >= 0 ? scaled + 2 : scaled - 2) / 5 + 320;
+}
@@ -0,0 +1,108 @@
+#include "fleet.h"
+
+#include <Arduino.h>
+#include <string.h>
+
+static portMUX_TYPE fleetMux = portMUX_INITIALIZER_UNLOCKED;
+static FleetEntry entries[FLEET_MAX_ENTRIES];
+static uint32_t lastVisitMs[FLEET_MAX_ENTRIES];
+static int entryCount = 0;
+static volatile uint32_t version = 0;
+
+static void copyText(char* out, size_t size, const char* text) {
+    strncpy(out, text, size - 1);
+    out[size - 1] = '\0';
+}
+
+// Entry of an address, or a cleared one for it: a free one, else the
+// one visited longest ago
+static int slotFor(const char* address, uint32_t now) {
+    for (int i = 0; i < entryCount; i++) {
+        if (strcmp(entries[i].address, address) == 0) return i;
+    }
+    int slot = 0;
+    if (entryCount < FLEET_MAX_ENTRIES) {
+        slot = entryCount++;
+    } else {
+        for (int i = 1; i < entryCount; i++) {
+            if (now - lastVisitMs[i] > now - lastVisitMs[slot]) slot = i;
+        }
+    }
+    memset(&entries[slot], 0, sizeof(entries[slot]));
+    copyText(entries[slot].address, sizeof(entries[slot].address), address);
+    return slot;
+}
+
+void fleetClear() {
+    portENTER_CRITICAL(&fleetMux);
+    entryCount = 0;
+    version++;
+    portEXIT_CRITICAL(&fleetMux);
+}
+
+void fleetRecord(const char* name, const char* address, int rssi, const VescValues* values, uint32_t visitMs,
+                 bool cachedHandles, uint32_t now) {
+    portENTER_CRITICAL(&fleetMux);
+    int index = slotFor(address, now);
+    FleetEntry& entry = entries[index];
+    copyText(entry.name, sizeof(entry.name), name);
+    entry.rssi = rssi;
+    entry.visitMs = visitMs > UINT16_MAX ? UINT16_MAX : (uint16_t)visitMs;
+    entry.cachedHandles = cachedHandles;
+    if (entry.visits < UINT16_MAX) entry.visits++;
+    entry.passive = false;
+    entry.lastFailed = values == nullptr;
+    if (values) {
+        entry.sampled = true;
+        entry.sampledMs = now;
+        entry.vIn = values->vIn;
+        entry.tempFet = values->tempFet;
+        entry.tempMotor = values->tempMotor;
+        entry.faultCode = values->faultCode;
+    } else if (entry.failures < UINT16_MAX) {
+        entry.failures++;
+    }
+    lastVisitMs[index] = now;
+    version++;
+    portEXIT_CRITICAL(&fleetMux);
+}
+
+void fleetRecordBeacon(const char* name, const char* address, int rssi, const VescValues& values, uint8_t sequence,
+                       uint32_t now) {
+    portENTER_CRITICAL(&fleetMux);
+    int index = slotFor(address, now);
+    FleetEntry& entry = entries[index];
+    bool repeat = entry.passive && entry.sampled && entry.sequence == sequence;
+    entry.rssi = rssi;
+    if (name) {
+        copyText(entry.name, sizeof(entry.name), name);
+    } else if (!entry.name[0]) {
+        copyText(entry.name, sizeof(entry.name), address);
+    }
+    lastVisitMs[index] = now;
+    if (!repeat) {
+        entry.passive = true;
+        entry.sequence = sequence;
+        entry.sampled = true;
+        entry.lastFailed = false;
+        entry.sampledMs = now;
+        entry.vIn = values.vIn;
+        entry.tempFet = values.tempFet;
+        entry.tempMotor = values.tempMotor;
+        entry.faultCode = values.faultCode;
+        version++;
+    }
+    portEXIT_CRITICAL(&fleetMux);
+}
+
+int fleetCopy(FleetEntry* out, int max) {
+    portENTER_CRITICAL(&fleetMux);
+    int count = entryCount < max ? entryCount : max;
+    memcpy(out, entries, count * sizeof(FleetEntry));
+    portEXIT_CRITICAL(&fleetMux);
+    return count;
+}
+
+uint32_t fleetVersion() {
+    return version;
+}
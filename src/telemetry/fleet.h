@@ -0,0 +1,52 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include "../vesc/values.h"
+
+// Fleet table: the last snapshot of each vehicle the dashboard keeps an
+// eye on without riding it, keyed by BLE address. Written by whatever
+// takes the snapshots (the connection task in fleet mode), read by the
+// UI as a copy. A visit that got no values keeps the last good ones and
+// counts a failure, so a vehicle that walked off shows how stale it is.
+// Vehicles that send status beacons are recorded from those instead,
+// straight from the scan callback.
+
+struct FleetEntry {
+    char name[32];
+    char address[18];
+    int rssi;
+    bool sampled;              // vIn to faultCode hold a snapshot
+    uint32_t sampledMs;        // millis() of the last good snapshot
+    int16_t vIn;               // 0.1 V
+    int16_t tempFet;           // 0.1 °C
+    int16_t tempMotor;         // 0.1 °C
+    uint8_t faultCode;         // mc_fault_code
+    uint16_t visitMs;          // Last visit, connect to reply
+    bool cachedHandles;        // Last visit skipped service discovery
+    bool lastFailed;           // Last visit got no values
+    bool passive;              // From its beacons, never connected
+    uint8_t sequence;          // Of the last beacon
+    uint16_t visits;
+    uint16_t failures;
+};
+
+static const int FLEET_MAX_ENTRIES = 16;
+
+void fleetClear();
+
+// One visit to a vehicle; values is nullptr if it gave none. A new
+// vehicle replaces the one seen longest ago when the table is full.
+void fleetRecord(const char* name, const char* address, int rssi, const VescValues* values, uint32_t visitMs,
+                 bool cachedHandles, uint32_t now);
+
+// A status beacon. One that repeats the last sequence only refreshes
+// the RSSI; name nullptr keeps the name known.
+void fleetRecordBeacon(const char* name, const char* address, int rssi, const VescValues& values, uint8_t sequence,
+                       uint32_t now);
+
+// Copy the table, in the order vehicles were first seen. Returns the count.
+int fleetCopy(FleetEntry* out, int max);
+
+// Changes with every record, so the UI redraws only when needed
+uint32_t fleetVersion();
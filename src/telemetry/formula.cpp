@@ -0,0 +1,378 @@
+#include "formula.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Instructions are a byte: the opcode in the top 3 bits, its operand in
+// the low 5
+enum FormulaOp : uint8_t {
+    OP_OPERAND,                  // Push an operand slot, below
+    OP_CONSTANT,                 // Push one of the formula's numbers
+    OP_FORMULA,                  // Push an earlier formula's result
+    OP_BINARY,                   // Pop b and a, push a <operand> b
+    OP_UNARY                     // Replace the top
+};
+
+enum FormulaBinary : uint8_t { BINARY_ADD, BINARY_SUB, BINARY_MUL, BINARY_DIV, BINARY_MIN, BINARY_MAX };
+enum FormulaUnary : uint8_t { UNARY_NEG, UNARY_ABS };
+
+static const uint8_t OPERAND_BITS = 5;
+static const uint8_t OPERAND_MASK = (1u << OPERAND_BITS) - 1;
+static const uint8_t MAX_NESTING = 16;       // Parentheses and calls, to bound the compiler's recursion
+static const float RESULT_LIMIT = 2147483.0f; // Results kept as int32 at 3 decimals
+
+static_assert(VALUES_FORMULA_DECIMALS == 3, "results are stored at 3 decimals");
+
+// Operand slots: the decoded fields by bit (their first element), then
+// the ones the dashboard works out
+struct ExtraOperand {
+    const char* name;
+    uint8_t offset;
+    uint8_t decimals;
+    uint32_t fields;             // The poll needs these for it to move
+};
+
+static const ExtraOperand EXTRA_OPERANDS[] = {
+    { "soc",       offsetof(VescValues, soc),           1, VALUES_FIELD_V_IN | VALUES_FIELD_CURRENT_IN },
+    { "gps_speed", offsetof(VescValues, gpsSpeed),      1, 0 },
+    { "pitch",     offsetof(VescValues, imuPitch),      1, 0 },
+    { "accel",     offsetof(VescValues, imuAccel),      2, 0 },
+    { "derate",    offsetof(VescValues, derateSeconds), 0,
+      VALUES_FIELD_TEMP_FET | VALUES_FIELD_TEMP_MOTOR | VALUES_FIELD_CURRENT_MOTOR },
+};
+
+static const uint8_t EXTRA_COUNT = sizeof(EXTRA_OPERANDS) / sizeof(EXTRA_OPERANDS[0]);
+static const uint8_t OPERAND_COUNT = VALUES_FIELD_COUNT + EXTRA_COUNT;
+static_assert(OPERAND_COUNT <= OPERAND_MASK + 1, "operand slots must fit an instruction");
+static_assert(FormulaSet::MAX_CONSTANTS <= OPERAND_MASK + 1, "constants must fit an instruction");
+
+static const float DECIMAL_SCALE[8] = { 1.0f, 0.1f, 0.01f, 0.001f, 0.0001f, 0.00001f, 0.000001f, 0.0000001f };
+
+static const char* const FUNCTION_NAMES[] = { "min", "max", "abs" };
+
+static float operandValue(const VescValues& values, uint8_t slot) {
+    if (slot < VALUES_FIELD_COUNT) {
+        return valuesField(values, slot) * DECIMAL_SCALE[VALUES_FIELD_INFO[slot].decimals];
+    }
+    const ExtraOperand& extra = EXTRA_OPERANDS[slot - VALUES_FIELD_COUNT];
+    int16_t raw;
+    memcpy(&raw, (const uint8_t*)&values + extra.offset, sizeof(raw));
+    return raw * DECIMAL_SCALE[extra.decimals];
+}
+
+static uint32_t operandFields(uint8_t slot) {
+    return slot < VALUES_FIELD_COUNT ? 1u << slot : EXTRA_OPERANDS[slot - VALUES_FIELD_COUNT].fields;
+}
+
+static int operandSlot(const char* name) {
+    for (uint8_t bit = 0; bit < VALUES_FIELD_COUNT; bit++) {
+        if (strcmp(VALUES_FIELD_INFO[bit].name, name) == 0) return bit;
+    }
+    for (uint8_t i = 0; i < EXTRA_COUNT; i++) {
+        if (strcmp(EXTRA_OPERANDS[i].name, name) == 0) return VALUES_FIELD_COUNT + i;
+    }
+    return -1;
+}
+
+static bool isNameStart(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
+}
+
+static bool isNameChar(char c) {
+    return isNameStart(c) || (c >= '0' && c <= '9');
+}
+
+// Recursive descent straight to stack code, tracking the stack depth the
+// code reaches
+struct FormulaParser {
+    const char* p;
+    const FormulaSet* set;
+    FormulaSet::Program* program;
+    uint8_t depth;
+    uint8_t nesting;
+    const char* error;
+
+    bool fail(const char* reason) {
+        if (!error) error = reason;
+        return false;
+    }
+
+    void skipSpace() {
+        while (*p == ' ' || *p == '\t') p++;
+    }
+
+    bool emit(uint8_t op, uint8_t operand) {
+        if (program->length >= FormulaSet::MAX_CODE) return fail("too long");
+        program->code[program->length++] = (uint8_t)(op << OPERAND_BITS | operand);
+        if (op <= OP_FORMULA) {
+            if (++depth > FormulaSet::MAX_STACK) return fail("too deeply nested");
+        } else if (op == OP_BINARY) {
+            depth--;
+        }
+        return true;
+    }
+
+    // A name into buffer (cut to size); false if there is none here
+    bool readName(char* buffer, size_t size) {
+        if (!isNameStart(*p)) return false;
+        size_t n = 0;
+        while (isNameChar(*p)) {
+            if (n + 1 < size) buffer[n++] = *p;
+            p++;
+        }
+        buffer[n] = '\0';
+        return true;
+    }
+
+    bool number() {
+        char* end;
+        float value = strtof(p, &end);
+        if (end == p) return fail("expected a value");
+        p = end;
+        if (program->constantCount >= FormulaSet::MAX_CONSTANTS) return fail("too many numbers");
+        program->constants[program->constantCount] = value;
+        return emit(OP_CONSTANT, program->constantCount++);
+    }
+
+    bool call(uint8_t function) {
+        if (++nesting > MAX_NESTING) return fail("too deeply nested");
+        p++;
+        uint8_t arguments = function == 2 ? 1 : 2;
+        for (uint8_t i = 0; i < arguments; i++) {
+            if (i > 0) {
+                skipSpace();
+                if (*p != ',') return fail("expected ,");
+                p++;
+            }
+            if (!expression()) return false;
+        }
+        skipSpace();
+        if (*p != ')') return fail("expected )");
+        p++;
+        nesting--;
+        switch (function) {
+            case 0:  return emit(OP_BINARY, BINARY_MIN);
+            case 1:  return emit(OP_BINARY, BINARY_MAX);
+            default: return emit(OP_UNARY, UNARY_ABS);
+        }
+    }
+
+    bool primary() {
+        skipSpace();
+        if (*p == '(') {
+            if (++nesting > MAX_NESTING) return fail("too deeply nested");
+            p++;
+            if (!expression()) return false;
+            skipSpace();
+            if (*p != ')') return fail("expected )");
+            p++;
+            nesting--;
+            return true;
+        }
+        char name[24];
+        if (!readName(name, sizeof(name))) {
+            if ((*p >= '0' && *p <= '9') || *p == '.') return number();
+            return fail("expected a value");
+        }
+        skipSpace();
+        if (*p == '(') {
+            for (uint8_t f = 0; f < sizeof(FUNCTION_NAMES) / sizeof(FUNCTION_NAMES[0]); f++) {
+                if (strcmp(name, FUNCTION_NAMES[f]) == 0) return call(f);
+            }
+            return fail("unknown function");
+        }
+        int slot = operandSlot(name);
+        if (slot >= 0) {
+            program->fields |= operandFields(slot);
+            return emit(OP_OPERAND, (uint8_t)slot);
+        }
+        for (uint8_t f = 0; f < set->count(); f++) {
+            if (strcmp(name, set->name(f)) == 0) {
+                program->fields |= set->programs[f].fields;
+                return emit(OP_FORMULA, f);
+            }
+        }
+        return fail("unknown name");
+    }
+
+    bool unary() {
+        skipSpace();
+        if (*p == '-') {
+            p++;
+            return unary() && emit(OP_UNARY, UNARY_NEG);
+        }
+        if (*p == '+') {
+            p++;
+            return unary();
+        }
+        return primary();
+    }
+
+    bool term() {
+        if (!unary()) return false;
+        for (;;) {
+            skipSpace();
+            if (*p != '*' && *p != '/') return true;
+            uint8_t op = *p++ == '*' ? BINARY_MUL : BINARY_DIV;
+            if (!unary() || !emit(OP_BINARY, op)) return false;
+        }
+    }
+
+    bool expression() {
+        if (!term()) return false;
+        for (;;) {
+            skipSpace();
+            if (*p != '+' && *p != '-') return true;
+            uint8_t op = *p++ == '+' ? BINARY_ADD : BINARY_SUB;
+            if (!term() || !emit(OP_BINARY, op)) return false;
+        }
+    }
+};
+
+FormulaSet::FormulaSet() {
+    clear();
+}
+
+void FormulaSet::clear() {
+    memset(programs, 0, sizeof(programs));
+    formulaCount = 0;
+}
+
+const char* FormulaSet::name(uint8_t formula) const {
+    return formula < formulaCount ? programs[formula].name : "";
+}
+
+uint32_t FormulaSet::fields() const {
+    uint32_t fields = 0;
+    for (uint8_t f = 0; f < formulaCount; f++) fields |= programs[f].fields;
+    return fields;
+}
+
+bool FormulaSet::add(const char* line, const char*& error) {
+    if (formulaCount >= MAX_FORMULAS) {
+        error = "too many formulas";
+        return false;
+    }
+    Program& program = programs[formulaCount];
+    memset(&program, 0, sizeof(program));
+
+    FormulaParser parser = { line, this, &program, 0, 0, nullptr };
+    parser.skipSpace();
+    char name[MAX_NAME + 2];
+    if (!parser.readName(name, sizeof(name))) {
+        error = "expected a name";
+        return false;
+    }
+    if (strlen(name) > MAX_NAME) {
+        error = "name too long";
+        return false;
+    }
+    bool taken = operandSlot(name) >= 0;
+    for (uint8_t f = 0; f < sizeof(FUNCTION_NAMES) / sizeof(FUNCTION_NAMES[0]); f++) {
+        if (strcmp(name, FUNCTION_NAMES[f]) == 0) taken = true;
+    }
+    for (uint8_t f = 0; f < formulaCount; f++) {
+        if (strcmp(name, programs[f].name) == 0) taken = true;
+    }
+    if (taken) {
+        error = "name already used";
+        return false;
+    }
+    parser.skipSpace();
+    if (*parser.p != '=') {
+        error = "expected =";
+        return false;
+    }
+    parser.p++;
+    bool compiled = parser.expression();
+    parser.skipSpace();
+    if (compiled && *parser.p != '\0' && *parser.p != '\r' && *parser.p != '\n') {
+        compiled = parser.fail("unexpected text at the end");
+    }
+    if (!compiled) {
+        error = parser.error;
+        memset(&program, 0, sizeof(program));
+        return false;
+    }
+    memcpy(program.name, name, strlen(name) + 1);
+    formulaCount++;
+    return true;
+}
+
+bool FormulaSet::parse(const char* text, size_t length, uint16_t& badLine, const char*& error) {
+    char line[128];
+    uint16_t number = 0;
+    size_t i = 0;
+    while (i < length) {
+        size_t n = 0;
+        number++;
+        while (i < length && text[i] != '\n') {
+            if (n + 1 < sizeof(line)) line[n++] = text[i];
+            i++;
+        }
+        i++;
+        line[n] = '\0';
+        const char* start = line;
+        while (*start == ' ' || *start == '\t') start++;
+        if (*start == '\0' || *start == '\r' || *start == '#') continue;
+        if (n + 1 >= sizeof(line)) {
+            badLine = number;
+            error = "line too long";
+            return false;
+        }
+        if (!add(start, error)) {
+            badLine = number;
+            return false;
+        }
+    }
+    return true;
+}
+
+void FormulaSet::evaluate(VescValues& values) const {
+    if (formulaCount == 0) return;
+
+    float results[MAX_FORMULAS];
+    for (uint8_t f = 0; f < MAX_FORMULAS; f++) values.formula[f] = 0;
+    for (uint8_t f = 0; f < formulaCount; f++) {
+        const Program& program = programs[f];
+        float stack[MAX_STACK];
+        uint8_t top = 0;
+        for (uint8_t i = 0; i < program.length; i++) {
+            uint8_t operand = program.code[i] & OPERAND_MASK;
+            switch (program.code[i] >> OPERAND_BITS) {
+                case OP_OPERAND:
+                    stack[top++] = operandValue(values, operand);
+                    break;
+                case OP_CONSTANT:
+                    stack[top++] = program.constants[operand];
+                    break;
+                case OP_FORMULA:
+                    stack[top++] = results[operand];
+                    break;
+                case OP_BINARY: {
+                    float b = stack[--top];
+                    float& a = stack[top - 1];
+                    switch (operand) {
+                        case BINARY_ADD: a += b; break;
+                        case BINARY_SUB: a -= b; break;
+                        case BINARY_MUL: a *= b; break;
+                        case BINARY_DIV: a = b != 0 ? a / b : 0; break;
+                        case BINARY_MIN: a = b < a ? b : a; break;
+                        default:         a = b > a ? b : a; break;
+                    }
+                    break;
+                }
+                default:
+                    stack[top - 1] = operand == UNARY_NEG ? -stack[top - 1] : fabsf(stack[top - 1]);
+                    break;
+            }
+        }
+        // Out of range and NaN alike
+        float result = stack[0];
+        if (!(result > -RESULT_LIMIT && result < RESULT_LIMIT)) result = 0;
+        results[f] = result;
+        values.formula[f] = (int32_t)lroundf(result * 1000.0f);
+    }
+    values.fields |= VALUES_FIELD_FORMULA;
+}
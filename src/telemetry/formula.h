@@ -0,0 +1,74 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include "../vesc/values.h"
+
+// Custom computed fields: formulas over a sample's fields, compiled once
+// into bytecode and run on every sample.
+//
+// A formulas file has one formula a line, "name = expression"; blank
+// lines and lines starting with '#' are skipped. An expression is made
+// of numbers, + - * /, parentheses, min(a, b), max(a, b), abs(a), and
+// names: a decoded field by its VALUES_FIELD_INFO name ("v_in",
+// "current_in", "watt_hours"...), "soc", "gps_speed", "derate", the
+// IMU's "pitch" (degrees) and "accel" (g), or an earlier formula.
+// Fields read in their own units (volts, amps, watt hours; ERPM and
+// counts as they are), not as the fixed-point integers they are kept
+// in, e.g.
+//
+//     power_kw = v_in * current_in / 1000
+//     wh_per_km = power_kw * 1000 / max(erpm / 7 * 0.000283 * 60, 1) + 2
+//
+// Compiling turns an expression into stack code over operand slots, with
+// the stack depth it needs checked, so evaluation has no parsing, name
+// lookups, branches or loops: a formula runs in at most MAX_CODE steps.
+// A division by zero, or a result out of range, gives 0. Results are
+// stored into VescValues::formula[] at VALUES_FORMULA_DECIMALS, where
+// widgets, alerts and the logger read them as any other field.
+class FormulaSet {
+public:
+    static const uint8_t MAX_FORMULAS = VALUES_FORMULA_COUNT;
+    static const uint8_t MAX_CODE = 32;          // Instructions a formula
+    static const uint8_t MAX_STACK = 8;
+    static const uint8_t MAX_CONSTANTS = 8;      // Numbers a formula
+    static const uint8_t MAX_NAME = 15;
+
+    FormulaSet();
+
+    void clear();
+
+    // Compile one "name = expression" line and add it. Returns false,
+    // with a reason in error and the set unchanged, if it does not
+    // compile or there is no room for it.
+    bool add(const char* line, const char*& error);
+
+    // Compile a formulas file. Returns false at the first bad line, with
+    // its number (from 1) and the reason; the formulas before it are kept.
+    bool parse(const char* text, size_t length, uint16_t& badLine, const char*& error);
+
+    uint8_t count() const { return formulaCount; }
+    const char* name(uint8_t formula) const;
+
+    // VALUES_FIELD_* the formulas read, for the poll mask
+    uint32_t fields() const;
+
+    // Run every formula on a sample and store the results in its
+    // formula[] (0 for the slots without one), marking VALUES_FIELD_FORMULA
+    void evaluate(VescValues& values) const;
+
+private:
+    friend struct FormulaParser;
+
+    struct Program {
+        char name[MAX_NAME + 1];
+        uint8_t length;
+        uint8_t constantCount;
+        uint32_t fields;
+        uint8_t code[MAX_CODE];              // Opcode in the top 3 bits, operand below
+        float constants[MAX_CONSTANTS];
+    };
+
+    Program programs[MAX_FORMULAS];
+    uint8_t formulaCount;
+};
@@ -0,0 +1,93 @@
+#include "gps.h"
+#include "../log.h"
+#include "../system/seqlock.h"
+#include "../system/perf_stats.h"
+#include "../system/task_layout.h"
+
+#include <Arduino.h>
+#include <driver/uart.h>
+#include <esp_timer.h>
+
+static const uart_port_t GPS_UART = UART_NUM_2;
+static const int RX_BUFFER_SIZE = 1024;      // Driver ring; a second of NMEA at 9600 baud
+static const int EVENT_QUEUE_LENGTH = 16;
+static const size_t CHUNK_SIZE = 128;
+static const uint32_t TASK_STACK_SIZE = 3072;
+static const TaskPlacement& PLACEMENT = TASK_PLACEMENT[TASK_GPS];
+
+static Seqlock<GpsSample> latest;
+static QueueHandle_t uartEvents = nullptr;
+static GpsParser parser;
+static uint32_t byteUs = 0;                  // Start, 8 data and stop bit at the line rate
+
+static void gpsTask(void* param) {
+    uint8_t chunk[CHUNK_SIZE];
+    uint32_t lastErrors = 0;
+    for (;;) {
+        uart_event_t event;
+        if (xQueueReceive(uartEvents, &event, portMAX_DELAY) != pdTRUE) continue;
+        if (event.type == UART_FIFO_OVF || event.type == UART_BUFFER_FULL) {
+            // The parser drops the sentence that lost bytes on its checksum
+            uart_flush_input(GPS_UART);
+            xQueueReset(uartEvents);
+            continue;
+        }
+        if (event.type != UART_DATA) continue;
+
+        taskBudgetStart(TASK_GPS);
+        size_t waiting = 0;
+        uart_get_buffered_data_len(GPS_UART, &waiting);
+        // The newest byte arrived about now, the oldest one at the line
+        // rate before it
+        uint64_t firstUs = esp_timer_get_time() - (uint64_t)waiting * byteUs;
+        while (waiting > 0) {
+            int n = uart_read_bytes(GPS_UART, chunk, waiting < CHUNK_SIZE ? waiting : CHUNK_SIZE, 0);
+            if (n <= 0) break;
+            if (parser.feed(chunk, n, firstUs, byteUs)) {
+                GpsSample sample;
+                sample.fix = parser.fix();
+                sample.timeUs = parser.fixTimeUs();
+                latest.write(sample);
+            }
+            firstUs += (uint64_t)n * byteUs;
+            waiting -= n;
+        }
+        if (parser.checksumErrors() != lastErrors) {
+            lastErrors = parser.checksumErrors();
+            LOG_D(APP, "GPS: %u bad sentences", lastErrors);
+        }
+        taskBudgetEnd(TASK_GPS);
+    }
+}
+
+bool gpsBegin(const GpsSettings& settings) {
+    if (uartEvents) return true;
+    uart_config_t config = {};
+    config.baud_rate = (int)settings.baud;
+    config.data_bits = UART_DATA_8_BITS;
+    config.parity = UART_PARITY_DISABLE;
+    config.stop_bits = UART_STOP_BITS_1;
+    config.flow_ctrl = UART_HW_FLOWCTRL_DISABLE;
+    config.source_clk = UART_SCLK_APB;
+    if (uart_driver_install(GPS_UART, RX_BUFFER_SIZE, 0, EVENT_QUEUE_LENGTH, &uartEvents, 0) != ESP_OK) {
+        LOG_E(APP, "GPS: could not install the UART driver");
+        return false;
+    }
+    uart_param_config(GPS_UART, &config);
+    uart_set_pin(GPS_UART, settings.txPin, settings.rxPin, UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE);
+    byteUs = 10000000 / (settings.baud > 0 ? settings.baud : 1);
+
+    TaskHandle_t task = nullptr;
+    if (xTaskCreatePinnedToCore(gpsTask, PLACEMENT.name, TASK_STACK_SIZE, nullptr, PLACEMENT.priority, &task,
+                                PLACEMENT.core) != pdPASS) {
+        LOG_E(APP, "GPS: could not start the task");
+        return false;
+    }
+    perfWatchTask(task, MEMORY_TAG_TELEMETRY);
+    LOG_I(APP, "GPS on RX %d / TX %d at %u baud", settings.rxPin, settings.txPin, settings.baud);
+    return true;
+}
+
+uint32_t gpsLatest(GpsSample& out) {
+    return latest.read(out);
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <stdint.h>
+#include "gps_parser.h"
+
+struct GpsSettings {
+    int8_t rxPin;                // Core2 Port C: 13 (the receiver's TX)
+    int8_t txPin;                // ...and 14
+    uint32_t baud;
+};
+
+// A fix and when its first byte reached the UART, on the esp_timer clock
+// the VESC samples are timed by (see ble/rx_queue.h)
+struct GpsSample {
+    GpsFix fix;
+    uint64_t timeUs;
+};
+
+// A GPS receiver on the Core2's UART port (Port C), NMEA or UBX.
+//
+// A task of its own sleeps on the UART driver's event queue and feeds
+// whatever arrived to a GpsParser, so nothing polls and nothing is
+// allocated after gpsBegin(). Each fix is published through a seqlock
+// and dated by its first byte: the byte's place in the read, counted
+// back from the time of the read at the line rate. The receiver's own
+// delay between the fix and its output is not known here; it is
+// constant for a given receiver and rate.
+//
+// The decoder merges the newest fix into every combined sample (see
+// telemetry.h), so the history and the log carry the GPS speed and
+// position next to the ERPM they were measured with.
+
+// Install the UART driver and start the task. Returns false if either
+// failed.
+bool gpsBegin(const GpsSettings& settings);
+
+// Copy the newest fix. Returns the number of fixes so far, 0 for none
+// (or no GPS).
+uint32_t gpsLatest(GpsSample& out);
@@ -0,0 +1,265 @@
+#include "gps_parser.h"
+
+#include <string.h>
+
+static const uint8_t UBX_SYNC_1 = 0xB5;
+static const uint8_t UBX_SYNC_2 = 0x62;
+static const uint8_t UBX_CLASS_NAV = 0x01;
+static const uint8_t UBX_ID_NAV_PVT = 0x07;
+static const size_t UBX_NAV_PVT_LENGTH = 92;
+static const int NMEA_MAX_FIELDS = 20;
+
+GpsParser::GpsParser()
+    : state(IDLE), length(0), ubxLength(0), ubxRead(0), ckA(0), ckB(0), startUs(0), fixUs(0), parsed(0),
+      badChecksums(0) {
+    memset(&current, 0, sizeof(current));
+}
+
+static int hexDigit(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    return -1;
+}
+
+// A decimal number as an integer with the given number of decimals,
+// further decimals cut off. False for an empty or malformed field.
+static bool parseFixed(const char* s, uint8_t decimals, int32_t& out) {
+    bool negative = *s == '-';
+    if (negative) s++;
+    if (!*s) return false;
+    int32_t value = 0;
+    while (*s >= '0' && *s <= '9') value = value * 10 + (*s++ - '0');
+    uint8_t shown = 0;
+    if (*s == '.') {
+        s++;
+        while (*s >= '0' && *s <= '9') {
+            if (shown < decimals) {
+                value = value * 10 + (*s - '0');
+                shown++;
+            }
+            s++;
+        }
+    }
+    if (*s) return false;
+    for (; shown < decimals; shown++) value *= 10;
+    out = negative ? -value : value;
+    return true;
+}
+
+// ddmm.mmmmm (or dddmm.mmmmm) and a hemisphere letter as 1e-7 degrees
+static bool parseCoordinate(const char* s, const char* hemisphere, int32_t& out) {
+    int32_t minutes;     // Whole degrees * 100 + minutes, at 1e-5 minutes
+    if (!parseFixed(s, 5, minutes) || minutes < 0) return false;
+    int32_t degrees = minutes / 10000000;
+    minutes %= 10000000;
+    out = degrees * 10000000 + (minutes * 10 + 3) / 6;
+    if (hemisphere[0] == 'S' || hemisphere[0] == 'W') out = -out;
+    return hemisphere[0] == 'N' || hemisphere[0] == 'S' || hemisphere[0] == 'E' || hemisphere[0] == 'W';
+}
+
+// hhmmss.sss as ms since midnight
+static bool parseTime(const char* s, uint32_t& out) {
+    int32_t hhmmss;
+    if (!parseFixed(s, 3, hhmmss) || hhmmss < 0) return false;
+    uint32_t ms = hhmmss % 1000;
+    uint32_t t = hhmmss / 1000;
+    out = ((t / 10000) * 3600 + (t / 100 % 100) * 60 + t % 100) * 1000 + ms;
+    return true;
+}
+
+bool GpsParser::feed(const uint8_t* data, size_t count, uint64_t timeUs, uint32_t byteUs) {
+    bool completed = false;
+    for (size_t i = 0; i < count; i++) {
+        uint8_t b = data[i];
+        switch (state) {
+            case IDLE:
+                if (b == '$') {
+                    state = NMEA;
+                    length = 0;
+                    startUs = timeUs + (uint64_t)i * byteUs;
+                } else if (b == UBX_SYNC_1) {
+                    state = UBX_SYNC;
+                    startUs = timeUs + (uint64_t)i * byteUs;
+                }
+                break;
+
+            case NMEA:
+                if (b == '\r' || b == '\n') {
+                    state = IDLE;
+                    if (endNmea()) {
+                        fixUs = startUs;
+                        completed = true;
+                    }
+                } else if (b == '$') {
+                    length = 0;          // A sentence cut short, start over
+                    startUs = timeUs + (uint64_t)i * byteUs;
+                } else if (length < NMEA_MAX) {
+                    buffer[length++] = b;
+                } else {
+                    state = IDLE;
+                    badChecksums++;
+                }
+                break;
+
+            case UBX_SYNC:
+                if (b == UBX_SYNC_2) {
+                    state = UBX_HEADER;
+                    length = 0;
+                    ckA = ckB = 0;
+                } else if (b == '$') {
+                    state = NMEA;
+                    length = 0;
+                    startUs = timeUs + (uint64_t)i * byteUs;
+                } else {
+                    state = IDLE;
+                }
+                break;
+
+            case UBX_HEADER:
+                header[length++] = b;
+                ckA += b;
+                ckB += ckA;
+                if (length == sizeof(header)) {
+                    ubxLength = header[2] | (size_t)header[3] << 8;
+                    ubxRead = 0;
+                    length = 0;
+                    state = UBX_BODY;
+                }
+                break;
+
+            case UBX_BODY:
+                if (ubxRead < ubxLength) {
+                    if (ubxRead < UBX_MAX) buffer[ubxRead] = b;
+                    ckA += b;
+                    ckB += ckA;
+                } else if (ubxRead == ubxLength) {
+                    if (b != ckA) {
+                        badChecksums++;
+                        state = IDLE;
+                    }
+                } else {
+                    state = IDLE;
+                    if (b != ckB) {
+                        badChecksums++;
+                    } else if (endUbx()) {
+                        fixUs = startUs;
+                        completed = true;
+                    }
+                }
+                ubxRead++;
+                break;
+        }
+    }
+    return completed;
+}
+
+// A whole sentence without the '$' and line end: check the checksum,
+// split it into fields in place and hand it to its parser
+bool GpsParser::endNmea() {
+    if (length < 4 || buffer[length - 3] != '*') {
+        badChecksums++;
+        return false;
+    }
+    int high = hexDigit(buffer[length - 2]);
+    int low = hexDigit(buffer[length - 1]);
+    uint8_t sum = 0;
+    for (size_t i = 0; i < length - 3; i++) sum ^= buffer[i];
+    if (high < 0 || low < 0 || sum != (high << 4 | low)) {
+        badChecksums++;
+        return false;
+    }
+    parsed++;
+
+    buffer[length - 3] = 0;
+    char* fields[NMEA_MAX_FIELDS];
+    int n = 0;
+    char* p = (char*)buffer;
+    fields[n++] = p;
+    for (; *p; p++) {
+        if (*p != ',') continue;
+        *p = 0;
+        if (n < NMEA_MAX_FIELDS) fields[n++] = p + 1;
+    }
+
+    // The talker (GP, GN, GL...) does not matter, only the sentence
+    if (strlen(fields[0]) != 5) return false;
+    const char* sentence = fields[0] + 2;
+    if (strcmp(sentence, "RMC") == 0) return parseRmc(fields, n);
+    if (strcmp(sentence, "GGA") == 0) parseGga(fields, n);
+    return false;
+}
+
+// $xxRMC,time,status,lat,N,lon,E,knots,course,date,...
+bool GpsParser::parseRmc(char** fields, int count) {
+    if (count < 9) return false;
+    GpsFix& fix = current;
+    parseTime(fields[1], fix.utcMs);
+    if (fields[2][0] != 'A') {
+        fix.fix = GPS_FIX_NONE;
+        return true;
+    }
+    int32_t latitude, longitude;
+    if (!parseCoordinate(fields[3], fields[4], latitude) || !parseCoordinate(fields[5], fields[6], longitude)) {
+        return false;
+    }
+    fix.latitude = latitude;
+    fix.longitude = longitude;
+    int32_t value;
+    // Knots to 0.1 km/h: 1 kn = 1.852 km/h
+    if (parseFixed(fields[7], 3, value) && value >= 0) fix.speed = (uint16_t)((value * 1852LL + 50000) / 100000);
+    if (parseFixed(fields[8], 2, value) && value >= 0) fix.course = (uint16_t)value;
+    if (fix.fix == GPS_FIX_NONE) fix.fix = GPS_FIX_2D;     // Until a GGA says more
+    return true;
+}
+
+// $xxGGA,time,lat,N,lon,E,quality,satellites,hdop,altitude,M,...
+void GpsParser::parseGga(char** fields, int count) {
+    if (count < 10) return;
+    GpsFix& fix = current;
+    int32_t value;
+    if (parseFixed(fields[7], 0, value) && value >= 0) fix.satellites = (uint8_t)value;
+    if (parseFixed(fields[8], 2, value) && value >= 0) fix.dop = (uint16_t)value;
+    bool altitude = parseFixed(fields[9], 1, value);
+    if (altitude) fix.altitude = value;
+    if (fields[6][0] == '0' || !fields[6][0]) {
+        fix.fix = GPS_FIX_NONE;
+    } else {
+        fix.fix = altitude ? GPS_FIX_3D : GPS_FIX_2D;
+    }
+}
+
+static uint32_t ubxU32(const uint8_t* p) {
+    return p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+static uint16_t ubxU16(const uint8_t* p) {
+    return (uint16_t)(p[0] | p[1] << 8);
+}
+
+// A UBX message with a good checksum; only NAV-PVT is read
+bool GpsParser::endUbx() {
+    parsed++;
+    if (header[0] != UBX_CLASS_NAV || header[1] != UBX_ID_NAV_PVT || ubxLength != UBX_NAV_PVT_LENGTH) return false;
+
+    const uint8_t* p = buffer;
+    GpsFix& fix = current;
+    uint32_t hour = p[8], minute = p[9], second = p[10];
+    int32_t nano = (int32_t)ubxU32(p + 16);
+    int32_t ms = (int32_t)((hour * 3600 + minute * 60 + second) * 1000) + nano / 1000000;
+    fix.utcMs = ms < 0 ? 0 : (uint32_t)ms;
+
+    bool fixOk = p[21] & 0x01;
+    uint8_t type = p[20];                   // 2 = 2D, 3 = 3D, 4 = GNSS + dead reckoning
+    fix.fix = !fixOk ? GPS_FIX_NONE : type == 2 ? GPS_FIX_2D : type >= 3 && type <= 4 ? GPS_FIX_3D : GPS_FIX_NONE;
+    fix.satellites = p[23];
+    fix.longitude = (int32_t)ubxU32(p + 24);
+    fix.latitude = (int32_t)ubxU32(p + 28);
+    fix.altitude = (int32_t)ubxU32(p + 36) / 100;          // mm to 0.1 m
+    int32_t speed = (int32_t)ubxU32(p + 60);               // mm/s
+    fix.speed = speed > 0 ? (uint16_t)((speed * 36LL + 500) / 1000) : 0;
+    int32_t heading = (int32_t)ubxU32(p + 64);             // 1e-5 degrees
+    fix.course = heading > 0 ? (uint16_t)(heading / 1000) : 0;
+    fix.dop = ubxU16(p + 76);
+    return true;
+}
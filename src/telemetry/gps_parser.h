@@ -0,0 +1,82 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+enum GpsFixType : uint8_t {
+    GPS_FIX_NONE,
+    GPS_FIX_2D,
+    GPS_FIX_3D
+};
+
+// Latest position, speed and quality from the receiver
+struct GpsFix {
+    int32_t latitude;        // 1e-7 degrees, north positive
+    int32_t longitude;       // 1e-7 degrees, east positive
+    int32_t altitude;        // 0.1 m above mean sea level
+    uint32_t utcMs;          // Time of day of the fix, ms since midnight UTC
+    uint16_t speed;          // 0.1 km/h over ground, as LAYOUT_Q_SPEED
+    uint16_t course;         // 0.01 degrees from true north
+    uint16_t dop;            // 0.01, HDOP from NMEA, PDOP from UBX
+    uint8_t satellites;
+    GpsFixType fix;
+};
+
+// Incremental parser for a GPS receiver's serial output: NMEA 0183 RMC
+// and GGA sentences from any talker, and u-blox UBX NAV-PVT. Bytes can
+// arrive in pieces of any size and both protocols may be interleaved on
+// the same port. Everything is parsed out of a fixed sentence buffer, so
+// nothing is allocated; sentences or messages with a bad checksum or
+// that overflow the buffer are counted and dropped.
+//
+// An RMC sentence or a NAV-PVT message completes a fix. GGA only adds
+// the satellites, DOP and altitude, which the next RMC carries along.
+class GpsParser {
+public:
+    GpsParser();
+
+    // Parse received bytes. timeUs is when data[0] arrived and byteUs
+    // the time each byte takes on the line, so a sentence is dated by
+    // its first byte. Returns true if the bytes completed at least one
+    // fix; fix() is then the newest.
+    bool feed(const uint8_t* data, size_t length, uint64_t timeUs = 0, uint32_t byteUs = 0);
+
+    const GpsFix& fix() const { return current; }
+
+    // When the first byte of the sentence or message that completed fix()
+    // arrived
+    uint64_t fixTimeUs() const { return fixUs; }
+
+    uint32_t sentences() const { return parsed; }
+    uint32_t checksumErrors() const { return badChecksums; }
+
+private:
+    enum State : uint8_t {
+        IDLE,
+        NMEA,                // After '$', until the line ends
+        UBX_SYNC,            // After 0xB5, expecting 0x62
+        UBX_HEADER,          // Class, id and length
+        UBX_BODY             // Payload and checksum
+    };
+
+    static const size_t NMEA_MAX = 96;       // 82 by the standard, some receivers run longer
+    static const size_t UBX_MAX = 100;       // NAV-PVT is 92; longer messages are skipped
+
+    bool endNmea();
+    bool parseRmc(char** fields, int count);
+    void parseGga(char** fields, int count);
+    bool endUbx();
+
+    State state;
+    uint8_t buffer[UBX_MAX > NMEA_MAX ? UBX_MAX : NMEA_MAX];
+    size_t length;
+    uint8_t header[4];       // UBX class, id, length
+    size_t ubxLength;        // Payload bytes of the UBX message
+    size_t ubxRead;          // Payload and checksum bytes seen
+    uint8_t ckA, ckB;
+    uint64_t startUs;        // First byte of the sentence or message being read
+    uint64_t fixUs;
+    GpsFix current;
+    uint32_t parsed;
+    uint32_t badChecksums;
+};
@@ -0,0 +1,274 @@
+#include "history.h"
+#include "../log.h"
+#include "../system/memory.h"
+
+#include <Arduino.h>
+#include <string.h>
+
+TelemetryHistory::TelemetryHistory()
+    : slots(0), times(nullptr), appended(0) {
+    for (int i = 0; i < HISTORY_FIELD_COUNT; i++) columns[i] = nullptr;
+}
+
+TelemetryHistory::~TelemetryHistory() {
+    for (int i = 0; i < HISTORY_FIELD_COUNT; i++) {
+        if (columns[i]) memoryFree(columns[i]);
+    }
+    if (times) memoryFree(times);
+}
+
+bool TelemetryHistory::begin(uint32_t capacity, uint8_t pyramidLevels, uint32_t bucketsPerLevel,
+                             size_t archiveBytes) {
+    if (times) return true;
+    if (capacity == 0) return false;
+
+    size_t columnBytes = (size_t)capacity * sizeof(int32_t);
+    times = (uint32_t*)memoryAlloc(columnBytes, MEMORY_BULK, MEMORY_TAG_TELEMETRY);
+    bool ok = times != nullptr;
+    for (int i = 0; i < HISTORY_FIELD_COUNT && ok; i++) {
+        columns[i] = (int32_t*)memoryAlloc(columnBytes, MEMORY_BULK, MEMORY_TAG_TELEMETRY);
+        ok = columns[i] != nullptr;
+    }
+
+    if (!ok) {
+        LOG_E(APP, "No PSRAM for %u sample telemetry history", capacity);
+        for (int i = 0; i < HISTORY_FIELD_COUNT; i++) {
+            if (columns[i]) memoryFree(columns[i]);
+            columns[i] = nullptr;
+        }
+        if (times) memoryFree(times);
+        times = nullptr;
+        return false;
+    }
+
+    slots = capacity;
+    LOG_I(APP, "Telemetry history: %u samples, %u KB PSRAM", slots,
+          (unsigned)(columnBytes * (HISTORY_FIELD_COUNT + 1) / 1024));
+    if (pyramidLevels > 0) levels.begin(pyramidLevels, bucketsPerLevel);
+    // The raw ring covers the archive's open block and the one closing
+    if (archiveBytes > 0 && capacity >= 2 * HistoryArchive::BLOCK_SAMPLES) archive.begin(archiveBytes);
+    return true;
+}
+
+void historySample(const VescValues& values, int32_t out[HISTORY_FIELD_COUNT]) {
+    out[HISTORY_V_IN] = values.vIn;
+    out[HISTORY_CURRENT_IN] = values.currentIn;
+    out[HISTORY_CURRENT_MOTOR] = values.currentMotor;
+    out[HISTORY_DUTY] = values.dutyNow;
+    out[HISTORY_RPM] = values.rpm;
+    out[HISTORY_TEMP_FET] = values.tempFet;
+    out[HISTORY_TEMP_MOTOR] = values.tempMotor;
+    out[HISTORY_POWER] = (int32_t)(((int64_t)values.vIn * values.currentIn) / 100);
+    out[HISTORY_GPS_SPEED] = (values.fields & VALUES_FIELD_GPS) ? values.gpsSpeed : 0;
+}
+
+void TelemetryHistory::append(const VescValues& values, uint32_t timeMs) {
+    if (!times) return;
+
+    int32_t sample[HISTORY_FIELD_COUNT];
+    historySample(values, sample);
+
+    uint32_t n = appended.load(std::memory_order_relaxed);
+    uint32_t slot = n % slots;
+    for (int f = 0; f < HISTORY_FIELD_COUNT; f++) {
+        columns[f][slot] = sample[f];
+    }
+    times[slot] = timeMs;
+    levels.add(sample);
+    archive.add(sample, timeMs);
+
+    // Publish after the columns are written
+    appended.store(n + 1, std::memory_order_release);
+}
+
+uint32_t TelemetryHistory::count() const {
+    uint32_t n = total();
+    return n < slots ? n : slots;
+}
+
+uint32_t TelemetryHistory::slotFor(uint32_t age, uint32_t newest) const {
+    return (newest - 1 - age) % slots;
+}
+
+int32_t TelemetryHistory::value(HistoryField field, uint32_t age) const {
+    return columns[field][slotFor(age, total())];
+}
+
+uint32_t TelemetryHistory::timeMs(uint32_t age) const {
+    return times[slotFor(age, total())];
+}
+
+uint32_t TelemetryHistory::countSince(uint32_t sinceMs) const {
+    return countSince(sinceMs, total());
+}
+
+uint32_t TelemetryHistory::countSince(uint32_t sinceMs, uint32_t newest) const {
+    if (!times) return 0;
+
+    uint32_t available = newest < slots ? newest : slots;
+
+    // Timestamps grow with age going down, so find the first age whose
+    // sample is older than sinceMs. Compared as differences so a millis()
+    // wrap does not break the ordering.
+    uint32_t low = 0;
+    uint32_t high = available;
+    while (low < high) {
+        uint32_t mid = low + (high - low) / 2;
+        if ((int32_t)(times[slotFor(mid, newest)] - sinceMs) >= 0) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return low;
+}
+
+void TelemetryHistory::copySlots(HistoryField field, uint32_t firstSlot, uint32_t n, int32_t* out) const {
+    // At most two contiguous runs of the ring
+    const int32_t* column = columns[field];
+    uint32_t run = slots - firstSlot;
+    if (run >= n) {
+        memcpy(out, column + firstSlot, n * sizeof(int32_t));
+    } else {
+        memcpy(out, column + firstSlot, run * sizeof(int32_t));
+        memcpy(out + run, column, (n - run) * sizeof(int32_t));
+    }
+}
+
+uint32_t TelemetryHistory::oldest() const {
+    uint32_t newest = total();
+    uint32_t oldestRaw = newest > slots ? newest - slots : 0;
+    if (archive.stored() > 0 && (int32_t)(archive.oldest() - oldestRaw) < 0) return archive.oldest();
+    return oldestRaw;
+}
+
+bool TelemetryHistory::clipRange(uint32_t& first, uint32_t& n) const {
+    if (!times) return false;
+
+    uint32_t newest = total();
+    uint32_t oldest = this->oldest();
+    if ((int32_t)(first - oldest) < 0) {
+        uint32_t skip = oldest - first;
+        if (skip >= n) return false;
+        first = oldest;
+        n -= skip;
+    }
+    if ((int32_t)(newest - first) <= 0) return false;
+    if (n > newest - first) n = newest - first;
+    return true;
+}
+
+// The part of a clipped range older than the raw ring, from the archive;
+// first and n are left on the rest
+uint32_t TelemetryHistory::copyArchived(uint8_t column, uint32_t& first, uint32_t& n, int32_t* out) const {
+    uint32_t newest = total();
+    uint32_t oldestRaw = newest > slots ? newest - slots : 0;
+    if ((int32_t)(first - oldestRaw) >= 0) return 0;
+    uint32_t want = oldestRaw - first < n ? oldestRaw - first : n;
+    uint32_t got = archive.copy(column, first, want, out);
+    first += got;
+    // Blocks dropped under the read leave nothing the raw ring can fill
+    n = got < want ? 0 : n - got;
+    return got;
+}
+
+uint32_t TelemetryHistory::copyRange(HistoryField field, uint32_t first, uint32_t n, int32_t* out) const {
+    if (!clipRange(first, n)) return 0;
+    uint32_t archived = copyArchived(field, first, n, out);
+    if (n > 0) copySlots(field, first % slots, n, out + archived);
+    return archived + n;
+}
+
+uint32_t TelemetryHistory::copyTimes(uint32_t first, uint32_t n, uint32_t* out) const {
+    if (!clipRange(first, n)) return 0;
+    uint32_t archived = copyArchived(HISTORY_FIELD_COUNT, first, n, (int32_t*)out);
+    out += archived;
+    if (n == 0) return archived;
+    uint32_t firstSlot = first % slots;
+    uint32_t run = slots - firstSlot;
+    if (run >= n) {
+        memcpy(out, times + firstSlot, n * sizeof(uint32_t));
+    } else {
+        memcpy(out, times + firstSlot, run * sizeof(uint32_t));
+        memcpy(out + run, times, (n - run) * sizeof(uint32_t));
+    }
+    return archived + n;
+}
+
+uint32_t TelemetryHistory::copyRecent(HistoryField field, int32_t* out, uint32_t maxCount) const {
+    if (!times) return 0;
+
+    uint32_t newest = total();
+    uint32_t available = newest < slots ? newest : slots;
+    uint32_t n = maxCount < available ? maxCount : available;
+    if (n == 0) return 0;
+
+    copySlots(field, slotFor(n - 1, newest), n, out);
+    return n;
+}
+
+uint32_t TelemetryHistory::decimate(HistoryField field, uint32_t first, uint32_t n, uint32_t maxBuckets,
+                                    HistoryBucket* out, uint32_t& samplesPerBucket) const {
+    if (n == 0 || maxBuckets == 0) return 0;
+
+    // Raw samples, if they fit and are still stored
+    if (n <= maxBuckets && (int32_t)(first - oldest()) >= 0) {
+        samplesPerBucket = 1;
+        int32_t chunk[32];
+        uint32_t written = 0;
+        while (written < n) {
+            uint32_t want = n - written < 32 ? n - written : 32;
+            uint32_t got = copyRange(field, first + written, want, chunk);
+            for (uint32_t i = 0; i < got; i++) {
+                out[written + i].min = chunk[i];
+                out[written + i].max = chunk[i];
+                out[written + i].mean = chunk[i];
+            }
+            written += got;
+            if (got < want) break;
+        }
+        return written;
+    }
+
+    // Finest level whose buckets spanning the range fit in maxBuckets
+    uint8_t level = 1;
+    uint32_t size = HistoryPyramid::FANOUT;
+    uint32_t last = first + n - 1;
+    while (level < levels.levels() && last / size - first / size + 1 > maxBuckets) {
+        level++;
+        size *= HistoryPyramid::FANOUT;
+    }
+
+    uint32_t firstBucket = first / size;
+    uint32_t count = last / size - firstBucket + 1;
+    if (count > maxBuckets) {
+        // Range longer than even the top level can show; keep the newest part
+        firstBucket += count - maxBuckets;
+        count = maxBuckets;
+    }
+    samplesPerBucket = size;
+    return levels.copy(field, level, firstBucket, count, out);
+}
+
+bool TelemetryHistory::stats(HistoryField field, uint32_t windowMs, uint32_t nowMs, HistoryStats& out) const {
+    uint32_t newest = total();
+    uint32_t n = countSince(nowMs - windowMs, newest);
+    if (n == 0) return false;
+
+    const int32_t* column = columns[field];
+    int32_t minValue = column[slotFor(0, newest)];
+    int32_t maxValue = minValue;
+    int64_t sum = 0;
+    for (uint32_t age = 0; age < n; age++) {
+        int32_t v = column[slotFor(age, newest)];
+        if (v < minValue) minValue = v;
+        if (v > maxValue) maxValue = v;
+        sum += v;
+    }
+
+    out.min = minValue;
+    out.max = maxValue;
+    out.avg = (int32_t)(sum / (int64_t)n);
+    out.count = n;
+    return true;
+}
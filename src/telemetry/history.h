@@ -0,0 +1,125 @@
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+#include "vesc/values.h"
+#include "history_pyramid.h"
+#include "history_archive.h"
+
+// Quantities kept in the history, one column each
+enum HistoryField : uint8_t {
+    HISTORY_V_IN,            // 0.1 V
+    HISTORY_CURRENT_IN,      // 0.01 A
+    HISTORY_CURRENT_MOTOR,   // 0.01 A
+    HISTORY_DUTY,            // 0.001
+    HISTORY_RPM,             // ERPM
+    HISTORY_TEMP_FET,        // 0.1 °C
+    HISTORY_TEMP_MOTOR,      // 0.1 °C
+    HISTORY_POWER,           // 0.1 W, input voltage x input current
+    HISTORY_GPS_SPEED,       // 0.1 km/h from the GPS, 0 without a fix
+    HISTORY_FIELD_COUNT
+};
+
+static_assert(HISTORY_FIELD_COUNT == HISTORY_PYRAMID_FIELDS, "pyramid must cover every history field");
+
+// One sample's value of every history field
+void historySample(const VescValues& values, int32_t out[HISTORY_FIELD_COUNT]);
+
+struct HistoryStats {
+    int32_t min;
+    int32_t max;
+    int32_t avg;
+    uint32_t count;          // Samples in the window
+};
+
+// Fixed-capacity ring of timestamped telemetry samples, stored as one
+// array per field in PSRAM so a graph or a min/max query only touches the
+// column it needs. Appending is O(1) and never allocates; once full, the
+// oldest sample is overwritten.
+//
+// One task appends, others read. A reader sees every sample up to the
+// published count; a sample that is being overwritten while a reader
+// walks the very oldest end of a full buffer may be torn, so queries
+// should stay a little short of capacity() if that matters.
+//
+// A HistoryPyramid is kept alongside for views too long to scan sample
+// by sample; decimate() picks the level that fits a given width. With a
+// HistoryArchive too, the range reads (copyRange(), copyTimes() and
+// decimate()'s raw samples) go on past the raw ring into its compressed
+// blocks; the queries by age and by time see the raw ring only.
+class TelemetryHistory {
+public:
+    TelemetryHistory();
+    ~TelemetryHistory();
+
+    // Allocate room for capacity samples per column, plus a pyramid of
+    // pyramidLevels levels with bucketsPerLevel buckets each (0 levels for
+    // none) and an archive of archiveBytes (0 for none; it needs a raw
+    // ring of two of its blocks at least). Returns false if the raw
+    // columns could not be allocated, in which case the history stays
+    // empty.
+    bool begin(uint32_t capacity, uint8_t pyramidLevels, uint32_t bucketsPerLevel, size_t archiveBytes = 0);
+
+    // Only one task may call append()
+    void append(const VescValues& values, uint32_t timeMs);
+
+    uint32_t capacity() const { return slots; }
+
+    // Samples currently stored
+    uint32_t count() const;
+
+    // Samples appended since boot; changes whenever a sample is added
+    uint32_t total() const { return appended.load(std::memory_order_acquire); }
+
+    // Index, counting as total() does, of the oldest sample the range
+    // reads still return, from the archive or the raw ring
+    uint32_t oldest() const;
+
+    // Sample by age, 0 = newest. age must be below count().
+    int32_t value(HistoryField field, uint32_t age) const;
+    uint32_t timeMs(uint32_t age) const;
+
+    // Number of newest samples taken at or after sinceMs (binary search)
+    uint32_t countSince(uint32_t sinceMs) const;
+
+    // Copy samples [first, first + n) of one field, counting from boot as
+    // total() does. Samples already overwritten are skipped. Returns how
+    // many were copied.
+    uint32_t copyRange(HistoryField field, uint32_t first, uint32_t n, int32_t* out) const;
+
+    // Timestamps of the same range, skipping overwritten samples alike
+    uint32_t copyTimes(uint32_t first, uint32_t n, uint32_t* out) const;
+
+    // Copy the newest samples of one field, oldest first. Returns how
+    // many were copied.
+    uint32_t copyRecent(HistoryField field, int32_t* out, uint32_t maxCount) const;
+
+    // Summarize samples [first, first + n) as at most maxBuckets buckets,
+    // oldest first, reading raw samples when they fit and otherwise the
+    // finest pyramid level that does. samplesPerBucket is set to the
+    // samples each bucket covers. Returns the number of buckets written;
+    // ranges older than what is stored come back shorter.
+    uint32_t decimate(HistoryField field, uint32_t first, uint32_t n, uint32_t maxBuckets,
+                      HistoryBucket* out, uint32_t& samplesPerBucket) const;
+
+    const HistoryPyramid& pyramid() const { return levels; }
+    const HistoryArchive& archived() const { return archive; }
+
+    // Min/max/average of a field over the last windowMs before nowMs.
+    // Returns false if the window holds no samples.
+    bool stats(HistoryField field, uint32_t windowMs, uint32_t nowMs, HistoryStats& out) const;
+
+private:
+    uint32_t slotFor(uint32_t age, uint32_t newest) const;
+    bool clipRange(uint32_t& first, uint32_t& n) const;
+    uint32_t countSince(uint32_t sinceMs, uint32_t newest) const;
+    void copySlots(HistoryField field, uint32_t firstSlot, uint32_t n, int32_t* out) const;
+    uint32_t copyArchived(uint8_t column, uint32_t& first, uint32_t& n, int32_t* out) const;
+
+    uint32_t slots;
+    int32_t* columns[HISTORY_FIELD_COUNT];
+    uint32_t* times;
+    std::atomic<uint32_t> appended;
+    HistoryPyramid levels;
+    HistoryArchive archive;
+};
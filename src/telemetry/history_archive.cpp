@@ -0,0 +1,145 @@
+#include "history_archive.h"
+#include "../log.h"
+#include "../system/memory.h"
+
+#include <Arduino.h>
+#include <string.h>
+
+// A column of a block takes at least a bit per sample
+static const size_t MIN_BLOCK_BYTES = HistoryArchive::COLUMNS * HistoryArchive::BLOCK_SAMPLES / 8;
+
+static SampleCoding columnCoding(uint8_t column) {
+    return column == HISTORY_PYRAMID_FIELDS ? SAMPLE_DELTA_OF_DELTA : SAMPLE_DELTA;
+}
+
+HistoryArchive::HistoryArchive()
+    : pool(nullptr), poolBytes(0), index(nullptr), maxBlocks(0), scratch(nullptr), scratchColumnBytes(0),
+      writeOffset(0), oldestBlock(0), closedBlocks(0) {}
+
+HistoryArchive::~HistoryArchive() {
+    if (pool) memoryFree(pool);
+    if (index) memoryFree(index);
+    if (scratch) memoryFree(scratch);
+}
+
+bool HistoryArchive::begin(size_t bytes) {
+    if (pool) return true;
+    scratchColumnBytes = SampleEncoder::maxBytes(BLOCK_SAMPLES);
+    if (bytes < COLUMNS * scratchColumnBytes) return false;
+
+    maxBlocks = bytes / MIN_BLOCK_BYTES + 1;
+    pool = (uint8_t*)memoryAlloc(bytes, MEMORY_BULK, MEMORY_TAG_TELEMETRY);
+    index = (BlockInfo*)memoryAlloc(maxBlocks * sizeof(BlockInfo), MEMORY_BULK, MEMORY_TAG_TELEMETRY);
+    scratch = (uint8_t*)memoryAlloc(COLUMNS * scratchColumnBytes, MEMORY_BULK, MEMORY_TAG_TELEMETRY);
+    if (!pool || !index || !scratch) {
+        LOG_E(APP, "No PSRAM for a %u KB history archive", (unsigned)(bytes / 1024));
+        if (pool) memoryFree(pool);
+        if (index) memoryFree(index);
+        if (scratch) memoryFree(scratch);
+        pool = nullptr;
+        index = nullptr;
+        scratch = nullptr;
+        return false;
+    }
+
+    poolBytes = bytes;
+    for (uint8_t c = 0; c < COLUMNS; c++) {
+        encoders[c].begin(columnCoding(c), scratch + c * scratchColumnBytes, scratchColumnBytes);
+    }
+    LOG_I(APP, "History archive: %u KB PSRAM", (unsigned)(bytes / 1024));
+    return true;
+}
+
+size_t HistoryArchive::blockSize(const BlockInfo& info) {
+    size_t size = 0;
+    for (uint8_t c = 0; c < COLUMNS; c++) size += info.columnBytes[c];
+    return size;
+}
+
+void HistoryArchive::add(const int32_t values[HISTORY_PYRAMID_FIELDS], uint32_t timeMs) {
+    if (!pool) return;
+    for (uint8_t f = 0; f < HISTORY_PYRAMID_FIELDS; f++) encoders[f].add(values[f]);
+    encoders[HISTORY_PYRAMID_FIELDS].add((int32_t)timeMs);
+    if (encoders[0].count() == BLOCK_SAMPLES) closeBlock();
+}
+
+// Copy the open block's columns to the end of the ring, dropping what
+// they land on, then start the next one
+void HistoryArchive::closeBlock() {
+    BlockInfo info;
+    for (uint8_t c = 0; c < COLUMNS; c++) info.columnBytes[c] = (uint16_t)encoders[c].bytes();
+    size_t size = blockSize(info);
+
+    uint32_t oldest = oldestBlock.load(std::memory_order_relaxed);
+    uint32_t closed = closedBlocks.load(std::memory_order_relaxed);
+    if (writeOffset + size > poolBytes) {
+        // What is left at the end is too short; the blocks there go first
+        while (oldest < closed && index[oldest % maxBlocks].offset >= writeOffset) oldest++;
+        writeOffset = 0;
+    }
+    while (oldest < closed) {
+        const BlockInfo& old = index[oldest % maxBlocks];
+        bool overlaps = old.offset < writeOffset + size && old.offset + blockSize(old) > writeOffset;
+        if (!overlaps && closed - oldest < maxBlocks) break;
+        oldest++;
+    }
+    // Readers stop trusting the blocks before they are written over
+    oldestBlock.store(oldest, std::memory_order_release);
+
+    info.offset = writeOffset;
+    size_t at = writeOffset;
+    for (uint8_t c = 0; c < COLUMNS; c++) {
+        memcpy(pool + at, scratch + c * scratchColumnBytes, info.columnBytes[c]);
+        at += info.columnBytes[c];
+    }
+    index[closed % maxBlocks] = info;
+    writeOffset = at;
+    closedBlocks.store(closed + 1, std::memory_order_release);
+
+    for (uint8_t c = 0; c < COLUMNS; c++) {
+        encoders[c].begin(columnCoding(c), scratch + c * scratchColumnBytes, scratchColumnBytes);
+    }
+}
+
+uint32_t HistoryArchive::oldest() const {
+    return oldestBlock.load(std::memory_order_acquire) * BLOCK_SAMPLES;
+}
+
+uint32_t HistoryArchive::end() const {
+    return closedBlocks.load(std::memory_order_acquire) * BLOCK_SAMPLES;
+}
+
+uint32_t HistoryArchive::copy(uint8_t column, uint32_t first, uint32_t n, int32_t* out) const {
+    if (!pool || column >= COLUMNS) return 0;
+    uint32_t from = oldest();
+    uint32_t to = end();
+    if (first < from || first >= to) return 0;
+    if (n > to - first) n = to - first;
+
+    uint32_t written = 0;
+    while (written < n) {
+        uint32_t sample = first + written;
+        uint32_t block = sample / BLOCK_SAMPLES;
+        const BlockInfo& info = index[block % maxBlocks];
+        size_t offset = info.offset;
+        for (uint8_t c = 0; c < column; c++) offset += info.columnBytes[c];
+
+        // Columns only decode from their start
+        SampleDecoder decoder(columnCoding(column), pool + offset, info.columnBytes[column]);
+        uint32_t skip = sample - block * BLOCK_SAMPLES;
+        for (uint32_t i = 0; i < skip; i++) decoder.next();
+        uint32_t take = BLOCK_SAMPLES - skip;
+        if (take > n - written) take = n - written;
+        for (uint32_t i = 0; i < take; i++) out[written + i] = decoder.next();
+        written += take;
+    }
+    return written;
+}
+
+size_t HistoryArchive::usedBytes() const {
+    uint32_t oldest = oldestBlock.load(std::memory_order_acquire);
+    uint32_t closed = closedBlocks.load(std::memory_order_acquire);
+    size_t used = 0;
+    for (uint32_t b = oldest; b < closed; b++) used += blockSize(index[b % maxBlocks]);
+    return used;
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+#include "history_pyramid.h"
+#include "sample_codec.h"
+
+// Compressed tier of the telemetry history, so the graphs can reach back
+// over a whole ride at full resolution after the raw ring has moved on.
+// Every sample is added here as well; each BLOCK_SAMPLES of them are
+// packed column by column (sample_codec.h) into one block of a byte ring
+// in PSRAM, typically a tenth of their raw size. Once the ring is full
+// the oldest blocks are dropped for the new one.
+//
+// Blocks are aligned to multiples of BLOCK_SAMPLES counted from the first
+// sample since boot, the index TelemetryHistory::total() uses, and only
+// closed blocks are readable; the newest samples are for the raw ring to
+// serve. One task adds, others read; as with the raw ring, a block being
+// dropped while it is read may come back torn.
+class HistoryArchive {
+public:
+    static const uint32_t BLOCK_SAMPLES = 256;
+    static const uint8_t COLUMNS = HISTORY_PYRAMID_FIELDS + 1;  // The fields, then the timestamps
+
+    HistoryArchive();
+    ~HistoryArchive();
+
+    // Allocate a ring of bytes in PSRAM. Returns false without the
+    // memory, in which case nothing is archived.
+    bool begin(size_t bytes);
+
+    bool active() const { return pool != nullptr; }
+
+    // Add the next sample. Only one task may call add().
+    void add(const int32_t values[HISTORY_PYRAMID_FIELDS], uint32_t timeMs);
+
+    // Range of sample indices readable, [oldest(), end())
+    uint32_t oldest() const;
+    uint32_t end() const;
+
+    // Decode samples [first, first + n) of a field, or column
+    // HISTORY_PYRAMID_FIELDS for their timestamps, which must lie within
+    // [oldest(), end()). Returns how many were written.
+    uint32_t copy(uint8_t column, uint32_t first, uint32_t n, int32_t* out) const;
+
+    // Bytes the stored blocks take, for their raw size see stored()
+    size_t usedBytes() const;
+    uint32_t stored() const { return end() - oldest(); }
+
+private:
+    struct BlockInfo {
+        uint32_t offset;                    // In the pool
+        uint16_t columnBytes[COLUMNS];
+    };
+
+    void closeBlock();
+    static size_t blockSize(const BlockInfo& info);
+
+    uint8_t* pool;
+    size_t poolBytes;
+    BlockInfo* index;                       // Ring of maxBlocks entries
+    uint32_t maxBlocks;
+    uint8_t* scratch;                       // The open block's columns
+    size_t scratchColumnBytes;
+    SampleEncoder encoders[COLUMNS];
+    size_t writeOffset;
+    std::atomic<uint32_t> oldestBlock;
+    std::atomic<uint32_t> closedBlocks;
+};
@@ -0,0 +1,139 @@
+#include "history_pyramid.h"
+#include "../log.h"
+#include "../system/memory.h"
+
+#include <Arduino.h>
+#include <string.h>
+
+HistoryPyramid::HistoryPyramid() : levelCount(0), bucketsPerLevel(0) {
+    for (int level = 0; level < MAX_LEVELS; level++) {
+        storage[level] = nullptr;
+        openParts[level] = 0;
+        closed[level].store(0, std::memory_order_relaxed);
+    }
+    memset(open, 0, sizeof(open));
+}
+
+HistoryPyramid::~HistoryPyramid() {
+    for (int level = 0; level < MAX_LEVELS; level++) {
+        if (storage[level]) memoryFree(storage[level]);
+    }
+}
+
+bool HistoryPyramid::begin(uint8_t levels, uint32_t buckets) {
+    if (levelCount > 0) return true;
+    if (levels == 0 || buckets == 0) return false;
+    if (levels > MAX_LEVELS) levels = MAX_LEVELS;
+
+    size_t levelBytes = (size_t)buckets * HISTORY_PYRAMID_FIELDS * sizeof(HistoryBucket);
+    for (uint8_t level = 0; level < levels; level++) {
+        storage[level] = (HistoryBucket*)memoryAlloc(levelBytes, MEMORY_BULK, MEMORY_TAG_TELEMETRY);
+        if (!storage[level]) {
+            LOG_E(APP, "No PSRAM for history pyramid level %d", level + 1);
+            for (uint8_t i = 0; i < level; i++) {
+                memoryFree(storage[i]);
+                storage[i] = nullptr;
+            }
+            return false;
+        }
+    }
+
+    bucketsPerLevel = buckets;
+    levelCount = levels;
+    LOG_I(APP, "History pyramid: %d levels x %u buckets, %u KB PSRAM", levels, buckets,
+          (unsigned)(levelBytes * levels / 1024));
+    return true;
+}
+
+uint32_t HistoryPyramid::bucketSize(uint8_t level) {
+    uint32_t size = 1;
+    for (uint8_t i = 0; i < level; i++) size *= FANOUT;
+    return size;
+}
+
+void HistoryPyramid::reset() {
+    for (int level = 0; level < MAX_LEVELS; level++) {
+        openParts[level] = 0;
+        closed[level].store(0, std::memory_order_release);
+    }
+    memset(open, 0, sizeof(open));
+}
+
+void HistoryPyramid::add(const int32_t values[HISTORY_PYRAMID_FIELDS]) {
+    if (levelCount == 0) return;
+
+    // What feeds the current level: one raw sample, then each closed bucket
+    Accumulator carry[HISTORY_PYRAMID_FIELDS];
+    for (uint8_t f = 0; f < HISTORY_PYRAMID_FIELDS; f++) {
+        carry[f].sum = values[f];
+        carry[f].count = 1;
+        carry[f].min = values[f];
+        carry[f].max = values[f];
+    }
+
+    for (uint8_t level = 0; level < levelCount; level++) {
+        Accumulator* acc = open[level];
+        bool first = openParts[level] == 0;
+        for (uint8_t f = 0; f < HISTORY_PYRAMID_FIELDS; f++) {
+            if (first) {
+                acc[f] = carry[f];
+            } else {
+                acc[f].sum += carry[f].sum;
+                acc[f].count += carry[f].count;
+                if (carry[f].min < acc[f].min) acc[f].min = carry[f].min;
+                if (carry[f].max > acc[f].max) acc[f].max = carry[f].max;
+            }
+        }
+        if (++openParts[level] < FANOUT) return;
+
+        // Close the bucket and carry it up
+        uint32_t index = closed[level].load(std::memory_order_relaxed);
+        uint32_t slot = index % bucketsPerLevel;
+        for (uint8_t f = 0; f < HISTORY_PYRAMID_FIELDS; f++) {
+            HistoryBucket& bucket = storage[level][f * bucketsPerLevel + slot];
+            bucket.min = acc[f].min;
+            bucket.max = acc[f].max;
+            bucket.mean = (int32_t)(acc[f].sum / (int64_t)acc[f].count);
+            carry[f] = acc[f];
+        }
+        openParts[level] = 0;
+        closed[level].store(index + 1, std::memory_order_release);
+    }
+}
+
+uint32_t HistoryPyramid::closedBuckets(uint8_t level) const {
+    if (level == 0 || level > levelCount) return 0;
+    return closed[level - 1].load(std::memory_order_acquire);
+}
+
+uint32_t HistoryPyramid::oldestBucket(uint8_t level) const {
+    uint32_t newest = closedBuckets(level);
+    return newest > bucketsPerLevel ? newest - bucketsPerLevel : 0;
+}
+
+uint32_t HistoryPyramid::copy(uint8_t field, uint8_t level, uint32_t first, uint32_t n,
+                              HistoryBucket* out) const {
+    if (level == 0 || level > levelCount || field >= HISTORY_PYRAMID_FIELDS) return 0;
+
+    uint32_t newest = closedBuckets(level);
+    uint32_t oldest = newest > bucketsPerLevel ? newest - bucketsPerLevel : 0;
+    if (first < oldest) {
+        uint32_t skip = oldest - first;
+        if (skip >= n) return 0;
+        first = oldest;
+        n -= skip;
+    }
+    if (first >= newest) return 0;
+    if (n > newest - first) n = newest - first;
+
+    const HistoryBucket* column = storage[level - 1] + field * bucketsPerLevel;
+    uint32_t slot = first % bucketsPerLevel;
+    uint32_t run = bucketsPerLevel - slot;
+    if (run >= n) {
+        memcpy(out, column + slot, n * sizeof(HistoryBucket));
+    } else {
+        memcpy(out, column + slot, run * sizeof(HistoryBucket));
+        memcpy(out + run, column, (n - run) * sizeof(HistoryBucket));
+    }
+    return n;
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+
+// Number of columns in the history; matches HistoryField in history.h
+static const uint8_t HISTORY_PYRAMID_FIELDS = 9;
+
+// Summary of a run of consecutive samples
+struct HistoryBucket {
+    int32_t min;
+    int32_t max;
+    int32_t mean;
+};
+
+// Min/max/mean decimation of the telemetry history for zoomed-out views.
+// Level 1 buckets cover FANOUT samples, level 2 FANOUT^2 and so on; each
+// level is its own ring of bucketsPerLevel buckets in PSRAM, so the coarse
+// levels reach back much further than the raw ring. add() is amortized
+// O(1): a sample lands in the level 1 accumulator, and every FANOUT
+// closed buckets roll up into one bucket of the next level.
+//
+// Buckets are aligned to multiples of their size counted from the first
+// sample since boot, the same index TelemetryHistory::total() uses. As
+// with the history, one task adds and others read closed buckets.
+class HistoryPyramid {
+public:
+    static const uint32_t FANOUT = 4;
+    static const uint8_t MAX_LEVELS = 12;
+
+    HistoryPyramid();
+    ~HistoryPyramid();
+
+    // Allocate every level. Returns false if there was not enough memory,
+    // in which case the pyramid stays empty.
+    bool begin(uint8_t levels, uint32_t bucketsPerLevel);
+
+    // Drop every bucket, keeping the memory, so the next sample is index
+    // 0 again. Not while another task adds or reads.
+    void reset();
+
+    // Add one sample of every field. Only one task may call add().
+    void add(const int32_t values[HISTORY_PYRAMID_FIELDS]);
+
+    uint8_t levels() const { return levelCount; }
+
+    // Samples covered by one bucket of a level (1 <= level <= levels())
+    static uint32_t bucketSize(uint8_t level);
+
+    // Index of the newest closed bucket + 1 at a level, and the oldest
+    // bucket still stored
+    uint32_t closedBuckets(uint8_t level) const;
+    uint32_t oldestBucket(uint8_t level) const;
+
+    // Copy buckets [first, first + n) of one field at a level. Buckets
+    // outside what is stored are skipped; returns how many were copied.
+    uint32_t copy(uint8_t field, uint8_t level, uint32_t first, uint32_t n, HistoryBucket* out) const;
+
+private:
+    struct Accumulator {
+        int64_t sum;
+        uint32_t count;
+        int32_t min;
+        int32_t max;
+    };
+
+    uint8_t levelCount;
+    uint32_t bucketsPerLevel;
+    HistoryBucket* storage[MAX_LEVELS];            // [field][bucket] per level
+    Accumulator open[MAX_LEVELS][HISTORY_PYRAMID_FIELDS];
+    uint32_t openParts[MAX_LEVELS];                // Children in the open bucket
+    std::atomic<uint32_t> closed[MAX_LEVELS];
+};
@@ -0,0 +1,238 @@
+#include "imu.h"
+#include "attitude.h"
+#include "../log.h"
+#include "../system/i2c_bus.h"
+#include "../system/perf_stats.h"
+#include "../system/task_layout.h"
+
+#include <Arduino.h>
+#include <Wire.h>
+#include <esp_timer.h>
+#include <math.h>
+
+// MPU6886 registers, as the M5Core2 library's driver names them
+static const uint8_t MPU6886_ADDRESS = 0x68;
+static const uint8_t REG_SMPLRT_DIV = 0x19;
+static const uint8_t REG_CONFIG = 0x1A;
+static const uint8_t REG_GYRO_CONFIG = 0x1B;
+static const uint8_t REG_ACCEL_CONFIG = 0x1C;
+static const uint8_t REG_ACCEL_CONFIG2 = 0x1D;
+static const uint8_t REG_FIFO_EN = 0x23;
+static const uint8_t REG_USER_CTRL = 0x6A;
+static const uint8_t REG_PWR_MGMT_1 = 0x6B;
+static const uint8_t REG_FIFO_COUNT = 0x72;
+static const uint8_t REG_FIFO_R_W = 0x74;
+static const uint8_t REG_WHO_AM_I = 0x75;
+static const uint8_t WHO_AM_I = 0x19;
+
+static const uint8_t FIFO_GYRO_ACCEL = 0x18;       // Gyro (with temperature) and accelerometer
+static const uint8_t USER_FIFO_ENABLE = 0x40;
+static const uint8_t USER_FIFO_RESET = 0x04;
+static const uint8_t CONFIG_DLPF_176HZ = 0x01;     // And a 1 kHz internal rate to divide down
+static const uint8_t GYRO_2000DPS = 0x18;          // The ranges M5.IMU reads with
+static const uint8_t ACCEL_8G = 0x10;
+
+static const uint16_t FIFO_SIZE = 1024;
+static const uint8_t PACKET_SIZE = 14;             // Accelerometer, temperature, gyro; big-endian
+static const uint8_t BURST_PACKETS = 9;            // 126 bytes, within the Wire driver's 128-byte buffer
+static const float ACCEL_G_PER_LSB = 1.0f / 4096;
+static const float GYRO_RAD_PER_LSB = 0.0174533f / 16.4f;
+static const uint8_t RING_SIZE = 64;               // Two reads at 500 Hz and 50 ms
+static const uint32_t TASK_STACK_SIZE = 3072;
+static const TaskPlacement& PLACEMENT = TASK_PLACEMENT[TASK_IMU];
+
+static TaskHandle_t task = nullptr;
+static ImuSettings settings;
+static AttitudeFilter* filter = nullptr;
+static uint32_t periodUs = 10000;
+static uint32_t readUs = 50000;
+static ImuStats stats;
+
+static portMUX_TYPE ringMux = portMUX_INITIALIZER_UNLOCKED;
+static ImuSample ring[RING_SIZE];
+static uint32_t ringWritten = 0;
+static uint8_t fifo[FIFO_SIZE];                    // The last drain; only the IMU task reads it
+
+static bool readRegisters(uint8_t reg, uint8_t* out, uint8_t length) {
+    Wire1.beginTransmission(MPU6886_ADDRESS);
+    Wire1.write(reg);
+    if (Wire1.endTransmission(false) != 0) return false;
+    if (Wire1.requestFrom(MPU6886_ADDRESS, length) != length) return false;
+    for (uint8_t i = 0; i < length; i++) out[i] = (uint8_t)Wire1.read();
+    return true;
+}
+
+static void writeRegister(uint8_t reg, uint8_t value) {
+    Wire1.beginTransmission(MPU6886_ADDRESS);
+    Wire1.write(reg);
+    Wire1.write(value);
+    Wire1.endTransmission();
+}
+
+static void resetFifo() {
+    writeRegister(REG_FIFO_EN, 0);
+    writeRegister(REG_USER_CTRL, USER_FIFO_RESET);
+    writeRegister(REG_FIFO_EN, FIFO_GYRO_ACCEL);
+    writeRegister(REG_USER_CTRL, USER_FIFO_ENABLE);
+}
+
+static int16_t bigEndian(const uint8_t* data) {
+    return (int16_t)((uint16_t)data[0] << 8 | data[1]);
+}
+
+static int16_t scaled(float value, float scale) {
+    float x = value * scale;
+    if (x > INT16_MAX) return INT16_MAX;
+    if (x < -INT16_MAX) return -INT16_MAX;
+    return (int16_t)lroundf(x);
+}
+
+static void filterPacket(const uint8_t* packet, uint64_t timeUs) {
+    float ax = bigEndian(packet) * ACCEL_G_PER_LSB;
+    float ay = bigEndian(packet + 2) * ACCEL_G_PER_LSB;
+    float az = bigEndian(packet + 4) * ACCEL_G_PER_LSB;
+    float gx = bigEndian(packet + 8) * GYRO_RAD_PER_LSB;
+    float gy = bigEndian(packet + 10) * GYRO_RAD_PER_LSB;
+    float gz = bigEndian(packet + 12) * GYRO_RAD_PER_LSB;
+    filter->update(gx, gy, gz, ax, ay, az, periodUs * 1e-6f);
+
+    ImuSample sample;
+    sample.timeUs = timeUs;
+    sample.pitch = scaled(filter->pitch(), 10);
+    sample.roll = scaled(filter->roll(), 10);
+    sample.accel = scaled(filter->forward(), 100);
+    portENTER_CRITICAL(&ringMux);
+    ring[ringWritten % RING_SIZE] = sample;
+    ringWritten++;
+    portEXIT_CRITICAL(&ringMux);
+    stats.samples++;
+}
+
+struct FifoRead {
+    uint16_t packets;            // Whole samples now in fifo[]
+    uint64_t countUs;            // When the count was read
+    bool overflowed;
+};
+
+// On the bus task: the count, then everything the FIFO holds in bursts
+// of whole samples. The filter runs afterwards, off the bus.
+static void drainFifo(void* context) {
+    FifoRead& read = *(FifoRead*)context;
+    read.packets = 0;
+    read.overflowed = false;
+    uint8_t count[2];
+    if (!readRegisters(REG_FIFO_COUNT, count, sizeof(count))) return;
+    read.countUs = esp_timer_get_time();
+    uint16_t bytes = (uint16_t)((count[0] & 0x1F) << 8 | count[1]);
+    if (bytes > FIFO_SIZE - PACKET_SIZE) {
+        // Full: samples were lost, and what is left may not start on one
+        resetFifo();
+        read.overflowed = true;
+        return;
+    }
+    uint16_t packets = bytes / PACKET_SIZE;
+    for (uint16_t done = 0; done < packets;) {
+        uint8_t n = packets - done < BURST_PACKETS ? (uint8_t)(packets - done) : BURST_PACKETS;
+        if (!readRegisters(REG_FIFO_R_W, fifo + done * PACKET_SIZE, n * PACKET_SIZE)) {
+            resetFifo();
+            return;
+        }
+        done += n;
+        stats.reads++;
+    }
+    read.packets = packets;
+}
+
+static void readFifo() {
+    FifoRead read;
+    i2cBusRun(I2C_PRIORITY_IMU, drainFifo, &read);
+    if (read.overflowed) {
+        stats.overflows++;
+        LOG_W(APP, "IMU FIFO overflowed, reset");
+        return;
+    }
+    // The newest sample was taken within a period of the count read, and
+    // the ones before it a period apart
+    uint64_t timeUs = read.countUs - (uint64_t)read.packets * periodUs + periodUs / 2;
+    for (uint16_t i = 0; i < read.packets; i++, timeUs += periodUs) filterPacket(fifo + i * PACKET_SIZE, timeUs);
+}
+
+static void imuTask(void* param) {
+    TickType_t wake = xTaskGetTickCount();
+    for (;;) {
+        vTaskDelayUntil(&wake, pdMS_TO_TICKS(settings.readMs));
+        taskBudgetStart(TASK_IMU);
+        readFifo();
+        taskBudgetEnd(TASK_IMU);
+    }
+}
+
+struct ImuSetup {
+    uint8_t divider;             // Of the 1 kHz internal rate
+    bool found;
+};
+
+// On the bus task: check for the MPU6886 and program its rate, ranges
+// and FIFO
+static void setupImu(void* context) {
+    ImuSetup& setup = *(ImuSetup*)context;
+    uint8_t id = 0;
+    setup.found = readRegisters(REG_WHO_AM_I, &id, 1) && id == WHO_AM_I;
+    if (!setup.found) return;
+    writeRegister(REG_PWR_MGMT_1, 0x01);       // Awake, on the gyro's PLL
+    delay(10);
+    writeRegister(REG_CONFIG, CONFIG_DLPF_176HZ);
+    writeRegister(REG_SMPLRT_DIV, setup.divider);
+    writeRegister(REG_GYRO_CONFIG, GYRO_2000DPS);
+    writeRegister(REG_ACCEL_CONFIG, ACCEL_8G);
+    writeRegister(REG_ACCEL_CONFIG2, 0);
+    resetFifo();
+}
+
+bool imuBegin(const ImuSettings& config) {
+    if (task) return true;
+
+    settings = config;
+    uint16_t rate = settings.rateHz < 4 ? 4 : settings.rateHz > 500 ? 500 : settings.rateHz;
+    ImuSetup setup = { (uint8_t)(1000 / rate - 1), false };
+    i2cBusRun(I2C_PRIORITY_IMU, setupImu, &setup);
+    if (!setup.found) {
+        LOG_W(APP, "No MPU6886, IMU fusion off");
+        return false;
+    }
+    periodUs = 1000 * (setup.divider + 1);
+    // Read well before the FIFO fills
+    uint32_t longestMs = (uint32_t)(FIFO_SIZE / PACKET_SIZE / 2) * periodUs / 1000;
+    if (settings.readMs == 0) settings.readMs = 1;
+    if (settings.readMs > longestMs) settings.readMs = longestMs;
+    readUs = settings.readMs * 1000;
+    filter = new AttitudeFilter(settings.kp, settings.ki, settings.gateG);
+
+    xTaskCreatePinnedToCore(imuTask, PLACEMENT.name, TASK_STACK_SIZE, nullptr, PLACEMENT.priority, &task,
+                            PLACEMENT.core);
+    perfWatchTask(task, MEMORY_TAG_TELEMETRY);
+    LOG_I(APP, "IMU: %u Hz through the FIFO, read every %u ms", (unsigned)(1000000 / periodUs),
+          (unsigned)settings.readMs);
+    return true;
+}
+
+bool imuAt(uint64_t timeUs, ImuSample& out) {
+    bool found = false;
+    uint64_t best = 0;
+    portENTER_CRITICAL(&ringMux);
+    uint32_t held = ringWritten < RING_SIZE ? ringWritten : RING_SIZE;
+    for (uint32_t i = 1; i <= held; i++) {
+        const ImuSample& sample = ring[(ringWritten - i) % RING_SIZE];
+        uint64_t distance = sample.timeUs > timeUs ? sample.timeUs - timeUs : timeUs - sample.timeUs;
+        if (found && distance >= best) break;    // Newest first: past the nearest, only further
+        out = sample;
+        best = distance;
+        found = true;
+    }
+    portEXIT_CRITICAL(&ringMux);
+    return found && best <= 2 * (uint64_t)readUs;
+}
+
+ImuStats imuStats() {
+    return stats;
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <stdint.h>
+
+struct ImuSettings {
+    uint16_t rateHz;             // Samples a second, 4 to 500
+    uint32_t readMs;             // FIFO reads apart; under the 1 KB FIFO's span at the rate
+    float kp;                    // Mahony gains (telemetry/attitude.h)
+    float ki;
+    float gateG;                 // Off 1 g by more and the accelerometer does not correct
+};
+
+// An attitude estimate and when its sample was taken, on the esp_timer
+// clock the VESC samples are timed by (see ble/rx_queue.h)
+struct ImuSample {
+    uint64_t timeUs;
+    int16_t pitch;               // 0.1 degree, nose up positive
+    int16_t roll;                // 0.1 degree, right side down positive
+    int16_t accel;               // 0.01 g forward, gravity taken out
+};
+
+struct ImuStats {
+    uint32_t samples;            // Run through the filter since boot
+    uint32_t reads;              // FIFO bursts
+    uint32_t overflows;          // FIFO resets after the task fell a FIFO behind
+};
+
+// Pitch and forward acceleration for riders of boards that balance, next
+// to the current they cost.
+//
+// The MPU6886 samples accelerometer and gyro at a fixed rate into its
+// FIFO, and a task reads whatever piled up every readMs in bursts of
+// whole samples, one I2C transaction each, instead of polling the data
+// registers a sample at a time. The samples are evenly spaced, so each
+// is dated from the read, counted back at the rate, and the filter runs
+// at the sample period exactly, however late the task got to them.
+//
+// The estimates go into a short ring, and the decoder merges the one
+// nearest a VESC sample's arrival into every combined sample (see
+// telemetry.h), so the history, the log and the widgets carry pitch and
+// acceleration measured with the current they sit next to.
+//
+// Each read is one IMU job on the I2C bus task (see i2c_bus.h), which
+// only touch reads go ahead of; the filter steps run on the IMU task,
+// off the bus.
+
+// Set up the FIFO and start the task. Call after sensorsBegin(): this
+// reprograms the MPU6886 that M5.IMU.Init() set up. Returns false
+// without an MPU6886.
+bool imuBegin(const ImuSettings& settings);
+
+// The estimate nearest timeUs. Returns false if there is none within two
+// reads of it (no IMU, or the task stalled).
+bool imuAt(uint64_t timeUs, ImuSample& out);
+
+ImuStats imuStats();
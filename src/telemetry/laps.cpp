@@ -0,0 +1,162 @@
+#include "laps.h"
+
+#include <math.h>
+#include <string.h>
+
+static const int64_t MM_PER_LATITUDE_UNIT_X1000 = 11132;  // 1e-7 degree is 11.132 mm of latitude
+
+LapTimer::LapTimer() {
+    config.geofence = false;
+    config.radiusM = 15;
+    config.minLapMs = 20000;
+    reset();
+}
+
+void LapTimer::configure(const LapConfig& settings) {
+    config = settings;
+}
+
+void LapTimer::reset() {
+    memset(laps, 0, sizeof(laps));
+    memset(&lap, 0, sizeof(lap));
+    newest = MAX_LAPS - 1;
+    kept = 0;
+    timing = false;
+    memset(counters, 0, sizeof(counters));
+    memset(startCounters, 0, sizeof(startCounters));
+    countersKnown = 0;
+    startKnown = 0;
+    hasFix = false;
+    fixLatitude = 0;
+    fixLongitude = 0;
+    lineSet = false;
+    lineLatitude = 0;
+    lineLongitude = 0;
+    cosLatitudeQ16 = 1 << 16;
+    outside = false;
+}
+
+const LapRecord& LapTimer::completed(uint8_t age) const {
+    if (age >= kept) age = kept > 0 ? kept - 1 : 0;
+    return laps[(newest + MAX_LAPS - age) % MAX_LAPS];
+}
+
+int LapTimer::best() const {
+    int fastest = -1;
+    for (uint8_t age = 0; age < kept; age++) {
+        if (fastest < 0 || completed(age).durationMs < completed(fastest).durationMs) fastest = age;
+    }
+    return fastest;
+}
+
+void LapTimer::startLap(uint32_t timeMs, uint32_t historyTotal) {
+    uint32_t number = lap.number + 1;
+    memset(&lap, 0, sizeof(lap));
+    lap.number = number;
+    lap.startMs = timeMs;
+    lap.historyStart = historyTotal;
+    memcpy(startCounters, counters, sizeof(counters));
+    startKnown = countersKnown;
+}
+
+void LapTimer::finishLap(uint32_t timeMs, uint32_t historyTotal) {
+    lap.durationMs = timeMs - lap.startMs;
+    lap.historyCount = historyTotal - lap.historyStart;
+    newest = (newest + 1) % MAX_LAPS;
+    laps[newest] = lap;
+    if (kept < MAX_LAPS) kept++;
+}
+
+// The lap's energy and distance are the counters' distance from where it
+// began. A counter that goes back (the VESC restarted) moves the start
+// with it, so the lap keeps what it had.
+void LapTimer::addCounters(const VescValues& values) {
+    static const uint32_t FIELDS[COUNTER_COUNT] = { VALUES_FIELD_WATT_HOURS, VALUES_FIELD_WATT_HOURS_CHARGED,
+                                                    VALUES_FIELD_TACHOMETER_ABS };
+    const int32_t readings[COUNTER_COUNT] = { values.wattHours, values.wattHoursCharged, values.tachometerAbs };
+    for (uint8_t i = 0; i < COUNTER_COUNT; i++) {
+        if (!(values.fields & FIELDS[i])) continue;
+        uint8_t bit = 1u << i;
+        if ((countersKnown & bit) && readings[i] < counters[i]) startCounters[i] -= counters[i] - readings[i];
+        counters[i] = readings[i];
+        countersKnown |= bit;
+        // A counter first heard during the lap counts from there
+        if (!(startKnown & bit)) {
+            startCounters[i] = readings[i];
+            startKnown |= bit;
+        }
+    }
+    lap.energy = (counters[COUNTER_WATT_HOURS] - startCounters[COUNTER_WATT_HOURS]) -
+                 (counters[COUNTER_WATT_HOURS_CHARGED] - startCounters[COUNTER_WATT_HOURS_CHARGED]);
+    lap.tachometer = counters[COUNTER_TACHOMETER] - startCounters[COUNTER_TACHOMETER];
+}
+
+// Flat-earth distance to the line, fine over a start circle's few metres
+bool LapTimer::crossedLine(const VescValues& values) {
+    if (!config.geofence || !lineSet || !(values.fields & VALUES_FIELD_GPS)) return false;
+    int64_t northMm = (int64_t)(values.gpsLatitude - lineLatitude) * MM_PER_LATITUDE_UNIT_X1000 / 1000;
+    int64_t eastMm = ((int64_t)(values.gpsLongitude - lineLongitude) * MM_PER_LATITUDE_UNIT_X1000 / 1000 *
+                      cosLatitudeQ16) >> 16;
+    int64_t squared = northMm * northMm + eastMm * eastMm;
+    int64_t radiusMm = (int64_t)config.radiusM * 1000;
+    if (squared > 4 * radiusMm * radiusMm) {
+        outside = true;
+        return false;
+    }
+    if (!outside || squared > radiusMm * radiusMm) return false;
+    outside = false;
+    return true;
+}
+
+bool LapTimer::add(const VescValues& values, uint32_t timeMs, uint32_t historyTotal) {
+    if (values.fields & VALUES_FIELD_GPS) {
+        hasFix = true;
+        fixLatitude = values.gpsLatitude;
+        fixLongitude = values.gpsLongitude;
+    }
+    addCounters(values);
+    if (!timing) return false;
+
+    // The pass happened when the fix was taken, a little before the sample
+    if (crossedLine(values) && timeMs - values.gpsAge - lap.startMs >= config.minLapMs) {
+        uint32_t crossedMs = timeMs - values.gpsAge;
+        finishLap(crossedMs, historyTotal);
+        startLap(crossedMs, historyTotal);
+        return true;
+    }
+
+    lap.durationMs = timeMs - lap.startMs;
+    lap.historyCount = historyTotal - lap.historyStart;
+    if (values.fields & VALUES_FIELD_V_IN) {
+        if (lap.minVoltage == 0 || values.vIn < lap.minVoltage) lap.minVoltage = values.vIn;
+    }
+    if ((values.fields & VALUES_FIELD_CURRENT_IN) && values.currentIn > lap.maxCurrentIn) {
+        lap.maxCurrentIn = values.currentIn;
+    }
+    if (values.fields & VALUES_FIELD_CURRENT_MOTOR) {
+        int32_t current = values.currentMotor < 0 ? -values.currentMotor : values.currentMotor;
+        if (current > lap.maxCurrentMotor) lap.maxCurrentMotor = current;
+    }
+    if (values.fields & VALUES_FIELD_RPM) {
+        int32_t rpm = values.rpm < 0 ? -values.rpm : values.rpm;
+        if (rpm > lap.maxRpm) lap.maxRpm = rpm;
+    }
+    if ((values.fields & VALUES_FIELD_GPS) && values.gpsSpeed > lap.maxGpsSpeed) lap.maxGpsSpeed = values.gpsSpeed;
+    return false;
+}
+
+void LapTimer::mark(uint32_t timeMs, uint32_t historyTotal) {
+    if (timing) {
+        finishLap(timeMs, historyTotal);
+    } else {
+        timing = true;
+        if (config.geofence && hasFix && !lineSet) {
+            lineSet = true;
+            lineLatitude = fixLatitude;
+            lineLongitude = fixLongitude;
+            cosLatitudeQ16 = (int32_t)(cosf(lineLatitude * 1e-7f * (float)M_PI / 180.0f) * 65536.0f);
+            outside = false;
+        }
+    }
+    startLap(timeMs, historyTotal);
+}
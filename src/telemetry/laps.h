@@ -0,0 +1,103 @@
+#pragma once
+
+#include <stdint.h>
+#include "vesc/values.h"
+
+// One lap's figures, kept as the lap goes on: each sample only moves the
+// running maxima and the counters' distance from where the lap began, so
+// nothing is ever summed from the history.
+struct LapRecord {
+    uint32_t number;         // From 1 since the last reset
+    uint32_t startMs;        // Sample clock
+    uint32_t durationMs;     // So far, for the lap under way
+    uint32_t historyStart;   // TelemetryHistory::total() as the lap began
+    uint32_t historyCount;   // History samples taken during it
+    int32_t energy;          // 0.0001 Wh drawn, less what was regenerated
+    int32_t tachometer;      // Counts covered (tachometer_abs), for the distance
+    int32_t maxCurrentIn;    // 0.01 A
+    int32_t maxCurrentMotor; // 0.01 A
+    int32_t maxRpm;          // ERPM, either direction
+    int16_t minVoltage;      // 0.1 V, 0 before the first reading
+    int16_t maxGpsSpeed;     // 0.1 km/h, 0 without a fix
+};
+
+// Where a lap starts and ends over GPS: the start line is a circle
+// around the point the first manual mark was made at. A lap is counted
+// as the vehicle comes back into the circle, once it has been further
+// out than twice the radius and the lap has run for minLapMs.
+struct LapConfig {
+    bool geofence;
+    uint16_t radiusM;
+    uint32_t minLapMs;
+};
+
+// Lap timer with the table of the laps since the last reset. A lap
+// starts and ends on mark() (a button), or on a pass of the start line
+// with the geofence on. add() takes each combined sample, so a lap is
+// timed to the sample; a GPS crossing is dated back to its fix.
+//
+// The caller keeps add() and the readers apart (one task adds, the UI
+// copies the timer under the same lock).
+class LapTimer {
+public:
+    static const uint8_t MAX_LAPS = 32;      // Completed laps kept, the oldest dropped
+
+    LapTimer();
+
+    void configure(const LapConfig& config);
+
+    // Forget the laps and the start line
+    void reset();
+
+    // A combined sample; historyTotal is the history's total() with it
+    // appended. Returns true if it completed a lap over the start line.
+    bool add(const VescValues& values, uint32_t timeMs, uint32_t historyTotal);
+
+    // The button: the first mark starts timing (and places the start line
+    // at the last fix, with the geofence on), later ones complete a lap
+    void mark(uint32_t timeMs, uint32_t historyTotal);
+
+    bool running() const { return timing; }
+    bool hasLine() const { return lineSet; }
+
+    // The lap under way, as of the last sample
+    const LapRecord& current() const { return lap; }
+
+    // Completed laps kept, and one of them by age (0 = the last)
+    uint8_t count() const { return kept; }
+    const LapRecord& completed(uint8_t age) const;
+
+    // Age of the fastest lap kept, -1 before the first
+    int best() const;
+
+private:
+    enum Counter : uint8_t { COUNTER_WATT_HOURS, COUNTER_WATT_HOURS_CHARGED, COUNTER_TACHOMETER, COUNTER_COUNT };
+
+    void startLap(uint32_t timeMs, uint32_t historyTotal);
+    void finishLap(uint32_t timeMs, uint32_t historyTotal);
+    void addCounters(const VescValues& values);
+    bool crossedLine(const VescValues& values);
+
+    LapConfig config;
+    LapRecord laps[MAX_LAPS];
+    uint8_t newest;          // Slot of the last completed lap
+    uint8_t kept;
+    LapRecord lap;
+    bool timing;
+
+    // The cumulative counters, latest and as the lap began
+    int32_t counters[COUNTER_COUNT];
+    int32_t startCounters[COUNTER_COUNT];
+    uint8_t countersKnown;   // Bits of the counters read so far
+    uint8_t startKnown;
+
+    bool hasFix;             // The latest sample's fix, for placing the line
+    int32_t fixLatitude;
+    int32_t fixLongitude;
+
+    bool lineSet;
+    int32_t lineLatitude;
+    int32_t lineLongitude;
+    int32_t cosLatitudeQ16;  // Shrinks longitude differences to ground distance
+    bool outside;            // Has been far enough out to count the next pass
+};
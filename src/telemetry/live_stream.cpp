@@ -0,0 +1,329 @@
+#include "live_stream.h"
+#include "telemetry.h"
+#include "../storage/log_format.h"
+#include "../log.h"
+#include "../system/perf_stats.h"
+#include "../system/task_layout.h"
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include <esp_coexist.h>
+#include <lwip/sockets.h>
+#include <mbedtls/base64.h>
+#include <mbedtls/sha1.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <errno.h>
+#include <string.h>
+#include <strings.h>
+
+static const char* WS_GUID = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+static const uint8_t RING_FRAMES = 8;           // Frames a client may fall behind before skipping
+static const size_t MAX_HEADER = 4;             // Server frames are unmasked and short
+static const size_t MAX_MESSAGE = MAX_HEADER + LOG_MAX_FRAME_SIZE;
+static const size_t RX_BUFFER = 128;            // Client frames larger than this drop the client
+static const uint32_t HANDSHAKE_TIMEOUT_MS = 1000;
+static const uint32_t PUMP_PERIOD_MS = 10;
+static const uint32_t TASK_STACK_SIZE = 6144;
+static const TaskPlacement& PLACEMENT = TASK_PLACEMENT[TASK_LIVE_STREAM];
+
+struct Message {
+    uint8_t data[MAX_MESSAGE];
+    uint8_t length;
+};
+
+struct Client {
+    WiFiClient socket;
+    bool open;
+    uint32_t next;                 // Sequence number of the next frame to send
+    uint8_t partial[MAX_MESSAGE];  // Rest of a frame the socket only partly took
+    uint8_t partialLength;
+    uint8_t rx[RX_BUFFER];
+    uint8_t rxLength;
+};
+
+static LiveStreamSettings config;
+static WiFiServer* server = nullptr;
+static Client clients[LIVE_STREAM_CLIENT_LIMIT];
+
+// Frames encoded so far; frame n is in ring[n % RING_FRAMES]
+static Message ring[RING_FRAMES];
+static uint32_t produced = 0;
+static BroadcastCursor samples;   // Into the telemetry bus
+
+static portMUX_TYPE statsMux = portMUX_INITIALIZER_UNLOCKED;
+static LiveStreamStats stats;
+
+// Answer the opening handshake. Returns false for anything that is not a
+// WebSocket upgrade.
+static bool acceptHandshake(WiFiClient& socket) {
+    char line[160];
+    char key[32] = "";
+    uint32_t started = millis();
+    size_t length = 0;
+    while (millis() - started < HANDSHAKE_TIMEOUT_MS) {
+        if (!socket.connected()) return false;
+        if (socket.available() == 0) {
+            vTaskDelay(pdMS_TO_TICKS(5));
+            continue;
+        }
+        char c = socket.read();
+        if (c == '\r') continue;
+        if (c != '\n') {
+            if (length < sizeof(line) - 1) line[length++] = c;
+            continue;
+        }
+        line[length] = '\0';
+        if (length == 0) break;   // End of the request headers
+        if (strncasecmp(line, "Sec-WebSocket-Key:", 18) == 0) {
+            const char* value = line + 18;
+            while (*value == ' ') value++;
+            strncpy(key, value, sizeof(key) - 1);
+            key[sizeof(key) - 1] = '\0';
+        }
+        length = 0;
+    }
+    if (key[0] == '\0') {
+        socket.print("HTTP/1.1 400 Bad Request\r\nConnection: close\r\n\r\n");
+        return false;
+    }
+
+    char joined[sizeof(key) + 36];
+    snprintf(joined, sizeof(joined), "%s%s", key, WS_GUID);
+    uint8_t digest[20];
+    mbedtls_sha1_ret((const uint8_t*)joined, strlen(joined), digest);
+    uint8_t accept[32];
+    size_t acceptLength = 0;
+    mbedtls_base64_encode(accept, sizeof(accept) - 1, &acceptLength, digest, sizeof(digest));
+    accept[acceptLength] = '\0';
+
+    char reply[160];
+    snprintf(reply, sizeof(reply),
+             "HTTP/1.1 101 Switching Protocols\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n"
+             "Sec-WebSocket-Accept: %s\r\n\r\n", (const char*)accept);
+    socket.print(reply);
+    return true;
+}
+
+static void closeClient(Client& client, const char* why) {
+    client.socket.stop();
+    client.open = false;
+    portENTER_CRITICAL(&statsMux);
+    stats.clients--;
+    portEXIT_CRITICAL(&statsMux);
+    LOG_I(APP, "Live stream client left (%s)", why);
+}
+
+static void acceptClients() {
+    WiFiClient socket = server->available();
+    if (!socket) return;
+
+    for (uint8_t i = 0; i < config.maxClients; i++) {
+        Client& client = clients[i];
+        if (client.open) continue;
+        if (!acceptHandshake(socket)) {
+            socket.stop();
+            return;
+        }
+        socket.setNoDelay(true);
+        client.socket = socket;
+        client.open = true;
+        client.next = produced;   // Start from the next sample
+        client.partialLength = 0;
+        client.rxLength = 0;
+        portENTER_CRITICAL(&statsMux);
+        stats.clients++;
+        portEXIT_CRITICAL(&statsMux);
+        LOG_I(APP, "Live stream client from %s", socket.remoteIP().toString().c_str());
+        return;
+    }
+    socket.print("HTTP/1.1 503 Service Unavailable\r\nConnection: close\r\n\r\n");
+    socket.stop();
+}
+
+// Encode one combined sample into the ring
+static void encodeSample(const TelemetrySnapshot& snapshot) {
+    LogSample sample;
+    logSampleFromValues(snapshot.values, snapshot.updatedMs, sample);
+    Message& message = ring[produced % RING_FRAMES];
+    size_t length = logEncodeFrame(sample, nullptr, message.data + MAX_HEADER);
+
+    // Binary frame header right in front of the payload
+    uint8_t* header;
+    if (length < 126) {
+        header = message.data + MAX_HEADER - 2;
+        header[1] = (uint8_t)length;
+    } else {
+        header = message.data;
+        header[1] = 126;
+        header[2] = (uint8_t)(length >> 8);
+        header[3] = (uint8_t)length;
+    }
+    header[0] = 0x82;   // FIN, binary
+    size_t headerLength = message.data + MAX_HEADER - header;
+    if (header != message.data) memmove(message.data, header, headerLength + length);
+    message.length = headerLength + length;
+    produced++;
+}
+
+// Every combined sample published since the last pump, in order
+static void encodeNew() {
+    TelemetrySnapshot snapshot;
+    uint32_t missedBefore = samples.missed;
+    while (telemetryNext(samples, snapshot)) encodeSample(snapshot);
+    if (samples.missed != missedBefore) {
+        portENTER_CRITICAL(&statsMux);
+        stats.samplesMissed += samples.missed - missedBefore;
+        portEXIT_CRITICAL(&statsMux);
+    }
+}
+
+// Send without blocking. Returns the bytes taken, or -1 if the socket failed.
+static int sendSome(Client& client, const uint8_t* data, size_t length) {
+    int sent = ::send(client.socket.fd(), data, length, MSG_DONTWAIT);
+    if (sent >= 0) return sent;
+    return (errno == EAGAIN || errno == EWOULDBLOCK) ? 0 : -1;
+}
+
+static void sendFrames(Client& client) {
+    if (client.partialLength > 0) {
+        int sent = sendSome(client, client.partial, client.partialLength);
+        if (sent < 0) {
+            closeClient(client, "send failed");
+            return;
+        }
+        client.partialLength -= sent;
+        memmove(client.partial, client.partial + sent, client.partialLength);
+        if (client.partialLength > 0) return;
+    }
+
+    if (produced - client.next > RING_FRAMES) {
+        uint32_t skipped = produced - RING_FRAMES - client.next;
+        portENTER_CRITICAL(&statsMux);
+        stats.framesDropped += skipped;
+        portEXIT_CRITICAL(&statsMux);
+        client.next = produced - RING_FRAMES;
+    }
+    while (client.next != produced) {
+        const Message& message = ring[client.next % RING_FRAMES];
+        int sent = sendSome(client, message.data, message.length);
+        if (sent < 0) {
+            closeClient(client, "send failed");
+            return;
+        }
+        if (sent == 0) return;
+        client.next++;
+        portENTER_CRITICAL(&statsMux);
+        stats.framesSent++;
+        portEXIT_CRITICAL(&statsMux);
+        if (sent < message.length) {
+            client.partialLength = message.length - sent;
+            memcpy(client.partial, message.data + sent, client.partialLength);
+            return;
+        }
+    }
+}
+
+// Read what the client sent and look for a close frame. Client frames
+// are masked, so their header is at least 6 bytes.
+static void readFrames(Client& client) {
+    while (client.socket.available() > 0 && client.rxLength < RX_BUFFER) {
+        int n = client.socket.read(client.rx + client.rxLength, RX_BUFFER - client.rxLength);
+        if (n <= 0) break;
+        client.rxLength += n;
+    }
+    while (client.rxLength >= 2) {
+        uint8_t opcode = client.rx[0] & 0x0F;
+        size_t payload = client.rx[1] & 0x7F;
+        size_t header = 2 + 4;
+        if (payload == 126) {
+            if (client.rxLength < 4) return;
+            payload = ((size_t)client.rx[2] << 8) | client.rx[3];
+            header += 2;
+        } else if (payload == 127) {
+            closeClient(client, "frame too large");
+            return;
+        }
+        if (header + payload > RX_BUFFER) {
+            closeClient(client, "frame too large");
+            return;
+        }
+        if (client.rxLength < header + payload) return;
+        if (opcode == 0x8) {
+            closeClient(client, "closed");
+            return;
+        }
+        client.rxLength -= header + payload;
+        memmove(client.rx, client.rx + header + payload, client.rxLength);
+    }
+}
+
+static void streamTaskMain(void* param) {
+    bool listening = false;
+    for (;;) {
+        vTaskDelay(pdMS_TO_TICKS(PUMP_PERIOD_MS));
+        bool up = config.accessPoint || WiFi.status() == WL_CONNECTED;
+        if (up && !listening) {
+            server->begin();
+            listening = true;
+            IPAddress address = config.accessPoint ? WiFi.softAPIP() : WiFi.localIP();
+            LOG_I(APP, "Live stream on ws://%s:%d/", address.toString().c_str(), config.port);
+        }
+        if (!listening) continue;
+
+        taskBudgetStart(TASK_LIVE_STREAM);
+        acceptClients();
+        encodeNew();
+        for (uint8_t i = 0; i < config.maxClients; i++) {
+            Client& client = clients[i];
+            if (!client.open) continue;
+            if (!client.socket.connected()) {
+                closeClient(client, "disconnected");
+                continue;
+            }
+            readFrames(client);
+            if (client.open) sendFrames(client);
+        }
+        taskBudgetEnd(TASK_LIVE_STREAM);
+    }
+}
+
+bool liveStreamBegin(const LiveStreamSettings& settings) {
+    if (server) return true;
+
+    config = settings;
+    if (config.maxClients > LIVE_STREAM_CLIENT_LIMIT) config.maxClients = LIVE_STREAM_CLIENT_LIMIT;
+    memset(&stats, 0, sizeof(stats));
+    telemetrySubscribe(samples);
+
+    if (config.accessPoint) {
+        WiFi.mode(WIFI_AP);
+        WiFi.softAP(config.ssid, config.password[0] ? config.password : nullptr);
+    } else {
+        // A station has to use modem sleep to share the radio with Bluetooth
+        WiFi.mode(WIFI_STA);
+        WiFi.setSleep(true);
+        WiFi.begin(config.ssid, config.password);
+    }
+    // The BLE links get the antenna whenever both want it
+    esp_coex_preference_set(ESP_COEX_PREFER_BT);
+
+    server = new WiFiServer(config.port, config.maxClients);
+    TaskHandle_t task = nullptr;
+    if (xTaskCreatePinnedToCore(streamTaskMain, PLACEMENT.name, TASK_STACK_SIZE, nullptr,
+                                PLACEMENT.priority, &task, PLACEMENT.core) != pdPASS) {
+        LOG_E(APP, "Could not start the live stream task");
+        return false;
+    }
+    perfWatchTask(task, MEMORY_TAG_TELEMETRY);
+    LOG_I(APP, "Live stream: %s %s, port %d", config.accessPoint ? "AP" : "joining", config.ssid, config.port);
+    return true;
+}
+
+LiveStreamStats liveStreamStats() {
+    LiveStreamStats out;
+    portENTER_CRITICAL(&statsMux);
+    out = stats;
+    portEXIT_CRITICAL(&statsMux);
+    return out;
+}
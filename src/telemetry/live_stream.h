@@ -0,0 +1,40 @@
+#pragma once
+
+#include <stdint.h>
+
+// Live telemetry over a WebSocket for a pit-side laptop. Each message is
+// one binary frame holding a log keyframe (storage/log_format.h) of the
+// combined sample, so the same decoder reads the stream and .vdl files.
+//
+// A low-priority task on the radio core brings up WiFi, either as its own
+// access point or as a station on an existing network, and serves
+// ws://<address>:<port>/ (any path). It takes every combined sample off
+// the telemetry bus and encodes each once into a short ring of frames
+// that every client sends from. A client that
+// falls more than the ring behind skips to the newest frame, so a slow
+// client loses stale samples instead of queueing them. Sends never block:
+// a frame the socket only partly took is finished before the next.
+// Anything a client sends is read and ignored, apart from a close.
+
+struct LiveStreamSettings {
+    bool accessPoint;          // Open our own AP; otherwise join ssid
+    const char* ssid;
+    const char* password;      // At least 8 characters for an AP, "" for an open one
+    uint16_t port;
+    uint8_t maxClients;        // At most LIVE_STREAM_CLIENT_LIMIT
+};
+
+#define LIVE_STREAM_CLIENT_LIMIT 4
+
+struct LiveStreamStats {
+    uint8_t clients;           // Connected WebSocket clients
+    uint32_t framesSent;       // Summed over clients
+    uint32_t framesDropped;    // Skipped because a client was behind
+    uint32_t samplesMissed;    // Lapped on the telemetry bus before they were encoded
+};
+
+// Start WiFi and the streaming task. Returns false if the task could not
+// be started; WiFi failing to come up is retried in the background.
+bool liveStreamBegin(const LiveStreamSettings& settings);
+
+LiveStreamStats liveStreamStats();
@@ -0,0 +1,161 @@
+#include "odometer.h"
+#include "../storage/slot_store.h"
+#include "../system/perf_stats.h"
+#include "../system/task_layout.h"
+#include "../log.h"
+
+#include <Arduino.h>
+#include <freertos/semphr.h>
+#include <string.h>
+
+static const char* NVS_NAMESPACE = "odometer";
+static const uint8_t STORED_VERSION = 1;
+static const uint32_t TASK_STACK_SIZE = 3072;
+static const TaskPlacement& PLACEMENT = TASK_PLACEMENT[TASK_ODOMETER];
+
+struct __attribute__((packed)) StoredTotals {
+    uint8_t version;
+    uint8_t size;                // sizeof(OdometerTotals) when written
+    OdometerTotals totals;
+};
+
+// The VESC counters summed, each with the field that carries it
+enum Counter : uint8_t {
+    COUNTER_TACHOMETER,
+    COUNTER_WATT_HOURS,
+    COUNTER_WATT_HOURS_CHARGED,
+    COUNTER_AMP_HOURS,
+    COUNTER_COUNT
+};
+
+static const uint32_t COUNTER_FIELDS[COUNTER_COUNT] = {
+    VALUES_FIELD_TACHOMETER_ABS,
+    VALUES_FIELD_WATT_HOURS,
+    VALUES_FIELD_WATT_HOURS_CHARGED,
+    VALUES_FIELD_AMP_HOURS,
+};
+
+// Each counter as of the last sample that carried it, to take the growth
+// from; a bit in valid per counter seen this session
+struct Baseline {
+    uint8_t valid;
+    int32_t last[COUNTER_COUNT];
+};
+
+static portMUX_TYPE odometerMux = portMUX_INITIALIZER_UNLOCKED;
+static OdometerTotals totals;
+static Baseline baseline;
+static Drivetrain wheels;
+static uint32_t changes = 0;         // Bumped by every add
+static uint32_t committed = 0;       // changes as of the last commit
+
+static SlotStore store(NVS_NAMESPACE, 4);
+static SemaphoreHandle_t storeMutex = nullptr;  // Commits come from the task and the UI
+static TaskHandle_t committer = nullptr;
+static uint32_t commitPeriodMs = 300000;
+
+// Growth of a counter since its last sample, which becomes the new
+// baseline; a counter that went backwards started over and counts from
+// here. Call with the lock held.
+static int32_t growth(const VescValues& values, Counter counter, int32_t now) {
+    if (!(values.fields & COUNTER_FIELDS[counter])) return 0;
+    uint8_t bit = 1u << counter;
+    int32_t delta = (baseline.valid & bit) ? now - baseline.last[counter] : 0;
+    baseline.last[counter] = now;
+    baseline.valid |= bit;
+    return delta > 0 ? delta : 0;
+}
+
+static void raise(int32_t& max, int32_t value) {
+    if (value > max) max = value;
+}
+
+static void raise(int16_t& max, int16_t value) {
+    if (value > max) max = value;
+}
+
+void odometerCommit() {
+    if (!storeMutex) return;
+    xSemaphoreTake(storeMutex, portMAX_DELAY);
+    StoredTotals blob;
+    portENTER_CRITICAL(&odometerMux);
+    uint32_t current = changes;
+    blob.totals = totals;
+    portEXIT_CRITICAL(&odometerMux);
+    if (current != committed) {
+        blob.version = STORED_VERSION;
+        blob.size = sizeof(OdometerTotals);
+        if (store.save(&blob, sizeof(blob))) committed = current;
+    }
+    xSemaphoreGive(storeMutex);
+}
+
+static void committerTask(void* arg) {
+    for (;;) {
+        vTaskDelay(pdMS_TO_TICKS(commitPeriodMs));
+        taskBudgetStart(TASK_ODOMETER);
+        odometerCommit();
+        taskBudgetEnd(TASK_ODOMETER);
+    }
+}
+
+void odometerBegin(uint32_t commitMs, uint8_t slots) {
+    if (storeMutex) return;
+    commitPeriodMs = commitMs;
+    store = SlotStore(NVS_NAMESPACE, slots);
+    StoredTotals blob;
+    if (store.load(&blob, sizeof(blob)) && blob.version == STORED_VERSION && blob.size == sizeof(OdometerTotals)) {
+        totals = blob.totals;
+        LOG_I(APP, "Odometer: %u m, %d Wh over %u samples", (unsigned)(totals.microns / 1000000),
+              (int)(totals.wattHours / 10000), (unsigned)totals.samples);
+    } else {
+        memset(&totals, 0, sizeof(totals));
+    }
+    storeMutex = xSemaphoreCreateMutex();
+    xTaskCreatePinnedToCore(committerTask, PLACEMENT.name, TASK_STACK_SIZE, nullptr, PLACEMENT.priority, &committer,
+                            PLACEMENT.core);
+    perfWatchTask(committer, MEMORY_TAG_TELEMETRY);
+}
+
+void odometerConfigure(const Drivetrain& drivetrain) {
+    portENTER_CRITICAL(&odometerMux);
+    wheels = drivetrain;
+    portEXIT_CRITICAL(&odometerMux);
+}
+
+void odometerResync() {
+    portENTER_CRITICAL(&odometerMux);
+    baseline.valid = 0;
+    portEXIT_CRITICAL(&odometerMux);
+}
+
+void odometerAdd(const VescValues& values) {
+    portENTER_CRITICAL(&odometerMux);
+    totals.microns += wheels.microns(growth(values, COUNTER_TACHOMETER, values.tachometerAbs));
+    totals.wattHours += growth(values, COUNTER_WATT_HOURS, values.wattHours);
+    totals.wattHoursCharged += growth(values, COUNTER_WATT_HOURS_CHARGED, values.wattHoursCharged);
+    totals.ampHours += growth(values, COUNTER_AMP_HOURS, values.ampHours);
+    if (values.fields & VALUES_FIELD_RPM) {
+        raise(totals.maxSpeed, wheels.speed(values.rpm < 0 ? -values.rpm : values.rpm));
+    }
+    if ((values.fields & (VALUES_FIELD_V_IN | VALUES_FIELD_CURRENT_IN)) ==
+        (VALUES_FIELD_V_IN | VALUES_FIELD_CURRENT_IN)) {
+        raise(totals.maxCurrentIn, values.currentIn);
+        raise(totals.maxPowerW, (int32_t)((int64_t)values.vIn * values.currentIn / 1000));
+    }
+    if (values.fields & VALUES_FIELD_TEMP_FET) raise(totals.maxTempFet, values.tempFet);
+    if (values.fields & VALUES_FIELD_TEMP_MOTOR) raise(totals.maxTempMotor, values.tempMotor);
+    totals.samples++;
+    changes++;
+    portEXIT_CRITICAL(&odometerMux);
+}
+
+void odometerRead(OdometerTotals& out) {
+    portENTER_CRITICAL(&odometerMux);
+    out = totals;
+    portEXIT_CRITICAL(&odometerMux);
+}
+
+uint32_t odometerCommits() {
+    return store.saves();
+}
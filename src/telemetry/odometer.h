@@ -0,0 +1,54 @@
+#pragma once
+
+#include <stdint.h>
+#include "vesc/values.h"
+#include "drivetrain.h"
+
+// What the dashboard has seen over its whole life
+struct OdometerTotals {
+    uint64_t microns;            // Distance
+    int64_t wattHours;           // 0.0001 Wh drawn
+    int64_t wattHoursCharged;    // 0.0001 Wh regenerated
+    int64_t ampHours;            // 0.0001 Ah drawn
+    uint32_t samples;
+    int32_t maxSpeed;            // 0.1 km/h
+    int32_t maxCurrentIn;        // 0.01 A
+    int32_t maxPowerW;
+    int16_t maxTempFet;          // 0.1 °C
+    int16_t maxTempMotor;        // 0.1 °C
+};
+
+// Lifetime totals of the combined telemetry, fed by the decoder.
+//
+// The VESC's own counters start over with every power-up, so only their
+// growth between two samples of a session is added; a counter that went
+// backwards (another VESC, a reboot) is taken as the new starting point.
+// Distance is turned into microns with the drivetrain in effect as it
+// was covered, so a later wheel change does not rewrite it.
+//
+// The totals live in RAM, where adding a sample costs a few adds under a
+// spinlock. A low-priority task commits them to a SlotStore ring in NVS
+// every commitMs while they change, so the flash sees one small write a
+// period however fast the samples come; odometerCommit() writes at once
+// for a power-loss warning or shutdown.
+
+// Load the stored totals and start the committing task
+void odometerBegin(uint32_t commitMs, uint8_t slots);
+
+// Drivetrain for the distance from now on. Called from the UI task.
+void odometerConfigure(const Drivetrain& drivetrain);
+
+// A new session: the next sample is only the starting point
+void odometerResync();
+
+// Add the combined sample. Called from the decoding task.
+void odometerAdd(const VescValues& values);
+
+// Write the totals now if they changed since the last commit. Blocks for
+// the NVS write.
+void odometerCommit();
+
+void odometerRead(OdometerTotals& out);
+
+// Commits since boot
+uint32_t odometerCommits();
@@ -0,0 +1,139 @@
+#include "ride_stats.h"
+#include "../system/perf_stats.h"
+#include "../log.h"
+#include "../system/task_layout.h"
+
+#include <Arduino.h>
+#include <Preferences.h>
+#include <string.h>
+
+static const char* NVS_NAMESPACE = "ride";
+static const char* NVS_KEY = "stats";
+static const uint8_t STORED_VERSION = 1;
+
+static const uint32_t TASK_STACK_SIZE = 3072;
+static const TaskPlacement& PLACEMENT = TASK_PLACEMENT[TASK_RIDE_STATS];
+
+struct __attribute__((packed)) StoredRideStats {
+    uint8_t version;
+    uint8_t size;                // sizeof(RideStats) when written
+    RideStats stats;
+};
+
+// Bits a reply must carry for each history field to count
+static const uint32_t FIELD_BITS[HISTORY_FIELD_COUNT] = {
+    VALUES_FIELD_V_IN,
+    VALUES_FIELD_CURRENT_IN,
+    VALUES_FIELD_CURRENT_MOTOR,
+    VALUES_FIELD_DUTY,
+    VALUES_FIELD_RPM,
+    VALUES_FIELD_TEMP_FET,
+    VALUES_FIELD_TEMP_MOTOR,
+    VALUES_FIELD_V_IN | VALUES_FIELD_CURRENT_IN,
+    VALUES_FIELD_GPS,
+};
+
+static portMUX_TYPE statsMux = portMUX_INITIALIZER_UNLOCKED;
+static RideStats stats;
+static uint32_t changes = 0;     // Bumped by every add and reset
+static TaskHandle_t saver = nullptr;
+static uint32_t persistPeriodMs = 60000;
+static volatile uint32_t saveRequests = 0;    // Tickets handed out by rideStatsSaveNow()
+static volatile uint32_t savedRequest = 0;    // Highest ticket whose save has finished
+
+static void load() {
+    StoredRideStats blob;
+    Preferences prefs;
+    size_t n = 0;
+    if (prefs.begin(NVS_NAMESPACE, true)) {
+        n = prefs.getBytes(NVS_KEY, &blob, sizeof(blob));
+        prefs.end();
+    }
+    if (n == sizeof(blob) && blob.version == STORED_VERSION && blob.size == sizeof(RideStats)) {
+        stats = blob.stats;
+        LOG_I(APP, "Ride stats: %u samples from NVS", (unsigned)stats.fields[HISTORY_V_IN].count);
+    } else {
+        memset(&stats, 0, sizeof(stats));
+    }
+}
+
+static void save(const RideStats& copy) {
+    StoredRideStats blob;
+    blob.version = STORED_VERSION;
+    blob.size = sizeof(RideStats);
+    blob.stats = copy;
+    Preferences prefs;
+    if (!prefs.begin(NVS_NAMESPACE, false)) {
+        LOG_W(APP, "Could not open NVS to store the ride stats");
+        return;
+    }
+    if (prefs.putBytes(NVS_KEY, &blob, sizeof(blob)) != sizeof(blob)) {
+        LOG_W(APP, "Could not store the ride stats");
+    }
+    prefs.end();
+}
+
+// Save whenever something changed since the last save, at most once a
+// period unless woken by a reset or rideStatsSaveNow()
+static void saverTask(void* arg) {
+    uint32_t saved = 0;
+    for (;;) {
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(persistPeriodMs));
+        uint32_t request = saveRequests;
+        RideStats copy;
+        portENTER_CRITICAL(&statsMux);
+        uint32_t current = changes;
+        copy = stats;
+        portEXIT_CRITICAL(&statsMux);
+        if (current != saved) {
+            taskBudgetStart(TASK_RIDE_STATS);
+            save(copy);
+            taskBudgetEnd(TASK_RIDE_STATS);
+            saved = current;
+        }
+        savedRequest = request;
+    }
+}
+
+void rideStatsBegin(uint32_t persistMs) {
+    persistPeriodMs = persistMs;
+    load();
+    xTaskCreatePinnedToCore(saverTask, PLACEMENT.name, TASK_STACK_SIZE, nullptr, PLACEMENT.priority, &saver, PLACEMENT.core);
+    perfWatchTask(saver, MEMORY_TAG_TELEMETRY);
+}
+
+void rideStatsAdd(const VescValues& values) {
+    int32_t sample[HISTORY_FIELD_COUNT];
+    historySample(values, sample);
+    portENTER_CRITICAL(&statsMux);
+    for (int f = 0; f < HISTORY_FIELD_COUNT; f++) {
+        if ((values.fields & FIELD_BITS[f]) == FIELD_BITS[f]) stats.fields[f].add(sample[f]);
+    }
+    changes++;
+    portEXIT_CRITICAL(&statsMux);
+}
+
+void rideStatsReset() {
+    portENTER_CRITICAL(&statsMux);
+    memset(&stats, 0, sizeof(stats));
+    changes++;
+    portEXIT_CRITICAL(&statsMux);
+    if (saver) xTaskNotifyGive(saver);
+    LOG_I(APP, "New trip");
+}
+
+void rideStatsRead(RideStats& out) {
+    portENTER_CRITICAL(&statsMux);
+    out = stats;
+    portEXIT_CRITICAL(&statsMux);
+}
+
+uint32_t rideStatsSaveNow() {
+    uint32_t ticket = ++saveRequests;
+    if (saver) xTaskNotifyGive(saver);
+    return ticket;
+}
+
+bool rideStatsSaved(uint32_t ticket) {
+    return !saver || (int32_t)(savedRequest - ticket) >= 0;
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <stdint.h>
+#include "vesc/values.h"
+#include "history.h"
+
+// Streaming statistics of one history field over the trip. The mean and
+// the spread are kept with Welford's update, so they stay accurate over
+// millions of samples without keeping any.
+struct RideFieldStats {
+    int32_t min;
+    int32_t max;
+    uint32_t count;
+    float mean;
+    float m2;                // Sum of squared differences from the mean
+
+    void add(int32_t value) {
+        if (count == 0 || value < min) min = value;
+        if (count == 0 || value > max) max = value;
+        count++;
+        float delta = value - mean;
+        mean += delta / count;
+        m2 += delta * (value - mean);
+    }
+
+    int32_t average() const { return (int32_t)(mean >= 0 ? mean + 0.5f : mean - 0.5f); }
+    float variance() const { return count > 1 ? m2 / (count - 1) : 0; }
+};
+
+// Peak, sag and average of every history field (history.h, same units)
+// since the trip was started
+struct RideStats {
+    RideFieldStats fields[HISTORY_FIELD_COUNT];
+};
+
+// Per-trip statistics of the combined telemetry, fed by the decoder.
+//
+// A sample only counts towards the fields its reply carried, so a
+// quantity polled at 1 Hz is not weighted by the 20 Hz ones riding
+// along. Adding a sample is a compare, a count and a few float
+// operations per field, under a spinlock the UI's copy also takes.
+//
+// The stats are kept in NVS and reloaded at boot, so the trip carries on
+// through a reboot. A low-priority task saves them every persistMs while
+// they change, and at once after a reset or when asked to.
+
+// Load the stored trip and start the saving task
+void rideStatsBegin(uint32_t persistMs);
+
+// Add the combined sample. Called from the decoding task.
+void rideStatsAdd(const VescValues& values);
+
+// Start a new trip
+void rideStatsReset();
+
+// Copy the current stats
+void rideStatsRead(RideStats& out);
+
+// Wake the saving task to store what changed now, e.g. when power is
+// about to go. Returns at once with a ticket for rideStatsSaved().
+uint32_t rideStatsSaveNow();
+
+// The stats as they were at rideStatsSaveNow() are in NVS
+bool rideStatsSaved(uint32_t ticket);
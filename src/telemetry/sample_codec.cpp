@@ -0,0 +1,96 @@
+#include "sample_codec.h"
+
+#include <string.h>
+
+static inline uint32_t zigzag(uint32_t d) {
+    return (d << 1) ^ (uint32_t)((int32_t)d >> 31);
+}
+
+static inline uint32_t unzigzag(uint32_t z) {
+    return (z >> 1) ^ (0u - (z & 1));
+}
+
+void SampleEncoder::reset(uint8_t* buffer, size_t size) {
+    mode = SAMPLE_DELTA;
+    out = buffer;
+    capacity = size;
+    bitCount = 0;
+    samples = 0;
+    previous = 0;
+    previousDelta = 0;
+}
+
+void SampleEncoder::begin(SampleCoding coding, uint8_t* buffer, size_t size) {
+    reset(buffer, size);
+    mode = coding;
+    memset(out, 0, capacity);
+}
+
+// Most significant bit first, so the prefix reads off the front
+void SampleEncoder::putBits(uint32_t value, uint8_t bits) {
+    for (int8_t i = bits - 1; i >= 0; i--) {
+        if (bitCount >= capacity * 8) return;
+        if ((value >> i) & 1) out[bitCount >> 3] |= 0x80 >> (bitCount & 7);
+        bitCount++;
+    }
+}
+
+void SampleEncoder::add(int32_t value) {
+    uint32_t delta = (uint32_t)value - previous;
+    uint32_t z = zigzag(mode == SAMPLE_DELTA_OF_DELTA ? delta - previousDelta : delta);
+    // The first sample is a difference from 0 like any other
+    previous = (uint32_t)value;
+    previousDelta = delta;
+    samples++;
+
+    if (z == 0) {
+        putBits(0, 1);
+    } else if (z < (1u << 6)) {
+        putBits(0x2, 2);
+        putBits(z, 6);
+    } else if (z < (1u << 12)) {
+        putBits(0x6, 3);
+        putBits(z, 12);
+    } else if (z < (1u << 20)) {
+        putBits(0xE, 4);
+        putBits(z, 20);
+    } else {
+        putBits(0xF, 4);
+        putBits(z, 32);
+    }
+}
+
+SampleDecoder::SampleDecoder(SampleCoding coding, const uint8_t* data, size_t bytes)
+    : mode(coding), in(data), bitLimit(bytes * 8), bitPosition(0), previous(0), previousDelta(0) {}
+
+uint32_t SampleDecoder::getBits(uint8_t bits) {
+    uint32_t value = 0;
+    for (uint8_t i = 0; i < bits; i++) {
+        uint32_t bit = bitPosition < bitLimit ? (in[bitPosition >> 3] >> (7 - (bitPosition & 7))) & 1 : 0;
+        value = value << 1 | bit;
+        bitPosition++;
+    }
+    return value;
+}
+
+int32_t SampleDecoder::next() {
+    if (bitPosition >= bitLimit) return (int32_t)previous;
+
+    uint32_t z = 0;
+    if (getBits(1) != 0) {
+        if (getBits(1) == 0) {
+            z = getBits(6);
+        } else if (getBits(1) == 0) {
+            z = getBits(12);
+        } else if (getBits(1) == 0) {
+            z = getBits(20);
+        } else {
+            z = getBits(32);
+        }
+    }
+    uint32_t d = unzigzag(z);
+    uint32_t delta = mode == SAMPLE_DELTA_OF_DELTA ? previousDelta + d : d;
+    previous += delta;
+    previousDelta = delta;
+    return (int32_t)previous;
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Bit packing of one column of the sample history, for the compressed
+// tier behind the raw ring (history_archive.h). Samples are fixed-point
+// integers that mostly move by a little from one to the next, so each is
+// stored as the zigzag of its difference from the one before, and the
+// timestamps, which step by a near-constant poll period, as the zigzag of
+// the difference between consecutive steps. The result takes a prefix
+// code:
+//
+//     0                   zero
+//     10   + 6 bits       below 64
+//     110  + 12 bits      below 4096
+//     1110 + 20 bits      below 2^20
+//     1111 + 32 bits      anything else
+//
+// so a held value costs a bit and a steady clock a bit per sample, and
+// nothing costs more than 36. Differences wrap at 32 bits, which keeps
+// every int32 exact. Not thread safe.
+enum SampleCoding : uint8_t {
+    SAMPLE_DELTA,            // Values: difference from the previous sample
+    SAMPLE_DELTA_OF_DELTA    // Timestamps: change of that difference
+};
+
+class SampleEncoder {
+public:
+    // Bytes a column of count samples may take at the very worst
+    static size_t maxBytes(uint32_t count) { return ((size_t)count * 36 + 7) / 8; }
+
+    SampleEncoder() : out(nullptr), capacity(0) { reset(nullptr, 0); }
+
+    // Start a column in out, which must hold maxBytes() of what will be added
+    void begin(SampleCoding coding, uint8_t* out, size_t capacity);
+
+    void add(int32_t value);
+
+    // Bytes written so far, the last one filled to its end
+    size_t bytes() const { return (bitCount + 7) / 8; }
+    uint32_t count() const { return samples; }
+
+private:
+    void reset(uint8_t* buffer, size_t size);
+    void putBits(uint32_t value, uint8_t bits);
+
+    SampleCoding mode;
+    uint8_t* out;
+    size_t capacity;
+    size_t bitCount;
+    uint32_t samples;
+    uint32_t previous;
+    uint32_t previousDelta;
+};
+
+class SampleDecoder {
+public:
+    // Read a column written by SampleEncoder with the same coding
+    SampleDecoder(SampleCoding coding, const uint8_t* in, size_t bytes);
+
+    // The next sample; past the end of the data, the last one again
+    int32_t next();
+
+private:
+    uint32_t getBits(uint8_t bits);
+
+    SampleCoding mode;
+    const uint8_t* in;
+    size_t bitLimit;
+    size_t bitPosition;
+    uint32_t previous;
+    uint32_t previousDelta;
+};
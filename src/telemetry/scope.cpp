@@ -0,0 +1,105 @@
+#include "scope.h"
+#include "../log.h"
+#include "../system/memory.h"
+
+#include <Arduino.h>
+#include <string.h>
+
+static portMUX_TYPE scopeMux = portMUX_INITIALIZER_UNLOCKED;
+static int32_t* samples = nullptr;           // [channel][sample]
+static uint16_t capacity = 0;
+static HistoryPyramid pyramid;
+static volatile uint16_t count = 0;
+static uint16_t expectedCount = 0;
+static volatile bool recording = false;
+static uint32_t lastSampleMs = 0;
+static uint32_t sampleTimeoutMs = 0;
+
+bool scopeBegin(uint16_t maxSamples, uint16_t columns) {
+    if (samples) return true;
+    if (maxSamples == 0 || columns == 0) return false;
+
+    // Coarse enough for the whole capture to fit the view
+    uint8_t levels = 1;
+    while (levels < HistoryPyramid::MAX_LEVELS && HistoryPyramid::bucketSize(levels) * columns < maxSamples) levels++;
+
+    size_t bytes = (size_t)maxSamples * VESC_SAMPLE_CHANNELS * sizeof(int32_t);
+    samples = (int32_t*)memoryAlloc(bytes, MEMORY_BULK, MEMORY_TAG_TELEMETRY);
+    if (!samples) {
+        LOG_E(APP, "No PSRAM for a %u sample scope capture", maxSamples);
+        return false;
+    }
+    if (!pyramid.begin(levels, maxSamples / HistoryPyramid::FANOUT + 1)) {
+        memoryFree(samples);
+        samples = nullptr;
+        return false;
+    }
+    capacity = maxSamples;
+    LOG_I(APP, "Scope: %u samples, %u KB PSRAM", maxSamples, (unsigned)(bytes / 1024));
+    return true;
+}
+
+void scopeStart(uint16_t expected, uint32_t timeoutMs, uint32_t now) {
+    if (!samples) return;
+    portENTER_CRITICAL(&scopeMux);
+    pyramid.reset();
+    count = 0;
+    expectedCount = expected < capacity ? expected : capacity;
+    sampleTimeoutMs = timeoutMs;
+    lastSampleMs = now;
+    recording = true;
+    portEXIT_CRITICAL(&scopeMux);
+}
+
+void scopeAdd(const VescSample& sample, uint32_t now) {
+    if (!recording) return;
+    portENTER_CRITICAL(&scopeMux);
+    if (recording && count < expectedCount) {
+        for (uint8_t c = 0; c < VESC_SAMPLE_CHANNELS; c++) samples[c * capacity + count] = sample.channels[c];
+        int32_t columns[HISTORY_PYRAMID_FIELDS] = {};   // Past the channels stay empty
+        memcpy(columns, sample.channels, sizeof(sample.channels));
+        pyramid.add(columns);
+        count++;
+        lastSampleMs = now;
+    }
+    portEXIT_CRITICAL(&scopeMux);
+}
+
+bool scopeUpdate(uint32_t now) {
+    if (!recording) return false;
+    portENTER_CRITICAL(&scopeMux);
+    bool done = count >= expectedCount || now - lastSampleMs >= sampleTimeoutMs;
+    if (done) recording = false;
+    uint16_t n = count;
+    portEXIT_CRITICAL(&scopeMux);
+    if (done) LOG_I(APP, "Scope capture: %u of %u samples", n, expectedCount);
+    return !done;
+}
+
+bool scopeRecording() {
+    return recording;
+}
+
+uint16_t scopeCount() {
+    return count;
+}
+
+uint8_t scopeLevels() {
+    return pyramid.levels();
+}
+
+uint32_t scopeCopy(VescSampleChannel channel, uint8_t level, uint32_t first, uint32_t n, HistoryBucket* out) {
+    if (!samples || channel >= VESC_SAMPLE_CHANNELS) return 0;
+    if (level > 0) return pyramid.copy(channel, level, first, n, out);
+
+    uint32_t available = count;
+    if (first >= available) return 0;
+    if (n > available - first) n = available - first;
+    const int32_t* column = samples + channel * capacity + first;
+    for (uint32_t i = 0; i < n; i++) {
+        out[i].min = column[i];
+        out[i].max = column[i];
+        out[i].mean = column[i];
+    }
+    return n;
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <stdint.h>
+#include "vesc/samples.h"
+#include "history_pyramid.h"
+
+static_assert(VESC_SAMPLE_CHANNELS <= HISTORY_PYRAMID_FIELDS, "one pyramid column per sample channel");
+
+// Oscilloscope captures of the VESC's sampled currents and voltages
+// (COMM_SAMPLE_PRINT). Each sample frame is decoded on the parser task
+// straight out of the framer's buffer into a fixed array in PSRAM, and
+// rolled into a min/max decimation pyramid as it arrives, so nothing is
+// allocated per frame and a zoomed-out view reads one bucket per column
+// however long the capture.
+//
+// One capture is kept; starting another drops it. One task starts and
+// reads captures (the UI), one adds samples (the parser).
+
+// Allocate room for maxSamples samples, with pyramid levels down to one
+// bucket per column of a view `columns` wide. Returns false without the
+// memory; captures are then ignored.
+bool scopeBegin(uint16_t maxSamples, uint16_t columns);
+
+// Drop the stored capture and take up to `expected` new samples, for at
+// most timeoutMs without one
+void scopeStart(uint16_t expected, uint32_t timeoutMs, uint32_t now);
+
+// A decoded sample; ignored unless a capture is being taken
+void scopeAdd(const VescSample& sample, uint32_t now);
+
+// Finish a capture that is complete or has timed out. Returns true while
+// one is being taken.
+bool scopeUpdate(uint32_t now);
+
+bool scopeRecording();
+
+// Samples in the capture so far
+uint16_t scopeCount();
+
+// Zoom levels beyond one sample per column
+uint8_t scopeLevels();
+
+// Samples per bucket at a zoom level
+inline uint32_t scopeBucketSize(uint8_t level) { return HistoryPyramid::bucketSize(level); }
+
+// Copy buckets [first, first + n) of a channel at a level; level 0 is the
+// raw samples, one per bucket. Returns how many were copied.
+uint32_t scopeCopy(VescSampleChannel channel, uint8_t level, uint32_t first, uint32_t n, HistoryBucket* out);
@@ -0,0 +1,72 @@
+#include "serial_stream.h"
+#include "../storage/log_format.h"
+#include "../vesc/crc.h"
+
+#include <Arduino.h>
+
+static const size_t MAX_RECORD = 1 + 4 + LOG_MAX_FRAME_SIZE + 2;
+// COBS adds a byte per 254, plus the two delimiters
+static const size_t MAX_ENCODED = MAX_RECORD + MAX_RECORD / 254 + 1 + 2;
+
+static bool started = false;
+static uint32_t sequence = 0;
+static volatile uint32_t dropped = 0;
+
+// Consistent overhead byte stuffing: no 0x00 in the output. Returns the
+// encoded length.
+static size_t cobsEncode(const uint8_t* in, size_t length, uint8_t* out) {
+    size_t codeAt = 0;
+    size_t n = 1;
+    uint8_t code = 1;
+    for (size_t i = 0; i < length; i++) {
+        if (in[i] != 0) {
+            out[n++] = in[i];
+            code++;
+        }
+        if (in[i] == 0 || code == 0xFF) {
+            out[codeAt] = code;
+            codeAt = n++;
+            code = 1;
+        }
+    }
+    out[codeAt] = code;
+    return n;
+}
+
+void serialStreamBegin(uint32_t baud, size_t txBufferBytes) {
+    Serial.flush();
+    Serial.end();
+    Serial.setTxBufferSize(txBufferBytes);
+    Serial.begin(baud);
+    started = true;
+}
+
+void serialStreamAppend(const VescValues& values, uint32_t timeMs) {
+    if (!started) return;
+
+    uint8_t record[MAX_RECORD];
+    record[0] = SERIAL_RECORD_SAMPLE;
+    uint32_t seq = sequence++;
+    for (int i = 0; i < 4; i++) record[1 + i] = (uint8_t)(seq >> (8 * i));
+    LogSample sample;
+    logSampleFromValues(values, timeMs, sample);
+    size_t length = 5 + logEncodeFrame(sample, nullptr, record + 5);
+    uint16_t crc = crc16(record, length);
+    record[length++] = (uint8_t)(crc >> 8);
+    record[length++] = (uint8_t)crc;
+
+    uint8_t encoded[MAX_ENCODED];
+    encoded[0] = 0;
+    size_t n = 1 + cobsEncode(record, length, encoded + 1);
+    encoded[n++] = 0;
+    // One write, so a log line from another task lands between records
+    if ((size_t)Serial.availableForWrite() < n) {
+        dropped++;
+        return;
+    }
+    Serial.write(encoded, n);
+}
+
+uint32_t serialStreamDropped() {
+    return dropped;
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include "vesc/values.h"
+
+// Binary telemetry on the USB serial port, for bench captures at full
+// poll rate (decoded by tools/serial_stream.py).
+//
+// Each sample is one record, COBS-encoded and delimited by a 0x00 on both
+// sides so text log lines in between never run into a record:
+//
+//   0x01        record type: combined sample
+//   uint32 LE   sequence number, counting every record offered (a gap
+//               is a dropped record)
+//   ...         the sample as a log keyframe (storage/log_format.h):
+//               LOG_FRAME_KEY, timeMs, fields, values, all varints
+//   uint16 BE   CRC-16 (as VESC packets) of everything before it
+//
+// A record the UART's transmit buffer has no room for is dropped rather
+// than waited for, so the decoder never stalls.
+
+static const uint8_t SERIAL_RECORD_SAMPLE = 0x01;
+
+// Restart the serial port at baud with a txBufferBytes transmit buffer
+void serialStreamBegin(uint32_t baud, size_t txBufferBytes);
+
+// Send one sample. Does nothing before serialStreamBegin(); never blocks.
+void serialStreamAppend(const VescValues& values, uint32_t timeMs);
+
+// Records dropped for want of buffer space
+uint32_t serialStreamDropped();
@@ -0,0 +1,79 @@
+#include "soc.h"
+
+// Open-circuit voltage of a cell at 0, 5, ... 100 % charge, mV
+static const int OCV_POINTS = 21;
+static constexpr uint16_t LI_ION_OCV[OCV_POINTS] = {
+    3270, 3610, 3690, 3710, 3730, 3750, 3770, 3790, 3800, 3820, 3840,
+    3850, 3870, 3910, 3950, 3980, 4020, 4080, 4110, 4150, 4200,
+};
+static constexpr uint16_t LIFEPO4_OCV[OCV_POINTS] = {
+    2500, 2900, 3000, 3100, 3170, 3200, 3220, 3240, 3250, 3260, 3270,
+    3280, 3290, 3300, 3310, 3320, 3325, 3330, 3340, 3350, 3650,
+};
+static constexpr const uint16_t* OCV_CURVES[CHEMISTRY_COUNT] = { LI_ION_OCV, LIFEPO4_OCV };
+static constexpr uint16_t NOMINAL_MILLIVOLTS[CHEMISTRY_COUNT] = { 3600, 3200 };
+
+// Learned resistances outside this are taken for noise, mΩ
+static const int32_t RESISTANCE_MIN = 1;
+static const int32_t RESISTANCE_MAX = 2000;
+
+int32_t socFromCellVoltage(BatteryChemistry chemistry, uint32_t cellMillivolts) {
+    const uint16_t* curve = OCV_CURVES[chemistry < CHEMISTRY_COUNT ? chemistry : CHEMISTRY_LI_ION];
+    if (cellMillivolts <= curve[0]) return 0;
+    if (cellMillivolts >= curve[OCV_POINTS - 1]) return 1000;
+    int i = 1;
+    while (cellMillivolts > curve[i]) i++;
+    int32_t low = curve[i - 1];
+    int32_t span = curve[i] - low;
+    return (i - 1) * 50 + ((int32_t)cellMillivolts - low) * 50 / span;
+}
+
+uint32_t socNominalCellMillivolts(BatteryChemistry chemistry) {
+    return NOMINAL_MILLIVOLTS[chemistry < CHEMISTRY_COUNT ? chemistry : CHEMISTRY_LI_ION];
+}
+
+SocEstimator::SocEstimator() : config(), started(false), resistance(0), lastVIn(0), lastCurrentIn(0),
+                               lastMs(0), smoothed(0) {
+}
+
+void SocEstimator::configure(const SocConfig& newConfig) {
+    // Settings are applied as a whole; keep what was learned if the pack
+    // is the same
+    if (started && newConfig.chemistry == config.chemistry && newConfig.cells == config.cells &&
+        newConfig.resistanceMilliohms == config.resistanceMilliohms && newConfig.smoothingMs == config.smoothingMs) {
+        return;
+    }
+    config = newConfig;
+    resistance = config.resistanceMilliohms * RESISTANCE_SCALE;
+    started = false;
+}
+
+int16_t SocEstimator::update(int32_t vIn, int32_t currentIn, uint32_t timeMs) {
+    if (config.cells == 0 || vIn <= 0) return soc();
+
+    // A step in current moves the voltage by the resistance times the step
+    uint32_t elapsed = timeMs - lastMs;
+    int32_t step = currentIn - lastCurrentIn;
+    if (started && elapsed <= STEP_MAX_MS && (step >= STEP_CURRENT || step <= -STEP_CURRENT)) {
+        int32_t measured = (int32_t)(-10000LL * (vIn - lastVIn) / step);
+        if (measured >= RESISTANCE_MIN && measured <= RESISTANCE_MAX) {
+            resistance += (measured * RESISTANCE_SCALE - resistance) / 8;
+        }
+    }
+
+    // mA x mΩ is µV
+    int64_t packMillivolts = (int64_t)vIn * 100 + (int64_t)currentIn * 10 * resistance / (1000 * RESISTANCE_SCALE);
+    if (packMillivolts < 0) packMillivolts = 0;
+    int64_t charge = socFromCellVoltage(config.chemistry, (uint32_t)(packMillivolts / config.cells)) * SMOOTH_SCALE;
+
+    if (!started || config.smoothingMs == 0 || elapsed >= config.smoothingMs) {
+        smoothed = charge;
+    } else {
+        smoothed += (charge - smoothed) * elapsed / config.smoothingMs;
+    }
+    started = true;
+    lastVIn = vIn;
+    lastCurrentIn = currentIn;
+    lastMs = timeMs;
+    return soc();
+}
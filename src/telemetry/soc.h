@@ -0,0 +1,68 @@
+#pragma once
+
+#include <stdint.h>
+
+enum BatteryChemistry : uint8_t {
+    CHEMISTRY_LI_ION,        // NMC/NCA cells, 4.2 V full
+    CHEMISTRY_LIFEPO4,       // 3.65 V full, flat in the middle
+    CHEMISTRY_COUNT
+};
+
+struct SocConfig {
+    BatteryChemistry chemistry;
+    uint8_t cells;               // In series
+    uint16_t resistanceMilliohms; // Pack internal resistance to start from
+    uint32_t smoothingMs;        // Time constant of the reported charge
+};
+
+// Pack state of charge from its voltage under load.
+//
+// The voltage a pack shows sags by its internal resistance times the
+// current drawn, so a plain lookup jumps with every throttle change.
+// Each sample's voltage is corrected back to the open-circuit voltage by
+// the current and the estimated resistance, looked up per cell on the
+// chemistry's discharge curve and smoothed over smoothingMs.
+//
+// The resistance starts from the configured figure and follows the
+// voltage step seen across each large step in current between two close
+// samples, so it tracks an ageing or cold pack. Every update costs the
+// same. Not thread safe.
+class SocEstimator {
+public:
+    // Smallest current step the resistance is learned from, 0.01 A
+    static const int32_t STEP_CURRENT = 1000;
+    // Longest gap between the two samples of a step
+    static const uint32_t STEP_MAX_MS = 500;
+
+    SocEstimator();
+
+    // Set the pack; unless it is the same as before, the next sample
+    // starts the charge and the resistance afresh
+    void configure(const SocConfig& config);
+
+    // Fold in a sample: vIn in 0.1 V, currentIn in 0.01 A. Returns the
+    // charge in 0.1 %.
+    int16_t update(int32_t vIn, int32_t currentIn, uint32_t timeMs);
+
+    // 0.1 %, 0 before the first sample
+    int16_t soc() const { return (int16_t)(smoothed / SMOOTH_SCALE); }
+    uint16_t resistanceMilliohms() const { return (uint16_t)(resistance / RESISTANCE_SCALE); }
+
+private:
+    static const int32_t SMOOTH_SCALE = 1000;
+    static const int32_t RESISTANCE_SCALE = 16;
+
+    SocConfig config;
+    bool started;
+    int32_t resistance;          // mΩ x RESISTANCE_SCALE, whole pack
+    int32_t lastVIn;
+    int32_t lastCurrentIn;
+    uint32_t lastMs;
+    int64_t smoothed;            // 0.1 % x SMOOTH_SCALE
+};
+
+// Charge of a resting cell on the chemistry's curve, 0.1 %
+int32_t socFromCellVoltage(BatteryChemistry chemistry, uint32_t cellMillivolts);
+
+// Nominal cell voltage, mV, for turning charge into energy
+uint32_t socNominalCellMillivolts(BatteryChemistry chemistry);
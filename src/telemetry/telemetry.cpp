@@ -0,0 +1,383 @@
+#include "telemetry.h"
+#include "gps.h"
+#include "imu.h"
+#include "time_align.h"
+#include "../feature_flags.h"
+#include "../system/seqlock.h"
+
+#include <Arduino.h>
+
+static const int64_t GPS_STALE_US = 2000000;   // Older fixes are not merged; receivers send 1 Hz or faster
+
+static Seqlock<TelemetrySnapshot> latest;
+static Seqlock<TelemetrySnapshot> perController[TELEMETRY_MAX_CONTROLLERS];
+static Seqlock<BmsSnapshot> bms;
+static BroadcastRing<TelemetrySnapshot, TELEMETRY_BUS_SAMPLES> bus;
+static TelemetryHistory history;
+
+// Owned by the decoding task
+static VescValues controllerValues[TELEMETRY_MAX_CONTROLLERS];
+static uint32_t controllerUpdatedMs[TELEMETRY_MAX_CONTROLLERS];
+static uint32_t controllerStaleMs = 0;
+static VescValues combined;
+static ValuesFilter controllerFilters[TELEMETRY_MAX_CONTROLLERS];
+static VescValues smoothedValues[TELEMETRY_MAX_CONTROLLERS];
+static VescValues smoothedCombined;
+static ValuesChangeTracker controllerChanges[TELEMETRY_MAX_CONTROLLERS];
+static ValuesChangeTracker combinedChanges;
+static SocEstimator socEstimator;
+static ThermalModel fetModel;
+static ThermalModel motorModel;
+static int16_t fetLimit = 0;
+static int16_t motorLimit = 0;
+
+// Each controller's recent currents, and controller 0's raw sample
+// waiting for the others' replies around it (see time_align.h)
+static SampleTrack tracks[TELEMETRY_MAX_CONTROLLERS];
+static uint64_t alignWindowUs = 0;
+static VescValues pendingValues;
+static uint64_t pendingUs = 0;
+static bool pending = false;
+
+// Battery settings from the UI, picked up on the next publish
+static portMUX_TYPE socConfigMux = portMUX_INITIALIZER_UNLOCKED;
+static SocConfig socConfig;
+static volatile bool socConfigChanged = false;
+
+// Thermal model settings and limits, picked up the same way
+static portMUX_TYPE thermalConfigMux = portMUX_INITIALIZER_UNLOCKED;
+static ThermalConfig thermalConfig;
+static int16_t thermalFetLimit = 0;
+static int16_t thermalMotorLimit = 0;
+static volatile bool thermalConfigChanged = false;
+
+// Formulas, picked up the same way. A build without them has no set
+// at all, so formula.cpp can be left out of it.
+#if FEATURE_FORMULAS
+static portMUX_TYPE formulasMux = portMUX_INITIALIZER_UNLOCKED;
+static FormulaSet pendingFormulas;
+static FormulaSet formulas;
+static volatile bool formulasChanged = false;
+#endif
+
+bool telemetryBegin(uint32_t historyCapacity, uint8_t pyramidLevels, uint32_t bucketsPerLevel,
+                    size_t archiveBytes, uint32_t staleMs) {
+    controllerStaleMs = staleMs;
+    return history.begin(historyCapacity, pyramidLevels, bucketsPerLevel, archiveBytes);
+}
+
+void telemetrySetStaleTimeout(uint32_t staleMs) {
+    controllerStaleMs = staleMs;
+}
+
+void telemetrySetAlignment(uint32_t windowMs) {
+    alignWindowUs = (uint64_t)windowMs * 1000;
+}
+
+void telemetrySetFilters(const ValuesFilterStage* stages, uint8_t count) {
+    for (uint8_t i = 0; i < TELEMETRY_MAX_CONTROLLERS; i++) controllerFilters[i].configure(stages, count);
+}
+
+void telemetrySetBattery(const SocConfig& config) {
+    portENTER_CRITICAL(&socConfigMux);
+    socConfig = config;
+    socConfigChanged = true;
+    portEXIT_CRITICAL(&socConfigMux);
+}
+
+// Fold controller 0's samples into the charge; the current is the
+// combined draw on the shared pack
+static void updateSoc(uint8_t controller, const VescValues& values, uint32_t now) {
+    const uint32_t needed = VALUES_FIELD_V_IN | VALUES_FIELD_CURRENT_IN;
+    if (socConfigChanged) {
+        portENTER_CRITICAL(&socConfigMux);
+        SocConfig config = socConfig;
+        socConfigChanged = false;
+        portEXIT_CRITICAL(&socConfigMux);
+        socEstimator.configure(config);
+    }
+    if (controller == 0 && (values.fields & needed) == needed) {
+        socEstimator.update(combined.vIn, combined.currentIn, now);
+    }
+    combined.soc = socEstimator.soc();
+}
+
+void telemetrySetThermal(const ThermalConfig& config, int16_t fetLimit, int16_t motorLimit) {
+    portENTER_CRITICAL(&thermalConfigMux);
+    thermalConfig = config;
+    thermalFetLimit = fetLimit;
+    thermalMotorLimit = motorLimit;
+    thermalConfigChanged = true;
+    portEXIT_CRITICAL(&thermalConfigMux);
+}
+
+// Fit controller 0's own current and temperatures (the other controllers
+// have their own bridges and motors) and predict the nearer of its two
+// limits
+static void updateThermal(uint8_t controller, const VescValues& values, uint32_t now) {
+    if (thermalConfigChanged) {
+        portENTER_CRITICAL(&thermalConfigMux);
+        ThermalConfig config = thermalConfig;
+        fetLimit = thermalFetLimit;
+        motorLimit = thermalMotorLimit;
+        thermalConfigChanged = false;
+        portEXIT_CRITICAL(&thermalConfigMux);
+        fetModel.configure(config);
+        motorModel.configure(config);
+    }
+    if (controller == 0) {
+        if (values.fields & VALUES_FIELD_CURRENT_MOTOR) {
+            fetModel.addCurrent(values.currentMotor, now);
+            motorModel.addCurrent(values.currentMotor, now);
+        }
+        if (values.fields & VALUES_FIELD_TEMP_FET) fetModel.addTemperature(values.tempFet, now);
+        if (values.fields & VALUES_FIELD_TEMP_MOTOR) motorModel.addTemperature(values.tempMotor, now);
+    }
+
+    int32_t seconds = ThermalModel::NEVER;
+    const ThermalModel* models[2] = { &fetModel, &motorModel };
+    const int16_t limits[2] = { fetLimit, motorLimit };
+    for (int i = 0; i < 2; i++) {
+        if (limits[i] <= 0) continue;
+        int32_t until = models[i]->secondsTo(limits[i]);
+        if (until != ThermalModel::NEVER && (seconds == ThermalModel::NEVER || until < seconds)) seconds = until;
+    }
+    combined.derateSeconds = seconds == ThermalModel::NEVER ? VALUES_DERATE_NONE : (int16_t)seconds;
+}
+
+void telemetrySetFormulas(const FormulaSet& set) {
+#if FEATURE_FORMULAS
+    portENTER_CRITICAL(&formulasMux);
+    pendingFormulas = set;
+    formulasChanged = true;
+    portEXIT_CRITICAL(&formulasMux);
+#endif
+}
+
+static void takeFormulas() {
+#if FEATURE_FORMULAS
+    if (formulasChanged) {
+        portENTER_CRITICAL(&formulasMux);
+        formulas = pendingFormulas;
+        formulasChanged = false;
+        portEXIT_CRITICAL(&formulasMux);
+    }
+#endif
+}
+
+static void evaluateFormulas(VescValues& values) {
+#if FEATURE_FORMULAS
+    formulas.evaluate(values);
+#endif
+}
+
+// Merge the newest GPS fix into a combined sample, with how far it lies
+// from the sample on the shared clock
+static void mergeGps(uint64_t timeUs, VescValues& out) {
+    GpsSample gps;
+    if (!FEATURE_GPS || gpsLatest(gps) == 0 || gps.fix.fix == GPS_FIX_NONE) return;
+    int64_t ageUs = (int64_t)(timeUs - gps.timeUs);
+    if (ageUs > GPS_STALE_US || ageUs < -GPS_STALE_US) return;
+    out.gpsLatitude = gps.fix.latitude;
+    out.gpsLongitude = gps.fix.longitude;
+    out.gpsSpeed = (int16_t)gps.fix.speed;
+    out.gpsAge = (int16_t)(ageUs / 1000);
+    out.fields |= VALUES_FIELD_GPS;
+}
+
+// Merge the attitude estimate taken nearest a combined sample's arrival
+static void mergeImu(uint64_t timeUs, VescValues& out) {
+    ImuSample imu;
+    if (!imuAt(timeUs, imu)) return;
+    out.imuPitch = imu.pitch;
+    out.imuRoll = imu.roll;
+    out.imuAccel = imu.accel;
+    out.fields |= VALUES_FIELD_IMU;
+}
+
+void telemetryForgetController(uint8_t controller) {
+    if (controller >= TELEMETRY_MAX_CONTROLLERS) return;
+    controllerValues[controller] = VescValues();
+    controllerUpdatedMs[controller] = 0;
+    controllerChanges[controller].reset();
+    controllerFilters[controller].reset();
+    smoothedValues[controller] = VescValues();
+    tracks[controller].clear();
+    if (controller == 0) {
+        pending = false;
+        fetModel.reset();
+        motorModel.reset();
+    }
+}
+
+static int16_t hotter(int16_t a, int16_t b) {
+    return a > b ? a : b;
+}
+
+// True if a controller other than 0 is left out of a sample at now. One
+// heard since now (a sample combined late) is not.
+static bool leftOut(uint8_t controller, uint32_t now) {
+    return controllerUpdatedMs[controller] == 0 ||
+           (int32_t)(now - controllerUpdatedMs[controller]) > (int32_t)controllerStaleMs;
+}
+
+// Add the other controllers onto controller 0's sample. Speed, duty and
+// voltage stay controller 0's: the motors share one pack and turn
+// together. With alignUs the others' currents are resampled at that
+// time; 0 takes them as they stand.
+static uint8_t combine(const VescValues& first, const VescValues* source, VescValues& out, uint32_t now,
+                       uint64_t alignUs) {
+    out = first;
+    uint8_t used = 1;
+    for (uint8_t i = 1; i < TELEMETRY_MAX_CONTROLLERS; i++) {
+        if (leftOut(i, now)) continue;
+
+        VescValues other = source[i];
+        if (alignUs != 0) tracks[i].at(alignUs, alignWindowUs, other);
+        out.currentMotor += other.currentMotor;
+        out.currentIn += other.currentIn;
+        out.currentId += other.currentId;
+        out.currentIq += other.currentIq;
+        out.ampHours += other.ampHours;
+        out.ampHoursCharged += other.ampHoursCharged;
+        out.wattHours += other.wattHours;
+        out.wattHoursCharged += other.wattHoursCharged;
+        out.tempFet = hotter(out.tempFet, other.tempFet);
+        out.tempMotor = hotter(out.tempMotor, other.tempMotor);
+        for (int t = 0; t < 3; t++) out.tempMos[t] = hotter(out.tempMos[t], other.tempMos[t]);
+        if (out.faultCode == 0) out.faultCode = other.faultCode;
+        used++;
+    }
+    return used;
+}
+
+// True once every other controller in the combined sample has currents
+// from at or after timeUs to resample
+static bool othersReached(uint64_t timeUs) {
+    uint32_t now = (uint32_t)(timeUs / 1000);
+    for (uint8_t i = 1; i < TELEMETRY_MAX_CONTROLLERS; i++) {
+        if (leftOut(i, now) || tracks[i].size() == 0) continue;
+        if (!tracks[i].reached(timeUs)) return false;
+    }
+    return true;
+}
+
+// Combine one of controller 0's raw samples with the others at its time,
+// work out what follows from it and add it to the history
+static const VescValues* combineRaw(const VescValues& values, uint64_t timeUs, uint64_t& combinedUs) {
+    uint32_t now = (uint32_t)(timeUs / 1000);
+    combine(values, controllerValues, combined, now, alignWindowUs != 0 ? timeUs : 0);
+    updateSoc(0, values, now);
+    updateThermal(0, values, now);
+    mergeGps(timeUs, combined);
+    mergeImu(timeUs, combined);
+    evaluateFormulas(combined);
+
+    // Every sample of the fastest-polled group becomes one history entry;
+    // slower fields ride along with their last known value
+    if (values.fields & VALUES_FIELD_V_IN) history.append(combined, now);
+    combinedUs = timeUs;
+    return &combined;
+}
+
+const VescValues* telemetryPublish(uint8_t controller, const VescValues& values, uint64_t timeUs,
+                                   uint64_t& combinedUs) {
+    if (controller >= TELEMETRY_MAX_CONTROLLERS) return nullptr;
+    takeFormulas();
+
+    TelemetrySnapshot snapshot;
+    snapshot.values = values;
+    snapshot.sampleUs = timeUs;
+    snapshot.updatedMs = (uint32_t)(timeUs / 1000);
+    snapshot.controllers = 1;
+    controllerValues[controller] = values;
+    controllerUpdatedMs[controller] = snapshot.updatedMs;
+    smoothedValues[controller] = values;
+    controllerFilters[controller].apply(smoothedValues[controller]);
+    snapshot.values = smoothedValues[controller];
+    snapshot.changed = controllerChanges[controller].update(snapshot.values);
+    perController[controller].write(snapshot);
+    tracks[controller].add(timeUs, values);
+
+    // Raw for the history and logs, once the others' replies around
+    // controller 0's sample are in. A sample still waiting when the next
+    // comes goes with what there is.
+    const VescValues* raw = nullptr;
+    if (controller == 0) {
+        if (pending) raw = combineRaw(pendingValues, pendingUs, combinedUs);
+        pending = false;
+        if (!raw && (alignWindowUs == 0 || othersReached(timeUs))) {
+            raw = combineRaw(values, timeUs, combinedUs);
+        } else {
+            pendingValues = values;
+            pendingUs = timeUs;
+            pending = true;
+        }
+    } else if (pending && othersReached(pendingUs)) {
+        raw = combineRaw(pendingValues, pendingUs, combinedUs);
+        pending = false;
+    }
+
+    // Smoothed for the snapshots, as soon as anything comes in
+    snapshot.controllers = combine(smoothedValues[0], smoothedValues, smoothedCombined, snapshot.updatedMs, 0);
+    smoothedCombined.soc = combined.soc;
+    smoothedCombined.derateSeconds = combined.derateSeconds;
+    mergeGps(timeUs, smoothedCombined);
+    mergeImu(timeUs, smoothedCombined);
+    evaluateFormulas(smoothedCombined);
+    snapshot.values = smoothedCombined;
+    snapshot.changed = combinedChanges.update(smoothedCombined) |
+                       (smoothedCombined.fields & (VALUES_FIELD_GPS | VALUES_FIELD_IMU | VALUES_FIELD_FORMULA));
+    latest.write(snapshot);
+    bus.publish(snapshot);
+    return raw;
+}
+
+const VescValues& telemetrySmoothed(uint8_t controller) {
+    return controller < TELEMETRY_MAX_CONTROLLERS ? smoothedValues[controller] : smoothedCombined;
+}
+
+const VescValues& telemetrySmoothedCombined() {
+    return smoothedCombined;
+}
+
+uint32_t telemetryLatest(TelemetrySnapshot& out) {
+    return latest.read(out);
+}
+
+TelemetryReading telemetryReadLatest(uint32_t nowMs) {
+    TelemetryReading reading;
+    reading.sequence = latest.read(reading.snapshot);
+    // Published on the other core after nowMs was taken, it is no age at all
+    int32_t age = (int32_t)(nowMs - reading.snapshot.updatedMs);
+    reading.ageMs = reading.sequence != 0 && age > 0 ? (uint32_t)age : 0;
+    return reading;
+}
+
+void telemetrySubscribe(BroadcastCursor& cursor) {
+    bus.subscribe(cursor);
+}
+
+bool telemetryNext(BroadcastCursor& cursor, TelemetrySnapshot& out) {
+    return bus.read(cursor, out);
+}
+
+uint32_t telemetryController(uint8_t controller, TelemetrySnapshot& out) {
+    if (controller >= TELEMETRY_MAX_CONTROLLERS) return 0;
+    return perController[controller].read(out);
+}
+
+const TelemetryHistory& telemetryHistory() {
+    return history;
+}
+
+void telemetryPublishBms(const VescBmsValues& values, uint32_t nowMs) {
+    BmsSnapshot snapshot;
+    snapshot.values = values;
+    snapshot.updatedMs = nowMs;
+    bms.write(snapshot);
+}
+
+uint32_t telemetryBms(BmsSnapshot& out) {
+    return bms.read(out);
+}
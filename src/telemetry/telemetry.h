@@ -0,0 +1,144 @@
+#pragma once
+
+#include <stdint.h>
+#include "vesc/values.h"
+#include "vesc/change_tracker.h"
+#include "vesc/bms.h"
+#include "history.h"
+#include "soc.h"
+#include "thermal.h"
+#include "formula.h"
+#include "filter.h"
+#include "../system/broadcast_ring.h"
+
+// Controllers whose telemetry is kept: the VESCs the BLE links are wired
+// to (controller 0 being the primary) and those reached through them
+// over CAN, up to eight on the primary's bus
+#define TELEMETRY_MAX_CONTROLLERS 10
+
+// Latest decoded telemetry, handed from the BLE side to the UI without
+// locks (see system/seqlock.h)
+struct TelemetrySnapshot {
+    VescValues values;
+    uint64_t sampleUs;       // esp_timer time the sample's reply began to arrive
+    uint32_t updatedMs;      // The same in millis()
+    uint32_t changed;        // VALUES_FIELD_* that moved past their deadband (see vesc/change_tracker.h)
+    uint8_t controllers;     // Controllers summed into a combined sample
+};
+
+// Allocate the sample history in PSRAM: historyCapacity raw samples plus
+// a decimation pyramid for long-range views and a compressed archive of
+// archiveBytes behind the raw samples (0 for none). A controller other
+// than 0 that has not published within staleMs is left out of the
+// combined sample.
+bool telemetryBegin(uint32_t historyCapacity, uint8_t pyramidLevels, uint32_t bucketsPerLevel,
+                    size_t archiveBytes, uint32_t staleMs);
+
+// Change how long a controller may go without publishing
+void telemetrySetStaleTimeout(uint32_t staleMs);
+
+// Resample the other controllers' currents onto controller 0's sample
+// times before they are summed into the raw combined sample, between
+// samples at most windowMs apart (see time_align.h). A sample of
+// controller 0's is then combined once every other controller's reply
+// after it is in, or when its next sample comes. 0 sums them as they
+// stand, with no wait. Call before the first publish.
+void telemetrySetAlignment(uint32_t windowMs);
+
+// Set the smoothing of each controller's fields (see filter.h). What
+// is shown and alerted on is smoothed: the snapshots, bus samples and
+// telemetrySmoothed(). The history and what telemetryPublish() returns,
+// which the logs record, stay raw. Call before the first publish.
+void telemetrySetFilters(const ValuesFilterStage* stages, uint8_t count);
+
+// Set the pack the combined sample's state of charge is worked out for.
+// Safe from any task; takes effect from the next publish.
+void telemetrySetBattery(const SocConfig& config);
+
+// Set the thermal models of controller 0's FETs and motor and the
+// temperatures (0.1 °C, 0 for none) the combined sample's derateSeconds
+// counts down to. Safe from any task; takes effect from the next publish.
+void telemetrySetThermal(const ThermalConfig& config, int16_t fetLimit, int16_t motorLimit);
+
+// Set the formulas worked out on every combined sample, raw and smoothed,
+// into its formula[]. Safe from any task; takes effect from the next
+// publish.
+void telemetrySetFormulas(const FormulaSet& formulas);
+
+// Forget a controller's last sample (its link dropped or its slot was
+// reassigned). Called only from the task that decodes replies.
+void telemetryForgetController(uint8_t controller);
+
+// Publish a new sample from one controller and recombine. The combined
+// sample is controller 0's with the other controllers' currents and
+// charge counters added and the hottest temperatures taken, so power
+// and current read as totals for the vehicle, soc set from the pack
+// voltage under the total current, derateSeconds from controller 0's
+// thermal models, the newest GPS fix within two seconds of the sample
+// merged in (VALUES_FIELD_GPS) and the IMU's attitude estimate nearest
+// it (VALUES_FIELD_IMU). Each snapshot flags the fields that moved
+// since they last changed, for the sample it holds. timeUs is when the
+// reply's first notification arrived (esp_timer_get_time(), which
+// millis() is derived from).
+//
+// There is one raw combined sample per sample of controller 0's, with
+// the others aligned to it (see telemetrySetAlignment()); those carrying
+// the input voltage are also appended to the history. Returns the raw
+// combined sample this publish completed, with its controller 0 time in
+// combinedUs, or nullptr if none. Called only from the task that
+// decodes replies.
+const VescValues* telemetryPublish(uint8_t controller, const VescValues& values, uint64_t timeUs,
+                                   uint64_t& combinedUs);
+
+// Smoothed sample of a controller, and combined, as of the last
+// publish. Called only from the task that decodes replies.
+const VescValues& telemetrySmoothed(uint8_t controller);
+const VescValues& telemetrySmoothedCombined();
+
+// Copy the latest combined sample. Returns a version that increases with
+// every publish; 0 means nothing has been published yet.
+uint32_t telemetryLatest(TelemetrySnapshot& out);
+
+// The latest combined sample with its sequence number and age, for
+// consumers that want the newest value without following every publish.
+// One sequence-checked read, retried if a publish overlapped it, so the
+// three always belong together. Safe from any task.
+struct TelemetryReading {
+    TelemetrySnapshot snapshot;
+    uint32_t sequence;       // telemetryLatest()'s version, 0 if nothing was published
+    uint32_t ageMs;          // nowMs less the sample's updatedMs; 0 for none, or one newer than nowMs
+};
+
+TelemetryReading telemetryReadLatest(uint32_t nowMs);
+
+// Copy the latest sample of a single controller, versioned the same way
+uint32_t telemetryController(uint8_t controller, TelemetrySnapshot& out);
+
+// Every combined sample, in order, for consumers that need each one
+// rather than the latest (see system/broadcast_ring.h). Each publish
+// goes once into a ring of TELEMETRY_BUS_SAMPLES that any task reads
+// through a cursor of its own; the decoder never waits for a reader, and
+// a reader that falls a whole ring behind skips ahead and counts the
+// samples it missed in cursor.missed.
+#define TELEMETRY_BUS_SAMPLES 32
+
+// Start a cursor at the next sample to be published
+void telemetrySubscribe(BroadcastCursor& cursor);
+
+// The next sample at a cursor. Returns false when it has caught up.
+bool telemetryNext(BroadcastCursor& cursor, TelemetrySnapshot& out);
+
+// Recent combined samples, appended by telemetryPublish()
+const TelemetryHistory& telemetryHistory();
+
+// Latest COMM_BMS_GET_VALUES reading, handed over the same way
+struct BmsSnapshot {
+    VescBmsValues values;
+    uint32_t updatedMs;
+};
+
+// Publish a BMS reading. Called only from the task that decodes replies.
+void telemetryPublishBms(const VescBmsValues& values, uint32_t nowMs);
+
+// Copy the latest BMS reading, versioned like telemetryLatest()
+uint32_t telemetryBms(BmsSnapshot& out);
@@ -0,0 +1,124 @@
+#include "thermal.h"
+
+#include <math.h>
+#include <string.h>
+
+static const float INITIAL_COVARIANCE = 1000.0f;
+// Covariance is not grown by forgetting beyond this, so a long spell of
+// steady load with nothing to learn from does not wind the fit up
+static const float MAX_COVARIANCE_TRACE = 1e6f;
+// Cooling below this (1/s, a time constant of hours) is taken as none,
+// and the temperature as rising in a straight line
+static const float MIN_COOLING = 1e-5f;
+static const int32_t MAX_SECONDS = 32000;
+
+ThermalModel::ThermalModel() {
+    config.forgetting = 0.999f;
+    config.minReadings = 60;
+    config.loadSmoothingMs = 30000;
+    reset();
+}
+
+void ThermalModel::configure(const ThermalConfig& settings) {
+    config = settings;
+}
+
+void ThermalModel::reset() {
+    memset(theta, 0, sizeof(theta));
+    memset(covariance, 0, sizeof(covariance));
+    for (int i = 0; i < 3; i++) covariance[i][i] = INITIAL_COVARIANCE;
+    loadSum = 0;
+    loadCount = 0;
+    recentLoad = 0;
+    loadStarted = false;
+    lastCurrentMs = 0;
+    hasTemperature = false;
+    lastTemperature = 0;
+    lastTemperatureMs = 0;
+    fittedReadings = 0;
+}
+
+void ThermalModel::addCurrent(int32_t current, uint32_t timeMs) {
+    float amps = current / 10000.0f;             // In 100 A, to keep the fit's terms alike in size
+    float load = amps * amps;
+    loadSum += load;
+    loadCount++;
+
+    if (!loadStarted) {
+        recentLoad = load;
+        loadStarted = true;
+    } else {
+        float dt = (float)(timeMs - lastCurrentMs);
+        float tau = (float)config.loadSmoothingMs;
+        recentLoad += (load - recentLoad) * (tau > 0 ? dt / (tau + dt) : 1.0f);
+    }
+    lastCurrentMs = timeMs;
+}
+
+void ThermalModel::addTemperature(int16_t temperature, uint32_t timeMs) {
+    float t = temperature / 10.0f;
+    uint32_t stepMs = timeMs - lastTemperatureMs;
+    bool fit = hasTemperature && loadCount > 0 && stepMs > 0 && stepMs <= MAX_STEP_MS;
+
+    if (fit) {
+        // ΔT = a·I²·dt - b·T·dt + c·dt
+        float dt = stepMs / 1000.0f;
+        float phi[3] = { loadSum / loadCount * dt, lastTemperature * dt, dt };
+        float error = (t - lastTemperature) - (theta[0] * phi[0] + theta[1] * phi[1] + theta[2] * phi[2]);
+
+        float pPhi[3];
+        for (int i = 0; i < 3; i++) {
+            pPhi[i] = covariance[i][0] * phi[0] + covariance[i][1] * phi[1] + covariance[i][2] * phi[2];
+        }
+        float denominator = config.forgetting + phi[0] * pPhi[0] + phi[1] * pPhi[1] + phi[2] * pPhi[2];
+        float gain[3];
+        for (int i = 0; i < 3; i++) {
+            gain[i] = pPhi[i] / denominator;
+            theta[i] += gain[i] * error;
+        }
+
+        float trace = 0;
+        for (int i = 0; i < 3; i++) {
+            for (int j = 0; j < 3; j++) covariance[i][j] -= gain[i] * pPhi[j];
+            trace += covariance[i][i];
+        }
+        if (trace < MAX_COVARIANCE_TRACE) {
+            for (int i = 0; i < 3; i++) {
+                for (int j = 0; j < 3; j++) covariance[i][j] /= config.forgetting;
+            }
+        }
+        fittedReadings++;
+    }
+
+    hasTemperature = true;
+    lastTemperature = t;
+    lastTemperatureMs = timeMs;
+    loadSum = 0;
+    loadCount = 0;
+}
+
+bool ThermalModel::fitted() const {
+    return fittedReadings >= config.minReadings && theta[0] > 0 && theta[1] <= 0;
+}
+
+int32_t ThermalModel::secondsTo(int16_t limit) const {
+    if (!hasTemperature) return NEVER;
+    float target = limit / 10.0f;
+    if (lastTemperature >= target) return 0;
+    if (!fitted()) return NEVER;
+
+    float b = -theta[1];
+    float drive = theta[0] * recentLoad + theta[2];
+    float seconds;
+    if (b > MIN_COOLING) {
+        // T(t) = T∞ + (T0 - T∞)·e^(-b·t)
+        float settled = drive / b;
+        if (settled <= target) return NEVER;
+        seconds = logf((settled - lastTemperature) / (settled - target)) / b;
+    } else {
+        float rate = drive - b * lastTemperature;
+        if (rate <= 0) return NEVER;
+        seconds = (target - lastTemperature) / rate;
+    }
+    return seconds < MAX_SECONDS ? (int32_t)(seconds + 0.5f) : MAX_SECONDS;
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <stdint.h>
+
+struct ThermalConfig {
+    float forgetting;            // RLS forgetting factor per temperature reading, just under 1
+    uint32_t minReadings;        // Readings fitted before a prediction is made
+    uint32_t loadSmoothingMs;    // Time constant of the load a prediction assumes
+};
+
+// First-order thermal model of a FET bridge or motor, fitted online.
+//
+// The temperature is taken to follow dT/dt = a·I² - b·T + c: heating
+// with the square of the motor current, cooling towards the air in
+// proportion to the temperature. Each temperature reading fits a, b
+// and c by recursive least squares over the step since the previous
+// one, with the mean I² of the samples in between, so every call costs
+// the same. Old readings fade by the forgetting factor, and the fit
+// follows the airflow and the ambient temperature as they change.
+//
+// The prediction runs the fitted model forward at the recent load (I²
+// smoothed over loadSmoothingMs): the temperature heads exponentially
+// for (a·I² + c) / b, and the limit is reached only if that lies above
+// it. Not thread safe.
+class ThermalModel {
+public:
+    // Longest step between two readings that is fitted; a longer one
+    // (a dropped link) only restarts the step
+    static const uint32_t MAX_STEP_MS = 5000;
+    // Prediction when the limit is not reached at the recent load
+    static const int32_t NEVER = -1;
+
+    ThermalModel();
+
+    void configure(const ThermalConfig& config);
+
+    // Forget the fit
+    void reset();
+
+    // The motor current of a sample, 0.01 A either direction
+    void addCurrent(int32_t current, uint32_t timeMs);
+
+    // A temperature reading, 0.1 °C. Fits the step from the previous one.
+    void addTemperature(int16_t temperature, uint32_t timeMs);
+
+    // Seconds until the temperature reaches limit (0.1 °C) at the recent
+    // load: 0 at or past it, NEVER if it levels off below it or the fit
+    // is not yet good enough to say
+    int32_t secondsTo(int16_t limit) const;
+
+    // Enough readings fitted, into a model that heats with current and
+    // cools with temperature
+    bool fitted() const;
+
+    uint32_t readings() const { return fittedReadings; }
+
+    // The fit, per second: heating per (100 A)², cooling rate (1/s) and
+    // offset (°C/s)
+    float heating() const { return theta[0]; }
+    float cooling() const { return -theta[1]; }
+    float offset() const { return theta[2]; }
+
+private:
+    ThermalConfig config;
+
+    float theta[3];              // a, -b, c
+    float covariance[3][3];
+
+    // Mean I², in (100 A)², since the last reading
+    float loadSum;
+    uint32_t loadCount;
+    float recentLoad;            // Smoothed over loadSmoothingMs
+    bool loadStarted;
+    uint32_t lastCurrentMs;
+
+    bool hasTemperature;
+    float lastTemperature;       // °C
+    uint32_t lastTemperatureMs;
+    uint32_t fittedReadings;
+};
@@ -0,0 +1,75 @@
+#include "time_align.h"
+
+static void readCurrents(const VescValues& values, int32_t* current) {
+    current[0] = values.currentMotor;
+    current[1] = values.currentIn;
+    current[2] = values.currentId;
+    current[3] = values.currentIq;
+}
+
+static void writeCurrents(const int32_t* current, VescValues& values) {
+    values.currentMotor = current[0];
+    values.currentIn = current[1];
+    values.currentId = current[2];
+    values.currentIq = current[3];
+}
+
+SampleTrack::SampleTrack() {
+    clear();
+}
+
+void SampleTrack::clear() {
+    held = 0;
+    newest = DEPTH - 1;
+}
+
+void SampleTrack::add(uint64_t timeUs, const VescValues& values) {
+    if (!(values.fields & FIELDS)) return;
+    if (held > 0 && timeUs < points[newest].timeUs) return;
+    newest = (uint8_t)((newest + 1) % DEPTH);
+    points[newest].timeUs = timeUs;
+    readCurrents(values, points[newest].current);
+    if (held < DEPTH) held++;
+}
+
+bool SampleTrack::reached(uint64_t timeUs) const {
+    return held > 0 && points[newest].timeUs >= timeUs;
+}
+
+bool SampleTrack::at(uint64_t timeUs, uint64_t windowUs, VescValues& out) const {
+    if (held == 0) return false;
+
+    // The first sample at or after timeUs, and the one before it
+    uint8_t after = 0;
+    while (after < held && point(after).timeUs < timeUs) after++;
+    if (after > 0 && after < held) {
+        const Point& a = point(after - 1);
+        const Point& b = point(after);
+        uint64_t span = b.timeUs - a.timeUs;
+        if (span <= windowUs) {
+            int64_t into = (int64_t)(timeUs - a.timeUs);
+            int32_t current[CURRENTS];
+            for (uint8_t i = 0; i < CURRENTS; i++) {
+                int64_t step = (int64_t)b.current[i] - a.current[i];
+                current[i] = a.current[i] + (int32_t)(span > 0 ? step * into / (int64_t)span : 0);
+            }
+            writeCurrents(current, out);
+            return true;
+        }
+    }
+
+    // Otherwise the nearer side, if it is near enough
+    const Point* nearest = nullptr;
+    uint64_t distance = 0;
+    if (after < held) {
+        nearest = &point(after);
+        distance = nearest->timeUs - timeUs;
+    }
+    if (after > 0 && (!nearest || timeUs - point(after - 1).timeUs < distance)) {
+        nearest = &point(after - 1);
+        distance = timeUs - nearest->timeUs;
+    }
+    if (distance > windowUs) return false;
+    writeCurrents(nearest->current, out);
+    return true;
+}
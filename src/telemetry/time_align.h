@@ -0,0 +1,54 @@
+#pragma once
+
+#include <stdint.h>
+#include "../vesc/values.h"
+
+// Recent currents of one controller, to be read back on another's clock.
+//
+// The combined sample adds the other controllers' currents onto the
+// primary's, but each reply arrives at its own time: forwarded over CAN
+// they come in after the primary's, so summed as they stand they are a
+// poll behind it, and the total power skews whenever the load changes.
+// A track keeps the last DEPTH samples that carried currents, by the
+// time their reply arrived, and at() resamples them onto any time
+// between two of them by linear interpolation. Not thread safe.
+class SampleTrack {
+public:
+    static const uint8_t DEPTH = 4;
+    static const uint32_t FIELDS = VALUES_FIELD_CURRENT_MOTOR | VALUES_FIELD_CURRENT_IN |
+                                   VALUES_FIELD_CURRENT_ID | VALUES_FIELD_CURRENT_IQ;
+
+    SampleTrack();
+
+    void clear();
+
+    // Keep a sample's currents. A sample with none of FIELDS, or older
+    // than the newest kept, is left out.
+    void add(uint64_t timeUs, const VescValues& values);
+
+    // True once a sample at or after timeUs is in, so at() has both sides
+    bool reached(uint64_t timeUs) const;
+
+    // Write the currents at timeUs into out: interpolated between the
+    // samples either side when they are at most windowUs apart, or the
+    // nearest sample's when it lies within windowUs. Returns false,
+    // leaving out alone, when no sample is that near.
+    bool at(uint64_t timeUs, uint64_t windowUs, VescValues& out) const;
+
+    uint8_t size() const { return held; }
+
+private:
+    static const uint8_t CURRENTS = 4;
+
+    struct Point {
+        uint64_t timeUs;
+        int32_t current[CURRENTS];       // Motor, input, d and q axis, as in VescValues
+    };
+
+    // The i-th oldest point kept
+    const Point& point(uint8_t i) const { return points[(newest + DEPTH + 1 - held + i) % DEPTH]; }
+
+    Point points[DEPTH];
+    uint8_t held;
+    uint8_t newest;
+};
@@ -0,0 +1,84 @@
+#include "units.h"
+
+#include <string.h>
+
+static const uint8_t FRACTION_BITS = 24;
+static const int32_t DECI_FAHRENHEIT_AT_ZERO = 320;
+
+// value -> value * factor / 2^FRACTION_BITS + offset; factor 0 leaves
+// the value alone
+struct UnitScale {
+    int64_t factor;
+    int32_t offset;
+};
+
+// Exact ratios each conversion is worked out from
+struct UnitRatio {
+    int64_t numerator;
+    int64_t denominator;
+    int32_t offset;
+};
+
+static const UnitRatio RATIOS[UNIT_KIND_COUNT] = {
+    { 1, 1, 0 },
+    { 9, 5, DECI_FAHRENHEIT_AT_ZERO },      // °C to °F
+    { 1000000, 1609344, 0 },                // km/h to mph
+    { 1000000, 1609344, 0 },                // km to mi
+    { 1609344, 1000000, 0 },                // Wh/km to Wh/mi
+};
+
+static const char* const METRIC_NAMES[UNIT_KIND_COUNT] = { "", "°C", "km/h", "km", "Wh/km" };
+static const char* const ALTERNATIVE_NAMES[UNIT_KIND_COUNT] = { "", "°F", "mph", "mi", "Wh/mi" };
+static const size_t MAX_NAME = 8;
+
+static UnitSettings current = { false, false };
+static UnitScale scales[UNIT_KIND_COUNT];
+static char names[UNIT_KIND_COUNT][MAX_NAME] = { "", "°C", "km/h", "km", "Wh/km" };
+
+static bool alternativeOf(UnitKind kind, const UnitSettings& settings) {
+    switch (kind) {
+        case UNIT_TEMPERATURE:  return settings.fahrenheit;
+        case UNIT_SPEED:
+        case UNIT_DISTANCE:
+        case UNIT_PER_DISTANCE: return settings.miles;
+        default:                return false;
+    }
+}
+
+void unitsConfigure(const UnitSettings& settings) {
+    current = settings;
+    for (uint8_t k = 0; k < UNIT_KIND_COUNT; k++) {
+        UnitKind kind = (UnitKind)k;
+        bool alternative = alternativeOf(kind, settings);
+        const UnitRatio& ratio = RATIOS[k];
+        scales[k].factor = alternative
+            ? ((ratio.numerator << FRACTION_BITS) + ratio.denominator / 2) / ratio.denominator : 0;
+        scales[k].offset = alternative ? ratio.offset : 0;
+        strncpy(names[k], unitsNameIn(kind, alternative), MAX_NAME - 1);
+        names[k][MAX_NAME - 1] = '\0';
+    }
+}
+
+const UnitSettings& unitsSettings() {
+    return current;
+}
+
+int32_t unitsConvert(UnitKind kind, int32_t value) {
+    if (kind >= UNIT_KIND_COUNT) return value;
+    const UnitScale& scale = scales[kind];
+    if (scale.factor == 0) return value;
+    const int64_t half = (int64_t)1 << (FRACTION_BITS - 1);
+    int64_t scaled = (int64_t)value * scale.factor;
+    // Half away from zero, as fixedRescale() rounds
+    int64_t rounded = scaled >= 0 ? (scaled + half) >> FRACTION_BITS : -((-scaled + half) >> FRACTION_BITS);
+    return (int32_t)rounded + scale.offset;
+}
+
+const char* unitsName(UnitKind kind) {
+    return names[kind < UNIT_KIND_COUNT ? kind : UNIT_NONE];
+}
+
+const char* unitsNameIn(UnitKind kind, bool alternative) {
+    if (kind >= UNIT_KIND_COUNT) kind = UNIT_NONE;
+    return alternative ? ALTERNATIVE_NAMES[kind] : METRIC_NAMES[kind];
+}
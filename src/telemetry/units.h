@@ -0,0 +1,43 @@
+#pragma once
+
+#include <stdint.h>
+
+// Units the dashboard shows its quantities in. Telemetry stays metric
+// everywhere (°C, km/h, km, Wh/km); a quantity is converted only as it
+// is printed. Choosing units works out each kind's conversion as an 8.24
+// fixed-point factor and an offset, so a conversion on a frame is one
+// multiply and shift, and the metric units skip even that.
+//
+// UI task only, like the settings the choice comes from.
+
+enum UnitKind : uint8_t {
+    UNIT_NONE,              // Printed as it is kept
+    UNIT_TEMPERATURE,       // °C or °F
+    UNIT_SPEED,             // km/h or mph
+    UNIT_DISTANCE,          // km or mi
+    UNIT_PER_DISTANCE,      // Wh/km or Wh/mi
+    UNIT_KIND_COUNT
+};
+
+struct UnitSettings {
+    bool fahrenheit;
+    bool miles;             // Speed, distance and consumption
+};
+
+// Work out the conversions. Until then everything is metric.
+void unitsConfigure(const UnitSettings& settings);
+
+const UnitSettings& unitsSettings();
+
+// A metric value, with any number of decimals, in the chosen unit with
+// the same decimals, rounded to nearest. Offsets (°F) are scaled for one
+// decimal, which is how temperatures are kept.
+int32_t unitsConvert(UnitKind kind, int32_t value);
+
+// The chosen unit's name ("km/h"). The pointer stays the same for a
+// kind when units change, so a widget holding it shows the new name on
+// its next repaint.
+const char* unitsName(UnitKind kind);
+
+// A kind's unit name in either system, whatever is chosen
+const char* unitsNameIn(UnitKind kind, bool alternative);
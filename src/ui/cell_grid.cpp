@@ -0,0 +1,64 @@
+#include "cell_grid.h"
+
+#include <string.h>
+
+static const int CHAR_WIDTH = 6;   // At text size 1
+static const int CHAR_HEIGHT = 8;
+
+CellGrid::CellGrid(DisplayGfx* display) : strip(display), originX(0), originY(0), width(0), height(0), columnCount(0), rowCount(0) {
+    memset(cells, 0, sizeof(cells));
+}
+
+void CellGrid::setGeometry(int16_t x, int16_t y, int16_t cellWidth, int16_t cellHeight, uint8_t columns,
+                           uint8_t rows) {
+    originX = x;
+    originY = y;
+    width = cellWidth;
+    height = cellHeight;
+    columnCount = columns > MAX_COLUMNS ? MAX_COLUMNS : columns;
+    rowCount = rows > MAX_ROWS ? MAX_ROWS : rows;
+    memset(cells, 0, sizeof(cells));
+    strip.begin(cellWidth, cellHeight);
+    invalidate();
+}
+
+void CellGrid::set(uint8_t column, uint8_t row, const char* text, uint16_t color) {
+    if (column >= columnCount || row >= rowCount) return;
+    Cell& cell = cells[row][column];
+    if (cell.color == color && strncmp(cell.text, text, MAX_CHARS) == 0) return;
+    strncpy(cell.text, text, MAX_CHARS);
+    cell.text[MAX_CHARS] = '\0';
+    cell.color = color;
+    cell.dirty = true;
+}
+
+void CellGrid::invalidate() {
+    for (uint8_t row = 0; row < rowCount; row++) {
+        for (uint8_t column = 0; column < columnCount; column++) cells[row][column].dirty = true;
+    }
+}
+
+int CellGrid::paint() {
+    int painted = 0;
+    int maxChars = width / CHAR_WIDTH;
+    if (maxChars > MAX_CHARS) maxChars = MAX_CHARS;
+    for (uint8_t row = 0; row < rowCount; row++) {
+        for (uint8_t column = 0; column < columnCount; column++) {
+            Cell& cell = cells[row][column];
+            if (!cell.dirty) continue;
+            cell.dirty = false;
+            char text[MAX_CHARS + 1];
+            int length = (int)strlen(cell.text);
+            if (length > maxChars) length = maxChars;
+            memcpy(text, cell.text, length);
+            text[length] = '\0';
+            // Right-aligned, a pixel clear of the next cell where there is
+            // room
+            int16_t textX = width - length * CHAR_WIDTH;
+            if (textX > 0) textX--;
+            strip.draw(cellX(column), cellY(row), text, textX, (height - CHAR_HEIGHT) / 2, 1, cell.color, BLACK);
+            painted++;
+        }
+    }
+    return painted;
+}
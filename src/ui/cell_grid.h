@@ -0,0 +1,52 @@
+#pragma once
+
+#include "display.h"
+#include "text_strip.h"
+
+// A table of short text cells drawn straight to the display at text size
+// 1. Each cell remembers what it last showed, so a frame repaints only
+// the cells whose text or colour changed, each as one push of its
+// rectangle (see text_strip.h): a full table of ten columns costs a few
+// small bursts per frame instead of a clear and a redraw. Text is
+// right-aligned in its cell and cut to fit.
+class CellGrid {
+public:
+    static const int MAX_COLUMNS = 10;
+    static const int MAX_ROWS = 12;
+    static const int MAX_CHARS = 7;
+
+    explicit CellGrid(DisplayGfx* display);
+
+    // Place the grid. Every cell is cleared and will be repainted.
+    void setGeometry(int16_t x, int16_t y, int16_t cellWidth, int16_t cellHeight, uint8_t columns, uint8_t rows);
+
+    // What a cell should show; only a change marks it for repaint
+    void set(uint8_t column, uint8_t row, const char* text, uint16_t color);
+
+    // Repaint every cell at the next paint (the screen was cleared)
+    void invalidate();
+
+    // Paint the cells that changed. Returns how many were painted.
+    int paint();
+
+    uint8_t columns() const { return columnCount; }
+    uint8_t rows() const { return rowCount; }
+    int16_t cellX(uint8_t column) const { return originX + column * width; }
+    int16_t cellY(uint8_t row) const { return originY + row * height; }
+
+private:
+    struct Cell {
+        char text[MAX_CHARS + 1];
+        uint16_t color;
+        bool dirty;
+    };
+
+    TextStrip strip;
+    int16_t originX;
+    int16_t originY;
+    int16_t width;
+    int16_t height;
+    uint8_t columnCount;
+    uint8_t rowCount;
+    Cell cells[MAX_ROWS][MAX_COLUMNS];
+};
@@ -0,0 +1,101 @@
+#include "cell_heatmap.h"
+
+#include <stdio.h>
+#include <string.h>
+
+static const int CHAR_WIDTH = 6;   // At text size 1
+static const int CHAR_HEIGHT = 8;
+static const int16_t GAP = 2;      // Between tiles, left black
+
+CellHeatmap::CellHeatmap(DisplayGfx* display)
+    : display(display), strip(display), originX(0), originY(0), width(0), height(0), columnCount(1), count(0), emptyMv(0), fullMv(0) {
+    memset(tiles, 0, sizeof(tiles));
+    setRange(3300, 4200);
+}
+
+void CellHeatmap::setGeometry(int16_t x, int16_t y, int16_t tileWidth, int16_t tileHeight, uint8_t columns) {
+    originX = x;
+    originY = y;
+    width = tileWidth;
+    height = tileHeight;
+    columnCount = columns > 0 ? columns : 1;
+    strip.begin(tileWidth - GAP, tileHeight - GAP);
+    invalidate();
+}
+
+void CellHeatmap::setRange(uint16_t empty, uint16_t full) {
+    emptyMv = empty;
+    fullMv = full > empty ? full : empty + 1;
+    // Red up to yellow over the first half, yellow down to green over the
+    // second, in RGB565
+    for (uint8_t s = 0; s < HEAT_STEPS; s++) {
+        uint32_t t = (uint32_t)s * 510 / (HEAT_STEPS - 1);
+        uint16_t red = t <= 255 ? 31 : (uint16_t)((510 - t) * 31 / 255);
+        uint16_t green = t <= 255 ? (uint16_t)(t * 63 / 255) : 63;
+        colors[s] = (uint16_t)(red << 11 | green << 5);
+    }
+    for (uint8_t c = 0; c < MAX_CELLS; c++) tiles[c].step = stepOf(tiles[c].centivolts * 10);
+    invalidate();
+}
+
+void CellHeatmap::setCount(uint8_t cells) {
+    count = cells < MAX_CELLS ? cells : MAX_CELLS;
+    for (uint8_t c = 0; c < MAX_CELLS; c++) {
+        bool shown = c < count;
+        if (tiles[c].shown == shown) continue;
+        tiles[c].shown = shown;
+        tiles[c].dirty = true;
+    }
+}
+
+uint8_t CellHeatmap::stepOf(uint16_t mv) const {
+    if (mv <= emptyMv) return 0;
+    if (mv >= fullMv) return HEAT_STEPS - 1;
+    return (uint8_t)((uint32_t)(mv - emptyMv) * (HEAT_STEPS - 1) / (fullMv - emptyMv));
+}
+
+void CellHeatmap::set(uint8_t cell, uint16_t mv, uint8_t marks) {
+    if (cell >= count) return;
+    Tile& tile = tiles[cell];
+    uint16_t centivolts = (uint16_t)((mv + 5) / 10);
+    uint8_t step = stepOf(mv);
+    if (tile.centivolts == centivolts && tile.step == step && tile.marks == marks) return;
+    tile.centivolts = centivolts;
+    tile.step = step;
+    tile.marks = marks;
+    tile.dirty = true;
+}
+
+void CellHeatmap::invalidate() {
+    for (uint8_t c = 0; c < MAX_CELLS; c++) tiles[c].dirty = true;
+}
+
+int CellHeatmap::paint() {
+    int painted = 0;
+    for (uint8_t c = 0; c < MAX_CELLS; c++) {
+        Tile& tile = tiles[c];
+        if (!tile.dirty) continue;
+        tile.dirty = false;
+        int16_t x = originX + (c % columnCount) * width;
+        int16_t y = originY + (c / columnCount) * height;
+        if (!tile.shown) {
+            display->fillRect(x, y, width - GAP, height - GAP, BLACK);
+            painted++;
+            continue;
+        }
+        char text[8];
+        snprintf(text, sizeof(text), "%u.%02u", tile.centivolts / 100, tile.centivolts % 100);
+        int16_t textX = (width - GAP - (int16_t)strlen(text) * CHAR_WIDTH) / 2;
+        uint16_t color = tile.marks & MARK_BALANCING ? BLUE : BLACK;
+        strip.draw(x, y, text, textX, (height - GAP - CHAR_HEIGHT) / 2, 1, color, colors[tile.step]);
+        if (tile.marks & (MARK_LOWEST | MARK_HIGHEST)) {
+            display->drawRect(x, y, width - GAP, height - GAP, tile.marks & MARK_LOWEST ? WHITE : BLACK);
+        }
+        painted++;
+    }
+    return painted;
+}
+
+int16_t CellHeatmap::bottom() const {
+    return originY + (int16_t)((count + columnCount - 1) / columnCount) * height;
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include "display.h"
+#include "text_strip.h"
+
+// A battery pack's cell voltages as a grid of tiles, drawn straight to
+// the display like CellGrid. Each tile shows its cell in hundredths of a
+// volt over a colour from red (empty) through yellow to green (full), in
+// HEAT_STEPS steps. The lowest cell is framed in white, the highest in
+// black, and a cell being balanced prints in blue. A tile remembers what it last showed,
+// so a reading repaints only the cells whose shown voltage, colour step
+// or marks changed, each as one push of its rectangle.
+class CellHeatmap {
+public:
+    static const uint8_t MAX_CELLS = 32;
+    static const uint8_t HEAT_STEPS = 16;
+
+    enum Mark : uint8_t {
+        MARK_LOWEST = 1,
+        MARK_HIGHEST = 2,
+        MARK_BALANCING = 4
+    };
+
+    explicit CellHeatmap(DisplayGfx* display);
+
+    // Place the grid, columns tiles a row. Every tile will be repainted.
+    void setGeometry(int16_t x, int16_t y, int16_t tileWidth, int16_t tileHeight, uint8_t columns);
+
+    // Cell voltages at the two ends of the colours; repaints every tile
+    void setRange(uint16_t emptyMv, uint16_t fullMv);
+
+    // How many cells the pack has; tiles past them are cleared
+    void setCount(uint8_t cells);
+
+    // A cell's reading; only a change that shows marks it for repaint
+    void set(uint8_t cell, uint16_t mv, uint8_t marks);
+
+    // Repaint every tile at the next paint (the screen was cleared)
+    void invalidate();
+
+    // Paint the tiles that changed. Returns how many were painted.
+    int paint();
+
+    // Just below the last row of the pack's tiles
+    int16_t bottom() const;
+
+private:
+    struct Tile {
+        uint16_t centivolts;
+        uint8_t step;
+        uint8_t marks;
+        bool shown;             // Inside the pack's count
+        bool dirty;
+    };
+
+    uint8_t stepOf(uint16_t mv) const;
+
+    DisplayGfx* display;
+    TextStrip strip;
+    int16_t originX;
+    int16_t originY;
+    int16_t width;
+    int16_t height;
+    uint8_t columnCount;
+    uint8_t count;
+    uint16_t emptyMv;
+    uint16_t fullMv;
+    uint16_t colors[HEAT_STEPS];
+    Tile tiles[MAX_CELLS];
+};
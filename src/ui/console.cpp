@@ -0,0 +1,68 @@
+#include "console.h"
+#include "../log.h"
+#include "../system/memory.h"
+
+#include <Arduino.h>
+#include <string.h>
+
+typedef char ConsoleLine[CONSOLE_COLUMNS + 1];
+
+static portMUX_TYPE consoleMux = portMUX_INITIALIZER_UNLOCKED;
+static ConsoleLine* ring = nullptr;
+static uint16_t ringLines = 0;
+static uint32_t lineCount = 0;
+
+bool consoleBegin(uint16_t lines) {
+    if (ring) return true;
+    if (lines == 0) return false;
+    ring = (ConsoleLine*)memoryAlloc((size_t)lines * sizeof(ConsoleLine), MEMORY_BULK, MEMORY_TAG_UI);
+    if (!ring) {
+        LOG_E(APP, "No PSRAM for %u console lines", lines);
+        return false;
+    }
+    ringLines = lines;
+    return true;
+}
+
+static void closeLine(const char* text, size_t length) {
+    portENTER_CRITICAL(&consoleMux);
+    char* line = ring[lineCount % ringLines];
+    memcpy(line, text, length);
+    line[length] = '\0';
+    lineCount++;
+    portEXIT_CRITICAL(&consoleMux);
+}
+
+void consoleAppend(const char* text, size_t length) {
+    LOG_D(APP, "VESC: %.*s", (int)length, text);
+    if (!ring) return;
+    size_t start = 0;
+    for (size_t i = 0; i <= length; i++) {
+        bool end = i == length || text[i] == '\n';
+        if (!end && i - start < CONSOLE_COLUMNS) continue;
+        // A trailing newline does not open an empty line
+        if (i == length && start == length && length > 0) break;
+        size_t n = i - start;
+        if (n > 0 && text[start + n - 1] == '\r') n--;
+        closeLine(text + start, n);
+        start = (end && i < length) ? i + 1 : i;
+    }
+}
+
+uint32_t consoleLineCount() {
+    return lineCount;
+}
+
+uint32_t consoleOldestLine() {
+    uint32_t count = lineCount;
+    return count > ringLines ? count - ringLines : 0;
+}
+
+bool consoleCopyLine(uint32_t line, char* out) {
+    if (!ring) return false;
+    portENTER_CRITICAL(&consoleMux);
+    bool stored = line < lineCount && lineCount - line <= ringLines;
+    if (stored) memcpy(out, ring[line % ringLines], sizeof(ConsoleLine));
+    portEXIT_CRITICAL(&consoleMux);
+    return stored;
+}
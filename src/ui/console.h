@@ -0,0 +1,29 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define CONSOLE_COLUMNS 53       // Characters per line at text size 1, as ScrollTextView shows
+
+// Scrollback of the VESC's terminal output (COMM_PRINT). Text is split
+// into lines at newlines and wrapped at CONSOLE_COLUMNS into a ring of
+// fixed-size lines in PSRAM, so appending never allocates. Lines are
+// numbered from the first since boot, as ScrollTextView fetches them; the
+// oldest are overwritten once the ring is full. consoleAppend() may be
+// called from any task.
+
+// Allocate the ring. Returns false without the memory; output is then
+// only logged.
+bool consoleBegin(uint16_t lines);
+
+// Add terminal output; a line that does not end in a newline is closed
+// anyway, as each COMM_PRINT is one print of the firmware
+void consoleAppend(const char* text, size_t length);
+
+// Lines appended since boot, and the oldest still in the ring
+uint32_t consoleLineCount();
+uint32_t consoleOldestLine();
+
+// Copy a line, NUL terminated, into out[CONSOLE_COLUMNS + 1]. Returns
+// false if it is no longer (or not yet) in the ring.
+bool consoleCopyLine(uint32_t line, char* out);
@@ -0,0 +1,194 @@
+#include "display.h"
+#include "palette.h"
+#include "../log.h"
+#include "../system/memory.h"
+
+#include <SD.h>
+#include <SPI.h>
+#include <string.h>
+
+// A push through the library, which takes the pixels as they are
+static void pushDirect(DisplayGfx* target, int32_t x, int32_t y, int32_t w, int32_t h, const uint16_t* pixels,
+                       int32_t stride) {
+    bool oldSwapBytes = target->getSwapBytes();
+    target->setSwapBytes(false);
+    if (stride == w) {
+        target->pushImage(x, y, w, h, (uint16_t*)pixels);
+    } else {
+        for (int32_t row = 0; row < h; row++) target->pushImage(x, y + row, w, 1, (uint16_t*)pixels + row * stride);
+    }
+    target->setSwapBytes(oldSwapBytes);
+}
+
+#ifdef DISPLAY_M5GFX
+// The Core2's SPI bus, which the card shares with the panel
+static const int8_t BUS_SCLK_PIN = 18;
+static const int8_t BUS_MISO_PIN = 38;
+static const int8_t BUS_MOSI_PIN = 23;
+static const uint32_t CARD_SPI_HZ = 40000000;   // As M5.begin() mounts it
+
+static M5GFX panel;
+
+// The line pool. A push of DMA_MIN_PIXELS or fewer costs less written out
+// by the CPU than set up for the DMA.
+static const uint8_t LINE_BUFFERS = 2;
+static const int32_t DMA_MIN_PIXELS = 1024;
+static uint16_t* lineBuffers[LINE_BUFFERS] = {};
+static uint32_t lineBufferPixels = 0;
+static uint8_t nextBuffer = 0;
+static uint16_t rgb332Table[256];                // To RGB565 in the LCD's byte order
+static uint16_t paletteTable[UI_PALETTE_SIZE];   // Likewise
+
+static uint16_t lcdOrder(uint16_t color) {
+    return (uint16_t)(color << 8 | color >> 8);
+}
+
+// One line of an image at 16, 8 or 4 bits a pixel, from column `left`,
+// into a buffer as RGB565 in the LCD's byte order
+static void expandLine(const uint8_t* line, uint8_t depth, int32_t left, int32_t w, uint16_t* out) {
+    if (depth == 16) {
+        memcpy(out, (const uint16_t*)line + left, (size_t)w * 2);
+    } else if (depth == 8) {
+        for (int32_t i = 0; i < w; i++) out[i] = rgb332Table[line[left + i]];
+    } else {
+        // Two pixels a byte, the even one in the high nibble
+        for (int32_t i = 0; i < w; i++) {
+            uint8_t pair = line[(left + i) >> 1];
+            out[i] = paletteTable[((left + i) & 1) ? (pair & 0x0F) : (pair >> 4)];
+        }
+    }
+}
+
+// Stream rows of an image to the panel a band of lines at a time. Each
+// pushImageDMA() waits for the other buffer's transfer before starting,
+// so the band after it is being filled while it goes out. Returns false,
+// having drawn nothing, if the pool cannot take it.
+static bool pushPooled(int32_t x, int32_t y, int32_t w, int32_t h, const uint8_t* image, uint32_t strideBytes,
+                       uint8_t depth) {
+    // Clipped to the panel, as the library would
+    int32_t left = 0;
+    if (x < 0) {
+        left = -x;
+        w += x;
+        x = 0;
+    }
+    if (y < 0) {
+        image += (uint32_t)(-y) * strideBytes;
+        h += y;
+        y = 0;
+    }
+    if (x + w > panel.width()) w = panel.width() - x;
+    if (y + h > panel.height()) h = panel.height() - y;
+    if (w <= 0 || h <= 0) return true;
+    if (lineBufferPixels < (uint32_t)w || w * h <= DMA_MIN_PIXELS) return false;
+
+    int32_t band = (int32_t)(lineBufferPixels / (uint32_t)w);
+    panel.startWrite();
+    for (int32_t row = 0; row < h; row += band) {
+        int32_t rows = h - row < band ? h - row : band;
+        uint16_t* buffer = lineBuffers[nextBuffer];
+        nextBuffer = (uint8_t)((nextBuffer + 1) % LINE_BUFFERS);
+        for (int32_t r = 0; r < rows; r++) {
+            expandLine(image + (uint32_t)(row + r) * strideBytes, depth, left, w, buffer + r * w);
+        }
+        panel.pushImageDMA(x, y + row, w, rows, (const lgfx::swap565_t*)buffer);
+    }
+    // The last band is waited for here, or by the caller's own endWrite()
+    panel.endWrite();
+    return true;
+}
+
+void displayBegin() {
+    // The library brings up the PMIC, touch and serial but leaves the
+    // panel alone. M5GFX sets up the bus for it; the card is mounted on
+    // that bus afterwards, which is the order LovyanGFX needs to share it.
+    M5.begin(false, false);
+    if (!panel.init()) LOG_E(UI, "M5GFX found no panel");
+    SPI.begin(BUS_SCLK_PIN, BUS_MISO_PIN, BUS_MOSI_PIN, -1);
+    SD.begin(TFCARD_CS_PIN, SPI, CARD_SPI_HZ);
+    LOG_I(UI, "Display on M5GFX, %dx%d", panel.width(), panel.height());
+}
+
+DisplayGfx& displayPanel() {
+    return panel;
+}
+
+void displayCommand(uint8_t command, const uint8_t* data, size_t length) {
+    panel.startWrite();
+    panel.writeCommand(command);
+    for (size_t i = 0; i < length; i++) panel.writeData(data[i]);
+    panel.endWrite();
+}
+
+const char* displayBackendName() {
+    return "M5GFX";
+}
+
+bool displayLinePoolBegin(uint16_t lines) {
+    if (lineBufferPixels > 0) return true;
+    if (lines == 0) return false;
+    uint32_t pixels = (uint32_t)panel.width() * lines;
+    for (uint8_t i = 0; i < LINE_BUFFERS; i++) {
+        lineBuffers[i] = (uint16_t*)memoryAlloc(pixels * 2, MEMORY_DMA, MEMORY_TAG_UI);
+        if (!lineBuffers[i]) {
+            for (uint8_t j = 0; j < i; j++) memoryFree(lineBuffers[j]);
+            LOG_W(UI, "No DMA memory for the display's line buffers");
+            return false;
+        }
+    }
+    for (int c = 0; c < 256; c++) rgb332Table[c] = lcdOrder(rgb332To565((uint8_t)c));
+    for (uint8_t c = 0; c < UI_PALETTE_SIZE; c++) paletteTable[c] = lcdOrder(UI_PALETTE[c]);
+    lineBufferPixels = pixels;
+    LOG_I(UI, "Display: %u DMA line buffers of %u lines", (unsigned)LINE_BUFFERS, (unsigned)lines);
+    return true;
+}
+
+void displayPushImage(DisplayGfx* target, int32_t x, int32_t y, int32_t w, int32_t h, const uint16_t* pixels,
+                      int32_t stride) {
+    if (target == &panel && pushPooled(x, y, w, h, (const uint8_t*)pixels, (uint32_t)stride * 2, 16)) return;
+    pushDirect(target, x, y, w, h, pixels, stride);
+}
+
+void displayPushSprite(DisplaySprite& sprite, int32_t x, int32_t y) {
+    uint8_t depth = sprite.getColorDepth();
+    int32_t w = sprite.width();
+    // 4-bit rows are whole bytes; an odd width would pad them
+    bool streams = depth == 16 || depth == 8 || (depth == 4 && (w & 1) == 0);
+    if (streams && sprite.getParent() == &panel &&
+        pushPooled(x, y, w, sprite.height(), (const uint8_t*)sprite.getBuffer(), (uint32_t)w * depth / 8, depth)) {
+        return;
+    }
+    sprite.pushSprite(x, y);
+}
+#else
+void displayBegin() {
+    M5.begin();
+}
+
+DisplayGfx& displayPanel() {
+    return M5.Lcd;
+}
+
+void displayCommand(uint8_t command, const uint8_t* data, size_t length) {
+    M5.Lcd.writecommand(command);
+    for (size_t i = 0; i < length; i++) M5.Lcd.writedata(data[i]);
+}
+
+const char* displayBackendName() {
+    return "M5.Lcd";
+}
+
+// M5.Lcd writes every pixel from the CPU, so a pool would only add a copy
+bool displayLinePoolBegin(uint16_t lines) {
+    return false;
+}
+
+void displayPushImage(DisplayGfx* target, int32_t x, int32_t y, int32_t w, int32_t h, const uint16_t* pixels,
+                      int32_t stride) {
+    pushDirect(target, x, y, w, h, pixels, stride);
+}
+
+void displayPushSprite(DisplaySprite& sprite, int32_t x, int32_t y) {
+    sprite.pushSprite(x, y);
+}
+#endif
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <M5Core2.h>
+
+// The graphics library the UI draws with, chosen at build time. By
+// default it is the M5Core2 library's own M5.Lcd, a TFT_eSPI fork. With
+// -DDISPLAY_M5GFX (the m5stack-core2-m5gfx environment) it is M5GFX, the
+// LovyanGFX build for M5 devices, driving the panel on its own SPI bus
+// driver with DMA; the M5Core2 library then only looks after the PMIC,
+// touch and buttons.
+//
+// Everything that draws takes a DisplayGfx and makes DisplaySprites, the
+// two backends' display and sprite classes under one name. As with
+// TFT_eSprite and TFT_eSPI, a sprite is also a DisplayGfx, so drawing
+// code can aim at either.
+#ifdef DISPLAY_M5GFX
+#include <M5GFX.h>
+
+typedef lgfx::LovyanGFX DisplayGfx;
+
+class DisplaySprite : public M5Canvas {
+public:
+    explicit DisplaySprite(DisplayGfx* parent) : M5Canvas(parent) {}
+};
+#else
+typedef TFT_eSPI DisplayGfx;
+typedef TFT_eSprite DisplaySprite;
+#endif
+
+// Start the M5Core2 library and the panel; called in place of M5.begin()
+void displayBegin();
+
+// The panel
+DisplayGfx& displayPanel();
+
+// Send the panel controller a command and its parameter bytes (display
+// on and off, the hardware scroll)
+void displayCommand(uint8_t command, const uint8_t* data = nullptr, size_t length = 0);
+
+// "M5GFX" or "M5.Lcd", for the logs and the render benchmark
+const char* displayBackendName();
+
+// DMA line buffers shared by everything that pushes to the panel. The SPI
+// DMA cannot read PSRAM, where the sprites are, so a push from there is a
+// few lines at a time through two buffers in internal RAM: the CPU fills
+// one (expanding 8 and 4-bit images to RGB565 as it goes) while the DMA
+// sends the other. Pushes to a sprite, small ones and those the pool
+// cannot stream are drawn by the library as before. Only M5GFX has the
+// DMA path; with M5.Lcd no pool is allocated. UI task only.
+
+// Allocate two buffers of `lines` panel-wide lines. Returns false
+// without the memory, or without a DMA path.
+bool displayLinePoolBegin(uint16_t lines);
+
+// Push w x h RGB565 pixels in the LCD's byte order whose rows start
+// `stride` pixels apart, clipped to the target
+void displayPushImage(DisplayGfx* target, int32_t x, int32_t y, int32_t w, int32_t h, const uint16_t* pixels,
+                      int32_t stride);
+
+// pushSprite(x, y), through the pool when the sprite goes to the panel
+void displayPushSprite(DisplaySprite& sprite, int32_t x, int32_t y);
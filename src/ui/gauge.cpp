@@ -0,0 +1,195 @@
+#include "gauge.h"
+#include "trig.h"
+#include "../telemetry/fixed_point.h"
+#include "../log.h"
+
+#include <stdio.h>
+
+static const int16_t HALF_SWEEP = GaugeWidget::SWEEP / 2;
+static const int16_t MAJOR_TICKS = 10;       // Intervals between the labelled ends
+static const int16_t END_TEXT_HEIGHT = 10;   // Below the ends of the scale
+
+// Point at a radius and angle from a center, the angle clockwise from
+// straight up and the radius in pixels
+static void polar(int16_t cx, int16_t cy, int32_t r, int16_t degrees, int16_t& px, int16_t& py) {
+    px = cx + (int16_t)((r * sinQ14(degrees) + 8192) >> 14);
+    py = cy - (int16_t)((r * cosQ14(degrees) + 8192) >> 14);
+}
+
+GaugeWidget::GaugeWidget(DisplayGfx* display, int16_t x, int16_t y, int16_t w, int16_t h,
+                         uint16_t color, int32_t fullScale, uint8_t decimals, const char* label,
+                         const char* unit)
+    : Widget(display, x, y, w, h), display(display), face(display), faceReady(false), cleared(false),
+      color(color), needleColor(color), fullScale(fullScale > 0 ? fullScale : 1), decimals(decimals), label(label),
+      unit(unit), angle(-HALF_SWEEP), shownAngle(-HALF_SWEEP) {
+    // The scale reaches cos(120) = half a radius below the center, and
+    // the end values sit under that
+    radius = w / 2 - 2;
+    int16_t byHeight = (h - END_TEXT_HEIGHT - 2) * 2 / 3;
+    if (byHeight < radius) radius = byHeight;
+    if (radius < 8) radius = 8;
+    centerX = w / 2;
+    centerY = radius + 2;
+    needleLength = radius - radius / 8 - 2;
+    needleHalfWidth = radius / 24 + 1;
+    hubRadius = needleHalfWidth + 2;
+}
+
+bool GaugeWidget::begin() {
+    if (faceReady) return true;
+    face.setColorDepth(16);
+    if (face.createSprite(width(), height()) == nullptr) {
+        LOG_W(UI, "No memory for a %dx%d gauge face, drawing it directly", width(), height());
+        return false;
+    }
+    drawFace(face, 0, 0);
+    faceReady = true;
+    return true;
+}
+
+void GaugeWidget::invalidate() {
+    cleared = false;
+    dirty = true;
+}
+
+void GaugeWidget::redrawFace() {
+    if (faceReady) drawFace(face, 0, 0);
+    invalidate();
+}
+
+int16_t GaugeWidget::angleOf(int32_t value) const {
+    if (value <= 0) return -HALF_SWEEP;
+    if (value >= fullScale) return HALF_SWEEP;
+    return -HALF_SWEEP + (int16_t)(((int64_t)value * SWEEP) / fullScale);
+}
+
+void GaugeWidget::setValue(int32_t value) {
+    angle = angleOf(value);
+    if (angle != shownAngle) dirty = true;
+}
+
+void GaugeWidget::setNeedleColor(uint16_t newColor) {
+    if (newColor == needleColor) return;
+    // The needle is drawn over itself, so nothing else repaints
+    needleColor = newColor;
+    dirty = true;
+}
+
+void GaugeWidget::drawFace(DisplayGfx& target, int16_t left, int16_t top) {
+    int16_t cx = left + centerX;
+    int16_t cy = top + centerY;
+    target.fillRect(left, top, width(), height(), BLACK);
+
+    // The scale, two pixels wide, in short chords
+    int16_t lastX = 0, lastY = 0, lastInnerX = 0, lastInnerY = 0;
+    for (int16_t degrees = -HALF_SWEEP; degrees <= HALF_SWEEP; degrees += 4) {
+        int16_t px, py, ix, iy;
+        polar(cx, cy, radius, degrees, px, py);
+        polar(cx, cy, radius - 1, degrees, ix, iy);
+        if (degrees > -HALF_SWEEP) {
+            target.drawLine(lastX, lastY, px, py, color);
+            target.drawLine(lastInnerX, lastInnerY, ix, iy, color);
+        }
+        lastX = px;
+        lastY = py;
+        lastInnerX = ix;
+        lastInnerY = iy;
+    }
+
+    // Major and minor ticks
+    int16_t majorLength = radius / 8 + 1;
+    for (int16_t tick = 0; tick <= 2 * MAJOR_TICKS; tick++) {
+        int16_t degrees = -HALF_SWEEP + tick * SWEEP / (2 * MAJOR_TICKS);
+        int16_t length = (tick % 2 == 0) ? majorLength : majorLength / 2;
+        int16_t ox, oy, ix, iy;
+        polar(cx, cy, radius - 2, degrees, ox, oy);
+        polar(cx, cy, radius - 2 - length, degrees, ix, iy);
+        target.drawLine(ox, oy, ix, iy, WHITE);
+    }
+
+    // Zero and full scale under the ends, the name and unit under the hub
+    char text[24];
+    int16_t endX, endY;
+    target.setTextSize(1);
+    target.setTextColor(LIGHTGREY, BLACK);
+    target.setTextDatum(TC_DATUM);
+    polar(cx, cy, radius - majorLength / 2, -HALF_SWEEP, endX, endY);
+    target.drawString("0", endX, endY + 2);
+    formatFixed(text, sizeof(text), fullScale, decimals);
+    polar(cx, cy, radius - majorLength / 2, HALF_SWEEP, endX, endY);
+    target.drawString(text, endX, endY + 2);
+
+    snprintf(text, sizeof(text), "%s%s%s", label, (*label && *unit) ? " " : "", unit);
+    target.setTextSize(radius >= 48 ? 2 : 1);
+    target.setTextColor(WHITE, BLACK);
+    target.drawString(text, cx, cy + radius / 3);
+    target.setTextDatum(TL_DATUM);
+}
+
+void GaugeWidget::needleTip(int16_t degrees, int16_t& tipX, int16_t& tipY) const {
+    polar(centerX, centerY, needleLength, degrees, tipX, tipY);
+}
+
+// Push the face back under a needle, as a few boxes along it rather than
+// one box around all of it, which for a diagonal needle would be most of
+// the dial
+void GaugeWidget::restoreFace(int16_t degrees) {
+    int16_t tipX, tipY;
+    needleTip(degrees, tipX, tipY);
+    int16_t margin = hubRadius + 1;
+    const uint16_t* pixels = (const uint16_t*)face.frameBuffer(0);
+    for (int k = 0; k < NEEDLE_CHUNKS; k++) {
+        int16_t x0 = centerX + (tipX - centerX) * k / NEEDLE_CHUNKS;
+        int16_t y0 = centerY + (tipY - centerY) * k / NEEDLE_CHUNKS;
+        int16_t x1 = centerX + (tipX - centerX) * (k + 1) / NEEDLE_CHUNKS;
+        int16_t y1 = centerY + (tipY - centerY) * (k + 1) / NEEDLE_CHUNKS;
+        int16_t left = (x0 < x1 ? x0 : x1) - margin;
+        int16_t right = (x0 < x1 ? x1 : x0) + margin;
+        int16_t top = (y0 < y1 ? y0 : y1) - margin;
+        int16_t bottom = (y0 < y1 ? y1 : y0) + margin;
+        if (left < 0) left = 0;
+        if (top < 0) top = 0;
+        if (right >= width()) right = width() - 1;
+        if (bottom >= height()) bottom = height() - 1;
+
+        // The face is in the LCD's byte order already
+        int16_t columns = right - left + 1;
+        display->setWindow(x() + left, y() + top, x() + right, y() + bottom);
+        for (int16_t row = top; row <= bottom; row++) {
+            display->pushColors((uint16_t*)pixels + (uint32_t)row * width() + left, columns, false);
+        }
+    }
+}
+
+void GaugeWidget::drawNeedle(int16_t degrees) {
+    int16_t tipX, tipY;
+    needleTip(degrees, tipX, tipY);
+    int16_t cx = x() + centerX;
+    int16_t cy = y() + centerY;
+
+    // A thin triangle from a base across the hub to the tip
+    int16_t dx = (int16_t)((needleHalfWidth * cosQ14(degrees) + 8192) >> 14);
+    int16_t dy = (int16_t)((needleHalfWidth * sinQ14(degrees) + 8192) >> 14);
+    display->fillTriangle(x() + tipX, y() + tipY, cx + dx, cy + dy, cx - dx, cy - dy, needleColor);
+    display->fillCircle(cx, cy, hubRadius, WHITE);
+}
+
+bool GaugeWidget::paint() {
+    if (!dirty) return false;
+    display->startWrite();
+    if (!cleared || !faceReady) {
+        if (faceReady) {
+            displayPushSprite(face, x(), y());
+        } else {
+            drawFace(*display, x(), y());
+        }
+        cleared = true;
+    } else if (angle != shownAngle) {
+        restoreFace(shownAngle);
+    }
+    drawNeedle(angle);
+    shownAngle = angle;
+    display->endWrite();
+    dirty = false;
+    return true;
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include "widget.h"
+
+// Analog dial of one value, with a 240 degree scale and a needle from
+// its center. The face (scale, ticks, end values and label) is drawn
+// once into a sprite in PSRAM. A frame only puts back the face under the
+// old needle, in a few small rectangles along it, and draws the new
+// needle straight to the LCD, with its ends from the sine table
+// (trig.h). The needle moves in whole degrees, so a change that does not
+// turn it costs nothing. Without memory for the face it is drawn
+// straight to the LCD on every move instead.
+class GaugeWidget : public Widget {
+public:
+    static const int16_t SWEEP = 240;   // Degrees from zero to full scale
+
+    // fullScale and the values are scaled integers with the given
+    // decimals, as for ValueWidget
+    GaugeWidget(DisplayGfx* display, int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color,
+                int32_t fullScale, uint8_t decimals, const char* label, const char* unit);
+
+    bool begin();
+    void invalidate();
+    bool paint();
+    bool retainable() const { return false; }
+
+    // Values outside the scale pin the needle to its end
+    void setValue(int32_t value);
+
+    // Draw the face again, e.g. once the unit's text has changed
+    void redrawFace();
+
+    // Needle in another color than the scale, e.g. greyed for a stale value
+    void setNeedleColor(uint16_t needleColor);
+
+protected:
+    // Drawn straight to the LCD by paint()
+    void render(SpritePanel& panel) {}
+
+private:
+    static const int NEEDLE_CHUNKS = 4;
+
+    int16_t angleOf(int32_t value) const;
+    void drawFace(DisplayGfx& target, int16_t left, int16_t top);
+    void restoreFace(int16_t angle);
+    void drawNeedle(int16_t angle);
+    void needleTip(int16_t angle, int16_t& tipX, int16_t& tipY) const;
+
+    DisplayGfx* display;
+    DisplaySprite face;
+    bool faceReady;
+    bool cleared;
+    uint16_t color;
+    uint16_t needleColor;
+    int32_t fullScale;
+    uint8_t decimals;
+    const char* label;
+    const char* unit;
+    int16_t centerX;               // Relative to the widget
+    int16_t centerY;
+    int16_t radius;
+    int16_t needleLength;
+    int16_t needleHalfWidth;       // At the hub
+    int16_t hubRadius;
+    int16_t angle;                 // Clockwise from straight up
+    int16_t shownAngle;
+};
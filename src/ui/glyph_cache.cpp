@@ -0,0 +1,183 @@
+#include "glyph_cache.h"
+#include "../log.h"
+#include "../system/memory.h"
+
+#include <string.h>
+
+// VLW layout (tools/value_font.py): a header of six words, seven words of
+// metrics per glyph, then the glyphs' coverage bytes in the same order
+static const uint32_t VLW_HEADER = 24;
+static const uint32_t VLW_METRICS = 28;
+
+// VLW words are big-endian
+static int32_t vlwWord(const uint8_t* p) {
+    return (int32_t)((uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | p[3]);
+}
+
+// Metrics of a character in a VLW font and, through alpha, its coverage.
+// nullptr if the font does not have it.
+static const uint8_t* findSmooth(const uint8_t* font, char c, const uint8_t** alpha) {
+    int32_t glyphs = vlwWord(font);
+    const uint8_t* bitmap = font + VLW_HEADER + (uint32_t)glyphs * VLW_METRICS;
+    for (int32_t i = 0; i < glyphs; i++) {
+        const uint8_t* metrics = font + VLW_HEADER + (uint32_t)i * VLW_METRICS;
+        if (vlwWord(metrics) == (uint8_t)c) {
+            *alpha = bitmap;
+            return metrics;
+        }
+        bitmap += (uint32_t)vlwWord(metrics + 4) * vlwWord(metrics + 8);
+    }
+    return nullptr;
+}
+
+// Mix two RGB565 colors, alpha 0 (background) to 255 (foreground)
+static uint16_t blend(uint8_t alpha, uint16_t fg, uint16_t bg) {
+    uint32_t inverse = 255 - alpha;
+    uint32_t r = ((fg >> 11) * alpha + (bg >> 11) * inverse + 127) / 255;
+    uint32_t g = (((fg >> 5) & 0x3F) * alpha + ((bg >> 5) & 0x3F) * inverse + 127) / 255;
+    uint32_t b = ((fg & 0x1F) * alpha + (bg & 0x1F) * inverse + 127) / 255;
+    return (uint16_t)(r << 11 | g << 5 | b);
+}
+
+// Sprite buffers hold pixels in the LCD's byte order
+static uint16_t lcdOrder(uint16_t color) {
+    return (uint16_t)(color << 8 | color >> 8);
+}
+
+GlyphCache::GlyphCache(const char* charset, uint8_t textSize, uint16_t color, uint16_t background,
+                       const uint8_t* smoothFont)
+    : charset(charset), count(0), textSize(textSize), fgColor(color), bgColor(background),
+      font(smoothFont), glyphHeight(8 * textSize), builtinTop(0), pixels(nullptr) {
+}
+
+GlyphCache::~GlyphCache() {
+    if (pixels) memoryFree(pixels);
+}
+
+bool GlyphCache::begin(DisplayGfx* display) {
+    if (pixels) return true;
+
+    // The smooth font sets the line; built-in glyphs sit on its baseline,
+    // 7 of their 8 rows above it
+    int16_t ascent = 0;
+    int16_t builtinHeight = 8 * textSize;
+    if (font) {
+        ascent = vlwWord(font + 16);
+        glyphHeight = ascent + vlwWord(font + 20);
+        builtinTop = ascent - 7 * textSize;
+        if (builtinTop < 0) builtinTop = 0;
+        if (glyphHeight < builtinTop + builtinHeight) glyphHeight = builtinTop + builtinHeight;
+    }
+
+    // Measure every glyph with the font that draws it
+    DisplaySprite scratch(display);
+    scratch.setTextSize(textSize);
+    char one[2] = { 0, 0 };
+    const uint8_t* smooth[MAX_GLYPHS];
+    const uint8_t* alpha[MAX_GLYPHS];
+    int16_t widest = 0;
+    uint32_t totalPixels = 0;
+    count = 0;
+    for (const char* c = charset; *c && count < MAX_GLYPHS; c++) {
+        smooth[count] = font ? findSmooth(font, *c, &alpha[count]) : nullptr;
+        if (smooth[count]) {
+            widths[count] = vlwWord(smooth[count] + 12);
+        } else {
+            one[0] = *c;
+            widths[count] = scratch.textWidth(one);
+            if (widths[count] > widest) widest = widths[count];
+        }
+        offsets[count] = totalPixels;
+        totalPixels += (uint32_t)widths[count] * glyphHeight;
+        count++;
+    }
+
+    size_t bytes = totalPixels * sizeof(uint16_t);
+    pixels = (uint16_t*)memoryAlloc(bytes, MEMORY_BULK, MEMORY_TAG_UI);
+    if (!pixels) {
+        LOG_E(UI, "No memory for %u byte glyph cache", (unsigned)bytes);
+        return false;
+    }
+
+    uint16_t background = lcdOrder(bgColor);
+    for (uint32_t p = 0; p < totalPixels; p++) pixels[p] = background;
+    for (int i = 0; i < count; i++) {
+        if (smooth[i]) blendSmooth(i, ascent, smooth[i], alpha[i]);
+    }
+
+    // Rasterize each built-in glyph once into a scratch sprite and keep its
+    // pixels. The sprite buffer is already in the LCD's byte order, so the
+    // copies can be pushed as-is.
+    if (widest > 0) {
+        scratch.setColorDepth(16);
+        if (scratch.createSprite(widest, builtinHeight) == nullptr) {
+            LOG_E(UI, "No memory for %dx%d glyph sprite", widest, builtinHeight);
+            memoryFree(pixels);
+            pixels = nullptr;
+            return false;
+        }
+        const uint16_t* frame = (const uint16_t*)scratch.frameBuffer(0);
+        for (int i = 0; i < count; i++) {
+            if (smooth[i]) continue;
+            scratch.fillSprite(bgColor);
+            scratch.drawChar(0, 0, charset[i], fgColor, bgColor, textSize);
+            for (int16_t row = 0; row < builtinHeight; row++) {
+                memcpy(pixels + offsets[i] + (uint32_t)(builtinTop + row) * widths[i],
+                       frame + (uint32_t)row * widest,
+                       widths[i] * sizeof(uint16_t));
+            }
+        }
+        scratch.deleteSprite();
+    }
+
+    LOG_I(UI, "Glyph cache: %d glyphs, %s, %u bytes", count, font ? "smooth" : "built-in",
+          (unsigned)bytes);
+    return true;
+}
+
+// Blend one smooth glyph into its cell, clipped to it. The bitmap's top
+// is dY above the baseline, which is ascent rows down the cell.
+void GlyphCache::blendSmooth(int index, int16_t ascent, const uint8_t* metrics, const uint8_t* alpha) {
+    int32_t rows = vlwWord(metrics + 4);
+    int32_t columns = vlwWord(metrics + 8);
+    int32_t top = ascent - vlwWord(metrics + 16);
+    int32_t left = vlwWord(metrics + 20);
+    uint16_t* cell = pixels + offsets[index];
+    for (int32_t row = 0; row < rows; row++) {
+        int32_t y = top + row;
+        if (y < 0 || y >= glyphHeight) continue;
+        for (int32_t column = 0; column < columns; column++) {
+            int32_t x = left + column;
+            uint8_t a = alpha[row * columns + column];
+            if (a == 0 || x < 0 || x >= widths[index]) continue;
+            cell[y * widths[index] + x] = lcdOrder(blend(a, fgColor, bgColor));
+        }
+    }
+}
+
+int GlyphCache::indexOf(char c) const {
+    for (int i = 0; i < count; i++) {
+        if (charset[i] == c) return i;
+    }
+    return -1;
+}
+
+int16_t GlyphCache::glyphWidth(char c) const {
+    int i = indexOf(c);
+    return i >= 0 ? widths[i] : 0;
+}
+
+int16_t GlyphCache::textWidth(const char* text) const {
+    int16_t total = 0;
+    for (const char* c = text; *c; c++) {
+        total += glyphWidth(*c);
+    }
+    return total;
+}
+
+void GlyphCache::draw(DisplayGfx* display, char c, int16_t x, int16_t y) const {
+    int i = indexOf(c);
+    if (i < 0 || !pixels) return;
+
+    displayPushImage(display, x, y, widths[i], glyphHeight, pixels + offsets[i], widths[i]);
+}
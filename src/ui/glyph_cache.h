@@ -0,0 +1,58 @@
+#pragma once
+
+#include "display.h"
+
+// A small character set rendered once, at one text size and color, into
+// RGB565 bitmaps in PSRAM. Drawing a cached glyph is a single pushImage
+// of ready pixels instead of rasterizing the scaled font dot by dot, and
+// the per-glyph widths are measured from the font so text can be
+// centered exactly.
+//
+// With a smooth font (VLW data, see tools/value_font.py) the glyphs it
+// has are blended from its 8-bit coverage between the two colors, so the
+// edges are anti-aliased at no cost per draw. The font is read in place,
+// wherever it lives; characters it lacks fall back to the built-in font
+// at the text size, with the baselines lined up.
+class GlyphCache {
+public:
+    static const int MAX_GLYPHS = 20;
+
+    GlyphCache(const char* charset, uint8_t textSize, uint16_t color, uint16_t background,
+               const uint8_t* smoothFont = nullptr);
+    ~GlyphCache();
+
+    // Render every glyph. Returns false if the bitmaps could not be allocated.
+    bool begin(DisplayGfx* display);
+
+    bool has(char c) const { return indexOf(c) >= 0; }
+
+    // Advance width of one glyph, 0 for characters not in the set
+    int16_t glyphWidth(char c) const;
+    int16_t height() const { return glyphHeight; }
+    uint8_t size() const { return textSize; }
+
+    // Exact width of a string drawn with draw()
+    int16_t textWidth(const char* text) const;
+
+    // Blit one glyph with its top-left corner at (x, y). Characters not
+    // in the set are skipped.
+    void draw(DisplayGfx* display, char c, int16_t x, int16_t y) const;
+
+    uint16_t background() const { return bgColor; }
+
+private:
+    int indexOf(char c) const;
+    void blendSmooth(int index, int16_t ascent, const uint8_t* metrics, const uint8_t* alpha);
+
+    const char* charset;
+    uint8_t count;
+    uint8_t textSize;
+    uint16_t fgColor;
+    uint16_t bgColor;
+    const uint8_t* font;
+    int16_t glyphHeight;
+    int16_t builtinTop;          // Row of the built-in glyphs, to share the smooth baseline
+    int16_t widths[MAX_GLYPHS];
+    uint32_t offsets[MAX_GLYPHS];
+    uint16_t* pixels;
+};
@@ -0,0 +1,146 @@
+#include "input.h"
+#include "../log.h"
+#include "../system/i2c_bus.h"
+
+#include <M5Core2.h>
+
+static const uint8_t QUEUE_LENGTH = 8;
+static const uint32_t FALLBACK_POLL_MS = 500;   // In case an interrupt edge is missed
+static const int16_t DISPLAY_WIDTH = 320;
+static const int16_t DISPLAY_HEIGHT = 240;      // The touch panel reaches below it, over the buttons
+static const uint16_t SWIPE_MIN_DISTANCE = 80;  // Pixels the finger has to travel
+static const uint8_t SWIPE_SPREAD = 30;         // Degrees either side of the direction
+static const uint16_t SWIPE_MAX_MS = 500;       // A slower drag is not a swipe
+
+static uint32_t holdTimeMs = 700;
+static portMUX_TYPE inputMux = portMUX_INITIALIZER_UNLOCKED;   // The bus task fills what the loop reads
+static InputEvent queue[QUEUE_LENGTH];
+static uint8_t head = 0;
+static uint8_t count = 0;
+static uint32_t dropped = 0;
+static volatile bool touchActive = false;
+static int16_t touchX = -1;
+static int16_t touchY = -1;
+static volatile bool readPending = false;      // A read is queued or on the bus
+static bool readWanted = false;                // The interrupt fired while one was
+static uint32_t lastReadMs = 0;
+
+// The library matches the finger's track against these as it lifts.
+// Each registers itself when constructed, so they are not copied.
+static const Zone DISPLAY_ZONE(0, 0, DISPLAY_WIDTH, DISPLAY_HEIGHT);
+static Gesture swipeLeft(DISPLAY_ZONE, DISPLAY_ZONE, "swipe left", SWIPE_MIN_DISTANCE, DIR_LEFT, SWIPE_SPREAD, false,
+                         SWIPE_MAX_MS);
+static Gesture swipeRight(DISPLAY_ZONE, DISPLAY_ZONE, "swipe right", SWIPE_MIN_DISTANCE, DIR_RIGHT, SWIPE_SPREAD, false,
+                          SWIPE_MAX_MS);
+static Gesture swipeDown(DISPLAY_ZONE, DISPLAY_ZONE, "swipe down", SWIPE_MIN_DISTANCE, DIR_DOWN, SWIPE_SPREAD, false,
+                         SWIPE_MAX_MS);
+static Gesture swipeUp(DISPLAY_ZONE, DISPLAY_ZONE, "swipe up", SWIPE_MIN_DISTANCE, DIR_UP, SWIPE_SPREAD, false,
+                       SWIPE_MAX_MS);
+static Gesture* const swipes[INPUT_SWIPE_COUNT] = { &swipeLeft, &swipeRight, &swipeDown, &swipeUp };
+
+static void push(InputButton button, InputAction action, InputSwipe swipe = INPUT_SWIPE_LEFT) {
+    portENTER_CRITICAL(&inputMux);
+    if (count == QUEUE_LENGTH) {
+        dropped++;
+    } else {
+        InputEvent& event = queue[(head + count) % QUEUE_LENGTH];
+        event.button = button;
+        event.action = action;
+        event.swipe = swipe;
+        count++;
+    }
+    portEXIT_CRITICAL(&inputMux);
+}
+
+void inputBegin(uint32_t holdMs) {
+    holdTimeMs = holdMs;
+    inputClear();
+}
+
+// On the bus task: read the panel and queue the button changes
+static void readTouch(void* context) {
+    M5.update();
+    bool active = M5.Touch.ispressed();
+    Point point = active ? M5.Touch.getPressPoint() : Point();
+
+    Button* buttons[INPUT_BUTTON_COUNT] = { &M5.BtnA, &M5.BtnB, &M5.BtnC };
+    for (uint8_t i = 0; i < INPUT_BUTTON_COUNT; i++) {
+        InputButton button = (InputButton)i;
+        if (buttons[i]->wasPressed()) push(button, INPUT_PRESS);
+        if (buttons[i]->wasReleasefor(holdTimeMs)) {
+            push(button, INPUT_HOLD);
+        } else if (buttons[i]->wasReleased()) {
+            push(button, INPUT_TAP);
+        }
+    }
+    for (uint8_t i = 0; i < INPUT_SWIPE_COUNT; i++) {
+        if (swipes[i]->wasDetected()) push(INPUT_BUTTON_A, INPUT_SWIPE, (InputSwipe)i);
+    }
+
+    portENTER_CRITICAL(&inputMux);
+    touchActive = active;
+    touchX = point.x;
+    touchY = point.y;
+    portEXIT_CRITICAL(&inputMux);
+    readPending = false;
+}
+
+void inputUpdate(bool touchInterrupt) {
+    if (touchInterrupt) readWanted = true;
+    if (readPending) return;
+    uint32_t now = millis();
+    if (!readWanted && !touchActive && now - lastReadMs < FALLBACK_POLL_MS) return;
+    readWanted = false;
+    lastReadMs = now;
+    readPending = true;
+    if (!i2cBusPost(I2C_PRIORITY_TOUCH, readTouch, nullptr)) readPending = false;
+}
+
+bool inputTouchActive() {
+    return touchActive || readPending;
+}
+
+bool inputTouchPoint(int16_t& x, int16_t& y) {
+    portENTER_CRITICAL(&inputMux);
+    bool down = touchActive && touchX >= 0 && touchY >= 0 && touchY < DISPLAY_HEIGHT;
+    x = touchX;
+    y = touchY;
+    portEXIT_CRITICAL(&inputMux);
+    return down;
+}
+
+bool inputNext(InputEvent& event) {
+    portENTER_CRITICAL(&inputMux);
+    bool any = count > 0;
+    if (any) {
+        event = queue[head];
+        head = (head + 1) % QUEUE_LENGTH;
+        count--;
+    }
+    portEXIT_CRITICAL(&inputMux);
+    return any;
+}
+
+void inputDispatch(const ScreenInput& screen) {
+    InputEvent event;
+    while (inputNext(event)) {
+        if (event.action == INPUT_SWIPE) {
+            if (screen.swipe[event.swipe]) screen.swipe[event.swipe]();
+            continue;
+        }
+        const InputHandler* handlers = event.action == INPUT_PRESS ? screen.press :
+                                       (event.action == INPUT_TAP ? screen.tap : screen.hold);
+        if (handlers[event.button]) handlers[event.button]();
+    }
+}
+
+void inputClear() {
+    portENTER_CRITICAL(&inputMux);
+    head = 0;
+    count = 0;
+    portEXIT_CRITICAL(&inputMux);
+}
+
+uint32_t inputDropped() {
+    return dropped;
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <stdint.h>
+
+// Input dispatcher for the Core2's three touch buttons. The touch panel
+// is only read when its interrupt fired, while a finger is down, or on a
+// slow fallback tick, so an idle loop does no I2C for input. A read is a
+// touch job on the I2C bus task (see i2c_bus.h): the loop only queues
+// it, and the button changes it finds become events in a small queue,
+// which inputDispatch() hands to the active screen's handlers on the
+// next pass.
+//
+// Each button reports a press as it goes down, then on release a tap or,
+// if it was held for the hold time, a hold. A screen that only cares
+// about presses reacts without waiting for the release; one that gives a
+// button both a tap and a hold meaning uses those instead.
+//
+// A quick drag across the display, sideways, down or up, is a swipe,
+// reported once the finger lifts. The button strip below the display is left out, so
+// sliding along the buttons stays a button press.
+enum InputButton : uint8_t {
+    INPUT_BUTTON_A,
+    INPUT_BUTTON_B,
+    INPUT_BUTTON_C,
+    INPUT_BUTTON_COUNT
+};
+
+enum InputAction : uint8_t {
+    INPUT_PRESS,
+    INPUT_TAP,
+    INPUT_HOLD,
+    INPUT_SWIPE
+};
+
+// Which way the finger moved
+enum InputSwipe : uint8_t {
+    INPUT_SWIPE_LEFT,
+    INPUT_SWIPE_RIGHT,
+    INPUT_SWIPE_DOWN,
+    INPUT_SWIPE_UP,
+    INPUT_SWIPE_COUNT
+};
+
+struct InputEvent {
+    InputButton button;     // Not for INPUT_SWIPE
+    InputAction action;
+    InputSwipe swipe;       // INPUT_SWIPE only
+};
+
+typedef void (*InputHandler)();
+
+// A screen's handlers, indexed by button or swipe; nullptr ignores the
+// event
+struct ScreenInput {
+    InputHandler press[INPUT_BUTTON_COUNT];
+    InputHandler tap[INPUT_BUTTON_COUNT];
+    InputHandler hold[INPUT_BUTTON_COUNT];
+    InputHandler swipe[INPUT_SWIPE_COUNT];
+};
+
+void inputBegin(uint32_t holdMs);
+
+// Queue a read of the panel if there is reason to; its button changes
+// are queued as it runs. touchInterrupt is whether the touch interrupt
+// woke the loop.
+void inputUpdate(bool touchInterrupt);
+
+// True while a finger is on the panel, or a read of it is still on the
+// bus, so the loop can keep tracking it
+bool inputTouchActive();
+
+// Where a finger is on the display, as of the last read; false if none
+// is (touches on the button strip below the display do not count)
+bool inputTouchPoint(int16_t& x, int16_t& y);
+
+// Take the oldest queued event. Returns false if there is none.
+bool inputNext(InputEvent& event);
+
+// Hand every queued event to a screen's handlers
+void inputDispatch(const ScreenInput& screen);
+
+// Drop queued events (e.g. when the screen changes under them)
+void inputClear();
+
+// Events lost to a full queue since boot
+uint32_t inputDropped();
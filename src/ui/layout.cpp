@@ -0,0 +1,291 @@
+#include "layout.h"
+#include "../vesc/crc.h"
+#include "../vesc/values.h"
+#include "../telemetry/units.h"
+
+#include <string.h>
+
+// The counters the energy estimate is folded from
+static const uint32_t ENERGY_FIELDS = VALUES_FIELD_WATT_HOURS | VALUES_FIELD_WATT_HOURS_CHARGED |
+                                      VALUES_FIELD_TACHOMETER_ABS;
+
+static const int16_t SCREEN_WIDTH = 320;
+static const int16_t SCREEN_HEIGHT = 240;
+
+// RGB565 colors of the built-in layout
+static const uint16_t COLOR_WHITE = 0xFFFF;
+static const uint16_t COLOR_GREEN = 0x07E0;
+static const uint16_t COLOR_CYAN = 0x07FF;
+static const uint16_t COLOR_YELLOW = 0xFFE0;
+static const uint16_t COLOR_ORANGE = 0xFDA0;
+
+uint8_t Layout::firstWidget(uint8_t page) const {
+    uint8_t first = 0;
+    for (uint8_t i = 0; i < page && i < pageCount; i++) {
+        first += pages[i].widgetCount;
+    }
+    return first;
+}
+
+const char* Layout::label(uint16_t offset) const {
+    return offset < labelBytes ? labels + offset : "";
+}
+
+uint32_t layoutQuantityFields(LayoutQuantity quantity) {
+    if (layoutIsField(quantity)) return 1u << layoutFieldBit(quantity);
+    switch (quantity) {
+        case LAYOUT_Q_V_IN:          return VALUES_FIELD_V_IN;
+        case LAYOUT_Q_CURRENT_IN:    return VALUES_FIELD_CURRENT_IN;
+        case LAYOUT_Q_CURRENT_MOTOR: return VALUES_FIELD_CURRENT_MOTOR;
+        case LAYOUT_Q_POWER:         return VALUES_FIELD_V_IN | VALUES_FIELD_CURRENT_IN;
+        case LAYOUT_Q_DUTY:          return VALUES_FIELD_DUTY;
+        case LAYOUT_Q_RPM:           return VALUES_FIELD_RPM;
+        case LAYOUT_Q_TEMP_FET:      return VALUES_FIELD_TEMP_FET;
+        case LAYOUT_Q_TEMP_MOTOR:    return VALUES_FIELD_TEMP_MOTOR;
+        case LAYOUT_Q_RANGE:         return ENERGY_FIELDS | VALUES_FIELD_V_IN | VALUES_FIELD_CURRENT_IN;
+        case LAYOUT_Q_WH_PER_KM:
+        case LAYOUT_Q_TRIP_DISTANCE:
+        case LAYOUT_Q_TRIP_ENERGY:   return ENERGY_FIELDS;
+        case LAYOUT_Q_SOC:           return VALUES_FIELD_V_IN | VALUES_FIELD_CURRENT_IN;
+        case LAYOUT_Q_SPEED:         return VALUES_FIELD_RPM;
+        case LAYOUT_Q_DISTANCE:      return VALUES_FIELD_TACHOMETER_ABS;
+        case LAYOUT_Q_GPS_SPEED:
+        case LAYOUT_Q_PITCH:
+        case LAYOUT_Q_ACCEL:         return VALUES_FIELD_V_IN;    // Rides along with the fastest group
+        case LAYOUT_Q_EFFICIENCY:    return VALUES_FIELD_V_IN | VALUES_FIELD_CURRENT_IN | VALUES_FIELD_RPM;
+        case LAYOUT_Q_DERATE:        return VALUES_FIELD_TEMP_FET | VALUES_FIELD_TEMP_MOTOR | VALUES_FIELD_CURRENT_MOTOR;
+        default:                     return 0;
+    }
+}
+
+UnitKind layoutQuantityUnitKind(LayoutQuantity quantity) {
+    if (layoutIsField(quantity)) {
+        const char* unit = VALUES_FIELD_INFO[layoutFieldBit(quantity)].unit;
+        return strcmp(unit, "°C") == 0 ? UNIT_TEMPERATURE : UNIT_NONE;
+    }
+    switch (quantity) {
+        case LAYOUT_Q_TEMP_FET:
+        case LAYOUT_Q_TEMP_MOTOR:    return UNIT_TEMPERATURE;
+        case LAYOUT_Q_RANGE:
+        case LAYOUT_Q_TRIP_DISTANCE:
+        case LAYOUT_Q_DISTANCE:      return UNIT_DISTANCE;
+        case LAYOUT_Q_SPEED:
+        case LAYOUT_Q_GPS_SPEED:     return UNIT_SPEED;
+        case LAYOUT_Q_WH_PER_KM:
+        case LAYOUT_Q_EFFICIENCY:    return UNIT_PER_DISTANCE;
+        default:                     return UNIT_NONE;
+    }
+}
+
+const char* layoutQuantityUnit(LayoutQuantity quantity, uint8_t flags) {
+    UnitKind kind = layoutQuantityUnitKind(quantity);
+    if (kind == UNIT_TEMPERATURE && (flags & LAYOUT_FAHRENHEIT)) return unitsNameIn(kind, true);
+    if (kind != UNIT_NONE) return unitsName(kind);
+    if (layoutIsField(quantity)) return VALUES_FIELD_INFO[layoutFieldBit(quantity)].unit;
+    switch (quantity) {
+        case LAYOUT_Q_V_IN:          return "V";
+        case LAYOUT_Q_CURRENT_IN:
+        case LAYOUT_Q_CURRENT_MOTOR: return "A";
+        case LAYOUT_Q_POWER:         return "W";
+        case LAYOUT_Q_DUTY:
+        case LAYOUT_Q_M5_BATTERY:
+        case LAYOUT_Q_SOC:           return "%";
+        case LAYOUT_Q_TRIP_ENERGY:   return "Wh";
+        case LAYOUT_Q_DERATE:        return "s";
+        case LAYOUT_Q_PITCH:         return "deg";
+        case LAYOUT_Q_ACCEL:         return "g";
+        default:                     return "";
+    }
+}
+
+uint32_t layoutPageFields(const Layout& layout, uint8_t page) {
+    if (page >= layout.pageCount) return 0;
+    uint32_t fields = 0;
+    uint8_t first = layout.firstWidget(page);
+    for (uint8_t i = first; i < first + layout.pages[page].widgetCount; i++) {
+        fields |= layoutQuantityFields((LayoutQuantity)layout.widgets[i].quantity);
+    }
+    return fields;
+}
+
+// A widget needs a quantity exactly when it shows one, and must lie on
+// the screen
+static bool widgetValid(const LayoutWidgetRecord& widget, uint16_t labelBytes) {
+    if (widget.kind >= LAYOUT_KIND_COUNT) return false;
+    if (layoutIsField(widget.quantity)) {
+        // A field has no history column behind it, so it has no chart or
+        // trip statistics
+        if (widget.kind == LAYOUT_CHART || (widget.flags & LAYOUT_RIDE_STAT)) return false;
+    } else if (widget.quantity >= LAYOUT_Q_COUNT) {
+        return false;
+    }
+    bool showsQuantity = widget.kind == LAYOUT_VALUE || widget.kind == LAYOUT_BIG_VALUE ||
+                         widget.kind == LAYOUT_CHART || widget.kind == LAYOUT_GAUGE;
+    if (showsQuantity != (widget.quantity != LAYOUT_Q_NONE)) return false;
+    if (widget.kind == LAYOUT_GAUGE && widget.param <= 0) return false;
+    // Charts plot the history, which has no columns for the M5 battery or
+    // the quantities worked out on the dashboard
+    if (widget.kind == LAYOUT_CHART && widget.quantity >= LAYOUT_Q_M5_BATTERY) return false;
+    // Trip statistics are kept for the same quantities, and only shown as numbers
+    if ((widget.flags & LAYOUT_RIDE_STAT) &&
+        (widget.kind == LAYOUT_CHART || widget.quantity >= LAYOUT_Q_M5_BATTERY)) return false;
+    if (widget.x < 0 || widget.y < 0 || widget.w <= 0 || widget.h <= 0) return false;
+    if (widget.x + widget.w > SCREEN_WIDTH || widget.y + widget.h > SCREEN_HEIGHT) return false;
+    if (widget.textSize < 1 || widget.textSize > 7) return false;
+    if (widget.align > LAYOUT_ALIGN_RIGHT || widget.decimals > 4) return false;
+    return widget.label == LAYOUT_NO_LABEL || widget.label < labelBytes;
+}
+
+bool layoutParse(const uint8_t* data, size_t length, Layout& out) {
+    LayoutFileHeader header;
+    if (length < sizeof(header)) return false;
+    memcpy(&header, data, sizeof(header));
+    if (header.magic != LAYOUT_MAGIC || header.version != LAYOUT_FORMAT_VERSION) return false;
+    if (header.pageCount == 0 || header.pageCount > Layout::MAX_PAGES) return false;
+    if (header.widgetCount > Layout::MAX_WIDGETS || header.labelBytes > Layout::MAX_LABEL_BYTES) return false;
+
+    size_t pagesBytes = header.pageCount * sizeof(LayoutPageRecord);
+    size_t widgetsBytes = header.widgetCount * sizeof(LayoutWidgetRecord);
+    if (length != sizeof(header) + pagesBytes + widgetsBytes + header.labelBytes) return false;
+    if (crc16(data + sizeof(header), length - sizeof(header)) != header.crc) return false;
+
+    const uint8_t* p = data + sizeof(header);
+    memcpy(out.pages, p, pagesBytes);
+    p += pagesBytes;
+    memcpy(out.widgets, p, widgetsBytes);
+    p += widgetsBytes;
+    memcpy(out.labels, p, header.labelBytes);
+
+    // Every string must end inside the pool
+    if (header.labelBytes > 0 && out.labels[header.labelBytes - 1] != '\0') return false;
+
+    unsigned owned = 0;
+    for (uint8_t i = 0; i < header.pageCount; i++) {
+        if (out.pages[i].widgetCount > Layout::MAX_PAGE_WIDGETS) return false;
+        owned += out.pages[i].widgetCount;
+        uint16_t name = out.pages[i].name;
+        if (name != LAYOUT_NO_LABEL && name >= header.labelBytes) return false;
+    }
+    if (owned != header.widgetCount) return false;
+    for (uint8_t i = 0; i < header.widgetCount; i++) {
+        if (!widgetValid(out.widgets[i], header.labelBytes)) return false;
+    }
+
+    out.pageCount = header.pageCount;
+    out.widgetCount = header.widgetCount;
+    out.labelBytes = header.labelBytes;
+    return true;
+}
+
+// Builders for the built-in layout
+
+static uint16_t addLabel(Layout& out, const char* text) {
+    if (!text) return LAYOUT_NO_LABEL;
+    size_t length = strlen(text) + 1;
+    if (out.labelBytes + length > (size_t)Layout::MAX_LABEL_BYTES) return LAYOUT_NO_LABEL;
+    uint16_t offset = out.labelBytes;
+    memcpy(out.labels + offset, text, length);
+    out.labelBytes += length;
+    return offset;
+}
+
+static void addPage(Layout& out, const char* name) {
+    LayoutPageRecord& page = out.pages[out.pageCount++];
+    page.widgetCount = 0;
+    page.reserved = 0;
+    page.name = addLabel(out, name);
+}
+
+static void addWidget(Layout& out, LayoutWidgetKind kind, LayoutQuantity quantity,
+                      int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color, uint8_t textSize,
+                      uint8_t align, uint8_t decimals, uint8_t flags, int16_t param, const char* label) {
+    LayoutWidgetRecord& widget = out.widgets[out.widgetCount++];
+    widget.kind = kind;
+    widget.quantity = quantity;
+    widget.x = x;
+    widget.y = y;
+    widget.w = w;
+    widget.h = h;
+    widget.color = color;
+    widget.textSize = textSize;
+    widget.align = align;
+    widget.decimals = decimals;
+    widget.flags = flags;
+    widget.param = param;
+    widget.label = addLabel(out, label);
+    out.pages[out.pageCount - 1].widgetCount++;
+}
+
+// One row of the graphs page: a chart, its name and its latest value
+static void addChartRow(Layout& out, LayoutQuantity quantity, int16_t y, uint16_t color,
+                        uint8_t decimals, int16_t minSpan, const char* name) {
+    addWidget(out, LAYOUT_CHART, quantity, 0, y, 256, 48, color, 1, LAYOUT_ALIGN_LEFT, 0, 0, minSpan, nullptr);
+    addWidget(out, LAYOUT_TEXT, LAYOUT_Q_NONE, 262, y + 4, 58, 10, COLOR_WHITE, 1, LAYOUT_ALIGN_LEFT, 0, 0, 0, name);
+    addWidget(out, LAYOUT_VALUE, quantity, 262, y + 22, 58, 16, color, 1, LAYOUT_ALIGN_LEFT, decimals, 0, 0, nullptr);
+}
+
+void layoutDefault(Layout& out) {
+    out.pageCount = 0;
+    out.widgetCount = 0;
+    out.labelBytes = 0;
+
+    addPage(out, "gauges");
+    addWidget(out, LAYOUT_TEXT, LAYOUT_Q_NONE, 10, 10, 120, 8, COLOR_WHITE, 1, LAYOUT_ALIGN_LEFT, 0, 0, 0,
+              "VESC Connected|# VESCs Connected");
+    addWidget(out, LAYOUT_VALUE, LAYOUT_Q_SOC, 0, 36, 320, 30, COLOR_GREEN, 3, LAYOUT_ALIGN_CENTER,
+              1, LAYOUT_CHARGE_COLORS, 10, "Battery ");
+    addWidget(out, LAYOUT_BIG_VALUE, LAYOUT_Q_V_IN, 0, 70, 320, 60, COLOR_GREEN, 6, LAYOUT_ALIGN_CENTER,
+              1, 0, 0, nullptr);
+    addWidget(out, LAYOUT_VALUE, LAYOUT_Q_TEMP_FET, 0, 140, 320, 30, COLOR_YELLOW, 2, LAYOUT_ALIGN_CENTER,
+              1, 0, 1, "FET: ");
+    addWidget(out, LAYOUT_VALUE, LAYOUT_Q_RANGE, 0, 170, 320, 20, COLOR_CYAN, 2, LAYOUT_ALIGN_CENTER,
+              1, 0, 1, "Range: ");
+    addWidget(out, LAYOUT_STATUS, LAYOUT_Q_NONE, 10, 195, 100, 20, COLOR_WHITE, 1, LAYOUT_ALIGN_LEFT,
+              0, 0, 0, nullptr);
+    addWidget(out, LAYOUT_VALUE, LAYOUT_Q_M5_BATTERY, 240, 195, 80, 20, COLOR_GREEN, 1, LAYOUT_ALIGN_LEFT,
+              0, LAYOUT_CHARGE_COLORS, 1, "M5: ");
+    addWidget(out, LAYOUT_TEXT, LAYOUT_Q_NONE, 10, 216, 300, 16, COLOR_WHITE, 1, LAYOUT_ALIGN_LEFT, 0, 0, 0,
+              "A:Disconnect  B:Ride  C:Back");
+
+    addPage(out, "ride");
+    addWidget(out, LAYOUT_VALUE, LAYOUT_Q_CURRENT_IN, 0, 12, 160, 24, COLOR_CYAN, 2, LAYOUT_ALIGN_CENTER,
+              2, LAYOUT_RIDE_MAX, 10, "Max ");
+    addWidget(out, LAYOUT_VALUE, LAYOUT_Q_V_IN, 160, 12, 160, 24, COLOR_GREEN, 2, LAYOUT_ALIGN_CENTER,
+              1, LAYOUT_RIDE_MIN, 1, "Min ");
+    addWidget(out, LAYOUT_BIG_VALUE, LAYOUT_Q_SPEED, 0, 50, 320, 60, COLOR_WHITE, 6, LAYOUT_ALIGN_CENTER,
+              1, 0, 2, nullptr);
+    addWidget(out, LAYOUT_VALUE, LAYOUT_Q_TRIP_DISTANCE, 0, 130, 160, 24, COLOR_CYAN, 2, LAYOUT_ALIGN_CENTER,
+              2, 0, 1, "Trip ");
+    addWidget(out, LAYOUT_VALUE, LAYOUT_Q_WH_PER_KM, 160, 130, 160, 24, COLOR_ORANGE, 2, LAYOUT_ALIGN_CENTER,
+              1, 0, 1, nullptr);
+    addWidget(out, LAYOUT_VALUE, LAYOUT_Q_RANGE, 0, 160, 160, 24, COLOR_CYAN, 2, LAYOUT_ALIGN_CENTER,
+              1, 0, 1, "Range ");
+    addWidget(out, LAYOUT_VALUE, LAYOUT_Q_SOC, 160, 160, 160, 24, COLOR_GREEN, 2, LAYOUT_ALIGN_CENTER,
+              1, LAYOUT_CHARGE_COLORS, 10, nullptr);
+    addWidget(out, LAYOUT_STATUS, LAYOUT_Q_NONE, 10, 195, 100, 20, COLOR_WHITE, 1, LAYOUT_ALIGN_LEFT,
+              0, 0, 0, nullptr);
+    addWidget(out, LAYOUT_TEXT, LAYOUT_Q_NONE, 10, 216, 300, 16, COLOR_WHITE, 1, LAYOUT_ALIGN_LEFT, 0, 0, 0,
+              "A:Disconnect  B:Graphs  C:Back");
+
+    addPage(out, "graphs");
+    addChartRow(out, LAYOUT_Q_V_IN, 0, COLOR_GREEN, 1, 10, "Voltage");
+    addChartRow(out, LAYOUT_Q_CURRENT_IN, 52, COLOR_CYAN, 2, 500, "Current|Total I");
+    addChartRow(out, LAYOUT_Q_POWER, 104, COLOR_ORANGE, 1, 1000, "Power|Total P");
+    addChartRow(out, LAYOUT_Q_TEMP_FET, 156, COLOR_YELLOW, 1, 20, "FET temp");
+    addWidget(out, LAYOUT_TEXT, LAYOUT_Q_NONE, 10, 216, 300, 16, COLOR_WHITE, 1, LAYOUT_ALIGN_LEFT, 0, 0, 0,
+              "A:Disconnect  B:Dials  C:Back");
+
+    addPage(out, "dials");
+    addWidget(out, LAYOUT_GAUGE, LAYOUT_Q_SPEED, 0, 4, 160, 140, COLOR_WHITE, 1, LAYOUT_ALIGN_CENTER,
+              1, 0, 600, "Speed");
+    addWidget(out, LAYOUT_GAUGE, LAYOUT_Q_CURRENT_IN, 160, 4, 160, 140, COLOR_CYAN, 1, LAYOUT_ALIGN_CENTER,
+              2, 0, 10000, "Current");
+    addWidget(out, LAYOUT_VALUE, LAYOUT_Q_SPEED, 0, 150, 160, 30, COLOR_WHITE, 3, LAYOUT_ALIGN_CENTER,
+              1, 0, 2, nullptr);
+    addWidget(out, LAYOUT_VALUE, LAYOUT_Q_CURRENT_IN, 160, 150, 160, 30, COLOR_CYAN, 3, LAYOUT_ALIGN_CENTER,
+              1, 0, 10, nullptr);
+    addWidget(out, LAYOUT_STATUS, LAYOUT_Q_NONE, 10, 195, 100, 20, COLOR_WHITE, 1, LAYOUT_ALIGN_LEFT,
+              0, 0, 0, nullptr);
+    addWidget(out, LAYOUT_TEXT, LAYOUT_Q_NONE, 10, 216, 300, 16, COLOR_WHITE, 1, LAYOUT_ALIGN_LEFT, 0, 0, 0,
+              "A:Disconnect  B:Gauges  C:Back");
+}
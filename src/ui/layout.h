@@ -0,0 +1,62 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include "layout_format.h"
+#include "../telemetry/units.h"
+#include "../vesc/values.h"
+
+// A dashboard layout, parsed once at boot into flat arrays: the pages,
+// every page's widgets back to back, and the label strings. Nothing here
+// touches the display, so a layout can be checked off the device.
+struct Layout {
+    static const int MAX_PAGES = 6;
+    static const int MAX_WIDGETS = 48;
+    static const int MAX_PAGE_WIDGETS = 16;   // At most Compositor::MAX_WIDGETS
+    static const int MAX_LABEL_BYTES = 512;
+
+    uint8_t pageCount;
+    uint8_t widgetCount;
+    LayoutPageRecord pages[MAX_PAGES];
+    LayoutWidgetRecord widgets[MAX_WIDGETS];
+    char labels[MAX_LABEL_BYTES];
+    uint16_t labelBytes;
+
+    // Index of a page's first widget
+    uint8_t firstWidget(uint8_t page) const;
+
+    // A label string, "" for LAYOUT_NO_LABEL
+    const char* label(uint16_t offset) const;
+};
+
+// Parse and validate a layout file. Returns false, leaving out
+// unspecified, if the file is damaged or does not fit the limits above.
+bool layoutParse(const uint8_t* data, size_t length, Layout& out);
+
+// The built-in layout: the gauges, ride, graphs and dials pages
+void layoutDefault(Layout& out);
+
+// A quantity bound straight to a decoded field, and that field's
+// VALUES_BIT_*
+inline bool layoutIsField(uint8_t quantity) {
+    return quantity >= LAYOUT_Q_FIELD && quantity < LAYOUT_Q_FIELD + VALUES_FIELD_COUNT;
+}
+
+inline uint8_t layoutFieldBit(uint8_t quantity) {
+    return quantity - LAYOUT_Q_FIELD;
+}
+
+// COMM_GET_VALUES_SELECTIVE fields the widgets of a page show
+uint32_t layoutPageFields(const Layout& layout, uint8_t page);
+
+// VALUES_FIELD_* a quantity is decoded from (0 for the M5's own battery)
+uint32_t layoutQuantityFields(LayoutQuantity quantity);
+
+// Kind of unit a quantity is converted to for showing; UNIT_NONE for the
+// ones printed as they are kept (volts, amps, watts, percent)
+UnitKind layoutQuantityUnitKind(LayoutQuantity quantity);
+
+// Unit printed after a quantity ("V", "A", "°C"). Convertible ones are
+// the chosen unit's name (see telemetry/units.h), so the text follows a
+// change of units.
+const char* layoutQuantityUnit(LayoutQuantity quantity, uint8_t flags);
@@ -0,0 +1,121 @@
+#pragma once
+
+#include <stdint.h>
+
+// Dashboard layout file format (/layout.bin on the SD card or SPIFFS).
+//
+// A file is a LayoutFileHeader, pageCount LayoutPageRecords, widgetCount
+// LayoutWidgetRecords and labelBytes of NUL-terminated strings. All
+// fields are little-endian. The CRC is the VESC CRC16 of everything
+// after the header.
+//
+// Widgets belong to pages in file order: the first page owns the first
+// widgetCount of its record, and so on, so the page counts must add up
+// to the header's widgetCount. Strings are referenced by their byte
+// offset in the label pool, LAYOUT_NO_LABEL for none. A value's label
+// is its prefix. A text label of the form "one|several" shows the part
+// after the bar when more than one controller is polled, with '#'
+// replaced by the controller count.
+//
+// Coordinates are screen pixels (320x240), colors RGB565.
+
+static const uint32_t LAYOUT_MAGIC = 0x594C4456;      // "VDLY"
+static const uint16_t LAYOUT_FORMAT_VERSION = 1;
+static const uint16_t LAYOUT_NO_LABEL = 0xFFFF;
+
+enum LayoutWidgetKind : uint8_t {
+    LAYOUT_TEXT,        // The label, fixed
+    LAYOUT_VALUE,       // Quantity as text: label prefix, number, unit
+    LAYOUT_BIG_VALUE,   // Quantity from a glyph cache (digits, '.', '-' and the unit)
+    LAYOUT_CHART,       // Strip chart of the quantity's history; param is the smallest span
+    LAYOUT_STATUS,      // Age of the latest sample
+    LAYOUT_GAUGE,       // Dial of the quantity from 0 to param, in the number's scaled units
+    LAYOUT_KIND_COUNT
+};
+
+// Displayed quantities, in the units the number is scaled by. Speeds,
+// distances, consumption and temperatures are shown in the units chosen
+// in the settings (mph, mi, Wh/mi, °F), at the same scale.
+enum LayoutQuantity : uint8_t {
+    LAYOUT_Q_NONE,
+    LAYOUT_Q_V_IN,           // 0.1 V
+    LAYOUT_Q_CURRENT_IN,     // 0.01 A
+    LAYOUT_Q_CURRENT_MOTOR,  // 0.01 A
+    LAYOUT_Q_POWER,          // 0.1 W
+    LAYOUT_Q_DUTY,           // 0.1 %
+    LAYOUT_Q_RPM,            // ERPM
+    LAYOUT_Q_TEMP_FET,       // 0.1 °C (0.1 °F with LAYOUT_FAHRENHEIT)
+    LAYOUT_Q_TEMP_MOTOR,     // 0.1 °C (0.1 °F with LAYOUT_FAHRENHEIT)
+    LAYOUT_Q_M5_BATTERY,     // percent, the M5Stack's own battery
+    LAYOUT_Q_RANGE,          // 0.1 km left at the recent consumption
+    LAYOUT_Q_WH_PER_KM,      // 0.1 Wh/km, recent
+    LAYOUT_Q_TRIP_DISTANCE,  // 0.01 km since power-on
+    LAYOUT_Q_TRIP_ENERGY,    // 0.1 Wh since power-on, net of regen
+    LAYOUT_Q_SOC,            // 0.1 %, the pack's state of charge
+    LAYOUT_Q_SPEED,          // 0.1 km/h, from the ERPM
+    LAYOUT_Q_DISTANCE,       // 0.01 km, the VESC's tachometer since it powered up
+    LAYOUT_Q_GPS_SPEED,      // 0.1 km/h, from the GPS; 0 without a fix
+    LAYOUT_Q_EFFICIENCY,     // 0.1 Wh/km right now; 0 below walking pace
+    LAYOUT_Q_DERATE,         // s until thermal derating at the recent load, up to 999 (not in sight)
+    LAYOUT_Q_FORMULA1,       // The first formula (telemetry/formula.h), at the widget's decimals; no unit
+    LAYOUT_Q_FORMULA2,       // The second
+    LAYOUT_Q_PITCH,          // 0.1 degree nose up, from the IMU; 0 without one
+    LAYOUT_Q_ACCEL,          // 0.01 g forward, gravity taken out; 0 without an IMU
+    LAYOUT_Q_COUNT
+};
+
+// Quantities from LAYOUT_Q_FIELD on are decoded fields taken straight
+// from their row in VALUES_FIELD_INFO (src/vesc/values.h):
+// LAYOUT_Q_FIELD + VALUES_BIT_*, e.g. LAYOUT_Q_FIELD + VALUES_BIT_VQ. The
+// value is the field's first element rescaled from the row's decimals to
+// the widget's, and the unit is the row's; temperatures follow the units
+// setting. Such a widget is a value, big value or dial.
+static const uint8_t LAYOUT_Q_FIELD = 0x80;
+
+// LayoutWidgetRecord align, in TextAlign order
+static const uint8_t LAYOUT_ALIGN_LEFT = 0;
+static const uint8_t LAYOUT_ALIGN_CENTER = 1;
+static const uint8_t LAYOUT_ALIGN_RIGHT = 2;
+
+// LayoutWidgetRecord flags
+static const uint8_t LAYOUT_FAHRENHEIT = 0x01;      // Temperatures in °F whatever the units setting
+static const uint8_t LAYOUT_CHARGE_COLORS = 0x02;   // Green, yellow, red by level instead of the color
+static const uint8_t LAYOUT_RIDE_STAT = 0x0C;       // Mask: a value shows the trip's...
+static const uint8_t LAYOUT_RIDE_MIN = 0x04;        // ...lowest,
+static const uint8_t LAYOUT_RIDE_MAX = 0x08;        // ...highest,
+static const uint8_t LAYOUT_RIDE_MEAN = 0x0C;       // ...or average of a history quantity
+
+struct __attribute__((packed)) LayoutFileHeader {
+    uint32_t magic;             // LAYOUT_MAGIC
+    uint16_t version;           // LAYOUT_FORMAT_VERSION
+    uint8_t pageCount;
+    uint8_t widgetCount;
+    uint16_t labelBytes;
+    uint16_t crc;               // CRC16 of the rest of the file
+};
+
+struct __attribute__((packed)) LayoutPageRecord {
+    uint8_t widgetCount;
+    uint8_t reserved;
+    uint16_t name;              // Label offset; shown in logs
+};
+
+struct __attribute__((packed)) LayoutWidgetRecord {
+    uint8_t kind;               // LayoutWidgetKind
+    uint8_t quantity;           // LayoutQuantity
+    int16_t x;
+    int16_t y;
+    int16_t w;
+    int16_t h;
+    uint16_t color;
+    uint8_t textSize;           // 1-7
+    uint8_t align;              // LAYOUT_ALIGN_*
+    uint8_t decimals;           // Of the scaled value shown
+    uint8_t flags;              // LAYOUT_FAHRENHEIT, LAYOUT_CHARGE_COLORS, LAYOUT_RIDE_*
+    int16_t param;              // Repaint threshold, a chart's smallest span or a gauge's full scale
+    uint16_t label;             // Label offset
+};
+
+static_assert(sizeof(LayoutFileHeader) == 12, "layout header is 12 bytes on disk");
+static_assert(sizeof(LayoutPageRecord) == 4, "layout page record is 4 bytes on disk");
+static_assert(sizeof(LayoutWidgetRecord) == 20, "layout widget record is 20 bytes on disk");
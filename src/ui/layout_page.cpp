@@ -0,0 +1,348 @@
+#include "layout_page.h"
+#include "widgets.h"
+#include "strip_chart.h"
+#include "gauge.h"
+#include "value_font.h"
+#include "../telemetry/fixed_point.h"
+#include "../log.h"
+
+#include <string.h>
+
+// The compared lap's dots under a chart's trace
+static const uint16_t LAYOUT_REFERENCE_COLOR = LIGHTGREY;
+static const uint16_t LAYOUT_STALE_COLOR = DARKGREY;    // A value or needle the link has not kept up with
+static const int16_t LAYOUT_DERATE_MAX_S = 999;     // Shown while derating is not in sight
+
+static_assert(LAYOUT_ALIGN_LEFT == ALIGN_LEFT && LAYOUT_ALIGN_CENTER == ALIGN_CENTER &&
+              LAYOUT_ALIGN_RIGHT == ALIGN_RIGHT, "layout alignment must match TextAlign");
+static_assert(Layout::MAX_PAGE_WIDGETS <= Compositor::MAX_WIDGETS, "a page must fit one compositor");
+static_assert(Layout::MAX_PAGE_WIDGETS <= 16, "a page's widgets must fit a uint16_t mask");
+
+// Glyphs of a big value: digits, sign, point and the unit, in both unit
+// systems for a quantity that can be converted, so a change of units
+// finds its glyphs cached
+static const char* bigValueCharset(const char* unit, UnitKind kind) {
+    static const char DIGITS[] = "0123456789.-";
+    char* charset = new char[GlyphCache::MAX_GLYPHS + 1];
+    size_t length = 0;
+    const char* parts[] = { DIGITS, unit, unitsNameIn(kind, false), unitsNameIn(kind, true) };
+    for (const char* part : parts) {
+        for (const char* c = part; *c && length < (size_t)GlyphCache::MAX_GLYPHS; c++) {
+            if (!memchr(charset, *c, length)) charset[length++] = *c;
+        }
+    }
+    charset[length] = '\0';
+    return charset;
+}
+
+// The smooth font drawn at a text size's line height, nullptr for none
+static const uint8_t* valueFont(uint8_t textSize) {
+    for (size_t i = 0; i < sizeof(VALUE_FONTS) / sizeof(VALUE_FONTS[0]); i++) {
+        if (VALUE_FONTS[i].size == 8 * textSize) return VALUE_FONTS[i].vlw;
+    }
+    return nullptr;
+}
+
+static HistoryField historyField(LayoutQuantity quantity) {
+    switch (quantity) {
+        case LAYOUT_Q_CURRENT_IN:    return HISTORY_CURRENT_IN;
+        case LAYOUT_Q_CURRENT_MOTOR: return HISTORY_CURRENT_MOTOR;
+        case LAYOUT_Q_POWER:         return HISTORY_POWER;
+        case LAYOUT_Q_DUTY:          return HISTORY_DUTY;
+        case LAYOUT_Q_RPM:           return HISTORY_RPM;
+        case LAYOUT_Q_TEMP_FET:      return HISTORY_TEMP_FET;
+        case LAYOUT_Q_TEMP_MOTOR:    return HISTORY_TEMP_MOTOR;
+        case LAYOUT_Q_GPS_SPEED:     return HISTORY_GPS_SPEED;
+        default:                     return HISTORY_V_IN;
+    }
+}
+
+// The trip's lowest, highest or average of a history quantity
+static int32_t rideValue(const LayoutWidgetRecord& record, const LayoutSample& sample) {
+    const RideFieldStats& stats = sample.ride->fields[historyField((LayoutQuantity)record.quantity)];
+    switch (record.flags & LAYOUT_RIDE_STAT) {
+        case LAYOUT_RIDE_MIN: return stats.min;
+        case LAYOUT_RIDE_MAX: return stats.max;
+        default:              return stats.average();
+    }
+}
+
+// A quantity in the scaled units printed for it: worked out in metric
+// units, then converted to the chosen ones
+static int32_t quantityValue(const LayoutWidgetRecord& record, const LayoutSample& sample) {
+    const VescValues& values = *sample.values;
+    DerivedValues& derived = *sample.derived;
+    LayoutQuantity quantity = (LayoutQuantity)record.quantity;
+    bool fahrenheit = (record.flags & LAYOUT_FAHRENHEIT) != 0;
+    int32_t value = 0;
+    if (layoutIsField(quantity)) {
+        // Converted at the row's own decimals, which the °F offset needs
+        uint8_t bit = layoutFieldBit(quantity);
+        value = valuesField(values, bit);
+        UnitKind kind = layoutQuantityUnitKind(quantity);
+        value = kind == UNIT_TEMPERATURE && fahrenheit ? deciCelsiusToDeciFahrenheit(value)
+                                                       : unitsConvert(kind, value);
+        return fixedRescale(value, VALUES_FIELD_INFO[bit].decimals, record.decimals);
+    }
+    if (record.flags & LAYOUT_RIDE_STAT) {
+        value = rideValue(record, sample);
+    } else {
+        switch (quantity) {
+            case LAYOUT_Q_V_IN:          return values.vIn;
+            case LAYOUT_Q_CURRENT_IN:    return values.currentIn;
+            case LAYOUT_Q_CURRENT_MOTOR: return values.currentMotor;
+            case LAYOUT_Q_POWER:         return derived.get(DERIVED_POWER);
+            case LAYOUT_Q_DUTY:          return values.dutyNow;
+            case LAYOUT_Q_RPM:           return values.rpm;
+            case LAYOUT_Q_TEMP_FET:
+                if (fahrenheit) return derived.get(DERIVED_TEMP_FET_F);
+                value = values.tempFet;
+                break;
+            case LAYOUT_Q_TEMP_MOTOR:
+                if (fahrenheit) return derived.get(DERIVED_TEMP_MOTOR_F);
+                value = values.tempMotor;
+                break;
+            case LAYOUT_Q_M5_BATTERY:    return sample.batteryLevel;
+            case LAYOUT_Q_RANGE:         value = sample.energy->range; break;
+            case LAYOUT_Q_WH_PER_KM:     value = sample.energy->recentWhPerKm; break;
+            case LAYOUT_Q_TRIP_DISTANCE: value = sample.energy->tripDistance; break;
+            case LAYOUT_Q_TRIP_ENERGY:   return sample.energy->tripEnergy;
+            case LAYOUT_Q_SOC:           return values.soc;
+            case LAYOUT_Q_SPEED:         value = derived.get(DERIVED_SPEED); break;
+            case LAYOUT_Q_DISTANCE:      value = derived.get(DERIVED_DISTANCE); break;
+            case LAYOUT_Q_EFFICIENCY:    value = derived.get(DERIVED_EFFICIENCY); break;
+            case LAYOUT_Q_GPS_SPEED:     value = (values.fields & VALUES_FIELD_GPS) ? values.gpsSpeed : 0; break;
+            case LAYOUT_Q_DERATE:        return values.derateSeconds < LAYOUT_DERATE_MAX_S ? values.derateSeconds
+                                                                                          : LAYOUT_DERATE_MAX_S;
+            case LAYOUT_Q_FORMULA1:
+            case LAYOUT_Q_FORMULA2:
+                return fixedRescale(values.formula[quantity - LAYOUT_Q_FORMULA1], VALUES_FORMULA_DECIMALS,
+                                    record.decimals);
+            case LAYOUT_Q_PITCH:         return (values.fields & VALUES_FIELD_IMU) ? values.imuPitch : 0;
+            case LAYOUT_Q_ACCEL:         return (values.fields & VALUES_FIELD_IMU) ? values.imuAccel : 0;
+            default:                     return 0;
+        }
+    }
+    UnitKind kind = layoutQuantityUnitKind(quantity);
+    // The trip's temperatures are kept in °C too
+    if (kind == UNIT_TEMPERATURE && fahrenheit) return deciCelsiusToDeciFahrenheit(value);
+    return unitsConvert(kind, value);
+}
+
+// Fields a widget's value follows, 0 if it can change without any of
+// them moving (trip figures, the state of charge, the M5's battery)
+static uint32_t followedFields(const LayoutWidgetRecord& record) {
+    if (record.flags & LAYOUT_RIDE_STAT) return 0;
+    if (layoutIsField(record.quantity)) return layoutQuantityFields((LayoutQuantity)record.quantity);
+    switch ((LayoutQuantity)record.quantity) {
+        case LAYOUT_Q_V_IN:
+        case LAYOUT_Q_CURRENT_IN:
+        case LAYOUT_Q_CURRENT_MOTOR:
+        case LAYOUT_Q_POWER:
+        case LAYOUT_Q_DUTY:
+        case LAYOUT_Q_RPM:
+        case LAYOUT_Q_TEMP_FET:
+        case LAYOUT_Q_TEMP_MOTOR:
+        case LAYOUT_Q_SPEED:
+        case LAYOUT_Q_DISTANCE:
+        case LAYOUT_Q_EFFICIENCY:
+        case LAYOUT_Q_DERATE:
+            return layoutQuantityFields((LayoutQuantity)record.quantity);
+        default:
+            return 0;
+    }
+}
+
+static uint16_t chargeColor(int level) {
+    if (level > 60) return GREEN;
+    if (level > 20) return YELLOW;
+    return RED;
+}
+
+LayoutPageView::LayoutPageView()
+    : layout(nullptr), first(0), count(0), everyFrame(0), staleWidgets(0), shownControllers(0) {
+    memset(fieldWidgets, 0, sizeof(fieldWidgets));
+}
+
+// Which widgets each field moves, so an update visits only those bound
+// to a field that changed, and the ones that need every frame
+void LayoutPageView::bindFields() {
+    memset(fieldWidgets, 0, sizeof(fieldWidgets));
+    everyFrame = 0;
+    for (uint8_t i = 0; i < count; i++) {
+        const LayoutWidgetRecord& r = layout->widgets[first + i];
+        uint16_t mask = 1u << i;
+        if (r.kind == LAYOUT_CHART || r.kind == LAYOUT_STATUS) {
+            everyFrame |= mask;
+            continue;
+        }
+        if (r.kind == LAYOUT_TEXT) continue;
+        uint32_t followed = followedFields(r);
+        if (followed == 0) everyFrame |= mask;
+        for (uint8_t bit = 0; bit < VALUES_FIELD_COUNT; bit++) {
+            if (followed & (1u << bit)) fieldWidgets[bit] |= mask;
+        }
+    }
+}
+
+bool LayoutPageView::build(DisplayGfx* display, const Layout& source, uint8_t page) {
+    if (page >= source.pageCount) return false;
+    layout = &source;
+    first = source.firstWidget(page);
+    count = source.pages[page].widgetCount;
+
+    for (uint8_t i = 0; i < count; i++) {
+        const LayoutWidgetRecord& r = source.widgets[first + i];
+        LayoutQuantity quantity = (LayoutQuantity)r.quantity;
+        const char* label = source.label(r.label);
+        TextAlign align = (TextAlign)r.align;
+        Widget* widget = nullptr;
+        switch (r.kind) {
+            case LAYOUT_VALUE:
+                widget = new ValueWidget(display, r.x, r.y, r.w, r.h, r.textSize, align, r.param,
+                                         r.decimals, label, layoutQuantityUnit(quantity, r.flags));
+                break;
+            case LAYOUT_BIG_VALUE: {
+                const char* unit = layoutQuantityUnit(quantity, r.flags);
+                GlyphCache* glyphs = new GlyphCache(bigValueCharset(unit, layoutQuantityUnitKind(quantity)),
+                                                    r.textSize, r.color, BLACK, valueFont(r.textSize));
+                widget = new GlyphValueWidget(display, r.x, r.y, r.w, r.h, *glyphs, r.param,
+                                              r.decimals, label, unit);
+                break;
+            }
+            case LAYOUT_CHART:
+                widget = new StripChartWidget(display, r.x, r.y, r.w, r.h, historyField(quantity),
+                                              r.color, r.param);
+                break;
+            case LAYOUT_GAUGE:
+                widget = new GaugeWidget(display, r.x, r.y, r.w, r.h, r.color, r.param, r.decimals,
+                                         label, layoutQuantityUnit(quantity, r.flags));
+                break;
+            default:
+                widget = new TextWidget(display, r.x, r.y, r.w, r.h, r.textSize, align);
+                break;
+        }
+        items[i] = widget;
+        widgets.add(widget);
+    }
+    widgets.begin();
+    bindFields();
+    // The labels as most vehicles show them, so a page painted ahead of
+    // its first showing has them
+    showLabels(1);
+
+    for (uint8_t i = 0; i < count; i++) {
+        const LayoutWidgetRecord& r = source.widgets[first + i];
+        if (r.kind == LAYOUT_VALUE || r.kind == LAYOUT_BIG_VALUE) {
+            static_cast<ValueWidget*>(items[i])->setColor(r.color);
+        }
+    }
+    LOG_I(UI, "Layout page \"%s\": %d widgets", source.label(source.pages[page].name), count);
+    return true;
+}
+
+void LayoutPageView::unitsChanged() {
+    for (uint8_t i = 0; i < count; i++) {
+        const LayoutWidgetRecord& r = layout->widgets[first + i];
+        if (layoutQuantityUnitKind((LayoutQuantity)r.quantity) == UNIT_NONE) continue;
+        if (r.kind == LAYOUT_VALUE || r.kind == LAYOUT_BIG_VALUE) {
+            static_cast<ValueWidget*>(items[i])->reformat();
+        } else if (r.kind == LAYOUT_GAUGE) {
+            static_cast<GaugeWidget*>(items[i])->redrawFace();
+        }
+    }
+}
+
+// Text labels, in their one-controller or several-controller form
+void LayoutPageView::showLabels(uint8_t controllers) {
+    shownControllers = controllers;
+    for (uint8_t i = 0; i < count; i++) {
+        const LayoutWidgetRecord& r = layout->widgets[first + i];
+        if (r.kind != LAYOUT_TEXT) continue;
+
+        const char* label = layout->label(r.label);
+        const char* bar = strchr(label, '|');
+        char text[TextWidget::MAX_TEXT];
+        size_t length = 0;
+        if (!bar) {
+            length = strlen(label);
+        } else if (controllers > 1) {
+            label = bar + 1;
+            length = strlen(label);
+        } else {
+            length = bar - label;
+        }
+        if (length >= sizeof(text)) length = sizeof(text) - 1;
+        size_t out = 0;
+        for (size_t c = 0; c < length && out < sizeof(text) - 1; c++) {
+            if (label[c] == '#') {
+                out += snprintf(text + out, sizeof(text) - out, "%d", controllers);
+                if (out >= sizeof(text)) out = sizeof(text) - 1;
+            } else {
+                text[out++] = label[c];
+            }
+        }
+        text[out] = '\0';
+        static_cast<TextWidget*>(items[i])->setText(text, r.color);
+    }
+}
+
+void LayoutPageView::update(const LayoutSample& sample) {
+    if (!layout) return;
+    if (sample.controllers != shownControllers) showLabels(sample.controllers);
+
+    uint16_t stale = 0;
+    for (uint32_t fields = sample.stale & VALUES_ALL_FIELDS; fields; fields &= fields - 1) {
+        stale |= fieldWidgets[__builtin_ctz(fields)];
+    }
+    uint16_t due = everyFrame | (stale ^ staleWidgets);
+    staleWidgets = stale;
+    for (uint32_t changed = sample.changed & VALUES_ALL_FIELDS; changed; changed &= changed - 1) {
+        due |= fieldWidgets[__builtin_ctz(changed)];
+    }
+    for (; due; due &= due - 1) {
+        uint8_t i = __builtin_ctz(due);
+        const LayoutWidgetRecord& r = layout->widgets[first + i];
+        bool greyed = stale & (1u << i);
+        switch (r.kind) {
+            case LAYOUT_VALUE: {
+                ValueWidget* widget = static_cast<ValueWidget*>(items[i]);
+                int32_t value = quantityValue(r, sample);
+                if (greyed) {
+                    widget->setColor(LAYOUT_STALE_COLOR);
+                } else if (r.flags & LAYOUT_CHARGE_COLORS) {
+                    widget->setColor(chargeColor(fixedRescale(value, r.decimals, 0)));
+                } else {
+                    widget->setColor(r.color);
+                }
+                widget->setValue(value);
+                break;
+            }
+            case LAYOUT_BIG_VALUE: {
+                GlyphValueWidget* widget = static_cast<GlyphValueWidget*>(items[i]);
+                int32_t value = quantityValue(r, sample);
+                if (r.flags & LAYOUT_CHARGE_COLORS) widget->setColor(chargeColor(fixedRescale(value, r.decimals, 0)));
+                widget->setStale(greyed);
+                widget->setValue(value);
+                break;
+            }
+            case LAYOUT_CHART: {
+                StripChartWidget* chart = static_cast<StripChartWidget*>(items[i]);
+                chart->setReference(sample.reference, LAYOUT_REFERENCE_COLOR);
+                chart->update(*sample.history);
+                break;
+            }
+            case LAYOUT_GAUGE: {
+                GaugeWidget* gauge = static_cast<GaugeWidget*>(items[i]);
+                gauge->setNeedleColor(greyed ? LAYOUT_STALE_COLOR : r.color);
+                gauge->setValue(quantityValue(r, sample));
+                break;
+            }
+            case LAYOUT_STATUS:
+                static_cast<TextWidget*>(items[i])->setText(sample.status, sample.statusColor);
+                break;
+            default:
+                break;
+        }
+    }
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "display.h"
+#include "layout.h"
+#include "widget.h"
+#include "strip_chart.h"
+#include "../vesc/values.h"
+#include "../telemetry/history.h"
+#include "../telemetry/energy.h"
+#include "../telemetry/drivetrain.h"
+#include "../telemetry/ride_stats.h"
+#include "../telemetry/derived.h"
+
+// What a layout page shows, gathered by the caller once per frame
+struct LayoutSample {
+    const VescValues* values;           // Latest combined telemetry
+    DerivedValues* derived;             // Worked out from it on demand, set to the same sample
+    uint32_t changed;                   // VALUES_FIELD_* that moved since the last update
+    const TelemetryHistory* history;    // For the charts
+    const EnergyEstimate* energy;       // Range and consumption
+    const RideStats* ride;              // Trip minimum, maximum and average
+    int batteryLevel;                   // M5Stack battery, percent
+    uint8_t controllers;                // Controllers polled
+    const char* status;                 // Data age text and its color
+    uint16_t statusColor;
+    ChartReference reference;           // Drawn under the charts, count 0 for none
+    uint32_t stale;                     // VALUES_FIELD_* overdue from a busy link, drawn greyed
+};
+
+// The widgets of one layout page, created once at boot from its records
+// and added to their own compositor
+class LayoutPageView {
+public:
+    LayoutPageView();
+
+    // Create the page's widgets. Returns false if the page is out of range.
+    bool build(DisplayGfx* display, const Layout& layout, uint8_t page);
+
+    Compositor& compositor() { return widgets; }
+
+    // Feed the widgets their values; each repaints only if it changed.
+    // Only widgets bound to a field in sample.changed are visited, with
+    // the charts, the data age and values that follow no field, and
+    // those whose fields went stale or fresh again.
+    void update(const LayoutSample& sample);
+
+    // Show the units chosen since the widgets last printed theirs; the
+    // next update() reformats every value
+    void unitsChanged();
+
+private:
+    void showLabels(uint8_t controllers);
+    void bindFields();
+
+    const Layout* layout;
+    uint8_t first;
+    uint8_t count;
+    Widget* items[Layout::MAX_PAGE_WIDGETS];
+    uint16_t fieldWidgets[VALUES_FIELD_COUNT];  // Per VALUES_BIT_*, a mask of the widgets it moves
+    uint16_t everyFrame;                        // Widgets updated on every frame
+    uint16_t staleWidgets;                      // Shown greyed by the last update
+    uint8_t shownControllers;   // Label variant shown, 0 before the first update
+    Compositor widgets;
+};
@@ -0,0 +1,146 @@
+#include "list_view.h"
+
+static const int16_t TAP_SLOP = 8;              // Pixels a tap may wander
+static const uint32_t TAP_MAX_MS = 500;
+static const int32_t FLING_MIN_VELOCITY = 300;  // Pixels per second to start a fling...
+static const int32_t FLING_STOP_VELOCITY = 60;  // ...and to end one
+static const int32_t FLING_DECAY_MS = 350;      // Time constant of the slowdown
+static const int16_t SCROLL_BAR_WIDTH = 3;
+
+ListView::ListView(DisplayGfx* display, int16_t x, int16_t y, int16_t w, uint8_t rows, int16_t rowHeight,
+                   RowPainter painter, RowKey key, void* context)
+    : display(display), x(x), y(y), w(w), rowCount(rows > MAX_ROWS ? MAX_ROWS : rows), rowHeight(rowHeight),
+      painter(painter), key(key), context(context), itemCount(0), firstRow(0),
+      touching(false), moved(false), startY(0), lastY(0), startFirst(0), startMs(0), lastMs(0),
+      velocity(0), flingPixels(0), flingMs(0), tapped(-1) {
+    invalidate();
+}
+
+uint32_t ListView::lastFirst() const {
+    return itemCount > rowCount ? itemCount - rowCount : 0;
+}
+
+void ListView::setCount(uint32_t count) {
+    itemCount = count;
+    if (firstRow > lastFirst()) firstRow = lastFirst();
+}
+
+void ListView::scrollTo(uint32_t firstPosition) {
+    firstRow = firstPosition > lastFirst() ? lastFirst() : firstPosition;
+}
+
+void ListView::ensureVisible(uint32_t position) {
+    if (position < firstRow) {
+        scrollTo(position);
+    } else if (position >= firstRow + rowCount) {
+        scrollTo(position - rowCount + 1);
+    }
+}
+
+void ListView::startDrag(int16_t touchY, uint32_t now) {
+    touching = true;
+    moved = false;
+    startY = lastY = touchY;
+    startFirst = firstRow;
+    startMs = lastMs = now;
+    velocity = 0;
+    flingMs = 0;
+}
+
+void ListView::touch(bool down, int16_t touchX, int16_t touchY, uint32_t now) {
+    if (down && !touching) {
+        // Only a touch that starts on the list counts
+        if (touchX < x || touchX >= x + w || touchY < y || touchY >= y + rowCount * rowHeight) return;
+        startDrag(touchY, now);
+        return;
+    }
+
+    if (down) {
+        if (abs(touchY - startY) > TAP_SLOP) moved = true;
+        if (moved) {
+            // Finger up scrolls towards later rows
+            int32_t rows = (startY - touchY) / rowHeight;
+            int64_t target = (int64_t)startFirst + rows;
+            scrollTo(target < 0 ? 0 : (uint32_t)target);
+        }
+        uint32_t dt = now - lastMs;
+        if (dt > 0) {
+            int32_t sample = (int32_t)(lastY - touchY) * 1000 / (int32_t)dt;
+            velocity = (velocity + 3 * sample) / 4;
+        }
+        lastY = touchY;
+        lastMs = now;
+        return;
+    }
+
+    if (touching) {
+        touching = false;
+        if (!moved && now - startMs <= TAP_MAX_MS) {
+            uint32_t position = firstRow + (startY - y) / rowHeight;
+            if (position < itemCount) tapped = position;
+        } else if (moved && abs(velocity) >= FLING_MIN_VELOCITY && now - lastMs < 100) {
+            flingPixels = 0;
+            flingMs = now;
+        }
+        return;
+    }
+
+    // Fling: travel at the velocity as it decays, a whole row at a time
+    if (flingMs == 0) return;
+    uint32_t dt = now - flingMs;
+    if (dt == 0) return;
+    flingMs = now;
+    flingPixels += velocity * (int32_t)dt / 1000;
+    velocity -= velocity * (int32_t)(dt < (uint32_t)FLING_DECAY_MS ? dt : FLING_DECAY_MS) / FLING_DECAY_MS;
+    int32_t rows = flingPixels / rowHeight;
+    flingPixels -= rows * rowHeight;
+    int64_t target = (int64_t)firstRow + rows;
+    scrollTo(target < 0 ? 0 : (uint32_t)target);
+    bool atEnd = (velocity < 0 && firstRow == 0) || (velocity > 0 && firstRow == lastFirst());
+    if (abs(velocity) < FLING_STOP_VELOCITY || atEnd) flingMs = 0;
+}
+
+int32_t ListView::takeTap() {
+    int32_t position = tapped;
+    tapped = -1;
+    return position;
+}
+
+void ListView::invalidate() {
+    for (uint8_t r = 0; r < MAX_ROWS; r++) {
+        shownPosition[r] = NO_ROW;
+        shownKey[r] = 0;
+    }
+    shownFirst = NO_ROW;
+    shownCount = NO_ROW;
+}
+
+void ListView::render() {
+    int16_t rowWidth = w - SCROLL_BAR_WIDTH - 1;
+    for (uint8_t r = 0; r < rowCount; r++) {
+        uint32_t position = firstRow + r;
+        uint32_t shown = position < itemCount ? position : NO_ROW - 1;
+        uint32_t rowKey = position < itemCount ? key(position, context) : 0;
+        if (shownPosition[r] == shown && shownKey[r] == rowKey) continue;
+        shownPosition[r] = shown;
+        shownKey[r] = rowKey;
+        int16_t rowY = y + r * rowHeight;
+        if (position < itemCount) {
+            painter(display, position, x, rowY, rowWidth, rowHeight, context);
+        } else {
+            display->fillRect(x, rowY, rowWidth, rowHeight, BLACK);
+        }
+    }
+
+    if (shownFirst == firstRow && shownCount == itemCount) return;
+    shownFirst = firstRow;
+    shownCount = itemCount;
+    int16_t barX = x + w - SCROLL_BAR_WIDTH;
+    int16_t height = rowCount * rowHeight;
+    display->fillRect(barX, y, SCROLL_BAR_WIDTH, height, BLACK);
+    if (itemCount <= rowCount) return;
+    int16_t thumb = height * rowCount / itemCount;
+    if (thumb < 6) thumb = 6;
+    int16_t thumbY = y + (int32_t)(height - thumb) * firstRow / lastFirst();
+    display->fillRect(barX, thumbY, SCROLL_BAR_WIDTH, thumb, DARKGREY);
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include "display.h"
+#include <stdint.h>
+
+// Virtualized list: only the rows in view exist, and each is painted by
+// a callback from its position in the list, so the list can be any
+// length. A key callback sums up what a row shows (e.g. its item, RSSI
+// and selection); a row is repainted only when its position or key
+// changed, so a refresh of the data repaints just the rows that moved.
+//
+// Touch: dragging scrolls a row at a time with the finger, a fling keeps
+// scrolling and slows down, and a short touch that did not move is a tap
+// on the row under it. Not thread safe.
+class ListView {
+public:
+    static const uint8_t MAX_ROWS = 12;
+
+    // Paint the row at a position into (x, y, w, h), background included
+    typedef void (*RowPainter)(DisplayGfx* display, uint32_t position, int16_t x, int16_t y, int16_t w, int16_t h,
+                               void* context);
+    typedef uint32_t (*RowKey)(uint32_t position, void* context);
+
+    ListView(DisplayGfx* display, int16_t x, int16_t y, int16_t w, uint8_t rows, int16_t rowHeight,
+             RowPainter painter, RowKey key, void* context = nullptr);
+
+    // Number of positions; the view is kept within them
+    void setCount(uint32_t count);
+    uint32_t count() const { return itemCount; }
+    uint32_t first() const { return firstRow; }
+    uint8_t rows() const { return rowCount; }
+
+    void scrollTo(uint32_t firstPosition);
+
+    // Scroll just enough to bring a position into view
+    void ensureVisible(uint32_t position);
+
+    // The finger, once per frame: down with its point, or up. Also runs
+    // a fling after the finger has left.
+    void touch(bool down, int16_t x, int16_t y, uint32_t now);
+
+    // Position tapped since the last call, or -1
+    int32_t takeTap();
+
+    // Repaint every row at the next render(), e.g. after a clear
+    void invalidate();
+
+    // Paint the rows that changed, and the scroll bar if the view moved
+    void render();
+
+private:
+    static const uint32_t NO_ROW = 0xFFFFFFFF;
+
+    uint32_t lastFirst() const;
+    void startDrag(int16_t y, uint32_t now);
+
+    DisplayGfx* display;
+    int16_t x, y, w;
+    uint8_t rowCount;
+    int16_t rowHeight;
+    RowPainter painter;
+    RowKey key;
+    void* context;
+
+    uint32_t itemCount;
+    uint32_t firstRow;
+    uint32_t shownPosition[MAX_ROWS];
+    uint32_t shownKey[MAX_ROWS];
+    uint32_t shownFirst;         // Of the scroll bar
+    uint32_t shownCount;
+
+    bool touching;
+    bool moved;                  // Past the tap slop since the finger came down
+    int16_t startY;
+    int16_t lastY;
+    uint32_t startFirst;
+    uint32_t startMs;
+    uint32_t lastMs;
+    int32_t velocity;            // Pixels per second, positive towards later rows
+    int32_t flingPixels;         // Travel not yet turned into whole rows
+    uint32_t flingMs;            // Last fling step, 0 if no fling is running
+    int32_t tapped;
+};
@@ -0,0 +1,39 @@
+#include "palette.h"
+
+// RGB565, the M5 colour names where there is one
+const uint16_t UI_PALETTE[UI_PALETTE_SIZE] = {
+    0x0000,  // BLACK
+    0xFFFF,  // WHITE
+    0xF800,  // RED
+    0x07E0,  // GREEN
+    0x001F,  // BLUE
+    0x07FF,  // CYAN
+    0xFFE0,  // YELLOW
+    0xF81F,  // MAGENTA
+    0xFDA0,  // The built-in layout's orange
+    0x7BEF,  // DARKGREY
+    0xC618,  // LIGHTGREY
+    0x7800,  // MAROON
+    0x03E0,  // DARKGREEN
+    0x000F,  // NAVY
+    0x780F,  // PURPLE
+    0x7BE0,  // OLIVE
+};
+
+uint8_t uiPaletteIndex(uint16_t color) {
+    int32_t r = color >> 11, g = (color >> 5) & 0x3F, b = color & 0x1F;
+    uint8_t best = 0;
+    int32_t bestDistance = INT32_MAX;
+    for (uint8_t i = 0; i < UI_PALETTE_SIZE; i++) {
+        uint16_t p = UI_PALETTE[i];
+        if (p == color) return i;
+        // Green has a bit more, so red and blue count double
+        int32_t dr = 2 * (r - (p >> 11)), dg = g - ((p >> 5) & 0x3F), db = 2 * (b - (p & 0x1F));
+        int32_t distance = dr * dr + dg * dg + db * db;
+        if (distance < bestDistance) {
+            bestDistance = distance;
+            best = i;
+        }
+    }
+    return best;
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <stdint.h>
+
+// The colours the UI draws with, as the palette of 4-bit retained screen
+// images. Index 0 is black, so a cleared image is all zeros.
+static const uint8_t UI_PALETTE_SIZE = 16;
+extern const uint16_t UI_PALETTE[UI_PALETTE_SIZE];
+
+// Index of the palette colour nearest an RGB565 colour
+uint8_t uiPaletteIndex(uint16_t color);
+
+// RGB565 to the sprite library's RGB332
+static inline uint8_t rgb565To332(uint16_t color) {
+    return (uint8_t)((color & 0xE000) >> 8 | (color & 0x0700) >> 6 | (color & 0x0018) >> 3);
+}
+
+// And back, each channel's top bits repeated into the bits below
+static inline uint16_t rgb332To565(uint8_t color) {
+    uint16_t r = color >> 5, g = (color >> 2) & 0x07, b = color & 0x03;
+    return (uint16_t)((r << 2 | r >> 1) << 11 | (g << 3 | g) << 5 | (b << 3 | b << 1 | b >> 1));
+}
@@ -0,0 +1,74 @@
+#include "qr_code.h"
+#include "../log.h"
+
+#include <string.h>
+#include <utility/qrcode.h>
+
+// Bytes each version holds at ECC_MEDIUM
+static const uint8_t BYTE_CAPACITY[QrCodeSprite::MAX_VERSION] = { 14, 26, 42, 62, 84, 106, 122, 152, 180, 213 };
+
+QrCodeSprite::QrCodeSprite(DisplayGfx* display) : sprite(display), side(0), isBuilt(false) {
+}
+
+bool QrCodeSprite::build(const char* text, int16_t maxSize) {
+    release();
+
+    // Sized for the largest version; the smaller ones use its start
+    uint8_t modules[(4 * MAX_VERSION + 17) * (4 * MAX_VERSION + 17) / 8 + 1];
+    // qrcode.c writes past its buffers for text longer than the version
+    // holds, so the version is picked here. Byte mode holds the least;
+    // text that packs denser fits with room to spare.
+    size_t length = strlen(text);
+    uint8_t version = 1;
+    while (version <= MAX_VERSION && length > BYTE_CAPACITY[version - 1]) version++;
+    if (version > MAX_VERSION) {
+        LOG_E(UI, "%u characters do not fit a QR code", (unsigned)length);
+        return false;
+    }
+    QRCode code;
+    qrcode_initText(&code, modules, version, ECC_MEDIUM, text);
+
+    int16_t span = code.size + 2 * QUIET_ZONE;
+    int16_t scale = maxSize / span;
+    if (scale < 1) {
+        LOG_E(UI, "A version %u QR code does not fit %d pixels", version, maxSize);
+        return false;
+    }
+    side = span * scale;
+    sprite.setPsram(true);
+    sprite.setColorDepth(8);
+    if (sprite.createSprite(side, side) == nullptr) {
+        LOG_E(UI, "No memory for a %dx%d QR code", side, side);
+        side = 0;
+        return false;
+    }
+
+    sprite.fillSprite(WHITE);
+    int16_t origin = QUIET_ZONE * scale;
+    for (uint8_t y = 0; y < code.size; y++) {
+        // Runs of dark modules in a row are one rectangle
+        uint8_t x = 0;
+        while (x < code.size) {
+            if (!qrcode_getModule(&code, x, y)) {
+                x++;
+                continue;
+            }
+            uint8_t start = x;
+            while (x < code.size && qrcode_getModule(&code, x, y)) x++;
+            sprite.fillRect(origin + start * scale, origin + y * scale, (x - start) * scale, scale, BLACK);
+        }
+    }
+    isBuilt = true;
+    LOG_I(UI, "QR code: version %u, %d px a module, %dx%d", version, scale, side, side);
+    return true;
+}
+
+void QrCodeSprite::release() {
+    if (isBuilt) sprite.deleteSprite();
+    isBuilt = false;
+    side = 0;
+}
+
+void QrCodeSprite::push(int16_t x, int16_t y) {
+    if (isBuilt) displayPushSprite(sprite, x, y);
+}
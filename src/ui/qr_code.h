@@ -0,0 +1,36 @@
+#pragma once
+
+#include "display.h"
+
+// A QR code drawn once into an 8-bit sprite in PSRAM and pushed from it
+// afterwards. The code is encoded with the M5Core2 library's qrcode.c at
+// the smallest version its text fits, and drawn at a whole number of
+// pixels a module with the four-module quiet zone the readers want, as
+// large as fits the size asked for. Encoding and drawing a module at a
+// time takes tens of milliseconds, so it is done the first time a code
+// is shown, not at boot, and never again.
+class QrCodeSprite {
+public:
+    static const uint8_t MAX_VERSION = 10;    // 57 modules: up to 213 bytes at ECC_MEDIUM
+    static const uint8_t QUIET_ZONE = 4;
+
+    explicit QrCodeSprite(DisplayGfx* display);
+
+    // Encode text and draw it into the sprite, at most maxSize pixels a
+    // side. Returns false if it does not fit a MAX_VERSION code, the
+    // modules would be smaller than a pixel, or there was no memory.
+    bool build(const char* text, int16_t maxSize);
+    void release();
+
+    bool built() const { return isBuilt; }
+
+    // Side of the code with its quiet zone, in pixels
+    int16_t size() const { return side; }
+
+    void push(int16_t x, int16_t y);
+
+private:
+    DisplaySprite sprite;
+    int16_t side;
+    bool isBuilt;
+};
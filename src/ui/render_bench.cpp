@@ -0,0 +1,48 @@
+#include "render_bench.h"
+#include "display.h"
+#include "../log.h"
+
+#include <Arduino.h>
+
+static const uint16_t WARMUP_RUNS = 3;
+
+RenderBenchResult renderBenchRun(const RenderBenchCase& benchCase, uint16_t iterations) {
+    RenderBenchResult result = { 0, UINT32_MAX, 0, 0 };
+    for (uint16_t i = 0; i < WARMUP_RUNS; i++) benchCase.run(benchCase.context);
+
+    uint64_t totalUs = 0;
+    for (uint16_t i = 0; i < iterations; i++) {
+        uint32_t started = micros();
+        benchCase.run(benchCase.context);
+        uint32_t took = micros() - started;
+        totalUs += took;
+        if (took < result.minUs) result.minUs = took;
+        if (took > result.maxUs) result.maxUs = took;
+        // Keep the idle task and its watchdog fed through long cases
+        if ((i & 7) == 7) vTaskDelay(1);
+    }
+    if (iterations == 0) {
+        result.minUs = 0;
+        return result;
+    }
+    result.avgUs = (uint32_t)(totalUs / iterations);
+    // bytes per us is MB/s; scaled to kB/s to keep the decimals
+    if (benchCase.bytes > 0 && result.avgUs > 0) {
+        result.kbPerSecond = (uint32_t)((uint64_t)benchCase.bytes * 1000 / result.avgUs);
+    }
+    return result;
+}
+
+void renderBenchRunAll(const RenderBenchCase* cases, size_t count, uint16_t iterations) {
+    LOG_I(UI, "Render benchmark (%s): %u cases, %u runs each", displayBackendName(), (unsigned)count, iterations);
+    for (size_t c = 0; c < count; c++) {
+        RenderBenchResult r = renderBenchRun(cases[c], iterations);
+        if (r.kbPerSecond > 0) {
+            LOG_I(UI, "  %-22s %7u us/op (min %u, max %u), %u.%02u MB/s", cases[c].name, r.avgUs, r.minUs, r.maxUs,
+                  r.kbPerSecond / 1000, (r.kbPerSecond % 1000) / 10);
+        } else {
+            LOG_I(UI, "  %-22s %7u us/op (min %u, max %u)", cases[c].name, r.avgUs, r.minUs, r.maxUs);
+        }
+    }
+    LOG_I(UI, "Render benchmark done");
+}
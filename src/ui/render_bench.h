@@ -0,0 +1,31 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Times drawing paths on the real LCD, so direct drawing, sprites and
+// cached glyphs can be compared by number. Each case is run a few times
+// untimed to warm the caches, then `iterations` times, and its average,
+// fastest and slowest run are logged. A case that knows how many bytes
+// one run moves to the LCD also gets its effective SPI rate.
+//
+// Runs on the calling task and owns the screen while it does.
+
+struct RenderBenchCase {
+    const char* name;
+    void (*run)(void* context);
+    void* context;
+    uint32_t bytes;             // Pixel bytes one run sends to the LCD, 0 if it varies
+};
+
+struct RenderBenchResult {
+    uint32_t avgUs;
+    uint32_t minUs;
+    uint32_t maxUs;
+    uint32_t kbPerSecond;       // Of bytes, 0 without
+};
+
+RenderBenchResult renderBenchRun(const RenderBenchCase& benchCase, uint16_t iterations);
+
+// Run and log every case
+void renderBenchRunAll(const RenderBenchCase* cases, size_t count, uint16_t iterations);
@@ -0,0 +1,43 @@
+#include "render_governor.h"
+
+RenderGovernor::RenderGovernor()
+    : frameUs(1000000 / 30), idleUs(250000), lastRenderUs(0), requestUs(0), requested(true),
+      started(false) {
+}
+
+void RenderGovernor::setRate(uint8_t fps, uint32_t idleMs) {
+    frameUs = 1000000 / (fps > 0 ? fps : 1);
+    idleUs = idleMs * 1000;
+}
+
+void RenderGovernor::request(uint32_t nowUs) {
+    if (requested) return;
+    requested = true;
+    requestUs = nowUs;
+}
+
+// When the pending render may start: the next slot, or the request if
+// that came later. With nothing requested, the idle render.
+uint32_t RenderGovernor::startUs() const {
+    uint32_t slot = lastRenderUs + frameUs;
+    if (!requested) return lastRenderUs + idleUs;
+    // Compare as distances from the last render, which survive the wrap
+    return (requestUs - lastRenderUs) > frameUs ? requestUs : slot;
+}
+
+uint32_t RenderGovernor::msUntilDue(uint32_t nowUs) const {
+    if (!started) return 0;
+    int32_t wait = (int32_t)(startUs() - nowUs);
+    return wait > 0 ? (uint32_t)(wait + 999) / 1000 : 0;
+}
+
+bool RenderGovernor::due(uint32_t nowUs, uint32_t& lateUs) {
+    // The first render has no slot to wait for
+    int32_t late = started ? (int32_t)(nowUs - startUs()) : 0;
+    if (late < 0) return false;
+    lateUs = (uint32_t)late;
+    started = true;
+    lastRenderUs = nowUs;
+    requested = false;
+    return true;
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <stdint.h>
+
+// Decides which passes of the UI loop render. The loop wakes for every
+// event (replies, polls due, USB bytes) and does its other work at once,
+// but a pass only renders when something on screen may have changed
+// since the last render, and at most fps times a second: any number of
+// telemetry updates between two render slots cost one render. Without
+// any request it still renders every idleMs, for countdowns and the age
+// of the data.
+//
+// Times are in microseconds from micros(). Not thread safe.
+class RenderGovernor {
+public:
+    RenderGovernor();
+
+    void setRate(uint8_t fps, uint32_t idleMs);
+
+    // Something visible changed; folded into the next render
+    void request(uint32_t nowUs);
+
+    // Milliseconds until the next render may start: 0 if now, else the
+    // wait for the next slot, or for the idle render if nothing is pending
+    uint32_t msUntilDue(uint32_t nowUs) const;
+
+    // Whether this pass renders. On true the render counts as started,
+    // and lateUs is how long after its slot opened (or, if it opened
+    // before the request, after the request).
+    bool due(uint32_t nowUs, uint32_t& lateUs);
+
+private:
+    uint32_t startUs() const;
+
+    uint32_t frameUs;            // Least time between two renders
+    uint32_t idleUs;
+    uint32_t lastRenderUs;
+    uint32_t requestUs;          // First request since the last render
+    bool requested;
+    bool started;                // Rendered once
+};
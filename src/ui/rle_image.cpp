@@ -0,0 +1,44 @@
+#include "rle_image.h"
+
+RleImageReader::RleImageReader(const RleImage& image)
+    : image(image), index(0), left(0), color(0), nextRowIndex(0) {
+}
+
+bool RleImageReader::nextRow(uint16_t* out) {
+    if (nextRowIndex >= image.height) return false;
+    uint16_t x = 0;
+    while (x < image.width) {
+        if (left == 0) {
+            if (index >= image.size) return false;
+            uint8_t run = image.data[index++];
+            left = (run >> 4) + 1;
+            color = image.palette[run & 0x0F];
+        }
+        uint16_t n = left;
+        if (n > image.width - x) n = image.width - x;
+        for (uint16_t i = 0; i < n; i++) out[x + i] = color;
+        x += n;
+        left -= n;
+    }
+    nextRowIndex++;
+    return true;
+}
+
+bool rleImageDraw(DisplayGfx* target, const RleImage& image, int16_t x, int16_t y) {
+    if (image.width > RLE_IMAGE_MAX_WIDTH) return false;
+    uint16_t line[RLE_IMAGE_MAX_WIDTH];
+    RleImageReader reader(image);
+    // The palette is already in the LCD's byte order
+    bool oldSwapBytes = target->getSwapBytes();
+    target->setSwapBytes(false);
+    bool complete = true;
+    for (uint16_t row = 0; row < image.height; row++) {
+        if (!reader.nextRow(line)) {
+            complete = false;
+            break;
+        }
+        target->pushImage(x, y + row, image.width, 1, line);
+    }
+    target->setSwapBytes(oldSwapBytes);
+    return complete;
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include "display.h"
+#include <stdint.h>
+
+// A run-length coded, palette-indexed image in flash (generated by
+// tools/ui_assets.py into ui_assets.h). Each byte of data is one run,
+// (length - 1) << 4 | palette index, running on across the ends of rows;
+// the palette is in the LCD's byte order.
+struct RleImage {
+    uint16_t width;
+    uint16_t height;
+    const uint16_t* palette;     // Up to 16 colours
+    const uint8_t* data;
+    uint32_t size;               // Bytes of data
+};
+
+// Widest image drawn through a line buffer on the stack
+#define RLE_IMAGE_MAX_WIDTH 320
+
+// Expands an image a row at a time, reading the runs in place from flash
+class RleImageReader {
+public:
+    explicit RleImageReader(const RleImage& image);
+
+    // Decode the next row into out[width]. Returns false past the last
+    // row, or if the data ran out before the row was full.
+    bool nextRow(uint16_t* out);
+
+    uint16_t row() const { return nextRowIndex; }
+
+private:
+    const RleImage& image;
+    uint32_t index;              // Next byte of data
+    uint8_t left;                // Pixels of the current run not yet written
+    uint16_t color;
+    uint16_t nextRowIndex;
+};
+
+// Draw an image with its top left at x, y, onto the LCD or into a
+// sprite: each row is expanded into a line buffer and pushed on its own,
+// so no copy the size of the image is made. Returns false if the image
+// is too wide or its data is short (the rows before are drawn).
+bool rleImageDraw(DisplayGfx* target, const RleImage& image, int16_t x, int16_t y);
@@ -0,0 +1,148 @@
+#include "screen.h"
+#include "palette.h"
+#include "../log.h"
+
+Screen::Screen(const char* name, const ScreenHooks& hooks, const ScreenInput& input, Compositor* widgets)
+    : screenName(name), hooks(hooks), inputHandlers(input), widgets(widgets), image(nullptr),
+      imageValid(false), full(true) {
+}
+
+bool Screen::retain(DisplayGfx* display, uint8_t colorDepth) {
+    if (image) return true;
+    if (!widgets) return false;
+    if (colorDepth != 8 && colorDepth != 4) colorDepth = 16;
+
+    image = new DisplaySprite(display);
+    image->setPsram(true);
+    image->setColorDepth(colorDepth);
+    if (image->createSprite(display->width(), display->height()) == nullptr) {
+        LOG_W(UI, "No memory to retain the %s screen", screenName);
+        delete image;
+        image = nullptr;
+        return false;
+    }
+    if (colorDepth == 4) image->createPalette(const_cast<uint16_t*>(UI_PALETTE), UI_PALETTE_SIZE);
+    // Black is 0 at any depth
+    image->fillSprite(BLACK);
+    return true;
+}
+
+bool Screen::prerender() {
+    if (!image || imageValid) return false;
+    widgets->prerender(*image);
+    imageValid = true;
+    return true;
+}
+
+void Screen::show(DisplayGfx* display) {
+    if (image && imageValid) {
+        displayPushSprite(*image, 0, 0);
+        widgets->invalidateUnretained();
+        full = false;
+        return;
+    }
+    display->fillScreen(BLACK);
+    if (widgets) widgets->invalidateAll();
+    full = true;
+}
+
+void Screen::frame() {
+    if (hooks.update) hooks.update();
+    if (widgets) {
+        widgets->frame(image);
+        // After a full repaint every widget is in the image
+        if (full && image) imageValid = true;
+    }
+    if (hooks.render) hooks.render(full);
+    full = false;
+}
+
+ScreenStack::ScreenStack(DisplayGfx* display)
+    : display(display), depth(0), pendingShow(false), slideFrom(nullptr), slideDirection(SLIDE_NONE),
+      slideDone(0) {
+}
+
+void ScreenStack::changeTop(Screen* previous) {
+    slideFrom = nullptr;
+    if (previous) previous->exit();
+    Screen* current = top();
+    if (current) {
+        current->enter();
+        LOG_D(UI, "Screen: %s", current->name());
+    }
+    pendingShow = true;
+}
+
+void ScreenStack::push(Screen* screen) {
+    if (depth >= MAX_DEPTH) {
+        LOG_W(UI, "Screen stack full, replacing %s", top()->name());
+        replace(screen);
+        return;
+    }
+    Screen* previous = top();
+    screens[depth++] = screen;
+    changeTop(previous);
+}
+
+void ScreenStack::pop() {
+    if (depth <= 1) return;
+    Screen* previous = top();
+    depth--;
+    changeTop(previous);
+}
+
+void ScreenStack::replace(Screen* screen) {
+    if (depth == 0) {
+        push(screen);
+        return;
+    }
+    Screen* previous = top();
+    if (previous == screen) return;
+    screens[depth - 1] = screen;
+    changeTop(previous);
+}
+
+void ScreenStack::setRoot(Screen* screen, ScreenSlide slide) {
+    if (depth == 1 && screens[0] == screen) return;
+    Screen* previous = top();
+    screens[0] = screen;
+    depth = 1;
+    changeTop(previous);
+    if (slide != SLIDE_NONE && previous && previous->retained() && screen->retained()) {
+        slideFrom = previous;
+        slideDirection = slide;
+        slideDone = 0;
+    }
+}
+
+// Push the next step of the slide, easing out so it starts fast and
+// settles. Returns false once the last step is due, which is the new
+// screen's own show.
+bool ScreenStack::slideStep() {
+    if (++slideDone >= SLIDE_STEPS) {
+        slideFrom = nullptr;
+        return false;
+    }
+    int32_t width = display->width();
+    uint32_t left = SLIDE_STEPS - slideDone;
+    int16_t offset = width - width * left * left / (SLIDE_STEPS * SLIDE_STEPS);
+    if (slideDirection == SLIDE_LEFT) {
+        slideFrom->pushRetained(-offset);
+        top()->pushRetained(width - offset);
+    } else {
+        slideFrom->pushRetained(offset);
+        top()->pushRetained(offset - width);
+    }
+    return true;
+}
+
+void ScreenStack::frame() {
+    Screen* current = top();
+    if (!current) return;
+    if (slideFrom && slideStep()) return;
+    if (pendingShow) {
+        pendingShow = false;
+        current->show(display);
+    }
+    current->frame();
+}
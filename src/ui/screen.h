@@ -0,0 +1,133 @@
+#pragma once
+
+#include "display.h"
+#include "widget.h"
+#include "input.h"
+
+// What a screen does at each point of its life; any hook may be nullptr
+struct ScreenHooks {
+    void (*enter)();            // Became the top of the stack
+    void (*exit)();             // Left the top: popped, replaced or covered
+    void (*update)();           // Every frame while on top, before rendering
+    void (*render)(bool full);  // Direct drawing; full after the screen was cleared
+};
+
+// One full screen of UI: its hooks, its button handlers and optionally a
+// compositor of widgets. A screen can retain a full-screen image of what
+// its widgets painted (in PSRAM), kept up to date as they repaint, so
+// showing it again is a single blit plus whatever changed meanwhile
+// instead of a clear and a full repaint. Only widget output is retained;
+// direct drawing in the render hook is redone with full set.
+//
+// The image may be kept at 8 bits a pixel (RGB332) or 4 (the UI palette,
+// see palette.h) for a half or a quarter of the 150 KB at 16; the sprite
+// library expands it to RGB565 a line at a time as it is pushed. Colours
+// outside the palette come back as their nearest until the widget
+// showing them repaints.
+class Screen {
+public:
+    Screen(const char* name, const ScreenHooks& hooks, const ScreenInput& input,
+           Compositor* widgets = nullptr);
+
+    // Allocate the retained image at 16, 8 or 4 bits a pixel. Returns
+    // false without the memory; the screen then repaints from scratch
+    // each time it is shown.
+    bool retain(DisplayGfx* display, uint8_t colorDepth = 16);
+
+    // Paint the retained image from the widgets as they are, without
+    // touching the display, so that even the first show() is a blit. Not
+    // for the screen on top, whose display would then lag its widgets.
+    // Returns false if there is no image or it is already complete.
+    bool prerender();
+
+    // Bring the screen onto the display: blit the retained image, or
+    // clear and mark everything for a full repaint
+    void show(DisplayGfx* display);
+
+    // Run the update hook, then paint the dirty widgets and the render hook
+    void frame();
+
+    // The retained image holds the whole screen, so it can be slid in or
+    // out (see ScreenStack::setRoot)
+    bool retained() const { return image && imageValid; }
+
+    // Push the retained image with its left edge at x; what falls off
+    // the display is clipped
+    void pushRetained(int16_t x) { displayPushSprite(*image, x, 0); }
+
+    void enter() { if (hooks.enter) hooks.enter(); }
+    void exit() { if (hooks.exit) hooks.exit(); }
+
+    const ScreenInput& input() const { return inputHandlers; }
+    const char* name() const { return screenName; }
+
+private:
+    const char* screenName;
+    ScreenHooks hooks;
+    const ScreenInput& inputHandlers;
+    Compositor* widgets;
+    DisplaySprite* image;
+    bool imageValid;      // The image holds a complete paint of every widget
+    bool full;            // Shown from a cleared screen, not yet rendered
+};
+
+// Which way a new root slides in: SLIDE_LEFT moves the old screen out
+// to the left and brings the new one in from the right
+enum ScreenSlide : uint8_t {
+    SLIDE_NONE,
+    SLIDE_LEFT,
+    SLIDE_RIGHT
+};
+
+// Screens on the display, the top one shown. A change of top calls the
+// exit and enter hooks at once and shows the new top at the next frame,
+// so several changes within one frame cost one transition.
+//
+// A slide pushes the two retained images side by side, a little further
+// over at each frame, for SLIDE_STEPS frames; the new screen's own frame
+// runs from the last one. Nothing is cleared or repainted along the way,
+// and the widgets repaint only what changed while the new screen was
+// hidden.
+class ScreenStack {
+public:
+    static const int MAX_DEPTH = 4;
+    static const uint8_t SLIDE_STEPS = 4;
+
+    explicit ScreenStack(DisplayGfx* display);
+
+    // Cover the top with another screen; pop() goes back to it
+    void push(Screen* screen);
+    void pop();
+
+    // Swap the top for another screen
+    void replace(Screen* screen);
+
+    // Drop the whole stack for one screen; nothing happens if it is
+    // already the only one. With a slide, and both screens retained, the
+    // new one slides in over the next frames instead of appearing at once.
+    void setRoot(Screen* screen, ScreenSlide slide = SLIDE_NONE);
+
+    Screen* top() const { return depth > 0 ? screens[depth - 1] : nullptr; }
+
+    // Show the top again from scratch at the next frame (e.g. its layout
+    // changed)
+    void redraw() { pendingShow = true; }
+
+    // Show a new top, or the next step of a slide, then run its frame
+    void frame();
+
+    // A slide is under way; each frame moves it on
+    bool animating() const { return slideFrom != nullptr; }
+
+private:
+    void changeTop(Screen* previous);
+    bool slideStep();
+
+    DisplayGfx* display;
+    Screen* screens[MAX_DEPTH];
+    int depth;
+    bool pendingShow;
+    Screen* slideFrom;        // The screen sliding out, nullptr if none
+    ScreenSlide slideDirection;
+    uint8_t slideDone;        // Steps pushed so far
+};
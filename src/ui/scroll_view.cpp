@@ -0,0 +1,105 @@
+#include "scroll_view.h"
+
+static const uint8_t CMD_VSCRDEF = 0x33;     // Scroll band: top fixed, scrolled, bottom fixed rows
+static const uint8_t CMD_VSCRSADD = 0x37;    // Frame row shown at the top of the band
+
+ScrollTextView::ScrollTextView(DisplayGfx* display, int16_t top, uint8_t lines, LineSource source, void* context)
+    : display(display), strip(display), top(top), lines(lines), source(source), context(context),
+      offset(0), first(0), oldest(0), count(0), follow(true) {}
+
+void ScrollTextView::setBand(uint16_t fixedTop, uint16_t scrolled, uint16_t fixedBottom) {
+    // The scroll registers are the panel's, so they go through the backend
+    // whichever display this view draws on
+    const uint8_t rows[] = {
+        (uint8_t)(fixedTop >> 8), (uint8_t)(fixedTop & 0xFF),
+        (uint8_t)(scrolled >> 8), (uint8_t)(scrolled & 0xFF),
+        (uint8_t)(fixedBottom >> 8), (uint8_t)(fixedBottom & 0xFF)
+    };
+    displayCommand(CMD_VSCRDEF, rows, sizeof(rows));
+}
+
+void ScrollTextView::scrollTo(uint16_t row) {
+    const uint8_t start[] = { (uint8_t)(row >> 8), (uint8_t)(row & 0xFF) };
+    displayCommand(CMD_VSCRSADD, start, sizeof(start));
+}
+
+void ScrollTextView::drawLine(uint32_t line, int16_t y) {
+    char text[MAX_COLUMNS + 1];
+    uint16_t color = WHITE;
+    if (line < oldest || line >= count || !source(line, text, color, context)) text[0] = '\0';
+    text[MAX_COLUMNS] = '\0';
+    strip.draw(0, y, text, 2, 1, 1, color, BLACK);
+}
+
+// Lines in band order from the frame row now at its top
+void ScrollTextView::drawAll() {
+    uint16_t band = lines * LINE_HEIGHT;
+    for (uint8_t i = 0; i < lines; i++) drawLine(first + i, top + (offset + i * LINE_HEIGHT) % band);
+}
+
+uint32_t ScrollTextView::newestFirst() const {
+    uint32_t last = count > lines ? count - lines : 0;
+    return last > oldest ? last : oldest;
+}
+
+void ScrollTextView::moveTo(uint32_t target) {
+    uint32_t distance = target > first ? target - first : first - target;
+    if (distance == 0) return;
+    if (distance >= lines) {
+        first = target;
+        drawAll();
+        return;
+    }
+    uint16_t band = lines * LINE_HEIGHT;
+    while (first < target) {
+        // The rows at the top become the bottom line
+        drawLine(first + lines, top + offset);
+        offset = (offset + LINE_HEIGHT) % band;
+        first++;
+    }
+    while (first > target) {
+        // ...and the rows at the bottom the top line
+        offset = (offset + band - LINE_HEIGHT) % band;
+        first--;
+        drawLine(first, top + offset);
+    }
+    scrollTo(top + offset);
+}
+
+void ScrollTextView::show(uint32_t oldestLine, uint32_t lineCount) {
+    uint16_t band = lines * LINE_HEIGHT;
+    strip.begin(display->width(), LINE_HEIGHT);
+    setBand(top, band, display->height() - top - band);
+    offset = 0;
+    scrollTo(top);
+    oldest = oldestLine;
+    count = lineCount;
+    if (follow || first < oldest) first = newestFirst();
+    drawAll();
+}
+
+void ScrollTextView::update(uint32_t oldestLine, uint32_t lineCount) {
+    if (oldestLine == oldest && lineCount == count) return;
+    oldest = oldestLine;
+    count = lineCount;
+    if (follow) {
+        moveTo(newestFirst());
+    } else if (first < oldest) {
+        moveTo(oldest);
+    }
+}
+
+void ScrollTextView::scrollBy(int32_t delta) {
+    int64_t target = (int64_t)first + delta;
+    uint32_t newest = newestFirst();
+    if (target < oldest) target = oldest;
+    if (target > newest) target = newest;
+    moveTo((uint32_t)target);
+    follow = first == newest;
+}
+
+void ScrollTextView::hide() {
+    offset = 0;
+    scrollTo(0);
+    setBand(0, display->height(), 0);
+}
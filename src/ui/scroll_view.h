@@ -0,0 +1,68 @@
+#pragma once
+
+#include "display.h"
+#include <stdint.h>
+#include "text_strip.h"
+
+// Lines of text in a band of the display that scrolls with the panel's
+// vertical scroll registers (VSCRDEF sets the band, VSCRSADD its start
+// row). Moving by one line redraws only that line, as one push of its
+// rectangle (see text_strip.h): the rows that wrap
+// from one edge of the band to the other are repainted with it, and the
+// start address is moved by a line. The ILI9342C on the Core2 is natively
+// landscape, so its vertical scroll moves the rows of the rotated screen.
+// Rows above and below the band stay put.
+//
+// The view holds no text; lines are fetched by number from a source, so
+// a log in a ring buffer or a list of any length can be shown. While at
+// the newest line the view follows new ones. Only one view may be shown
+// at a time, and hide() must be called before anything else draws. Not
+// thread safe.
+class ScrollTextView {
+public:
+    static const int16_t LINE_HEIGHT = 10;
+    static const uint8_t MAX_COLUMNS = 53;       // At text size 1
+
+    // Copy a line, NUL terminated, into out[MAX_COLUMNS + 1] and pick its
+    // color. Returns false if there is no such line; it is left blank.
+    typedef bool (*LineSource)(uint32_t line, char* out, uint16_t& color, void* context);
+
+    // The band from y = top, `lines` lines high
+    ScrollTextView(DisplayGfx* display, int16_t top, uint8_t lines, LineSource source, void* context = nullptr);
+
+    // Set up the scroll band and draw it; lines [oldest, count) exist
+    void show(uint32_t oldest, uint32_t count);
+
+    // New lines arrived or old ones went. Scrolls them in if following,
+    // redrawing everything only if more arrived than fit.
+    void update(uint32_t oldest, uint32_t count);
+
+    // Move towards older (negative) or newer lines. Following stops until
+    // the newest line is back in view.
+    void scrollBy(int32_t lines);
+
+    bool following() const { return follow; }
+
+    // Put the display's scrolling back to normal
+    void hide();
+
+private:
+    void setBand(uint16_t fixedTop, uint16_t scrolled, uint16_t fixedBottom);
+    void scrollTo(uint16_t row);
+    void drawLine(uint32_t line, int16_t y);
+    void drawAll();
+    void moveTo(uint32_t first);
+    uint32_t newestFirst() const;
+
+    DisplayGfx* display;
+    TextStrip strip;
+    int16_t top;
+    uint8_t lines;
+    LineSource source;
+    void* context;
+    uint16_t offset;             // Rows the band is scrolled by
+    uint32_t first;              // Line at the top of the band
+    uint32_t oldest;
+    uint32_t count;
+    bool follow;
+};
@@ -0,0 +1,73 @@
+#include "sprite_panel.h"
+#include "palette.h"
+#include "../log.h"
+
+SpritePanel::SpritePanel(DisplayGfx* display, int16_t x, int16_t y, int16_t w, int16_t h)
+    : sprite(display), panelX(x), panelY(y), panelW(w), panelH(h), isReady(false) {
+}
+
+bool SpritePanel::begin(uint8_t colorDepth) {
+    if (isReady) return true;
+
+    sprite.setPsram(true);
+    sprite.setColorDepth(colorDepth);
+    isReady = sprite.createSprite(panelW, panelH) != nullptr;
+    if (!isReady) {
+        LOG_E(UI, "No memory for %dx%d sprite", panelW, panelH);
+    }
+    return isReady;
+}
+
+void SpritePanel::drawCentered(const char* text, int16_t y, uint8_t size, uint16_t color, uint16_t background) {
+    sprite.setTextSize(size);
+    sprite.setTextColor(color, background);
+    int16_t xPos = (panelW - sprite.textWidth(text)) / 2;
+    sprite.setCursor(xPos, y);
+    sprite.print(text);
+}
+
+void SpritePanel::push() {
+    if (isReady) displayPushSprite(sprite, panelX, panelY);
+}
+
+bool SpritePanel::copyTo(DisplaySprite& target) {
+    if (!isReady || sprite.getColorDepth() != 16) return false;
+    const uint16_t* pixels = (const uint16_t*)sprite.frameBuffer(0);
+    int8_t depth = target.getColorDepth();
+    if (depth == 16) {
+        // Both buffers hold pixels in the LCD's byte order; copy them as-is
+        bool oldSwapBytes = target.getSwapBytes();
+        target.setSwapBytes(false);
+        target.pushImage(panelX, panelY, panelW, panelH, (uint16_t*)pixels);
+        target.setSwapBytes(oldSwapBytes);
+        return true;
+    }
+    if (depth != 8 && depth != 4) return false;
+    int16_t targetW = target.width();
+    if (panelX < 0 || panelY < 0 || panelX + panelW > targetW || panelY + panelH > target.height()) return false;
+
+    uint8_t* buffer = (uint8_t*)target.frameBuffer(0);
+    // Widgets paint runs of one colour, so the last lookup is kept
+    uint16_t lastColor = BLACK;
+    uint8_t lastIndex = 0;
+    for (int16_t row = 0; row < panelH; row++) {
+        const uint16_t* source = pixels + (uint32_t)row * panelW;
+        uint32_t start = (uint32_t)(panelY + row) * targetW + panelX;
+        for (int16_t column = 0; column < panelW; column++) {
+            uint16_t color = (uint16_t)(source[column] << 8 | source[column] >> 8);
+            uint32_t at = start + column;
+            if (depth == 8) {
+                buffer[at] = rgb565To332(color);
+                continue;
+            }
+            if (color != lastColor) {
+                lastColor = color;
+                lastIndex = uiPaletteIndex(color);
+            }
+            // Two pixels a byte, the even one in the high nibble
+            uint8_t& pair = buffer[at >> 1];
+            pair = (at & 1) ? (uint8_t)((pair & 0xF0) | lastIndex) : (uint8_t)((pair & 0x0F) | lastIndex << 4);
+        }
+    }
+    return true;
+}
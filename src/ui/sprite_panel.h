@@ -0,0 +1,44 @@
+#pragma once
+
+#include "display.h"
+
+// A rectangle of the screen rendered off-screen first. Draw into canvas()
+// with coordinates relative to the panel, then push() sends the whole
+// rectangle to the LCD in one SPI transaction, so the panel never shows a
+// half-cleared or half-drawn state. Buffers go to PSRAM when available.
+class SpritePanel {
+public:
+    SpritePanel(DisplayGfx* display, int16_t x, int16_t y, int16_t w, int16_t h);
+
+    // Allocate the buffer. Returns false if there was not enough memory.
+    bool begin(uint8_t colorDepth = 16);
+
+    DisplaySprite& canvas() { return sprite; }
+
+    // Draw text horizontally centered in the panel, using the exact
+    // rendered width rather than a per-character estimate
+    void drawCentered(const char* text, int16_t y, uint8_t size, uint16_t color, uint16_t background);
+
+    void push();
+
+    // Copy the rendered rectangle into a full-screen sprite at the
+    // panel's screen position. Only 16-bit panels can be copied; a target
+    // of 8 bits (RGB332) or 4 (the UI palette, see palette.h) is written
+    // straight into its buffer, a pixel at a time.
+    bool copyTo(DisplaySprite& target);
+
+    bool ready() const { return isReady; }
+
+    int16_t x() const { return panelX; }
+    int16_t y() const { return panelY; }
+    int16_t width() const { return panelW; }
+    int16_t height() const { return panelH; }
+
+private:
+    DisplaySprite sprite;
+    int16_t panelX;
+    int16_t panelY;
+    int16_t panelW;
+    int16_t panelH;
+    bool isReady;
+};
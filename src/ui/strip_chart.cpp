@@ -0,0 +1,148 @@
+#include "strip_chart.h"
+
+// Samples for a full redraw. Only the UI task draws charts.
+static int32_t scratch[StripChartWidget::MAX_WIDTH];
+static int32_t referenceScratch[StripChartWidget::MAX_WIDTH];
+
+StripChartWidget::StripChartWidget(DisplayGfx* display, int16_t x, int16_t y, int16_t w, int16_t h,
+                                   HistoryField field, uint16_t color, int32_t minSpan)
+    : Widget(display, x, y, w, h), history(nullptr), field(field), color(color),
+      minSpan(minSpan), reference({ 0, 0, 0 }), referenceColor(DARKGREY), shownTotal(0), pendingTotal(0),
+      needsRedraw(true), rangeLow(0), rangeHigh(1), lastValue(0), hasLast(false) {
+}
+
+void StripChartWidget::invalidate() {
+    needsRedraw = true;
+    dirty = true;
+}
+
+void StripChartWidget::update(const TelemetryHistory& source) {
+    history = &source;
+    pendingTotal = source.total();
+    if (pendingTotal != shownTotal) dirty = true;
+}
+
+void StripChartWidget::setReference(const ChartReference& next, uint16_t color) {
+    if (next.count == 0 && reference.count == 0) return;
+    if (next.traceStart == reference.traceStart && next.start == reference.start && next.count == reference.count &&
+        color == referenceColor) {
+        return;
+    }
+    reference = next;
+    referenceColor = color;
+    invalidate();
+}
+
+int16_t StripChartWidget::toY(int32_t value) const {
+    int32_t bottom = height() - 1;
+    if (value <= rangeLow) return bottom;
+    if (value >= rangeHigh) return 0;
+    return bottom - (int16_t)(((int64_t)(value - rangeLow) * bottom) / (rangeHigh - rangeLow));
+}
+
+void StripChartWidget::setRange(const int32_t* values, uint32_t count) {
+    int32_t low = values[0];
+    int32_t high = values[0];
+    for (uint32_t i = 1; i < count; i++) {
+        if (values[i] < low) low = values[i];
+        if (values[i] > high) high = values[i];
+    }
+
+    // Pad by an eighth so the trace does not hug the edges, and widen
+    // around the middle if the data barely moves
+    int32_t span = high - low;
+    if (span < minSpan) {
+        int32_t middle = low + span / 2;
+        span = minSpan;
+        low = middle - span / 2;
+        high = low + span;
+    }
+    int32_t pad = span / 8 + 1;
+    rangeLow = low - pad;
+    rangeHigh = high + pad;
+}
+
+void StripChartWidget::drawColumn(DisplaySprite& canvas, int16_t x, int32_t value, const int32_t* referenceValue) {
+    // Join to the previous sample with a vertical run so steep changes
+    // stay connected
+    int16_t y = toY(value);
+    int16_t fromY = hasLast ? toY(lastValue) : y;
+    int16_t top = y < fromY ? y : fromY;
+    int16_t length = (y < fromY ? fromY - y : y - fromY) + 1;
+    canvas.drawFastVLine(x, 0, height(), BLACK);
+    canvas.drawPixel(x, height() / 2, DARKGREY);
+    if (referenceValue) canvas.drawPixel(x, toY(*referenceValue), referenceColor);
+    canvas.drawFastVLine(x, top, length, color);
+    lastValue = value;
+    hasLast = true;
+}
+
+void StripChartWidget::redrawAll(DisplaySprite& canvas, uint32_t newestTotal) {
+    int16_t plotW = width();
+    uint32_t first = newestTotal > (uint32_t)plotW ? newestTotal - plotW : 0;
+    uint32_t count = history ? history->copyRange(field, first, newestTotal - first, scratch) : 0;
+
+    canvas.fillRect(0, 0, plotW, height(), BLACK);
+    canvas.drawFastHLine(0, height() / 2, plotW, DARKGREY);
+    hasLast = false;
+    if (count == 0) return;
+
+    setRange(scratch, count);
+    drawRange(canvas, plotW - (int16_t)count, newestTotal - count, count);
+}
+
+// The reference samples that go with trace samples [first, first + n):
+// out[i] with trace sample first + from + i. Returns how many; none if
+// the reference is no longer all in the history.
+uint32_t StripChartWidget::copyReference(uint32_t first, uint32_t n, int32_t* out, uint32_t& from) const {
+    from = 0;
+    if (reference.count == 0 || !history || first + n <= reference.traceStart) return 0;
+    if (first < reference.traceStart) from = reference.traceStart - first;
+    uint32_t offset = first + from - reference.traceStart;
+    if (offset >= reference.count || reference.start < history->oldest()) return 0;
+    uint32_t count = n - from;
+    if (count > reference.count - offset) count = reference.count - offset;
+    return history->copyRange(field, reference.start + offset, count, out);
+}
+
+// Columns from x on for trace samples [first, first + count), which are
+// in scratch
+void StripChartWidget::drawRange(DisplaySprite& canvas, int16_t x, uint32_t first, uint32_t count) {
+    uint32_t from = 0;
+    uint32_t referenced = copyReference(first, count, referenceScratch, from);
+    for (uint32_t i = 0; i < count; i++) {
+        bool shown = i >= from && i - from < referenced;
+        drawColumn(canvas, x + i, scratch[i], shown ? &referenceScratch[i - from] : nullptr);
+    }
+}
+
+void StripChartWidget::render(SpritePanel& panel) {
+    DisplaySprite& canvas = panel.canvas();
+    int16_t plotW = width();
+    uint32_t newestTotal = pendingTotal;
+    uint32_t fresh = newestTotal - shownTotal;
+
+    if (!needsRedraw && fresh > 0 && fresh < (uint32_t)plotW && history) {
+        uint32_t count = history->copyRange(field, shownTotal, fresh, scratch);
+
+        // A value outside the current range rescales the whole plot
+        bool inRange = count == fresh;
+        for (uint32_t i = 0; i < count && inRange; i++) {
+            inRange = scratch[i] > rangeLow && scratch[i] < rangeHigh;
+        }
+        if (inRange) {
+            canvas.scroll(-(int16_t)count, 0);
+            drawRange(canvas, plotW - (int16_t)count, shownTotal, count);
+        } else {
+            needsRedraw = true;
+        }
+    } else if (fresh > 0) {
+        needsRedraw = true;
+    }
+
+    if (needsRedraw) {
+        redrawAll(canvas, newestTotal);
+        needsRedraw = false;
+    }
+    shownTotal = newestTotal;
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include "widget.h"
+#include "telemetry/history.h"
+
+// Scrolling plot of one history field, one pixel column per sample with
+// the newest at the right edge. Each new sample scrolls the sprite one
+// pixel left and draws a single column; the whole trace is only redrawn
+// when the chart is first shown, falls too far behind, or a value leaves
+// the current vertical range. The sprite holds nothing but the plot, so
+// the bytes pushed per frame are the plot's own; put the name and value
+// in their own widgets beside it.
+//
+// A reference stretch of the history (another lap) can be drawn under
+// the trace, sample for sample from a point of the trace: the column of
+// trace sample traceStart + i shows reference sample start + i as a dot.
+// It scrolls with the trace, so it too costs one column per sample.
+struct ChartReference {
+    uint32_t traceStart;     // Trace sample the reference lines up with
+    uint32_t start;          // First history sample of the reference
+    uint32_t count;          // Its samples, 0 for none
+};
+
+class StripChartWidget : public Widget {
+public:
+    static const int16_t MAX_WIDTH = 320;
+
+    // minSpan is the smallest vertical range in the field's raw units, so
+    // a steady value is not amplified into a noisy trace
+    StripChartWidget(DisplayGfx* display, int16_t x, int16_t y, int16_t w, int16_t h,
+                     HistoryField field, uint16_t color, int32_t minSpan);
+
+    void invalidate();
+
+    // Pick up samples appended since the last frame; marks the widget
+    // dirty if there are any
+    void update(const TelemetryHistory& history);
+
+    // Draw a reference under the trace; a change redraws the plot
+    void setReference(const ChartReference& reference, uint16_t referenceColor);
+
+protected:
+    void render(SpritePanel& panel);
+
+private:
+    int16_t toY(int32_t value) const;
+    void setRange(const int32_t* values, uint32_t count);
+    void redrawAll(DisplaySprite& canvas, uint32_t newestTotal);
+    void drawColumn(DisplaySprite& canvas, int16_t x, int32_t value, const int32_t* reference);
+    uint32_t copyReference(uint32_t first, uint32_t n, int32_t* out, uint32_t& from) const;
+    void drawRange(DisplaySprite& canvas, int16_t x, uint32_t first, uint32_t count);
+
+    const TelemetryHistory* history;
+    HistoryField field;
+    uint16_t color;
+    int32_t minSpan;
+    ChartReference reference;
+    uint16_t referenceColor;
+
+    uint32_t shownTotal;     // history.total() as of the last paint
+    uint32_t pendingTotal;   // history.total() seen by update()
+    bool needsRedraw;
+    int32_t rangeLow;
+    int32_t rangeHigh;
+    int32_t lastValue;
+    bool hasLast;
+};
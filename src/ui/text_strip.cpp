@@ -0,0 +1,49 @@
+#include "text_strip.h"
+#include "unicode_text.h"
+#include "../log.h"
+
+TextStrip::TextStrip(DisplayGfx* display) : display(display), sprite(display), stripW(0), stripH(0), isReady(false) {
+}
+
+bool TextStrip::begin(int16_t w, int16_t h) {
+    if (isReady && w == stripW && h == stripH) return true;
+    if (isReady) sprite.deleteSprite();
+
+    stripW = w;
+    stripH = h;
+    sprite.setPsram(true);
+    sprite.setColorDepth(16);
+    isReady = sprite.createSprite(w, h) != nullptr;
+    if (!isReady) {
+        LOG_E(UI, "No memory for %dx%d text strip", w, h);
+    }
+    return isReady;
+}
+
+void TextStrip::draw(int16_t x, int16_t y, const char* text, int16_t textX, int16_t textY, uint8_t textSize,
+                     uint16_t color, uint16_t background) {
+    bool unicode = utf8HasNonAscii(text);
+    if (!isReady) {
+        display->fillRect(x, y, stripW, stripH, background);
+        if (unicode) {
+            unicodeTextDraw(display, text, x + textX, y + textY, textSize, color, background);
+            return;
+        }
+        display->setTextSize(textSize);
+        display->setTextColor(color, background);
+        display->setCursor(x + textX, y + textY);
+        display->print(text);
+        return;
+    }
+    sprite.fillSprite(background);
+    if (unicode) {
+        unicodeTextDraw(&sprite, text, textX, textY, textSize, color, background);
+        displayPushSprite(sprite, x, y);
+        return;
+    }
+    sprite.setTextSize(textSize);
+    sprite.setTextColor(color, background);
+    sprite.setCursor(textX, textY);
+    sprite.print(text);
+    displayPushSprite(sprite, x, y);
+}
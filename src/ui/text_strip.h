@@ -0,0 +1,35 @@
+#pragma once
+
+#include "display.h"
+
+// One line of text for the small pieces of screen drawn straight to the
+// LCD (table cells, status and list rows). The line is rendered over its
+// background off-screen and pushed with one address window and one burst
+// of exactly its rectangle, instead of a fillRect and then glyph runs over
+// the same pixels. One strip serves every rectangle of its size. Without
+// the memory for it, it clears and prints directly.
+class TextStrip {
+public:
+    explicit TextStrip(DisplayGfx* display);
+
+    // Allocate for w by h rectangles, freeing a previous size. Returns
+    // false if there was not enough memory; draw() still works, the old
+    // way.
+    bool begin(int16_t w, int16_t h);
+
+    // Fill the rectangle at x, y with background and print text in it at
+    // textX, textY (relative to the rectangle), as one push. UTF-8 outside
+    // ASCII is drawn from the glyph cells (see unicode_text.h).
+    void draw(int16_t x, int16_t y, const char* text, int16_t textX, int16_t textY, uint8_t textSize,
+              uint16_t color, uint16_t background);
+
+    int16_t width() const { return stripW; }
+    int16_t height() const { return stripH; }
+
+private:
+    DisplayGfx* display;
+    DisplaySprite sprite;
+    int16_t stripW;
+    int16_t stripH;
+    bool isReady;
+};
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <stdint.h>
+
+// Sine and cosine in whole degrees, Q14 (16384 is 1.0), from a
+// quarter-wave table the compiler fills in, so needles and arcs are
+// placed without any float or libm call at run time.
+
+// Taylor series of sin(x), well inside a Q14 step up to pi/2
+constexpr double sineSeries(double x) {
+    return x * (1 - x * x / 6 * (1 - x * x / 20 * (1 - x * x / 42 * (1 - x * x / 72 * (1 - x * x / 110)))));
+}
+
+constexpr int16_t sineEntry(int degrees) {
+    return (int16_t)(sineSeries(degrees * 3.14159265358979323846 / 180) * 16384 + 0.5);
+}
+
+#define SINE_DECADE(d) sineEntry(d), sineEntry(d + 1), sineEntry(d + 2), sineEntry(d + 3), \
+                       sineEntry(d + 4), sineEntry(d + 5), sineEntry(d + 6), sineEntry(d + 7), \
+                       sineEntry(d + 8), sineEntry(d + 9)
+
+// sin(0..90 degrees)
+static constexpr int16_t SINE_QUARTER[91] = {
+    SINE_DECADE(0), SINE_DECADE(10), SINE_DECADE(20), SINE_DECADE(30), SINE_DECADE(40),
+    SINE_DECADE(50), SINE_DECADE(60), SINE_DECADE(70), SINE_DECADE(80), sineEntry(90)
+};
+
+#undef SINE_DECADE
+
+static_assert(SINE_QUARTER[30] == 8192 && SINE_QUARTER[90] == 16384, "sine table is off");
+
+// Any angle, negative ones included
+inline int32_t sinQ14(int32_t degrees) {
+    degrees %= 360;
+    if (degrees < 0) degrees += 360;
+    if (degrees <= 90) return SINE_QUARTER[degrees];
+    if (degrees <= 180) return SINE_QUARTER[180 - degrees];
+    if (degrees <= 270) return -SINE_QUARTER[degrees - 180];
+    return -SINE_QUARTER[360 - degrees];
+}
+
+inline int32_t cosQ14(int32_t degrees) {
+    return sinQ14(degrees + 90);
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+// Generated by tools/ui_assets.py; edit the shapes there, not the tables.
+
+#include "rle_image.h"
+
+// Blue disc with the Bluetooth rune, for scanning and connecting, 24x24, 179 bytes for 1152 raw
+static const uint16_t IMAGE_BLUETOOTH_PALETTE[10] = {
+    0x0000, 0xc700, 0x2a01, 0x8e01, 0x6300, 0xd902, 0x9a23, 0x1102,
+    0xffff, 0x3edf,
+};
+static const uint8_t IMAGE_BLUETOOTH_RUNS[179] = {
+    0x80, 0x01, 0x02, 0x13, 0x02, 0x01, 0xe0, 0x04, 0x03, 0x75, 0x03, 0x04, 0xa0, 0x03, 0x45, 0x16,
+    0x45, 0x03, 0x80, 0x07, 0x55, 0x18, 0x06, 0x45, 0x07, 0x60, 0x07, 0x65, 0x28, 0x06, 0x45, 0x07,
+    0x40, 0x03, 0x75, 0x38, 0x06, 0x45, 0x03, 0x20, 0x04, 0x85, 0x18, 0x09, 0x18, 0x06, 0x45, 0x04,
+    0x10, 0x03, 0x45, 0x18, 0x06, 0x05, 0x18, 0x05, 0x09, 0x18, 0x45, 0x03, 0x10, 0x55, 0x28, 0x06,
+    0x18, 0x06, 0x28, 0x55, 0x00, 0x01, 0x55, 0x06, 0x78, 0x06, 0x55, 0x01, 0x02, 0x65, 0x06, 0x58,
+    0x06, 0x65, 0x02, 0x03, 0x75, 0x06, 0x38, 0x06, 0x75, 0x13, 0x75, 0x06, 0x38, 0x06, 0x75, 0x03,
+    0x02, 0x65, 0x06, 0x58, 0x06, 0x65, 0x02, 0x01, 0x55, 0x06, 0x78, 0x06, 0x55, 0x01, 0x00, 0x55,
+    0x28, 0x06, 0x18, 0x06, 0x28, 0x55, 0x10, 0x03, 0x45, 0x18, 0x06, 0x05, 0x18, 0x05, 0x09, 0x18,
+    0x45, 0x03, 0x10, 0x04, 0x85, 0x18, 0x09, 0x18, 0x06, 0x45, 0x04, 0x20, 0x03, 0x75, 0x38, 0x06,
+    0x45, 0x03, 0x40, 0x07, 0x65, 0x28, 0x06, 0x45, 0x07, 0x60, 0x07, 0x55, 0x18, 0x06, 0x45, 0x07,
+    0x80, 0x03, 0x45, 0x16, 0x45, 0x03, 0xa0, 0x04, 0x03, 0x75, 0x03, 0x04, 0xe0, 0x01, 0x02, 0x13,
+    0x02, 0x01, 0x80,
+};
+static const RleImage IMAGE_BLUETOOTH = { 24, 24, IMAGE_BLUETOOTH_PALETTE, IMAGE_BLUETOOTH_RUNS, sizeof(IMAGE_BLUETOOTH_RUNS) };
+
+// The rune struck through in red, for a failed connection, 24x24, 195 bytes for 1152 raw
+static const uint16_t IMAGE_BLUETOOTH_OFF_PALETTE[11] = {
+    0x0000, 0xa210, 0xe318, 0x4529, 0x4108, 0x2842, 0x2862, 0xa649,
+    0x87fa, 0x8631, 0x67e2,
+};
+static const uint8_t IMAGE_BLUETOOTH_OFF_RUNS[195] = {
+    0x80, 0x01, 0x02, 0x13, 0x02, 0x01, 0xe0, 0x04, 0x03, 0x75, 0x03, 0x04, 0xa0, 0x03, 0x45, 0x16,
+    0x45, 0x03, 0x80, 0x07, 0x55, 0x18, 0x06, 0x45, 0x09, 0x60, 0x07, 0x18, 0x06, 0x35, 0x28, 0x06,
+    0x45, 0x09, 0x40, 0x03, 0x05, 0x28, 0x06, 0x25, 0x38, 0x06, 0x45, 0x03, 0x20, 0x04, 0x15, 0x06,
+    0x28, 0x06, 0x15, 0x18, 0x0a, 0x18, 0x06, 0x45, 0x04, 0x10, 0x03, 0x25, 0x06, 0x28, 0x06, 0x05,
+    0x18, 0x05, 0x0a, 0x18, 0x45, 0x03, 0x10, 0x45, 0x06, 0x28, 0x06, 0x18, 0x06, 0x28, 0x55, 0x00,
+    0x01, 0x55, 0x06, 0x78, 0x06, 0x55, 0x01, 0x02, 0x65, 0x06, 0x58, 0x06, 0x65, 0x02, 0x03, 0x75,
+    0x06, 0x38, 0x06, 0x75, 0x13, 0x75, 0x06, 0x38, 0x06, 0x75, 0x03, 0x02, 0x65, 0x06, 0x58, 0x06,
+    0x65, 0x02, 0x01, 0x55, 0x06, 0x78, 0x06, 0x55, 0x01, 0x00, 0x55, 0x28, 0x06, 0x18, 0x06, 0x28,
+    0x06, 0x45, 0x10, 0x03, 0x45, 0x18, 0x06, 0x05, 0x18, 0x05, 0x0a, 0x28, 0x06, 0x25, 0x03, 0x10,
+    0x04, 0x85, 0x18, 0x0a, 0x48, 0x06, 0x15, 0x04, 0x20, 0x03, 0x75, 0x38, 0x16, 0x28, 0x05, 0x03,
+    0x40, 0x09, 0x65, 0x28, 0x06, 0x15, 0x06, 0x18, 0x07, 0x60, 0x09, 0x55, 0x18, 0x06, 0x45, 0x07,
+    0x80, 0x03, 0x45, 0x16, 0x45, 0x03, 0xa0, 0x04, 0x03, 0x75, 0x03, 0x04, 0xe0, 0x01, 0x02, 0x13,
+    0x02, 0x01, 0x80,
+};
+static const RleImage IMAGE_BLUETOOTH_OFF = { 24, 24, IMAGE_BLUETOOTH_OFF_PALETTE, IMAGE_BLUETOOTH_OFF_RUNS, sizeof(IMAGE_BLUETOOTH_OFF_RUNS) };
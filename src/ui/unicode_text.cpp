@@ -0,0 +1,304 @@
+#include "unicode_text.h"
+#include "../log.h"
+#include "../system/memory.h"
+
+#include <string.h>
+
+// The efont the M5GFX build rasterizes from; only this one is linked in.
+// Pick the script and size with e.g. -DUNICODE_TEXT_FONT=efontKR_16.
+#ifndef UNICODE_TEXT_FONT
+#define UNICODE_TEXT_FONT efontJA_12
+#endif
+
+static const uint16_t NONE = 0xFFFF;
+static const uint32_t REPLACEMENT = 0xFFFD;
+static const uint32_t HASH_MULTIPLIER = 2654435761u;
+
+struct GlyphCell {
+    uint32_t codepoint;
+    uint16_t older;              // Least recently used order
+    uint16_t newer;
+    uint16_t chain;              // Next cell in the same hash bucket
+    uint8_t advance;
+};
+
+static DisplaySprite* scratch = nullptr;
+static GlyphCell* cells = nullptr;
+static uint8_t* bitmaps = nullptr;       // XBM: 1 bit a pixel, LSB first, rows of (advance + 7) / 8 bytes
+static uint16_t* buckets = nullptr;
+static uint16_t bucketMask = 0;
+static uint16_t cellCount = 0;
+static uint16_t newest = NONE;
+static uint16_t oldest = NONE;
+static int16_t glyphHeight = 8;
+static int16_t cellWidth = 6;
+static uint16_t cellBytes = 0;
+static UnicodeTextStats stats;
+
+bool utf8HasNonAscii(const char* text) {
+    for (const char* c = text; *c; c++) {
+        if ((uint8_t)*c >= 0x80) return true;
+    }
+    return false;
+}
+
+uint32_t utf8Next(const char*& text) {
+    static const uint32_t SMALLEST[4] = { 0, 0x80, 0x800, 0x10000 };
+    uint8_t lead = (uint8_t)*text;
+    if (lead == 0) return 0;
+    text++;
+    if (lead < 0x80) return lead;
+
+    uint8_t extra;
+    uint32_t codepoint;
+    if ((lead & 0xE0) == 0xC0) {
+        extra = 1;
+        codepoint = lead & 0x1F;
+    } else if ((lead & 0xF0) == 0xE0) {
+        extra = 2;
+        codepoint = lead & 0x0F;
+    } else if ((lead & 0xF8) == 0xF0) {
+        extra = 3;
+        codepoint = lead & 0x07;
+    } else {
+        return REPLACEMENT;
+    }
+    for (uint8_t i = 0; i < extra; i++) {
+        uint8_t next = (uint8_t)*text;
+        if ((next & 0xC0) != 0x80) return REPLACEMENT;
+        codepoint = codepoint << 6 | (next & 0x3F);
+        text++;
+    }
+    // Overlong forms, surrogates and beyond Unicode are not characters
+    if (codepoint < SMALLEST[extra] || codepoint > 0x10FFFF || (codepoint >= 0xD800 && codepoint <= 0xDFFF)) {
+        return REPLACEMENT;
+    }
+    return codepoint;
+}
+
+void utf8Trim(char* text) {
+    size_t length = strlen(text);
+    size_t start = length;
+    while (start > 0 && length - start < 3 && ((uint8_t)text[start - 1] & 0xC0) == 0x80) start--;
+    if (start == 0) return;
+    uint8_t lead = (uint8_t)text[start - 1];
+    if (lead < 0xC0) return;
+    size_t expected = lead >= 0xF0 ? 4 : lead >= 0xE0 ? 3 : 2;
+    if (length - (start - 1) < expected) text[start - 1] = '\0';
+}
+
+#ifdef DISPLAY_M5GFX
+static void encodeUtf8(uint32_t codepoint, char* out) {
+    if (codepoint < 0x80) {
+        *out++ = (char)codepoint;
+    } else if (codepoint < 0x800) {
+        *out++ = (char)(0xC0 | codepoint >> 6);
+        *out++ = (char)(0x80 | (codepoint & 0x3F));
+    } else if (codepoint < 0x10000) {
+        *out++ = (char)(0xE0 | codepoint >> 12);
+        *out++ = (char)(0x80 | ((codepoint >> 6) & 0x3F));
+        *out++ = (char)(0x80 | (codepoint & 0x3F));
+    } else {
+        *out++ = (char)(0xF0 | codepoint >> 18);
+        *out++ = (char)(0x80 | ((codepoint >> 12) & 0x3F));
+        *out++ = (char)(0x80 | ((codepoint >> 6) & 0x3F));
+        *out++ = (char)(0x80 | (codepoint & 0x3F));
+    }
+    *out = '\0';
+}
+#endif
+
+bool unicodeTextBegin(DisplayGfx* display, uint16_t count) {
+    if (cells || count == 0 || count == NONE) return cells != nullptr;
+
+    scratch = new DisplaySprite(display);
+#ifdef DISPLAY_M5GFX
+    scratch->setFont(&fonts::UNICODE_TEXT_FONT);
+    glyphHeight = scratch->fontHeight();
+    cellWidth = glyphHeight;     // efont's full-width glyphs are square
+#else
+    glyphHeight = 8;
+    cellWidth = 6;
+#endif
+    scratch->setColorDepth(16);
+    scratch->setTextWrap(false);
+    if (scratch->createSprite(cellWidth, glyphHeight) == nullptr) {
+        LOG_E(UI, "No memory for the %dx%d glyph sprite", cellWidth, glyphHeight);
+        delete scratch;
+        scratch = nullptr;
+        return false;
+    }
+
+    uint16_t bucketCount = 1;
+    while (bucketCount < count) bucketCount <<= 1;
+    cellBytes = (uint16_t)(((cellWidth + 7) / 8) * glyphHeight);
+    cells = (GlyphCell*)memoryAlloc(count * sizeof(GlyphCell), MEMORY_BULK, MEMORY_TAG_UI);
+    bitmaps = (uint8_t*)memoryAlloc((size_t)count * cellBytes, MEMORY_BULK, MEMORY_TAG_UI);
+    buckets = (uint16_t*)memoryAlloc(bucketCount * sizeof(uint16_t), MEMORY_BULK, MEMORY_TAG_UI);
+    if (!cells || !bitmaps || !buckets) {
+        LOG_E(UI, "No memory for %u glyph cells", count);
+        memoryFree(cells);
+        memoryFree(bitmaps);
+        memoryFree(buckets);
+        cells = nullptr;
+        bitmaps = nullptr;
+        buckets = nullptr;
+        scratch->deleteSprite();
+        delete scratch;
+        scratch = nullptr;
+        return false;
+    }
+    for (uint16_t i = 0; i < bucketCount; i++) buckets[i] = NONE;
+    bucketMask = bucketCount - 1;
+    cellCount = count;
+    memset(&stats, 0, sizeof(stats));
+    stats.cells = count;
+    LOG_I(UI, "Glyph cells: %u of %dx%d, %u bytes", count, cellWidth, glyphHeight,
+          (unsigned)(count * (sizeof(GlyphCell) + cellBytes) + bucketCount * sizeof(uint16_t)));
+    return true;
+}
+
+bool unicodeTextReady() {
+    return cells != nullptr;
+}
+
+const UnicodeTextStats& unicodeTextStats() {
+    return stats;
+}
+
+static uint16_t bucketOf(uint32_t codepoint) {
+    return (uint16_t)((codepoint * HASH_MULTIPLIER) >> 16) & bucketMask;
+}
+
+static void unlinkCell(uint16_t i) {
+    GlyphCell& cell = cells[i];
+    if (cell.older != NONE) cells[cell.older].newer = cell.newer; else oldest = cell.newer;
+    if (cell.newer != NONE) cells[cell.newer].older = cell.older; else newest = cell.older;
+}
+
+static void linkNewest(uint16_t i) {
+    cells[i].older = newest;
+    cells[i].newer = NONE;
+    if (newest != NONE) cells[newest].newer = i; else oldest = i;
+    newest = i;
+}
+
+static void unchainCell(uint16_t i) {
+    uint16_t* link = &buckets[bucketOf(cells[i].codepoint)];
+    while (*link != NONE && *link != i) link = &cells[*link].chain;
+    if (*link == i) *link = cells[i].chain;
+}
+
+// Draw the glyph into the scratch sprite and keep its set pixels
+static void rasterize(uint16_t i, uint32_t codepoint) {
+    scratch->fillSprite(BLACK);
+#ifdef DISPLAY_M5GFX
+    char utf8[5];
+    encodeUtf8(codepoint, utf8);
+    int16_t advance = scratch->textWidth(utf8);
+    if (advance <= 0) {
+        // Not in the font
+        utf8[0] = '?';
+        utf8[1] = '\0';
+        advance = scratch->textWidth(utf8);
+    }
+    scratch->setTextColor(WHITE, BLACK);
+    scratch->drawString(utf8, 0, 0);
+#else
+    char c = codepoint < 0x80 ? (char)codepoint : '?';
+    int16_t advance = cellWidth;
+    scratch->drawChar(0, 0, c, WHITE, BLACK, 1);
+#endif
+    if (advance > cellWidth) advance = cellWidth;
+
+    uint8_t* bits = bitmaps + (size_t)i * cellBytes;
+    int16_t stride = (advance + 7) / 8;
+    memset(bits, 0, cellBytes);
+    for (int16_t y = 0; y < glyphHeight; y++) {
+        for (int16_t x = 0; x < advance; x++) {
+            if (scratch->readPixel(x, y) != 0) bits[y * stride + x / 8] |= 1 << (x & 7);
+        }
+    }
+    cells[i].advance = (uint8_t)advance;
+}
+
+// The cell holding a glyph, rasterizing it into the least recently used
+// cell if it is not cached
+static uint16_t glyphCell(uint32_t codepoint) {
+    uint16_t bucket = bucketOf(codepoint);
+    for (uint16_t i = buckets[bucket]; i != NONE; i = cells[i].chain) {
+        if (cells[i].codepoint != codepoint) continue;
+        if (i != newest) {
+            unlinkCell(i);
+            linkNewest(i);
+        }
+        stats.hits++;
+        return i;
+    }
+
+    uint16_t i;
+    if (stats.used < cellCount) {
+        i = stats.used++;
+    } else {
+        i = oldest;
+        unchainCell(i);
+        unlinkCell(i);
+        stats.evictions++;
+    }
+    stats.misses++;
+    cells[i].codepoint = codepoint;
+    cells[i].chain = buckets[bucket];
+    buckets[bucket] = i;
+    rasterize(i, codepoint);
+    linkNewest(i);
+    return i;
+}
+
+static int16_t scaleFor(uint8_t textSize) {
+    int16_t scale = (8 * textSize + glyphHeight / 2) / glyphHeight;
+    return scale > 0 ? scale : 1;
+}
+
+int16_t unicodeTextHeight(uint8_t textSize) {
+    if (!cells) return 8 * textSize;
+    return glyphHeight * scaleFor(textSize);
+}
+
+int16_t unicodeTextWidth(const char* text, uint8_t textSize) {
+    if (!cells) return (int16_t)(strlen(text) * 6 * textSize);
+    int16_t width = 0;
+    for (uint32_t c = utf8Next(text); c != 0; c = utf8Next(text)) width += cells[glyphCell(c)].advance;
+    return width * scaleFor(textSize);
+}
+
+void unicodeTextDraw(DisplayGfx* target, const char* text, int16_t x, int16_t y, uint8_t textSize, uint16_t color,
+                     uint16_t background) {
+    if (!cells) {
+        target->setTextSize(textSize);
+        target->setTextColor(color, background);
+        target->setCursor(x, y);
+        target->print(text);
+        return;
+    }
+    int16_t scale = scaleFor(textSize);
+    for (uint32_t c = utf8Next(text); c != 0; c = utf8Next(text)) {
+        uint16_t i = glyphCell(c);
+        const uint8_t* bits = bitmaps + (size_t)i * cellBytes;
+        int16_t advance = cells[i].advance;
+        if (scale == 1) {
+            target->drawXBitmap(x, y, bits, advance, glyphHeight, color, background);
+        } else {
+            // Larger sizes are rare enough to draw a block per pixel
+            int16_t stride = (advance + 7) / 8;
+            target->fillRect(x, y, advance * scale, glyphHeight * scale, background);
+            for (int16_t row = 0; row < glyphHeight; row++) {
+                for (int16_t column = 0; column < advance; column++) {
+                    if (bits[row * stride + column / 8] & (1 << (column & 7))) {
+                        target->fillRect(x + column * scale, y + row * scale, scale, scale, color);
+                    }
+                }
+            }
+        }
+        x += advance * scale;
+    }
+}
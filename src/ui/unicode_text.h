@@ -0,0 +1,57 @@
+#pragma once
+
+#include "display.h"
+
+// UTF-8 text for the strings the built-in font cannot show: layout
+// labels and BLE device names in other scripts. ASCII text never comes
+// here and is drawn as before.
+//
+// Glyphs come from one efont bitmap font in the M5GFX build (which one,
+// and so the script and size, is UNICODE_TEXT_FONT at build time; the
+// M5.Lcd build has only the built-in font and shows other characters as
+// '?'). Each glyph is rasterized the first time it is drawn into a 1-bit
+// cell in PSRAM. A fixed number of cells is kept, and a glyph not yet
+// cached takes the least recently used one. So a large character set
+// costs only the cells of the glyphs in use. Once a string's glyphs are
+// in, drawing it is one hash lookup and one bitmap blit per character.
+//
+// UI task only.
+
+struct UnicodeTextStats {
+    uint32_t hits;
+    uint32_t misses;             // Glyphs rasterized
+    uint32_t evictions;          // ...into a cell taken from another glyph
+    uint16_t cells;
+    uint16_t used;
+};
+
+// Allocate cells for that many glyphs and measure the font. Returns
+// false if the memory could not be had; non-ASCII text is then printed
+// with the built-in font.
+bool unicodeTextBegin(DisplayGfx* display, uint16_t cells);
+
+bool unicodeTextReady();
+
+// True if the text needs the cache: any byte outside ASCII
+bool utf8HasNonAscii(const char* text);
+
+// Next code point of text, moving text past it; U+FFFD for a malformed
+// or cut-off sequence, 0 at the end
+uint32_t utf8Next(const char*& text);
+
+// Cut a string back to whole characters, after a copy that may have
+// stopped inside one
+void utf8Trim(char* text);
+
+// Line height and exact width of text drawn at a built-in text size.
+// The font is scaled by whole steps to about the built-in font's height
+// at that size.
+int16_t unicodeTextHeight(uint8_t textSize);
+int16_t unicodeTextWidth(const char* text, uint8_t textSize);
+
+// Draw text with its top-left corner at (x, y), each glyph over its
+// background. target may be the panel or a sprite.
+void unicodeTextDraw(DisplayGfx* target, const char* text, int16_t x, int16_t y, uint8_t textSize, uint16_t color,
+                     uint16_t background);
+
+const UnicodeTextStats& unicodeTextStats();
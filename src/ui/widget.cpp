@@ -0,0 +1,61 @@
+#include "widget.h"
+
+Widget::Widget(DisplayGfx* display, int16_t x, int16_t y, int16_t w, int16_t h)
+    : panel(display, x, y, w, h), dirty(true) {
+}
+
+bool Widget::paint() {
+    if (!dirty) return false;
+    render(panel);
+    panel.push();
+    dirty = false;
+    return true;
+}
+
+Compositor::Compositor() : count(0) {
+}
+
+bool Compositor::add(Widget* widget) {
+    if (count >= MAX_WIDGETS) return false;
+    widgets[count++] = widget;
+    return true;
+}
+
+void Compositor::begin() {
+    for (int i = 0; i < count; i++) {
+        widgets[i]->begin();
+    }
+}
+
+void Compositor::invalidateAll() {
+    for (int i = 0; i < count; i++) {
+        widgets[i]->invalidate();
+    }
+}
+
+void Compositor::invalidateUnretained() {
+    for (int i = 0; i < count; i++) {
+        if (!widgets[i]->retainable()) widgets[i]->invalidate();
+    }
+}
+
+int Compositor::prerender(DisplaySprite& image) {
+    int rendered = 0;
+    for (int i = 0; i < count; i++) {
+        if (!widgets[i]->retainable()) continue;
+        widgets[i]->paintOffscreen();
+        widgets[i]->copyTo(image);
+        rendered++;
+    }
+    return rendered;
+}
+
+int Compositor::frame(DisplaySprite* mirror) {
+    int painted = 0;
+    for (int i = 0; i < count; i++) {
+        if (!widgets[i]->paint()) continue;
+        painted++;
+        if (mirror && widgets[i]->retainable()) widgets[i]->copyTo(*mirror);
+    }
+    return painted;
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include "display.h"
+#include "sprite_panel.h"
+
+// A rectangular piece of UI that owns its bounds, remembers what it last
+// rendered and knows when that is out of date. Subclasses decide what
+// makes them dirty (usually a changed value) and how to draw themselves
+// into their sprite; the compositor repaints only dirty widgets.
+class Widget {
+public:
+    Widget(DisplayGfx* display, int16_t x, int16_t y, int16_t w, int16_t h);
+    virtual ~Widget() {}
+
+    // Allocate the widget's buffer
+    virtual bool begin() { return panel.begin(); }
+
+    // Force a repaint on the next frame (e.g. after the screen was cleared)
+    virtual void invalidate() { dirty = true; }
+    bool isDirty() const { return dirty; }
+
+    // Render into the sprite and push it if dirty. Returns true if it drew.
+    virtual bool paint();
+
+    // Whether what the widget shows can be copied into a retained screen
+    // image; widgets drawing straight to the LCD cannot
+    virtual bool retainable() const { return panel.ready(); }
+    bool copyTo(DisplaySprite& target) { return panel.copyTo(target); }
+
+    // Render into the sprite without pushing it, for a screen image
+    // painted before the screen is shown (see Screen::prerender())
+    void paintOffscreen() {
+        render(panel);
+        dirty = false;
+    }
+
+    int16_t x() const { return panel.x(); }
+    int16_t y() const { return panel.y(); }
+    int16_t width() const { return panel.width(); }
+    int16_t height() const { return panel.height(); }
+
+protected:
+    // Draw the whole widget; coordinates are relative to the widget
+    virtual void render(SpritePanel& panel) = 0;
+
+    SpritePanel panel;
+    bool dirty;
+};
+
+// Repaints the dirty widgets of one screen in a single pass
+class Compositor {
+public:
+    static const int MAX_WIDGETS = 24;
+
+    Compositor();
+
+    bool add(Widget* widget);
+
+    // Allocate every widget's buffer
+    void begin();
+
+    // Mark everything dirty, e.g. when the screen is entered
+    void invalidateAll();
+
+    // Mark the widgets a retained screen image cannot restore
+    void invalidateUnretained();
+
+    // Paint all dirty widgets, copying each into mirror if given. Returns
+    // how many were repainted.
+    int frame(DisplaySprite* mirror = nullptr);
+
+    // Render every retainable widget off-screen and copy it into image,
+    // leaving the display alone; the others stay dirty. Returns how many
+    // were rendered.
+    int prerender(DisplaySprite& image);
+
+private:
+    Widget* widgets[MAX_WIDGETS];
+    int count;
+};
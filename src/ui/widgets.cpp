@@ -0,0 +1,175 @@
+#include "widgets.h"
+#include "unicode_text.h"
+#include "../telemetry/fixed_point.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+static const uint16_t STALE_MARK_COLOR = DARKGREY;
+static const int16_t STALE_MARK_SIZE = 4;
+
+TextWidget::TextWidget(DisplayGfx* display, int16_t x, int16_t y, int16_t w, int16_t h,
+                       uint8_t textSize, TextAlign align)
+    : Widget(display, x, y, w, h), color(WHITE), textSize(textSize), align(align) {
+    text[0] = '\0';
+}
+
+void TextWidget::setText(const char* newText, uint16_t newColor) {
+    if (newColor != color) {
+        color = newColor;
+        dirty = true;
+    }
+    if (strncmp(newText, text, MAX_TEXT) != 0) {
+        strncpy(text, newText, MAX_TEXT - 1);
+        text[MAX_TEXT - 1] = '\0';
+        utf8Trim(text);
+        dirty = true;
+    }
+}
+
+void TextWidget::setColor(uint16_t newColor) {
+    if (newColor != color) {
+        color = newColor;
+        dirty = true;
+    }
+}
+
+void TextWidget::render(SpritePanel& panel) {
+    DisplaySprite& canvas = panel.canvas();
+    canvas.fillSprite(BLACK);
+    canvas.setTextSize(textSize);
+    canvas.setTextColor(color, BLACK);
+
+    // Other scripts, from the glyph cells
+    if (utf8HasNonAscii(text)) {
+        int16_t width = unicodeTextWidth(text, textSize);
+        int16_t textX = align == ALIGN_CENTER ? (panel.width() - width) / 2
+                      : align == ALIGN_RIGHT  ? panel.width() - width : 0;
+        unicodeTextDraw(&canvas, text, textX, (panel.height() - unicodeTextHeight(textSize)) / 2, textSize, color,
+                        BLACK);
+        return;
+    }
+
+    int16_t textY = (panel.height() - 8 * textSize) / 2;
+    if (align == ALIGN_CENTER) {
+        panel.drawCentered(text, textY, textSize, color, BLACK);
+        return;
+    }
+
+    int16_t textX = 0;
+    if (align == ALIGN_RIGHT) {
+        textX = panel.width() - canvas.textWidth(text);
+    }
+    canvas.setCursor(textX, textY);
+    canvas.print(text);
+}
+
+ValueWidget::ValueWidget(DisplayGfx* display, int16_t x, int16_t y, int16_t w, int16_t h,
+                         uint8_t textSize, TextAlign align, int32_t threshold, uint8_t decimals,
+                         const char* prefix, const char* suffix)
+    : TextWidget(display, x, y, w, h, textSize, align), shownValue(0), hasValue(false),
+      threshold(threshold), decimals(decimals), prefix(prefix), suffix(suffix) {
+}
+
+void ValueWidget::setValue(int32_t value) {
+    if (hasValue && labs(value - shownValue) <= threshold) return;
+
+    char number[16];
+    formatFixed(number, sizeof(number), value, decimals);
+    char buffer[MAX_TEXT];
+    snprintf(buffer, sizeof(buffer), "%s%s%s", prefix, number, suffix);
+    setText(buffer, color);
+    shownValue = value;
+    hasValue = true;
+}
+
+GlyphValueWidget::GlyphValueWidget(DisplayGfx* display, int16_t x, int16_t y, int16_t w, int16_t h,
+                                   GlyphCache& glyphs, int32_t threshold, uint8_t decimals,
+                                   const char* prefix, const char* suffix)
+    : ValueWidget(display, x, y, w, h, glyphs.size(), ALIGN_CENTER, threshold, decimals,
+                  prefix, suffix),
+      display(display), glyphs(glyphs), cached(false), cleared(false), stale(false), markShown(false),
+      shownLeft(0), shownRight(0) {
+    shownText[0] = '\0';
+}
+
+bool GlyphValueWidget::begin() {
+    cached = glyphs.begin(display);
+    if (cached) return true;
+    return ValueWidget::begin();
+}
+
+void GlyphValueWidget::invalidate() {
+    // The screen under the widget is unknown, so clear it and redraw every glyph
+    cleared = false;
+    dirty = true;
+}
+
+void GlyphValueWidget::setStale(bool nowStale) {
+    if (nowStale == stale) return;
+    stale = nowStale;
+    dirty = true;
+}
+
+// A dot in the top right corner, clear of the centered text, drawn or
+// cleared when it changes
+void GlyphValueWidget::paintStaleMark() {
+    if (stale == markShown) return;
+    uint16_t background = cached ? glyphs.background() : BLACK;
+    display->fillRect(x() + width() - STALE_MARK_SIZE - 1, y() + 1, STALE_MARK_SIZE, STALE_MARK_SIZE,
+                      stale ? STALE_MARK_COLOR : background);
+    markShown = stale;
+}
+
+bool GlyphValueWidget::paint() {
+    if (!cached) {
+        if (!ValueWidget::paint()) return false;
+        markShown = false;   // Under the sprite now
+        paintStaleMark();
+        return true;
+    }
+    if (!dirty) return false;
+
+    uint16_t background = glyphs.background();
+    display->startWrite();
+    if (!cleared) {
+        display->fillRect(x(), y(), width(), height(), background);
+        shownText[0] = '\0';
+        shownLeft = shownRight = x();
+        markShown = false;
+        cleared = true;
+    }
+
+    int16_t left = x() + (width() - glyphs.textWidth(text)) / 2;
+    int16_t top = y() + (height() - glyphs.height()) / 2;
+    int16_t penX = left;
+    bool ended = false;
+    size_t i = 0;
+    for (; text[i] != '\0'; i++) {
+        // Once the old string has ended every later slot is new
+        if (shownText[i] == '\0') ended = true;
+        if (ended || shownText[i] != text[i] || shownX[i] != penX) {
+            glyphs.draw(display, text[i], penX, top);
+        }
+        shownText[i] = text[i];
+        shownX[i] = penX;
+        penX += glyphs.glyphWidth(text[i]);
+    }
+    shownText[i] = '\0';
+
+    // Clear whatever the previous string covered outside the new one
+    if (shownLeft < left) {
+        display->fillRect(shownLeft, top, left - shownLeft, glyphs.height(), background);
+    }
+    if (shownRight > penX) {
+        display->fillRect(penX, top, shownRight - penX, glyphs.height(), background);
+    }
+    shownLeft = left;
+    shownRight = penX;
+    paintStaleMark();
+    display->endWrite();
+
+    dirty = false;
+    return true;
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include "widget.h"
+#include "glyph_cache.h"
+
+enum TextAlign : uint8_t {
+    ALIGN_LEFT,
+    ALIGN_CENTER,
+    ALIGN_RIGHT
+};
+
+// Single line of text, vertically centered. Repaints only when the text
+// or its color changes. Text outside ASCII is drawn from the glyph
+// cells (see unicode_text.h).
+class TextWidget : public Widget {
+public:
+    static const size_t MAX_TEXT = 40;
+
+    TextWidget(DisplayGfx* display, int16_t x, int16_t y, int16_t w, int16_t h,
+               uint8_t textSize, TextAlign align);
+
+    void setText(const char* text, uint16_t color);
+    void setColor(uint16_t color);
+
+protected:
+    void render(SpritePanel& panel);
+
+    char text[MAX_TEXT];
+    uint16_t color;
+    uint8_t textSize;
+    TextAlign align;
+};
+
+// Fixed-point number with a prefix and suffix ("FET: 98.6F"). Values are
+// scaled integers with the given number of decimals (481 with 1 decimal
+// shows "48.1"). The text is only reformatted when the value moves by
+// more than the threshold, in the same scaled units, which keeps sensor
+// noise from repainting the widget every sample.
+class ValueWidget : public TextWidget {
+public:
+    ValueWidget(DisplayGfx* display, int16_t x, int16_t y, int16_t w, int16_t h,
+                uint8_t textSize, TextAlign align, int32_t threshold, uint8_t decimals,
+                const char* prefix, const char* suffix);
+
+    void setValue(int32_t value);
+
+    // Format the next value even if it has not moved, e.g. once the
+    // suffix's text has changed
+    void reformat() { hasValue = false; }
+
+private:
+    int32_t shownValue;
+    bool hasValue;
+    int32_t threshold;
+    uint8_t decimals;
+    const char* prefix;
+    const char* suffix;
+};
+
+// ValueWidget for the big readouts. Text is drawn from a GlyphCache
+// straight to the LCD, one glyph at a time, and only the glyphs whose
+// character or position changed since the last paint are re-blitted.
+// Falls back to the sprite path if the cache could not be allocated.
+class GlyphValueWidget : public ValueWidget {
+public:
+    GlyphValueWidget(DisplayGfx* display, int16_t x, int16_t y, int16_t w, int16_t h,
+                     GlyphCache& glyphs, int32_t threshold, uint8_t decimals,
+                     const char* prefix, const char* suffix);
+
+    bool begin();
+    void invalidate();
+    bool paint();
+    bool retainable() const { return !cached && ValueWidget::retainable(); }
+
+    // Mark the value as out of date with a corner dot; the glyphs keep
+    // the color they were rendered in
+    void setStale(bool stale);
+
+private:
+    void paintStaleMark();
+
+    DisplayGfx* display;
+    GlyphCache& glyphs;
+    bool cached;
+    bool cleared;
+    bool stale;
+    bool markShown;
+    char shownText[MAX_TEXT];
+    int16_t shownX[MAX_TEXT];
+    int16_t shownLeft;
+    int16_t shownRight;
+};
@@ -0,0 +1,99 @@
+#include "bms.h"
+#include "buffer.h"
+#include "protocol.h"
+
+#include <string.h>
+
+// Everything before the cells, and after the temperature list
+static const size_t HEAD_SIZE = 1 + 6 * 4 + 1;
+static const size_t TAIL_SIZE = 4 * 2 + 2 * 2 + 1;
+
+// x1e6 on the wire to thousandths
+static int32_t micro(const uint8_t* payload, size_t& index) {
+    int32_t value = bufferGetInt32(payload, index);
+    return value >= 0 ? (value + 500) / 1000 : (value - 500) / 1000;
+}
+
+// x1e2 on the wire to tenths
+static int16_t deci(const uint8_t* payload, size_t& index) {
+    int16_t value = bufferGetInt16(payload, index);
+    return (int16_t)(value >= 0 ? (value + 5) / 10 : (value - 5) / 10);
+}
+
+bool decodeBmsValues(const uint8_t* payload, size_t length, VescBmsValues& out) {
+    if (length < HEAD_SIZE || payload[0] != COMM_BMS_GET_VALUES) return false;
+    size_t index = 1;
+    int32_t packMv = micro(payload, index);
+    int32_t chargeMv = micro(payload, index);
+    int32_t currentMa = micro(payload, index);
+    micro(payload, index);                      // Current the BMS measures itself
+    int32_t ampHoursMah = bufferGetInt32(payload, index);
+    int32_t wattHoursMwh = bufferGetInt32(payload, index);
+    uint8_t cells = bufferGetUint8(payload, index);
+    if (length < index + cells * 3 + 1) return false;
+    size_t tempsAt = index + cells * 3;
+    uint8_t temps = payload[tempsAt];
+    if (length < tempsAt + 1 + temps * 2 + TAIL_SIZE) return false;
+
+    // Checked in full before anything is written
+    out.packMv = packMv;
+    out.chargeMv = chargeMv;
+    out.currentMa = currentMa;
+    out.ampHoursMah = ampHoursMah;
+    out.wattHoursMwh = wattHoursMwh;
+    out.cellCount = cells < VESC_BMS_MAX_CELLS ? cells : VESC_BMS_MAX_CELLS;
+    out.minCell = 0;
+    out.maxCell = 0;
+    for (uint8_t c = 0; c < cells; c++) {
+        int16_t mv = bufferGetInt16(payload, index);
+        if (c >= out.cellCount) continue;
+        out.cellMv[c] = mv > 0 ? (uint16_t)mv : 0;
+        if (out.cellMv[c] < out.cellMv[out.minCell]) out.minCell = c;
+        if (out.cellMv[c] > out.cellMv[out.maxCell]) out.maxCell = c;
+    }
+    memset(out.cellMv + out.cellCount, 0, (VESC_BMS_MAX_CELLS - out.cellCount) * sizeof(out.cellMv[0]));
+    out.balancing = 0;
+    for (uint8_t c = 0; c < cells; c++) {
+        if (bufferGetUint8(payload, index) && c < out.cellCount) out.balancing |= 1u << c;
+    }
+    index++;
+    out.tempCount = temps < VESC_BMS_MAX_TEMPS ? temps : VESC_BMS_MAX_TEMPS;
+    for (uint8_t t = 0; t < temps; t++) {
+        int16_t temp = deci(payload, index);
+        if (t < out.tempCount) out.temps[t] = temp;
+    }
+    out.tempIc = deci(payload, index);
+    deci(payload, index);                       // Humidity sensor's temperature
+    index += 2;                                 // ...and humidity
+    out.tempCellMax = deci(payload, index);
+    out.soc = bufferGetInt16(payload, index);
+    out.soh = bufferGetInt16(payload, index);
+    out.canId = bufferGetUint8(payload, index);
+    return true;
+}
+
+size_t encodeBmsValues(const VescBmsValues& values, uint8_t* payload) {
+    size_t index = 0;
+    bufferAppendUint8(payload, COMM_BMS_GET_VALUES, index);
+    bufferAppendInt32(payload, values.packMv * 1000, index);
+    bufferAppendInt32(payload, values.chargeMv * 1000, index);
+    bufferAppendInt32(payload, values.currentMa * 1000, index);
+    bufferAppendInt32(payload, values.currentMa * 1000, index);
+    bufferAppendInt32(payload, values.ampHoursMah, index);
+    bufferAppendInt32(payload, values.wattHoursMwh, index);
+    uint8_t cells = values.cellCount < VESC_BMS_MAX_CELLS ? values.cellCount : VESC_BMS_MAX_CELLS;
+    bufferAppendUint8(payload, cells, index);
+    for (uint8_t c = 0; c < cells; c++) bufferAppendInt16(payload, (int16_t)values.cellMv[c], index);
+    for (uint8_t c = 0; c < cells; c++) bufferAppendUint8(payload, (values.balancing >> c) & 1, index);
+    uint8_t temps = values.tempCount < VESC_BMS_MAX_TEMPS ? values.tempCount : VESC_BMS_MAX_TEMPS;
+    bufferAppendUint8(payload, temps, index);
+    for (uint8_t t = 0; t < temps; t++) bufferAppendInt16(payload, (int16_t)(values.temps[t] * 10), index);
+    bufferAppendInt16(payload, (int16_t)(values.tempIc * 10), index);
+    bufferAppendInt16(payload, 0, index);
+    bufferAppendInt16(payload, 0, index);
+    bufferAppendInt16(payload, (int16_t)(values.tempCellMax * 10), index);
+    bufferAppendInt16(payload, values.soc, index);
+    bufferAppendInt16(payload, values.soh, index);
+    bufferAppendUint8(payload, values.canId, index);
+    return index;
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+// COMM_BMS_GET_VALUES: what a VESC-compatible BMS on the CAN bus last
+// reported to the controller, which keeps it and answers for it. The
+// request has no arguments; the reply (bms_send_values() in the VESC
+// firmware) is
+//   v_tot v_charge i_in i_in_ic:f32 (x1e6)  ah wh:f32 (x1e3)
+//   cell_num:u8  v_cell[cell_num]:f16 (x1e3)  bal_state[cell_num]:u8
+//   temp_num:u8  temps[temp_num]:f16 (x1e2)  temp_ic temp_hum hum temp_max_cell:f16 (x1e2)
+//   soc soh:f16 (x1e3)  can_id:u8  ...
+// Firmware without a BMS heard answers with no cells.
+
+static const uint8_t VESC_BMS_MAX_CELLS = 32;
+static const uint8_t VESC_BMS_MAX_TEMPS = 8;    // The rest of a longer list is skipped
+
+struct VescBmsValues {
+    int32_t packMv;             // Sum of the cells
+    int32_t chargeMv;           // At the charge port
+    int32_t currentMa;          // Into the pack, negative when discharging
+    int32_t ampHoursMah;        // Counted by the BMS
+    int32_t wattHoursMwh;
+    uint16_t cellMv[VESC_BMS_MAX_CELLS];
+    uint32_t balancing;         // Bit per cell being bled
+    int16_t temps[VESC_BMS_MAX_TEMPS];  // 0.1 °C, pack sensors
+    int16_t tempIc;             // 0.1 °C
+    int16_t tempCellMax;        // 0.1 °C, hottest cell
+    int16_t soc;                // 0.1 %
+    int16_t soh;                // 0.1 %
+    uint8_t cellCount;
+    uint8_t tempCount;
+    uint8_t canId;
+    uint8_t minCell;            // Index of the lowest cell, and the highest;
+    uint8_t maxCell;            // 0 with no cells
+};
+
+// Decode a reply. Cells past VESC_BMS_MAX_CELLS are dropped. Returns
+// false if the payload is too short for what it says it holds.
+bool decodeBmsValues(const uint8_t* payload, size_t length, VescBmsValues& out);
+
+// Build a reply, for the emulator and the checks. Returns its length;
+// payload needs room for VESC_BMS_MAX_REPLY_SIZE.
+static const size_t VESC_BMS_MAX_REPLY_SIZE = 1 + 24 + 1 + VESC_BMS_MAX_CELLS * 3 + 1 + VESC_BMS_MAX_TEMPS * 2 + 8 + 4 + 1;
+size_t encodeBmsValues(const VescBmsValues& values, uint8_t* payload);
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+// Big-endian field access for VESC payloads, mirroring buffer.c in the
+// VESC firmware. The index is advanced past each field read or written.
+
+inline int16_t bufferGetInt16(const uint8_t* buffer, size_t& index) {
+    int16_t value = (int16_t)(((uint16_t)buffer[index] << 8) | buffer[index + 1]);
+    index += 2;
+    return value;
+}
+
+inline uint16_t bufferGetUint16(const uint8_t* buffer, size_t& index) {
+    uint16_t value = (uint16_t)(((uint16_t)buffer[index] << 8) | buffer[index + 1]);
+    index += 2;
+    return value;
+}
+
+inline int32_t bufferGetInt32(const uint8_t* buffer, size_t& index) {
+    uint32_t value = ((uint32_t)buffer[index] << 24) | ((uint32_t)buffer[index + 1] << 16) |
+                     ((uint32_t)buffer[index + 2] << 8) | buffer[index + 3];
+    index += 4;
+    return (int32_t)value;
+}
+
+inline uint32_t bufferGetUint32(const uint8_t* buffer, size_t& index) {
+    return (uint32_t)bufferGetInt32(buffer, index);
+}
+
+inline uint8_t bufferGetUint8(const uint8_t* buffer, size_t& index) {
+    return buffer[index++];
+}
+
+// A float sent with buffer_append_float32_auto: IEEE 754 single
+// precision with subnormals flushed to zero, so the bits are the float
+inline float bufferGetFloat32Auto(const uint8_t* buffer, size_t& index) {
+    uint32_t bits = bufferGetUint32(buffer, index);
+    if ((bits & 0x7F800000u) == 0) bits &= 0x80000000u;
+    float value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+inline void bufferAppendInt16(uint8_t* buffer, int16_t value, size_t& index) {
+    buffer[index++] = (uint8_t)((uint16_t)value >> 8);
+    buffer[index++] = (uint8_t)value;
+}
+
+inline void bufferAppendUint16(uint8_t* buffer, uint16_t value, size_t& index) {
+    bufferAppendInt16(buffer, (int16_t)value, index);
+}
+
+inline void bufferAppendInt32(uint8_t* buffer, int32_t value, size_t& index) {
+    buffer[index++] = (uint8_t)((uint32_t)value >> 24);
+    buffer[index++] = (uint8_t)((uint32_t)value >> 16);
+    buffer[index++] = (uint8_t)((uint32_t)value >> 8);
+    buffer[index++] = (uint8_t)value;
+}
+
+inline void bufferAppendUint32(uint8_t* buffer, uint32_t value, size_t& index) {
+    bufferAppendInt32(buffer, (int32_t)value, index);
+}
+
+inline void bufferAppendUint8(uint8_t* buffer, uint8_t value, size_t& index) {
+    buffer[index++] = value;
+}
+
+// Fixed-point floats, as buffer_append_float16/32 in the firmware: the
+// value times scale, rounded toward zero
+inline void bufferAppendFloat16(uint8_t* buffer, float value, float scale, size_t& index) {
+    bufferAppendInt16(buffer, (int16_t)(value * scale), index);
+}
+
+inline void bufferAppendFloat32(uint8_t* buffer, float value, float scale, size_t& index) {
+    bufferAppendInt32(buffer, (int32_t)(value * scale), index);
+}
+
+inline void bufferAppendFloat32Auto(uint8_t* buffer, float value, size_t& index) {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    bufferAppendUint32(buffer, bits, index);
+}
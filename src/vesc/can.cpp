@@ -0,0 +1,21 @@
+#include "can.h"
+#include "protocol.h"
+
+#include <string.h>
+
+size_t encodeForwardCan(uint8_t canId, const uint8_t* payload, size_t length, uint8_t* out) {
+    out[0] = COMM_FORWARD_CAN;
+    out[1] = canId;
+    memcpy(out + 2, payload, length);
+    return length + 2;
+}
+
+int decodePingCan(const uint8_t* payload, size_t length, uint8_t* ids, size_t maxIds) {
+    if (length < 1 || payload[0] != COMM_PING_CAN) return -1;
+
+    size_t count = 0;
+    for (size_t i = 1; i < length && count < maxIds; i++) {
+        if (payload[i] <= CAN_ID_MAX) ids[count++] = payload[i];
+    }
+    return (int)count;
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Controllers behind the connected VESC on its CAN bus. A request is
+// wrapped in COMM_FORWARD_CAN and the addressed controller's reply comes
+// back unwrapped, as if the connected VESC had sent it, so replies are
+// told apart by the controller id they carry (see
+// valuesReplyControllerId()).
+
+// CAN ids run 0..253; 255 is broadcast
+#define CAN_ID_MAX 253
+
+// Wrap a request payload for a CAN id: [COMM_FORWARD_CAN][id][payload...].
+// out must have room for length + 2 bytes. Returns the wrapped length.
+size_t encodeForwardCan(uint8_t canId, const uint8_t* payload, size_t length, uint8_t* out);
+
+// Decode a COMM_PING_CAN reply ([62][id][id]...), the ids that answered a
+// ping of the whole bus. Writes at most maxIds ids and returns how many
+// were written, or -1 if the payload is not a ping reply.
+int decodePingCan(const uint8_t* payload, size_t length, uint8_t* ids, size_t maxIds);
@@ -0,0 +1,140 @@
+#include "can_buffer.h"
+#include "crc.h"
+
+#include <string.h>
+
+static const uint8_t SEND_AND_REPLY = 0;    // Process, and answer the sender
+
+VescCanBuffer::VescCanBuffer(uint8_t ownId, FrameSender sender, PayloadHandler handler, void* context)
+    : ownId(ownId), sender(sender), handler(handler), context(context), targetId(0), sent(0), received(0),
+      crcFailures(0), dropped(0) {
+}
+
+size_t VescCanBuffer::framesFor(size_t length) {
+    if (length <= 6) return 1;
+    // 7 bytes a frame up to offset 255 (37 frames, 259 bytes), then 6
+    size_t shortBytes = length < 259 ? length : 259;
+    size_t frames = (shortBytes + 6) / 7;
+    if (length > 259) frames += (length - 259 + 5) / 6;
+    return frames + 1;
+}
+
+bool VescCanBuffer::fill(uint32_t offset, const uint8_t* data, uint8_t length) {
+    uint8_t frame[8];
+    uint32_t id;
+    uint8_t header;
+    if (offset <= 255) {
+        id = (uint32_t)CAN_PACKET_FILL_RX_BUFFER << 8 | targetId;
+        frame[0] = (uint8_t)offset;
+        header = 1;
+    } else {
+        id = (uint32_t)CAN_PACKET_FILL_RX_BUFFER_LONG << 8 | targetId;
+        frame[0] = (uint8_t)(offset >> 8);
+        frame[1] = (uint8_t)offset;
+        header = 2;
+    }
+    memcpy(frame + header, data, length);
+    if (!sender(id, frame, header + length, context)) return false;
+    sent++;
+    return true;
+}
+
+bool VescCanBuffer::send(uint8_t target, const uint8_t* payload, size_t length) {
+    if (length == 0 || length > MAX_PAYLOAD) return false;
+    targetId = target;
+    uint8_t frame[8];
+
+    if (length <= 6) {
+        frame[0] = ownId;
+        frame[1] = SEND_AND_REPLY;
+        memcpy(frame + 2, payload, length);
+        if (!sender((uint32_t)CAN_PACKET_PROCESS_SHORT_BUFFER << 8 | target, frame, length + 2, context)) {
+            return false;
+        }
+        sent++;
+        return true;
+    }
+
+    size_t offset = 0;
+    while (offset < length && offset <= 255) {
+        uint8_t n = length - offset < 7 ? length - offset : 7;
+        if (!fill(offset, payload + offset, n)) return false;
+        offset += n;
+    }
+    while (offset < length) {
+        uint8_t n = length - offset < 6 ? length - offset : 6;
+        if (!fill(offset, payload + offset, n)) return false;
+        offset += n;
+    }
+
+    uint16_t crc = crc16(payload, length);
+    frame[0] = ownId;
+    frame[1] = SEND_AND_REPLY;
+    frame[2] = (uint8_t)(length >> 8);
+    frame[3] = (uint8_t)length;
+    frame[4] = (uint8_t)(crc >> 8);
+    frame[5] = (uint8_t)crc;
+    if (!sender((uint32_t)CAN_PACKET_PROCESS_RX_BUFFER << 8 | target, frame, 6, context)) return false;
+    sent++;
+    return true;
+}
+
+void VescCanBuffer::onFrame(uint32_t id, const uint8_t* data, uint8_t length) {
+    if ((id & 0xFF) != ownId || length > 8) return;
+    switch ((uint8_t)(id >> 8)) {
+        case CAN_PACKET_FILL_RX_BUFFER:
+            if (length < 1 || data[0] + (size_t)length - 1 > MAX_PAYLOAD) {
+                dropped++;
+                return;
+            }
+            memcpy(rx + data[0], data + 1, length - 1);
+            break;
+
+        case CAN_PACKET_FILL_RX_BUFFER_LONG: {
+            if (length < 2) {
+                dropped++;
+                return;
+            }
+            size_t offset = (size_t)data[0] << 8 | data[1];
+            if (offset + length - 2 > MAX_PAYLOAD) {
+                dropped++;
+                return;
+            }
+            memcpy(rx + offset, data + 2, length - 2);
+            break;
+        }
+
+        case CAN_PACKET_PROCESS_RX_BUFFER: {
+            if (length < 6) {
+                dropped++;
+                return;
+            }
+            size_t size = (size_t)data[2] << 8 | data[3];
+            uint16_t crc = (uint16_t)(data[4] << 8 | data[5]);
+            if (size == 0 || size > MAX_PAYLOAD) {
+                dropped++;
+                return;
+            }
+            if (crc16(rx, size) != crc) {
+                crcFailures++;
+                return;
+            }
+            received++;
+            handler(rx, size, context);
+            break;
+        }
+
+        case CAN_PACKET_PROCESS_SHORT_BUFFER:
+            if (length < 3) {
+                dropped++;
+                return;
+            }
+            received++;
+            handler(data + 2, length - 2, context);
+            break;
+
+        default:
+            // Status broadcasts and the like carry the sender's id, not ours
+            break;
+    }
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include "framer.h"
+
+// VESC packets over a CAN bus directly, the way controllers pass them to
+// each other (comm_can_send_buffer() in the VESC firmware). A payload of
+// up to 6 bytes goes in one CAN_PACKET_PROCESS_SHORT_BUFFER frame; a
+// longer one is sent as CAN_PACKET_FILL_RX_BUFFER fragments of 7 bytes
+// (CAN_PACKET_FILL_RX_BUFFER_LONG of 6 past offset 255) into the
+// receiver's buffer, then CAN_PACKET_PROCESS_RX_BUFFER with its length
+// and CRC. Frames use extended ids: packet type << 8 | receiver's CAN id.
+// The VESC answers the same way, addressed to our id.
+//
+// Hardware independent: frames go out through a sender and reassembled
+// payloads come back through a handler.
+class VescCanBuffer {
+public:
+    enum PacketType : uint8_t {
+        CAN_PACKET_FILL_RX_BUFFER = 5,
+        CAN_PACKET_FILL_RX_BUFFER_LONG = 6,
+        CAN_PACKET_PROCESS_RX_BUFFER = 7,
+        CAN_PACKET_PROCESS_SHORT_BUFFER = 8
+    };
+
+    // Send one extended frame. Returns false if it could not be queued.
+    typedef bool (*FrameSender)(uint32_t id, const uint8_t* data, uint8_t length, void* context);
+    // A payload addressed to us, command byte first; valid during the call
+    typedef void (*PayloadHandler)(const uint8_t* payload, size_t length, void* context);
+
+    static const size_t MAX_PAYLOAD = VescFramer::MAX_PAYLOAD;
+
+    VescCanBuffer(uint8_t ownId, FrameSender sender, PayloadHandler handler, void* context = nullptr);
+
+    void setOwnId(uint8_t id) { ownId = id; }
+
+    // CAN frames a payload of length bytes takes
+    static size_t framesFor(size_t length);
+
+    // Send a payload for the controller with CAN id targetId to process
+    // and answer. Returns false if a frame could not be queued; the
+    // receiver then drops the partial buffer on its CRC.
+    bool send(uint8_t targetId, const uint8_t* payload, size_t length);
+
+    // A received extended frame. Frames for other ids are ignored.
+    void onFrame(uint32_t id, const uint8_t* data, uint8_t length);
+
+    uint32_t framesSent() const { return sent; }
+    uint32_t payloadsReceived() const { return received; }
+    uint32_t crcErrors() const { return crcFailures; }
+    uint32_t framesDropped() const { return dropped; }
+
+private:
+    bool fill(uint32_t offset, const uint8_t* data, uint8_t length);
+
+    uint8_t ownId;
+    FrameSender sender;
+    PayloadHandler handler;
+    void* context;
+    uint8_t targetId;           // Of the send() in progress
+    uint32_t sent;
+    uint32_t received;
+    uint32_t crcFailures;
+    uint32_t dropped;
+    uint8_t rx[MAX_PAYLOAD];
+};
@@ -0,0 +1,94 @@
+#include "can_status.h"
+#include "buffer.h"
+
+// The firmware scales currents by 10 and pid_pos by 50; COMM_GET_VALUES
+// has 0.01 A and 0.000001 degrees
+static const int32_t CURRENT_SCALE = 10;
+static const int32_t PID_POS_SCALE = 20000;
+
+bool isCanStatus(uint32_t id) {
+    return canStatusFields((uint8_t)(id >> 8)) != 0 || (id >> 8) == CAN_PACKET_STATUS_6;
+}
+
+uint32_t canStatusFields(uint8_t type) {
+    switch (type) {
+        case CAN_PACKET_STATUS: return VALUES_FIELD_RPM | VALUES_FIELD_CURRENT_MOTOR | VALUES_FIELD_DUTY;
+        case CAN_PACKET_STATUS_2: return VALUES_FIELD_AMP_HOURS | VALUES_FIELD_AMP_HOURS_CHARGED;
+        case CAN_PACKET_STATUS_3: return VALUES_FIELD_WATT_HOURS | VALUES_FIELD_WATT_HOURS_CHARGED;
+        case CAN_PACKET_STATUS_4:
+            return VALUES_FIELD_TEMP_FET | VALUES_FIELD_TEMP_MOTOR | VALUES_FIELD_CURRENT_IN | VALUES_FIELD_PID_POS;
+        case CAN_PACKET_STATUS_5: return VALUES_FIELD_TACHOMETER | VALUES_FIELD_V_IN;
+        default: return 0;
+    }
+}
+
+uint32_t decodeCanStatus(uint32_t id, const uint8_t* data, uint8_t length, VescValues& out) {
+    uint8_t type = (uint8_t)(id >> 8);
+    uint32_t fields = canStatusFields(type);
+    size_t needed = type == CAN_PACKET_STATUS_5 ? 6 : 8;
+    if (fields == 0 || (id >> 16) != 0 || length < needed) return 0;
+
+    size_t index = 0;
+    switch (type) {
+        case CAN_PACKET_STATUS:
+            out.rpm = bufferGetInt32(data, index);
+            out.currentMotor = bufferGetInt16(data, index) * CURRENT_SCALE;
+            out.dutyNow = bufferGetInt16(data, index);
+            break;
+        case CAN_PACKET_STATUS_2:
+            out.ampHours = bufferGetInt32(data, index);
+            out.ampHoursCharged = bufferGetInt32(data, index);
+            break;
+        case CAN_PACKET_STATUS_3:
+            out.wattHours = bufferGetInt32(data, index);
+            out.wattHoursCharged = bufferGetInt32(data, index);
+            break;
+        case CAN_PACKET_STATUS_4:
+            out.tempFet = bufferGetInt16(data, index);
+            out.tempMotor = bufferGetInt16(data, index);
+            out.currentIn = bufferGetInt16(data, index) * CURRENT_SCALE;
+            out.pidPos = bufferGetInt16(data, index) * PID_POS_SCALE;
+            break;
+        case CAN_PACKET_STATUS_5:
+            out.tachometer = bufferGetInt32(data, index);
+            out.vIn = bufferGetInt16(data, index);
+            break;
+    }
+    out.controllerId = canStatusSender(id);
+    out.fields |= fields | VALUES_FIELD_CONTROLLER_ID;
+    return fields;
+}
+
+uint8_t encodeCanStatus(uint8_t type, uint8_t canId, const VescValues& values, uint32_t& id, uint8_t* data) {
+    size_t index = 0;
+    switch (type) {
+        case CAN_PACKET_STATUS:
+            bufferAppendInt32(data, values.rpm, index);
+            bufferAppendInt16(data, (int16_t)(values.currentMotor / CURRENT_SCALE), index);
+            bufferAppendInt16(data, values.dutyNow, index);
+            break;
+        case CAN_PACKET_STATUS_2:
+            bufferAppendInt32(data, values.ampHours, index);
+            bufferAppendInt32(data, values.ampHoursCharged, index);
+            break;
+        case CAN_PACKET_STATUS_3:
+            bufferAppendInt32(data, values.wattHours, index);
+            bufferAppendInt32(data, values.wattHoursCharged, index);
+            break;
+        case CAN_PACKET_STATUS_4:
+            bufferAppendInt16(data, values.tempFet, index);
+            bufferAppendInt16(data, values.tempMotor, index);
+            bufferAppendInt16(data, (int16_t)(values.currentIn / CURRENT_SCALE), index);
+            bufferAppendInt16(data, (int16_t)(values.pidPos / PID_POS_SCALE), index);
+            break;
+        case CAN_PACKET_STATUS_5:
+            bufferAppendInt32(data, values.tachometer, index);
+            bufferAppendInt16(data, values.vIn, index);
+            bufferAppendInt16(data, 0, index);
+            break;
+        default:
+            return 0;
+    }
+    id = (uint32_t)type << 8 | canId;
+    return (uint8_t)index;
+}
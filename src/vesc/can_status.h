@@ -0,0 +1,46 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include "values.h"
+
+// Status broadcasts on a VESC CAN bus. With "CAN status messages" set in
+// the app configuration, every controller sends its own numbers at a
+// fixed rate without being asked, in frames with extended id
+// type << 8 | its CAN id (comm_can_send_status*() in the VESC firmware):
+//   STATUS    rpm:i32 current:i16 (x10) duty:i16 (x1000)
+//   STATUS_2  ah:i32 (x1e4) ah_charged:i32 (x1e4)
+//   STATUS_3  wh:i32 (x1e4) wh_charged:i32 (x1e4)
+//   STATUS_4  temp_fet:i16 (x10) temp_motor:i16 (x10) current_in:i16 (x10) pid_pos:i16 (x50)
+//   STATUS_5  tachometer:i32 v_in:i16 (x10)
+//   STATUS_6  adc1..3, ppm:i16 (x1000); inputs, not kept here
+// None carries the fault code, which still has to be asked for.
+
+enum CanStatusType : uint8_t {
+    CAN_PACKET_STATUS = 9,
+    CAN_PACKET_STATUS_2 = 14,
+    CAN_PACKET_STATUS_3 = 15,
+    CAN_PACKET_STATUS_4 = 16,
+    CAN_PACKET_STATUS_5 = 27,
+    CAN_PACKET_STATUS_6 = 28
+};
+
+// True if an extended frame id is a status broadcast
+bool isCanStatus(uint32_t id);
+
+// CAN id of the controller that sent a frame
+inline uint8_t canStatusSender(uint32_t id) { return (uint8_t)id; }
+
+// VALUES_FIELD_* a status frame type carries, 0 for none
+uint32_t canStatusFields(uint8_t type);
+
+// Decode a status frame into out, in the units of COMM_GET_VALUES. Only
+// the fields the frame carries are written and added to out.fields, so
+// the frames of one round gather into one sample. Returns the fields
+// written, 0 if the frame is not a status frame or is too short.
+uint32_t decodeCanStatus(uint32_t id, const uint8_t* data, uint8_t length, VescValues& out);
+
+// The controller's side, for emulators and tests: the frame of a type
+// for a controller. Writes 8 bytes at most and returns the length, 0 for
+// a type this does not send.
+uint8_t encodeCanStatus(uint8_t type, uint8_t canId, const VescValues& values, uint32_t& id, uint8_t* data);
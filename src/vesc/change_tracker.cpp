@@ -0,0 +1,22 @@
+#include "change_tracker.h"
+
+uint32_t ValuesChangeTracker::update(const VescValues& values) {
+    uint32_t changed = 0;
+    uint32_t fields = values.fields & VALUES_ALL_FIELDS;
+    for (uint8_t bit = 0; bit < VALUES_FIELD_COUNT; bit++) {
+        uint32_t field = 1u << bit;
+        if (!(fields & field)) continue;
+        const ValuesFieldInfo& info = VALUES_FIELD_INFO[bit];
+        bool moved = !(seen & field);
+        for (uint8_t i = 0; i < info.count && !moved; i++) {
+            int32_t delta = valuesField(values, bit, i) - reference[bit][i];
+            if (delta < 0) delta = -delta;
+            moved = delta > info.deadband;
+        }
+        if (!moved) continue;
+        for (uint8_t i = 0; i < info.count; i++) reference[bit][i] = valuesField(values, bit, i);
+        changed |= field;
+    }
+    seen |= fields;
+    return changed;
+}
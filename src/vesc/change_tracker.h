@@ -0,0 +1,28 @@
+#pragma once
+
+#include <stdint.h>
+#include "values.h"
+
+// Which fields of a stream of samples moved. Each field is compared with
+// the value it had when it last counted as changed, not with the sample
+// before, so a slow drift below the field's deadband (see
+// ValuesFieldInfo) still shows once it adds up. A field decoded for the
+// first time counts as changed; one a sample does not carry keeps its
+// reference. Consumers that would redo work for a field (redraw, derive)
+// skip it while its bit stays clear.
+//
+// Hardware independent.
+class ValuesChangeTracker {
+public:
+    ValuesChangeTracker() { reset(); }
+
+    // Forget every reference: the next sample changes all it carries
+    void reset() { seen = 0; }
+
+    // VALUES_FIELD_* of values.fields that moved since they last changed
+    uint32_t update(const VescValues& values);
+
+private:
+    uint32_t seen;
+    int32_t reference[VALUES_FIELD_COUNT][3];
+};
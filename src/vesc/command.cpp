@@ -0,0 +1,66 @@
+#include "command.h"
+#include "buffer.h"
+#include "protocol.h"
+
+#include <string.h>
+
+VescCommand::VescCommand(uint8_t command) : used(0), overflowed(false) {
+    buffer[used++] = command;
+}
+
+VescCommand::VescCommand(uint8_t command, uint8_t canId) : used(0), overflowed(false) {
+    buffer[used++] = COMM_FORWARD_CAN;
+    buffer[used++] = canId;
+    buffer[used++] = command;
+}
+
+bool VescCommand::reserve(size_t bytes) {
+    if (overflowed || used + bytes > MAX_PAYLOAD) {
+        overflowed = true;
+        return false;
+    }
+    return true;
+}
+
+VescCommand& VescCommand::addUint8(uint8_t value) {
+    if (reserve(1)) bufferAppendUint8(buffer, value, used);
+    return *this;
+}
+
+VescCommand& VescCommand::addInt16(int16_t value) {
+    if (reserve(2)) bufferAppendInt16(buffer, value, used);
+    return *this;
+}
+
+VescCommand& VescCommand::addUint16(uint16_t value) {
+    if (reserve(2)) bufferAppendUint16(buffer, value, used);
+    return *this;
+}
+
+VescCommand& VescCommand::addInt32(int32_t value) {
+    if (reserve(4)) bufferAppendInt32(buffer, value, used);
+    return *this;
+}
+
+VescCommand& VescCommand::addUint32(uint32_t value) {
+    if (reserve(4)) bufferAppendUint32(buffer, value, used);
+    return *this;
+}
+
+VescCommand& VescCommand::addFloat16(float value, float scale) {
+    if (reserve(2)) bufferAppendFloat16(buffer, value, scale, used);
+    return *this;
+}
+
+VescCommand& VescCommand::addFloat32(float value, float scale) {
+    if (reserve(4)) bufferAppendFloat32(buffer, value, scale, used);
+    return *this;
+}
+
+VescCommand& VescCommand::addBytes(const uint8_t* data, size_t length) {
+    if (reserve(length)) {
+        memcpy(buffer + used, data, length);
+        used += length;
+    }
+    return *this;
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Builds a request payload (command byte first) in a fixed buffer, for
+// commands with arguments: selective values masks, set-commands, requests
+// forwarded over CAN. Fields are appended big-endian as the firmware
+// reads them. An append that would not fit is dropped and marks the
+// command invalid, so a caller checks once before sending.
+class VescCommand {
+public:
+    // Enough for set-commands and forwarded requests; configuration
+    // writes are far larger and not built here
+    static const size_t MAX_PAYLOAD = 64;
+
+    explicit VescCommand(uint8_t command);
+
+    // The same command addressed to a controller on the CAN bus, wrapped
+    // in COMM_FORWARD_CAN
+    VescCommand(uint8_t command, uint8_t canId);
+
+    VescCommand& addUint8(uint8_t value);
+    VescCommand& addInt16(int16_t value);
+    VescCommand& addUint16(uint16_t value);
+    VescCommand& addInt32(int32_t value);
+    VescCommand& addUint32(uint32_t value);
+    VescCommand& addFloat16(float value, float scale);
+    VescCommand& addFloat32(float value, float scale);
+    VescCommand& addBytes(const uint8_t* data, size_t length);
+
+    // False if an append overflowed
+    bool valid() const { return !overflowed; }
+
+    const uint8_t* payload() const { return buffer; }
+    size_t length() const { return used; }
+
+private:
+    bool reserve(size_t bytes);
+
+    uint8_t buffer[MAX_PAYLOAD];
+    size_t used;
+    bool overflowed;
+};
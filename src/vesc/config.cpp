@@ -0,0 +1,150 @@
+#include "config.h"
+#include "buffer.h"
+#include "protocol.h"
+
+#include <string.h>
+
+static const size_t UUID_SIZE = 12;
+static const uint32_t FNV_OFFSET = 2166136261u;
+static const uint32_t FNV_PRIME = 16777619u;
+
+// Signature, then pwm_mode, comm_mode, motor_type and sensor_mode
+static const size_t MCCONF_HEADER_SIZE = 4 + 4;
+static const size_t APPCONF_HEADER_SIZE = 4;
+
+// Sanity bounds for a decoded mcconf
+static const float MAX_CURRENT_A = 1000;
+static const float MAX_VOLTAGE_V = 300;
+static const float MAX_TEMPERATURE_C = 200;
+
+static uint32_t fnv1a(uint32_t hash, const uint8_t* data, size_t length) {
+    for (size_t i = 0; i < length; i++) {
+        hash ^= data[i];
+        hash *= FNV_PRIME;
+    }
+    return hash;
+}
+
+bool decodeFwIdentity(const uint8_t* payload, size_t length, VescIdentity& out) {
+    if (length < 3 || payload[0] != COMM_FW_VERSION) return false;
+
+    // [major][minor][hw name\0][uuid x12]...
+    size_t name = 3;
+    while (name < length && payload[name] != 0) name++;
+    size_t end = name < length ? name + 1 : length;
+    size_t uuid = end;
+    if (uuid + UUID_SIZE <= length) {
+        end = uuid + UUID_SIZE;
+        out.uuidHash = fnv1a(FNV_OFFSET, payload + uuid, UUID_SIZE);
+    } else {
+        out.uuidHash = fnv1a(FNV_OFFSET, payload + 3, end - 3);
+    }
+    out.firmwareHash = fnv1a(FNV_OFFSET, payload + 1, end - 1);
+    return true;
+}
+
+static int32_t toFixed(float value, float scale) {
+    float scaled = value * scale;
+    return (int32_t)(scaled >= 0 ? scaled + 0.5f : scaled - 0.5f);
+}
+
+bool decodeMcconf(const uint8_t* payload, size_t length, const VescFirmware& fw, VescConfig& out) {
+    if (length < 1 || payload[0] != COMM_GET_MCCONF || fw.major < 5) return false;
+    bool inputMap = fw.major >= 6;
+    size_t floats = inputMap ? 16 : 14;
+    if (length < 1 + MCCONF_HEADER_SIZE + floats * 4) return false;
+
+    size_t index = 1 + MCCONF_HEADER_SIZE;
+    float currentMax = bufferGetFloat32Auto(payload, index);
+    float currentMin = bufferGetFloat32Auto(payload, index);
+    float inCurrentMax = bufferGetFloat32Auto(payload, index);
+    float inCurrentMin = bufferGetFloat32Auto(payload, index);
+    if (inputMap) index += 8;                        // l_in_current_map_start, _filter
+    float absCurrentMax = bufferGetFloat32Auto(payload, index);
+    index += 5 * 4;                                   // ERPM limits
+    float minVin = bufferGetFloat32Auto(payload, index);
+    float maxVin = bufferGetFloat32Auto(payload, index);
+    float cutStart = bufferGetFloat32Auto(payload, index);
+    float cutEnd = bufferGetFloat32Auto(payload, index);
+
+    // A layout we do not know shows up as nonsense here
+    if (!(currentMax > 0 && currentMax <= MAX_CURRENT_A) || !(currentMin <= 0 && currentMin >= -MAX_CURRENT_A) ||
+        !(inCurrentMax > 0 && inCurrentMax <= MAX_CURRENT_A) || !(inCurrentMin <= 0 && inCurrentMin >= -MAX_CURRENT_A) ||
+        !(absCurrentMax > 0 && absCurrentMax <= MAX_CURRENT_A) || !(minVin > 0 && minVin < maxVin) ||
+        !(maxVin <= MAX_VOLTAGE_V) || !(cutEnd > 0 && cutEnd <= cutStart && cutStart <= maxVin)) {
+        return false;
+    }
+
+    out.currentMax = toFixed(currentMax, 100);
+    out.currentMin = toFixed(currentMin, 100);
+    out.inCurrentMax = toFixed(inCurrentMax, 100);
+    out.inCurrentMin = toFixed(inCurrentMin, 100);
+    out.absCurrentMax = toFixed(absCurrentMax, 100);
+    out.minVin = (int16_t)toFixed(minVin, 10);
+    out.maxVin = (int16_t)toFixed(maxVin, 10);
+    out.batteryCutStart = (int16_t)toFixed(cutStart, 10);
+    out.batteryCutEnd = (int16_t)toFixed(cutEnd, 10);
+
+    // l_slow_abs_current, then the FET and motor temperature limits
+    out.tempFetStart = out.tempFetEnd = out.tempMotorStart = out.tempMotorEnd = 0;
+    if (length >= index + 1 + 4 * 4) {
+        index += 1;
+        float fetStart = bufferGetFloat32Auto(payload, index);
+        float fetEnd = bufferGetFloat32Auto(payload, index);
+        float motorStart = bufferGetFloat32Auto(payload, index);
+        float motorEnd = bufferGetFloat32Auto(payload, index);
+        if (fetStart > 0 && fetStart <= fetEnd && fetEnd <= MAX_TEMPERATURE_C && motorStart > 0 &&
+            motorStart <= motorEnd && motorEnd <= MAX_TEMPERATURE_C) {
+            out.tempFetStart = (int16_t)toFixed(fetStart, 10);
+            out.tempFetEnd = (int16_t)toFixed(fetEnd, 10);
+            out.tempMotorStart = (int16_t)toFixed(motorStart, 10);
+            out.tempMotorEnd = (int16_t)toFixed(motorEnd, 10);
+        }
+    }
+    out.parts |= VESC_CONFIG_MOTOR;
+    return true;
+}
+
+bool decodeAppconf(const uint8_t* payload, size_t length, VescConfig& out) {
+    if (length < 1 + APPCONF_HEADER_SIZE + 1 || payload[0] != COMM_GET_APPCONF) return false;
+
+    size_t index = 1 + APPCONF_HEADER_SIZE;
+    out.canId = bufferGetUint8(payload, index);
+    out.parts |= VESC_CONFIG_APP;
+    return true;
+}
+
+size_t encodeMcconf(const VescConfig& config, const VescFirmware& fw, uint8_t* payload) {
+    size_t index = 0;
+    bufferAppendUint8(payload, COMM_GET_MCCONF, index);
+    bufferAppendUint32(payload, 0, index);           // Signature
+    for (int i = 0; i < 4; i++) bufferAppendUint8(payload, 0, index);
+    bufferAppendFloat32Auto(payload, config.currentMax / 100.0f, index);
+    bufferAppendFloat32Auto(payload, config.currentMin / 100.0f, index);
+    bufferAppendFloat32Auto(payload, config.inCurrentMax / 100.0f, index);
+    bufferAppendFloat32Auto(payload, config.inCurrentMin / 100.0f, index);
+    if (fw.major >= 6) {
+        bufferAppendFloat32Auto(payload, 0, index);
+        bufferAppendFloat32Auto(payload, 0, index);
+    }
+    bufferAppendFloat32Auto(payload, config.absCurrentMax / 100.0f, index);
+    for (int i = 0; i < 5; i++) bufferAppendFloat32Auto(payload, 0, index);
+    bufferAppendFloat32Auto(payload, config.minVin / 10.0f, index);
+    bufferAppendFloat32Auto(payload, config.maxVin / 10.0f, index);
+    bufferAppendFloat32Auto(payload, config.batteryCutStart / 10.0f, index);
+    bufferAppendFloat32Auto(payload, config.batteryCutEnd / 10.0f, index);
+    bufferAppendUint8(payload, 0, index);            // l_slow_abs_current
+    bufferAppendFloat32Auto(payload, config.tempFetStart / 10.0f, index);
+    bufferAppendFloat32Auto(payload, config.tempFetEnd / 10.0f, index);
+    bufferAppendFloat32Auto(payload, config.tempMotorStart / 10.0f, index);
+    bufferAppendFloat32Auto(payload, config.tempMotorEnd / 10.0f, index);
+    return index;
+}
+
+size_t encodeAppconf(const VescConfig& config, uint8_t* payload) {
+    size_t index = 0;
+    bufferAppendUint8(payload, COMM_GET_APPCONF, index);
+    bufferAppendUint32(payload, 0, index);           // Signature
+    bufferAppendUint8(payload, config.canId, index);
+    return index;
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include "values.h"
+
+// Which VESC and firmware a COMM_FW_VERSION reply came from. The reply
+// carries the hardware name and, on firmware since 3.x, the STM32's
+// 96-bit unique id after it.
+struct VescIdentity {
+    uint32_t uuidHash;           // FNV-1a of the unique id (of the name without one)
+    uint32_t firmwareHash;       // FNV-1a of version, name and unique id
+};
+
+// The part of the motor and app configuration the dashboard uses,
+// converted to the same fixed point as the telemetry
+struct VescConfig {
+    int32_t currentMax;          // 0.01 A, motor
+    int32_t currentMin;          // 0.01 A, motor braking (negative)
+    int32_t inCurrentMax;        // 0.01 A, battery
+    int32_t inCurrentMin;        // 0.01 A, battery regen (negative)
+    int32_t absCurrentMax;       // 0.01 A
+    int16_t minVin;              // 0.1 V
+    int16_t maxVin;              // 0.1 V
+    int16_t batteryCutStart;     // 0.1 V, current is ramped down from here
+    int16_t batteryCutEnd;       // 0.1 V, ...to none here
+    int16_t tempFetStart;        // 0.1 °C, current is ramped down from here; 0 if not read
+    int16_t tempFetEnd;          // 0.1 °C, ...to none here
+    int16_t tempMotorStart;      // 0.1 °C, the same for the motor
+    int16_t tempMotorEnd;        // 0.1 °C
+    uint8_t canId;               // From appconf
+    uint8_t parts;               // VESC_CONFIG_* decoded so far
+};
+
+#define VESC_CONFIG_MOTOR 0x01
+#define VESC_CONFIG_APP   0x02
+#define VESC_CONFIG_ALL   (VESC_CONFIG_MOTOR | VESC_CONFIG_APP)
+
+// Identity from a COMM_FW_VERSION reply. Returns false if the payload is
+// too short to carry the version.
+bool decodeFwIdentity(const uint8_t* payload, size_t length, VescIdentity& out);
+
+// Limits and cutoffs from a COMM_GET_MCCONF reply. The configuration is
+// serialized field by field in confgenerator order, which differs between
+// firmware releases, so only the leading limits are read: 6.x added the
+// input current map after the input current limits. Only firmware from
+// 5.0 on is understood. The temperature limits that follow the battery
+// cutoff are read when the reply carries them and they make sense, and
+// left 0 otherwise. Returns false, leaving out alone, for older
+// firmware, a short reply or values that make no sense.
+bool decodeMcconf(const uint8_t* payload, size_t length, const VescFirmware& fw, VescConfig& out);
+
+// CAN id from a COMM_GET_APPCONF reply, the first field after the
+// signature. Returns false if the reply is too short.
+bool decodeAppconf(const uint8_t* payload, size_t length, VescConfig& out);
+
+// The VESC's side, for emulators and tests: the leading fields of an
+// mcconf or appconf reply in the firmware's order, as much as the
+// decoders read. Largest reply either encoder writes:
+#define VESC_CONFIG_MAX_REPLY_SIZE 96
+size_t encodeMcconf(const VescConfig& config, const VescFirmware& fw, uint8_t* payload);
+size_t encodeAppconf(const VescConfig& config, uint8_t* payload);
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+// CRC-16-CCITT as used by VESC packets (poly 0x1021, initial value 0).
+// Table driven, one lookup per byte. The incremental form lets a caller
+// checksum a payload in pieces as it arrives.
+
+extern const uint16_t crc16Table[256];
+
+inline uint16_t crc16UpdateByte(uint16_t crc, uint8_t byte) {
+    return (uint16_t)((crc << 8) ^ crc16Table[((crc >> 8) ^ byte) & 0xFF]);
+}
+
+uint16_t crc16Update(uint16_t crc, const uint8_t* data, size_t length);
+
+inline uint16_t crc16(const uint8_t* data, size_t length) {
+    return crc16Update(0, data, length);
+}
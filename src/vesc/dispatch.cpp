@@ -0,0 +1,21 @@
+#include "dispatch.h"
+
+VescDispatcher::VescDispatcher() : unhandled(0), lastUnhandledId(0) {
+    for (int i = 0; i < 256; i++) handlers[i] = nullptr;
+}
+
+void VescDispatcher::on(uint8_t command, Handler handler) {
+    handlers[command] = handler;
+}
+
+bool VescDispatcher::dispatch(uint8_t link, const uint8_t* payload, size_t length) {
+    if (length == 0) return false;
+    Handler handler = handlers[payload[0]];
+    if (!handler) {
+        unhandled++;
+        lastUnhandledId = payload[0];
+        return false;
+    }
+    handler(link, payload, length);
+    return true;
+}
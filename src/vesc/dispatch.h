@@ -0,0 +1,33 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Routes validated frames to a handler by their command byte. The table
+// has an entry for every possible id, so dispatching is one indexed load
+// and an indirect call however many reply types there are, and a new one
+// only needs registering. Frames with an id nothing handles are counted.
+// Register from one task before frames arrive; dispatch from one task.
+class VescDispatcher {
+public:
+    // A reply from a link; payload[0] is the command byte
+    typedef void (*Handler)(uint8_t link, const uint8_t* payload, size_t length);
+
+    VescDispatcher();
+
+    // Set the handler of a command, replacing any earlier one; nullptr
+    // unregisters it
+    void on(uint8_t command, Handler handler);
+
+    // Hand a frame to its handler. Returns false if it has none.
+    bool dispatch(uint8_t link, const uint8_t* payload, size_t length);
+
+    uint32_t unhandledCount() const { return unhandled; }
+    // Command byte of the latest unhandled frame
+    uint8_t lastUnhandled() const { return lastUnhandledId; }
+
+private:
+    Handler handlers[256];
+    uint32_t unhandled;
+    uint8_t lastUnhandledId;
+};
@@ -0,0 +1,178 @@
+#include "emulator.h"
+#include "protocol.h"
+#include "buffer.h"
+#include "config.h"
+
+#include <math.h>
+#include <string.h>
+
+static const char* HARDWARE_NAME = "EMULATOR";
+
+// Limits reported in the configuration replies: 60 A motor, 30 A battery,
+// a 12S pack cut off from 42 V down to 40 V
+static const VescConfig EMULATED_CONFIG = { 6000, -6000, 3000, -1500, 15000, 300, 570, 420, 400, 850, 1000, 850, 1000, 0, 0 };
+
+VescEmulator::VescEmulator(const EmulatorConfig& config, OutputHandler output, void* context)
+    : config(config), output(output), context(context), framer(onFrame, this),
+      nowUs(0), lastDueUs(0), rng(config.seed ? config.seed : 1), head(0), count(0),
+      requestCount(0), replyCount(0), droppedCount(0), unknownCount(0) {
+    if (this->config.mtu == 0) this->config.mtu = 20;
+}
+
+void VescEmulator::receive(const uint8_t* data, size_t length, uint64_t now) {
+    nowUs = now;
+    framer.feed(data, length);
+}
+
+void VescEmulator::poll(uint64_t now) {
+    nowUs = now;
+    while (count > 0 && pending[head].dueUs <= now) {
+        const Pending& reply = pending[head];
+        for (size_t offset = 0; offset < reply.length; offset += config.mtu) {
+            size_t n = reply.length - offset < config.mtu ? reply.length - offset : config.mtu;
+            output(reply.packet + offset, n, context);
+        }
+        head = (head + 1) % MAX_PENDING;
+        count--;
+    }
+}
+
+uint64_t VescEmulator::nextDueUs() const {
+    return count > 0 ? pending[head].dueUs : UINT64_MAX;
+}
+
+void VescEmulator::onFrame(const uint8_t* payload, size_t length, void* context) {
+    ((VescEmulator*)context)->handle(payload, length);
+}
+
+void VescEmulator::handle(const uint8_t* payload, size_t length) {
+    requestCount++;
+    if (payload[0] != COMM_FORWARD_CAN) {
+        answer(payload, length, config.controllerId);
+        return;
+    }
+
+    // [COMM_FORWARD_CAN][id][command...]; the reply comes back unwrapped
+    // from that controller, or not at all if it is not on the bus
+    if (length < 3) return;
+    for (uint8_t i = 0; i < config.canCount; i++) {
+        if (config.canIds[i] == payload[1]) {
+            answer(payload + 2, length - 2, payload[1]);
+            return;
+        }
+    }
+}
+
+void VescEmulator::answer(const uint8_t* request, size_t length, uint8_t controllerId) {
+    uint8_t reply[MAX_REPLY];
+    size_t n = 0;
+    VescValues values;
+
+    switch (request[0]) {
+        case COMM_FW_VERSION: {
+            reply[n++] = COMM_FW_VERSION;
+            reply[n++] = config.fwMajor;
+            reply[n++] = config.fwMinor;
+            size_t nameLength = strlen(HARDWARE_NAME) + 1;
+            memcpy(reply + n, HARDWARE_NAME, nameLength);
+            n += nameLength;
+            for (int i = 0; i < 12; i++) reply[n++] = (uint8_t)(controllerId + i);  // UUID
+            reply[n++] = 0;     // Pairing done
+            reply[n++] = 0;     // Test version
+            break;
+        }
+        case COMM_ALIVE:
+            // A real VESC stays silent; the echo lets keep-alive handling
+            // on the dashboard be exercised
+            reply[n++] = COMM_ALIVE;
+            break;
+        case COMM_GET_MCCONF: {
+            VescFirmware fw = { config.fwMajor, config.fwMinor };
+            n = encodeMcconf(EMULATED_CONFIG, fw, reply);
+            break;
+        }
+        case COMM_GET_APPCONF: {
+            VescConfig app = EMULATED_CONFIG;
+            app.canId = controllerId;
+            n = encodeAppconf(app, reply);
+            break;
+        }
+        case COMM_PING_CAN:
+            reply[n++] = COMM_PING_CAN;
+            for (uint8_t i = 0; i < config.canCount && n < MAX_REPLY; i++) reply[n++] = config.canIds[i];
+            break;
+        case COMM_GET_VALUES: {
+            VescFirmware fw = { config.fwMajor, config.fwMinor };
+            simulate(controllerId, values);
+            n = encodeValues(values, valuesGroupsForFirmware(fw), reply);
+            break;
+        }
+        case COMM_GET_VALUES_SELECTIVE: {
+            if (length < 5) return;
+            size_t index = 1;
+            uint32_t mask = bufferGetUint32(request, index);
+            simulate(controllerId, values);
+            n = encodeValuesSelective(values, mask, reply);
+            break;
+        }
+        default:
+            unknownCount++;
+            return;
+    }
+    queueReply(reply, n);
+}
+
+void VescEmulator::queueReply(const uint8_t* payload, size_t length) {
+    if (config.dropPerMille > 0 && random() % 1000 < config.dropPerMille) {
+        droppedCount++;
+        return;
+    }
+    if (count == MAX_PENDING) {
+        droppedCount++;
+        return;
+    }
+
+    // Replies leave in order, so one never overtakes the one before it
+    uint64_t due = nowUs + config.latencyUs;
+    if (config.jitterUs > 0) due += random() % (config.jitterUs + 1);
+    if (due < lastDueUs) due = lastDueUs;
+    lastDueUs = due;
+
+    Pending& reply = pending[(head + count) % MAX_PENDING];
+    reply.dueUs = due;
+    reply.length = (uint16_t)vescEncodePacket(payload, length, reply.packet);
+    count++;
+    replyCount++;
+}
+
+// A ride that loops every few minutes: throttle swells and fades, the
+// pack sags under load and the temperatures creep up towards a plateau.
+// Each controller runs slightly out of phase.
+void VescEmulator::simulate(uint8_t controllerId, VescValues& values) {
+    double t = nowUs / 1e6 + controllerId * 1.7;
+    double throttle = 0.5 + 0.5 * sin(t / 6.0);
+
+    memset(&values, 0, sizeof(values));
+    values.dutyNow = (int16_t)(throttle * 950);                                   // 0.001
+    values.rpm = (int32_t)(throttle * 30000);                                      // ERPM
+    values.currentMotor = (int32_t)(throttle * 4000 + 500 * sin(t * 1.3));         // 0.01 A
+    values.currentIn = values.currentMotor * values.dutyNow / 1000;
+    values.currentIq = values.currentMotor;
+    values.vIn = (int16_t)(504 - values.currentIn * 8 / 1000);                     // 0.1 V, 0.08 V/A sag
+    values.tempFet = (int16_t)(250 + 150 * (1 - exp(-t / 300)));                   // 0.1 °C
+    values.tempMotor = (int16_t)(250 + 250 * (1 - exp(-t / 400)));
+    for (int i = 0; i < 3; i++) values.tempMos[i] = values.tempFet + i;
+    values.ampHours = (int32_t)(t * 5);                                            // 0.0001 Ah
+    values.wattHours = values.ampHours * values.vIn / 10;
+    values.tachometer = (int32_t)(t * 6000);
+    values.tachometerAbs = values.tachometer;
+    values.controllerId = controllerId;
+}
+
+uint32_t VescEmulator::random() {
+    // xorshift32
+    rng ^= rng << 13;
+    rng ^= rng >> 17;
+    rng ^= rng << 5;
+    return rng;
+}
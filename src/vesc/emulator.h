@@ -0,0 +1,88 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include "framer.h"
+#include "packet.h"
+#include "values.h"
+
+// Protocol-level stand-in for a VESC, for load and soak testing the
+// dashboard without a controller on the bench. Request bytes go in as
+// they arrive; replies come out through a handler in chunks of at most
+// the configured MTU, each released only once its (latency + jitter)
+// delay has passed, in request order. Answers COMM_FW_VERSION,
+// COMM_ALIVE, COMM_GET_VALUES, COMM_GET_VALUES_SELECTIVE, COMM_PING_CAN
+// and COMM_FORWARD_CAN to the configured CAN ids, with telemetry from a
+// simple simulated ride. Replies can be dropped at a set rate.
+//
+// Time is passed in by the caller in microseconds, so the same code runs
+// in real time on an ESP32 (emulator/) and in virtual time on the host
+// (bench/). Not thread safe.
+
+struct EmulatorConfig {
+    uint8_t controllerId;        // The VESC the BLE module is wired to
+    const uint8_t* canIds;       // Controllers reachable with COMM_FORWARD_CAN
+    uint8_t canCount;
+    uint8_t fwMajor;
+    uint8_t fwMinor;
+    uint32_t latencyUs;          // Request to reply
+    uint32_t jitterUs;           // Extra delay, uniform in [0, jitterUs]
+    uint16_t mtu;                // Largest chunk handed to the output (ATT MTU - 3)
+    uint16_t dropPerMille;       // Replies silently dropped, per 1000
+    uint32_t seed;               // For jitter and drops
+};
+
+class VescEmulator {
+public:
+    typedef void (*OutputHandler)(const uint8_t* data, size_t length, void* context);
+
+    static const int MAX_PENDING = 16;   // Replies queued at once; more are dropped
+    static const size_t MAX_REPLY = 128;
+
+    VescEmulator(const EmulatorConfig& config, OutputHandler output, void* context = nullptr);
+
+    // Bytes written by the dashboard
+    void receive(const uint8_t* data, size_t length, uint64_t nowUs);
+
+    // Release every reply that is due
+    void poll(uint64_t nowUs);
+
+    // When the next reply is due, or UINT64_MAX if none is queued
+    uint64_t nextDueUs() const;
+
+    uint32_t requests() const { return requestCount; }
+    uint32_t replies() const { return replyCount; }
+    uint32_t dropped() const { return droppedCount; }
+    uint32_t unknown() const { return unknownCount; }
+
+private:
+    struct Pending {
+        uint64_t dueUs;
+        uint16_t length;
+        uint8_t packet[MAX_REPLY + VESC_PACKET_MAX_OVERHEAD];
+    };
+
+    static void onFrame(const uint8_t* payload, size_t length, void* context);
+    void handle(const uint8_t* payload, size_t length);
+    void answer(const uint8_t* request, size_t length, uint8_t controllerId);
+    void queueReply(const uint8_t* payload, size_t length);
+    void simulate(uint8_t controllerId, VescValues& values);
+    uint32_t random();
+
+    EmulatorConfig config;
+    OutputHandler output;
+    void* context;
+    VescFramer framer;
+    uint64_t nowUs;
+    uint64_t lastDueUs;
+    uint32_t rng;
+
+    Pending pending[MAX_PENDING];
+    int head;
+    int count;
+
+    uint32_t requestCount;
+    uint32_t replyCount;
+    uint32_t droppedCount;
+    uint32_t unknownCount;
+};
@@ -0,0 +1,276 @@
+#include "firmware_upload.h"
+#include "buffer.h"
+#include "crc.h"
+#include "protocol.h"
+
+#include <string.h>
+
+VescFirmwareUpload::VescFirmwareUpload(ReadHandler reader, void* context)
+    : reader(reader), context(context), current(UPLOAD_IDLE), failure(""), image(0), crc(0), checked(0),
+      chunk(TARGET_CHUNK), maxWindow(1), windowCap(1), ackedInWindow(0), eraseSent(false), eraseSentMs(0),
+      nextOffset(0), acked(0), count(0), pending(PENDING_NONE), pendingIndex(0), pendingLength(0), srtt(0),
+      rttvar(0), minRtt(0), ackGap(0), lastAckMs(0), resends(0), strays(0) {
+    memset(header, 0, sizeof(header));
+    memset(chunks, 0, sizeof(chunks));
+}
+
+bool VescFirmwareUpload::start(uint32_t imageBytes, uint8_t window, size_t writeLimit) {
+    if (active() || imageBytes == 0) return false;
+
+    image = imageBytes;
+    crc = 0;
+    checked = 0;
+    maxWindow = window == 0 ? 1 : (window > MAX_WINDOW ? MAX_WINDOW : window);
+    windowCap = 1;
+    ackedInWindow = 0;
+    eraseSent = false;
+    nextOffset = 0;
+    acked = 0;
+    count = 0;
+    pending = PENDING_NONE;
+    srtt = rttvar = minRtt = ackGap = 0;
+    resends = strays = 0;
+    failure = "";
+
+    // As many whole writes as come nearest VESC Tool's chunk, less the
+    // framing, on a 4-byte boundary for the flash
+    size_t limit = writeLimit > 0 ? writeLimit : 20;
+    size_t writes = (TARGET_CHUNK + CHUNK_OVERHEAD + limit / 2) / limit;
+    if (writes == 0) writes = 1;
+    while (writes > 1 && writes * limit - CHUNK_OVERHEAD > MAX_CHUNK) writes--;
+    chunk = writes * limit > CHUNK_OVERHEAD + MAX_CHUNK ? MAX_CHUNK : writes * limit - CHUNK_OVERHEAD;
+    chunk &= ~(size_t)3;
+
+    current = UPLOAD_CHECKING;
+    return true;
+}
+
+void VescFirmwareUpload::cancel() {
+    if (active()) fail("cancelled");
+}
+
+size_t VescFirmwareUpload::fail(const char* why) {
+    failure = why;
+    current = UPLOAD_FAILED;
+    pending = PENDING_NONE;
+    count = 0;
+    return 0;
+}
+
+uint8_t VescFirmwareUpload::window() const {
+    uint32_t w = maxWindow;
+    // Enough chunks to keep the link busy for the bare round trip
+    if (minRtt > 0 && ackGap > 0) {
+        uint32_t cover = (minRtt + ackGap - 1) / ackGap + 1;
+        if (cover < w) w = cover;
+    }
+    if (windowCap < w) w = windowCap;
+    return (uint8_t)(w > 0 ? w : 1);
+}
+
+uint32_t VescFirmwareUpload::rto() const {
+    if (srtt == 0) return INITIAL_RTO_MS;
+    uint32_t timeout = srtt + 4 * rttvar;
+    return timeout < MIN_RTO_MS ? MIN_RTO_MS : timeout;
+}
+
+// Smoothed as in RFC 6298, in whole ms
+void VescFirmwareUpload::addRtt(uint32_t rtt) {
+    if (minRtt == 0 || rtt < minRtt) minRtt = rtt > 0 ? rtt : 1;
+    if (srtt == 0) {
+        srtt = rtt;
+        rttvar = rtt / 2;
+        return;
+    }
+    uint32_t error = rtt > srtt ? rtt - srtt : srtt - rtt;
+    rttvar = (3 * rttvar + error) / 4;
+    srtt = (7 * srtt + rtt) / 8;
+}
+
+void VescFirmwareUpload::removeChunk(uint8_t index) {
+    for (uint8_t i = index; i + 1 < count; i++) chunks[i] = chunks[i + 1];
+    count--;
+}
+
+// Header bytes first, then the image from the reader
+size_t VescFirmwareUpload::build(uint32_t offset, size_t length, uint8_t* out, Pending kind) {
+    size_t index = 0;
+    out[index++] = COMM_WRITE_NEW_APP_DATA;
+    bufferAppendUint32(out, offset, index);
+    size_t done = 0;
+    while (done < length && offset + done < HEADER_BYTES) {
+        out[index + done] = header[offset + done];
+        done++;
+    }
+    if (done < length) {
+        uint32_t from = offset + done - HEADER_BYTES;
+        if (reader(from, out + index + done, length - done, context) != length - done) {
+            return fail("could not read the image");
+        }
+    }
+    pending = kind;
+    pendingLength = length;
+    return index + length;
+}
+
+size_t VescFirmwareUpload::next(uint8_t* out, uint32_t now) {
+    pending = PENDING_NONE;
+    switch (current) {
+        case UPLOAD_CHECKING: {
+            uint32_t end = image - checked > CHECK_BYTES ? checked + CHECK_BYTES : image;
+            while (checked < end) {
+                size_t n = end - checked < MAX_PAYLOAD ? end - checked : MAX_PAYLOAD;
+                if (reader(checked, out, n, context) != n) return fail("could not read the image");
+                crc = crc16Update(crc, out, n);
+                checked += n;
+            }
+            if (checked == image) {
+                size_t index = 0;
+                bufferAppendUint32(header, image, index);
+                bufferAppendUint16(header, crc, index);
+                current = UPLOAD_ERASING;
+            }
+            return 0;
+        }
+
+        case UPLOAD_ERASING:
+            if (eraseSent) {
+                if (now - eraseSentMs >= ERASE_TIMEOUT_MS) return fail("no answer to the erase");
+                return 0;
+            } else {
+                size_t index = 0;
+                out[index++] = COMM_ERASE_NEW_APP;
+                bufferAppendUint32(out, image, index);
+                pending = PENDING_ERASE;
+                return index;
+            }
+
+        case UPLOAD_WRITING: {
+            // A refused chunk, or the oldest one whose ack is overdue
+            uint32_t timeout = rto();
+            for (uint8_t i = 0; i < count; i++) {
+                Chunk& c = chunks[i];
+                if (!c.overdue && now - c.sentMs < timeout) continue;
+                if (c.retries >= MAX_RETRIES) return fail("a chunk was not acked");
+                pendingIndex = i;
+                return build(c.offset, c.length, out, PENDING_RESEND);
+            }
+            if (nextOffset < totalBytes() && count < window()) {
+                size_t length = totalBytes() - nextOffset < chunk ? totalBytes() - nextOffset : chunk;
+                return build(nextOffset, length, out, PENDING_CHUNK);
+            }
+            if (nextOffset == totalBytes() && count == 0) {
+                out[0] = COMM_JUMP_TO_BOOTLOADER;
+                pending = PENDING_JUMP;
+                return 1;
+            }
+            return 0;
+        }
+
+        default:
+            return 0;
+    }
+}
+
+void VescFirmwareUpload::sent(uint32_t now) {
+    switch (pending) {
+        case PENDING_ERASE:
+            eraseSent = true;
+            eraseSentMs = now;
+            break;
+        case PENDING_CHUNK: {
+            Chunk& c = chunks[count++];
+            c.offset = nextOffset;
+            c.length = (uint16_t)pendingLength;
+            c.retries = 0;
+            c.resent = false;
+            c.overdue = false;
+            c.sentMs = now;
+            nextOffset += pendingLength;
+            break;
+        }
+        case PENDING_RESEND: {
+            Chunk& c = chunks[pendingIndex];
+            c.retries++;
+            c.resent = true;
+            c.overdue = false;
+            c.sentMs = now;
+            resends++;
+            // A loss: back to one chunk at a time, growing again from there
+            windowCap = 1;
+            ackedInWindow = 0;
+            break;
+        }
+        case PENDING_JUMP:
+            current = UPLOAD_DONE;
+            break;
+        default:
+            break;
+    }
+    pending = PENDING_NONE;
+}
+
+void VescFirmwareUpload::onReply(const uint8_t* payload, size_t length, uint32_t now) {
+    if (length < 2) return;
+    bool ok = payload[1] != 0;
+
+    if (payload[0] == COMM_ERASE_NEW_APP) {
+        if (current != UPLOAD_ERASING || !eraseSent) return;
+        if (!ok) {
+            fail("the VESC refused the erase (image too large?)");
+            return;
+        }
+        current = UPLOAD_WRITING;
+        lastAckMs = now;
+        return;
+    }
+    if (payload[0] != COMM_WRITE_NEW_APP_DATA || current != UPLOAD_WRITING || count == 0) return;
+
+    int index = 0;
+    if (length >= 6) {
+        size_t at = 2;
+        uint32_t offset = bufferGetUint32(payload, at);
+        index = -1;
+        for (uint8_t i = 0; i < count; i++) {
+            if (chunks[i].offset == offset) {
+                index = i;
+                break;
+            }
+        }
+    }
+    if (index < 0) {
+        strays++;
+        return;
+    }
+
+    Chunk& c = chunks[index];
+    if (!ok) {
+        c.overdue = true;
+        return;
+    }
+    // Only a chunk sent once gives an RTT that is surely its own
+    if (!c.resent) addRtt(now - c.sentMs);
+    if (count > 1) {
+        uint32_t gap = now - lastAckMs;
+        ackGap = ackGap == 0 ? gap : (7 * ackGap + gap) / 8;
+    }
+    lastAckMs = now;
+    acked += c.length;
+    removeChunk((uint8_t)index);
+    if (++ackedInWindow >= windowCap) {
+        ackedInWindow = 0;
+        if (windowCap < maxWindow) windowCap++;
+    }
+}
+
+const char* VescFirmwareUpload::stateName(State state) {
+    switch (state) {
+        case UPLOAD_IDLE: return "idle";
+        case UPLOAD_CHECKING: return "checking";
+        case UPLOAD_ERASING: return "erasing";
+        case UPLOAD_WRITING: return "writing";
+        case UPLOAD_DONE: return "done";
+        case UPLOAD_FAILED: return "failed";
+    }
+    return "?";
+}
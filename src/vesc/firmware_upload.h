@@ -0,0 +1,141 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Pushes a firmware image into a VESC's new-app flash area over one link,
+// the way VESC Tool does: COMM_ERASE_NEW_APP for the image size, then
+// COMM_WRITE_NEW_APP_DATA chunks of the image behind a 6-byte header (its
+// size and CRC-16, which the bootloader checks), then
+// COMM_JUMP_TO_BOOTLOADER, which copies it over the running app and
+// restarts the VESC.
+//
+// VESC Tool waits for each chunk's ack before sending the next, so over
+// BLE every chunk costs a round trip. Here a window of chunks is out at
+// once. Chunks are sized to fill whole link writes at the MTU, and the
+// window to cover a round trip: the lowest RTT seen over the smoothed gap
+// between acks, plus one, but never more than maxWindow (what the VESC's
+// BLE bridge can buffer). The window starts at one and opens by one per
+// window of acks; a chunk the VESC refuses, or one unanswered past the
+// retransmit timeout, is sent again and closes the window back to one.
+// Acks must be ok and match an outstanding chunk by offset; firmware whose
+// ack carries no offset answers in order and is matched to the oldest.
+//
+// Hardware independent; times are passed in. Not thread safe.
+class VescFirmwareUpload {
+public:
+    // Read length bytes of the image at offset into out. Returns the
+    // bytes read.
+    typedef size_t (*ReadHandler)(uint32_t offset, uint8_t* out, size_t length, void* context);
+
+    enum State : uint8_t {
+        UPLOAD_IDLE,
+        UPLOAD_CHECKING,       // Reading the image for its CRC
+        UPLOAD_ERASING,
+        UPLOAD_WRITING,
+        UPLOAD_DONE,           // Jumped to the bootloader
+        UPLOAD_FAILED
+    };
+
+    static const size_t HEADER_BYTES = 6;        // Image size and CRC ahead of the image
+    static const size_t CHUNK_OVERHEAD = 11;     // Command, offset and the long frame around a chunk
+    static const size_t TARGET_CHUNK = 384;      // VESC Tool's chunk size
+    static const size_t MAX_CHUNK = 496;         // Well inside the VESC's 512-byte packet buffer
+    static const size_t MAX_PAYLOAD = 5 + MAX_CHUNK;
+    static const uint8_t MAX_WINDOW = 16;
+    static const uint8_t MAX_RETRIES = 5;        // Sends of one chunk past its first
+    static const uint32_t CHECK_BYTES = 16384;   // Image read per next() while checking
+    static const uint32_t ERASE_TIMEOUT_MS = 20000;
+    static const uint32_t INITIAL_RTO_MS = 1000;
+    static const uint32_t MIN_RTO_MS = 200;
+
+    VescFirmwareUpload(ReadHandler reader, void* context = nullptr);
+
+    // Start on an image of imageBytes, with at most maxWindow chunks
+    // outstanding and chunks sized to writes of writeLimit bytes. Returns
+    // false if an upload is running or the image is empty.
+    bool start(uint32_t imageBytes, uint8_t maxWindow, size_t writeLimit);
+
+    void cancel();
+
+    // The next payload for the link, command byte first, or 0 if nothing
+    // is due. out needs MAX_PAYLOAD bytes. It counts as sent once sent()
+    // is called; if the link refused it, the next call builds it again.
+    size_t next(uint8_t* out, uint32_t now);
+    void sent(uint32_t now);
+
+    // A COMM_ERASE_NEW_APP or COMM_WRITE_NEW_APP_DATA reply
+    void onReply(const uint8_t* payload, size_t length, uint32_t now);
+
+    State state() const { return current; }
+    // Between start() and the jump or a failure
+    bool active() const { return current != UPLOAD_IDLE && current != UPLOAD_DONE && current != UPLOAD_FAILED; }
+    // What went wrong, once failed
+    const char* error() const { return failure; }
+
+    uint32_t imageBytes() const { return image; }
+    uint16_t imageCrc() const { return crc; }
+    // Header and image written and acked, of totalBytes()
+    uint32_t bytesAcked() const { return acked; }
+    uint32_t totalBytes() const { return image + HEADER_BYTES; }
+    size_t chunkBytes() const { return chunk; }
+    uint8_t window() const;
+    uint32_t smoothedRtt() const { return srtt; }
+    uint32_t retransmits() const { return resends; }
+    uint32_t strayAcks() const { return strays; }
+
+    static const char* stateName(State state);
+
+private:
+    enum Pending : uint8_t {
+        PENDING_NONE,
+        PENDING_ERASE,
+        PENDING_CHUNK,
+        PENDING_RESEND,
+        PENDING_JUMP
+    };
+
+    struct Chunk {
+        uint32_t offset;
+        uint16_t length;
+        uint8_t retries;
+        bool resent;           // Its RTT is ambiguous
+        bool overdue;          // Refused; send again at once
+        uint32_t sentMs;
+    };
+
+    size_t build(uint32_t offset, size_t length, uint8_t* out, Pending kind);
+    size_t fail(const char* why);
+    uint32_t rto() const;
+    void addRtt(uint32_t rtt);
+    void removeChunk(uint8_t index);
+
+    ReadHandler reader;
+    void* context;
+    State current;
+    const char* failure;
+    uint32_t image;
+    uint16_t crc;
+    uint8_t header[HEADER_BYTES];
+    uint32_t checked;
+    size_t chunk;
+    uint8_t maxWindow;
+    uint8_t windowCap;         // Grows by one per window of acks, back to one on a loss
+    uint8_t ackedInWindow;
+    bool eraseSent;
+    uint32_t eraseSentMs;
+    uint32_t nextOffset;       // First byte not yet sent
+    uint32_t acked;
+    Chunk chunks[MAX_WINDOW];  // Outstanding, oldest first
+    uint8_t count;
+    Pending pending;
+    uint8_t pendingIndex;      // Chunk a PENDING_RESEND is for
+    size_t pendingLength;
+    uint32_t srtt;
+    uint32_t rttvar;
+    uint32_t minRtt;
+    uint32_t ackGap;           // Smoothed ms between acks while more than one chunk is out
+    uint32_t lastAckMs;
+    uint32_t resends;
+    uint32_t strays;
+};
@@ -0,0 +1,156 @@
+#include "framer.h"
+#include "protocol.h"
+#include "crc.h"
+#include "hot_path.h"
+
+#include <string.h>
+
+static_assert((VescFramer::RING_SIZE & (VescFramer::RING_SIZE - 1)) == 0, "RING_SIZE must be a power of two");
+static_assert(VescFramer::RING_SIZE >= VescFramer::MAX_PAYLOAD + VescFramer::MAX_FRAME_OVERHEAD, "RING_SIZE must hold a full frame");
+
+// Start bytes 0x02, 0x03 and 0x04 are followed by a 1, 2 or 3 byte length
+static inline bool isStartByte(uint8_t b) {
+    return (uint8_t)(b - VESC_PACKET_START) <= (VESC_PACKET_START_HUGE - VESC_PACKET_START);
+}
+
+VescFramer::VescFramer(FrameHandler handler, void* context)
+    : handler(handler), context(context), head(0), count(0),
+      feedTimeUs(0), startTimeUs(0), startStamped(false),
+      frames(0), discarded(0), resyncs(0), crcErrors(0), stopErrors(0), oversize(0) {
+}
+
+void VescFramer::reset() {
+    head = 0;
+    count = 0;
+    startStamped = false;
+}
+
+VESC_HOT_CODE void VescFramer::feed(const uint8_t* data, size_t length, uint64_t timeUs) {
+    feedTimeUs = timeUs;
+    // A full ring always yields a frame or discarded bytes in process(),
+    // so this loop terminates even when a notification exceeds the ring
+    while (length > 0) {
+        size_t accepted = push(data, length);
+        data += accepted;
+        length -= accepted;
+        process();
+    }
+}
+
+VESC_HOT_CODE size_t VescFramer::push(const uint8_t* data, size_t length) {
+    size_t space = RING_SIZE - count;
+    if (length > space) length = space;
+
+    size_t tail = (head + count) & (RING_SIZE - 1);
+    size_t firstPart = RING_SIZE - tail;
+    if (firstPart > length) firstPart = length;
+
+    memcpy(&ring[tail], data, firstPart);
+    memcpy(&ring[0], data + firstPart, length - firstPart);
+    count += length;
+    return length;
+}
+
+// Copy buffered bytes into dest and return their CRC, so the payload is
+// only walked once
+VESC_HOT_CODE uint16_t VescFramer::copyOut(size_t offset, size_t length, uint8_t* dest) const {
+    size_t start = (head + offset) & (RING_SIZE - 1);
+    size_t firstPart = RING_SIZE - start;
+    if (firstPart > length) firstPart = length;
+
+    memcpy(dest, &ring[start], firstPart);
+    memcpy(dest + firstPart, &ring[0], length - firstPart);
+
+    uint16_t crc = crc16Update(0, &ring[start], firstPart);
+    return crc16Update(crc, &ring[0], length - firstPart);
+}
+
+VESC_HOT_CODE void VescFramer::discard(size_t length) {
+    head = (head + length) & (RING_SIZE - 1);
+    count -= length;
+    startStamped = false;
+}
+
+// Drop bytes until a start byte sits at the head of the ring.
+// Returns false if the ring ran empty.
+VESC_HOT_CODE bool VescFramer::syncToStart() {
+    if (count == 0) return false;
+    if (isStartByte(ring[head])) return true;
+
+    resyncs++;
+    while (count > 0) {
+        // Scan the contiguous run up to the end of the ring (or data)
+        size_t run = RING_SIZE - head;
+        if (run > count) run = count;
+
+        const uint8_t* p = &ring[head];
+        const uint8_t* end = p + run;
+        while (p < end && !isStartByte(*p)) p++;
+
+        size_t skip = (size_t)(p - &ring[head]);
+        discarded += skip;
+        discard(skip);
+        if (p < end) return true;
+    }
+    return false;
+}
+
+VESC_HOT_CODE void VescFramer::process() {
+    while (syncToStart()) {
+        // Every buffered frame is taken out before feed() returns, so
+        // the first pass to find a start byte at the head is in the feed
+        // that brought it
+        if (!startStamped) {
+            startTimeUs = feedTimeUs;
+            startStamped = true;
+        }
+
+        size_t lengthBytes = ring[head] - VESC_PACKET_START + 1;
+        size_t headerLength = 1 + lengthBytes;
+        if (count < headerLength) return;
+
+        size_t payloadLength = 0;
+        for (size_t i = 1; i <= lengthBytes; i++) {
+            payloadLength = (payloadLength << 8) | peek(i);
+        }
+
+        if (payloadLength == 0 || payloadLength > MAX_PAYLOAD) {
+            // Not a frame we can hold, skip this start byte
+            if (payloadLength > MAX_PAYLOAD) oversize++;
+            discarded++;
+            discard(1);
+            continue;
+        }
+
+        size_t totalLength = headerLength + payloadLength + 3;  // + CRC(2) + Stop
+
+        // Wait for the rest of the frame
+        if (count < totalLength) return;
+
+        if (peek(totalLength - 1) != VESC_PACKET_STOP) {
+            // Invalid frame, skip this start byte and search for the next
+            stopErrors++;
+            discarded++;
+            discard(1);
+            continue;
+        }
+
+        uint16_t crc = copyOut(headerLength, payloadLength, frame);
+        size_t crcOffset = headerLength + payloadLength;
+        uint16_t expected = (uint16_t)((peek(crcOffset) << 8) | peek(crcOffset + 1));
+        if (crc != expected) {
+            // Corrupted payload (or a false start byte inside another
+            // frame), resync from the next byte
+            crcErrors++;
+            discarded++;
+            discard(1);
+            continue;
+        }
+
+        uint64_t timeUs = startTimeUs;
+        discard(totalLength);
+        frames++;
+        startTimeUs = timeUs;
+        handler(frame, payloadLength, context);
+    }
+}
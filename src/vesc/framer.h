@@ -0,0 +1,76 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Big enough for COMM_GET_MCCONF and other bulk replies
+#ifndef VESC_FRAMER_MAX_PAYLOAD
+#define VESC_FRAMER_MAX_PAYLOAD 1024
+#endif
+
+// Reassembles VESC packets from an arbitrarily fragmented byte stream
+// (BLE notifications, UART reads). Incoming bytes are copied into a fixed
+// ring buffer, so no heap is touched after construction. When the stream
+// is desynced the framer skips straight to the next start byte instead of
+// discarding one byte at a time. Only frames with a valid stop byte and
+// payload CRC are passed on; anything else is counted and dropped.
+// Short (0x02), long (0x03) and 3-byte-length (0x04) frames are supported.
+class VescFramer {
+public:
+    // Called for every complete frame with the payload (command byte first).
+    // The pointer is only valid for the duration of the call.
+    typedef void (*FrameHandler)(const uint8_t* payload, size_t length, void* context);
+
+    // Largest payload we reassemble; longer frames are treated as corrupt
+    static const size_t MAX_PAYLOAD = VESC_FRAMER_MAX_PAYLOAD;
+    static const size_t RING_SIZE = 2048;          // Must be a power of two
+    static const size_t MAX_FRAME_OVERHEAD = 7;    // Start + Length(3) + CRC(2) + Stop
+
+    VescFramer(FrameHandler handler, void* context = nullptr);
+
+    // Append received bytes and emit any frames they complete. timeUs is
+    // when the bytes arrived, in whatever clock the caller uses.
+    void feed(const uint8_t* data, size_t length, uint64_t timeUs = 0);
+
+    // While the handler runs: timeUs of the feed() that brought the
+    // frame's start byte, i.e. when the frame's first fragment arrived
+    uint64_t frameTimeUs() const { return startTimeUs; }
+
+    // Drop any partially received frame (e.g. after a reconnect)
+    void reset();
+
+    uint32_t framesReceived() const { return frames; }
+    uint32_t bytesDiscarded() const { return discarded; }
+    uint32_t resyncCount() const { return resyncs; }
+    uint32_t crcErrorCount() const { return crcErrors; }
+    uint32_t stopErrorCount() const { return stopErrors; }
+    uint32_t oversizeCount() const { return oversize; }
+
+private:
+    size_t push(const uint8_t* data, size_t length);
+    void process();
+    bool syncToStart();
+    uint8_t peek(size_t offset) const { return ring[(head + offset) & (RING_SIZE - 1)]; }
+    uint16_t copyOut(size_t offset, size_t length, uint8_t* dest) const;
+    void discard(size_t length);
+
+    FrameHandler handler;
+    void* context;
+
+    uint8_t ring[RING_SIZE];
+    size_t head;    // Index of the oldest buffered byte
+    size_t count;   // Number of buffered bytes
+
+    uint8_t frame[MAX_PAYLOAD];  // Linear copy of the current payload
+
+    uint64_t feedTimeUs;         // Of the bytes being processed
+    uint64_t startTimeUs;        // Of the start byte at the head
+    bool startStamped;           // startTimeUs belongs to the byte at the head
+
+    uint32_t frames;
+    uint32_t discarded;
+    uint32_t resyncs;
+    uint32_t crcErrors;
+    uint32_t stopErrors;
+    uint32_t oversize;
+};
@@ -0,0 +1,47 @@
+#include "heartbeat.h"
+
+VescHeartbeat::VescHeartbeat(uint32_t aliveMs, uint32_t probeMs, uint32_t deadMs)
+    : aliveMs(aliveMs), probeMs(probeMs), deadMs(deadMs), lastAliveMs(0), lastProbeMs(0), lastFrameMs(0),
+      heardFrame(false), piggybackCount(0), standaloneCount(0), probeCount(0) {
+}
+
+void VescHeartbeat::reset(uint32_t now) {
+    lastAliveMs = now;
+    lastProbeMs = now;
+    lastFrameMs = now;
+    heardFrame = false;
+}
+
+bool VescHeartbeat::piggyback(uint32_t now) {
+    if (now - lastAliveMs < aliveMs / 2) return false;
+    lastAliveMs = now;
+    piggybackCount++;
+    return true;
+}
+
+VescHeartbeat::Action VescHeartbeat::idle(uint32_t now) {
+    if (now - lastFrameMs >= probeMs && now - lastProbeMs >= probeMs) {
+        lastProbeMs = now;
+        lastAliveMs = now;
+        probeCount++;
+        return HEARTBEAT_PROBE;
+    }
+    if (now - lastAliveMs >= aliveMs) {
+        lastAliveMs = now;
+        standaloneCount++;
+        return HEARTBEAT_ALIVE;
+    }
+    return HEARTBEAT_NONE;
+}
+
+uint32_t VescHeartbeat::msUntilDue(uint32_t now) const {
+    uint32_t sinceAlive = now - lastAliveMs;
+    uint32_t until = sinceAlive < aliveMs ? aliveMs - sinceAlive : 0;
+    // The next probe, if the link stays quiet until then
+    uint32_t sinceFrame = now - lastFrameMs;
+    uint32_t sinceProbe = now - lastProbeMs;
+    uint32_t probeWait = sinceFrame < probeMs ? probeMs - sinceFrame : 0;
+    uint32_t probeGap = sinceProbe < probeMs ? probeMs - sinceProbe : 0;
+    if (probeGap > probeWait) probeWait = probeGap;
+    return probeWait < until ? probeWait : until;
+}
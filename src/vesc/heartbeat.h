@@ -0,0 +1,69 @@
+#pragma once
+
+#include <stdint.h>
+
+// Heartbeat of one link. COMM_ALIVE keeps the VESC's own timeout fed for
+// control features; it draws no reply, so it rides along with outgoing
+// telemetry once half its period has passed, and goes out on its own
+// only when the link carried nothing for a whole period (e.g. parked,
+// between slow polls).
+//
+// The link is judged by what comes back: any frame counts. After probeMs
+// without one, a probe that does draw a reply is asked for, at most once
+// per probeMs, so a quiet link and a dead one can be told apart early;
+// after deadMs without one the link is dead.
+//
+// Hardware independent; times are passed in.
+class VescHeartbeat {
+public:
+    enum Action : uint8_t {
+        HEARTBEAT_NONE,
+        HEARTBEAT_ALIVE,      // Send COMM_ALIVE
+        HEARTBEAT_PROBE       // Send COMM_ALIVE and a request that is answered
+    };
+
+    VescHeartbeat(uint32_t aliveMs, uint32_t probeMs, uint32_t deadMs);
+
+    // A new session: everything counts from now
+    void reset(uint32_t now);
+
+    // Telemetry is going out: true if COMM_ALIVE should join it, in which
+    // case it counts as sent
+    bool piggyback(uint32_t now);
+
+    // Nothing else is going out: what to send on its own, counted as sent
+    Action idle(uint32_t now);
+
+    // A frame came back
+    void onFrame(uint32_t now) {
+        lastFrameMs = now;
+        heardFrame = true;
+    }
+
+    // A frame came back since reset()
+    bool heard() const { return heardFrame; }
+
+    uint32_t silentMs(uint32_t now) const { return now - lastFrameMs; }
+
+    // No frame for deadMs, times factor (to give a poor link longer)
+    bool dead(uint32_t now, uint32_t factor = 1) const { return now - lastFrameMs >= deadMs * factor; }
+
+    // Until idle() has something to send
+    uint32_t msUntilDue(uint32_t now) const;
+
+    uint32_t piggybacked() const { return piggybackCount; }
+    uint32_t standalone() const { return standaloneCount; }
+    uint32_t probes() const { return probeCount; }
+
+private:
+    uint32_t aliveMs;
+    uint32_t probeMs;
+    uint32_t deadMs;
+    uint32_t lastAliveMs;
+    uint32_t lastProbeMs;
+    uint32_t lastFrameMs;
+    bool heardFrame;
+    uint32_t piggybackCount;
+    uint32_t standaloneCount;
+    uint32_t probeCount;
+};
@@ -0,0 +1,15 @@
+#pragma once
+
+// Placement of the receive hot path: the framer and the CRC. On the ESP32
+// their code goes to IRAM and the CRC table to DRAM, so a notification is
+// framed without flash cache misses, which stall for as long as the SD
+// logger, NVS or WiFi keep the cache busy. Elsewhere (the native bench)
+// both expand to nothing.
+#ifdef ESP_PLATFORM
+#include <esp_attr.h>
+#define VESC_HOT_CODE IRAM_ATTR
+#define VESC_HOT_DATA DRAM_ATTR
+#else
+#define VESC_HOT_CODE
+#define VESC_HOT_DATA
+#endif
@@ -0,0 +1,78 @@
+#include "link_analyzer.h"
+
+#include <string.h>
+
+static const uint32_t FIRST_RTT_EDGE_MS = 16;
+
+// A ratio scaled by scale, 0 without a denominator, held to 16 bits
+static uint16_t ratio(uint32_t count, uint32_t total, uint32_t scale) {
+    if (total == 0) return 0;
+    uint64_t value = ((uint64_t)count * scale + total / 2) / total;
+    return value > 0xFFFF ? 0xFFFF : (uint16_t)value;
+}
+
+LinkAnalyzer::LinkAnalyzer() {
+    reset();
+}
+
+void LinkAnalyzer::reset() {
+    held = 0;
+    newest = 0;
+    memset(&current, 0, sizeof(current));
+    current.rttMedian = RTT_BUCKETS;
+    current.rttP90 = RTT_BUCKETS;
+}
+
+uint32_t LinkAnalyzer::rttBucketEdge(uint8_t bucket) {
+    if (bucket >= RTT_BUCKETS - 1) return 0;
+    return FIRST_RTT_EDGE_MS << bucket;
+}
+
+void LinkAnalyzer::update(const Counters& counters, uint32_t nowMs) {
+    if (held > 0) {
+        const Counters& last = ring[newest];
+        bool backwards = counters.notifications < last.notifications || counters.frames < last.frames ||
+                         counters.crcErrors < last.crcErrors || counters.requests < last.requests ||
+                         counters.replies < last.replies || counters.timeouts < last.timeouts;
+        for (uint8_t b = 0; b < RTT_BUCKETS; b++) backwards = backwards || counters.rtt[b] < last.rtt[b];
+        if (backwards) reset();
+    }
+    newest = held == 0 ? 0 : (uint8_t)((newest + 1) % WINDOW_UPDATES);
+    ring[newest] = counters;
+    times[newest] = nowMs;
+    if (held < WINDOW_UPDATES) held++;
+    compute();
+}
+
+void LinkAnalyzer::compute() {
+    if (held < 2) return;
+    const Counters& last = ring[newest];
+    uint8_t oldestIndex = (uint8_t)((newest + WINDOW_UPDATES - (held - 1)) % WINDOW_UPDATES);
+    const Counters& first = ring[oldestIndex];
+    uint32_t windowMs = times[newest] - times[oldestIndex];
+
+    uint32_t notifications = last.notifications - first.notifications;
+    uint32_t frames = last.frames - first.frames;
+    uint32_t crcErrors = last.crcErrors - first.crcErrors;
+    current.windowMs = windowMs;
+    current.notificationsPerFrameX100 = ratio(notifications, frames, 100);
+    current.bytesPerNotification = ratio(last.notificationBytes - first.notificationBytes, notifications, 1);
+    current.requestsPerSecondX10 = ratio(last.requests - first.requests, windowMs, 10000);
+    current.repliesPerSecondX10 = ratio(last.replies - first.replies, windowMs, 10000);
+    current.timeoutsPerSecondX10 = ratio(last.timeouts - first.timeouts, windowMs, 10000);
+    current.crcFailuresX100 = ratio(crcErrors, frames + crcErrors, 10000);
+
+    current.rttCount = 0;
+    for (uint8_t b = 0; b < RTT_BUCKETS; b++) {
+        current.rtt[b] = last.rtt[b] - first.rtt[b];
+        current.rttCount += current.rtt[b];
+    }
+    current.rttMedian = RTT_BUCKETS;
+    current.rttP90 = RTT_BUCKETS;
+    uint32_t below = 0;
+    for (uint8_t b = 0; b < RTT_BUCKETS && current.rttCount > 0; b++) {
+        below += current.rtt[b];
+        if (current.rttMedian == RTT_BUCKETS && below * 2 >= current.rttCount) current.rttMedian = b;
+        if (current.rttP90 == RTT_BUCKETS && below * 10 >= current.rttCount * 9) current.rttP90 = b;
+    }
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <stdint.h>
+
+// Rates of one link over a sliding window, for the link analyzer screen:
+// how replies are split into notifications, how busy the link is each
+// way, how often frames fail their CRC and how round trips spread.
+//
+// Fed a link's cumulative counters at a steady rate (the screen's 2 Hz).
+// Each update goes into a ring of WINDOW_UPDATES, and the figures are
+// the change from the oldest to the newest, so they move a little with
+// every update and settle over the window instead of jumping per period.
+// Counters that go backwards (a link reset) start the window over. Not
+// thread safe.
+class LinkAnalyzer {
+public:
+    static const uint8_t WINDOW_UPDATES = 9;     // Eight periods: 4 s at 2 Hz
+    static const uint8_t RTT_BUCKETS = 8;        // <16, <32, ... <1024 ms, then 1024+, as PERF_RTT_BUCKETS
+
+    // Cumulative, as read from the receive queue, framer, request
+    // trackers and the RTT histogram
+    struct Counters {
+        uint32_t notifications;
+        uint32_t notificationBytes;
+        uint32_t frames;                 // That passed their CRC
+        uint32_t crcErrors;
+        uint32_t requests;
+        uint32_t replies;
+        uint32_t timeouts;
+        uint32_t rtt[RTT_BUCKETS];
+    };
+
+    struct Figures {
+        uint32_t windowMs;                   // 0 until there are two updates
+        uint16_t notificationsPerFrameX100;
+        uint16_t bytesPerNotification;
+        uint16_t requestsPerSecondX10;
+        uint16_t repliesPerSecondX10;
+        uint16_t timeoutsPerSecondX10;
+        uint16_t crcFailuresX100;            // Percent of frames received, x100
+        uint32_t rtt[RTT_BUCKETS];           // Round trips in the window
+        uint32_t rttCount;
+        uint8_t rttMedian;                   // Bucket of the median, RTT_BUCKETS without round trips
+        uint8_t rttP90;
+    };
+
+    LinkAnalyzer();
+
+    void reset();
+
+    void update(const Counters& counters, uint32_t nowMs);
+
+    const Figures& figures() const { return current; }
+
+    // Upper edge of an RTT bucket in ms, 0 for the last (unbounded) one
+    static uint32_t rttBucketEdge(uint8_t bucket);
+
+private:
+    void compute();
+
+    Counters ring[WINDOW_UPDATES];
+    uint32_t times[WINDOW_UPDATES];
+    uint8_t held;
+    uint8_t newest;
+    Figures current;
+};
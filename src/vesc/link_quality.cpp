@@ -0,0 +1,105 @@
+#include "link_quality.h"
+
+#include <string.h>
+
+// Good and bad ends of each measure. Loss and CRC ratios are in percent.
+static const uint32_t LOSS_GOOD = 2;
+static const uint32_t LOSS_BAD = 30;
+static const uint32_t CRC_GOOD = 1;
+static const uint32_t CRC_BAD = 10;
+static const uint32_t RTT_GOOD_MS = 100;
+static const uint32_t RTT_BAD_MS = 600;
+static const int RSSI_GOOD = -70;
+static const int RSSI_BAD = -95;
+
+// Score thresholds of the levels
+static const uint8_t DEGRADED_BELOW = 70;
+static const uint8_t POOR_BELOW = 35;
+
+// 100 at or below good, 0 at or above bad, linear in between
+static uint8_t scoreFor(uint32_t value, uint32_t good, uint32_t bad) {
+    if (value <= good) return 100;
+    if (value >= bad) return 0;
+    return (uint8_t)(100 - (value - good) * 100 / (bad - good));
+}
+
+// Percent of count out of total, 0 with no traffic
+static uint32_t percent(uint32_t count, uint32_t total) {
+    return total > 0 ? count * 100 / total : 0;
+}
+
+LinkQuality::LinkQuality() {
+    reset();
+}
+
+void LinkQuality::reset() {
+    memset(&previous, 0, sizeof(previous));
+    hasBaseline = false;
+    current = LINK_GOOD;
+    lastScore = 100;
+    betterWindows = 0;
+}
+
+LinkQuality::Level LinkQuality::levelForScore(uint8_t score) {
+    if (score < POOR_BELOW) return LINK_POOR;
+    if (score < DEGRADED_BELOW) return LINK_DEGRADED;
+    return LINK_GOOD;
+}
+
+LinkQuality::Level LinkQuality::update(const LinkCounters& counters) {
+    if (!hasBaseline) {
+        previous = counters;
+        hasBaseline = true;
+        return current;
+    }
+
+    uint32_t replies = counters.replies - previous.replies;
+    uint32_t timeouts = counters.timeouts - previous.timeouts;
+    uint32_t frames = counters.frames - previous.frames;
+    uint32_t crcErrors = counters.crcErrors - previous.crcErrors;
+    previous = counters;
+
+    uint8_t score = scoreFor(percent(timeouts, replies + timeouts), LOSS_GOOD, LOSS_BAD);
+    uint8_t s = scoreFor(percent(crcErrors, frames + crcErrors), CRC_GOOD, CRC_BAD);
+    if (s < score) score = s;
+    // A window of nothing but timeouts has no fresh RTT to go on
+    if (counters.srttMs > 0 && replies > 0) {
+        s = scoreFor(counters.srttMs, RTT_GOOD_MS, RTT_BAD_MS);
+        if (s < score) score = s;
+    }
+    if (counters.rssi < 0) {
+        s = scoreFor((uint32_t)(-counters.rssi), (uint32_t)(-RSSI_GOOD), (uint32_t)(-RSSI_BAD));
+        if (s < score) score = s;
+    }
+    lastScore = score;
+
+    Level measured = levelForScore(score);
+    if (measured > current) {
+        current = measured;
+        betterWindows = 0;
+    } else if (measured < current) {
+        if (++betterWindows >= RECOVER_WINDOWS) {
+            current = (Level)(current - 1);
+            betterWindows = 0;
+        }
+    } else {
+        betterWindows = 0;
+    }
+    return current;
+}
+
+uint8_t LinkQuality::pollSlowdown() const {
+    switch (current) {
+        case LINK_DEGRADED: return 2;
+        case LINK_POOR: return 4;
+        default: return 1;
+    }
+}
+
+const char* LinkQuality::levelName(Level level) {
+    switch (level) {
+        case LINK_DEGRADED: return "degraded";
+        case LINK_POOR: return "poor";
+        default: return "good";
+    }
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <stdint.h>
+
+// Cumulative counters of one link, as read from its framer and request
+// trackers. rssi is in dBm, 0 if unknown.
+struct LinkCounters {
+    uint32_t replies;
+    uint32_t timeouts;
+    uint32_t frames;
+    uint32_t crcErrors;
+    uint32_t srttMs;
+    int rssi;
+};
+
+// Link quality estimate, updated once per window from the change in a
+// link's counters. Each of reply loss, CRC failures, round-trip time and
+// RSSI is scored 0-100 between a good and a bad threshold, and the worst
+// one is the window's score. The level drops as soon as one window is
+// worse, and climbs back one step only after RECOVER_WINDOWS better
+// windows in a row, so a marginal link settles instead of flapping.
+// Not thread safe.
+class LinkQuality {
+public:
+    enum Level : uint8_t {
+        LINK_GOOD,
+        LINK_DEGRADED,
+        LINK_POOR
+    };
+
+    static const uint8_t RECOVER_WINDOWS = 3;
+
+    LinkQuality();
+
+    // Start over on a new connection; the first update only takes a
+    // baseline of the counters
+    void reset();
+
+    // Score the window since the last update and move the level
+    Level update(const LinkCounters& counters);
+
+    Level level() const { return current; }
+    uint8_t score() const { return lastScore; }
+
+    // Factor the poll period is stretched by at this level
+    uint8_t pollSlowdown() const;
+
+    static const char* levelName(Level level);
+
+private:
+    static Level levelForScore(uint8_t score);
+
+    LinkCounters previous;
+    bool hasBaseline;
+    Level current;
+    uint8_t lastScore;
+    uint8_t betterWindows;
+};
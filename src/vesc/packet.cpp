@@ -0,0 +1,31 @@
+#include "packet.h"
+#include "protocol.h"
+#include "crc.h"
+
+#include <string.h>
+
+size_t vescEncodePacket(const uint8_t* payload, size_t length, uint8_t* out) {
+    if (length == 0 || length > 0xFFFFFF) return 0;
+
+    size_t n = 0;
+    if (length <= 0xFF) {
+        out[n++] = VESC_PACKET_START;
+    } else if (length <= 0xFFFF) {
+        out[n++] = VESC_PACKET_START_LONG;
+        out[n++] = (uint8_t)(length >> 8);
+    } else {
+        out[n++] = VESC_PACKET_START_HUGE;
+        out[n++] = (uint8_t)(length >> 16);
+        out[n++] = (uint8_t)(length >> 8);
+    }
+    out[n++] = (uint8_t)length;
+
+    memcpy(out + n, payload, length);
+    n += length;
+
+    uint16_t crc = crc16(payload, length);
+    out[n++] = (uint8_t)(crc >> 8);
+    out[n++] = (uint8_t)crc;
+    out[n++] = VESC_PACKET_STOP;
+    return n;
+}
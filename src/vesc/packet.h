@@ -0,0 +1,19 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Largest frame overhead: start byte, 3-byte length, CRC and stop byte
+#define VESC_PACKET_MAX_OVERHEAD 7
+
+// Bytes a frame adds to a payload of length
+inline size_t vescPacketOverhead(size_t length) {
+    return length <= 255 ? 5 : length <= 65535 ? 6 : 7;
+}
+
+// Frame a payload (command byte first) for sending. The start byte and
+// length width follow the payload size, as the framer expects on the way
+// back. out needs room for length + VESC_PACKET_MAX_OVERHEAD bytes.
+// Returns the frame length, or 0 if the payload is empty or too long for
+// a 3-byte length.
+size_t vescEncodePacket(const uint8_t* payload, size_t length, uint8_t* out);
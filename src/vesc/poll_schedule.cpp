@@ -0,0 +1,122 @@
+#include "poll_schedule.h"
+
+PollSchedule::PollSchedule(uint32_t coalesceWindowMs)
+    : count(0), coalesceWindowMs(coalesceWindowMs) {
+}
+
+int PollSchedule::add(uint32_t fields, uint32_t periodMs, PollPriority priority) {
+    if (count >= MAX_ITEMS) return -1;
+    items[count].fields = fields;
+    items[count].periodMs = periodMs;
+    items[count].nextDueMs = 0;
+    items[count].costBytes = 0;
+    items[count].priority = priority;
+    items[count].stretch = 1;
+    return count++;
+}
+
+void PollSchedule::setPeriod(int id, uint32_t periodMs) {
+    if (id < 0 || (size_t)id >= count) return;
+    items[id].periodMs = periodMs;
+}
+
+uint32_t PollSchedule::period(int id) const {
+    if (id < 0 || (size_t)id >= count) return 0;
+    return items[id].periodMs;
+}
+
+void PollSchedule::setCost(int id, uint32_t bytes) {
+    if (id < 0 || (size_t)id >= count) return;
+    items[id].costBytes = bytes;
+}
+
+void PollSchedule::fit(uint32_t bytesPerSecond, uint32_t requestBytes) {
+    uint32_t fastestMs = 0;
+    for (size_t i = 0; i < count; i++) {
+        items[i].stretch = 1;
+        uint32_t p = items[i].periodMs;
+        if (p != 0 && (fastestMs == 0 || p < fastestMs)) fastestMs = p;
+    }
+    if (bytesPerSecond == 0 || fastestMs == 0) return;
+
+    // Requests go out at the fastest rate; their headers come off first
+    uint64_t left = bytesPerSecond;
+    uint64_t headers = (uint64_t)requestBytes * 1000 / fastestMs;
+    left = left > headers ? left - headers : 0;
+    for (uint8_t priority = 0; priority < POLL_PRIORITY_COUNT; priority++) {
+        uint64_t demand = 0;
+        for (size_t i = 0; i < count; i++) {
+            const Item& item = items[i];
+            if (item.priority == priority && item.periodMs != 0) {
+                demand += (uint64_t)item.costBytes * 1000 / item.periodMs;
+            }
+        }
+        if (demand == 0) continue;
+        uint64_t stretch = 1;
+        if (demand > left) stretch = left > 0 ? (demand + left - 1) / left : MAX_STRETCH;
+        if (stretch > MAX_STRETCH) stretch = MAX_STRETCH;
+        uint64_t spent = demand / stretch;
+        left = left > spent ? left - spent : 0;
+        for (size_t i = 0; i < count; i++) {
+            if (items[i].priority == priority) items[i].stretch = (uint8_t)stretch;
+        }
+    }
+}
+
+uint32_t PollSchedule::slowedFields() const {
+    uint32_t fields = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (items[i].periodMs != 0 && items[i].stretch > 1) fields |= items[i].fields;
+    }
+    return fields;
+}
+
+void PollSchedule::restart(uint32_t now) {
+    for (size_t i = 0; i < count; i++) {
+        items[i].nextDueMs = now;
+    }
+}
+
+uint32_t PollSchedule::due(uint32_t now) const {
+    bool anyDue = false;
+    uint32_t soon = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (items[i].periodMs == 0) continue;
+        int32_t remaining = (int32_t)(items[i].nextDueMs - now);
+        if (remaining <= 0) anyDue = true;
+        if (remaining <= (int32_t)coalesceWindowMs) soon |= items[i].fields;
+    }
+    return anyDue ? soon : 0;
+}
+
+uint32_t PollSchedule::msUntilDue(uint32_t now) const {
+    uint32_t soonest = UINT32_MAX;
+    for (size_t i = 0; i < count; i++) {
+        if (items[i].periodMs == 0) continue;
+        int32_t remaining = (int32_t)(items[i].nextDueMs - now);
+        if (remaining <= 0) return 0;
+        if ((uint32_t)remaining < soonest) soonest = remaining;
+    }
+    return soonest;
+}
+
+void PollSchedule::markSent(uint32_t fields, uint32_t now) {
+    for (size_t i = 0; i < count; i++) {
+        Item& item = items[i];
+        if (item.periodMs == 0 || (item.fields & fields) != item.fields) continue;
+
+        // Keep the cadence, but never try to catch up on missed slots
+        item.nextDueMs += periodOf(item);
+        if ((int32_t)(item.nextDueMs - now) <= 0) {
+            item.nextDueMs = now + periodOf(item);
+        }
+    }
+}
+
+uint32_t PollSchedule::allFields() const {
+    uint32_t fields = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (items[i].periodMs != 0) fields |= items[i].fields;
+    }
+    return fields;
+}
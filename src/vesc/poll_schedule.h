@@ -0,0 +1,83 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Multi-rate telemetry schedule. Each subscribed group of
+// COMM_GET_VALUES_SELECTIVE fields has its own period; every tick the
+// groups that are due (plus any due within the coalescing window) are
+// merged into one field mask, so one request serves all of them.
+//
+// When the link cannot carry every group at its rate, fit() slows them
+// by priority instead of all alike: the critical groups keep their rate
+// while anything fits, and the low ones give way first.
+// Times are in milliseconds. Not thread safe.
+enum PollPriority : uint8_t {
+    POLL_CRITICAL,
+    POLL_NORMAL,
+    POLL_LOW,
+    POLL_PRIORITY_COUNT
+};
+
+class PollSchedule {
+public:
+    static const size_t MAX_ITEMS = 8;
+    static const uint8_t MAX_STRETCH = 16;     // Slowest fit() makes a group, in periods
+
+    explicit PollSchedule(uint32_t coalesceWindowMs);
+
+    // Subscribe a field group at a period. Returns an id, or -1 if full.
+    int add(uint32_t fields, uint32_t periodMs, PollPriority priority = POLL_NORMAL);
+
+    // Change or pause (period 0) a subscription
+    void setPeriod(int id, uint32_t periodMs);
+
+    // The period as subscribed, before fit() slows it
+    uint32_t period(int id) const;
+
+    // Reply bytes a subscription's fields add to a request
+    void setCost(int id, uint32_t bytes);
+
+    // Fit the subscriptions into replies of bytesPerSecond (0: no limit),
+    // each request paying requestBytes besides its fields' costs. A
+    // priority keeps its rate while the bytes left over by those above
+    // cover it; the first that does not fit is slowed to what is left,
+    // and those below it to MAX_STRETCH times their period.
+    void fit(uint32_t bytesPerSecond, uint32_t requestBytes);
+
+    // Fields of the subscriptions fit() has slowed
+    uint32_t slowedFields() const;
+
+    // Make every subscription due now (e.g. after connecting)
+    void restart(uint32_t now);
+
+    // Fields due at now, including those falling due within the window.
+    // 0 if nothing is due.
+    uint32_t due(uint32_t now) const;
+
+    // Milliseconds until the next subscription falls due (0 if one is
+    // due now, UINT32_MAX if none is active)
+    uint32_t msUntilDue(uint32_t now) const;
+
+    // Reschedule every subscription fully covered by a sent mask
+    void markSent(uint32_t fields, uint32_t now);
+
+    // Fields of all active subscriptions
+    uint32_t allFields() const;
+
+private:
+    struct Item {
+        uint32_t fields;
+        uint32_t periodMs;     // 0 = paused
+        uint32_t nextDueMs;
+        uint32_t costBytes;
+        PollPriority priority;
+        uint8_t stretch;       // Periods between polls, from fit()
+    };
+
+    uint32_t periodOf(const Item& item) const { return item.periodMs * item.stretch; }
+
+    Item items[MAX_ITEMS];
+    size_t count;
+    uint32_t coalesceWindowMs;
+};
@@ -0,0 +1,27 @@
+#pragma once
+
+// VESC UART protocol constants (see scratchpad/VESC_UART_Protocol.md)
+
+// Packet framing. The start byte also encodes the width of the length field.
+#define VESC_PACKET_START 2        // 1-byte length (payload <= 255)
+#define VESC_PACKET_START_LONG 3   // 2-byte big-endian length
+#define VESC_PACKET_START_HUGE 4   // 3-byte big-endian length
+#define VESC_PACKET_STOP 3
+
+// Command ids
+#define COMM_FW_VERSION 0
+#define COMM_JUMP_TO_BOOTLOADER 1
+#define COMM_ERASE_NEW_APP 2
+#define COMM_WRITE_NEW_APP_DATA 3
+#define COMM_GET_VALUES 4
+#define COMM_SET_CURRENT 6
+#define COMM_GET_MCCONF 14
+#define COMM_GET_APPCONF 17
+#define COMM_TERMINAL_CMD 20
+#define COMM_PRINT 21
+#define COMM_SAMPLE_PRINT 23
+#define COMM_ALIVE 30
+#define COMM_FORWARD_CAN 34
+#define COMM_GET_VALUES_SELECTIVE 50
+#define COMM_PING_CAN 62
+#define COMM_BMS_GET_VALUES 96
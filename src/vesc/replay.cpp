@@ -0,0 +1,110 @@
+#include "replay.h"
+#include "framer.h"
+#include "protocol.h"
+#include "values.h"
+
+#include <string.h>
+
+static const uint32_t FNV_OFFSET = 2166136261u;
+static const uint32_t FNV_PRIME = 16777619u;
+
+static uint32_t fnv1a(uint32_t hash, const void* data, size_t length) {
+    const uint8_t* bytes = (const uint8_t*)data;
+    for (size_t i = 0; i < length; i++) {
+        hash = (hash ^ bytes[i]) * FNV_PRIME;
+    }
+    return hash;
+}
+
+// Decoder state carried across frames, as on the device
+struct ReplayState {
+    ReplayReport* report;
+    VescFirmware firmware;
+    const ValuesLayout* layout;
+    VescValues values;
+};
+
+static void replayFrame(const uint8_t* payload, size_t length, void* context) {
+    ReplayState* state = (ReplayState*)context;
+    ReplayReport& report = *state->report;
+    report.frameDigest = fnv1a(report.frameDigest, payload, length);
+
+    bool decoded;
+    switch (payload[0]) {
+        case COMM_FW_VERSION:
+            if (decodeFwVersion(payload, length, state->firmware)) {
+                state->layout = &valuesLayoutForFirmware(state->firmware);
+            }
+            return;
+        case COMM_GET_VALUES:
+            decoded = decodeValues(payload, length, *state->layout, state->values);
+            break;
+        case COMM_GET_VALUES_SELECTIVE:
+            decoded = decodeValuesSelective(payload, length, state->values);
+            break;
+        default:
+            return;
+    }
+    if (decoded) {
+        report.valuesDecoded++;
+        report.valuesDigest = fnv1a(report.valuesDigest, &state->values, sizeof(state->values));
+    } else {
+        report.decodeFailures++;
+    }
+}
+
+static ReplayState state;
+static VescFramer framer(replayFrame, &state);
+
+bool replayCapture(const uint8_t* data, size_t length, bool realtime,
+                   ReplayClock clock, ReplaySleep sleep, ReplayReport& report) {
+    CaptureFileHeader header;
+    if (length < sizeof(header)) return false;
+    memcpy(&header, data, sizeof(header));
+    if (header.magic != CAPTURE_MAGIC || header.version != CAPTURE_VERSION ||
+        header.headerSize < sizeof(header) || header.headerSize > length) {
+        return false;
+    }
+
+    memset(&report, 0, sizeof(report));
+    report.frameDigest = FNV_OFFSET;
+    report.valuesDigest = FNV_OFFSET;
+    memset(&state, 0, sizeof(state));
+    state.report = &report;
+    state.layout = &valuesLayoutForFirmware(state.firmware);
+    framer.reset();
+
+    // The framer's counters run on across replays
+    uint32_t framesBefore = framer.framesReceived();
+    uint32_t crcBefore = framer.crcErrorCount();
+    uint32_t resyncsBefore = framer.resyncCount();
+    uint32_t discardedBefore = framer.bytesDiscarded();
+
+    size_t offset = header.headerSize;
+    uint64_t started = clock();
+    CaptureChunkHeader chunk;
+    while (offset + sizeof(chunk) <= length) {
+        memcpy(&chunk, data + offset, sizeof(chunk));
+        offset += sizeof(chunk);
+        if (offset + chunk.length > length) break;
+
+        if (realtime) {
+            uint64_t due = started + chunk.timeUs;
+            uint64_t now = clock();
+            if (due > now) sleep((uint32_t)(due - now));
+        }
+        framer.feed(data + offset, chunk.length, chunk.timeUs);
+        offset += chunk.length;
+
+        report.chunks++;
+        report.bytes += chunk.length;
+        report.captureUs = chunk.timeUs;
+    }
+    report.elapsedUs = clock() - started;
+
+    report.frames = framer.framesReceived() - framesBefore;
+    report.crcErrors = framer.crcErrorCount() - crcBefore;
+    report.resyncs = framer.resyncCount() - resyncsBefore;
+    report.bytesDiscarded = framer.bytesDiscarded() - discardedBefore;
+    return true;
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Recorded BLE notification streams and a driver that plays them back
+// through the framer and decoders, so parser bugs and slowdowns that
+// depend on real fragmentation can be reproduced off the vehicle.
+//
+// A capture is a CaptureFileHeader followed by chunks, each a
+// CaptureChunkHeader and the notification's bytes exactly as received.
+// Little-endian throughout.
+
+static const uint32_t CAPTURE_MAGIC = 0x50414356;   // "VCAP"
+static const uint16_t CAPTURE_VERSION = 1;
+
+struct __attribute__((packed)) CaptureFileHeader {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t headerSize;        // sizeof(CaptureFileHeader)
+    uint32_t chunkCount;        // 0 if the capture was not closed
+    uint32_t reserved;
+};
+
+struct __attribute__((packed)) CaptureChunkHeader {
+    uint32_t timeUs;            // Since the capture started
+    uint16_t length;
+};
+
+// Outcome of a replay. Two replays of the same capture through
+// equivalent code give identical counts and digests; elapsedUs is how
+// long the replay took.
+struct ReplayReport {
+    uint32_t chunks;
+    uint32_t bytes;
+    uint32_t frames;
+    uint32_t crcErrors;
+    uint32_t resyncs;
+    uint32_t bytesDiscarded;
+    uint32_t valuesDecoded;     // COMM_GET_VALUES(_SELECTIVE) replies decoded
+    uint32_t decodeFailures;
+    uint32_t frameDigest;       // FNV-1a over every frame payload
+    uint32_t valuesDigest;      // FNV-1a over the decoded values after each reply
+    uint64_t elapsedUs;
+    uint32_t captureUs;         // Time span of the capture itself
+};
+
+// Microsecond clock and sleep, supplied by the platform
+typedef uint64_t (*ReplayClock)();
+typedef void (*ReplaySleep)(uint32_t us);
+
+// Feed a capture held in memory through a fresh framer and the values
+// decoders. With realtime set each chunk is held back until its recorded
+// offset, otherwise chunks go in back to back. Returns false if the data
+// is not a capture; a capture truncated mid-chunk replays up to the cut.
+// Not reentrant.
+bool replayCapture(const uint8_t* data, size_t length, bool realtime,
+                   ReplayClock clock, ReplaySleep sleep, ReplayReport& report);
@@ -0,0 +1,125 @@
+#include "requests.h"
+
+RequestTracker::RequestTracker(uint8_t maxInFlight, uint32_t timeoutMs,
+                               uint32_t minPeriodMs, uint32_t maxPeriodMs, uint8_t streamInFlight)
+    : maxInFlight(maxInFlight > MAX_SLOTS ? MAX_SLOTS : (maxInFlight == 0 ? 1 : maxInFlight)),
+      timeoutMs(timeoutMs), minPeriodMs(minPeriodMs), maxPeriodMs(maxPeriodMs),
+      srtt(0), rttvar(0), lastSample(0), lastSentTag(0), timeoutCount(0), replyCount(0), sentCount(0) {
+    this->streamInFlight = streamInFlight > MAX_SLOTS ? MAX_SLOTS : streamInFlight;
+    if (this->streamInFlight < this->maxInFlight) this->streamInFlight = this->maxInFlight;
+    windowCap = this->streamInFlight;
+    cleanReplies = 0;
+    reset();
+}
+
+void RequestTracker::reset(bool resetRtt) {
+    for (size_t i = 0; i < MAX_SLOTS; i++) {
+        slots[i].used = false;
+    }
+    outstanding = 0;
+    if (resetRtt) {
+        srtt = 0;
+        rttvar = 0;
+        lastSample = 0;
+        windowCap = streamInFlight;
+        cleanReplies = 0;
+    }
+}
+
+// Enough requests to cover the RTT with headroom at the fastest period
+uint8_t RequestTracker::window() const {
+    if (srtt == 0 || windowCap <= maxInFlight) return maxInFlight;
+    uint32_t period = minPeriodMs > 0 ? minPeriodMs : 1;
+    uint32_t needed = (srtt + 4 * rttvar + period - 1) / period;
+    if (needed > windowCap) needed = windowCap;
+    if (needed < maxInFlight) needed = maxInFlight;
+    return (uint8_t)needed;
+}
+
+bool RequestTracker::canSend(uint32_t now) {
+    expire(now);
+    return outstanding < window();
+}
+
+void RequestTracker::onSent(uint8_t command, uint32_t now, uint32_t tag) {
+    sentCount++;
+    for (size_t i = 0; i < MAX_SLOTS; i++) {
+        if (!slots[i].used) {
+            slots[i].command = command;
+            slots[i].sentMs = now;
+            slots[i].tag = tag;
+            slots[i].used = true;
+            outstanding++;
+            return;
+        }
+    }
+}
+
+bool RequestTracker::onReply(uint8_t command, uint32_t now) {
+    int oldest = -1;
+    for (size_t i = 0; i < MAX_SLOTS; i++) {
+        if (slots[i].used && slots[i].command == command) {
+            if (oldest < 0 || (int32_t)(slots[i].sentMs - slots[oldest].sentMs) < 0) {
+                oldest = i;
+            }
+        }
+    }
+    if (oldest < 0) return false;
+
+    addSample(now - slots[oldest].sentMs);
+    lastSentTag = slots[oldest].tag;
+    replyCount++;
+    if (windowCap < streamInFlight && ++cleanReplies >= WINDOW_GROWTH_REPLIES) {
+        windowCap++;
+        cleanReplies = 0;
+    }
+    slots[oldest].used = false;
+    outstanding--;
+    return true;
+}
+
+void RequestTracker::expire(uint32_t now) {
+    for (size_t i = 0; i < MAX_SLOTS; i++) {
+        if (slots[i].used && now - slots[i].sentMs >= timeoutMs) {
+            slots[i].used = false;
+            outstanding--;
+            timeoutCount++;
+            windowCap = maxInFlight;
+            cleanReplies = 0;
+        }
+    }
+}
+
+uint8_t RequestTracker::overdue(uint32_t now, uint32_t minWaitMs) const {
+    uint32_t wait = srtt > 0 ? srtt + 4 * rttvar : timeoutMs;
+    if (wait < minWaitMs) wait = minWaitMs;
+    uint8_t count = 0;
+    for (size_t i = 0; i < MAX_SLOTS; i++) {
+        if (slots[i].used && now - slots[i].sentMs >= wait) count++;
+    }
+    return count;
+}
+
+// Smoothed RTT and mean deviation as in RFC 6298 (alpha 1/8, beta 1/4)
+void RequestTracker::addSample(uint32_t rtt) {
+    lastSample = rtt;
+    if (srtt == 0) {
+        srtt = rtt > 0 ? rtt : 1;
+        rttvar = rtt / 2;
+        return;
+    }
+    uint32_t deviation = rtt > srtt ? rtt - srtt : srtt - rtt;
+    rttvar = (3 * rttvar + deviation) / 4;
+    srtt = (7 * srtt + rtt) / 8;
+    if (srtt == 0) srtt = 1;
+}
+
+uint32_t RequestTracker::pollPeriod() const {
+    if (srtt == 0) return minPeriodMs;
+
+    // One request per RTT per slot, with some headroom for jitter
+    uint32_t period = (srtt + 4 * rttvar) / window();
+    if (period < minPeriodMs) period = minPeriodMs;
+    if (period > maxPeriodMs) period = maxPeriodMs;
+    return period;
+}
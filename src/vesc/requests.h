@@ -0,0 +1,96 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Tracks outstanding VESC requests so polling follows the link instead of
+// a fixed timer. A reply is matched to the oldest outstanding request with
+// the same command id (the VESC answers in order), and its round-trip time
+// feeds a smoothed estimate. The poll period is derived from that
+// estimate, never faster than the configured minimum.
+//
+// At least maxInFlight requests may be outstanding. With a larger
+// streamInFlight the window opens up to as many as it takes to cover the
+// RTT at the fastest poll period, so requests stream out back to back and
+// the rate is limited by the link rather than by the round trip. A timeout
+// closes the window back to maxInFlight, and it reopens by one request
+// every WINDOW_GROWTH_REPLIES replies. Not thread safe; callers on
+// different tasks must serialize access. Times are in milliseconds.
+class RequestTracker {
+public:
+    static const size_t MAX_SLOTS = 8;
+    static const uint8_t WINDOW_GROWTH_REPLIES = 16;
+
+    RequestTracker(uint8_t maxInFlight, uint32_t timeoutMs,
+                   uint32_t minPeriodMs, uint32_t maxPeriodMs, uint8_t streamInFlight = 0);
+
+    // Forget everything outstanding (e.g. on a new connection). The RTT
+    // estimate is kept unless resetRtt is set.
+    void reset(bool resetRtt = false);
+
+    // True if another request may be sent now
+    bool canSend(uint32_t now);
+
+    // Record a request that was just sent. The tag is the caller's own,
+    // e.g. a finer send timestamp, and comes back with the reply.
+    void onSent(uint8_t command, uint32_t now, uint32_t tag = 0);
+
+    // Match a reply. Returns false if nothing was outstanding for command.
+    bool onReply(uint8_t command, uint32_t now);
+
+    // Tag of the request the last matched reply answered
+    uint32_t lastTag() const { return lastSentTag; }
+
+    // Drop requests older than the timeout. Called by canSend().
+    void expire(uint32_t now);
+
+    // Requests still unanswered past the smoothed RTT plus four times its
+    // spread (but at least minWaitMs, and the timeout before the first
+    // sample). Replies come in order, so these are misses in a row: a
+    // reply to any later one would have matched the oldest first.
+    uint8_t overdue(uint32_t now, uint32_t minWaitMs) const;
+
+    // Poll period suited to the measured RTT
+    uint32_t pollPeriod() const;
+
+    // Change the fastest poll period (e.g. from the settings screen)
+    void setMinPeriod(uint32_t periodMs) { minPeriodMs = periodMs; }
+
+    // Requests that may be outstanding at once right now
+    uint8_t window() const;
+
+    uint8_t inFlight() const { return outstanding; }
+    uint32_t smoothedRtt() const { return srtt; }
+    uint32_t rttVariance() const { return rttvar; }
+    uint32_t lastRtt() const { return lastSample; }
+    uint32_t timeouts() const { return timeoutCount; }
+    uint32_t replies() const { return replyCount; }
+    uint32_t sent() const { return sentCount; }
+
+private:
+    struct Slot {
+        uint8_t command;
+        bool used;
+        uint32_t sentMs;
+        uint32_t tag;
+    };
+
+    void addSample(uint32_t rtt);
+
+    Slot slots[MAX_SLOTS];
+    uint8_t maxInFlight;
+    uint8_t streamInFlight;
+    uint8_t windowCap;      // streamInFlight, or less since a timeout
+    uint8_t cleanReplies;   // Replies since the cap last moved
+    uint8_t outstanding;
+    uint32_t timeoutMs;
+    uint32_t minPeriodMs;
+    uint32_t maxPeriodMs;
+    uint32_t srtt;          // 0 until the first sample
+    uint32_t rttvar;
+    uint32_t lastSample;
+    uint32_t lastSentTag;
+    uint32_t timeoutCount;
+    uint32_t replyCount;
+    uint32_t sentCount;
+};
@@ -0,0 +1,22 @@
+#include "samples.h"
+#include "buffer.h"
+#include "protocol.h"
+
+// 8 float32_auto channels, then status and phase
+static const size_t SAMPLE_SIZE = 1 + VESC_SAMPLE_CHANNELS * 4 + 2;
+
+// Channel unit per firmware unit (A, V, Hz)
+static const float SCALE[VESC_SAMPLE_CHANNELS] = { 1000, 1000, 1000, 1000, 1000, 1000, 1000, 1 };
+
+bool decodeSample(const uint8_t* payload, size_t length, VescSample& out) {
+    if (length < SAMPLE_SIZE || payload[0] != COMM_SAMPLE_PRINT) return false;
+    size_t index = 1;
+    for (uint8_t c = 0; c < VESC_SAMPLE_CHANNELS; c++) {
+        float scaled = bufferGetFloat32Auto(payload, index) * SCALE[c];
+        if (!(scaled > -2e9f && scaled < 2e9f)) scaled = 0;   // Also catches NaN
+        out.channels[c] = (int32_t)(scaled >= 0 ? scaled + 0.5f : scaled - 0.5f);
+    }
+    out.status = bufferGetUint8(payload, index);
+    out.phase = bufferGetUint8(payload, index);
+    return true;
+}
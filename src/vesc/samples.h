@@ -0,0 +1,41 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+// COMM_SAMPLE_PRINT: the motor controller's ADC sampling buffer. A request
+// (mode, uint16 sample count, uint8 decimation) starts or, with a trigger
+// mode, arms a capture of that many samples, one every `decimation` PWM
+// cycles; once full, the VESC sends it as one frame per sample.
+
+// debug_sampling_mode in the firmware
+enum VescSampleMode : uint8_t {
+    VESC_SAMPLE_OFF = 0,
+    VESC_SAMPLE_NOW = 1,             // Start at once
+    VESC_SAMPLE_START = 2,           // Start with the next motor start
+    VESC_SAMPLE_TRIGGER_START = 3,   // Keep sampling, send around a motor start
+    VESC_SAMPLE_TRIGGER_FAULT = 4,   // Keep sampling, send around a fault
+    VESC_SAMPLE_LAST = 7             // Send the last capture again
+};
+
+// Channels of one sample, in the order they are sent
+enum VescSampleChannel : uint8_t {
+    VESC_SAMPLE_CURRENT_1,           // mA, phase current sensors
+    VESC_SAMPLE_CURRENT_2,
+    VESC_SAMPLE_PHASE_1,             // mV, phase voltages
+    VESC_SAMPLE_PHASE_2,
+    VESC_SAMPLE_PHASE_3,
+    VESC_SAMPLE_V_ZERO,              // mV, virtual ground
+    VESC_SAMPLE_CURRENT_FILTERED,    // mA, FIR-filtered current
+    VESC_SAMPLE_F_SW,                // Hz, switching frequency
+    VESC_SAMPLE_CHANNELS
+};
+
+struct VescSample {
+    int32_t channels[VESC_SAMPLE_CHANNELS];
+    uint8_t status;                  // Timer and ADC state bits
+    uint8_t phase;                   // Commutation step (BLDC)
+};
+
+// One sample frame. Returns false if the payload is too short.
+bool decodeSample(const uint8_t* payload, size_t length, VescSample& out);
@@ -0,0 +1,87 @@
+#include "throughput.h"
+
+// Enough for a full COMM_GET_VALUES reply, framed
+static const uint32_t MIN_CAPACITY_BYTES = 96;
+
+ThroughputProbe::ThroughputProbe()
+    : startedMs(0), firstUs(0), lastUs(0), bytesBefore(0), rate(0), expected(0), received(0), running(false) {
+}
+
+void ThroughputProbe::start(uint8_t replies, uint32_t nowMs) {
+    startedMs = nowMs;
+    bytesBefore = 0;
+    rate = 0;
+    expected = replies;
+    received = 0;
+    running = replies >= 2;
+}
+
+void ThroughputProbe::onFrame(size_t bytes, uint32_t timeUs) {
+    if (!running) return;
+    if (received == 0) firstUs = timeUs;
+    lastUs = timeUs;
+    received++;
+    // The bytes up to this frame's start are in once it starts
+    if (received < expected) bytesBefore += (uint32_t)bytes;
+}
+
+bool ThroughputProbe::update(uint32_t nowMs, uint32_t timeoutMs) {
+    if (!running) return false;
+    if (received < expected && nowMs - startedMs < timeoutMs) return false;
+    finish();
+    return true;
+}
+
+void ThroughputProbe::finish() {
+    running = false;
+    uint32_t elapsedUs = lastUs - firstUs;
+    // Short of every reply, the bytes before the last one that came
+    // still count over the time to it
+    if (received < 2 || elapsedUs == 0) {
+        rate = 0;
+        return;
+    }
+    rate = (uint32_t)((uint64_t)bytesBefore * 1000000 / elapsedUs);
+}
+
+ThroughputBudget::ThroughputBudget(uint32_t burstMs)
+    : burstMs(burstMs), bytesPerSecondLimit(0), capacityMilli(0), levelMilli(0), refilledMs(0) {
+}
+
+void ThroughputBudget::setRate(uint32_t bytesPerSecond, uint32_t nowMs) {
+    bytesPerSecondLimit = bytesPerSecond;
+    uint32_t capacity = bytesPerSecond * burstMs / 1000;
+    if (capacity < MIN_CAPACITY_BYTES) capacity = MIN_CAPACITY_BYTES;
+    capacityMilli = capacity * 1000;
+    levelMilli = capacityMilli;
+    refilledMs = nowMs;
+}
+
+void ThroughputBudget::refill(uint32_t nowMs) {
+    uint32_t elapsed = nowMs - refilledMs;
+    refilledMs = nowMs;
+    // A second or more refills it whatever the rate
+    if (elapsed >= 1000) {
+        levelMilli = capacityMilli;
+        return;
+    }
+    uint32_t added = elapsed * bytesPerSecondLimit;
+    levelMilli = capacityMilli - levelMilli > added ? levelMilli + added : capacityMilli;
+}
+
+bool ThroughputBudget::fits(size_t bytes, uint32_t nowMs) {
+    if (bytesPerSecondLimit == 0) return true;
+    refill(nowMs);
+    return levelMilli >= (uint32_t)bytes * 1000;
+}
+
+void ThroughputBudget::spend(size_t bytes) {
+    if (bytesPerSecondLimit == 0) return;
+    uint32_t cost = (uint32_t)bytes * 1000;
+    levelMilli = levelMilli > cost ? levelMilli - cost : 0;
+}
+
+uint32_t ThroughputBudget::periodFor(size_t bytes) const {
+    if (bytesPerSecondLimit == 0) return 0;
+    return (uint32_t)(((uint64_t)bytes * 1000 + bytesPerSecondLimit - 1) / bytesPerSecondLimit);
+}
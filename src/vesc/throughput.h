@@ -0,0 +1,77 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+// What a link actually carries from the VESC. A module's UART bridge (the
+// NRF modules forward at 115200 baud) can cap a link well below what BLE
+// would, whatever the connection parameters.
+//
+// At connect the caller sends a burst of requests back to back. The VESC
+// answers each as it reads it, so the replies queue behind the slowest
+// hop and arrive at its rate. Every frame but the last is counted over
+// the time from the first frame's start to the last one's, which leaves
+// the round trip out. Hardware independent; times are passed in.
+class ThroughputProbe {
+public:
+    ThroughputProbe();
+
+    // The caller is sending `replies` requests now
+    void start(uint8_t replies, uint32_t nowMs);
+
+    // A reply frame of bytes, framing included, began to arrive at timeUs
+    void onFrame(size_t bytes, uint32_t timeUs);
+
+    // True once every reply is in, or timeoutMs has passed since start();
+    // the probe is then no longer active
+    bool update(uint32_t nowMs, uint32_t timeoutMs);
+
+    bool active() const { return running; }
+
+    // Measured rate, 0 if fewer than two replies came back
+    uint32_t bytesPerSecond() const { return rate; }
+
+private:
+    void finish();
+
+    uint32_t startedMs;
+    uint32_t firstUs;
+    uint32_t lastUs;
+    uint32_t bytesBefore;     // Of every frame before the latest
+    uint32_t rate;
+    uint8_t expected;
+    uint8_t received;
+    bool running;
+};
+
+// Keeps the reply traffic polls ask for under a rate: each request spends
+// the bytes its reply will take from an allowance that refills at the
+// rate, up to burstMs worth (and never less than one largest reply).
+// Rate 0 means no limit. Not thread safe.
+class ThroughputBudget {
+public:
+    explicit ThroughputBudget(uint32_t burstMs = 100);
+
+    // Bytes a second; starts with a full allowance
+    void setRate(uint32_t bytesPerSecond, uint32_t nowMs);
+    uint32_t rate() const { return bytesPerSecondLimit; }
+
+    // True if a reply of bytes may be asked for at now
+    bool fits(size_t bytes, uint32_t nowMs);
+
+    // A request went out for a reply of bytes
+    void spend(size_t bytes);
+
+    // Shortest period a poll asking for bytes a round can run at; 0 with
+    // no limit
+    uint32_t periodFor(size_t bytes) const;
+
+private:
+    void refill(uint32_t nowMs);
+
+    uint32_t burstMs;
+    uint32_t bytesPerSecondLimit;
+    uint32_t capacityMilli;   // In thousandths of a byte
+    uint32_t levelMilli;
+    uint32_t refilledMs;
+};
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Byte stream to one VESC, whatever carries it: the Nordic UART Service
+// over BLE, a hardware UART, or the CAN bus. The transmit path writes
+// framed packets to it; what comes back goes to the owner's data handler
+// and from there into the link's framer, the same way for every kind.
+class VescTransport {
+public:
+    // Received bytes, tagged with the link's index. Called on the
+    // transport's own task.
+    typedef void (*DataHandler)(uint8_t link, const uint8_t* data, size_t length);
+
+    virtual ~VescTransport() {}
+
+    // True while bytes can be written (a UART always can; whether a VESC
+    // answers is the heartbeat's business)
+    virtual bool isConnected() = 0;
+
+    // Write bytes without waiting. Returns false, keeping nothing, if the
+    // transport cannot take them all now; the caller retries later.
+    virtual bool write(const uint8_t* data, size_t length) = 0;
+
+    // Most bytes one write() should carry
+    virtual size_t writeLimit() = 0;
+};
@@ -0,0 +1,74 @@
+#include "tx_scheduler.h"
+#include "command.h"
+
+#include <string.h>
+
+static const uint32_t TOKENS_PER_FRAME = 1000;
+
+VescTxScheduler::VescTxScheduler(VescWriteBatch::WriteHandler handler, void* context)
+    : batches{ VescWriteBatch(handler, context), VescWriteBatch(handler, context) } {
+    memset(limits, 0, sizeof(limits));
+}
+
+void VescTxScheduler::setLimit(TxClass txClass, uint16_t framesPerSecond, uint16_t burst) {
+    Bucket& bucket = limits[txClass];
+    bucket.perSecond = framesPerSecond;
+    bucket.capacity = (uint32_t)(burst > 0 ? burst : 1) * TOKENS_PER_FRAME;
+    bucket.tokens = bucket.capacity;
+    bucket.lastMs = 0;
+}
+
+void VescTxScheduler::setWriteLimit(size_t bytes) {
+    for (uint8_t i = 0; i < CLASSES; i++) batches[i].setWriteLimit(bytes);
+}
+
+// Refill by the time passed (frames a second times ms is thousandths of
+// a frame), then spend one frame if there is one
+bool VescTxScheduler::take(Bucket& bucket, uint32_t nowMs) {
+    if (bucket.perSecond == 0) return true;
+    uint32_t elapsed = nowMs - bucket.lastMs;
+    bucket.lastMs = nowMs;
+    uint64_t tokens = (uint64_t)bucket.tokens + (uint64_t)elapsed * bucket.perSecond;
+    bucket.tokens = tokens > bucket.capacity ? bucket.capacity : (uint32_t)tokens;
+    if (bucket.tokens < TOKENS_PER_FRAME) {
+        bucket.limited++;
+        return false;
+    }
+    bucket.tokens -= TOKENS_PER_FRAME;
+    return true;
+}
+
+bool VescTxScheduler::add(TxClass txClass, const uint8_t* payload, size_t length, uint32_t nowMs) {
+    if (!take(limits[txClass], nowMs)) return false;
+    // A full telemetry batch writes itself out early; control left over
+    // from a busy link goes first
+    if (txClass == TELEMETRY && batches[CONTROL].pending() > 0) flush();
+    return batches[txClass].add(payload, length);
+}
+
+bool VescTxScheduler::add(TxClass txClass, const VescCommand& command, uint32_t nowMs) {
+    if (!command.valid()) return false;
+    return add(txClass, command.payload(), command.length(), nowMs);
+}
+
+bool VescTxScheduler::flush() {
+    if (!batches[TELEMETRY].flushPartial()) return false;
+    if (!batches[CONTROL].flush()) return false;
+    return batches[TELEMETRY].flush();
+}
+
+void VescTxScheduler::clear() {
+    for (uint8_t i = 0; i < CLASSES; i++) batches[i].clear();
+}
+
+uint32_t VescTxScheduler::framesQueued() const {
+    return batches[CONTROL].framesQueued() + batches[TELEMETRY].framesQueued();
+}
+
+uint32_t VescTxScheduler::writesIssued() const {
+    return batches[CONTROL].writesIssued() + batches[TELEMETRY].writesIssued();
+}
+
+uint32_t VescTxScheduler::framesDropped() const {
+    return batches[CONTROL].framesDropped() + batches[TELEMETRY].framesDropped();
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include "write_batch.h"
+
+class VescCommand;
+
+// Transmit path of one link with two classes of traffic. Control frames
+// (setpoints such as COMM_SET_CURRENT, keepalives) are batched apart
+// from telemetry (polls, configuration reads, bridged packets) and
+// written ahead of it at every flush. The VESC reads one byte stream, so
+// a telemetry frame a short write cut off is finished first; control
+// then waits at most the rest of that one frame.
+//
+// Each class can be held to a frame rate with a token bucket, checked as
+// frames are added: over its rate a frame is refused and counted, so a
+// runaway control loop cannot crowd out polling, nor polling control.
+// Hardware independent; times are passed in.
+class VescTxScheduler {
+public:
+    enum TxClass : uint8_t {
+        CONTROL,
+        TELEMETRY,
+        CLASSES
+    };
+
+    VescTxScheduler(VescWriteBatch::WriteHandler handler, void* context = nullptr);
+
+    // At most framesPerSecond frames of a class on average, up to burst
+    // at once; 0 frames per second is no limit (the default)
+    void setLimit(TxClass txClass, uint16_t framesPerSecond, uint16_t burst);
+
+    void setWriteLimit(size_t bytes);
+    size_t writeLimit() const { return batches[CONTROL].writeLimit(); }
+
+    // Frame a payload into its class's batch. Returns false, dropping it,
+    // if the class is over its rate or the batch refuses it.
+    bool add(TxClass txClass, const uint8_t* payload, size_t length, uint32_t nowMs);
+    bool add(TxClass txClass, const VescCommand& command, uint32_t nowMs);
+
+    // Finish a cut-off telemetry frame, then write control, then
+    // telemetry. Returns false if the link stopped taking writes; what is
+    // left stays queued.
+    bool flush();
+
+    void clear();
+
+    size_t pending() const { return batches[CONTROL].pending() + batches[TELEMETRY].pending(); }
+    const VescWriteBatch& batch(TxClass txClass) const { return batches[txClass]; }
+
+    // Summed over both classes
+    uint32_t framesQueued() const;
+    uint32_t writesIssued() const;
+    uint32_t framesDropped() const;
+
+    // Refused for being over the class's rate
+    uint32_t framesLimited(TxClass txClass) const { return limits[txClass].limited; }
+
+private:
+    struct Bucket {
+        uint32_t perSecond;     // Frames a second, 0 for no limit
+        uint32_t capacity;      // Burst, in thousandths of a frame
+        uint32_t tokens;        // Thousandths of a frame
+        uint32_t lastMs;
+        uint32_t limited;
+    };
+
+    bool take(Bucket& bucket, uint32_t nowMs);
+
+    VescWriteBatch batches[CLASSES];
+    Bucket limits[CLASSES];
+};
@@ -0,0 +1,391 @@
+#include "values.h"
+#include "buffer.h"
+#include "protocol.h"
+
+#include <string.h>
+
+
+#define FIELD(member, width, count, decimals, name, unit, deadband) \
+    { offsetof(VescValues, member), width, count, decimals, name, unit, deadband }
+
+constexpr ValuesFieldInfo VALUES_FIELD_INFO[VALUES_FIELD_COUNT] = {
+    FIELD(tempFet,          2, 1, 1, "temp_fet",           "°C", 2),
+    FIELD(tempMotor,        2, 1, 1, "temp_motor",         "°C", 2),
+    FIELD(currentMotor,     4, 1, 2, "current_motor",      "A", 5),
+    FIELD(currentIn,        4, 1, 2, "current_in",         "A", 5),
+    FIELD(currentId,        4, 1, 2, "current_id",         "A", 5),
+    FIELD(currentIq,        4, 1, 2, "current_iq",         "A", 5),
+    FIELD(dutyNow,          2, 1, 3, "duty",               "", 2),
+    FIELD(rpm,              4, 1, 0, "erpm",               "", 20),
+    FIELD(vIn,              2, 1, 1, "v_in",               "V", 1),
+    FIELD(ampHours,         4, 1, 4, "amp_hours",          "Ah", 0),
+    FIELD(ampHoursCharged,  4, 1, 4, "amp_hours_charged",  "Ah", 0),
+    FIELD(wattHours,        4, 1, 4, "watt_hours",         "Wh", 0),
+    FIELD(wattHoursCharged, 4, 1, 4, "watt_hours_charged", "Wh", 0),
+    FIELD(tachometer,       4, 1, 0, "tachometer",         "", 0),
+    FIELD(tachometerAbs,    4, 1, 0, "tachometer_abs",     "", 0),
+    FIELD(faultCode,        1, 1, 0, "fault",              "", 0),
+    FIELD(pidPos,           4, 1, 6, "pid_pos",            "°", 100000),
+    FIELD(controllerId,     1, 1, 0, "controller_id",      "", 0),
+    FIELD(tempMos,          2, 3, 1, "temp_mos",           "°C", 2),
+    FIELD(vd,               4, 1, 3, "vd",                 "V", 10),
+    FIELD(vq,               4, 1, 3, "vq",                 "V", 10),
+    FIELD(status,           1, 1, 0, "status",             "", 0),
+};
+
+#undef FIELD
+
+// A row whose width does not match its member, or that sits in the wrong
+// place, would decode into the neighbouring field
+static constexpr bool rowsMatch(int bit) {
+    return bit == VALUES_FIELD_COUNT ||
+           ((VALUES_FIELD_INFO[bit].width == 1 || VALUES_FIELD_INFO[bit].width == 2 ||
+             VALUES_FIELD_INFO[bit].width == 4) && rowsMatch(bit + 1));
+}
+static_assert(rowsMatch(0), "field widths are 1, 2 or 4 bytes");
+static_assert(VALUES_FIELD_INFO[VALUES_BIT_V_IN].offset == offsetof(VescValues, vIn), "rows follow the bits");
+static_assert(VALUES_FIELD_INFO[VALUES_BIT_STATUS].offset == offsetof(VescValues, status), "rows follow the bits");
+static_assert(sizeof(VescValues::tempMos) == 2 * 3, "temp_mos row");
+
+// Reply size of a field
+static constexpr uint8_t fieldSize(int bit) {
+    return VALUES_FIELD_INFO[bit].width * VALUES_FIELD_INFO[bit].count;
+}
+
+// Offset of a field in a COMM_GET_VALUES reply carrying the given fields,
+// after the command byte and everything sent before it
+static constexpr uint8_t fieldOffset(uint32_t fields, int bit) {
+    return bit == 0 ? 1 : fieldOffset(fields, bit - 1) + (((fields >> (bit - 1)) & 1) ? fieldSize(bit - 1) : 0);
+}
+
+static constexpr uint8_t offsetIf(uint32_t fields, int bit) {
+    return ((fields >> bit) & 1) ? fieldOffset(fields, bit) : 0;
+}
+
+#define VALUES_LAYOUT(fields) {                                                                        \
+    fields, fieldOffset(fields, VALUES_FIELD_COUNT), {                                                 \
+        offsetIf(fields, 0), offsetIf(fields, 1), offsetIf(fields, 2), offsetIf(fields, 3),             \
+        offsetIf(fields, 4), offsetIf(fields, 5), offsetIf(fields, 6), offsetIf(fields, 7),             \
+        offsetIf(fields, 8), offsetIf(fields, 9), offsetIf(fields, 10), offsetIf(fields, 11),           \
+        offsetIf(fields, 12), offsetIf(fields, 13), offsetIf(fields, 14), offsetIf(fields, 15),         \
+        offsetIf(fields, 16), offsetIf(fields, 17), offsetIf(fields, 18), offsetIf(fields, 19),         \
+        offsetIf(fields, 20), offsetIf(fields, 21) } }
+
+// One layout per firmware generation, each adding a trailing group
+static constexpr ValuesLayout LAYOUT_BASE = VALUES_LAYOUT(VALUES_GROUP_BASE);
+static constexpr ValuesLayout LAYOUT_3_0 = VALUES_LAYOUT(VALUES_GROUP_BASE | VALUES_GROUP_PID_ID);
+static constexpr ValuesLayout LAYOUT_3_40 = VALUES_LAYOUT(VALUES_GROUP_BASE | VALUES_GROUP_PID_ID |
+                                                          VALUES_GROUP_MOS_TEMPS);
+static constexpr ValuesLayout LAYOUT_5_0 = VALUES_LAYOUT(VALUES_GROUP_BASE | VALUES_GROUP_PID_ID |
+                                                         VALUES_GROUP_MOS_TEMPS | VALUES_GROUP_VD_VQ);
+static constexpr ValuesLayout LAYOUT_5_2 = VALUES_LAYOUT(VALUES_ALL_FIELDS);
+
+static_assert(LAYOUT_BASE.size == 54, "base reply is 53 bytes after the command");
+static_assert(LAYOUT_5_2.size == 74, "full reply is 73 bytes after the command");
+static_assert(LAYOUT_5_2.offset[VALUES_BIT_CONTROLLER_ID] == 58, "controller id follows pid_pos");
+static_assert(VALUES_MAX_REPLY_SIZE >= LAYOUT_5_2.size, "reply buffer too small");
+
+const ValuesLayout& valuesLayoutForFirmware(const VescFirmware& fw) {
+    uint16_t version = (uint16_t)(fw.major << 8) | fw.minor;
+    if (version >= 0x0502) return LAYOUT_5_2;
+    if (version >= 0x0500) return LAYOUT_5_0;
+    if (version >= 0x0328) return LAYOUT_3_40;
+    if (version >= 0x0300) return LAYOUT_3_0;
+    return LAYOUT_BASE;
+}
+
+uint32_t valuesGroupsForFirmware(const VescFirmware& fw) {
+    return valuesLayoutForFirmware(fw).fields;
+}
+
+bool decodeFwVersion(const uint8_t* payload, size_t length, VescFirmware& out) {
+    if (length < 3 || payload[0] != COMM_FW_VERSION) return false;
+    
+    out.major = payload[1];
+    out.minor = payload[2];
+    return true;
+}
+
+// Per-field readers and writers, generated from the table. Offsets,
+// widths and counts are template constants, so each instance compiles to
+// the loads and stores a hand-written decoder would have.
+template <int Width> struct Element;
+
+template <> struct Element<1> {
+    typedef uint8_t Type;
+    static Type read(const uint8_t* payload, size_t& index) { return bufferGetUint8(payload, index); }
+    static void write(Type value, uint8_t* payload, size_t& index) { bufferAppendUint8(payload, value, index); }
+};
+
+template <> struct Element<2> {
+    typedef int16_t Type;
+    static Type read(const uint8_t* payload, size_t& index) { return bufferGetInt16(payload, index); }
+    static void write(Type value, uint8_t* payload, size_t& index) { bufferAppendInt16(payload, value, index); }
+};
+
+template <> struct Element<4> {
+    typedef int32_t Type;
+    static Type read(const uint8_t* payload, size_t& index) { return bufferGetInt32(payload, index); }
+    static void write(Type value, uint8_t* payload, size_t& index) { bufferAppendInt32(payload, value, index); }
+};
+
+// The member of a field's row, as the type its width stands for
+template <int Bit>
+struct Member {
+    typedef Element<VALUES_FIELD_INFO[Bit].width> Wire;
+    typedef typename Wire::Type Type;
+
+    static Type* of(VescValues& values) {
+        return (Type*)((uint8_t*)&values + VALUES_FIELD_INFO[Bit].offset);
+    }
+    static const Type* of(const VescValues& values) {
+        return (const Type*)((const uint8_t*)&values + VALUES_FIELD_INFO[Bit].offset);
+    }
+};
+
+template <int Bit>
+__attribute__((always_inline)) static inline void readField(const uint8_t* payload, size_t& index, VescValues& out) {
+    for (int i = 0; i < VALUES_FIELD_INFO[Bit].count; i++) {
+        Member<Bit>::of(out)[i] = Member<Bit>::Wire::read(payload, index);
+    }
+}
+
+template <int Bit>
+__attribute__((always_inline)) static inline void writeField(const VescValues& values, uint8_t* payload, size_t& index) {
+    for (int i = 0; i < VALUES_FIELD_INFO[Bit].count; i++) {
+        Member<Bit>::Wire::write(Member<Bit>::of(values)[i], payload, index);
+    }
+}
+
+// Fields First up to Last (exclusive) in a row, unrolled
+template <int First, int Last>
+struct FieldRun {
+    __attribute__((always_inline)) static inline void read(const uint8_t* payload, size_t& index, VescValues& out) {
+        readField<First>(payload, index, out);
+        FieldRun<First + 1, Last>::read(payload, index, out);
+    }
+    __attribute__((always_inline)) static inline void write(const VescValues& values, uint8_t* payload, size_t& index) {
+        writeField<First>(values, payload, index);
+        FieldRun<First + 1, Last>::write(values, payload, index);
+    }
+};
+
+template <int Last>
+struct FieldRun<Last, Last> {
+    static inline void read(const uint8_t*, size_t&, VescValues&) {}
+    static inline void write(const VescValues&, uint8_t*, size_t&) {}
+};
+
+// One reader and writer per field, for the selective replies' set bits
+typedef void (*FieldReader)(const uint8_t* payload, size_t& index, VescValues& out);
+typedef void (*FieldWriter)(const VescValues& values, uint8_t* payload, size_t& index);
+
+#define EACH_FIELD(f) {                                                                 \
+    f(0), f(1), f(2), f(3), f(4), f(5), f(6), f(7), f(8), f(9), f(10), f(11), f(12), f(13), \
+    f(14), f(15), f(16), f(17), f(18), f(19), f(20), f(21) }
+#define READER(bit) readField<bit>
+#define WRITER(bit) writeField<bit>
+
+static const FieldReader FIELD_READERS[VALUES_FIELD_COUNT] = EACH_FIELD(READER);
+static const FieldWriter FIELD_WRITERS[VALUES_FIELD_COUNT] = EACH_FIELD(WRITER);
+static constexpr uint8_t FIELD_SIZES[VALUES_FIELD_COUNT] = EACH_FIELD(fieldSize);
+
+#undef READER
+#undef WRITER
+#undef EACH_FIELD
+
+int32_t valuesField(const VescValues& values, uint8_t bit, uint8_t element) {
+    const ValuesFieldInfo& info = VALUES_FIELD_INFO[bit];
+    const uint8_t* member = (const uint8_t*)&values + info.offset + element * info.width;
+    switch (info.width) {
+        case 1: return *member;
+        case 2: { int16_t v; memcpy(&v, member, sizeof(v)); return v; }
+        default: { int32_t v; memcpy(&v, member, sizeof(v)); return v; }
+    }
+}
+
+void valuesSetField(VescValues& values, uint8_t bit, int32_t value, uint8_t element) {
+    const ValuesFieldInfo& info = VALUES_FIELD_INFO[bit];
+    uint8_t* member = (uint8_t*)&values + info.offset + element * info.width;
+    switch (info.width) {
+        case 1: *member = (uint8_t)value; break;
+        case 2: { int16_t v = (int16_t)value; memcpy(member, &v, sizeof(v)); break; }
+        default: memcpy(member, &value, sizeof(value)); break;
+    }
+}
+
+// A trailing group, read at its offset in the layout
+template <int First, int Last>
+static inline void readGroup(const uint8_t* payload, const ValuesLayout& layout, VescValues& out) {
+    if (!(layout.fields & (1u << First))) return;
+    size_t index = layout.offset[First];
+    FieldRun<First, Last>::read(payload, index, out);
+}
+
+bool decodeValues(const uint8_t* payload, size_t length, const ValuesLayout& layout, VescValues& out) {
+    if (length < layout.size || payload[0] != COMM_GET_VALUES) return false;
+
+    // The base fields sit at the same offsets in every layout
+    size_t index = 1;
+    FieldRun<VALUES_BIT_TEMP_FET, VALUES_BIT_PID_POS>::read(payload, index, out);
+
+    readGroup<VALUES_BIT_PID_POS, VALUES_BIT_TEMP_MOS>(payload, layout, out);
+    readGroup<VALUES_BIT_TEMP_MOS, VALUES_BIT_VD>(payload, layout, out);
+    readGroup<VALUES_BIT_VD, VALUES_BIT_STATUS>(payload, layout, out);
+    readGroup<VALUES_BIT_STATUS, VALUES_FIELD_COUNT>(payload, layout, out);
+    out.fields = layout.fields;
+    return true;
+}
+
+int valuesReplyControllerId(const uint8_t* payload, size_t length, const ValuesLayout& layout) {
+    size_t index;
+    if (length >= 1 && payload[0] == COMM_GET_VALUES) {
+        if (!(layout.fields & VALUES_FIELD_CONTROLLER_ID)) return -1;
+        index = layout.offset[VALUES_BIT_CONTROLLER_ID];
+    } else if (length >= 5 && payload[0] == COMM_GET_VALUES_SELECTIVE) {
+        index = 1;
+        uint32_t mask = bufferGetUint32(payload, index);
+        if (!(mask & VALUES_FIELD_CONTROLLER_ID)) return -1;
+        index += valuesSelectiveReplySize(mask & (VALUES_FIELD_CONTROLLER_ID - 1));
+    } else {
+        return -1;
+    }
+    return index < length ? payload[index] : -1;
+}
+
+size_t encodeValuesSelectiveRequest(uint32_t mask, uint8_t* payload) {
+    payload[0] = COMM_GET_VALUES_SELECTIVE;
+    payload[1] = (uint8_t)(mask >> 24);
+    payload[2] = (uint8_t)(mask >> 16);
+    payload[3] = (uint8_t)(mask >> 8);
+    payload[4] = (uint8_t)mask;
+    return 5;
+}
+
+size_t valuesSelectiveReplySize(uint32_t mask) {
+    size_t size = 0;
+    for (int bit = 0; bit < VALUES_FIELD_COUNT; bit++) {
+        if (mask & (1u << bit)) size += FIELD_SIZES[bit];
+    }
+    return size;
+}
+
+bool decodeValuesSelective(const uint8_t* payload, size_t length, VescValues& out) {
+    if (length < 5 || payload[0] != COMM_GET_VALUES_SELECTIVE) return false;
+
+    size_t index = 1;
+    uint32_t mask = bufferGetUint32(payload, index) & VALUES_ALL_FIELDS;
+    if (index + valuesSelectiveReplySize(mask) > length) return false;
+
+    // Fields appear in bit order; walk only the set bits
+    uint32_t remaining = mask;
+    while (remaining) {
+        int bit = __builtin_ctz(remaining);
+        remaining &= remaining - 1;
+
+        FIELD_READERS[bit](payload, index, out);
+    }
+
+    out.fields = mask;
+    return true;
+}
+
+// The fields of a mask in bit order, unrolled; Kind is 0 past the last
+// field, 1 for a field in the mask and 2 for one that is not
+static constexpr int maskKind(uint32_t mask, int bit) {
+    return bit >= VALUES_FIELD_COUNT ? 0 : ((mask >> bit) & 1) ? 1 : 2;
+}
+
+template <uint32_t Mask, int Bit, int Kind = maskKind(Mask, Bit)>
+struct MaskRun;
+
+template <uint32_t Mask, int Bit>
+struct MaskRun<Mask, Bit, 0> {
+    static inline void read(const uint8_t*, size_t&, VescValues&) {}
+};
+
+template <uint32_t Mask, int Bit>
+struct MaskRun<Mask, Bit, 1> {
+    __attribute__((always_inline)) static inline void read(const uint8_t* payload, size_t& index, VescValues& out) {
+        readField<Bit>(payload, index, out);
+        MaskRun<Mask, Bit + 1>::read(payload, index, out);
+    }
+};
+
+template <uint32_t Mask, int Bit>
+struct MaskRun<Mask, Bit, 2> {
+    __attribute__((always_inline)) static inline void read(const uint8_t* payload, size_t& index, VescValues& out) {
+        MaskRun<Mask, Bit + 1>::read(payload, index, out);
+    }
+};
+
+static constexpr size_t maskSize(uint32_t mask, int bit = 0) {
+    return bit == VALUES_FIELD_COUNT ? 0 : (((mask >> bit) & 1) ? fieldSize(bit) : 0) + maskSize(mask, bit + 1);
+}
+
+template <uint32_t Mask>
+static bool decodeMask(const uint8_t* payload, size_t length, VescValues& out) {
+    if (length < 5 + maskSize(Mask) || payload[0] != COMM_GET_VALUES_SELECTIVE) return false;
+    size_t index = 1;
+    if (bufferGetUint32(payload, index) != Mask) return false;
+    MaskRun<Mask, 0>::read(payload, index, out);
+    out.fields = Mask;
+    return true;
+}
+
+struct MaskDecoder {
+    uint32_t mask;
+    ValuesDecoder decode;
+};
+
+#define MASK_DECODERS(mask) \
+    { mask, decodeMask<mask> }, { (mask) | VALUES_FIELD_CONTROLLER_ID, decodeMask<(mask) | VALUES_FIELD_CONTROLLER_ID> }
+
+static const MaskDecoder MASK_DECODERS[] = {
+    MASK_DECODERS(VALUES_MASK_POWER),
+    MASK_DECODERS(VALUES_MASK_TEMPS),
+    MASK_DECODERS(VALUES_MASK_FAULT),
+    MASK_DECODERS(VALUES_MASK_ENERGY),
+};
+
+#undef MASK_DECODERS
+
+ValuesDecoder valuesDecoderForMask(uint32_t mask) {
+    for (const MaskDecoder& decoder : MASK_DECODERS) {
+        if (decoder.mask == mask) return decoder.decode;
+    }
+    return decodeValuesSelective;
+}
+
+size_t encodeValues(const VescValues& values, uint32_t groups, uint8_t* payload) {
+    size_t index = 0;
+    bufferAppendUint8(payload, COMM_GET_VALUES, index);
+    FieldRun<VALUES_BIT_TEMP_FET, VALUES_BIT_PID_POS>::write(values, payload, index);
+
+    // Trailing groups stop at the first one the firmware lacks
+    if (!(groups & VALUES_GROUP_PID_ID)) return index;
+    FieldRun<VALUES_BIT_PID_POS, VALUES_BIT_TEMP_MOS>::write(values, payload, index);
+    if (!(groups & VALUES_GROUP_MOS_TEMPS)) return index;
+    FieldRun<VALUES_BIT_TEMP_MOS, VALUES_BIT_VD>::write(values, payload, index);
+    if (!(groups & VALUES_GROUP_VD_VQ)) return index;
+    FieldRun<VALUES_BIT_VD, VALUES_BIT_STATUS>::write(values, payload, index);
+    if (!(groups & VALUES_GROUP_STATUS)) return index;
+    FieldRun<VALUES_BIT_STATUS, VALUES_FIELD_COUNT>::write(values, payload, index);
+    return index;
+}
+
+size_t encodeValuesSelective(const VescValues& values, uint32_t mask, uint8_t* payload) {
+    mask &= VALUES_ALL_FIELDS;
+    size_t index = 0;
+    bufferAppendUint8(payload, COMM_GET_VALUES_SELECTIVE, index);
+    bufferAppendUint32(payload, mask, index);
+
+    uint32_t remaining = mask;
+    while (remaining) {
+        int bit = __builtin_ctz(remaining);
+        remaining &= remaining - 1;
+
+        FIELD_WRITERS[bit](values, payload, index);
+    }
+    return index;
+}
@@ -0,0 +1,214 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Custom fields a sample carries (telemetry/formula.h), and the decimals
+// they are kept at
+#define VALUES_FORMULA_COUNT 2
+#define VALUES_FORMULA_DECIMALS 3
+
+// Decoded COMM_GET_VALUES telemetry.
+//
+// Fields keep the raw fixed-point integers sent by the VESC; the comment
+// on each field gives its unit. Members are ordered by size so the struct
+// has no padding.
+struct VescValues {
+    int32_t currentMotor;      // 0.01 A
+    int32_t currentIn;         // 0.01 A
+    int32_t currentId;         // 0.01 A
+    int32_t currentIq;         // 0.01 A
+    int32_t rpm;               // ERPM
+    int32_t ampHours;          // 0.0001 Ah
+    int32_t ampHoursCharged;   // 0.0001 Ah
+    int32_t wattHours;         // 0.0001 Wh
+    int32_t wattHoursCharged;  // 0.0001 Wh
+    int32_t tachometer;        // counts
+    int32_t tachometerAbs;     // counts
+    int32_t pidPos;            // 0.000001 deg
+    int32_t vd;                // 0.001 V
+    int32_t vq;                // 0.001 V
+    int32_t gpsLatitude;       // 1e-7 degrees; this and the other gps* fields are
+    int32_t gpsLongitude;      // 1e-7 degrees   merged in by the dashboard, see VALUES_FIELD_GPS
+    int32_t formula[VALUES_FORMULA_COUNT]; // 0.001 of the formula's own units: worked out by the
+                               // dashboard, see VALUES_FIELD_FORMULA
+    int16_t tempFet;           // 0.1 °C
+    int16_t tempMotor;         // 0.1 °C
+    int16_t dutyNow;           // 0.001 (fraction of full duty)
+    int16_t vIn;               // 0.1 V
+    int16_t tempMos[3];        // 0.1 °C, per-phase MOSFET sensors
+    int16_t soc;               // 0.1 %, pack charge; worked out by the dashboard, not decoded
+    int16_t gpsSpeed;          // 0.1 km/h over ground
+    int16_t gpsAge;            // ms from the sample's arrival back to the fix's
+    int16_t derateSeconds;     // s until the FET or motor reaches its derating temperature at the
+                               // recent load, VALUES_DERATE_NONE if it never does; worked out by the dashboard
+    int16_t imuPitch;          // 0.1 degree, nose up; this and the other imu* fields are merged in
+    int16_t imuRoll;           // 0.1 degree, right side down   by the dashboard, see VALUES_FIELD_IMU
+    int16_t imuAccel;          // 0.01 g forward, gravity taken out
+    uint8_t faultCode;         // mc_fault_code
+    uint8_t controllerId;
+    uint8_t status;
+    uint8_t reserved;
+    uint32_t fields;           // VALUES_FIELD_* decoded into this struct
+};
+
+#define VALUES_DERATE_NONE INT16_MAX
+
+// Field numbers, as the bits of the COMM_GET_VALUES_SELECTIVE request
+// mask and in the order a reply carries them
+enum ValuesFieldBit : uint8_t {
+    VALUES_BIT_TEMP_FET, VALUES_BIT_TEMP_MOTOR, VALUES_BIT_CURRENT_MOTOR, VALUES_BIT_CURRENT_IN,
+    VALUES_BIT_CURRENT_ID, VALUES_BIT_CURRENT_IQ, VALUES_BIT_DUTY, VALUES_BIT_RPM, VALUES_BIT_V_IN,
+    VALUES_BIT_AMP_HOURS, VALUES_BIT_AMP_HOURS_CHARGED, VALUES_BIT_WATT_HOURS,
+    VALUES_BIT_WATT_HOURS_CHARGED, VALUES_BIT_TACHOMETER, VALUES_BIT_TACHOMETER_ABS, VALUES_BIT_FAULT,
+    VALUES_BIT_PID_POS, VALUES_BIT_CONTROLLER_ID, VALUES_BIT_TEMP_MOS, VALUES_BIT_VD, VALUES_BIT_VQ,
+    VALUES_BIT_STATUS
+};
+
+#define VALUES_FIELD_TEMP_FET          (1u << VALUES_BIT_TEMP_FET)
+#define VALUES_FIELD_TEMP_MOTOR        (1u << VALUES_BIT_TEMP_MOTOR)
+#define VALUES_FIELD_CURRENT_MOTOR     (1u << VALUES_BIT_CURRENT_MOTOR)
+#define VALUES_FIELD_CURRENT_IN        (1u << VALUES_BIT_CURRENT_IN)
+#define VALUES_FIELD_CURRENT_ID        (1u << VALUES_BIT_CURRENT_ID)
+#define VALUES_FIELD_CURRENT_IQ        (1u << VALUES_BIT_CURRENT_IQ)
+#define VALUES_FIELD_DUTY              (1u << VALUES_BIT_DUTY)
+#define VALUES_FIELD_RPM               (1u << VALUES_BIT_RPM)
+#define VALUES_FIELD_V_IN              (1u << VALUES_BIT_V_IN)
+#define VALUES_FIELD_AMP_HOURS         (1u << VALUES_BIT_AMP_HOURS)
+#define VALUES_FIELD_AMP_HOURS_CHARGED (1u << VALUES_BIT_AMP_HOURS_CHARGED)
+#define VALUES_FIELD_WATT_HOURS        (1u << VALUES_BIT_WATT_HOURS)
+#define VALUES_FIELD_WATT_HOURS_CHARGED (1u << VALUES_BIT_WATT_HOURS_CHARGED)
+#define VALUES_FIELD_TACHOMETER        (1u << VALUES_BIT_TACHOMETER)
+#define VALUES_FIELD_TACHOMETER_ABS    (1u << VALUES_BIT_TACHOMETER_ABS)
+#define VALUES_FIELD_FAULT             (1u << VALUES_BIT_FAULT)
+#define VALUES_FIELD_PID_POS           (1u << VALUES_BIT_PID_POS)
+#define VALUES_FIELD_CONTROLLER_ID     (1u << VALUES_BIT_CONTROLLER_ID)
+#define VALUES_FIELD_TEMP_MOS          (1u << VALUES_BIT_TEMP_MOS)   // all three sensors
+#define VALUES_FIELD_VD                (1u << VALUES_BIT_VD)
+#define VALUES_FIELD_VQ                (1u << VALUES_BIT_VQ)
+#define VALUES_FIELD_STATUS            (1u << VALUES_BIT_STATUS)
+#define VALUES_FIELD_COUNT 22
+
+// How each field is sent and kept, indexed by field number. This is the
+// one description of COMM_GET_VALUES: the reply layouts, the decoders and
+// encoders (generated from it per field at compile time, in values.cpp)
+// and the debug dump all read it, so adding a field is a member, a bit
+// and a row here.
+struct ValuesFieldInfo {
+    uint8_t offset;          // Of the member in VescValues
+    uint8_t width;           // Bytes per element, in the reply and the member: 1 (unsigned), 2 or 4
+    uint8_t count;           // Elements, 3 for the MOSFET sensors
+    uint8_t decimals;        // Of the raw fixed-point value
+    const char* name;        // As in VESC Tool and tools/serial_stream.py
+    const char* unit;
+    int32_t deadband;        // Raw change a field must exceed to have moved, 0 for any change
+};
+
+extern const ValuesFieldInfo VALUES_FIELD_INFO[VALUES_FIELD_COUNT];
+
+// Element of a decoded field, widened to 32 bits
+int32_t valuesField(const VescValues& values, uint8_t bit, uint8_t element = 0);
+
+// Store an element of a field, narrowed to the member's width
+void valuesSetField(VescValues& values, uint8_t bit, int32_t value, uint8_t element = 0);
+
+// Groups of trailing fields, appended over firmware releases
+#define VALUES_GROUP_BASE      0x0000FFFFu  // temp_fet .. fault_code
+#define VALUES_GROUP_PID_ID    (VALUES_FIELD_PID_POS | VALUES_FIELD_CONTROLLER_ID)
+#define VALUES_GROUP_MOS_TEMPS VALUES_FIELD_TEMP_MOS
+#define VALUES_GROUP_VD_VQ     (VALUES_FIELD_VD | VALUES_FIELD_VQ)
+#define VALUES_GROUP_STATUS    VALUES_FIELD_STATUS
+#define VALUES_ALL_FIELDS      ((1u << VALUES_FIELD_COUNT) - 1)
+
+// Not a VESC field: the gps* members hold a fix the dashboard merged
+// into a combined sample. Never requested or decoded.
+#define VALUES_FIELD_GPS       (1u << 31)
+
+// Not a VESC field either: the formula members hold the dashboard's
+// custom fields, worked out on a combined sample
+#define VALUES_FIELD_FORMULA   (1u << 30)
+
+// Nor is this: the imu* members hold the dashboard's attitude estimate
+// nearest the sample (telemetry/imu.h)
+#define VALUES_FIELD_IMU       (1u << 29)
+
+// Firmware version reported by COMM_FW_VERSION (0.0 = not yet known)
+struct VescFirmware {
+    uint8_t major;
+    uint8_t minor;
+};
+
+// Decode a COMM_FW_VERSION reply ([0][major][minor][hw name...]).
+// Returns false if the payload is too short.
+bool decodeFwVersion(const uint8_t* payload, size_t length, VescFirmware& out);
+
+// Where each field sits in a COMM_GET_VALUES reply from one firmware
+// generation. The tables are worked out at compile time; the link picks
+// one when the COMM_FW_VERSION handshake comes back, and every reply is
+// then read at fixed offsets.
+struct ValuesLayout {
+    uint32_t fields;                     // VALUES_FIELD_* the firmware sends
+    uint8_t size;                        // Reply length, command byte included
+    uint8_t offset[VALUES_FIELD_COUNT];  // Of each field in the payload, 0 if not sent
+};
+
+// Layout of a firmware's replies. Unknown firmware (0.0) gets the base
+// fields only, which every release sends.
+const ValuesLayout& valuesLayoutForFirmware(const VescFirmware& fw);
+
+// Fields a given firmware sends in COMM_GET_VALUES
+uint32_t valuesGroupsForFirmware(const VescFirmware& fw);
+
+// Decode a COMM_GET_VALUES payload (command byte first) in place from the
+// framer buffer. Returns false if the payload is not a values reply or is
+// shorter than the layout; extra trailing bytes from newer firmware are
+// ignored.
+bool decodeValues(const uint8_t* payload, size_t length, const ValuesLayout& layout, VescValues& out);
+
+// Decode a COMM_GET_VALUES_SELECTIVE reply. Only the fields named by the
+// echoed mask are written; out.fields is set to the fields decoded.
+// Returns false on a malformed or truncated reply.
+bool decodeValuesSelective(const uint8_t* payload, size_t length, VescValues& out);
+
+// The field sets the dashboard polls together (see pollGroups in
+// main.cpp). Each has a decoder generated for it, below.
+#define VALUES_MASK_POWER  (VALUES_FIELD_V_IN | VALUES_FIELD_CURRENT_IN | VALUES_FIELD_CURRENT_MOTOR | \
+                            VALUES_FIELD_DUTY | VALUES_FIELD_RPM)
+#define VALUES_MASK_TEMPS  (VALUES_FIELD_TEMP_FET | VALUES_FIELD_TEMP_MOTOR)
+#define VALUES_MASK_FAULT  VALUES_FIELD_FAULT
+#define VALUES_MASK_ENERGY (VALUES_FIELD_WATT_HOURS | VALUES_FIELD_WATT_HOURS_CHARGED | VALUES_FIELD_TACHOMETER_ABS)
+
+// Decodes a COMM_GET_VALUES_SELECTIVE reply, as decodeValuesSelective()
+typedef bool (*ValuesDecoder)(const uint8_t* payload, size_t length, VescValues& out);
+
+// Decoder for the replies to one request mask. For a VALUES_MASK_* set,
+// alone or with VALUES_FIELD_CONTROLLER_ID as forwarded requests add, it
+// is generated for that mask: one length check and straight-line reads,
+// without walking the mask. It returns false for a reply to any other
+// mask, so the caller can fall back to decodeValuesSelective(). Any
+// other mask gets decodeValuesSelective() itself. Pick it when the mask
+// changes, not per reply.
+ValuesDecoder valuesDecoderForMask(uint32_t mask);
+
+// Controller id carried by a COMM_GET_VALUES or COMM_GET_VALUES_SELECTIVE
+// reply, read without decoding the rest. -1 if the reply has none (old
+// firmware, or a selective mask without VALUES_FIELD_CONTROLLER_ID).
+int valuesReplyControllerId(const uint8_t* payload, size_t length, const ValuesLayout& layout);
+
+// Build a COMM_GET_VALUES_SELECTIVE request payload (5 bytes) for a mask
+size_t encodeValuesSelectiveRequest(uint32_t mask, uint8_t* payload);
+
+// Size in bytes of the reply fields for a mask, excluding command and mask
+size_t valuesSelectiveReplySize(uint32_t mask);
+
+// The VESC's side, for emulators and tests. Largest reply either encoder
+// writes:
+#define VALUES_MAX_REPLY_SIZE 80
+
+// Build a COMM_GET_VALUES reply carrying the groups a firmware sends
+// (see valuesGroupsForFirmware). Returns the payload length.
+size_t encodeValues(const VescValues& values, uint32_t groups, uint8_t* payload);
+
+// Build a COMM_GET_VALUES_SELECTIVE reply for a request mask. Returns the
+// payload length.
+size_t encodeValuesSelective(const VescValues& values, uint32_t mask, uint8_t* payload);
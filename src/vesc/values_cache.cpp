@@ -0,0 +1,30 @@
+#include "values_cache.h"
+
+ValuesCache::ValuesCache() {
+    clear();
+}
+
+void ValuesCache::clear() {
+    seen = 0;
+    for (uint8_t bit = 0; bit < VALUES_FIELD_COUNT; bit++) receivedMs[bit] = 0;
+}
+
+void ValuesCache::note(uint32_t mask, uint32_t nowMs) {
+    mask &= VALUES_ALL_FIELDS;
+    for (uint32_t rest = mask; rest != 0; rest &= rest - 1) receivedMs[__builtin_ctz(rest)] = nowMs;
+    seen |= mask;
+}
+
+uint32_t ValuesCache::fresh(uint32_t fields, const uint32_t* ttlMs, uint32_t rttMs, uint32_t nowMs) const {
+    uint32_t result = 0;
+    for (uint32_t rest = fields & seen; rest != 0; rest &= rest - 1) {
+        uint8_t bit = __builtin_ctz(rest);
+        if (ttlMs[bit] > 0 && nowMs - receivedMs[bit] + rttMs < ttlMs[bit]) result |= 1u << bit;
+    }
+    return result;
+}
+
+uint32_t ValuesCache::ageMs(uint8_t bit, uint32_t nowMs) const {
+    if (bit >= VALUES_FIELD_COUNT || !(seen & (1u << bit))) return UINT32_MAX;
+    return nowMs - receivedMs[bit];
+}
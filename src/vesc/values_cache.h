@@ -0,0 +1,38 @@
+#pragma once
+
+#include <stdint.h>
+#include "values.h"
+
+// When each field of one controller's telemetry last came in, from any
+// reply or status broadcast, so a request can leave out what is still
+// fresh: temperatures and counters a full COMM_GET_VALUES reply or a CAN
+// status frame just brought need not be asked for again on their own
+// schedule.
+//
+// A field is fresh while its age plus the round trip of a new request
+// is under its TTL, since asking now could not bring a value in any
+// sooner. With the TTL under the field's poll period, its own replies
+// never hold its next poll back; a reply it did not ask for puts the
+// poll off until the value it brought runs out. TTL 0 is never fresh.
+//
+// One task notes fields while another reads; each time is one word.
+class ValuesCache {
+public:
+    ValuesCache();
+
+    // Forget everything (the controller's slot was reassigned)
+    void clear();
+
+    // The fields in mask came in at now
+    void note(uint32_t mask, uint32_t nowMs);
+
+    // Those of fields still fresh at now, against each field's TTL
+    uint32_t fresh(uint32_t fields, const uint32_t* ttlMs, uint32_t rttMs, uint32_t nowMs) const;
+
+    // How long ago a field came in, UINT32_MAX if it has not since clear()
+    uint32_t ageMs(uint8_t bit, uint32_t nowMs) const;
+
+private:
+    volatile uint32_t receivedMs[VALUES_FIELD_COUNT];
+    volatile uint32_t seen;
+};
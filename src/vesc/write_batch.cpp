@@ -0,0 +1,74 @@
+#include "write_batch.h"
+#include "command.h"
+#include "protocol.h"
+
+#include <string.h>
+
+VescWriteBatch::VescWriteBatch(WriteHandler handler, void* context)
+    : handler(handler), context(context), limit(20), used(0), tail(0), frames(0), writes(0), dropped(0) {
+}
+
+// Length of the encoded frame at data, from its start byte and length
+static size_t frameLength(const uint8_t* data) {
+    size_t header = data[0] == VESC_PACKET_START ? 1 : (data[0] == VESC_PACKET_START_LONG ? 2 : 3);
+    size_t length = 0;
+    for (size_t i = 1; i <= header; i++) length = (length << 8) | data[i];
+    return 1 + header + length + 3;
+}
+
+void VescWriteBatch::setWriteLimit(size_t bytes) {
+    if (bytes < 1) bytes = 1;
+    limit = bytes > MAX_WRITE ? MAX_WRITE : bytes;
+}
+
+bool VescWriteBatch::add(const uint8_t* payload, size_t length) {
+    if (length == 0 || length > MAX_PAYLOAD) {
+        dropped++;
+        return false;
+    }
+
+    // Start a new write rather than split a frame across two. A frame
+    // longer than the limit goes out on its own, in several chunks.
+    size_t needed = length + VESC_PACKET_MAX_OVERHEAD;
+    if (used > 0 && used + needed > limit) flush();
+    if (used + needed > BUFFER_SIZE) {
+        dropped++;
+        return false;
+    }
+    used += vescEncodePacket(payload, length, buffer + used);
+    frames++;
+    return true;
+}
+
+bool VescWriteBatch::add(const VescCommand& command) {
+    if (!command.valid()) return false;
+    return add(command.payload(), command.length());
+}
+
+bool VescWriteBatch::flush() {
+    return write(used);
+}
+
+bool VescWriteBatch::flushPartial() {
+    return write(tail);
+}
+
+bool VescWriteBatch::write(size_t bytes) {
+    size_t offset = 0;
+    while (offset < bytes) {
+        size_t chunk = bytes - offset < limit ? bytes - offset : limit;
+        if (!handler(buffer + offset, chunk, context)) break;
+        offset += chunk;
+        writes++;
+    }
+    if (offset == 0) return bytes == 0;
+
+    // Find where the first whole frame left starts, then keep whatever
+    // the link did not take
+    size_t boundary = tail;
+    while (boundary < offset) boundary += frameLength(buffer + boundary);
+    tail = boundary - offset;
+    if (offset < used) memmove(buffer, buffer + offset, used - offset);
+    used -= offset;
+    return offset == bytes;
+}
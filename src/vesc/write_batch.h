@@ -0,0 +1,74 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include "packet.h"
+#include "framer.h"
+
+class VescCommand;
+
+// Coalesces outgoing frames into as few link writes as the MTU allows.
+// Frames are encoded back to back into a fixed buffer and handed to the
+// write handler in chunks of at most the write limit when the batch is
+// flushed, or early when the next frame would not fit. The VESC reads a
+// byte stream, so a frame may straddle two writes. A write the link
+// refuses (busy, see VescTransport::write()) is kept, with everything after
+// it, for the next flush. The batch knows where that leaves its frames,
+// so another batch on the same link only goes in between whole frames.
+class VescWriteBatch {
+public:
+    // Writes one chunk; returns false if the link did not take it
+    typedef bool (*WriteHandler)(const uint8_t* data, size_t length, void* context);
+
+    // Largest attribute value a single ATT write can carry
+    static const size_t MAX_WRITE = 512;
+    // Longest payload add() accepts: as long as the framer reassembles,
+    // so bridged configuration writes fit (they go out in several writes)
+    static const size_t MAX_PAYLOAD = VESC_FRAMER_MAX_PAYLOAD;
+    static const size_t BUFFER_SIZE = MAX_PAYLOAD + VESC_PACKET_MAX_OVERHEAD;
+
+    VescWriteBatch(WriteHandler handler, void* context = nullptr);
+
+    // Bytes per write: the negotiated ATT MTU less the 3-byte write
+    // header. Starts at the 20 bytes of the default MTU.
+    void setWriteLimit(size_t bytes);
+    size_t writeLimit() const { return limit; }
+
+    // Frame a payload into the batch. Returns false, dropping it, if it
+    // is empty, longer than MAX_PAYLOAD, or there is no room left because
+    // the link has not taken earlier writes.
+    bool add(const uint8_t* payload, size_t length);
+    bool add(const VescCommand& command);
+
+    // Write out everything queued. Returns false if the link stopped
+    // taking writes; what is left stays queued.
+    bool flush();
+
+    // Write out only the rest of a frame a short write cut off, so
+    // another batch may take the link. Returns false if the link stopped
+    // taking writes first.
+    bool flushPartial();
+
+    // Forget queued frames without writing them (e.g. after a disconnect)
+    void clear() { used = 0; tail = 0; }
+
+    size_t pending() const { return used; }
+    // Leading bytes that finish a frame whose start is already written
+    size_t partialBytes() const { return tail; }
+    uint32_t framesQueued() const { return frames; }
+    uint32_t writesIssued() const { return writes; }
+    uint32_t framesDropped() const { return dropped; }
+
+private:
+    bool write(size_t bytes);
+
+    WriteHandler handler;
+    void* context;
+    size_t limit;
+    size_t used;
+    size_t tail;
+    uint8_t buffer[BUFFER_SIZE];
+    uint32_t frames;
+    uint32_t writes;
+    uint32_t dropped;
+};
@@ -0,0 +1,136 @@
+#include "can_link.h"
+#include "../log.h"
+#include "../system/perf_stats.h"
+#include "../system/task_layout.h"
+#include "../vesc/can_status.h"
+
+#include <Arduino.h>
+#include <string.h>
+#include <driver/twai.h>
+#include <esp_timer.h>
+
+static const uint32_t RX_QUEUE_LENGTH = 64;
+static const uint32_t TASK_STACK_SIZE = 4096;
+static const uint32_t STATE_CHECK_MS = 100;  // Receive timeout, to look for a bus-off
+static const TaskPlacement& PLACEMENT = TASK_PLACEMENT[TASK_WIRED_RX];
+
+VescCanLink::VescCanLink()
+    : linkIndex(0), vescId(0), dataHandler(nullptr), statusHandler(nullptr), started(false), deferred(0),
+      busOffCount(0), statusCount(0),
+      txFramer(onOutgoing, this), canBuffer(0, sendFrame, onPayload, this) {
+}
+
+bool VescCanLink::sendFrame(uint32_t id, const uint8_t* data, uint8_t length, void* context) {
+    twai_message_t message = {};
+    message.extd = 1;
+    message.identifier = id;
+    message.data_length_code = length;
+    memcpy(message.data, data, length);
+    return twai_transmit(&message, 0) == ESP_OK;
+}
+
+// A reply, framed again for the link's framer. Runs on the receive task.
+void VescCanLink::onPayload(const uint8_t* payload, size_t length, void* context) {
+    VescCanLink* link = (VescCanLink*)context;
+    size_t packetLength = vescEncodePacket(payload, length, link->rxPacket);
+    if (packetLength > 0) link->dataHandler(link->linkIndex, link->rxPacket, packetLength);
+}
+
+// A packet the transmit path wrote, unframed. Runs in write().
+void VescCanLink::onOutgoing(const uint8_t* payload, size_t length, void* context) {
+    VescCanLink* link = (VescCanLink*)context;
+    link->canBuffer.send(link->vescId, payload, length);
+}
+
+void VescCanLink::task(void* param) {
+    VescCanLink* link = (VescCanLink*)param;
+    for (;;) {
+        twai_message_t message;
+        if (twai_receive(&message, pdMS_TO_TICKS(STATE_CHECK_MS)) == ESP_OK) {
+            taskBudgetStart(TASK_WIRED_RX);
+            if (message.extd && !message.rtr) {
+                if (isCanStatus(message.identifier)) {
+                    if (link->statusHandler) {
+                        link->statusCount++;
+                        link->statusHandler(message.identifier, message.data, message.data_length_code,
+                                            esp_timer_get_time());
+                    }
+                } else {
+                    link->canBuffer.onFrame(message.identifier, message.data, message.data_length_code);
+                }
+            }
+            taskBudgetEnd(TASK_WIRED_RX);
+            continue;
+        }
+        twai_status_info_t status;
+        if (twai_get_status_info(&status) != ESP_OK) continue;
+        if (status.state == TWAI_STATE_BUS_OFF) {
+            link->busOffCount++;
+            LOG_W(APP, "CAN bus off, recovering");
+            twai_initiate_recovery();
+        } else if (status.state == TWAI_STATE_STOPPED) {
+            // Recovered; the controller comes back stopped
+            twai_start();
+        }
+    }
+}
+
+bool VescCanLink::begin(uint8_t index, const WiredCanSettings& settings, DataHandler onData) {
+    if (started) return true;
+    linkIndex = index;
+    vescId = settings.vescId;
+    dataHandler = onData;
+    canBuffer.setOwnId(settings.ownId);
+
+    twai_general_config_t general = TWAI_GENERAL_CONFIG_DEFAULT((gpio_num_t)settings.txPin,
+                                                                (gpio_num_t)settings.rxPin, TWAI_MODE_NORMAL);
+    general.tx_queue_len = TX_QUEUE_LENGTH;
+    general.rx_queue_len = RX_QUEUE_LENGTH;
+    twai_timing_config_t timing;
+    switch (settings.bitrateKbit) {
+        case 125: timing = TWAI_TIMING_CONFIG_125KBITS(); break;
+        case 250: timing = TWAI_TIMING_CONFIG_250KBITS(); break;
+        case 1000: timing = TWAI_TIMING_CONFIG_1MBITS(); break;
+        default: timing = TWAI_TIMING_CONFIG_500KBITS(); break;
+    }
+    // Everything; replies are picked out by id in software
+    twai_filter_config_t filter = TWAI_FILTER_CONFIG_ACCEPT_ALL();
+    if (twai_driver_install(&general, &timing, &filter) != ESP_OK || twai_start() != ESP_OK) {
+        LOG_E(APP, "Wired CAN: could not start the TWAI driver");
+        return false;
+    }
+
+    TaskHandle_t handle = nullptr;
+    if (xTaskCreatePinnedToCore(task, PLACEMENT.name, TASK_STACK_SIZE, this, PLACEMENT.priority, &handle,
+                                PLACEMENT.core) != pdPASS) {
+        LOG_E(APP, "Wired CAN: could not start the task");
+        return false;
+    }
+    perfWatchTask(handle, MEMORY_TAG_PROTOCOL);
+    started = true;
+    LOG_I(APP, "VESC %d on CAN, TX %d / RX %d at %u kbit/s, our id %d", vescId, settings.txPin, settings.rxPin,
+          settings.bitrateKbit, settings.ownId);
+    return true;
+}
+
+bool VescCanLink::isConnected() {
+    if (!started) return false;
+    twai_status_info_t status;
+    return twai_get_status_info(&status) == ESP_OK && status.state == TWAI_STATE_RUNNING;
+}
+
+bool VescCanLink::write(const uint8_t* data, size_t length) {
+    if (!isConnected()) return false;
+    // Room for every frame the bytes can take, so a packet is never cut
+    // off halfway for want of queue space. The worst case is 7-byte
+    // payloads: 11 bytes framed, 3 CAN frames.
+    twai_status_info_t status;
+    if (twai_get_status_info(&status) != ESP_OK) return false;
+    size_t needed = (length * 3 + 10) / 11 + 1;
+    if (status.msgs_to_tx + needed > TX_QUEUE_LENGTH) {
+        deferred++;
+        return false;
+    }
+    txFramer.feed(data, length);
+    return true;
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include "../vesc/transport.h"
+#include "../vesc/framer.h"
+#include "../vesc/can_buffer.h"
+#include "../vesc/packet.h"
+
+struct WiredCanSettings {
+    int8_t txPin;                // To the transceiver's TX/D
+    int8_t rxPin;                // From its RX/R
+    uint16_t bitrateKbit;        // 125, 250, 500 or 1000; the VESC's CAN baud rate
+    uint8_t ownId;               // Our CAN id, unused by any controller
+    uint8_t vescId;              // The controller spoken to, as the BLE module's VESC would be
+};
+
+// A VESC on the CAN bus through an external transceiver and the ESP32's
+// TWAI controller, spoken to the way controllers speak to each other
+// (see vesc/can_buffer.h). The transmit path stays as it is: the framed
+// packets it writes are unframed again by a framer of its own and sent
+// as CAN buffers. Replies are reassembled, framed once more and handed
+// to the data handler, so the link's framer sees the same byte stream as
+// from BLE. Controllers further along the bus are still reached with
+// COMM_FORWARD_CAN through vescId.
+//
+// Status broadcasts (see vesc/can_status.h) from any controller on the
+// bus go to a status handler of their own, when one is set, with the
+// esp_timer time they were taken off the controller's queue.
+//
+// Connected while the controller is running; a bus-off is recovered
+// from on the receive task.
+class VescCanLink : public VescTransport {
+public:
+    typedef void (*StatusHandler)(uint32_t id, const uint8_t* data, uint8_t length, uint64_t timeUs);
+
+    VescCanLink();
+
+    // Install and start the TWAI driver and the receive task. Returns
+    // false if either failed.
+    bool begin(uint8_t index, const WiredCanSettings& settings, DataHandler onData);
+
+    // Runs on the receive task; set before begin()
+    void setStatusHandler(StatusHandler handler) { statusHandler = handler; }
+
+    bool isConnected() override;
+    bool write(const uint8_t* data, size_t length) override;
+    size_t writeLimit() override { return WRITE_LIMIT; }
+
+    const VescCanBuffer& buffer() const { return canBuffer; }
+    uint32_t writesDeferred() const { return deferred; }
+    uint32_t busOffs() const { return busOffCount; }
+    uint32_t statusFrames() const { return statusCount; }
+
+private:
+    static const uint32_t TX_QUEUE_LENGTH = 48;
+    static const size_t WRITE_LIMIT = 128;
+
+    static void task(void* param);
+    static bool sendFrame(uint32_t id, const uint8_t* data, uint8_t length, void* context);
+    static void onPayload(const uint8_t* payload, size_t length, void* context);
+    static void onOutgoing(const uint8_t* payload, size_t length, void* context);
+
+    uint8_t linkIndex;
+    uint8_t vescId;
+    DataHandler dataHandler;
+    StatusHandler statusHandler;
+    bool started;
+    uint32_t deferred;
+    volatile uint32_t busOffCount;
+    volatile uint32_t statusCount;
+    VescFramer txFramer;        // Written bytes back to payloads
+    VescCanBuffer canBuffer;
+    uint8_t rxPacket[VescCanBuffer::MAX_PAYLOAD + VESC_PACKET_MAX_OVERHEAD];  // A reply, framed again
+};
@@ -0,0 +1,96 @@
+#include "uart_link.h"
+#include "../log.h"
+#include "../system/perf_stats.h"
+#include "../system/task_layout.h"
+
+#include <Arduino.h>
+
+static const int RX_BUFFER_SIZE = 2048;      // A full MCCONF reply and then some
+static const int EVENT_QUEUE_LENGTH = 16;
+static const size_t CHUNK_SIZE = 256;
+static const uint32_t TASK_STACK_SIZE = 3072;
+static const TaskPlacement& PLACEMENT = TASK_PLACEMENT[TASK_WIRED_RX];
+
+VescUartLink::VescUartLink()
+    : linkIndex(0), port(UART_NUM_1), baud(115200), dataHandler(nullptr), events(nullptr), started(false),
+      backlog(0), backlogMs(0), deferred(0), received(0), overflowCount(0) {
+}
+
+void VescUartLink::task(void* param) {
+    VescUartLink* link = (VescUartLink*)param;
+    uint8_t chunk[CHUNK_SIZE];
+    for (;;) {
+        uart_event_t event;
+        if (xQueueReceive(link->events, &event, portMAX_DELAY) != pdTRUE) continue;
+        if (event.type == UART_FIFO_OVF || event.type == UART_BUFFER_FULL) {
+            // The framer drops the frame that lost bytes on its CRC
+            link->overflowCount++;
+            uart_flush_input(link->port);
+            xQueueReset(link->events);
+            continue;
+        }
+        if (event.type != UART_DATA) continue;
+
+        taskBudgetStart(TASK_WIRED_RX);
+        size_t waiting = 0;
+        uart_get_buffered_data_len(link->port, &waiting);
+        while (waiting > 0) {
+            int n = uart_read_bytes(link->port, chunk, waiting < CHUNK_SIZE ? waiting : CHUNK_SIZE, 0);
+            if (n <= 0) break;
+            link->received += n;
+            link->dataHandler(link->linkIndex, chunk, n);
+            waiting -= n;
+        }
+        taskBudgetEnd(TASK_WIRED_RX);
+    }
+}
+
+bool VescUartLink::begin(uint8_t index, const WiredUartSettings& settings, DataHandler onData) {
+    if (started) return true;
+    linkIndex = index;
+    port = (uart_port_t)settings.port;
+    baud = settings.baud > 0 ? settings.baud : 115200;
+    dataHandler = onData;
+
+    uart_config_t config = {};
+    config.baud_rate = (int)baud;
+    config.data_bits = UART_DATA_8_BITS;
+    config.parity = UART_PARITY_DISABLE;
+    config.stop_bits = UART_STOP_BITS_1;
+    config.flow_ctrl = UART_HW_FLOWCTRL_DISABLE;
+    config.source_clk = UART_SCLK_APB;
+    if (uart_driver_install(port, RX_BUFFER_SIZE, TX_BUFFER_SIZE, EVENT_QUEUE_LENGTH, &events, 0) != ESP_OK) {
+        LOG_E(APP, "Wired UART: could not install the driver");
+        return false;
+    }
+    uart_param_config(port, &config);
+    uart_set_pin(port, settings.txPin, settings.rxPin, UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE);
+
+    TaskHandle_t handle = nullptr;
+    if (xTaskCreatePinnedToCore(task, PLACEMENT.name, TASK_STACK_SIZE, this, PLACEMENT.priority, &handle,
+                                PLACEMENT.core) != pdPASS) {
+        LOG_E(APP, "Wired UART: could not start the task");
+        return false;
+    }
+    perfWatchTask(handle, MEMORY_TAG_PROTOCOL);
+    started = true;
+    LOG_I(APP, "VESC on UART %d, RX %d / TX %d at %u baud", (int)port, settings.rxPin, settings.txPin,
+          (unsigned)baud);
+    return true;
+}
+
+bool VescUartLink::write(const uint8_t* data, size_t length) {
+    if (!started) return false;
+    // Drained since the last write: start, 8 data and stop bit a byte
+    uint32_t now = millis();
+    uint32_t drained = (uint32_t)((uint64_t)(now - backlogMs) * baud / 10000);
+    backlog = backlog > drained ? backlog - drained : 0;
+    backlogMs = now;
+    if (backlog + length > TX_BUFFER_SIZE) {
+        deferred++;
+        return false;
+    }
+    uart_write_bytes(port, (const char*)data, length);
+    backlog += length;
+    return true;
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <driver/uart.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include "../vesc/transport.h"
+
+struct WiredUartSettings {
+    uint8_t port;                // UART_NUM_1; UART_NUM_2 is the GPS's
+    int8_t rxPin;                // To the VESC's TX
+    int8_t txPin;                // To the VESC's RX
+    uint32_t baud;               // The VESC's app configuration, UART baud rate
+};
+
+// A VESC wired to a hardware UART, the link the VESC's own UART app
+// speaks (same framing as over BLE). A task sleeps on the UART driver's
+// event queue and hands what arrived to the data handler, as the BLE
+// notification callback does, so the framer and everything after it do
+// not know the difference.
+//
+// A UART has no connection to lose, so it counts as connected once
+// begun. Writes go into the driver's TX ring; the bytes the line has not
+// sent yet are estimated from the baud rate, and a write that would not
+// fit is refused instead of blocking the poll loop.
+class VescUartLink : public VescTransport {
+public:
+    VescUartLink();
+
+    // Install the driver and start the task. Returns false if either
+    // failed.
+    bool begin(uint8_t index, const WiredUartSettings& settings, DataHandler onData);
+
+    bool isConnected() override { return started; }
+    bool write(const uint8_t* data, size_t length) override;
+    size_t writeLimit() override { return WRITE_LIMIT; }
+
+    uint32_t writesDeferred() const { return deferred; }
+    uint32_t bytesReceived() const { return received; }
+    uint32_t overflows() const { return overflowCount; }
+
+private:
+    static const size_t TX_BUFFER_SIZE = 1024;
+    static const size_t WRITE_LIMIT = 256;
+
+    static void task(void* param);
+
+    uint8_t linkIndex;
+    uart_port_t port;
+    uint32_t baud;
+    DataHandler dataHandler;
+    QueueHandle_t events;
+    bool started;
+    uint32_t backlog;           // Bytes written the line may not have sent yet
+    uint32_t backlogMs;
+    uint32_t deferred;
+    volatile uint32_t received;
+    volatile uint32_t overflowCount;
+};
@@ -0,0 +1,63 @@
+#!/usr/bin/env python3
+"""Generate the alert sound clips as PCM tables for flash.
+
+    tools/audio_clips.py > src/system/audio_clips.h
+
+Each clip is a list of (frequency Hz, milliseconds) notes, frequency 0
+for a rest, rendered as 16-bit mono samples at SAMPLE_RATE with a short
+fade at each edge so notes do not click. The player (src/system/audio.h)
+streams the tables to the speaker unchanged; the enum order here is the
+AudioClip order.
+"""
+
+import math
+
+SAMPLE_RATE = 8000
+AMPLITUDE = 0.5      # Of full scale; the NS4168 amplifier is loud
+FADE_MS = 5
+
+# Name, comment, notes
+CLIPS = [
+    ("ALERT", "Falling two-tone, for a threshold alert",
+     [(880, 150), (660, 150)]),
+    ("FAULT", "Three fast high beeps, for a VESC fault",
+     [(1320, 80), (0, 60), (1320, 80), (0, 60), (1320, 80)]),
+]
+
+
+def render(notes):
+    samples = []
+    fade = SAMPLE_RATE * FADE_MS // 1000
+    for frequency, ms in notes:
+        n = SAMPLE_RATE * ms // 1000
+        for i in range(n):
+            if frequency == 0:
+                samples.append(0)
+                continue
+            edge = min(i, n - 1 - i)
+            gain = 0.5 - 0.5 * math.cos(math.pi * edge / fade) if edge < fade else 1.0
+            value = AMPLITUDE * gain * math.sin(2 * math.pi * frequency * i / SAMPLE_RATE)
+            samples.append(int(round(value * 32767)))
+    return samples
+
+
+def main():
+    print("#pragma once")
+    print()
+    print("// Generated by tools/audio_clips.py; edit the notes there, not the tables.")
+    print()
+    print("#include <stdint.h>")
+    print()
+    print("#define AUDIO_SAMPLE_RATE %d" % SAMPLE_RATE)
+    for name, comment, notes in CLIPS:
+        samples = render(notes)
+        print()
+        print("// %s, %d ms" % (comment, sum(ms for _, ms in notes)))
+        print("static const int16_t AUDIO_CLIP_%s_PCM[%d] = {" % (name, len(samples)))
+        for i in range(0, len(samples), 12):
+            print("    " + " ".join("%d," % s for s in samples[i:i + 12]))
+        print("};")
+
+
+if __name__ == "__main__":
+    main()
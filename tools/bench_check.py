@@ -0,0 +1,130 @@
+#!/usr/bin/env python3
+"""Run the native protocol benchmark and compare it with a stored baseline.
+
+Build the native environment first (platformio run -e native), then:
+
+    tools/bench_check.py                  # run, compare, fail on a regression
+    tools/bench_check.py --update         # run and store the result as the baseline
+    tools/bench_check.py --results r.json # compare an earlier run instead
+
+The benchmark is run a few times and the best figure of each case kept,
+which shakes off most scheduler noise. A case regresses when it is more
+than the tolerance slower than the baseline: lower for rates ("/s"),
+higher for times ("ns/..."). The baseline's own "tolerance" applies
+unless --tolerance is given, and a case may carry a wider one of its own.
+Figures are only comparable on the machine the baseline was taken on;
+re-take it with --update after moving.
+"""
+
+import argparse
+import json
+import os
+import platform
+import subprocess
+import sys
+import tempfile
+
+ROOT = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+PROGRAM = os.path.join(ROOT, ".pio", "build", "native", "program")
+BASELINE = os.path.join(ROOT, "src", "bench", "baseline.json")
+DEFAULT_TOLERANCE = 0.15
+
+
+def higher_is_better(unit):
+    return unit.endswith("/s")
+
+
+def run(program, runs):
+    """Best figure of each case over runs runs of the benchmark."""
+    best = {}
+    for _ in range(runs):
+        with tempfile.NamedTemporaryFile(suffix=".json", delete=False) as f:
+            path = f.name
+        try:
+            done = subprocess.run([program, "--json", path], stdout=subprocess.PIPE,
+                                  universal_newlines=True)
+            if done.returncode != 0:
+                sys.stdout.write(done.stdout)
+                sys.exit("benchmark checks failed")
+            with open(path) as f:
+                results = json.load(f)["results"]
+        finally:
+            os.unlink(path)
+        for name, result in results.items():
+            kept = best.get(name)
+            better = (result["value"] > kept["value"]) == higher_is_better(result["unit"]) if kept else True
+            if better:
+                best[name] = result
+    return best
+
+
+def compare(results, baseline, tolerance):
+    """Print each case against the baseline; returns the regressions."""
+    regressions = []
+    for name, base in baseline["results"].items():
+        if name not in results:
+            print(f"{name:16} missing from this run")
+            continue
+        value, unit = results[name]["value"], base["unit"]
+        allowed = base.get("tolerance", tolerance)
+        if higher_is_better(unit):
+            change = value / base["value"] - 1
+            regressed = change < -allowed
+        else:
+            change = base["value"] / value - 1
+            regressed = change < -allowed
+        mark = "REGRESSED" if regressed else ""
+        print(f"{name:16} {value:12.4g} {unit:11} baseline {base['value']:10.4g}  {change:+6.1%}  {mark}")
+        if regressed:
+            regressions.append(name)
+    for name in results:
+        if name not in baseline["results"]:
+            print(f"{name:16} not in the baseline")
+    return regressions
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--program", default=PROGRAM, help="benchmark binary (default: the native build)")
+    parser.add_argument("--baseline", default=BASELINE, help="baseline JSON (default: src/bench/baseline.json)")
+    parser.add_argument("--results", help="results JSON of an earlier run, instead of running")
+    parser.add_argument("--runs", type=int, default=3, help="runs to take the best of (default 3)")
+    parser.add_argument("--tolerance", type=float, help="allowed slowdown, e.g. 0.1 for 10%%")
+    parser.add_argument("--update", action="store_true", help="store this run as the baseline")
+    args = parser.parse_args()
+
+    if args.results:
+        with open(args.results) as f:
+            results = json.load(f)["results"]
+    else:
+        results = run(args.program, args.runs)
+
+    if args.update:
+        old = {}
+        if os.path.exists(args.baseline):
+            with open(args.baseline) as f:
+                old = json.load(f)
+        tolerance = args.tolerance if args.tolerance is not None else old.get("tolerance", DEFAULT_TOLERANCE)
+        # Per-case tolerances outlive the figures they were set for
+        for name, result in results.items():
+            if "tolerance" in old.get("results", {}).get(name, {}):
+                result["tolerance"] = old["results"][name]["tolerance"]
+        baseline = {"machine": platform.platform(), "tolerance": tolerance, "results": results}
+        with open(args.baseline, "w") as f:
+            json.dump(baseline, f, indent=2)
+            f.write("\n")
+        print(f"Baseline written to {args.baseline}")
+        return
+
+    with open(args.baseline) as f:
+        baseline = json.load(f)
+    if baseline.get("machine") != platform.platform():
+        print(f"Baseline was taken on {baseline.get('machine')}; figures may not compare", file=sys.stderr)
+    tolerance = args.tolerance if args.tolerance is not None else baseline.get("tolerance", DEFAULT_TOLERANCE)
+    regressions = compare(results, baseline, tolerance)
+    if regressions:
+        sys.exit(f"{len(regressions)} case(s) regressed by more than {tolerance:.0%}: {', '.join(regressions)}")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,75 @@
+#!/usr/bin/env python3
+"""Compare the flash and RAM of PlatformIO envs side by side.
+
+Reads each env's linker map (see build_flags in platformio.ini), so build
+them first:
+
+    pio run -e m5stack-core2 -e m5stack-core2-lean
+    tools/env_sizes.py m5stack-core2 m5stack-core2-lean
+    tools/env_sizes.py --objects 10 m5stack-core2 m5stack-core2-lean
+
+Flash is .flash.text and .flash.rodata; internal RAM is .dram0.data,
+.dram0.bss and .iram0.text. The first env is the reference the others
+are compared with; --objects also lists the objects whose size changed
+most against it.
+"""
+
+import argparse
+import collections
+import os
+
+from memory_map import parse
+
+FLASH = [".flash.text", ".flash.rodata"]
+RAM = [".dram0.data", ".dram0.bss", ".iram0.text"]
+
+
+def load(build_dir, env):
+    """Return ({section: total}, Counter of object bytes) for an env."""
+    path = os.path.join(build_dir, env, "firmware.map")
+    with open(path) as f:
+        sections = parse(f)
+    totals = {section: total for section, (total, _) in sections.items()}
+    objects = collections.Counter()
+    for _, section_objects in sections.values():
+        objects.update(section_objects)
+    return totals, objects
+
+
+def row(label, values, reference):
+    cells = ["%20d" % values[0]]
+    for value in values[1:]:
+        cells.append("%10d %+9d" % (value, value - reference))
+    print("%-16s %s" % (label, "  ".join(cells)))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("envs", nargs="+", help="env names, the reference first")
+    parser.add_argument("--build-dir", default=".pio/build", help="PlatformIO build directory")
+    parser.add_argument("--objects", type=int, default=0, help="objects listed by size change")
+    args = parser.parse_args()
+
+    loaded = [load(args.build_dir, env) for env in args.envs]
+    print("%-16s %s" % ("", "  ".join("%20s" % env for env in args.envs)))
+    for label, sections in (("flash", FLASH), ("ram", RAM)):
+        for section in sections:
+            values = [totals.get(section, 0) for totals, _ in loaded]
+            row(section, values, values[0])
+        values = [sum(totals.get(s, 0) for s in sections) for totals, _ in loaded]
+        row(label + " total", values, values[0])
+
+    if args.objects:
+        reference = loaded[0][1]
+        for env, (_, objects) in zip(args.envs[1:], loaded[1:]):
+            names = set(reference) | set(objects)
+            changes = sorted(((objects[n] - reference[n], n) for n in names), key=lambda c: abs(c[0]),
+                             reverse=True)
+            print("\n%s against %s:" % (env, args.envs[0]))
+            for change, name in changes[:args.objects]:
+                if change:
+                    print("    %+9d  %s" % (change, name))
+
+
+if __name__ == "__main__":
+    main()
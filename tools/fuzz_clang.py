@@ -0,0 +1,7 @@
+# PlatformIO extra script for the native-fuzz environment: libFuzzer
+# comes with clang, and the native platform builds with gcc otherwise.
+# The sanitizers are linked in as well as compiled in.
+Import("env")
+
+env.Replace(CC="clang", CXX="clang++", LINK="clang++")
+env.Append(LINKFLAGS=["-fsanitize=fuzzer,address,undefined"])
@@ -0,0 +1,133 @@
+#!/usr/bin/env python3
+"""Seed the fuzz corpus from recorded BLE captures.
+
+Record captures on the dashboard with BLE_CAPTURE_BYTES set, copy the
+captNNNN.vcap files off the SD card, then:
+
+    tools/fuzz_corpus.py fuzz/corpus /path/to/capt*.vcap
+
+Each capture gives three kinds of seeds for src/fuzz/vesc_fuzz.cpp:
+stretches of its notification stream, split the way the VESC's BLE module
+split them; each distinct reply (by command and length) as a bare
+payload; and the capture file itself. Seeds are named by their SHA-1,
+as libFuzzer names its own, so running it again adds only what is new.
+"""
+
+import argparse
+import hashlib
+import os
+import struct
+import sys
+
+CAPTURE_MAGIC = 0x50414356
+FILE_HEADER = struct.Struct("<IHHII")   # CaptureFileHeader
+CHUNK_HEADER = struct.Struct("<IH")     # CaptureChunkHeader
+
+MODE_STREAM = 0
+MODE_PAYLOAD = 1
+MODE_CAPTURE = 3
+
+MAX_PAYLOAD = 1024                      # VescFramer::MAX_PAYLOAD
+
+
+def crc16(data):
+    """CRC-16-CCITT as VESC packets: poly 0x1021, initial value 0."""
+    crc = 0
+    for byte in data:
+        crc ^= byte << 8
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x1021) if crc & 0x8000 else crc << 1
+            crc &= 0xFFFF
+    return crc
+
+
+def read_capture(path):
+    """The notifications of a capture, in order."""
+    with open(path, "rb") as f:
+        data = f.read()
+    if len(data) < FILE_HEADER.size:
+        raise ValueError("too short")
+    magic, _version, header_size, _count, _reserved = FILE_HEADER.unpack_from(data)
+    if magic != CAPTURE_MAGIC:
+        raise ValueError("not a capture")
+    chunks = []
+    offset = header_size
+    while offset + CHUNK_HEADER.size <= len(data):
+        _time_us, length = CHUNK_HEADER.unpack_from(data, offset)
+        offset += CHUNK_HEADER.size
+        if offset + length > len(data):
+            break
+        chunks.append(data[offset:offset + length])
+        offset += length
+    return data, chunks
+
+
+def payloads(stream):
+    """Payloads of the frames in a stream that pass their CRC."""
+    i = 0
+    while i < len(stream):
+        start = stream[i]
+        if start == 2 and i + 1 < len(stream):
+            length, body = stream[i + 1], i + 2
+        elif start == 3 and i + 2 < len(stream):
+            length, body = stream[i + 1] << 8 | stream[i + 2], i + 3
+        else:
+            i += 1
+            continue
+        end = body + length
+        if 0 < length <= MAX_PAYLOAD and end + 3 <= len(stream) and stream[end + 2] == 3:
+            payload = stream[body:end]
+            if crc16(payload) == stream[end] << 8 | stream[end + 1]:
+                yield payload
+                i = end + 3
+                continue
+        i += 1
+
+
+def seeds(capture, chunks, max_len):
+    stream = b"".join(chunks)
+    # Notifications of the size the module sent most
+    sizes = sorted(len(c) for c in chunks if c)
+    chunk = sizes[len(sizes) // 2] if sizes else 20
+    mode = ((min(chunk, 64) - 1) << 2) | MODE_STREAM
+    step = max_len - 1
+    for start in range(0, len(stream), step):
+        yield bytes([mode]) + stream[start:start + step]
+
+    seen = set()
+    for payload in payloads(stream):
+        key = (payload[0], len(payload))
+        if key not in seen:
+            seen.add(key)
+            yield bytes([MODE_PAYLOAD]) + payload[:max_len - 1]
+
+    yield bytes([MODE_CAPTURE]) + capture[:max_len - 1]
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("corpus", help="directory to write seeds to")
+    parser.add_argument("captures", nargs="+", help=".vcap files")
+    parser.add_argument("--max-len", type=int, default=4096,
+                        help="longest seed, as libFuzzer's -max_len (default 4096)")
+    args = parser.parse_args()
+
+    os.makedirs(args.corpus, exist_ok=True)
+    added = 0
+    for path in args.captures:
+        try:
+            capture, chunks = read_capture(path)
+        except (OSError, ValueError) as e:
+            print(f"{path}: {e}", file=sys.stderr)
+            continue
+        for seed in seeds(capture, chunks, args.max_len):
+            name = os.path.join(args.corpus, hashlib.sha1(seed).hexdigest())
+            if not os.path.exists(name):
+                with open(name, "wb") as f:
+                    f.write(seed)
+                added += 1
+    print(f"{added} seeds added to {args.corpus}", file=sys.stderr)
+
+
+if __name__ == "__main__":
+    main()
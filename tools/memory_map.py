@@ -0,0 +1,99 @@
+#!/usr/bin/env python3
+"""Summarize the firmware's static memory by section and object file.
+
+Every build writes a linker map next to the firmware (see build_flags in
+platformio.ini); point this at it:
+
+    tools/memory_map.py .pio/build/m5stack-core2/firmware.map
+    tools/memory_map.py --top 30 --section .dram0.bss firmware.map
+
+Internal RAM is .dram0.data, .dram0.bss and .iram0.text; flash is
+.flash.text and .flash.rodata. Buffers the dashboard allocates at boot
+are not in the map; the firmware logs those once setup() is done.
+"""
+
+import argparse
+import collections
+import os
+import re
+
+SECTIONS = [".dram0.data", ".dram0.bss", ".iram0.text", ".flash.text", ".flash.rodata"]
+
+OUTPUT = re.compile(r"^(\.\S+)\s+0x[0-9a-f]+\s+0x([0-9a-f]+)")
+INPUT = re.compile(r"^ (\S+)\s+0x[0-9a-f]+\s+0x([0-9a-f]+)\s+(\S.*)$")
+INPUT_NAME = re.compile(r"^ (\S+)$")
+INPUT_WRAPPED = re.compile(r"^\s+0x[0-9a-f]+\s+0x([0-9a-f]+)\s+(\S.*)$")
+
+
+def object_name(path):
+    """src/ui/gauge.cpp.o for the project's files, libfoo.a(bar.o) for
+    archive members."""
+    path = path.strip().replace("\\", "/")
+    if "/src/" in path:
+        return "src/" + path.split("/src/", 1)[1]
+    archive = re.match(r"(.*)\((.*)\)$", path)
+    if archive:
+        return "%s(%s)" % (os.path.basename(archive.group(1)), archive.group(2))
+    return os.path.basename(path)
+
+
+def parse(lines):
+    """Return {section: (total, {object: bytes})} for the output sections
+    of interest."""
+    totals = {}
+    objects = collections.defaultdict(collections.Counter)
+    section = None
+    name = None
+    for line in lines:
+        line = line.rstrip("\n")
+        match = OUTPUT.match(line)
+        if match:
+            section = match.group(1) if match.group(1) in SECTIONS else None
+            if section:
+                totals[section] = int(match.group(2), 16)
+            name = None
+            continue
+        if line and not line[0].isspace():
+            section = None
+            continue
+        if section is None:
+            continue
+        match = INPUT.match(line)
+        if match:
+            objects[section][object_name(match.group(3))] += int(match.group(2), 16)
+            name = None
+            continue
+        match = INPUT_NAME.match(line)
+        if match:
+            name = match.group(1)
+            continue
+        match = INPUT_WRAPPED.match(line)
+        if match and name is not None:
+            objects[section][object_name(match.group(2))] += int(match.group(1), 16)
+            name = None
+    return {s: (totals[s], objects[s]) for s in SECTIONS if s in totals}
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("map", help="linker map file")
+    parser.add_argument("--top", type=int, default=12, help="objects listed per section")
+    parser.add_argument("--section", action="append", help="only these output sections")
+    args = parser.parse_args()
+
+    with open(args.map) as f:
+        sections = parse(f)
+    for section, (total, objects) in sections.items():
+        if args.section and section not in args.section:
+            continue
+        print("%-16s %8d bytes" % (section, total))
+        for name, size in objects.most_common(args.top):
+            if size:
+                print("    %8d  %s" % (size, name))
+        rest = sum(objects.values()) - sum(size for _, size in objects.most_common(args.top))
+        if rest > 0:
+            print("    %8d  (%d more objects)" % (rest, max(len(objects) - args.top, 0)))
+
+
+if __name__ == "__main__":
+    main()
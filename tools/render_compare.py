@@ -0,0 +1,76 @@
+#!/usr/bin/env python3
+"""Compare render benchmark runs of two builds side by side.
+
+Capture the serial log of a run on each display backend, e.g. the
+default m5stack-core2 build (M5.Lcd) and m5stack-core2-m5gfx (M5GFX),
+each booted with Button C held, then:
+
+    tools/render_compare.py lcd.log m5gfx.log
+
+Each case's average us/op is printed for both runs with the ratio of the
+second to the first (below 1.00 is faster), and the MB/s of cases that
+report one. A case only one build has shows "-" for the other. When a
+log holds several runs, the last is used.
+"""
+
+import argparse
+import re
+import sys
+
+HEADER = re.compile(r"Render benchmark(?: \((?P<backend>[^)]*)\))?: \d+ cases")
+CASE = re.compile(r"^  (?P<name>\S.*?)\s+(?P<us>\d+) us/op \(min \d+, max \d+\)(?:, (?P<rate>[\d.]+) MB/s)?")
+
+
+def read_run(path):
+    """Backend name and {case: (us, rate)} of the last run in a log."""
+    backend, cases, reading = None, {}, False
+    order = []
+    with open(path, errors="replace") as f:
+        for line in f:
+            line = line.rstrip("\r\n")
+            header = HEADER.search(line)
+            if header:
+                backend = header.group("backend") or "M5.Lcd"
+                cases, order, reading = {}, [], True
+                continue
+            if not reading:
+                continue
+            case = CASE.match(line)
+            if case:
+                name = case.group("name")
+                rate = float(case.group("rate")) if case.group("rate") else None
+                cases[name] = (int(case.group("us")), rate)
+                order.append(name)
+            elif "Render benchmark done" in line:
+                reading = False
+    if backend is None:
+        sys.exit(f"{path}: no render benchmark run in the log")
+    return backend, cases, order
+
+
+def rate_text(rate):
+    return f"{rate:6.2f}" if rate is not None else "     -"
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("first", help="serial log of the first build")
+    parser.add_argument("second", help="serial log of the second build")
+    args = parser.parse_args()
+
+    first_name, first, first_order = read_run(args.first)
+    second_name, second, second_order = read_run(args.second)
+    names = first_order + [n for n in second_order if n not in first]
+
+    print(f"{'case':22} {first_name:>10} {second_name:>10}  ratio   MB/s {first_name} / {second_name}")
+    for name in names:
+        a, b = first.get(name), second.get(name)
+        a_us = f"{a[0]:10d}" if a else f"{'-':>10}"
+        b_us = f"{b[0]:10d}" if b else f"{'-':>10}"
+        ratio = f"{b[0] / a[0]:5.2f}" if a and b and a[0] > 0 else "    -"
+        rates = f"{rate_text(a[1] if a else None)} / {rate_text(b[1] if b else None)}"
+        print(f"{name:22} {a_us} {b_us}  {ratio}  {rates}")
+
+
+if __name__ == "__main__":
+    main()
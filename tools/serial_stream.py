@@ -0,0 +1,159 @@
+#!/usr/bin/env python3
+"""Decode the dashboard's binary serial telemetry stream to CSV.
+
+Build and flash the m5stack-core2-serial-stream environment, then:
+
+    tools/serial_stream.py /dev/ttyUSB0 > capture.csv
+    tools/serial_stream.py --file raw.bin > capture.csv
+
+Records are described in src/telemetry/serial_stream.h. Text log lines
+between records are skipped; dropped or corrupt records are counted on
+stderr. Reading a port needs pyserial.
+"""
+
+import argparse
+import sys
+
+RECORD_SAMPLE = 0x01
+FRAME_KEY = 0x01
+
+# LogValue order (src/storage/log_format.h) with the fixed-point scale of
+# each VescValues field (src/vesc/values.h)
+VALUES = [
+    ("current_motor", 0.01), ("current_in", 0.01), ("current_id", 0.01),
+    ("current_iq", 0.01), ("erpm", 1), ("amp_hours", 0.0001),
+    ("amp_hours_charged", 0.0001), ("watt_hours", 0.0001),
+    ("watt_hours_charged", 0.0001), ("tachometer", 1), ("tachometer_abs", 1),
+    ("pid_pos", 0.000001), ("vd", 0.001), ("vq", 0.001), ("temp_fet", 0.1),
+    ("temp_motor", 0.1), ("duty", 0.001), ("v_in", 0.1), ("temp_mos1", 0.1),
+    ("temp_mos2", 0.1), ("temp_mos3", 0.1), ("fault", 1),
+    ("controller_id", 1), ("status", 1), ("soc", 0.1),
+    ("gps_latitude", 0.0000001), ("gps_longitude", 0.0000001),
+    ("gps_speed", 0.1), ("gps_age_ms", 1), ("formula1", 0.001),
+    ("formula2", 0.001), ("imu_pitch", 0.1), ("imu_roll", 0.1),
+    ("imu_accel", 0.01),
+]
+
+
+def crc16(data):
+    """CRC-16-CCITT as VESC packets: poly 0x1021, initial value 0."""
+    crc = 0
+    for byte in data:
+        crc ^= byte << 8
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x1021) if crc & 0x8000 else crc << 1
+            crc &= 0xFFFF
+    return crc
+
+
+def cobs_decode(data):
+    out = bytearray()
+    i = 0
+    while i < len(data):
+        code = data[i]
+        if code == 0 or i + code > len(data) + 1:
+            return None
+        out += data[i + 1:i + code]
+        i += code
+        if code < 0xFF and i < len(data):
+            out.append(0)
+    return bytes(out)
+
+
+def varint(data, pos):
+    value = shift = 0
+    while True:
+        if pos >= len(data) or shift > 28:
+            raise ValueError("truncated varint")
+        byte = data[pos]
+        pos += 1
+        value |= (byte & 0x7F) << shift
+        shift += 7
+        if not byte & 0x80:
+            return value, pos
+
+
+def unzigzag(value):
+    return (value >> 1) ^ -(value & 1)
+
+
+def decode_record(record):
+    """Return (sequence, time_ms, fields, values) or None if corrupt."""
+    if len(record) < 8 or record[0] != RECORD_SAMPLE:
+        return None
+    if crc16(record[:-2]) != (record[-2] << 8 | record[-1]):
+        return None
+    sequence = int.from_bytes(record[1:5], "little")
+    frame = record[5:-2]
+    if frame[0] != FRAME_KEY:
+        return None
+    try:
+        time_ms, pos = varint(frame, 1)
+        fields, pos = varint(frame, pos)
+        values = []
+        for _ in VALUES:
+            word, pos = varint(frame, pos)
+            values.append(unzigzag(word))
+    except ValueError:
+        return None
+    return sequence, time_ms, fields, values
+
+
+def chunks(source):
+    """Yield the bytes between 0x00 delimiters. source() returns None at
+    the end and b"" when there is nothing yet."""
+    pending = bytearray()
+    while True:
+        data = source()
+        if data is None:
+            return
+        pending += data
+        while True:
+            end = pending.find(0)
+            if end < 0:
+                break
+            if end > 0:
+                yield bytes(pending[:end])
+            del pending[:end + 1]
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("port", nargs="?", help="serial port")
+    parser.add_argument("--baud", type=int, default=921600)
+    parser.add_argument("--file", help="decode a raw capture instead of a port")
+    args = parser.parse_args()
+
+    if args.file:
+        stream = open(args.file, "rb")
+        source = lambda: stream.read(4096) or None
+    elif args.port:
+        import serial
+        port = serial.Serial(args.port, args.baud, timeout=1)
+        source = lambda: port.read(port.in_waiting or 1)
+    else:
+        parser.error("give a port or --file")
+
+    print("sequence,time_ms,fields," + ",".join(name for name, _ in VALUES))
+    expected = None
+    lost = corrupt = 0
+    try:
+        for chunk in chunks(source):
+            record = cobs_decode(chunk)
+            decoded = decode_record(record) if record else None
+            if decoded is None:
+                corrupt += 1
+                continue
+            sequence, time_ms, fields, values = decoded
+            if expected is not None and sequence != expected:
+                lost += (sequence - expected) & 0xFFFFFFFF
+            expected = (sequence + 1) & 0xFFFFFFFF
+            scaled = ("%g" % (v * scale) for v, (_, scale) in zip(values, VALUES))
+            print("%d,%d,0x%06x,%s" % (sequence, time_ms, fields, ",".join(scaled)))
+    except KeyboardInterrupt:
+        pass
+    print("%d records lost, %d chunks skipped (text or corrupt)" % (lost, corrupt), file=sys.stderr)
+
+
+if __name__ == "__main__":
+    main()
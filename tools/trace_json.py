@@ -0,0 +1,145 @@
+#!/usr/bin/env python3
+"""Convert a saved event trace to Chrome trace JSON.
+
+Copy traceNNNN.vtr off the SD card (or save the serial log of a board
+without one, which prints the trace as "trc" lines), then:
+
+    tools/trace_json.py trace0001.vtr > trace.json
+    tools/trace_json.py --serial serial.log > trace.json
+
+and open the result in chrome://tracing or ui.perfetto.dev. Each link is a
+process with a row per stage (polls and writes, BLE notifications, the
+parser); renders sit on a UI row. A poll's round trip, from its request to
+the first frame that answers it, is drawn as a span of its own. The record
+layout is described in src/system/event_trace.h.
+"""
+
+import argparse
+import collections
+import json
+import struct
+import sys
+
+MAGIC = 0x43525456  # "VTRC"
+HEADER = struct.Struct("<IHHII")
+RECORD = struct.Struct("<IBBH")
+
+EVENTS = ["request", "write", "notify", "parse", "frame", "decoded", "render start", "render end"]
+REQUEST, WRITE, NOTIFY, PARSE, FRAME, DECODED, RENDER_START, RENDER_END = range(len(EVENTS))
+
+# Rows of a link's process, by event
+ROWS = {REQUEST: (1, "poll"), WRITE: (1, "poll"), NOTIFY: (2, "ble"),
+        PARSE: (3, "parser"), FRAME: (3, "parser"), DECODED: (3, "parser")}
+ROUND_TRIP_ROW = (4, "round trip")
+UI_PID = 100
+
+
+def read_file(path):
+    with open(path, "rb") as f:
+        data = f.read()
+    if len(data) < HEADER.size:
+        sys.exit("%s: too short for a trace" % path)
+    magic, version, header_size, count, lost = HEADER.unpack_from(data)
+    if magic != MAGIC:
+        sys.exit("%s: not an event trace" % path)
+    body = data[header_size:header_size + count * RECORD.size]
+    return parse_records(body), lost
+
+
+def read_serial(path):
+    """The hex lines between "trace begin" and "trace end"; the last
+    trace in the log wins."""
+    body, lost, inside = bytearray(), 0, False
+    with open(path, errors="replace") as f:
+        for line in f:
+            words = line.split()
+            if words[:2] == ["trace", "begin"]:
+                body, inside = bytearray(), True
+                lost = int(words[3]) if len(words) > 3 else 0
+            elif words[:2] == ["trace", "end"]:
+                inside = False
+            elif inside and len(words) == 2 and words[0] == "trc":
+                body += bytes.fromhex(words[1])
+    if not body:
+        sys.exit("%s: no trace found" % path)
+    return parse_records(bytes(body)), lost
+
+
+def parse_records(body):
+    """(time, event, link, arg), with the 32-bit microsecond clock
+    unwrapped so times keep rising across its roll-over."""
+    records, base, last = [], 0, None
+    for offset in range(0, len(body) - RECORD.size + 1, RECORD.size):
+        time, event, link, arg = RECORD.unpack_from(body, offset)
+        if last is not None and time < last and last - time > 1 << 31:
+            base += 1 << 32
+        last = time
+        records.append((base + time, event, link, arg))
+    return records
+
+
+def chrome_events(records):
+    out = []
+    named = set()
+    start = records[0][0] if records else 0
+
+    def name_row(pid, row, process):
+        if (pid, row[0]) in named:
+            return
+        if pid not in named:
+            named.add(pid)
+            out.append({"ph": "M", "name": "process_name", "pid": pid, "args": {"name": process}})
+        named.add((pid, row[0]))
+        out.append({"ph": "M", "name": "thread_name", "pid": pid, "tid": row[0], "args": {"name": row[1]}})
+
+    requests = collections.defaultdict(collections.deque)  # (link, command) -> request times
+    render_start = None
+    for time, event, link, arg in records:
+        ts = time - start
+        if event == RENDER_START:
+            render_start = ts
+            continue
+        if event == RENDER_END:
+            if render_start is not None:
+                name_row(UI_PID, (1, "render"), "UI")
+                out.append({"ph": "X", "name": "render", "pid": UI_PID, "tid": 1,
+                            "ts": render_start, "dur": ts - render_start})
+            render_start = None
+            continue
+        if event not in ROWS:
+            continue
+
+        row = ROWS[event]
+        name_row(link, row, "link %d" % link)
+        args = {"bytes": arg}
+        if event == REQUEST:
+            args = {"command": arg >> 8, "controller": arg & 0xFF}
+            requests[(link, arg >> 8)].append(ts)
+        elif event == FRAME:
+            args = {"command": arg}
+            pending = requests[(link, arg)]
+            if pending:
+                sent = pending.popleft()
+                name_row(link, ROUND_TRIP_ROW, "link %d" % link)
+                out.append({"ph": "X", "name": "command %d" % arg, "pid": link, "tid": ROUND_TRIP_ROW[0],
+                            "ts": sent, "dur": ts - sent})
+        elif event == DECODED:
+            args = {"controller": arg}
+        out.append({"ph": "i", "s": "t", "name": EVENTS[event], "pid": link, "tid": row[0],
+                    "ts": ts, "args": args})
+    return out
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("trace", help=".vtr file, or a serial log with --serial")
+    parser.add_argument("--serial", action="store_true", help="read trc lines from a serial log")
+    args = parser.parse_args()
+
+    records, lost = read_serial(args.trace) if args.serial else read_file(args.trace)
+    json.dump({"traceEvents": chrome_events(records), "displayTimeUnit": "ms"}, sys.stdout)
+    sys.stderr.write("%d records, %d written over before the save\n" % (len(records), lost))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,141 @@
+#!/usr/bin/env python3
+"""Generate the UI images as run-length coded tables for flash.
+
+    tools/ui_assets.py > src/ui/ui_assets.h
+
+Each image is drawn here from filled circles and round-capped strokes,
+4x4 supersampled, and its coverage quantized to a palette of at most 16
+colours shading from the background to the foreground. Every byte of
+the output is one run:
+
+    (length - 1) << 4 | palette index     length 1 to 16
+
+running on across the ends of rows, so an icon that is mostly
+background costs a few bytes a row instead of two a pixel. The palette
+is stored in the LCD's byte order. RleImageReader (src/ui/rle_image.h)
+expands one row at a time into a line buffer, so nothing the size of
+the image is ever held in RAM.
+"""
+
+import math
+
+SUPERSAMPLE = 4
+LEVELS = 8          # Shades between background and foreground, the ends included
+
+
+def rgb565(r, g, b):
+    return (r >> 3) << 11 | (g >> 2) << 5 | b >> 3
+
+
+def lcd_order(color):
+    return (color << 8 | color >> 8) & 0xFFFF
+
+
+def blend(t, fg, bg):
+    return tuple(int(round(b + (f - b) * t)) for f, b in zip(fg, bg))
+
+
+def segment_distance(px, py, ax, ay, bx, by):
+    dx, dy = bx - ax, by - ay
+    length = dx * dx + dy * dy
+    t = 0 if length == 0 else max(0.0, min(1.0, ((px - ax) * dx + (py - ay) * dy) / length))
+    return math.hypot(px - (ax + t * dx), py - (ay + t * dy))
+
+
+# The Bluetooth rune: a spine with two chevrons, in units of the icon size
+RUNE = [[(0.33, 0.33), (0.67, 0.67), (0.5, 0.84), (0.5, 0.16), (0.67, 0.33), (0.33, 0.67)]]
+
+# Name, comment, size, background, disc colour, disc radius (0 for none),
+# strokes, stroke colour, stroke width, all in units of the icon size
+IMAGES = [
+    ("BLUETOOTH", "Blue disc with the Bluetooth rune, for scanning and connecting", 24,
+     (0, 0, 0), (0, 90, 200), 0.48, RUNE, (255, 255, 255), 0.09),
+    ("BLUETOOTH_OFF", "The rune struck through in red, for a failed connection", 24,
+     (0, 0, 0), (70, 70, 70), 0.48, RUNE + [[(0.2, 0.2), (0.8, 0.8)]], (255, 80, 60), 0.09),
+]
+
+
+def coverage(size, inside):
+    """Fraction of each pixel's subsamples for which inside(x, y) holds"""
+    rows = []
+    n = SUPERSAMPLE
+    for py in range(size):
+        row = []
+        for px in range(size):
+            hits = 0
+            for sy in range(n):
+                for sx in range(n):
+                    if inside((px + (sx + 0.5) / n) / size, (py + (sy + 0.5) / n) / size):
+                        hits += 1
+            row.append(hits / (n * n))
+        rows.append(row)
+    return rows
+
+
+def render(size, background, disc, radius, strokes, ink, width):
+    """Palette (RGB565) and one palette index per pixel, row by row"""
+    def in_disc(x, y):
+        return math.hypot(x - 0.5, y - 0.5) <= radius
+
+    def in_stroke(x, y):
+        for stroke in strokes:
+            for (ax, ay), (bx, by) in zip(stroke, stroke[1:]):
+                if segment_distance(x, y, ax, ay, bx, by) <= width / 2:
+                    return True
+        return False
+
+    disc_cover = coverage(size, in_disc) if radius > 0 else [[0] * size for _ in range(size)]
+    ink_cover = coverage(size, in_stroke)
+    palette = []
+    pixels = []
+    for y in range(size):
+        for x in range(size):
+            # Quantize each layer's coverage so the colours stay few
+            d = round(disc_cover[y][x] * (LEVELS - 1)) / (LEVELS - 1)
+            s = round(ink_cover[y][x] * (LEVELS - 1)) / (LEVELS - 1)
+            color = rgb565(*blend(s, ink, blend(d, disc, background)))
+            if color not in palette:
+                palette.append(color)
+            pixels.append(palette.index(color))
+    if len(palette) > 16:
+        raise SystemExit("%d colours in a %d px image; lower LEVELS" % (len(palette), size))
+    return palette, pixels
+
+
+def runs(pixels):
+    out = []
+    i = 0
+    while i < len(pixels):
+        j = i
+        while j < len(pixels) and j - i < 16 and pixels[j] == pixels[i]:
+            j += 1
+        out.append((j - i - 1) << 4 | pixels[i])
+        i = j
+    return out
+
+
+def main():
+    print("#pragma once")
+    print()
+    print("// Generated by tools/ui_assets.py; edit the shapes there, not the tables.")
+    print()
+    print('#include "rle_image.h"')
+    for name, comment, size, background, disc, radius, strokes, ink, width in IMAGES:
+        palette, pixels = render(size, background, disc, radius, strokes, ink, width)
+        data = runs(pixels)
+        print()
+        print("// %s, %dx%d, %d bytes for %d raw" % (comment, size, size, len(data), 2 * size * size))
+        print("static const uint16_t IMAGE_%s_PALETTE[%d] = {" % (name, len(palette)))
+        for i in range(0, len(palette), 8):
+            print("    " + " ".join("0x%04x," % lcd_order(c) for c in palette[i:i + 8]))
+        print("};")
+        print("static const uint8_t IMAGE_%s_RUNS[%d] = {" % (name, len(data)))
+        for i in range(0, len(data), 16):
+            print("    " + " ".join("0x%02x," % b for b in data[i:i + 16]))
+        print("};")
+        print("static const RleImage IMAGE_%s = { %d, %d, IMAGE_%s_PALETTE, IMAGE_%s_RUNS, sizeof(IMAGE_%s_RUNS) };"
+              % (name, size, size, name, name, name))
+
+
+if __name__ == "__main__":
+    main()
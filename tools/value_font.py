@@ -0,0 +1,170 @@
+#!/usr/bin/env python3
+"""Generate the smooth font of the big values as VLW data for flash.
+
+    tools/value_font.py > src/ui/value_font.h
+
+The glyphs are drawn here as round-capped strokes along polylines, with
+4x4 supersampling for an 8-bit coverage per pixel, so the dashboard gets
+anti-aliased digits without shipping a font file or a converter. The
+output is the VLW layout TFT_eSPI's smooth fonts use (big-endian):
+
+    header   glyph count, version 11, size, 0, ascent, descent
+    metrics  per glyph: unicode, height, width, x advance, dY, dX, 0
+    bitmaps  per glyph: width * height alpha bytes, row by row
+
+where dY is the top of the bitmap above the baseline. The arrays stay in
+flash and are read in place through the cache; GlyphCache blends them
+into its colors once.
+"""
+
+import math
+
+# Line heights to generate, each the height of the built-in font at one
+# text size (8 px per size) so the two can be mixed in a line
+SIZES = [32, 48]
+SUPERSAMPLE = 4
+
+
+def arc(cx, cy, rx, ry, start, end, steps=32):
+    points = []
+    for i in range(steps + 1):
+        a = math.radians(start + (end - start) * i / steps)
+        points.append((cx + rx * math.cos(a), cy + ry * math.sin(a)))
+    return points
+
+
+def curve(p0, control, p1, steps=16):
+    points = []
+    for i in range(steps + 1):
+        t = i / steps
+        points.append(tuple((1 - t) ** 2 * a + 2 * t * (1 - t) * c + t * t * b
+                            for a, c, b in zip(p0, control, p1)))
+    return points
+
+
+def turned(strokes):
+    return [[(1 - x, 1 - y) for x, y in stroke] for stroke in strokes]
+
+
+SIX = [arc(0.5, 0.3, 0.5, 0.3, 0, 360), curve((0, 0.3), (0, 1), (0.85, 0.98))]
+
+# Character, width in digit widths, strokes in units of the digit width
+# and height with the baseline at 0
+GLYPHS = [
+    ("0", 1, [arc(0.5, 0.5, 0.5, 0.5, 0, 360)]),
+    ("1", 1, [[(0.2, 0.8), (0.55, 1), (0.55, 0)]]),
+    ("2", 1, [arc(0.5, 0.73, 0.5, 0.27, 165, -20) + [(0, 0), (1, 0)]]),
+    ("3", 1, [arc(0.5, 0.76, 0.47, 0.24, 150, -90), arc(0.5, 0.26, 0.5, 0.26, 90, -150)]),
+    ("4", 1, [[(0.78, 0), (0.78, 1), (0, 0.32), (1, 0.32)]]),
+    ("5", 1, [[(0.92, 1), (0.12, 1), (0.08, 0.55)], arc(0.5, 0.32, 0.5, 0.32, 145, -150)]),
+    ("6", 1, SIX),
+    ("7", 1, [[(0, 1), (1, 1), (0.35, 0)]]),
+    ("8", 1, [arc(0.5, 0.76, 0.42, 0.24, 0, 360), arc(0.5, 0.27, 0.5, 0.27, 0, 360)]),
+    ("9", 1, turned(SIX)),
+    (".", 0, [[(0, 0)]]),
+    ("-", 0.7, [[(0, 0.45), (0.7, 0.45)]]),
+    ("V", 1.1, [[(0, 1), (0.55, 0), (1.1, 1)]]),
+    ("A", 1.1, [[(0, 0), (0.55, 1), (1.1, 0)], [(0.22, 0.36), (0.88, 0.36)]]),
+    ("W", 1.5, [[(0, 1), (0.38, 0), (0.75, 0.75), (1.12, 0), (1.5, 1)]]),
+    ("%", 1.1, [arc(0.22, 0.8, 0.22, 0.2, 0, 360), arc(0.88, 0.2, 0.22, 0.2, 0, 360),
+                [(0.05, 0), (1.05, 1)]]),
+    ("k", 0.85, [[(0, 0), (0, 1)], [(0.8, 0.65), (0, 0.22)], [(0.28, 0.36), (0.85, 0)]]),
+    ("m", 1.2, [[(0, 0), (0, 0.65)], arc(0.3, 0.4, 0.3, 0.22, 180, 0) + [(0.6, 0)],
+                arc(0.9, 0.4, 0.3, 0.22, 180, 0) + [(1.2, 0)]]),
+    ("h", 0.8, [[(0, 0), (0, 1)], arc(0.4, 0.4, 0.4, 0.25, 180, 0) + [(0.8, 0)]]),
+    ("/", 0.6, [[(0, 0), (0.6, 1)]]),
+]
+
+
+def segment_distance(px, py, ax, ay, bx, by):
+    dx, dy = bx - ax, by - ay
+    length = dx * dx + dy * dy
+    t = 0 if length == 0 else max(0, min(1, ((px - ax) * dx + (py - ay) * dy) / length))
+    ex, ey = ax + t * dx - px, ay + t * dy - py
+    return math.sqrt(ex * ex + ey * ey)
+
+
+def metrics(size):
+    descent = size // 8
+    ascent = size - descent
+    stroke = size / 8
+    height = ascent - stroke / 2 - 1       # Of a digit's center line
+    width = round(height * 0.52)
+    gap = size // 10
+    return ascent, descent, stroke, height, width, gap
+
+
+def render(size, span, strokes):
+    ascent, descent, stroke, height, width, gap = metrics(size)
+    w = int(math.ceil(span * width + stroke))
+    h = int(math.ceil(height + stroke))
+    top = height + stroke / 2              # Of the bitmap, above the baseline
+    radius = stroke / 2
+    n = SUPERSAMPLE
+    covered = [[False] * (w * n) for _ in range(h * n)]
+    for points in strokes:
+        points = [(x * width + radius, top - y * height) for x, y in points]
+        if len(points) == 1:
+            points = points * 2
+        for (ax, ay), (bx, by) in zip(points, points[1:]):
+            x0 = max(0, int((min(ax, bx) - radius) * n))
+            x1 = min(w * n, int(math.ceil((max(ax, bx) + radius) * n)))
+            y0 = max(0, int((min(ay, by) - radius) * n))
+            y1 = min(h * n, int(math.ceil((max(ay, by) + radius) * n)))
+            for sy in range(y0, y1):
+                row = covered[sy]
+                for sx in range(x0, x1):
+                    if not row[sx] and segment_distance((sx + 0.5) / n, (sy + 0.5) / n,
+                                                        ax, ay, bx, by) <= radius:
+                        row[sx] = True
+    alpha = []
+    for y in range(h):
+        for x in range(w):
+            hits = sum(covered[y * n + j][x * n + i] for j in range(n) for i in range(n))
+            alpha.append((hits * 255 + n * n // 2) // (n * n))
+    advance = w + gap
+    return w, h, advance, int(math.ceil(top)), gap // 2, alpha
+
+
+def vlw(size):
+    ascent, descent = metrics(size)[:2]
+    words = [len(GLYPHS), 11, size, 0, ascent, descent]
+    bitmaps = []
+    for char, span, strokes in GLYPHS:
+        w, h, advance, dy, dx, alpha = render(size, span, strokes)
+        words += [ord(char), h, w, advance, dy, dx, 0]
+        bitmaps += alpha
+    data = []
+    for word in words:
+        data += list((word & 0xFFFFFFFF).to_bytes(4, "big"))
+    return data + bitmaps
+
+
+def main():
+    print("#pragma once")
+    print()
+    print("// Generated by tools/value_font.py; edit the strokes there, not the tables.")
+    print()
+    print("#include <stdint.h>")
+    for size in SIZES:
+        data = vlw(size)
+        print()
+        print("// \"%s\", %d px lines" % ("".join(c for c, _, _ in GLYPHS), size))
+        print("static const uint8_t VALUE_FONT_%d[%d] = {" % (size, len(data)))
+        for i in range(0, len(data), 16):
+            print("    " + " ".join("0x%02x," % b for b in data[i:i + 16]))
+        print("};")
+    print()
+    print("struct ValueFont {")
+    print("    uint8_t size;                // Line height in pixels")
+    print("    const uint8_t* vlw;")
+    print("};")
+    print()
+    print("static const ValueFont VALUE_FONTS[] = {")
+    for size in SIZES:
+        print("    { %d, VALUE_FONT_%d }," % (size, size))
+    print("};")
+
+
+if __name__ == "__main__":
+    main()